@@ -154,6 +154,9 @@ def parse_options():
     res["debug"] = options.debug
     return res
 
+# The number of rows sent to a writer process at a time
+export_batch_size = 200
+
 # This is called through rdb_call_wrapper and may be called multiple times if
 # connection errors occur.  Don't bother setting progress, because this is a
 # fairly small operation.
@@ -194,6 +197,9 @@ def finalize_directory(base_path, base_path_partial):
     os_call_wrapper(lambda x: os.rename(base_path_partial, x), base_path,
                     "Failed to move temporary directory to output directory (%s): %s")
 
+# The number of rows sent to a writer process at a time
+export_batch_size = 200
+
 # This is called through rdb_call_wrapper and may be called multiple times if
 # connection errors occur.  Don't bother setting progress, because we either
 # succeed or fail, there is no partial success.
@@ -208,6 +214,9 @@ def write_table_metadata(progress, conn, db, table, base_path):
     out.close()
     return table_info
 
+# The number of rows sent to a writer process at a time
+export_batch_size = 200
+
 # This is called through rdb_call_wrapper and may be called multiple times if
 # connection errors occur.  In order to facilitate this, we do an order_by by the
 # primary key so that we only ever get a given row once.
@@ -218,21 +227,29 @@ def read_table_into_queue(progress, conn, db, table, pkey, task_queue, progress_
     else:
         cursor = r.db(db).table(table).between(progress[0], None, left_bound="open").order_by(index=pkey).run(conn, time_format="raw", binary_format='raw')
 
+    # Rows are handed to the writer process in batches, because sending each row
+    # through the queue on its own costs more than reading it from the server
+    batch = []
     try:
         for row in cursor:
             if exit_event.is_set():
                 break
-            task_queue.put([row])
-
-            # Set progress so we can continue from this point if a connection error occurs
-            progress[0] = row[pkey]
-
-            # Update the progress every 20 rows - to reduce locking overhead
-            read_rows += 1
-            if read_rows % 20 == 0:
-                progress_info[0].value += 20
+            batch.append(row)
+
+            if len(batch) >= export_batch_size:
+                task_queue.put(("rows", batch))
+                batch = []
+                # Set progress so we can continue from this point if a connection error occurs
+                progress[0] = row[pkey]
+                progress_info[0].value += export_batch_size
+                read_rows = 0
+            else:
+                read_rows += 1
     finally:
-        progress_info[0].value += read_rows % 20
+        if len(batch) > 0:
+            task_queue.put(("rows", batch))
+            progress[0] = batch[-1][pkey]
+        progress_info[0].value += read_rows
 
     # Export is done - since we used estimates earlier, update the actual table size
     progress_info[1].value = progress_info[0].value
@@ -244,19 +261,18 @@ def json_writer(filename, fields, task_queue, error_queue):
             out.write("[")
             while True:
                 item = task_queue.get()
-                if len(item) != 1:
+                if item[0] != "rows":
                     break
-                row = item[0]
-
-                if fields is not None:
-                    for item in list(row.keys()):
-                        if item not in fields:
-                            del row[item]
-                if first:
-                    first = False
-                    out.write("\n" + json.dumps(row))
-                else:
-                    out.write(",\n" + json.dumps(row))
+                for row in item[1]:
+                    if fields is not None:
+                        for field in list(row.keys()):
+                            if field not in fields:
+                                del row[field]
+                    if first:
+                        first = False
+                        out.write("\n" + json.dumps(row))
+                    else:
+                        out.write(",\n" + json.dumps(row))
             out.write("\n]\n")
     except:
         ex_type, ex_class, tb = sys.exc_info()
@@ -270,23 +286,23 @@ def csv_writer(filename, fields, delimiter, task_queue, error_queue):
 
             while True:
                 item = task_queue.get()
-                if len(item) != 1:
+                if item[0] != "rows":
                     break
-                row = item[0]
-                info = []
-                # If the data is a simple type, just write it directly, otherwise, write it as json
-                for field in fields:
-                    if field not in row:
-                        info.append(None)
-                    elif isinstance(row[field], numbers.Number):
-                        info.append(str(row[field]))
-                    elif isinstance(row[field], str):
-                        info.append(row[field])
-                    elif isinstance(row[field], unicode):
-                        info.append(row[field].encode('utf-8'))
-                    else:
-                        info.append(json.dumps(row[field]))
-                out_writer.writerow(info)
+                for row in item[1]:
+                    info = []
+                    # If the data is a simple type, just write it directly, otherwise, write it as json
+                    for field in fields:
+                        if field not in row:
+                            info.append(None)
+                        elif isinstance(row[field], numbers.Number):
+                            info.append(str(row[field]))
+                        elif isinstance(row[field], str):
+                            info.append(row[field])
+                        elif isinstance(row[field], unicode):
+                            info.append(row[field].encode('utf-8'))
+                        else:
+                            info.append(json.dumps(row[field]))
+                    out_writer.writerow(info)
     except:
         ex_type, ex_class, tb = sys.exc_info()
         error_queue.put((ex_type, ex_class, traceback.extract_tb(tb)))
@@ -334,7 +350,7 @@ def export_table(host, port, auth_key, db, table, directory, fields, delimiter,
         error_queue.put((ex_type, ex_class, traceback.extract_tb(tb)))
     finally:
         if writer is not None and writer.is_alive():
-            task_queue.put(("exit", "event")) # Exit is triggered by sending a message with two objects
+            task_queue.put(("exit", "event")) # Anything other than a "rows" message stops the writer
             writer.join()
 
 def abort_export(signum, frame, exit_event, interrupt_event):
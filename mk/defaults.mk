@@ -146,5 +146,6 @@ NO_EVENTFD ?= 0
 NO_EPOLL ?= 0
 LEGACY_PROC_STAT ?= 0
 UNIT_TEST_FILTER ?= *
+BENCHMARK_FILTER ?=
 PACKAGE_FOR_SUSE_10 ?= 0
 NO_COMPILE_JS ?= 0
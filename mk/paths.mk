@@ -70,6 +70,7 @@ GDB_FUNCTIONS_NAME := rethinkdb-gdb.py
 
 PACKAGE_NAME := $(VANILLA_PACKAGE_NAME)
 SERVER_UNIT_TEST_NAME := $(SERVER_EXEC_NAME)-unittest
+SERVER_BENCHMARK_NAME := $(SERVER_EXEC_NAME)-benchmark
 
 EXTERNAL_DIR := $(TOP)/external
 EXTERNAL_DIR_ABS := $(abspath $(EXTERNAL_DIR))
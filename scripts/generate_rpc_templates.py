@@ -66,6 +66,11 @@ def generate_async_message_template(nargs):
         print "            if (bad(res)) { throw fake_archive_exc_t(); }"
     print "            parent->fun(interruptor%s);" % cpre("std::move(arg#)")
     print "        }"
+    if nargs == 1:
+        print "        bool read_local(void *message, signal_t *interruptor) {"
+        print "            parent->fun(interruptor, std::move(*static_cast<arg0_t *>(message)));"
+        print "            return true;"
+        print "        }"
     print "    private:"
     print "        %s *parent;" % mailbox_t_str
     print "    };"
@@ -117,6 +122,20 @@ def generate_async_message_template(nargs):
     print "    send(src, dest.addr, &writer);"
     print "}"
     print
+    if nargs == 1:
+        print "/* `send_moving_locally()` is like `send()`, but if `dest` is on this server it"
+        print "moves `arg0` into the mailbox's callback instead of serializing it. Only use it"
+        print "for types that are safe to hand to another thread, and for mailboxes whose"
+        print "callbacks don't block for long, since they run in the sender's coroutine. */"
+        print "template<class arg0_t>"
+        print "void send_moving_locally(mailbox_manager_t *src,"
+        print "                         typename %s::address_t dest," % mailbox_t_str
+        print "                         arg0_t &&arg0) {"
+        print "    if (!try_deliver_locally(src, dest.addr, &arg0)) {"
+        print "        send(src, dest, arg0);"
+        print "    }"
+        print "}"
+        print
 
 if __name__ == "__main__":
     print "// Copyright 2010-2014 RethinkDB, all rights reserved."
@@ -157,6 +176,10 @@ if __name__ == "__main__":
         print "    template <%s>" % ncsep("class a#_t", nargs)
         print "    friend void send(mailbox_manager_t *,"
         print "                     typename mailbox_t< void(%s) >::address_t%s);" % (ncsep("a#_t", nargs), ncpre("const a#_t&", nargs))
+    print "    template <class a0_t>"
+    print "    friend void send_moving_locally(mailbox_manager_t *,"
+    print "                                    typename mailbox_t< void(a0_t) >::address_t,"
+    print "                                    a0_t &&);"
     print
     print "    raw_mailbox_t::address_t addr;"
     print "};"
@@ -9,9 +9,15 @@
 #include <netinet/in.h>
 
 #include <functional>
+#include <map>
+#include <utility>
 
 #include "arch/io/network.hpp"
+#include "arch/runtime/coroutines.hpp"
 #include "arch/runtime/thread_pool.hpp"
+#include "arch/spinlock.hpp"
+#include "config/args.hpp"
+#include "time.hpp"
 
 host_lookup_exc_t::host_lookup_exc_t(const std::string &_host,
                                      int _res, int _errno_res)
@@ -60,8 +66,10 @@ std::string ip_to_string(const addr_t &addr, int address_family) {
     return std::string(buffer);
 }
 
-void hostname_to_ips_internal(const std::string &host,
+void uncached_hostname_to_ips(const std::string &host,
                               int address_family,
+                              int *res_out,
+                              int *errno_res_out,
                               std::set<ip_address_t> *ips) {
     struct addrinfo hint;
     memset(&hint, 0, sizeof(hint));
@@ -74,10 +82,12 @@ void hostname_to_ips_internal(const std::string &host,
     std::function<void ()> fn =
         std::bind(do_getaddrinfo, host.c_str(), static_cast<const char*>(NULL),
                   &hint, &addrs, &res, &errno_res);
-    thread_pool_t::run_in_blocker_pool(fn);
+    thread_pool_t::run_in_dns_blocker_pool(fn);
 
+    *res_out = res;
+    *errno_res_out = errno_res;
     if (res != 0) {
-        throw host_lookup_exc_t(host, res, errno_res);
+        return;
     }
 
     guarantee(addrs);
@@ -88,6 +98,104 @@ void hostname_to_ips_internal(const std::string &host,
     freeaddrinfo(addrs);
 }
 
+/* Lookups are cached process-wide, so that reconnecting to peers by hostname doesn't
+hit the resolver every time. `getaddrinfo()` doesn't tell us the TTLs of the records it
+found, so successful lookups are kept for `DNS_CACHE_TTL_MS` and failed ones for the
+shorter `DNS_NEGATIVE_CACHE_TTL_MS`. Concurrent lookups of the same host, from any
+thread, wait for a single `getaddrinfo()` call. */
+static const int64_t DNS_CACHE_TTL_MS = 30 * THOUSAND;
+static const int64_t DNS_NEGATIVE_CACHE_TTL_MS = 5 * THOUSAND;
+
+// Expired entries are only removed once the cache has grown to this many entries.
+static const size_t DNS_CACHE_MAX_SIZE = 1000;
+
+struct dns_cache_entry_t {
+    dns_cache_entry_t() : in_flight(false), res(0), errno_res(0), expiration_ticks(0) { }
+
+    // If `in_flight` is true, a lookup is running and `waiters` are the coroutines
+    // waiting for it. Otherwise the other fields hold the result of the last lookup.
+    bool in_flight;
+    std::vector<coro_t *> waiters;
+
+    int res;
+    int errno_res;
+    std::set<ip_address_t> ips;
+    int64_t expiration_ticks;
+};
+
+static spinlock_t dns_cache_lock;
+static std::map<std::pair<std::string, int>, dns_cache_entry_t> dns_cache;
+
+void hostname_to_ips_internal(const std::string &host,
+                              int address_family,
+                              std::set<ip_address_t> *ips) {
+    const std::pair<std::string, int> key(host, address_family);
+
+    for (;;) {
+        {
+            spinlock_acq_t acq(&dns_cache_lock);
+            const int64_t now = get_ticks();
+            if (dns_cache.size() >= DNS_CACHE_MAX_SIZE) {
+                for (auto it = dns_cache.begin(); it != dns_cache.end();) {
+                    auto curr = it++;
+                    if (!curr->second.in_flight
+                        && curr->second.expiration_ticks <= now) {
+                        dns_cache.erase(curr);
+                    }
+                }
+            }
+
+            dns_cache_entry_t *entry = &dns_cache[key];
+            if (!entry->in_flight) {
+                if (entry->expiration_ticks <= now) {
+                    // It's up to us to do the lookup.
+                    entry->in_flight = true;
+                    break;
+                }
+                if (entry->res != 0) {
+                    throw host_lookup_exc_t(host, entry->res, entry->errno_res);
+                }
+                ips->insert(entry->ips.begin(), entry->ips.end());
+                return;
+            }
+
+            // Lookups only run concurrently once the thread pool is up, so we must be
+            // in a coroutine.
+            guarantee(coro_t::self() != NULL);
+            entry->waiters.push_back(coro_t::self());
+        }
+        // Once we get woken up the entry is filled in, so the next iteration returns it.
+        coro_t::wait();
+    }
+
+    int res;
+    int errno_res;
+    std::set<ip_address_t> result;
+    uncached_hostname_to_ips(host, address_family, &res, &errno_res, &result);
+
+    std::vector<coro_t *> waiters;
+    {
+        spinlock_acq_t acq(&dns_cache_lock);
+        dns_cache_entry_t *entry = &dns_cache[key];
+        guarantee(entry->in_flight);
+        entry->in_flight = false;
+        entry->res = res;
+        entry->errno_res = errno_res;
+        entry->ips = result;
+        entry->expiration_ticks = get_ticks()
+            + (res == 0 ? DNS_CACHE_TTL_MS : DNS_NEGATIVE_CACHE_TTL_MS) * MILLION;
+        waiters.swap(entry->waiters);
+    }
+    for (coro_t *waiter : waiters) {
+        waiter->notify_sometime();
+    }
+
+    if (res != 0) {
+        throw host_lookup_exc_t(host, res, errno_res);
+    }
+    ips->insert(result.begin(), result.end());
+}
+
 std::set<ip_address_t> hostname_to_ips(const std::string &host) {
     std::set<ip_address_t> ips;
 
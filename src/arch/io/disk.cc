@@ -6,6 +6,9 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/file.h>
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
 #include <unistd.h>
 #include <libgen.h>
 #include <limits.h>
@@ -46,12 +49,14 @@ public:
     linux_disk_manager_t(linux_event_queue_t *queue,
                          int batch_factor,
                          int max_concurrent_io_requests,
+                         io_backend_mode_t backend_mode,
                          perfmon_collection_t *stats) :
         stack_stats(stats, "stack"),
         conflict_resolver(stats),
-        accounter(batch_factor),
+        accounter(batch_factor, stats),
         backend_stats(stats, "backend", accounter.producer),
-        backend(queue, backend_stats.producer, max_concurrent_io_requests),
+        backend(queue, backend_stats.producer, max_concurrent_io_requests,
+                backend_mode),
         outstanding_txn(0)
     {
         /* Hook up the `submit_fun`s of the parts of the IO stack that are above the
@@ -77,8 +82,9 @@ public:
                 outstanding_txn);
     }
 
-    void *create_account(int pri, int outstanding_requests_limit) {
-        return new accounting_diskmgr_t::account_t(&accounter, pri, outstanding_requests_limit);
+    void *create_account(int pri, int outstanding_requests_limit, io_class_t io_class) {
+        return new accounting_diskmgr_t::account_t(&accounter, pri, outstanding_requests_limit,
+                                                   io_class);
     }
 
     void delayed_destroy(void *_account) {
@@ -101,11 +107,11 @@ public:
 
     void submit_write(fd_t fd, const void *buf, size_t count, int64_t offset,
                       void *account, linux_iocallback_t *cb,
-                      bool wrap_in_datasyncs) {
+                      bool datasync_before, bool datasync_after) {
         threadnum_t calling_thread = get_thread_id();
 
         action_t *a = new action_t(calling_thread, cb);
-        a->make_write(fd, buf, count, offset, wrap_in_datasyncs);
+        a->make_write(fd, buf, count, offset, datasync_before, datasync_after);
         a->account = static_cast<accounting_diskmgr_t::account_t *>(account);
 
         do_on_thread(home_thread(),
@@ -188,7 +194,8 @@ private:
     will tell you how many IO operations are queued. The "backend stats" will tell you
     how long the OS takes to perform the operations. Note that it's not perfect, because
     it counts operations that have been queued by the backend but not sent to the OS yet
-    as having been sent to the OS. */
+    as having been sent to the OS. The account manager breaks the same two intervals
+    down by the `io_class_t` of each operation's account. */
 
     stats_diskmgr_t stack_stats;
     conflict_resolving_diskmgr_t conflict_resolver;
@@ -202,16 +209,55 @@ private:
     DISABLE_COPYING(linux_disk_manager_t);
 };
 
+class io_backender_t::device_t {
+public:
+    device_t(perfmon_collection_t *parent_stats, dev_t device,
+             int max_concurrent_io_requests, io_backend_mode_t backend_mode)
+        : stats_membership(parent_stats, &stats,
+                           strprintf("device_%u_%u", major(device), minor(device))),
+          diskmgr(&linux_thread_pool_t::get_thread()->queue,
+                  DEFAULT_IO_BATCH_FACTOR,
+                  max_concurrent_io_requests,
+                  backend_mode,
+                  &stats) { }
+
+    perfmon_collection_t stats;
+    perfmon_membership_t stats_membership;
+    linux_disk_manager_t diskmgr;
+
+private:
+    DISABLE_COPYING(device_t);
+};
+
 io_backender_t::io_backender_t(file_direct_io_mode_t _direct_io_mode,
-                               int max_concurrent_io_requests)
+                               int _max_concurrent_io_requests,
+                               io_backend_mode_t _backend_mode)
     : direct_io_mode(_direct_io_mode),
-      diskmgr(new linux_disk_manager_t(&linux_thread_pool_t::get_thread()->queue,
-                                       DEFAULT_IO_BATCH_FACTOR,
-                                       max_concurrent_io_requests,
-                                       &stats)) { }
+      max_concurrent_io_requests(_max_concurrent_io_requests),
+      backend_mode(_backend_mode),
+      stats_membership(&get_global_perfmon_collection(), &stats, "disk_io") { }
 
 io_backender_t::~io_backender_t() { }
 
+linux_disk_manager_t *io_backender_t::get_diskmgr_ptr(dev_t device) {
+    on_thread_t thread_switcher(home_thread());
+    auto it = devices.find(device);
+    if (it == devices.end()) {
+        int max_requests = max_concurrent_io_requests;
+        if (is_rotational_device(device)) {
+            max_requests = std::min(max_requests, ROTATIONAL_MAX_CONCURRENT_IO_REQUESTS);
+        }
+        scoped_ptr_t<device_t> new_device(
+            new device_t(&stats, device, max_requests, backend_mode));
+        // Another file on the same device may have been opened while we blocked.
+        it = devices.find(device);
+        if (it == devices.end()) {
+            it = devices.insert(std::make_pair(device, std::move(new_device))).first;
+        }
+    }
+    return &it->second->diskmgr;
+}
+
 file_direct_io_mode_t io_backender_t::get_direct_io_mode() const { return direct_io_mode; }
 
 
@@ -288,7 +334,9 @@ void linux_file_t::write_async(int64_t offset, size_t length, const void *buf,
     diskmgr->submit_write(fd.get(), buf, length, offset,
                           account == DEFAULT_DISK_ACCOUNT ? default_account->get_account() : account->get_account(),
                           callback,
-                          wrap_in_datasyncs == WRAP_IN_DATASYNCS);
+                          wrap_in_datasyncs == WRAP_IN_DATASYNCS,
+                          wrap_in_datasyncs == WRAP_IN_DATASYNCS
+                          || wrap_in_datasyncs == DATASYNC_AFTER);
 }
 
 void linux_file_t::writev_async(int64_t offset, size_t length,
@@ -339,7 +387,7 @@ void linux_file_t::writev_async(int64_t offset, size_t length,
                               ? default_account->get_account()
                               : account->get_account(),
                               intermediate_cb,
-                              false);
+                              false, false);
         partial_offset += bufs[i].iov_len;
     }
     guarantee(partial_offset - offset == static_cast<int64_t>(length));
@@ -358,9 +406,10 @@ bool linux_file_t::coop_lock_and_check() {
     return true;
 }
 
-void *linux_file_t::create_account(int priority, int outstanding_requests_limit) {
+void *linux_file_t::create_account(int priority, int outstanding_requests_limit,
+                                   io_class_t io_class) {
     assert_thread();
-    return diskmgr->create_account(priority, outstanding_requests_limit);
+    return diskmgr->create_account(priority, outstanding_requests_limit, io_class);
 }
 
 void linux_file_t::destroy_account(void *account) {
@@ -401,6 +450,14 @@ void verify_aligned_file_access(DEBUG_VAR int64_t file_size, DEBUG_VAR int64_t o
     rassert(divides(DEVICE_BLOCK_SIZE, length));
 }
 
+static void log_fsync_parent_directory_failure(const char *path, int sync_res) {
+    logWRN("Failed to sync parent directory of \"%s\" (errno: %d - %s). "
+           "You may encounter data loss in case of a system failure. "
+           "(Is the file located on a filesystem that doesn't support directory sync? "
+           "e.g. VirtualBox shared folders)",
+           path, sync_res, errno_string(sync_res).c_str());
+}
+
 file_open_result_t open_file(const char *path, const int mode, io_backender_t *backender,
                              scoped_ptr_t<file_t> *out) {
     // Construct file flags
@@ -444,84 +501,102 @@ file_open_result_t open_file(const char *path, const int mode, io_backender_t *b
     flags |= O_NOATIME;
 #endif
 
-    // Open the file.
-
+    // Opening the file (and syncing its directory) can block for a long time on a busy
+    // disk, so we do it in the blocker pool.  A server that opens the files of many
+    // tables at startup then opens them in parallel, and doesn't hold up the tables
+    // that are already being served on the same threads.
+    const file_direct_io_mode_t direct_io_mode = backender->get_direct_io_mode();
     scoped_fd_t fd;
-    {
+    file_open_result_t open_res;
+    int disable_readahead_res = 0;
+    int sync_res = 0;
+    int64_t file_size = 0;
+    dev_t device = 0;
+    linux_thread_pool_t::run_in_blocker_pool([&]() {
         int res_open;
         do {
             res_open = open(path, flags, 0644);
         } while (res_open == -1 && get_errno() == EINTR);
 
         fd.reset(res_open);
-    }
-
-    if (fd.get() == INVALID_FD) {
-        return file_open_result_t(file_open_result_t::ERROR, get_errno());
-    }
-
-    // When building, we must either support O_DIRECT or F_NOCACHE.  The former works on Linux,
-    // the latter works on OS X.
-    file_open_result_t open_res;
+        if (fd.get() == INVALID_FD) {
+            open_res = file_open_result_t(file_open_result_t::ERROR, get_errno());
+            return;
+        }
 
-    switch (backender->get_direct_io_mode()) {
-    case file_direct_io_mode_t::direct_desired: {
+        // When building, we must either support O_DIRECT or F_NOCACHE.  The former works on Linux,
+        // the latter works on OS X.
+        switch (direct_io_mode) {
+        case file_direct_io_mode_t::direct_desired: {
 #ifdef __linux__
-        // fcntl(2) is documented to take an argument of type long, not of type int, with the
-        // F_SETFL command, on Linux.  But POSIX says it's supposed to take an int?  Passing long
-        // should be generally fine, with either the x86 or amd64 calling convention, on another
-        // system (that supports O_DIRECT) but we use "#ifdef __linux__" (and not "#ifdef O_DIRECT")
-        // specifically to avoid such concerns.
-        const int fcntl_res = fcntl(fd.get(), F_SETFL,
-                                    static_cast<long>(flags | O_DIRECT));  // NOLINT(runtime/int)
+            // fcntl(2) is documented to take an argument of type long, not of type int, with the
+            // F_SETFL command, on Linux.  But POSIX says it's supposed to take an int?  Passing long
+            // should be generally fine, with either the x86 or amd64 calling convention, on another
+            // system (that supports O_DIRECT) but we use "#ifdef __linux__" (and not "#ifdef O_DIRECT")
+            // specifically to avoid such concerns.
+            const int fcntl_res = fcntl(fd.get(), F_SETFL,
+                                        static_cast<long>(flags | O_DIRECT));  // NOLINT(runtime/int)
 #elif defined(__APPLE__)
-        const int fcntl_res = fcntl(fd.get(), F_NOCACHE, 1);
+            const int fcntl_res = fcntl(fd.get(), F_NOCACHE, 1);
 #else
 #error "Figure out how to do direct I/O and fsync correctly (despite your operating system's lies) on your platform."
 #endif  // __linux__, defined(__APPLE__)
-        open_res = file_open_result_t(fcntl_res == -1 ?
-                                      file_open_result_t::BUFFERED_FALLBACK :
-                                      file_open_result_t::DIRECT,
-                                      0);
-    } break;
-    case file_direct_io_mode_t::buffered_desired: {
-        // We can typically improve read performance by disabling read-ahead.
-        // Our access patterns are usually pretty random, and on startup we already
-        // do read-ahead internally in our cache.
-        int disable_readahead_res = -1;
+            open_res = file_open_result_t(fcntl_res == -1 ?
+                                          file_open_result_t::BUFFERED_FALLBACK :
+                                          file_open_result_t::DIRECT,
+                                          0);
+        } break;
+        case file_direct_io_mode_t::buffered_desired: {
+            // We can typically improve read performance by disabling read-ahead.
+            // Our access patterns are usually pretty random, and on startup we already
+            // do read-ahead internally in our cache.
+            disable_readahead_res = -1;
 #ifdef __linux__
-        // From the man-page:
-        //  Under Linux, POSIX_FADV_NORMAL sets the readahead window to the
-        //  default size for the backing device; POSIX_FADV_SEQUENTIAL doubles
-        //  this size, and POSIX_FADV_RANDOM disables file readahead entirely.
-        //  These changes affect the entire file, not just the specified region
-        //  (but other open file handles to the same file are unaffected)
-        disable_readahead_res = posix_fadvise(fd.get(), 0, 0, POSIX_FADV_RANDOM);
+            // From the man-page:
+            //  Under Linux, POSIX_FADV_NORMAL sets the readahead window to the
+            //  default size for the backing device; POSIX_FADV_SEQUENTIAL doubles
+            //  this size, and POSIX_FADV_RANDOM disables file readahead entirely.
+            //  These changes affect the entire file, not just the specified region
+            //  (but other open file handles to the same file are unaffected)
+            disable_readahead_res = posix_fadvise(fd.get(), 0, 0, POSIX_FADV_RANDOM);
 #elif defined(__APPLE__)
-        const int fcntl_res = fcntl(fd.get(), F_RDAHEAD, 0);
-        disable_readahead_res = fcntl_res == -1
-                                ? get_errno()
-                                : 0;
+            const int fcntl_res = fcntl(fd.get(), F_RDAHEAD, 0);
+            disable_readahead_res = fcntl_res == -1
+                                    ? get_errno()
+                                    : 0;
 #endif
-        if (disable_readahead_res != 0) {
-            // Non-critical error. Just print a warning and keep going.
-            logWRN("Failed to disable read-ahead on '%s' (errno %d). You might see "
-                   "decreased read performance.", path, disable_readahead_res);
+            open_res = file_open_result_t(file_open_result_t::BUFFERED, 0);
+        } break;
+        default:
+            unreachable();
         }
 
-        open_res = file_open_result_t(file_open_result_t::BUFFERED, 0);
-    } break;
-    default:
-        unreachable();
-    }
+        file_size = get_file_size(fd.get());
+        device = get_file_device(fd.get());
+
+        // Call fsync() on the parent directory to guarantee that the newly
+        // created file's directory entry is persisted to disk.  Opening a file that
+        // already exists doesn't change the directory.
+        if (mode & linux_file_t::mode_create) {
+            sync_res = fsync_parent_directory(path);
+        }
+    });
 
-    const int64_t file_size = get_file_size(fd.get());
+    if (open_res.outcome == file_open_result_t::ERROR) {
+        return open_res;
+    }
+    if (disable_readahead_res != 0) {
+        // Non-critical error. Just print a warning and keep going.
+        logWRN("Failed to disable read-ahead on '%s' (errno %d). You might see "
+               "decreased read performance.", path, disable_readahead_res);
+    }
+    if (sync_res != 0) {
+        log_fsync_parent_directory_failure(path, sync_res);
+    }
 
-    // Call fsync() on the parent directory to guarantee that the newly
-    // created file's directory entry is persisted to disk.
-    warn_fsync_parent_directory(path);
+    linux_disk_manager_t *diskmgr = backender->get_diskmgr_ptr(device);
 
-    out->init(new linux_file_t(std::move(fd), file_size, backender->get_diskmgr_ptr()));
+    out->init(new linux_file_t(std::move(fd), file_size, diskmgr));
 
     return open_res;
 }
@@ -613,10 +688,6 @@ MUST_USE int fsync_parent_directory(const char *path) {
 void warn_fsync_parent_directory(const char *path) {
     int sync_res = fsync_parent_directory(path);
     if (sync_res != 0) {
-        logWRN("Failed to sync parent directory of \"%s\" (errno: %d - %s). "
-               "You may encounter data loss in case of a system failure. "
-               "(Is the file located on a filesystem that doesn't support directory sync? "
-               "e.g. VirtualBox shared folders)",
-               path, sync_res, errno_string(sync_res).c_str());
+        log_fsync_parent_directory_failure(path, sync_res);
     }
 }
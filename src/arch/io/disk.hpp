@@ -2,6 +2,10 @@
 #ifndef ARCH_IO_DISK_HPP_
 #define ARCH_IO_DISK_HPP_
 
+#include <sys/types.h>
+
+#include <map>
+
 #include "arch/io/io_utils.hpp"
 #include "arch/types.hpp"
 #include "concurrency/auto_drainer.hpp"
@@ -23,21 +27,31 @@ class linux_iocallback_t;
 
 class linux_disk_manager_t;
 
-class io_backender_t : public home_thread_mixin_debug_only_t {
+class io_backender_t : public home_thread_mixin_t {
 public:
     // This takes what is effectively a global flag whether to use O_DIRECT here.  Nothing technical
     // stops us from specifying this on a file-by-file basis, but right now there's no desire for
     // that.  See https://github.com/rethinkdb/rethinkdb/issues/97#issuecomment-19778177 .
     io_backender_t(file_direct_io_mode_t direct_io_mode,
-                   int max_concurrent_io_requests = DEFAULT_MAX_CONCURRENT_IO_REQUESTS);
+                   int max_concurrent_io_requests = DEFAULT_MAX_CONCURRENT_IO_REQUESTS,
+                   io_backend_mode_t backend_mode = io_backend_mode_t::pool);
     ~io_backender_t();
-    linux_disk_manager_t *get_diskmgr_ptr() { return diskmgr.get(); }
+
+    /* Returns the disk manager for files on `device`.  Each device gets its own, so
+    that requests for the files on a device are sorted and merged with each other, and
+    so that a slow device doesn't hold up requests for the others.  This may block. */
+    linux_disk_manager_t *get_diskmgr_ptr(dev_t device);
     file_direct_io_mode_t get_direct_io_mode() const;
 
 protected:
     const file_direct_io_mode_t direct_io_mode;
+    const int max_concurrent_io_requests;
+    const io_backend_mode_t backend_mode;
     perfmon_collection_t stats;
-    scoped_ptr_t<linux_disk_manager_t> diskmgr;
+    perfmon_membership_t stats_membership;
+
+    class device_t;
+    std::map<dev_t, scoped_ptr_t<device_t> > devices;
 
 private:
     DISABLE_COPYING(io_backender_t);
@@ -89,7 +103,8 @@ public:
 
     bool coop_lock_and_check();
 
-    void *create_account(int priority, int outstanding_requests_limit);
+    void *create_account(int priority, int outstanding_requests_limit,
+                         io_class_t io_class);
     void destroy_account(void *account);
 
     ~linux_file_t();
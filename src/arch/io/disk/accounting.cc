@@ -49,9 +49,11 @@ private:
 
 accounting_diskmgr_account_t::accounting_diskmgr_account_t(accounting_diskmgr_t *_par,
                                                            int _pri,
-                                                           int _outstanding_requests_limit)
+                                                           int _outstanding_requests_limit,
+                                                           io_class_t _io_class)
         : par(_par), pri(_pri),
-          outstanding_requests_limit(_outstanding_requests_limit) { }
+          outstanding_requests_limit(_outstanding_requests_limit),
+          io_class(_io_class) { }
 
 accounting_diskmgr_account_t::~accounting_diskmgr_account_t() {
     par->assert_thread();
@@ -98,18 +100,66 @@ void debug_print(printf_buffer_t *buf,
     debug_print(buf, parent_action);
 }
 
+accounting_diskmgr_class_stats_t::accounting_diskmgr_class_stats_t(
+        perfmon_collection_t *parent, io_class_t io_class)
+    : collection_membership(parent, &collection, io_class_name(io_class)),
+      queue_wait(secs_to_ticks(1)),
+      service_time(secs_to_ticks(1)),
+      stats_membership(&collection,
+                       &queue_wait, "queue_wait",
+                       &service_time, "service_time",
+                       &queued, "queued",
+                       &in_flight, "in_flight") { }
+
+
+accounting_diskmgr_t::accounting_diskmgr_t(int batch_factor, perfmon_collection_t *stats)
+    : producer(&dispatcher),
+      queue(batch_factor),
+      dispatcher(this),
+      classes_membership(stats, &classes_collection, "classes"),
+      auto_drainer(new auto_drainer_t()) {
+    for (int i = 0; i < NUM_IO_CLASSES; ++i) {
+        class_stats[i].init(new accounting_diskmgr_class_stats_t(
+            &classes_collection, static_cast<io_class_t>(i)));
+    }
+}
 
 accounting_diskmgr_t::~accounting_diskmgr_t() {
     auto_drainer.reset();  // Make absolutely sure this happens first.
 }
 
+accounting_diskmgr_class_stats_t *accounting_diskmgr_t::get_class_stats(action_t *a) {
+    return class_stats[static_cast<int>(a->account->get_io_class())].get();
+}
+
 void accounting_diskmgr_t::submit(action_t *a) {
+    accounting_diskmgr_class_stats_t *stats = get_class_stats(a);
+    ++stats->queued;
+    a->queued_time = global_full_perfmon ? get_ticks() : 0;
+    a->dispatched_time = 0;
     a->account->push(a);
 }
 
+accounting_payload_t *accounting_diskmgr_t::dispatcher_t::produce_next_value() {
+    action_t *a = parent->queue.pop();
+    accounting_diskmgr_class_stats_t *stats = parent->get_class_stats(a);
+    --stats->queued;
+    ++stats->in_flight;
+    if (a->queued_time != 0) {
+        a->dispatched_time = get_ticks();
+        stats->queue_wait.record(a->dispatched_time - a->queued_time);
+    }
+    return a;
+}
+
 void accounting_diskmgr_t::done(accounting_payload_t *p) {
     // p really is an action_t...
     action_t *a = static_cast<action_t *>(p);
+    accounting_diskmgr_class_stats_t *stats = get_class_stats(a);
+    --stats->in_flight;
+    if (a->dispatched_time != 0) {
+        stats->service_time.record(get_ticks() - a->dispatched_time);
+    }
     a->account->get_outstanding_requests_limiter()->unlock(1);
     a->account_acq.reset();
     done_fun(static_cast<action_t *>(p));
@@ -12,24 +12,7 @@
 #include "concurrency/semaphore.hpp"
 #include "arch/io/disk.hpp"
 #include "arch/io/disk/stats_2.hpp"
-
-/* `casting_passive_producer_t` is useful when you have a
-`passive_producer_t<X>` but you need a `passive_producer_t<Y>`, where `X` can
-be cast to `Y`. */
-
-template <class input_t, class output_t>
-struct casting_passive_producer_t : public passive_producer_t<output_t> {
-    explicit casting_passive_producer_t(passive_producer_t<input_t> *_source) :
-        passive_producer_t<output_t>(_source->available), source(_source) { }
-
-    output_t produce_next_value() {
-        /* Implicit cast from `input_t` to `output_t` in return */
-        return source->pop();
-    }
-
-private:
-    passive_producer_t<input_t> *source;
-};
+#include "perfmon/perfmon.hpp"
 
 /* `accounting_diskmgr_t` shares disk throughput proportionally between a
 number of different "accounts". */
@@ -47,10 +30,13 @@ struct accounting_diskmgr_account_t {
 
     accounting_diskmgr_account_t(accounting_diskmgr_t *_par,
                                  int _pri,
-                                 int _outstanding_requests_limit);
+                                 int _outstanding_requests_limit,
+                                 io_class_t _io_class);
 
     ~accounting_diskmgr_account_t();
 
+    io_class_t get_io_class() const { return io_class; }
+
     void push(action_t *action);
     void on_semaphore_available();
     co_semaphore_t *get_outstanding_requests_limiter();
@@ -63,6 +49,7 @@ private:
     accounting_diskmgr_t *par;
     int pri;
     int outstanding_requests_limit;
+    io_class_t io_class;
     scoped_ptr_t<eager_account_t> eager_account;
     // A scoped pointer because we create the drainer lazily on first use.
     scoped_ptr_t<auto_drainer_t> requests_drainer;
@@ -75,18 +62,35 @@ struct accounting_diskmgr_action_t
       public accounting_payload_t {
     accounting_diskmgr_account_t *account;
     auto_drainer_t::lock_t account_acq;
+    // When the operation was submitted to and dispatched from the accounter, or 0
+    // if `global_full_perfmon` was off at the time.
+    ticks_t queued_time;
+    ticks_t dispatched_time;
 };
 
 void debug_print(printf_buffer_t *buf,
                  const accounting_diskmgr_action_t &action);
 
+/* The stats for the operations of one `io_class_t`: how long they wait in the
+accounter's queues, how long the layers below take to complete them once they
+have been dispatched, and how many of them are in either state right now. */
+struct accounting_diskmgr_class_stats_t {
+    accounting_diskmgr_class_stats_t(perfmon_collection_t *parent, io_class_t io_class);
+
+    perfmon_collection_t collection;
+    perfmon_membership_t collection_membership;
+    perfmon_latency_histogram_t queue_wait;
+    perfmon_latency_histogram_t service_time;
+    perfmon_counter_t queued;
+    perfmon_counter_t in_flight;
+    perfmon_multi_membership_t stats_membership;
+
+    DISABLE_COPYING(accounting_diskmgr_class_stats_t);
+};
+
 class accounting_diskmgr_t : public home_thread_mixin_t {
 public:
-    explicit accounting_diskmgr_t(int batch_factor)
-        : producer(&caster),
-          queue(batch_factor),
-          caster(&queue),
-          auto_drainer(new auto_drainer_t()) { }
+    accounting_diskmgr_t(int batch_factor, perfmon_collection_t *stats);
 
     ~accounting_diskmgr_t();
 
@@ -108,8 +112,24 @@ public:
 private:
     friend struct accounting_diskmgr_eager_account_t;
 
+    /* Pops the operations off `queue` for the next stage of the IO stack, and
+    records that they have been dispatched. */
+    struct dispatcher_t : public passive_producer_t<accounting_payload_t *> {
+        explicit dispatcher_t(accounting_diskmgr_t *_parent)
+            : passive_producer_t<accounting_payload_t *>(_parent->queue.available),
+              parent(_parent) { }
+        accounting_payload_t *produce_next_value();
+    private:
+        accounting_diskmgr_t *parent;
+    };
+
+    accounting_diskmgr_class_stats_t *get_class_stats(action_t *a);
+
     accounting_queue_t<action_t *> queue;
-    casting_passive_producer_t<action_t *, accounting_payload_t *> caster;
+    dispatcher_t dispatcher;
+    perfmon_collection_t classes_collection;
+    perfmon_membership_t classes_membership;
+    scoped_ptr_t<accounting_diskmgr_class_stats_t> class_stats[NUM_IO_CLASSES];
     scoped_ptr_t<auto_drainer_t> auto_drainer;
 
     DISABLE_COPYING(accounting_diskmgr_t);
@@ -1,8 +1,13 @@
 #include "arch/io/disk/filestat.hpp"
 
+#include <stdio.h>
 #include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
 
 #include "errors.hpp"
+#include "utils.hpp"
 
 int64_t get_file_size(int fd) {
     guarantee(fd != -1);
@@ -21,3 +26,40 @@ int64_t get_file_size(int fd) {
     guarantee(buf.st_size >= 0);
     return buf.st_size;
 }
+
+dev_t get_file_device(int fd) {
+    guarantee(fd != -1);
+    struct stat buf;
+    int res = fstat(fd, &buf);
+    guarantee_err(res == 0, "fstat failed");
+    return buf.st_dev;
+}
+
+#ifdef __linux__
+static bool read_rotational_flag(const std::string &path, bool *rotational_out) {
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        return false;
+    }
+    int flag;
+    bool ok = fscanf(file, "%d", &flag) == 1;
+    fclose(file);
+    if (ok) {
+        *rotational_out = flag != 0;
+    }
+    return ok;
+}
+#endif
+
+bool is_rotational_device(UNUSED dev_t device) {
+#ifdef __linux__
+    const std::string dir = strprintf("/sys/dev/block/%u:%u/", major(device), minor(device));
+    bool rotational = false;
+    // Partitions don't have a `queue` directory of their own.
+    if (read_rotational_flag(dir + "queue/rotational", &rotational)
+        || read_rotational_flag(dir + "../queue/rotational", &rotational)) {
+        return rotational;
+    }
+#endif
+    return false;
+}
@@ -2,7 +2,15 @@
 #define ARCH_IO_DISK_FILESTAT_HPP_
 
 #include <stdint.h>
+#include <sys/types.h>
 
 int64_t get_file_size(int fd);
 
+// The device that the file is stored on.
+dev_t get_file_device(int fd);
+
+// Whether `device` is a spinning disk (or a partition of one).  Returns false if we
+// can't tell, for example for network file systems.
+bool is_rotational_device(dev_t device);
+
 #endif  // ARCH_IO_DISK_FILESTAT_HPP_
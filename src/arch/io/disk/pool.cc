@@ -7,6 +7,9 @@
 #include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "arch/io/disk.hpp"
 #include "config/args.hpp"
 #include "containers/printf_buffer.hpp"
@@ -33,11 +36,15 @@ void debug_print(printf_buffer_t *buf,
 
 pool_diskmgr_t::pool_diskmgr_t(linux_event_queue_t *queue,
                                passive_producer_t<action_t *> *_source,
-                               int max_concurrent_io_requests)
+                               int max_concurrent_io_requests,
+                               io_backend_mode_t backend_mode)
     : queue_depth(blocker_pool_queue_depth(max_concurrent_io_requests)),
       source(_source),
       blocker_pool(max_concurrent_io_requests, queue),
       n_pending(0) {
+    if (backend_mode == io_backend_mode_t::io_uring_desired) {
+        uring = io_uring_t::create(queue, queue_depth);
+    }
     if (source->available->get()) { pump(); }
     source->available->set_callback(this);
 }
@@ -48,9 +55,7 @@ pool_diskmgr_t::~pool_diskmgr_t() {
 }
 
 // Advance the vector, while respecting the device block size alignment for direct I/O
-size_t pool_diskmgr_t::action_t::advance_vector(iovec **vecs,
-                                                size_t *count,
-                                                size_t bytes_done) {
+static size_t advance_vector(iovec **vecs, size_t *count, size_t bytes_done) {
     // Note: if somehow the read/write call returns a result unaligned with 
     // DEVICE_BLOCK_SIZE, there will probably be an error when we try again with the
     // advanced vector.
@@ -72,27 +77,22 @@ size_t pool_diskmgr_t::action_t::advance_vector(iovec **vecs,
     return bytes_done;
 }
 
-ssize_t pool_diskmgr_t::action_t::vectored_read_write(iovec *vecs,
-                                                      size_t vecs_len,
-                                                      int64_t partial_offset) {
-    int64_t real_offset = offset + partial_offset;
+static ssize_t vectored_read_write(bool is_read, fd_t fd, int64_t offset,
+                                   iovec *vecs, size_t vecs_len) {
 #ifndef USE_WRITEV
 #error "USE_WRITEV not defined.  Did you include pool.hpp?"
 #elif USE_WRITEV
     size_t vecs_to_use = std::min<size_t>(vecs_len, IOV_MAX);
-    if (type == ACTION_READ) {
-        return preadv(fd, vecs, vecs_to_use, real_offset);
+    if (is_read) {
+        return preadv(fd, vecs, vecs_to_use, offset);
     }
-    rassert(type == ACTION_WRITE);
-    return pwritev(fd, vecs, vecs_to_use, real_offset);
+    return pwritev(fd, vecs, vecs_to_use, offset);
 #else
     guarantee(vecs_len == 1);
-    guarantee(partial_offset == 0);
-    if (type == ACTION_READ) {
-        return pread(fd, vecs[0].iov_base, vecs[0].iov_len, real_offset);
+    if (is_read) {
+        return pread(fd, vecs[0].iov_base, vecs[0].iov_len, offset);
     }
-    rassert(type == ACTION_WRITE);
-    return pwrite(fd, vecs[0].iov_base, vecs[0].iov_len, real_offset);
+    return pwrite(fd, vecs[0].iov_base, vecs[0].iov_len, offset);
 #endif
 }
 
@@ -107,8 +107,9 @@ void pool_diskmgr_t::action_t::copy_vectors(scoped_array_t<iovec> *vectors_out)
     }
 }
 
-int64_t pool_diskmgr_t::action_t::perform_read_write(iovec *vecs,
-                                                     size_t vecs_len) {
+// Returns the number of bytes transferred, or a negated errno value.
+static int64_t perform_read_write(bool is_read, fd_t fd, int64_t offset,
+                                  iovec *vecs, size_t vecs_len) {
     ssize_t res = 0;
     int64_t partial_offset = 0;
 
@@ -119,12 +120,13 @@ int64_t pool_diskmgr_t::action_t::perform_read_write(iovec *vecs,
 
     while (vecs_len > 0 && partial_offset < total_bytes) {
         do {
-            res = vectored_read_write(vecs, vecs_len, partial_offset);
+            res = vectored_read_write(is_read, fd, offset + partial_offset,
+                                      vecs, vecs_len);
         } while (res == -1 && get_errno() == EINTR);
 
         if (res == -1) {
             return -get_errno();
-        } else if (res == 0 && type == ACTION_WRITE) {
+        } else if (res == 0 && !is_read) {
             // This happens when running out of disk space.
             // The errno in that case is 0 and doesn't tell us about the
             // real reason for the failed i/o.
@@ -143,7 +145,7 @@ int64_t pool_diskmgr_t::action_t::perform_read_write(iovec *vecs,
 }
 
 void pool_diskmgr_t::action_t::run() {
-    if (wrap_in_datasyncs) {
+    if (datasync_before) {
         int errcode = perform_datasync(fd);
         if (errcode != 0) {
             io_result = -errcode;
@@ -170,13 +172,14 @@ void pool_diskmgr_t::action_t::run() {
         // Copy the io vectors because perform_read_write will modify them
         scoped_array_t<iovec> vectors;
         copy_vectors(&vectors);
-        io_result = perform_read_write(vectors.data(), vectors.size());
+        io_result = perform_read_write(type == ACTION_READ, fd, offset,
+                                       vectors.data(), vectors.size());
     } break;
     default:
         unreachable("Unknown I/O action");
     }
 
-    if (wrap_in_datasyncs) {
+    if (datasync_after) {
         int errcode = perform_datasync(fd);
         if (errcode != 0) {
             io_result = -errcode;
@@ -192,6 +195,72 @@ void pool_diskmgr_action_t::done() {
     parent->done_fun(this);
 }
 
+void pool_diskmgr_action_t::on_uring_complete(int64_t result) {
+    io_result = result;
+    done();
+}
+
+/* Reads (or writes) of adjacent parts of a file that are sent to the OS as one. */
+struct pool_diskmgr_merged_action_t
+    : private blocker_pool_t::job_t,
+      private io_uring_t::request_t {
+    explicit pool_diskmgr_merged_action_t(std::vector<pool_diskmgr_action_t *> &&_actions)
+        : actions(std::move(_actions)), total_count(0) {
+        size_t num_vecs = 0;
+        for (pool_diskmgr_action_t *a : actions) {
+            iovec *vecs;
+            size_t count;
+            a->get_bufs(&vecs, &count);
+            num_vecs += count;
+            total_count += a->get_count();
+        }
+        iovecs.init(num_vecs);
+        size_t i = 0;
+        for (pool_diskmgr_action_t *a : actions) {
+            iovec *vecs;
+            size_t count;
+            a->get_bufs(&vecs, &count);
+            std::copy(vecs, vecs + count, iovecs.data() + i);
+            i += count;
+        }
+    }
+
+private:
+    friend class pool_diskmgr_t;
+
+    void run() {
+        // `perform_read_write()` modifies the io vectors, but we won't need them again.
+        io_result = perform_read_write(actions.front()->get_is_read(),
+                                       actions.front()->get_fd(),
+                                       actions.front()->get_offset(),
+                                       iovecs.data(), iovecs.size());
+    }
+
+    void done() {
+        for (pool_diskmgr_action_t *a : actions) {
+            if (io_result == static_cast<int64_t>(total_count)) {
+                a->io_result = a->get_count();
+            } else {
+                a->io_result = io_result < 0 ? io_result : -EIO;
+            }
+            a->done();
+        }
+        delete this;
+    }
+
+    void on_uring_complete(int64_t result) {
+        io_result = result;
+        done();
+    }
+
+    std::vector<pool_diskmgr_action_t *> actions;
+    scoped_array_t<iovec> iovecs;
+    size_t total_count;
+    int64_t io_result;
+
+    DISABLE_COPYING(pool_diskmgr_merged_action_t);
+};
+
 void pool_diskmgr_t::on_source_availability_changed() {
     assert_thread();
     /* This is called when the queue used to be empty but now has requests on
@@ -199,13 +268,80 @@ void pool_diskmgr_t::on_source_availability_changed() {
     if (source->available->get()) pump();
 }
 
+template <class request_t>
+bool pool_diskmgr_t::dispatch(request_t *request, fd_t fd, bool is_read,
+                              iovec *vecs, size_t count, int64_t offset) {
+    if (uring.has() && uring->has_capacity()) {
+        if (is_read) {
+            uring->prepare_readv(fd, vecs, count, offset, request);
+        } else {
+            uring->prepare_writev(fd, vecs, count, offset, request);
+        }
+        return true;
+    }
+    blocker_pool.do_job(request);
+    return false;
+}
+
 void pool_diskmgr_t::pump() {
     assert_thread();
+    std::vector<action_t *> batch;
     while (source->available->get() && n_pending < queue_depth) {
         action_t *a = source->pop();
         a->parent = this;
         n_pending++;
-        blocker_pool.do_job(a);
+        batch.push_back(a);
+    }
+
+    // The conflict resolver above us never lets conflicting requests be in flight at
+    // the same time, so we can reorder the ones we took.
+    std::stable_sort(batch.begin(), batch.end(),
+        [](const action_t *a, const action_t *b) {
+            return a->fd != b->fd ? a->fd < b->fd : a->offset < b->offset;
+        });
+
+    bool prepared_uring_requests = false;
+    for (size_t i = 0; i < batch.size();) {
+        action_t *a = batch[i];
+        iovec *vecs;
+        size_t count;
+        a->get_bufs(&vecs, &count);
+        size_t end = i + 1;
+        size_t total_vecs = count;
+        int64_t total_bytes = a->get_count();
+        while (end < batch.size() && batch[end - 1]->can_merge_with(batch[end])) {
+            iovec *next_vecs;
+            size_t next_count;
+            batch[end]->get_bufs(&next_vecs, &next_count);
+            if (total_vecs + next_count > IOV_MAX
+                || total_bytes + static_cast<int64_t>(batch[end]->get_count())
+                   > MAX_MERGED_IO_SIZE) {
+                break;
+            }
+            total_vecs += next_count;
+            total_bytes += batch[end]->get_count();
+            ++end;
+        }
+
+        if (end == i + 1) {
+            if (a->can_use_uring()) {
+                prepared_uring_requests |=
+                    dispatch(a, a->fd, a->get_is_read(), vecs, count, a->offset);
+            } else {
+                blocker_pool.do_job(a);
+            }
+        } else {
+            pool_diskmgr_merged_action_t *merged = new pool_diskmgr_merged_action_t(
+                std::vector<action_t *>(batch.begin() + i, batch.begin() + end));
+            prepared_uring_requests |=
+                dispatch(merged, a->fd, a->get_is_read(), merged->iovecs.data(),
+                         merged->iovecs.size(), a->offset);
+        }
+        i = end;
+    }
+    if (prepared_uring_requests) {
+        // Everything we popped in this round goes to the kernel in one syscall.
+        uring->submit();
     }
 }
 
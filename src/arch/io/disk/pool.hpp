@@ -9,6 +9,8 @@
 
 #include "arch/runtime/event_queue.hpp"
 #include "arch/io/blocker_pool.hpp"
+#include "arch/io/disk/uring.hpp"
+#include "arch/types.hpp"
 #include "concurrency/queue/passive_producer.hpp"
 #include "containers/scoped.hpp"
 
@@ -20,19 +22,27 @@
 
 struct iovec;
 class pool_diskmgr_t;
+struct pool_diskmgr_merged_action_t;
 class printf_buffer_t;
 
 /* The pool disk manager uses a thread pool in conjunction with synchronous
-(blocking) IO calls to asynchronously run IO requests. */
+(blocking) IO calls to asynchronously run IO requests.  If io_uring is enabled, plain
+reads and writes are instead submitted in batches through an `io_uring_t`, and only
+resizes and datasync-wrapped writes still go to the thread pool.
+
+Each time it takes requests from its source, it sorts them by file and offset, and
+sends reads (or writes) of adjacent parts of a file to the OS as a single request. */
 
 struct pool_diskmgr_action_t
-    : private blocker_pool_t::job_t {
+    : private blocker_pool_t::job_t,
+      private io_uring_t::request_t {
     pool_diskmgr_action_t() { }
 
     void make_write(fd_t _fd, const void *_buf, size_t _count, int64_t _offset,
-                    bool _wrap_in_datasyncs) {
+                    bool _datasync_before, bool _datasync_after) {
         type = ACTION_WRITE;
-        wrap_in_datasyncs = _wrap_in_datasyncs;
+        datasync_before = _datasync_before;
+        datasync_after = _datasync_after;
         fd = _fd;
         buf_and_count.iov_base = const_cast<void *>(_buf);
         buf_and_count.iov_len = _count;
@@ -42,7 +52,8 @@ struct pool_diskmgr_action_t
     void make_resize(fd_t _fd, int64_t _new_size,
                     bool _wrap_in_datasyncs) {
         type = ACTION_RESIZE;
-        wrap_in_datasyncs = _wrap_in_datasyncs;
+        datasync_before = _wrap_in_datasyncs;
+        datasync_after = _wrap_in_datasyncs;
         fd = _fd;
         buf_and_count.iov_base = NULL;
         buf_and_count.iov_len = 0;
@@ -54,7 +65,8 @@ struct pool_diskmgr_action_t
 #elif USE_WRITEV
     void make_writev(fd_t _fd, scoped_array_t<iovec> &&_bufs, size_t _count, int64_t _offset) {
         type = ACTION_WRITE;
-        wrap_in_datasyncs = false;
+        datasync_before = false;
+        datasync_after = false;
         fd = _fd;
         iovecs = std::move(_bufs);
         buf_and_count.iov_base = NULL;
@@ -65,7 +77,8 @@ struct pool_diskmgr_action_t
 
     void make_read(fd_t _fd, void *_buf, size_t _count, int64_t _offset) {
         type = ACTION_READ;
-        wrap_in_datasyncs = false;
+        datasync_before = false;
+        datasync_after = false;
         fd = _fd;
         buf_and_count.iov_base = _buf;
         buf_and_count.iov_len = _count;
@@ -97,11 +110,13 @@ struct pool_diskmgr_action_t
 
 private:
     friend class pool_diskmgr_t;
+    friend struct pool_diskmgr_merged_action_t;
     pool_diskmgr_t *parent;
 
     enum action_type_t {ACTION_READ, ACTION_WRITE, ACTION_RESIZE};
     action_type_t type;
-    bool wrap_in_datasyncs;
+    bool datasync_before;
+    bool datasync_after;
     fd_t fd;
 
     // Either type is ACTION_RESIZE, or buf_and_count.iov_base is used, or iovecs
@@ -112,16 +127,24 @@ private:
     iovec buf_and_count;
     int64_t offset;
 
-    // Helper functions for vectored reads/writes
-    static size_t advance_vector(iovec **vecs, size_t *count, size_t bytes_done);
-    ssize_t vectored_read_write(iovec *vecs, size_t vecs_len, int64_t partial_offset);
     void copy_vectors(scoped_array_t<iovec> *vectors_out);
-    int64_t perform_read_write(iovec *vecs, size_t count);
 
     int64_t io_result;
 
+    // Whether this action can be run through io_uring, or merged with others.
+    bool can_use_uring() const {
+        return type != ACTION_RESIZE && !datasync_before && !datasync_after;
+    }
+
+    // Whether `next` reads (or writes) the part of the file right after this one.
+    bool can_merge_with(const pool_diskmgr_action_t *next) const {
+        return can_use_uring() && next->can_use_uring() && type == next->type
+            && fd == next->fd && offset + static_cast<int64_t>(get_count()) == next->offset;
+    }
+
     void run();
     void done();
+    void on_uring_complete(int64_t result);
 
     DISABLE_COPYING(pool_diskmgr_action_t);
 };
@@ -132,12 +155,13 @@ void debug_print(printf_buffer_t *buf,
 class pool_diskmgr_t : private availability_callback_t, public home_thread_mixin_debug_only_t {
 public:
     friend struct pool_diskmgr_action_t;
+    friend struct pool_diskmgr_merged_action_t;
     typedef pool_diskmgr_action_t action_t;
 
     /* The `pool_diskmgr_t` will draw actions to run from `source`. It will call `done_fun`
     on each one when it's done. */
     pool_diskmgr_t(linux_event_queue_t *queue, passive_producer_t<action_t *> *source,
-                   int max_concurrent_io_requests);
+                   int max_concurrent_io_requests, io_backend_mode_t backend_mode);
     std::function<void(action_t *)> done_fun;
     ~pool_diskmgr_t();
 
@@ -145,11 +169,19 @@ private:
     const int queue_depth;
     passive_producer_t<action_t *> *source;
     blocker_pool_t blocker_pool;
+    // Empty unless io_uring was requested and is supported by the kernel.
+    scoped_ptr_t<io_uring_t> uring;
 
     void on_source_availability_changed();
     int n_pending;
     void pump();
 
+    // Sends a request to io_uring if we can, and to the thread pool otherwise.
+    // Returns true if it was prepared on the io_uring.
+    template <class request_t>
+    bool dispatch(request_t *request, fd_t fd, bool is_read, iovec *vecs, size_t count,
+                  int64_t offset);
+
     DISABLE_COPYING(pool_diskmgr_t);
 };
 
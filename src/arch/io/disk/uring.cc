@@ -0,0 +1,351 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/io/disk/uring.hpp"
+
+#include <inttypes.h>
+#include <limits.h>
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "logger.hpp"
+#include "utils.hpp"
+
+#if USE_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// glibc doesn't provide wrappers for the io_uring syscalls either.
+static int sys_io_uring_setup(unsigned int entries, io_uring_params *params) {
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int ring_fd, unsigned int to_submit) {
+    return syscall(__NR_io_uring_enter, ring_fd, to_submit, 0, 0, NULL, 0);
+}
+
+static int sys_io_uring_register(int ring_fd, unsigned int opcode, void *arg,
+                                 unsigned int nr_args) {
+    return syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+// There's no point in a ring bigger than this, since the disk stack above us
+// limits the number of outstanding requests anyway.
+static const int MAX_IO_URING_ENTRIES = 4096;
+
+struct io_uring_t::op_t {
+    request_t *request;
+    bool is_write;
+    fd_t fd;
+    // Our own copy of the iovecs, which gets advanced on short reads and writes.
+    scoped_array_t<iovec> vecs;
+    size_t first_vec;
+    int64_t offset;
+    int64_t done;
+    int64_t total;
+};
+
+io_uring_t::io_uring_t(linux_event_queue_t *queue)
+    : queue_(queue),
+      watching_(false),
+      max_in_flight_(0),
+      in_flight_(0),
+      sq_ring_(MAP_FAILED),
+      sq_ring_size_(0),
+      cq_ring_(MAP_FAILED),
+      cq_ring_size_(0),
+      sqes_(MAP_FAILED),
+      sqes_size_(0),
+      to_submit_(0) { }
+
+scoped_ptr_t<io_uring_t> io_uring_t::create(linux_event_queue_t *queue,
+                                            int max_in_flight) {
+    scoped_ptr_t<io_uring_t> ring(new io_uring_t(queue));
+    if (!ring->init(max_in_flight)) {
+        ring.reset();
+    }
+    return ring;
+}
+
+bool io_uring_t::init(int max_in_flight) {
+    guarantee(max_in_flight > 0);
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    const unsigned int entries = std::min(max_in_flight, MAX_IO_URING_ENTRIES);
+    int res = sys_io_uring_setup(entries, &params);
+    if (res == -1) {
+        logWRN("Could not set up io_uring (%s).  Falling back to the thread pool "
+               "for disk I/O.", errno_string(get_errno()).c_str());
+        return false;
+    }
+    ring_fd_.reset(res);
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = mmap(NULL, sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_.get(), IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        logWRN("Could not map the io_uring submission queue (%s).  Falling back to "
+               "the thread pool for disk I/O.", errno_string(get_errno()).c_str());
+        return false;
+    }
+    if (!single_mmap) {
+        cq_ring_ = mmap(NULL, cq_ring_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd_.get(), IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            logWRN("Could not map the io_uring completion queue (%s).  Falling back "
+                   "to the thread pool for disk I/O.",
+                   errno_string(get_errno()).c_str());
+            return false;
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ring_fd_.get(), IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) {
+        logWRN("Could not map the io_uring submission entries (%s).  Falling back "
+               "to the thread pool for disk I/O.", errno_string(get_errno()).c_str());
+        return false;
+    }
+
+    char *sq = static_cast<char *>(sq_ring_);
+    char *cq = static_cast<char *>(single_mmap ? sq_ring_ : cq_ring_);
+    sq_head_ = reinterpret_cast<unsigned int *>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned int *>(sq + params.sq_off.tail);
+    sq_ring_mask_ = reinterpret_cast<unsigned int *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned int *>(sq + params.sq_off.array);
+    cq_head_ = reinterpret_cast<unsigned int *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned int *>(cq + params.cq_off.tail);
+    cq_ring_mask_ = reinterpret_cast<unsigned int *>(cq + params.cq_off.ring_mask);
+    cqes_ = cq + params.cq_off.cqes;
+
+    int event_fd = completion_event_.get_notify_fd();
+    res = sys_io_uring_register(ring_fd_.get(), IORING_REGISTER_EVENTFD, &event_fd, 1);
+    if (res == -1) {
+        logWRN("Could not register an eventfd with io_uring (%s).  Falling back to "
+               "the thread pool for disk I/O.", errno_string(get_errno()).c_str());
+        return false;
+    }
+
+    // The completion queue is at least as big as the submission queue, so it
+    // can't overflow as long as we don't have more requests in flight than that.
+    max_in_flight_ = params.sq_entries;
+
+    queue_->watch_resource(completion_event_.get_notify_fd(), poll_event_in, this);
+    watching_ = true;
+    return true;
+}
+
+io_uring_t::~io_uring_t() {
+    guarantee(in_flight_ == 0, "Destroying an io_uring_t with requests in flight.");
+    if (watching_) {
+        queue_->forget_resource(completion_event_.get_notify_fd(), this);
+    }
+    if (sqes_ != MAP_FAILED) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ != MAP_FAILED) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != MAP_FAILED) {
+        munmap(sq_ring_, sq_ring_size_);
+    }
+}
+
+bool io_uring_t::has_capacity() const {
+    return in_flight_ < max_in_flight_;
+}
+
+void io_uring_t::prepare_readv(fd_t fd, const iovec *vecs, size_t count,
+                               int64_t offset, request_t *request) {
+    prepare(false, fd, vecs, count, offset, request);
+}
+
+void io_uring_t::prepare_writev(fd_t fd, const iovec *vecs, size_t count,
+                                int64_t offset, request_t *request) {
+    prepare(true, fd, vecs, count, offset, request);
+}
+
+void io_uring_t::prepare(bool is_write, fd_t fd, const iovec *vecs, size_t count,
+                         int64_t offset, request_t *request) {
+    guarantee(has_capacity());
+    op_t *op = new op_t;
+    op->request = request;
+    op->is_write = is_write;
+    op->fd = fd;
+    op->vecs.init(count);
+    op->first_vec = 0;
+    op->offset = offset;
+    op->done = 0;
+    op->total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        op->vecs[i] = vecs[i];
+        op->total += vecs[i].iov_len;
+    }
+    ++in_flight_;
+    push_sqe(op);
+}
+
+void io_uring_t::push_sqe(op_t *op) {
+    const unsigned int tail = *sq_tail_;
+    const unsigned int index = tail & *sq_ring_mask_;
+    io_uring_sqe *sqe = static_cast<io_uring_sqe *>(sqes_) + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = op->is_write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = op->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(op->vecs.data() + op->first_vec);
+    sqe->len = std::min<size_t>(op->vecs.size() - op->first_vec, IOV_MAX);
+    sqe->off = op->offset + op->done;
+    sqe->user_data = reinterpret_cast<uint64_t>(op);
+    sq_array_[index] = index;
+    // The kernel must see the entry before it sees the new tail.
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    ++to_submit_;
+}
+
+void io_uring_t::submit() {
+    while (to_submit_ > 0) {
+        int res = sys_io_uring_enter(ring_fd_.get(), to_submit_);
+        if (res == -1) {
+            const int err = get_errno();
+            if (err == EINTR) {
+                continue;
+            }
+            guarantee_err(err == EAGAIN || err == EBUSY, "io_uring_enter failed");
+            // The kernel is temporarily out of resources (`EAGAIN`) or won't take
+            // more requests until we make room on the completion ring (`EBUSY`).
+            // Taking the completions off the ring helps with both; they get
+            // handled in `on_event()`, since the kernel has signalled the eventfd
+            // for them.
+            const size_t reaped = reap_completions();
+            const size_t in_kernel = in_flight_ - to_submit_ - reaped_.size();
+            if (reaped == 0 && in_kernel > 0) {
+                // We have to wait for a request to complete.  `on_event()` sends
+                // off the rest afterwards.
+                return;
+            }
+            continue;
+        }
+        guarantee(static_cast<unsigned int>(res) <= to_submit_);
+        to_submit_ -= res;
+    }
+}
+
+size_t io_uring_t::reap_completions() {
+    unsigned int head = *cq_head_;
+    const unsigned int tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    reaped_.reserve(reaped_.size() + (tail - head));
+    for (; head != tail; ++head) {
+        const io_uring_cqe *cqe =
+            static_cast<const io_uring_cqe *>(cqes_) + (head & *cq_ring_mask_);
+        reaped_.push_back(std::make_pair(reinterpret_cast<op_t *>(cqe->user_data),
+                                         cqe->res));
+    }
+    const size_t count = head - *cq_head_;
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+void io_uring_t::on_event(DEBUG_VAR int events) {
+    rassert(events == poll_event_in);
+    completion_event_.consume_wakey_wakeys();
+
+    // We first pop all available completions off the ring, because handling them
+    // can cause new requests to be prepared (and thus reenter this object).
+    reap_completions();
+    std::vector<std::pair<op_t *, int32_t> > completed;
+    completed.swap(reaped_);
+
+    for (auto it = completed.begin(); it != completed.end(); ++it) {
+        on_cqe(it->first, it->second);
+    }
+
+    // Send off any requests that were retried or prepared by the callbacks.
+    submit();
+}
+
+void io_uring_t::on_cqe(op_t *op, int32_t res) {
+    if (res == -EINTR || res == -EAGAIN) {
+        push_sqe(op);
+        return;
+    }
+
+    int64_t result;
+    if (res < 0) {
+        result = res;
+    } else if (res == 0 && op->done < op->total) {
+        if (op->is_write) {
+            // See the corresponding comment in `pool.cc`.
+            logERR("Failed I/O: vectored write of %" PRIi64 " bytes stopped after "
+                   "%" PRIi64 " bytes. Assuming we ran out of disk space.",
+                   op->total, op->done);
+            result = -ENOSPC;
+        } else {
+            // We never read past the end of the file on purpose.
+            result = -EIO;
+        }
+    } else {
+        op->done += res;
+        size_t to_advance = res;
+        while (to_advance > 0) {
+            rassert(op->first_vec < op->vecs.size());
+            iovec *vec = &op->vecs[op->first_vec];
+            const size_t cur = std::min(vec->iov_len, to_advance);
+            vec->iov_base = static_cast<char *>(vec->iov_base) + cur;
+            vec->iov_len -= cur;
+            to_advance -= cur;
+            while (op->first_vec < op->vecs.size()
+                   && op->vecs[op->first_vec].iov_len == 0) {
+                ++op->first_vec;
+            }
+        }
+        if (op->done < op->total) {
+            // Short read or write, send the rest.
+            push_sqe(op);
+            return;
+        }
+        result = op->total;
+    }
+
+    --in_flight_;
+    request_t *request = op->request;
+    delete op;
+    request->on_uring_complete(result);
+}
+
+#else  // USE_IO_URING
+
+scoped_ptr_t<io_uring_t> io_uring_t::create(linux_event_queue_t *, int) {
+    logWRN("This build does not support io_uring.  Using the thread pool for disk "
+           "I/O.");
+    return scoped_ptr_t<io_uring_t>();
+}
+
+io_uring_t::~io_uring_t() { }
+
+void io_uring_t::prepare_readv(fd_t, const iovec *, size_t, int64_t, request_t *) {
+    unreachable();
+}
+
+void io_uring_t::prepare_writev(fd_t, const iovec *, size_t, int64_t, request_t *) {
+    unreachable();
+}
+
+void io_uring_t::submit() {
+    unreachable();
+}
+
+bool io_uring_t::has_capacity() const {
+    return false;
+}
+
+#endif  // USE_IO_URING
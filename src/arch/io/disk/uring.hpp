@@ -0,0 +1,126 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_DISK_URING_HPP_
+#define ARCH_IO_DISK_URING_HPP_
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include <utility>
+#include <vector>
+
+#include "arch/io/io_utils.hpp"
+#include "arch/runtime/event_queue.hpp"
+#include "containers/scoped.hpp"
+
+#if defined(__linux) && !defined(NO_EVENTFD) && !defined(LEGACY_LINUX) \
+    && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define USE_IO_URING 1
+#endif
+#endif
+#ifndef USE_IO_URING
+#define USE_IO_URING 0
+#endif
+
+#if USE_IO_URING
+#include "arch/runtime/system_event/eventfd_event.hpp"
+#endif
+
+/* `io_uring_t` hands reads and writes to the kernel through an io_uring submission
+queue, instead of running blocking syscalls on `blocker_pool_t` threads.  Requests
+are queued with `prepare_*()` and sent to the kernel in one batch by `submit()`.
+The kernel pings an eventfd that is watched by the event queue when requests have
+completed, so completions are delivered on the thread that owns the `io_uring_t`.
+
+Short reads and writes are resubmitted internally, so a request's
+`on_uring_complete()` only gets called once the whole transfer has been done (or
+has failed). */
+
+class io_uring_t
+#if USE_IO_URING
+    : private linux_event_callback_t
+#endif
+{
+public:
+    class request_t {
+    public:
+        /* Called on the `io_uring_t`'s thread with the total number of bytes
+        transferred, or with a negated errno value. */
+        virtual void on_uring_complete(int64_t result) = 0;
+    protected:
+        virtual ~request_t() { }
+    };
+
+    /* Sets up an io_uring that can hold `max_in_flight` requests at a time.
+    Returns an empty pointer (after logging why) if the kernel doesn't support
+    io_uring, in which case the caller should fall back to the blocker pool. */
+    static scoped_ptr_t<io_uring_t> create(linux_event_queue_t *queue,
+                                           int max_in_flight);
+
+    ~io_uring_t();
+
+    /* The iovecs are copied, but the buffers they point to must stay valid until
+    `request->on_uring_complete()` has been called. */
+    void prepare_readv(fd_t fd, const iovec *vecs, size_t count, int64_t offset,
+                       request_t *request);
+    void prepare_writev(fd_t fd, const iovec *vecs, size_t count, int64_t offset,
+                        request_t *request);
+
+    // Sends all prepared requests to the kernel with a single syscall.
+    void submit();
+
+    // Whether another request can be prepared without exceeding the ring size.
+    bool has_capacity() const;
+
+private:
+#if USE_IO_URING
+    struct op_t;
+
+    explicit io_uring_t(linux_event_queue_t *queue);
+    // Returns false (after logging why) if the ring could not be set up.
+    bool init(int max_in_flight);
+
+    void prepare(bool is_write, fd_t fd, const iovec *vecs, size_t count,
+                 int64_t offset, request_t *request);
+    void push_sqe(op_t *op);
+    // Moves the completions off the completion ring into `reaped_`, and returns
+    // how many there were.
+    size_t reap_completions();
+    void on_event(int events);
+    void on_cqe(op_t *op, int32_t res);
+
+    linux_event_queue_t *const queue_;
+    bool watching_;
+    int max_in_flight_;
+    int in_flight_;
+    scoped_fd_t ring_fd_;
+    eventfd_event_t completion_event_;
+
+    // The mmapped rings, and pointers into them.
+    void *sq_ring_;
+    size_t sq_ring_size_;
+    void *cq_ring_;
+    size_t cq_ring_size_;
+    void *sqes_;
+    size_t sqes_size_;
+
+    unsigned int *sq_head_;
+    unsigned int *sq_tail_;
+    unsigned int *sq_ring_mask_;
+    unsigned int *sq_array_;
+    unsigned int *cq_head_;
+    unsigned int *cq_tail_;
+    unsigned int *cq_ring_mask_;
+    void *cqes_;
+
+    // SQEs that have been written but not yet passed to `io_uring_enter`.
+    unsigned int to_submit_;
+
+    // Completions that have been taken off the ring, but not handled yet.
+    std::vector<std::pair<op_t *, int32_t> > reaped_;
+#endif  // USE_IO_URING
+
+    DISABLE_COPYING(io_uring_t);
+};
+
+#endif  // ARCH_IO_DISK_URING_HPP_
@@ -4,6 +4,7 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/tcp.h>
@@ -11,10 +12,15 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include <exception>
 
 #include "utils.hpp"
 #include <boost/bind.hpp>
 
+#include "arch/io/tls.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "arch/timing.hpp"
@@ -160,6 +166,164 @@ linux_tcp_conn_t::linux_tcp_conn_t(fd_t s) :
     guarantee_err(res == 0, "Could not make socket non-blocking");
 }
 
+class linux_tcp_conn_t::tls_state_t {
+public:
+    explicit tls_state_t(SSL *_ssl) : ssl(_ssl) { }
+    ~tls_state_t() {
+        SSL_free(ssl);
+    }
+
+    SSL *const ssl;
+
+    /* For client connections, the address we remember the session under */
+    std::string peer;
+
+private:
+    DISABLE_COPYING(tls_state_t);
+};
+
+void linux_tcp_conn_t::enable_tls(tls_ctx_t *ctx, signal_t *interruptor) THROWS_ONLY(tls_failed_exc_t, interrupted_exc_t) {
+    assert_thread();
+    rassert(!tls.has());
+    rassert(!read_in_progress && !write_in_progress);
+
+    ERR_clear_error();
+    SSL *ssl = SSL_new(ctx->get());
+    if (ssl == NULL) {
+        throw tls_failed_exc_t(tls_error_string());
+    }
+    tls.init(new tls_state_t(ssl));
+    if (SSL_set_fd(ssl, sock.get()) != 1) {
+        throw tls_failed_exc_t(tls_error_string());
+    }
+
+    if (ctx->get_role() == tls_role_t::CLIENT) {
+        ip_and_port_t peer;
+        if (getpeername(&peer)) {
+            tls->peer = peer.to_string();
+            SSL_set_app_data(ssl, &tls->peer);
+            if (SSL_SESSION *session = ctx->get_session(tls->peer)) {
+                SSL_set_session(ssl, session);
+                SSL_SESSION_free(session);
+            }
+        }
+        SSL_set_connect_state(ssl);
+    } else {
+        SSL_set_accept_state(ssl);
+    }
+
+    while (true) {
+        ERR_clear_error();
+        int res = SSL_do_handshake(ssl);
+        if (res == 1) {
+            return;
+        }
+        int ssl_error = SSL_get_error(ssl, res);
+        if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE) {
+            linux_event_watcher_t::watch_t watch(event_watcher.get(),
+                ssl_error == SSL_ERROR_WANT_READ ? poll_event_in : poll_event_out);
+            wait_interruptible(&watch, interruptor);
+        } else if (ssl_error == SSL_ERROR_SYSCALL && ERR_peek_error() == 0) {
+            throw tls_failed_exc_t(res == 0
+                ? std::string("the peer closed the connection")
+                : errno_string(get_errno()));
+        } else {
+            throw tls_failed_exc_t(tls_error_string());
+        }
+    }
+}
+
+bool linux_tcp_conn_t::wait_for_tls(int ssl_error, int own_event, const cond_t *closed) {
+    const int event = (ssl_error == SSL_ERROR_WANT_READ) ? poll_event_in : poll_event_out;
+    if (event == own_event) {
+        linux_event_watcher_t::watch_t watch(event_watcher.get(), event);
+        wait_any_t waiter(&watch, closed);
+        waiter.wait_lazily_unordered();
+    } else {
+        /* OpenSSL needs the socket to be ready in the other direction, which that
+        direction's coroutine may be watching for already. This only happens when TLS
+        protocol messages have to go the other way, so we just poll. */
+        signal_timer_t timer(1);
+        wait_any_t waiter(&timer, closed);
+        waiter.wait_lazily_unordered();
+    }
+    return !closed->is_pulsed();
+}
+
+size_t linux_tcp_conn_t::tls_read_internal(void *buffer, size_t size) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
+    while (true) {
+        ERR_clear_error();
+        int res = SSL_read(tls->ssl, buffer, std::min<size_t>(size, INT_MAX));
+        if (res > 0) {
+            return res;
+        }
+
+        int ssl_error = SSL_get_error(tls->ssl, res);
+        if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE) {
+            if (!wait_for_tls(ssl_error, poll_event_in, &read_closed)) {
+                /* Whatever closed us has already called on_shutdown_read(). */
+                throw tcp_conn_read_closed_exc_t();
+            }
+        } else if (ssl_error == SSL_ERROR_ZERO_RETURN
+                   || (ssl_error == SSL_ERROR_SYSCALL && ERR_peek_error() == 0)) {
+            /* The peer closed the connection (or reset it). */
+            on_shutdown_read();
+            throw tcp_conn_read_closed_exc_t();
+        } else {
+            logERR("Could not read from TLS connection: %s", tls_error_string().c_str());
+            on_shutdown_read();
+            throw tcp_conn_read_closed_exc_t();
+        }
+    }
+}
+
+void linux_tcp_conn_t::perform_tls_write_vectored(const iovec *iov, size_t iovcnt) {
+    /* OpenSSL has no vectored write, and writing the buffers one by one would send a
+    TLS record for each of them. Encryption copies the data anyway, so we gather it
+    into one buffer first. */
+    std::vector<char> gathered;
+    const char *data;
+    size_t size;
+    if (iovcnt == 1) {
+        data = static_cast<const char *>(iov[0].iov_base);
+        size = iov[0].iov_len;
+    } else {
+        for (size_t i = 0; i < iovcnt; ++i) {
+            const char *base = static_cast<const char *>(iov[i].iov_base);
+            gathered.insert(gathered.end(), base, base + iov[i].iov_len);
+        }
+        data = gathered.data();
+        size = gathered.size();
+    }
+
+    while (size > 0) {
+        ERR_clear_error();
+        int res = SSL_write(tls->ssl, data, std::min<size_t>(size, INT_MAX));
+        if (res > 0) {
+            if (write_perfmon) write_perfmon->record(res);
+            data += res;
+            size -= res;
+            continue;
+        }
+
+        int ssl_error = SSL_get_error(tls->ssl, res);
+        if (ssl_error == SSL_ERROR_WANT_READ || ssl_error == SSL_ERROR_WANT_WRITE) {
+            if (!wait_for_tls(ssl_error, poll_event_out, &write_closed)) {
+                /* Whatever closed us has already called on_shutdown_write(). */
+                break;
+            }
+        } else if (ssl_error == SSL_ERROR_ZERO_RETURN
+                   || (ssl_error == SSL_ERROR_SYSCALL && ERR_peek_error() == 0)) {
+            on_shutdown_write();
+            break;
+        } else {
+            logERR("Could not write to TLS connection: %s", tls_error_string().c_str());
+            on_shutdown_write();
+            break;
+        }
+    }
+}
+
 void linux_tcp_conn_t::enable_keepalive() {
     int optval = 1;
     int res = setsockopt(sock.get(), SOL_SOCKET, SO_KEEPALIVE, &optval, sizeof(optval));
@@ -204,6 +368,10 @@ size_t linux_tcp_conn_t::read_internal(void *buffer, size_t size) THROWS_ONLY(tc
     assert_thread();
     rassert(!read_closed.is_pulsed());
 
+    if (tls.has()) {
+        return tls_read_internal(buffer, size);
+    }
+
     while (true) {
         ssize_t res = ::read(sock.get(), buffer, size);
 
@@ -337,7 +505,9 @@ linux_tcp_conn_t::write_handler_t::write_handler_t(linux_tcp_conn_t *_parent) :
 { }
 
 void linux_tcp_conn_t::write_handler_t::coro_pool_callback(write_queue_op_t *operation, UNUSED signal_t *interruptor) {
-    if (operation->buffer != NULL) {
+    if (operation->iov != NULL) {
+        parent->perform_write_vectored(operation->iov, operation->iovcnt);
+    } else if (operation->buffer != NULL) {
         parent->perform_write(operation->buffer, operation->size);
         if (operation->dealloc != NULL) {
             parent->release_write_buffer(operation->dealloc);
@@ -362,6 +532,8 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
     released once the write is over. */
     op->buffer = current_write_buffer->buffer;
     op->size = current_write_buffer->size;
+    op->iov = NULL;
+    op->iovcnt = 0;
     op->dealloc = current_write_buffer.release();
     op->cond = NULL;
     op->keepalive = auto_drainer_t::lock_t(drainer.get());
@@ -377,6 +549,13 @@ void linux_tcp_conn_t::internal_flush_write_buffer() {
 }
 
 void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
+    iovec iov;
+    iov.iov_base = const_cast<void *>(buf);
+    iov.iov_len = size;
+    perform_write_vectored(&iov, 1);
+}
+
+void linux_tcp_conn_t::perform_write_vectored(iovec *iov, size_t iovcnt) {
     assert_thread();
 
     if (write_closed.is_pulsed()) {
@@ -386,8 +565,19 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
         return;
     }
 
-    while (size > 0) {
-        ssize_t res = ::write(sock.get(), buf, size);
+    if (tls.has()) {
+        perform_tls_write_vectored(iov, iovcnt);
+        return;
+    }
+
+    /* Skip over empty buffers, so that `iovcnt > 0` means there is data left */
+    while (iovcnt > 0 && iov->iov_len == 0) {
+        ++iov;
+        --iovcnt;
+    }
+
+    while (iovcnt > 0) {
+        ssize_t res = ::writev(sock.get(), iov, std::min<size_t>(iovcnt, IOV_MAX));
 
         if (res == -1 && (get_errno() == EAGAIN || get_errno() == EWOULDBLOCK)) {
             /* Wait for a notification from the event queue, or for an order to
@@ -425,10 +615,21 @@ void linux_tcp_conn_t::perform_write(const void *buf, size_t size) {
             break;
 
         } else {
-            rassert(res <= static_cast<ssize_t>(size));
-            buf = reinterpret_cast<const void *>(reinterpret_cast<const char *>(buf) + res);
-            size -= res;
             if (write_perfmon) write_perfmon->record(res);
+            /* Advance past everything that was written, which might end in the
+            middle of a buffer */
+            size_t written = res;
+            while (iovcnt > 0 && written >= iov->iov_len) {
+                written -= iov->iov_len;
+                ++iov;
+                --iovcnt;
+            }
+            if (iovcnt > 0) {
+                iov->iov_base = static_cast<char *>(iov->iov_base) + written;
+                iov->iov_len -= written;
+            } else {
+                rassert(written == 0);
+            }
         }
     }
 }
@@ -448,6 +649,8 @@ void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THR
     /* Enqueue the write so it will happen eventually */
     op.buffer = buf;
     op.size = size;
+    op.iov = NULL;
+    op.iovcnt = 0;
     op.dealloc = NULL;
     op.cond = &to_signal_when_done;
     write_queue.push(&op);
@@ -460,6 +663,33 @@ void linux_tcp_conn_t::write(const void *buf, size_t size, signal_t *closer) THR
     if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
 }
 
+void linux_tcp_conn_t::write_vectored(const iovec *iov, size_t iovcnt, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
+    write_op_wrapper_t sentry(this, closer);
+
+    write_queue_op_t op;
+    cond_t to_signal_when_done;
+
+    /* Flush out any data that's been buffered, so that things don't get out of order */
+    if (current_write_buffer->size > 0) internal_flush_write_buffer();
+
+    /* `perform_write_vectored()` advances the entries as it goes, so it needs its
+    own copy. The buffers themselves aren't copied. */
+    std::vector<iovec> iov_copy(iov, iov + iovcnt);
+
+    op.buffer = NULL;
+    op.size = 0;
+    op.iov = iov_copy.data();
+    op.iovcnt = iov_copy.size();
+    op.dealloc = NULL;
+    op.cond = &to_signal_when_done;
+    write_queue.push(&op);
+
+    /* See the comment in `write()` */
+    to_signal_when_done.wait();
+
+    if (write_closed.is_pulsed()) throw tcp_conn_write_closed_exc_t();
+}
+
 void linux_tcp_conn_t::write_buffered(const void *vbuf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
     write_op_wrapper_t sentry(this, closer);
 
@@ -507,6 +737,8 @@ void linux_tcp_conn_t::flush_buffer(signal_t *closer) THROWS_ONLY(tcp_conn_write
     write_queue_op_t op;
     cond_t to_signal_when_done;
     op.buffer = NULL;
+    op.iov = NULL;
+    op.iovcnt = 0;
     op.dealloc = NULL;
     op.cond = &to_signal_when_done;
     write_queue.push(&op);
@@ -636,11 +868,13 @@ void linux_tcp_conn_descriptor_t::make_overcomplicated(linux_tcp_conn_t **tcp_co
 /* Network listener object */
 linux_nonthrowing_tcp_listener_t::linux_nonthrowing_tcp_listener_t(
         const std::set<ip_address_t> &bind_addresses, int _port,
-        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &cb) :
+        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &cb,
+        bool _reuse_port) :
     callback(cb),
     local_addresses(bind_addresses),
     port(_port),
     bound(false),
+    reuse_port(_reuse_port),
     socks(),
     last_used_socket_index(0),
     event_watchers(),
@@ -710,6 +944,17 @@ int linux_nonthrowing_tcp_listener_t::init_sockets() {
         int res = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &sockoptval, sizeof(sockoptval));
         guarantee_err(res != -1, "Could not set REUSEADDR option");
 
+        if (reuse_port) {
+#ifdef SO_REUSEPORT
+            res = setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &sockoptval, sizeof(sockoptval));
+            if (res == -1) {
+                return get_errno();
+            }
+#else
+            return ENOPROTOOPT;
+#endif
+        }
+
         /* XXX Making our socket NODELAY prevents the problem where responses to
          * pipelined requests are delayed, since the TCP Nagle algorithm will
          * notice when we send multiple small packets and try to coalesce them. But
@@ -942,6 +1187,53 @@ void linux_nonthrowing_tcp_listener_t::on_event(int) {
     via event_listener.watch(). */
 }
 
+linux_per_thread_tcp_listener_t::linux_per_thread_tcp_listener_t(
+        const std::set<ip_address_t> &bind_addresses, int _port, int num_threads,
+        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &callback) :
+    port(_port),
+    listeners(num_threads)
+{
+    guarantee(num_threads > 0);
+    // We don't switch threads in the exception handler; see `destroy_listeners()`.
+    std::exception_ptr error;
+    try {
+        // If we were given `ANY_PORT`, the first listener picks the port and the others
+        // join it.
+        for (int i = 0; i < num_threads; ++i) {
+            on_thread_t thread_switcher((threadnum_t(i)));
+            listeners[i].init(new linux_nonthrowing_tcp_listener_t(
+                bind_addresses, port, callback, true));
+            if (!listeners[i]->begin_listening()) {
+                throw address_in_use_exc_t("localhost", port);
+            }
+            port = listeners[i]->get_port();
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+    if (error) {
+        destroy_listeners();
+        std::rethrow_exception(error);
+    }
+}
+
+linux_per_thread_tcp_listener_t::~linux_per_thread_tcp_listener_t() {
+    destroy_listeners();
+}
+
+int linux_per_thread_tcp_listener_t::get_port() const {
+    return port;
+}
+
+void linux_per_thread_tcp_listener_t::destroy_listeners() {
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        if (listeners[i].has()) {
+            on_thread_t thread_switcher((threadnum_t(i)));
+            listeners[i].reset();
+        }
+    }
+}
+
 void noop_fun(UNUSED const scoped_ptr_t<linux_tcp_conn_descriptor_t> &arg) { }
 
 linux_tcp_bound_socket_t::linux_tcp_bound_socket_t(const std::set<ip_address_t> &bind_addresses, int port) :
@@ -5,6 +5,7 @@
 #include <stdarg.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <ifaddrs.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
@@ -30,6 +31,8 @@
 #include "containers/intrusive_list.hpp"
 #include "perfmon/types.hpp"
 
+class tls_ctx_t;
+
 /* linux_tcp_conn_t provides a disgusting wrapper around a TCP network connection. */
 
 class linux_tcp_conn_t :
@@ -56,9 +59,28 @@ public:
         const std::string info;
     };
 
+    class tls_failed_exc_t : public std::exception {
+    public:
+        explicit tls_failed_exc_t(const std::string &_info) :
+            info("TLS handshake failed: " + _info) { }
+
+        const char *what() const throw () {
+            return info.c_str();
+        }
+
+        ~tls_failed_exc_t() throw () { }
+
+        const std::string info;
+    };
+
     // NB. interruptor cannot be NULL.
     linux_tcp_conn_t(const ip_address_t &host, int port, signal_t *interruptor, int local_port = ANY_PORT) THROWS_ONLY(connect_failed_exc_t, interrupted_exc_t);
 
+    /* Does a TLS handshake as `ctx`'s role, after which everything that's read and
+    written is encrypted. Must be called before anything is read or written. If it
+    throws `tls_failed_exc_t`, the connection can't be used any more. */
+    void enable_tls(tls_ctx_t *ctx, signal_t *interruptor) THROWS_ONLY(tls_failed_exc_t, interrupted_exc_t);
+
     /* Reading */
 
     /* If you know beforehand how many bytes you want to read, use read() with a
@@ -105,6 +127,11 @@ public:
     pipe and throws `tcp_conn_write_closed_exc_t`. */
     void write(const void *buf, size_t size, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
 
+    /* write_vectored() is like write(), but gathers the data from `iovcnt` separate
+    buffers and hands them to the kernel together, without copying them into a
+    contiguous buffer first. */
+    void write_vectored(const iovec *iov, size_t iovcnt, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t);
+
     /* write_buffered() is like write(), but it might not send the data until
     flush_buffer*() or write() is called. Internally, it bundles together the
     buffered writes; this may improve performance. */
@@ -230,6 +257,20 @@ private:
     ::read(). Returns the number of bytes read or throws tcp_conn_read_closed_exc_t. Bypasses read_buffer. */
     size_t read_internal(void *buffer, size_t size) THROWS_ONLY(tcp_conn_read_closed_exc_t);
 
+    /* The OpenSSL session, if `enable_tls()` was called. It's destroyed after `drainer`,
+    so that no write is still using it. */
+    class tls_state_t;
+    scoped_ptr_t<tls_state_t> tls;
+
+    /* Like `read_internal()` and `perform_write_vectored()`, for TLS connections */
+    size_t tls_read_internal(void *buffer, size_t size) THROWS_ONLY(tcp_conn_read_closed_exc_t);
+    void perform_tls_write_vectored(const iovec *iov, size_t iovcnt);
+
+    /* Waits until the socket is ready for what OpenSSL asked for with `ssl_error`.
+    `own_event` is the event that the calling direction normally waits for. Returns
+    false if `closed` was pulsed first. */
+    bool wait_for_tls(int ssl_error, int own_event, const cond_t *closed);
+
     static const size_t WRITE_QUEUE_MAX_SIZE = 128 * KILOBYTE;
     static const size_t WRITE_CHUNK_SIZE = 8 * KILOBYTE;
 
@@ -243,6 +284,10 @@ private:
         write_buffer_t *dealloc;
         const void *buffer;
         size_t size;
+        /* If `iov` is non-NULL, the operation writes these `iovcnt` buffers instead
+        of `buffer`. */
+        iovec *iov;
+        size_t iovcnt;
         cond_t *cond;
         auto_drainer_t::lock_t keepalive;
     };
@@ -301,6 +346,10 @@ private:
     `size` bytes from `buffer` to the socket. */
     void perform_write(const void *buffer, size_t size);
 
+    /* Like `perform_write()`, but gathers the data from `iovcnt` buffers. Modifies
+    the entries of `iov` to keep track of how much has been written. */
+    void perform_write_vectored(iovec *iov, size_t iovcnt);
+
     scoped_ptr_t<auto_drainer_t> drainer;
 };
 
@@ -331,8 +380,11 @@ the provided callback will be called in a new coroutine every time something con
 
 class linux_nonthrowing_tcp_listener_t : private linux_event_callback_t {
 public:
+    // With `_reuse_port`, the sockets are opened with `SO_REUSEPORT`, so that several
+    // listeners can share the port.
     linux_nonthrowing_tcp_listener_t(const std::set<ip_address_t> &bind_addresses, int _port,
-        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &callback);
+        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &callback,
+        bool _reuse_port = false);
 
     ~linux_nonthrowing_tcp_listener_t();
 
@@ -375,6 +427,8 @@ private:
     // Inidicates successful binding to a port
     bool bound;
 
+    const bool reuse_port;
+
     // The sockets to listen for connections on
     scoped_array_t<scoped_fd_t> socks;
 
@@ -387,6 +441,32 @@ private:
     bool log_next_error;
 };
 
+/* `linux_per_thread_tcp_listener_t` listens on the same port on threads 0 to
+`num_threads - 1`, through one `SO_REUSEPORT` socket per thread, each with its own
+accept loop. The kernel spreads incoming connections over the sockets, so a storm of
+reconnects isn't accepted by a single thread. `callback` is called on the thread
+that accepted the connection. Like `linux_tcp_listener_t`, the constructor throws if
+it can't listen. The constructor and destructor must be called in a coroutine. */
+class linux_per_thread_tcp_listener_t {
+public:
+    linux_per_thread_tcp_listener_t(const std::set<ip_address_t> &bind_addresses,
+        int _port, int num_threads,
+        const std::function<void(scoped_ptr_t<linux_tcp_conn_descriptor_t> &)> &callback);
+    ~linux_per_thread_tcp_listener_t();
+
+    int get_port() const;
+
+private:
+    void destroy_listeners();
+
+    int port;
+
+    // `listeners[i]` is created and destroyed on thread `i`.
+    scoped_array_t<scoped_ptr_t<linux_nonthrowing_tcp_listener_t> > listeners;
+
+    DISABLE_COPYING(linux_per_thread_tcp_listener_t);
+};
+
 /* Used by the old style tcp listener */
 class linux_tcp_bound_socket_t {
 public:
@@ -0,0 +1,189 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "arch/io/tls.hpp"
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <pthread.h>
+
+#include <vector>
+
+#include "utils.hpp"
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+// OpenSSL before 1.1 needs the application to provide locks for it.
+static std::vector<pthread_mutex_t> *openssl_locks;
+
+static void openssl_locking_callback(int mode, int n, const char *, int) {
+    if (mode & CRYPTO_LOCK) {
+        pthread_mutex_lock(&(*openssl_locks)[n]);
+    } else {
+        pthread_mutex_unlock(&(*openssl_locks)[n]);
+    }
+}
+#endif
+
+static void initialize_openssl() {
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    SSL_library_init();
+    SSL_load_error_strings();
+    openssl_locks = new std::vector<pthread_mutex_t>(CRYPTO_num_locks());
+    for (pthread_mutex_t &lock : *openssl_locks) {
+        int res = pthread_mutex_init(&lock, NULL);
+        guarantee_xerr(res == 0, res, "could not initialize OpenSSL lock");
+    }
+    CRYPTO_set_locking_callback(&openssl_locking_callback);
+#endif
+}
+
+static pthread_once_t openssl_initialized = PTHREAD_ONCE_INIT;
+
+std::string tls_error_string() {
+    std::string result;
+    while (unsigned long err = ERR_get_error()) {  // NOLINT(runtime/int)
+        char buffer[256];
+        ERR_error_string_n(err, buffer, sizeof(buffer));
+        if (!result.empty()) {
+            result += "; ";
+        }
+        result += buffer;
+    }
+    return result.empty() ? std::string("unknown error") : result;
+}
+
+static int on_new_client_session(SSL *ssl, SSL_SESSION *session) {
+    tls_ctx_t *ctx = static_cast<tls_ctx_t *>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    const std::string *peer = static_cast<const std::string *>(SSL_get_app_data(ssl));
+    if (ctx == NULL || peer == NULL) {
+        return 0;
+    }
+    ctx->set_session(*peer, session);
+    // We keep the reference to the session.
+    return 1;
+}
+
+tls_ctx_t::tls_ctx_t(tls_role_t _role,
+                     const std::string &cert_file,
+                     const std::string &key_file,
+                     const std::string &ca_file)
+        THROWS_ONLY(tls_config_exc_t)
+    : role(_role) {
+    pthread_once(&openssl_initialized, &initialize_openssl);
+
+    ctx = SSL_CTX_new(role == tls_role_t::SERVER
+                      ? SSLv23_server_method()
+                      : SSLv23_client_method());
+    if (ctx == NULL) {
+        throw tls_config_exc_t("Could not create TLS context: " + tls_error_string());
+    }
+    SSL_CTX_set_app_data(ctx, this);
+
+    long options = SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3  // NOLINT(runtime/int)
+        | SSL_OP_NO_COMPRESSION | SSL_OP_CIPHER_SERVER_PREFERENCE;
+#ifdef SSL_OP_NO_RENEGOTIATION
+    // `linux_tcp_conn_t` reads and writes from separate coroutines, which only works
+    // as long as neither direction needs the other to make progress.
+    options |= SSL_OP_NO_RENEGOTIATION;
+#endif
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    // Peers usually just close the socket without sending a close_notify alert.
+    options |= SSL_OP_IGNORE_UNEXPECTED_EOF;
+#endif
+#ifdef SSL_OP_ENABLE_KTLS
+    // Let the kernel do the record encryption where it supports it.
+    options |= SSL_OP_ENABLE_KTLS;
+#endif
+    SSL_CTX_set_options(ctx, options);
+    SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE
+                     | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER
+                     | SSL_MODE_RELEASE_BUFFERS);
+
+    try {
+        if (!cert_file.empty()) {
+            if (SSL_CTX_use_certificate_chain_file(ctx, cert_file.c_str()) != 1) {
+                throw tls_config_exc_t(strprintf(
+                    "Could not load TLS certificate `%s`: %s",
+                    cert_file.c_str(), tls_error_string().c_str()));
+            }
+            if (SSL_CTX_use_PrivateKey_file(ctx, key_file.c_str(), SSL_FILETYPE_PEM) != 1
+                || SSL_CTX_check_private_key(ctx) != 1) {
+                throw tls_config_exc_t(strprintf(
+                    "Could not load TLS private key `%s`: %s",
+                    key_file.c_str(), tls_error_string().c_str()));
+            }
+        } else if (role == tls_role_t::SERVER) {
+            throw tls_config_exc_t("A TLS server needs a certificate.");
+        }
+
+        if (!ca_file.empty()) {
+            if (SSL_CTX_load_verify_locations(ctx, ca_file.c_str(), NULL) != 1) {
+                throw tls_config_exc_t(strprintf(
+                    "Could not load TLS certificate authority `%s`: %s",
+                    ca_file.c_str(), tls_error_string().c_str()));
+            }
+            SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT,
+                               NULL);
+        }
+    } catch (...) {
+        SSL_CTX_free(ctx);
+        throw;
+    }
+
+    if (role == tls_role_t::SERVER) {
+        // Session tickets are on by default; this also lets clients that don't
+        // support them resume sessions from the server-side cache.
+        static const unsigned char session_id_context[] = "rethinkdb";
+        SSL_CTX_set_session_id_context(ctx, session_id_context,
+                                       sizeof(session_id_context) - 1);
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    } else {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT
+                                       | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, &on_new_client_session);
+    }
+}
+
+tls_ctx_t::~tls_ctx_t() {
+    for (const auto &pair : sessions) {
+        SSL_SESSION_free(pair.second);
+    }
+    SSL_CTX_free(ctx);
+}
+
+ssl_session_st *tls_ctx_t::get_session(const std::string &peer) {
+    spinlock_acq_t acq(&sessions_lock);
+    auto it = sessions.find(peer);
+    if (it == sessions.end()) {
+        return NULL;
+    }
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    CRYPTO_add(&it->second->references, 1, CRYPTO_LOCK_SSL_SESSION);
+#else
+    SSL_SESSION_up_ref(it->second);
+#endif
+    return it->second;
+}
+
+void tls_ctx_t::set_session(const std::string &peer, ssl_session_st *session) {
+    SSL_SESSION *old_session = NULL;
+    {
+        spinlock_acq_t acq(&sessions_lock);
+        SSL_SESSION *&entry = sessions[peer];
+        old_session = entry;
+        entry = session;
+    }
+    if (old_session != NULL) {
+        SSL_SESSION_free(old_session);
+    }
+}
+
+static tls_ctx_t *tls_ctxs[3][2] = { { NULL, NULL }, { NULL, NULL }, { NULL, NULL } };
+
+void set_tls_ctx(tls_service_t service, tls_ctx_t *ctx) {
+    tls_ctx_t **slot = &tls_ctxs[static_cast<int>(service)][static_cast<int>(ctx->get_role())];
+    delete *slot;
+    *slot = ctx;
+}
+
+tls_ctx_t *get_tls_ctx(tls_service_t service, tls_role_t role) {
+    return tls_ctxs[static_cast<int>(service)][static_cast<int>(role)];
+}
@@ -0,0 +1,80 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef ARCH_IO_TLS_HPP_
+#define ARCH_IO_TLS_HPP_
+
+#include <exception>
+#include <map>
+#include <string>
+
+#include "arch/spinlock.hpp"
+#include "errors.hpp"
+
+struct ssl_ctx_st;
+struct ssl_session_st;
+
+class tls_config_exc_t : public std::exception {
+public:
+    explicit tls_config_exc_t(const std::string &_info) : info(_info) { }
+    ~tls_config_exc_t() throw () { }
+    const char *what() const throw () {
+        return info.c_str();
+    }
+private:
+    std::string info;
+};
+
+enum class tls_role_t { SERVER, CLIENT };
+
+/* `tls_ctx_t` holds the certificate, key and settings for one side of the TLS
+connections on a port. It's safe to use from any thread.
+
+Servers hand out session tickets, and clients remember the last session each server
+gave them, so that a client that reconnects (which happens a lot when a cluster
+recovers from a network partition) can resume its session instead of doing a full
+handshake. */
+class tls_ctx_t {
+public:
+    /* `cert_file` and `key_file` are required for servers and optional for clients.
+    If `ca_file` isn't empty, peers must present a certificate that it signed. Throws
+    `tls_config_exc_t` if the files can't be loaded. */
+    tls_ctx_t(tls_role_t role,
+              const std::string &cert_file,
+              const std::string &key_file,
+              const std::string &ca_file)
+        THROWS_ONLY(tls_config_exc_t);
+    ~tls_ctx_t();
+
+    tls_role_t get_role() const { return role; }
+    ssl_ctx_st *get() const { return ctx; }
+
+    /* Returns a new reference to the session we last got from `peer`, or `NULL`. */
+    ssl_session_st *get_session(const std::string &peer);
+
+    /* Takes ownership of `session`. */
+    void set_session(const std::string &peer, ssl_session_st *session);
+
+private:
+    const tls_role_t role;
+    ssl_ctx_st *ctx;
+
+    spinlock_t sessions_lock;
+    std::map<std::string, ssl_session_st *> sessions;
+
+    DISABLE_COPYING(tls_ctx_t);
+};
+
+/* Which ports use TLS is decided on the command line before the thread pool starts,
+and doesn't change afterwards. The cluster port needs a context for each role, since
+servers both accept and make connections to their peers. */
+enum class tls_service_t { DRIVER, HTTP, CLUSTER };
+
+/* Takes ownership of `ctx`. */
+void set_tls_ctx(tls_service_t service, tls_ctx_t *ctx);
+
+/* Returns `NULL` if connections for `service` in `role` don't use TLS. */
+tls_ctx_t *get_tls_ctx(tls_service_t service, tls_role_t role);
+
+/* Describes (and clears) the errors in OpenSSL's error queue for this thread. */
+std::string tls_error_string();
+
+#endif  // ARCH_IO_TLS_HPP_
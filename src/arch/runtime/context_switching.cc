@@ -167,6 +167,49 @@ artificial_stack_t::~artificial_stack_t() {
     free(stack);
 }
 
+size_t artificial_stack_t::trim() {
+    rassert(!context.is_nil(), "trimming a stack that is in use");
+    const size_t page_size = getpagesize();
+
+    /* Find how deep the stack has been used.  We gave all pages but the first one
+    back to the operating system when we created the stack, so the ones that are in
+    memory are the ones that were touched since. */
+#ifdef __MACH__
+    typedef char mincore_vec_t;
+#else
+    typedef unsigned char mincore_vec_t;
+#endif
+    const size_t num_pages = stack_size / page_size;
+    scoped_array_t<mincore_vec_t> resident(num_pages);
+    size_t used_size = 0;
+    if (mincore(stack, num_pages * page_size, resident.data()) == 0) {
+        // Skip the protection page.
+        for (size_t i = 1; i < num_pages; ++i) {
+            if ((resident[i] & 1) != 0) {
+                used_size = stack_size - i * page_size;
+                break;
+            }
+        }
+    }
+
+    /* Nothing below the stack pointer of a stack that is switched out is live.  We
+    keep the page with the stack pointer and the one below it in memory, since we'll
+    need them again as soon as we switch back in. */
+    const uintptr_t keep_from =
+        floor_aligned(reinterpret_cast<uintptr_t>(context.pointer), page_size)
+        - page_size;
+    const uintptr_t trim_from = reinterpret_cast<uintptr_t>(stack) + page_size;
+    if (keep_from > trim_from) {
+#ifdef __MACH__
+        madvise(reinterpret_cast<void *>(trim_from), keep_from - trim_from, MADV_FREE);
+#else
+        madvise(reinterpret_cast<void *>(trim_from), keep_from - trim_from,
+                MADV_DONTNEED);
+#endif
+    }
+    return used_size;
+}
+
 bool artificial_stack_t::address_in_stack(void *addr) {
     return reinterpret_cast<uintptr_t>(addr) >=
             reinterpret_cast<uintptr_t>(get_stack_bound())
@@ -65,6 +65,11 @@ public:
     /* Returns the end of the stack */
     void *get_stack_bound() { return stack; }
 
+    /* Gives the pages of the stack below its stack pointer back to the operating
+    system.  Returns how deep the stack was used since it was created or last
+    trimmed, rounded to whole pages.  The stack must be switched out. */
+    size_t trim();
+
 private:
     void *stack;
     size_t stack_size;
@@ -177,6 +182,9 @@ public:
     /* Returns the end of the stack */
     void *get_stack_bound();
 
+    /* Does nothing, the thread owns the stack.  Returns 0. */
+    size_t trim() { return 0; }
+
 private:
     static void *internal_run(void *p);
     void get_stack_addr_size(void **stackaddr_out, size_t *stacksize_out);
@@ -0,0 +1,258 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "arch/runtime/coro_sampler.hpp"
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
+#include "backtrace.hpp"
+#include "rethinkdb_backtrace.hpp"
+#include "utils.hpp"
+
+uint32_t coro_sampler_t::sample_interval = 0;
+uint32_t coro_sampler_t::wait_sample_interval = 0;
+uint32_t coro_sampler_t::allocation_sample_interval = 0;
+
+coro_sampler_t &coro_sampler_t::get_global_sampler() {
+    // See `coro_profiler_t::get_global_profiler()`.
+    static coro_sampler_t sampler;
+    return sampler;
+}
+
+void coro_sampler_t::set_sample_interval(uint32_t interval) {
+    __atomic_store_n(&sample_interval, interval, __ATOMIC_RELAXED);
+}
+
+void coro_sampler_t::set_wait_sample_interval(uint32_t interval) {
+    __atomic_store_n(&wait_sample_interval, interval, __ATOMIC_RELAXED);
+}
+
+void coro_sampler_t::set_allocation_sample_interval(uint32_t interval) {
+    __atomic_store_n(&allocation_sample_interval, interval, __ATOMIC_RELAXED);
+}
+
+void coro_sampler_t::record_coro_resume() {
+    rassert(coro_t::self());
+    rings[get_thread_id().threadnum].value.last_resumed_at = get_ticks();
+}
+
+void coro_sampler_t::record_coro_yield(size_t levels_to_strip_from_backtrace) {
+    rassert(coro_t::self());
+    const uint32_t interval = get_sample_interval();
+    per_thread_ring_t *ring = &rings[get_thread_id().threadnum].value;
+
+    const ticks_t resumed_at = ring->last_resumed_at;
+    ring->last_resumed_at = 0;
+    // The interval might have been lowered since we last counted down.
+    ring->yields_until_sample = std::min(ring->yields_until_sample, interval);
+    if (ring->yields_until_sample > 1) {
+        --ring->yields_until_sample;
+        return;
+    }
+    ring->yields_until_sample = interval;
+    if (resumed_at == 0 || interval == 0) {
+        return;
+    }
+
+    trace_t trace;
+    capture_trace(levels_to_strip_from_backtrace, &trace);
+    const ticks_t now = get_ticks();
+    ring->running.push(trace, now > resumed_at ? (now - resumed_at) / 1000 : 0);
+}
+
+void coro_sampler_t::record_wait_begin(wait_t *wait,
+                                       size_t levels_to_strip_from_backtrace) {
+    rassert(coro_t::self());
+    const uint32_t interval = get_wait_sample_interval();
+    per_thread_ring_t *ring = &rings[get_thread_id().threadnum].value;
+
+    ring->waits_until_sample = std::min(ring->waits_until_sample, interval);
+    if (ring->waits_until_sample > 1) {
+        --ring->waits_until_sample;
+        return;
+    }
+    ring->waits_until_sample = interval;
+    if (interval == 0) {
+        return;
+    }
+
+    capture_trace(levels_to_strip_from_backtrace, &wait->trace);
+    wait->started_at = get_ticks();
+}
+
+void coro_sampler_t::record_wait_end(wait_t *wait) {
+    rassert(coro_t::self());
+    rassert(wait->started_at != 0);
+    // We record the sample even if wait sampling has been switched off in the
+    // meantime, so that long waits aren't lost.
+    per_thread_ring_t *ring = &rings[get_thread_id().threadnum].value;
+    const ticks_t now = get_ticks();
+    ring->waiting.push(wait->trace,
+                       now > wait->started_at ? (now - wait->started_at) / 1000 : 0);
+    wait->started_at = 0;
+}
+
+void coro_sampler_t::record_allocation(memory_tag_t tag, int64_t bytes,
+                                       size_t levels_to_strip_from_backtrace) {
+    const int64_t interval = get_allocation_sample_interval();
+    const int threadnum = get_thread_id().threadnum;
+    // Memory might be counted on threads that aren't ours, e.g. before the thread
+    // pool starts.
+    if (interval == 0 || threadnum < 0) {
+        return;
+    }
+    per_thread_ring_t *ring = &rings[threadnum].value;
+
+    ring->bytes_until_allocation_sample =
+        std::min(ring->bytes_until_allocation_sample, interval);
+    ring->bytes_until_allocation_sample -= bytes;
+    if (ring->bytes_until_allocation_sample > 0) {
+        return;
+    }
+    // An allocation that spans several intervals stands for as many samples.
+    const int64_t samples = 1 - ring->bytes_until_allocation_sample / interval;
+    ring->bytes_until_allocation_sample += samples * interval;
+
+    trace_t trace;
+    capture_trace(levels_to_strip_from_backtrace, &trace);
+    ring->allocating[static_cast<int>(tag)].push(trace, samples * interval);
+}
+
+NOINLINE void coro_sampler_t::capture_trace(size_t levels_to_strip_from_backtrace,
+                                            trace_t *trace_out) {
+    // We strip ourselves, the `record_...` function that called us, and the frames
+    // that are inside `rethinkdb_backtrace()`.
+    levels_to_strip_from_backtrace += 2 + NUM_FRAMES_INSIDE_RETHINKDB_BACKTRACE;
+    void *stack_frames[CORO_SAMPLER_BACKTRACE_DEPTH + 8];
+    const size_t max_frames =
+        std::min(CORO_SAMPLER_BACKTRACE_DEPTH + levels_to_strip_from_backtrace,
+                 sizeof(stack_frames) / sizeof(stack_frames[0]));
+    const size_t backtrace_size = rethinkdb_backtrace(stack_frames, max_frames);
+
+    for (size_t i = 0; i < CORO_SAMPLER_BACKTRACE_DEPTH; ++i) {
+        if (i + levels_to_strip_from_backtrace < backtrace_size) {
+            (*trace_out)[i] = stack_frames[i + levels_to_strip_from_backtrace];
+        } else {
+            (*trace_out)[i] = NULL;
+        }
+    }
+}
+
+void coro_sampler_t::sample_ring_t::push(const trace_t &trace, uint64_t weight) {
+    if (samples == NULL) {
+        __atomic_store_n(&samples, new sample_t[CORO_SAMPLER_RING_SIZE],
+                         __ATOMIC_RELEASE);
+    }
+    const uint64_t index = num_written;
+    sample_t *sample = &samples[index % CORO_SAMPLER_RING_SIZE];
+    sample->trace = trace;
+    sample->weight = weight;
+    __atomic_store_n(&num_written, index + 1, __ATOMIC_RELEASE);
+}
+
+void coro_sampler_t::sample_ring_t::collect(
+        bool count, std::map<trace_t, uint64_t> *weights_out) const {
+    const sample_t *ring_samples = __atomic_load_n(&samples, __ATOMIC_ACQUIRE);
+    if (ring_samples == NULL) {
+        return;
+    }
+    const uint64_t end = __atomic_load_n(&num_written, __ATOMIC_ACQUIRE);
+    const uint64_t begin =
+        end > CORO_SAMPLER_RING_SIZE ? end - CORO_SAMPLER_RING_SIZE : 0;
+    std::vector<sample_t> copied;
+    copied.reserve(end - begin);
+    for (uint64_t i = begin; i < end; ++i) {
+        copied.push_back(ring_samples[i % CORO_SAMPLER_RING_SIZE]);
+    }
+    // The owning thread might have lapped us while we were copying. The
+    // sample it is writing right now goes into the slot of index
+    // `end_after - CORO_SAMPLER_RING_SIZE`, so that and everything before it
+    // might be garbage.
+    const uint64_t end_after = __atomic_load_n(&num_written, __ATOMIC_ACQUIRE);
+    const uint64_t first_valid =
+        end_after >= CORO_SAMPLER_RING_SIZE ? end_after - CORO_SAMPLER_RING_SIZE + 1 : 0;
+    for (uint64_t i = std::max(begin, first_valid); i < end; ++i) {
+        const sample_t &sample = copied[i - begin];
+        (*weights_out)[sample.trace] += count ? 1 : sample.weight;
+    }
+}
+
+static std::string get_frame_name(void *addr,
+                                  std::map<void *, std::string> *name_cache) {
+    auto it = name_cache->find(addr);
+    if (it != name_cache->end()) {
+        return it->second;
+    }
+
+    backtrace_frame_t frame(addr);
+    frame.initialize_symbols();
+    std::string name;
+    try {
+        name = frame.get_demangled_name();
+    } catch (const demangle_failed_exc_t &) {
+        name = strprintf("%p", addr);
+    }
+    // Semicolons separate frames in the folded format.
+    std::replace(name.begin(), name.end(), ';', ':');
+    return name_cache->insert(std::make_pair(addr, name)).first->second;
+}
+
+std::string coro_sampler_t::get_folded_stacks() {
+    std::map<trace_t, uint64_t> weights;
+    for (auto ring = rings.begin(); ring != rings.end(); ++ring) {
+        ring->value.running.collect(false, &weights);
+    }
+    return fold(weights);
+}
+
+std::string coro_sampler_t::get_folded_wait_stacks(wait_weight_t weight) {
+    std::map<trace_t, uint64_t> weights;
+    for (auto ring = rings.begin(); ring != rings.end(); ++ring) {
+        ring->value.waiting.collect(weight == wait_weight_t::COUNT, &weights);
+    }
+    return fold(weights);
+}
+
+std::string coro_sampler_t::get_folded_allocation_stacks() {
+    std::string result;
+    for (int tag = 0; tag < NUM_MEMORY_TAGS; ++tag) {
+        std::map<trace_t, uint64_t> weights;
+        for (auto ring = rings.begin(); ring != rings.end(); ++ring) {
+            ring->value.allocating[tag].collect(false, &weights);
+        }
+        result += fold(weights, memory_tag_name(static_cast<memory_tag_t>(tag)));
+    }
+    return result;
+}
+
+std::string coro_sampler_t::fold(const std::map<trace_t, uint64_t> &weights,
+                                 const std::string &root_frame) {
+    std::map<void *, std::string> name_cache;
+    std::string result;
+    for (auto it = weights.begin(); it != weights.end(); ++it) {
+        if (it->second == 0) {
+            continue;
+        }
+        // Backtraces are innermost first, the folded format wants them outermost
+        // first.
+        std::string line = root_frame;
+        for (auto frame = it->first.rbegin(); frame != it->first.rend(); ++frame) {
+            if (*frame == NULL) {
+                continue;
+            }
+            if (!line.empty()) {
+                line += ";";
+            }
+            line += get_frame_name(*frame, &name_cache);
+        }
+        if (line.empty()) {
+            continue;
+        }
+        result += strprintf("%s %" PRIu64 "\n", line.c_str(), it->second);
+    }
+    return result;
+}
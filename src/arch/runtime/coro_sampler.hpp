@@ -0,0 +1,192 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_CORO_SAMPLER_HPP_
+#define ARCH_RUNTIME_CORO_SAMPLER_HPP_
+
+#include <stdint.h>
+
+#include <array>
+#include <map>
+#include <string>
+
+#include "arch/runtime/memory_tags.hpp"
+#include "concurrency/cache_line_padded.hpp"
+#include "config/args.hpp"
+#include "errors.hpp"
+#include "time.hpp"
+
+/* Depth of the stack traces recorded by the coro sampler. */
+#define CORO_SAMPLER_BACKTRACE_DEPTH            16
+
+/* Number of samples that each thread keeps around. Older samples are overwritten. */
+#define CORO_SAMPLER_RING_SIZE                  4096
+
+/*
+ * The `coro_sampler_t` is a low-overhead alternative to the `coro_profiler_t` that
+ * is always compiled in and can be switched on and off at runtime. While it is
+ * switched off, the only cost is a relaxed load of the sample interval on every
+ * coroutine resume and yield.
+ *
+ * Once switched on with `set_sample_interval(n)`, every thread records a backtrace
+ * on every n-th coroutine yield. Each sample is weighted by the time the coroutine
+ * has been running since it last resumed, so the resulting profile approximates where
+ * CPU time is spent rather than how often we yield. Samples go into a fixed-size ring
+ * buffer per thread. Only the owning thread ever writes into its ring, so recording
+ * a sample takes no locks; readers detect and drop samples that were overwritten
+ * while they were being copied.
+ *
+ * `get_folded_stacks()` aggregates the samples from all threads into the "folded"
+ * format that flamegraph.pl and similar tools consume: one line per distinct stack,
+ * frames separated by semicolons from the outermost to the innermost, followed by
+ * the total weight in microseconds.
+ *
+ * The sampler can also profile where coroutines are blocked rather than where they
+ * run. Once switched on with `set_wait_sample_interval(n)`, every n-th call to
+ * `coro_t::wait()` records the backtrace of the wait site, that is, the semaphore,
+ * lock, signal, mailbox reply or thread hop that the coroutine waits on, together
+ * with the time until the coroutine is resumed again. `get_folded_wait_stacks()`
+ * aggregates these either by total blocked time or by the number of waits.
+ *
+ * Finally, once switched on with `set_allocation_sample_interval(n)`, every thread
+ * records the backtrace of an allocation counted by `count_tagged_memory()` about
+ * every n bytes, weighted by n. `get_folded_allocation_stacks()` aggregates these
+ * with the allocation's `memory_tag_t` as the outermost frame, so the profile
+ * shows what allocated the memory of each tag. It shows where memory was
+ * allocated recently, not what is still held.
+ */
+class coro_sampler_t {
+public:
+    static coro_sampler_t &get_global_sampler();
+
+    // Records a sample on every `interval`-th yield. 0 switches the sampler off.
+    static void set_sample_interval(uint32_t interval);
+    static uint32_t get_sample_interval() {
+        return __atomic_load_n(&sample_interval, __ATOMIC_RELAXED);
+    }
+
+    // Records a sample on every `interval`-th wait. 0 switches wait sampling off.
+    static void set_wait_sample_interval(uint32_t interval);
+    static uint32_t get_wait_sample_interval() {
+        return __atomic_load_n(&wait_sample_interval, __ATOMIC_RELAXED);
+    }
+
+    // Records a sample about every `interval` bytes of tagged allocations. 0
+    // switches allocation sampling off.
+    static void set_allocation_sample_interval(uint32_t interval);
+    static uint32_t get_allocation_sample_interval() {
+        return __atomic_load_n(&allocation_sample_interval, __ATOMIC_RELAXED);
+    }
+
+    enum class wait_weight_t { BLOCKED_TIME, COUNT };
+
+    std::string get_folded_stacks();
+    std::string get_folded_wait_stacks(wait_weight_t weight);
+    std::string get_folded_allocation_stacks();
+
+    // coroutine execution is resumed
+    void record_coro_resume();
+    // coroutine execution yields
+    void record_coro_yield(size_t levels_to_strip_from_backtrace);
+
+    typedef std::array<void *, CORO_SAMPLER_BACKTRACE_DEPTH> trace_t;
+
+    // One wait of a coroutine. It lives on the waiting coroutine's stack rather
+    // than in the per-thread state, because the coroutine may be resumed on a
+    // different thread than the one it waited on.
+    struct wait_t {
+        wait_t() : started_at(0) { }
+        trace_t trace;
+        // 0 if this wait isn't sampled.
+        ticks_t started_at;
+    };
+
+    // coroutine waits to be notified
+    void record_wait_begin(wait_t *wait, size_t levels_to_strip_from_backtrace);
+    // coroutine has been notified and runs again
+    void record_wait_end(wait_t *wait);
+
+    // `bytes` of memory have been counted towards `tag`
+    void record_allocation(memory_tag_t tag, int64_t bytes,
+                           size_t levels_to_strip_from_backtrace);
+
+private:
+    coro_sampler_t() { }
+
+    struct sample_t {
+        trace_t trace;
+        // Microseconds, or bytes for allocation samples.
+        uint64_t weight;
+    };
+
+    struct sample_ring_t {
+        sample_ring_t() : samples(NULL), num_written(0) { }
+        // Must only be called by the owning thread.
+        void push(const trace_t &trace, uint64_t weight);
+        // Adds the weights of the samples in the ring to `weights_out`, or 1 for
+        // each sample if `count` is true.
+        void collect(bool count, std::map<trace_t, uint64_t> *weights_out) const;
+
+        // Allocated by the owning thread when it records its first sample, so
+        // threads that never sample don't pay for a ring. Never freed.
+        sample_t *samples;
+        // Only ever incremented by the owning thread, after the sample it
+        // accounts for has been written.
+        uint64_t num_written;
+    };
+
+    struct per_thread_ring_t {
+        per_thread_ring_t() : yields_until_sample(0), waits_until_sample(0),
+                              bytes_until_allocation_sample(0),
+                              last_resumed_at(0) { }
+        sample_ring_t running;
+        sample_ring_t waiting;
+        std::array<sample_ring_t, NUM_MEMORY_TAGS> allocating;
+        uint32_t yields_until_sample;
+        uint32_t waits_until_sample;
+        int64_t bytes_until_allocation_sample;
+        // 0 if the current coroutine resumed before the sampler was switched on.
+        ticks_t last_resumed_at;
+    };
+
+    static void capture_trace(size_t levels_to_strip_from_backtrace, trace_t *trace_out);
+    // Prefixes every stack with `root_frame`, unless it's empty.
+    static std::string fold(const std::map<trace_t, uint64_t> &weights,
+                            const std::string &root_frame = "");
+
+    static uint32_t sample_interval;
+    static uint32_t wait_sample_interval;
+    static uint32_t allocation_sample_interval;
+
+    // Would be nice if we could use one_per_thread here, but the sampler can be
+    // used before the thread pool exists.
+    std::array<cache_line_padded_t<per_thread_ring_t>, MAX_THREADS> rings;
+
+    DISABLE_COPYING(coro_sampler_t);
+};
+
+// PROFILER_CORO_RESUME and PROFILER_CORO_YIELD's counterparts for the sampler.
+// They only call out of line while the sampler is switched on.
+#define SAMPLER_CORO_RESUME do {                                        \
+        if (coro_sampler_t::get_sample_interval() != 0) {               \
+            coro_sampler_t::get_global_sampler().record_coro_resume();  \
+        }                                                               \
+    } while (0)
+#define SAMPLER_CORO_YIELD(STRIP_FRAMES) do {                                       \
+        if (coro_sampler_t::get_sample_interval() != 0) {                           \
+            coro_sampler_t::get_global_sampler().record_coro_yield(STRIP_FRAMES);   \
+        }                                                                           \
+    } while (0)
+
+// Wrapped around the context switch in `coro_t::wait()`. `WAIT` must point to a
+// `coro_sampler_t::wait_t` on the waiting coroutine's stack.
+#define SAMPLER_CORO_WAIT_BEGIN(WAIT, STRIP_FRAMES) do {                                \
+        if (coro_sampler_t::get_wait_sample_interval() != 0) {                          \
+            coro_sampler_t::get_global_sampler().record_wait_begin(WAIT, STRIP_FRAMES); \
+        }                                                                               \
+    } while (0)
+#define SAMPLER_CORO_WAIT_END(WAIT) do {                                \
+        if ((WAIT)->started_at != 0) {                                  \
+            coro_sampler_t::get_global_sampler().record_wait_end(WAIT); \
+        }                                                               \
+    } while (0)
+
+#endif /* ARCH_RUNTIME_CORO_SAMPLER_HPP_ */
@@ -13,6 +13,9 @@
 
 #include "arch/runtime/context_switching.hpp"
 #include "arch/runtime/coro_profiler.hpp"
+#include "arch/runtime/coro_sampler.hpp"
+#include "arch/runtime/memory_tags.hpp"
+#include "arch/runtime/resource_usage.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "config/args.hpp"
@@ -44,6 +47,10 @@ struct coro_globals_t {
     /* A list of coro_t objects that are not in use. */
     intrusive_list_t<coro_t> free_coros;
 
+    /* More coro_t objects that are not in use, whose stacks have been trimmed. We
+    use them once `free_coros` is empty. */
+    intrusive_list_t<coro_t> trimmed_free_coros;
+
 #ifndef NDEBUG
 
     /* An integer counting the number of coros on this thread */
@@ -89,6 +96,10 @@ struct coro_globals_t {
             free_coros.remove(s);
             delete s;
         }
+        while (coro_t *s = trimmed_free_coros.head()) {
+            trimmed_free_coros.remove(s);
+            delete s;
+        }
     }
 
 };
@@ -99,9 +110,12 @@ TLS_with_init(coro_globals_t *, cglobals, NULL);
 // construction depends on coro_t::coroutines_have_been_initialized() which in turn
 // depends on cglobals.
 static perfmon_counter_t pm_active_coroutines, pm_allocated_coroutines;
+// How deep the stacks of coroutines were used, sampled when they are trimmed.
+static perfmon_sampler_t pm_coroutine_stack_usage(secs_to_ticks(1), false);
 static perfmon_multi_membership_t pm_coroutines_membership(&get_global_perfmon_collection(),
     &pm_active_coroutines, "active_coroutines",
-    &pm_allocated_coroutines, "allocated_coroutines");
+    &pm_allocated_coroutines, "allocated_coroutines",
+    &pm_coroutine_stack_usage, "coroutine_stack_usage");
 
 coro_runtime_t::coro_runtime_t() {
     rassert(!TLS_get_cglobals(), "coro runtime initialized twice on this thread");
@@ -131,7 +145,10 @@ coro_t::coro_t() :
     stack(&coro_t::run, coro_stack_size),
     current_thread_(linux_thread_pool_t::get_thread_id()),
     notified_(false),
-    waiting_(false)
+    waiting_(false),
+    trim_stack_on_wait_(false),
+    usage_(NULL),
+    usage_resumed_at_(0)
 #ifndef NDEBUG
     , selfname_number(get_thread_id().threadnum + MAX_THREADS *
           // The comma here is the comma operator, to implement the semantics
@@ -144,6 +161,8 @@ coro_t::coro_t() :
 #endif
 {
     ++pm_allocated_coroutines;
+    // `coro_stack_size` is only set at startup, before any coroutines exist.
+    count_tagged_memory(memory_tag_t::coroutine_stacks, coro_stack_size);
 
 #ifndef NDEBUG
     TLS_get_cglobals()->coro_count++;
@@ -162,9 +181,20 @@ void coro_t::return_coro_to_free_list(coro_t *coro) {
 
 void coro_t::maybe_evict_from_free_list() {
     coro_globals_t *cglobals = TLS_get_cglobals();
+    // Trimming the least recently used stacks is much cheaper than freeing them
+    // and allocating new ones on the next spike, and keeps their memory usage low.
     while (cglobals->free_coros.size() > COROUTINE_FREE_LIST_SIZE) {
-        coro_t *coro_to_delete = cglobals->free_coros.tail();
-        cglobals->free_coros.remove(coro_to_delete);
+        coro_t *coro_to_trim = cglobals->free_coros.head();
+        cglobals->free_coros.remove(coro_to_trim);
+        const size_t used_size = coro_to_trim->stack.trim();
+        if (used_size != 0) {
+            pm_coroutine_stack_usage.record(used_size);
+        }
+        cglobals->trimmed_free_coros.push_back(coro_to_trim);
+    }
+    while (cglobals->trimmed_free_coros.size() > COROUTINE_TRIMMED_FREE_LIST_SIZE) {
+        coro_t *coro_to_delete = cglobals->trimmed_free_coros.head();
+        cglobals->trimmed_free_coros.remove(coro_to_delete);
         delete coro_to_delete;
     }
 }
@@ -177,6 +207,8 @@ coro_t::~coro_t() {
     TLS_get_cglobals()->coro_count--;
 #endif
     --pm_allocated_coroutines;
+    count_tagged_memory(memory_tag_t::coroutine_stacks,
+                        -static_cast<int64_t>(coro_stack_size));
 }
 
 void coro_t::run() {
@@ -201,7 +233,10 @@ void coro_t::run() {
         TLS_get_cglobals()->active_coroutines.insert(coro);
 #endif
         PROFILER_CORO_RESUME;
+        SAMPLER_CORO_RESUME;
         coro->action_wrapper.run();
+        rassert(coro->usage_ == NULL);
+        SAMPLER_CORO_YIELD(0);
         PROFILER_CORO_YIELD(0);
 #ifndef NDEBUG
         TLS_get_cglobals()->running_coroutine_counts[coro->coroutine_type]--;
@@ -255,11 +290,22 @@ void coro_t::wait() {   /* class method */
     self()->waiting_ = true;
 
     PROFILER_CORO_YIELD(1);
+    SAMPLER_CORO_YIELD(1);
+    coro_sampler_t::wait_t sampled_wait;
+    SAMPLER_CORO_WAIT_BEGIN(&sampled_wait, 1);
+    if (self()->usage_ != NULL) {
+        self()->charge_run_time();
+    }
     if (TLS_get_cglobals()->prev_coro) {
         context_switch(&self()->stack.context, &TLS_get_cglobals()->prev_coro->stack.context);
     } else {
         context_switch(&self()->stack.context, &TLS_get_cglobals()->scheduler);
     }
+    if (self()->usage_ != NULL) {
+        self()->usage_resumed_at_ = get_ticks();
+    }
+    SAMPLER_CORO_WAIT_END(&sampled_wait);
+    SAMPLER_CORO_RESUME;
     PROFILER_CORO_RESUME;
 
     rassert(self());
@@ -297,6 +343,10 @@ void coro_t::notify_now_deprecated() {
 
     if (coro_t::self() != NULL) {
         PROFILER_CORO_YIELD(1);
+        // Don't charge the coroutine we're switching to to our usage.
+        if (coro_t::self()->usage_ != NULL) {
+            coro_t::self()->charge_run_time();
+        }
     }
     coro_t *prev_prev_coro = TLS_get_cglobals()->prev_coro;
     TLS_get_cglobals()->prev_coro = TLS_get_cglobals()->current_coro;
@@ -308,11 +358,21 @@ void coro_t::notify_now_deprecated() {
         context_switch(&TLS_get_cglobals()->scheduler, &this->stack.context);
     }
 
+    // The coroutine has switched out again, so its stack can be trimmed now -- unless
+    // it is moving to another thread, which may already be running it.
+    if (trim_stack_on_wait_ && waiting_
+        && current_thread_.threadnum == linux_thread_pool_t::get_thread_id()) {
+        stack.trim();
+    }
+
     rassert(TLS_get_cglobals()->current_coro == this);
     TLS_get_cglobals()->current_coro = TLS_get_cglobals()->prev_coro;
     TLS_get_cglobals()->prev_coro = prev_prev_coro;
     if (coro_t::self() != NULL) {
         PROFILER_CORO_RESUME;
+        if (coro_t::self()->usage_ != NULL) {
+            coro_t::self()->usage_resumed_at_ = get_ticks();
+        }
     }
 
 #ifndef NDEBUG
@@ -385,11 +445,15 @@ coro_t * coro_t::get_coro() {
     rassert(coroutines_have_been_initialized());
     coro_t *coro;
 
-    if (TLS_get_cglobals()->free_coros.size() == 0) {
+    intrusive_list_t<coro_t> *free_coros = &TLS_get_cglobals()->free_coros;
+    if (free_coros->size() == 0) {
+        free_coros = &TLS_get_cglobals()->trimmed_free_coros;
+    }
+    if (free_coros->size() == 0) {
         coro = new coro_t();
     } else {
-        coro = TLS_get_cglobals()->free_coros.tail();
-        TLS_get_cglobals()->free_coros.remove(coro);
+        coro = free_coros->tail();
+        free_coros->remove(coro);
 
         /* We cannot easily delete coroutines at the time where we return
         them to the free list, because coro_t::run() requires the coro_t pointer to remain
@@ -398,9 +462,10 @@ coro_t * coro_t::get_coro() {
         hub that would delete the coroutine later, but that would make the shut down
         process more complicated because we would have to wait for those messages
         to get processed.
-        Instead, we delete unused coroutines from the free list here. It's not perfect,
-        but the important thing is that unused coroutines get evicted eventually
-        so we can reclaim the memory. */
+        Instead, we trim and delete unused coroutines from the free list here. It's not
+        perfect, but the important thing is that unused coroutines get evicted
+        eventually so we can reclaim the memory.  (The same goes for trimming: a
+        coroutine's stack can't be trimmed while it's still running on it.) */
         maybe_evict_from_free_list();
     }
 
@@ -506,3 +571,21 @@ void home_coro_mixin_t::assert_coro() {
 }
 
 #endif /* NDEBUG */
+
+void coro_t::charge_run_time() {
+    rassert(usage_ != NULL);
+    const ticks_t now = get_ticks();
+    usage_->run_ticks += now - usage_resumed_at_;
+    usage_resumed_at_ = now;
+}
+
+trim_stack_while_waiting_t::trim_stack_while_waiting_t()
+    : coro(coro_t::self()), was_trimming(coro->trim_stack_on_wait_) {
+    rassert(coro != NULL, "Not in a coroutine context");
+    coro->trim_stack_on_wait_ = true;
+}
+
+trim_stack_while_waiting_t::~trim_stack_while_waiting_t() {
+    rassert(coro == coro_t::self());
+    coro->trim_stack_on_wait_ = was_trimming;
+}
@@ -22,6 +22,7 @@ const size_t MAX_COROUTINE_STACK_SIZE = 8*1024*1024;
 
 threadnum_t get_thread_id();
 struct coro_globals_t;
+struct resource_usage_t;
 
 
 struct coro_profiler_mixin_t {
@@ -194,6 +195,9 @@ private:
 
     friend class coro_profiler_t;
     friend struct coro_globals_t;
+    friend class trim_stack_while_waiting_t;
+    friend class charge_resource_usage_t;
+    friend resource_usage_t *current_resource_usage();
     ~coro_t();
 
     virtual void on_thread_switch();
@@ -206,6 +210,15 @@ private:
     bool notified_;
     bool waiting_;
 
+    // Set by `trim_stack_while_waiting_t`.
+    bool trim_stack_on_wait_;
+
+    // Set by `charge_resource_usage_t`.  While it's non-NULL, the time between
+    // `usage_resumed_at_` and the next time we switch out is charged to it.
+    resource_usage_t *usage_;
+    ticks_t usage_resumed_at_;
+    void charge_run_time();
+
     callable_action_wrapper_t action_wrapper;
 
 #ifndef NDEBUG
@@ -226,6 +239,21 @@ private:
 bool is_coroutine_stack_overflow(void *addr);
 bool coroutines_have_been_initialized();
 
+/* While one of these exists, the current coroutine's stack is trimmed every time the
+coroutine waits: the pages below its stack pointer, which deeper calls touched
+before, are given back to the operating system.  Use it around waits that can last
+very long, such as idle client connections waiting for their next query, so that
+thousands of them don't hold on to stack memory they're not using. */
+class trim_stack_while_waiting_t {
+public:
+    trim_stack_while_waiting_t();
+    ~trim_stack_while_waiting_t();
+private:
+    coro_t *const coro;
+    const bool was_trimming;
+    DISABLE_COPYING(trim_stack_while_waiting_t);
+};
+
 class home_coro_mixin_t {
 private:
     coro_t *home_coro;
@@ -15,6 +15,23 @@ perfmon_duration_sampler_t *pm_eventloop_singleton_t::get() {
     return &pm_eventloop;
 }
 
+perfmon_rate_monitor_t *pm_eventloop_singleton_t::get_wakeups() {
+    static perfmon_rate_monitor_t pm_wakeups(secs_to_ticks(1));
+    static perfmon_membership_t pm_wakeups_membership(
+        &get_global_perfmon_collection(), &pm_wakeups, "eventloop_wakeups_per_sec");
+    return &pm_wakeups;
+}
+
+static int64_t event_loop_busy_poll = 0;
+
+void set_event_loop_busy_poll(int64_t microseconds) {
+    event_loop_busy_poll = microseconds;
+}
+
+int64_t get_event_loop_busy_poll() {
+    return event_loop_busy_poll;
+}
+
 std::string format_poll_event(int event) {
     std::string s;
     if (event & poll_event_in) {
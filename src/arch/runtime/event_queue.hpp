@@ -25,8 +25,18 @@ std::string format_poll_event(int event);
 // by the constructor of `perfmon_membership_t`.
 struct pm_eventloop_singleton_t {
     static perfmon_duration_sampler_t *get();
+    // How often the event loop wakes up after going to sleep.
+    static perfmon_rate_monitor_t *get_wakeups();
 };
 
+/* If `microseconds` isn't zero, each thread's event loop spins for that long, looking
+for events and for messages from other threads, before it goes to sleep. That burns
+CPU time on idle threads, but saves the latency of putting a thread to sleep and
+waking it up again. Only the epoll queue supports it. Call this before starting the
+thread pool. */
+void set_event_loop_busy_poll(int64_t microseconds);
+int64_t get_event_loop_busy_poll();
+
 /* Pick the queue now*/
 #if defined(__MACH__)
 
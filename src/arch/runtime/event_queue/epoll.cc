@@ -53,13 +53,36 @@ epoll_event_queue_t::epoll_event_queue_t(linux_queue_parent_t *_parent)
     guarantee_err(epoll_fd >= 0, "Could not create epoll fd");
 }
 
+int epoll_event_queue_t::busy_poll(ticks_t duration, bool *got_messages_out) {
+    const ticks_t deadline = get_ticks() + duration;
+    parent->begin_busy_poll();
+    int res;
+    do {
+        res = epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, 0);
+        if (res != 0 || parent->has_pending_messages()) {
+            break;
+        }
+    } while (get_ticks() < deadline);
+    *got_messages_out = parent->end_busy_poll();
+    return res;
+}
+
 void epoll_event_queue_t::run() {
     int res;
+    const ticks_t busy_poll_duration = get_event_loop_busy_poll() * THOUSAND;
 
     // Now, start the loop
     while (!parent->should_shut_down()) {
-        // Grab the events from the kernel!
-        res = epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, -1);
+        bool got_messages = false;
+        res = 0;
+        if (busy_poll_duration != 0) {
+            res = busy_poll(busy_poll_duration, &got_messages);
+        }
+        if (res == 0 && !got_messages) {
+            // Grab the events from the kernel!
+            res = epoll_wait(epoll_fd, events, MAX_IO_EVENT_PROCESSING_BATCH_SIZE, -1);
+            pm_eventloop_singleton_t::get_wakeups()->record();
+        }
 
         // epoll_wait might return with EINTR in some cases (in
         // particular under GDB), we just need to retry.
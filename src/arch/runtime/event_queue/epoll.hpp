@@ -11,6 +11,7 @@
 #include "arch/runtime/event_queue_types.hpp"
 #include "arch/runtime/runtime_utils.hpp"
 #include "config/args.hpp"
+#include "time.hpp"
 
 // Event queue structure
 struct epoll_event_queue_t {
@@ -26,6 +27,11 @@ public:
     void forget_resource(fd_t resource, linux_event_callback_t *cb);
 
 private:
+    /* Spins for up to `duration` looking for events without sleeping. Returns what
+    `epoll_wait()` returned the last time, and sets `*got_messages_out` if it handled
+    messages from other threads instead. */
+    int busy_poll(ticks_t duration, bool *got_messages_out);
+
     linux_queue_parent_t *parent;
 
     fd_t epoll_fd;
@@ -15,6 +15,14 @@ struct linux_event_callback_t {
 struct linux_queue_parent_t {
     virtual void pump() = 0;
     virtual bool should_shut_down() = 0;
+
+    /* While the event queue busy polls, messages from other threads don't wake it
+    up, so it has to ask about them with `has_pending_messages()`. `end_busy_poll()`
+    handles the messages that arrived, and returns true if there were any. */
+    virtual void begin_busy_poll() = 0;
+    virtual bool has_pending_messages() = 0;
+    virtual bool end_busy_poll() = 0;
+
     virtual ~linux_queue_parent_t() {}
 };
 
@@ -0,0 +1,65 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "arch/runtime/memory_tags.hpp"
+
+#include "arch/runtime/coro_sampler.hpp"
+#include "perfmon/perfmon.hpp"
+#include "utils.hpp"
+
+const char *memory_tag_name(memory_tag_t tag) {
+    switch (tag) {
+    case memory_tag_t::page_cache: return "page_cache";
+    case memory_tag_t::datum_buffers: return "datum_buffers";
+    case memory_tag_t::changefeed_queues: return "changefeed_queues";
+    case memory_tag_t::disk_backed_queues: return "disk_backed_queues";
+    case memory_tag_t::mailbox_buffers: return "mailbox_buffers";
+    case memory_tag_t::coroutine_stacks: return "coroutine_stacks";
+    default: unreachable();
+    }
+}
+
+// See the comment above `pm_active_coroutines` in coroutines.cc about why these
+// have to be defined at namespace scope.
+static perfmon_counter_t pm_tagged_memory[NUM_MEMORY_TAGS];
+static perfmon_collection_t pm_memory_collection;
+static perfmon_membership_t pm_memory_membership(
+    &get_global_perfmon_collection(), &pm_memory_collection, "memory");
+static perfmon_multi_membership_t pm_tagged_memory_membership(&pm_memory_collection,
+    &pm_tagged_memory[static_cast<int>(memory_tag_t::page_cache)],
+    "page_cache_bytes",
+    &pm_tagged_memory[static_cast<int>(memory_tag_t::datum_buffers)],
+    "datum_buffers_bytes",
+    &pm_tagged_memory[static_cast<int>(memory_tag_t::changefeed_queues)],
+    "changefeed_queues_bytes",
+    &pm_tagged_memory[static_cast<int>(memory_tag_t::disk_backed_queues)],
+    "disk_backed_queues_bytes",
+    &pm_tagged_memory[static_cast<int>(memory_tag_t::mailbox_buffers)],
+    "mailbox_buffers_bytes",
+    &pm_tagged_memory[static_cast<int>(memory_tag_t::coroutine_stacks)],
+    "coroutine_stacks_bytes");
+
+NOINLINE void count_tagged_memory(memory_tag_t tag, int64_t bytes) {
+    pm_tagged_memory[static_cast<int>(tag)] += bytes;
+    if (bytes > 0 && coro_sampler_t::get_allocation_sample_interval() != 0) {
+        coro_sampler_t::get_global_sampler().record_allocation(tag, bytes, 1);
+    }
+}
+
+tagged_memory_t::tagged_memory_t(memory_tag_t tag, int64_t bytes)
+    : tag_(tag), bytes_(0) {
+    add(bytes);
+}
+
+tagged_memory_t::~tagged_memory_t() {
+    set(0);
+}
+
+void tagged_memory_t::add(int64_t bytes) {
+    if (bytes != 0) {
+        bytes_ += bytes;
+        count_tagged_memory(tag_, bytes);
+    }
+}
+
+void tagged_memory_t::set(int64_t bytes) {
+    add(bytes - bytes_);
+}
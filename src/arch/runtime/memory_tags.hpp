@@ -0,0 +1,59 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_MEMORY_TAGS_HPP_
+#define ARCH_RUNTIME_MEMORY_TAGS_HPP_
+
+#include <stdint.h>
+
+#include "errors.hpp"
+
+/* The big consumers of memory, whose usage we keep track of so that growth of the
+process's memory can be attributed to one of them. The byte counts show up under
+`memory` in the global perfmon collection, and in the `memory` field of the
+server rows of the `stats` table. They are what the consumers think they hold, not
+what the allocator has handed out for them, so allocator overhead and
+fragmentation aren't included. */
+enum class memory_tag_t {
+    // Pages held by the caches of the tables (including compressed copies of
+    // evicted pages).
+    page_cache = 0,
+    // The buffers that serialized `datum_t`s point into.
+    datum_buffers,
+    // Changes that changefeed subscriptions haven't handed out yet.
+    changefeed_queues,
+    // The in-memory pages of the caches behind `disk_backed_queue_t`s.
+    disk_backed_queues,
+    // Incoming mailbox messages, and the buffers that are pooled for them.
+    mailbox_buffers,
+    // The stacks of the allocated coroutines, as reserved (not as touched).
+    coroutine_stacks
+};
+
+static const int NUM_MEMORY_TAGS = 6;
+
+const char *memory_tag_name(memory_tag_t tag);
+
+/* Counts `bytes` (which are negative when memory is freed) towards `tag`. If the
+`coro_sampler_t`'s allocation sampling is on, allocations may record a sample of the
+stack that made them. May be called on any thread; memory may be freed on a
+different thread than the one it was counted on. */
+void count_tagged_memory(memory_tag_t tag, int64_t bytes);
+
+/* Keeps `count_tagged_memory()` up to date with a size that changes over time, and
+uncounts whatever is left when it is destroyed. */
+class tagged_memory_t {
+public:
+    explicit tagged_memory_t(memory_tag_t tag, int64_t bytes = 0);
+    ~tagged_memory_t();
+
+    void add(int64_t bytes);
+    void set(int64_t bytes);
+    int64_t bytes() const { return bytes_; }
+
+private:
+    const memory_tag_t tag_;
+    int64_t bytes_;
+
+    DISABLE_COPYING(tagged_memory_t);
+};
+
+#endif  // ARCH_RUNTIME_MEMORY_TAGS_HPP_
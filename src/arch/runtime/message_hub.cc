@@ -8,6 +8,7 @@
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/thread_pool.hpp"
 #include "logger.hpp"
+#include "perfmon/perfmon.hpp"
 #include "utils.hpp"
 
 // Set this to 1 if you would like some "unordered" messages to be unordered.
@@ -15,13 +16,39 @@
 #define RDB_RELOOP_MESSAGES 0
 #endif
 
+// Like `pm_eventloop_singleton_t`, these are initialized on first use.
+struct pm_message_hub_singleton_t {
+    pm_message_hub_singleton_t()
+        : messages_received(secs_to_ticks(1)),
+          notifications(secs_to_ticks(1)),
+          membership(&get_global_perfmon_collection(), &collection, "message_hub"),
+          collection_membership(&collection,
+              &messages_received, "messages_received_per_sec",
+              &notifications, "notify") { }
+
+    static pm_message_hub_singleton_t *get() {
+        static pm_message_hub_singleton_t pm;
+        return &pm;
+    }
+
+    perfmon_collection_t collection;
+    perfmon_rate_monitor_t messages_received;
+    perfmon_duration_sampler_t notifications;
+    perfmon_membership_t membership;
+    perfmon_multi_membership_t collection_membership;
+};
+
 linux_message_hub_t::linux_message_hub_t(linux_event_queue_t *queue,
                                          linux_thread_pool_t *thread_pool,
                                          threadnum_t current_thread)
     : queue_(queue),
       thread_pool_(thread_pool),
       is_woken_up_(false),
+      is_busy_polling_(false),
       current_thread_(current_thread) {
+    for (int i = 0; i <= EXTERNAL_INCOMING; ++i) {
+        incoming_[i].value = NULL;
+    }
 
 #ifndef NDEBUG
     if(MESSAGE_SCHEDULER_GRANULARITY < (1 << (NUM_SCHEDULER_PRIORITIES))) {
@@ -44,7 +71,9 @@ linux_message_hub_t::~linux_message_hub_t() {
         guarantee(get_priority_msg_list(p).empty());
     }
 
-    guarantee(incoming_messages_.empty());
+    for (int i = 0; i <= EXTERNAL_INCOMING; ++i) {
+        guarantee(incoming_[i].value == NULL);
+    }
 }
 
 void linux_message_hub_t::do_store_message(threadnum_t nthread, linux_thread_message_t *msg) {
@@ -91,15 +120,75 @@ void linux_message_hub_t::store_message_sometime(threadnum_t nthread, linux_thre
 
 
 void linux_message_hub_t::insert_external_message(linux_thread_message_t *msg) {
-    bool do_wake_up;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        do_wake_up = !check_and_set_is_woken_up();
-        incoming_messages_.push_back(msg);
+    msg_list_t list;
+    list.push_back(msg);
+    push_incoming(this, &incoming_[EXTERNAL_INCOMING].value, &list);
+}
+
+void linux_message_hub_t::push_incoming(linux_message_hub_t *target,
+                                        linux_thread_message_t **incoming,
+                                        msg_list_t *list) {
+    // Link the messages newest first.
+    linux_thread_message_t *oldest = list->head();
+    linux_thread_message_t *newest = NULL;
+    while (linux_thread_message_t *m = list->head()) {
+        list->remove(m);
+        m->next_incoming = newest;
+        newest = m;
+    }
+    rassert(oldest != NULL);
+
+    linux_thread_message_t *old_head;
+    do {
+        old_head = __atomic_load_n(incoming, __ATOMIC_RELAXED);
+        oldest->next_incoming = old_head;
+    } while (!__sync_bool_compare_and_swap(incoming, old_head, newest));
+
+    // If the queue wasn't empty, whoever pushed onto it when it was has made sure
+    // that `target` will look at it again.
+    if (old_head == NULL) {
+        target->wake_up();
     }
+}
 
+void linux_message_hub_t::begin_busy_poll() {
+    // If `is_woken_up_` was already set, `event_` has been notified and `on_event()`
+    // will take care of the messages.
+    is_busy_polling_ = !__atomic_exchange_n(&is_woken_up_.value, true, __ATOMIC_SEQ_CST);
+}
+
+bool linux_message_hub_t::has_incoming_messages() const {
+    for (int i = 0; i <= EXTERNAL_INCOMING; ++i) {
+        if (i == thread_pool_->n_threads) {
+            i = EXTERNAL_INCOMING;
+        }
+        if (__atomic_load_n(&incoming_[i].value, __ATOMIC_RELAXED) != NULL) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool linux_message_hub_t::end_busy_poll() {
+    if (!is_busy_polling_) {
+        return false;
+    }
+    is_busy_polling_ = false;
+
+    // Senders that push after this will notify `event_`, so we only have to worry
+    // about the ones that pushed before. This is the same dance as in
+    // `sort_incoming_messages_by_priority()`.
+    __atomic_store_n(&is_woken_up_.value, false, __ATOMIC_SEQ_CST);
+    if (!has_incoming_messages()) {
+        return false;
+    }
+    process_messages();
+    return true;
+}
+
+void linux_message_hub_t::wake_up() {
     // Wakey wakey eggs and bakey
-    if (do_wake_up) {
+    if (!__atomic_exchange_n(&is_woken_up_.value, true, __ATOMIC_SEQ_CST)) {
         event_.wakey_wakey();
     }
 }
@@ -119,6 +208,10 @@ void linux_message_hub_t::on_event(int events) {
     // up and so that poll-based event triggering doesn't infinite-loop.
     event_.consume_wakey_wakeys();
 
+    process_messages();
+}
+
+void linux_message_hub_t::process_messages() {
     // Sort incoming messages into the respective priority_msg_lists_
     sort_incoming_messages_by_priority();
 
@@ -175,31 +268,47 @@ void linux_message_hub_t::on_event(int events) {
             // Place wakey_wakey and then yield to the event processing.
             // It will wake us up again immediately, but can handle a few
             // OS events (such as timers, network messages etc.) in the meantime.
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&incoming_messages_lock_);
-                do_wake_up = !check_and_set_is_woken_up();
-            }
-            if (do_wake_up) {
-                event_.wakey_wakey();
-            }
+            wake_up();
             break;
         }
     }
 }
 
 void linux_message_hub_t::sort_incoming_messages_by_priority() {
-    // We do this in two steps to release the spinlock faster.
-    // append_and_clear is a very cheap operation, while
-    // assigning each message to a different priority queue
-    // is more expensive.
+    // Senders that push after this will wake us up again.  This has to come before
+    // we look at the queues, see `push_incoming`.
+    __atomic_store_n(&is_woken_up_.value, false, __ATOMIC_SEQ_CST);
 
     // 1. Pull the messages
     msg_list_t new_messages;
-    {
-        spinlock_acq_t acq(&incoming_messages_lock_);
-        new_messages.append_and_clear(&incoming_messages_);
-        is_woken_up_ = false;
+    size_t num_new_messages = 0;
+    for (int i = 0; i <= EXTERNAL_INCOMING; ++i) {
+        if (i == thread_pool_->n_threads) {
+            i = EXTERNAL_INCOMING;
+        }
+        if (__atomic_load_n(&incoming_[i].value, __ATOMIC_RELAXED) == NULL) {
+            continue;
+        }
+        linux_thread_message_t *newest =
+            __atomic_exchange_n(&incoming_[i].value, NULL, __ATOMIC_ACQ_REL);
+        // Reverse the stack, so its messages come oldest first.
+        linux_thread_message_t *oldest = NULL;
+        while (newest != NULL) {
+            linux_thread_message_t *next = newest->next_incoming;
+            newest->next_incoming = oldest;
+            oldest = newest;
+            newest = next;
+        }
+        while (oldest != NULL) {
+            linux_thread_message_t *next = oldest->next_incoming;
+            oldest->next_incoming = NULL;
+            new_messages.push_back(oldest);
+            oldest = next;
+            ++num_new_messages;
+        }
+    }
+    if (num_new_messages != 0) {
+        pm_message_hub_singleton_t::get()->messages_received.record(num_new_messages);
     }
 
     // 2. Sort the messages into their respective priority queues
@@ -218,12 +327,6 @@ void linux_message_hub_t::sort_incoming_messages_by_priority() {
     }
 }
 
-bool linux_message_hub_t::check_and_set_is_woken_up() {
-    const bool was_woken_up = is_woken_up_;
-    is_woken_up_ = true;
-    return was_woken_up;
-}
-
 // Pushes messages collected locally global lists available to all
 // threads.
 void linux_message_hub_t::push_messages() {
@@ -233,23 +336,12 @@ void linux_message_hub_t::push_messages() {
         thread_queue_t *queue = &queues_[i];
         if (!queue->msg_local_list.empty()) {
             // Transfer messages to the other core
-
-            bool do_wake_up;
-            {
-                spinlock_acq_t acq(&thread_pool_->threads[i]->message_hub.incoming_messages_lock_);
-
-                // We only need to do a wake up if we're the first people to do a
-                // wake up.
-                do_wake_up =
-                    !thread_pool_->threads[i]->message_hub.check_and_set_is_woken_up();
-
-                thread_pool_->threads[i]->message_hub.incoming_messages_.append_and_clear(&queue->msg_local_list);
-            }
-
-            // Wakey wakey, perhaps eggs and bakey
-            if (do_wake_up) {
-                thread_pool_->threads[i]->message_hub.event_.wakey_wakey();
-            }
+            block_pm_duration notify_timer(
+                &pm_message_hub_singleton_t::get()->notifications);
+            linux_message_hub_t *target = &thread_pool_->threads[i]->message_hub;
+            push_incoming(target,
+                          &target->incoming_[current_thread_.threadnum].value,
+                          &queue->msg_local_list);
         }
     }
 }
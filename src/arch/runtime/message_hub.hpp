@@ -8,7 +8,7 @@
 #include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/runtime_utils.hpp"
 #include "arch/runtime/system_event.hpp"
-#include "arch/spinlock.hpp"
+#include "concurrency/cache_line_padded.hpp"
 #include "config/args.hpp"
 #include "containers/intrusive_list.hpp"
 #include "threading.hpp"
@@ -49,6 +49,14 @@ public:
     // (which does not have an event queue)
     void insert_external_message(linux_thread_message_t *msg);
 
+    /* While the event queue busy polls, `begin_busy_poll()` keeps senders from
+    notifying `event_`, since nobody is asleep to be woken up. The event queue checks
+    `has_incoming_messages()` instead, and `end_busy_poll()` processes the messages
+    that arrived and returns true if there were any. */
+    void begin_busy_poll();
+    bool has_incoming_messages() const;
+    bool end_busy_poll();
+
     ~linux_message_hub_t();
 
 private:
@@ -56,7 +64,17 @@ private:
     // debug mode.
     void do_store_message(threadnum_t nthread, linux_thread_message_t *msg);
 
-    // Moves messages from incoming_messages_ into the respective entries of
+    // Pushes the messages of `list` onto `*incoming` and wakes up `target` if
+    // needed.  Safe to call from any thread.
+    static void push_incoming(linux_message_hub_t *target,
+                              linux_thread_message_t **incoming,
+                              msg_list_t *list);
+
+    // Wakes us up unless we already have a wake up pending.  Safe to call from any
+    // thread.
+    void wake_up();
+
+    // Moves messages from incoming_ into the respective entries of
     // priority_msg_lists, depending on the messages' priorities.
     void sort_incoming_messages_by_priority();
 
@@ -74,11 +92,19 @@ private:
         msg_list_t msg_local_list;
     } queues_[MAX_THREADS];
 
-    // Must only be used with acquired incoming_messages_lock_
-    bool check_and_set_is_woken_up();
-    bool is_woken_up_;
-    msg_list_t incoming_messages_;
-    spinlock_t incoming_messages_lock_;
+    /* Messages for this thread, with one queue for each thread that sends them and
+    one more for external messages (`EXTERNAL_INCOMING`).  Each queue is a stack that
+    senders push whole batches of messages onto with a compare-and-swap, newest
+    message first, linked through `linux_thread_message_t::next_incoming`.  We pop
+    all of them at once and reverse them, so the messages from each sender stay in
+    order.  They are padded so that senders don't bounce each other's cache lines.
+    */
+    static const int EXTERNAL_INCOMING = MAX_THREADS;
+    cache_line_padded_t<linux_thread_message_t *> incoming_[MAX_THREADS + 1];
+
+    // Whether `event_` has been notified since we last looked at `incoming_`, so
+    // senders of batches only notify it once.  Only accessed atomically.
+    cache_line_padded_t<bool> is_woken_up_;
 
     // Use `sort_incoming_messages_by_priority()` to sort incoming_messages_ into
     // these lists.
@@ -90,8 +116,15 @@ private:
 
     void on_event(int events);
 
+    // Processes (some of) the messages that are waiting for us.
+    void process_messages();
+
+    // True between `begin_busy_poll()` and `end_busy_poll()`, unless `event_` had
+    // already been notified when we started.
+    bool is_busy_polling_;
+
     // The eventfd (or pipe-based alternative) notified after the first incoming
-    // message is put onto incoming_messages_.
+    // message is put onto incoming_.
     system_event_t event_;
 
     /* The thread that we queue messages originating from. (Recall that there is one
@@ -0,0 +1,66 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "arch/runtime/resource_usage.hpp"
+
+#include "arch/runtime/coroutines.hpp"
+
+resource_usage_t::resource_usage_t()
+    : run_ticks(0),
+      blocks_from_cache(0),
+      blocks_from_disk(0),
+      bytes_read(0),
+      bytes_written(0),
+      rows_scanned(0),
+      rows_returned(0),
+      shard_requests(0),
+      datum_bytes_allocated(0) { }
+
+void resource_usage_t::add(const resource_usage_t &other) {
+    run_ticks += other.run_ticks;
+    blocks_from_cache += other.blocks_from_cache;
+    blocks_from_disk += other.blocks_from_disk;
+    bytes_read += other.bytes_read;
+    bytes_written += other.bytes_written;
+    rows_scanned += other.rows_scanned;
+    rows_returned += other.rows_returned;
+    shard_requests += other.shard_requests;
+    datum_bytes_allocated += other.datum_bytes_allocated;
+}
+
+RDB_IMPL_SERIALIZABLE_9_FOR_CLUSTER(resource_usage_t,
+                                    run_ticks,
+                                    blocks_from_cache,
+                                    blocks_from_disk,
+                                    bytes_read,
+                                    bytes_written,
+                                    rows_scanned,
+                                    rows_returned,
+                                    shard_requests,
+                                    datum_bytes_allocated);
+
+charge_resource_usage_t::charge_resource_usage_t(resource_usage_t *usage)
+    : coro(usage != NULL ? coro_t::self() : NULL),
+      previous(coro != NULL ? coro->usage_ : NULL) {
+    if (usage == NULL) {
+        return;
+    }
+    rassert(coro != NULL, "Not in a coroutine context");
+    if (previous != NULL) {
+        coro->charge_run_time();
+    }
+    coro->usage_ = usage;
+    coro->usage_resumed_at_ = get_ticks();
+}
+
+charge_resource_usage_t::~charge_resource_usage_t() {
+    if (coro == NULL) {
+        return;
+    }
+    rassert(coro == coro_t::self());
+    coro->charge_run_time();
+    coro->usage_ = previous;
+}
+
+resource_usage_t *current_resource_usage() {
+    coro_t *coro = coro_t::self();
+    return coro == NULL ? NULL : coro->usage_;
+}
@@ -0,0 +1,64 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef ARCH_RUNTIME_RESOURCE_USAGE_HPP_
+#define ARCH_RUNTIME_RESOURCE_USAGE_HPP_
+
+#include <stdint.h>
+
+#include "containers/archive/archive.hpp"
+#include "errors.hpp"
+#include "rpc/serialize_macros.hpp"
+#include "time.hpp"
+
+class coro_t;
+
+/* What a piece of work, such as a query, has used so far.  The coroutine running it
+charges the time it spends running (as opposed to waiting) to it while a
+`charge_resource_usage_t` exists; the other fields are counted by the layers that
+know about them, through `current_resource_usage()`.
+
+Coroutines don't inherit the charged usage from the coroutine that spawned them, so
+work that is handed off to other coroutines is only accounted for if whoever hands
+it off sets up a `charge_resource_usage_t` there, too. */
+struct resource_usage_t {
+    resource_usage_t();
+
+    void add(const resource_usage_t &other);
+
+    ticks_t run_ticks;
+    // Blocks that were already in memory when they were acquired, and blocks that
+    // we had to wait for to be loaded.
+    uint64_t blocks_from_cache;
+    uint64_t blocks_from_disk;
+    // The sizes of the blocks that were read and written.
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    // Documents that were looked at on the shards, and values that were sent back
+    // to the client.
+    uint64_t rows_scanned;
+    uint64_t rows_returned;
+    // Reads and writes that were sent to the shards.
+    uint64_t shard_requests;
+    // The sizes of the buffers that were allocated for datums.  This counts what
+    // was allocated, not what is held at any one time.
+    uint64_t datum_bytes_allocated;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(resource_usage_t);
+
+/* Charges the current coroutine's running time, and whatever `current_resource_usage()`
+is used for, to `usage` until it is destroyed.  The coroutine's previous usage (if
+any) is not charged for that time, and is restored afterwards.  Does nothing if
+`usage` is NULL. */
+class charge_resource_usage_t {
+public:
+    explicit charge_resource_usage_t(resource_usage_t *usage);
+    ~charge_resource_usage_t();
+private:
+    coro_t *const coro;
+    resource_usage_t *const previous;
+    DISABLE_COPYING(charge_resource_usage_t);
+};
+
+// The usage the current coroutine is charging to, or NULL if there is none.
+resource_usage_t *current_resource_usage();
+
+#endif  // ARCH_RUNTIME_RESOURCE_USAGE_HPP_
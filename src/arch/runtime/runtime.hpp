@@ -11,6 +11,11 @@ threadnum_t get_thread_id();
 
 int get_num_threads();
 
+// The NUMA node a thread is pinned to, and how many there are.  Unless the thread
+// pool was started with NUMA-aware placement, everything is on node 0.
+int get_thread_numa_node(threadnum_t thread);
+int get_num_numa_nodes();
+
 #ifndef NDEBUG
 void assert_good_thread_id(threadnum_t thread);
 #else
@@ -1,8 +1,14 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "arch/runtime/runtime_utils.hpp"
 
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 
+#include <map>
+#include <string>
+
 #include "arch/runtime/context_switching.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "logger.hpp"
@@ -12,6 +18,82 @@ int get_cpu_count() {
     return sysconf(_SC_NPROCESSORS_ONLN);
 }
 
+// Parses a sysfs CPU list like "0-7,16-23".
+std::vector<int> parse_cpu_list(const std::string &list) {
+    std::vector<int> cpus;
+    const char *p = list.c_str();
+    while (*p != '\0' && *p != '\n') {
+        char *end;
+        const long first = strtol(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            ++p;
+            last = strtol(p, &end, 10);
+            if (end == p) {
+                break;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+        if (*p == ',') {
+            ++p;
+        }
+    }
+    return cpus;
+}
+
+std::vector<std::vector<int> > get_numa_node_cpus() {
+    const char *const node_dir = "/sys/devices/system/node";
+
+    // Node numbers can have gaps, so we list the directory.
+    std::map<int, std::vector<int> > cpus_by_node;
+    DIR *dir = opendir(node_dir);
+    if (dir != NULL) {
+        // No other thread reads `dir`, so readdir is safe here.
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {  // NOLINT(runtime/threadsafe_fn)
+            int node;
+            char trailing;
+            if (sscanf(entry->d_name, "node%d%c", &node, &trailing) != 1) {
+                continue;
+            }
+            const std::string path
+                = std::string(node_dir) + "/" + entry->d_name + "/cpulist";
+            FILE *file = fopen(path.c_str(), "r");
+            if (file == NULL) {
+                continue;
+            }
+            char buf[4096];
+            if (fgets(buf, sizeof(buf), file) != NULL) {
+                std::vector<int> cpus = parse_cpu_list(buf);
+                if (!cpus.empty()) {
+                    cpus_by_node[node] = std::move(cpus);
+                }
+            }
+            fclose(file);
+        }
+        closedir(dir);
+    }
+
+    std::vector<std::vector<int> > ret;
+    for (auto &&pair : cpus_by_node) {
+        ret.push_back(std::move(pair.second));
+    }
+    if (ret.empty()) {
+        ret.push_back(std::vector<int>());
+        for (int cpu = 0; cpu < get_cpu_count(); ++cpu) {
+            ret[0].push_back(cpu);
+        }
+    }
+    return ret;
+}
+
 callable_action_wrapper_t::callable_action_wrapper_t() :
     action_on_heap(false),
     action_(NULL)
@@ -5,6 +5,8 @@
 #include <signal.h>
 #include <stdint.h>
 
+#include <vector>
+
 #include "config/args.hpp"
 #include "containers/intrusive_list.hpp"
 
@@ -15,14 +17,16 @@ class linux_thread_message_t : public intrusive_list_node_t<linux_thread_message
 public:
     explicit linux_thread_message_t(int _priority)
         : priority(_priority),
-        is_ordered(false)
+        is_ordered(false),
+        next_incoming(NULL)
 #ifndef NDEBUG
         , reloop_count_(0)
 #endif
         { }
     linux_thread_message_t()
         : priority(MESSAGE_SCHEDULER_DEFAULT_PRIORITY),
-        is_ordered(false)
+        is_ordered(false),
+        next_incoming(NULL)
 #ifndef NDEBUG
         , reloop_count_(0)
 #endif
@@ -37,6 +41,8 @@ private:
     friend class linux_message_hub_t;
     int priority;
     bool is_ordered; // Used internally by the message hub
+    // Links the message into the receiving message hub's lock-free queues.
+    linux_thread_message_t *next_incoming;
 #ifndef NDEBUG
     int reloop_count_;
 #endif
@@ -46,6 +52,10 @@ typedef linux_thread_message_t thread_message_t;
 
 int get_cpu_count();
 
+// The online CPUs of each NUMA node, read from sysfs.  Without NUMA information (on
+// non-NUMA kernels, say) this returns a single node that has all the CPUs.
+std::vector<std::vector<int> > get_numa_node_cpus();
+
 // More pollution of runtime_utils.hpp.
 #ifndef NDEBUG
 
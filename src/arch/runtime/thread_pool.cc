@@ -7,6 +7,9 @@
 #include <unistd.h>
 #include <sys/time.h>
 
+#include <utility>
+#include <vector>
+
 #include "arch/barrier.hpp"
 #include "arch/os_signal.hpp"
 #include "arch/io/timer_provider.hpp"
@@ -49,12 +52,18 @@ linux_thread_pool_t::linux_thread_pool_t(int worker_threads, bool _do_set_affini
 #endif
       interrupt_message(NULL),
       generic_blocker_pool(NULL),
+      dns_blocker_pool(NULL),
       n_threads(worker_threads + 1),    // we create an extra utility thread
-      do_set_affinity(_do_set_affinity)
+      do_set_affinity(_do_set_affinity),
+      n_numa_nodes(1)
 {
     rassert(n_threads > 1);             // we want at least one non-utility thread
     rassert(n_threads <= MAX_THREADS);
 
+    for (int i = 0; i < n_threads; ++i) {
+        numa_nodes[i] = 0;
+    }
+
     int res;
 
     res = pthread_cond_init(&shutdown_cond, NULL);
@@ -111,6 +120,7 @@ void *linux_thread_pool_t::start_thread(void *arg) {
         tdata->thread_pool->threads[tdata->current_thread] = &local_thread;
         set_thread(&local_thread);
         blocker_pool_t *generic_blocker_pool = NULL; // Will only be instantiated by one thread
+        blocker_pool_t *dns_blocker_pool = NULL;
 
         /* Install a handler for segmentation faults that just prints a backtrace. If we're
         running under valgrind, we don't install this handler because Valgrind will print the
@@ -132,12 +142,15 @@ void *linux_thread_pool_t::start_thread(void *arg) {
 
 #endif  // VALGRIND
 
-        // First thread should initialize generic_blocker_pool before the start barrier
+        // First thread should initialize the blocker pools before the start barrier
         if (tdata->initial_message) {
             rassert(tdata->thread_pool->generic_blocker_pool == NULL, "generic_blocker_pool already initialized");
             generic_blocker_pool = new blocker_pool_t(GENERIC_BLOCKER_THREAD_COUNT,
                                                       &local_thread.queue);
             tdata->thread_pool->generic_blocker_pool = generic_blocker_pool;
+            dns_blocker_pool = new blocker_pool_t(DNS_BLOCKER_THREAD_COUNT,
+                                                  &local_thread.queue);
+            tdata->thread_pool->dns_blocker_pool = dns_blocker_pool;
         }
 
         // If one thread is allowed to run before another one has finished
@@ -163,11 +176,15 @@ void *linux_thread_pool_t::start_thread(void *arg) {
         free(segv_stack.ss_sp);
 #endif
 
-        // If this thread created the generic blocker pool, clean it up
+        // If this thread created the blocker pools, clean them up
         if (generic_blocker_pool != NULL) {
             delete generic_blocker_pool;
             tdata->thread_pool->generic_blocker_pool = NULL;
         }
+        if (dns_blocker_pool != NULL) {
+            delete dns_blocker_pool;
+            tdata->thread_pool->dns_blocker_pool = NULL;
+        }
 
         tdata->thread_pool->threads[tdata->current_thread] = NULL;
         set_thread(NULL);
@@ -186,6 +203,28 @@ void linux_thread_pool_t::enable_coroutine_summary() {
 void linux_thread_pool_t::run_thread_pool(linux_thread_message_t *initial_message) {
     do_shutdown = false;
 
+    // The CPU for each thread, if we set affinity.  Threads get consecutive CPUs,
+    // node by node, spread evenly over all CPUs, so that threads with neighbouring
+    // ids share a NUMA node, and each node gets its share of the threads.
+    std::vector<int> thread_cpus;
+    if (do_set_affinity) {
+        const std::vector<std::vector<int> > node_cpus = get_numa_node_cpus();
+        std::vector<std::pair<int, int> > cpus;  // (node, cpu)
+        for (size_t node = 0; node < node_cpus.size(); ++node) {
+            for (int cpu : node_cpus[node]) {
+                cpus.push_back(std::make_pair(static_cast<int>(node), cpu));
+            }
+        }
+        guarantee(!cpus.empty());
+        n_numa_nodes = node_cpus.size();
+        for (int i = 0; i < n_threads; i++) {
+            const std::pair<int, int> &cpu
+                = cpus[static_cast<int64_t>(i) * cpus.size() / n_threads];
+            numa_nodes[i] = cpu.first;
+            thread_cpus.push_back(cpu.second);
+        }
+    }
+
     // Start child threads
     thread_barrier_t barrier(n_threads + 1);
 
@@ -197,21 +236,29 @@ void linux_thread_pool_t::run_thread_pool(linux_thread_message_t *initial_messag
         // The initial message gets sent to thread zero.
         tdata->initial_message = (i == 0) ? initial_message : NULL;
 
-        int res = pthread_create(&pthreads[i], NULL, &start_thread, tdata);
-        guarantee_xerr(res == 0, res, "Could not create thread");
+        pthread_attr_t attr;
+        int res = pthread_attr_init(&attr);
+        guarantee_xerr(res == 0, res, "Could not initialize thread attributes");
 
         if (do_set_affinity) {
             // On Apple, the thread affinity API has awful documentation, so we don't even bother.
 #ifdef _GNU_SOURCE
-            // Distribute threads evenly among CPUs
-            int ncpus = get_cpu_count();
+            // We pin the thread before it starts running, so that its event queue,
+            // its coroutine stacks and the caches it allocates all get first touched
+            // -- and thus placed -- on its own NUMA node.
             cpu_set_t mask;
             CPU_ZERO(&mask);
-            CPU_SET(i % ncpus, &mask);
-            res = pthread_setaffinity_np(pthreads[i], sizeof(cpu_set_t), &mask);
+            CPU_SET(thread_cpus[i], &mask);
+            res = pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &mask);
             guarantee_xerr(res == 0, res, "Could not set thread affinity");
 #endif
         }
+
+        res = pthread_create(&pthreads[i], &attr, &start_thread, tdata);
+        guarantee_xerr(res == 0, res, "Could not create thread");
+
+        res = pthread_attr_destroy(&attr);
+        guarantee_xerr(res == 0, res, "Could not destroy thread attributes");
     }
 
     // Mark the main thread (for use in assertions etc.)
@@ -409,6 +456,18 @@ void linux_thread_t::pump() {
     message_hub.push_messages();
 }
 
+void linux_thread_t::begin_busy_poll() {
+    message_hub.begin_busy_poll();
+}
+
+bool linux_thread_t::has_pending_messages() {
+    return message_hub.has_incoming_messages();
+}
+
+bool linux_thread_t::end_busy_poll() {
+    return message_hub.end_busy_poll();
+}
+
 void linux_thread_t::on_event(int events) {
     // No-op. This is just to make sure that the event queue wakes up
     // so it can shut down.
@@ -14,6 +14,7 @@
 #include "arch/runtime/coroutines.hpp"
 #include "arch/io/blocker_pool.hpp"
 #include "arch/io/timer_provider.hpp"
+#include "arch/spinlock.hpp"
 #include "arch/timer.hpp"
 
 class linux_thread_t;
@@ -81,6 +82,15 @@ private:
     static const int GENERIC_BLOCKER_THREAD_COUNT = 2;
     blocker_pool_t* generic_blocker_pool;
 
+    // The threads that run `getaddrinfo()`. They're separate from the generic blocker
+    // pool so that a burst of slow DNS lookups can't hold up file I/O, and vice versa.
+    static const int DNS_BLOCKER_THREAD_COUNT = 2;
+    blocker_pool_t* dns_blocker_pool;
+
+    template <class Callable>
+    static void run_in_blocker_pool_internal(blocker_pool_t *linux_thread_pool_t::*pool,
+                                             const Callable &);
+
 public:
     pthread_t pthreads[MAX_THREADS];
     linux_thread_t *threads[MAX_THREADS];
@@ -89,9 +99,18 @@ public:
     template <class Callable>
     static void run_in_blocker_pool(const Callable &);
 
+    // Like `run_in_blocker_pool()`, but for DNS lookups
+    template <class Callable>
+    static void run_in_dns_blocker_pool(const Callable &);
+
     int n_threads;
     bool do_set_affinity;
 
+    // The NUMA node of each thread's CPU, if do_set_affinity is set.  Otherwise all
+    // threads count as being on node 0, and n_numa_nodes is 1.
+    int numa_nodes[MAX_THREADS];
+    int n_numa_nodes;
+
     // Non-inlinable getters and setters for the thread local variables.
     // See thread_local.hpp for an explanation of why these must not be
     // inlined.
@@ -134,15 +153,28 @@ struct generic_job_t :
 // This should be used for any calls that cannot otherwise be made non-blocking
 template <class Callable>
 void linux_thread_pool_t::run_in_blocker_pool(const Callable &fn)
+{
+    run_in_blocker_pool_internal(&linux_thread_pool_t::generic_blocker_pool, fn);
+}
+
+template <class Callable>
+void linux_thread_pool_t::run_in_dns_blocker_pool(const Callable &fn)
+{
+    run_in_blocker_pool_internal(&linux_thread_pool_t::dns_blocker_pool, fn);
+}
+
+template <class Callable>
+void linux_thread_pool_t::run_in_blocker_pool_internal(
+        blocker_pool_t *linux_thread_pool_t::*pool, const Callable &fn)
 {
     if (get_thread_pool() != NULL) {
         generic_job_t<Callable> job;
         job.fn = &fn;
         job.suspended = coro_t::self();
 
-        rassert(get_thread_pool()->generic_blocker_pool != NULL,
-                "thread_pool_t::run_in_blocker_pool called while generic_thread_pool uninitialized");
-        get_thread_pool()->generic_blocker_pool->do_job(&job);
+        rassert(get_thread_pool()->*pool != NULL,
+                "thread_pool_t::run_in_blocker_pool called while the blocker pool is uninitialized");
+        (get_thread_pool()->*pool)->do_job(&job);
 
         // Give up execution, to be resumed when the done callback is made
         coro_t::wait();
@@ -170,6 +202,9 @@ public:
 
     void pump();   // Called by the event queue
     bool should_shut_down();   // Called by the event queue
+    void begin_busy_poll();   // Called by the event queue
+    bool has_pending_messages();   // Called by the event queue
+    bool end_busy_poll();   // Called by the event queue
 #ifndef NDEBUG
     void initiate_shut_down(std::map<std::string, size_t> *coroutine_counts); // Can be called from any thread
 #else
@@ -1,15 +1,26 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "arch/timer.hpp"
 
+#include <stddef.h>
+
+#include <algorithm>
+#include <limits>
+
 #include "arch/runtime/thread_pool.hpp"
 #include "time.hpp"
 #include "utils.hpp"
 
-class timer_token_t : public intrusive_priority_queue_node_t<timer_token_t> {
+// The width of a slot on the finest level of the wheel. Timers that are due within the current
+// tick go straight into the priority queue.
+static const int64_t WHEEL_TICK_NANOS = 16 * MILLION;
+
+class timer_token_t : public intrusive_priority_queue_node_t<timer_token_t>,
+                      public intrusive_list_node_t<timer_token_t> {
     friend class timer_handler_t;
 
 private:
-    timer_token_t() : interval_nanos(-1), next_time_in_nanos(-1), callback(NULL) { }
+    timer_token_t()
+        : interval_nanos(-1), next_time_in_nanos(-1), callback(NULL), wheel_slot(NULL) { }
 
     friend bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *right);
 
@@ -22,6 +33,9 @@ private:
     // The callback we call upon each 'ring'.
     timer_callback_t *callback;
 
+    // The wheel slot the token is in, or `NULL` if it's in the priority queue.
+    intrusive_list_t<timer_token_t> *wheel_slot;
+
     DISABLE_COPYING(timer_token_t);
 };
 
@@ -31,12 +45,21 @@ bool left_is_higher_priority(const timer_token_t *left, const timer_token_t *rig
 
 timer_handler_t::timer_handler_t(linux_event_queue_t *queue)
     : timer_provider(queue),
-      expected_oneshot_time_in_nanos(0) {
+      expected_oneshot_time_in_nanos(0),
+      scheduled_oneshot_time_in_nanos(-1),
+      wheel_size(0),
+      wheel_time_in_nanos(0),
+      next_wheel_time_in_nanos(std::numeric_limits<int64_t>::max()) {
+    static_assert(WHEEL_SLOTS == 64, "wheel_occupancy needs a bit for every slot");
+    for (int level = 0; level < WHEEL_LEVELS; ++level) {
+        wheel_occupancy[level] = 0;
+    }
     // Right now, we have no tokens.  So we don't ask the timer provider to do anything for us.
 }
 
 timer_handler_t::~timer_handler_t() {
     guarantee(token_queue.empty());
+    guarantee(wheel_size == 0);
 }
 
 void timer_handler_t::on_oneshot() {
@@ -46,6 +69,11 @@ void timer_handler_t::on_oneshot() {
     int64_t real_ticks = get_ticks();
     int64_t ticks = std::max(real_ticks, expected_oneshot_time_in_nanos);
 
+    scheduled_oneshot_time_in_nanos = -1;
+
+    // Move the timers from the wheel slots we've reached into the priority queue.
+    advance_wheel(ticks);
+
     while (!token_queue.empty() && token_queue.peek()->next_time_in_nanos <= ticks) {
         timer_token_t *token = token_queue.pop();
 
@@ -53,7 +81,7 @@ void timer_handler_t::on_oneshot() {
         // may be canceled).
         if (token->interval_nanos != 0) {
             token->next_time_in_nanos = real_ticks + token->interval_nanos;
-            token_queue.push(token);
+            insert_token(token);
         }
 
         token->callback->on_timer();
@@ -65,8 +93,121 @@ void timer_handler_t::on_oneshot() {
     }
 
     // We've processed young tokens.  Now schedule a new one-shot (if necessary).
+    schedule_oneshot_if_earlier();
+}
+
+void timer_handler_t::insert_token(timer_token_t *token) {
+    const int64_t current_tick = wheel_time_in_nanos / WHEEL_TICK_NANOS;
+    int64_t slot_number = token->next_time_in_nanos / WHEEL_TICK_NANOS;
+    if (slot_number <= current_tick) {
+        token_queue.push(token);
+        return;
+    }
+
+    // Find the finest level that reaches far enough. Timers that are too far away for the
+    // coarsest level go into its last slot, and get put back into the wheel from there.
+    int level = 0;
+    int64_t current_slot_number = current_tick;
+    while (slot_number - current_slot_number >= WHEEL_SLOTS) {
+        if (level == WHEEL_LEVELS - 1) {
+            slot_number = current_slot_number + WHEEL_SLOTS - 1;
+            break;
+        }
+        ++level;
+        slot_number >>= WHEEL_SLOT_BITS;
+        current_slot_number >>= WHEEL_SLOT_BITS;
+    }
+
+    const int index = slot_number & (WHEEL_SLOTS - 1);
+    token->wheel_slot = &wheel[level][index];
+    token->wheel_slot->push_back(token);
+    wheel_occupancy[level] |= static_cast<uint64_t>(1) << index;
+    ++wheel_size;
+
+    const int64_t slot_time_in_nanos =
+        (slot_number << (level * WHEEL_SLOT_BITS)) * WHEEL_TICK_NANOS;
+    next_wheel_time_in_nanos = std::min(next_wheel_time_in_nanos, slot_time_in_nanos);
+}
+
+void timer_handler_t::remove_from_wheel(timer_token_t *token) {
+    intrusive_list_t<timer_token_t> *slot = token->wheel_slot;
+    slot->remove(token);
+    token->wheel_slot = NULL;
+    --wheel_size;
+
+    if (slot->empty()) {
+        const ptrdiff_t offset = slot - &wheel[0][0];
+        wheel_occupancy[offset / WHEEL_SLOTS] &=
+            ~(static_cast<uint64_t>(1) << (offset % WHEEL_SLOTS));
+    }
+}
+
+void timer_handler_t::advance_wheel(int64_t ticks) {
+    while (next_wheel_time_in_nanos <= ticks) {
+        wheel_time_in_nanos = next_wheel_time_in_nanos;
+        const int64_t current_tick = wheel_time_in_nanos / WHEEL_TICK_NANOS;
+
+        // Coarser levels go first, because their timers may end up in a finer slot that starts
+        // at the same time.
+        for (int level = WHEEL_LEVELS - 1; level >= 0; --level) {
+            const int shift = level * WHEEL_SLOT_BITS;
+            if ((current_tick & ((static_cast<int64_t>(1) << shift) - 1)) != 0) {
+                continue;
+            }
+            const int index = (current_tick >> shift) & (WHEEL_SLOTS - 1);
+            intrusive_list_t<timer_token_t> due;
+            due.append_and_clear(&wheel[level][index]);
+            wheel_occupancy[level] &= ~(static_cast<uint64_t>(1) << index);
+            wheel_size -= due.size();
+            while (timer_token_t *token = due.head()) {
+                due.pop_front();
+                token->wheel_slot = NULL;
+                insert_token(token);
+            }
+        }
+
+        next_wheel_time_in_nanos = compute_next_wheel_time();
+    }
+
+    // Nothing is due before `next_wheel_time_in_nanos`, so we can skip ahead to the current tick.
+    wheel_time_in_nanos = std::max(wheel_time_in_nanos, ticks - ticks % WHEEL_TICK_NANOS);
+}
+
+int64_t timer_handler_t::compute_next_wheel_time() const {
+    const int64_t current_tick = wheel_time_in_nanos / WHEEL_TICK_NANOS;
+    int64_t next_time_in_nanos = std::numeric_limits<int64_t>::max();
+    for (int level = 0; level < WHEEL_LEVELS; ++level) {
+        const uint64_t occupancy = wheel_occupancy[level];
+        if (occupancy == 0) {
+            continue;
+        }
+        // Rotate the occupancy bits so that bit 0 is the slot after the current one.
+        const int shift = level * WHEEL_SLOT_BITS;
+        const int64_t current_slot_number = current_tick >> shift;
+        const int rotation = (current_slot_number + 1) & (WHEEL_SLOTS - 1);
+        const uint64_t rotated = rotation == 0
+            ? occupancy
+            : (occupancy >> rotation) | (occupancy << (WHEEL_SLOTS - rotation));
+        const int64_t slot_number = current_slot_number + 1 + __builtin_ctzll(rotated);
+        next_time_in_nanos = std::min(next_time_in_nanos,
+                                      (slot_number << shift) * WHEEL_TICK_NANOS);
+    }
+    return next_time_in_nanos;
+}
+
+void timer_handler_t::schedule_oneshot_if_earlier() {
+    int64_t next_time_in_nanos = next_wheel_time_in_nanos;
     if (!token_queue.empty()) {
-        timer_provider.schedule_oneshot(token_queue.peek()->next_time_in_nanos, this);
+        next_time_in_nanos = std::min(next_time_in_nanos,
+                                      token_queue.peek()->next_time_in_nanos);
+    }
+    if (next_time_in_nanos == std::numeric_limits<int64_t>::max()) {
+        return;
+    }
+    if (scheduled_oneshot_time_in_nanos == -1
+        || next_time_in_nanos < scheduled_oneshot_time_in_nanos) {
+        timer_provider.schedule_oneshot(next_time_in_nanos, this);
+        scheduled_oneshot_time_in_nanos = next_time_in_nanos;
     }
 }
 
@@ -74,29 +215,34 @@ timer_token_t *timer_handler_t::add_timer_internal(const int64_t ms, timer_callb
     const int64_t nanos = ms * MILLION;
     rassert(nanos > 0);
 
-    const int64_t next_time_in_nanos = get_ticks() + nanos;
+    const int64_t now = get_ticks();
+    const int64_t next_time_in_nanos = now + nanos;
 
     timer_token_t *const token = new timer_token_t;
     token->interval_nanos = once ? 0 : nanos;
     token->next_time_in_nanos = next_time_in_nanos;
     token->callback = callback;
 
-    const timer_token_t *top_entry = token_queue.peek();
-    token_queue.push(token);
-
-    if (top_entry == NULL || next_time_in_nanos < top_entry->next_time_in_nanos) {
-        timer_provider.schedule_oneshot(next_time_in_nanos, this);
-    }
+    // Catch the wheel up first, so that the new token goes into a slot that's still ahead.
+    advance_wheel(now);
+    insert_token(token);
+    schedule_oneshot_if_earlier();
 
     return token;
 }
 
 void timer_handler_t::cancel_timer(timer_token_t *token) {
-    token_queue.remove(token);
+    if (token->wheel_slot != NULL) {
+        remove_from_wheel(token);
+    } else {
+        token_queue.remove(token);
+    }
     delete token;
 
-    if (token_queue.empty()) {
+    if (token_queue.empty() && wheel_size == 0) {
         timer_provider.unschedule_oneshot();
+        scheduled_oneshot_time_in_nanos = -1;
+        next_wheel_time_in_nanos = std::numeric_limits<int64_t>::max();
     }
 }
 
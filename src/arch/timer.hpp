@@ -2,6 +2,9 @@
 #ifndef ARCH_TIMER_HPP_
 #define ARCH_TIMER_HPP_
 
+#include <stdint.h>
+
+#include "containers/intrusive_list.hpp"
 #include "containers/intrusive_priority_queue.hpp"
 #include "arch/io/timer_provider.hpp"
 
@@ -14,7 +17,14 @@ struct timer_callback_t {
 
 /* This timer class uses the underlying OS timer provider to get one-shot timing events. It then
  * manages a list of application timers based on that lower level interface. Everyone who needs a
- * timer should use this class (through the thread pool). */
+ * timer should use this class (through the thread pool).
+ *
+ * Most timers (query timeouts, heartbeats, batch deadlines) get canceled long before they would
+ * fire, so only the timers that are due within the current wheel tick are kept in the priority
+ * queue. Everything else goes into a hierarchical timing wheel, where adding and canceling a
+ * timer is O(1). Level `k` of the wheel has `WHEEL_SLOTS` slots, each `WHEEL_SLOTS^k` ticks
+ * wide. When the wheel reaches a slot, its timers are moved into the priority queue if they are
+ * due within the tick, or into a finer level otherwise, so timers still fire precisely. */
 class timer_handler_t : private timer_provider_callback_t {
 public:
     explicit timer_handler_t(linux_event_queue_t *queue);
@@ -24,8 +34,24 @@ public:
     void cancel_timer(timer_token_t *timer);
 
 private:
+    static const int WHEEL_LEVELS = 4;
+    static const int WHEEL_SLOT_BITS = 6;
+    static const int WHEEL_SLOTS = 1 << WHEEL_SLOT_BITS;
+
     void on_oneshot();
 
+    // Puts `token` into the priority queue or the wheel, depending on how soon it is due.
+    void insert_token(timer_token_t *token);
+    void remove_from_wheel(timer_token_t *token);
+
+    // Processes every wheel slot that starts at or before `ticks`.
+    void advance_wheel(int64_t ticks);
+    int64_t compute_next_wheel_time() const;
+
+    // Asks the timer provider for a oneshot at the time of the next queued timer or wheel slot,
+    // unless one is already scheduled for that time or earlier.
+    void schedule_oneshot_if_earlier();
+
     // The timer provider, a platform-dependent typedef for interfacing with the OS.
     timer_provider_t timer_provider;
 
@@ -33,9 +59,25 @@ private:
     // time, we pretend that it had arrived on time.
     int64_t expected_oneshot_time_in_nanos;
 
-    // A priority queue of timer tokens, ordered by the soonest.
+    // The time for which we've asked the timer provider for a oneshot, or -1 if we haven't.
+    int64_t scheduled_oneshot_time_in_nanos;
+
+    // A priority queue of the timer tokens that are due within the current wheel tick, ordered
+    // by the soonest.
     intrusive_priority_queue_t<timer_token_t> token_queue;
 
+    // The timing wheel. `wheel_occupancy[k]` has bit `i` set iff `wheel[k][i]` is non-empty.
+    intrusive_list_t<timer_token_t> wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+    uint64_t wheel_occupancy[WHEEL_LEVELS];
+    size_t wheel_size;
+
+    // The start of the wheel tick we've processed the wheel up to.
+    int64_t wheel_time_in_nanos;
+
+    // The start of the earliest non-empty wheel slot. This may be too early after a timer was
+    // canceled (which then costs us a spurious oneshot), but it's never too late.
+    int64_t next_wheel_time_in_nanos;
+
     DISABLE_COPYING(timer_handler_t);
 };
 
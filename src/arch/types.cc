@@ -15,9 +15,21 @@ address_in_use_exc_t::address_in_use_exc_t(const char* hostname, int port) throw
     }
 }
 
-file_account_t::file_account_t(file_t *par, int pri, int outstanding_requests_limit) :
+const char *io_class_name(io_class_t io_class) {
+    switch (io_class) {
+    case io_class_t::foreground_read: return "foreground_read";
+    case io_class_t::backfill: return "backfill";
+    case io_class_t::flush: return "flush";
+    case io_class_t::gc: return "gc";
+    case io_class_t::other: return "other";
+    default: unreachable();
+    }
+}
+
+file_account_t::file_account_t(file_t *par, int pri, int outstanding_requests_limit,
+                               io_class_t io_class) :
     parent(par),
-    account(parent->create_account(pri, outstanding_requests_limit)) { }
+    account(parent->create_account(pri, outstanding_requests_limit, io_class)) { }
 
 file_account_t::~file_account_t() {
     parent->destroy_account(account);
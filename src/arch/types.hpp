@@ -87,6 +87,9 @@ typedef linux_nonthrowing_tcp_listener_t non_throwing_tcp_listener_t;
 class linux_tcp_listener_t;
 typedef linux_tcp_listener_t tcp_listener_t;
 
+class linux_per_thread_tcp_listener_t;
+typedef linux_per_thread_tcp_listener_t per_thread_tcp_listener_t;
+
 class linux_repeated_nonthrowing_tcp_listener_t;
 typedef linux_repeated_nonthrowing_tcp_listener_t repeated_nonthrowing_tcp_listener_t;
 
@@ -101,6 +104,14 @@ enum class file_direct_io_mode_t {
     buffered_desired
 };
 
+// Which mechanism the disk manager uses to run reads and writes.
+enum class io_backend_mode_t {
+    // Blocking syscalls on a pool of threads.
+    pool,
+    // io_uring, falling back to the thread pool if the kernel doesn't support it.
+    io_uring_desired
+};
+
 class semantic_checking_file_t {
 public:
     semantic_checking_file_t() { }
@@ -114,11 +125,27 @@ private:
     DISABLE_COPYING(semantic_checking_file_t);
 };
 
+// What an I/O account's operations are for, so that the disk stats can tell
+// foreground reads from background I/O.  The priority alone doesn't say, since
+// unrelated accounts share priorities.
+enum class io_class_t {
+    foreground_read = 0,
+    backfill,
+    flush,
+    gc,
+    other
+};
+static const int NUM_IO_CLASSES = static_cast<int>(io_class_t::other) + 1;
+const char *io_class_name(io_class_t io_class);
+
 // A linux file.  It expects reads and writes and buffers to have an
 // alignment of DEVICE_BLOCK_SIZE.
 class file_t {
 public:
-    enum wrap_in_datasyncs_t { NO_DATASYNCS, WRAP_IN_DATASYNCS };
+    // `DATASYNC_AFTER` only syncs once the write itself has completed. It's for
+    // writes that are safe to reorder with the writes before them, because the
+    // reader can tell whether those made it to disk.
+    enum wrap_in_datasyncs_t { NO_DATASYNCS, WRAP_IN_DATASYNCS, DATASYNC_AFTER };
 
     file_t() { }
 
@@ -136,7 +163,8 @@ public:
     virtual void writev_async(int64_t offset, size_t length, scoped_array_t<iovec> &&bufs,
                               file_account_t *account, linux_iocallback_t *cb) = 0;
 
-    virtual void *create_account(int priority, int outstanding_requests_limit) = 0;
+    virtual void *create_account(int priority, int outstanding_requests_limit,
+                                 io_class_t io_class) = 0;
     virtual void destroy_account(void *account) = 0;
 
     virtual bool coop_lock_and_check() = 0;
@@ -147,7 +175,9 @@ private:
 
 class file_account_t {
 public:
-    file_account_t(file_t *f, int p, int outstanding_requests_limit = UNLIMITED_OUTSTANDING_REQUESTS);
+    file_account_t(file_t *f, int p,
+                   int outstanding_requests_limit = UNLIMITED_OUTSTANDING_REQUESTS,
+                   io_class_t io_class = io_class_t::other);
     ~file_account_t();
     void *get_account() { return account; }
 
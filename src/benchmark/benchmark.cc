@@ -0,0 +1,224 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "benchmark/benchmark.hpp"
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+#include "utils.hpp"
+
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+
+static std::atomic<int64_t> allocations(0);
+
+static void *counted_malloc(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == NULL) {
+        crash_oom();
+    }
+    return ptr;
+}
+
+void *operator new(size_t size) {
+    return counted_malloc(size);
+}
+
+void *operator new[](size_t size) {
+    return counted_malloc(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    free(ptr);
+}
+
+#endif  // BENCHMARK_COUNT_ALLOCATIONS
+
+namespace benchmark {
+
+int64_t allocation_count() {
+#ifdef BENCHMARK_COUNT_ALLOCATIONS
+    return allocations.load(std::memory_order_relaxed);
+#else
+    return -1;
+#endif
+}
+
+// We stop growing the iteration count there, so that benchmarks of empty loops
+// finish.
+static const int64_t MAX_ITERATIONS = 1000 * MILLION;
+
+state_t::state_t(int64_t iterations)
+    : iterations_(iterations),
+      done_(0),
+      bytes_per_iteration_(0),
+      items_per_iteration_(0),
+      start_ticks_(0),
+      pause_started_ticks_(0),
+      paused_ticks_(0),
+      elapsed_ticks_(0),
+      start_allocations_(0),
+      pause_started_allocations_(0),
+      paused_allocations_(0),
+      allocations_(0),
+      last_ticks_(0) {
+    guarantee(iterations_ > 0);
+}
+
+void state_t::record_latencies() {
+    guarantee(done_ == 0);
+    latencies_.init(new latency_histogram_t());
+}
+
+void state_t::pause_timing() {
+    guarantee(done_ > 0 && pause_started_ticks_ == 0);
+    pause_started_ticks_ = get_ticks();
+    pause_started_allocations_ = allocation_count();
+}
+
+void state_t::resume_timing() {
+    guarantee(pause_started_ticks_ != 0);
+    const ticks_t paused = get_ticks() - pause_started_ticks_;
+    paused_ticks_ += paused;
+    // The paused time doesn't count towards the current iteration's latency either.
+    last_ticks_ += paused;
+    paused_allocations_ += allocation_count() - pause_started_allocations_;
+    pause_started_ticks_ = 0;
+}
+
+ticks_t state_t::elapsed_ticks() const {
+    guarantee(done_ == iterations_,
+              "The benchmark returned without running its loop to the end.");
+    return std::max<ticks_t>(elapsed_ticks_, 1);
+}
+
+int64_t state_t::allocations() const {
+    guarantee(done_ == iterations_,
+              "The benchmark returned without running its loop to the end.");
+    return allocation_count() < 0 ? -1 : allocations_;
+}
+
+static std::vector<benchmark_t> *benchmarks = NULL;
+
+registration_t::registration_t(const char *group, const char *name,
+                               benchmark_fun_t fun, int num_threads) {
+    // Registrations run during static initialization, in no particular order, so
+    // the list can't be a plain static object.
+    if (benchmarks == NULL) {
+        benchmarks = new std::vector<benchmark_t>();
+    }
+    benchmark_t benchmark;
+    benchmark.name = strprintf("%s.%s", group, name);
+    benchmark.fun = fun;
+    benchmark.num_threads = num_threads;
+    benchmarks->push_back(benchmark);
+}
+
+const std::vector<benchmark_t> &all_benchmarks() {
+    static const std::vector<benchmark_t> empty;
+    return benchmarks == NULL ? empty : *benchmarks;
+}
+
+struct run_t {
+    ticks_t elapsed_ticks;
+    int64_t bytes_per_iteration;
+    int64_t items_per_iteration;
+    int64_t allocations;
+    latency_histogram_t latencies;
+    bool has_latencies;
+};
+
+static void run_once(const benchmark_t &benchmark, int64_t iterations, run_t *out) {
+    state_t state(iterations);
+    benchmark.fun(&state);
+    out->elapsed_ticks = state.elapsed_ticks();
+    out->bytes_per_iteration = state.bytes_per_iteration();
+    out->items_per_iteration = state.items_per_iteration();
+    out->allocations = state.allocations();
+    out->has_latencies = state.latencies() != NULL;
+    if (out->has_latencies) {
+        out->latencies.merge(*state.latencies());
+    }
+}
+
+result_t run_benchmark(const benchmark_t &benchmark, ticks_t min_time_ticks,
+                       int repetitions) {
+    guarantee(repetitions > 0);
+
+    // Grow the iteration count the way Go's testing package does: aim for the
+    // minimum time with some headroom, but never grow by more than 100x at once,
+    // since the first runs are dominated by cold caches.
+    int64_t iterations = 1;
+    for (;;) {
+        run_t run;
+        run_once(benchmark, iterations, &run);
+        const ticks_t elapsed = run.elapsed_ticks;
+        if (elapsed >= min_time_ticks || iterations >= MAX_ITERATIONS) {
+            break;
+        }
+        const double predicted = 1.2 * static_cast<double>(iterations)
+            * static_cast<double>(min_time_ticks) / static_cast<double>(elapsed);
+        iterations = std::min<int64_t>(
+            std::max<int64_t>(static_cast<int64_t>(predicted), iterations + 1),
+            std::min<int64_t>(iterations * 100, MAX_ITERATIONS));
+    }
+
+    // The latencies of all the repetitions go into one histogram.
+    run_t run;
+    std::vector<double> ns_per_op;
+    int64_t allocations = 0;
+    for (int i = 0; i < repetitions; ++i) {
+        run_once(benchmark, iterations, &run);
+        ns_per_op.push_back(static_cast<double>(run.elapsed_ticks)
+                            / static_cast<double>(iterations));
+        allocations += run.allocations;
+    }
+    std::sort(ns_per_op.begin(), ns_per_op.end());
+
+    result_t result;
+    result.name = benchmark.name;
+    result.iterations = iterations;
+    result.ns_per_op_min = ns_per_op.front();
+    result.ns_per_op_median = ns_per_op[ns_per_op.size() / 2];
+    result.ns_per_op_max = ns_per_op.back();
+    // Bytes per nanosecond are gigabytes per second.
+    result.mb_per_sec = run.bytes_per_iteration == 0
+        ? 0
+        : run.bytes_per_iteration / result.ns_per_op_median * THOUSAND;
+    result.items_per_sec = run.items_per_iteration == 0
+        ? 0
+        : run.items_per_iteration / result.ns_per_op_median * BILLION;
+    const double items = static_cast<double>(iterations) * repetitions
+        * std::max<int64_t>(run.items_per_iteration, 1);
+    result.allocs_per_item = run.allocations < 0 ? -1 : allocations / items;
+    result.p99_ns = run.has_latencies ? run.latencies.percentile(0.99) : 0;
+    return result;
+}
+
+std::string results_to_json(const std::vector<result_t> &results) {
+    std::string json = "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const result_t &r = results[i];
+        json += strprintf("  {\"name\": \"%s\", \"iterations\": %" PRIi64 ", "
+                          "\"ns_per_op_min\": %.3f, \"ns_per_op_median\": %.3f, "
+                          "\"ns_per_op_max\": %.3f, \"mb_per_sec\": %.3f, "
+                          "\"items_per_sec\": %.3f, \"allocs_per_item\": %.3f, "
+                          "\"p99_ns\": %.3f}%s\n",
+                          r.name.c_str(), r.iterations,
+                          r.ns_per_op_min, r.ns_per_op_median, r.ns_per_op_max,
+                          r.mb_per_sec, r.items_per_sec, r.allocs_per_item,
+                          r.p99_ns,
+                          i + 1 == results.size() ? "" : ",");
+    }
+    json += "]\n";
+    return json;
+}
+
+}  // namespace benchmark
@@ -0,0 +1,174 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef BENCHMARK_BENCHMARK_HPP_
+#define BENCHMARK_BENCHMARK_HPP_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "errors.hpp"
+#include "containers/scoped.hpp"
+#include "perfmon/perfmon.hpp"
+#include "time.hpp"
+
+namespace benchmark {
+
+// The number of calls to `operator new` so far, on all threads, or -1 if the build
+// doesn't count them (see `BENCHMARK_COUNT_ALLOCATIONS` in `src/build.mk`).
+int64_t allocation_count();
+
+/* Handed to a benchmark each time it is run.  The benchmark sets up whatever it
+needs, then loops on `keep_running()` around the code it measures:
+
+    BENCHMARK(LeafNode, FindKey) {
+        ... set up a leaf node ...
+        while (state->keep_running()) {
+            leaf::find_key(node, key, &index);
+        }
+    }
+
+Only the time spent in the loop counts, and the runner picks how many iterations the
+loop runs for. */
+class state_t {
+public:
+    explicit state_t(int64_t iterations);
+
+    bool keep_running() {
+        if (done_ < iterations_) {
+            if (done_ == 0) {
+                start_ticks_ = get_ticks();
+                start_allocations_ = allocation_count();
+                last_ticks_ = start_ticks_;
+            } else if (latencies_.has()) {
+                record_latency();
+            }
+            ++done_;
+            return true;
+        }
+        if (elapsed_ticks_ == 0) {
+            elapsed_ticks_ = get_ticks() - start_ticks_ - paused_ticks_;
+            allocations_ = allocation_count() - start_allocations_ - paused_allocations_;
+            if (latencies_.has()) {
+                record_latency();
+            }
+        }
+        return false;
+    }
+
+    // Excludes the time between the two calls from the measurement, e.g. to reset
+    // state every so many iterations.  Both must be called from inside the loop.
+    void pause_timing();
+    void resume_timing();
+
+    // How many bytes one iteration processes, to report throughput as well.
+    void set_bytes_per_iteration(int64_t bytes) { bytes_per_iteration_ = bytes; }
+
+    // How many items (rows, documents) one iteration processes, to report items per
+    // second and allocations per item rather than per iteration.
+    void set_items_per_iteration(int64_t items) { items_per_iteration_ = items; }
+
+    // Times every iteration on its own, so that the results include the p99
+    // latency.  Costs two clock reads per iteration, so it only suits benchmarks
+    // whose iterations take microseconds.  Must be called before the loop.
+    void record_latencies();
+
+    int64_t iterations() const { return iterations_; }
+    int64_t bytes_per_iteration() const { return bytes_per_iteration_; }
+    int64_t items_per_iteration() const { return items_per_iteration_; }
+    ticks_t elapsed_ticks() const;
+    // Negative if the build doesn't count allocations.
+    int64_t allocations() const;
+    // NULL unless the benchmark called `record_latencies()`.
+    const latency_histogram_t *latencies() const { return latencies_.get_or_null(); }
+
+private:
+    void record_latency() {
+        const ticks_t now = get_ticks();
+        latencies_->record(now - last_ticks_);
+        last_ticks_ = now;
+    }
+
+    const int64_t iterations_;
+    int64_t done_;
+    int64_t bytes_per_iteration_;
+    int64_t items_per_iteration_;
+    ticks_t start_ticks_;
+    ticks_t pause_started_ticks_;
+    ticks_t paused_ticks_;
+    ticks_t elapsed_ticks_;
+    int64_t start_allocations_;
+    int64_t pause_started_allocations_;
+    int64_t paused_allocations_;
+    int64_t allocations_;
+    ticks_t last_ticks_;
+    scoped_ptr_t<latency_histogram_t> latencies_;
+
+    DISABLE_COPYING(state_t);
+};
+
+typedef void (*benchmark_fun_t)(state_t *state);
+
+struct benchmark_t {
+    std::string name;
+    benchmark_fun_t fun;
+    // How many threads the benchmark's thread pool has, or 0 if it runs outside of
+    // a thread pool.
+    int num_threads;
+};
+
+// Adds a benchmark to the list that `all_benchmarks()` returns.  Used by the macros
+// below, at static initialization time.
+class registration_t {
+public:
+    registration_t(const char *group, const char *name, benchmark_fun_t fun,
+                   int num_threads);
+};
+
+const std::vector<benchmark_t> &all_benchmarks();
+
+struct result_t {
+    std::string name;
+    int64_t iterations;
+    // Nanoseconds per iteration, over the repetitions.
+    double ns_per_op_min;
+    double ns_per_op_median;
+    double ns_per_op_max;
+    // Zero if the benchmark doesn't set the bytes per iteration.
+    double mb_per_sec;
+    // Zero if the benchmark doesn't set the items per iteration.
+    double items_per_sec;
+    // Per item if the benchmark sets the items per iteration, per iteration
+    // otherwise.  Negative if the build doesn't count allocations.
+    double allocs_per_item;
+    // Over all the repetitions.  Zero unless the benchmark records latencies.
+    double p99_ns;
+};
+
+// Finds an iteration count that makes the benchmark run for at least
+// `min_time_ticks`, then runs it `repetitions` more times with that count.
+result_t run_benchmark(const benchmark_t &benchmark, ticks_t min_time_ticks,
+                       int repetitions);
+
+// Formats the results as a JSON array with one object per benchmark.
+std::string results_to_json(const std::vector<result_t> &results);
+
+}  // namespace benchmark
+
+// Defines a benchmark that runs outside of a thread pool, for code that doesn't
+// need one (node layouts, serialization).
+#define BENCHMARK(group, name)                                            \
+    void benchmark_##group##_##name(::benchmark::state_t *state);         \
+    static ::benchmark::registration_t benchmark_registration_##group##_##name( \
+        #group, #name, &benchmark_##group##_##name, 0);                   \
+    void benchmark_##group##_##name(::benchmark::state_t *state)
+
+// Defines a benchmark that runs in a coroutine in a thread pool with the given
+// number of threads, like `TPTEST`.
+#define TPBENCHMARK(group, name, num_threads)                             \
+    void benchmark_##group##_##name(::benchmark::state_t *state);         \
+    static ::benchmark::registration_t benchmark_registration_##group##_##name( \
+        #group, #name, &benchmark_##group##_##name, num_threads);         \
+    void benchmark_##group##_##name(::benchmark::state_t *state)
+
+#endif  // BENCHMARK_BENCHMARK_HPP_
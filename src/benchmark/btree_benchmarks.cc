@@ -0,0 +1,167 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "benchmark/benchmark.hpp"
+#include "btree/internal_node.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
+#include "containers/scoped.hpp"
+#include "repli_timestamp.hpp"
+#include "utils.hpp"
+
+namespace benchmark {
+
+static const int NODE_BLOCK_SIZE = 4096;
+static const int VALUE_SIZE = 16;
+
+// Values are opaque blobs of `VALUE_SIZE` bytes, about the size of a blob reference
+// to a small document.
+class fixed_value_sizer_t : public value_sizer_t {
+public:
+    fixed_value_sizer_t() : block_size_(max_block_size_t::unsafe_make(NODE_BLOCK_SIZE)) { }
+
+    int size(const void *) const { return VALUE_SIZE; }
+
+    bool fits(const void *, int length_available) const {
+        return VALUE_SIZE <= length_available;
+    }
+
+    int max_possible_size() const { return VALUE_SIZE; }
+
+    block_magic_t btree_leaf_magic() const {
+        block_magic_t magic = { { 'b', 'm', 'L', 'F' } };
+        return magic;
+    }
+
+    max_block_size_t block_size() const { return block_size_; }
+
+private:
+    max_block_size_t block_size_;
+
+    DISABLE_COPYING(fixed_value_sizer_t);
+};
+
+// Keys that look like primary keys of a table with string ids.
+static store_key_t make_key(int i) {
+    return store_key_t(strprintf("S%08d-user", i));
+}
+
+// Fills a leaf node with as many keys as fit, in random order, and returns them.
+static std::vector<store_key_t> fill_leaf(fixed_value_sizer_t *sizer,
+                                          leaf_node_t *node) {
+    leaf::init(sizer, node);
+    std::vector<int> order;
+    for (int i = 0; i < NODE_BLOCK_SIZE; ++i) {
+        order.push_back(i);
+    }
+    std::random_shuffle(order.begin(), order.end());
+
+    char value[VALUE_SIZE];
+    memset(value, 'v', sizeof(value));
+    std::vector<store_key_t> keys;
+    for (int i : order) {
+        store_key_t key = make_key(i);
+        if (leaf::is_full(sizer, node, key.btree_key(), value)) {
+            break;
+        }
+        leaf::insert(sizer, node, key.btree_key(), value, repli_timestamp_t::distant_past,
+                     key_modification_proof_t::real_proof());
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+BENCHMARK(LeafNode, FindKey) {
+    fixed_value_sizer_t sizer;
+    scoped_malloc_t<leaf_node_t> node(NODE_BLOCK_SIZE);
+    std::vector<store_key_t> keys = fill_leaf(&sizer, node.get());
+
+    size_t i = 0;
+    int index;
+    while (state->keep_running()) {
+        leaf::find_key(node.get(), keys[i].btree_key(), &index);
+        i = (i + 1 == keys.size() ? 0 : i + 1);
+    }
+}
+
+BENCHMARK(LeafNode, FindKeyWithLookupIndex) {
+    fixed_value_sizer_t sizer;
+    scoped_malloc_t<leaf_node_t> node(NODE_BLOCK_SIZE);
+    std::vector<store_key_t> keys = fill_leaf(&sizer, node.get());
+    leaf::lookup_index_t lookup_index(node.get());
+
+    size_t i = 0;
+    int index;
+    while (state->keep_running()) {
+        lookup_index.find_key(node.get(), keys[i].btree_key(), &index);
+        i = (i + 1 == keys.size() ? 0 : i + 1);
+    }
+}
+
+BENCHMARK(LeafNode, Insert) {
+    fixed_value_sizer_t sizer;
+    scoped_malloc_t<leaf_node_t> node(NODE_BLOCK_SIZE);
+    std::vector<store_key_t> keys = fill_leaf(&sizer, node.get());
+    leaf::init(&sizer, node.get());
+
+    char value[VALUE_SIZE];
+    memset(value, 'w', sizeof(value));
+    size_t i = 0;
+    while (state->keep_running()) {
+        if (i == keys.size()) {
+            state->pause_timing();
+            leaf::init(&sizer, node.get());
+            i = 0;
+            state->resume_timing();
+        }
+        leaf::insert(&sizer, node.get(), keys[i].btree_key(), value,
+                     repli_timestamp_t::distant_past,
+                     key_modification_proof_t::real_proof());
+        ++i;
+    }
+}
+
+// Fills an internal node with as many keys as fit and returns them.
+static std::vector<store_key_t> fill_internal(internal_node_t *node) {
+    const block_size_t bs = block_size_t::unsafe_make(NODE_BLOCK_SIZE);
+    internal_node::init(bs, node);
+    std::vector<store_key_t> keys;
+    block_id_t next_id = 1;
+    for (int i = 0; i < NODE_BLOCK_SIZE; ++i) {
+        store_key_t key = make_key(i);
+        if (!internal_node::insert(node, key.btree_key(), next_id, next_id + 1)) {
+            break;
+        }
+        next_id += 2;
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+BENCHMARK(InternalNode, Lookup) {
+    scoped_malloc_t<internal_node_t> node(NODE_BLOCK_SIZE);
+    std::vector<store_key_t> keys = fill_internal(node.get());
+
+    size_t i = 0;
+    while (state->keep_running()) {
+        internal_node::lookup(node.get(), keys[i].btree_key());
+        i = (i + 1 == keys.size() ? 0 : i + 1);
+    }
+}
+
+BENCHMARK(InternalNode, LookupWithSearchIndex) {
+    scoped_malloc_t<internal_node_t> node(NODE_BLOCK_SIZE);
+    std::vector<store_key_t> keys = fill_internal(node.get());
+    internal_node::search_index_t search_index(node.get());
+
+    size_t i = 0;
+    while (state->keep_running()) {
+        internal_node::lookup(node.get(), keys[i].btree_key(), &search_index);
+        i = (i + 1 == keys.size() ? 0 : i + 1);
+    }
+}
+
+}  // namespace benchmark
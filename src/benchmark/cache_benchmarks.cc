@@ -0,0 +1,100 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <vector>
+
+#include "benchmark/benchmark.hpp"
+#include "buffer_cache/alt.hpp"
+#include "buffer_cache/cache_balancer.hpp"
+#include "config/args.hpp"
+#include "containers/scoped.hpp"
+#include "serializer/config.hpp"
+#include "unittest/mock_file.hpp"
+
+namespace benchmark {
+
+// A cache on top of a serializer that keeps its files in memory, so that loading
+// a block costs a copy rather than a disk read.
+struct mock_cache_t {
+    explicit mock_cache_t(uint64_t memory_limit) : balancer(memory_limit) {
+        standard_serializer_t::create(&opener,
+                                      standard_serializer_t::static_config_t());
+        ser.init(new standard_serializer_t(standard_serializer_t::dynamic_config_t(),
+                                           &opener,
+                                           &get_global_perfmon_collection()));
+        cache.init(new cache_t(ser.get(), &balancer, &get_global_perfmon_collection()));
+        cache_conn.init(new cache_conn_t(cache.get()));
+    }
+
+    // Creates `count` blocks and waits for them to be written, so that the cache
+    // may evict them.
+    std::vector<block_id_t> create_blocks(int count) {
+        std::vector<block_id_t> ids;
+        txn_t txn(cache_conn.get(), write_durability_t::HARD,
+                  repli_timestamp_t::distant_past, count);
+        for (int i = 0; i < count; ++i) {
+            buf_lock_t lock(buf_parent_t(&txn), alt_create_t::create);
+            buf_write_t write(&lock);
+            memset(write.get_data_write(), i % 256, cache->max_block_size().value());
+            ids.push_back(lock.block_id());
+        }
+        return ids;
+    }
+
+    unittest::mock_file_opener_t opener;
+    scoped_ptr_t<standard_serializer_t> ser;
+    dummy_cache_balancer_t balancer;
+    scoped_ptr_t<cache_t> cache;
+    scoped_ptr_t<cache_conn_t> cache_conn;
+};
+
+// Acquiring and releasing a block that is in memory, the cost that every btree
+// descent pays at every level.
+TPBENCHMARK(BufLock, AcquireRelease, 1) {
+    mock_cache_t mock(GIGABYTE);
+    const std::vector<block_id_t> ids = mock.create_blocks(256);
+
+    txn_t txn(mock.cache_conn.get(), read_access_t::read);
+    size_t i = 0;
+    while (state->keep_running()) {
+        buf_lock_t lock(buf_parent_t(&txn), ids[i], access_t::read);
+        buf_read_t read(&lock);
+        read.get_data_read();
+        i = (i + 1 == ids.size() ? 0 : i + 1);
+    }
+}
+
+TPBENCHMARK(BufLock, AcquireReleaseForWrite, 1) {
+    mock_cache_t mock(GIGABYTE);
+    const std::vector<block_id_t> ids = mock.create_blocks(256);
+
+    txn_t txn(mock.cache_conn.get(), write_durability_t::SOFT,
+              repli_timestamp_t::distant_past, 0);
+    size_t i = 0;
+    while (state->keep_running()) {
+        buf_lock_t lock(buf_parent_t(&txn), ids[i], access_t::write);
+        buf_write_t write(&lock);
+        write.get_data_write();
+        i = (i + 1 == ids.size() ? 0 : i + 1);
+    }
+}
+
+// Cycling through eight times as many blocks as fit in the cache, so that nearly
+// every acquisition loads a block and evicts another one.
+TPBENCHMARK(PageCache, Eviction, 1) {
+    const int cached_blocks = 128;
+    mock_cache_t mock(cached_blocks * DEFAULT_BTREE_BLOCK_SIZE);
+    const std::vector<block_id_t> ids = mock.create_blocks(8 * cached_blocks);
+    state->set_bytes_per_iteration(mock.cache->max_block_size().value());
+
+    size_t i = 0;
+    while (state->keep_running()) {
+        txn_t txn(mock.cache_conn.get(), read_access_t::read);
+        buf_lock_t lock(buf_parent_t(&txn), ids[i], access_t::read);
+        buf_read_t read(&lock);
+        read.get_data_read();
+        i = (i + 1 == ids.size() ? 0 : i + 1);
+    }
+}
+
+}  // namespace benchmark
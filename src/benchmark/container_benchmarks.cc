@@ -0,0 +1,104 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "benchmark/benchmark.hpp"
+#include "containers/flat_int_map.hpp"
+
+namespace benchmark {
+
+// The tables that these stand in for (mailboxes by id, queries by token) hold
+// integer keys handed out in sequence, a few hundred to a few thousand at a time.
+static const int64_t TABLE_SIZE = 1000;
+static const int64_t LOOKUPS = 1000;
+
+// Keys to look up, in an order that doesn't follow the table's layout.
+static std::vector<int64_t> lookup_keys() {
+    std::vector<int64_t> keys;
+    for (int64_t i = 0; i < LOOKUPS; ++i) {
+        keys.push_back((i * 7919) % TABLE_SIZE);
+    }
+    return keys;
+}
+
+BENCHMARK(IntMap, FlatFind) {
+    flat_int_map_t<int64_t, int64_t> map;
+    for (int64_t i = 0; i < TABLE_SIZE; ++i) {
+        map.insert(i, i);
+    }
+    const std::vector<int64_t> keys = lookup_keys();
+    state->set_items_per_iteration(LOOKUPS);
+    int64_t sum = 0;
+    while (state->keep_running()) {
+        for (int64_t key : keys) {
+            sum += *map.find(key);
+        }
+    }
+    guarantee(sum >= 0);
+}
+
+BENCHMARK(IntMap, StdMapFind) {
+    std::map<int64_t, int64_t> map;
+    for (int64_t i = 0; i < TABLE_SIZE; ++i) {
+        map[i] = i;
+    }
+    const std::vector<int64_t> keys = lookup_keys();
+    state->set_items_per_iteration(LOOKUPS);
+    int64_t sum = 0;
+    while (state->keep_running()) {
+        for (int64_t key : keys) {
+            sum += map.find(key)->second;
+        }
+    }
+    guarantee(sum >= 0);
+}
+
+BENCHMARK(IntMap, UnorderedMapFind) {
+    std::unordered_map<int64_t, int64_t> map;
+    for (int64_t i = 0; i < TABLE_SIZE; ++i) {
+        map[i] = i;
+    }
+    const std::vector<int64_t> keys = lookup_keys();
+    state->set_items_per_iteration(LOOKUPS);
+    int64_t sum = 0;
+    while (state->keep_running()) {
+        for (int64_t key : keys) {
+            sum += map.find(key)->second;
+        }
+    }
+    guarantee(sum >= 0);
+}
+
+// Registering and unregistering in sequence, as mailboxes and queries are.
+BENCHMARK(IntMap, FlatInsertErase) {
+    flat_int_map_t<int64_t, int64_t> map;
+    for (int64_t i = 0; i < TABLE_SIZE; ++i) {
+        map.insert(i, i);
+    }
+    state->set_items_per_iteration(LOOKUPS);
+    int64_t next = TABLE_SIZE;
+    while (state->keep_running()) {
+        for (int64_t i = 0; i < LOOKUPS; ++i, ++next) {
+            map.insert(next, next);
+            map.erase(next - TABLE_SIZE);
+        }
+    }
+}
+
+BENCHMARK(IntMap, StdMapInsertErase) {
+    std::map<int64_t, int64_t> map;
+    for (int64_t i = 0; i < TABLE_SIZE; ++i) {
+        map[i] = i;
+    }
+    state->set_items_per_iteration(LOOKUPS);
+    int64_t next = TABLE_SIZE;
+    while (state->keep_running()) {
+        for (int64_t i = 0; i < LOOKUPS; ++i, ++next) {
+            map[next] = next;
+            map.erase(next - TABLE_SIZE);
+        }
+    }
+}
+
+}  // namespace benchmark
@@ -0,0 +1,69 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <map>
+#include <vector>
+
+#include "benchmark/benchmark.hpp"
+#include "containers/archive/buffer_stream.hpp"
+#include "containers/archive/vector_stream.hpp"
+#include "rdb_protocol/configured_limits.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
+
+namespace benchmark {
+
+// A document like the ones a typical users table holds.
+static ql::datum_t make_document() {
+    std::map<datum_string_t, ql::datum_t> address;
+    address[datum_string_t("street")] = ql::datum_t(datum_string_t("1 Market Street"));
+    address[datum_string_t("city")] = ql::datum_t(datum_string_t("San Francisco"));
+    address[datum_string_t("zip")] = ql::datum_t(datum_string_t("94105"));
+
+    std::vector<ql::datum_t> tags;
+    tags.push_back(ql::datum_t(datum_string_t("admin")));
+    tags.push_back(ql::datum_t(datum_string_t("beta")));
+    tags.push_back(ql::datum_t(datum_string_t("newsletter")));
+
+    std::map<datum_string_t, ql::datum_t> doc;
+    doc[datum_string_t("id")] = ql::datum_t(datum_string_t("S00001234-user"));
+    doc[datum_string_t("name")] = ql::datum_t(datum_string_t("Ada Lovelace"));
+    doc[datum_string_t("age")] = ql::datum_t(36.0);
+    doc[datum_string_t("score")] = ql::datum_t(3.14159);
+    doc[datum_string_t("active")] = ql::datum_t::boolean(true);
+    doc[datum_string_t("tags")] =
+        ql::datum_t(std::move(tags), ql::configured_limits_t::unlimited);
+    doc[datum_string_t("address")] = ql::datum_t(std::move(address));
+    return ql::datum_t(std::move(doc));
+}
+
+static std::vector<char> serialize_to_vector(const ql::datum_t &datum) {
+    write_message_t wm;
+    datum_serialize(&wm, datum, ql::check_datum_serialization_errors_t::NO);
+    vector_stream_t stream;
+    int res = send_write_message(&stream, &wm);
+    guarantee(res == 0);
+    std::vector<char> ret;
+    stream.swap(&ret);
+    return ret;
+}
+
+BENCHMARK(Datum, Serialize) {
+    const ql::datum_t doc = make_document();
+    state->set_bytes_per_iteration(serialize_to_vector(doc).size());
+    while (state->keep_running()) {
+        write_message_t wm;
+        datum_serialize(&wm, doc, ql::check_datum_serialization_errors_t::NO);
+    }
+}
+
+BENCHMARK(Datum, Deserialize) {
+    const std::vector<char> serialized = serialize_to_vector(make_document());
+    state->set_bytes_per_iteration(serialized.size());
+    while (state->keep_running()) {
+        buffer_read_stream_t stream(serialized.data(), serialized.size());
+        ql::datum_t doc;
+        archive_result_t res = datum_deserialize(&stream, &doc);
+        guarantee_deserialization(res, "benchmark document");
+    }
+}
+
+}  // namespace benchmark
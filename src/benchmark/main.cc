@@ -0,0 +1,112 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.hpp"
+#include "unittest/unittest_utils.hpp"
+#include "utils.hpp"
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "Usage: %s [--filter=substring] [--min-time-ms=n] [--repetitions=n]\n"
+            "          [--output=file] [--list]\n"
+            "\n"
+            "Runs the benchmarks whose names contain the filter, and writes the results\n"
+            "as JSON to the output file (or to stdout).  A summary goes to stderr.\n",
+            argv0);
+}
+
+static bool parse_int_arg(const char *arg, const char *prefix, int64_t *out) {
+    if (strncmp(arg, prefix, strlen(prefix)) != 0) {
+        return false;
+    }
+    const char *value = arg + strlen(prefix);
+    if (!strtoi64_strict(value, 10, out) || *out <= 0) {
+        fprintf(stderr, "Invalid value for %s\n", prefix);
+        exit(EXIT_FAILURE);
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    startup_shutdown_t startup_shutdown;
+
+    std::string filter;
+    std::string output;
+    int64_t min_time_ms = 500;
+    int64_t repetitions = 5;
+    bool list = false;
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--filter=", strlen("--filter=")) == 0) {
+            filter = arg + strlen("--filter=");
+        } else if (strncmp(arg, "--output=", strlen("--output=")) == 0) {
+            output = arg + strlen("--output=");
+        } else if (parse_int_arg(arg, "--min-time-ms=", &min_time_ms)) {
+        } else if (parse_int_arg(arg, "--repetitions=", &repetitions)) {
+        } else if (strcmp(arg, "--list") == 0) {
+            list = true;
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<benchmark::result_t> results;
+    for (const benchmark::benchmark_t &b : benchmark::all_benchmarks()) {
+        if (b.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        if (list) {
+            printf("%s\n", b.name.c_str());
+            continue;
+        }
+
+        benchmark::result_t result;
+        auto run = [&]() {
+            result = benchmark::run_benchmark(b, min_time_ms * MILLION, repetitions);
+        };
+        if (b.num_threads == 0) {
+            run();
+        } else {
+            unittest::run_in_thread_pool(run, b.num_threads);
+        }
+        fprintf(stderr, "%-40s %12" PRIi64 " iterations %12.1f ns/op",
+                result.name.c_str(), result.iterations, result.ns_per_op_median);
+        if (result.mb_per_sec != 0) {
+            fprintf(stderr, " %10.1f MB/s", result.mb_per_sec);
+        }
+        if (result.items_per_sec != 0) {
+            fprintf(stderr, " %12.0f items/s", result.items_per_sec);
+        }
+        if (result.allocs_per_item >= 0) {
+            fprintf(stderr, " %8.2f allocs/%s", result.allocs_per_item,
+                    result.items_per_sec != 0 ? "item" : "op");
+        }
+        if (result.p99_ns != 0) {
+            fprintf(stderr, " p99 %.0f ns", result.p99_ns);
+        }
+        fprintf(stderr, "\n");
+        results.push_back(result);
+    }
+    if (list) {
+        return EXIT_SUCCESS;
+    }
+
+    const std::string json = benchmark::results_to_json(results);
+    if (output.empty()) {
+        fputs(json.c_str(), stdout);
+    } else {
+        FILE *file = fopen(output.c_str(), "w");
+        if (file == NULL || fputs(json.c_str(), file) == EOF || fclose(file) != 0) {
+            fprintf(stderr, "Could not write to %s\n", output.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,195 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.hpp"
+#include "concurrency/cond_var.hpp"
+#include "rdb_protocol/changefeed.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/term.hpp"
+#include "unittest/rdb_env.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace benchmark {
+
+namespace r = ql::r;
+using ql::pb::dummy_var_t;
+
+// The queries below run against a table of `TABLE_ROWS` documents like
+// `{id: 17, group: 7, value: 119, other: 221}`, held in the unit tests' mock table,
+// so that they measure the query engine (compilation aside) rather than the btree.
+static const int TABLE_ROWS = 1000;
+static const int GROUPS = 10;
+
+static std::set<ql::datum_t, latest_version_optional_datum_less_t> make_dataset() {
+    std::set<ql::datum_t, latest_version_optional_datum_less_t> rows;
+    for (int i = 0; i < TABLE_ROWS; ++i) {
+        ql::datum_object_builder_t row;
+        row.overwrite("id", ql::datum_t(static_cast<double>(i)));
+        row.overwrite("group", ql::datum_t(static_cast<double>(i % GROUPS)));
+        row.overwrite("value", ql::datum_t(static_cast<double>((i * 7) % TABLE_ROWS)));
+        row.overwrite("other", ql::datum_t(static_cast<double>((i * 13) % TABLE_ROWS)));
+        rows.insert(std::move(row).to_datum());
+    }
+    return rows;
+}
+
+static r::reql_t table() {
+    return r::db("db").table("t");
+}
+
+static r::reql_t field(dummy_var_t var, const std::string &name) {
+    return r::var(var)[name];
+}
+
+// Compiles the queries once and evaluates one of them per iteration, in turn, in a
+// thread pool.  Every iteration processes `items_per_iteration` rows.
+static void run_queries(state_t *state,
+                        const std::vector<ql::protob_t<const Term> > &queries,
+                        int64_t items_per_iteration) {
+    // The environment forks the extproc spawner, so it has to be created before
+    // the thread pool starts.
+    unittest::test_rdb_env_t test_env;
+    test_env.add_database("db");
+    test_env.add_table("db", "t", "id", make_dataset());
+
+    unittest::run_in_thread_pool([&]() {
+        scoped_ptr_t<unittest::test_rdb_env_t::instance_t> env_instance =
+            test_env.make_env();
+        std::vector<counted_t<const ql::term_t> > compiled;
+        for (const auto &query : queries) {
+            ql::compile_env_t compile_env((ql::var_visibility_t()));
+            compiled.push_back(ql::compile_term(&compile_env, query));
+        }
+
+        state->set_items_per_iteration(items_per_iteration);
+        state->record_latencies();
+        size_t i = 0;
+        while (state->keep_running()) {
+            ql::scope_env_t scope_env(env_instance->get_env(), ql::var_scope_t());
+            scoped_ptr_t<ql::val_t> result = compiled[i]->eval(&scope_env);
+            i = (i + 1 == compiled.size() ? 0 : i + 1);
+        }
+    });
+}
+
+static void run_query(state_t *state, r::reql_t &&query, int64_t items_per_iteration) {
+    std::vector<ql::protob_t<const Term> > queries;
+    queries.push_back(query.release_counted());
+    run_queries(state, queries, items_per_iteration);
+}
+
+BENCHMARK(ReQL, PointGet) {
+    std::vector<ql::protob_t<const Term> > queries;
+    for (int i = 0; i < 256; ++i) {
+        queries.push_back(
+            table().get_(static_cast<double>((i * 37) % TABLE_ROWS)).release_counted());
+    }
+    run_queries(state, queries, 1);
+}
+
+BENCHMARK(ReQL, RangeScan) {
+    const int rows = TABLE_ROWS / 10;
+    run_query(state,
+              table().call(Term::BETWEEN, 100.0, static_cast<double>(100 + rows))
+                     .coerce_to("array"),
+              rows);
+}
+
+BENCHMARK(ReQL, TableScan) {
+    run_query(state, table().coerce_to("array"), TABLE_ROWS);
+}
+
+// The filter, map and reduce are all pushed down into the range read.
+BENCHMARK(ReQL, FilterMapReduce) {
+    run_query(state,
+              table().filter(r::fun(dummy_var_t::IGNORED,
+                                    field(dummy_var_t::IGNORED, "value")
+                                        < static_cast<double>(TABLE_ROWS / 2)))
+                     .map(r::fun(dummy_var_t::IGNORED,
+                                 field(dummy_var_t::IGNORED, "value")))
+                     .call(Term::REDUCE,
+                           r::fun(dummy_var_t::GROUPBY_REDUCE_A,
+                                  dummy_var_t::GROUPBY_REDUCE_B,
+                                  r::var(dummy_var_t::GROUPBY_REDUCE_A)
+                                      + r::var(dummy_var_t::GROUPBY_REDUCE_B))),
+              TABLE_ROWS);
+}
+
+BENCHMARK(ReQL, GroupCount) {
+    run_query(state, table().call(Term::GROUP, "group").count(), TABLE_ROWS);
+}
+
+// Without an index, so the whole table is sorted in memory.
+BENCHMARK(ReQL, OrderBy) {
+    run_query(state, table().call(Term::ORDER_BY, "value").coerce_to("array"),
+              TABLE_ROWS);
+}
+
+// Every row is joined with the one whose primary key is its `other` field.
+BENCHMARK(ReQL, EqJoin) {
+    run_query(state,
+              table().call(Term::EQ_JOIN, "other", table()).coerce_to("array"),
+              TABLE_ROWS);
+}
+
+// One change delivered to many range changefeeds on the same table, and each
+// feed's batch read back.
+TPBENCHMARK(ReQL, ChangefeedFanOut, 1) {
+    using ql::changefeed::artificial_t;
+    using ql::changefeed::keyspec_t;
+    using ql::changefeed::msg_t;
+    class dummy_artificial_t : public artificial_t {
+    public:
+        void maybe_remove() { }
+    };
+    const int subscribers = 100;
+
+    cond_t interruptor;
+    ql::env_t env(&interruptor,
+                  ql::return_empty_normal_batches_t::YES,
+                  reql_version_t::LATEST);
+    dummy_artificial_t artificial_cfeed;
+    ql::protob_t<const Backtrace> bt = ql::make_counted_backtrace();
+    std::vector<counted_t<ql::datum_stream_t> > feeds;
+    for (int i = 0; i < subscribers; ++i) {
+        feeds.push_back(artificial_cfeed.subscribe(
+            &env,
+            false,
+            keyspec_t::range_t{
+                std::vector<ql::transform_variant_t>(),
+                boost::optional<std::string>(),
+                sorting_t::UNORDERED,
+                ql::datum_range_t::universe()},
+            "id",
+            std::vector<ql::datum_t>(),
+            bt));
+    }
+    const ql::batchspec_t batchspec =
+        ql::batchspec_t::all()
+        .with_new_batch_type(ql::batch_type_t::NORMAL)
+        .with_max_dur(1000);
+
+    state->set_items_per_iteration(subscribers);
+    state->record_latencies();
+    int i = 0;
+    while (state->keep_running()) {
+        const ql::datum_t id(static_cast<double>(i % TABLE_ROWS));
+        artificial_cfeed.send_all(msg_t(msg_t::change_t{
+            std::map<std::string, std::vector<ql::datum_t> >(),
+            std::map<std::string, std::vector<ql::datum_t> >(),
+            store_key_t(id.print_primary()),
+            ql::datum_t(static_cast<double>(i)),
+            ql::datum_t(static_cast<double>(i + 1)),
+            0}));
+        for (const auto &feed : feeds) {
+            std::vector<ql::datum_t> batch = feed->next_batch(&env, batchspec);
+            guarantee(batch.size() == 1);
+        }
+        ++i;
+    }
+}
+
+}  // namespace benchmark
@@ -0,0 +1,91 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <vector>
+
+#include "arch/arch.hpp"
+#include "benchmark/benchmark.hpp"
+#include "concurrency/cond_var.hpp"
+#include "concurrency/new_mutex.hpp"
+#include "containers/scoped.hpp"
+#include "serializer/buf_ptr.hpp"
+#include "serializer/config.hpp"
+#include "unittest/mock_file.hpp"
+
+namespace benchmark {
+
+// The serializer's disk managers (extent, data block and LBA managers) running on
+// in-memory files, so that we measure their bookkeeping rather than the disk.
+struct mock_serializer_t {
+    mock_serializer_t() {
+        standard_serializer_t::create(&opener,
+                                      standard_serializer_t::static_config_t());
+        ser.init(new standard_serializer_t(standard_serializer_t::dynamic_config_t(),
+                                           &opener,
+                                           &get_global_perfmon_collection()));
+        account.init(ser->make_io_account(1));
+    }
+
+    counted_t<standard_block_token_t> write_block(const buf_ptr_t &buf,
+                                                  block_id_t block_id) {
+        std::vector<buf_write_info_t> infos;
+        infos.push_back(buf_write_info_t(buf.ser_buffer(), buf.block_size(), block_id));
+        struct : public iocallback_t, public cond_t {
+            void on_io_complete() {
+                pulse();
+            }
+        } cb;
+        std::vector<counted_t<standard_block_token_t> > tokens
+            = ser->block_writes(infos, account.get(), &cb);
+        cb.wait();
+        return tokens[0];
+    }
+
+    void index_write(block_id_t block_id,
+                     const counted_t<standard_block_token_t> &token) {
+        std::vector<index_write_op_t> write_ops;
+        write_ops.push_back(index_write_op_t(block_id, token,
+                                             repli_timestamp_t::distant_past));
+        new_mutex_in_line_t dummy_acq;
+        ser->index_write(&dummy_acq, write_ops);
+    }
+
+    unittest::mock_file_opener_t opener;
+    scoped_ptr_t<standard_serializer_t> ser;
+    scoped_ptr_t<file_account_t> account;
+};
+
+// Writing a block and pointing the index at it, like a cache flush of a single
+// dirty block.  Overwriting the same few blocks keeps the file from growing, and
+// exercises the garbage collector.
+TPBENCHMARK(Serializer, WriteBlockAndIndex, 1) {
+    mock_serializer_t mock;
+    buf_ptr_t buf = buf_ptr_t::alloc_zeroed(mock.ser->max_block_size());
+    state->set_bytes_per_iteration(buf.block_size().ser_value());
+
+    const block_id_t blocks = 64;
+    block_id_t block_id = 0;
+    while (state->keep_running()) {
+        mock.index_write(block_id, mock.write_block(buf, block_id));
+        block_id = (block_id + 1) % blocks;
+    }
+}
+
+TPBENCHMARK(Serializer, ReadBlock, 1) {
+    mock_serializer_t mock;
+    buf_ptr_t buf = buf_ptr_t::alloc_zeroed(mock.ser->max_block_size());
+    state->set_bytes_per_iteration(buf.block_size().ser_value());
+
+    std::vector<counted_t<standard_block_token_t> > tokens;
+    for (block_id_t block_id = 0; block_id < 256; ++block_id) {
+        tokens.push_back(mock.write_block(buf, block_id));
+        mock.index_write(block_id, tokens.back());
+    }
+
+    size_t i = 0;
+    while (state->keep_running()) {
+        buf_ptr_t read = mock.ser->block_read(mock.ser->index_read(i),
+                                              mock.account.get());
+        i = (i + 1 == tokens.size() ? 0 : i + 1);
+    }
+}
+
+}  // namespace benchmark
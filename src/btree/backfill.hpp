@@ -15,6 +15,12 @@
 // each not too much larger than this value.
 #define BACKFILL_MAX_KVPAIRS_SIZE (1024 * 64)
 
+// A backfill that starts at `repli_timestamp_t::distant_past` copies every key in
+// its range, typically to a new replica that has no data yet. It uses bigger chunks,
+// which cut down the per-chunk overhead (superblock and secondary index block
+// acquisition, message round trips, acknowledgements) on both sides.
+#define BACKFILL_FROM_SCRATCH_MAX_KVPAIRS_SIZE (1024 * 256)
+
 class buf_parent_t;
 class buf_lock_t;
 struct btree_key_t;
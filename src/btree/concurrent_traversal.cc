@@ -6,6 +6,7 @@
 #include <functional>
 
 #include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/resource_usage.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/semaphore.hpp"
 #include "concurrency/fifo_enforcer.hpp"
@@ -41,7 +42,8 @@ public:
         : semaphore_(concurrent_traversal::initial_semaphore_capacity, 0.5),
           sink_waiters_(0),
           cb_(cb),
-          failure_cond_(failure_cond) { }
+          failure_cond_(failure_cond),
+          usage_(current_resource_usage()) { }
 
     void handle_pair_coro(scoped_key_value_t *fragile_keyvalue,
                           semaphore_acq_t *fragile_acq,
@@ -55,6 +57,9 @@ public:
 
         fifo_enforcer_sink_t::exit_write_t exit_write(&sink_, token);
 
+        // The pair is handled on behalf of whoever started the traversal.
+        charge_resource_usage_t charge(usage_);
+
         done_traversing_t done;
         try {
             done = cb_->handle_pair(
@@ -111,6 +116,9 @@ private:
     // the query.
     cond_t *failure_cond_;
 
+    // What the coroutine that started the traversal was charging to, if anything.
+    resource_usage_t *const usage_;
+
     // We don't use the drainer's drain signal, we use failure_cond_
     auto_drainer_t drainer_;
     DISABLE_COPYING(concurrent_traversal_adapter_t);
@@ -166,6 +166,10 @@ bool btree_depth_first_traversal(counted_t<counted_buf_lock_t> block,
                     return false;
                 }
             }
+
+            // We're done with this subtree, so if we're reading a snapshot, the
+            // cache can let go of its old versions.
+            block->retire_snapshotted_child(pair->lnode);
         }
         return true;
     } else {
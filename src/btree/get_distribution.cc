@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "btree/get_distribution.hpp"
 
+#include <map>
+
 #include "btree/internal_node.hpp"
 #include "btree/node.hpp"
 #include "btree/leaf_node.hpp"
@@ -10,8 +12,9 @@
 
 class get_distribution_traversal_helper_t : public btree_traversal_helper_t, public home_thread_mixin_debug_only_t {
 public:
-    get_distribution_traversal_helper_t(int _depth_limit, std::vector<store_key_t> *_keys)
-        : depth_limit(_depth_limit), key_count(0), keys(_keys)
+    get_distribution_traversal_helper_t(int _depth_limit, std::vector<store_key_t> *_keys,
+                                        std::map<store_key_t, int64_t> *_fanouts)
+        : depth_limit(_depth_limit), key_count(0), keys(_keys), fanouts(_fanouts)
     { }
 
     void read_stat_block(buf_lock_t *stat_block) {
@@ -34,6 +37,16 @@ public:
         const leaf_node_t *node
             = static_cast<const leaf_node_t *>(read.get_data_read());
 
+        auto sample = samples.find(leaf_node_buf->block_id());
+        if (sample != samples.end()) {
+            int64_t num_keys = 0;
+            for (auto it = leaf::begin(*node); it != leaf::end(*node); ++it) {
+                ++num_keys;
+            }
+            record_sample(sample, num_keys);
+            return;
+        }
+
         for (auto it = leaf::begin(*node); it != leaf::end(*node); ++it) {
             const btree_key_t *key = (*it).first;
             keys->push_back(store_key_t(key->size, key->contents));
@@ -45,6 +58,12 @@ public:
         const internal_node_t *node
             = static_cast<const internal_node_t *>(read.get_data_read());
 
+        auto sample = samples.find(internal_node_buf->block_id());
+        if (sample != samples.end()) {
+            record_sample(sample, node->npairs);
+            return;
+        }
+
         /* Notice, we iterate all but the last pair because the last pair
          * doesn't actually have a key and we're looking for the split points.
          * */
@@ -57,7 +76,8 @@ public:
     void filter_interesting_children(buf_parent_t,
                                      ranged_block_ids_t *ids_source,
                                      interesting_children_callback_t *cb) {
-        if (ids_source->get_level() < depth_limit) {
+        const int level = ids_source->get_level();
+        if (level < depth_limit) {
             int num_block_ids = ids_source->num_block_ids();
             for (int i = 0; i < num_block_ids; ++i) {
                 block_id_t block_id;
@@ -66,6 +86,37 @@ public:
 
                 cb->receive_interesting_child(i);
             }
+        } else if (level == depth_limit) {
+            /* The children of this node are the buckets of the distribution. Rather
+            than assuming that they all hold the same number of keys, we look at the
+            middle child and assume that its siblings are about as full as it is. That
+            costs one extra block per node at this level, and means that parts of the
+            tree with larger keys or emptier nodes get smaller estimates. */
+            int num_block_ids = ids_source->num_block_ids();
+            if (num_block_ids > 0) {
+                const int sample_index = num_block_ids / 2;
+                std::vector<store_key_t> *siblings = NULL;
+                for (int i = 0; i < num_block_ids; ++i) {
+                    block_id_t block_id;
+                    const btree_key_t *left, *right;
+                    ids_source->get_block_id_and_bounding_interval(
+                        i, &block_id, &left, &right);
+                    if (i == sample_index) {
+                        siblings = &samples[block_id];
+                    }
+                }
+                guarantee(siblings != NULL);
+                for (int i = 0; i < num_block_ids; ++i) {
+                    block_id_t block_id;
+                    const btree_key_t *left, *right;
+                    ids_source->get_block_id_and_bounding_interval(
+                        i, &block_id, &left, &right);
+                    siblings->push_back(left == NULL
+                        ? store_key_t::min()
+                        : store_key_t(left->size, left->contents));
+                }
+                cb->receive_interesting_child(sample_index);
+            }
         } else {
             //We're over the depth limit and thus disinterested in all children
         }
@@ -86,13 +137,29 @@ public:
 
     //TODO this is inefficient since each one is maximum size
     std::vector<store_key_t> *keys;
+    std::map<store_key_t, int64_t> *fanouts;
+
+private:
+    void record_sample(std::map<block_id_t, std::vector<store_key_t> >::iterator sample,
+                       int64_t fanout) {
+        for (auto const &left : sample->second) {
+            (*fanouts)[left] = fanout;
+        }
+        samples.erase(sample);
+    }
+
+    /* Maps the block id of every sampled node to the left bounds of itself and all of
+    its siblings. */
+    std::map<block_id_t, std::vector<store_key_t> > samples;
 };
 
 void get_btree_key_distribution(superblock_t *superblock, int depth_limit,
                                 int64_t *key_count_out,
-                                std::vector<store_key_t> *keys_out) {
-    get_distribution_traversal_helper_t helper(depth_limit, keys_out);
+                                std::vector<store_key_t> *keys_out,
+                                std::map<store_key_t, int64_t> *fanouts_out) {
+    get_distribution_traversal_helper_t helper(depth_limit, keys_out, fanouts_out);
     rassert(keys_out->empty(), "Why is this output parameter not an empty vector\n");
+    rassert(fanouts_out->empty());
 
     cond_t non_interruptor;
     btree_parallel_traversal(superblock, &helper, &non_interruptor);
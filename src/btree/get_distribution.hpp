@@ -2,6 +2,7 @@
 #ifndef BTREE_GET_DISTRIBUTION_HPP_
 #define BTREE_GET_DISTRIBUTION_HPP_
 
+#include <map>
 #include <vector>
 
 #include "btree/keys.hpp"
@@ -9,8 +10,15 @@
 
 class superblock_t;
 
+/* `keys_out` receives the keys that split the tree into subtrees at `depth_limit`.
+`fanouts_out` maps the left bound of each of those subtrees to the number of
+children or keys that a sampled node at the top of it or one of its siblings has;
+the leftmost subtree is listed under `store_key_t::min()`. The fanouts are only
+comparable relative to each other. `fanouts_out` stays empty if the tree isn't
+deeper than `depth_limit`. */
 void get_btree_key_distribution(superblock_t *superblock, int depth_limit,
                                 int64_t *key_count_out,
-                                std::vector<store_key_t> *keys_out);
+                                std::vector<store_key_t> *keys_out,
+                                std::map<store_key_t, int64_t> *fanouts_out);
 
 #endif /* BTREE_GET_DISTRIBUTION_HPP_ */
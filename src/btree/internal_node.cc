@@ -23,6 +23,7 @@ void delete_offset(internal_node_t *node, int index);
 void insert_offset(internal_node_t *node, uint16_t offset, int index);
 void make_last_pair_special(internal_node_t *node);
 bool is_equal(const btree_key_t *key1, const btree_key_t *key2);
+uint64_t key_prefix(const btree_key_t *key);
 }  // namespace impl
 
 void init(block_size_t block_size, internal_node_t *node) {
@@ -47,6 +48,39 @@ block_id_t lookup(const internal_node_t *node, const btree_key_t *key) {
     return get_pair_by_index(node, index)->lnode;
 }
 
+block_id_t lookup(const internal_node_t *node, const btree_key_t *key,
+                  const search_index_t *index) {
+    int i = index->offset_index(node, key);
+    rassert(i == get_offset_index(node, key));
+    return get_pair_by_index(node, i)->lnode;
+}
+
+search_index_t::search_index_t(const internal_node_t *node) {
+    rassert(node->npairs > 0);
+    prefixes_.reserve(node->npairs - 1);
+    for (int i = 0; i < node->npairs - 1; ++i) {
+        prefixes_.push_back(impl::key_prefix(&get_pair_by_index(node, i)->key));
+    }
+}
+
+int search_index_t::offset_index(const internal_node_t *node,
+                                 const btree_key_t *key) const {
+    rassert(static_cast<size_t>(node->npairs) == prefixes_.size() + 1);
+    // Keys with a lesser prefix are less than `key`, and keys with a greater prefix
+    // are greater, so only the ones with an equal prefix need a full comparison.
+    const uint64_t prefix = impl::key_prefix(key);
+    auto begin = prefixes_.begin();
+    auto lo = std::lower_bound(begin, prefixes_.end(), prefix);
+    auto hi = std::upper_bound(lo, prefixes_.end(), prefix);
+    if (lo == hi) {
+        return lo - begin;
+    }
+    return std::lower_bound(node->pair_offsets + (lo - begin),
+                            node->pair_offsets + (hi - begin),
+                            static_cast<uint16_t>(internal_key_comp::faux_offset),
+                            internal_key_comp(node, key)) - node->pair_offsets;
+}
+
 bool insert(internal_node_t *node, const btree_key_t *key, block_id_t lnode, block_id_t rnode) {
     rassert(key->size <= MAX_KEY_SIZE, "key too large");
     if (is_full(node)) return false;
@@ -69,7 +103,12 @@ bool insert(internal_node_t *node, const btree_key_t *key, block_id_t lnode, blo
 }
 
 bool remove(block_size_t block_size, internal_node_t *node, const btree_key_t *key) {
-    int index = get_offset_index(node, key);
+    remove_by_index(block_size, node, get_offset_index(node, key));
+    return true;
+}
+
+void remove_by_index(block_size_t block_size, internal_node_t *node, int index) {
+    rassert(index >= 0 && index < node->npairs);
     impl::delete_pair(node, node->pair_offsets[index]);
     impl::delete_offset(node, index);
 
@@ -78,7 +117,6 @@ bool remove(block_size_t block_size, internal_node_t *node, const btree_key_t *k
     }
 
     validate(block_size, node);
-    return true;
 }
 
 void split(block_size_t block_size, internal_node_t *node, internal_node_t *rnode, btree_key_t *median) {
@@ -460,6 +498,16 @@ bool is_equal(const btree_key_t *key1, const btree_key_t *key2) {
     return btree_key_cmp(key1, key2) == 0;
 }
 
+// The first eight bytes of the key, big-endian, padded with zeroes.  If two keys'
+// prefixes differ, the keys compare the same way.
+uint64_t key_prefix(const btree_key_t *key) {
+    uint64_t ret = 0;
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+        ret = (ret << 8) | (i < key->size ? key->contents[i] : 0);
+    }
+    return ret;
+}
+
 }  // namespace impl
 
 }  // namespace internal_node
@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "btree/keys.hpp"
+#include "buffer_cache/types.hpp"
 #include "serializer/types.hpp"
 #include "utils.hpp"
 
@@ -31,8 +32,31 @@ void init(block_size_t block_size, internal_node_t *node);
 void init(block_size_t block_size, internal_node_t *node, const internal_node_t *lnode, const uint16_t *offsets, int numpairs);
 
 block_id_t lookup(const internal_node_t *node, const btree_key_t *key);
+
+// An in-memory search index over the keys of an internal node, meant to be cached
+// with the node's block (see buf_read_t::get_derived_data()).  It holds the first
+// eight bytes of every key but the last, empty one, packed into integers that
+// compare like the keys do.  A lookup binary searches this one small array and only
+// compares full keys among those with the same prefix, instead of following the
+// pair offsets to a key scattered somewhere in the block at every step.
+class search_index_t : public buf_derived_data_t {
+public:
+    explicit search_index_t(const internal_node_t *node);
+
+    // Same as get_offset_index(node, key), for the node the index was built from.
+    int offset_index(const internal_node_t *node, const btree_key_t *key) const;
+
+private:
+    std::vector<uint64_t> prefixes_;
+};
+
+block_id_t lookup(const internal_node_t *node, const btree_key_t *key,
+                  const search_index_t *index);
 bool insert(internal_node_t *node, const btree_key_t *key, block_id_t lnode, block_id_t rnode);
 bool remove(block_size_t block_size, internal_node_t *node, const btree_key_t *key);
+// Removes the pair at `index`.  The child to its right takes over the removed
+// child's key range, or the one to its left if it was the last pair.
+void remove_by_index(block_size_t block_size, internal_node_t *node, int index);
 void split(block_size_t block_size, internal_node_t *node, internal_node_t *rnode, btree_key_t *median);
 void merge(block_size_t block_size, const internal_node_t *node, internal_node_t *rnode, const internal_node_t *parent);
 bool level(block_size_t block_size, internal_node_t *node, internal_node_t *sibling,
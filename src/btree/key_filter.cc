@@ -0,0 +1,62 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "btree/key_filter.hpp"
+
+#include "btree/keys.hpp"
+
+static bool key_filters_enabled_ = false;
+
+void set_key_filters_enabled(bool enabled) {
+    key_filters_enabled_ = enabled;
+}
+
+bool key_filters_enabled() {
+    return key_filters_enabled_;
+}
+
+key_filter_t::key_filter_t() : ready_(false), rebuilding_(false) { }
+
+bool key_filter_t::may_contain(const btree_key_t *key) const {
+    assert_thread();
+    return !ready_ || filter_->may_contain(key->contents, key->size);
+}
+
+void key_filter_t::add(const btree_key_t *key) {
+    assert_thread();
+    if (filter_.has()) {
+        filter_->add(key->contents, key->size);
+    }
+}
+
+bool key_filter_t::needs_rebuild() const {
+    assert_thread();
+    return key_filters_enabled_
+        && !rebuilding_
+        && (!filter_.has() || filter_->count() > filter_->capacity());
+}
+
+size_t key_filter_t::count() const {
+    assert_thread();
+    return filter_.has() ? filter_->count() : 0;
+}
+
+void key_filter_t::start_rebuild(size_t capacity) {
+    assert_thread();
+    guarantee(!rebuilding_);
+    rebuilding_ = true;
+    ready_ = false;
+    filter_ = make_scoped<bloom_filter_t>(capacity);
+}
+
+void key_filter_t::finish_rebuild() {
+    assert_thread();
+    guarantee(rebuilding_);
+    rebuilding_ = false;
+    ready_ = true;
+}
+
+void key_filter_t::abort_rebuild() {
+    assert_thread();
+    guarantee(rebuilding_);
+    rebuilding_ = false;
+    filter_.reset();
+}
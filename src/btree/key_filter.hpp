@@ -0,0 +1,49 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef BTREE_KEY_FILTER_HPP_
+#define BTREE_KEY_FILTER_HPP_
+
+#include "containers/bloom_filter.hpp"
+#include "containers/scoped.hpp"
+#include "threading.hpp"
+
+struct btree_key_t;
+
+/* Key filters are off unless `--primary-key-filter` is given. */
+void set_key_filters_enabled(bool enabled);
+bool key_filters_enabled();
+
+/* `key_filter_t` keeps a Bloom filter over the keys of a B-tree in memory, so that
+lookups of keys that aren't in the tree can return without reading any leaves. It
+says that every key may be in the tree until it has been built.
+
+To build it, the owner calls `start_rebuild()`, then adds every key of a snapshot of
+the tree that it acquires after that, then calls `finish_rebuild()`. Writes must
+`add()` every key that they might insert before they release the superblock; that
+way a read that gets the superblock after them sees their keys, and a rebuild sees
+every key that isn't in its snapshot. Deleted keys stay in the filter until the next
+rebuild. */
+class key_filter_t : public home_thread_mixin_debug_only_t {
+public:
+    key_filter_t();
+
+    bool may_contain(const btree_key_t *key) const;
+    void add(const btree_key_t *key);
+
+    /* Whether the filter is missing or too full, and no rebuild is running. */
+    bool needs_rebuild() const;
+    /* The number of keys in the filter, which is how big the next one should be. */
+    size_t count() const;
+
+    void start_rebuild(size_t capacity);
+    void finish_rebuild();
+    void abort_rebuild();
+
+private:
+    scoped_ptr_t<bloom_filter_t> filter_;
+    bool ready_;
+    bool rebuilding_;
+
+    DISABLE_COPYING(key_filter_t);
+};
+
+#endif  // BTREE_KEY_FILTER_HPP_
@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include <set>
+#include <vector>
 
 #include "btree/node.hpp"
 #include "repli_timestamp.hpp"
@@ -1012,6 +1013,49 @@ void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode, btree_ke
     keycpy(median_out, entry_key(get_entry(node, node->pair_offsets[s - 1])));
 }
 
+void split_for_append(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *rnode,
+                      btree_key_t *median_out) {
+    int tstamp_back_offset;
+    int mandatory = mandatory_cost(sizer, node, MANDATORY_TIMESTAMPS, &tstamp_back_offset);
+
+    rassert(mandatory >= free_space(sizer) - leaf_epsilon(sizer));
+
+    // Take entries from the end until they make up the right share of the mandatory
+    // cost, counting costs the same way as `split()` does.  The node keeps at least
+    // one entry, for the median.
+    const int target_rcost = mandatory * APPEND_SPLIT_RIGHT_PERCENT / 100;
+    int num_mandatories = 0;
+    int rcost = 0;
+    int s = node->num_pairs;
+    while (s > 1 && rcost < target_rcost) {
+        --s;
+        int offset = node->pair_offsets[s];
+        entry_t *ent = get_entry(node, offset);
+
+        if (entry_is_live(ent)) {
+            rcost += entry_size(sizer, ent) + sizeof(uint16_t) + (offset < tstamp_back_offset ? sizeof(repli_timestamp_t) : 0);
+            ++num_mandatories;
+        } else {
+            rassert(entry_is_deletion(ent));
+
+            if (offset < tstamp_back_offset) {
+                rcost += entry_size(sizer, ent) + sizeof(uint16_t) + sizeof(repli_timestamp_t);
+                ++num_mandatories;
+            }
+        }
+    }
+
+    // Now we wish to move the elements at indices [s, num_pairs) to rnode.
+
+    init(sizer, rnode);
+
+    int node_copysize = rcost - num_mandatories * sizeof(uint16_t);
+    move_elements(sizer, node, s, node->num_pairs, 0, rnode, node_copysize,
+                  tstamp_back_offset, NULL);
+
+    keycpy(median_out, entry_key(get_entry(node, node->pair_offsets[s - 1])));
+}
+
 void merge(value_sizer_t *sizer, leaf_node_t *left, leaf_node_t *right) {
     rassert(left != right);
 
@@ -1150,6 +1194,24 @@ bool is_mergable(value_sizer_t *sizer, const leaf_node_t *node, const leaf_node_
     return is_underfull(sizer, node) && is_underfull(sizer, sibling);
 }
 
+// Compares `key` to `other` like `btree_key_cmp`, given that their first `skip`
+// bytes are already known to be equal.  Sets `*common_out` to the length of their
+// common prefix.
+static int key_cmp_after_prefix(const btree_key_t *key, const btree_key_t *other,
+                                int skip, int *common_out) {
+    const int min_size = std::min<int>(key->size, other->size);
+    rassert(skip <= min_size);
+    int i = skip;
+    while (i < min_size && key->contents[i] == other->contents[i]) {
+        ++i;
+    }
+    *common_out = i;
+    if (i < min_size) {
+        return static_cast<int>(key->contents[i]) - static_cast<int>(other->contents[i]);
+    }
+    return static_cast<int>(key->size) - static_cast<int>(other->size);
+}
+
 // Sets *index_out to the index for the live entry or deletion entry
 // for the key, or to the index the key would have if it were
 // inserted.  Returns true if the key at said index is actually equal.
@@ -1160,20 +1222,32 @@ bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) {
     // beg == 0 or key > *(beg - 1).
     // end == num_pairs or key < *end.
 
+    // The lengths of the common prefixes of `key` with *(beg - 1) and *end.  Every
+    // key in between shares at least the smaller of the two with `key`, so we
+    // don't compare those bytes again.  Keys in a leaf tend to share long
+    // prefixes (compound primary keys, sindex keys that end in the same primary
+    // key), which makes this a lot cheaper than comparing whole keys.
+    int beg_common = 0;
+    int end_common = 0;
+
     while (beg < end) {
         // when (end - beg) > 0, (end - beg) / 2 is always less than (end - beg).  So beg <= test_point < end.
         int test_point = beg + (end - beg) / 2;
 
         const btree_key_t *ek = entry_key(get_entry(node, node->pair_offsets[test_point]));
 
-        int res = btree_key_cmp(key, ek);
+        int common;
+        int res = key_cmp_after_prefix(key, ek, std::min(beg_common, end_common),
+                                       &common);
 
         if (res < 0) {
             // key < *test_point.
             end = test_point;
+            end_common = common;
         } else if (res > 0) {
             // key > *test_point.  Since test_point < end, we have test_point + 1 <= end.
             beg = test_point + 1;
+            beg_common = common;
         } else {
             // We found the key!
             *index_out = test_point;
@@ -1202,6 +1276,118 @@ bool lookup(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *ke
     return false;
 }
 
+// FNV-1a, over the key's contents.
+uint32_t key_hash(const btree_key_t *key) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < key->size; ++i) {
+        h = (h ^ key->contents[i]) * 16777619u;
+    }
+    return h;
+}
+
+lookup_index_t::lookup_index_t(const leaf_node_t *node) {
+    // At most half full, so that probe sequences stay short.
+    size_t capacity = 8;
+    while (capacity < 2 * static_cast<size_t>(node->num_pairs)) {
+        capacity *= 2;
+    }
+    slots_.resize(capacity, 0);
+    const size_t mask = capacity - 1;
+    // Block sizes are at most 32 KB, so indices fit in 16 bits.
+    rassert(node->num_pairs < 0xFFFF);
+
+    for (int i = 0; i < node->num_pairs; ++i) {
+        const uint32_t h = key_hash(entry_key(get_entry(node, node->pair_offsets[i])));
+        size_t slot = h & mask;
+        while (slots_[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots_[slot] = (h & 0xFFFF0000u) | static_cast<uint32_t>(i + 1);
+    }
+}
+
+bool lookup_index_t::find_key(const leaf_node_t *node, const btree_key_t *key,
+                              int *index_out) const {
+    const uint32_t h = key_hash(key);
+    const size_t mask = slots_.size() - 1;
+    for (size_t slot = h & mask; slots_[slot] != 0; slot = (slot + 1) & mask) {
+        if ((slots_[slot] & 0xFFFF0000u) != (h & 0xFFFF0000u)) {
+            continue;
+        }
+        const int index = static_cast<int>(slots_[slot] & 0xFFFFu) - 1;
+        rassert(index < node->num_pairs);
+        if (btree_key_cmp(entry_key(get_entry(node, node->pair_offsets[index])),
+                          key) == 0) {
+            *index_out = index;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool lookup(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *key,
+            void *value_out, const lookup_index_t *index) {
+    int i;
+    const bool found = index->find_key(node, key, &i);
+#ifndef NDEBUG
+    int expected;
+    rassert(found == leaf::find_key(node, key, &expected));
+    rassert(!found || i == expected);
+#endif
+    if (found) {
+        const entry_t *ent = get_entry(node, node->pair_offsets[i]);
+        if (entry_is_live(ent)) {
+            const void *val = entry_value(ent);
+            memcpy(value_out, val, sizer->size(val));
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// When a node runs out of space, we don't want to drop its timestamp history
+// unless garbage collecting dead entries leaves less than
+// `free_space(sizer) / GARBAGE_COLLECTION_SLACK_FRACTION` bytes of room.
+const int GARBAGE_COLLECTION_SLACK_FRACTION = 8;
+
+// The offset that `frontmost` must not be below for a new entry of
+// `new_entry_size` bytes (plus its timestamp) to fit into the node.
+int space_needed_for_new_entry(const leaf_node_t *node, bool reuses_pair_offset,
+                               int new_entry_size) {
+    return offsetof(leaf_node_t, pair_offsets) +
+        sizeof(uint16_t) * (node->num_pairs + (reuses_pair_offset ? 0 : 1)) +
+        sizeof(repli_timestamp_t) +
+        new_entry_size;
+}
+
+// The largest number of timestamps we can keep such that dropping the history
+// beyond them frees at least `bytes_to_free` bytes. Dropping a live entry's
+// timestamp frees the timestamp; dropping a deletion entry frees the entry, its
+// timestamp and its `pair_offsets` slot.
+int timestamps_to_keep(value_sizer_t *sizer, const leaf_node_t *node,
+                       int bytes_to_free) {
+    std::vector<int> history_costs;
+    for (entry_iter_t iter = entry_iter_t::make(node);
+         !iter.done(sizer) && iter.offset < node->tstamp_cutpoint;
+         iter.step(sizer, node)) {
+        const entry_t *ent = get_entry(node, iter.offset);
+        if (entry_is_deletion(ent)) {
+            history_costs.push_back(sizeof(uint16_t) + sizeof(repli_timestamp_t)
+                                    + entry_size(sizer, ent));
+        } else if (entry_is_live(ent)) {
+            history_costs.push_back(sizeof(repli_timestamp_t));
+        }
+    }
+    int freed = 0;
+    int keep = history_costs.size();
+    while (keep > 0 && freed < bytes_to_free) {
+        --keep;
+        freed += history_costs[keep];
+    }
+    return keep;
+}
+
 /* `insert()` and `remove()` call this to insert a new entry into the leaf node.
 
 First it removes any existing entry for `key`; then it makes room in the leaf
@@ -1261,11 +1447,7 @@ MUST_USE bool prepare_space_for_new_entry(value_sizer_t *sizer, leaf_node_t *nod
     /* Garbage collect if appropriate. We do it after cleaning up any existing
     entry so that deletion always works no matter how full the node is. */
 
-    if (offsetof(leaf_node_t, pair_offsets) +
-            sizeof(uint16_t) * (node->num_pairs + (found ? 0 : 1)) +
-            sizeof(repli_timestamp_t) +
-            new_entry_size >
-            node->frontmost) {
+    if (space_needed_for_new_entry(node, found, new_entry_size) > node->frontmost) {
 
         if (found) {
             /* We can't re-use an existing index if we're garbage collecting. */
@@ -1279,8 +1461,25 @@ MUST_USE bool prepare_space_for_new_entry(value_sizer_t *sizer, leaf_node_t *nod
 
         /* Passing `&index` as the last parameter to `garbage_collect()`
         guarantees that it will remain valid even as `pair_offsets` entries are
-        moved around. */
-        garbage_collect(sizer, node, MANDATORY_TIMESTAMPS - 1, &index);
+        moved around.
+
+        We drop no more of the timestamp and deletion history than we have to.
+        The longer that history, the more often backfills can send just the
+        entries that changed instead of the whole node. So first we only squeeze
+        out dead entries, and then we drop the oldest history until there's
+        enough room. We ask for some slack on top, or a nearly full node would be
+        garbage collected again on every write. */
+        garbage_collect(sizer, node, node->num_pairs, &index);
+        const int bytes_to_free =
+            space_needed_for_new_entry(node, false, new_entry_size)
+            + free_space(sizer) / GARBAGE_COLLECTION_SLACK_FRACTION
+            - node->frontmost;
+        if (bytes_to_free > 0) {
+            garbage_collect(sizer, node,
+                            std::max(MANDATORY_TIMESTAMPS - 1,
+                                     timestamps_to_keep(sizer, node, bytes_to_free)),
+                            &index);
+        }
 
         /* Make sure that `index` still refers to where the new key should be
         inserted. */
@@ -129,6 +129,17 @@ bool is_underfull(value_sizer_t *sizer, const leaf_node_t *node);
 void split(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *sibling,
            btree_key_t *median_out);
 
+// The share of a full node's mandatory cost that `split_for_append()` moves.
+const int APPEND_SPLIT_RIGHT_PERCENT = 10;
+
+// Like `split()`, but for a node that keys are appended to in increasing order.  It
+// only moves the last `APPEND_SPLIT_RIGHT_PERCENT` percent of the node to `sibling`,
+// so that `node` stays nearly full instead of being left half empty for good.
+// `sibling` ends up underfull; the caller must only do this to the last child of its
+// parent, which `check_and_handle_underfull()` doesn't level.
+void split_for_append(value_sizer_t *sizer, leaf_node_t *node, leaf_node_t *sibling,
+                      btree_key_t *median_out);
+
 void merge(value_sizer_t *sizer, leaf_node_t *left, leaf_node_t *right);
 
 // The pointers in `moved_values_out` point to positions in `node` and
@@ -143,6 +154,28 @@ bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out);
 
 bool lookup(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *key, void *value_out);
 
+// A hash table from the keys of a leaf node to their indices, meant to be cached with
+// the node's block (see buf_read_t::get_derived_data()), so that exact-match
+// lookups in hot leaves take one probe and one full key comparison instead of a
+// binary search.  Entries store a few bits of the hash next to the index, so that
+// colliding probes rarely touch the node.
+class lookup_index_t : public buf_derived_data_t {
+public:
+    explicit lookup_index_t(const leaf_node_t *node);
+
+    // Same as find_key(node, key, &index) for the node the index was built from,
+    // except that *index_out is left alone if the key isn't found.
+    bool find_key(const leaf_node_t *node, const btree_key_t *key, int *index_out) const;
+
+private:
+    // The upper 16 bits are the upper bits of the key's hash, the lower 16 bits are
+    // the key's index plus one.  Zero means the slot is empty.
+    std::vector<uint32_t> slots_;
+};
+
+bool lookup(value_sizer_t *sizer, const leaf_node_t *node, const btree_key_t *key,
+            void *value_out, const lookup_index_t *index);
+
 void insert(value_sizer_t *sizer, leaf_node_t *node, const btree_key_t *key, const void *value, repli_timestamp_t tstamp, UNUSED key_modification_proof_t km_proof);
 
 void remove(value_sizer_t *sizer, leaf_node_t *node, const btree_key_t *key, repli_timestamp_t tstamp, key_modification_proof_t km_proof);
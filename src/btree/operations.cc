@@ -62,6 +62,20 @@ void detach_all_children(const node_t *node, buf_parent_t parent,
     }
 }
 
+// Whether the leaf `buf` holds is the last child of its parent `last_buf`, or the
+// root.  `key` must lead to the leaf.
+bool leaf_is_last_child(DEBUG_VAR buf_lock_t *buf, buf_lock_t *last_buf,
+                        const btree_key_t *key) {
+    if (last_buf->empty()) {
+        return true;
+    }
+    buf_read_t last_buf_read(last_buf);
+    const internal_node_t *parent_node
+        = static_cast<const internal_node_t *>(last_buf_read.get_data_read());
+    rassert(internal_node::lookup(parent_node, key) == buf->block_id());
+    return internal_node::get_offset_index(parent_node, key) == parent_node->npairs - 1;
+}
+
 // Split the node if necessary. If the node is a leaf_node, provide the new
 // value that will be inserted; if it's an internal node, provide NULL (we
 // split internal nodes proactively).
@@ -73,6 +87,8 @@ void check_and_handle_split(value_sizer_t *sizer,
                             superblock_t *sb,
                             const btree_key_t *key, void *new_value,
                             const value_deleter_t *detacher) {
+    // Whether `key` is being appended to the last leaf below its parent.
+    bool appending = false;
     {
         buf_read_t buf_read(buf);
         const node_t *node = static_cast<const node_t *>(buf_read.get_data_read());
@@ -80,10 +96,13 @@ void check_and_handle_split(value_sizer_t *sizer,
         // If the node isn't full, we don't need to split, so we're done.
         if (!node::is_internal(node)) { // This should only be called when update_needed.
             rassert(new_value);
-            if (!leaf::is_full(sizer, reinterpret_cast<const leaf_node_t *>(node),
-                               key, new_value)) {
+            const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(node);
+            if (!leaf::is_full(sizer, leaf, key, new_value)) {
                 return;
             }
+            appending = leaf_is_last_child(buf, last_buf, key)
+                && leaf::rbegin(*leaf) != leaf::rend(*leaf)
+                && btree_key_cmp(key, (*leaf::rbegin(*leaf)).first) > 0;
         } else {
             rassert(!new_value);
             if (!internal_node::is_full(reinterpret_cast<const internal_node_t *>(node))) {
@@ -109,10 +128,20 @@ void check_and_handle_split(value_sizer_t *sizer,
     {
         buf_write_t buf_write(buf);
         buf_write_t rbuf_write(&rbuf);
-        node::split(sizer,
-                    static_cast<node_t *>(buf_write.get_data_write()),
-                    static_cast<node_t *>(rbuf_write.get_data_write()),
-                    median);
+        if (appending) {
+            // Keys arriving in increasing order would leave every leaf half empty
+            // behind them, so keep this one nearly full instead.
+            leaf::split_for_append(
+                sizer,
+                static_cast<leaf_node_t *>(buf_write.get_data_write()),
+                static_cast<leaf_node_t *>(rbuf_write.get_data_write()),
+                median);
+        } else {
+            node::split(sizer,
+                        static_cast<node_t *>(buf_write.get_data_write()),
+                        static_cast<node_t *>(rbuf_write.get_data_write()),
+                        median);
+        }
 
         // We must detach all entries that we have removed from `buf`.
         buf_read_t rbuf_read(&rbuf);
@@ -223,6 +252,18 @@ void check_and_handle_underfull(value_sizer_t *sizer,
             node_is_mergable = node::is_mergable(sizer, node, sib_node, parent_node);
         }
 
+        // `leaf::split_for_append()` leaves the last leaf below a parent underfull on
+        // purpose. Leveling it would move half of its full left sibling back over, so
+        // we only ever merge it. That leaves at most one underfull leaf per parent.
+        bool node_is_last_leaf;
+        {
+            buf_read_t buf_read(buf);
+            const node_t *const node
+                = static_cast<const node_t *>(buf_read.get_data_read());
+            node_is_last_leaf = node::is_leaf(node)
+                && leaf_is_last_child(buf, last_buf, key);
+        }
+
         if (node_is_mergable) {
             // Merge.
 
@@ -290,7 +331,7 @@ void check_and_handle_underfull(value_sizer_t *sizer,
                 last_buf->mark_deleted();
                 insert_root(buf->block_id(), sb);
             }
-        } else {
+        } else if (!node_is_last_leaf) {
             // Level.
             store_key_t replacement_key_buffer;
             btree_key_t *replacement_key = replacement_key_buffer.btree_key();
@@ -355,6 +396,151 @@ void check_and_handle_underfull(value_sizer_t *sizer,
     }
 }
 
+// Whether the children of the internal node `buf` holds are leaves.  All leaves are at
+// the same depth, so it's enough to look at the child `key` leads to.
+bool children_are_leaves(buf_lock_t *buf, const btree_key_t *key) {
+    block_id_t child_id;
+    {
+        buf_read_t read(buf);
+        child_id = internal_node::lookup(
+                static_cast<const internal_node_t *>(read.get_data_read()), key);
+    }
+    rassert(child_id != NULL_BLOCK_ID && child_id != SUPERBLOCK_ID);
+    {
+        ASSERT_NO_CORO_WAITING;
+        buf_optimistic_read_t peek(buf_parent_t(buf), child_id);
+        const void *data = peek.get_data_read();
+        if (data != NULL) {
+            return !node::is_internal(static_cast<const node_t *>(data));
+        }
+    }
+    buf_lock_t child(buf, child_id, access_t::read);
+    buf_read_t read(&child);
+    return !node::is_internal(static_cast<const node_t *>(read.get_data_read()));
+}
+
+// Whether the internal node `buf` holds doesn't need to be split or merged by
+// `check_and_handle_split()` or `check_and_handle_underfull()`.
+bool internal_node_is_balanced(value_sizer_t *sizer, buf_lock_t *buf, bool is_root) {
+    buf_read_t read(buf);
+    const internal_node_t *node
+        = static_cast<const internal_node_t *>(read.get_data_read());
+    rassert(node::is_internal(reinterpret_cast<const node_t *>(node)));
+    return !internal_node::is_full(node)
+        && (is_root || !internal_node::is_underfull(sizer->block_size(), node));
+}
+
+// Tries to acquire `key`'s leaf and the leaf's parent for write while only taking
+// read locks on the internal nodes above them.  Then writers to different leaves
+// don't queue up behind one another on the upper levels of the tree, and the cache
+// doesn't make their transactions' flushes depend on each other through those nodes.
+// That only works if none of the nodes on the way needs to be split or merged, which
+// takes write locks on the node and its parent -- and we can't upgrade a read lock.
+// Returns false, having released everything it acquired, if the caller has to
+// descend the usual way.  The caller keeps holding the superblock meanwhile, so the
+// tree's height can't change under us.
+//
+// Snapshots rely on writers bumping the version of every block above the ones they
+// change, so we can only do this while nothing is snapshotted.  Snapshots are taken
+// of superblocks as soon as the reader gets in line for them, so one that's taken
+// later than this check is behind us in line all the way down.
+bool find_leaf_for_write_optimistically(value_sizer_t *sizer,
+                                        superblock_t *superblock,
+                                        const btree_key_t *key,
+                                        buf_lock_t *last_buf_out,
+                                        buf_lock_t *buf_out,
+                                        profile::trace_t *trace) {
+    const block_id_t root_id = superblock->get_root_block_id();
+    if (root_id == NULL_BLOCK_ID || superblock->expose_buf().cache()->has_snapshots()) {
+        return false;
+    }
+
+    buf_lock_t buf;
+    {
+        profile::starter_t starter("Acquire a block for read.", trace);
+        buf_lock_t tmp(superblock->expose_buf(), root_id, access_t::read);
+        buf = std::move(tmp);
+    }
+    {
+        // If the root is a leaf or a leaf's parent, it has to be write-locked anyway.
+        buf_read_t read(&buf);
+        if (!node::is_internal(static_cast<const node_t *>(read.get_data_read()))) {
+            return false;
+        }
+    }
+    if (!internal_node_is_balanced(sizer, &buf, true) || children_are_leaves(&buf, key)) {
+        return false;
+    }
+
+    // `buf` is a balanced internal node whose children aren't leaves.
+    for (;;) {
+        block_id_t node_id;
+        {
+            buf_read_t read(&buf);
+            node_id = internal_node::lookup(
+                    static_cast<const internal_node_t *>(read.get_data_read()), key);
+        }
+        rassert(node_id != NULL_BLOCK_ID && node_id != SUPERBLOCK_ID);
+
+        buf_lock_t child;
+        {
+            profile::starter_t starter("Acquire a block for read.", trace);
+            buf_lock_t tmp(&buf, node_id, access_t::read);
+            child = std::move(tmp);
+        }
+        if (!internal_node_is_balanced(sizer, &child, false)) {
+            return false;
+        }
+        if (!children_are_leaves(&child, key)) {
+            buf.reset_buf_lock();
+            buf = std::move(child);
+            continue;
+        }
+
+        // `child` is the leaf's parent.  Get back in line for it for write.  Since
+        // we still hold `buf`, nobody can split or merge `child` in the meantime,
+        // but other writers can change it by splitting or merging its leaves.  (We
+        // go through the transaction because `buf` isn't write-acquired; that's
+        // fine since nothing is snapshotted.)
+        child.reset_buf_lock();
+        {
+            profile::starter_t starter("Acquiring block for write.\n", trace);
+            buf_lock_t tmp(buf_parent_t(buf.txn()), node_id, access_t::write);
+            buf.reset_buf_lock();
+            child = std::move(tmp);
+        }
+        if (!internal_node_is_balanced(sizer, &child, false)) {
+            return false;
+        }
+
+        {
+            buf_read_t read(&child);
+            node_id = internal_node::lookup(
+                    static_cast<const internal_node_t *>(read.get_data_read()), key);
+        }
+        rassert(node_id != NULL_BLOCK_ID && node_id != SUPERBLOCK_ID);
+        {
+            profile::starter_t starter("Acquiring block for write.\n", trace);
+            buf_lock_t tmp(&child, node_id, access_t::write);
+            *buf_out = std::move(tmp);
+        }
+        *last_buf_out = std::move(child);
+        return true;
+    }
+}
+
+// Releases the superblock, or passes it back, once `find_keyvalue_location_for_write()`
+// has gone past the root.
+void release_superblock_for_write(keyvalue_location_t *keyvalue_location,
+                                  promise_t<superblock_t *> *pass_back_superblock) {
+    if (pass_back_superblock != NULL) {
+        pass_back_superblock->pulse(keyvalue_location->superblock);
+    } else {
+        keyvalue_location->superblock->release();
+    }
+    keyvalue_location->superblock = NULL;
+}
+
 /* Passing in a pass_back_superblock parameter will cause this function to
  * return the superblock after it's no longer needed (rather than releasing
  * it). Notice the superblock is not guaranteed to be returned until the
@@ -369,6 +555,8 @@ void find_keyvalue_location_for_write(
         btree_stats_t *stats,
         profile::trace_t *trace,
         promise_t<superblock_t *> *pass_back_superblock) THROWS_NOTHING {
+    block_pm_latency latency(stats != NULL ? &stats->pm_write_latency : NULL);
+
     keyvalue_location_out->superblock = superblock;
     keyvalue_location_out->pass_back_superblock = pass_back_superblock;
 
@@ -378,7 +566,11 @@ void find_keyvalue_location_for_write(
 
     buf_lock_t last_buf;
     buf_lock_t buf;
-    {
+    if (find_leaf_for_write_optimistically(sizer, superblock, key,
+                                           &last_buf, &buf, trace)) {
+        // The leaf isn't the root, so we're done with the superblock.
+        release_superblock_for_write(keyvalue_location_out, pass_back_superblock);
+    } else {
         // KSI: We can't acquire the block for write here -- we could, but it would
         // worsen the performance of the program -- sometimes we only end up using
         // this block for read.  So the profiling information is not very good.
@@ -413,13 +605,7 @@ void find_keyvalue_location_for_write(
         // its direct children, we might still want to replace the root, so
         // we can't release the superblock yet.
         if (!last_buf.empty() && keyvalue_location_out->superblock) {
-            if (pass_back_superblock != NULL) {
-                pass_back_superblock->pulse(superblock);
-                keyvalue_location_out->superblock = NULL;
-            } else {
-                keyvalue_location_out->superblock->release();
-                keyvalue_location_out->superblock = NULL;
-            }
+            release_superblock_for_write(keyvalue_location_out, pass_back_superblock);
         }
 
         // Release the old previous node (unless we're at the root), and set
@@ -461,13 +647,128 @@ void find_keyvalue_location_for_write(
     keyvalue_location_out->buf.swap(buf);
 }
 
+bool find_keyvalue_location_in_same_leaf(
+        value_sizer_t *sizer,
+        const btree_key_t *key,
+        keyvalue_location_t *keyvalue_location) THROWS_NOTHING {
+    if (keyvalue_location->last_buf.empty()) {
+        // The leaf is the root, so it might get split into a new root. That
+        // needs the superblock.
+        if (keyvalue_location->superblock == NULL) {
+            return false;
+        }
+    } else {
+        buf_read_t read(&keyvalue_location->last_buf);
+        auto parent = static_cast<const internal_node_t *>(read.get_data_read());
+        const int index = internal_node::get_offset_index(parent, key);
+        if (internal_node::get_pair_by_index(parent, index)->lnode
+            != keyvalue_location->buf.block_id()) {
+            return false;
+        }
+        // The parent's first and last child also take the keys below and above the
+        // parent's own range, which only the grandparent knows about.  So unless the
+        // parent is the root (which it is while we still hold the superblock), `key`
+        // is only known to belong into the leaf if it's between two of the parent's
+        // keys.
+        if (keyvalue_location->superblock == NULL
+            && (index == 0 || index == parent->npairs - 1)) {
+            return false;
+        }
+        // `find_keyvalue_location_for_write()` only made sure that the parent
+        // has room for one more child, and an earlier split might have used it.
+        if (internal_node::is_full(parent)) {
+            return false;
+        }
+    }
+
+    keyvalue_location->there_originally_was_value = false;
+    keyvalue_location->value.reset();
+
+    scoped_malloc_t<void> tmp(sizer->max_possible_size());
+    buf_read_t read(&keyvalue_location->buf);
+    auto node = static_cast<const leaf_node_t *>(read.get_data_read());
+    if (leaf::lookup(sizer, node, key, tmp.get())) {
+        keyvalue_location->there_originally_was_value = true;
+        keyvalue_location->value = std::move(tmp);
+    }
+    return true;
+}
+
+// Looks up `key` in the internal node `read` holds, using the search index cached
+// with the block, or building it and caching it if there is none.  (The data cached
+// with internal nodes' blocks is always a search_index_t, and with leaves' blocks
+// always a leaf::lookup_index_t.)
+template <class read_t>
+block_id_t lookup_in_internal_node(read_t *read, const internal_node_t *node,
+                                   const btree_key_t *key) {
+    const internal_node::search_index_t *index
+        = static_cast<const internal_node::search_index_t *>(read->get_derived_data());
+    if (index != NULL) {
+        return internal_node::lookup(node, key, index);
+    }
+    internal_node::search_index_t *new_index = new internal_node::search_index_t(node);
+    scoped_ptr_t<buf_derived_data_t> holder(new_index);
+    const block_id_t ret = internal_node::lookup(node, key, new_index);
+    read->set_derived_data(std::move(holder));
+    return ret;
+}
+
+// Looks up `key` in the leaf `read` holds, using the lookup index cached with the
+// block.  Building the index costs about as much as hashing every key in the leaf,
+// so we only do that for leaves that have been acquired before.
+bool lookup_in_leaf(value_sizer_t *sizer, buf_read_t *read, const leaf_node_t *node,
+                    const btree_key_t *key, void *value_out) {
+    const leaf::lookup_index_t *index
+        = static_cast<const leaf::lookup_index_t *>(read->get_derived_data());
+    if (index != NULL) {
+        return leaf::lookup(sizer, node, key, value_out, index);
+    }
+    if (!read->is_hot()) {
+        return leaf::lookup(sizer, node, key, value_out);
+    }
+    leaf::lookup_index_t *new_index = new leaf::lookup_index_t(node);
+    scoped_ptr_t<buf_derived_data_t> holder(new_index);
+    const bool ret = leaf::lookup(sizer, node, key, value_out, new_index);
+    read->set_derived_data(std::move(holder));
+    return ret;
+}
+
+// Follows `key` down from `node_id` for as long as the nodes are internal nodes that
+// can be read with `buf_optimistic_read_t`, and returns the id of the first node that
+// isn't -- a leaf, or a node that isn't in memory or that a writer is in line for.
+// `parent` must be the lock that `node_id` would be acquired through.
+block_id_t descend_optimistically(DEBUG_VAR value_sizer_t *sizer,
+                                  buf_parent_t parent,
+                                  block_id_t node_id,
+                                  const btree_key_t *key) {
+    ASSERT_NO_CORO_WAITING;
+    for (;;) {
+        buf_optimistic_read_t read(parent, node_id);
+        const void *data = read.get_data_read();
+        if (data == NULL || !node::is_internal(static_cast<const node_t *>(data))) {
+            return node_id;
+        }
+#ifndef NDEBUG
+        node::validate(sizer, static_cast<const node_t *>(data));
+#endif  // NDEBUG
+
+        const block_id_t child_id = lookup_in_internal_node(
+                &read, static_cast<const internal_node_t *>(data), key);
+        if (!read.validate()) {
+            return node_id;
+        }
+        rassert(child_id != NULL_BLOCK_ID && child_id != SUPERBLOCK_ID);
+        node_id = child_id;
+    }
+}
+
 void find_keyvalue_location_for_read(
         value_sizer_t *sizer,
         superblock_t *superblock, const btree_key_t *key,
         keyvalue_location_t *keyvalue_location_out,
         btree_stats_t *stats, profile::trace_t *trace) {
-    stats->pm_keys_read.record();
-    stats->pm_total_keys_read += 1;
+    stats->record_keys_read(1);
+    block_pm_latency latency(&stats->pm_read_latency);
 
     const block_id_t root_id = superblock->get_root_block_id();
     rassert(root_id != SUPERBLOCK_ID);
@@ -478,10 +779,16 @@ void find_keyvalue_location_for_read(
         return;
     }
 
+    // Descend through the tree's hot, uncontended internal nodes without getting in
+    // line for them, while still holding the superblock.  We then get in line for
+    // the node we stopped at, just where coupling locks down to it would have.
+    const block_id_t node_id = descend_optimistically(sizer, superblock->expose_buf(),
+                                                      root_id, key);
+
     buf_lock_t buf;
     {
         profile::starter_t starter("Acquire a block for read.", trace);
-        buf_lock_t tmp(superblock->expose_buf(), root_id, access_t::read);
+        buf_lock_t tmp(superblock->expose_buf(), node_id, access_t::read);
         superblock->release();
         buf = std::move(tmp);
     }
@@ -502,8 +809,8 @@ void find_keyvalue_location_for_read(
                 break;
             }
 
-            node_id = internal_node::lookup(static_cast<const internal_node_t *>(data),
-                                            key);
+            node_id = lookup_in_internal_node(
+                    &read, static_cast<const internal_node_t *>(data), key);
         }
         rassert(node_id != NULL_BLOCK_ID && node_id != SUPERBLOCK_ID);
 
@@ -529,7 +836,7 @@ void find_keyvalue_location_for_read(
         buf_read_t read(&buf);
         const leaf_node_t *leaf
             = static_cast<const leaf_node_t *>(read.get_data_read());
-        value_found = leaf::lookup(sizer, leaf, key, value.get());
+        value_found = lookup_in_leaf(sizer, &read, leaf, key, value.get());
     }
     if (value_found) {
         keyvalue_location_out->buf = std::move(buf);
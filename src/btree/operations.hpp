@@ -8,6 +8,7 @@
 
 #include "btree/leaf_node.hpp"
 #include "btree/node.hpp"
+#include "arch/runtime/resource_usage.hpp"
 #include "buffer_cache/alt.hpp"
 #include "concurrency/fifo_enforcer.hpp"
 #include "concurrency/new_semaphore.hpp"
@@ -63,11 +64,15 @@ public:
         : btree_collection(),
           pm_keys_read(secs_to_ticks(1)),
           pm_keys_set(secs_to_ticks(1)),
+          pm_read_latency(secs_to_ticks(1)),
+          pm_write_latency(secs_to_ticks(1)),
           pm_keys_membership(&btree_collection,
               &pm_keys_read, "keys_read",
               &pm_total_keys_read, "total_keys_read",
               &pm_keys_set, "keys_set",
-              &pm_total_keys_set, "total_keys_set") {
+              &pm_total_keys_set, "total_keys_set",
+              &pm_read_latency, "read_latency",
+              &pm_write_latency, "write_latency") {
         if (parent != NULL) {
             rename(parent, identifier);
         }
@@ -77,6 +82,23 @@ public:
         btree_collection_membership.reset();
     }
 
+    // Records `n` keys that were read, in our stats and as rows scanned in the
+    // current coroutine's resource usage.
+    void record_keys_read(size_t n) {
+        pm_keys_read.record(n);
+        pm_total_keys_read += n;
+        record_keys_scanned(n);
+    }
+
+    // Records keys that were looked at without loading their values (e.g. for a
+    // `count`), which only counts towards the resource usage.
+    static void record_keys_scanned(size_t n) {
+        resource_usage_t *usage = current_resource_usage();
+        if (usage != NULL) {
+            usage->rows_scanned += n;
+        }
+    }
+
     void rename(perfmon_collection_t *parent,
                 const std::string &identifier) {
         btree_collection_membership.reset();
@@ -94,6 +116,10 @@ public:
     perfmon_counter_t
         pm_total_keys_read,
         pm_total_keys_set;
+    // How long it takes to find a key's leaf, including waiting for blocks.
+    perfmon_latency_histogram_t
+        pm_read_latency,
+        pm_write_latency;
     perfmon_multi_membership_t pm_keys_membership;
 };
 
@@ -203,6 +229,17 @@ void find_keyvalue_location_for_write(
         profile::trace_t *trace,
         promise_t<superblock_t *> *pass_back_superblock = NULL) THROWS_NOTHING;
 
+/* Points `keyvalue_location` at `key` in the leaf that it already holds from an
+ * earlier call to `find_keyvalue_location_for_write()` and `apply_keyvalue_change()`,
+ * without walking down the tree again. Returns false and leaves
+ * `*keyvalue_location` alone if `key` doesn't belong into that leaf, if that can't
+ * be told from the leaf's parent alone, or if the leaf couldn't be split safely
+ * anymore. */
+bool find_keyvalue_location_in_same_leaf(
+        value_sizer_t *sizer,
+        const btree_key_t *key,
+        keyvalue_location_t *keyvalue_location) THROWS_NOTHING;
+
 void find_keyvalue_location_for_read(
         value_sizer_t *sizer,
         superblock_t *superblock, const btree_key_t *key,
@@ -168,7 +168,8 @@ btree_slice_t::btree_slice_t(cache_t *c, perfmon_collection_t *parent,
     : stats(parent,
             (index_type == index_type_t::SECONDARY ? "index-" : "") + identifier),
       cache_(c),
-      backfill_account_(cache()->create_cache_account(BACKFILL_CACHE_PRIORITY)) { }
+      backfill_account_(cache()->create_cache_account(BACKFILL_CACHE_PRIORITY,
+                                                       io_class_t::backfill)) { }
 
 btree_slice_t::~btree_slice_t() { }
 
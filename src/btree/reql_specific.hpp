@@ -2,6 +2,7 @@
 #ifndef BTREE_REQL_SPECIFIC_HPP_
 #define BTREE_REQL_SPECIFIC_HPP_
 
+#include "btree/key_filter.hpp"
 #include "btree/operations.hpp"
 
 /* Most of the code in the `btree/` directory doesn't "know" about the format of the
@@ -100,6 +101,9 @@ public:
 
     btree_stats_t stats;
 
+    // Only the store's primary B-tree builds its key filter.
+    key_filter_t key_filter;
+
 private:
     cache_t *cache_;
 
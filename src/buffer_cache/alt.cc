@@ -4,6 +4,7 @@
 
 #include "arch/types.hpp"
 #include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/resource_usage.hpp"
 #include "buffer_cache/stats.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "utils.hpp"
@@ -50,6 +51,10 @@ private:
     // alt_snapshot_node_t's referring to this node (via its children_ vector).
     int64_t ref_count_;
 
+    // True if buf_lock_t::retire_snapshotted_child() has marked some of children_ as
+    // deleted, so that nobody else may start using this node.
+    bool has_retired_children_;
+
 
     DISABLE_COPYING(alt_snapshot_node_t);
 };
@@ -84,17 +89,28 @@ void alt_txn_throttler_t::inform_memory_limit_change(uint64_t memory_limit,
 
 cache_t::cache_t(serializer_t *serializer,
                  cache_balancer_t *balancer,
-                 perfmon_collection_t *perfmon_collection)
+                 perfmon_collection_t *perfmon_collection,
+                 memory_tag_t memory_tag)
     : throttler_(MINIMUM_SOFT_UNWRITTEN_CHANGES_LIMIT),
-      page_cache_(serializer, balancer, &throttler_),
+      page_cache_(serializer, balancer, &throttler_, memory_tag),
       stats_(make_scoped<alt_cache_stats_t>(&page_cache_, perfmon_collection)) { }
 
 cache_t::~cache_t() {
     guarantee(snapshot_nodes_by_block_id_.empty());
 }
 
-cache_account_t cache_t::create_cache_account(int priority) {
-    return page_cache_.create_cache_account(priority);
+cache_account_t cache_t::create_cache_account(int priority, io_class_t io_class) {
+    return page_cache_.create_cache_account(priority, io_class);
+}
+
+void cache_t::set_quota_group(const uuid_u &group) {
+    assert_thread();
+    page_cache_.evicter().set_quota_group(group);
+}
+
+void cache_t::enable_warmup_snapshots(const std::string &path) {
+    assert_thread();
+    page_cache_.enable_warmup_snapshots(path);
 }
 
 alt_snapshot_node_t *
@@ -107,7 +123,8 @@ cache_t::matching_snapshot_node_or_null(block_id_t block_id,
     }
     intrusive_list_t<alt_snapshot_node_t> *list = &list_it->second;
     for (alt_snapshot_node_t *p = list->tail(); p != NULL; p = list->prev(p)) {
-        if (p->current_page_acq_->block_version() == block_version) {
+        if (p->current_page_acq_->block_version() == block_version
+            && !p->has_retired_children_) {
             return p;
         }
     }
@@ -229,6 +246,7 @@ txn_t::~txn_t() {
 
     if (durability_ == write_durability_t::SOFT) {
         cache_->page_cache_.flush_and_destroy_txn(std::move(page_txn_),
+                                                  durability_,
                                                   std::bind(&txn_t::inform_tracker,
                                                             cache_,
                                                             ph::_1));
@@ -236,6 +254,7 @@ txn_t::~txn_t() {
         cond_t cond;
         cache_->page_cache_.flush_and_destroy_txn(
                 std::move(page_txn_),
+                durability_,
                 std::bind(&txn_t::pulse_and_inform_tracker,
                           cache_, ph::_1, &cond));
         cond.wait();
@@ -248,7 +267,8 @@ void txn_t::set_account(cache_account_t *cache_account) {
 
 
 alt_snapshot_node_t::alt_snapshot_node_t(scoped_ptr_t<current_page_acq_t> &&acq)
-    : current_page_acq_(std::move(acq)), ref_count_(0) { }
+    : current_page_acq_(std::move(acq)), ref_count_(0),
+      has_retired_children_(false) { }
 
 alt_snapshot_node_t::~alt_snapshot_node_t() {
     // The only thing that deletes an alt_snapshot_node_t should be the
@@ -680,6 +700,39 @@ void buf_lock_t::detach_child(block_id_t child_id) {
             child_id);
 }
 
+void buf_lock_t::retire_snapshotted_child(block_id_t child_id) {
+    ASSERT_FINITE_CORO_WAITING;
+    guarantee(!empty());
+
+    // If anybody else refers to the snapshot node, they might still want the child.
+    // (Nobody new can start referring to it after this, because
+    // matching_snapshot_node_or_null() skips it.)
+    alt_snapshot_node_t *node = snapshot_node_;
+    if (node == NULL || node->ref_count_ != 1) {
+        return;
+    }
+    node->has_retired_children_ = true;
+
+    // Marking the child as deleted (instead of just removing it) keeps writers from
+    // attaching the versions they replace to the node.
+    alt_snapshot_node_t *child = NULL;
+    auto it = node->children_.find(child_id);
+    if (it == node->children_.end()) {
+        node->children_.insert(std::make_pair(child_id,
+                                              static_cast<alt_snapshot_node_t *>(NULL)));
+    } else {
+        child = it->second;
+        it->second = NULL;
+    }
+
+    if (child != NULL) {
+        --child->ref_count_;
+        if (child->ref_count_ == 0) {
+            cache()->remove_snapshot_node(child_id, child);
+        }
+    }
+}
+
 repli_timestamp_t buf_lock_t::get_recency() const {
     guarantee(!empty());
     current_page_acq_t *cpa = current_page_acq();
@@ -753,17 +806,103 @@ buf_read_t::~buf_read_t() {
     lock_->access_ref_count_--;
 }
 
+// Counts a block acquisition towards the current coroutine's resource usage.  If the
+// buffer wasn't ready right after we initialized the `page_acq_t`, the block had to
+// be loaded.
+static void charge_block_acquisition(bool was_ready, uint32_t block_size,
+                                     bool is_write) {
+    resource_usage_t *usage = current_resource_usage();
+    if (usage == NULL) {
+        return;
+    }
+    if (was_ready) {
+        ++usage->blocks_from_cache;
+    } else {
+        ++usage->blocks_from_disk;
+    }
+    if (is_write) {
+        usage->bytes_written += block_size;
+    } else {
+        usage->bytes_read += block_size;
+    }
+}
+
 const void *buf_read_t::get_data_read(uint32_t *block_size_out) {
     page_t *page = lock_->get_held_page_for_read();
+    bool first_access = false;
+    bool was_ready = false;
     if (!page_acq_.has()) {
         page_acq_.init(page, &lock_->cache()->page_cache_,
                        lock_->txn()->account());
+        first_access = true;
+        was_ready = page_acq_.buf_ready_signal()->is_pulsed();
     }
     page_acq_.buf_ready_signal()->wait();
     *block_size_out = page_acq_.get_buf_size().value();
+    if (first_access) {
+        charge_block_acquisition(was_ready, *block_size_out, false);
+    }
     return page_acq_.get_buf_read();
 }
 
+buf_derived_data_t *buf_read_t::get_derived_data() {
+    guarantee(page_acq_.has(), "get_data_read() must be called first.");
+    return page_acq_.get_derived_data();
+}
+
+void buf_read_t::set_derived_data(scoped_ptr_t<buf_derived_data_t> &&data) {
+    guarantee(page_acq_.has(), "get_data_read() must be called first.");
+    page_acq_.set_derived_data(std::move(data));
+}
+
+bool buf_read_t::is_hot() {
+    guarantee(page_acq_.has(), "get_data_read() must be called first.");
+    return !page_acq_.page_is_probationary();
+}
+
+buf_optimistic_read_t::buf_optimistic_read_t(buf_parent_t parent,
+                                             block_id_t block_id)
+    : cache_(parent.cache()),
+      block_id_(block_id),
+      usable_(false),
+      page_(NULL) {
+    buf_lock_t *lock = parent.lock_or_null_;
+    // Snapshotted parents hand out old versions of their children, which only
+    // buf_lock_t knows how to find.
+    usable_ = lock != NULL
+        && lock->snapshot_node_ == NULL
+        && lock->read_acq_signal()->is_pulsed();
+}
+
+const void *buf_optimistic_read_t::get_data_read() {
+    if (!usable_) {
+        return NULL;
+    }
+    page_ = cache_->page_cache_.optimistic_page_for_read(block_id_, &block_version_);
+    if (page_ == NULL) {
+        return NULL;
+    }
+    guarantee(page_->get_page_buf_size().value() == cache_->max_block_size().value());
+    // Bumps the page's access time, like a real acquisition would.
+    return page_->get_page_buf(&cache_->page_cache_);
+}
+
+buf_derived_data_t *buf_optimistic_read_t::get_derived_data() {
+    guarantee(page_ != NULL);
+    return page_->derived_data();
+}
+
+void buf_optimistic_read_t::set_derived_data(
+        scoped_ptr_t<buf_derived_data_t> &&data) {
+    guarantee(page_ != NULL);
+    page_->set_derived_data(std::move(data));
+}
+
+bool buf_optimistic_read_t::validate() const {
+    guarantee(page_ != NULL);
+    return cache_->page_cache_.optimistic_read_is_valid(block_id_, block_version_);
+}
+
 buf_write_t::buf_write_t(buf_lock_t *lock)
     : lock_(lock) {
     guarantee(lock_->access() == access_t::write);
@@ -780,6 +919,8 @@ void *buf_write_t::get_data_write(uint32_t block_size) {
     if (!page_acq_.has()) {
         page_acq_.init(page, &lock_->cache()->page_cache_,
                        lock_->txn()->account());
+        charge_block_acquisition(page_acq_.buf_ready_signal()->is_pulsed(),
+                                 block_size, true);
     }
     page_acq_.buf_ready_signal()->wait();
     return page_acq_.get_buf_write(block_size_t::make_from_cache(block_size));
@@ -40,9 +40,11 @@ private:
 
 class cache_t : public home_thread_mixin_t {
 public:
+    // The memory of the cached pages counts towards `memory_tag`.
     explicit cache_t(serializer_t *serializer,
                      cache_balancer_t *balancer,
-                     perfmon_collection_t *perfmon_collection);
+                     perfmon_collection_t *perfmon_collection,
+                     memory_tag_t memory_tag = memory_tag_t::page_cache);
     ~cache_t();
 
     max_block_size_t max_block_size() const { return page_cache_.max_block_size(); }
@@ -52,13 +54,24 @@ public:
     // throttling systems.  TODO: Come up with a consistent priority scheme,
     // i.e. define a "default" priority etc.  TODO: As soon as we can support it, we
     // might consider supporting a mem_cap paremeter.
-    cache_account_t create_cache_account(int priority);
+    cache_account_t create_cache_account(int priority,
+                                         io_class_t io_class = io_class_t::other);
+
+    // Puts the cache into a group whose `cache_quota_t` the cache balancer honors.
+    void set_quota_group(const uuid_u &group);
+
+    // See `page_cache_t::enable_warmup_snapshots()`.
+    void enable_warmup_snapshots(const std::string &path);
+
+    // Whether any block is snapshotted at the moment.
+    bool has_snapshots() const { return !snapshot_nodes_by_block_id_.empty(); }
 
 private:
     friend class txn_t;
     friend class buf_read_t;
     friend class buf_write_t;
     friend class buf_lock_t;
+    friend class buf_optimistic_read_t;
 
     alt_snapshot_node_t *matching_snapshot_node_or_null(
             block_id_t block_id,
@@ -192,6 +205,14 @@ public:
 
     void detach_child(block_id_t child_id);
 
+    // Tells a snapshotted lock that its holder won't acquire the child `child_id`
+    // through it again.  A long scan holds on to the snapshot of the nodes above the
+    // one it's at, and with it every old version of their subtrees that writers have
+    // replaced since.  Once the scan is past a subtree, this lets the cache free
+    // those versions, unless somebody else shares the snapshot.  Does nothing if the
+    // lock isn't snapshotted.
+    void retire_snapshotted_child(block_id_t child_id);
+
     block_id_t block_id() const {
         guarantee(txn_ != NULL);
         return current_page_acq()->block_id();
@@ -252,6 +273,7 @@ private:
 
     friend class buf_read_t;  // for get_held_page_for_read, access_ref_count_.
     friend class buf_write_t;  // for get_held_page_for_write, access_ref_count_.
+    friend class buf_optimistic_read_t;  // for snapshot_node_.
 
     alt::page_t *get_held_page_for_read();
     alt::page_t *get_held_page_for_write();
@@ -306,6 +328,7 @@ public:
 
 private:
     friend class buf_lock_t;
+    friend class buf_optimistic_read_t;
     txn_t *txn_;
     buf_lock_t *lock_or_null_;
 };
@@ -323,6 +346,18 @@ public:
         return data;
     }
 
+    // Data derived from the block's contents that some earlier reader cached with it
+    // using set_derived_data(), or NULL.  The cache drops it whenever the block gets
+    // acquired for write.
+    buf_derived_data_t *get_derived_data();
+    // Caches `data`, which must have been computed from get_data_read(), with the
+    // block.
+    void set_derived_data(scoped_ptr_t<buf_derived_data_t> &&data);
+    // False if the block hasn't been acquired before since it was loaded (by a table
+    // scan or read-ahead, say), in which case computing derived data for it might
+    // not pay off.
+    bool is_hot();
+
 private:
     buf_lock_t *lock_;
     alt::page_acq_t page_acq_;
@@ -330,6 +365,41 @@ private:
     DISABLE_COPYING(buf_read_t);
 };
 
+// Reads a block without getting in line for it, so that read-only descents through
+// hot, uncontended internal nodes don't have to couple buf_lock_t's all the way
+// down (optimistic lock coupling).  The parent must stay acquired throughout.
+// Since we're not in line, the data may only be used until the coroutine yields,
+// and validate() must be checked after extracting what you need from it (e.g. a
+// child block id).  Acquire the node the descent ends at with a buf_lock_t using the
+// same parent: it gets in line exactly where coupled buf_lock_t's would have put it.
+class buf_optimistic_read_t {
+public:
+    buf_optimistic_read_t(buf_parent_t parent, block_id_t block_id);
+
+    // Returns NULL if the block can't be read optimistically -- because it isn't
+    // loaded in memory, a write acquirer is in line for it, or the parent isn't
+    // read-acquired or is snapshotted.  Fall back to a buf_lock_t in that case.
+    const void *get_data_read();
+
+    // Like buf_read_t's, and only after get_data_read() returned non-NULL.
+    buf_derived_data_t *get_derived_data();
+    void set_derived_data(scoped_ptr_t<buf_derived_data_t> &&data);
+
+    // True if no write acquirer has gotten in line for the block since
+    // get_data_read() returned non-NULL.
+    bool validate() const;
+
+private:
+    cache_t *cache_;
+    block_id_t block_id_;
+    alt::block_version_t block_version_;
+    bool usable_;
+    // The page, once get_data_read() has returned non-NULL.
+    alt::page_t *page_;
+
+    DISABLE_COPYING(buf_optimistic_read_t);
+};
+
 class buf_write_t {
 public:
     explicit buf_write_t(buf_lock_t *lock);
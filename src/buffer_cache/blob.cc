@@ -12,10 +12,12 @@
 #include "math.hpp"
 #include "serializer/types.hpp"
 
-// The maximal number of blocks to traverse concurrently.
-// Roughly equivalent to the maximal number of coroutines that loading a blob
-// can allocate.
-const int64_t BLOB_TRAVERSAL_CONCURRENCY = 8;
+// The maximal number of leaf blocks to traverse concurrently below one internal
+// node, and the maximal number of internal nodes to traverse concurrently below the
+// next level up.  The maximal number of coroutines that loading a blob can allocate
+// is roughly the product of the two for a blob with two levels.
+const int64_t BLOB_TRAVERSAL_CONCURRENCY = 32;
+const int64_t BLOB_INTERNAL_TRAVERSAL_CONCURRENCY = 4;
 
 template <class T>
 void clear_and_delete(std::vector<T *> *vec) {
@@ -42,17 +44,17 @@ int block_ids_offset(int maxreflen) {
     return big_size_offset(maxreflen) + sizeof(int64_t);
 }
 
+// touches_end_t specifies whether the [offset, offset + size) region given to
+// make_tree_from_block_ids touches the end of the data in the blob.
+enum class touches_end_t { yes, no };
 temporary_acq_tree_node_t *
 make_tree_from_block_ids(buf_parent_t parent, access_t mode, int levels,
-                         int64_t offset, int64_t size, const block_id_t *block_ids);
+                         int64_t offset, int64_t size, touches_end_t touches_end,
+                         const block_id_t *block_ids);
 
-// touches_end_t specifies whether the [offset, offset + size) region given to
-// expose_tree_from_block_ids touches the end of the data in the blob.
-enum class touches_end_t { yes, no };
-void expose_tree_from_block_ids(buf_parent_t parent, access_t mode,
-                                int levels, int64_t offset, int64_t size,
+void expose_tree_from_block_ids(buf_parent_t parent, int levels,
+                                int64_t offset, int64_t size,
                                 temporary_acq_tree_node_t *tree,
-                                touches_end_t touches_end,
                                 buffer_group_t *buffer_group_out,
                                 blob_acq_t *acq_group_out);
 
@@ -309,8 +311,18 @@ void blob_t::detach_subtrees(buf_parent_t root) {
     }
 }
 
-union temporary_acq_tree_node_t {
+// A leaf block of a blob region, acquired and loaded by `make_tree_from_block_ids`.
+struct temporary_acq_leaf_t {
+    temporary_acq_leaf_t() : buf(NULL), read(NULL), write(NULL), data(NULL) { }
     buf_lock_t *buf;
+    // Exactly one of `read` and `write` is set, depending on the access mode.
+    buf_read_t *read;
+    buf_write_t *write;
+    char *data;
+};
+
+union temporary_acq_tree_node_t {
+    temporary_acq_leaf_t *leaf;
     temporary_acq_tree_node_t *child;
 };
 
@@ -336,19 +348,19 @@ void blob_t::expose_region(buf_parent_t parent, access_t mode,
         const int levels = blob::ref_info(parent.cache()->max_block_size(),
                                           ref_, maxreflen_).levels;
 
-        // Acquiring is done recursively in parallel,
+        // Acquiring and loading the blocks is done recursively in parallel,
         temporary_acq_tree_node_t *tree
             = blob::make_tree_from_block_ids(parent, mode, levels,
                                              offset, size,
+                                             size == valuesize()
+                                             ? blob::touches_end_t::yes
+                                             : blob::touches_end_t::no,
                                              blob::block_ids(ref_, maxreflen_));
 
         // Exposing and writing to the buffer group is done serially.
-        blob::expose_tree_from_block_ids(parent, mode, levels,
+        blob::expose_tree_from_block_ids(parent, levels,
                                          offset, size,
                                          tree,
-                                         size == valuesize()
-                                         ? blob::touches_end_t::yes
-                                         : blob::touches_end_t::no,
                                          buffer_group_out,
                                          acq_group_out);
     }
@@ -370,36 +382,70 @@ struct region_tree_filler_t {
     access_t mode;
     int levels;
     int64_t offset, size;
+    touches_end_t touches_end;
     const block_id_t *block_ids;
     int lo, hi;
     temporary_acq_tree_node_t *nodes;
 
     void operator()(int i) const {
+        const max_block_size_t block_size = parent.cache()->max_block_size();
+        int64_t suboffset, subsize;
+        shrink(block_size, levels, offset, size, lo + i, &suboffset, &subsize);
         if (levels > 1) {
             buf_lock_t lock(parent, block_ids[lo + i], mode);
             buf_read_t buf_read(&lock);
             const block_id_t *sub_ids
                 = blob::internal_node_block_ids(buf_read.get_data_read());
 
-            int64_t suboffset, subsize;
-            shrink(parent.cache()->max_block_size(), levels, offset, size, lo + i, &suboffset, &subsize);
             nodes[i].child = blob::make_tree_from_block_ids(buf_parent_t(&lock),
                                                             mode, levels - 1,
                                                             suboffset, subsize,
-                                                            sub_ids);
+                                                            touches_end, sub_ids);
         } else {
-            nodes[i].buf = new buf_lock_t(parent, block_ids[lo + i], mode);
+            rassert(0 < subsize && subsize <= blob::leaf_size(block_size));
+            rassert(0 <= suboffset
+                    && suboffset + subsize <= blob::leaf_size(block_size));
+
+            // We load the leaf here rather than in `expose_tree_from_block_ids`, so
+            // that the loads of all the leaves are in flight at the same time.
+            temporary_acq_leaf_t *leaf = new temporary_acq_leaf_t;
+            leaf->buf = new buf_lock_t(parent, block_ids[lo + i], mode);
+            void *leaf_buf;
+            if (mode == access_t::read) {
+                leaf->read = new buf_read_t(leaf->buf);
+                // We can't assert a specific block size here (without undesirably
+                // intricate logic), because immediately after creation, the blob has
+                // size max_value_size, but after we've written to the block, its
+                // size could be shrunken.
+                uint32_t leaf_block_size;
+                leaf_buf = const_cast<void *>(
+                    leaf->read->get_data_read(&leaf_block_size));
+            } else {
+                leaf->write = new buf_write_t(leaf->buf);
+                if (touches_end == touches_end_t::yes) {
+                    // Using suboffset + subsize is valid because we know that, when
+                    // appending, there are no bytes in this block past suboffset +
+                    // subsize that are a valid part of the blob.
+                    leaf_buf = leaf->write->get_data_write(
+                        suboffset + subsize + blob::LEAF_NODE_DATA_OFFSET);
+                } else {
+                    leaf_buf = leaf->write->get_data_write();
+                }
+            }
+            leaf->data = blob::leaf_node_data(leaf_buf);
+            nodes[i].leaf = leaf;
         }
     }
 };
 
 int64_t choose_concurrency(int levels) {
-    // Parallelize on the lowest level. That way we get a higher chance
-    // of sequential disk reads, assuming that the blob is laid out on disk
-    // from left to right (which might or might not be true, depending the details
-    // of how it was written and how the cache and serializer operate).
+    // Internal nodes fan out to many leaves each, so a few of them are enough to keep
+    // plenty of leaf loads in flight.  Leaves are what we actually wait on, so that
+    // is where most of the concurrency goes.  The serializer's read-ahead still
+    // turns neighbouring leaf loads into bigger reads if the blob is laid out on
+    // disk from left to right.
     if (levels > 1) {
-        return 1;
+        return BLOB_INTERNAL_TRAVERSAL_CONCURRENCY;
     } else {
         rassert(levels == 1);
         return BLOB_TRAVERSAL_CONCURRENCY;
@@ -408,7 +454,8 @@ int64_t choose_concurrency(int levels) {
 
 temporary_acq_tree_node_t *
 make_tree_from_block_ids(buf_parent_t parent, access_t mode, int levels,
-                         int64_t offset, int64_t size, const block_id_t *block_ids) {
+                         int64_t offset, int64_t size, touches_end_t touches_end,
+                         const block_id_t *block_ids) {
     rassert(size > 0);
 
     region_tree_filler_t filler(parent);
@@ -416,6 +463,7 @@ make_tree_from_block_ids(buf_parent_t parent, access_t mode, int levels,
     filler.levels = levels;
     filler.offset = offset;
     filler.size = size;
+    filler.touches_end = touches_end;
     filler.block_ids = block_ids;
     compute_acquisition_offsets(parent.cache()->max_block_size(), levels, offset,
                                 size, &filler.lo, &filler.hi);
@@ -427,10 +475,9 @@ make_tree_from_block_ids(buf_parent_t parent, access_t mode, int levels,
     return filler.nodes;
 }
 
-void expose_tree_from_block_ids(buf_parent_t parent, access_t mode,
-                                int levels, int64_t offset, int64_t size,
+void expose_tree_from_block_ids(buf_parent_t parent, int levels,
+                                int64_t offset, int64_t size,
                                 temporary_acq_tree_node_t *tree,
-                                touches_end_t touches_end,
                                 buffer_group_t *buffer_group_out,
                                 blob_acq_t *acq_group_out) {
     rassert(size > 0);
@@ -444,42 +491,19 @@ void expose_tree_from_block_ids(buf_parent_t parent, access_t mode,
         blob::shrink(parent.cache()->max_block_size(), levels, offset, size,
                      lo + i, &suboffset, &subsize);
         if (levels > 1) {
-            expose_tree_from_block_ids(parent, mode, levels - 1, suboffset,
-                                       subsize, tree[i].child, touches_end,
+            expose_tree_from_block_ids(parent, levels - 1, suboffset,
+                                       subsize, tree[i].child,
                                        buffer_group_out,
                                        acq_group_out);
         } else {
-            rassert(0 < subsize && subsize <= blob::leaf_size(parent.cache()->max_block_size()));
-            rassert(0 <= suboffset && suboffset + subsize <= blob::leaf_size(parent.cache()->max_block_size()));
-
-            buf_lock_t *buf = tree[i].buf;
-            void *leaf_buf;
-            if (mode == access_t::read) {
-                buf_read_t *buf_read = new buf_read_t(buf);
-                // We can't assert a specific block size here (without undesirably
-                // intricate logic), because immediately after creation, the blob has
-                // size max_value_size, but after we've written to the block, its
-                // size could be shrunken.
-                uint32_t block_size;
-                leaf_buf = const_cast<void *>(buf_read->get_data_read(&block_size));
-                acq_group_out->add_buf(buf, buf_read);
+            temporary_acq_leaf_t *leaf = tree[i].leaf;
+            if (leaf->read != NULL) {
+                acq_group_out->add_buf(leaf->buf, leaf->read);
             } else {
-                buf_write_t *buf_write = new buf_write_t(buf);
-                if (touches_end == touches_end_t::yes) {
-                    // Using suboffset + subsize is valid because we know that, when
-                    // appending, there are no bytes in this block past suboffset +
-                    // subsize that are a valid part of the blob.
-                    leaf_buf = buf_write->get_data_write(suboffset + subsize
-                                                         + blob::LEAF_NODE_DATA_OFFSET);
-                } else {
-                    leaf_buf = buf_write->get_data_write();
-                }
-
-                acq_group_out->add_buf(buf, buf_write);
+                acq_group_out->add_buf(leaf->buf, leaf->write);
             }
-
-            char *data = blob::leaf_node_data(leaf_buf);
-            buffer_group_out->add_buffer(subsize, data + suboffset);
+            buffer_group_out->add_buffer(subsize, leaf->data + suboffset);
+            delete leaf;
         }
     }
 
@@ -0,0 +1,193 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "buffer_cache/block_slab.hpp"
+
+#include <sys/mman.h>
+
+#include "math.hpp"
+#include "serializer/types.hpp"
+#include "utils.hpp"
+
+// Buffers bigger than this fraction of a slab just come from malloc.
+const size_t MAX_BUFFERS_PER_SLAB_DIVISOR = 8;
+
+struct block_slab_allocator_t::slab_t
+    : public intrusive_list_node_t<block_slab_allocator_t::slab_t> {
+    char *base;
+    size_class_t *size_class;
+    // How many buffers the slab has room for, and how many of them have ever been
+    // handed out.  Buffers past `used_count` have never been touched, so we don't
+    // need to put them on the free list, and their memory stays unfaulted.
+    size_t capacity;
+    size_t used_count;
+    // Buffers that were handed out and freed again, chained through their first
+    // bytes.
+    void *free_list;
+    size_t in_use;
+};
+
+struct block_slab_allocator_t::size_class_t {
+    explicit size_class_t(size_t _buffer_size)
+        : buffer_size(_buffer_size), empty_slabs(0) { }
+    size_t buffer_size;
+    // Slabs that have room for another buffer.
+    intrusive_list_t<slab_t> available;
+    size_t empty_slabs;
+};
+
+block_slab_allocator_t::block_slab_allocator_t(size_t slab_size)
+    : slab_size_(slab_size) {
+    guarantee(slab_size_ >= DEVICE_BLOCK_SIZE * MAX_BUFFERS_PER_SLAB_DIVISOR);
+    guarantee((slab_size_ & (slab_size_ - 1)) == 0,
+              "slab size %zu is not a power of two", slab_size_);
+}
+
+block_slab_allocator_t::~block_slab_allocator_t() {
+    for (auto it = slabs_.begin(); it != slabs_.end(); ++it) {
+        if (it->second->in_a_list()) {
+            it->second->size_class->available.remove(it->second);
+        }
+        destroy_slab(it->second);
+    }
+    for (auto it = size_classes_.begin(); it != size_classes_.end(); ++it) {
+        delete it->second;
+    }
+}
+
+void *block_slab_allocator_t::allocate(size_t size) {
+    const size_t buffer_size = ceil_aligned(size, DEVICE_BLOCK_SIZE);
+    if (buffer_size > slab_size_ / MAX_BUFFERS_PER_SLAB_DIVISOR) {
+        return NULL;
+    }
+
+    spinlock_acq_t acq(&lock_);
+
+    size_class_t *size_class;
+    auto it = size_classes_.find(buffer_size);
+    if (it == size_classes_.end()) {
+        size_class = new size_class_t(buffer_size);
+        size_classes_.insert(std::make_pair(buffer_size, size_class));
+    } else {
+        size_class = it->second;
+    }
+
+    slab_t *slab = size_class->available.head();
+    if (slab == NULL) {
+        slab = create_slab(size_class);
+        size_class->available.push_front(slab);
+        ++size_class->empty_slabs;
+    }
+
+    void *ret;
+    if (slab->free_list != NULL) {
+        ret = slab->free_list;
+        slab->free_list = *static_cast<void **>(ret);
+    } else {
+        rassert(slab->used_count < slab->capacity);
+        ret = slab->base + slab->used_count * buffer_size;
+        ++slab->used_count;
+    }
+
+    if (slab->in_use == 0) {
+        --size_class->empty_slabs;
+    }
+    ++slab->in_use;
+    if (slab->free_list == NULL && slab->used_count == slab->capacity) {
+        size_class->available.remove(slab);
+    }
+    return ret;
+}
+
+bool block_slab_allocator_t::deallocate(void *ptr) {
+    const uintptr_t base = reinterpret_cast<uintptr_t>(ptr) & ~(slab_size_ - 1);
+
+    spinlock_acq_t acq(&lock_);
+
+    auto it = slabs_.find(base);
+    if (it == slabs_.end()) {
+        return false;
+    }
+    slab_t *slab = it->second;
+    size_class_t *size_class = slab->size_class;
+    rassert((static_cast<char *>(ptr) - slab->base) % size_class->buffer_size == 0);
+
+    if (!slab->in_a_list()) {
+        size_class->available.push_back(slab);
+    }
+    *static_cast<void **>(ptr) = slab->free_list;
+    slab->free_list = ptr;
+    --slab->in_use;
+
+    if (slab->in_use == 0) {
+        if (size_class->empty_slabs > 0) {
+            size_class->available.remove(slab);
+            slabs_.erase(it);
+            destroy_slab(slab);
+        } else {
+            ++size_class->empty_slabs;
+        }
+    }
+    return true;
+}
+
+uint64_t block_slab_allocator_t::slab_bytes() const {
+    spinlock_acq_t acq(&lock_);
+    return static_cast<uint64_t>(slabs_.size()) * slab_size_;
+}
+
+block_slab_allocator_t::slab_t *
+block_slab_allocator_t::create_slab(size_class_t *size_class) {
+    // Explicit huge pages only work if the administrator has reserved some, so if we
+    // can't get them we fall back to transparent huge pages.  For those we have to
+    // align the mapping ourselves.
+    int huge_flags = MAP_HUGETLB;
+#ifdef MAP_HUGE_SHIFT
+    huge_flags |= __builtin_ctzll(slab_size_) << MAP_HUGE_SHIFT;
+#endif
+    void *base = mmap(NULL, slab_size_, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | huge_flags, -1, 0);
+    if (base == MAP_FAILED) {
+        void *region = mmap(NULL, 2 * slab_size_, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED) {
+            crash_oom();
+        }
+        const uintptr_t start = reinterpret_cast<uintptr_t>(region);
+        const uintptr_t aligned = ceil_aligned(start, slab_size_);
+        if (aligned > start) {
+            munmap(region, aligned - start);
+        }
+        munmap(reinterpret_cast<char *>(aligned) + slab_size_,
+               start + slab_size_ - aligned);
+        base = reinterpret_cast<void *>(aligned);
+#ifdef MADV_HUGEPAGE
+        madvise(base, slab_size_, MADV_HUGEPAGE);
+#endif
+    }
+
+    slab_t *slab = new slab_t;
+    slab->base = static_cast<char *>(base);
+    slab->size_class = size_class;
+    slab->capacity = slab_size_ / size_class->buffer_size;
+    slab->used_count = 0;
+    slab->free_list = NULL;
+    slab->in_use = 0;
+    slabs_.insert(std::make_pair(reinterpret_cast<uintptr_t>(base), slab));
+    return slab;
+}
+
+void block_slab_allocator_t::destroy_slab(slab_t *slab) {
+    int res = munmap(slab->base, slab_size_);
+    guarantee_err(res == 0, "munmap failed");
+    delete slab;
+}
+
+static block_slab_allocator_t *block_slab_allocator = NULL;
+
+void enable_block_slabs(size_t slab_size) {
+    guarantee(block_slab_allocator == NULL);
+    block_slab_allocator = new block_slab_allocator_t(slab_size);
+}
+
+block_slab_allocator_t *get_block_slab_allocator() {
+    return block_slab_allocator;
+}
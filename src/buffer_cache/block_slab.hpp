@@ -0,0 +1,70 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_BLOCK_SLAB_HPP_
+#define BUFFER_CACHE_BLOCK_SLAB_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <map>
+#include <unordered_map>
+
+#include "arch/spinlock.hpp"
+#include "containers/intrusive_list.hpp"
+#include "errors.hpp"
+
+// Carves block buffers out of huge-page backed slabs.  A big cache made of
+// individually malloc'd buffers needs a TLB entry for every 4 KB page it touches, and
+// btree traversals miss the TLB all the time.  With 2 MB (or 1 GB) pages, one entry
+// covers hundreds of blocks.
+//
+// Every slab holds buffers of a single size.  Buffers get allocated and freed on
+// whatever thread holds them at the time (blocks are read on the serializer's thread
+// and evicted on the cache's), so there is one allocator for the whole process,
+// guarded by a spinlock.  Once all of a slab's buffers are freed, the slab is given
+// back to the OS -- except for one spare slab per buffer size, to avoid thrashing.
+class block_slab_allocator_t {
+public:
+    // `slab_size` must be a power of two, and is the huge page size we ask for.
+    explicit block_slab_allocator_t(size_t slab_size);
+    ~block_slab_allocator_t();
+
+    // Returns a DEVICE_BLOCK_SIZE-aligned buffer of `size` bytes, or NULL if `size` is
+    // too big to be worth putting in a slab (the caller should use malloc then).
+    void *allocate(size_t size);
+
+    // Frees a buffer returned by `allocate`.  Returns false, and does nothing, if
+    // `ptr` doesn't point into one of our slabs.
+    bool deallocate(void *ptr);
+
+    size_t slab_size() const { return slab_size_; }
+
+    // How much memory is held in slabs, including free space within them.
+    uint64_t slab_bytes() const;
+
+private:
+    struct slab_t;
+    struct size_class_t;
+
+    slab_t *create_slab(size_class_t *size_class);
+    void destroy_slab(slab_t *slab);
+
+    const size_t slab_size_;
+
+    mutable spinlock_t lock_;
+
+    // Size classes by buffer size.  Owned (and deleted) by us.
+    std::map<size_t, size_class_t *> size_classes_;
+    // Slabs by their base address, which is a multiple of `slab_size_`.
+    std::unordered_map<uintptr_t, slab_t *> slabs_;
+
+    DISABLE_COPYING(block_slab_allocator_t);
+};
+
+// Makes the page cache allocate its block buffers from huge page slabs of the given
+// size.  Must be called before the thread pool starts, if at all.
+void enable_block_slabs(size_t slab_size);
+
+// The allocator for block buffers, or NULL if they come from malloc (the default).
+block_slab_allocator_t *get_block_slab_allocator();
+
+#endif  // BUFFER_CACHE_BLOCK_SLAB_HPP_
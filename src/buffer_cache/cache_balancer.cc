@@ -1,7 +1,9 @@
 #include "buffer_cache/cache_balancer.hpp"
 
+#include <algorithm>
 #include <limits>
 
+#include "buffer_cache/block_slab.hpp"
 #include "buffer_cache/evicter.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "concurrency/pmap.hpp"
@@ -14,10 +16,12 @@ const double alt_cache_balancer_t::read_ahead_proportion = 0.9;
 
 alt_cache_balancer_t::cache_data_t::cache_data_t(alt::evicter_t *_evicter) :
     evicter(_evicter),
+    quota_group(evicter->quota_group()),
     new_size(0),
     old_size(evicter->memory_limit()),
     bytes_loaded(evicter->get_clamped_bytes_loaded()),
-    access_count(evicter->access_count()) { }
+    access_count(evicter->access_count()),
+    at_quota_limit(false) { }
 
 alt_cache_balancer_t::alt_cache_balancer_t(
         clone_ptr_t<watchable_t<uint64_t> > _total_cache_size_watchable) :
@@ -68,6 +72,128 @@ void alt_cache_balancer_t::wake_up_activity_happened() {
     }
 }
 
+void alt_cache_balancer_t::set_quota(const uuid_u &group, const cache_quota_t &quota) {
+    assert_thread();
+    guarantee(!group.is_nil());
+    guarantee(quota.weight > 0);
+    guarantee(quota.min_bytes <= quota.max_bytes);
+    quotas[group] = quota;
+    last_rebalance_time = 0;
+    wake_up_activity_happened();
+    pool_queue.give_value(alt_cache_balancer_dummy_value_t());
+}
+
+void alt_cache_balancer_t::remove_quota(const uuid_u &group) {
+    assert_thread();
+    quotas.erase(group);
+}
+
+const cache_quota_t &alt_cache_balancer_t::get_quota(const uuid_u &group) const {
+    static const cache_quota_t default_quota;
+    auto it = quotas.find(group);
+    return it == quotas.end() ? default_quota : it->second;
+}
+
+void alt_cache_balancer_t::apply_quota_limits(
+        uint64_t total_cache_size,
+        scoped_array_t<std::vector<cache_data_t> > *cache_data) const {
+    struct group_t {
+        group_t() : size(0), target(0), num_evicters(0), fixed(false) { }
+        uint64_t size;
+        uint64_t target;
+        size_t num_evicters;
+        bool fixed;
+    };
+
+    std::map<uuid_u, group_t> groups;
+    bool any_limits = false;
+    for (size_t i = 0; i < cache_data->size(); ++i) {
+        for (const cache_data_t &data : (*cache_data)[i]) {
+            group_t *group = &groups[data.quota_group];
+            group->size += data.new_size;
+            group->num_evicters += 1;
+            const cache_quota_t &quota = get_quota(data.quota_group);
+            any_limits |= quota.min_bytes > 0 || quota.max_bytes < UINT64_MAX;
+        }
+    }
+    if (!any_limits) {
+        return;
+    }
+
+    // If the minimums can't all be satisfied, scale them down proportionally.
+    double min_scale = 1.0;
+    {
+        double total_min_bytes = 0;
+        for (const auto &pair : groups) {
+            total_min_bytes += get_quota(pair.first).min_bytes;
+        }
+        if (total_min_bytes > total_cache_size) {
+            min_scale = total_cache_size / total_min_bytes;
+        }
+    }
+
+    // Every round fixes at least one more group at one of its limits, and hands the
+    // rest of the memory to the other groups in proportion to their demand-based size.
+    for (size_t round = 0; round <= groups.size(); ++round) {
+        uint64_t fixed_bytes = 0;
+        uint64_t unfixed_size = 0;
+        size_t num_unfixed = 0;
+        for (const auto &pair : groups) {
+            if (pair.second.fixed) {
+                fixed_bytes += pair.second.target;
+            } else {
+                unfixed_size += pair.second.size;
+                ++num_unfixed;
+            }
+        }
+        if (num_unfixed == 0) {
+            break;
+        }
+        const double free_bytes = fixed_bytes < total_cache_size
+            ? total_cache_size - fixed_bytes
+            : 0;
+
+        bool changed = false;
+        for (auto &pair : groups) {
+            group_t *group = &pair.second;
+            if (group->fixed) {
+                continue;
+            }
+            const cache_quota_t &quota = get_quota(pair.first);
+            const double share = unfixed_size > 0
+                ? free_bytes * group->size / unfixed_size
+                : free_bytes / num_unfixed;
+            const uint64_t min_bytes = quota.min_bytes * min_scale;
+            if (share < min_bytes) {
+                group->target = min_bytes;
+                group->fixed = changed = true;
+            } else if (share > quota.max_bytes) {
+                group->target = quota.max_bytes;
+                group->fixed = changed = true;
+            } else {
+                group->target = share;
+            }
+        }
+        if (!changed) {
+            break;
+        }
+    }
+
+    // Hand each group's memory to its evicters in proportion to their sizes.
+    for (size_t i = 0; i < cache_data->size(); ++i) {
+        for (cache_data_t &data : (*cache_data)[i]) {
+            const group_t &group = groups[data.quota_group];
+            if (group.size > 0) {
+                data.new_size = static_cast<double>(group.target) * data.new_size
+                    / group.size;
+            } else {
+                data.new_size = group.target / group.num_evicters;
+            }
+            data.at_quota_limit = group.fixed;
+        }
+    }
+}
+
 void alt_cache_balancer_t::add_evicter(alt::evicter_t *evicter) {
     evicter->assert_thread();
     auto res = per_thread_data[get_thread_id().threadnum].evicters.insert(evicter);
@@ -148,7 +274,16 @@ void alt_cache_balancer_t::coro_pool_callback(alt_cache_balancer_dummy_value_t,
 
     // Calculate new cache sizes
     if (total_evicters > 0) {
-        uint64_t total_new_sizes = 0;
+        // Bytes loaded by evicters in a weighted group count `weight` times.  This
+        // leaves the sum of the new sizes unchanged.
+        double total_weighted_bytes_loaded = 0;
+        for (size_t i = 0; i < cache_data.size(); ++i) {
+            for (size_t j = 0; j < cache_data[i].size(); ++j) {
+                const cache_data_t &data = cache_data[i][j];
+                total_weighted_bytes_loaded +=
+                    get_quota(data.quota_group).weight * data.bytes_loaded;
+            }
+        }
 
         for (size_t i = 0; i < cache_data.size(); ++i) {
             for (size_t j = 0; j < cache_data[i].size(); ++j) {
@@ -157,31 +292,48 @@ void alt_cache_balancer_t::coro_pool_callback(alt_cache_balancer_dummy_value_t,
                 if (total_cache_size > 0) {
                     double temp = data->old_size;
                     temp /= static_cast<double>(total_cache_size);
-                    temp *= static_cast<double>(total_bytes_loaded);
+                    temp *= total_weighted_bytes_loaded;
 
-                    int64_t new_size = data->bytes_loaded;
+                    int64_t new_size = get_quota(data->quota_group).weight
+                        * data->bytes_loaded;
                     new_size -= static_cast<int64_t>(temp);
                     new_size += data->old_size;
                     new_size = std::max<int64_t>(new_size, 0);
 
                     data->new_size = new_size;
-                    total_new_sizes += new_size;
                 } else {
                     data->new_size = 0;
                 }
             }
         }
 
-        // Distribute any rounding error across shards
-        int64_t extra_bytes = total_cache_size - total_new_sizes;
+        apply_quota_limits(total_cache_size, &cache_data);
+
+        uint64_t total_new_sizes = 0;
+        size_t adjustable_evicters = 0;
+        for (size_t i = 0; i < cache_data.size(); ++i) {
+            for (size_t j = 0; j < cache_data[i].size(); ++j) {
+                total_new_sizes += cache_data[i][j].new_size;
+                adjustable_evicters += cache_data[i][j].at_quota_limit ? 0 : 1;
+            }
+        }
+
+        // Distribute any rounding error across shards that aren't held at a quota
+        // limit.  If there are none, memory beyond the groups' maximums stays unused.
+        int64_t extra_bytes = adjustable_evicters > 0
+            ? static_cast<int64_t>(total_cache_size) - static_cast<int64_t>(total_new_sizes)
+            : 0;
         while (extra_bytes != 0) {
-            int64_t delta = extra_bytes / static_cast<int64_t>(total_evicters);
+            int64_t delta = extra_bytes / static_cast<int64_t>(adjustable_evicters);
             if (delta == 0) {
                 delta = ((extra_bytes < 0) ? -1 : 1);
             }
             for (size_t i = 0; i < cache_data.size() && extra_bytes != 0; ++i) {
                 for (size_t j = 0; j < cache_data[i].size() && extra_bytes != 0; ++j) {
                     cache_data_t *data = &cache_data[i][j];
+                    if (data->at_quota_limit) {
+                        continue;
+                    }
 
                     // Avoid underflow
                     if (static_cast<int64_t>(data->new_size) + delta >= 0) {
@@ -195,6 +347,13 @@ void alt_cache_balancer_t::coro_pool_callback(alt_cache_balancer_dummy_value_t,
             }
         }
 
+        // With huge page slabs, block buffers take up memory a slab at a time, so we
+        // size the caches in slab units too.
+        block_slab_allocator_t *slab_allocator = get_block_slab_allocator();
+        if (slab_allocator != NULL) {
+            round_to_slab_units(slab_allocator->slab_size(), &cache_data);
+        }
+
         // Send new cache sizes to each thread
         pmap(num_threads,
              std::bind(&alt_cache_balancer_t::apply_rebalance_to_thread,
@@ -213,6 +372,35 @@ void alt_cache_balancer_t::coro_pool_callback(alt_cache_balancer_dummy_value_t,
     }
 }
 
+void alt_cache_balancer_t::round_to_slab_units(
+        uint64_t slab_size,
+        scoped_array_t<std::vector<cache_data_t> > *cache_data) {
+    uint64_t spare_bytes = 0;
+    std::vector<cache_data_t *> rounded;
+    for (size_t i = 0; i < cache_data->size(); ++i) {
+        for (size_t j = 0; j < (*cache_data)[i].size(); ++j) {
+            cache_data_t *data = &(*cache_data)[i][j];
+            if (data->at_quota_limit || data->new_size < slab_size) {
+                continue;
+            }
+            const uint64_t new_size = data->new_size - data->new_size % slab_size;
+            spare_bytes += data->new_size - new_size;
+            data->new_size = new_size;
+            rounded.push_back(data);
+        }
+    }
+
+    // Give the largest caches the spare slabs, since they have the most to lose.
+    std::sort(rounded.begin(), rounded.end(),
+              [](const cache_data_t *x, const cache_data_t *y) {
+                  return x->new_size > y->new_size;
+              });
+    for (size_t i = 0; i < rounded.size() && spare_bytes >= slab_size; ++i) {
+        rounded[i]->new_size += slab_size;
+        spare_bytes -= slab_size;
+    }
+}
+
 void alt_cache_balancer_t::collect_stats_from_thread(
         int index,
         scoped_array_t<std::vector<cache_data_t> > *data_out,
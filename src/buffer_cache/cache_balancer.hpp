@@ -2,6 +2,7 @@
 #define BUFFER_CACHE_CACHE_BALANCER_HPP_
 
 #include <stdint.h>
+#include <map>
 #include <set>
 #include <vector>
 
@@ -14,11 +15,29 @@
 #include "concurrency/queue/single_value_producer.hpp"
 #include "concurrency/watchable.hpp"
 #include "containers/scoped.hpp"
+#include "containers/uuid.hpp"
 
 namespace alt {
 class evicter_t;
 }
 
+// Limits how much memory the balancer hands to a group of evicters.  Evicters are
+// grouped by their `quota_group()`; in practice a group contains the caches of all the
+// shards of one table on this server.  By default an evicter belongs to the nil group,
+// which has no limits.
+class cache_quota_t {
+public:
+    cache_quota_t() : weight(1.0), min_bytes(0), max_bytes(UINT64_MAX) { }
+
+    // How much a byte loaded in the group counts when the balancer compares demand
+    // between evicters.  A group with weight 2 grows as if it had twice as many misses.
+    double weight;
+    // The group's total memory limit is kept within [min_bytes, max_bytes], as far as
+    // the total cache size allows.
+    uint64_t min_bytes;
+    uint64_t max_bytes;
+};
+
 // Base class so we can have a dummy implementation for tests
 class cache_balancer_t : public home_thread_mixin_t {
 public:
@@ -44,6 +63,11 @@ public:
     // balancing processes, if necessary (since right now they run on a timer).
     virtual void wake_up_activity_happened() = 0;
 
+    // Sets or removes the quota for the evicters in `group`.  Must be called on the
+    // balancer's home thread.
+    virtual void set_quota(const uuid_u &group, const cache_quota_t &quota) = 0;
+    virtual void remove_quota(const uuid_u &group) = 0;
+
 protected:
     friend class alt::evicter_t;
 
@@ -75,6 +99,9 @@ public:
 
     void wake_up_activity_happened() final { }
 
+    void set_quota(const uuid_u &, const cache_quota_t &) final { }
+    void remove_quota(const uuid_u &) final { }
+
 private:
     void add_evicter(alt::evicter_t *) { }
     void remove_evicter(alt::evicter_t *) { }
@@ -109,6 +136,9 @@ public:
 
     void wake_up_activity_happened() final;
 
+    void set_quota(const uuid_u &group, const cache_quota_t &quota) final;
+    void remove_quota(const uuid_u &group) final;
+
 private:
     friend class alt::evicter_t;
 
@@ -144,12 +174,29 @@ private:
         explicit cache_data_t(alt::evicter_t *_evicter);
 
         alt::evicter_t *evicter;
+        uuid_u quota_group;
         uint64_t new_size;
         uint64_t old_size;
         uint64_t bytes_loaded;
         uint64_t access_count;
+        // Set if the evicter's group was held at its `min_bytes` or `max_bytes`, in
+        // which case its size must not be touched when distributing rounding errors.
+        bool at_quota_limit;
     };
 
+    const cache_quota_t &get_quota(const uuid_u &group) const;
+
+    // Scales the groups' sizes so that every group ends up within its quota's
+    // limits, taking memory from (or giving it to) the groups that aren't limited.
+    void apply_quota_limits(uint64_t total_cache_size,
+                            scoped_array_t<std::vector<cache_data_t> > *cache_data) const;
+
+    // Rounds the caches' sizes down to multiples of `slab_size`, and hands the bytes
+    // freed that way back out in whole slabs.  Caches smaller than a slab, and
+    // caches held at a quota limit, are left alone.
+    static void round_to_slab_units(uint64_t slab_size,
+                                    scoped_array_t<std::vector<cache_data_t> > *cache_data);
+
     // Helper function to collect stats from each thread so we don't need
     //  atomic variables slowing down normal operations
     void collect_stats_from_thread(int index,
@@ -176,6 +223,8 @@ private:
     };
     rebalance_timer_state_t rebalance_timer_state;
 
+    std::map<uuid_u, cache_quota_t> quotas;
+
     microtime_t last_rebalance_time;
     bool read_ahead_ok;
     uint64_t bytes_toward_read_ahead_limit;
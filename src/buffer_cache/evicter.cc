@@ -7,7 +7,13 @@
 
 namespace alt {
 
-evicter_t::evicter_t()
+static bool compressed_page_tier_enabled = false;
+
+void enable_compressed_page_tier() {
+    compressed_page_tier_enabled = true;
+}
+
+evicter_t::evicter_t(memory_tag_t memory_tag)
     : initialized_(false),
       page_cache_(nullptr),
       balancer_(nullptr),
@@ -16,7 +22,17 @@ evicter_t::evicter_t()
       bytes_loaded_counter_(0),
       access_count_counter_(0),
       access_time_counter_(INITIAL_ACCESS_TIME),
-      evict_if_necessary_active_(false) { }
+      page_accesses_total_(0),
+      page_loads_total_(0),
+      quota_group_(nil_uuid()),
+      memory_usage_(memory_tag),
+      evict_if_necessary_active_(false),
+      compressed_bytes_(0) {
+    unevictable_.count_size_in(&memory_usage_);
+    evictable_disk_backed_.count_size_in(&memory_usage_);
+    evictable_probationary_.count_size_in(&memory_usage_);
+    evictable_unbacked_.count_size_in(&memory_usage_);
+}
 
 evicter_t::~evicter_t() {
     assert_thread();
@@ -83,6 +99,26 @@ uint64_t evicter_t::access_count() const {
     return access_count_counter_;
 }
 
+uint64_t evicter_t::page_accesses_total() const {
+    assert_thread();
+    return page_accesses_total_;
+}
+
+uint64_t evicter_t::page_loads_total() const {
+    assert_thread();
+    return page_loads_total_;
+}
+
+const uuid_u &evicter_t::quota_group() const {
+    assert_thread();
+    return quota_group_;
+}
+
+void evicter_t::set_quota_group(const uuid_u &group) {
+    assert_thread();
+    quota_group_ = group;
+}
+
 void wake_up_balancer(cache_balancer_t *balancer,
                       UNUSED auto_drainer_t::lock_t drainer_lock) {
     on_thread_t th(balancer->home_thread());
@@ -113,6 +149,7 @@ void evicter_t::catch_up_deferred_load(page_t *page) {
     assert_thread();
     guarantee(initialized_);
     rassert(unevictable_.has_page(page));
+    ++page_loads_total_;
     notify_bytes_loading(page->hypothetical_memory_usage(page_cache_));
 }
 
@@ -121,12 +158,24 @@ void evicter_t::add_not_yet_loaded(page_t *page) {
     guarantee(initialized_);
     unevictable_.add(page, page->hypothetical_memory_usage(page_cache_));
     evict_if_necessary();
+    ++page_loads_total_;
     notify_bytes_loading(page->hypothetical_memory_usage(page_cache_));
 }
 
 void evicter_t::reloading_page(page_t *page) {
     assert_thread();
     guarantee(initialized_);
+    ++page_loads_total_;
+    notify_bytes_loading(page->hypothetical_memory_usage(page_cache_));
+}
+
+void evicter_t::decompressing_page(page_t *page) {
+    assert_thread();
+    guarantee(initialized_);
+    rassert(page->is_compressed());
+    rassert(compressed_bytes_ >= page->compressed_size());
+    compressed_bytes_ -= page->compressed_size();
+    memory_usage_.add(-static_cast<int64_t>(page->compressed_size()));
     notify_bytes_loading(page->hypothetical_memory_usage(page_cache_));
 }
 
@@ -153,7 +202,9 @@ void evicter_t::add_to_evictable_unbacked(page_t *page) {
 void evicter_t::add_to_evictable_disk_backed(page_t *page) {
     assert_thread();
     guarantee(initialized_);
-    evictable_disk_backed_.add(page, page->hypothetical_memory_usage(page_cache_));
+    eviction_bag_t *bag = correct_eviction_category(page);
+    rassert(bag == &evictable_disk_backed_ || bag == &evictable_probationary_);
+    bag->add(page, page->hypothetical_memory_usage(page_cache_));
     evict_if_necessary();
     notify_bytes_loading(page->hypothetical_memory_usage(page_cache_));
 }
@@ -165,6 +216,7 @@ void evicter_t::move_unevictable_to_evictable(page_t *page) {
     unevictable_.remove(page, page->hypothetical_memory_usage(page_cache_));
     eviction_bag_t *new_bag = correct_eviction_category(page);
     rassert(new_bag == &evictable_disk_backed_
+            || new_bag == &evictable_probationary_
             || new_bag == &evictable_unbacked_);
     new_bag->add(page, page->hypothetical_memory_usage(page_cache_));
     evict_if_necessary();
@@ -187,9 +239,11 @@ eviction_bag_t *evicter_t::correct_eviction_category(page_t *page) {
     if (page->is_loading() || page->has_waiters()) {
         return &unevictable_;
     } else if (!page->is_loaded()) {
-        return &evicted_;
+        return page->is_compressed() ? &compressed_ : &evicted_;
     } else if (page->is_disk_backed()) {
-        return &evictable_disk_backed_;
+        return page->is_probationary()
+            ? &evictable_probationary_
+            : &evictable_disk_backed_;
     } else {
         return &evictable_unbacked_;
     }
@@ -200,6 +254,11 @@ void evicter_t::remove_page(page_t *page) {
     guarantee(initialized_);
     eviction_bag_t *bag = correct_eviction_category(page);
     bag->remove(page, page->hypothetical_memory_usage(page_cache_));
+    if (page->is_compressed()) {
+        rassert(compressed_bytes_ >= page->compressed_size());
+        compressed_bytes_ -= page->compressed_size();
+        memory_usage_.add(-static_cast<int64_t>(page->compressed_size()));
+    }
     evict_if_necessary();
     notify_bytes_loading(-static_cast<int64_t>(page->hypothetical_memory_usage(page_cache_)));
 }
@@ -209,7 +268,39 @@ uint64_t evicter_t::in_memory_size() const {
     guarantee(initialized_);
     return unevictable_.size()
         + evictable_disk_backed_.size()
-        + evictable_unbacked_.size();
+        + evictable_probationary_.size()
+        + evictable_unbacked_.size()
+        + compressed_bytes_;
+}
+
+// The share of the memory limit that probationary pages may occupy before they
+// become the preferred eviction candidates (in the spirit of 2Q's A1 queue).
+static const uint64_t PROBATIONARY_SHARE_DIVISOR = 4;
+
+bool evicter_t::remove_page_to_evict(page_t **page_out) {
+    // Pages that have only been touched once (e.g. by a table scan) get evicted
+    // first whenever they take up more than their share of the cache.  This way
+    // a big scan can only churn through that share, instead of pushing the
+    // whole working set out of memory.
+    if (evictable_probationary_.size() > memory_limit_ / PROBATIONARY_SHARE_DIVISOR
+        && evictable_probationary_.remove_oldish(page_out, access_time_counter_,
+                                                 page_cache_)) {
+        return true;
+    }
+    return evictable_disk_backed_.remove_oldish(page_out, access_time_counter_,
+                                                page_cache_)
+        || evictable_probationary_.remove_oldish(page_out, access_time_counter_,
+                                                 page_cache_);
+}
+
+// The share of the memory limit that compressed copies of evicted pages may take up,
+// if the compressed tier is enabled.
+static const uint64_t COMPRESSED_SHARE_DIVISOR = 4;
+
+uint64_t evicter_t::compressed_limit() const {
+    return compressed_page_tier_enabled
+        ? memory_limit_ / COMPRESSED_SHARE_DIVISOR
+        : 0;
 }
 
 void evicter_t::evict_if_necessary() THROWS_NOTHING {
@@ -227,13 +318,32 @@ void evicter_t::evict_if_necessary() THROWS_NOTHING {
     // currently in the process of being evicted, to avoid reflushing a page
     // currently being written for the purpose of eviction.
 
+    // Pages evicted from memory go to the compressed tier, if it's enabled.  Once
+    // that is over its limit (or there's nothing else left to evict), the oldish
+    // compressed pages get dropped entirely.
     evict_if_necessary_active_ = true;
     page_t *page;
-    while (in_memory_size() > memory_limit_
-           && evictable_disk_backed_.remove_oldish(&page, access_time_counter_,
-                                                   page_cache_)) {
-        evicted_.add(page, page->hypothetical_memory_usage(page_cache_));
-        page->evict_self(page_cache_);
+    while (in_memory_size() > memory_limit_) {
+        if (compressed_bytes_ <= compressed_limit() && remove_page_to_evict(&page)) {
+            const uint32_t usage = page->hypothetical_memory_usage(page_cache_);
+            // Probationary pages aren't worth compressing, and would let a scan
+            // churn through the compressed tier.
+            page->evict_self(page_cache_,
+                             compressed_limit() > 0 && !page->is_probationary());
+            if (page->is_compressed()) {
+                compressed_bytes_ += page->compressed_size();
+                memory_usage_.add(page->compressed_size());
+            }
+            correct_eviction_category(page)->add(page, usage);
+        } else if (compressed_.remove_oldish(&page, access_time_counter_,
+                                             page_cache_)) {
+            compressed_bytes_ -= page->compressed_size();
+            memory_usage_.add(-static_cast<int64_t>(page->compressed_size()));
+            page->drop_compressed();
+            evicted_.add(page, page->hypothetical_memory_usage(page_cache_));
+        } else {
+            break;
+        }
         page_cache_->consider_evicting_current_page(page->block_id());
     }
     evict_if_necessary_active_ = false;
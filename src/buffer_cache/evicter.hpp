@@ -5,10 +5,12 @@
 
 #include <functional>
 
+#include "arch/runtime/memory_tags.hpp"
 #include "buffer_cache/eviction_bag.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/cache_line_padded.hpp"
 #include "concurrency/pubsub.hpp"
+#include "containers/uuid.hpp"
 #include "threading.hpp"
 
 class cache_balancer_t;
@@ -34,9 +36,11 @@ public:
     eviction_bag_t *evicted_category() { return &evicted_; }
     void remove_page(page_t *page);
     void reloading_page(page_t *page);
+    void decompressing_page(page_t *page);
 
-    // Evicter will be unusable until initialize is called
-    evicter_t();
+    // Evicter will be unusable until initialize is called.  The memory of the
+    // pages it holds counts towards `memory_tag`.
+    explicit evicter_t(memory_tag_t memory_tag);
     ~evicter_t();
 
     void initialize(page_cache_t *page_cache,
@@ -49,6 +53,7 @@ public:
 
     uint64_t next_access_time() {
         guarantee(initialized_);
+        ++page_accesses_total_;
         return ++access_time_counter_;
     }
 
@@ -58,6 +63,14 @@ public:
 
     uint64_t in_memory_size() const;
 
+    // Cumulative counts, used to compute the cache's hit ratio.
+    uint64_t page_accesses_total() const;
+    uint64_t page_loads_total() const;
+
+    // The balancer applies the `cache_quota_t` of this group to the evicter.
+    const uuid_u &quota_group() const;
+    void set_quota_group(const uuid_u &group);
+
     // This is decremented past UINT64_MAX to force code to be aware of access time
     // rollovers.
     static const uint64_t INITIAL_ACCESS_TIME = UINT64_MAX - 100;
@@ -71,6 +84,13 @@ private:
     // Evicts any evictable pages until under the memory limit
     void evict_if_necessary() THROWS_NOTHING;
 
+    // Picks a disk-backed page to evict and removes it from its bag.  Returns false
+    // if there is no such page.
+    bool remove_page_to_evict(page_t **page_out);
+
+    // How much memory the compressed copies of evicted pages may take up.
+    uint64_t compressed_limit() const;
+
     bool initialized_;
     page_cache_t *page_cache_;
     cache_balancer_t *balancer_;
@@ -89,6 +109,17 @@ private:
     // This gets incremented every time a page is accessed.
     uint64_t access_time_counter_;
 
+    uint64_t page_accesses_total_;
+    // Incremented every time a page has to be loaded, instead of being found in
+    // memory.
+    uint64_t page_loads_total_;
+
+    uuid_u quota_group_;
+
+    // What `in_memory_size()` returns, kept up to date by the bags of pages in
+    // memory and by changes to `compressed_bytes_`.
+    tagged_memory_t memory_usage_;
+
     // This is set to true while `evict_if_necessary()` is active.
     // It avoids reentrant calls to that function.
     bool evict_if_necessary_active_;
@@ -96,14 +127,27 @@ private:
     // These track every page's eviction status.
     eviction_bag_t unevictable_;
     eviction_bag_t evictable_disk_backed_;
+    // Disk-backed pages that have not been re-referenced yet (see
+    // `page_t::is_probationary()`).
+    eviction_bag_t evictable_probationary_;
     eviction_bag_t evictable_unbacked_;
     eviction_bag_t evicted_;
+    // Evicted pages that have a compressed copy of their buf in memory.  The bag's
+    // size counts their uncompressed sizes, like evicted_'s does; the memory they
+    // really use is compressed_bytes_.
+    eviction_bag_t compressed_;
+    uint64_t compressed_bytes_;
 
     auto_drainer_t drainer_;
 
     DISABLE_COPYING(evicter_t);
 };
 
+// Makes every cache keep pages it evicts compressed in memory, in a second tier that
+// takes up part of its memory limit, and get them back from there without a disk
+// read.  Must be called before the thread pool starts, if at all.
+void enable_compressed_page_tier();
+
 // This adjusts the memory usage in the destructor, with the _same_ eviction bag the
 // page had in the constructor -- its lifespan ends before the page would have its
 // eviction bag changed.
@@ -2,27 +2,39 @@
 
 #include <inttypes.h>
 
+#include "arch/runtime/memory_tags.hpp"
 #include "buffer_cache/page.hpp"
 #include "utils.hpp"
 
 namespace alt {
 
 eviction_bag_t::eviction_bag_t()
-    : bag_(), size_(0) { }
+    : bag_(), size_(0), memory_(nullptr) { }
 
 eviction_bag_t::~eviction_bag_t() {
     guarantee(bag_.size() == 0);
     guarantee(size_ == 0, "size was %" PRIu64, size_);
 }
 
+void eviction_bag_t::count_size_in(tagged_memory_t *memory) {
+    guarantee(size_ == 0);
+    memory_ = memory;
+}
+
 void eviction_bag_t::change_size(int64_t adjustment) {
     rassert(adjustment >= 0 || size_ >= static_cast<uint64_t>(-adjustment));
     size_ += adjustment;
+    if (memory_ != nullptr) {
+        memory_->add(adjustment);
+    }
 }
 
 void eviction_bag_t::add(page_t *page, uint32_t ser_buf_size) {
     bag_.add(page);
     size_ += ser_buf_size;
+    if (memory_ != nullptr) {
+        memory_->add(ser_buf_size);
+    }
 }
 
 void eviction_bag_t::remove(page_t *page, uint32_t ser_buf_size) {
@@ -31,6 +43,9 @@ void eviction_bag_t::remove(page_t *page, uint32_t ser_buf_size) {
     rassert(value <= size_, "value = %" PRIu64 ", size_ = %" PRIu64,
             value, size_);
     size_ -= value;
+    if (memory_ != nullptr) {
+        memory_->add(-static_cast<int64_t>(value));
+    }
 }
 
 bool eviction_bag_t::has_page(page_t *page) const {
@@ -5,6 +5,8 @@
 
 #include "containers/backindex_bag.hpp"
 
+class tagged_memory_t;
+
 namespace alt {
 
 class page_t;
@@ -30,6 +32,10 @@ public:
 
     uint64_t size() const { return size_; }
 
+    // Makes changes to the size count towards `memory`, for bags of pages that are
+    // in memory.  Must be called while the bag is empty.
+    void count_size_in(tagged_memory_t *memory);
+
     bool remove_oldish(page_t **page_out, uint64_t access_time_offset,
                        page_cache_t *page_cache);
 
@@ -37,6 +43,7 @@ private:
     backindex_bag_t<page_t *> bag_;
     // The size in memory.
     uint64_t size_;
+    tagged_memory_t *memory_;
 
     DISABLE_COPYING(eviction_bag_t);
 };
@@ -1,5 +1,8 @@
 #include "buffer_cache/page.hpp"
 
+#include <inttypes.h>
+#include <zlib.h>
+
 #include "arch/runtime/coroutines.hpp"
 #include "buffer_cache/page_cache.hpp"
 #include "serializer/serializer.hpp"
@@ -55,8 +58,11 @@ static const uint64_t READ_AHEAD_ACCESS_TIME = evicter_t::INITIAL_ACCESS_TIME -
 page_t::page_t(block_id_t block_id, page_cache_t *page_cache)
     : block_id_(block_id),
       loader_(NULL),
+      compressed_size_(0),
       access_time_(page_cache->evicter().next_access_time()),
-      snapshot_refcount_(0) {
+      acquisition_count_(0),
+      snapshot_refcount_(0),
+      write_acq_count_(0) {
     page_cache->evicter().add_deferred_loaded(this);
 
     coro_t::spawn_now_dangerously(std::bind(&page_t::deferred_load_with_block_id,
@@ -69,8 +75,11 @@ page_t::page_t(block_id_t block_id, page_cache_t *page_cache,
                cache_account_t *account)
     : block_id_(block_id),
       loader_(NULL),
+      compressed_size_(0),
       access_time_(page_cache->evicter().next_access_time()),
-      snapshot_refcount_(0) {
+      acquisition_count_(0),
+      snapshot_refcount_(0),
+      write_acq_count_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
 
     coro_t::spawn_now_dangerously(std::bind(&page_t::load_with_block_id,
@@ -85,8 +94,11 @@ page_t::page_t(block_id_t block_id, buf_ptr_t buf,
     : block_id_(block_id),
       loader_(NULL),
       buf_(std::move(buf)),
+      compressed_size_(0),
       access_time_(page_cache->evicter().next_access_time()),
-      snapshot_refcount_(0) {
+      acquisition_count_(0),
+      snapshot_refcount_(0),
+      write_acq_count_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_unbacked(this);
 }
@@ -99,8 +111,11 @@ page_t::page_t(block_id_t block_id,
       loader_(NULL),
       buf_(std::move(buf)),
       block_token_(block_token),
+      compressed_size_(0),
       access_time_(READ_AHEAD_ACCESS_TIME),
-      snapshot_refcount_(0) {
+      acquisition_count_(0),
+      snapshot_refcount_(0),
+      write_acq_count_(0) {
     rassert(buf_.has());
     page_cache->evicter().add_to_evictable_disk_backed(this);
 }
@@ -108,8 +123,11 @@ page_t::page_t(block_id_t block_id,
 page_t::page_t(page_t *copyee, page_cache_t *page_cache, cache_account_t *account)
     : block_id_(copyee->block_id_),
       loader_(NULL),
+      compressed_size_(0),
       access_time_(page_cache->evicter().next_access_time()),
-      snapshot_refcount_(0) {
+      acquisition_count_(0),
+      snapshot_refcount_(0),
+      write_acq_count_(0) {
     page_cache->evicter().add_not_yet_loaded(this);
     coro_t::spawn_now_dangerously(std::bind(&page_t::load_from_copyee,
                                             this,
@@ -413,10 +431,16 @@ void page_t::pulse_waiters_or_make_evictable(page_cache_t *page_cache) {
 void page_t::add_waiter(page_acq_t *acq, cache_account_t *account) {
     eviction_bag_t *old_bag
         = acq->page_cache()->evicter().correct_eviction_category(this);
+    if (acquisition_count_ < 2) {
+        ++acquisition_count_;
+    }
     waiters_.push_front(acq);
     acq->page_cache()->evicter().change_to_correct_eviction_bag(old_bag, this);
     if (buf_.has()) {
         acq->buf_ready_signal_.pulse();
+    } else if (compressed_buf_.has()) {
+        load_from_compressed(acq->page_cache());
+        acq->buf_ready_signal_.pulse();
     } else if (loader_ != NULL) {
         loader_->added_waiter(acq->page_cache(), account);
     } else if (block_token_.has()) {
@@ -471,6 +495,31 @@ void page_t::load_using_block_token(page_t *page, page_cache_t *page_cache,
     page->pulse_waiters_or_make_evictable(page_cache);
 }
 
+void page_t::load_from_compressed(page_cache_t *page_cache) {
+    rassert(!buf_.has());
+    rassert(block_token_.has());
+    rassert(loader_ == NULL);
+
+    buf_ptr_t buf = buf_ptr_t::alloc_uninitialized(block_token_->block_size());
+    uLongf size = buf.block_size().ser_value();
+    const int res = uncompress(reinterpret_cast<Bytef *>(buf.ser_buffer()),
+                               &size,
+                               reinterpret_cast<const Bytef *>(compressed_buf_.get()),
+                               compressed_size_);
+    guarantee(res == Z_OK && size == buf.block_size().ser_value(),
+              "Could not decompress cached block %" PRIi64 " (zlib error %d).",
+              block_id_, res);
+    buf.fill_padding_zero();
+
+    page_cache->evicter().decompressing_page(this);
+    compressed_buf_.reset();
+    compressed_size_ = 0;
+    {
+        usage_adjuster_t adjuster(page_cache, this);
+        buf_ = std::move(buf);
+    }
+}
+
 void page_t::set_page_buf_size(block_size_t block_size, page_cache_t *page_cache) {
     rassert(buf_.has(),
             "Called outside page_acq_t or without waiting for the buf_ready_signal_?");
@@ -534,7 +583,7 @@ void page_t::remove_waiter(page_acq_t *acq) {
     rassert(snapshot_refcount_ > 0);
 }
 
-void page_t::evict_self(DEBUG_VAR page_cache_t *page_cache) {
+void page_t::evict_self(DEBUG_VAR page_cache_t *page_cache, bool compress) {
     // A page_t can only self-evict if it has a block token (for now).
     rassert(waiters_.empty());
     rassert(block_token_.has());
@@ -543,12 +592,47 @@ void page_t::evict_self(DEBUG_VAR page_cache_t *page_cache) {
 #ifndef NDEBUG
     const uint32_t usage_before = hypothetical_memory_usage(page_cache);
 #endif
+    if (compress) {
+        // We only keep the compressed copy if it saves at least a quarter of the
+        // buf's memory.  zlib fails with Z_BUF_ERROR if the result doesn't fit.
+        const uint32_t size = buf_.block_size().ser_value();
+        scoped_malloc_t<char> compressed(size - size / 4);
+        uLongf compressed_size = size - size / 4;
+        const int res = compress2(reinterpret_cast<Bytef *>(compressed.get()),
+                                  &compressed_size,
+                                  reinterpret_cast<const Bytef *>(buf_.ser_buffer()),
+                                  size,
+                                  Z_BEST_SPEED);
+        if (res == Z_OK) {
+            compressed_buf_ = scoped_malloc_t<char>(compressed.get(),
+                                                    compressed.get() + compressed_size);
+            compressed_size_ = compressed_size;
+        }
+    }
     buf_.reset();
+    derived_data_.reset();
     // Hypothetical memory usage shouldn't have changed -- the block token has the
     // same block size.
     rassert(usage_before == hypothetical_memory_usage(page_cache));
 }
 
+void page_t::drop_compressed() {
+    rassert(compressed_buf_.has());
+    compressed_buf_.reset();
+    compressed_size_ = 0;
+}
+
+buf_derived_data_t *page_t::derived_data() {
+    return write_acq_count_ == 0 ? derived_data_.get() : NULL;
+}
+
+void page_t::set_derived_data(scoped_ptr_t<buf_derived_data_t> &&data) {
+    rassert(buf_.has());
+    if (write_acq_count_ == 0) {
+        derived_data_ = std::move(data);
+    }
+}
+
 ser_buffer_t *page_t::get_loaded_ser_buffer() {
     rassert(buf_.has());
     return buf_.ser_buffer();
@@ -571,7 +655,7 @@ void page_t::init_block_token(counted_t<standard_block_token_t> token,
 
 
 
-page_acq_t::page_acq_t() : page_(NULL), page_cache_(NULL) {
+page_acq_t::page_acq_t() : page_(NULL), page_cache_(NULL), for_write_(false) {
 }
 
 void page_acq_t::init(page_t *page, page_cache_t *page_cache,
@@ -587,6 +671,10 @@ void page_acq_t::init(page_t *page, page_cache_t *page_cache,
 page_acq_t::~page_acq_t() {
     if (page_ != NULL) {
         rassert(page_cache_ != NULL);
+        if (for_write_) {
+            rassert(page_->write_acq_count_ > 0);
+            --page_->write_acq_count_;
+        }
         page_->remove_waiter(this);
 
         // There's no need to call consider_evicting_current_page, because page_acq_t
@@ -611,6 +699,11 @@ block_size_t page_acq_t::get_buf_size() {
 
 void *page_acq_t::get_buf_write(block_size_t block_size) {
     buf_ready_signal_.wait();
+    if (!for_write_) {
+        for_write_ = true;
+        ++page_->write_acq_count_;
+        page_->derived_data_.reset();
+    }
     page_->reset_block_token(page_cache_);
     page_->set_page_buf_size(block_size, page_cache_);
     return page_->get_page_buf(page_cache_);
@@ -621,6 +714,16 @@ const void *page_acq_t::get_buf_read() {
     return page_->get_page_buf(page_cache_);
 }
 
+buf_derived_data_t *page_acq_t::get_derived_data() {
+    buf_ready_signal_.wait();
+    return page_->derived_data();
+}
+
+void page_acq_t::set_derived_data(scoped_ptr_t<buf_derived_data_t> &&data) {
+    buf_ready_signal_.wait();
+    page_->set_derived_data(std::move(data));
+}
+
 page_ptr_t::page_ptr_t() : page_(NULL) {
 }
 
@@ -1,6 +1,7 @@
 #ifndef BUFFER_CACHE_PAGE_HPP_
 #define BUFFER_CACHE_PAGE_HPP_
 
+#include "buffer_cache/types.hpp"
 #include "concurrency/cond_var.hpp"
 #include "containers/backindex_bag.hpp"
 #include "containers/half_intrusive_list.hpp"
@@ -65,8 +66,19 @@ public:
     bool has_waiters() const { return !waiters_.empty(); }
     bool is_loaded() const { return buf_.has(); }
     bool is_disk_backed() const { return block_token_.has(); }
-
-    void evict_self(page_cache_t *page_cache);
+    // True if the buf is evicted, but a compressed copy of it is kept in memory.
+    bool is_compressed() const { return compressed_buf_.has(); }
+    uint32_t compressed_size() const { return compressed_size_; }
+    // True if the page has been acquired at most once since it was created.  Such
+    // pages are typically touched by a table scan or by read-ahead, and get
+    // evicted before pages that have proven to be part of the working set.
+    bool is_probationary() const { return acquisition_count_ < 2; }
+
+    // If `compress` is true, keeps a compressed copy of the buf in memory, provided
+    // that it saves enough memory to be worth it.
+    void evict_self(page_cache_t *page_cache, bool compress);
+    // Drops the compressed copy of an evicted page's buf.
+    void drop_compressed();
 
     block_id_t block_id() const { return block_id_; }
 
@@ -76,12 +88,21 @@ public:
         return block_token_;
     }
 
+    // Data derived from the buf that readers cache with the page.  It's dropped
+    // when a page_acq_t gets the buf for write and when the buf is evicted, and it
+    // can't be used or set while some page_acq_t has the buf for write (returns
+    // NULL, and set_derived_data does nothing).  It's not counted towards the cache's
+    // memory usage.
+    buf_derived_data_t *derived_data();
+    void set_derived_data(scoped_ptr_t<buf_derived_data_t> &&data);
+
     ser_buffer_t *get_loaded_ser_buffer();
     void init_block_token(counted_t<standard_block_token_t> token,
                           page_cache_t *page_cache);
 
 private:
     friend class page_ptr_t;
+    friend class page_acq_t;  // for write_acq_count_ and derived_data_.
     friend class deferred_page_loader_t;
     static bool loader_is_loading(page_loader_t *loader);
     void add_snapshotter();
@@ -117,6 +138,8 @@ private:
     static void load_using_block_token(page_t *page, page_cache_t *page_cache,
                                        cache_account_t *account);
 
+    void load_from_compressed(page_cache_t *page_cache);
+
     friend backindex_bag_index_t *access_backindex(page_t *page);
 
     // The block id.  Used to (potentially) delete the page_t and current_page_t when
@@ -130,12 +153,28 @@ private:
     buf_ptr_t buf_;
     counted_t<standard_block_token_t> block_token_;
 
+    // A zlib-compressed copy of the evicted buf, which can be loaded without a disk
+    // read.  Only set while buf_ isn't, and block_token_ is.
+    scoped_malloc_t<char> compressed_buf_;
+    uint32_t compressed_size_;
+
     uint64_t access_time_;
 
+    // How many times the page was acquired (by a page_acq_t), saturating at 2.
+    // Survives eviction of the buffer, so that a page which gets reloaded is
+    // recognized as re-referenced.
+    uint8_t acquisition_count_;
+
     // How many page_ptr_t's point at this page, expecting nothing to modify it,
     // other than themselves.
     size_t snapshot_refcount_;
 
+    // How many page_acq_t's have gotten the buf for write.
+    size_t write_acq_count_;
+
+    // See derived_data().  Only set while buf_ is.
+    scoped_ptr_t<buf_derived_data_t> derived_data_;
+
     // A list of waiters that expect the value to be loaded, and (as long as there
     // are waiters) expect the value to never be evicted.
     half_intrusive_list_t<page_acq_t> waiters_;
@@ -145,14 +184,16 @@ private:
     //
     // if loader_ is non-null:  unevictable_pages_
     // else if waiters_ is non-empty: unevictable_pages_
-    // else if buf_ is null: evicted_pages_ (and block_token_ is non-null)
-    // else if block_token_ is non-null: evictable_disk_backed_pages_
+    // else if buf_ is null: evicted_pages_, or compressed_pages_ if compressed_buf_
+    //     is non-null (and block_token_ is non-null)
+    // else if block_token_ is non-null: evictable_disk_backed_pages_ (or
+    //     evictable_probationary_pages_ if is_probationary())
     // else: evictable_unbacked_pages_ (buf_ is non-null, block_token_ is null)
     //
     // So, when loader_, waiters_, buf_, or block_token_ is touched, we might
     // need to change this page's eviction bag.
     //
-    // The logic above is implemented in page_cache_t::correct_eviction_category.
+    // The logic above is implemented in evicter_t::correct_eviction_category.
     backindex_bag_index_t eviction_index_;
 
     DISABLE_COPYING(page_t);
@@ -242,11 +283,18 @@ public:
     void *get_buf_write(block_size_t block_size);
     const void *get_buf_read();
 
+    // See page_t::derived_data().
+    buf_derived_data_t *get_derived_data();
+    void set_derived_data(scoped_ptr_t<buf_derived_data_t> &&data);
+    bool page_is_probationary() const { return page_->is_probationary(); }
+
 private:
     friend class page_t;
 
     page_t *page_;
     page_cache_t *page_cache_;
+    // True once get_buf_write has been called.
+    bool for_write_;
     cond_t buf_ready_signal_;
     DISABLE_COPYING(page_acq_t);
 };
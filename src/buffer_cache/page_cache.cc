@@ -8,9 +8,12 @@
 #include "arch/runtime/coroutines.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/runtime_utils.hpp"
+#include "arch/timing.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/new_mutex.hpp"
+#include "concurrency/pmap.hpp"
 #include "buffer_cache/cache_balancer.hpp"
+#include "buffer_cache/warmup_snapshot.hpp"
 #include "do_on_thread.hpp"
 #include "serializer/serializer.hpp"
 #include "stl_utils.hpp"
@@ -60,7 +63,7 @@ void page_read_ahead_cb_t::offer_read_ahead_buf(
     buf_ptr_t local_buf = std::move(*buf);
 
     block_size_t block_size = block_size_t::undefined();
-    scoped_malloc_t<ser_buffer_t> ptr;
+    scoped_ser_buffer_t ptr;
     local_buf.release(&block_size, &ptr);
 
     // We're going to reconstruct the buf_ptr_t on the other side of this do_on_thread
@@ -100,30 +103,24 @@ void page_cache_t::consider_evicting_current_page(block_id_t block_id) {
         return;
     }
 
-    current_page_t *current_page = current_pages_.get_sparsely(block_id);
+    current_page_t *current_page = current_pages_.get(block_id);
     if (current_page == NULL) {
         return;
     }
 
     if (current_page->should_be_evicted()) {
-        current_pages_[block_id] = NULL;
+        current_pages_.set(block_id, NULL);
         current_page->reset(this);
         delete current_page;
     }
 }
 
-void page_cache_t::resize_current_pages_to_id(block_id_t block_id) {
-    if (current_pages_.size() <= block_id) {
-        current_pages_.resize_with_zeros(block_id + 1);
-    }
-}
-
 void page_cache_t::add_read_ahead_buf(block_id_t block_id,
                                       ser_buffer_t *ser_buffer,
                                       const counted_t<standard_block_token_t> &token) {
     assert_thread();
 
-    scoped_malloc_t<ser_buffer_t> ptr(ser_buffer);
+    scoped_ser_buffer_t ptr(ser_buffer);
 
     // We MUST stop if read_ahead_cb_ is NULL because that means current_page_t's
     // could start being destroyed.
@@ -131,10 +128,9 @@ void page_cache_t::add_read_ahead_buf(block_id_t block_id,
         return;
     }
 
-    resize_current_pages_to_id(block_id);
     // We MUST stop if current_pages_[block_id] already exists, because that means
     // the read-ahead page might be out of date.
-    if (current_pages_[block_id] != NULL) {
+    if (current_pages_.get(block_id) != NULL) {
         return;
     }
 
@@ -145,7 +141,8 @@ void page_cache_t::add_read_ahead_buf(block_id_t block_id,
     // useful work to be done).
 
     buf_ptr_t buf(token->block_size(), std::move(ptr));
-    current_pages_[block_id] = new current_page_t(block_id, std::move(buf), token, this);
+    current_pages_.set(block_id,
+                       new current_page_t(block_id, std::move(buf), token, this));
 }
 
 void page_cache_t::have_read_ahead_cb_destroyed() {
@@ -166,9 +163,10 @@ void page_cache_t::have_read_ahead_cb_destroyed() {
 
 void page_cache_t::consider_evicting_all_current_pages(page_cache_t *page_cache,
                                                        auto_drainer_t::lock_t lock) {
-    for (block_id_t id = 0; id < page_cache->current_pages_.size(); ++id) {
+    size_t n = 0;
+    for (size_t id = 0; page_cache->current_pages_.find_next(&id); ++id, ++n) {
         page_cache->consider_evicting_current_page(id);
-        if (id % 16 == 15) {
+        if (n % 16 == 15) {
             coro_t::yield();
             if (lock.get_drain_signal()->is_pulsed()) {
                 return;
@@ -193,12 +191,15 @@ public:
 
 page_cache_t::page_cache_t(serializer_t *serializer,
                            cache_balancer_t *balancer,
-                           alt_txn_throttler_t *throttler)
+                           alt_txn_throttler_t *throttler,
+                           memory_tag_t memory_tag)
     : max_block_size_(serializer->max_block_size()),
       serializer_(serializer),
       free_list_(serializer),
-      evicter_(),
+      evicter_(memory_tag),
       read_ahead_cb_(NULL),
+      saving_warmup_snapshot_(false),
+      write_back_pending_(false),
       drainer_(make_scoped<auto_drainer_t>()) {
 
     const bool start_read_ahead = balancer->read_ahead_ok_at_start();
@@ -213,7 +214,8 @@ page_cache_t::page_cache_t(serializer_t *serializer,
             local_read_ahead_cb = new page_read_ahead_cb_t(serializer, this);
         }
         default_reads_account_.init(serializer->home_thread(),
-                                    serializer->make_io_account(CACHE_READS_IO_PRIORITY));
+                                    serializer->make_io_account(CACHE_READS_IO_PRIORITY,
+                                                                io_class_t::foreground_read));
         index_write_sink_.init(new page_cache_index_write_sink_t);
         recencies_ = serializer->get_all_recencies();
     }
@@ -234,16 +236,21 @@ page_cache_t::~page_cache_t() {
 
     have_read_ahead_cb_destroyed();
 
+    warmup_snapshot_timer_.reset();
     drainer_.reset();
-    for (size_t i = 0, e = current_pages_.size(); i < e; ++i) {
-        if (i % 256 == 255) {
+    if (!warmup_snapshot_path_.empty()) {
+        save_warmup_snapshot(warmup_snapshot_path_, hot_block_ids());
+    }
+
+    size_t n = 0;
+    for (size_t id = 0; current_pages_.find_next(&id); ++id, ++n) {
+        if (n % 256 == 255) {
             coro_t::yield();
         }
-        current_page_t *current_page = current_pages_[i];
-        if (current_page != NULL) {
-            current_page->reset(this);
-            delete current_page;
-        }
+        current_page_t *current_page = current_pages_.get(id);
+        current_pages_.set(id, NULL);
+        current_page->reset(this);
+        delete current_page;
     }
 
     {
@@ -257,6 +264,127 @@ page_cache_t::~page_cache_t() {
     }
 }
 
+void page_cache_t::enable_warmup_snapshots(const std::string &path) {
+    assert_thread();
+    guarantee(warmup_snapshot_path_.empty());
+    warmup_snapshot_path_ = path;
+    warmup_snapshot_timer_.init(new repeating_timer_t(
+        CACHE_WARMUP_SNAPSHOT_INTERVAL_MS,
+        std::bind(&page_cache_t::on_warmup_snapshot_timer, this)));
+    coro_t::spawn_sometime(std::bind(&page_cache_t::warm_up, this, drainer_->lock()));
+}
+
+std::vector<block_id_t> page_cache_t::hot_block_ids() {
+    assert_thread();
+    std::vector<std::pair<uint64_t, block_id_t> > pages;
+    for (size_t id = 0; current_pages_.find_next(&id); ++id) {
+        current_page_t *current_page = current_pages_.get(id);
+        if (!current_page->page_.has()) {
+            continue;
+        }
+        const page_t *page = current_page->page_.get_page_for_read();
+        if (page->is_loaded()) {
+            pages.push_back(std::make_pair(page->access_time(), id));
+        }
+    }
+    std::sort(pages.begin(), pages.end(),
+              std::greater<std::pair<uint64_t, block_id_t> >());
+
+    std::vector<block_id_t> ret;
+    ret.reserve(pages.size());
+    for (auto it = pages.begin(); it != pages.end(); ++it) {
+        ret.push_back(it->second);
+    }
+    return ret;
+}
+
+void page_cache_t::on_warmup_snapshot_timer() {
+    assert_thread();
+    if (!saving_warmup_snapshot_) {
+        saving_warmup_snapshot_ = true;
+        coro_t::spawn_sometime(std::bind(&page_cache_t::save_warmup_snapshot_periodically,
+                                         this, drainer_->lock()));
+    }
+}
+
+void page_cache_t::save_warmup_snapshot_periodically(page_cache_t *page_cache,
+                                                     auto_drainer_t::lock_t) {
+    page_cache->assert_thread();
+    save_warmup_snapshot(page_cache->warmup_snapshot_path_,
+                         page_cache->hot_block_ids());
+    page_cache->saving_warmup_snapshot_ = false;
+}
+
+void page_cache_t::warm_up(page_cache_t *page_cache, auto_drainer_t::lock_t lock) {
+    page_cache->assert_thread();
+    std::vector<block_id_t> block_ids;
+    if (!load_warmup_snapshot(page_cache->warmup_snapshot_path_, &block_ids)) {
+        return;
+    }
+
+    serializer_t *const serializer = page_cache->serializer_;
+    scoped_ptr_t<file_account_t> io_account;
+    {
+        on_thread_t thread_switcher(serializer->home_thread());
+        io_account.init(serializer->make_io_account(CACHE_WARMUP_IO_PRIORITY,
+                                                    CACHE_WARMUP_MAX_OUTSTANDING_READS,
+                                                    io_class_t::other));
+    }
+
+    // The snapshot lists the hottest blocks first, so we go through it in batches in
+    // that order, and read the blocks of each batch in the order they are on disk.
+    for (size_t begin = 0; begin < block_ids.size(); begin += CACHE_WARMUP_BATCH_SIZE) {
+        // Once the read-ahead callback is gone, add_read_ahead_buf couldn't tell
+        // whether what we read is up to date anymore.  That happens when the cache
+        // is full, so there'd be no point in going on anyway.
+        if (lock.get_drain_signal()->is_pulsed() || page_cache->read_ahead_cb_ == NULL) {
+            break;
+        }
+        const size_t end = std::min(block_ids.size(), begin + CACHE_WARMUP_BATCH_SIZE);
+
+        std::vector<std::pair<counted_t<standard_block_token_t>, block_id_t> > tokens;
+        std::vector<buf_ptr_t> bufs;
+        {
+            on_thread_t thread_switcher(serializer->home_thread());
+            const block_id_t max_block_id = serializer->max_block_id();
+            for (size_t i = begin; i < end; ++i) {
+                if (block_ids[i] >= max_block_id) {
+                    continue;
+                }
+                counted_t<standard_block_token_t> token
+                    = serializer->index_read(block_ids[i]);
+                if (token.has()) {
+                    tokens.push_back(std::make_pair(std::move(token), block_ids[i]));
+                }
+            }
+            std::sort(tokens.begin(), tokens.end(),
+                      [](const std::pair<counted_t<standard_block_token_t>, block_id_t> &x,
+                         const std::pair<counted_t<standard_block_token_t>, block_id_t> &y) {
+                          return x.first->offset() < y.first->offset();
+                      });
+
+            bufs.resize(tokens.size());
+            pmap(tokens.size(), [&](size_t i) {
+                bufs[i] = serializer->block_read(tokens[i].first, io_account.get());
+            });
+        }
+
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            block_size_t block_size = block_size_t::undefined();
+            scoped_ser_buffer_t ptr;
+            bufs[i].release(&block_size, &ptr);
+            page_cache->add_read_ahead_buf(tokens[i].second, ptr.release(),
+                                           tokens[i].first);
+        }
+    }
+
+    {
+        /* IO accounts must be destroyed on the thread they were created on */
+        on_thread_t thread_switcher(serializer->home_thread());
+        io_account.reset();
+    }
+}
+
 // We go a bit old-school, with a self-destroying callback.
 class flush_and_destroy_txn_waiter_t : public signal_t::subscription_t {
 public:
@@ -308,12 +436,13 @@ private:
 
 void page_cache_t::flush_and_destroy_txn(
         scoped_ptr_t<page_txn_t> txn,
+        write_durability_t durability,
         std::function<void(throttler_acq_t *)> on_flush_complete) {
     guarantee(txn->live_acqs_ == 0,
               "A current_page_acq_t lifespan exceeds its page_txn_t's.");
     guarantee(!txn->began_waiting_for_flush_);
 
-    txn->announce_waiting_for_flush();
+    txn->announce_waiting_for_flush(durability);
 
     page_txn_t *page_txn = txn.release();
     flush_and_destroy_txn_waiter_t *sub
@@ -327,18 +456,48 @@ void page_cache_t::flush_and_destroy_txn(
 current_page_t *page_cache_t::page_for_block_id(block_id_t block_id) {
     assert_thread();
 
-    resize_current_pages_to_id(block_id);
-    if (current_pages_[block_id] == NULL) {
+    current_page_t *current_page = current_pages_.get(block_id);
+    if (current_page == NULL) {
         rassert(recency_for_block_id(block_id) != repli_timestamp_t::invalid,
                 "Expected block %" PR_BLOCK_ID " not to be deleted "
                 "(should you have used alt_create_t::create?).",
                 block_id);
-        current_pages_[block_id] = new current_page_t(block_id);
+        current_page = new current_page_t(block_id);
+        current_pages_.set(block_id, current_page);
     } else {
-        rassert(!current_pages_[block_id]->is_deleted());
+        rassert(!current_page->is_deleted());
     }
 
-    return current_pages_[block_id];
+    return current_page;
+}
+
+page_t *page_cache_t::optimistic_page_for_read(block_id_t block_id,
+                                               block_version_t *version_out) {
+    assert_thread();
+    ASSERT_NO_CORO_WAITING;
+
+    current_page_t *current_page = current_pages_.get(block_id);
+    if (current_page == NULL || current_page->is_deleted()
+        || !current_page->page_.has() || current_page->has_write_acquirer()) {
+        return NULL;
+    }
+    page_t *page = current_page->page_.get_page_for_read();
+    if (!page->is_loaded()) {
+        return NULL;
+    }
+
+    *version_out = current_page->last_write_acquirer_version_;
+    return page;
+}
+
+bool page_cache_t::optimistic_read_is_valid(block_id_t block_id,
+                                            block_version_t version) const {
+    assert_thread();
+    const current_page_t *current_page = current_pages_.get(block_id);
+    return current_page != NULL
+        && !current_page->is_deleted()
+        && !current_page->has_write_acquirer()
+        && current_page->last_write_acquirer_version_ == version;
 }
 
 current_page_t *page_cache_t::page_for_new_block_id(block_id_t *block_id_out) {
@@ -369,14 +528,14 @@ current_page_t *page_cache_t::internal_page_for_new_chosen(block_id_t block_id)
     memset(buf.cache_data(), 0xCD, max_block_size_.value());
 #endif
 
-    resize_current_pages_to_id(block_id);
-    guarantee(current_pages_[block_id] == NULL);
-    current_pages_[block_id] = new current_page_t(block_id, std::move(buf), this);
+    guarantee(current_pages_.get(block_id) == NULL);
+    current_page_t *current_page = new current_page_t(block_id, std::move(buf), this);
+    current_pages_.set(block_id, current_page);
 
-    return current_pages_[block_id];
+    return current_page;
 }
 
-cache_account_t page_cache_t::create_cache_account(int priority) {
+cache_account_t page_cache_t::create_cache_account(int priority, io_class_t io_class) {
     // We assume that a priority of 100 means that the transaction should have the
     // same priority as all the non-accounted transactions together. Not sure if this
     // makes sense.
@@ -395,7 +554,8 @@ cache_account_t page_cache_t::create_cache_account(int priority) {
         // what the file account API is right now, deep in the I/O layer.
         on_thread_t thread_switcher(serializer_->home_thread());
         io_account = serializer_->make_io_account(io_priority,
-                                                  outstanding_requests_limit);
+                                                  outstanding_requests_limit,
+                                                  io_class);
     }
 
     return cache_account_t(serializer_->home_thread(), io_account);
@@ -721,13 +881,14 @@ bool current_page_t::should_be_evicted() const {
         return false;
     }
 
-    // A reason: Its page_t isn't evicted, or has other snapshotters or waiters
-    // anyway.  (Getting this wrong can only hurt performance.  We want to evict
-    // current_page_t's with unloaded, otherwise unused page_t's.)
+    // A reason: Its page_t isn't evicted (or only to the compressed tier), or has
+    // other snapshotters or waiters anyway.  (Getting this wrong can only hurt
+    // performance.  We want to evict current_page_t's with unloaded, otherwise
+    // unused page_t's.)
     if (page_.has()) {
         page_t *page = page_.get_page_for_read();
         if (page->is_loading() || page->has_waiters() || page->is_loaded()
-            || page->page_ptr_count() != 1) {
+            || page->is_compressed() || page->page_ptr_count() != 1) {
             return false;
         }
         // is_loading is false and is_loaded is false -- it must be disk-backed.
@@ -737,6 +898,17 @@ bool current_page_t::should_be_evicted() const {
     return true;
 }
 
+bool current_page_t::has_write_acquirer() const {
+    for (current_page_acq_t *acq = acquirers_.head();
+         acq != NULL;
+         acq = acquirers_.next(acq)) {
+        if (acq->access_ == access_t::write) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void current_page_t::add_acquirer(current_page_acq_t *acq) {
     const block_version_t prev_version = last_write_acquirer_version_;
 
@@ -1027,12 +1199,12 @@ void page_txn_t::remove_acquirer(current_page_acq_t *acq) {
     }
 }
 
-void page_txn_t::announce_waiting_for_flush() {
+void page_txn_t::announce_waiting_for_flush(write_durability_t durability) {
     rassert(live_acqs_ == 0);
     rassert(!began_waiting_for_flush_);
     rassert(!spawned_flush_);
     began_waiting_for_flush_ = true;
-    page_cache_->im_waiting_for_flush(this);
+    page_cache_->im_waiting_for_flush(this, durability);
 }
 
 std::map<block_id_t, page_cache_t::block_change_t>
@@ -1475,20 +1647,76 @@ std::vector<page_txn_t *> page_cache_t::maximal_flushable_txn_set(page_txn_t *ba
     return colored;
 }
 
-void page_cache_t::im_waiting_for_flush(page_txn_t *base) {
+static int64_t write_back_window_ms = 0;
+
+void set_write_back_window_ms(int64_t ms) {
+    guarantee(ms >= 0);
+    write_back_window_ms = ms;
+}
+
+void page_cache_t::im_waiting_for_flush(page_txn_t *base,
+                                        write_durability_t durability) {
     assert_thread();
     rassert(base->began_waiting_for_flush_);
     rassert(!base->spawned_flush_);
     ASSERT_FINITE_CORO_WAITING;
 
-    std::vector<page_txn_t *> flush_set
-        = page_cache_t::maximal_flushable_txn_set(base);
-    if (!flush_set.empty()) {
-        for (auto it = flush_set.begin(); it != flush_set.end(); ++it) {
+    if (write_back_window_ms > 0 && durability == write_durability_t::SOFT) {
+        write_back_txns_.insert(base);
+        if (!write_back_pending_) {
+            write_back_pending_ = true;
+            coro_t::spawn_sometime(std::bind(&page_cache_t::flush_write_back_txns_later,
+                                             this, drainer_->lock()));
+        }
+    } else {
+        spawn_flush(std::vector<page_txn_t *>(1, base));
+    }
+}
+
+void page_cache_t::flush_write_back_txns_later(page_cache_t *page_cache,
+                                               auto_drainer_t::lock_t lock) {
+    // When the cache gets destroyed we flush right away.
+    try {
+        nap(write_back_window_ms, lock.get_drain_signal());
+    } catch (const interrupted_exc_t &) {
+    }
+
+    page_cache->write_back_pending_ = false;
+    std::vector<page_txn_t *> bases(page_cache->write_back_txns_.begin(),
+                                    page_cache->write_back_txns_.end());
+    if (!bases.empty()) {
+        page_cache->spawn_flush(bases);
+    }
+}
+
+void page_cache_t::spawn_flush(const std::vector<page_txn_t *> &bases) {
+    assert_thread();
+    ASSERT_FINITE_CORO_WAITING;
+
+    std::vector<page_txn_t *> flush_set;
+    for (auto base = bases.begin(); base != bases.end(); ++base) {
+        if ((*base)->spawned_flush_) {
+            // It was flushable from one of the previous bases.
+            continue;
+        }
+        std::vector<page_txn_t *> base_flush_set
+            = page_cache_t::maximal_flushable_txn_set(*base);
+        for (auto it = base_flush_set.begin(); it != base_flush_set.end(); ++it) {
             rassert(!(*it)->spawned_flush_);
             (*it)->spawned_flush_ = true;
+            // Once the flush is spawned the txn can get destroyed at any time, so
+            // it must not stay among the write-back txns.
+            write_back_txns_.erase(*it);
+            flush_set.push_back(*it);
         }
+    }
+    // The txns that can't be flushed yet are waiting for a txn that hasn't begun
+    // waiting for a flush.  They get flushed along with that txn.
+    for (auto base = bases.begin(); base != bases.end(); ++base) {
+        write_back_txns_.erase(*base);
+    }
 
+    if (!flush_set.empty()) {
         std::map<block_id_t, block_change_t> changes
             = page_cache_t::compute_changes(flush_set);
 
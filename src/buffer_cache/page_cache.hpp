@@ -5,9 +5,11 @@
 #include <functional>
 #include <map>
 #include <set>
+#include <string>
 #include <utility>
 #include <vector>
 
+#include "arch/types.hpp"
 #include "buffer_cache/block_version.hpp"
 #include "buffer_cache/cache_account.hpp"
 #include "buffer_cache/evicter.hpp"
@@ -21,6 +23,7 @@
 #include "concurrency/new_semaphore.hpp"
 #include "containers/backindex_bag.hpp"
 #include "containers/intrusive_list.hpp"
+#include "containers/radix_array.hpp"
 #include "containers/segmented_vector.hpp"
 #include "repli_timestamp.hpp"
 #include "serializer/types.hpp"
@@ -28,6 +31,7 @@
 class alt_txn_throttler_t;
 class cache_balancer_t;
 class auto_drainer_t;
+class repeating_timer_t;
 class cache_t;
 class file_account_t;
 
@@ -127,6 +131,10 @@ private:
 
     bool is_deleted() const { return is_deleted_; }
 
+    // True if some acquirer in acquirers_ has write access, i.e. a read acquirer
+    // getting in line now would not be handed the page right away.
+    bool has_write_acquirer() const;
+
     // KSI: We could get rid of this variable if
     // page_txn_t::pages_write_acquired_last_ noted each page's block_id_t.  Other
     // space reductions are more important.
@@ -311,19 +319,33 @@ class page_cache_t : public home_thread_mixin_t {
 public:
     page_cache_t(serializer_t *serializer,
                  cache_balancer_t *balancer,
-                 alt_txn_throttler_t *throttler);
+                 alt_txn_throttler_t *throttler,
+                 memory_tag_t memory_tag = memory_tag_t::page_cache);
     ~page_cache_t();
 
     // Takes a txn to be flushed.  Calls on_flush_complete() (which resets the
-    // throttler_acq parameter) when done.
+    // throttler_acq parameter) when done.  With soft durability, the flush can be
+    // held back for the write-back window (see set_write_back_window_ms()); with
+    // hard durability the txn, and whatever txns it depends on, are flushed right
+    // away.
     void flush_and_destroy_txn(
             scoped_ptr_t<page_txn_t> txn,
+            write_durability_t durability,
             std::function<void(throttler_acq_t *)> on_flush_complete);
 
     current_page_t *page_for_block_id(block_id_t block_id);
     current_page_t *page_for_new_block_id(block_id_t *block_id_out);
     current_page_t *page_for_new_chosen_block_id(block_id_t block_id);
 
+    // For optimistic read-only descents (see buf_optimistic_read_t).  Returns the
+    // block's page if it is loaded in memory and no write acquirer is in line for it,
+    // and NULL otherwise -- this never loads a page or creates a current_page_t.
+    // Sets *version_out to the page's current block version, which
+    // optimistic_read_is_valid() checks against.
+    page_t *optimistic_page_for_read(block_id_t block_id,
+                                     block_version_t *version_out);
+    bool optimistic_read_is_valid(block_id_t block_id, block_version_t version) const;
+
     // Returns how much memory is being used by all the pages in the cache at this
     // moment in time.
     size_t total_page_memory() const;
@@ -331,7 +353,8 @@ public:
 
     max_block_size_t max_block_size() const { return max_block_size_; }
 
-    cache_account_t create_cache_account(int priority);
+    cache_account_t create_cache_account(int priority,
+                                         io_class_t io_class = io_class_t::other);
 
     cache_account_t *default_reads_account() {
         return &default_reads_account_;
@@ -347,6 +370,11 @@ public:
 
     void have_read_ahead_cb_destroyed();
 
+    // Loads the blocks listed in the warmup snapshot at `path`, if there is one, and
+    // from now on keeps the snapshot up to date. See warmup_snapshot.hpp.  Warming up
+    // uses the read-ahead mechanism, so it stops once the cache is full.
+    void enable_warmup_snapshots(const std::string &path);
+
     evicter_t &evicter() { return evicter_; }
 
     auto_drainer_t::lock_t drainer_lock() { return drainer_->lock(); }
@@ -360,6 +388,14 @@ private:
 
     void read_ahead_cb_is_destroyed();
 
+    // The ids of the blocks that are loaded in memory, most recently used first.
+    std::vector<block_id_t> hot_block_ids();
+
+    void on_warmup_snapshot_timer();
+    static void save_warmup_snapshot_periodically(page_cache_t *page_cache,
+                                                  auto_drainer_t::lock_t lock);
+    static void warm_up(page_cache_t *page_cache, auto_drainer_t::lock_t lock);
+
 
     current_page_t *internal_page_for_new_chosen(block_id_t block_id);
 
@@ -396,7 +432,14 @@ private:
 
     static std::vector<page_txn_t *> maximal_flushable_txn_set(page_txn_t *base);
 
-    void im_waiting_for_flush(page_txn_t *txns);
+    void im_waiting_for_flush(page_txn_t *base, write_durability_t durability);
+
+    // Flushes every txn that can be flushed, given the txns in `bases` that are
+    // waiting for a flush, as a single set of changes.
+    void spawn_flush(const std::vector<page_txn_t *> &bases);
+
+    static void flush_write_back_txns_later(page_cache_t *page_cache,
+                                            auto_drainer_t::lock_t lock);
 
     friend class current_page_acq_t;
     repli_timestamp_t recency_for_block_id(block_id_t id) {
@@ -415,7 +458,6 @@ private:
     friend class current_page_t;
     free_list_t *free_list() { return &free_list_; }
 
-    void resize_current_pages_to_id(block_id_t block_id);
 
     static void consider_evicting_all_current_pages(page_cache_t *page_cache,
                                                     auto_drainer_t::lock_t lock);
@@ -437,7 +479,7 @@ private:
     serializer_t *serializer_;
     segmented_vector_t<repli_timestamp_t> recencies_;
 
-    segmented_vector_t<current_page_t *> current_pages_;
+    radix_array_t<current_page_t *> current_pages_;
 
     free_list_t free_list_;
 
@@ -451,11 +493,28 @@ private:
     // destroyed and all possible read-ahead operations have completed.
     auto_drainer_t::lock_t read_ahead_cb_existence_;
 
+    // Empty unless enable_warmup_snapshots() has been called.
+    std::string warmup_snapshot_path_;
+    scoped_ptr_t<repeating_timer_t> warmup_snapshot_timer_;
+    bool saving_warmup_snapshot_;
+
+    // Soft durability txns that wait for the write-back window to end before they
+    // get flushed, and whether flush_write_back_txns_later is running.
+    std::set<page_txn_t *> write_back_txns_;
+    bool write_back_pending_;
+
     scoped_ptr_t<auto_drainer_t> drainer_;
 
     DISABLE_COPYING(page_cache_t);
 };
 
+// Makes page caches hold back the flushes of soft durability txns for up to `ms`
+// milliseconds, and then flush all the txns that accumulated together.  A page that
+// gets modified over and over is then written once per window, instead of once per
+// txn.  Zero (the default) flushes every txn as soon as it's done.  Must be called
+// before the thread pool starts, if at all.
+void set_write_back_window_ms(int64_t ms);
+
 class dirtied_page_t {
 public:
     dirtied_page_t()
@@ -568,7 +627,7 @@ private:
     void add_acquirer(current_page_acq_t *acq);
     void remove_acquirer(current_page_acq_t *acq);
 
-    void announce_waiting_for_flush();
+    void announce_waiting_for_flush(write_durability_t durability);
 
     page_cache_t *page_cache_;
     // This can be NULL, if the txn is not part of some cache conn.
@@ -15,18 +15,27 @@ public:
     perfmon_collection_t cache_collection;
     perfmon_membership_t cache_membership;
 
+    // Reports the value of one of the evicter's getters.
     class perfmon_value_t : public perfmon_t {
     public:
-        explicit perfmon_value_t(alt_cache_stats_t *_parent);
+        perfmon_value_t(alt_cache_stats_t *_parent,
+                        uint64_t (alt::evicter_t::*_getter)() const);
         void *begin_stats();
         void visit_stats(void *);
         ql::datum_t end_stats(void *);
     private:
         alt_cache_stats_t *parent;
+        uint64_t (alt::evicter_t::*getter)() const;
         DISABLE_COPYING(perfmon_value_t);
     };
     perfmon_value_t in_use_bytes;
     perfmon_membership_t in_use_bytes_membership;
+    perfmon_value_t limit_bytes;
+    perfmon_membership_t limit_bytes_membership;
+    perfmon_value_t page_accesses_total;
+    perfmon_membership_t page_accesses_total_membership;
+    perfmon_value_t page_loads_total;
+    perfmon_membership_t page_loads_total_membership;
 
 
     perfmon_multi_membership_t cache_collection_membership;
@@ -39,4 +39,14 @@ struct block_magic_t {
 
 void debug_print(printf_buffer_t *buf, block_magic_t magic);
 
+// Data computed from a block's contents, like a search index, that readers can cache
+// in memory alongside the block.  See buf_read_t::derived_data().
+class buf_derived_data_t {
+public:
+    buf_derived_data_t() { }
+    virtual ~buf_derived_data_t() { }
+private:
+    DISABLE_COPYING(buf_derived_data_t);
+};
+
 #endif /* BUFFER_CACHE_TYPES_HPP_ */
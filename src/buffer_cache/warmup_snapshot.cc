@@ -0,0 +1,109 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "buffer_cache/warmup_snapshot.hpp"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "arch/io/io_utils.hpp"
+#include "arch/runtime/thread_pool.hpp"
+#include "arch/types.hpp"
+#include "logger.hpp"
+#include "utils.hpp"
+
+// The file starts with this, followed by the number of block ids and the block ids
+// themselves, all in native byte order.
+const uint64_t WARMUP_SNAPSHOT_MAGIC = 0x31706d7261776472ull;  // "rdwarmp1"
+
+bool load_warmup_snapshot(const std::string &path,
+                          std::vector<block_id_t> *block_ids_out) {
+    std::string contents;
+    bool read_ok = false;
+    thread_pool_t::run_in_blocker_pool([&]() {
+        read_ok = blocking_read_file(path.c_str(), &contents);
+    });
+    if (!read_ok) {
+        return false;
+    }
+
+    uint64_t header[2];
+    if (contents.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(header, contents.data(), sizeof(header));
+    if (header[0] != WARMUP_SNAPSHOT_MAGIC
+        || (contents.size() - sizeof(header)) / sizeof(uint64_t) != header[1]
+        || (contents.size() - sizeof(header)) % sizeof(uint64_t) != 0) {
+        logWRN("Ignoring malformed cache warmup file %s.", path.c_str());
+        return false;
+    }
+
+    block_ids_out->resize(header[1]);
+    for (uint64_t i = 0; i < header[1]; ++i) {
+        uint64_t block_id;
+        memcpy(&block_id, contents.data() + sizeof(header) + i * sizeof(uint64_t),
+               sizeof(uint64_t));
+        (*block_ids_out)[i] = block_id;
+    }
+    return true;
+}
+
+static bool blocking_write_all(fd_t fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t res;
+        do {
+            res = write(fd, data, size);
+        } while (res == -1 && get_errno() == EINTR);
+        if (res == -1) {
+            return false;
+        }
+        data += res;
+        size -= res;
+    }
+    return true;
+}
+
+void save_warmup_snapshot(const std::string &path,
+                          const std::vector<block_id_t> &block_ids) {
+    std::string contents;
+    contents.reserve(2 * sizeof(uint64_t) + block_ids.size() * sizeof(uint64_t));
+    const uint64_t header[2] = { WARMUP_SNAPSHOT_MAGIC, block_ids.size() };
+    contents.append(reinterpret_cast<const char *>(header), sizeof(header));
+    for (auto it = block_ids.begin(); it != block_ids.end(); ++it) {
+        const uint64_t block_id = *it;
+        contents.append(reinterpret_cast<const char *>(&block_id), sizeof(block_id));
+    }
+
+    // We write a temporary file and rename it, so that a crash while writing leaves
+    // the previous snapshot in place.
+    const std::string temporary_path = path + ".tmp";
+    int error = 0;
+    thread_pool_t::run_in_blocker_pool([&]() {
+        scoped_fd_t fd;
+        {
+            int res;
+            do {
+                res = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            } while (res == -1 && get_errno() == EINTR);
+            if (res == -1) {
+                error = get_errno();
+                return;
+            }
+            fd.reset(res);
+        }
+        if (!blocking_write_all(fd.get(), contents.data(), contents.size())) {
+            error = get_errno();
+            return;
+        }
+        fd.reset();
+        if (::rename(temporary_path.c_str(), path.c_str()) != 0) {
+            error = get_errno();
+        }
+    });
+    if (error != 0) {
+        logWRN("Could not write cache warmup file %s: %s", path.c_str(),
+               errno_string(error).c_str());
+    }
+}
@@ -0,0 +1,26 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef BUFFER_CACHE_WARMUP_SNAPSHOT_HPP_
+#define BUFFER_CACHE_WARMUP_SNAPSHOT_HPP_
+
+#include <string>
+#include <vector>
+
+#include "serializer/types.hpp"
+
+/* A warmup snapshot is a list of the block ids that a `page_cache_t` had in memory,
+hottest first. The cache writes one every now and then and when it shuts down, and
+loads the blocks in it when it starts up again, so that it doesn't have to refill
+block by block while serving queries.
+
+The snapshot is only a hint. A missing or corrupt file just means that we don't warm
+up, and failing to write it is logged and otherwise ignored.
+
+Both functions block the calling coroutine, but do the file i/o in the blocker pool. */
+
+bool load_warmup_snapshot(const std::string &path,
+                          std::vector<block_id_t> *block_ids_out);
+
+void save_warmup_snapshot(const std::string &path,
+                          const std::vector<block_id_t> &block_ids);
+
+#endif  // BUFFER_CACHE_WARMUP_SNAPSHOT_HPP_
@@ -246,6 +246,22 @@ ql::datum_t convert_microtime_to_datum(
     return ql::pseudo::make_time(value / 1.0e6, "+00:00");
 }
 
+ql::datum_t convert_store_key_to_datum(
+        const store_key_t &key) {
+    return ql::datum_t::binary(datum_string_t(
+        key.size(), reinterpret_cast<const char *>(key.contents())));
+}
+
+ql::datum_t convert_key_range_to_datum(
+        const key_range_t &range) {
+    ql::datum_array_builder_t builder(ql::configured_limits_t::unlimited);
+    builder.add(convert_store_key_to_datum(range.left));
+    builder.add(range.right.unbounded
+        ? ql::datum_t::null()
+        : convert_store_key_to_datum(range.right.key));
+    return std::move(builder).to_datum();
+}
+
 bool converter_from_datum_object_t::init(
         ql::datum_t _datum,
         std::string *error_out) {
@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 
+#include "btree/keys.hpp"
 #include "containers/name_string.hpp"
 #include "rdb_protocol/context.hpp"
 #include "rdb_protocol/datum.hpp"
@@ -101,6 +102,16 @@ ql::datum_t convert_port_to_datum(
 ql::datum_t convert_microtime_to_datum(
         microtime_t value);
 
+/* Store keys are the server's own encoding of primary keys rather than ReQL values, so
+they are exposed as binary data. They sort the same way the server's B-trees do. */
+ql::datum_t convert_store_key_to_datum(
+        const store_key_t &key);
+
+/* Returns an array of the range's left bound and right bound, or `null` in place of the
+right bound if the range is unbounded on the right. */
+ql::datum_t convert_key_range_to_datum(
+        const key_range_t &range);
+
 template<class T>
 ql::datum_t convert_vector_to_datum(
         const std::function<ql::datum_t(const T&)> &conv,
@@ -0,0 +1,87 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CLUSTERING_ADMINISTRATION_HTTP_CORO_SAMPLER_APP_HPP_
+#define CLUSTERING_ADMINISTRATION_HTTP_CORO_SAMPLER_APP_HPP_
+
+#include <inttypes.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "arch/runtime/coro_sampler.hpp"
+#include "http/http.hpp"
+#include "utils.hpp"
+
+/* This is an `http_app_t` that controls the `coro_sampler_t` of the server
+processing the request. `GET` returns the samples recorded so far in the folded
+format that flamegraph.pl consumes: by default where coroutines run, weighted by
+running time; with `?profile=wait` where they are blocked, weighted by blocked time;
+with `?profile=wait_count` where they are blocked, weighted by the number of waits;
+and with `?profile=allocation` where tagged memory was allocated, weighted by bytes.
+`POST ?interval=N` makes every thread record a sample on every N-th coroutine
+yield, `POST ?wait_interval=N` on every N-th coroutine wait, and
+`POST ?allocation_interval=N` about every N bytes of tagged allocations; 0 switches
+the respective sampling off. */
+class coro_sampler_http_app_t : public http_app_t {
+private:
+    void handle(const http_req_t &req, http_res_t *result, signal_t *) {
+        if (req.method == http_method_t::GET) {
+            boost::optional<std::string> profile = req.find_query_param("profile");
+            if (req.query_params.size() > (profile ? 1 : 0)) {
+                *result = http_error_res("Unexpected query param");
+                return;
+            }
+            std::string stacks;
+            if (!profile || *profile == "cpu") {
+                stacks = coro_sampler_t::get_global_sampler().get_folded_stacks();
+            } else if (*profile == "wait") {
+                stacks = coro_sampler_t::get_global_sampler().get_folded_wait_stacks(
+                    coro_sampler_t::wait_weight_t::BLOCKED_TIME);
+            } else if (*profile == "wait_count") {
+                stacks = coro_sampler_t::get_global_sampler().get_folded_wait_stacks(
+                    coro_sampler_t::wait_weight_t::COUNT);
+            } else if (*profile == "allocation") {
+                stacks =
+                    coro_sampler_t::get_global_sampler().get_folded_allocation_stacks();
+            } else {
+                *result = http_error_res("Expected `profile` to be `cpu`, `wait`, "
+                                         "`wait_count` or `allocation`");
+                return;
+            }
+            *result = http_res_t(http_status_code_t::OK, "text/plain", stacks);
+        } else if (req.method == http_method_t::POST) {
+            boost::optional<std::string> interval_str = req.find_query_param("interval");
+            boost::optional<std::string> wait_interval_str =
+                req.find_query_param("wait_interval");
+            boost::optional<std::string> allocation_interval_str =
+                req.find_query_param("allocation_interval");
+            const boost::optional<std::string> &given_str =
+                interval_str ? interval_str
+                : wait_interval_str ? wait_interval_str
+                : allocation_interval_str;
+            uint64_t interval;
+            if (req.query_params.size() != 1
+                || !given_str
+                || !strtou64_strict(*given_str, 10, &interval)
+                || interval > UINT32_MAX) {
+                *result = http_error_res("Expected a single `interval`, "
+                                         "`wait_interval` or `allocation_interval` "
+                                         "query param");
+                return;
+            }
+            if (interval_str) {
+                coro_sampler_t::set_sample_interval(static_cast<uint32_t>(interval));
+            } else if (wait_interval_str) {
+                coro_sampler_t::set_wait_sample_interval(static_cast<uint32_t>(interval));
+            } else {
+                coro_sampler_t::set_allocation_sample_interval(
+                    static_cast<uint32_t>(interval));
+            }
+            *result = http_res_t(http_status_code_t::OK, "application/json",
+                                 strprintf("%" PRIu64, interval));
+        } else {
+            *result = http_res_t(http_status_code_t::METHOD_NOT_ALLOWED);
+        }
+    }
+};
+
+#endif /* CLUSTERING_ADMINISTRATION_HTTP_CORO_SAMPLER_APP_HPP_ */
@@ -1,6 +1,7 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/administration/http/server.hpp"
 
+#include "clustering/administration/http/coro_sampler_app.hpp"
 #include "clustering/administration/http/cyanide.hpp"
 #include "clustering/administration/http/me_app.hpp"
 #include "http/file_app.hpp"
@@ -20,6 +21,8 @@ administrative_http_server_manager_t::administrative_http_server_manager_t(
 
     me_app.init(new me_http_app_t(my_server_id));
 
+    coro_sampler_app.init(new coro_sampler_http_app_t);
+
 #ifndef NDEBUG
     cyanide_app.init(new cyanide_http_app_t);
 #endif
@@ -27,6 +30,7 @@ administrative_http_server_manager_t::administrative_http_server_manager_t(
     std::map<std::string, http_app_t *> ajax_routes;
     ajax_routes["me"] = me_app.get();
     ajax_routes["reql"] = reql_app;
+    ajax_routes["coro_sampler"] = coro_sampler_app.get();
     DEBUG_ONLY_CODE(ajax_routes["cyanide"] = cyanide_app.get());
     ajax_routing_app.init(new routing_http_app_t(nullptr, ajax_routes));
 
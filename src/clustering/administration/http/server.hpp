@@ -15,6 +15,7 @@ class http_server_t;
 class routing_http_app_t;
 class file_http_app_t;
 class me_http_app_t;
+class coro_sampler_http_app_t;
 class cyanide_http_app_t;
 
 class real_reql_cluster_interface_t;
@@ -35,6 +36,7 @@ private:
 
     scoped_ptr_t<file_http_app_t> file_app;
     scoped_ptr_t<me_http_app_t> me_app;
+    scoped_ptr_t<coro_sampler_http_app_t> coro_sampler_app;
 #ifndef NDEBUG
     scoped_ptr_t<cyanide_http_app_t> cyanide_app;
 #endif
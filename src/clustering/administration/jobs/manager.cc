@@ -5,6 +5,7 @@
 #include <iterator>
 
 #include "clustering/administration/reactor_driver.hpp"
+#include "concurrency/pmap.hpp"
 #include "concurrency/watchable.hpp"
 #include "pprint/js_pprint.hpp"
 #include "rdb_protocol/context.hpp"
@@ -91,37 +92,39 @@ void jobs_manager_t::on_get_job_reports(
     microtime_t time = current_microtime();
 
     if (rdb_context != nullptr) {
-        pmap(get_num_threads(), [&](int32_t threadnum) {
-            // Here we need to store `query_job_report_t` locally to prevent multiple threads
-            // from inserting into the outer `job_reports`.
-            std::vector<query_job_report_t> query_job_reports_inner;
-            {
-                on_thread_t thread((threadnum_t(threadnum)));
-
-                for (auto const &query_cache
-                        : *rdb_context->get_query_caches_for_this_thread()) {
-                    for (auto const &pair : *query_cache) {
-                        if (pair.second->persistent_interruptor.is_pulsed()) {
-                            continue;
-                        }
-
-                        auto render = pprint::render_as_javascript(
-                            pair.second->original_query->query());
-
-                        query_job_reports_inner.emplace_back(
-                            pair.second->job_id,
-                            time - std::min(pair.second->start_time, time),
-                            server_id,
-                            query_cache->get_client_addr_port(),
-                            pretty_print(printed_query_columns, render));
+        // Each thread fills in its own vector, so that they don't all insert into the
+        // outer `query_job_reports` at once.
+        std::vector<std::vector<query_job_report_t> > query_job_reports_per_thread(
+            get_num_threads());
+        pmap_on_threads([&](size_t threadnum) {
+            std::vector<query_job_report_t> *query_job_reports_inner =
+                &query_job_reports_per_thread[threadnum];
+            for (auto const &query_cache
+                    : *rdb_context->get_query_caches_for_this_thread()) {
+                for (auto const &pair : *query_cache) {
+                    if (pair.second->persistent_interruptor.is_pulsed()) {
+                        continue;
                     }
+
+                    auto render = pprint::render_as_javascript(
+                        pair.second->original_query->query());
+
+                    query_job_reports_inner->emplace_back(
+                        pair.second->job_id,
+                        time - std::min(pair.second->start_time, time),
+                        server_id,
+                        query_cache->get_client_addr_port(),
+                        pretty_print(printed_query_columns, render),
+                        pair.second->usage);
                 }
             }
+        });
+        for (auto &&query_job_reports_inner : query_job_reports_per_thread) {
             query_job_reports.insert(
                 query_job_reports.end(),
                 std::make_move_iterator(query_job_reports_inner.begin()),
                 std::make_move_iterator(query_job_reports_inner.end()));
-        });
+        }
     }
 
     if (reactor_driver != nullptr) {
@@ -201,9 +204,7 @@ void jobs_manager_t::on_job_interrupt(
 
     auto lock = drainer.lock();
 
-    pmap(get_num_threads(), [&](int32_t threadnum) {
-        on_thread_t thread((threadnum_t(threadnum)));
-
+    pmap_on_threads([&](size_t) {
         if (rdb_context != nullptr) {
             for (auto &&query_cache : *rdb_context->get_query_caches_for_this_thread()) {
                 for (auto &&pair : *query_cache) {
@@ -218,10 +218,12 @@ query_job_report_t::query_job_report_t(
         double _duration,
         server_id_t const &_server_id,
         ip_and_port_t const &_client_addr_port,
-        std::string const &_query)
+        std::string const &_query,
+        resource_usage_t const &_usage)
     : job_report_base_t<query_job_report_t>("query", _id, _duration, _server_id),
       client_addr_port(_client_addr_port),
-      query(_query) { }
+      query(_query),
+      usage(_usage) { }
 
 void query_job_report_t::merge_derived(query_job_report_t const &) { }
 
@@ -236,8 +238,29 @@ bool query_job_report_t::info_derived(
         convert_port_to_datum(client_addr_port.port().value()));
     info_builder_out->overwrite("query", convert_string_to_datum(query));
 
+    ql::datum_object_builder_t usage_builder;
+    usage_builder.overwrite("cpu_time_sec",
+        ql::datum_t(ticks_to_secs(usage.run_ticks)));
+    usage_builder.overwrite("blocks_read_from_cache",
+        ql::datum_t(static_cast<double>(usage.blocks_from_cache)));
+    usage_builder.overwrite("blocks_read_from_disk",
+        ql::datum_t(static_cast<double>(usage.blocks_from_disk)));
+    usage_builder.overwrite("bytes_read",
+        ql::datum_t(static_cast<double>(usage.bytes_read)));
+    usage_builder.overwrite("bytes_written",
+        ql::datum_t(static_cast<double>(usage.bytes_written)));
+    usage_builder.overwrite("rows_scanned",
+        ql::datum_t(static_cast<double>(usage.rows_scanned)));
+    usage_builder.overwrite("rows_returned",
+        ql::datum_t(static_cast<double>(usage.rows_returned)));
+    usage_builder.overwrite("shard_requests",
+        ql::datum_t(static_cast<double>(usage.shard_requests)));
+    usage_builder.overwrite("datum_bytes_allocated",
+        ql::datum_t(static_cast<double>(usage.datum_bytes_allocated)));
+    info_builder_out->overwrite("usage", std::move(usage_builder).to_datum());
+
     return true;
 }
 
-RDB_IMPL_SERIALIZABLE_6_FOR_CLUSTER(
-    query_job_report_t, type, id, duration, servers, client_addr_port, query);
+RDB_IMPL_SERIALIZABLE_7_FOR_CLUSTER(
+    query_job_report_t, type, id, duration, servers, client_addr_port, query, usage);
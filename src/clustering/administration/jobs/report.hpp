@@ -5,6 +5,7 @@
 #include <string>
 
 #include "arch/address.hpp"
+#include "arch/runtime/resource_usage.hpp"
 #include "btree/secondary_operations.hpp"
 #include "clustering/administration/datum_adapter.hpp"
 #include "concurrency/signal.hpp"
@@ -133,7 +134,8 @@ public:
             double duration,
             server_id_t const &server_id,
             ip_and_port_t const &client_addr_port,
-            std::string const &query);
+            std::string const &query,
+            resource_usage_t const &usage);
 
     void merge_derived(query_job_report_t const &job_report);
 
@@ -145,6 +147,7 @@ public:
 
     ip_and_port_t client_addr_port;
     std::string query;
+    resource_usage_t usage;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(query_job_report_t);
 
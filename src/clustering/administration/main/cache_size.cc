@@ -9,6 +9,7 @@
 #include <mach/mach.h>
 #endif
 
+#include <algorithm>
 #include <limits>
 #include <string>
 
@@ -135,6 +136,47 @@ bool get_proc_meminfo_available_memory_size(uint64_t *mem_avail_out) {
     return parse_meminfo_file(contents, mem_avail_out);
 }
 
+/* Reads a cgroup memory file, which holds a single number of bytes. Returns false
+if it holds something else, such as "max" for a cgroup without a limit. */
+bool parse_cgroup_memory_file(const std::string &contents, uint64_t *value_out) {
+    size_t end = contents.find_last_not_of(" \t\n");
+    if (end == std::string::npos) {
+        return false;
+    }
+    return strtou64_strict(contents.substr(0, end + 1), 10, value_out);
+}
+
+/* If we're in a cgroup with a memory limit, computes how much of it is left. Inside
+a container, this is usually much less than what `/proc/meminfo` reports for the
+host, and it's what the OOM killer goes by. */
+bool get_cgroup_available_memory_size(uint64_t *mem_avail_out) {
+    static const char *const limit_and_usage_paths[][2] = {
+        // cgroup v2
+        { "/sys/fs/cgroup/memory.max", "/sys/fs/cgroup/memory.current" },
+        // cgroup v1
+        { "/sys/fs/cgroup/memory/memory.limit_in_bytes",
+          "/sys/fs/cgroup/memory/memory.usage_in_bytes" } };
+    for (const auto &paths : limit_and_usage_paths) {
+        std::string limit_contents, usage_contents;
+        bool ok;
+        thread_pool_t::run_in_blocker_pool([&]() {
+            ok = blocking_read_file(paths[0], &limit_contents)
+                && blocking_read_file(paths[1], &usage_contents);
+        });
+        if (!ok) {
+            continue;
+        }
+        uint64_t limit, usage;
+        if (!parse_cgroup_memory_file(limit_contents, &limit)
+            || !parse_cgroup_memory_file(usage_contents, &usage)) {
+            return false;
+        }
+        *mem_avail_out = limit > usage ? limit - usage : 0;
+        return true;
+    }
+    return false;
+}
+
 #endif  // __MACH_
 
 uint64_t get_avail_mem_size() {
@@ -173,16 +215,19 @@ uint64_t get_avail_mem_size() {
 #else
     {
         uint64_t memory;
-        if (get_proc_meminfo_available_memory_size(&memory)) {
-            return memory;
-        } else {
+        if (!get_proc_meminfo_available_memory_size(&memory)) {
             logERR("Could not parse /proc/meminfo, so we will treat cached file memory "
                 "as if it were unavailable.");
 
             // This just returns what /proc/meminfo would report as "MemFree".
             uint64_t avail_mem_pages = sysconf(_SC_AVPHYS_PAGES);
-            return avail_mem_pages * page_size;
+            memory = avail_mem_pages * page_size;
+        }
+        uint64_t cgroup_memory;
+        if (get_cgroup_available_memory_size(&cgroup_memory)) {
+            memory = std::min(memory, cgroup_memory);
         }
+        return memory;
     }
 #endif
 }
@@ -203,9 +248,7 @@ uint64_t get_max_total_cache_size() {
         static_cast<uint64_t>(MEGABYTE) * static_cast<uint64_t>(GIGABYTE));
 }
 
-uint64_t get_default_total_cache_size() {
-    const int64_t available_mem = get_avail_mem_size();
-
+static uint64_t compute_total_cache_size(int64_t available_mem) {
     // Default to half the available memory minus a gigabyte, to leave room for server
     // and query overhead, but never default to less than 100 megabytes
     const int64_t signed_res =
@@ -215,6 +258,14 @@ uint64_t get_default_total_cache_size() {
     return res;
 }
 
+uint64_t get_default_total_cache_size() {
+    return compute_total_cache_size(get_avail_mem_size());
+}
+
+uint64_t get_auto_total_cache_size(uint64_t current_size) {
+    return compute_total_cache_size(get_avail_mem_size() + current_size);
+}
+
 void log_warnings_for_cache_size(uint64_t bytes) {
     const uint64_t available_memory = get_avail_mem_size();
     if (bytes > available_memory) {
@@ -7,6 +7,10 @@
 
 uint64_t get_max_total_cache_size();
 uint64_t get_default_total_cache_size();
+/* Recomputes the automatic cache size while the server is running. The
+`current_size` bytes that the cache is allowed to use count as available, because
+it's the cache that's holding them. */
+uint64_t get_auto_total_cache_size(uint64_t current_size);
 void log_warnings_for_cache_size(uint64_t);
 
 #endif  // CLUSTERING_ADMINISTRATION_MAIN_CACHE_SIZE_HPP_
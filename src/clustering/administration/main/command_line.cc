@@ -25,10 +25,18 @@
 #include <re2/re2.h>
 
 #include "arch/io/disk.hpp"
+#include "arch/io/tls.hpp"
 #include "arch/os_signal.hpp"
+#include "arch/runtime/event_queue.hpp"
 #include "arch/runtime/starter.hpp"
+#include "btree/key_filter.hpp"
+#include "buffer_cache/block_slab.hpp"
+#include "buffer_cache/evicter.hpp"
+#include "buffer_cache/page_cache.hpp"
+#include "extproc/extproc_pool.hpp"
 #include "extproc/extproc_spawner.hpp"
 #include "clustering/administration/main/cache_size.hpp"
+#include "clustering/administration/main/file_based_svs_by_namespace.hpp"
 #include "clustering/administration/main/names.hpp"
 #include "clustering/administration/main/options.hpp"
 #include "clustering/administration/main/ports.hpp"
@@ -40,6 +48,10 @@
 #include "clustering/administration/main/path.hpp"
 #include "clustering/administration/persist.hpp"
 #include "logger.hpp"
+#include "protob/protob.hpp"
+#include "rdb_protocol/query_cache.hpp"
+#include "rdb_protocol/query_memory.hpp"
+#include "rdb_protocol/result_cache.hpp"
 
 #define RETHINKDB_EXPORT_SCRIPT "rethinkdb-export"
 #define RETHINKDB_IMPORT_SCRIPT "rethinkdb-import"
@@ -449,6 +461,80 @@ boost::optional<boost::optional<uint64_t> > parse_total_cache_size_option(
     }
 }
 
+// Returns the huge page size to allocate cache memory from, or 0 if the
+// `--cache-huge-pages` parameter is not present.
+size_t parse_cache_huge_pages_option(const std::map<std::string, options::values_t> &opts) {
+    if (!exists_option(opts, "--cache-huge-pages")) {
+        return 0;
+    }
+    const std::string huge_pages_opt = get_single_option(opts, "--cache-huge-pages");
+    if (huge_pages_opt == "2m" || huge_pages_opt == "2M") {
+        return 2 * MEGABYTE;
+    } else if (huge_pages_opt == "1g" || huge_pages_opt == "1G") {
+        return GIGABYTE;
+    } else {
+        throw std::runtime_error(strprintf(
+                "ERROR: cache-huge-pages should be '2m' or '1g', got '%s'",
+                huge_pages_opt.c_str()));
+    }
+}
+
+// Returns 0 if the `--cache-write-back-window` parameter is not present.
+int64_t parse_cache_write_back_window_option(
+        const std::map<std::string, options::values_t> &opts) {
+    if (!exists_option(opts, "--cache-write-back-window")) {
+        return 0;
+    }
+    const std::string window_opt = get_single_option(opts, "--cache-write-back-window");
+    uint64_t window_ms;
+    if (!strtou64_strict(window_opt, 10, &window_ms) || window_ms > 60 * THOUSAND) {
+        throw std::runtime_error(strprintf(
+                "ERROR: cache-write-back-window should be a number of milliseconds "
+                "between 0 and 60000, got '%s'", window_opt.c_str()));
+    }
+    return window_ms;
+}
+
+// Returns an empty string if the `--slow-tier-directory` parameter is not present.
+std::string parse_slow_tier_options(
+        const std::map<std::string, options::values_t> &opts,
+        int64_t *fast_tier_size_out) {
+    *fast_tier_size_out = 0;
+    if (!exists_option(opts, "--slow-tier-directory")) {
+        if (exists_option(opts, "--fast-tier-size")) {
+            throw std::runtime_error(
+                "ERROR: fast-tier-size can only be used with slow-tier-directory");
+        }
+        return std::string();
+    }
+    if (!exists_option(opts, "--fast-tier-size")) {
+        throw std::runtime_error(
+            "ERROR: slow-tier-directory requires fast-tier-size");
+    }
+
+    const std::string size_opt = get_single_option(opts, "--fast-tier-size");
+    uint64_t size_mb;
+    if (!strtou64_strict(size_opt, 10, &size_mb) || size_mb == 0
+        || size_mb > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()
+                                           / MEGABYTE)) {
+        throw std::runtime_error(strprintf(
+                "ERROR: fast-tier-size should be a positive number of megabytes, "
+                "got '%s'", size_opt.c_str()));
+    }
+    *fast_tier_size_out = size_mb * MEGABYTE;
+
+    // Make sure we return an absolute path, since we might change directories when
+    // daemonizing.
+    base_path_t slow_tier_path(get_single_option(opts, "--slow-tier-directory"));
+    if (!check_existence(slow_tier_path)) {
+        throw std::runtime_error(strprintf(
+                "ERROR: slow tier directory not found '%s'",
+                slow_tier_path.path().c_str()));
+    }
+    slow_tier_path.make_absolute();
+    return slow_tier_path.path();
+}
+
 // Note that this defaults to the peer port if no port is specified
 //  (at the moment, this is only used for parsing --join directives)
 // Possible formats:
@@ -647,7 +733,8 @@ service_address_ports_t get_service_address_ports(const std::map<std::string, op
         exists_option(opts, "--no-http-admin"),
         offseted_port(get_single_int(opts, "--http-port"), port_offset),
         offseted_port(get_single_int(opts, "--driver-port"), port_offset),
-        port_offset);
+        port_offset,
+        exists_option(opts, "--compress-cluster-traffic"));
 }
 
 
@@ -657,6 +744,7 @@ void run_rethinkdb_create(const base_path_t &base_path,
                           boost::optional<uint64_t> total_cache_size,
                           const file_direct_io_mode_t direct_io_mode,
                           const int max_concurrent_io_requests,
+                          const io_backend_mode_t io_backend_mode,
                           bool *const result_out) {
     server_id_t our_server_id = generate_uuid();
 
@@ -673,7 +761,8 @@ void run_rethinkdb_create(const base_path_t &base_path,
     cluster_metadata.servers.servers.insert(
         std::make_pair(our_server_id, make_deletable(server_semilattice_metadata)));
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests,
+                                io_backend_mode);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -724,6 +813,7 @@ void run_rethinkdb_serve(const base_path_t &base_path,
                          serve_info_t *serve_info,
                          const file_direct_io_mode_t direct_io_mode,
                          const int max_concurrent_io_requests,
+                         const io_backend_mode_t io_backend_mode,
                          const boost::optional<boost::optional<uint64_t> >
                             &total_cache_size,
                          const server_id_t *our_server_id,
@@ -736,7 +826,8 @@ void run_rethinkdb_serve(const base_path_t &base_path,
 
     logNTC("Loading data from directory %s\n", base_path.path().c_str());
 
-    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests);
+    io_backender_t io_backender(direct_io_mode, max_concurrent_io_requests,
+                                io_backend_mode);
 
     perfmon_collection_t metadata_perfmon_collection;
     perfmon_membership_t metadata_perfmon_membership(&get_global_perfmon_collection(), &metadata_perfmon_collection, "metadata");
@@ -810,6 +901,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
                              const std::set<name_string_t> &server_tag_names,
                              const file_direct_io_mode_t direct_io_mode,
                              const int max_concurrent_io_requests,
+                             const io_backend_mode_t io_backend_mode,
                              const boost::optional<boost::optional<uint64_t> >
                                 &total_cache_size,
                              const bool new_directory,
@@ -818,7 +910,8 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
                              bool *const result_out) {
     if (!new_directory) {
         run_rethinkdb_serve(base_path, serve_info, direct_io_mode,
-                            max_concurrent_io_requests, total_cache_size,
+                            max_concurrent_io_requests, io_backend_mode,
+                            total_cache_size,
                             NULL, NULL, data_directory_lock,
                             result_out);
     } else {
@@ -860,7 +953,7 @@ void run_rethinkdb_porcelain(const base_path_t &base_path,
         }
 
         run_rethinkdb_serve(base_path, serve_info, direct_io_mode,
-                            max_concurrent_io_requests,
+                            max_concurrent_io_requests, io_backend_mode,
                             boost::optional<boost::optional<uint64_t> >(),
                             &our_server_id, &cluster_metadata,
                             data_directory_lock, result_out);
@@ -904,6 +997,15 @@ options::help_section_t get_log_options(std::vector<options::option_t> *options_
                                             options::OPTIONAL_NO_PARAMETER));
     help.add("--no-update-check", "disable checking for available updates.  Also turns "
              "off anonymous usage data collection.");
+    options_out->push_back(options::option_t(options::names_t("--slow-query-threshold"),
+                                             options::OPTIONAL));
+    help.add("--slow-query-threshold ms", "log queries that take at least this many "
+             "milliseconds to answer, with the query and its duration");
+    options_out->push_back(options::option_t(options::names_t("--slow-query-profile-rate"),
+                                             options::OPTIONAL,
+                                             "0.01"));
+    help.add("--slow-query-profile-rate fraction", "the fraction of queries that are "
+             "profiled, so that the slow query log can include their profile");
     return help;
 }
 
@@ -919,6 +1021,10 @@ options::help_section_t get_file_options(std::vector<options::option_t> *options
                                              strprintf("%d", DEFAULT_MAX_CONCURRENT_IO_REQUESTS)));
     help.add("--io-threads n",
              "how many simultaneous I/O operations can happen at the same time");
+    options_out->push_back(options::option_t(options::names_t("--io-uring"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--io-uring", "submit disk I/O through io_uring where the kernel "
+             "supports it");
     options_out->push_back(options::option_t(options::names_t("--no-direct-io"),
                                              options::OPTIONAL_NO_PARAMETER));
     // `--no-direct-io` is deprecated (it's now the default). Not adding to help.
@@ -930,6 +1036,34 @@ options::help_section_t get_file_options(std::vector<options::option_t> *options
                                              options::OPTIONAL));
     help.add("--cache-size mb", "total cache size (in megabytes) for the process. Can "
         "be 'auto'.");
+    options_out->push_back(options::option_t(options::names_t("--cache-huge-pages"),
+                                             options::OPTIONAL));
+    help.add("--cache-huge-pages 2m|1g", "allocate cache memory from huge pages of "
+        "the given size");
+    options_out->push_back(options::option_t(options::names_t("--cache-compressed-tier"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--cache-compressed-tier", "keep pages evicted from the cache compressed "
+        "in memory, using up to a quarter of the cache size");
+    options_out->push_back(options::option_t(options::names_t("--cache-write-back-window"),
+                                             options::OPTIONAL));
+    help.add("--cache-write-back-window ms", "hold back writes with soft durability "
+        "for up to this many milliseconds, to combine writes to the same pages");
+    options_out->push_back(options::option_t(options::names_t("--primary-key-filter"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--primary-key-filter", "keep a Bloom filter of each table's primary keys "
+        "in memory, so that looking up a missing key doesn't read from disk");
+    options_out->push_back(options::option_t(options::names_t("--slow-tier-directory"),
+                                             options::OPTIONAL));
+    help.add("--slow-tier-directory path", "store the parts of new tables' data files "
+        "beyond the fast tier size in this directory, e.g. on a bigger, slower disk");
+    options_out->push_back(options::option_t(options::names_t("--fast-tier-size"),
+                                             options::OPTIONAL));
+    help.add("--fast-tier-size mb", "how many megabytes of each new table's data file "
+        "stay in the data directory when slow-tier-directory is given");
+    options_out->push_back(options::option_t(options::names_t("--ordered-writes"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--ordered-writes", "sync the data files once per metablock write instead "
+        "of twice, and detect metablocks whose data didn't reach the disk on startup");
     return help;
 }
 
@@ -1078,6 +1212,23 @@ options::help_section_t get_network_options(const bool join_required, std::vecto
                                              strprintf("%d", port_defaults::reql_port)));
     help.add("--driver-port port", "port for rethinkdb protocol client drivers");
 
+    options_out->push_back(options::option_t(options::names_t("--max-queries-per-connection"),
+                                             options::OPTIONAL,
+                                             strprintf("%d", DEFAULT_MAX_QUERIES_PER_CONNECTION)));
+    help.add("--max-queries-per-connection n", "how many queries one client driver connection may run at once");
+
+    options_out->push_back(options::option_t(options::names_t("--listen-on-all-threads"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--listen-on-all-threads", "accept client driver connections on every thread through SO_REUSEPORT sockets, and keep each connection on the thread that accepted it");
+
+    options_out->push_back(options::option_t(options::names_t("--query-memory-limit"),
+                                             options::OPTIONAL));
+    help.add("--query-memory-limit mb", "how many megabytes all queries together may hold in arrays, groups and sort buffers before they spill to disk or fail");
+
+    options_out->push_back(options::option_t(options::names_t("--query-result-cache-size"),
+                                             options::OPTIONAL));
+    help.add("--query-result-cache-size mb", "how many megabytes of responses to queries run with `result_cache=true` to keep (0 turns the cache off)");
+
     options_out->push_back(options::option_t(options::names_t("--port-offset", "-o"),
                                              options::OPTIONAL,
                                              strprintf("%d", port_defaults::port_offset)));
@@ -1095,15 +1246,178 @@ options::help_section_t get_network_options(const bool join_required, std::vecto
                                              options::OPTIONAL_REPEAT));
     help.add("--canonical-address addr", "address that other rethinkdb instances will use to connect to us, can be specified multiple times");
 
+    options_out->push_back(options::option_t(options::names_t("--compress-cluster-traffic"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--compress-cluster-traffic", "compress the messages that we send to other rethinkdb instances");
+
+    return help;
+}
+
+options::help_section_t get_tls_options(std::vector<options::option_t> *options_out) {
+    options::help_section_t help("TLS options");
+    options_out->push_back(options::option_t(options::names_t("--tls-cert"),
+                                             options::OPTIONAL));
+    help.add("--tls-cert file", "certificate chain (in PEM format) to present on the ports that use TLS");
+
+    options_out->push_back(options::option_t(options::names_t("--tls-key"),
+                                             options::OPTIONAL));
+    help.add("--tls-key file", "private key (in PEM format) for the certificate, if it isn't in the certificate file");
+
+    options_out->push_back(options::option_t(options::names_t("--tls-ca"),
+                                             options::OPTIONAL));
+    help.add("--tls-ca file", "if given, other rethinkdb instances must present a certificate signed by this certificate authority");
+
+    options_out->push_back(options::option_t(options::names_t("--driver-tls"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--driver-tls", "require TLS on the client driver port");
+
+    options_out->push_back(options::option_t(options::names_t("--cluster-tls"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--cluster-tls", "use TLS for connections to and from other rethinkdb instances; all of them must use this option");
+
+    options_out->push_back(options::option_t(options::names_t("--http-tls"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--http-tls", "serve the web administration console over HTTPS");
+
     return help;
 }
 
+MUST_USE bool parse_tls_options(const std::map<std::string, options::values_t> &opts) {
+    const bool driver_tls = exists_option(opts, "--driver-tls");
+    const bool cluster_tls = exists_option(opts, "--cluster-tls");
+    const bool http_tls = exists_option(opts, "--http-tls");
+    const std::string cert = get_optional_option(opts, "--tls-cert").get_value_or("");
+    const std::string key = get_optional_option(opts, "--tls-key").get_value_or(cert);
+    const std::string ca = get_optional_option(opts, "--tls-ca").get_value_or("");
+    if (!driver_tls && !cluster_tls && !http_tls) {
+        return true;
+    }
+    if (cert.empty()) {
+        fprintf(stderr, "ERROR: --tls-cert is required for --driver-tls, --cluster-tls "
+                "and --http-tls\n");
+        return false;
+    }
+
+    try {
+        if (driver_tls) {
+            set_tls_ctx(tls_service_t::DRIVER,
+                        new tls_ctx_t(tls_role_t::SERVER, cert, key, ""));
+        }
+        if (http_tls) {
+            set_tls_ctx(tls_service_t::HTTP,
+                        new tls_ctx_t(tls_role_t::SERVER, cert, key, ""));
+        }
+        if (cluster_tls) {
+            set_tls_ctx(tls_service_t::CLUSTER,
+                        new tls_ctx_t(tls_role_t::SERVER, cert, key, ca));
+            set_tls_ctx(tls_service_t::CLUSTER,
+                        new tls_ctx_t(tls_role_t::CLIENT, cert, key, ca));
+        }
+    } catch (const tls_config_exc_t &ex) {
+        fprintf(stderr, "ERROR: %s\n", ex.what());
+        return false;
+    }
+    return true;
+}
+
+MUST_USE bool parse_max_queries_per_connection_option(
+        const std::map<std::string, options::values_t> &opts) {
+    const int max_queries = get_single_int(opts, "--max-queries-per-connection");
+    if (max_queries <= 0 || max_queries > MAX_QUERIES_PER_CONNECTION) {
+        fprintf(stderr, "ERROR: max-queries-per-connection must be between 1 and %d\n",
+                MAX_QUERIES_PER_CONNECTION);
+        return false;
+    }
+    set_max_queries_per_connection(max_queries);
+    return true;
+}
+
+MUST_USE bool parse_query_memory_limit_option(
+        const std::map<std::string, options::values_t> &opts) {
+    const boost::optional<std::string> limit_opt =
+        get_optional_option(opts, "--query-memory-limit");
+    if (!limit_opt) {
+        return true;
+    }
+    uint64_t limit_mb;
+    if (!strtou64_strict(*limit_opt, 10, &limit_mb) || limit_mb == 0
+        || limit_mb > std::numeric_limits<uint64_t>::max() / MEGABYTE) {
+        fprintf(stderr, "ERROR: query-memory-limit must be a positive number of "
+                "megabytes\n");
+        return false;
+    }
+    ql::set_global_query_memory_limit(limit_mb * MEGABYTE);
+    return true;
+}
+
+MUST_USE bool parse_query_result_cache_size_option(
+        const std::map<std::string, options::values_t> &opts) {
+    const boost::optional<std::string> size_opt =
+        get_optional_option(opts, "--query-result-cache-size");
+    if (!size_opt) {
+        return true;
+    }
+    uint64_t size_mb;
+    if (!strtou64_strict(*size_opt, 10, &size_mb)
+        || size_mb > std::numeric_limits<uint64_t>::max() / MEGABYTE) {
+        fprintf(stderr, "ERROR: query-result-cache-size must be a number of "
+                "megabytes\n");
+        return false;
+    }
+    ql::set_query_result_cache_size(size_mb * MEGABYTE);
+    return true;
+}
+
+MUST_USE bool parse_slow_query_log_options(
+        const std::map<std::string, options::values_t> &opts) {
+    const boost::optional<std::string> threshold_opt =
+        get_optional_option(opts, "--slow-query-threshold");
+    if (!threshold_opt) {
+        return true;
+    }
+    uint64_t threshold_ms;
+    if (!strtou64_strict(*threshold_opt, 10, &threshold_ms) || threshold_ms == 0
+        || threshold_ms > 24 * 60 * 60 * THOUSAND) {
+        fprintf(stderr, "ERROR: slow-query-threshold must be a positive number of "
+                "milliseconds, and at most a day\n");
+        return false;
+    }
+    const std::string rate_opt = get_single_option(opts, "--slow-query-profile-rate");
+    char *end;
+    const double rate = strtod(rate_opt.c_str(), &end);
+    if (rate_opt.empty() || *end != '\0' || !(rate >= 0 && rate <= 1)) {
+        fprintf(stderr, "ERROR: slow-query-profile-rate must be between 0 and 1\n");
+        return false;
+    }
+    ql::set_slow_query_log(threshold_ms, rate);
+    return true;
+}
+
 options::help_section_t get_cpu_options(std::vector<options::option_t> *options_out) {
     options::help_section_t help("CPU options");
     options_out->push_back(options::option_t(options::names_t("--cores", "-c"),
                                              options::OPTIONAL,
                                              strprintf("%d", get_cpu_count())));
     help.add("-c [ --cores ] n", "the number of cores to use");
+    options_out->push_back(options::option_t(options::names_t("--numa"),
+                                             options::OPTIONAL_NO_PARAMETER));
+    help.add("--numa", "pin threads to cores grouped by NUMA node, and keep each "
+             "table's threads on a single node");
+    options_out->push_back(options::option_t(options::names_t("--max-extproc-workers"),
+                                             options::OPTIONAL));
+    help.add("--max-extproc-workers n", "the most worker processes to run r.js and "
+             "r.http queries in (defaults to the number of cores)");
+    options_out->push_back(options::option_t(options::names_t("--min-extproc-workers"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--min-extproc-workers n", "how many started worker processes to keep "
+             "around when they are idle");
+    options_out->push_back(options::option_t(options::names_t("--busy-poll"),
+                                             options::OPTIONAL,
+                                             "0"));
+    help.add("--busy-poll microseconds", "how long each thread spins looking for work "
+             "before it goes to sleep; lowers latency at the cost of CPU time on idle "
+             "threads (Linux only)");
     return help;
 }
 
@@ -1118,6 +1432,40 @@ MUST_USE bool parse_cores_option(const std::map<std::string, options::values_t>
     return true;
 }
 
+MUST_USE bool parse_busy_poll_option(const std::map<std::string, options::values_t> &opts) {
+    const int busy_poll = get_single_int(opts, "--busy-poll");
+    if (busy_poll < 0 || busy_poll > MILLION) {
+        fprintf(stderr, "ERROR: busy-poll must be between 0 and %lld microseconds\n",
+                MILLION);
+        return false;
+    }
+    set_event_loop_busy_poll(busy_poll);
+    return true;
+}
+
+// Sets the extproc pool's worker limits from `--min-extproc-workers` and
+// `--max-extproc-workers`; the latter defaults to `num_workers`.
+MUST_USE bool parse_extproc_workers_options(
+        const std::map<std::string, options::values_t> &opts, int num_workers) {
+    int max_workers = num_workers;
+    if (exists_option(opts, "--max-extproc-workers")) {
+        max_workers = get_single_int(opts, "--max-extproc-workers");
+    }
+    const int min_workers = get_single_int(opts, "--min-extproc-workers");
+    if (max_workers <= 0 || max_workers > MAX_EXTPROC_WORKERS) {
+        fprintf(stderr, "ERROR: max-extproc-workers must be between 1 and %d\n",
+                MAX_EXTPROC_WORKERS);
+        return false;
+    }
+    if (min_workers < 0 || min_workers > max_workers) {
+        fprintf(stderr, "ERROR: min-extproc-workers must be between 0 and "
+                "max-extproc-workers (%d)\n", max_workers);
+        return false;
+    }
+    set_extproc_worker_limits(min_workers, max_workers);
+    return true;
+}
+
 options::help_section_t get_service_options(std::vector<options::option_t> *options_out) {
     options::help_section_t help("Service options");
     options_out->push_back(options::option_t(options::names_t("--pid-file"),
@@ -1167,6 +1515,7 @@ void get_rethinkdb_serve_options(std::vector<options::help_section_t> *help_out,
     help_out->push_back(get_file_options(options_out));
     help_out->push_back(get_network_options(false, options_out));
     help_out->push_back(get_web_options(options_out));
+    help_out->push_back(get_tls_options(options_out));
     help_out->push_back(get_cpu_options(options_out));
     help_out->push_back(get_service_options(options_out));
     help_out->push_back(get_setuser_options(options_out));
@@ -1179,6 +1528,7 @@ void get_rethinkdb_proxy_options(std::vector<options::help_section_t> *help_out,
                                  std::vector<options::option_t> *options_out) {
     help_out->push_back(get_network_options(true, options_out));
     help_out->push_back(get_web_options(options_out));
+    help_out->push_back(get_tls_options(options_out));
     help_out->push_back(get_service_options(options_out));
     help_out->push_back(get_setuser_options(options_out));
     help_out->push_back(get_help_options(options_out));
@@ -1192,6 +1542,7 @@ void get_rethinkdb_porcelain_options(std::vector<options::help_section_t> *help_
     help_out->push_back(get_server_options(options_out));
     help_out->push_back(get_network_options(false, options_out));
     help_out->push_back(get_web_options(options_out));
+    help_out->push_back(get_tls_options(options_out));
     help_out->push_back(get_cpu_options(options_out));
     help_out->push_back(get_service_options(options_out));
     help_out->push_back(get_setuser_options(options_out));
@@ -1283,6 +1634,12 @@ file_direct_io_mode_t parse_direct_io_mode_option(const std::map<std::string, op
         file_direct_io_mode_t::buffered_desired;
 }
 
+io_backend_mode_t parse_io_backend_mode_option(const std::map<std::string, options::values_t> &opts) {
+    return exists_option(opts, "--io-uring") ?
+        io_backend_mode_t::io_uring_desired :
+        io_backend_mode_t::pool;
+}
+
 int main_rethinkdb_create(int argc, char *argv[]) {
     std::vector<options::option_t> options;
     std::vector<options::help_section_t> help;
@@ -1306,6 +1663,11 @@ int main_rethinkdb_create(int argc, char *argv[]) {
                 parse_total_cache_size_option(opts)) {
             total_cache_size = *x;
         }
+        const size_t huge_page_size = parse_cache_huge_pages_option(opts);
+        const int64_t write_back_window_ms = parse_cache_write_back_window_option(opts);
+        int64_t fast_tier_size;
+        const std::string slow_tier_directory =
+            parse_slow_tier_options(opts, &fast_tier_size);
 
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
@@ -1329,6 +1691,18 @@ int main_rethinkdb_create(int argc, char *argv[]) {
         recreate_temporary_directory(base_path);
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
+        const io_backend_mode_t io_backend_mode = parse_io_backend_mode_option(opts);
+
+        if (huge_page_size != 0) {
+            enable_block_slabs(huge_page_size);
+        }
+        if (exists_option(opts, "--cache-compressed-tier")) {
+            alt::enable_compressed_page_tier();
+        }
+        alt::set_write_back_window_ms(write_back_window_ms);
+        set_key_filters_enabled(exists_option(opts, "--primary-key-filter"));
+        set_slow_tier_storage(slow_tier_directory, fast_tier_size);
+        set_ordered_serializer_writes(exists_option(opts, "--ordered-writes"));
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_create, base_path,
@@ -1337,6 +1711,7 @@ int main_rethinkdb_create(int argc, char *argv[]) {
                                      total_cache_size,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend_mode,
                                      &result),
                            num_workers);
 
@@ -1415,6 +1790,27 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
 
         service_address_ports_t address_ports = get_service_address_ports(opts);
 
+        if (!parse_max_queries_per_connection_option(opts)) {
+            return EXIT_FAILURE;
+        }
+        set_listen_on_all_threads(exists_option(opts, "--listen-on-all-threads"));
+
+        if (!parse_tls_options(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_query_memory_limit_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_query_result_cache_size_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_slow_query_log_options(opts)) {
+            return EXIT_FAILURE;
+        }
+
         std::string web_path = get_web_path(opts);
 
         int num_workers;
@@ -1422,6 +1818,14 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        if (!parse_busy_poll_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_extproc_workers_options(opts, num_workers)) {
+            return EXIT_FAILURE;
+        }
+
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
             return EXIT_FAILURE;
@@ -1431,6 +1835,11 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
 
         boost::optional<boost::optional<uint64_t> > total_cache_size =
             parse_total_cache_size_option(opts);
+        const size_t huge_page_size = parse_cache_huge_pages_option(opts);
+        const int64_t write_back_window_ms = parse_cache_write_back_window_option(opts);
+        int64_t fast_tier_size;
+        const std::string slow_tier_directory =
+            parse_slow_tier_options(opts, &fast_tier_size);
 
         // Open and lock the directory, but do not create it
         bool is_new_directory = false;
@@ -1466,6 +1875,18 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
                                 std::vector<std::string>(argv, argv + argc));
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
+        const io_backend_mode_t io_backend_mode = parse_io_backend_mode_option(opts);
+
+        if (huge_page_size != 0) {
+            enable_block_slabs(huge_page_size);
+        }
+        if (exists_option(opts, "--cache-compressed-tier")) {
+            alt::enable_compressed_page_tier();
+        }
+        alt::set_write_back_window_ms(write_back_window_ms);
+        set_key_filters_enabled(exists_option(opts, "--primary-key-filter"));
+        set_slow_tier_storage(slow_tier_directory, fast_tier_size);
+        set_ordered_serializer_writes(exists_option(opts, "--ordered-writes"));
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_serve,
@@ -1473,12 +1894,14 @@ int main_rethinkdb_serve(int argc, char *argv[]) {
                                      &serve_info,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend_mode,
                                      total_cache_size,
                                      static_cast<server_id_t*>(NULL),
                                      static_cast<cluster_semilattice_metadata_t*>(NULL),
                                      &data_directory_lock,
                                      &result),
-                           num_workers);
+                           num_workers,
+                           exists_option(opts, "--numa"));
         return result ? EXIT_SUCCESS : EXIT_FAILURE;
     } catch (const options::named_error_t &ex) {
         output_named_error(ex, help);
@@ -1510,6 +1933,27 @@ int main_rethinkdb_proxy(int argc, char *argv[]) {
 
         service_address_ports_t address_ports = get_service_address_ports(opts);
 
+        if (!parse_max_queries_per_connection_option(opts)) {
+            return EXIT_FAILURE;
+        }
+        set_listen_on_all_threads(exists_option(opts, "--listen-on-all-threads"));
+
+        if (!parse_tls_options(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_query_memory_limit_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_query_result_cache_size_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_slow_query_log_options(opts)) {
+            return EXIT_FAILURE;
+        }
+
         if (joins.empty()) {
             fprintf(stderr, "No --join option(s) given. A proxy needs to connect to something!\n"
                     "Run 'rethinkdb help proxy' for more information.\n");
@@ -1645,6 +2089,27 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
 
         const service_address_ports_t address_ports = get_service_address_ports(opts);
 
+        if (!parse_max_queries_per_connection_option(opts)) {
+            return EXIT_FAILURE;
+        }
+        set_listen_on_all_threads(exists_option(opts, "--listen-on-all-threads"));
+
+        if (!parse_tls_options(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_query_memory_limit_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_query_result_cache_size_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_slow_query_log_options(opts)) {
+            return EXIT_FAILURE;
+        }
+
         std::string web_path = get_web_path(opts);
 
         int num_workers;
@@ -1652,6 +2117,14 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
+        if (!parse_busy_poll_option(opts)) {
+            return EXIT_FAILURE;
+        }
+
+        if (!parse_extproc_workers_options(opts, num_workers)) {
+            return EXIT_FAILURE;
+        }
+
         int max_concurrent_io_requests;
         if (!parse_io_threads_option(opts, &max_concurrent_io_requests)) {
             return EXIT_FAILURE;
@@ -1688,6 +2161,11 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
 
         boost::optional<boost::optional<uint64_t> > total_cache_size =
             parse_total_cache_size_option(opts);
+        const size_t huge_page_size = parse_cache_huge_pages_option(opts);
+        const int64_t write_back_window_ms = parse_cache_write_back_window_option(opts);
+        int64_t fast_tier_size;
+        const std::string slow_tier_directory =
+            parse_slow_tier_options(opts, &fast_tier_size);
 
         if (check_pid_file(opts) != EXIT_SUCCESS) {
             return EXIT_FAILURE;
@@ -1716,6 +2194,18 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
                                 std::vector<std::string>(argv, argv + argc));
 
         const file_direct_io_mode_t direct_io_mode = parse_direct_io_mode_option(opts);
+        const io_backend_mode_t io_backend_mode = parse_io_backend_mode_option(opts);
+
+        if (huge_page_size != 0) {
+            enable_block_slabs(huge_page_size);
+        }
+        if (exists_option(opts, "--cache-compressed-tier")) {
+            alt::enable_compressed_page_tier();
+        }
+        alt::set_write_back_window_ms(write_back_window_ms);
+        set_key_filters_enabled(exists_option(opts, "--primary-key-filter"));
+        set_slow_tier_storage(slow_tier_directory, fast_tier_size);
+        set_ordered_serializer_writes(exists_option(opts, "--ordered-writes"));
 
         bool result;
         run_in_thread_pool(std::bind(&run_rethinkdb_porcelain,
@@ -1724,12 +2214,14 @@ int main_rethinkdb_porcelain(int argc, char *argv[]) {
                                      server_tag_names,
                                      direct_io_mode,
                                      max_concurrent_io_requests,
+                                     io_backend_mode,
                                      total_cache_size,
                                      is_new_directory,
                                      &serve_info,
                                      &data_directory_lock,
                                      &result),
-                           num_workers);
+                           num_workers,
+                           exists_option(opts, "--numa"));
 
         return result ? EXIT_SUCCESS : EXIT_FAILURE;
     } catch (const options::named_error_t &ex) {
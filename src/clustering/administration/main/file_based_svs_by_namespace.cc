@@ -4,6 +4,9 @@
 #include "errors.hpp"
 #include <boost/bind.hpp>
 
+#include "arch/runtime/runtime.hpp"
+#include "buffer_cache/alt.hpp"
+#include "buffer_cache/cache_balancer.hpp"
 #include "clustering/immediate_consistency/branch/multistore.hpp"
 #include "clustering/reactor/reactor.hpp"
 #include "logger.hpp"
@@ -13,6 +16,21 @@
 #include "serializer/merger.hpp"
 #include "utils.hpp"
 
+static std::string slow_tier_directory;
+static int64_t fast_tier_size = 0;
+
+void set_slow_tier_storage(const std::string &directory, int64_t _fast_tier_size) {
+    guarantee(directory.empty() || _fast_tier_size > 0);
+    slow_tier_directory = directory;
+    fast_tier_size = _fast_tier_size;
+}
+
+static bool ordered_serializer_writes = false;
+
+void set_ordered_serializer_writes(bool enabled) {
+    ordered_serializer_writes = enabled;
+}
+
 /* This object serves mostly as a container for arguments to the
  * do_construct_existing_store function because we hit the boost::bind argument
  * limit. */
@@ -45,6 +63,14 @@ std::string hash_shard_perfmon_name(int hash_shard_number) {
     return strprintf("shard_%d", hash_shard_number);
 }
 
+serializer_filepath_t warmup_snapshot_file_name(const base_path_t &base_path,
+                                                namespace_id_t namespace_id,
+                                                int hash_shard_number) {
+    return serializer_filepath_t(
+        base_path,
+        strprintf("%s.warmup_%d", uuid_to_str(namespace_id).c_str(), hash_shard_number));
+}
+
 void do_construct_store(
     const std::vector<threadnum_t> &threads,
     int thread_offset,
@@ -71,6 +97,9 @@ void do_construct_store(
         create, store_args.serializers_perfmon_collection,
         store_args.ctx, store_args.io_backender, store_args.base_path,
         std::move(index_report), store_args.ns_id);
+    store->cache->enable_warmup_snapshots(
+        warmup_snapshot_file_name(store_args.base_path, store_args.ns_id,
+                                  thread_offset).permanent_path());
     (*stores_out_stores)[thread_offset].init(store);
     store_views[thread_offset] = store;
 }
@@ -103,6 +132,9 @@ void
 file_based_svs_by_namespace_t::get_svs(
             perfmon_collection_t *serializers_perfmon_collection,
             namespace_id_t namespace_id,
+            uint64_t block_size,
+            int cpu_shards,
+            bool compress_blocks,
             stores_lifetimer_t *stores_out,
             scoped_ptr_t<multistore_ptr_t> *svs_out,
             rdb_context_t *ctx) {
@@ -118,15 +150,21 @@ file_based_svs_by_namespace_t::get_svs(
     // TODO: We should use N slices on M serializers, not N slices
     // on N serializers.
 
-    const int num_stores = CPU_SHARDING_FACTOR;
+    guarantee(cpu_shards >= 1 && cpu_shards <= MAX_CPU_SHARDING_FACTOR);
+    int num_stores = cpu_shards;
     scoped_array_t<scoped_ptr_t<store_t> > *stores_out_stores
         = stores_out->stores();
-    stores_out_stores->init(num_stores);
 
-    const threadnum_t serializer_thread = next_thread(num_db_threads);
+    // Keep the table's serializer and its stores on one NUMA node, so that the
+    // cache pages they allocate stay local to the threads that touch them.
+    // Tables are spread over the nodes round-robin.
+    const int numa_node = numa_node_counter_;
+    numa_node_counter_ = (numa_node_counter_ + 1) % get_num_numa_nodes();
+
+    const threadnum_t serializer_thread = next_thread(num_db_threads, numa_node);
     std::vector<threadnum_t> store_threads;
     for (int i = 0; i < num_stores; ++i) {
-        store_threads.push_back(next_thread(num_db_threads));
+        store_threads.push_back(next_thread(num_db_threads, numa_node));
     }
 
     scoped_ptr_t<serializer_t> serializer;
@@ -134,7 +172,7 @@ file_based_svs_by_namespace_t::get_svs(
     scoped_ptr_t<multistore_ptr_t> mptr;
     {
         on_thread_t th(serializer_thread);
-        scoped_array_t<store_view_t *> store_views(num_stores);
+        scoped_array_t<store_view_t *> store_views;
 
         const serializer_filepath_t serializer_filepath = file_name_for(namespace_id);
         int res = access(serializer_filepath.permanent_path().c_str(), R_OK | W_OK);
@@ -142,7 +180,21 @@ file_based_svs_by_namespace_t::get_svs(
                                 namespace_id, balancer_,
                                 serializers_perfmon_collection, ctx,
                                 &outdated_index_tracker, namespace_id);
-        filepath_file_opener_t file_opener(serializer_filepath, io_backender_);
+        // New data files get a slow tier if there is one; existing ones have one if
+        // they were created with it.
+        const std::string slow_tier_path = slow_tier_file_name_for(namespace_id);
+        scoped_ptr_t<filepath_file_opener_t> file_opener;
+        if (!slow_tier_path.empty()
+            && (res != 0 || access(slow_tier_path.c_str(), F_OK) == 0)) {
+            file_opener.init(new filepath_file_opener_t(
+                serializer_filepath, slow_tier_path, fast_tier_size, io_backender_));
+        } else {
+            file_opener.init(
+                new filepath_file_opener_t(serializer_filepath, io_backender_));
+        }
+        standard_serializer_t::dynamic_config_t dynamic_config;
+        dynamic_config.compress_blocks = compress_blocks;
+        dynamic_config.ordered_writes = ordered_serializer_writes;
         if (res == 0) {
             // TODO: Could we handle failure when loading the serializer?  Right
             // now, we don't.
@@ -150,11 +202,14 @@ file_based_svs_by_namespace_t::get_svs(
             {
                 scoped_ptr_t<serializer_t> ser
                     = make_scoped<standard_serializer_t>(
-                        standard_serializer_t::dynamic_config_t(),
-                        &file_opener,
+                        dynamic_config,
+                        file_opener.get(),
                         serializers_perfmon_collection);
-                ser = make_scoped<merger_serializer_t>(std::move(ser),
-                                                       MERGER_SERIALIZER_MAX_ACTIVE_WRITES);
+                ser = make_scoped<merger_serializer_t>(
+                    std::move(ser),
+                    MERGER_SERIALIZER_MAX_ACTIVE_WRITES,
+                    MERGER_SERIALIZER_MAX_COMMIT_DELAY_USECS,
+                    serializers_perfmon_collection);
                 serializer = std::move(ser);
             }
 
@@ -162,6 +217,20 @@ file_based_svs_by_namespace_t::get_svs(
             ptrs.push_back(serializer.get());
             multiplexer.init(new serializer_multiplexer_t(ptrs));
 
+            // The file keeps the number of CPU shards that it was created with.  That's
+            // always the table's `cpu_shards`, since that can't change.
+            if (static_cast<int>(multiplexer->proxies.size()) != num_stores) {
+                logWRN("The data file for table %s has %zu CPU shards, but the table "
+                       "is configured with %d.", uuid_to_str(namespace_id).c_str(),
+                       multiplexer->proxies.size(), num_stores);
+                num_stores = multiplexer->proxies.size();
+                for (int i = store_threads.size(); i < num_stores; ++i) {
+                    store_threads.push_back(store_threads[i % cpu_shards]);
+                }
+            }
+            stores_out_stores->init(num_stores);
+            store_views.init(num_stores);
+
             // TODO: Exceptions?  Can exceptions happen, and then
             // store_views' values would leak.  That is, are we handling
             // them in the pmap?  No.
@@ -171,16 +240,20 @@ file_based_svs_by_namespace_t::get_svs(
                                          stores_out_stores, store_views.data()));
             mptr.init(new multistore_ptr_t(store_views.data(), num_stores));
         } else {
-            standard_serializer_t::create(&file_opener,
-                                          standard_serializer_t::static_config_t());
+            standard_serializer_t::static_config_t static_config;
+            static_config.block_size_ = block_size;
+            standard_serializer_t::create(file_opener.get(), static_config);
             {
                 scoped_ptr_t<serializer_t> ser
                     = make_scoped<standard_serializer_t>(
-                        standard_serializer_t::dynamic_config_t(),
-                        &file_opener,
+                        dynamic_config,
+                        file_opener.get(),
                         serializers_perfmon_collection);
-                ser = make_scoped<merger_serializer_t>(std::move(ser),
-                                                       MERGER_SERIALIZER_MAX_ACTIVE_WRITES);
+                ser = make_scoped<merger_serializer_t>(
+                    std::move(ser),
+                    MERGER_SERIALIZER_MAX_ACTIVE_WRITES,
+                    MERGER_SERIALIZER_MAX_COMMIT_DELAY_USECS,
+                    serializers_perfmon_collection);
                 serializer = std::move(ser);
             }
 
@@ -188,6 +261,8 @@ file_based_svs_by_namespace_t::get_svs(
             ptrs.push_back(serializer.get());
             serializer_multiplexer_t::create(ptrs, num_stores);
             multiplexer.init(new serializer_multiplexer_t(ptrs));
+            stores_out_stores->init(num_stores);
+            store_views.init(num_stores);
 
             // TODO: How do we specify what the stores' regions are?
             // TODO: Exceptions?  Can exceptions happen, and then store_views'
@@ -215,7 +290,7 @@ file_based_svs_by_namespace_t::get_svs(
                 &dummy_interruptor);
 
             // Finally, the store is created.
-            file_opener.move_serializer_file_to_permanent_location();
+            file_opener->move_serializer_file_to_permanent_location();
         }
     } // back on calling thread
 
@@ -225,6 +300,11 @@ file_based_svs_by_namespace_t::get_svs(
 }
 
 void file_based_svs_by_namespace_t::destroy_svs(namespace_id_t namespace_id) {
+    {
+        on_thread_t th(balancer_->home_thread());
+        balancer_->remove_quota(namespace_id);
+    }
+
     // TODO: Handle errors?  It seems like we can't really handle the error so
     // let's just ignore it?
     const std::string filepath = file_name_for(namespace_id).permanent_path();
@@ -232,13 +312,58 @@ void file_based_svs_by_namespace_t::destroy_svs(namespace_id_t namespace_id) {
     const int res = ::unlink(filepath.c_str());
     guarantee_err(res == 0 || get_errno() == ENOENT,
                   "unlink failed for file %s", filepath.c_str());
+
+    const std::string slow_tier_path = slow_tier_file_name_for(namespace_id);
+    if (!slow_tier_path.empty()) {
+        const int slow_res = ::unlink(slow_tier_path.c_str());
+        guarantee_err(slow_res == 0 || get_errno() == ENOENT,
+                      "unlink failed for file %s", slow_tier_path.c_str());
+    }
+
+    // The warmup snapshots are only hints, so we don't care if this fails.  We don't
+    // know how many CPU shards the table had, so we try all the names it could've used.
+    for (int i = 0; i < MAX_CPU_SHARDING_FACTOR; ++i) {
+        const std::string warmup_path
+            = warmup_snapshot_file_name(base_path_, namespace_id, i).permanent_path();
+        UNUSED int warmup_res = ::unlink(warmup_path.c_str());
+    }
+}
+
+void file_based_svs_by_namespace_t::set_cache_config(
+        namespace_id_t namespace_id,
+        const table_cache_config_t &config) {
+    cache_quota_t quota;
+    quota.weight = config.weight;
+    quota.min_bytes = config.min_bytes;
+    if (static_cast<bool>(config.max_bytes)) {
+        quota.max_bytes = *config.max_bytes;
+    }
+
+    on_thread_t th(balancer_->home_thread());
+    balancer_->set_quota(namespace_id, quota);
 }
 
 serializer_filepath_t file_based_svs_by_namespace_t::file_name_for(namespace_id_t namespace_id) {
     return serializer_filepath_t(base_path_, uuid_to_str(namespace_id));
 }
 
-threadnum_t file_based_svs_by_namespace_t::next_thread(int num_db_threads) {
+std::string file_based_svs_by_namespace_t::slow_tier_file_name_for(
+        namespace_id_t namespace_id) {
+    if (slow_tier_directory.empty()) {
+        return std::string();
+    }
+    return slow_tier_directory + "/" + uuid_to_str(namespace_id);
+}
+
+threadnum_t file_based_svs_by_namespace_t::next_thread(int num_db_threads,
+                                                       int numa_node) {
+    for (int i = 0; i < num_db_threads; ++i) {
+        thread_counter_ = (thread_counter_ + 1) % num_db_threads;
+        if (get_thread_numa_node(threadnum_t(thread_counter_)) == numa_node) {
+            return threadnum_t(thread_counter_);
+        }
+    }
+    // None of the db threads are on that node; any thread will do.
     thread_counter_ = (thread_counter_ + 1) % num_db_threads;
     return threadnum_t(thread_counter_);
 }
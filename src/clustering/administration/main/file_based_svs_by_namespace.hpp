@@ -10,6 +10,16 @@
 class cache_balancer_t;
 class rdb_context_t;
 
+/* Tables' data files are only split over two devices if `--slow-tier-directory` is
+given.  The first `fast_tier_size` bytes of a new table's data file then stay in the
+data directory, and the rest goes to a file with the same name in `directory`.  See
+`tiered_file_t`.  Existing tables keep the layout they were created with. */
+void set_slow_tier_storage(const std::string &directory, int64_t fast_tier_size);
+
+/* Tables' serializers only use ordered writes (see
+`log_serializer_dynamic_config_t::ordered_writes`) if `--ordered-writes` is given. */
+void set_ordered_serializer_writes(bool enabled);
+
 class file_based_svs_by_namespace_t : public svs_by_namespace_t {
 public:
     file_based_svs_by_namespace_t(io_backender_t *io_backender,
@@ -17,26 +27,36 @@ public:
                                   const base_path_t& base_path,
                                   local_issue_aggregator_t *local_issue_aggregator)
         : io_backender_(io_backender), balancer_(balancer),
-          base_path_(base_path), thread_counter_(0),
+          base_path_(base_path), thread_counter_(0), numa_node_counter_(0),
           outdated_index_tracker(local_issue_aggregator) { }
 
     void get_svs(perfmon_collection_t *serializers_perfmon_collection,
                  namespace_id_t namespace_id,
+                 uint64_t block_size,
+                 int cpu_shards,
+                 bool compress_blocks,
                  stores_lifetimer_t *stores_out,
                  scoped_ptr_t<multistore_ptr_t> *svs_out,
                  rdb_context_t *);
 
     void destroy_svs(namespace_id_t namespace_id);
 
+    void set_cache_config(namespace_id_t namespace_id,
+                          const table_cache_config_t &config);
+
     serializer_filepath_t file_name_for(namespace_id_t namespace_id);
+    // Returns an empty string if there's no slow storage tier.
+    std::string slow_tier_file_name_for(namespace_id_t namespace_id);
 
 private:
     io_backender_t *io_backender_;
     cache_balancer_t *balancer_;
     const base_path_t base_path_;
 
-    threadnum_t next_thread(int num_db_threads);
+    // Returns the next thread (round-robin) that is on the given NUMA node.
+    threadnum_t next_thread(int num_db_threads, int numa_node);
     int thread_counter_; // should only be used by `next_thread`
+    int numa_node_counter_;
 
     outdated_index_issue_tracker_t outdated_index_tracker;
 
@@ -91,7 +91,9 @@ bool do_serve(io_backender_t *io_backender,
     // Do this here so we don't block on popen while pretending to serve.
     std::string uname = run_uname("ms");
     try {
-        extproc_pool_t extproc_pool(get_num_threads());
+        extproc_pool_t extproc_pool(get_extproc_max_workers(),
+                                    get_extproc_min_workers(),
+                                    &get_global_perfmon_collection());
 
         local_issue_aggregator_t local_issue_aggregator;
 
@@ -222,7 +224,8 @@ bool do_serve(io_backender_t *io_backender,
                 serve_info.ports.local_addresses,
                 serve_info.ports.canonical_addresses,
                 serve_info.ports.port,
-                serve_info.ports.client_port));
+                serve_info.ports.client_port,
+                serve_info.ports.compress_cluster_traffic));
         } catch (const address_in_use_exc_t &ex) {
             throw address_in_use_exc_t(strprintf("Could not bind to cluster port: %s", ex.what()));
         }
@@ -275,7 +278,9 @@ bool do_serve(io_backender_t *io_backender,
                               NULL,   /* we'll fill this in later */
                               semilattice_manager_auth.get_root_view(),
                               &get_global_perfmon_collection(),
-                              serve_info.reql_http_proxy);
+                              serve_info.reql_http_proxy,
+                              io_backender,
+                              base_path);
         jobs_manager.set_rdb_context(&rdb_ctx);
 
         real_reql_cluster_interface_t real_reql_cluster_interface(
@@ -46,7 +46,8 @@ struct service_address_ports_t {
         client_port(0),
         http_port(0),
         reql_port(0),
-        port_offset(0) { }
+        port_offset(0),
+        compress_cluster_traffic(false) { }
 
     service_address_ports_t(const std::set<ip_address_t> &_local_addresses,
                             const peer_address_t &_canonical_addresses,
@@ -55,7 +56,8 @@ struct service_address_ports_t {
                             bool _http_admin_is_disabled,
                             int _http_port,
                             int _reql_port,
-                            int _port_offset) :
+                            int _port_offset,
+                            bool _compress_cluster_traffic) :
         local_addresses(_local_addresses),
         canonical_addresses(_canonical_addresses),
         port(_port),
@@ -63,7 +65,8 @@ struct service_address_ports_t {
         http_admin_is_disabled(_http_admin_is_disabled),
         http_port(_http_port),
         reql_port(_reql_port),
-        port_offset(_port_offset)
+        port_offset(_port_offset),
+        compress_cluster_traffic(_compress_cluster_traffic)
     {
             sanitize_port(port, "port", port_offset);
             sanitize_port(client_port, "client_port", port_offset);
@@ -83,6 +86,7 @@ struct service_address_ports_t {
     int http_port;
     int reql_port;
     int port_offset;
+    bool compress_cluster_traffic;
 };
 
 peer_address_set_t look_up_peers_addresses(const std::vector<host_and_port_t> &names);
@@ -52,6 +52,7 @@ void version_checker_t::do_check(bool is_initial, auto_drainer_t::lock_t keepali
                   ql::return_empty_normal_batches_t::NO,
                   keepalive.get_drain_signal(),
                   std::map<std::string, ql::wire_func_t>(),
+                  nullptr,
                   nullptr);
     http_opts_t opts;
     opts.limits = env.limits();
@@ -8,6 +8,8 @@
 #include "containers/archive/stl_types.hpp"
 #include "containers/archive/versioned.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rpc/semilattice/delta.hpp"
+#include "rpc/semilattice/joins/map.hpp"
 #include "stl_utils.hpp"
 
 RDB_IMPL_SERIALIZABLE_3_SINCE_v1_16(server_semilattice_metadata_t,
@@ -33,6 +35,21 @@ RDB_IMPL_SEMILATTICE_JOINABLE_3(cluster_semilattice_metadata_t,
 RDB_IMPL_EQUALITY_COMPARABLE_3(cluster_semilattice_metadata_t,
                                rdb_namespaces, servers, databases);
 
+cluster_semilattice_metadata_t semilattice_delta(
+        const cluster_semilattice_metadata_t &before,
+        const cluster_semilattice_metadata_t &after) {
+    cluster_semilattice_metadata_t delta;
+    namespaces_semilattice_metadata_t namespaces;
+    namespaces.namespaces = semilattice_delta(
+        before.rdb_namespaces->namespaces, after.rdb_namespaces->namespaces);
+    delta.rdb_namespaces.set(namespaces);
+    delta.servers.servers =
+        semilattice_delta(before.servers.servers, after.servers.servers);
+    delta.databases.databases =
+        semilattice_delta(before.databases.databases, after.databases.databases);
+    return delta;
+}
+
 RDB_IMPL_SERIALIZABLE_1_SINCE_v1_13(auth_semilattice_metadata_t, auth_key);
 RDB_IMPL_SEMILATTICE_JOINABLE_1(auth_semilattice_metadata_t, auth_key);
 RDB_IMPL_EQUALITY_COMPARABLE_1(auth_semilattice_metadata_t, auth_key);
@@ -36,6 +36,12 @@ RDB_DECLARE_SERIALIZABLE(cluster_semilattice_metadata_t);
 RDB_DECLARE_SEMILATTICE_JOINABLE(cluster_semilattice_metadata_t);
 RDB_DECLARE_EQUALITY_COMPARABLE(cluster_semilattice_metadata_t);
 
+/* Only the tables, servers and databases that changed; see `semilattice_delta()` in
+`rpc/semilattice/delta.hpp`. */
+cluster_semilattice_metadata_t semilattice_delta(
+        const cluster_semilattice_metadata_t &before,
+        const cluster_semilattice_metadata_t &after);
+
 class auth_semilattice_metadata_t {
 public:
     auth_semilattice_metadata_t() { }
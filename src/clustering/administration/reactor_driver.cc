@@ -248,6 +248,7 @@ public:
                             reactor_driver_t *parent,
                             namespace_id_t namespace_id,
                             const blueprint_t &blueprint,
+                            const std::string &_primary_key,
                             const table_replication_info_t &repli_info,
                             const servers_semilattice_metadata_t &server_md,
                             svs_by_namespace_t *svs_by_namespace,
@@ -259,11 +260,22 @@ public:
         parent_(parent),
         namespace_id_(namespace_id),
         svs_by_namespace_(svs_by_namespace),
+        primary_key(_primary_key),
         write_ack_config_var(write_ack_config_checker_t(repli_info.config, server_md)),
         write_durability_var(repli_info.config.durability),
+        write_limits_var(repli_info.config.write_limits),
+        expiry_var(repli_info.config.expiry),
         write_ack_config_cross_threader(write_ack_config_var.get_watchable()),
-        write_durability_cross_threader(write_durability_var.get_watchable())
+        write_durability_cross_threader(write_durability_var.get_watchable()),
+        write_limits_cross_threader(write_limits_var.get_watchable()),
+        expiry_cross_threader(expiry_var.get_watchable()),
+        last_repli_info(repli_info),
+        cache_config(repli_info.config.cache),
+        block_size(repli_info.config.block_size),
+        cpu_shards(repli_info.config.cpu_shards),
+        compress_blocks(repli_info.config.compress_blocks)
     {
+        svs_by_namespace_->set_cache_config(namespace_id_, cache_config);
         coro_t::spawn_sometime(boost::bind(&watchable_and_reactor_t::initialize_reactor, this, io_backender));
     }
 
@@ -296,9 +308,23 @@ public:
                            const table_replication_info_t &repli_info,
                            const servers_semilattice_metadata_t &server_md) {
         watchable.set_value(blueprint);
+        last_repli_info = repli_info;
         write_ack_config_var.set_value_no_equals(
             write_ack_config_checker_t(repli_info.config, server_md));
         write_durability_var.set_value(repli_info.config.durability);
+        write_limits_var.set_value_no_equals(repli_info.config.write_limits);
+        expiry_var.set_value_no_equals(repli_info.config.expiry);
+        block_size = repli_info.config.block_size;
+        cpu_shards = repli_info.config.cpu_shards;
+        compress_blocks = repli_info.config.compress_blocks;
+        if (!(repli_info.config.cache == cache_config)) {
+            cache_config = repli_info.config.cache;
+            svs_by_namespace_->set_cache_config(namespace_id_, cache_config);
+        }
+    }
+
+    const table_replication_info_t &get_repli_info() const {
+        return last_repli_info;
     }
 
     bool is_acceptable_ack_set(const std::set<server_id_t> &acks) const {
@@ -314,6 +340,29 @@ public:
         return write_durability_cross_threader.get_watchable()->get();
     }
 
+    uint64_t get_max_writes_per_sec() const {
+        return write_limits_cross_threader.get_watchable()->get()
+            .writes_per_sec.get_value_or(0);
+    }
+
+    uint64_t get_max_pending_writes() const {
+        return write_limits_cross_threader.get_watchable()->get()
+            .max_pending_writes.get_value_or(0);
+    }
+
+    std::string get_expiry_index() const {
+        return expiry_cross_threader.get_watchable()->get()
+            .index.get_value_or(std::string());
+    }
+
+    uint64_t get_expiry_deletes_per_sec() const {
+        return expiry_cross_threader.get_watchable()->get().deletes_per_sec;
+    }
+
+    std::string get_primary_key() const {
+        return primary_key;
+    }
+
     bool is_gc_active() const {
         return stores_lifetimer_.is_gc_active();
     }
@@ -345,7 +394,9 @@ private:
         perfmon_collection_t *serializers_collection = &perfmon_collections->serializers_collection;
 
         // TODO: We probably shouldn't have to pass in this perfmon collection.
-        svs_by_namespace_->get_svs(serializers_collection, namespace_id_, &stores_lifetimer_, &svs_, ctx);
+        svs_by_namespace_->get_svs(serializers_collection, namespace_id_, block_size,
+                                   cpu_shards, compress_blocks,
+                                   &stores_lifetimer_, &svs_, ctx);
 
         reactor_.init(new reactor_t(
             base_path,
@@ -382,13 +433,27 @@ private:
     reactor_driver_t *const parent_;
     const namespace_id_t namespace_id_;
     svs_by_namespace_t *const svs_by_namespace_;
+    /* Never changes, so any thread may read it. */
+    const std::string primary_key;
 
     watchable_variable_t<write_ack_config_checker_t> write_ack_config_var;
     watchable_variable_t<write_durability_t> write_durability_var;
+    watchable_variable_t<table_write_limits_t> write_limits_var;
+    watchable_variable_t<table_expiry_t> expiry_var;
     all_thread_watchable_variable_t<write_ack_config_checker_t>
         write_ack_config_cross_threader;
     all_thread_watchable_variable_t<write_durability_t>
         write_durability_cross_threader;
+    all_thread_watchable_variable_t<table_write_limits_t>
+        write_limits_cross_threader;
+    all_thread_watchable_variable_t<table_expiry_t>
+        expiry_cross_threader;
+
+    table_replication_info_t last_repli_info;
+    table_cache_config_t cache_config;
+    uint64_t block_size;
+    int cpu_shards;
+    bool compress_blocks;
 
     stores_lifetimer_t stores_lifetimer_;
     scoped_ptr_t<multistore_ptr_t> svs_;
@@ -428,12 +493,14 @@ reactor_driver_t::reactor_driver_t(
       we_were_permanently_removed(_we_were_permanently_removed),
       ctx(_ctx),
       svs_by_namespace(_svs_by_namespace),
+      on_change_pending(false),
+      server_mapping_changed(true),
       semilattice_subscription(
         boost::bind(&reactor_driver_t::on_change, this), semilattice_view),
       name_to_server_id_subscription(
-        boost::bind(&reactor_driver_t::on_change, this)),
+        boost::bind(&reactor_driver_t::on_server_mapping_change, this)),
       server_id_to_peer_id_subscription(
-        boost::bind(&reactor_driver_t::on_change, this)),
+        boost::bind(&reactor_driver_t::on_server_mapping_change, this)),
       perfmon_collection_repo(_perfmon_collection_repo)
 {
     watchable_t< std::multimap<name_string_t, server_id_t> >::freeze_t
@@ -511,15 +578,30 @@ void reactor_driver_t::delete_reactor_data(
     svs_by_namespace->destroy_svs(namespace_id);
 }
 
+void reactor_driver_t::on_server_mapping_change() {
+    server_mapping_changed = true;
+    on_change();
+}
+
 void reactor_driver_t::on_change() {
+    if (on_change_pending) {
+        return;
+    }
+    on_change_pending = true;
     auto_drainer_t::lock_t drainer_lock = drainer.lock();
 
     // This can't block but must acquire a write lock thus it's done through a coroutine.
     coro_t::spawn_sometime([this, drainer_lock](){
         rwlock_acq_t rwlock(&reactor_data_rwlock, access_t::write);
+        on_change_pending = false;
 
         cluster_semilattice_metadata_t md = semilattice_view->get();
 
+        const bool servers_changed = server_mapping_changed
+            || !(md.servers == last_servers_md);
+        server_mapping_changed = false;
+        last_servers_md = md.servers;
+
         for (auto it = md.rdb_namespaces->namespaces.begin();
                 it != md.rdb_namespaces->namespaces.end();
                 ++it) {
@@ -547,6 +629,12 @@ void reactor_driver_t::on_change() {
                 const table_replication_info_t *repli_info =
                     &it->second.get_ref().replication_info.get_ref();
 
+                auto existing = reactor_data.find(it->first);
+                if (!servers_changed && existing != reactor_data.end() &&
+                        existing->second->get_repli_info() == *repli_info) {
+                    continue;
+                }
+
                 blueprint_t bp;
                 try {
                     bp = construct_blueprint(*repli_info, server_config_client);
@@ -568,14 +656,15 @@ void reactor_driver_t::on_change() {
                 /* Either construct a new reactor (if this is a namespace we
                  * haven't seen before). Or send the new blueprint to the
                  * existing reactor. */
-                if (!std_contains(reactor_data, it->first)) {
+                if (existing == reactor_data.end()) {
                     namespace_id_t tmp = it->first;
                     reactor_data.insert(std::make_pair(tmp,
                         make_scoped<watchable_and_reactor_t>(
                             base_path, io_backender, this, it->first, bp,
+                            it->second.get_ref().primary_key.get_ref(),
                             *repli_info, md.servers, svs_by_namespace, ctx)));
                 } else {
-                    reactor_data.find(it->first)->second->update_repli_info(
+                    existing->second->update_repli_info(
                         bp, *repli_info, md.servers);
                 }
             }
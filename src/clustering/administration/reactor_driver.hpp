@@ -97,11 +97,19 @@ private:
 
 class svs_by_namespace_t {
 public:
+    /* `block_size` and `cpu_shards` are only used if the table's data file has to be
+    created; `compress_blocks` applies to the blocks written from now on. */
     virtual void get_svs(perfmon_collection_t *perfmon_collection, namespace_id_t namespace_id,
+                         uint64_t block_size,
+                         int cpu_shards,
+                         bool compress_blocks,
                          stores_lifetimer_t *stores_out,
                          scoped_ptr_t<multistore_ptr_t> *svs_out,
                          rdb_context_t *) = 0;
     virtual void destroy_svs(namespace_id_t namespace_id) = 0;
+    /* Tells the cache balancer how to treat the caches of the table's stores. */
+    virtual void set_cache_config(namespace_id_t namespace_id,
+                                  const table_cache_config_t &config) = 0;
 
 protected:
     virtual ~svs_by_namespace_t() { }
@@ -158,6 +166,7 @@ private:
             watchable_and_reactor_t *thing_to_delete,
             namespace_id_t namespace_id);
     void on_change();
+    void on_server_mapping_change();
 
     const base_path_t base_path;
     io_backender_t *const io_backender;
@@ -181,6 +190,18 @@ private:
     reactor_map_t reactor_data;
     rwlock_t reactor_data_rwlock;
 
+    /* `on_change()` sets `on_change_pending` when it spawns a pass over the tables, and
+    the pass clears it once it holds `reactor_data_rwlock`. Changes that arrive before
+    then are picked up by that pass, so creating many tables at once doesn't queue one
+    pass over every table per table. */
+    bool on_change_pending;
+
+    /* What the last pass saw of the inputs that every table's blueprint depends on.
+    If they haven't changed, tables whose replication info hasn't changed either are
+    skipped. */
+    bool server_mapping_changed;
+    servers_semilattice_metadata_t last_servers_md;
+
     auto_drainer_t drainer;
 
     semilattice_read_view_t<cluster_semilattice_metadata_t>::subscription_t
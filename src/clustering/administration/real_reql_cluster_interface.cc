@@ -735,6 +735,15 @@ bool real_reql_cluster_interface_t::reconfigure_internal(
 
     new_repli_info.config.write_ack_config.mode = write_ack_config_t::mode_t::majority;
     new_repli_info.config.durability = write_durability_t::HARD;
+    /* Reconfiguring changes where the table's shards live, not how they are cached
+    or stored. */
+    new_repli_info.config.cache = table_md->replication_info.get_ref().config.cache;
+    new_repli_info.config.block_size =
+        table_md->replication_info.get_ref().config.block_size;
+    new_repli_info.config.cpu_shards =
+        table_md->replication_info.get_ref().config.cpu_shards;
+    new_repli_info.config.compress_blocks =
+        table_md->replication_info.get_ref().config.compress_blocks;
 
     if (!dry_run) {
         /* Commit the change */
@@ -850,8 +859,9 @@ bool real_reql_cluster_interface_t::rebalance_internal(
     namespace_semilattice_metadata_t *table_md =
         ns_change.get()->namespaces.at(table_id).get_mutable();
 
-    std::map<store_key_t, int64_t> counts;
-    if (!fetch_distribution(table_id, this, interruptor, &counts, error_out)) {
+    std::map<store_key_t, int64_t> counts, access_counts;
+    if (!fetch_distribution(table_id, this, interruptor, &counts, &access_counts,
+                            error_out)) {
         *error_out = strprintf("When measuring document distribution for table "
             "`%s.%s`: %s", db->name.c_str(), table_name.c_str(), error_out->c_str());
         return false;
@@ -861,7 +871,7 @@ bool real_reql_cluster_interface_t::rebalance_internal(
     table_replication_info_t new_repli_info = table_md->replication_info.get_ref();
     // If there's not enough data to rebalance, just pretend like we did
     if (!calculate_split_points_with_distribution(
-            counts,
+            weigh_distribution_by_load(counts, access_counts),
             new_repli_info.config.shards.size(),
             &new_repli_info.shard_scheme,
             error_out)) {
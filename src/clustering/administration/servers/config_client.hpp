@@ -154,7 +154,7 @@ private:
     watchable_variable_t< std::map<server_id_t, name_string_t> > server_id_to_name_map;
 
     watchable_t< change_tracking_map_t<peer_id_t,
-        cluster_directory_metadata_t> >::subscription_t directory_subs;
+        cluster_directory_metadata_t> >::coalesced_subscription_t directory_subs;
     semilattice_readwrite_view_t<servers_semilattice_metadata_t>::subscription_t
         semilattice_subs;
 };
@@ -15,6 +15,8 @@ server_config_server_t::server_config_server_t(
     my_name(name_string_t()),
     my_tags(std::set<name_string_t>()),
     actual_cache_size_bytes(0),
+    cache_size_is_auto(false),
+    readjusting_auto_cache_size(false),
     directory_view(_directory_view),
     semilattice_view(_semilattice_view),
     change_name_mailbox(mailbox_manager,
@@ -28,7 +30,8 @@ server_config_server_t::server_config_server_t(
             ph::_1, ph::_2, ph::_3)),
     semilattice_subs([this]() {
         on_semilattice_change();
-        })
+        }),
+    auto_cache_size_timer(AUTO_CACHE_SIZE_INTERVAL_MS, this)
 {
     /* Find our entry in the servers semilattice map and determine our current name from
     it. */
@@ -152,6 +155,7 @@ void server_config_server_t::on_semilattice_change() {
 void server_config_server_t::update_actual_cache_size(
         const boost::optional<uint64_t> &setting) {
     uint64_t actual_size;
+    cache_size_is_auto = !static_cast<bool>(setting);
     if (!static_cast<bool>(setting)) {
         actual_size = get_default_total_cache_size();
         logINF("Automatically using cache size of %" PRIu64 " MB",
@@ -178,3 +182,34 @@ void server_config_server_t::update_actual_cache_size(
     actual_cache_size_bytes.set_value(actual_size);
 }
 
+void server_config_server_t::on_ring() {
+    if (cache_size_is_auto && !readjusting_auto_cache_size) {
+        readjusting_auto_cache_size = true;
+        coro_t::spawn_sometime(std::bind(
+            &server_config_server_t::readjust_auto_cache_size, this, drainer.lock()));
+    }
+}
+
+void server_config_server_t::readjust_auto_cache_size(
+        auto_drainer_t::lock_t keepalive) {
+    const uint64_t current_size = actual_cache_size_bytes.get_watchable()->get();
+    // This blocks while we read the memory statistics.
+    const uint64_t new_size = get_auto_total_cache_size(current_size);
+    readjusting_auto_cache_size = false;
+    if (keepalive.get_drain_signal()->is_pulsed() || !cache_size_is_auto) {
+        return;
+    }
+    // The setting may also have been changed and changed back while we were blocked.
+    const uint64_t latest_size = actual_cache_size_bytes.get_watchable()->get();
+    const uint64_t change = new_size > latest_size
+        ? new_size - latest_size
+        : latest_size - new_size;
+    // Resizing makes the cache balancer move memory around between every table, so
+    // ignore small fluctuations.
+    if (change * AUTO_CACHE_SIZE_MIN_CHANGE_RATIO < latest_size) {
+        return;
+    }
+    logINF("Automatically adjusting cache size to %" PRIu64 " MB",
+        new_size / static_cast<uint64_t>(MEGABYTE));
+    actual_cache_size_bytes.set_value(new_size);
+}
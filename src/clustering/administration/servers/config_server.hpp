@@ -4,8 +4,10 @@
 
 #include <set>
 
+#include "arch/timing.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "clustering/administration/servers/server_metadata.hpp"
+#include "concurrency/auto_drainer.hpp"
 #include "containers/incremental_lenses.hpp"
 #include "rpc/semilattice/view.hpp"
 
@@ -20,7 +22,9 @@ being renamed.
 
 A server's tags and cache size are also handled and configured in the same way. */
 
-class server_config_server_t : public home_thread_mixin_t {
+class server_config_server_t :
+    public home_thread_mixin_t,
+    private repeating_timer_callback_t {
 public:
     server_config_server_t(
         mailbox_manager_t *_mailbox_manager,
@@ -45,7 +49,8 @@ public:
 
     /* Returns the actual cache size, not the cache size setting. If the cache size
     setting is "auto", the actual cache size will be some reasonable automatically
-    selected value; otherwise, the actual cache size will be the cache size setting. */
+    selected value, which follows the available memory as the server runs; otherwise,
+    the actual cache size will be the cache size setting. */
     clone_ptr_t<watchable_t<uint64_t> > get_actual_cache_size_bytes() {
         return actual_cache_size_bytes.get_watchable();
     }
@@ -82,11 +87,20 @@ private:
 
     void update_actual_cache_size(const boost::optional<uint64_t> &setting);
 
+    /* While the cache size setting is "auto", `on_ring()` periodically spawns
+    `readjust_auto_cache_size()`, which resizes the cache if the memory available to
+    it has changed significantly. That way we give memory back when other processes
+    or queries need it, and take it again once it's been freed. */
+    void on_ring();
+    void readjust_auto_cache_size(auto_drainer_t::lock_t keepalive);
+
     mailbox_manager_t *mailbox_manager;
     server_id_t my_server_id;
     watchable_variable_t<name_string_t> my_name;
     watchable_variable_t<std::set<name_string_t> > my_tags;
     watchable_variable_t<uint64_t> actual_cache_size_bytes;
+    bool cache_size_is_auto;
+    bool readjusting_auto_cache_size;
     cond_t permanently_removed_cond;
 
     clone_ptr_t<watchable_t<change_tracking_map_t<peer_id_t,
@@ -99,6 +113,9 @@ private:
     server_config_business_card_t::change_cache_size_mailbox_t change_cache_size_mailbox;
     semilattice_readwrite_view_t<servers_semilattice_metadata_t>::subscription_t
         semilattice_subs;
+
+    auto_drainer_t drainer;
+    repeating_timer_t auto_cache_size_timer;
 };
 
 #endif /* CLUSTERING_ADMINISTRATION_SERVERS_CONFIG_SERVER_HPP_ */
@@ -1,6 +1,11 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "clustering/administration/stats/request.hpp"
 
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+
 #include "clustering/administration/datum_adapter.hpp"
 #include "clustering/administration/servers/config_client.hpp"
 
@@ -33,15 +38,29 @@ const char *table_server_stats_request_t::table_server_request_type = "table_ser
 parsed_stats_t::server_stats_t::server_stats_t() :
     responsive(false),
     queries_per_sec(0), queries_total(0),
-    client_connections(0), clients_active(0) { }
+    client_connections(0), clients_active(0),
+    term_cache_hits_total(0), term_cache_misses_total(0),
+    page_cache_bytes(0), datum_buffers_bytes(0), changefeed_queues_bytes(0),
+    disk_backed_queues_bytes(0), mailbox_buffers_bytes(0),
+    coroutine_stacks_bytes(0) { }
+
+parsed_stats_t::shard_stats_t::shard_stats_t() :
+    read_docs_total(0), written_docs_total(0),
+    in_use_bytes(0), limit_bytes(0), page_accesses_total(0), page_loads_total(0) { }
+
+parsed_stats_t::unindexed_scan_stats_t::unindexed_scan_stats_t() :
+    reads(0), rows_scanned(0), rows_returned(0) { }
 
 parsed_stats_t::table_stats_t::table_stats_t() :
     read_docs_per_sec(0), read_docs_total(0),
     written_docs_per_sec(0), written_docs_total(0),
-    in_use_bytes(0), metadata_bytes(0), data_bytes(0),
+    in_use_bytes(0), limit_bytes(0), page_accesses_total(0), page_loads_total(0),
+    metadata_bytes(0), data_bytes(0),
     garbage_bytes(0), preallocated_bytes(0),
     read_bytes_per_sec(0), read_bytes_total(0),
-    written_bytes_per_sec(0), written_bytes_total(0) { }
+    written_bytes_per_sec(0), written_bytes_total(0),
+    gc_read_bytes_total(0), gc_written_bytes_total(0), queue_depth(0),
+    read_ahead_blocks_total(0), read_ahead_blocks_used_total(0) { }
 
 parsed_stats_t::parsed_stats_t(const std::vector<ql::datum_t> &stats) {
     for (auto const &s : stats) {
@@ -64,6 +83,8 @@ parsed_stats_t::parsed_stats_t(const std::vector<ql::datum_t> &stats) {
             std::pair<datum_string_t, ql::datum_t> perf_pair = s.get_pair(i);
             if (perf_pair.first == "query_engine") {
                 store_query_engine_stats(perf_pair.second, &serv_stats);
+            } else if (perf_pair.first == "memory") {
+                store_memory_stats(perf_pair.second, &serv_stats);
             } else {
                 namespace_id_t table_id;
                 res = str_to_uuid(perf_pair.first.to_std(), &table_id);
@@ -105,8 +126,12 @@ void parsed_stats_t::store_shard_values(const ql::datum_t &shard_perf,
     r_sanity_check(shard_perf.get_type() == ql::datum_t::R_OBJECT);
     for (size_t i = 0; i < shard_perf.obj_size(); ++i) {
         std::pair<datum_string_t, ql::datum_t> pair = shard_perf.get_pair(i);
-        if (pair.first.to_std().find("shard_") == 0) {
+        int64_t shard_number;
+        if (pair.first.to_std().find("shard_") == 0
+            && strtoi64_strict(pair.first.to_std().substr(strlen("shard_")), 10,
+                               &shard_number)) {
             r_sanity_check(pair.second.get_type() == ql::datum_t::R_OBJECT);
+            shard_stats_t *shard_out = &stats_out->shards[shard_number];
             for (size_t j = 0; j < pair.second.obj_size(); ++j) {
                 std::pair<datum_string_t, ql::datum_t> sub_pair = pair.second.get_pair(j);
                 std::string key = sub_pair.first.to_std();
@@ -121,9 +146,41 @@ void parsed_stats_t::store_shard_values(const ql::datum_t &shard_perf,
                                       &stats_out->read_docs_total);
                     add_perfmon_value(sub_pair.second, "total_keys_set",
                                       &stats_out->written_docs_total);
+                    add_perfmon_value(sub_pair.second, "total_keys_read",
+                                      &shard_out->read_docs_total);
+                    add_perfmon_value(sub_pair.second, "total_keys_set",
+                                      &shard_out->written_docs_total);
                 } else if (key == "cache") {
                     add_perfmon_value(sub_pair.second, "in_use_bytes",
                                       &stats_out->in_use_bytes);
+                    add_perfmon_value(sub_pair.second, "limit_bytes",
+                                      &stats_out->limit_bytes);
+                    add_perfmon_value(sub_pair.second, "page_accesses_total",
+                                      &stats_out->page_accesses_total);
+                    add_perfmon_value(sub_pair.second, "page_loads_total",
+                                      &stats_out->page_loads_total);
+                    store_perfmon_value(sub_pair.second, "in_use_bytes",
+                                        &shard_out->in_use_bytes);
+                    store_perfmon_value(sub_pair.second, "limit_bytes",
+                                        &shard_out->limit_bytes);
+                    store_perfmon_value(sub_pair.second, "page_accesses_total",
+                                        &shard_out->page_accesses_total);
+                    store_perfmon_value(sub_pair.second, "page_loads_total",
+                                        &shard_out->page_loads_total);
+                } else if (key == "unindexed_scans") {
+                    r_sanity_check(sub_pair.second.get_type() == ql::datum_t::R_OBJECT);
+                    for (size_t k = 0; k < sub_pair.second.obj_size(); ++k) {
+                        std::pair<datum_string_t, ql::datum_t> field_pair =
+                            sub_pair.second.get_pair(k);
+                        unindexed_scan_stats_t *scans_out =
+                            &stats_out->unindexed_scans[field_pair.first.to_std()];
+                        add_perfmon_value(field_pair.second, "reads",
+                                          &scans_out->reads);
+                        add_perfmon_value(field_pair.second, "rows_scanned",
+                                          &scans_out->rows_scanned);
+                        add_perfmon_value(field_pair.second, "rows_returned",
+                                          &scans_out->rows_returned);
+                    }
                 }
             }
         }
@@ -141,6 +198,25 @@ void parsed_stats_t::store_serializer_values(const ql::datum_t &ser_perf,
                         &stats_out->written_bytes_per_sec);
     store_perfmon_value(ser_perf, "serializer_written_bytes_total",
                         &stats_out->written_bytes_total);
+    store_perfmon_value(ser_perf, "serializer_gc_read_bytes_total",
+                        &stats_out->gc_read_bytes_total);
+    store_perfmon_value(ser_perf, "serializer_gc_written_bytes_total",
+                        &stats_out->gc_written_bytes_total);
+    store_perfmon_value(ser_perf, "serializer_read_ahead_blocks",
+                        &stats_out->read_ahead_blocks_total);
+    store_perfmon_value(ser_perf, "serializer_read_ahead_blocks_used",
+                        &stats_out->read_ahead_blocks_used_total);
+
+    // The block reads and index writes in progress.  Data block writes aren't
+    // counted, but every batch of them is followed by an index write.
+    for (const char *sampler : { "serializer_block_reads",
+                                 "serializer_index_writes" }) {
+        ql::datum_t sampler_perf = ser_perf.get_field(sampler, ql::throw_bool_t::NOTHROW);
+        if (sampler_perf.has()) {
+            r_sanity_check(sampler_perf.get_type() == ql::datum_t::R_OBJECT);
+            add_perfmon_value(sampler_perf, "active_count", &stats_out->queue_depth);
+        }
+    }
 
     // TODO: these are not entirely accurate, but the underlying stats would need
     // a good overhaul
@@ -165,6 +241,32 @@ void parsed_stats_t::store_query_engine_stats(const ql::datum_t &qe_perf,
     store_perfmon_value(qe_perf, "queries_total", &stats_out->queries_total);
     store_perfmon_value(qe_perf, "client_connections", &stats_out->client_connections);
     store_perfmon_value(qe_perf, "clients_active", &stats_out->clients_active);
+    store_perfmon_value(qe_perf, "term_cache_hits",
+                        &stats_out->term_cache_hits_total);
+    store_perfmon_value(qe_perf, "term_cache_misses",
+                        &stats_out->term_cache_misses_total);
+    ql::datum_t latency = qe_perf.get_field("query_latency", ql::throw_bool_t::NOTHROW);
+    if (latency.has()) {
+        r_sanity_check(latency.get_type() == ql::datum_t::R_OBJECT);
+        stats_out->query_latency = latency;
+    }
+}
+
+void parsed_stats_t::store_memory_stats(const ql::datum_t &memory_perf,
+                                        server_stats_t *stats_out) {
+    r_sanity_check(memory_perf.get_type() == ql::datum_t::R_OBJECT);
+    store_perfmon_value(memory_perf, "page_cache_bytes",
+                        &stats_out->page_cache_bytes);
+    store_perfmon_value(memory_perf, "datum_buffers_bytes",
+                        &stats_out->datum_buffers_bytes);
+    store_perfmon_value(memory_perf, "changefeed_queues_bytes",
+                        &stats_out->changefeed_queues_bytes);
+    store_perfmon_value(memory_perf, "disk_backed_queues_bytes",
+                        &stats_out->disk_backed_queues_bytes);
+    store_perfmon_value(memory_perf, "mailbox_buffers_bytes",
+                        &stats_out->mailbox_buffers_bytes);
+    store_perfmon_value(memory_perf, "coroutine_stacks_bytes",
+                        &stats_out->coroutine_stacks_bytes);
 }
 
 void parsed_stats_t::store_table_stats(const namespace_id_t &table_id,
@@ -228,6 +330,14 @@ double parsed_stats_t::accumulate_server(const server_id_t &server_id,
     return res;
 }
 
+// Every page access that didn't have to load the page from disk is a hit.
+double cache_hit_ratio(double page_accesses_total, double page_loads_total) {
+    if (page_accesses_total <= 0) {
+        return 1.0;
+    }
+    return std::max(0.0, 1.0 - page_loads_total / page_accesses_total);
+}
+
 bool add_table_fields(const namespace_id_t &table_id,
                       const cluster_semilattice_metadata_t &metadata,
                       admin_identifier_format_t admin_format,
@@ -345,7 +455,8 @@ table_stats_request_t::table_stats_request_t(const namespace_id_t &_table_id) :
 
 std::set<std::vector<std::string> > table_stats_request_t::get_filter() const {
     return std::set<std::vector<std::string> >({
-        { uuid_to_str(table_id), "serializers", "shard_[0-9]+", "btree-.*", "keys_.*" }
+        { uuid_to_str(table_id), "serializers", "shard_[0-9]+", "btree-.*", "keys_.*" },
+        { uuid_to_str(table_id), "serializers", "shard_[0-9]+", "unindexed_scans" }
         });
 }
 
@@ -382,6 +493,43 @@ bool table_stats_request_t::to_datum(const parsed_stats_t &stats,
     ADD_TABLE_STAT(qe_builder, stats, table_id, written_docs_per_sec);
     row_builder.overwrite("query_engine", std::move(qe_builder).to_datum());
 
+    // The fields that unindexed reads filtered on, the ones whose filters dropped the
+    // most rows first: those are the reads that an index would save the most work.
+    std::map<std::string, parsed_stats_t::unindexed_scan_stats_t> scans;
+    for (auto const &server_pair : stats.servers) {
+        auto const &table_it = server_pair.second.tables.find(table_id);
+        if (table_it != server_pair.second.tables.end()) {
+            for (auto const &field_pair : table_it->second.unindexed_scans) {
+                parsed_stats_t::unindexed_scan_stats_t *field_scans =
+                    &scans[field_pair.first];
+                field_scans->reads += field_pair.second.reads;
+                field_scans->rows_scanned += field_pair.second.rows_scanned;
+                field_scans->rows_returned += field_pair.second.rows_returned;
+            }
+        }
+    }
+    std::vector<std::pair<double, std::string> > ranked;
+    for (auto const &field_pair : scans) {
+        const double rows_skipped =
+            field_pair.second.rows_scanned - field_pair.second.rows_returned;
+        if (rows_skipped > 0) {
+            ranked.push_back(std::make_pair(rows_skipped, field_pair.first));
+        }
+    }
+    std::sort(ranked.begin(), ranked.end(),
+              std::greater<std::pair<double, std::string> >());
+    ql::datum_array_builder_t suggestions_builder(ql::configured_limits_t::unlimited);
+    for (auto const &pair : ranked) {
+        const parsed_stats_t::unindexed_scan_stats_t &field_scans = scans[pair.second];
+        ql::datum_object_builder_t suggestion_builder;
+        suggestion_builder.overwrite("field", ql::datum_t(datum_string_t(pair.second)));
+        ADD_STAT(suggestion_builder, field_scans, reads);
+        ADD_STAT(suggestion_builder, field_scans, rows_scanned);
+        ADD_STAT(suggestion_builder, field_scans, rows_returned);
+        suggestions_builder.add(std::move(suggestion_builder).to_datum());
+    }
+    row_builder.overwrite("index_suggestions", std::move(suggestions_builder).to_datum());
+
     *result_out = std::move(row_builder).to_datum();
     return true;
 }
@@ -413,6 +561,7 @@ server_stats_request_t::server_stats_request_t(const server_id_t &_server_id) :
 std::set<std::vector<std::string> > server_stats_request_t::get_filter() const {
     return std::set<std::vector<std::string> >(
         { {"query_engine"},
+          {"memory"},
           {".*", "serializers", "shard_[0-9]+", "btree-.*" } });
 }
 
@@ -462,11 +611,25 @@ bool server_stats_request_t::to_datum(const parsed_stats_t &stats,
         ADD_STAT(qe_builder, server_stats, clients_active);
         ADD_STAT(qe_builder, server_stats, queries_per_sec);
         ADD_STAT(qe_builder, server_stats, queries_total);
+        ADD_STAT(qe_builder, server_stats, term_cache_hits_total);
+        ADD_STAT(qe_builder, server_stats, term_cache_misses_total);
+        if (server_stats.query_latency.has()) {
+            qe_builder.overwrite("query_latency", server_stats.query_latency);
+        }
         ADD_SERVER_STAT(qe_builder, stats, server_id, read_docs_per_sec);
         ADD_SERVER_STAT(qe_builder, stats, server_id, read_docs_total);
         ADD_SERVER_STAT(qe_builder, stats, server_id, written_docs_per_sec);
         ADD_SERVER_STAT(qe_builder, stats, server_id, written_docs_total);
         row_builder.overwrite("query_engine", std::move(qe_builder).to_datum());
+
+        ql::datum_object_builder_t memory_builder;
+        ADD_STAT(memory_builder, server_stats, page_cache_bytes);
+        ADD_STAT(memory_builder, server_stats, datum_buffers_bytes);
+        ADD_STAT(memory_builder, server_stats, changefeed_queues_bytes);
+        ADD_STAT(memory_builder, server_stats, disk_backed_queues_bytes);
+        ADD_STAT(memory_builder, server_stats, mailbox_buffers_bytes);
+        ADD_STAT(memory_builder, server_stats, coroutine_stacks_bytes);
+        row_builder.overwrite("memory", std::move(memory_builder).to_datum());
     }
     *result_out = std::move(row_builder).to_datum();
     return true;
@@ -572,6 +735,10 @@ bool table_server_stats_request_t::to_datum(const parsed_stats_t &stats,
 
         ql::datum_object_builder_t se_cache_builder;
         ADD_STAT(se_cache_builder, table_stats, in_use_bytes);
+        ADD_STAT(se_cache_builder, table_stats, limit_bytes);
+        se_cache_builder.overwrite("hit_ratio", ql::datum_t(
+            cache_hit_ratio(table_stats.page_accesses_total,
+                            table_stats.page_loads_total)));
 
         ql::datum_object_builder_t se_disk_space_builder;
         ADD_STAT(se_disk_space_builder, table_stats, metadata_bytes);
@@ -584,11 +751,52 @@ bool table_server_stats_request_t::to_datum(const parsed_stats_t &stats,
         ADD_STAT(se_disk_builder, table_stats, read_bytes_total);
         ADD_STAT(se_disk_builder, table_stats, written_bytes_per_sec);
         ADD_STAT(se_disk_builder, table_stats, written_bytes_total);
+        ADD_STAT(se_disk_builder, table_stats, gc_read_bytes_total);
+        ADD_STAT(se_disk_builder, table_stats, gc_written_bytes_total);
+        ADD_STAT(se_disk_builder, table_stats, queue_depth);
         se_disk_builder.overwrite("space_usage", std::move(se_disk_space_builder).to_datum());
 
+        // The fraction of the blocks read ahead that ended up in a cache.
+        ql::datum_object_builder_t se_read_ahead_builder;
+        se_read_ahead_builder.overwrite("blocks_total",
+            ql::datum_t(table_stats.read_ahead_blocks_total));
+        se_read_ahead_builder.overwrite("blocks_used_total",
+            ql::datum_t(table_stats.read_ahead_blocks_used_total));
+        se_read_ahead_builder.overwrite("efficiency", ql::datum_t(
+            table_stats.read_ahead_blocks_total > 0
+                ? table_stats.read_ahead_blocks_used_total
+                    / table_stats.read_ahead_blocks_total
+                : 1.0));
+        se_disk_builder.overwrite("read_ahead",
+                                  std::move(se_read_ahead_builder).to_datum());
+
+        // The table's store on this server is split into hash shards, each with its
+        // own cache, so that one hot shard shows up here.
+        ql::datum_array_builder_t se_shards_builder(
+            ql::configured_limits_t::unlimited);
+        for (const auto &pair : table_stats.shards) {
+            const parsed_stats_t::shard_stats_t &shard_stats = pair.second;
+            ql::datum_object_builder_t shard_cache_builder;
+            ADD_STAT(shard_cache_builder, shard_stats, in_use_bytes);
+            ADD_STAT(shard_cache_builder, shard_stats, limit_bytes);
+            ADD_STAT(shard_cache_builder, shard_stats, page_accesses_total);
+            ADD_STAT(shard_cache_builder, shard_stats, page_loads_total);
+            shard_cache_builder.overwrite("hit_ratio", ql::datum_t(
+                cache_hit_ratio(shard_stats.page_accesses_total,
+                                shard_stats.page_loads_total)));
+
+            ql::datum_object_builder_t shard_builder;
+            shard_builder.overwrite("shard", ql::datum_t(static_cast<double>(pair.first)));
+            ADD_STAT(shard_builder, shard_stats, read_docs_total);
+            ADD_STAT(shard_builder, shard_stats, written_docs_total);
+            shard_builder.overwrite("cache", std::move(shard_cache_builder).to_datum());
+            se_shards_builder.add(std::move(shard_builder).to_datum());
+        }
+
         ql::datum_object_builder_t se_builder;
         se_builder.overwrite("cache", std::move(se_cache_builder).to_datum());
         se_builder.overwrite("disk", std::move(se_disk_builder).to_datum());
+        se_builder.overwrite("shards", std::move(se_shards_builder).to_datum());
 
         row_builder.overwrite("query_engine", std::move(qe_builder).to_datum());
         row_builder.overwrite("storage_engine", std::move(se_builder).to_datum());
@@ -19,6 +19,29 @@ class server_config_client_t;
 // rows in the `stats` table, without performing more requests.
 class parsed_stats_t {
 public:
+    // The stats of one of the hash shards (`shard_N`) that a table's store on a
+    // server is split into, each with its own btree and cache.
+    struct shard_stats_t {
+        shard_stats_t();
+
+        double read_docs_total;
+        double written_docs_total;
+        double in_use_bytes;
+        double limit_bytes;
+        double page_accesses_total;
+        double page_loads_total;
+    };
+
+    // The range reads on the primary index that filtered on one field (see
+    // `unindexed_scan_stats_t`).
+    struct unindexed_scan_stats_t {
+        unindexed_scan_stats_t();
+
+        double reads;
+        double rows_scanned;
+        double rows_returned;
+    };
+
     struct table_stats_t {
         table_stats_t();
 
@@ -27,6 +50,9 @@ public:
         double written_docs_per_sec;
         double written_docs_total;
         double in_use_bytes;
+        double limit_bytes;
+        double page_accesses_total;
+        double page_loads_total;
         double metadata_bytes;
         double data_bytes;
         double garbage_bytes;
@@ -35,6 +61,15 @@ public:
         double read_bytes_total;
         double written_bytes_per_sec;
         double written_bytes_total;
+        double gc_read_bytes_total;
+        double gc_written_bytes_total;
+        double queue_depth;
+        double read_ahead_blocks_total;
+        double read_ahead_blocks_used_total;
+
+        std::map<int, shard_stats_t> shards;
+        // By the fields' paths, joined by dots.
+        std::map<std::string, unindexed_scan_stats_t> unindexed_scans;
     };
 
     struct server_stats_t {
@@ -45,6 +80,19 @@ public:
         double queries_total;
         double client_connections;
         double clients_active;
+        double term_cache_hits_total;
+        double term_cache_misses_total;
+        // The `perfmon_latency_histogram_t` output ({count, p50, ..., max}) as is,
+        // since percentiles can't be added up across servers.
+        ql::datum_t query_latency;
+
+        // Bytes held by the big consumers of memory, see `memory_tag_t`.
+        double page_cache_bytes;
+        double datum_buffers_bytes;
+        double changefeed_queues_bytes;
+        double disk_backed_queues_bytes;
+        double mailbox_buffers_bytes;
+        double coroutine_stacks_bytes;
 
         std::map<namespace_id_t, table_stats_t> tables;
     };
@@ -89,6 +137,9 @@ private:
     void store_query_engine_stats(const ql::datum_t &qe_perf,
                                   server_stats_t *stats_out);
 
+    void store_memory_stats(const ql::datum_t &memory_perf,
+                            server_stats_t *stats_out);
+
     void store_table_stats(const namespace_id_t &table_id,
                            const ql::datum_t &table_perf,
                            server_stats_t *stats_out);
@@ -13,6 +13,7 @@ stat_manager_t::stat_manager_t(mailbox_manager_t* mm,
                                server_id_t _own_server_id) :
     own_server_id(_own_server_id),
     mailbox_manager(mm),
+    snapshot_time(0),
     get_stats_mailbox(mailbox_manager,
                       std::bind(&stat_manager_t::on_stats_request,
                                 this, ph::_1, ph::_2, ph::_3))
@@ -23,12 +24,11 @@ get_stats_mailbox_address_t stat_manager_t::get_address() {
 }
 
 void stat_manager_t::on_stats_request(
-        UNUSED signal_t *interruptor,
+        signal_t *interruptor,
         const return_address_t& reply_address,
         const std::set<std::vector<stat_id_t> >& requested_stats) {
     perfmon_filter_t request(requested_stats);
-    ql::datum_t perfmon_result(perfmon_get_stats());
-    perfmon_result = request.filter(perfmon_result);
+    ql::datum_t perfmon_result = request.filter(get_stats_snapshot(interruptor));
 
     // Add in our own server id so the other side does not need to perform lookups
     ql::datum_object_builder_t stats(perfmon_result);
@@ -36,6 +36,17 @@ void stat_manager_t::on_stats_request(
     send(mailbox_manager, reply_address, std::move(stats).to_datum());
 }
 
+ql::datum_t stat_manager_t::get_stats_snapshot(signal_t *interruptor) {
+    new_mutex_in_line_t mutex_acq(&snapshot_mutex);
+    wait_interruptible(mutex_acq.acq_signal(), interruptor);
+    if (!snapshot.has()
+        || current_microtime() >= snapshot_time + STATS_SNAPSHOT_MAX_AGE_MS * THOUSAND) {
+        snapshot = perfmon_get_stats();
+        snapshot_time = current_microtime();
+    }
+    return snapshot;
+}
+
 bool fetch_stats_from_server(
         mailbox_manager_t *mailbox_manager,
         const get_stats_mailbox_address_t &request_addr,
@@ -6,6 +6,7 @@
 #include <set>
 #include <string>
 
+#include "concurrency/new_mutex.hpp"
 #include "perfmon/types.hpp"
 #include "rpc/mailbox/typed.hpp"
 
@@ -27,8 +28,19 @@ private:
         const return_address_t& reply_address,
         const std::set<std::vector<stat_id_t> >& requested_stats);
 
+    /* Collecting the stats visits every thread and every perfmon, so we serve requests
+    from a snapshot that is at most `STATS_SNAPSHOT_MAX_AGE_MS` old. Requests that come
+    in while the stats are being collected wait for that collection instead of starting
+    another one. */
+    ql::datum_t get_stats_snapshot(signal_t *interruptor);
+
     server_id_t own_server_id;
     mailbox_manager_t *mailbox_manager;
+
+    new_mutex_t snapshot_mutex;
+    ql::datum_t snapshot;
+    microtime_t snapshot_time;
+
     get_stats_mailbox_t get_stats_mailbox;
 
     DISABLE_COPYING(stat_manager_t);
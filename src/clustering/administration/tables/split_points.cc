@@ -90,6 +90,7 @@ bool fetch_distribution(
         real_reql_cluster_interface_t *reql_cluster_interface,
         signal_t *interruptor,
         std::map<store_key_t, int64_t> *counts_out,
+        std::map<store_key_t, int64_t> *access_counts_out,
         std::string *error_out) {
     namespace_interface_access_t ns_if_access =
         reql_cluster_interface->get_namespace_repo()->get_namespace_interface(
@@ -106,11 +107,46 @@ bool fetch_distribution(
             "currently available for reading.";
         return false;
     }
-    *counts_out = std::move(
-        boost::get<distribution_read_response_t>(resp.response).key_counts);
+    distribution_read_response_t *dist_resp =
+        boost::get<distribution_read_response_t>(&resp.response);
+    *counts_out = std::move(dist_resp->key_counts);
+    if (access_counts_out != NULL) {
+        *access_counts_out = std::move(dist_resp->key_access_counts);
+    }
     return true;
 }
 
+std::map<store_key_t, int64_t> weigh_distribution_by_load(
+        const std::map<store_key_t, int64_t> &counts,
+        const std::map<store_key_t, int64_t> &access_counts) {
+    std::map<store_key_t, int64_t> weighted = counts;
+    if (counts.empty()) {
+        return weighted;
+    }
+    int64_t total_count = 0;
+    for (auto const &pair : counts) {
+        total_count += pair.second;
+    }
+    int64_t total_accesses = 0;
+    for (auto const &pair : access_counts) {
+        total_accesses += pair.second;
+    }
+    if (total_count == 0 || total_accesses == 0) {
+        return weighted;
+    }
+    const double scale =
+        static_cast<double>(total_count) / static_cast<double>(total_accesses);
+    for (auto const &pair : access_counts) {
+        /* Find the bucket of `counts` that the key falls into */
+        auto it = weighted.upper_bound(pair.first);
+        if (it != weighted.begin()) {
+            --it;
+        }
+        it->second += static_cast<int64_t>(pair.second * scale);
+    }
+    return weighted;
+}
+
 bool calculate_split_points_with_distribution(
         const std::map<store_key_t, int64_t> &counts,
         size_t num_shards,
@@ -221,14 +257,15 @@ bool calculate_split_points_intelligently(
         table_shard_scheme_t *split_points_out,
         std::string *error_out) {
     if (num_shards > old_split_points.num_shards()) {
-        std::map<store_key_t, int64_t> counts;
+        std::map<store_key_t, int64_t> counts, access_counts;
         if (!fetch_distribution(table_id, reql_cluster_interface,
-                interruptor, &counts, error_out)) {
+                interruptor, &counts, &access_counts, error_out)) {
             return false;
         }
         std::string dummy_error;
         if (!calculate_split_points_with_distribution(
-                counts, num_shards, split_points_out, &dummy_error)) {
+                weigh_distribution_by_load(counts, access_counts),
+                num_shards, split_points_out, &dummy_error)) {
             /* There aren't enough documents to calculate distribution. We'll just assume
             the user is going to use UUID primary keys. If we got it wrong, they will end
             up with horribly unbalanced data, but it's the best we can do. */
@@ -13,14 +13,25 @@ class real_reql_cluster_interface_t;
 class signal_t;
 class table_shard_scheme_t;
 
-/* `fetch_distribution` fetches the distribution information from the database. */
+/* `fetch_distribution` fetches the distribution information from the database. If
+`access_counts_out` isn't `NULL`, it also fetches a sample of how often keys have
+been accessed recently. */
 bool fetch_distribution(
         const namespace_id_t &table_id,
         real_reql_cluster_interface_t *reql_cluster_interface,
         signal_t *interruptor,
         std::map<store_key_t, int64_t> *counts_out,
+        std::map<store_key_t, int64_t> *access_counts_out,
         std::string *error_out);
 
+/* `weigh_distribution_by_load` adds the accesses from `access_counts` to the
+document counts in `counts`, scaled so that accesses and documents weigh the same
+in total. Split points calculated from the result balance both the data and the
+load between the shards. */
+std::map<store_key_t, int64_t> weigh_distribution_by_load(
+        const std::map<store_key_t, int64_t> &counts,
+        const std::map<store_key_t, int64_t> &access_counts);
+
 /* `calculate_split_points_with_distribution` generates a set of split points that are
 guaranteed to divide the data approximately evenly, using the results of
 `fetch_distribution()`. It fails if there are too few documents in the database. */
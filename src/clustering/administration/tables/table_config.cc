@@ -1,6 +1,10 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "clustering/administration/tables/table_config.hpp"
 
+#include <inttypes.h>
+
+#include <limits>
+
 #include "clustering/administration/datum_adapter.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "clustering/administration/tables/generate_config.hpp"
@@ -188,6 +192,291 @@ bool convert_durability_from_datum(
     return true;
 }
 
+ql::datum_t convert_table_cache_config_to_datum(
+        const table_cache_config_t &config) {
+    ql::datum_object_builder_t builder;
+    builder.overwrite("weight", ql::datum_t(config.weight));
+    builder.overwrite("min_size_mb",
+        ql::datum_t(static_cast<double>(config.min_bytes) / MEGABYTE));
+    builder.overwrite("max_size_mb", static_cast<bool>(config.max_bytes)
+        ? ql::datum_t(static_cast<double>(*config.max_bytes) / MEGABYTE)
+        : ql::datum_t::null());
+    return std::move(builder).to_datum();
+}
+
+bool convert_cache_size_mb_from_datum(
+        const ql::datum_t &datum,
+        uint64_t *bytes_out,
+        std::string *error_out) {
+    if (datum.get_type() != ql::datum_t::R_NUM) {
+        *error_out = "Expected a number, got " + datum.print();
+        return false;
+    }
+    double size_mb = datum.as_num();
+    if (size_mb * MEGABYTE > static_cast<double>(std::numeric_limits<int64_t>::max())) {
+        *error_out = "Value is too big.";
+        return false;
+    }
+    if (size_mb < 0) {
+        *error_out = "Cache size cannot be negative.";
+        return false;
+    }
+    *bytes_out = size_mb * MEGABYTE;
+    return true;
+}
+
+bool convert_table_cache_config_from_datum(
+        const ql::datum_t &datum,
+        table_cache_config_t *config_out,
+        std::string *error_out) {
+    converter_from_datum_object_t converter;
+    if (!converter.init(datum, error_out)) {
+        return false;
+    }
+    *config_out = table_cache_config_t();
+
+    if (converter.has("weight")) {
+        ql::datum_t weight_datum;
+        if (!converter.get("weight", &weight_datum, error_out)) {
+            return false;
+        }
+        if (weight_datum.get_type() != ql::datum_t::R_NUM
+                || !(weight_datum.as_num() > 0)) {
+            *error_out = "In `weight`: Expected a positive number, got " +
+                weight_datum.print();
+            return false;
+        }
+        config_out->weight = weight_datum.as_num();
+    }
+
+    if (converter.has("min_size_mb")) {
+        ql::datum_t min_datum;
+        if (!converter.get("min_size_mb", &min_datum, error_out)) {
+            return false;
+        }
+        if (!convert_cache_size_mb_from_datum(min_datum, &config_out->min_bytes,
+                                              error_out)) {
+            *error_out = "In `min_size_mb`: " + *error_out;
+            return false;
+        }
+    }
+
+    if (converter.has("max_size_mb")) {
+        ql::datum_t max_datum;
+        if (!converter.get("max_size_mb", &max_datum, error_out)) {
+            return false;
+        }
+        if (max_datum.get_type() != ql::datum_t::R_NULL) {
+            uint64_t max_bytes;
+            if (!convert_cache_size_mb_from_datum(max_datum, &max_bytes, error_out)) {
+                *error_out = "In `max_size_mb`: " + *error_out;
+                return false;
+            }
+            if (max_bytes < config_out->min_bytes) {
+                *error_out = "`max_size_mb` must not be less than `min_size_mb`.";
+                return false;
+            }
+            config_out->max_bytes = max_bytes;
+        }
+    }
+
+    if (!converter.check_no_extra_keys(error_out)) {
+        return false;
+    }
+
+    return true;
+}
+
+ql::datum_t convert_table_write_limits_to_datum(
+        const table_write_limits_t &limits) {
+    ql::datum_object_builder_t builder;
+    builder.overwrite("writes_per_sec", static_cast<bool>(limits.writes_per_sec)
+        ? ql::datum_t(static_cast<double>(*limits.writes_per_sec))
+        : ql::datum_t::null());
+    builder.overwrite("max_pending_writes", static_cast<bool>(limits.max_pending_writes)
+        ? ql::datum_t(static_cast<double>(*limits.max_pending_writes))
+        : ql::datum_t::null());
+    return std::move(builder).to_datum();
+}
+
+bool convert_write_limit_from_datum(
+        const ql::datum_t &datum,
+        boost::optional<uint64_t> *limit_out,
+        std::string *error_out) {
+    if (datum.get_type() == ql::datum_t::R_NULL) {
+        *limit_out = boost::none;
+        return true;
+    }
+    if (datum.get_type() != ql::datum_t::R_NUM
+            || datum.as_num() != static_cast<double>(static_cast<int64_t>(datum.as_num()))
+            || datum.as_num() < 1) {
+        *error_out = "Expected a positive integer or `null`, got " + datum.print();
+        return false;
+    }
+    *limit_out = static_cast<uint64_t>(datum.as_num());
+    return true;
+}
+
+bool convert_table_write_limits_from_datum(
+        const ql::datum_t &datum,
+        table_write_limits_t *limits_out,
+        std::string *error_out) {
+    converter_from_datum_object_t converter;
+    if (!converter.init(datum, error_out)) {
+        return false;
+    }
+    *limits_out = table_write_limits_t();
+
+    if (converter.has("writes_per_sec")) {
+        ql::datum_t rate_datum;
+        if (!converter.get("writes_per_sec", &rate_datum, error_out)) {
+            return false;
+        }
+        if (!convert_write_limit_from_datum(rate_datum, &limits_out->writes_per_sec,
+                                            error_out)) {
+            *error_out = "In `writes_per_sec`: " + *error_out;
+            return false;
+        }
+    }
+
+    if (converter.has("max_pending_writes")) {
+        ql::datum_t pending_datum;
+        if (!converter.get("max_pending_writes", &pending_datum, error_out)) {
+            return false;
+        }
+        if (!convert_write_limit_from_datum(pending_datum,
+                                            &limits_out->max_pending_writes,
+                                            error_out)) {
+            *error_out = "In `max_pending_writes`: " + *error_out;
+            return false;
+        }
+    }
+
+    if (!converter.check_no_extra_keys(error_out)) {
+        return false;
+    }
+
+    return true;
+}
+
+ql::datum_t convert_table_expiry_to_datum(
+        const table_expiry_t &expiry) {
+    ql::datum_object_builder_t builder;
+    builder.overwrite("index", static_cast<bool>(expiry.index)
+        ? ql::datum_t(datum_string_t(*expiry.index))
+        : ql::datum_t::null());
+    builder.overwrite("deletes_per_sec",
+        ql::datum_t(static_cast<double>(expiry.deletes_per_sec)));
+    return std::move(builder).to_datum();
+}
+
+bool convert_table_expiry_from_datum(
+        const ql::datum_t &datum,
+        table_expiry_t *expiry_out,
+        std::string *error_out) {
+    converter_from_datum_object_t converter;
+    if (!converter.init(datum, error_out)) {
+        return false;
+    }
+    *expiry_out = table_expiry_t();
+
+    if (converter.has("index")) {
+        ql::datum_t index_datum;
+        if (!converter.get("index", &index_datum, error_out)) {
+            return false;
+        }
+        if (index_datum.get_type() == ql::datum_t::R_STR) {
+            expiry_out->index = index_datum.as_str().to_std();
+        } else if (index_datum.get_type() != ql::datum_t::R_NULL) {
+            *error_out = "In `index`: Expected a string or `null`, got " +
+                index_datum.print();
+            return false;
+        }
+    }
+
+    if (converter.has("deletes_per_sec")) {
+        ql::datum_t rate_datum;
+        if (!converter.get("deletes_per_sec", &rate_datum, error_out)) {
+            return false;
+        }
+        if (rate_datum.get_type() != ql::datum_t::R_NUM
+                || rate_datum.as_num() != static_cast<double>(
+                    static_cast<int64_t>(rate_datum.as_num()))
+                || rate_datum.as_num() < 1) {
+            *error_out = "In `deletes_per_sec`: Expected a positive integer, got " +
+                rate_datum.print();
+            return false;
+        }
+        expiry_out->deletes_per_sec = static_cast<uint64_t>(rate_datum.as_num());
+    }
+
+    if (!converter.check_no_extra_keys(error_out)) {
+        return false;
+    }
+
+    return true;
+}
+
+bool convert_block_size_from_datum(
+        const ql::datum_t &datum,
+        uint64_t *block_size_out,
+        std::string *error_out) {
+    /* Leaf nodes address their contents with 16-bit offsets, which limits how big
+    the blocks can get. */
+    const uint64_t min_block_size = DEFAULT_BTREE_BLOCK_SIZE;
+    const uint64_t max_block_size = 32 * KILOBYTE;
+    if (datum.get_type() != ql::datum_t::R_NUM) {
+        *error_out = "Expected a number, got " + datum.print();
+        return false;
+    }
+    const double size = datum.as_num();
+    if (!(size >= min_block_size && size <= max_block_size)) {
+        *error_out = strprintf("The block size must be between %" PRIu64 " and %"
+                               PRIu64 " bytes, got %s.", min_block_size,
+                               max_block_size, datum.print().c_str());
+        return false;
+    }
+    const uint64_t block_size = size;
+    if (block_size != size || (block_size & (block_size - 1)) != 0) {
+        *error_out = "The block size must be a power of two, got " + datum.print();
+        return false;
+    }
+    *block_size_out = block_size;
+    return true;
+}
+
+bool convert_cpu_shards_from_datum(
+        const ql::datum_t &datum,
+        int32_t *cpu_shards_out,
+        std::string *error_out) {
+    if (datum.get_type() != ql::datum_t::R_NUM) {
+        *error_out = "Expected a number, got " + datum.print();
+        return false;
+    }
+    const double cpu_shards = datum.as_num();
+    if (!(cpu_shards >= 1 && cpu_shards <= MAX_CPU_SHARDING_FACTOR)
+            || cpu_shards != static_cast<int32_t>(cpu_shards)) {
+        *error_out = strprintf("The number of CPU shards must be an integer between 1 "
+                               "and %d, got %s.", MAX_CPU_SHARDING_FACTOR,
+                               datum.print().c_str());
+        return false;
+    }
+    *cpu_shards_out = static_cast<int32_t>(cpu_shards);
+    return true;
+}
+
+bool convert_compress_blocks_from_datum(
+        const ql::datum_t &datum,
+        bool *compress_blocks_out,
+        std::string *error_out) {
+    if (datum.get_type() != ql::datum_t::R_BOOL) {
+        *error_out = "Expected a boolean, got " + datum.print();
+        return false;
+    }
+    *compress_blocks_out = datum.as_bool();
+    return true;
+}
+
 ql::datum_t convert_table_config_shard_to_datum(
         const table_config_t::shard_t &shard,
         admin_identifier_format_t identifier_format,
@@ -297,6 +586,18 @@ ql::datum_t convert_table_config_to_datum(
             config.write_ack_config, identifier_format, server_config_client));
     builder.overwrite("durability",
         convert_durability_to_datum(config.durability));
+    builder.overwrite("cache",
+        convert_table_cache_config_to_datum(config.cache));
+    builder.overwrite("write_limits",
+        convert_table_write_limits_to_datum(config.write_limits));
+    builder.overwrite("expiry",
+        convert_table_expiry_to_datum(config.expiry));
+    builder.overwrite("block_size",
+        ql::datum_t(static_cast<double>(config.block_size)));
+    builder.overwrite("cpu_shards",
+        ql::datum_t(static_cast<double>(config.cpu_shards)));
+    builder.overwrite("compress_blocks",
+        ql::datum_t::boolean(config.compress_blocks));
     return std::move(builder).to_datum();
 }
 
@@ -441,6 +742,90 @@ bool convert_table_config_and_name_from_datum(
         config_out->durability = write_durability_t::HARD;
     }
 
+    if (existed_before || converter.has("cache")) {
+        ql::datum_t cache_datum;
+        if (!converter.get("cache", &cache_datum, error_out)) {
+            return false;
+        }
+        if (!convert_table_cache_config_from_datum(cache_datum, &config_out->cache,
+                error_out)) {
+            *error_out = "In `cache`: " + *error_out;
+            return false;
+        }
+    } else {
+        config_out->cache = table_cache_config_t();
+    }
+
+    if (existed_before || converter.has("write_limits")) {
+        ql::datum_t write_limits_datum;
+        if (!converter.get("write_limits", &write_limits_datum, error_out)) {
+            return false;
+        }
+        if (!convert_table_write_limits_from_datum(write_limits_datum,
+                &config_out->write_limits, error_out)) {
+            *error_out = "In `write_limits`: " + *error_out;
+            return false;
+        }
+    } else {
+        config_out->write_limits = table_write_limits_t();
+    }
+
+    if (existed_before || converter.has("expiry")) {
+        ql::datum_t expiry_datum;
+        if (!converter.get("expiry", &expiry_datum, error_out)) {
+            return false;
+        }
+        if (!convert_table_expiry_from_datum(expiry_datum, &config_out->expiry,
+                                             error_out)) {
+            *error_out = "In `expiry`: " + *error_out;
+            return false;
+        }
+    } else {
+        config_out->expiry = table_expiry_t();
+    }
+
+    if (existed_before || converter.has("block_size")) {
+        ql::datum_t block_size_datum;
+        if (!converter.get("block_size", &block_size_datum, error_out)) {
+            return false;
+        }
+        if (!convert_block_size_from_datum(block_size_datum, &config_out->block_size,
+                error_out)) {
+            *error_out = "In `block_size`: " + *error_out;
+            return false;
+        }
+    } else {
+        config_out->block_size = DEFAULT_BTREE_BLOCK_SIZE;
+    }
+
+    if (existed_before || converter.has("cpu_shards")) {
+        ql::datum_t cpu_shards_datum;
+        if (!converter.get("cpu_shards", &cpu_shards_datum, error_out)) {
+            return false;
+        }
+        if (!convert_cpu_shards_from_datum(cpu_shards_datum, &config_out->cpu_shards,
+                error_out)) {
+            *error_out = "In `cpu_shards`: " + *error_out;
+            return false;
+        }
+    } else {
+        config_out->cpu_shards = CPU_SHARDING_FACTOR;
+    }
+
+    if (existed_before || converter.has("compress_blocks")) {
+        ql::datum_t compress_blocks_datum;
+        if (!converter.get("compress_blocks", &compress_blocks_datum, error_out)) {
+            return false;
+        }
+        if (!convert_compress_blocks_from_datum(compress_blocks_datum,
+                &config_out->compress_blocks, error_out)) {
+            *error_out = "In `compress_blocks`: " + *error_out;
+            return false;
+        }
+    } else {
+        config_out->compress_blocks = false;
+    }
+
     write_ack_config_checker_t ack_checker(*config_out, all_metadata.servers);
     for (const table_config_t::shard_t &shard : config_out->shards) {
         std::set<server_id_t> replicas;
@@ -557,6 +942,15 @@ bool table_config_artificial_table_backend_t::write_row(
                 *error_out = "It's illegal to change a table's primary key.";
                 return false;
             }
+            /* The replicas of a table replicate each of their CPU shards separately,
+            so they all need to have the same ones. */
+            if (replication_info.config.cpu_shards != it->second.get_ref()
+                    .replication_info.get_ref().config.cpu_shards) {
+                *error_out = "It's illegal to change a table's `cpu_shards`. Create a "
+                    "new table with the number of CPU shards you want and copy the data "
+                    "into it instead.";
+                return false;
+            }
         }
 
         /* Decide on the sharding scheme for the table */
@@ -20,9 +20,72 @@ RDB_IMPL_SERIALIZABLE_2_SINCE_v1_16(table_config_t::shard_t,
 RDB_IMPL_EQUALITY_COMPARABLE_2(table_config_t::shard_t,
                                replicas, primary_replica);
 
-RDB_IMPL_SERIALIZABLE_3_SINCE_v1_16(table_config_t,
-                                    shards, write_ack_config, durability);
-RDB_IMPL_EQUALITY_COMPARABLE_3(table_config_t, shards, write_ack_config, durability);
+RDB_IMPL_SERIALIZABLE_3_SINCE_v1_16(table_cache_config_t,
+                                    weight, min_bytes, max_bytes);
+RDB_IMPL_EQUALITY_COMPARABLE_3(table_cache_config_t, weight, min_bytes, max_bytes);
+
+RDB_IMPL_SERIALIZABLE_2_SINCE_v1_16(table_write_limits_t,
+                                    writes_per_sec, max_pending_writes);
+RDB_IMPL_EQUALITY_COMPARABLE_2(table_write_limits_t,
+                               writes_per_sec, max_pending_writes);
+
+RDB_IMPL_SERIALIZABLE_2_SINCE_v1_16(table_expiry_t, index, deletes_per_sec);
+RDB_IMPL_EQUALITY_COMPARABLE_2(table_expiry_t, index, deletes_per_sec);
+
+template <cluster_version_t W>
+void serialize(write_message_t *wm, const table_config_t &config) {
+    serialize<W>(wm, config.shards);
+    serialize<W>(wm, config.write_ack_config);
+    serialize<W>(wm, config.durability);
+    serialize<W>(wm, config.cache);
+    serialize<W>(wm, config.write_limits);
+    serialize<W>(wm, config.expiry);
+    serialize<W>(wm, config.block_size);
+    serialize<W>(wm, config.cpu_shards);
+    serialize<W>(wm, config.compress_blocks);
+}
+INSTANTIATE_SERIALIZE_FOR_CLUSTER_AND_DISK(table_config_t);
+
+template <cluster_version_t W>
+archive_result_t deserialize(read_stream_t *s, table_config_t *config) {
+    archive_result_t res = archive_result_t::SUCCESS;
+    res = deserialize<W>(s, &config->shards);
+    if (bad(res)) { return res; }
+    res = deserialize<W>(s, &config->write_ack_config);
+    if (bad(res)) { return res; }
+    res = deserialize<W>(s, &config->durability);
+    if (bad(res)) { return res; }
+    /* Tables from before v2.1 didn't have a cache configuration, write limits, an
+    expiry, a block size, a number of CPU shards or block compression. */
+    if (W == cluster_version_t::v1_16 || W == cluster_version_t::v2_0) {
+        config->cache = table_cache_config_t();
+        config->write_limits = table_write_limits_t();
+        config->expiry = table_expiry_t();
+        config->block_size = DEFAULT_BTREE_BLOCK_SIZE;
+        config->cpu_shards = CPU_SHARDING_FACTOR;
+        config->compress_blocks = false;
+    } else {
+        res = deserialize<W>(s, &config->cache);
+        if (bad(res)) { return res; }
+        res = deserialize<W>(s, &config->write_limits);
+        if (bad(res)) { return res; }
+        res = deserialize<W>(s, &config->expiry);
+        if (bad(res)) { return res; }
+        res = deserialize<W>(s, &config->block_size);
+        if (bad(res)) { return res; }
+        res = deserialize<W>(s, &config->cpu_shards);
+        if (bad(res)) { return res; }
+        res = deserialize<W>(s, &config->compress_blocks);
+        if (bad(res)) { return res; }
+    }
+    return res;
+}
+INSTANTIATE_DESERIALIZE_SINCE_v1_16(table_config_t);
+
+RDB_IMPL_EQUALITY_COMPARABLE_9(table_config_t,
+                               shards, write_ack_config, durability, cache,
+                               write_limits, expiry, block_size, cpu_shards,
+                               compress_blocks);
 
 RDB_IMPL_SERIALIZABLE_1_SINCE_v1_16(table_shard_scheme_t, split_points);
 RDB_IMPL_EQUALITY_COMPARABLE_1(table_shard_scheme_t, split_points);
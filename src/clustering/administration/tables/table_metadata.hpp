@@ -8,12 +8,16 @@
 #include <utility>
 #include <vector>
 
+#include "errors.hpp"
+#include <boost/optional.hpp>
+
 #include "clustering/administration/servers/server_metadata.hpp"
 #include "clustering/administration/tables/database_metadata.hpp"
 #include "clustering/generic/nonoverlapping_regions.hpp"
 #include "clustering/reactor/blueprint.hpp"
 #include "clustering/reactor/directory_echo.hpp"
 #include "clustering/reactor/metadata.hpp"
+#include "config/args.hpp"
 #include "containers/cow_ptr.hpp"
 #include "containers/name_string.hpp"
 #include "containers/uuid.hpp"
@@ -48,11 +52,63 @@ RDB_DECLARE_EQUALITY_COMPARABLE(write_ack_config_t::req_t);
 RDB_DECLARE_SERIALIZABLE(write_ack_config_t);
 RDB_DECLARE_EQUALITY_COMPARABLE(write_ack_config_t);
 
+/* `table_cache_config_t` tells the cache balancer on each server how to treat the
+table's caches, relative to those of other tables. The limits apply to the total
+cache memory of the table's shards on one server. */
+
+class table_cache_config_t {
+public:
+    table_cache_config_t() : weight(1.0), min_bytes(0) { }
+    double weight;
+    uint64_t min_bytes;
+    /* An empty `max_bytes` means that there is no limit. */
+    boost::optional<uint64_t> max_bytes;
+};
+
+RDB_DECLARE_SERIALIZABLE(table_cache_config_t);
+RDB_DECLARE_EQUALITY_COMPARABLE(table_cache_config_t);
+
+/* `table_write_limits_t` bounds how many writes each of the table's primary replicas
+takes. Writes over a limit are turned away with an error that tells the client when
+to retry, instead of queueing up behind the others. Empty means no limit. */
+
+class table_write_limits_t {
+public:
+    /* Per primary replica, so per shard. */
+    boost::optional<uint64_t> writes_per_sec;
+    /* Writes that the primary replica has started but not yet finished. */
+    boost::optional<uint64_t> max_pending_writes;
+};
+
+RDB_DECLARE_SERIALIZABLE(table_write_limits_t);
+RDB_DECLARE_EQUALITY_COMPARABLE(table_write_limits_t);
+
+/* `table_expiry_t` makes the table's rows expire. Each primary replica deletes the
+rows whose value in the secondary index `index` is a time in the past, in batches of
+at most `deletes_per_sec` rows once a second. Empty `index` means rows don't expire.
+`index` may also name the primary key, for time series tables keyed by time; then the
+expired rows are found at the start of the primary btree without any secondary
+index. */
+
+class table_expiry_t {
+public:
+    table_expiry_t() : deletes_per_sec(DEFAULT_EXPIRY_DELETES_PER_SEC) { }
+    boost::optional<std::string> index;
+    uint64_t deletes_per_sec;
+};
+
+RDB_DECLARE_SERIALIZABLE(table_expiry_t);
+RDB_DECLARE_EQUALITY_COMPARABLE(table_expiry_t);
+
 /* `table_config_t` describes the contents of the `rethinkdb.table_config` artificial
 table. */
 
 class table_config_t {
 public:
+    table_config_t()
+        : block_size(DEFAULT_BTREE_BLOCK_SIZE), cpu_shards(CPU_SHARDING_FACTOR),
+          compress_blocks(false) { }
+
     class shard_t {
     public:
         std::set<server_id_t> replicas;
@@ -61,6 +117,23 @@ public:
     std::vector<shard_t> shards;
     write_ack_config_t write_ack_config;
     write_durability_t durability;
+    table_cache_config_t cache;
+    table_write_limits_t write_limits;
+    table_expiry_t expiry;
+    /* The block size of the table's data files, in bytes.  Bigger blocks store
+    bigger documents in fewer blocks, and so with fewer reads.  It is fixed when a data
+    file is created, so changing it only affects the files that are created
+    afterwards. */
+    uint64_t block_size;
+    /* How many stores (each with its own B-tree and thread) each replica splits the
+    table's data into by hash.  Small tables read faster with fewer of them and big
+    tables can use more cores with more.  Every replica has to use the same number,
+    so it's fixed when the table is created. */
+    int32_t cpu_shards;
+    /* Whether the table's data blocks are compressed before they're written to disk.
+    Blocks that are already on disk stay as they are, and the setting takes effect
+    the next time a server opens the table's data file. */
+    bool compress_blocks;
 };
 
 RDB_DECLARE_SERIALIZABLE(table_config_t::shard_t);
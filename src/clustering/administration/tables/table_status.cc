@@ -17,9 +17,29 @@ table_status_artificial_table_backend_t::table_status_artificial_table_backend_t
         directory_subs(directory_view,
             [this](const std::pair<peer_id_t, namespace_id_t> &key,
                    const namespace_directory_metadata_t *) {
+                cached_rows.erase(key.second);
                 notify_row(convert_uuid_to_datum(key.second));
-            })
-        { }
+            }),
+        semilattice_subs([this]() {
+                cached_rows.clear();
+                cached_servers_metadata = boost::none;
+            }, semilattice_view),
+        server_names_subs([this]() { cached_rows.clear(); }),
+        server_peers_subs([this]() { cached_rows.clear(); }) {
+    server_config_client->assert_thread();
+    {
+        watchable_t<std::multimap<name_string_t, server_id_t> >::freeze_t freeze(
+            server_config_client->get_name_to_server_id_map());
+        server_names_subs.reset(server_config_client->get_name_to_server_id_map(),
+                                &freeze);
+    }
+    {
+        watchable_t<std::map<peer_id_t, server_id_t> >::freeze_t freeze(
+            server_config_client->get_peer_id_to_server_id_map());
+        server_peers_subs.reset(server_config_client->get_peer_id_to_server_id_map(),
+                                &freeze);
+    }
+}
 
 table_status_artificial_table_backend_t::~table_status_artificial_table_backend_t() {
     begin_changefeed_destruction();
@@ -190,45 +210,58 @@ ql::datum_t convert_nothing_status_to_datum(
     }
 }
 
-ql::datum_t convert_table_status_shard_to_datum(
+/* Returns the reactor activities for the table on each connected server. Looking up
+each server's directory entry for the table directly is much cheaper than walking the
+whole directory, which has an entry for every table on every server. */
+static std::map<server_id_t, std::vector<reactor_activity_entry_t> >
+get_table_server_states(
         namespace_id_t table_id,
-        key_range_t range,
-        const table_config_t::shard_t &shard,
         watchable_map_t<std::pair<peer_id_t, namespace_id_t>,
                         namespace_directory_metadata_t> *dir,
+        server_config_client_t *server_config_client) {
+    std::map<server_id_t, std::vector<reactor_activity_entry_t> > server_states;
+    std::map<peer_id_t, server_id_t> peers =
+        server_config_client->get_peer_id_to_server_id_map()->get();
+    for (const auto &peer : peers) {
+        dir->read_key(std::make_pair(peer.first, table_id),
+            [&](const namespace_directory_metadata_t *value) {
+                if (value == nullptr) {
+                    return;
+                }
+                std::vector<reactor_activity_entry_t> *server_state =
+                    &server_states[peer.second];
+                for (const auto &pair : value->internal->activities) {
+                    server_state->push_back(pair.second);
+                }
+            });
+    }
+    return server_states;
+}
+
+ql::datum_t convert_table_status_shard_to_datum(
+        key_range_t range,
+        const table_config_t::shard_t &shard,
+        const std::map<server_id_t, std::vector<reactor_activity_entry_t> >
+            &table_server_states,
         admin_identifier_format_t identifier_format,
         server_config_client_t *server_config_client,
         const write_ack_config_checker_t &ack_checker,
         table_readiness_t *readiness_out) {
     /* `server_states` will contain one entry per connected server. That entry will be a
     vector with the current state of each hash-shard on the server whose key range
-    matches the expected range. */
+    matches the expected range. `server_state` may be left empty if the reactor doesn't
+    have a business card for this table, or if no entry has the same region as the
+    target region. */
     std::map<server_id_t, std::vector<reactor_activity_entry_t> > server_states;
-    dir->read_all(
-        [&](const std::pair<peer_id_t, namespace_id_t> &key,
-                const namespace_directory_metadata_t *value) {
-            if (key.second != table_id) {
-                return;
-            }
-            /* Translate peer ID to server ID */
-            boost::optional<server_id_t> server_id =
-                server_config_client->get_server_id_for_peer_id(key.first);
-            if (!static_cast<bool>(server_id)) {
-                /* This can occur as a race condition if the peer has just connected or just
-                disconnected */
-                return;
-            }
-            /* Extract activity from reactor business card. `server_state` may be left
-            empty if the reactor doesn't have a business card for this table, or if no
-            entry has the same region as the target region. */
-            std::vector<reactor_activity_entry_t> server_state;
-            for (const auto &pair : value->internal->activities) {
-                if (pair.second.region.inner == range) {
-                    server_state.push_back(pair.second);
-                }
+    for (const auto &table_server_state : table_server_states) {
+        std::vector<reactor_activity_entry_t> *server_state =
+            &server_states[table_server_state.first];
+        for (const reactor_activity_entry_t &entry : table_server_state.second) {
+            if (entry.region.inner == range) {
+                server_state->push_back(entry);
             }
-            server_states[*server_id] = std::move(server_state);
-        });
+        }
+    }
 
     ql::datum_object_builder_t builder;
 
@@ -322,6 +355,10 @@ ql::datum_t convert_table_status_shard_to_datum(
 
     builder.overwrite("replicas", std::move(array_builder).to_datum());
 
+    /* Together with the primary replica and the addresses in `server_status`, this lets
+    shard-aware clients send each write straight to the server that handles it. */
+    builder.overwrite("key_range", convert_key_range_to_datum(range));
+
     if (has_primary_replica) {
         if (ack_checker.check_acks(servers_for_acks)) {
             if (!is_unfinished) {
@@ -361,16 +398,18 @@ ql::datum_t convert_table_status_to_datum(
 
     write_ack_config_checker_t ack_checker(repli_info.config, server_md);
 
+    std::map<server_id_t, std::vector<reactor_activity_entry_t> > table_server_states =
+        get_table_server_states(table_id, dir, server_config_client);
+
     table_readiness_t readiness = table_readiness_t::finished;
     ql::datum_array_builder_t array_builder((ql::configured_limits_t::unlimited));
     for (size_t i = 0; i < repli_info.config.shards.size(); ++i) {
         table_readiness_t this_shard_readiness;
         array_builder.add(
             convert_table_status_shard_to_datum(
-                table_id,
                 repli_info.shard_scheme.get_shard_range(i),
                 repli_info.config.shards[i],
-                dir,
+                table_server_states,
                 identifier_format,
                 server_config_client,
                 ack_checker,
@@ -406,6 +445,14 @@ bool table_status_artificial_table_backend_t::format_row(
         ql::datum_t *row_out,
         UNUSED std::string *error_out) {
     assert_thread();
+    auto it = cached_rows.find(table_id);
+    if (it != cached_rows.end()) {
+        *row_out = it->second;
+        return true;
+    }
+    if (!static_cast<bool>(cached_servers_metadata)) {
+        cached_servers_metadata = semilattice_view->get().servers;
+    }
     *row_out = convert_table_status_to_datum(
         table_name,
         db_name_or_uuid,
@@ -413,9 +460,10 @@ bool table_status_artificial_table_backend_t::format_row(
         metadata.replication_info.get_ref(),
         directory_view,
         identifier_format,
-        semilattice_view->get().servers,
+        *cached_servers_metadata,
         server_config_client,
         nullptr);
+    cached_rows.insert(std::make_pair(table_id, *row_out));
     return true;
 }
 
@@ -465,7 +513,7 @@ table_wait_result_t wait_for_table_readiness(
             ql::datum_t row = convert_table_status_to_datum(table_name, db_name_or_uuid,
                 table_id, it->second.get_ref().replication_info.get_ref(),
                 backend->directory_view, backend->identifier_format,
-                backend->semilattice_view->get().servers, backend->server_config_client,
+                md.servers, backend->server_config_client,
                 &readiness);
 
             if (readiness >= wait_readiness) {
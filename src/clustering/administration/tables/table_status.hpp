@@ -2,6 +2,7 @@
 #ifndef CLUSTERING_ADMINISTRATION_TABLES_TABLE_STATUS_HPP_
 #define CLUSTERING_ADMINISTRATION_TABLES_TABLE_STATUS_HPP_
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -69,8 +70,23 @@ private:
     watchable_map_t<std::pair<peer_id_t, namespace_id_t>,
         namespace_directory_metadata_t> *directory_view;
     server_config_client_t *server_config_client;
+
+    /* Formatted rows, so that reading the whole table only recomputes the status of
+    the tables that changed since the last read. A directory change drops the row for
+    its table; a change to the cluster metadata or the set of servers drops them all,
+    since those can affect any row. Only accessed on the home thread. */
+    std::map<namespace_id_t, ql::datum_t> cached_rows;
+    /* Copying the cluster metadata for every row adds up with thousands of tables, so
+    we also keep the servers' metadata around until it changes. */
+    boost::optional<servers_semilattice_metadata_t> cached_servers_metadata;
+
     watchable_map_t<std::pair<peer_id_t, namespace_id_t>,
         namespace_directory_metadata_t>::all_subs_t directory_subs;
+    semilattice_readwrite_view_t<cluster_semilattice_metadata_t>::subscription_t
+        semilattice_subs;
+    watchable_t<std::multimap<name_string_t, server_id_t> >::subscription_t
+        server_names_subs;
+    watchable_t<std::map<peer_id_t, server_id_t> >::subscription_t server_peers_subs;
 };
 
 #endif /* CLUSTERING_ADMINISTRATION_TABLES_TABLE_STATUS_HPP_ */
@@ -1,6 +1,7 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/immediate_consistency/branch/backfillee.hpp"
 
+#include <algorithm>
 #include <functional>
 
 #include "errors.hpp"
@@ -16,6 +17,7 @@
 #include "containers/death_runner.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "store_view.hpp"
+#include "time.hpp"
 
 // Must be <= than MAX_CHUNKS_OUT in backfiller.cc
 #define ALLOCATION_CHUNK 8
@@ -24,7 +26,17 @@
 // their impact on other queries.
 // (See https://github.com/rethinkdb/rethinkdb/issues/2392 for some
 //  empirical data)
+// This is where the number of chunks we apply concurrently starts out. It then
+// adapts to how quickly the store applies chunks, between 1 and
+// MAX_CHUNK_PROCESSING_CONCURRENCY.
 #define CHUNK_PROCESSING_CONCURRENCY 4
+#define MAX_CHUNK_PROCESSING_CONCURRENCY 16
+
+// If applying a chunk takes longer than this, the store is busy (usually with
+// foreground queries), and we halve the concurrency. Otherwise we increase it
+// by one every CHUNK_PROCESSING_CONCURRENCY_INCREASE_INTERVAL chunks.
+#define CHUNK_PROCESSING_TARGET_LATENCY_MS 100
+#define CHUNK_PROCESSING_CONCURRENCY_INCREASE_INTERVAL 16
 
 struct backfill_queue_entry_t {
     // TODO: The fact that fifo_enforcer_queue_t requires a default
@@ -63,14 +75,26 @@ public:
         progress_out(_progress_out),
         unacked_chunks(0),
         done_message_arrived(false),
-        num_outstanding_chunks(0)
+        num_outstanding_chunks(0),
+        concurrency_sem(CHUNK_PROCESSING_CONCURRENCY),
+        concurrency(CHUNK_PROCESSING_CONCURRENCY),
+        chunks_since_concurrency_change(0)
     { }
 
     void apply_backfill_chunk(fifo_enforcer_write_token_t chunk_token, const backfill_chunk_t& chunk, signal_t *interruptor) {
         // No re-ordering must happen up to the point where we obtain a
         // token from the store.
         // This is also asserted by `chunk_queue->finish_write(chunk_token)`.
+        new_semaphore_acq_t concurrency_acq;
         try {
+            // The semaphore hands out its slots in order, and
+            // `wait_lazily_ordered()` keeps that order.
+            concurrency_acq.init(&concurrency_sem, 1);
+            wait_any_t waiter(concurrency_acq.acquisition_signal(), interruptor);
+            waiter.wait_lazily_ordered();
+            if (interruptor->is_pulsed()) {
+                throw interrupted_exc_t();
+            }
             svs->throttle_backfill_chunk(interruptor);
         } catch (const interrupted_exc_t &) {
             chunk_queue->finish_write(chunk_token);
@@ -81,7 +105,33 @@ public:
         svs->new_write_token(&token);
         chunk_queue->finish_write(chunk_token);
 
+        const ticks_t start_ticks = get_ticks();
         svs->receive_backfill(chunk, &token, interruptor);
+        adapt_concurrency(get_ticks() - start_ticks);
+    }
+
+    /* Additive increase, multiplicative decrease: keep applying more chunks at a
+    time while the store keeps up, and back off quickly once it starts to slow
+    down. Foreground queries compete for the same superblock and cache, so this
+    leaves them room when the server is busy and lets backfills go at full speed
+    when it isn't. */
+    void adapt_concurrency(ticks_t chunk_ticks) {
+        assert_thread();
+        ++chunks_since_concurrency_change;
+        if (chunk_ticks > CHUNK_PROCESSING_TARGET_LATENCY_MS * MILLION) {
+            if (concurrency > 1) {
+                concurrency = std::max<int64_t>(1, concurrency / 2);
+                concurrency_sem.set_capacity(concurrency);
+            }
+            chunks_since_concurrency_change = 0;
+        } else if (chunks_since_concurrency_change
+                       >= CHUNK_PROCESSING_CONCURRENCY_INCREASE_INTERVAL) {
+            if (concurrency < MAX_CHUNK_PROCESSING_CONCURRENCY) {
+                ++concurrency;
+                concurrency_sem.set_capacity(concurrency);
+            }
+            chunks_since_concurrency_change = 0;
+        }
     }
 
     void coro_pool_callback(backfill_queue_entry_t chunk, signal_t *interruptor) {
@@ -160,6 +210,11 @@ private:
     bool done_message_arrived;
     int num_outstanding_chunks;
 
+    // Limits how many chunks we apply at the same time, see `adapt_concurrency()`.
+    new_semaphore_t concurrency_sem;
+    int64_t concurrency;
+    int chunks_since_concurrency_change;
+
     DISABLE_COPYING(chunk_callback_t);
 };
 
@@ -360,7 +415,7 @@ void backfillee(
         chunk_callback_t chunk_callback(
             svs, &chunk_queue, mailbox_manager, allocation_mailbox, progress_out);
 
-        coro_pool_t<backfill_queue_entry_t> backfill_workers(CHUNK_PROCESSING_CONCURRENCY,
+        coro_pool_t<backfill_queue_entry_t> backfill_workers(MAX_CHUNK_PROCESSING_CONCURRENCY,
                                                              &chunk_queue, &chunk_callback);
 
         /* Now wait for the backfill to be over */
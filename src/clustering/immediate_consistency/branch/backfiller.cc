@@ -15,7 +15,9 @@
 // The number of backfill chunks that may be sent but not yet acknowledged (~processed)
 // by the receiver.
 // Each chunk can contain multiple key/value pairs, but its (approximate) maximum
-// size is limited by BACKFILL_MAX_KVPAIRS_SIZE as defined in btree/backfill.hpp.
+// size is limited by BACKFILL_MAX_KVPAIRS_SIZE (or by
+// BACKFILL_FROM_SCRATCH_MAX_KVPAIRS_SIZE for backfills that start from scratch) as
+// defined in btree/backfill.hpp.
 // When setting this value, keep memory consumption in mind.
 // Must be >= ALLOCATION_CHUNK in backfillee.cc, or backfilling will stall and
 // never finish.
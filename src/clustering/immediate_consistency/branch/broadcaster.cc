@@ -216,6 +216,8 @@ public:
                                  &background_write_caller),
         controller(c),
         latest_acked_write(state_timestamp_t::zero()),
+        write_ack_mailbox(controller->mailbox_manager,
+            boost::bind(&dispatchee_t::on_write_ack, this, _1, _2)),
         upgrade_mailbox(controller->mailbox_manager,
             boost::bind(&dispatchee_t::upgrade, this, _1, _2, _3)),
         downgrade_mailbox(controller->mailbox_manager,
@@ -271,7 +273,44 @@ public:
         latest_acked_write = std::max(latest_acked_write, ts);
     }
 
+    /* A remote listener acknowledges all the writes up to some timestamp at
+    once. So rather than having a mailbox for every write, we register a
+    `write_ack_waiter_t` for the write's timestamp; it gets pulsed once the
+    listener has acknowledged the write. */
+    class write_ack_waiter_t : public cond_t {
+    public:
+        write_ack_waiter_t(dispatchee_t *_parent, state_timestamp_t _timestamp)
+                : parent(_parent), timestamp(_timestamp) {
+            DEBUG_VAR bool inserted = parent->write_ack_waiters.insert(
+                std::make_pair(timestamp, this)).second;
+            rassert(inserted);
+        }
+        ~write_ack_waiter_t() {
+            if (!is_pulsed()) {
+                parent->write_ack_waiters.erase(timestamp);
+            }
+        }
+    private:
+        dispatchee_t *parent;
+        state_timestamp_t timestamp;
+        DISABLE_COPYING(write_ack_waiter_t);
+    };
+
+    listener_business_card_t::write_ack_mailbox_t::address_t get_write_ack_address() {
+        return write_ack_mailbox.get_address();
+    }
+
 private:
+    void on_write_ack(UNUSED signal_t *interruptor, state_timestamp_t timestamp)
+            THROWS_NOTHING {
+        while (!write_ack_waiters.empty()
+               && write_ack_waiters.begin()->first <= timestamp) {
+            write_ack_waiter_t *waiter = write_ack_waiters.begin()->second;
+            write_ack_waiters.erase(write_ack_waiters.begin());
+            waiter->pulse();
+        }
+    }
+
     /* The constructor spawns `send_intro()` in the background. */
     void send_intro(listener_business_card_t to_send_intro_to,
                     state_timestamp_t intro_timestamp,
@@ -355,7 +394,10 @@ private:
 
     state_timestamp_t latest_acked_write;
 
+    std::map<state_timestamp_t, write_ack_waiter_t *> write_ack_waiters;
+
     auto_drainer_t drainer;
+    listener_business_card_t::write_ack_mailbox_t write_ack_mailbox;
     listener_business_card_t::upgrade_mailbox_t upgrade_mailbox;
     listener_business_card_t::downgrade_mailbox_t downgrade_mailbox;
 
@@ -391,15 +433,12 @@ void broadcaster_t::listener_write(
     if (mirror->local_listener != NULL) {
         mirror->local_listener->local_write(w, ts, order_token, token, interruptor);
     } else {
-        cond_t ack_cond;
-        mailbox_t<void()> ack_mailbox(
-            mailbox_manager,
-            [&](signal_t *) { ack_cond.pulse(); });
+        dispatchee_t::write_ack_waiter_t ack_waiter(mirror, ts);
 
         send(mailbox_manager, mirror->write_mailbox,
-             w, ts, order_token, token, ack_mailbox.get_address());
+             w, ts, order_token, token, mirror->get_write_ack_address());
 
-        wait_interruptible(&ack_cond, interruptor);
+        wait_interruptible(&ack_waiter, interruptor);
     }
 
     /* Update latest acked write on the distpatchee so we can route queries
@@ -664,6 +703,7 @@ void broadcaster_t::background_writeread(
             if (write_ref.get()->callback != NULL) {
                 guarantee(write_ref.get()->callback->write == write_ref.get().get());
                 write_ref.get()->callback->write = NULL;
+                response.versions[branch_id] = write_ref.get()->timestamp;
                 write_ref.get()->callback->on_success(response);
                 write_ref.get()->callback = NULL;
             }
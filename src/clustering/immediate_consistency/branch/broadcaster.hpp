@@ -29,6 +29,20 @@ public:
     virtual bool is_acceptable_ack_set(const std::set<server_id_t> &acks) const = 0;
     virtual write_durability_t get_write_durability() const = 0;
 
+    /* How many writes per second the primary replica takes, and how many it lets be
+    in progress at once, before it turns writes away. Zero means no limit. These
+    may be called on any thread. */
+    virtual uint64_t get_max_writes_per_sec() const { return 0; }
+    virtual uint64_t get_max_pending_writes() const { return 0; }
+
+    /* The secondary index whose values are the times the table's rows expire at, or
+    an empty string if they don't expire; and how many expired rows the primary
+    replica deletes per second. The primary key is needed to delete them. These may
+    be called on any thread. */
+    virtual std::string get_expiry_index() const { return std::string(); }
+    virtual uint64_t get_expiry_deletes_per_sec() const { return 0; }
+    virtual std::string get_primary_key() const { return std::string(); }
+
     ack_checker_t() { }
 protected:
     virtual ~ack_checker_t() { }
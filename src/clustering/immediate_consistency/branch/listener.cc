@@ -24,6 +24,11 @@
 when draining the write queue after completing a backfill. */
 #define WRITE_QUEUE_CORO_POOL_SIZE 64
 
+/* Writes that don't overlap any write that's still being applied don't take up one
+of those coroutines; `WRITE_QUEUE_MAX_DETACHED_WRITES` is how many of them can be
+applied at the same time. */
+#define WRITE_QUEUE_MAX_DETACHED_WRITES 1024
+
 /* When we have caught up to the primary replica to within
 `WRITE_QUEUE_SEMAPHORE_LONG_TERM_CAPACITY` elements, then we consider ourselves
 to be up-to-date. */
@@ -85,6 +90,9 @@ listener_t::listener_t(const base_path_t &base_path,
                  &perfmon_collection_),
     write_queue_semaphore_(SEMAPHORE_NO_LIMIT,
         WRITE_QUEUE_SEMAPHORE_TRICKLE_FRACTION),
+    num_detached_writes_(0),
+    write_ack_timestamp_(state_timestamp_t::zero()),
+    write_ack_scheduled_(false),
     write_mailbox_(mailbox_manager_,
         std::bind(&listener_t::on_write, this, ph::_1, ph::_2, ph::_3, ph::_4, ph::_5, ph::_6)),
     writeread_mailbox_(mailbox_manager_,
@@ -262,6 +270,9 @@ listener_t::listener_t(const base_path_t &base_path,
     write_queue_(io_backender, serializer_filepath_t(base_path, "backfill-serialization-" + uuid_to_str(uuid_)), &perfmon_collection_),
     write_queue_semaphore_(WRITE_QUEUE_SEMAPHORE_LONG_TERM_CAPACITY,
         WRITE_QUEUE_SEMAPHORE_TRICKLE_FRACTION),
+    num_detached_writes_(0),
+    write_ack_timestamp_(state_timestamp_t::zero()),
+    write_ack_scheduled_(false),
     write_mailbox_(mailbox_manager_,
         std::bind(&listener_t::on_write, this, ph::_1, ph::_2, ph::_3, ph::_4, ph::_5, ph::_6)),
     writeread_mailbox_(mailbox_manager_,
@@ -409,16 +420,36 @@ void listener_t::on_write(
         state_timestamp_t timestamp,
         order_token_t order_token,
         fifo_enforcer_write_token_t fifo_token,
-        mailbox_addr_t<void()> ack_addr)
+        listener_business_card_t::write_ack_mailbox_t::address_t ack_addr)
         THROWS_NOTHING {
     try {
         local_write(write, timestamp, order_token, fifo_token, interruptor);
-        send(mailbox_manager_, ack_addr);
     } catch (const interrupted_exc_t &) {
-        /* pass */
+        return;
+    }
+
+    /* `local_write()` queues up writes in the order of their timestamps, so by
+    now every write up to `timestamp` is queued up. */
+    if (write_ack_scheduled_ && !(write_ack_addr_ == ack_addr)) {
+        send(mailbox_manager_, write_ack_addr_, write_ack_timestamp_);
+        write_ack_timestamp_ = state_timestamp_t::zero();
+    }
+    write_ack_addr_ = ack_addr;
+    write_ack_timestamp_ = std::max(write_ack_timestamp_, timestamp);
+    if (!write_ack_scheduled_) {
+        write_ack_scheduled_ = true;
+        coro_t::spawn_sometime(std::bind(&listener_t::send_write_ack, this,
+                                         auto_drainer_t::lock_t(&drainer_)));
     }
 }
 
+void listener_t::send_write_ack(UNUSED auto_drainer_t::lock_t keepalive)
+        THROWS_NOTHING {
+    guarantee(write_ack_scheduled_);
+    write_ack_scheduled_ = false;
+    send(mailbox_manager_, write_ack_addr_, write_ack_timestamp_);
+}
+
 void listener_t::local_write(const write_t &write,
         state_timestamp_t timestamp,
         order_token_t order_token,
@@ -448,24 +479,81 @@ void listener_t::perform_enqueued_write(const write_queue_entry_t &qe,
 
     write_token_t write_token;
     fifo_enforcer_write_token_t mark_write_done_token;
+    multimap_insertion_sentry_t<state_timestamp_t, region_t> in_flight;
     {
         fifo_enforcer_sink_t::exit_write_t fifo_exit(&store_entrance_sink_, qe.fifo_token);
         if (qe.timestamp <= backfill_end_timestamp) {
             return;
         }
         wait_interruptible(&fifo_exit, interruptor);
-        advance_current_timestamp_and_pulse_waiters(qe.timestamp);
 
-        // To make sure that writes get processed by the store in the right order.
-        svs_->new_write_token(&write_token);
+        /* Inside the store, a write mostly waits for the writes that touch the same
+        keys or leaves, and for the superblock, which it only holds briefly. So if
+        this write doesn't overlap any write that's still being applied, we apply it
+        in a coroutine of its own and free up this one for the next write; that way
+        we apply as many writes at once as the primary does. The writes that do
+        overlap keep their coroutine, which limits how many can pile up behind a busy
+        key. Either way the write gets in line for the store before we give up our
+        place in `store_entrance_sink_`, so writes to the same key are still applied
+        in timestamp order. */
+        if (num_detached_writes_ < WRITE_QUEUE_MAX_DETACHED_WRITES
+                && !overlaps_in_flight_write(qe.write.get_region())) {
+            // `perform_detached_write()` calls `start_enqueued_write()` before it
+            // blocks for the first time.
+            coro_t::spawn_now_dangerously(std::bind(
+                &listener_t::perform_detached_write, this, qe,
+                auto_drainer_t::lock_t(&detached_writes_drainer_)));
+            return;
+        }
+        start_enqueued_write(qe, &write_token, &mark_write_done_token, &in_flight);
+    }
 
-        // To make sure that we mark writes done in the right order
-        mark_write_done_token = mark_done_fifo_source_.enter_write();
+    finish_enqueued_write(qe, &write_token, mark_write_done_token, interruptor);
+}
+
+void listener_t::perform_detached_write(const write_queue_entry_t &qe,
+                                        auto_drainer_t::lock_t keepalive)
+        THROWS_NOTHING {
+    ++num_detached_writes_;
+    write_token_t write_token;
+    fifo_enforcer_write_token_t mark_write_done_token;
+    multimap_insertion_sentry_t<state_timestamp_t, region_t> in_flight;
+    start_enqueued_write(qe, &write_token, &mark_write_done_token, &in_flight);
+    try {
+        finish_enqueued_write(qe, &write_token, mark_write_done_token,
+                              keepalive.get_drain_signal());
+    } catch (const interrupted_exc_t &) {
+        /* pass */
     }
+    --num_detached_writes_;
+}
+
+void listener_t::start_enqueued_write(
+        const write_queue_entry_t &qe,
+        write_token_t *write_token_out,
+        fifo_enforcer_write_token_t *mark_write_done_token_out,
+        multimap_insertion_sentry_t<state_timestamp_t, region_t> *in_flight_out) {
+    advance_current_timestamp_and_pulse_waiters(qe.timestamp);
+
+    // To make sure that writes get processed by the store in the right order.
+    svs_->new_write_token(write_token_out);
+
+    // To make sure that we mark writes done in the right order
+    *mark_write_done_token_out = mark_done_fifo_source_.enter_write();
 
+    in_flight_out->reset(&in_flight_write_regions_, qe.timestamp,
+                         qe.write.get_region());
+}
+
+void listener_t::finish_enqueued_write(
+        const write_queue_entry_t &qe,
+        write_token_t *write_token,
+        const fifo_enforcer_write_token_t &mark_write_done_token,
+        signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t) {
 #ifndef NDEBUG
-        version_leq_metainfo_checker_callback_t metainfo_checker_callback(qe.timestamp.pred());
-        metainfo_checker_t metainfo_checker(&metainfo_checker_callback, svs_->get_region());
+    version_leq_metainfo_checker_callback_t metainfo_checker_callback(qe.timestamp.pred());
+    metainfo_checker_t metainfo_checker(&metainfo_checker_callback, svs_->get_region());
 #endif
 
     write_response_t response;
@@ -482,7 +570,7 @@ void listener_t::perform_enqueued_write(const write_queue_entry_t &qe,
         write_durability_t::SOFT,
         qe.timestamp,
         qe.order_token,
-        &write_token,
+        write_token,
         interruptor);
 
     // Mark the write done with the read_min_timestamp_enforcer_ so reads that have
@@ -490,6 +578,15 @@ void listener_t::perform_enqueued_write(const write_queue_entry_t &qe,
     mark_write_done(qe.timestamp, mark_write_done_token);
 }
 
+bool listener_t::overlaps_in_flight_write(const region_t &region) const {
+    for (const auto &pair : in_flight_write_regions_) {
+        if (region_overlaps(pair.second, region)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void listener_t::on_writeread(
         signal_t *interruptor,
         const write_t &write,
@@ -631,6 +728,15 @@ void listener_t::wait_for_version(state_timestamp_t timestamp, signal_t *interru
     }
 }
 
+void listener_t::wait_for_write_done(state_timestamp_t timestamp,
+                                     signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t) {
+    auto_drainer_t::lock_t keepalive = drainer_.lock();
+    wait_any_t combined_interruptor(keepalive.get_drain_signal(), interruptor);
+    read_min_timestamp_enforcer_.wait_interruptible(
+        min_timestamp_token_t(timestamp), &combined_interruptor);
+}
+
 void listener_t::advance_current_timestamp_and_pulse_waiters(state_timestamp_t timestamp) {
     guarantee(timestamp == current_timestamp_.next());
     current_timestamp_ = timestamp;
@@ -13,6 +13,7 @@
 #include "concurrency/promise.hpp"
 #include "concurrency/queue/disk_backed_queue_wrapper.hpp"
 #include "concurrency/semaphore.hpp"
+#include "containers/map_sentries.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "serializer/types.hpp"
 #include "timestamps.hpp"
@@ -124,6 +125,12 @@ public:
 
     void wait_for_version(state_timestamp_t timestamp, signal_t *interruptor);
 
+    /* Unlike `wait_for_version()`, which returns as soon as the write with the given
+    timestamp has started, this waits until it and all earlier writes have been
+    applied to the store, so that a read that starts afterwards sees them. */
+    void wait_for_write_done(state_timestamp_t timestamp, signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t);
+
     const listener_intro_t &registration_done_cond_value() const {
         return registration_done_cond_.wait();
     }
@@ -187,12 +194,41 @@ private:
             state_timestamp_t timestamp,
             order_token_t order_token,
             fifo_enforcer_write_token_t fifo_token,
-            mailbox_addr_t<void()> ack_addr)
+            listener_business_card_t::write_ack_mailbox_t::address_t ack_addr)
         THROWS_NOTHING;
 
+    /* `on_write()` doesn't acknowledge each write on its own. It records the
+    latest write that it has queued up and spawns `send_write_ack()`, which then
+    acknowledges all of the writes that have come in since in a single message. */
+    void send_write_ack(auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
+
     void perform_enqueued_write(const write_queue_entry_t &serialized_write, state_timestamp_t backfill_end_timestamp, signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t);
 
+    /* `perform_detached_write()` applies a write from the write queue in a coroutine
+    of its own. It's spawned by `perform_enqueued_write()` for writes that don't
+    overlap any of the writes that are still being applied. */
+    void perform_detached_write(const write_queue_entry_t &qe,
+                                auto_drainer_t::lock_t keepalive) THROWS_NOTHING;
+
+    /* `start_enqueued_write()` gets a write from the write queue in line for the
+    store. It must be called while holding the write's place in
+    `store_entrance_sink_`, and doesn't block. `finish_enqueued_write()` then
+    applies it. */
+    void start_enqueued_write(
+            const write_queue_entry_t &qe,
+            write_token_t *write_token_out,
+            fifo_enforcer_write_token_t *mark_write_done_token_out,
+            multimap_insertion_sentry_t<state_timestamp_t, region_t> *in_flight_out);
+    void finish_enqueued_write(
+            const write_queue_entry_t &qe,
+            write_token_t *write_token,
+            const fifo_enforcer_write_token_t &mark_write_done_token,
+            signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t);
+
+    bool overlaps_in_flight_write(const region_t &region) const;
+
     /* See the note at the place where `writeread_mailbox` is declared for an
     explanation of why `on_writeread()` and `on_read()` are here. */
 
@@ -273,12 +309,25 @@ private:
     adjustable_semaphore_t write_queue_semaphore_;
     cond_t write_queue_has_drained_;
 
+    /* The regions of the writes from the write queue that have gotten in line for
+    the store but haven't been applied yet, by timestamp. */
+    std::multimap<state_timestamp_t, region_t> in_flight_write_regions_;
+
+    /* `perform_detached_write()` coroutines. They're drained after
+    `write_queue_coro_pool_` is destroyed, because that's what spawns them. */
+    size_t num_detached_writes_;
+    auto_drainer_t detached_writes_drainer_;
+
     /* Destroying `write_queue_coro_pool` will stop any invocations of
     `perform_enqueued_write()`. We mustn't access any member variables defined
     below `write_queue_coro_pool` from within `perform_enqueued_write()`,
     because their destructors might have been called. */
     scoped_ptr_t<coro_pool_t<write_queue_entry_t> > write_queue_coro_pool_;
 
+    listener_business_card_t::write_ack_mailbox_t::address_t write_ack_addr_;
+    state_timestamp_t write_ack_timestamp_;
+    bool write_ack_scheduled_;
+
     auto_drainer_t drainer_;
 
     listener_business_card_t::write_mailbox_t write_mailbox_;
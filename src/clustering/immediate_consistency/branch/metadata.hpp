@@ -28,11 +28,16 @@ public:
     /* These are the types of mailboxes that the master uses to communicate with
     the mirrors. */
 
+    /* The mirror acknowledges writes by sending the timestamp of the latest
+    write it has queued up to `ack_addr`. That acknowledges every write up to
+    that timestamp, so it can acknowledge several writes with one message. */
+    typedef mailbox_t<void(state_timestamp_t)> write_ack_mailbox_t;
+
     typedef mailbox_t<void(write_t,
                            state_timestamp_t,
                            order_token_t,
                            fifo_enforcer_write_token_t,
-                           mailbox_addr_t<void()> ack_addr)> write_mailbox_t;
+                           write_ack_mailbox_t::address_t ack_addr)> write_mailbox_t;
 
     typedef mailbox_t<void(write_t,
                            state_timestamp_t,
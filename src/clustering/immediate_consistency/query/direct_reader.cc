@@ -1,16 +1,19 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "clustering/immediate_consistency/query/direct_reader.hpp"
 
+#include "clustering/immediate_consistency/branch/listener.hpp"
 #include "protocol_api.hpp"
 #include "store_view.hpp"
 
 direct_reader_t::direct_reader_t(
         mailbox_manager_t *mm,
-        store_view_t *svs_) :
+        store_view_t *svs_,
+        listener_t *listener_) :
     mailbox_manager(mm),
     svs(svs_),
+    listener(listener_),
     read_mailbox(mm, std::bind(&direct_reader_t::on_read, this,
-                               ph::_1, ph::_2, ph::_3))
+                               ph::_1, ph::_2, ph::_3, ph::_4))
     { }
 
 direct_reader_business_card_t direct_reader_t::get_business_card() {
@@ -20,9 +23,18 @@ direct_reader_business_card_t direct_reader_t::get_business_card() {
 void direct_reader_t::on_read(
         signal_t *interruptor,
         const read_t &read,
+        state_timestamp_t min_timestamp,
         const mailbox_addr_t<void(read_response_t)> &cont) {
 
     try {
+        /* The cluster only asks replicas that are keeping up with the primary to
+        wait for a write.  The write has to have been applied to the store, not
+        just started, for the read to see it. */
+        if (min_timestamp != state_timestamp_t::zero()) {
+            guarantee(listener != NULL);
+            listener->wait_for_write_done(min_timestamp, interruptor);
+        }
+
         /* Leave the token empty. We're not actually interested in ordering here. */
         read_token_t token;
 
@@ -5,19 +5,24 @@
 #include "clustering/immediate_consistency/query/direct_reader_metadata.hpp"
 #include "concurrency/fifo_checker.hpp"
 
+class listener_t;
 class store_view_t;
 
 /* For each primary or secondary replica of each shard, there is a `direct_reader_t`.
 The `direct_reader_t` allows the `cluster_namespace_interface_t` to bypass the
 `broadcaster_t` and read directly from the B-tree itself. This reduces network traffic
 and is possible even when the primary replica is unavailable, but the data it returns
-might be out of date. */
+might be out of date.
+
+If the replica is keeping up with a primary, `listener` is its `listener_t`, and reads
+can ask to wait until it has caught up with some write. */
 
 class direct_reader_t {
 public:
     direct_reader_t(
             mailbox_manager_t *mm,
-            store_view_t *svs);
+            store_view_t *svs,
+            listener_t *listener = NULL);
 
     direct_reader_business_card_t get_business_card();
 
@@ -25,10 +30,12 @@ private:
     void on_read(
             signal_t *interruptor,
             const read_t &,
+            state_timestamp_t min_timestamp,
             const mailbox_addr_t<void(read_response_t)> &);
 
     mailbox_manager_t *mailbox_manager;
     store_view_t *svs;
+    listener_t *listener;
 
     order_source_t order_source;  // TODO: order_token_t::ignore
 
@@ -10,8 +10,11 @@ is a primary or secondary replica for. */
 
 class direct_reader_business_card_t {
 public:
+    /* The `state_timestamp_t` is a version of the replica's branch that the read has
+    to wait for, or zero. */
     typedef mailbox_t< void(
             read_t,
+            state_timestamp_t,
             mailbox_addr_t< void(read_response_t)>
             )> read_mailbox_t;
 
@@ -1,7 +1,15 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 #include "clustering/immediate_consistency/query/master.hpp"
 
+#include <math.h>
+
+#include <algorithm>
+
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/wait_any.hpp"
 #include "containers/archive/boost_types.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
 
 /* If the master has received and not yet processed more than
    `MAX_OUTSTANDING_MASTER_REQUESTS` requests, clients will be throttled. This limit
@@ -9,20 +17,113 @@
    master and a number of multi_throttling_client_t instances on the client nodes. */
 const int MAX_OUTSTANDING_MASTER_REQUESTS = 2000;
 
+/* When a write is turned away because too many are pending, we don't know when one
+will finish, so we tell the client to retry after this long. */
+const int64_t PENDING_WRITES_RETRY_AFTER_MS = 100;
+
 master_t::master_t(mailbox_manager_t *mm, ack_checker_t *ac,
                    region_t r, broadcaster_t *b) THROWS_ONLY(interrupted_exc_t)
     : mailbox_manager(mm),
       ack_checker(ac),
       broadcaster(b),
       region(r),
+      write_tokens(0),
+      write_tokens_refilled(get_ticks()),
+      pending_writes(0),
       multi_throttling_server(mm, this, MAX_OUTSTANDING_MASTER_REQUESTS) {
     guarantee(ack_checker);
+    coro_t::spawn_sometime(std::bind(&master_t::expire_rows, this, drainer.lock()));
 }
 
 master_t::~master_t() {
     shutdown_cond.pulse();
 }
 
+bool master_t::admit_write(int64_t *retry_after_ms_out) {
+    const uint64_t max_pending = ack_checker->get_max_pending_writes();
+    if (max_pending != 0 && pending_writes >= max_pending) {
+        *retry_after_ms_out = PENDING_WRITES_RETRY_AFTER_MS;
+        return false;
+    }
+    const uint64_t rate = ack_checker->get_max_writes_per_sec();
+    if (rate != 0) {
+        const ticks_t now = get_ticks();
+        write_tokens = std::min<double>(
+            rate, write_tokens + ticks_to_secs(now - write_tokens_refilled) * rate);
+        write_tokens_refilled = now;
+        if (write_tokens < 1) {
+            *retry_after_ms_out =
+                static_cast<int64_t>(ceil((1 - write_tokens) * THOUSAND / rate));
+            return false;
+        }
+        write_tokens -= 1;
+    }
+    ++pending_writes;
+    return true;
+}
+
+void master_t::expire_rows(auto_drainer_t::lock_t keepalive) {
+    class write_callback_t : public broadcaster_t::write_callback_t {
+    public:
+        void on_success(const write_response_t &response) {
+            success_promise.pulse(response);
+        }
+        void on_failure(UNUSED bool might_have_run_anyway) {
+            failure_cond.pulse();
+        }
+        promise_t<write_response_t> success_promise;
+        cond_t failure_cond;
+    };
+
+    try {
+        int64_t wait_ms = EXPIRY_IDLE_INTERVAL_MS;
+        for (;;) {
+            nap(wait_ms, keepalive.get_drain_signal());
+            wait_ms = EXPIRY_IDLE_INTERVAL_MS;
+
+            const std::string index = ack_checker->get_expiry_index();
+            const uint64_t max_rows = ack_checker->get_expiry_deletes_per_sec();
+            if (index.empty() || max_rows == 0) {
+                continue;
+            }
+
+            /* The cutoff is part of the write, so that every replica deletes the same
+            rows no matter what its clock says. */
+            write_t write(
+                expire_t(index, ack_checker->get_primary_key(), ql::pseudo::time_now(),
+                         max_rows, region),
+                profile_bool_t::DONT_PROFILE,
+                ql::configured_limits_t());
+            write_callback_t write_callback;
+            fifo_enforcer_sink_t::exit_write_t exiter(
+                &expiry_fifo_sink, expiry_fifo_source.enter_write());
+            broadcaster->spawn_write(write, &exiter, order_token_t::ignore,
+                                     &write_callback, keepalive.get_drain_signal(),
+                                     ack_checker);
+
+            wait_any_t waiter(write_callback.success_promise.get_ready_signal(),
+                              &write_callback.failure_cond);
+            wait_interruptible(&waiter, keepalive.get_drain_signal());
+
+            /* If we deleted a whole batch there are probably more expired rows, so we
+            go on after a second instead of waiting for the idle interval. */
+            write_response_t response;
+            if (write_callback.success_promise.try_get_value(&response)) {
+                const ql::datum_t *stats = boost::get<ql::datum_t>(&response.response);
+                if (stats != nullptr) {
+                    ql::datum_t deleted = stats->get_field("deleted", ql::NOTHROW);
+                    if (deleted.has()
+                            && deleted.as_num() >= static_cast<double>(max_rows)) {
+                        wait_ms = THOUSAND;
+                    }
+                }
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        /* The `master_t` is being destroyed */
+    }
+}
+
 master_business_card_t master_t::get_business_card() {
     return master_business_card_t(region,
                                   multi_throttling_server.get_business_card());
@@ -43,12 +144,31 @@ void master_t::client_t::perform_request(
             reply = read_response_t();
             read_response_t &resp = boost::get<read_response_t>(reply);
 
+            const ticks_t received = get_ticks();
             fifo_enforcer_sink_t::exit_read_t exiter(&fifo_sink, read->fifo_token);
+            if (read->read.profile == profile_bool_t::PROFILE) {
+                // `broadcaster_t::read()` waits for `exiter` first thing too; we
+                // only wait here to time how long the read is queued.
+                wait_interruptible(&exiter, interruptor);
+            }
+            const ticks_t queued = get_ticks() - received;
             parent->broadcaster->read(read->read, &resp, &exiter, read->order_token, interruptor);
+            if (read->read.profile == profile_bool_t::PROFILE) {
+                profile::wrap_parallel_tasks(
+                    "Perform read on primary replica.", received, get_ticks(),
+                    { profile::sample_t("Wait for earlier operations on the "
+                                        "primary replica.", queued, 1) },
+                    resp.n_shards, &resp.event_log);
+                resp.n_shards = 1;
+            }
         } catch (const cannot_perform_query_exc_t &e) {
             reply = e.what();
         }
-        send(parent->mailbox_manager, read->cont_addr, reply);
+        /* The reply is usually going to a `master_access_t` on this server, so we
+        hand it over directly if we can instead of serializing it. Requests still
+        go through serialization, because they hold compiled ReQL functions that
+        can't be shared across threads. */
+        send_moving_locally(parent->mailbox_manager, read->cont_addr, std::move(reply));
 
     } else if (const master_business_card_t::write_request_t *write =
             boost::get<master_business_card_t::write_request_t>(&request)) {
@@ -76,7 +196,23 @@ void master_t::client_t::perform_request(
             return;
         }
 
+        /* Turning a write away leaves `exiter` un-waited-for, which lets the
+        client's later writes through the FIFO without it. */
         fifo_enforcer_sink_t::exit_write_t exiter(&fifo_sink, write->fifo_token);
+        int64_t retry_after_ms;
+        if (!parent->admit_write(&retry_after_ms)) {
+            send(parent->mailbox_manager, write->cont_addr,
+                 boost::variant<write_response_t, std::string>(strprintf(
+                     "The table is over its write limits (see `write_limits` in "
+                     "`rethinkdb.table_config`). The write was not performed. "
+                     "Retry after %" PRIi64 " ms.", retry_after_ms)));
+            return;
+        }
+        struct pending_write_t {
+            ~pending_write_t() { --*pending_writes; }
+            uint64_t *pending_writes;
+        } pending_write = { &parent->pending_writes };
+
         parent->broadcaster->spawn_write(write->write, &exiter, write->order_token, &write_callback, interruptor, parent->ack_checker);
 
         wait_any_t waiter(write_callback.success_promise.get_ready_signal(),
@@ -95,8 +231,8 @@ void master_t::client_t::perform_request(
 
         write_response_t write_response;
         if (write_callback.success_promise.try_get_value(&write_response)) {
-            send(parent->mailbox_manager, write->cont_addr,
-                 boost::variant<write_response_t, std::string>(write_response));
+            send_moving_locally(parent->mailbox_manager, write->cont_addr,
+                boost::variant<write_response_t, std::string>(std::move(write_response)));
         } else {
             guarantee(write_callback.failure_promise.get_ready_signal()->is_pulsed());
             if (write_callback.failure_promise.wait()) {
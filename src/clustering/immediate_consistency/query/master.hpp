@@ -48,11 +48,30 @@ private:
         fifo_enforcer_sink_t fifo_sink;
     };
 
+    /* Returns false if taking another write would go over the limits from
+    `ack_checker`, and sets `*retry_after_ms_out` to when the client should try
+    again. Otherwise counts the write as pending. */
+    bool admit_write(int64_t *retry_after_ms_out);
+
+    /* Runs for as long as the `master_t` exists, and deletes the expired rows in
+    `region` for the table's `expiry` from `ack_checker`, one batch at a time. */
+    void expire_rows(auto_drainer_t::lock_t keepalive);
+
     mailbox_manager_t *mailbox_manager;
     ack_checker_t *ack_checker;
     broadcaster_t *broadcaster;
     region_t region;
 
+    /* For `admit_write()`. The rate limit is a token bucket that holds up to a
+    second's worth of writes. */
+    double write_tokens;
+    ticks_t write_tokens_refilled;
+    uint64_t pending_writes;
+
+    /* For the writes that `expire_rows()` sends */
+    fifo_enforcer_source_t expiry_fifo_source;
+    fifo_enforcer_sink_t expiry_fifo_sink;
+
     /* See note in `client_t::perform_request()` for what this is about */
     cond_t shutdown_cond;
 
@@ -63,6 +82,8 @@ private:
             client_t
             > multi_throttling_server;
 
+    auto_drainer_t drainer;
+
     DISABLE_COPYING(master_t);
 };
 
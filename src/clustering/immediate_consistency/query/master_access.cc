@@ -19,6 +19,7 @@ master_access_t::master_access_t(
         signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t, resource_lost_exc_t) :
     mailbox_manager(mm),
+    local_thread(INVALID_THREAD),
     multi_throttling_client(
         mailbox_manager,
         master->subview(&master_access_t::extract_multi_throttling_business_card),
@@ -31,6 +32,13 @@ master_access_t::master_access_t(
     }
 
     region = business_card.get().get().region;
+
+    const auto &create_mailbox =
+        business_card.get().get().multi_throttling.registrar.create_mailbox;
+    if (create_mailbox.get_peer() ==
+            mailbox_manager->get_connectivity_cluster()->get_me()) {
+        local_thread = create_mailbox.get_thread();
+    }
 }
 
 void master_access_t::new_read_token(fifo_enforcer_sink_t::exit_read_t *out) {
@@ -48,12 +56,15 @@ void master_access_t::read(
                     cannot_perform_query_exc_t) {
     rassert(region_is_superset(region, read.get_region()));
 
+    const ticks_t started = get_ticks();
+    ticks_t received = 0;
     promise_t<boost::variant<read_response_t, std::string> >
         result_or_failure;
     mailbox_t<void(boost::variant<read_response_t, std::string>)>
         result_or_failure_mailbox(
             mailbox_manager,
             [&](signal_t *, const boost::variant<read_response_t, std::string> &res) {
+                received = get_ticks();
                 result_or_failure.pulse(res);
             });
 
@@ -64,6 +75,11 @@ void master_access_t::read(
             master_business_card_t::inner_client_business_card_t
             >::ticket_acq_t ticket(&multi_throttling_client);
     token->end();
+    if (read.profile == profile_bool_t::PROFILE) {
+        // `spawn_request()` waits for the ticket too; we only wait here to time it.
+        wait_interruptible(&ticket, interruptor);
+    }
+    const ticks_t sent = get_ticks();
 
     master_business_card_t::read_request_t read_request(
         read,
@@ -84,6 +100,9 @@ void master_access_t::read(
                 boost::get<read_response_t>(
                     &result_or_failure.wait())) {
             *response = *result;
+            if (read.profile == profile_bool_t::PROFILE) {
+                add_hops_to_profile(started, sent, received, response);
+            }
         } else {
             unreachable();
         }
@@ -92,6 +111,28 @@ void master_access_t::read(
     }
 }
 
+void master_access_t::add_hops_to_profile(ticks_t started, ticks_t sent,
+                                          ticks_t received,
+                                          read_response_t *response) {
+    std::vector<profile::sample_t> hops;
+    hops.push_back(profile::sample_t(
+        "Wait for earlier operations and throttling.", sent - started, 1));
+    // The primary replica's clock can't be compared to ours, but the duration that
+    // it reports can be.
+    ticks_t on_primary;
+    if (profile::single_task_duration(response->event_log, &on_primary)
+        && on_primary <= received - sent) {
+        hops.push_back(profile::sample_t(
+            "Network transit to and from the primary replica.",
+            (received - sent) - on_primary, 1));
+    }
+    profile::wrap_parallel_tasks(
+        strprintf("Read from the primary replica for shard %s.",
+                  key_range_to_string(region.inner).c_str()),
+        started, received, hops, response->n_shards, &response->event_log);
+    response->n_shards = 1;
+}
+
 void master_access_t::new_write_token(fifo_enforcer_sink_t::exit_write_t *out) {
     out->begin(&internal_fifo_sink, internal_fifo_source.enter_write());
 }
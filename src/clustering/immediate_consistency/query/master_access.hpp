@@ -28,6 +28,12 @@ public:
         return region;
     }
 
+    /* Returns the thread the `master_t` runs on if it's on this server, and
+    `INVALID_THREAD` if it's on another one. */
+    threadnum_t get_local_thread() {
+        return local_thread;
+    }
+
     signal_t *get_failed_signal() {
         return multi_throttling_client.get_failed_signal();
     }
@@ -73,9 +79,15 @@ private:
 
     void on_allocation(int);
 
+    /* Adds the time it took the read to get to and back from the primary replica
+    to the profile in `response`. */
+    void add_hops_to_profile(ticks_t started, ticks_t sent, ticks_t received,
+                             read_response_t *response);
+
     mailbox_manager_t *mailbox_manager;
 
     region_t region;
+    threadnum_t local_thread;
     fifo_enforcer_source_t internal_fifo_source;
     fifo_enforcer_sink_t internal_fifo_sink;
 
@@ -1,6 +1,7 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "clustering/reactor/namespace_interface.hpp"
 
+#include <algorithm>
 #include <functional>
 
 #include "clustering/immediate_consistency/query/master_access.hpp"
@@ -8,6 +9,11 @@
 #include "concurrency/watchable.hpp"
 #include "rdb_protocol/env.hpp"
 
+/* Outdated reads go to the remote direct reader that has answered the fastest so
+far. Every `OUTDATED_READ_EXPLORATION_INTERVAL`-th read or so picks one at random
+instead, so that we notice when another one becomes faster. */
+static const int OUTDATED_READ_EXPLORATION_INTERVAL = 16;
+
 cluster_namespace_interface_t::cluster_namespace_interface_t(
         mailbox_manager_t *mm,
         const std::map<namespace_id_t, std::map<key_range_t, server_id_t> >
@@ -92,7 +98,18 @@ void cluster_namespace_interface_t::read_outdated(const read_t &r, read_response
     /* This seems kind of silly. We do it this way because
        `dispatch_outdated_read` needs to be able to see `outdated_read_info_t`,
        which is defined in the `private` section. */
-    dispatch_outdated_read(r, response, interruptor);
+    dispatch_outdated_read(r, NULL, response, interruptor);
+}
+
+void cluster_namespace_interface_t::read_after(const read_t &r,
+                                               const write_versions_t &versions,
+                                               read_response_t *response,
+                                               signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) {
+    if (!dispatch_outdated_read(r, &versions, response, interruptor)) {
+        /* The primary replicas have all the writes that they acknowledged. */
+        read(r, response, order_token_t::ignore, interruptor);
+    }
 }
 
 void cluster_namespace_interface_t::write(const write_t &w,
@@ -123,6 +140,45 @@ cluster_namespace_interface_t::get_sharding_scheme() THROWS_ONLY(cannot_perform_
     return std::set<region_t>(s.begin(), s.end());
 }
 
+threadnum_t cluster_namespace_interface_t::get_local_primary_thread() {
+    threadnum_t thread = INVALID_THREAD;
+    for (auto it = relationships.begin(); it != relationships.end(); ++it) {
+        for (relationship_t *relationship : it->second) {
+            if (relationship->master_access == NULL) {
+                continue;
+            }
+            threadnum_t t = relationship->master_access->get_local_thread();
+            if (t == INVALID_THREAD || !(thread == INVALID_THREAD || thread == t)) {
+                return INVALID_THREAD;
+            }
+            thread = t;
+        }
+    }
+    return thread;
+}
+
+/* Reads size their per-region batches by how many regions they get sent to (see
+`read_t::shard()`); writes don't care. */
+static bool shard_op(const read_t &op, const region_t &region, size_t fanout,
+                     read_t *op_out) {
+    return op.shard(region, op_out, fanout);
+}
+
+static bool shard_op(const write_t &op, const region_t &region, size_t,
+                     write_t *op_out) {
+    return op.shard(region, op_out);
+}
+
+size_t cluster_namespace_interface_t::count_fanout(const region_t &op_region) {
+    size_t fanout = 0;
+    for (auto it = relationships.begin(); it != relationships.end(); ++it) {
+        if (!region_is_empty(region_intersection(it->first, op_region))) {
+            ++fanout;
+        }
+    }
+    return fanout;
+}
+
 template<class op_type, class fifo_enforcer_token_type, class op_response_type>
 void cluster_namespace_interface_t::dispatch_immediate_op(
     /* `how_to_make_token` and `how_to_run_query` have type pointer-to-
@@ -148,8 +204,9 @@ void cluster_namespace_interface_t::dispatch_immediate_op(
         masters_to_contact;
     scoped_ptr_t<immediate_op_info_t<op_type, fifo_enforcer_token_type> >
         new_op_info(new immediate_op_info_t<op_type, fifo_enforcer_token_type>());
+    const size_t fanout = count_fanout(op.get_region());
     for (auto it = relationships.begin(); it != relationships.end(); ++it) {
-        if (op.shard(it->first, &new_op_info->sharded_op)) {
+        if (shard_op(op, it->first, fanout, &new_op_info->sharded_op)) {
             relationship_t *chosen_relationship = NULL;
             const std::set<relationship_t *> *relationship_map = &it->second;
             for (auto jt = relationship_map->begin();
@@ -257,9 +314,43 @@ void cluster_namespace_interface_t::perform_immediate_op(
     }
 }
 
-void
+bool cluster_namespace_interface_t::get_required_version(
+        const write_versions_t &versions,
+        const region_t &region,
+        boost::optional<branch_id_t> *branch_out,
+        state_timestamp_t *timestamp_out) {
+    *branch_out = boost::none;
+    *timestamp_out = state_timestamp_t::zero();
+    for (const auto &version : versions) {
+        /* Every replica that keeps up with a branch covers all of its region, so any
+        of them tells us where the write went. */
+        boost::optional<region_t> branch_region;
+        for (auto it = relationships.begin(); it != relationships.end(); ++it) {
+            for (relationship_t *relationship : it->second) {
+                if (relationship->branch && *relationship->branch == version.first) {
+                    branch_region = relationship->region;
+                }
+            }
+        }
+        if (!branch_region) {
+            return false;
+        }
+        if (region_is_empty(region_intersection(*branch_region, region))) {
+            continue;
+        }
+        if (*branch_out && **branch_out != version.first) {
+            return false;
+        }
+        *branch_out = version.first;
+        *timestamp_out = version.second;
+    }
+    return true;
+}
+
+bool
 cluster_namespace_interface_t::dispatch_outdated_read(
     const read_t &op,
+    const write_versions_t *versions,
     read_response_t *response,
     signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) {
@@ -269,15 +360,27 @@ cluster_namespace_interface_t::dispatch_outdated_read(
     std::vector<scoped_ptr_t<outdated_read_info_t> > direct_readers_to_contact;
 
     scoped_ptr_t<outdated_read_info_t> new_op_info(new outdated_read_info_t());
+    const size_t fanout = count_fanout(op.get_region());
     for (auto it = relationships.begin(); it != relationships.end(); ++it) {
-        if (op.shard(it->first, &new_op_info->sharded_op)) {
+        if (op.shard(it->first, &new_op_info->sharded_op, fanout)) {
             std::vector<relationship_t *> potential_relationships;
             relationship_t *chosen_relationship = NULL;
 
+            boost::optional<branch_id_t> required_branch;
+            new_op_info->min_timestamp = state_timestamp_t::zero();
+            if (versions != NULL
+                && !get_required_version(*versions, it->first, &required_branch,
+                                         &new_op_info->min_timestamp)) {
+                return false;
+            }
+
             const std::set<relationship_t *> *relationship_map = &it->second;
             for (auto jt = relationship_map->begin();
                  jt != relationship_map->end();
                  ++jt) {
+                if (required_branch && (*jt)->branch != required_branch) {
+                    continue;
+                }
                 if ((*jt)->direct_reader_access) {
                     if ((*jt)->is_local) {
                         chosen_relationship = *jt;
@@ -288,17 +391,30 @@ cluster_namespace_interface_t::dispatch_outdated_read(
                 }
             }
             if (!chosen_relationship && !potential_relationships.empty()) {
-                chosen_relationship
-                    = potential_relationships[
-                        distributor_rng.randint(potential_relationships.size())];
+                if (distributor_rng.randint(OUTDATED_READ_EXPLORATION_INTERVAL) == 0) {
+                    chosen_relationship
+                        = potential_relationships[
+                            distributor_rng.randint(potential_relationships.size())];
+                } else {
+                    chosen_relationship = *std::min_element(
+                        potential_relationships.begin(),
+                        potential_relationships.end(),
+                        [](relationship_t *a, relationship_t *b) {
+                            return a->outdated_read_latency < b->outdated_read_latency;
+                        });
+                }
             }
             if (!chosen_relationship) {
+                if (versions != NULL) {
+                    return false;
+                }
                 /* Don't bother looking for masters; if there are no direct
                    readers, there won't be any masters either. */
                 throw cannot_perform_query_exc_t("No direct reader available");
             }
             new_op_info->direct_reader_access
                 = chosen_relationship->direct_reader_access;
+            new_op_info->relationship = chosen_relationship;
             new_op_info->keepalive = auto_drainer_t::lock_t(
                 &chosen_relationship->drainer);
             direct_readers_to_contact.push_back(std::move(new_op_info));
@@ -320,6 +436,7 @@ cluster_namespace_interface_t::dispatch_outdated_read(
     }
 
     op.unshard(results.data(), results.size(), response, ctx, interruptor);
+    return true;
 }
 
 void cluster_namespace_interface_t::perform_outdated_read(
@@ -338,10 +455,16 @@ void cluster_namespace_interface_t::perform_outdated_read(
                 done.pulse();
             });
 
-        send(mailbox_manager, direct_reader_to_contact->direct_reader_access->access().read_mailbox, direct_reader_to_contact->sharded_op, cont.get_address());
+        const ticks_t start_time = get_ticks();
+        send(mailbox_manager, direct_reader_to_contact->direct_reader_access->access().read_mailbox, direct_reader_to_contact->sharded_op, direct_reader_to_contact->min_timestamp, cont.get_address());
         wait_any_t waiter(direct_reader_to_contact->direct_reader_access->get_failed_signal(), &done);
         wait_interruptible(&waiter, interruptor);
         direct_reader_to_contact->direct_reader_access->access();   /* throws if `get_failed_signal()->is_pulsed()` */
+
+        /* `keepalive` makes sure that the relationship is still around. */
+        const ticks_t latency = get_ticks() - start_time;
+        ticks_t *average = &direct_reader_to_contact->relationship->outdated_read_latency;
+        *average = *average == 0 ? latency : (*average * 7 + latency) / 8;
     } catch (const resource_lost_exc_t &) {
         failures->at(i).assign("lost contact with direct reader");
     } catch (const interrupted_exc_t &) {
@@ -362,20 +485,24 @@ void cluster_namespace_interface_t::update_registrant(
             ++amit) {
         bool has_anything_useful;
         bool is_primary;
+        boost::optional<branch_id_t> branch;
         if (const reactor_business_card_details::primary_t *primary =
                 boost::get<reactor_business_card_details::primary_t>(
                     &amit->second.activity)) {
             if (primary->master) {
                 has_anything_useful = true;
                 is_primary = true;
+                branch = primary->broadcaster.branch_id;
             } else {
                 has_anything_useful = false;
                 is_primary = false;  // Appease -Wconditional-uninitialized
             }
-        } else if (boost::get<reactor_business_card_details::secondary_up_to_date_t>(
-                &amit->second.activity)) {
+        } else if (const reactor_business_card_details::secondary_up_to_date_t *
+                secondary = boost::get<reactor_business_card_details::secondary_up_to_date_t>(
+                    &amit->second.activity)) {
             has_anything_useful = true;
             is_primary = false;
+            branch = secondary->branch_id;
         } else if (boost::get<reactor_business_card_details::secondary_without_primary_t>(
                 &amit->second.activity)) {
             has_anything_useful = true;
@@ -397,7 +524,7 @@ void cluster_namespace_interface_t::update_registrant(
                 /* Now handle it. */
                 coro_t::spawn_sometime(std::bind(
                     &cluster_namespace_interface_t::relationship_coroutine, this,
-                    peer, id, starting_up, is_primary, amit->second.region,
+                    peer, id, starting_up, is_primary, amit->second.region, branch,
                     auto_drainer_t::lock_t(&relationship_coroutine_auto_drainer)));
             }
         }
@@ -495,6 +622,7 @@ private:
 
 void cluster_namespace_interface_t::relationship_coroutine(peer_id_t peer_id, reactor_activity_id_t activity_id,
                                                            bool is_start, bool is_primary, const region_t &region,
+                                                           const boost::optional<branch_id_t> &branch,
                                                            auto_drainer_t::lock_t lock) THROWS_NOTHING {
     try {
         scoped_ptr_t<master_access_t> master_access;
@@ -529,6 +657,8 @@ void cluster_namespace_interface_t::relationship_coroutine(peer_id_t peer_id, re
         relationship_record.region = region;
         relationship_record.master_access = master_access.has() ? master_access.get() : NULL;
         relationship_record.direct_reader_access = direct_reader_access.has() ? direct_reader_access.get() : NULL;
+        relationship_record.branch = branch;
+        relationship_record.outdated_read_latency = 0;
 
         region_map_set_membership_t<relationship_t *> relationship_map_insertion(&relationships,
                                                                                  region,
@@ -22,6 +22,7 @@
 #include "concurrency/watchable.hpp"
 #include "protocol_api.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "time.hpp"
 
 template <class> class cow_ptr_t;
 class master_access_t;
@@ -55,10 +56,14 @@ public:
 
     void read_outdated(const read_t &r, read_response_t *response, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
 
+    void read_after(const read_t &r, const write_versions_t &versions, read_response_t *response, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
+
     void write(const write_t &w, write_response_t *response, order_token_t order_token, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
 
     std::set<region_t> get_sharding_scheme() THROWS_ONLY(cannot_perform_query_exc_t);
 
+    threadnum_t get_local_primary_thread();
+
 private:
     class relationship_t {
     public:
@@ -66,6 +71,12 @@ private:
         region_t region;
         master_access_t *master_access;
         resource_access_t<direct_reader_business_card_t> *direct_reader_access;
+        /* The branch that the replica is keeping up with, if it's a primary or an
+        up-to-date secondary. Its direct reader can wait for writes on that branch. */
+        boost::optional<branch_id_t> branch;
+        /* A moving average of how long outdated reads from `direct_reader_access`
+        have taken, or 0 if we haven't done any yet. */
+        ticks_t outdated_read_latency;
         auto_drainer_t drainer;
     };
 
@@ -85,10 +96,16 @@ private:
     class outdated_read_info_t {
     public:
         read_t sharded_op;
+        /* The timestamp that the direct reader has to wait for, or zero. */
+        state_timestamp_t min_timestamp;
         resource_access_t<direct_reader_business_card_t> *direct_reader_access;
+        relationship_t *relationship;
         auto_drainer_t::lock_t keepalive;
     };
 
+    // The number of relationship regions that `op_region` touches.
+    size_t count_fanout(const region_t &op_region);
+
     template <class op_type, class fifo_enforcer_token_type, class op_response_type>
     void dispatch_immediate_op(
             /* `how_to_make_token` and `how_to_run_query` have type pointer-to-member-function. */
@@ -115,12 +132,26 @@ private:
             signal_t *interruptor)
         THROWS_NOTHING;
 
-    void dispatch_outdated_read(
+    /* If `versions` isn't `NULL`, only reads from replicas that can wait for the
+    writes in it. Returns false without reading anything if there's a shard that no
+    such replica is available for. */
+    bool dispatch_outdated_read(
             const read_t &op,
+            const write_versions_t *versions,
             read_response_t *response,
             signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t);
 
+    /* Finds the branch that replicas of `region` have to be on to wait for the
+    writes in `versions`, if any, and the timestamp to wait for. Returns false if
+    there's no such branch because the writes are from branches that we don't know
+    about or that overlap (for example after a failover or a resharding). */
+    bool get_required_version(
+            const write_versions_t &versions,
+            const region_t &region,
+            boost::optional<branch_id_t> *branch_out,
+            state_timestamp_t *timestamp_out);
+
     void perform_outdated_read(
             std::vector<scoped_ptr_t<outdated_read_info_t> > *direct_readers_to_contact,
             std::vector<read_response_t> *results,
@@ -148,6 +179,7 @@ private:
 
     void relationship_coroutine(peer_id_t peer_id, reactor_activity_id_t activity_id,
                                 bool is_start, bool is_primary, const region_t &region,
+                                const boost::optional<branch_id_t> &branch,
                                 auto_drainer_t::lock_t lock) THROWS_NOTHING;
 
     mailbox_manager_t *mailbox_manager;
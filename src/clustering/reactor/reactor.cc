@@ -10,6 +10,7 @@
 #include "clustering/immediate_consistency/branch/multistore.hpp"
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/cross_thread_watchable.hpp"
+#include "concurrency/pmap.hpp"
 #include "config/args.hpp"
 #include "containers/scoped.hpp"
 #include "stl_utils.hpp"
@@ -68,18 +69,18 @@ reactor_t::get_reactor_directory() {
 }
 
 std::map<region_t, reactor_progress_report_t> reactor_t::get_progress() {
+    std::vector<std::map<region_t, reactor_progress_report_t> > temps(
+        get_num_threads());
+    pmap_on_threads([&](size_t i) {
+        temps[i] = *progress_map.get();
+    });
     std::map<region_t, reactor_progress_report_t> output;
-    pmap(get_num_threads(), [&](int i) {
-        std::map<region_t, reactor_progress_report_t> temp;
-        {
-            on_thread_t th((threadnum_t(i)));
-            temp = *progress_map.get();
-        }
+    for (const auto &temp : temps) {
         for (const auto &pair : temp) {
             auto res = output.insert(pair);
             guarantee(res.second);
         }
-    });
+    }
     return output;
 }
 
@@ -110,6 +111,11 @@ directory_echo_version_t reactor_t::directory_entry_t::update_without_changing_i
     return our_value_change.commit();
 }
 
+void reactor_t::directory_entry_t::flush() {
+    parent->assert_thread();
+    parent->directory_buffer.flush();
+}
+
 reactor_activity_id_t reactor_t::directory_entry_t::get_reactor_activity_id() const {
     return reactor_activity_id;
 }
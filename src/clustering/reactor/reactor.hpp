@@ -79,6 +79,13 @@ private:
 
         //XXX this is a bit of a hack that we should revisit when we know more
         directory_echo_version_t update_without_changing_id(reactor_business_card_t::activity_t);
+
+        /* Changes to the directory are normally buffered for a little while so that
+        they can be sent in batches. `flush()` sends them right away; use it for the
+        steps of a failover, where writes are unavailable until the other servers
+        see our new state. */
+        void flush();
+
         ~directory_entry_t();
 
         reactor_activity_id_t get_reactor_activity_id() const;
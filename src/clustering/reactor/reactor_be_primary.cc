@@ -420,8 +420,13 @@ bool reactor_t::attempt_backfill_from_peers(
             }
         }
 
-        /* Tell the other peers which backfills we're waiting on. */
-        directory_entry->set(reactor_business_card_t::primary_when_safe_t());
+        /* Tell the other peers which backfills we're waiting on. If our store
+         * already has the latest version, e.g. because we were an up-to-date
+         * secondary replica until the old primary failed, there's nothing to wait
+         * on and we go straight to constructing the broadcaster. */
+        if (!promises.empty()) {
+            directory_entry->set(reactor_business_card_t::primary_when_safe_t());
+        }
 
         /* Since these don't actually modify peers behavior, just allow
          * them to query the backfiller for progress reports there's no
@@ -463,6 +468,7 @@ void reactor_t::be_primary(region_t region, store_view_t *svs, const clone_ptr_t
 
         /* Tell everyone watching our directory entry what we're up to. */
         directory_echo_version_t version_to_wait_on = directory_entry.set(reactor_business_card_t::primary_when_safe_t());
+        directory_entry.flush();
 
         /* block until all peers have acked `directory_entry` */
         wait_for_directory_acks(version_to_wait_on, interruptor);
@@ -502,6 +508,7 @@ void reactor_t::be_primary(region_t region, store_view_t *svs, const clone_ptr_t
         on_thread_t th2(this->home_thread());
 
         directory_entry.set(reactor_business_card_t::primary_t(broadcaster.get_business_card()));
+        directory_entry.flush();
 
         clone_ptr_t<watchable_t<boost::optional<boost::optional<broadcaster_business_card_t> > > > broadcaster_business_card =
             get_directory_entry_view<reactor_business_card_t::primary_t>(get_me(), directory_entry.get_reactor_activity_id())->
@@ -523,7 +530,7 @@ void reactor_t::be_primary(region_t region, store_view_t *svs, const clone_ptr_t
             &order_source);
         replier_t replier(&listener, mailbox_manager, branch_history_manager);
         master_t master(mailbox_manager, ack_checker, region, &broadcaster);
-        direct_reader_t direct_reader(mailbox_manager, svs);
+        direct_reader_t direct_reader(mailbox_manager, svs, &listener);
 
         on_thread_t th4(this->home_thread());
 
@@ -533,6 +540,7 @@ void reactor_t::be_primary(region_t region, store_view_t *svs, const clone_ptr_t
                 replier.get_business_card(),
                 master.get_business_card(),
                 direct_reader.get_business_card()));
+        directory_entry.flush();
 
         interruptor->wait_lazily_unordered();
 
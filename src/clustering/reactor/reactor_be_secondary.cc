@@ -144,6 +144,11 @@ void reactor_t::be_secondary(region_t region, store_view_t *svs, const clone_ptr
         /* Tell everyone that we're backfilling so that we can get up to
          * date. */
         directory_entry_t directory_entry(this, region);
+
+        /* Set once we've lost a primary we were tracking. From then on the new
+         * primary can't proceed until it sees that we stopped tracking the old
+         * one, so we don't let our directory changes sit in the buffer. */
+        bool primary_was_lost = false;
         while (true) {
 
             clone_ptr_t<watchable_t<boost::optional<boost::optional<broadcaster_business_card_t> > > > broadcaster;
@@ -183,6 +188,9 @@ void reactor_t::be_secondary(region_t region, store_view_t *svs, const clone_ptr
                     activity(to_version_range_map(metainfo_blob), backfiller.get_business_card(), direct_reader.get_business_card(), branch_history);
 
                 directory_entry.set(activity);
+                if (primary_was_lost) {
+                    directory_entry.flush();
+                }
 
                 /* Wait until we can find a primary for our region. */
                 run_until_satisfied_2(
@@ -264,7 +272,7 @@ void reactor_t::be_secondary(region_t region, store_view_t *svs, const clone_ptr
                  * us for backfills. */
                 replier_t replier(&listener, mailbox_manager, branch_history_manager);
 
-                direct_reader_t direct_reader(mailbox_manager, svs);
+                direct_reader_t direct_reader(mailbox_manager, svs, &listener);
 
                 cross_thread_signal_t ct_broadcaster_lost_signal(listener.get_broadcaster_lost_signal(), this->home_thread());
                 on_thread_t th2(this->home_thread());
@@ -275,6 +283,7 @@ void reactor_t::be_secondary(region_t region, store_view_t *svs, const clone_ptr
 
                 /* Wait for something to change. */
                 wait_interruptible(&ct_broadcaster_lost_signal, interruptor);
+                primary_was_lost = true;
             } catch (const listener_t::backfiller_lost_exc_t &) {
                 /* We lost the replier which means we should retry, just
                  * going back to the top of the while loop accomplishes this.
@@ -282,6 +291,7 @@ void reactor_t::be_secondary(region_t region, store_view_t *svs, const clone_ptr
             } catch (const listener_t::broadcaster_lost_exc_t &) {
                 /* We didn't find the broadcaster which means we should retry,
                  * same deal as above. */
+                primary_was_lost = true;
             }
         }
     } catch (const interrupted_exc_t &) {
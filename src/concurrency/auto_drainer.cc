@@ -28,10 +28,6 @@ auto_drainer_t::lock_t::lock_t(auto_drainer_t *p, throw_if_draining_t thr) : par
     parent->incref();
 }
 
-auto_drainer_t::lock_t::lock_t(const lock_t &l) : parent(l.parent) {
-    if (parent) parent->incref();
-}
-
 auto_drainer_t::lock_t &auto_drainer_t::lock_t::operator=(const lock_t &l) {
     if (l.parent) l.parent->incref();
     if (parent) parent->decref();
@@ -39,10 +35,6 @@ auto_drainer_t::lock_t &auto_drainer_t::lock_t::operator=(const lock_t &l) {
     return *this;
 }
 
-auto_drainer_t::lock_t::lock_t(lock_t &&l) : parent(l.parent) {
-    l.parent = NULL;
-}
-
 auto_drainer_t::lock_t &auto_drainer_t::lock_t::operator=(lock_t &&l) {
     lock_t tmp(std::move(l));
     std::swap(parent, tmp.parent);
@@ -53,11 +45,6 @@ auto_drainer_t::lock_t auto_drainer_t::lock() {
     return auto_drainer_t::lock_t(this);
 }
 
-void auto_drainer_t::lock_t::reset() {
-    if (parent) parent->decref();
-    parent = NULL;
-}
-
 bool auto_drainer_t::lock_t::has_lock() const {
     return parent != NULL;
 }
@@ -74,9 +61,6 @@ void auto_drainer_t::lock_t::assert_is_holding(auto_drainer_t *p) const {
     guarantee(p == parent);
 }
 
-auto_drainer_t::lock_t::~lock_t() {
-    if (parent) parent->decref();
-}
 
 void auto_drainer_t::begin_draining() {
     assert_not_draining();
@@ -91,16 +75,3 @@ void auto_drainer_t::drain() {
     drained.wait_lazily_unordered();
     guarantee(refcount == 0);
 }
-
-void auto_drainer_t::incref() {
-    assert_thread();
-    refcount++;
-}
-
-void auto_drainer_t::decref() {
-    assert_thread();
-    refcount--;
-    if (refcount == 0 && draining.is_pulsed()) {
-        drained.pulse();
-    }
-}
@@ -39,16 +39,25 @@ public:
         lock_t();
         explicit lock_t(auto_drainer_t *,
                         throw_if_draining_t thr = throw_if_draining_t::NO);
-        lock_t(const lock_t &);
+        lock_t(const lock_t &l) : parent(l.parent) {
+            if (parent != NULL) parent->incref();
+        }
         lock_t &operator=(const lock_t &);
-        lock_t(lock_t &&);
+        lock_t(lock_t &&l) : parent(l.parent) {
+            l.parent = NULL;
+        }
         lock_t &operator=(lock_t &&);
 
-        void reset();
+        void reset() {
+            if (parent != NULL) parent->decref();
+            parent = NULL;
+        }
         bool has_lock() const;
         signal_t *get_drain_signal() const;
         void assert_is_holding(auto_drainer_t *) const;
-        ~lock_t();
+        ~lock_t() {
+            if (parent != NULL) parent->decref();
+        }
     private:
         auto_drainer_t *parent;
     };
@@ -82,8 +91,20 @@ public:
     }
 
 private:
-    void incref();
-    void decref();
+    // These are inline because an `auto_drainer_t::lock_t` is taken, copied and
+    // dropped on nearly every operation that touches a store or a connection.
+    void incref() {
+        assert_thread();
+        ++refcount;
+    }
+
+    void decref() {
+        assert_thread();
+        --refcount;
+        if (refcount == 0 && draining.is_pulsed()) {
+            drained.pulse();
+        }
+    }
 
     cond_t draining;
     int refcount;
@@ -2,6 +2,8 @@
 #ifndef CONCURRENCY_CROSS_THREAD_SEMAPHORE_HPP_
 #define CONCURRENCY_CROSS_THREAD_SEMAPHORE_HPP_
 
+#include <algorithm>
+
 #include "containers/scoped.hpp"
 #include "containers/intrusive_list.hpp"
 #include "concurrency/interruptor.hpp"
@@ -31,8 +33,12 @@ public:
 
     class lock_t {
     public:
-        explicit lock_t(cross_thread_semaphore_t *_parent, signal_t *interruptor) :
-            parent(_parent), value(parent->lock(interruptor)) { }
+        // If `preferred` is available it is the element we get, otherwise we get
+        // whichever is available (or first released).
+        explicit lock_t(cross_thread_semaphore_t *_parent,
+                        signal_t *interruptor,
+                        value_t *preferred = NULL) :
+            parent(_parent), value(parent->lock(interruptor, preferred)) { }
 
         ~lock_t() {
             parent->unlock(value);
@@ -92,7 +98,7 @@ private:
         request_node_t *request;
     };
 
-    value_t *lock(signal_t *interruptor);
+    value_t *lock(signal_t *interruptor, value_t *preferred);
     void unlock(value_t *value);
 
     // Mutex to control access, since a lock may be constructed from any thread
@@ -114,7 +120,7 @@ private:
 template <class value_t>
 cross_thread_semaphore_t<value_t>::~cross_thread_semaphore_t() {
     for (size_t i = 0; i < values.size(); ++i) {
-        delete lock(NULL);
+        delete lock(NULL, NULL);
     }
 }
 
@@ -134,7 +140,8 @@ void cross_thread_semaphore_t<value_t>::pass_value_coroutine(request_node_t *req
 }
 
 template <class value_t>
-value_t *cross_thread_semaphore_t<value_t>::lock(signal_t *interruptor) {
+value_t *cross_thread_semaphore_t<value_t>::lock(signal_t *interruptor,
+                                                 value_t *preferred) {
     system_mutex_t::lock_t lock(&mutex);
     value_t *result = NULL;
 
@@ -143,6 +150,14 @@ value_t *cross_thread_semaphore_t<value_t>::lock(signal_t *interruptor) {
         lock.unlock();
         result = request.wait_and_get(interruptor);
     } else {
+        if (preferred != NULL) {
+            for (size_t i = available_value_index + 1; i < values.size(); ++i) {
+                if (values[i] == preferred) {
+                    std::swap(values[i], values[available_value_index]);
+                    break;
+                }
+            }
+        }
         result = values[available_value_index];
         values[available_value_index] = NULL;
         ++available_value_index;
@@ -20,6 +20,14 @@ void new_semaphore_t::set_capacity(int64_t new_capacity) {
 
 void new_semaphore_t::add_acquirer(new_semaphore_acq_t *acq) {
     assert_thread();
+    if (waiters_.empty()
+        && (acq->count_ <= capacity_ - current_ || current_ == 0)) {
+        // Uncontended: nobody is ahead of us and there's room, so take the capacity
+        // directly instead of passing through `waiters_`.
+        current_ += acq->count_;
+        acq->cond_.pulse();
+        return;
+    }
     waiters_.push_back(acq);
     pulse_waiters();
 }
@@ -2,7 +2,10 @@
 #ifndef CONCURRENCY_PMAP_HPP_
 #define CONCURRENCY_PMAP_HPP_
 
+#include <vector>
+
 #include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/runtime.hpp"
 #include "concurrency/cond_var.hpp"
 #include "concurrency/new_semaphore.hpp"
 
@@ -125,4 +128,80 @@ void throttled_pmap(int64_t count, const callable_t &c, int64_t capacity) {
     throttled_pmap(0, count, c, capacity);
 }
 
+/* `pmap_on_threads()` calls `c(i)` on thread `threads[i]` for every `i`, in parallel,
+and returns once all of them have returned. It's for the common pattern of `pmap()`
+over a set of threads with an `on_thread_t` in each call, but it sends one message to
+each thread and one back instead of spawning a coroutine per thread and switching it
+there and back, and it wakes the caller only once at the end. In exchange, `c` runs
+outside of any coroutine and must not block. */
+
+template <class callable_t>
+class pmap_on_threads_runner_t : public thread_message_t {
+public:
+    pmap_on_threads_runner_t(size_t _i, const callable_t *_c, threadnum_t _caller,
+                             int64_t *_outstanding, cond_t *_to_signal)
+        : i(_i), c(_c), caller(_caller), outstanding(_outstanding),
+          to_signal(_to_signal), done(false) { }
+
+    void on_thread_switch() {
+        if (!done) {
+            (*c)(i);
+            done = true;
+            DEBUG_VAR bool no_switch = continue_on_thread(caller, this);
+            rassert(!no_switch);
+        } else {
+            (*outstanding)--;
+            if (*outstanding == 0) {
+                to_signal->pulse();
+            }
+            delete this;
+        }
+    }
+
+private:
+    size_t i;
+    const callable_t *c;
+    threadnum_t caller;
+    int64_t *outstanding;
+    cond_t *to_signal;
+    bool done;
+};
+
+template <class callable_t>
+void pmap_on_threads(const std::vector<threadnum_t> &threads, const callable_t &c) {
+    const threadnum_t caller = get_thread_id();
+    cond_t cond;
+    // One extra for the calls on the caller's own thread, which we make directly.
+    int64_t outstanding = 1;
+    for (size_t i = 0; i < threads.size(); ++i) {
+        if (!(threads[i] == caller)) {
+            ++outstanding;
+            auto runner = new pmap_on_threads_runner_t<callable_t>(
+                i, &c, caller, &outstanding, &cond);
+            DEBUG_VAR bool no_switch = continue_on_thread(threads[i], runner);
+            rassert(!no_switch);
+        }
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        if (threads[i] == caller) {
+            c(i);
+        }
+    }
+    --outstanding;
+    if (outstanding != 0) {
+        cond.wait();
+    }
+}
+
+/* Calls `c(i)` on thread `i` for every thread in the thread pool. */
+template <class callable_t>
+void pmap_on_threads(const callable_t &c) {
+    std::vector<threadnum_t> threads;
+    threads.reserve(get_num_threads());
+    for (int i = 0; i < get_num_threads(); ++i) {
+        threads.push_back(threadnum_t(i));
+    }
+    pmap_on_threads(threads, c);
+}
+
 #endif /* CONCURRENCY_PMAP_HPP_ */
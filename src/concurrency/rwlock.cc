@@ -9,8 +9,22 @@ rwlock_t::~rwlock_t() {
 }
 
 void rwlock_t::add_acq(rwlock_in_line_t *acq) {
+    rwlock_in_line_t *tail = acqs_.tail();
     acqs_.push_back(acq);
-    pulse_pulsables(acq);
+    // The common cases are an idle lock and a read behind readers that already hold
+    // it. Both acquire immediately, without walking the line.
+    if (tail == NULL) {
+        acq->read_cond_.pulse();
+        if (acq->access_ == access_t::write) {
+            acq->write_cond_.pulse();
+        }
+    } else if (acq->access_ == access_t::read
+               && tail->access_ == access_t::read
+               && tail->read_cond_.is_pulsed()) {
+        acq->read_cond_.pulse();
+    } else {
+        pulse_pulsables(acq);
+    }
 }
 
 void rwlock_t::remove_acq(rwlock_in_line_t *acq) {
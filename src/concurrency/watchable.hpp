@@ -4,6 +4,8 @@
 
 #include <functional>
 
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/auto_drainer.hpp"
 #include "concurrency/interruptor.hpp"
 #include "concurrency/mutex_assertion.hpp"
 #include "concurrency/pubsub.hpp"
@@ -64,6 +66,71 @@ private:
 };
 
 
+/* `watchable_coalesced_subscription_t` is like `watchable_subscription_t`, except
+that it doesn't call the callback from within `set_value()`. Instead, a change marks
+the subscription as dirty and the callback is called once, in a coroutine spawned
+with `spawn_sometime()`, no matter how many changes happened in the meantime. Use it
+when the callback does a lot of work (e.g. it recomputes something from the whole
+value) and the value can change many times in a row, as the cluster directory does
+when many servers connect or reconfigure at once.
+
+Since it runs in its own coroutine, the callback may block. If the value changes
+while the callback is running, the callback is called again once it returns. The
+destructor waits for a running callback to return. */
+template <class value_t>
+class watchable_coalesced_subscription_t {
+public:
+    explicit watchable_coalesced_subscription_t(const std::function<void()> &f)
+        : callback(f), pending(false), running(false),
+          subscription([this]() { this->on_change(); })
+    { }
+
+    watchable_coalesced_subscription_t(const std::function<void()> &f,
+                                       const clone_ptr_t<watchable_t<value_t> > &watchable,
+                                       watchable_freeze_t<value_t> *freeze)
+        : callback(f), pending(false), running(false),
+          subscription([this]() { this->on_change(); }, watchable, freeze)
+    { }
+
+    ~watchable_coalesced_subscription_t() {
+        subscription.reset();
+        drainer.drain();
+    }
+
+    /* Notifications that are already pending are still delivered after `reset()`. */
+    void reset() {
+        subscription.reset();
+    }
+
+    void reset(const clone_ptr_t<watchable_t<value_t> > &watchable, watchable_freeze_t<value_t> *freeze) {
+        subscription.reset(watchable, freeze);
+    }
+
+private:
+    void on_change() {
+        pending = true;
+        if (!running) {
+            running = true;
+            auto_drainer_t::lock_t keepalive(&drainer);
+            coro_t::spawn_sometime([this, keepalive]() {
+                while (pending) {
+                    pending = false;
+                    callback();
+                }
+                running = false;
+            });
+        }
+    }
+
+    std::function<void()> callback;
+    bool pending, running;
+    auto_drainer_t drainer;
+    watchable_subscription_t<value_t> subscription;
+
+    DISABLE_COPYING(watchable_coalesced_subscription_t);
+};
+
+
 /* The purpose of the `freeze_t` is to assert that the value of the
    `watchable_t` doesn't change for as long as it exists. You should not block
    while the `freeze_t` exists. It's kind of like `mutex_assertion_t`.
@@ -102,6 +169,7 @@ class watchable_t : public home_thread_mixin_t {
 public:
     typedef watchable_freeze_t<value_t> freeze_t;
     typedef watchable_subscription_t<value_t> subscription_t;
+    typedef watchable_coalesced_subscription_t<value_t> coalesced_subscription_t;
 
     virtual ~watchable_t() { }
     virtual watchable_t *clone() const = 0;
@@ -104,11 +104,17 @@ public:
     clone_ptr_t<watchable_t<value_t> > get_output() {
         return output.get_watchable();
     }
+
+    /* Delivers any buffered changes right away instead of waiting for the delay to
+    expire. This is for the rare changes that other servers are blocked on. */
+    void flush();
+
 private:
     void notify();
     clone_ptr_t<watchable_t<value_t> > input;
     int64_t delay;
     bool coro_running;
+    bool dirty;
     watchable_variable_t<value_t> output;
     auto_drainer_t drainer;
     typename watchable_t<value_t>::subscription_t subs;
@@ -166,6 +166,7 @@ watchable_buffer_t<value_t>::watchable_buffer_t(
         input(_input),
         delay(_delay),
         coro_running(false),
+        dirty(false),
         output(value_t()),
         subs(std::bind(&watchable_buffer_t::notify, this)) {
     typename watchable_t<value_t>::freeze_t freeze(input);
@@ -175,6 +176,7 @@ watchable_buffer_t<value_t>::watchable_buffer_t(
 
 template<class value_t>
 void watchable_buffer_t<value_t>::notify() {
+    dirty = true;
     if (!coro_running) {
         coro_running = true;
         auto_drainer_t::lock_t keepalive(&drainer);
@@ -192,8 +194,19 @@ void watchable_buffer_t<value_t>::notify() {
             update, so that if `output.set_value_no_equals()` somehow causes `notify` to
             be called again, the new update will still get delivered eventually. */
             coro_running = false;
-            output.set_value_no_equals(input->get());
+            if (dirty) {
+                dirty = false;
+                output.set_value_no_equals(input->get());
+            }
         });
     }
 }
 
+template<class value_t>
+void watchable_buffer_t<value_t>::flush() {
+    if (dirty) {
+        dirty = false;
+        output.set_value_no_equals(input->get());
+    }
+}
+
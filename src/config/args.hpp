@@ -28,15 +28,17 @@
  * Basic configuration parameters.
  */
 
-// The number of hash-based CPU shards per table.
-// This "must" be hard-coded because a cluster cannot run with
-// differing cpu sharding factors.
+// The default number of hash-based CPU shards per table.  Each table's
+// `cpu_shards` setting decides how many it really has.  Every replica of a table
+// must use the same number, so it can't change after the table is created.
 #define CPU_SHARDING_FACTOR                       8
+#define MAX_CPU_SHARDING_FACTOR                   64
 
 // Defines the maximum size of the batch of IO events to process on
 // each loop iteration. A larger number will increase throughput but
-// decrease concurrency
-#define MAX_IO_EVENT_PROCESSING_BATCH_SIZE        50
+// decrease concurrency. With many connections per thread, taking more events
+// per wakeup saves `epoll_wait` calls.
+#define MAX_IO_EVENT_PROCESSING_BATCH_SIZE        256
 
 // The io batch factor ensures a minimum number of i/o operations
 // which are picked from any specific i/o account consecutively.
@@ -51,6 +53,14 @@
 // useful.
 #define DEFAULT_IO_BATCH_FACTOR                   1
 
+// The disk backend merges reads (or writes) of adjacent parts of a file into one
+// request of at most this many bytes.
+#define MAX_MERGED_IO_SIZE                        MEGABYTE
+
+// Spinning disks get at most this many concurrent I/O requests.  Deeper queues only
+// add latency there, and they keep a slow disk from tying up more threads.
+#define ROTATIONAL_MAX_CONCURRENT_IO_REQUESTS     16
+
 // I/O priority of index writes in the log serializer
 #define INDEX_WRITE_IO_PRIORITY                   128
 
@@ -73,6 +83,34 @@
 // 0 = minimal priority
 #define SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY   5
 
+// The cache priority of the shard reads of queries run with `priority: "batch"`,
+// on the same scale.
+#define BATCH_QUERY_CACHE_PRIORITY                20
+
+// The primary key filter of a store (see `key_filter_t`) is sized for at least this
+// many keys, and for twice as many as the table had when it was built.  It's built
+// again when it gets full.
+#define PRIMARY_KEY_FILTER_MIN_CAPACITY           (64 * KILOBYTE)
+
+// How often each cache writes the list of the blocks it has in memory, so that it
+// can load them again after a restart. It also writes one when it shuts down.
+#define CACHE_WARMUP_SNAPSHOT_INTERVAL_MS         (10 * 60 * 1000)
+
+// I/O priority for loading the blocks from the warmup snapshot at startup, and how
+// many of those reads each cache may have in flight. Kept low so that warming up
+// doesn't slow down the queries that come in meanwhile.
+#define CACHE_WARMUP_IO_PRIORITY                  8
+#define CACHE_WARMUP_MAX_OUTSTANDING_READS        8
+
+// How many blocks from the warmup snapshot we look up and read at a time. Each
+// batch is read in disk order.
+#define CACHE_WARMUP_BATCH_SIZE                   256
+
+// How many secondary indexes a single write updates at a time. Each update is a
+// coroutine with its own btree descent, so this bounds what a write to a heavily
+// indexed table can have in flight.
+#define MAX_CONCURRENT_SINDEX_UPDATES             16
+
 // Size of the buffer used to perform IO operations (in bytes).
 #define IO_BUFFER_SIZE                            (4 * KILOBYTE)
 
@@ -90,9 +128,18 @@
 // inefficient (especially on rotational drives).
 #define DEFAULT_EXTENT_SIZE                       (2 * MEGABYTE)
 
+// How old the stats snapshot that `stat_manager_t` serves requests from can get before a
+// request collects the stats again
+#define STATS_SNAPSHOT_MAX_AGE_MS                 500
+
 // Ratio of free ram to use for the cache by default
 #define DEFAULT_MAX_CACHE_RATIO                   2
 
+// How often an automatically sized cache is resized to follow the available memory,
+// and by how much (as a fraction of the current size) the size has to change first
+#define AUTO_CACHE_SIZE_INTERVAL_MS               (10 * THOUSAND)
+#define AUTO_CACHE_SIZE_MIN_CHANGE_RATIO          10
+
 // The maximum number of concurrently active
 // index writes per merger serializer.
 // The smaller the number, the more effective
@@ -102,6 +149,11 @@
 // small values of this variable.
 #define MERGER_SERIALIZER_MAX_ACTIVE_WRITES       1
 
+// How long the merger serializer may hold back an index write, in
+// microseconds, to let further index writes join it. Every hard durability
+// write waits for an index write, so merging them saves datasyncs.
+#define MERGER_SERIALIZER_MAX_COMMIT_DELAY_USECS  200
+
 // I/O priority of block writes in the merger_serializer_t
 #define MERGER_BLOCK_WRITE_IO_PRIORITY            64
 
@@ -109,6 +161,24 @@
 // TODO: make this dynamic where possible
 #define MAX_THREADS                               128
 
+// Maximum number of extproc worker processes (for r.js and r.http) we allow
+#define MAX_EXTPROC_WORKERS                       1024
+
+// How many queries a single client connection may run at once, by default and at
+// most.  Further queries wait, and eventually stop us from reading the connection.
+#define DEFAULT_MAX_QUERIES_PER_CONNECTION        1024
+#define MAX_QUERIES_PER_CONNECTION                65536
+
+// How many queries run with `priority: "batch"` each thread starts at once; the
+// others wait for one of them to finish.  Interactive queries aren't limited.
+#define MAX_BATCH_QUERIES_PER_THREAD              2
+
+// How many expired rows each primary replica of a table with an `expiry` deletes per
+// second, by default.  They're deleted in one batch per second, or every
+// `EXPIRY_IDLE_INTERVAL_MS` once there were fewer expired rows than that.
+#define DEFAULT_EXPIRY_DELETES_PER_SEC            1000
+#define EXPIRY_IDLE_INTERVAL_MS                   10000
+
 // Ticks (in milliseconds) the internal timed tasks are performed at
 #define TIMER_TICKS_IN_MS                         5
 
@@ -129,6 +199,19 @@
 // How large can the key be, in bytes?  This value needs to fit in a byte.
 #define MAX_KEY_SIZE                              250
 
+// How many bytes of changes each changefeed server keeps around for resumed
+// changefeeds to replay, while a resumable changefeed is subscribed to it.
+#define CHANGEFEED_RESUME_LOG_BYTES               (8 * MEGABYTE)
+
+// The most changefeed messages a changefeed server puts into one mailbox
+// message to a feed.  Smaller batches go out once the sending coroutine yields.
+#define CHANGEFEED_MAX_BATCH_MSGS                 256
+
+// How many items past the end of an `orderBy.limit` changefeed's window each shard
+// keeps in memory (or fewer, if the limit is smaller), so that most items
+// leaving the window can be replaced without reading from disk.
+#define CHANGEFEED_LIMIT_MAX_SPARES               128
+
 // Special block IDs.  These don't really belong here because they're
 // more magic constants than tunable parameters.
 
@@ -144,6 +227,9 @@
 // I/O priority for LBA garbage collection
 #define LBA_GC_IO_PRIORITY                        8
 
+// I/O priority for reading the LBA when starting up
+#define LBA_STARTUP_IO_PRIORITY                   CACHE_READS_IO_PRIORITY
+
 // How many block ids should the LBA garbage collector rewrite before yielding?
 #define LBA_GC_BATCH_SIZE                         (1024 * 8)
 
@@ -168,9 +254,12 @@
 
 #define COROUTINE_STACK_SIZE                      131072
 
-// How many unused coroutine stacks to keep around (maximally), before they are
-// freed. This value is per thread.
+// How many unused coroutine stacks to keep around with their memory intact.  Past
+// that, stacks that go unused are trimmed (their used pages are given back to the
+// operating system), and we keep up to `COROUTINE_TRIMMED_FREE_LIST_SIZE` of those
+// before they are freed.  These values are per thread.
 #define COROUTINE_FREE_LIST_SIZE                  64
+#define COROUTINE_TRIMMED_FREE_LIST_SIZE          1024
 
 // In debug mode, we print a warning if more than this many coroutines have been
 // allocated on one thread.
@@ -221,6 +310,7 @@
 #define CORO_PRIORITY_REACTOR                   (-1)
 #define CORO_PRIORITY_DIRECTORY_CHANGES         (-2)
 #define CORO_PRIORITY_LBA_GC                    (-2)
+#define CORO_PRIORITY_BATCH_QUERY               (-1)
 
 #endif  // CONFIG_ARGS_HPP_
 
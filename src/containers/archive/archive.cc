@@ -5,6 +5,8 @@
 #include <netinet/in.h>
 
 #include <algorithm>
+#include <new>
+#include <vector>
 
 #include "containers/archive/versioned.hpp"
 #include "containers/uuid.hpp"
@@ -29,7 +31,7 @@ const char *archive_result_as_str(archive_result_t archive_result) {
     }
 }
 
-int64_t force_read(read_stream_t *s, void *p, int64_t n) {
+int64_t force_read_from_stream(read_stream_t *s, void *p, int64_t n) {
     rassert(n >= 0);
 
     char *chp = static_cast<char *>(p);
@@ -53,46 +55,88 @@ int64_t force_read(read_stream_t *s, void *p, int64_t n) {
     return written_so_far;
 }
 
+write_buffer_t *write_buffer_t::create(int64_t capacity) {
+    rassert(capacity > 0);
+    void *memory = ::operator new(sizeof(write_buffer_t) + capacity);
+    return new (memory) write_buffer_t(capacity);
+}
+
+void write_buffer_t::destroy(write_buffer_t *buffer) {
+    buffer->~write_buffer_t();
+    ::operator delete(buffer);
+}
+
 write_message_t::~write_message_t() {
     while (write_buffer_t *buffer = buffers_.head()) {
         buffers_.remove(buffer);
-        delete buffer;
+        write_buffer_t::destroy(buffer);
     }
 }
 
+void write_message_t::add_buffer(int64_t min_capacity) {
+    const int64_t capacity = std::min<int64_t>(
+        std::max<int64_t>(size_, write_buffer_t::MIN_DATA_SIZE),
+        write_buffer_t::MAX_DATA_SIZE);
+    buffers_.push_back(write_buffer_t::create(std::max(capacity, min_capacity)));
+}
+
 void write_message_t::append(const void *p, int64_t n) {
     while (n > 0) {
-        if (buffers_.empty() || buffers_.tail()->size == write_buffer_t::DATA_SIZE) {
-            buffers_.push_back(new write_buffer_t);
+        if (buffers_.empty() || buffers_.tail()->size == buffers_.tail()->capacity) {
+            add_buffer(n);
         }
 
         write_buffer_t *b = buffers_.tail();
-        int64_t k = std::min<int64_t>(n, write_buffer_t::DATA_SIZE - b->size);
+        int64_t k = std::min<int64_t>(n, b->capacity - b->size);
 
         memcpy(b->data + b->size, p, k);
         b->size += k;
+        size_ += k;
         p = static_cast<const char *>(p) + k;
         n = n - k;
     }
 }
 
-size_t write_message_t::size() const {
-    size_t ret = 0;
-    for (write_buffer_t *h = buffers_.head(); h != NULL; h = buffers_.next(h)) {
-        ret += h->size;
+void write_message_t::reserve(int64_t n) {
+    if (n > 0
+        && (buffers_.empty()
+            || buffers_.tail()->capacity - buffers_.tail()->size < n)) {
+        add_buffer(n);
     }
-    return ret;
 }
 
-int send_write_message(write_stream_t *s, const write_message_t *wm) {
-    intrusive_list_t<write_buffer_t> *list = const_cast<write_message_t *>(wm)->unsafe_expose_buffers();
-    for (write_buffer_t *p = list->head(); p; p = list->next(p)) {
-        int64_t res = s->write(p->data, p->size);
+int64_t write_stream_t::write_vectored(const iovec *iov, size_t iovcnt) {
+    int64_t total = 0;
+    for (size_t i = 0; i < iovcnt; ++i) {
+        int64_t res = write(iov[i].iov_base, iov[i].iov_len);
         if (res == -1) {
             return -1;
         }
-        rassert(res == p->size);
+        rassert(res == static_cast<int64_t>(iov[i].iov_len));
+        total += res;
+    }
+    return total;
+}
+
+int send_write_message(write_stream_t *s, const write_message_t *wm) {
+    intrusive_list_t<write_buffer_t> *list = const_cast<write_message_t *>(wm)->unsafe_expose_buffers();
+    std::vector<iovec> iov;
+    DEBUG_VAR int64_t total = 0;
+    for (write_buffer_t *p = list->head(); p; p = list->next(p)) {
+        iovec entry;
+        entry.iov_base = p->data;
+        entry.iov_len = p->size;
+        iov.push_back(entry);
+        total += p->size;
+    }
+    if (iov.empty()) {
+        return 0;
+    }
+    int64_t res = s->write_vectored(iov.data(), iov.size());
+    if (res == -1) {
+        return -1;
     }
+    rassert(res == total);
     return 0;
 }
 
@@ -3,6 +3,8 @@
 #define CONTAINERS_ARCHIVE_ARCHIVE_HPP_
 
 #include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
 
 #include <string>
 #include <type_traits>
@@ -22,11 +24,30 @@ struct fake_archive_exc_t {
 
 class read_stream_t {
 public:
-    read_stream_t() { }
+    read_stream_t() : contiguous_pos_(NULL), contiguous_end_(NULL) { }
     // Returns number of bytes read or 0 upon EOF, -1 upon error.
     virtual MUST_USE int64_t read(void *p, int64_t n) = 0;
+
+    // Reads `n` bytes without a virtual call if the stream reads from a buffer in
+    // memory that has at least that many bytes left.  Otherwise returns false without
+    // reading anything.
+    MUST_USE bool read_contiguous(void *p, int64_t n) {
+        if (contiguous_end_ - contiguous_pos_ < n) {
+            return false;
+        }
+        memcpy(p, contiguous_pos_, n);
+        contiguous_pos_ += n;
+        return true;
+    }
+
 protected:
     virtual ~read_stream_t() { }
+
+    // Streams that read from a contiguous buffer in memory point these at the part of
+    // it that hasn't been read yet, and keep their position in `contiguous_pos_`.
+    const char *contiguous_pos_;
+    const char *contiguous_end_;
+
 private:
     DISABLE_COPYING(read_stream_t);
 };
@@ -76,30 +97,53 @@ private:
         }                                                               \
     } while (0)
 
+// Keeps calling `s->read()` until `n` bytes are read. Use `force_read` instead.
+MUST_USE int64_t force_read_from_stream(read_stream_t *s, void *p, int64_t n);
+
 // Returns the number of bytes written, or -1.  Returns a
 // non-negative value less than n upon EOF.
-MUST_USE int64_t force_read(read_stream_t *s, void *p, int64_t n);
+inline MUST_USE int64_t force_read(read_stream_t *s, void *p, int64_t n) {
+    if (s->read_contiguous(p, n)) {
+        return n;
+    }
+    return force_read_from_stream(s, p, n);
+}
 
 class write_stream_t {
 public:
     write_stream_t() { }
     // Returns n, or -1 upon error. Blocks until all bytes are written.
     virtual MUST_USE int64_t write(const void *p, int64_t n) = 0;
+    // Writes `iovcnt` buffers one after another. Returns their total size, or -1
+    // upon error. The default implementation calls `write()` for each of them;
+    // streams that can hand several buffers to the kernel at once override it.
+    virtual MUST_USE int64_t write_vectored(const iovec *iov, size_t iovcnt);
 protected:
     virtual ~write_stream_t() { }
 private:
     DISABLE_COPYING(write_stream_t);
 };
 
+// A chunk of a `write_message_t`, allocated together with its data.
 class write_buffer_t : public intrusive_list_node_t<write_buffer_t> {
 public:
-    write_buffer_t() : size(0) { }
+    static write_buffer_t *create(int64_t capacity);
+    static void destroy(write_buffer_t *buffer);
+
+    // The smallest and largest capacities that `write_message_t` picks for its
+    // buffers, unless it's asked to append or reserve more than that at once.
+    static const int64_t MIN_DATA_SIZE = 4096;
+    static const int64_t MAX_DATA_SIZE = 1024 * 1024;
 
-    static const int DATA_SIZE = 4096;
-    int size;
-    char data[DATA_SIZE];
+    const int64_t capacity;
+    int64_t size;
+    char *const data;
 
 private:
+    explicit write_buffer_t(int64_t _capacity)
+        : capacity(_capacity), size(0), data(reinterpret_cast<char *>(this + 1)) { }
+    ~write_buffer_t() { }
+
     DISABLE_COPYING(write_buffer_t);
 };
 
@@ -109,21 +153,33 @@ private:
 // flush.  This type can be extended to support holding references to
 // large buffers, to save copying.)  Generally speaking, you serialize
 // to a write_message_t, and then flush that to a write_stream_t.
+//
+// Each buffer is about as large as the message before it (within the bounds of
+// `write_buffer_t`), so a large message takes few allocations. Serializers that know
+// how large their output will be can `reserve()` it, so that it's written into a single
+// buffer.
 class write_message_t {
 public:
-    write_message_t() { }
+    write_message_t() : size_(0) { }
     ~write_message_t();
 
     void append(const void *p, int64_t n);
 
-    size_t size() const;
+    // Makes sure that the next `n` bytes that are appended go into one buffer.
+    void reserve(int64_t n);
+
+    size_t size() const { return size_; }
 
     intrusive_list_t<write_buffer_t> *unsafe_expose_buffers() { return &buffers_; }
 
 private:
     friend int send_write_message(write_stream_t *s, const write_message_t *wm);
 
+    // Adds a buffer with room for at least `min_capacity` bytes.
+    void add_buffer(int64_t min_capacity);
+
     intrusive_list_t<write_buffer_t> buffers_;
+    size_t size_;
 
     DISABLE_COPYING(write_message_t);
 };
@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "containers/archive/archive.hpp"
+#include "containers/shared_buffer.hpp"
 
 // Reads from a buffer without taking ownership over it
 class buffer_read_stream_t : public read_stream_t {
@@ -17,32 +18,76 @@ public:
     // we can probably move this back to a .cc file.
 
     explicit buffer_read_stream_t(const char *buf, size_t size, int64_t offset = 0)
-        : pos_(offset), buf_(buf), size_(size) {
-        guarantee(pos_ >= 0);
-        guarantee(static_cast<uint64_t>(pos_) <= size_);
+        : buf_(buf) {
+        guarantee(offset >= 0);
+        guarantee(static_cast<uint64_t>(offset) <= size);
+        contiguous_pos_ = buf + offset;
+        contiguous_end_ = buf + size;
     }
     virtual ~buffer_read_stream_t() { }
 
     virtual MUST_USE int64_t read(void *p, int64_t n) {
-        int64_t num_left = size_ - pos_;
+        int64_t num_left = contiguous_end_ - contiguous_pos_;
         int64_t num_to_read = n < num_left ? n : num_left;
 
-        memcpy(p, buf_ + pos_, num_to_read);
+        memcpy(p, contiguous_pos_, num_to_read);
 
-        pos_ += num_to_read;
+        contiguous_pos_ += num_to_read;
 
         return num_to_read;
     }
 
-    int64_t tell() const { return pos_; }
+    int64_t tell() const { return contiguous_pos_ - buf_; }
 
 private:
-    int64_t pos_;
     const char *buf_;
-    size_t size_;
 
     DISABLE_COPYING(buffer_read_stream_t);
 };
 
+// Reads from a `shared_buf_t`, which it keeps alive.  Deserializers can refer to
+// parts of the buffer with `ref_at()` instead of copying them out of it.
+class shared_buf_read_stream_t : public read_stream_t {
+public:
+    explicit shared_buf_read_stream_t(counted_t<const shared_buf_t> &&buf)
+        : buf_(std::move(buf)) {
+        contiguous_pos_ = buf_->data();
+        contiguous_end_ = buf_->data() + buf_->size();
+    }
+    virtual ~shared_buf_read_stream_t() { }
+
+    virtual MUST_USE int64_t read(void *p, int64_t n) {
+        int64_t num_left = contiguous_end_ - contiguous_pos_;
+        int64_t num_to_read = n < num_left ? n : num_left;
+
+        memcpy(p, contiguous_pos_, num_to_read);
+
+        contiguous_pos_ += num_to_read;
+
+        return num_to_read;
+    }
+
+    int64_t tell() const { return contiguous_pos_ - buf_->data(); }
+
+    // Skips `n` bytes.  Returns false, without skipping anything, if there are fewer
+    // left.
+    MUST_USE bool skip(int64_t n) {
+        if (contiguous_end_ - contiguous_pos_ < n) {
+            return false;
+        }
+        contiguous_pos_ += n;
+        return true;
+    }
+
+    shared_buf_ref_t<char> ref_at(int64_t offset) const {
+        return shared_buf_ref_t<char>(buf_, offset);
+    }
+
+private:
+    counted_t<const shared_buf_t> buf_;
+
+    DISABLE_COPYING(shared_buf_read_stream_t);
+};
+
 
 #endif  // CONTAINERS_ARCHIVE_BUFFER_STREAM_HPP_
@@ -32,7 +32,6 @@ public:
 
 private:
     std::string source;
-    int64_t offset;
 
     DISABLE_COPYING(string_read_stream_t);
 };
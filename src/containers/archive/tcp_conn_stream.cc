@@ -39,6 +39,21 @@ int64_t tcp_conn_stream_t::write(const void *p, int64_t n) {
     }
 }
 
+int64_t tcp_conn_stream_t::write_vectored(const iovec *iov, size_t iovcnt) {
+    try {
+        // write_vectored writes everything or throws an exception.
+        cond_t non_closer;
+        conn_->write_vectored(iov, iovcnt, &non_closer);
+        int64_t total = 0;
+        for (size_t i = 0; i < iovcnt; ++i) {
+            total += iov[i].iov_len;
+        }
+        return total;
+    } catch (const tcp_conn_write_closed_exc_t &) {
+        return -1;
+    }
+}
+
 void tcp_conn_stream_t::rethread(threadnum_t new_thread) {
     conn_->rethread(new_thread);
 }
@@ -98,6 +113,14 @@ int64_t keepalive_tcp_conn_stream_t::write(const void *p, int64_t n) {
     return tcp_conn_stream_t::write(p, n);
 }
 
+int64_t keepalive_tcp_conn_stream_t::write_vectored(const iovec *iov, size_t iovcnt) {
+    if (keepalive_callback != NULL) {
+        keepalive_callback->keepalive_write();
+    }
+
+    return tcp_conn_stream_t::write_vectored(iov, iovcnt);
+}
+
 rethread_tcp_conn_stream_t::rethread_tcp_conn_stream_t(tcp_conn_stream_t *conn, threadnum_t thread)
     : conn_(conn), old_thread_(conn->home_thread()), new_thread_(thread) {
     conn->rethread(thread);
@@ -19,6 +19,7 @@ public:
 
     virtual MUST_USE int64_t read(void *p, int64_t n);
     virtual MUST_USE int64_t write(const void *p, int64_t n);
+    virtual MUST_USE int64_t write_vectored(const iovec *iov, size_t iovcnt);
 
     void rethread(threadnum_t new_thread);
 
@@ -58,6 +59,7 @@ public:
 
     virtual MUST_USE int64_t read(void *p, int64_t n);
     virtual MUST_USE int64_t write(const void *p, int64_t n);
+    virtual MUST_USE int64_t write_vectored(const iovec *iov, size_t iovcnt);
 
 private:
     keepalive_callback_t *keepalive_callback;
@@ -39,7 +39,7 @@ inline archive_result_t deserialize_varint_uint64(read_stream_t *s, uint64_t *va
     int offset = 0;
     for (;;) {
         uint8_t buf[1];
-        int64_t res = s->read(buf, 1);
+        int64_t res = s->read_contiguous(buf, 1) ? 1 : s->read(buf, 1);
         if (res == 1) {
             uint64_t x = (buf[0] & ((1 << 7) - 1));
             value |= (x << offset);
@@ -23,30 +23,33 @@ void vector_stream_t::reserve(size_t reserve_size) {
 }
 
 vector_read_stream_t::vector_read_stream_t(std::vector<char> &&vector, int64_t offset)
-    : pos_(offset), vec_(std::move(vector)) {
-    guarantee(pos_ >= 0);
-    guarantee(static_cast<uint64_t>(pos_) <= vec_.size());
+    : vec_(std::move(vector)) {
+    guarantee(offset >= 0);
+    guarantee(static_cast<uint64_t>(offset) <= vec_.size());
+    contiguous_pos_ = vec_.data() + offset;
+    contiguous_end_ = vec_.data() + vec_.size();
 }
 vector_read_stream_t::~vector_read_stream_t() { }
 
 int64_t vector_read_stream_t::read(void *p, int64_t n) {
-    int64_t num_left = vec_.size() - pos_;
+    int64_t num_left = contiguous_end_ - contiguous_pos_;
     int64_t num_to_read = n < num_left ? n : num_left;
 
-    memcpy(p, vec_.data() + pos_, num_to_read);
+    memcpy(p, contiguous_pos_, num_to_read);
 
-    pos_ += num_to_read;
+    contiguous_pos_ += num_to_read;
 
     return num_to_read;
 }
 
 void vector_read_stream_t::swap(std::vector<char> *other_vec, int64_t *other_pos) {
-    int64_t temp_pos = *other_pos;
-    *other_pos = pos_;
-    pos_ = temp_pos;
+    int64_t pos = *other_pos;
+    *other_pos = contiguous_pos_ - vec_.data();
 
     vec_.swap(*other_vec);
 
-    guarantee(pos_ >= 0);
-    guarantee(static_cast<uint64_t>(pos_) <= vec_.size());
+    guarantee(pos >= 0);
+    guarantee(static_cast<uint64_t>(pos) <= vec_.size());
+    contiguous_pos_ = vec_.data() + pos;
+    contiguous_end_ = vec_.data() + vec_.size();
 }
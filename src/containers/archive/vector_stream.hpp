@@ -35,7 +35,6 @@ public:
     void swap(std::vector<char> *other_vec, int64_t *other_pos);
 
 private:
-    int64_t pos_;
     std::vector<char> vec_;
 
     DISABLE_COPYING(vector_read_stream_t);
@@ -0,0 +1,66 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "containers/arena.hpp"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "config/args.hpp"
+#include "utils.hpp"
+
+// The first chunk we allocate once we run out of space. Every chunk after it is
+// twice the size of the previous one, up to `MAX_ARENA_CHUNK_SIZE`.
+const size_t MIN_ARENA_CHUNK_SIZE = KILOBYTE;
+const size_t MAX_ARENA_CHUNK_SIZE = 64 * KILOBYTE;
+
+arena_t::arena_t()
+    : current(NULL), end(NULL), chunks(NULL), next_chunk_size(MIN_ARENA_CHUNK_SIZE) { }
+
+arena_t::arena_t(char *initial_buffer, size_t initial_size)
+    : current(initial_buffer), end(initial_buffer + initial_size), chunks(NULL),
+      next_chunk_size(MIN_ARENA_CHUNK_SIZE) { }
+
+arena_t::~arena_t() {
+    while (chunks != NULL) {
+        chunk_header_t *next = chunks->next;
+        ::free(chunks);
+        chunks = next;
+    }
+}
+
+static char *align_up(char *p, size_t alignment) {
+    rassert((alignment & (alignment - 1)) == 0);
+    const uintptr_t value = reinterpret_cast<uintptr_t>(p);
+    return reinterpret_cast<char *>((value + alignment - 1) & ~(alignment - 1));
+}
+
+void *arena_t::allocate(size_t size, size_t alignment) {
+    if (current != NULL) {
+        char *result = align_up(current, alignment);
+        if (result <= end && size <= static_cast<size_t>(end - result)) {
+            current = result + size;
+            return result;
+        }
+    }
+    return allocate_from_new_chunk(size, alignment);
+}
+
+void *arena_t::allocate_from_new_chunk(size_t size, size_t alignment) {
+    const size_t needed = sizeof(chunk_header_t) + alignment + size;
+    // Big allocations get a chunk of their own, so that we keep allocating from
+    // whatever space is left in the current one.
+    const bool oversized = needed > next_chunk_size;
+    const size_t chunk_size = oversized ? needed : next_chunk_size;
+    chunk_header_t *chunk = static_cast<chunk_header_t *>(rmalloc(chunk_size));
+    chunk->next = chunks;
+    chunks = chunk;
+
+    char *result = align_up(reinterpret_cast<char *>(chunk + 1), alignment);
+    if (!oversized) {
+        current = result + size;
+        end = reinterpret_cast<char *>(chunk) + chunk_size;
+        next_chunk_size = std::min(2 * next_chunk_size, MAX_ARENA_CHUNK_SIZE);
+    }
+    return result;
+}
@@ -0,0 +1,126 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_ARENA_HPP_
+#define CONTAINERS_ARENA_HPP_
+
+#include <stddef.h>
+
+#include <limits>
+#include <new>
+#include <utility>
+
+#include "errors.hpp"
+
+/* `arena_t` is a bump allocator for short-lived scratch data. Allocations are carved
+out of a chain of chunks and are never freed individually; all of the memory is
+released at once when the arena is destroyed. This makes it a good fit for node-based
+containers that are filled, read out and then thrown away, since every node otherwise
+costs a separate trip through `malloc` and `free`.
+
+The arena doesn't run destructors; whoever allocated an object from it is responsible
+for destroying that object before the arena goes away. */
+class arena_t {
+public:
+    arena_t();
+    ~arena_t();
+
+    void *allocate(size_t size, size_t alignment);
+
+protected:
+    // The arena allocates from `initial_buffer` before it starts allocating chunks.
+    // The buffer must outlive the arena.
+    arena_t(char *initial_buffer, size_t initial_size);
+
+private:
+    struct chunk_header_t {
+        chunk_header_t *next;
+    };
+
+    void *allocate_from_new_chunk(size_t size, size_t alignment);
+
+    char *current;
+    char *end;
+    chunk_header_t *chunks;
+    size_t next_chunk_size;
+
+    DISABLE_COPYING(arena_t);
+};
+
+/* An `arena_t` with the first `inline_size` bytes stored in the object itself, so
+small workloads don't allocate at all. */
+template <size_t inline_size>
+class inline_arena_t : public arena_t {
+public:
+    inline_arena_t() : arena_t(buffer, inline_size) { }
+
+private:
+    // Aligned for anything we might put into it.
+    union {
+        char buffer[inline_size];
+        long double alignment_dummy_1;
+        void *alignment_dummy_2;
+    };
+};
+
+/* An STL allocator that allocates from an `arena_t`. Deallocation does nothing; the
+memory comes back when the arena is destroyed. */
+template <class T>
+class arena_allocator_t {
+public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <class U>
+    struct rebind {
+        typedef arena_allocator_t<U> other;
+    };
+
+    explicit arena_allocator_t(arena_t *_arena) : arena(_arena) { }
+    template <class U>
+    arena_allocator_t(const arena_allocator_t<U> &other)  // NOLINT(runtime/explicit)
+        : arena(other.arena) { }
+
+    pointer address(reference x) const { return &x; }
+    const_pointer address(const_reference x) const { return &x; }
+
+    pointer allocate(size_type n, const void * = NULL) {
+        if (n > max_size()) {
+            throw std::bad_alloc();
+        }
+        return static_cast<pointer>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(pointer, size_type) { }
+
+    size_type max_size() const {
+        return std::numeric_limits<size_type>::max() / sizeof(T);
+    }
+
+    template <class U, class... Args>
+    void construct(U *p, Args &&... args) {
+        new (p) U(std::forward<Args>(args)...);
+    }
+    template <class U>
+    void destroy(U *p) {
+        p->~U();
+    }
+
+    template <class U>
+    bool operator==(const arena_allocator_t<U> &other) const {
+        return arena == other.arena;
+    }
+    template <class U>
+    bool operator!=(const arena_allocator_t<U> &other) const {
+        return arena != other.arena;
+    }
+
+private:
+    template <class U> friend class arena_allocator_t;
+
+    arena_t *arena;
+};
+
+#endif  // CONTAINERS_ARENA_HPP_
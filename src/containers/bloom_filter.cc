@@ -0,0 +1,76 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "containers/bloom_filter.hpp"
+
+#include <algorithm>
+
+// With ten bits per key and seven bits set per key, a blocked filter has a false
+// positive rate of a bit under 1%.
+static const size_t BITS_PER_KEY = 10;
+static const int BITS_SET_PER_KEY = 7;
+
+// 64-bit FNV-1a, followed by the finalizer from MurmurHash3 so that the high and low
+// halves are both well mixed.
+static uint64_t hash_bytes(const void *data, size_t size) {
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= bytes[i];
+        h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+bloom_filter_t::bloom_filter_t(size_t capacity)
+    : num_blocks_(std::max<size_t>(1,
+          (capacity * BITS_PER_KEY + WORDS_PER_BLOCK * 64 - 1)
+          / (WORDS_PER_BLOCK * 64))),
+      count_(0),
+      capacity_(capacity) {
+    words_.resize(num_blocks_ * WORDS_PER_BLOCK, 0);
+}
+
+size_t bloom_filter_t::block_offset(uint64_t hash) const {
+    return ((hash >> 32) % num_blocks_) * WORDS_PER_BLOCK;
+}
+
+bool bloom_filter_t::add(const void *data, size_t size) {
+    const uint64_t hash = hash_bytes(data, size);
+    uint64_t *block = &words_[block_offset(hash)];
+    // Double hashing within the block, using the low half of the hash.
+    uint32_t h = static_cast<uint32_t>(hash);
+    const uint32_t delta = (h >> 17) | (h << 15);
+    bool added = false;
+    for (int i = 0; i < BITS_SET_PER_KEY; ++i) {
+        const uint32_t bit = h % (WORDS_PER_BLOCK * 64);
+        const uint64_t mask = uint64_t(1) << (bit % 64);
+        if ((block[bit / 64] & mask) == 0) {
+            block[bit / 64] |= mask;
+            added = true;
+        }
+        h += delta;
+    }
+    if (added) {
+        ++count_;
+    }
+    return added;
+}
+
+bool bloom_filter_t::may_contain(const void *data, size_t size) const {
+    const uint64_t hash = hash_bytes(data, size);
+    const uint64_t *block = &words_[block_offset(hash)];
+    uint32_t h = static_cast<uint32_t>(hash);
+    const uint32_t delta = (h >> 17) | (h << 15);
+    for (int i = 0; i < BITS_SET_PER_KEY; ++i) {
+        const uint32_t bit = h % (WORDS_PER_BLOCK * 64);
+        if ((block[bit / 64] & (uint64_t(1) << (bit % 64))) == 0) {
+            return false;
+        }
+        h += delta;
+    }
+    return true;
+}
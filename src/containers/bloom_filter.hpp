@@ -0,0 +1,41 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_BLOOM_FILTER_HPP_
+#define CONTAINERS_BLOOM_FILTER_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "errors.hpp"
+
+/* `bloom_filter_t` is a blocked Bloom filter over byte strings: all of the bits for a
+key are in the same 64-byte block, so a lookup touches a single cache line. Sized for
+its capacity, it answers "maybe" for about 1% of the keys it hasn't seen. */
+class bloom_filter_t {
+public:
+    explicit bloom_filter_t(size_t capacity);
+
+    /* Returns `true` if `data` wasn't in the filter before. */
+    bool add(const void *data, size_t size);
+    bool may_contain(const void *data, size_t size) const;
+
+    /* The number of distinct keys that have been added, give or take the keys that
+    were mistaken for ones that had been. */
+    size_t count() const { return count_; }
+    size_t capacity() const { return capacity_; }
+
+private:
+    static const size_t WORDS_PER_BLOCK = 8;
+
+    size_t block_offset(uint64_t hash) const;
+
+    std::vector<uint64_t> words_;
+    size_t num_blocks_;
+    size_t count_;
+    size_t capacity_;
+
+    DISABLE_COPYING(bloom_filter_t);
+};
+
+#endif  // CONTAINERS_BLOOM_FILTER_HPP_
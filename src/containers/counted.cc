@@ -0,0 +1,41 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "containers/counted.hpp"
+
+#include "arch/runtime/thread_pool.hpp"
+#include "do_on_thread.hpp"
+#include "thread_local.hpp"
+
+TLS_with_init(int32_t, biased_countable_thread, -1);
+
+int32_t biased_countable_current_thread() {
+#ifdef THREADED_COROUTINES
+    // The emulated thread-local storage is indexed by thread number.
+    if (get_thread_id().threadnum < 0) {
+        return -1;
+    }
+#endif
+    return TLS_get_biased_countable_thread();
+}
+
+int32_t biased_countable_new_owner() {
+    int32_t thread = biased_countable_current_thread();
+    if (thread == -1
+        && linux_thread_pool_t::get_thread_pool() != NULL
+        && get_thread_id().threadnum >= 0) {
+        thread = get_thread_id().threadnum;
+        TLS_set_biased_countable_thread(thread);
+    }
+    return thread;
+}
+
+void biased_countable_release_on_thread(int32_t thread,
+                                        void (*release)(const void *),
+                                        const void *p) {
+    if (linux_thread_pool_t::get_thread_pool() == NULL) {
+        // The thread pool has shut down (we're destroying globals on the main
+        // thread), so nothing can race with us.
+        release(p);
+        return;
+    }
+    do_on_thread(threadnum_t(thread), [release, p]() { release(p); });
+}
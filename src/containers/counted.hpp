@@ -282,10 +282,170 @@ private:
     DISABLE_COPYING(movable_t);
 };
 
-// Extends an arbitrary object with a slow_atomic_countable_t
+/* `biased_countable_t` is a reference count that costs no atomic operations on the
+thread that created the object (its owner), but that stays correct when references
+are copied and released on other threads.
+
+The owner counts its references in the plain `biased_`; other threads count theirs
+atomically in `shared_`, which starts at `BIAS` so that it cannot drop to zero while
+the owner is still counting. Since a reference may be copied on one thread and
+released on another, neither `biased_` nor `shared_ - BIAS` alone is meaningful, but
+their sum is the number of references. When `biased_` drops to zero, the owner folds
+it into `shared_` and from then on every thread counts atomically. A release on
+another thread that might be the last one (`shared_` is at most `BIAS + 1`) is sent
+to the owner, which is the only thread that can tell.
+
+Objects created outside of the thread pool are counted atomically from the start.
+References to an object created in the thread pool must not be released in the
+blocker pool. */
+
+template <class> class biased_countable_t;
+
+template <class T>
+inline void counted_add_ref(const biased_countable_t<T> *p);
+template <class T>
+inline void counted_release(const biased_countable_t<T> *p);
+template <class T>
+inline intptr_t counted_use_count(const biased_countable_t<T> *p);
+
+// Returns the thread number to record as the owner of a new `biased_countable_t`,
+// or -1 if the current thread is not in the thread pool.
+int32_t biased_countable_new_owner();
+// Returns the current thread's number if `biased_countable_new_owner()` has been
+// called on it, and -1 otherwise.
+int32_t biased_countable_current_thread();
+// Calls `release(p)` on the given thread.
+void biased_countable_release_on_thread(int32_t thread,
+                                        void (*release)(const void *),
+                                        const void *p);
+
+template <class T>
+class biased_countable_t {
+public:
+    biased_countable_t()
+        : owner_thread_(biased_countable_new_owner()),
+          biased_(0),
+          shared_(owner_thread_ == -1 ? 0 : BIAS) { }
+
+protected:
+    ~biased_countable_t() { }
+
+    counted_t<T> counted_from_this() {
+        rassert(counted_use_count(this) > 0);
+        return counted_t<T>(static_cast<T *>(this));
+    }
+
+    counted_t<const T> counted_from_this() const {
+        rassert(counted_use_count(this) > 0);
+        return counted_t<const T>(static_cast<const T *>(this));
+    }
+
+private:
+    friend void counted_add_ref<T>(const biased_countable_t<T> *p);
+    friend void counted_release<T>(const biased_countable_t<T> *p);
+    friend intptr_t counted_use_count<T>(const biased_countable_t<T> *p);
+
+    static const intptr_t BIAS = INTPTR_MAX / 2;
+
+    bool on_owner_thread() const {
+        int32_t owner = __atomic_load_n(&owner_thread_, __ATOMIC_RELAXED);
+        return owner != -1 && owner == biased_countable_current_thread();
+    }
+
+    // Called on the owner thread, or outside of the thread pool once it has shut
+    // down.
+    static void release_as_owner(const void *ptr) {
+        const biased_countable_t<T> *p = static_cast<const biased_countable_t<T> *>(ptr);
+        if (__atomic_load_n(&p->owner_thread_, __ATOMIC_RELAXED) == -1) {
+            p->release_shared();
+            return;
+        }
+        --p->biased_;
+        if (p->biased_ > 0) {
+            return;
+        }
+        if (p->biased_ == 0 && __atomic_load_n(&p->shared_, __ATOMIC_ACQUIRE) == BIAS) {
+            // No other thread holds a reference, so there's nothing to merge.
+            p->destroy();
+            return;
+        }
+        const intptr_t delta = p->biased_ - BIAS;
+        p->biased_ = 0;
+        __atomic_store_n(&p->owner_thread_, -1, __ATOMIC_RELAXED);
+        if (__atomic_add_fetch(&p->shared_, delta, __ATOMIC_ACQ_REL) == 0) {
+            p->destroy();
+        }
+    }
+
+    void release_shared() const {
+        intptr_t old = __atomic_load_n(&shared_, __ATOMIC_RELAXED);
+        for (;;) {
+            if (old == BIAS || old == BIAS + 1) {
+                int32_t owner = __atomic_load_n(&owner_thread_, __ATOMIC_ACQUIRE);
+                if (owner == -1) {
+                    // The owner is merging; wait for `shared_` to drop below `BIAS`.
+                    old = __atomic_load_n(&shared_, __ATOMIC_RELAXED);
+                    continue;
+                }
+                biased_countable_release_on_thread(owner, &release_as_owner, this);
+                return;
+            }
+            if (__atomic_compare_exchange_n(&shared_, &old, old - 1, true,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                rassert(old > 0);
+                if (old == 1) {
+                    destroy();
+                }
+                return;
+            }
+        }
+    }
+
+    void destroy() const {
+        delete static_cast<T *>(const_cast<biased_countable_t<T> *>(this));
+    }
+
+    mutable int32_t owner_thread_;
+    mutable intptr_t biased_;
+    mutable intptr_t shared_;
+    DISABLE_COPYING(biased_countable_t);
+};
+
+template <class T>
+inline void counted_add_ref(const biased_countable_t<T> *p) {
+    if (p->on_owner_thread()) {
+        ++p->biased_;
+    } else {
+        __atomic_add_fetch(&p->shared_, 1, __ATOMIC_RELAXED);
+    }
+}
+
+template <class T>
+inline void counted_release(const biased_countable_t<T> *p) {
+    if (p->on_owner_thread()) {
+        biased_countable_t<T>::release_as_owner(p);
+    } else {
+        p->release_shared();
+    }
+}
+
+template <class T>
+inline intptr_t counted_use_count(const biased_countable_t<T> *p) {
+    // Only exact on the owner thread, or once the counts have been merged.
+    intptr_t shared = __atomic_load_n(&p->shared_, __ATOMIC_ACQUIRE);
+    intptr_t res = shared >= biased_countable_t<T>::BIAS
+        ? static_cast<const volatile intptr_t&>(p->biased_) + shared
+            - biased_countable_t<T>::BIAS
+        : shared;
+    rassert(res > 0);
+    return res;
+}
+
+// Extends an arbitrary object with a biased_countable_t. Datums keep their arrays and
+// objects in these, and they are copied a lot, often on the thread that built them.
 template<class T>
 class countable_wrapper_t : public T,
-                            public slow_atomic_countable_t<countable_wrapper_t<T> > {
+                            public biased_countable_t<countable_wrapper_t<T> > {
 public:
     template <class... Args>
     explicit countable_wrapper_t(Args &&... args)
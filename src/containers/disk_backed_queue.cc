@@ -2,6 +2,7 @@
 #include "containers/disk_backed_queue.hpp"
 
 #include "arch/io/disk.hpp"
+#include "arch/runtime/coroutines.hpp"
 #include "buffer_cache/alt.hpp"
 #include "buffer_cache/blob.hpp"
 #include "buffer_cache/cache_balancer.hpp"
@@ -11,12 +12,21 @@
 
 #define DBQ_MAX_REF_SIZE 251
 
+// How many bytes of items are kept in memory at the end we pop from, and how many
+// are collected at the end we push onto before they are written to disk.
+#define DBQ_MEMORY_TAIL_SIZE (64 * KILOBYTE)
+#define DBQ_WRITE_BATCH_SIZE (64 * KILOBYTE)
+
 internal_disk_backed_queue_t::internal_disk_backed_queue_t(io_backender_t *io_backender,
                                                            const serializer_filepath_t &filename,
                                                            perfmon_collection_t *stats_parent)
     : perfmon_membership(stats_parent, &perfmon_collection,
                          filename.permanent_path().c_str()),
       queue_size(0),
+      memory_tail_bytes(0),
+      memory_head_bytes(0),
+      disk_size(0),
+      prefetching(false),
       head_block_id(NULL_BLOCK_ID),
       tail_block_id(NULL_BLOCK_ID),
       file_opener(new filepath_file_opener_t(filename, io_backender)) {
@@ -28,7 +38,8 @@ internal_disk_backed_queue_t::internal_disk_backed_queue_t(io_backender_t *io_ba
                                               &perfmon_collection));
 
     balancer.init(new dummy_cache_balancer_t(2 * MEGABYTE));
-    cache.init(new cache_t(serializer.get(), balancer.get(), &perfmon_collection));
+    cache.init(new cache_t(serializer.get(), balancer.get(), &perfmon_collection,
+                           memory_tag_t::disk_backed_queues));
     cache_conn.init(new cache_conn_t(cache.get()));
     // Emulate cache_t::create behavior by zeroing the block with id SUPERBLOCK_ID.
     txn_t txn(cache_conn.get(), write_durability_t::HARD,
@@ -44,6 +55,7 @@ internal_disk_backed_queue_t::~internal_disk_backed_queue_t() {
     /* First destroy the serializer, then remove the temporary file.
     This avoids issues with certain file systems (specifically VirtualBox
     shared folders), see https://github.com/rethinkdb/rethinkdb/issues/3791. */
+    drainer.drain();
     cache_conn.reset();
     cache.reset();
     balancer.reset();
@@ -52,29 +64,114 @@ internal_disk_backed_queue_t::~internal_disk_backed_queue_t() {
     file_opener->unlink_serializer_file();
 }
 
+static std::vector<char> serialize_item(const write_message_t &wm) {
+    vector_stream_t stream;
+    stream.reserve(wm.size());
+    int res = send_write_message(&stream, &wm);
+    guarantee(res == 0);
+    std::vector<char> item;
+    stream.swap(&item);
+    return item;
+}
+
 void internal_disk_backed_queue_t::push(const write_message_t &wm) {
     mutex_t::acq_t mutex_acq(&mutex);
+    push_item(serialize_item(wm));
+}
 
+void internal_disk_backed_queue_t::push(const scoped_array_t<write_message_t> &wms) {
+    mutex_t::acq_t mutex_acq(&mutex);
+    for (size_t i = 0; i < wms.size(); ++i) {
+        push_item(serialize_item(wms[i]));
+    }
+}
+
+void internal_disk_backed_queue_t::push_item(std::vector<char> &&item) {
+    ++queue_size;
+    if (disk_size == 0 && memory_head.empty()
+        && memory_tail_bytes < DBQ_MEMORY_TAIL_SIZE) {
+        memory_tail_bytes += item.size();
+        memory_tail.push_back(std::move(item));
+        return;
+    }
+    memory_head_bytes += item.size();
+    memory_head.push_back(std::move(item));
+    if (memory_head_bytes >= DBQ_WRITE_BATCH_SIZE) {
+        flush_memory_head();
+    }
+}
+
+void internal_disk_backed_queue_t::flush_memory_head() {
     // There's no need for hard durability with an unlinked dbq file.
     txn_t txn(cache_conn.get(), write_durability_t::SOFT,
               repli_timestamp_t::distant_past, 2);
-
-    push_single(&txn, wm);
+    for (const std::vector<char> &item : memory_head) {
+        push_single(&txn, item);
+    }
+    disk_size += memory_head.size();
+    memory_head.clear();
+    memory_head_bytes = 0;
 }
 
-void internal_disk_backed_queue_t::push(const scoped_array_t<write_message_t> &wms) {
-    mutex_t::acq_t mutex_acq(&mutex);
+void internal_disk_backed_queue_t::fill_memory_tail() {
+    if (disk_size == 0) {
+        while (!memory_head.empty() && memory_tail_bytes < DBQ_MEMORY_TAIL_SIZE) {
+            memory_head_bytes -= memory_head.front().size();
+            memory_tail_bytes += memory_head.front().size();
+            memory_tail.push_back(std::move(memory_head.front()));
+            memory_head.pop_front();
+        }
+        return;
+    }
 
-    // There's no need for hard durability with an unlinked dbq file.
+    // No need for hard durability with an unlinked dbq file.
     txn_t txn(cache_conn.get(), write_durability_t::SOFT,
               repli_timestamp_t::distant_past, 2);
+    while (disk_size > 0 && memory_tail_bytes < DBQ_MEMORY_TAIL_SIZE) {
+        std::vector<char> item;
+        pop_single(&txn, &item);
+        --disk_size;
+        memory_tail_bytes += item.size();
+        memory_tail.push_back(std::move(item));
+    }
+}
 
-    for (size_t i = 0; i < wms.size(); ++i) {
-        push_single(&txn, wms[i]);
+void internal_disk_backed_queue_t::maybe_start_prefetch() {
+    if (!prefetching && disk_size > 0
+        && memory_tail_bytes < DBQ_MEMORY_TAIL_SIZE / 2) {
+        prefetching = true;
+        auto_drainer_t::lock_t keepalive(&drainer);
+        coro_t::spawn_sometime(std::bind(&internal_disk_backed_queue_t::prefetch,
+                                         this, keepalive));
     }
 }
 
-void internal_disk_backed_queue_t::push_single(txn_t *txn, const write_message_t &wm) {
+void internal_disk_backed_queue_t::prefetch(auto_drainer_t::lock_t) {
+    mutex_t::acq_t mutex_acq(&mutex);
+    fill_memory_tail();
+    prefetching = false;
+}
+
+void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
+    guarantee(size() != 0);
+    mutex_t::acq_t mutex_acq(&mutex);
+
+    if (memory_tail.empty()) {
+        fill_memory_tail();
+    }
+    guarantee(!memory_tail.empty());
+    std::vector<char> item = std::move(memory_tail.front());
+    memory_tail.pop_front();
+    memory_tail_bytes -= item.size();
+    --queue_size;
+    maybe_start_prefetch();
+
+    const_buffer_group_t group;
+    group.add_buffer(item.size(), item.data());
+    viewer->view_buffer_group(&group);
+}
+
+void internal_disk_backed_queue_t::push_single(txn_t *txn, const std::vector<char> &item) {
     if (head_block_id == NULL_BLOCK_ID) {
         add_block_to_head(txn);
     }
@@ -89,7 +186,14 @@ void internal_disk_backed_queue_t::push_single(txn_t *txn, const write_message_t
 
     blob_t blob(cache->max_block_size(), buffer, DBQ_MAX_REF_SIZE);
 
-    write_onto_blob(buf_parent_t(_head.get()), &blob, wm);
+    {
+        buf_parent_t parent(_head.get());
+        blob.append_region(parent, item.size());
+        blob_acq_t acq;
+        buffer_group_t group;
+        blob.expose_all(parent, access_t::write, &group, &acq);
+        buffer_group_copy_data(&group, item.data(), item.size());
+    }
 
     if (static_cast<size_t>((head->data + head->data_size) - reinterpret_cast<char *>(head)) + blob.refsize(cache->max_block_size()) > cache->max_block_size().value()) {
         // The data won't fit in our current head block, so it's time to make a new one.
@@ -106,22 +210,13 @@ void internal_disk_backed_queue_t::push_single(txn_t *txn, const write_message_t
     memcpy(head->data + head->data_size, buffer,
            blob.refsize(cache->max_block_size()));
     head->data_size += blob.refsize(cache->max_block_size());
-
-    queue_size++;
 }
 
-void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
-    guarantee(size() != 0);
-    mutex_t::acq_t mutex_acq(&mutex);
-
+void internal_disk_backed_queue_t::pop_single(txn_t *txn, std::vector<char> *item_out) {
     char buffer[DBQ_MAX_REF_SIZE];
-    // No need for hard durability with an unlinked dbq file.
-    txn_t txn(cache_conn.get(), write_durability_t::SOFT,
-              repli_timestamp_t::distant_past, 2);
 
-    buf_lock_t _tail(buf_parent_t(&txn), tail_block_id, access_t::write);
+    buf_lock_t _tail(buf_parent_t(txn), tail_block_id, access_t::write);
 
-    /* Grab the data from the blob and delete it. */
     {
         buf_read_t read(&_tail);
         const queue_block_t *tail
@@ -134,9 +229,6 @@ void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
     }
 
     /* Grab the data from the blob and delete it. */
-
-    std::vector<char> data_vec;
-
     blob_t blob(cache->max_block_size(), buffer, DBQ_MAX_REF_SIZE);
     {
         blob_acq_t acq_group;
@@ -144,7 +236,13 @@ void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
         blob.expose_all(buf_parent_t(&_tail), access_t::read,
                         &blob_group, &acq_group);
 
-        viewer->view_buffer_group(const_view(&blob_group));
+        item_out->resize(blob_group.get_size());
+        size_t offset = 0;
+        for (size_t i = 0; i < blob_group.num_buffers(); ++i) {
+            buffer_group_t::buffer_t b = blob_group.get_buffer(i);
+            memcpy(item_out->data() + offset, b.data, b.size);
+            offset += b.size;
+        }
     }
 
     int32_t data_size;
@@ -160,13 +258,11 @@ void internal_disk_backed_queue_t::pop(buffer_group_viewer_t *viewer) {
 
     blob.clear(buf_parent_t(&_tail));
 
-    queue_size--;
-
     _tail.reset_buf_lock();
 
     /* If that was the last blob in this block move on to the next one. */
     if (live_data_offset == data_size) {
-        remove_block_from_tail(&txn);
+        remove_block_from_tail(txn);
     }
 }
 
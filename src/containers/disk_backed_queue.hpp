@@ -2,9 +2,11 @@
 #ifndef CONTAINERS_DISK_BACKED_QUEUE_HPP_
 #define CONTAINERS_DISK_BACKED_QUEUE_HPP_
 
+#include <deque>
 #include <string>
 #include <vector>
 
+#include "concurrency/auto_drainer.hpp"
 #include "concurrency/fifo_checker.hpp"
 #include "concurrency/mutex.hpp"
 #include "containers/buffer_group.hpp"
@@ -40,6 +42,13 @@ protected:
     DISABLE_COPYING(buffer_group_viewer_t);
 };
 
+/* `internal_disk_backed_queue_t` keeps the items at both ends of the queue in memory
+and only writes the ones in between to disk. While nothing is on disk, pushed items
+go into `memory_tail` until it holds `DBQ_MEMORY_TAIL_SIZE` bytes. After that they
+collect in `memory_head`, which is written to disk in a single transaction whenever it
+holds `DBQ_WRITE_BATCH_SIZE` bytes. Pops take items from `memory_tail`; when it runs
+low, a coroutine refills it from disk (or, once the disk is empty, from
+`memory_head`) in the background. */
 class internal_disk_backed_queue_t {
 public:
     internal_disk_backed_queue_t(io_backender_t *io_backender, const serializer_filepath_t& filename, perfmon_collection_t *stats_parent);
@@ -57,7 +66,17 @@ public:
 private:
     void add_block_to_head(txn_t *txn);
     void remove_block_from_tail(txn_t *txn);
-    void push_single(txn_t *txn, const write_message_t &value);
+
+    // These need `mutex` to be held.
+    void push_item(std::vector<char> &&item);
+    void flush_memory_head();
+    void fill_memory_tail();
+    void maybe_start_prefetch();
+
+    void prefetch(auto_drainer_t::lock_t keepalive);
+
+    void push_single(txn_t *txn, const std::vector<char> &item);
+    void pop_single(txn_t *txn, std::vector<char> *item_out);
 
     mutex_t mutex;
 
@@ -68,6 +87,18 @@ private:
 
     int64_t queue_size;
 
+    // The serialized items at the end we pop from, and at the end we push onto, that
+    // are not on disk. The queue is `memory_tail`, then the items on disk, then
+    // `memory_head`.
+    std::deque<std::vector<char> > memory_tail;
+    size_t memory_tail_bytes;
+    std::deque<std::vector<char> > memory_head;
+    size_t memory_head_bytes;
+
+    // The number of items on disk.
+    int64_t disk_size;
+    bool prefetching;
+
     // The end we push onto.
     block_id_t head_block_id;
     // The end we pop from.
@@ -79,6 +110,8 @@ private:
     scoped_ptr_t<cache_t> cache;
     scoped_ptr_t<cache_conn_t> cache_conn;
 
+    auto_drainer_t drainer;
+
     DISABLE_COPYING(internal_disk_backed_queue_t);
 };
 
@@ -0,0 +1,192 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_FLAT_INT_MAP_HPP_
+#define CONTAINERS_FLAT_INT_MAP_HPP_
+
+#include <stdint.h>
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "errors.hpp"
+
+/* `flat_int_map_t` is a hash map from integers to small values, which may be move-only
+ones such as `scoped_ptr_t`. It keeps
+all of its entries in one array and resolves collisions with linear probing, so
+unlike `std::map` and `std::unordered_map` it doesn't allocate on every insertion,
+and lookups touch only a cache line or two. Deletions shift the following entries
+back instead of leaving tombstones, so the table never degrades.
+
+Pointers to values are invalidated by any insertion or deletion. */
+template <class key_t, class value_t>
+class flat_int_map_t {
+public:
+    static_assert(std::is_integral<key_t>::value, "flat_int_map_t needs integer keys");
+
+    flat_int_map_t() : num_entries(0), mask(0) { }
+
+    size_t size() const { return num_entries; }
+    bool empty() const { return num_entries == 0; }
+
+    /* Returns a pointer to the value for `key`, or `NULL` if there is none. */
+    value_t *find(key_t key) {
+        if (num_entries == 0) {
+            return NULL;
+        }
+        for (size_t i = slot_for(key); ; i = (i + 1) & mask) {
+            entry_t *e = &entries[i];
+            if (!e->occupied) {
+                return NULL;
+            }
+            if (e->key == key) {
+                return &e->value;
+            }
+        }
+    }
+
+    const value_t *find(key_t key) const {
+        return const_cast<flat_int_map_t *>(this)->find(key);
+    }
+
+    /* Returns false, and doesn't change anything, if `key` is already present. */
+    bool insert(key_t key, value_t value) {
+        // Keep the load factor at or below one half, so that probe sequences stay
+        // short.
+        if (2 * (num_entries + 1) > entries.size()) {
+            grow();
+        }
+        for (size_t i = slot_for(key); ; i = (i + 1) & mask) {
+            entry_t *e = &entries[i];
+            if (!e->occupied) {
+                e->occupied = true;
+                e->key = key;
+                e->value = std::move(value);
+                ++num_entries;
+                return true;
+            }
+            if (e->key == key) {
+                return false;
+            }
+        }
+    }
+
+    /* Returns the number of entries erased, that is 0 or 1. */
+    size_t erase(key_t key) {
+        if (num_entries == 0) {
+            return 0;
+        }
+        size_t hole = slot_for(key);
+        while (true) {
+            if (!entries[hole].occupied) {
+                return 0;
+            }
+            if (entries[hole].key == key) {
+                break;
+            }
+            hole = (hole + 1) & mask;
+        }
+
+        /* Move back every following entry of the same cluster that would become
+        unreachable through the hole, i.e. whose home slot isn't cyclically in
+        `(hole, i]`. */
+        for (size_t i = (hole + 1) & mask; entries[i].occupied; i = (i + 1) & mask) {
+            const size_t home = slot_for(entries[i].key);
+            const bool reachable = hole <= i
+                ? (hole < home && home <= i)
+                : (hole < home || home <= i);
+            if (!reachable) {
+                entries[hole] = std::move(entries[i]);
+                hole = i;
+            }
+        }
+        entries[hole].occupied = false;
+        entries[hole].value = value_t();
+        --num_entries;
+        return 1;
+    }
+
+    /* Calls `cb(key, value)` for every entry, in no particular order. */
+    template <class callable_t>
+    void visit(const callable_t &cb) const {
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->occupied) {
+                cb(it->key, it->value);
+            }
+        }
+    }
+
+private:
+    struct entry_t {
+        entry_t() : occupied(false), key(0), value() { }
+        bool occupied;
+        key_t key;
+        value_t value;
+    };
+
+public:
+    /* Iterates over the entries in no particular order, yielding
+    `std::pair<key_t, const value_t &>`s. */
+    class const_iterator {
+    public:
+        std::pair<key_t, const value_t &> operator*() const {
+            return std::pair<key_t, const value_t &>(it_->key, it_->value);
+        }
+        const_iterator &operator++() {
+            ++it_;
+            skip_empty();
+            return *this;
+        }
+        bool operator==(const const_iterator &other) const { return it_ == other.it_; }
+        bool operator!=(const const_iterator &other) const { return it_ != other.it_; }
+
+    private:
+        friend class flat_int_map_t;
+        typedef typename std::vector<entry_t>::const_iterator inner_t;
+        const_iterator(inner_t it, inner_t end) : it_(it), end_(end) {
+            skip_empty();
+        }
+        void skip_empty() {
+            while (it_ != end_ && !it_->occupied) {
+                ++it_;
+            }
+        }
+        inner_t it_, end_;
+    };
+
+    const_iterator begin() const {
+        return const_iterator(entries.begin(), entries.end());
+    }
+    const_iterator end() const {
+        return const_iterator(entries.end(), entries.end());
+    }
+
+private:
+    size_t slot_for(key_t key) const {
+        // Fibonacci hashing. Keys such as sequential ids would otherwise all
+        // cluster in the same part of the table.
+        const uint64_t h = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(h >> 32) & mask;
+    }
+
+    void grow() {
+        std::vector<entry_t> old_entries;
+        old_entries.swap(entries);
+        entries.resize(old_entries.empty() ? 16 : 2 * old_entries.size());
+        mask = entries.size() - 1;
+        num_entries = 0;
+        for (auto it = old_entries.begin(); it != old_entries.end(); ++it) {
+            if (it->occupied) {
+                DEBUG_VAR bool inserted = insert(it->key, std::move(it->value));
+                rassert(inserted);
+            }
+        }
+    }
+
+    std::vector<entry_t> entries;
+    size_t num_entries;
+    size_t mask;
+
+    DISABLE_COPYING(flat_int_map_t);
+};
+
+#endif  // CONTAINERS_FLAT_INT_MAP_HPP_
@@ -81,6 +81,16 @@ public:
             return cache_list_.end();
         }
     }
+    // Returns whether there was an entry for `key`.
+    bool erase(const K &key) {
+        auto search = cache_map_.find(key);
+        if (search == cache_map_.end()) {
+            return false;
+        }
+        cache_list_.erase(search->second);
+        cache_map_.erase(search);
+        return true;
+    }
 private:
     V &insert(const K &key) {
         cache_list_.push_front(std::make_pair(key, V()));
@@ -93,7 +103,7 @@ private:
     }
     V &insert(K &&key) {
         cache_list_.push_front(std::make_pair(std::move(key), V()));
-        cache_map_[key] = cache_list_.begin();
+        cache_map_[cache_list_.begin()->first] = cache_list_.begin();
         if (cache_list_.size() > _max) {
             cache_map_.erase(cache_list_.back().first);
             cache_list_.pop_back();
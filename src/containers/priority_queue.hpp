@@ -54,6 +54,9 @@ public:
     void remove(entry_t *);
     T pop();
     void update(int);
+    /* Restores the heap order of every entry. Call this after a change that can
+    affect the relative order of all entries, rather than that of a single one. */
+    void rebuild();
 public:
     void validate();
 
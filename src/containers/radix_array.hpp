@@ -0,0 +1,155 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef CONTAINERS_RADIX_ARRAY_HPP_
+#define CONTAINERS_RADIX_ARRAY_HPP_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "errors.hpp"
+
+/* `radix_array_t` is an infinite array, like `two_level_array_t`, stored as a radix
+tree with three levels: a vector of inner nodes, each pointing to up to
+`2^INNER_BITS` leaves of `2^LEAF_BITS` values. Only the leaves (and inner nodes) that
+hold a value other than `value_t()` are allocated, and they're freed again once all
+of their values are reset to `value_t()`. The leaves are small (a few kilobytes) so
+that sparse keys, such as the block ids of a large store of which only some blocks
+are cached, don't keep large mostly-empty chunks around. A lookup is three dependent
+array accesses.
+
+It makes the same assumptions about `value_t` as `two_level_array_t`: `value_t()` has
+no side effects, and `operator==` tells `value_t()` apart from every other value. */
+template <class value_t, int LEAF_BITS = 9, int INNER_BITS = 9>
+class radix_array_t {
+public:
+    radix_array_t() { }
+
+    ~radix_array_t() {
+        for (inner_t *inner : inners) {
+            if (inner != NULL) {
+                for (size_t i = 0; i < INNER_SIZE; ++i) {
+                    delete inner->leaves[i];
+                }
+                delete inner;
+            }
+        }
+    }
+
+    value_t get(size_t key) const {
+        const size_t inner_index = key >> (LEAF_BITS + INNER_BITS);
+        if (inner_index >= inners.size() || inners[inner_index] == NULL) {
+            return value_t();
+        }
+        const leaf_t *leaf = inners[inner_index]->leaves[(key >> LEAF_BITS) & INNER_MASK];
+        if (leaf == NULL) {
+            return value_t();
+        }
+        return leaf->values[key & LEAF_MASK];
+    }
+
+    void set(size_t key, const value_t &value) {
+        const bool is_empty = (value == value_t());
+        const size_t inner_index = key >> (LEAF_BITS + INNER_BITS);
+        if (inner_index >= inners.size()) {
+            if (is_empty) {
+                return;
+            }
+            inners.resize(inner_index + 1, NULL);
+        }
+        inner_t *inner = inners[inner_index];
+        if (inner == NULL) {
+            if (is_empty) {
+                return;
+            }
+            inner = new inner_t;
+            inners[inner_index] = inner;
+        }
+        leaf_t **leaf_slot = &inner->leaves[(key >> LEAF_BITS) & INNER_MASK];
+        if (*leaf_slot == NULL) {
+            if (is_empty) {
+                return;
+            }
+            *leaf_slot = new leaf_t;
+            ++inner->count;
+        }
+
+        leaf_t *leaf = *leaf_slot;
+        value_t *slot = &leaf->values[key & LEAF_MASK];
+        if (!(*slot == value_t())) {
+            --leaf->count;
+        }
+        *slot = value;
+        if (!is_empty) {
+            ++leaf->count;
+        }
+
+        if (leaf->count == 0) {
+            delete leaf;
+            *leaf_slot = NULL;
+            --inner->count;
+            if (inner->count == 0) {
+                delete inner;
+                inners[inner_index] = NULL;
+                while (!inners.empty() && inners.back() == NULL) {
+                    inners.pop_back();
+                }
+            }
+        }
+    }
+
+    /* Sets `*key` to the smallest key at or after `*key` whose value isn't
+    `value_t()`, skipping unallocated ranges. Returns false if there is none. */
+    bool find_next(size_t *key) const {
+        size_t inner_index = *key >> (LEAF_BITS + INNER_BITS);
+        size_t leaf_index = (*key >> LEAF_BITS) & INNER_MASK;
+        size_t value_index = *key & LEAF_MASK;
+        for (; inner_index < inners.size(); ++inner_index, leaf_index = 0) {
+            const inner_t *inner = inners[inner_index];
+            if (inner == NULL) {
+                value_index = 0;
+                continue;
+            }
+            for (; leaf_index < INNER_SIZE; ++leaf_index, value_index = 0) {
+                const leaf_t *leaf = inner->leaves[leaf_index];
+                if (leaf == NULL) {
+                    continue;
+                }
+                for (; value_index < LEAF_SIZE; ++value_index) {
+                    if (!(leaf->values[value_index] == value_t())) {
+                        *key = (inner_index << (LEAF_BITS + INNER_BITS))
+                            | (leaf_index << LEAF_BITS)
+                            | value_index;
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+private:
+    static const size_t LEAF_SIZE = static_cast<size_t>(1) << LEAF_BITS;
+    static const size_t LEAF_MASK = LEAF_SIZE - 1;
+    static const size_t INNER_SIZE = static_cast<size_t>(1) << INNER_BITS;
+    static const size_t INNER_MASK = INNER_SIZE - 1;
+
+    struct leaf_t {
+        leaf_t() : count(0), values() { }
+        // The number of values that aren't `value_t()`.
+        size_t count;
+        value_t values[LEAF_SIZE];
+    };
+
+    struct inner_t {
+        inner_t() : count(0), leaves() { }
+        // The number of leaves that are allocated.
+        size_t count;
+        leaf_t *leaves[INNER_SIZE];
+    };
+
+    std::vector<inner_t *> inners;
+
+    DISABLE_COPYING(radix_array_t);
+};
+
+#endif  // CONTAINERS_RADIX_ARRAY_HPP_
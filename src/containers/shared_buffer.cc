@@ -3,6 +3,8 @@
 
 #include <stdlib.h>
 
+#include "arch/runtime/memory_tags.hpp"
+#include "arch/runtime/resource_usage.hpp"
 #include "utils.hpp"
 
 counted_t<shared_buf_t> shared_buf_t::create(size_t size) {
@@ -12,10 +14,20 @@ counted_t<shared_buf_t> shared_buf_t::create(size_t size) {
     shared_buf_t *result = static_cast<shared_buf_t *>(raw_result);
     result->refcount_ = 0;
     result->size_ = size;
+    // Shared buffers are only used for datums.
+    count_tagged_memory(memory_tag_t::datum_buffers, memory_size);
+    resource_usage_t *usage = current_resource_usage();
+    if (usage != NULL) {
+        usage->datum_bytes_allocated += memory_size;
+    }
     return counted_t<shared_buf_t>(result);
 }
 
 void shared_buf_t::operator delete(void *p) {
+    const size_t memory_size =
+        sizeof(shared_buf_t) + static_cast<shared_buf_t *>(p)->size_ - 1;
+    count_tagged_memory(memory_tag_t::datum_buffers,
+                        -static_cast<int64_t>(memory_size));
     ::free(p);
 }
 
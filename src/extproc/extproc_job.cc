@@ -5,7 +5,8 @@
 
 extproc_job_t::extproc_job_t(extproc_pool_t *_pool,
                              bool (*worker_fn) (read_stream_t *, write_stream_t *),
-                             signal_t *_user_interruptor) :
+                             signal_t *_user_interruptor,
+                             uint64_t affinity) :
     pool(_pool),
     user_error(false),
     user_interruptor(_user_interruptor),
@@ -15,22 +16,44 @@ extproc_job_t::extproc_job_t(extproc_pool_t *_pool,
         combined_interruptor.add(user_interruptor);
     }
 
-    worker_lock.create(pool->get_worker_semaphore(), &combined_interruptor);
+    {
+        extproc_pool_t::wait_sentry_t waiting(pool);
+        worker_lock.create(pool->get_worker_semaphore(), &combined_interruptor,
+                           pool->get_preferred_worker(affinity));
+    }
+    extproc_worker_t *worker = worker_lock.get()->get_value();
+    pool->set_preferred_worker(affinity, worker);
 
+    const bool was_alive = worker->is_process_alive();
     try {
-        worker_lock.get()->get_value()->acquired(&combined_interruptor);
-        extproc_pool_t::worker_acq_t worker_acq(pool);
-        worker_lock.get()->get_value()->run_job(worker_fn);
+        worker->acquired(&combined_interruptor);
     } catch (...) {
+        pool->on_worker_acquired(!was_alive && worker->is_process_alive());
         user_error = true;
-        worker_lock.get()->get_value()->released(user_error, user_interruptor);
+        release_worker();
+        throw;
+    }
+    pool->on_worker_acquired(!was_alive);
+
+    try {
+        worker->run_job(worker_fn);
+    } catch (...) {
+        user_error = true;
+        release_worker();
         throw;
     }
 }
 
 extproc_job_t::~extproc_job_t() {
     assert_thread();
-    worker_lock.get()->get_value()->released(user_error, user_interruptor);
+    release_worker();
+}
+
+void extproc_job_t::release_worker() {
+    extproc_worker_t *worker = worker_lock.get()->get_value();
+    const bool was_alive = worker->is_process_alive();
+    worker->released(user_error, user_interruptor);
+    pool->on_worker_released(was_alive && !worker->is_process_alive());
 }
 
 // All data written and read by the user must be accounted for, or things will break
@@ -27,9 +27,11 @@ private:
 
 class extproc_job_t : public home_thread_mixin_t {
 public:
+    // See `extproc_pool_t::get_preferred_worker` for `affinity` (0 means none).
     extproc_job_t(extproc_pool_t *_pool,
                   bool (*worker_fn) (read_stream_t *, write_stream_t *),
-                  signal_t *_user_interruptor);
+                  signal_t *_user_interruptor,
+                  uint64_t affinity = 0);
     ~extproc_job_t();
 
     // All data written and read by the user must be accounted for, or the worker will
@@ -43,6 +45,8 @@ public:
     void worker_error();
 
 private:
+    void release_worker();
+
     extproc_pool_t *pool;
     bool user_error;
     signal_t *user_interruptor;
@@ -1,16 +1,29 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
-#include "containers/object_buffer.hpp"
 #include "extproc/extproc_pool.hpp"
+
+#include <algorithm>
+
+#include "containers/object_buffer.hpp"
 #include "extproc/extproc_spawner.hpp"
 
-extproc_pool_t::extproc_pool_t(size_t worker_count) :
+extproc_pool_t::extproc_pool_t(size_t max_workers,
+                               size_t min_workers,
+                               perfmon_collection_t *_stats) :
     ct_interruptors(&interruptor),
     worker_cnt(0),
     prev_worker_cnt(0),
+    live_worker_cnt(0),
+    min_worker_cnt(std::min(min_workers, max_workers)),
+    stats(_stats),
     dealloc_timer(DEALLOC_TIMER_FREQ_MS, this),
-    worker_semaphore(worker_count,
+    worker_semaphore(max_workers,
                      extproc_spawner_t::get_instance()),
-    dealloc_pool(1, &pool_queue, this) { }
+    preferred_workers(AFFINITY_SLOTS),
+    dealloc_pool(1, &pool_queue, this) {
+    for (size_t i = 0; i < preferred_workers.size(); ++i) {
+        preferred_workers[i] = NULL;
+    }
+}
 
 extproc_pool_t::~extproc_pool_t() {
     // Can only be destructed on the same thread we were created on
@@ -24,6 +37,22 @@ cross_thread_semaphore_t<extproc_worker_t> *extproc_pool_t::get_worker_semaphore
     return &worker_semaphore;
 }
 
+extproc_worker_t *extproc_pool_t::get_preferred_worker(uint64_t affinity) {
+    if (affinity == NO_AFFINITY) {
+        return NULL;
+    }
+    spinlock_acq_t acq(&affinity_lock);
+    return preferred_workers[affinity % preferred_workers.size()];
+}
+
+void extproc_pool_t::set_preferred_worker(uint64_t affinity, extproc_worker_t *worker) {
+    if (affinity == NO_AFFINITY) {
+        return;
+    }
+    spinlock_acq_t acq(&affinity_lock);
+    preferred_workers[affinity % preferred_workers.size()] = worker;
+}
+
 signal_t *extproc_pool_t::get_shutdown_signal() {
     return ct_interruptors.get();
 }
@@ -39,23 +68,63 @@ void extproc_pool_t::coro_pool_callback(extproc_pool_dummy_value_t,
     prev_worker_cnt = cur_worker_cnt;
 
     for (int i = 0; i < dealloc_cnt; ++i) {
+        if (live_worker_cnt <= min_worker_cnt) {
+            break;
+        }
+
         object_buffer_t<cross_thread_semaphore_t<extproc_worker_t>::lock_t> worker_lock;
         worker_lock.create(get_worker_semaphore(), get_shutdown_signal());
 
         if (worker_lock.get()->get_value()->is_process_alive()) {
             worker_lock.get()->get_value()->kill_process();
+            __sync_sub_and_fetch(&live_worker_cnt, 1);
+            --stats.workers_alive;
         }
     }
 }
 
-void extproc_pool_t::on_worker_acquired()
+extproc_pool_t::wait_sentry_t::wait_sentry_t(extproc_pool_t *_pool) : pool(_pool) {
+    ++pool->stats.jobs_waiting;
+    pool->stats.wait_duration.begin(&start_time);
+}
+
+extproc_pool_t::wait_sentry_t::~wait_sentry_t() {
+    pool->stats.wait_duration.end(&start_time);
+    --pool->stats.jobs_waiting;
+}
+
+void extproc_pool_t::on_worker_acquired(bool process_started)
 {
     __sync_add_and_fetch(&worker_cnt, 1);
+    ++stats.workers_busy;
+    if (process_started) {
+        __sync_add_and_fetch(&live_worker_cnt, 1);
+        ++stats.workers_alive;
+        ++stats.processes_started;
+    }
 }
 
-void extproc_pool_t::on_worker_released()
+void extproc_pool_t::on_worker_released(bool process_killed)
 {
     __sync_sub_and_fetch(&worker_cnt, 1);
+    --stats.workers_busy;
+    if (process_killed) {
+        __sync_sub_and_fetch(&live_worker_cnt, 1);
+        --stats.workers_alive;
+    }
+}
+
+extproc_pool_t::stats_t::stats_t(perfmon_collection_t *parent) :
+    wait_duration(secs_to_ticks(1), true),
+    multi_membership(&collection,
+                     &jobs_waiting, "jobs_waiting",
+                     &workers_busy, "workers_busy",
+                     &workers_alive, "workers_alive",
+                     &processes_started, "processes_started",
+                     &wait_duration, "wait") {
+    if (parent != NULL) {
+        membership.init(new perfmon_membership_t(parent, &collection, "extproc"));
+    }
 }
 
 extproc_pool_t::ct_interruptors_t::ct_interruptors_t(signal_t *shutdown_signal) :
@@ -69,3 +138,22 @@ extproc_pool_t::ct_interruptors_t::ct_interruptors_t(signal_t *shutdown_signal)
 signal_t *extproc_pool_t::ct_interruptors_t::get() {
     return ct_signals[get_thread_id().threadnum].get();
 }
+
+static size_t extproc_min_workers = 0;
+static size_t extproc_max_workers = 0;
+
+void set_extproc_worker_limits(size_t min_workers, size_t max_workers) {
+    guarantee(min_workers <= max_workers);
+    extproc_min_workers = min_workers;
+    extproc_max_workers = max_workers;
+}
+
+size_t get_extproc_min_workers() {
+    return extproc_min_workers;
+}
+
+size_t get_extproc_max_workers() {
+    return extproc_max_workers != 0
+        ? extproc_max_workers
+        : static_cast<size_t>(get_num_threads());
+}
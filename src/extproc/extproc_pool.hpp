@@ -2,6 +2,7 @@
 #ifndef EXTPROC_EXTPROC_POOL_HPP_
 #define EXTPROC_EXTPROC_POOL_HPP_
 
+#include "arch/spinlock.hpp"
 #include "arch/timing.hpp"
 #include "utils.hpp"
 #include "containers/scoped.hpp"
@@ -11,16 +12,22 @@
 #include "concurrency/cross_thread_semaphore.hpp"
 #include "concurrency/queue/single_value_producer.hpp"
 #include "extproc/extproc_worker.hpp"
+#include "perfmon/perfmon.hpp"
 
 class extproc_pool_dummy_value_t { };
 
 // Extproc pool is used to acquire and release workers from any thread,
-//  must be created from within the thread pool
+//  must be created from within the thread pool.  There are `max_workers` workers,
+//  whose processes are only started when a job needs them, and are killed again
+//  when demand goes down -- but never below `min_workers` live processes.  If
+//  `stats` is given, the pool's queue and worker counts show up in it.
 class extproc_pool_t : public home_thread_mixin_t,
                        public coro_pool_callback_t<extproc_pool_dummy_value_t>,
                        public repeating_timer_callback_t {
 public:
-    explicit extproc_pool_t(size_t worker_count);
+    explicit extproc_pool_t(size_t max_workers,
+                            size_t min_workers = 0,
+                            perfmon_collection_t *stats = NULL);
     ~extproc_pool_t();
 
     // Get the signal for the current thread that will indicate when this object is being
@@ -30,19 +37,30 @@ public:
     // Get the semaphore of workers to obtain a lock (may be done from any thread)
     cross_thread_semaphore_t<extproc_worker_t> *get_worker_semaphore();
 
-    class worker_acq_t {
+    // Jobs may give an affinity key (for instance a hash of the JavaScript they are
+    //  going to run), so that they get the worker that last ran a job with the same
+    //  key if it's free, since it may still have state cached from that job.
+    static const uint64_t NO_AFFINITY = 0;
+    extproc_worker_t *get_preferred_worker(uint64_t affinity);
+    void set_preferred_worker(uint64_t affinity, extproc_worker_t *worker);
+
+    // Put on the stack by a job while it waits for a worker.
+    class wait_sentry_t {
     public:
-        explicit worker_acq_t(extproc_pool_t *_pool) : pool(_pool) {
-            pool->on_worker_acquired();
-        }
-        ~worker_acq_t() {
-            pool->on_worker_released();
-        }
+        explicit wait_sentry_t(extproc_pool_t *_pool);
+        ~wait_sentry_t();
     private:
         extproc_pool_t *pool;
-        DISABLE_COPYING(worker_acq_t);
+        ticks_t start_time;
+        DISABLE_COPYING(wait_sentry_t);
     };
 
+    // Called by jobs once they have a worker, and when they let go of it.
+    //  `process_started` and `process_killed` say whether the worker's process was
+    //  started by acquiring it, or killed by releasing it.
+    void on_worker_acquired(bool process_started);
+    void on_worker_released(bool process_killed);
+
 private:
     // The interruptor to be pulsed when shutting down
     cond_t interruptor;
@@ -60,9 +78,23 @@ private:
     // Worker counters for the deallocation window.
     int worker_cnt, prev_worker_cnt;
 
-    // Acquire / Release worker notifications.
-    void on_worker_acquired();
-    void on_worker_released();
+    // How many workers have a running process, and how few we are willing to go down
+    //  to when killing idle ones.
+    int live_worker_cnt;
+    const int min_worker_cnt;
+
+    struct stats_t {
+        explicit stats_t(perfmon_collection_t *parent);
+
+        perfmon_collection_t collection;
+        scoped_ptr_t<perfmon_membership_t> membership;
+        perfmon_counter_t jobs_waiting;
+        perfmon_counter_t workers_busy;
+        perfmon_counter_t workers_alive;
+        perfmon_counter_t processes_started;
+        perfmon_duration_sampler_t wait_duration;
+        perfmon_multi_membership_t multi_membership;
+    } stats;
 
     // Timer to trigger worker deallocation.
     repeating_timer_t dealloc_timer;
@@ -79,10 +111,23 @@ private:
     // Cross-threaded semaphore allowing workers to be acquired from any thread
     cross_thread_semaphore_t<extproc_worker_t> worker_semaphore;
 
+    // The worker that last ran a job for each affinity key, hashed into a fixed
+    //  number of slots.  Collisions just mean a job doesn't get its preference.
+    static const size_t AFFINITY_SLOTS = 256;
+    spinlock_t affinity_lock;
+    scoped_array_t<extproc_worker_t *> preferred_workers;
+
     // Coroutine pool to make sure there is only one worker deallocation happening at a time
     // The single_value_producer_t makes sure we never build up a backlog.
     single_value_producer_t<extproc_pool_dummy_value_t> pool_queue;
     coro_pool_t<extproc_pool_dummy_value_t> dealloc_pool;
 };
 
+// Sets the worker counts the server's extproc pool is created with.  By default there
+//  are as many workers as threads, and idle ones may all be killed.  Must be called
+//  before the thread pool starts, if at all.
+void set_extproc_worker_limits(size_t min_workers, size_t max_workers);
+size_t get_extproc_min_workers();
+size_t get_extproc_max_workers();
+
 #endif /* EXTPROC_EXTPROC_POOL_HPP_ */
@@ -49,24 +49,40 @@ public:
     const std::string error_string;
 };
 
-class scoped_curl_handle_t {
+// Each worker process performs all its requests with the same curl handle, so that
+// libcurl can reuse the connections (as well as DNS lookups and TLS sessions) it has
+// kept alive from earlier requests to the same host -- also from earlier queries,
+// since the worker process outlives them.  Getting the handle puts its options back
+// to their defaults, and throws away the cookies of earlier requests, which
+// `curl_easy_reset` would keep.
+class worker_curl_handle_t {
 public:
-    scoped_curl_handle_t() :
-        curl_handle(curl_easy_init()) {
-    }
-
-    ~scoped_curl_handle_t() {
-        curl_easy_cleanup(curl_handle);
+    worker_curl_handle_t() :
+        curl_handle(acquire()) {
     }
 
+    // NULL if the handle couldn't be created.
     CURL *get() {
         return curl_handle;
     }
 
 private:
+    static CURL *acquire();
+
     CURL *curl_handle;
 };
 
+CURL *worker_curl_handle_t::acquire() {
+    static CURL *handle = NULL;
+    if (handle == NULL) {
+        handle = curl_easy_init();
+    } else {
+        curl_easy_reset(handle);
+        curl_easy_setopt(handle, CURLOPT_COOKIELIST, "ALL");
+    }
+    return handle;
+}
+
 // Used for adding headers, which cannot be freed until after the request is done
 class scoped_curl_slist_t {
 public:
@@ -523,6 +539,11 @@ void set_default_opts(CURL *curl_handle,
 
     exc_setopt(curl_handle, CURLOPT_NOSIGNAL, 1, "NOSIGNAL");
 
+    // Keep connections to a few more hosts alive than the default of 5, for queries
+    //  that talk to several services
+    exc_setopt(curl_handle, CURLOPT_MAXCONNECTS, 16L, "MAXCONNECTS");
+    exc_setopt(curl_handle, CURLOPT_TCP_KEEPALIVE, 1L, "TCP KEEPALIVE");
+
     // Enable cookies - needed for multiple requests like redirects or digest auth
     exc_setopt(curl_handle, CURLOPT_COOKIEFILE, "", "COOKIEFILE");
 
@@ -534,7 +555,7 @@ void set_default_opts(CURL *curl_handle,
 
 // TODO: implement streaming API support
 void perform_http(http_opts_t *opts, http_result_t *res_out) {
-    scoped_curl_handle_t curl_handle;
+    worker_curl_handle_t curl_handle;
     curl_data_t curl_data;
 
     if (curl_handle.get() == NULL) {
@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <libplatform/libplatform.h>
 #include <limits>
+#include <unordered_map>
 
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/stl_types.hpp"
@@ -32,12 +33,42 @@ ql::datum_t js_to_datum(const v8::Handle<v8::Value> &value,
 v8::Handle<v8::Value> js_from_datum(const ql::datum_t &datum,
                                     std::string *err_out);
 
+// Compiled scripts by source.  The worker process outlives the jobs (and so the
+// queries) it runs, so keeping these around means a function that every query uses
+// only gets compiled once per worker.  Scripts are compiled unbound, and each eval
+// binds them to its own fresh context, so queries still don't share any JS state.
+class js_script_cache_t {
+public:
+    js_script_cache_t() : use_counter(0) { }
+    ~js_script_cache_t();
+
+    // Must be called within a `HandleScope`.  Returns an empty handle if `source`
+    // doesn't compile, in which case the error is left for the caller's `TryCatch`.
+    v8::Local<v8::UnboundScript> get(const std::string &source);
+
+private:
+    static const size_t MAX_SIZE = 100;
+
+    void trim();
+
+    struct entry_t {
+        boost::shared_ptr<v8::Persistent<v8::UnboundScript> > script;
+        uint64_t last_used;
+    };
+
+    std::unordered_map<std::string, entry_t> scripts;
+    uint64_t use_counter;
+
+    DISABLE_COPYING(js_script_cache_t);
+};
+
 // Each worker process should have a single instance of this class before using the v8 API
 class js_instance_t {
 public:
     static void run_other_tasks();
     static void maybe_initialize_v8();
     static v8::Isolate *isolate();
+    static js_script_cache_t *script_cache();
 
 private:
     js_instance_t();
@@ -48,6 +79,8 @@ private:
     v8::Isolate *isolate_;
 
     scoped_ptr_t<v8::Platform> platform;
+
+    scoped_ptr_t<js_script_cache_t> script_cache_;
 };
 
 js_instance_t *js_instance_t::instance = NULL;
@@ -59,9 +92,11 @@ js_instance_t::js_instance_t() {
     v8::V8::Initialize();
     isolate_ = v8::Isolate::New();
     isolate_->Enter();
+    script_cache_.init(new js_script_cache_t());
 }
 
 js_instance_t::~js_instance_t() {
+    script_cache_.reset();
     isolate_->Exit();
     isolate_->Dispose();
     v8::V8::Dispose();
@@ -76,6 +111,62 @@ v8::Isolate *js_instance_t::isolate() {
     return instance->isolate_;
 }
 
+js_script_cache_t *js_instance_t::script_cache() {
+    return instance->script_cache_.get();
+}
+
+js_script_cache_t::~js_script_cache_t() {
+    for (auto it = scripts.begin(); it != scripts.end(); ++it) {
+        it->second.script->Reset();
+    }
+}
+
+v8::Local<v8::UnboundScript> js_script_cache_t::get(const std::string &source) {
+    v8::Isolate *isolate = js_instance_t::isolate();
+    ++use_counter;
+
+    auto it = scripts.find(source);
+    if (it != scripts.end()) {
+        it->second.last_used = use_counter;
+        return v8::Local<v8::UnboundScript>::New(isolate, *it->second.script);
+    }
+
+    // TODO: use an "external resource" to avoid copy?
+    v8::Handle<v8::String> src = v8::String::NewFromUtf8(isolate,
+                                                         source.data(),
+                                                         v8::String::NewStringType::kNormalString,
+                                                         source.size());
+    v8::ScriptCompiler::Source script_source(src);
+    v8::Local<v8::UnboundScript> script
+        = v8::ScriptCompiler::CompileUnbound(isolate, &script_source);
+    if (script.IsEmpty()) {
+        return script;
+    }
+
+    trim();
+    entry_t entry;
+    entry.script.reset(new v8::Persistent<v8::UnboundScript>());
+    entry.script->Reset(isolate, script);
+    entry.last_used = use_counter;
+    scripts.insert(std::make_pair(source, entry));
+    return script;
+}
+
+void js_script_cache_t::trim() {
+    if (scripts.size() < MAX_SIZE) {
+        return;
+    }
+
+    auto oldest = scripts.begin();
+    for (auto it = ++scripts.begin(); it != scripts.end(); ++it) {
+        if (it->second.last_used < oldest->second.last_used) {
+            oldest = it;
+        }
+    }
+    oldest->second.script->Reset();
+    scripts.erase(oldest);
+}
+
 void js_instance_t::maybe_initialize_v8() {
     if (instance == NULL) {
         instance = new js_instance_t;
@@ -91,10 +182,16 @@ public:
     js_result_t eval(const std::string &source, const ql::configured_limits_t &limits);
     js_result_t call(js_id_t id, const std::vector<ql::datum_t> &args,
                      const ql::configured_limits_t &limits);
+    std::vector<js_result_t> call_batch(
+        js_id_t id, const std::vector<std::vector<ql::datum_t> > &args_list,
+        const ql::configured_limits_t &limits);
     void release(js_id_t id);
     void run_other_tasks(uint64_t task_counter);
 
 private:
+    js_result_t call_in_context(v8::Handle<v8::Function> fn,
+                                const std::vector<ql::datum_t> &args,
+                                const ql::configured_limits_t &limits);
     js_id_t remember_value(const v8::Handle<v8::Value> &value);
     const boost::shared_ptr<v8::Persistent<v8::Value> > find_value(js_id_t id);
 
@@ -118,14 +215,15 @@ public:
 enum js_task_t {
     TASK_EVAL,
     TASK_CALL,
+    TASK_CALL_BATCH,
     TASK_RELEASE,
     TASK_EXIT
 };
 
 // The job_t runs in the context of the main rethinkdb process
 js_job_t::js_job_t(extproc_pool_t *pool, signal_t *interruptor,
-                   const ql::configured_limits_t &_limits) :
-    extproc_job(pool, &worker_fn, interruptor), limits(_limits) { }
+                   const ql::configured_limits_t &_limits, uint64_t affinity) :
+    extproc_job(pool, &worker_fn, interruptor, affinity), limits(_limits) { }
 
 js_result_t js_job_t::eval(const std::string &source) {
     js_task_t task = js_task_t::TASK_EVAL;
@@ -176,6 +274,32 @@ js_result_t js_job_t::call(js_id_t id, const std::vector<ql::datum_t> &args) {
     return result;
 }
 
+std::vector<js_result_t> js_job_t::call_batch(
+        js_id_t id, const std::vector<std::vector<ql::datum_t> > &args_list) {
+    js_task_t task = js_task_t::TASK_CALL_BATCH;
+    write_message_t wm;
+    wm.append(&task, sizeof(task));
+    serialize<cluster_version_t::LATEST_OVERALL>(&wm, id);
+    serialize<cluster_version_t::LATEST_OVERALL>(&wm, args_list);
+    serialize<cluster_version_t::LATEST_OVERALL>(&wm, limits);
+    {
+        int res = send_write_message(extproc_job.write_stream(), &wm);
+        if (res != 0) {
+            throw extproc_worker_exc_t("failed to send data to the worker");
+        }
+    }
+
+    std::vector<js_result_t> results;
+    archive_result_t res
+        = deserialize<cluster_version_t::LATEST_OVERALL>(extproc_job.read_stream(),
+                                                         &results);
+    if (bad(res) || results.size() != args_list.size()) {
+        throw extproc_worker_exc_t(strprintf("failed to deserialize call results from "
+                                             "worker (%s)", archive_result_as_str(res)));
+    }
+    return results;
+}
+
 void js_job_t::release(js_id_t id) {
     js_task_t task = js_task_t::TASK_RELEASE;
     write_message_t wm;
@@ -308,6 +432,39 @@ bool run_call(read_stream_t *stream_in,
     return send_js_result(stream_out, js_result);
 }
 
+bool run_call_batch(read_stream_t *stream_in,
+                    write_stream_t *stream_out,
+                    js_env_t *js_env,
+                    uint64_t task_counter) {
+    js_id_t id;
+    std::vector<std::vector<ql::datum_t> > args_list;
+    ql::configured_limits_t limits;
+    {
+        archive_result_t res
+            = deserialize<cluster_version_t::LATEST_OVERALL>(stream_in, &id);
+        if (bad(res)) { return false; }
+        res = deserialize<cluster_version_t::LATEST_OVERALL>(stream_in, &args_list);
+        if (bad(res)) { return false; }
+        res = deserialize<cluster_version_t::LATEST_OVERALL>(stream_in, &limits);
+        if (bad(res)) { return false; }
+    }
+
+    std::vector<js_result_t> js_results;
+    try {
+        js_results = js_env->call_batch(id, args_list, limits);
+    } catch (const std::exception &e) {
+        js_results.assign(args_list.size(), js_result_t(std::string(e.what())));
+    } catch (...) {
+        js_results.assign(args_list.size(),
+                          js_result_t(std::string("encountered an unknown exception")));
+    }
+
+    js_env->run_other_tasks(task_counter);
+    write_message_t wm;
+    serialize<cluster_version_t::LATEST_OVERALL>(&wm, js_results);
+    return send_write_message(stream_out, &wm) == 0;
+}
+
 bool run_release(read_stream_t *stream_in,
                  write_stream_t *stream_out,
                  js_env_t *js_env,
@@ -352,6 +509,11 @@ bool js_job_t::worker_fn(read_stream_t *stream_in, write_stream_t *stream_out) {
                 return false;
             }
             break;
+        case TASK_CALL_BATCH:
+            if (!run_call_batch(stream_in, stream_out, &js_env, task_counter)) {
+                return false;
+            }
+            break;
         case TASK_RELEASE:
             if (!run_release(stream_in, stream_out, &js_env, task_counter)) {
                 return false;
@@ -396,25 +558,19 @@ js_result_t js_env_t::eval(const std::string &source,
 
     v8::HandleScope handle_scope(isolate);
 
-    // TODO: use an "external resource" to avoid copy?
-    v8::Handle<v8::String> src = v8::String::NewFromUtf8(isolate,
-                                                         source.data(),
-                                                         v8::String::NewStringType::kNormalString,
-                                                         source.size());
-
     // This constructor registers itself with v8 so that any errors generated
     // within v8 will be available within this object.
     v8::TryCatch try_catch;
 
     // Firstly, compilation may fail (because of say a syntax error)
-    v8::Handle<v8::Script> script = v8::Script::Compile(src);
+    v8::Handle<v8::UnboundScript> script = js_instance_t::script_cache()->get(source);
     if (script.IsEmpty()) {
         // Get the error out of the TryCatch object
         append_caught_error(err_out, try_catch);
     } else {
         // Secondly, evaluation may fail because of an exception generated
         // by the code
-        v8::Handle<v8::Value> result_val = script->Run();
+        v8::Handle<v8::Value> result_val = script->BindToCurrentContext()->Run();
         if (result_val.IsEmpty()) {
             // Get the error from the TryCatch object
             append_caught_error(err_out, try_catch);
@@ -493,8 +649,6 @@ js_result_t js_env_t::call(js_id_t id,
                            const std::vector<ql::datum_t> &args,
                            const ql::configured_limits_t &limits) {
     js_context_t clean_context;
-    js_result_t result("");
-    std::string *err_out = boost::get<std::string>(&result);
 
     const boost::shared_ptr<v8::Persistent<v8::Value> > found_value = find_value(id);
     guarantee(!found_value->IsEmpty());
@@ -506,6 +660,43 @@ js_result_t js_env_t::call(js_id_t id,
     // Construct local handle from persistent handle
     v8::Local<v8::Value> local_handle = v8::Local<v8::Value>::New(isolate, *found_value);
     v8::Local<v8::Function> fn = v8::Local<v8::Function>::Cast(local_handle);
+    return call_in_context(fn, args, limits);
+}
+
+std::vector<js_result_t> js_env_t::call_batch(
+        js_id_t id,
+        const std::vector<std::vector<ql::datum_t> > &args_list,
+        const ql::configured_limits_t &limits) {
+    // We enter the context once for the whole batch.  (The function runs in the
+    // context it was created in anyway.)
+    js_context_t clean_context;
+
+    const boost::shared_ptr<v8::Persistent<v8::Value> > found_value = find_value(id);
+    guarantee(!found_value->IsEmpty());
+
+    v8::Isolate *isolate = js_instance_t::isolate();
+
+    v8::HandleScope handle_scope(isolate);
+
+    v8::Local<v8::Value> local_handle = v8::Local<v8::Value>::New(isolate, *found_value);
+    v8::Local<v8::Function> fn = v8::Local<v8::Function>::Cast(local_handle);
+
+    std::vector<js_result_t> results;
+    results.reserve(args_list.size());
+    for (const auto &args : args_list) {
+        // So that the handles each call creates get freed as we go.
+        v8::HandleScope call_scope(isolate);
+        results.push_back(call_in_context(fn, args, limits));
+    }
+    return results;
+}
+
+js_result_t js_env_t::call_in_context(v8::Handle<v8::Function> fn,
+                                      const std::vector<ql::datum_t> &args,
+                                      const ql::configured_limits_t &limits) {
+    js_result_t result("");
+    std::string *err_out = boost::get<std::string>(&result);
+
     v8::Handle<v8::Value> value = run_js_func(fn, args, err_out);
 
     if (!value.IsEmpty()) {
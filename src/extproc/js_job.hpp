@@ -20,10 +20,13 @@
 class js_job_t {
 public:
     js_job_t(extproc_pool_t *pool, signal_t *interruptor,
-             const ql::configured_limits_t &limits);
+             const ql::configured_limits_t &limits, uint64_t affinity);
 
     js_result_t eval(const std::string &source);
     js_result_t call(js_id_t id, const std::vector<ql::datum_t> &args);
+    // Calls the function once per element of `args_list`, in one round trip.
+    std::vector<js_result_t> call_batch(
+        js_id_t id, const std::vector<std::vector<ql::datum_t> > &args_list);
     void release(js_id_t id);
     void exit();
 
@@ -3,6 +3,9 @@
 
 #include <inttypes.h>   // For PRIu64
 
+#include <algorithm>
+#include <functional>
+#include <limits>
 #include <map>
 
 #include "extproc/js_job.hpp"
@@ -47,13 +50,13 @@ private:
 class js_runner_t::job_data_t {
 public:
     job_data_t(extproc_pool_t *pool, signal_t *interruptor,
-               const ql::configured_limits_t &limits) :
+               const ql::configured_limits_t &limits, uint64_t affinity) :
         combined_interruptor(interruptor, js_timeout.get_signal()),
-        js_job(pool, &combined_interruptor, limits) { }
+        js_job(pool, &combined_interruptor, limits, affinity) { }
 
-    explicit job_data_t(extproc_pool_t *pool,
-                        const ql::configured_limits_t &limits) :
-        js_job(pool, js_timeout.get_signal(), limits) { }
+    job_data_t(extproc_pool_t *pool,
+               const ql::configured_limits_t &limits, uint64_t affinity) :
+        js_job(pool, js_timeout.get_signal(), limits, affinity) { }
 
     struct func_info_t {
         explicit func_info_t(js_id_t _id) :
@@ -101,12 +104,18 @@ bool js_runner_t::connected() const {
 
 // Starts the javascript function in the worker process
 void js_runner_t::begin(extproc_pool_t *pool, signal_t *interruptor,
-                        const ql::configured_limits_t &limits) {
+                        const ql::configured_limits_t &limits,
+                        const std::string &first_source) {
     assert_thread();
+    // Worker processes keep compiled scripts around between jobs, so we'd like
+    //  the worker that last ran this source.
+    uint64_t affinity = first_source.empty()
+        ? extproc_pool_t::NO_AFFINITY
+        : std::hash<std::string>()(first_source);
     if (interruptor == NULL) {
-        job_data.init(new job_data_t(pool, limits));
+        job_data.init(new job_data_t(pool, limits, affinity));
     } else {
-        job_data.init(new job_data_t(pool, interruptor, limits));
+        job_data.init(new job_data_t(pool, interruptor, limits, affinity));
     }
 }
 
@@ -219,6 +228,77 @@ js_result_t js_runner_t::call(const std::string &source,
     return result;
 }
 
+std::vector<js_result_t> js_runner_t::call_batch(
+        const std::string &source,
+        const std::vector<std::vector<ql::datum_t> > &args_list,
+        const req_config_t &config) {
+    assert_thread();
+    guarantee(job_data.has());
+
+    // This will retrieve the function from the cache if it's there, or re-eval it
+    js_result_t fn_result = eval(source, config);
+    js_id_t *fn_id = boost::get<js_id_t>(&fn_result);
+    guarantee(fn_id != NULL);
+
+    const uint64_t batch_timeout_ms
+        = config.timeout_ms > std::numeric_limits<uint64_t>::max() / std::max<size_t>(args_list.size(), 1)
+        ? std::numeric_limits<uint64_t>::max()
+        : config.timeout_ms * std::max<size_t>(args_list.size(), 1);
+
+    object_buffer_t<js_timeout_t::sentry_t> sentry;
+    sentry.create(&job_data->js_timeout, batch_timeout_ms);
+
+    std::vector<js_result_t> results;
+    bool is_timeout = false;
+    try {
+        try {
+            results = job_data->js_job.call_batch(*fn_id, args_list);
+        } catch (...) {
+            // This inner try-catch block deals with cleanup after an exception, but due
+            // to this we must store whether we triggered the timeout signal.
+            is_timeout = job_data->js_timeout.get_signal()->is_pulsed();
+
+            // Sentry must be destroyed before the js_timeout
+            sentry.reset();
+            // This will mark the worker as errored so we don't try to re-sync with it
+            //  on the next line (since we're in a catch statement, we aren't allowed)
+            job_data->js_job.worker_error();
+            job_data.reset();
+
+            throw;
+        }
+    } catch (interrupted_exc_t const &e) {
+        // This outer try-catch block explicitly checks whether it was an
+        // `interrupted_exc_t`, and if so deals with the timeout if set.
+        if (is_timeout) {
+            return std::vector<js_result_t>(args_list.size(), js_result_t(strprintf(
+                "JavaScript query `%s` timed out after %" PRIu64 ".%03" PRIu64 " seconds.",
+                source.c_str(), config.timeout_ms / 1000, config.timeout_ms % 1000)));
+        } else {
+            throw;
+        }
+    }
+
+    // Functions returned by the calls are recompiled from `source` when used (see
+    // `js_result_visitor_t`), so we don't keep them around in the worker.
+    try {
+        for (auto &&result : results) {
+            js_id_t *any_id = boost::get<js_id_t>(&result);
+            if (any_id != NULL) {
+                release_id(*any_id);
+            }
+        }
+    } catch (...) {
+        // This will mark the worker as errored so we don't try to re-sync with it
+        //  on the next line (since we're in a catch statement, we aren't allowed)
+        job_data->js_job.worker_error();
+        job_data.reset();
+        throw;
+    }
+
+    return results;
+}
+
 void js_runner_t::cache_id(js_id_t id, const std::string &source) {
     guarantee(job_data.has());
     guarantee(id != INVALID_ID);
@@ -44,9 +44,12 @@ public:
         uint64_t timeout_ms;
     };
 
+    // `first_source` is the JavaScript we are about to run, if known, and is used
+    // to pick a worker process that has run it before.
     void begin(extproc_pool_t *pool,
                signal_t *interruptor,
-               const ql::configured_limits_t &limits);
+               const ql::configured_limits_t &limits,
+               const std::string &first_source = std::string());
 
     void end();
 
@@ -59,6 +62,14 @@ public:
                      const std::vector<ql::datum_t> &args,
                      const req_config_t &config);
 
+    // Calls a previously compiled function once per element of `args_list`, with a
+    // single round trip to the worker.  The timeout applies to each call, so the
+    // whole batch gets `args_list.size()` times as long.
+    std::vector<js_result_t> call_batch(
+        const std::string &source,
+        const std::vector<std::vector<ql::datum_t> > &args_list,
+        const req_config_t &config);
+
 private:
     static const size_t CACHE_SIZE;
 
@@ -1,6 +1,7 @@
 // Copyright 2010-2012 RethinkDB, all rights reserved.
 
 #include <time.h>
+#include <zlib.h>
 
 #include <string>
 
@@ -24,6 +25,59 @@ bool ends_with(const std::string& str, const std::string& end) {
     return str.rfind(end) == str.length() - end.length();
 }
 
+// Returns true if `etag` is one of the tags in the request's If-None-Match header.
+bool etag_matches(const http_req_t &req, const std::string &etag) {
+    boost::optional<std::string> if_none_match = req.find_header_line("If-None-Match");
+    if (!if_none_match) {
+        return false;
+    }
+    const std::string &tags = if_none_match.get();
+    size_t pos = 0;
+    while (pos < tags.size()) {
+        size_t end = tags.find(',', pos);
+        if (end == std::string::npos) {
+            end = tags.size();
+        }
+        size_t beg = tags.find_first_not_of(' ', pos);
+        size_t last = tags.find_last_not_of(' ', end - 1);
+        if (beg < end && last != std::string::npos && last >= beg) {
+            std::string tag(tags, beg, last + 1 - beg);
+            // If-None-Match uses the weak comparison, so "W/" doesn't matter.
+            if (tag.compare(0, 2, "W/") == 0) {
+                tag.erase(0, 2);
+            }
+            if (tag == "*" || tag == etag) {
+                return true;
+            }
+        }
+        pos = end + 1;
+    }
+    return false;
+}
+
+const file_http_app_t::cached_asset_t *file_http_app_t::get_cached_asset(
+        const std::string &filename, const std::string &data) {
+    {
+        spinlock_acq_t acq(&cache_lock);
+        auto it = cache.find(filename);
+        if (it != cache.end()) {
+            return &it->second;
+        }
+    }
+
+    // Two threads might both do this for the same asset, but only the first result
+    // gets kept. Entries are never removed, so the pointer we return stays valid.
+    cached_asset_t asset;
+    uint32_t checksum = crc32(0, reinterpret_cast<const Bytef *>(data.data()), data.size());
+    asset.etag = strprintf("\"%08" PRIx32 "-%zx\"", checksum, data.size());
+    if (!gzip_compress(data.data(), data.size(), &asset.gzipped)) {
+        asset.gzipped.clear();
+    }
+
+    spinlock_acq_t acq(&cache_lock);
+    return &cache.insert(std::make_pair(filename, std::move(asset))).first->second;
+}
+
 void file_http_app_t::handle(const http_req_t &req, http_res_t *result, signal_t *) {
     if (req.method != http_method_t::GET) {
         *result = http_res_t(http_status_code_t::METHOD_NOT_ALLOWED);
@@ -94,7 +148,20 @@ void file_http_app_t::handle(const http_req_t &req, http_res_t *result, signal_t
     result->add_header_line("Content-Type", mimetype);
 
     if (asset_dir.empty()) {
-        result->body.assign(resource_data.begin(), resource_data.end());
+        const cached_asset_t *cached = get_cached_asset(filename, resource_data);
+        result->add_header_line("ETag", cached->etag);
+        result->add_header_line("Vary", "Accept-Encoding");
+        if (etag_matches(req, cached->etag)) {
+            result->code = http_status_code_t::NOT_MODIFIED;
+            return;
+        }
+
+        if (!cached->gzipped.empty() && accepts_gzip_encoding(req)) {
+            result->add_header_line("Content-Encoding", "gzip");
+            result->body = cached->gzipped;
+        } else {
+            result->body = resource_data;
+        }
         result->code = http_status_code_t::OK;
     } else {
         thread_pool_t::run_in_blocker_pool(boost::bind(&file_http_app_t::handle_blocking, this, filename, result));
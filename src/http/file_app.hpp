@@ -2,8 +2,10 @@
 #ifndef HTTP_FILE_APP_HPP_
 #define HTTP_FILE_APP_HPP_
 
+#include <map>
 #include <string>
 
+#include "arch/spinlock.hpp"
 #include "http/http.hpp"
 
 class file_http_app_t : public http_app_t {
@@ -12,9 +14,23 @@ public:
 
     void handle(const http_req_t &, http_res_t *result, signal_t *interruptor);
 private:
+    /* The compiled-in assets never change, so we work out their ETag and gzip them the
+    first time they're requested, and keep the results for later requests. */
+    struct cached_asset_t {
+        std::string etag;
+        // Empty if gzipping doesn't make the asset any smaller
+        std::string gzipped;
+    };
+
+    const cached_asset_t *get_cached_asset(const std::string &filename,
+                                           const std::string &data);
+
     void handle_blocking(std::string filename, http_res_t *res_out);
 
     std::string asset_dir;
+
+    spinlock_t cache_lock;
+    std::map<std::string, cached_asset_t> cache;
 };
 
 #endif /* HTTP_FILE_APP_HPP_ */
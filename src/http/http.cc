@@ -13,6 +13,7 @@
 #include <boost/algorithm/string.hpp>
 
 #include "arch/io/network.hpp"
+#include "arch/io/tls.hpp"
 #include "logger.hpp"
 #include "utils.hpp"
 
@@ -201,13 +202,7 @@ void http_res_t::set_body(const std::string& content_type, const std::string& co
     body = content;
 }
 
-bool maybe_gzip_response(const http_req_t &req, http_res_t *res) {
-    // Don't bother zipping anything less than 0.5k
-    size_t body_size = res->body.size();
-    if (body_size < 512) {
-        return false;
-    }
-
+bool accepts_gzip_encoding(const http_req_t &req) {
     // See the specification for the "Accept-Encoding" header line here:
     // http://www.w3.org/Protocols/rfc2616/rfc2616-sec14.html#sec14.3
     // We do not implement the entire standard, that is, we will always fallback to
@@ -233,8 +228,10 @@ bool maybe_gzip_response(const http_req_t &req, http_res_t *res) {
     //      be the next comma or the end of the string.  We consume the comma so that the
     //      next iteration will start at the beginning of the remaining string.
     {
-        RE2 re2_parser("^\\s*([\\w-]+|\\*)\\s*(?:;\\s*q\\s*=\\s*([0-9]+(?:\\.[0-9]+)?)\\s*)?(?:,|$)",
-                       RE2::Quiet);
+        // Compiling the regex is much more expensive than matching it, and a const
+        // `RE2` can be shared between threads.
+        static const RE2 re2_parser("^\\s*([\\w-]+|\\*)\\s*(?:;\\s*q\\s*=\\s*([0-9]+(?:\\.[0-9]+)?)\\s*)?(?:,|$)",
+                                    RE2::Quiet);
         re2::StringPiece encodings_re2(supported_encoding.get());
         std::string name;
         std::string qvalue;
@@ -295,16 +292,19 @@ bool maybe_gzip_response(const http_req_t &req, http_res_t *res) {
         return false;
     }
 
-    // Gzip is supported and preferred, gzip the body of the result
-    scoped_array_t<char> out_buffer(body_size);
+    return true;
+}
+
+bool gzip_compress(const char *data, size_t size, std::string *out) {
+    scoped_array_t<char> out_buffer(size);
 
     z_stream zstream;
     zstream.zalloc = Z_NULL;
     zstream.zfree = Z_NULL;
     zstream.opaque = Z_NULL;
-    zstream.avail_in = body_size;
-    zstream.avail_out = body_size;
-    zstream.next_in = reinterpret_cast<unsigned char*>(const_cast<char *>(res->body.data()));
+    zstream.avail_in = size;
+    zstream.avail_out = size;
+    zstream.next_in = reinterpret_cast<unsigned char*>(const_cast<char *>(data));
     zstream.next_out = reinterpret_cast<unsigned char*>(out_buffer.data());
     zstream.total_in = 0;
     zstream.total_out = 0;
@@ -332,12 +332,28 @@ bool maybe_gzip_response(const http_req_t &req, http_res_t *res) {
         return false;
     }
 
-    // Would be nice if we could do this without copying
-    res->body.assign(out_buffer.data(), zstream.total_out);
+    out->assign(out_buffer.data(), zstream.total_out);
+    return true;
+}
+
+bool maybe_gzip_response(const http_req_t &req, http_res_t *res) {
+    // Don't bother zipping anything less than 0.5k
+    if (res->body.size() < 512
+        || res->header_lines.find("content-encoding") != res->header_lines.end()
+        || !accepts_gzip_encoding(req)) {
+        return false;
+    }
+
+    // Gzip is supported and preferred, gzip the body of the result
+    std::string compressed;
+    if (!gzip_compress(res->body.data(), res->body.size(), &compressed)) {
+        return false;
+    }
+    res->body.swap(compressed);
 
     // Update the body size in the headers
     if (res->header_lines.find("content-length") != res->header_lines.end()){
-        res->header_lines["content-length"] = strprintf("%lu", zstream.total_out);
+        res->header_lines["content-length"] = strprintf("%zu", res->body.size());
     }
 
     res->add_header_line("Content-Encoding", "gzip");
@@ -369,6 +385,8 @@ std::string human_readable_status(http_status_code_t code) {
     switch (code) {
     case http_status_code_t::OK:
         return "OK";
+    case http_status_code_t::NOT_MODIFIED:
+        return "Not Modified";
     case http_status_code_t::BAD_REQUEST:
         return "Bad Request";
     case http_status_code_t::FORBIDDEN:
@@ -385,15 +403,22 @@ std::string human_readable_status(http_status_code_t code) {
 }
 
 void write_http_msg(tcp_conn_t *conn, const http_res_t &res, signal_t *closer) THROWS_ONLY(tcp_conn_write_closed_exc_t) {
-    conn->writef(closer, "HTTP/%s %" PRIu32 " %s\r\n",
-                 res.version.c_str(),
-                 static_cast<uint32_t>(res.code),
-                 human_readable_status(res.code).c_str());
+    // Send the status line, the headers and the body with a single write.
+    std::string head = strprintf("HTTP/%s %" PRIu32 " %s\r\n",
+                                 res.version.c_str(),
+                                 static_cast<uint32_t>(res.code),
+                                 human_readable_status(res.code).c_str());
     for (auto const &line: res.header_lines) {
-        conn->writef(closer, "%s: %s\r\n", line.first.c_str(), line.second.c_str());
+        head.append(line.first).append(": ").append(line.second).append("\r\n");
     }
-    conn->writef(closer, "\r\n");
-    conn->write(res.body.c_str(), res.body.size(), closer);
+    head.append("\r\n");
+
+    iovec iov[2];
+    iov[0].iov_base = const_cast<char *>(head.data());
+    iov[0].iov_len = head.size();
+    iov[1].iov_base = const_cast<char *>(res.body.data());
+    iov[1].iov_len = res.body.size();
+    conn->write_vectored(iov, res.body.empty() ? 1 : 2, closer);
 }
 
 void http_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn, auto_drainer_t::lock_t keepalive) {
@@ -405,6 +430,10 @@ void http_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn
 
     // Parse the request
     try {
+        if (tls_ctx_t *tls_ctx = get_tls_ctx(tls_service_t::HTTP, tls_role_t::SERVER)) {
+            conn->enable_tls(tls_ctx, keepalive.get_drain_signal());
+        }
+
         http_res_t res;
         UNUSED bool peer_res = conn->getpeername(&req.peer);
 
@@ -418,6 +447,8 @@ void http_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn
         write_http_msg(conn.get(), res, keepalive.get_drain_signal());
     } catch (const interrupted_exc_t &) {
         // The query was interrupted, no response since we are shutting down
+    } catch (const tcp_conn_t::tls_failed_exc_t &) {
+        // Probably someone speaking plain HTTP to a TLS port.
     } catch (const tcp_conn_read_closed_exc_t &) {
         // Someone disconnected before sending us all the information we
         // needed... oh well.
@@ -427,153 +458,208 @@ void http_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn
     }
 }
 
+// The request line and the headers must fit in this many bytes.
+static const size_t MAX_HTTP_HEAD_SIZE = 64 * KILOBYTE;
+
+/* Returns the size of the request line and headers at the start of `slice`,
+including the blank line that ends them, or 0 if they aren't all there yet. The
+first `scanned` bytes were already searched by an earlier call. */
+static size_t find_http_head_size(const_charslice slice, size_t scanned) {
+    static const char terminator[] = "\r\n\r\n";
+    const size_t terminator_size = sizeof(terminator) - 1;
+    const size_t size = slice.end - slice.beg;
+    const size_t start = scanned < terminator_size ? 0 : scanned - (terminator_size - 1);
+    if (size < start + terminator_size) {
+        return 0;
+    }
+    const char *found = static_cast<const char *>(
+        memmem(slice.beg + start, size - start, terminator, terminator_size));
+    return found == NULL ? 0 : (found - slice.beg) + terminator_size;
+}
+
+// Returns the "\r\n" that ends the line at `beg`. Only call this on a complete head.
+static const char *find_http_line_end(const char *beg) {
+    const char *iter = beg;
+    while (!(iter[0] == '\r' && iter[1] == '\n')) {
+        ++iter;
+    }
+    return iter;
+}
+
+static const char *skip_spaces(const char *beg, const char *end) {
+    while (beg != end && *beg == ' ') {
+        ++beg;
+    }
+    return beg;
+}
+
+static bool parse_http_method(const char *beg, const char *end, http_method_t *out) {
+    static const std::pair<const char *, http_method_t> methods[] = {
+        std::make_pair("HEAD", http_method_t::HEAD),
+        std::make_pair("GET", http_method_t::GET),
+        std::make_pair("POST", http_method_t::POST),
+        std::make_pair("PUT", http_method_t::PUT),
+        std::make_pair("DELETE", http_method_t::DELETE),
+        std::make_pair("TRACE", http_method_t::TRACE),
+        std::make_pair("OPTIONS", http_method_t::OPTIONS),
+        std::make_pair("CONNECT", http_method_t::CONNECT),
+        std::make_pair("PATCH", http_method_t::PATCH) };
+    const size_t size = end - beg;
+    for (const auto &method : methods) {
+        if (strlen(method.first) == size && memcmp(method.first, beg, size) == 0) {
+            *out = method.second;
+            return true;
+        }
+    }
+    return false;
+}
+
 // Parse a http request off of the tcp conn and stuff it into the http_req_t object. Returns parse success.
 bool tcp_http_msg_parser_t::parse(tcp_conn_t *conn, http_req_t *req, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t) {
-    line_parser_t parser(conn);
-
-    std::string method = parser.readWord(closer);
-    if (method == "HEAD") {
-        req->method = http_method_t::HEAD;
-    } else if (method == "GET") {
-        req->method = http_method_t::GET;
-    } else if (method == "POST") {
-        req->method = http_method_t::POST;
-    } else if (method == "PUT") {
-        req->method = http_method_t::PUT;
-    } else if (method == "DELETE") {
-        req->method = http_method_t::DELETE;
-    } else if (method == "TRACE") {
-        req->method = http_method_t::TRACE;
-    } else if (method == "OPTIONS") {
-        req->method = http_method_t::OPTIONS;
-    } else if (method == "CONNECT") {
-        req->method = http_method_t::CONNECT;
-    } else if (method == "PATCH") {
-        req->method = http_method_t::PATCH;
-    } else {
+    // Wait until the whole head is in the read buffer, so that we can parse it in
+    // place instead of copying it out a line at a time.
+    size_t scanned = 0;
+    size_t head_size;
+    const_charslice slice = conn->peek();
+    while ((head_size = find_http_head_size(slice, scanned)) == 0) {
+        scanned = slice.end - slice.beg;
+        if (scanned > MAX_HTTP_HEAD_SIZE) {
+            return false;
+        }
+        conn->read_more_buffered(closer);
+        slice = conn->peek();
+    }
+
+    bool success = parse_head(slice.beg, slice.beg + head_size - 2, req);
+    conn->pop(head_size, closer);
+    if (!success) {
+        return false;
+    }
+
+    // Parse body
+    size_t body_length = content_length(*req);
+    const_charslice body = conn->peek(body_length, closer);
+    req->body.append(body.beg, body_length);
+    conn->pop(body_length, closer);
+
+    return true;
+}
+
+// `end` points at the blank line that ends the head.
+bool tcp_http_msg_parser_t::parse_head(const char *beg, const char *end, http_req_t *req) {
+    const char *line_end = find_http_line_end(beg);
+
+    const char *word_end = static_cast<const char *>(memchr(beg, ' ', line_end - beg));
+    if (word_end == NULL || !parse_http_method(beg, word_end, &req->method)) {
         return false;
     }
 
     // Parse out the query params from the resource
+    const char *word_beg = skip_spaces(word_end, line_end);
+    word_end = static_cast<const char *>(memchr(word_beg, ' ', line_end - word_beg));
+    if (word_end == NULL) {
+        return false;
+    }
     resource_string_parser_t resource_string;
-    std::string src_string = parser.readWord(closer);
-    if (!resource_string.parse(src_string)) {
+    if (!resource_string.parse(word_beg, word_end)) {
         return false;
     }
 
-    if (!req->resource.assign(resource_string.resource)) return false;
-    req->query_params = resource_string.query_params;
+    if (!req->resource.assign(resource_string.resource_beg,
+                              resource_string.resource_end - resource_string.resource_beg)) {
+        return false;
+    }
+    req->query_params = std::move(resource_string.query_params);
 
-    std::string version_str = parser.readLine(closer);
     version_parser_t version_parser;
-    version_parser.parse(version_str);
+    version_parser.parse(skip_spaces(word_end, line_end), line_end);
     req->version = version_parser.version;
 
     // Parse header lines.
-    while (true) {
-        std::string header_line = parser.readLine(closer);
-        if (header_line.length() == 0) {
-            // Blank line separates header from body. We're done here.
-            break;
-        }
+    // The blank line at `end` separates the headers from the body.
+    for (const char *iter = line_end + 2; iter != end; iter = line_end + 2) {
+        line_end = find_http_line_end(iter);
 
         header_line_parser_t header_parser;
-        if (!header_parser.parse(header_line)) {
+        if (!header_parser.parse(iter, line_end)) {
             return false;
         }
 
         req->add_header_line(header_parser.key, header_parser.val);
     }
 
-    // Parse body
-    size_t body_length = content_length(*req);
-    const_charslice body = conn->peek(body_length, closer);
-    req->body.append(body.beg, body_length);
-    conn->pop(body_length, closer);
-
     return true;
 }
 
 #define HTTP_VERSION_PREFIX "HTTP/"
-bool tcp_http_msg_parser_t::version_parser_t::parse(const std::string &src) {
+bool tcp_http_msg_parser_t::version_parser_t::parse(const char *beg, const char *end) {
     // Very simple, src will almost always be 'HTTP/1.1', we just need the '1.1'
-    if (strncmp(HTTP_VERSION_PREFIX, src.c_str(), strlen(HTTP_VERSION_PREFIX)) == 0) {
-        version = std::string(src.begin() + strlen(HTTP_VERSION_PREFIX), src.end());
+    const size_t prefix_size = strlen(HTTP_VERSION_PREFIX);
+    if (static_cast<size_t>(end - beg) >= prefix_size
+        && strncmp(HTTP_VERSION_PREFIX, beg, prefix_size) == 0) {
+        version.assign(beg + prefix_size, end);
         return true;
     }
     return false;
 }
 
-bool tcp_http_msg_parser_t::resource_string_parser_t::parse(const std::string &src) {
-    std::string key, val;
-    std::string::const_iterator iter = src.begin();
+bool tcp_http_msg_parser_t::resource_string_parser_t::parse(const char *beg, const char *end) {
+    const char *iter = beg;
 
-    while (iter != src.end() && *iter != '?') {
+    while (iter != end && *iter != '?') {
         ++iter;
     }
 
-    resource = std::string(src.begin(), iter);
+    resource_beg = beg;
+    resource_end = iter;
 
-    if (iter == src.end()) {
+    if (iter == end) {
         // No query string, leave it empty
         return true;
     }
 
     ++iter; // To skip the '?'
 
-    while (iter != src.end()) {
+    while (iter != end) {
 
         // Skip to the end of this param
-        std::string::const_iterator query_start = iter;
-        while (!(iter == src.end() || *iter == '&')) {
+        const char *query_start = iter;
+        while (!(iter == end || *iter == '&')) {
             ++iter;
         }
 
         // Find '=' that splits the key and value
-        std::string::const_iterator query_iter = query_start;
+        const char *query_iter = query_start;
         while (!(query_iter == iter || *query_iter == '=')) {
             ++query_iter;
         }
 
-        key = std::string(query_start, query_iter);
-        if (query_iter == iter) {
-            // There was no '=' and subsequent value, default to ""
-            val = "";
-        } else {
-            val = std::string(query_iter + 1, iter);
-        }
-
+        std::string key(query_start, query_iter);
         if (query_params.find(key) == query_params.end()) {
-            query_params[key] = val;
+            // If there was no '=' and subsequent value, default to ""
+            query_params[key] = query_iter == iter
+                ? std::string()
+                : std::string(query_iter + 1, iter);
         }
 
         // Skip the '&'
-        if (iter != src.end()) ++iter;
+        if (iter != end) ++iter;
     }
 
     return true;
 }
 
-bool tcp_http_msg_parser_t::header_line_parser_t::parse(const std::string &src) {
-    std::string::const_iterator iter = src.begin();
-    while (iter != src.end() && *iter != ':') {
-        ++iter;
-    }
-
-    if (iter == src.end()) {
+bool tcp_http_msg_parser_t::header_line_parser_t::parse(const char *beg, const char *end) {
+    const char *iter = static_cast<const char *>(memchr(beg, ':', end - beg));
+    if (iter == NULL) {
         // No ':' found, error
         return false;
     }
 
-    key = std::string(src.begin(), iter);
+    key.assign(beg, iter);
 
     /* Strip away spaces before parsing value */
-    ++iter;
-    while (iter != src.end() && *iter == ' ') {
-        ++iter;
-    }
-
-    val = std::string(iter, src.end());
+    val.assign(skip_spaces(iter + 1, end), end);
 
     return true;
 }
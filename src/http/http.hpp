@@ -83,6 +83,7 @@ int content_length(const http_req_t&);
 
 enum class http_status_code_t {
     OK = 200,
+    NOT_MODIFIED = 304,
     BAD_REQUEST = 400,
     FORBIDDEN = 403,
     NOT_FOUND = 404,
@@ -107,34 +108,49 @@ public:
     void add_last_modified(int);
 };
 
+/* Returns true if the request's Accept-Encoding header prefers gzip. */
+bool accepts_gzip_encoding(const http_req_t &req);
+
+/* Gzips `size` bytes from `data` into `out`. Returns false if that fails, or if the
+result wouldn't be any smaller. */
+bool gzip_compress(const char *data, size_t size, std::string *out);
+
+/* Gzips the body of `res` if the client supports it and it's worth it. Does nothing if
+the body is already encoded. */
 bool maybe_gzip_response(const http_req_t &req, http_res_t *res);
 
 http_res_t http_error_res(const std::string &content,
     http_status_code_t rescode = http_status_code_t::BAD_REQUEST);
 
+/* `tcp_http_msg_parser_t` waits until the request line and headers are all in the
+connection's read buffer, and then parses them in place. Only the values that end up
+in the `http_req_t` get copied. */
 class tcp_http_msg_parser_t {
 public:
     tcp_http_msg_parser_t() {}
     bool parse(tcp_conn_t *conn, http_req_t *req, signal_t *closer) THROWS_ONLY(tcp_conn_read_closed_exc_t);
 private:
+    static bool parse_head(const char *beg, const char *end, http_req_t *req);
+
     struct version_parser_t {
         std::string version;
 
-        bool parse(const std::string &src);
+        bool parse(const char *beg, const char *end);
     };
 
     struct resource_string_parser_t {
-        std::string resource;
+        const char *resource_beg;
+        const char *resource_end;
         std::map<std::string, std::string> query_params;
 
-        bool parse(const std::string &src);
+        bool parse(const char *beg, const char *end);
     };
 
     struct header_line_parser_t {
         std::string key;
         std::string val;
 
-        bool parse(const std::string &src);
+        bool parse(const char *beg, const char *end);
     };
 };
 
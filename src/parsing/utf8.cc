@@ -1,5 +1,6 @@
 #include "parsing/utf8.hpp"
 
+#include <stdint.h>
 #include <string.h>
 #include <string>
 
@@ -50,8 +51,7 @@ inline unsigned int extract_and_shift(char c, unsigned int bits, unsigned int am
     return extract_bits(c, bits) << amount;
 }
 
-template <class Iterator>
-inline bool check_continuation(const Iterator &p, const Iterator &end,
+inline bool check_continuation(const char *p, const char *end,
                                size_t position, reason_t *reason) {
     if (p == end) {
         reason->position = position;
@@ -66,12 +66,28 @@ inline bool check_continuation(const Iterator &p, const Iterator &end,
     return true;
 }
 
-template <class Iterator>
-inline bool is_valid_internal(const Iterator &begin, const Iterator &end,
+// Most strings are mostly ASCII, so we check eight bytes at a time for any of them
+// having the high bit set before looking at the bytes one by one.
+const uint64_t HIGH_BITS_OF_WORD = 0x8080808080808080ULL;
+
+inline bool is_valid_internal(const char *begin, const char *end,
                               reason_t *reason) {
-    Iterator p = begin;
+    const char *p = begin;
     size_t position = 0;
     while (p != end) {
+        while (end - p >= static_cast<ptrdiff_t>(sizeof(uint64_t))) {
+            uint64_t word;
+            memcpy(&word, p, sizeof(word));
+            if ((word & HIGH_BITS_OF_WORD) != 0) {
+                break;
+            }
+            p += sizeof(word);
+            position += sizeof(word);
+        }
+        if (p == end) {
+            break;
+        }
+
         if (is_standalone(*p)) {
             // 0xxxxxxx - ASCII character
             // don't need to do anything
@@ -144,7 +160,7 @@ bool is_valid(const datum_string_t &str) {
 
 bool is_valid(const std::string &str) {
     reason_t reason;
-    return is_valid_internal(str.begin(), str.end(), &reason);
+    return is_valid_internal(str.data(), str.data() + str.size(), &reason);
 }
 
 bool is_valid(const char *start, const char *end) {
@@ -157,7 +173,7 @@ bool is_valid(const datum_string_t &str, reason_t *reason) {
 }
 
 bool is_valid(const std::string &str, reason_t *reason) {
-    return is_valid_internal(str.begin(), str.end(), reason);
+    return is_valid_internal(str.data(), str.data() + str.size(), reason);
 }
 
 bool is_valid(const char *start, const char *end, reason_t *reason) {
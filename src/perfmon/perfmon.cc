@@ -3,6 +3,7 @@
 
 #include <stdarg.h>
 #include <math.h>
+#include <string.h>
 #include <map>
 
 #include "utils.hpp"
@@ -18,6 +19,10 @@ static const char *stat_per_sec = "per_sec";
 static const char *stat_count = "count";
 static const char *stat_mean = "mean";
 static const char *stat_std_dev = "std_dev";
+static const char *stat_p50 = "p50";
+static const char *stat_p90 = "p90";
+static const char *stat_p99 = "p99";
+static const char *stat_p999 = "p999";
 
 
 #ifdef FULL_PERFMON
@@ -301,11 +306,151 @@ ql::datum_t perfmon_rate_monitor_t::output_stat(const double &stat) {
     return ql::datum_t(stat / ticks_to_secs(length));
 }
 
+/* latency_histogram_t */
+
+latency_histogram_t::latency_histogram_t() : count_(0), max_(0) {
+    memset(buckets_, 0, sizeof(buckets_));
+}
+
+size_t latency_histogram_t::bucket_index(ticks_t duration) {
+    if (duration < static_cast<ticks_t>(SUB_BUCKETS)) {
+        return duration;
+    }
+    const int magnitude = 63 - __builtin_clzll(duration);
+    if (magnitude > MAX_MAGNITUDE) {
+        return NUM_BUCKETS - 1;
+    }
+    // The top bit is implied by the magnitude; the next `SUB_BUCKET_BITS` bits pick
+    // the sub-bucket.
+    const int shift = magnitude - SUB_BUCKET_BITS;
+    return (magnitude - SUB_BUCKET_BITS + 1) * SUB_BUCKETS
+        + ((duration >> shift) & (SUB_BUCKETS - 1));
+}
+
+ticks_t latency_histogram_t::bucket_upper_bound(size_t index) {
+    rassert(index < NUM_BUCKETS);
+    if (index < static_cast<size_t>(SUB_BUCKETS)) {
+        return index;
+    }
+    const int shift = index / SUB_BUCKETS - 1;
+    const ticks_t lower = (SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    return lower + (static_cast<ticks_t>(1) << shift) - 1;
+}
+
+void latency_histogram_t::record(ticks_t duration) {
+    ++buckets_[bucket_index(duration)];
+    ++count_;
+    max_ = std::max(max_, duration);
+}
+
+void latency_histogram_t::merge(const latency_histogram_t &other) {
+    if (other.count_ == 0) {
+        return;
+    }
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    max_ = std::max(max_, other.max_);
+}
+
+ticks_t latency_histogram_t::percentile(double fraction) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, ceil(fraction * count_));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            return std::min(bucket_upper_bound(i), max_);
+        }
+    }
+    return max_;
+}
+
+/* perfmon_latency_histogram_t */
+
+perfmon_latency_histogram_t::perfmon_latency_histogram_t(ticks_t _length)
+    : perfmon_perthread_t<latency_histogram_t>(), length(_length) {
+    for (int i = 0; i < MAX_THREADS; ++i) {
+        thread_data[i] = NULL;
+    }
+}
+
+perfmon_latency_histogram_t::~perfmon_latency_histogram_t() {
+    for (int i = 0; i < MAX_THREADS; ++i) {
+        delete thread_data[i];
+    }
+}
+
+perfmon_latency_histogram_t::thread_info_t *
+perfmon_latency_histogram_t::get_thread_info(ticks_t now) {
+    rassert(get_thread_id().threadnum >= 0);
+    thread_info_t *&thread = thread_data[get_thread_id().threadnum];
+    const int64_t interval = now / length;
+    if (thread == NULL) {
+        thread = new thread_info_t;
+        thread->current_interval = interval;
+    } else if (thread->current_interval + 1 == interval) {
+        thread->last_stats = thread->current_stats;
+        thread->current_stats = latency_histogram_t();
+        thread->current_interval = interval;
+    } else if (thread->current_interval != interval) {
+        thread->last_stats = thread->current_stats = latency_histogram_t();
+        thread->current_interval = interval;
+    }
+    return thread;
+}
+
+void perfmon_latency_histogram_t::record(ticks_t duration) {
+    get_thread_info(get_ticks())->current_stats.record(duration);
+}
+
+void perfmon_latency_histogram_t::get_thread_stat(latency_histogram_t *stat) {
+    // Like `perfmon_sampler_t`, we report the last complete interval.
+    rassert(get_thread_id().threadnum >= 0);
+    if (thread_data[get_thread_id().threadnum] != NULL) {
+        *stat = get_thread_info(get_ticks())->last_stats;
+    }
+}
+
+latency_histogram_t perfmon_latency_histogram_t::combine_stats(
+        const latency_histogram_t *stats) {
+    latency_histogram_t combined;
+    for (int i = 0; i < get_num_threads(); ++i) {
+        combined.merge(stats[i]);
+    }
+    return combined;
+}
+
+ql::datum_t perfmon_latency_histogram_t::output_stat(const latency_histogram_t &stat) {
+    ql::datum_object_builder_t builder;
+
+    builder.overwrite(stat_count, ql::datum_t(static_cast<double>(stat.count())));
+    const std::pair<const char *, double> percentiles[] = {
+        std::make_pair(stat_p50, 0.5),
+        std::make_pair(stat_p90, 0.9),
+        std::make_pair(stat_p99, 0.99),
+        std::make_pair(stat_p999, 0.999) };
+    for (const auto &p : percentiles) {
+        builder.overwrite(p.first, stat.count() > 0
+            ? ql::datum_t(ticks_to_secs(stat.percentile(p.second)))
+            : ql::datum_t::null());
+    }
+    builder.overwrite(stat_max, stat.count() > 0
+        ? ql::datum_t(ticks_to_secs(stat.max()))
+        : ql::datum_t::null());
+
+    return std::move(builder).to_datum();
+}
+
 perfmon_duration_sampler_t::perfmon_duration_sampler_t(ticks_t length, bool _ignore_global_full_perfmon)
-    : stat(), active(), total(), recent(length, true),
+    : stat(), active(), total(), recent(length, true), latency(length),
       active_membership(&stat, &active, "active_count"),
       total_membership(&stat, &total, "total"),
       recent_membership(&stat, &recent, "recent_duration"),
+      latency_membership(&stat, &latency, "latency"),
       ignore_global_full_perfmon(_ignore_global_full_perfmon)
 { }
 
@@ -322,7 +467,9 @@ void perfmon_duration_sampler_t::begin(ticks_t *v) {
 void perfmon_duration_sampler_t::end(ticks_t *v) {
     --active;
     if (*v != 0) {
-        recent.record(ticks_to_secs(get_ticks() - *v));
+        const ticks_t duration = get_ticks() - *v;
+        recent.record(ticks_to_secs(duration));
+        latency.record(duration);
     }
 }
 
@@ -215,11 +215,77 @@ public:
     void record(double value = 1.0);
 };
 
+/* `latency_histogram_t` counts durations (in ticks) in logarithmic buckets: eight
+ * buckets per power of two, so any percentile we read back is within 12.5% of the
+ * true value. Histograms from different threads can be merged, which is what lets
+ * us report tail latencies instead of just averages. Durations above
+ * 2^MAX_MAGNITUDE ticks (about 73 minutes) all land in the last bucket.
+ */
+class latency_histogram_t {
+public:
+    static const int SUB_BUCKET_BITS = 3;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int MAX_MAGNITUDE = 42;
+    static const size_t NUM_BUCKETS = (MAX_MAGNITUDE - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+    latency_histogram_t();
+
+    void record(ticks_t duration);
+    void merge(const latency_histogram_t &other);
+
+    uint64_t count() const { return count_; }
+    ticks_t max() const { return max_; }
+
+    // The duration that `fraction` (between 0 and 1) of the recorded durations are
+    // at or below, rounded up to the end of its bucket. Zero if nothing was recorded.
+    ticks_t percentile(double fraction) const;
+
+    static size_t bucket_index(ticks_t duration);
+    // The largest duration that goes in bucket `index`.
+    static ticks_t bucket_upper_bound(size_t index);
+
+private:
+    uint64_t count_;
+    ticks_t max_;
+    uint32_t buckets_[NUM_BUCKETS];
+};
+
+/* `perfmon_latency_histogram_t` reports the count, p50, p90, p99, p99.9 and max
+ * (in seconds) of the durations recorded over the last `length` ticks. Each thread
+ * records into its own histograms, which it allocates the first time it records
+ * something, so threads that never see an event don't pay for the buckets. Only
+ * the owning thread ever touches them (stats are collected on each thread in
+ * turn), so no locking is needed.
+ */
+class perfmon_latency_histogram_t : public perfmon_perthread_t<latency_histogram_t> {
+public:
+    explicit perfmon_latency_histogram_t(ticks_t length);
+    virtual ~perfmon_latency_histogram_t();
+    void record(ticks_t duration);
+
+private:
+    struct thread_info_t {
+        latency_histogram_t current_stats, last_stats;
+        int64_t current_interval;
+    };
+
+    thread_info_t *get_thread_info(ticks_t now);
+
+    void get_thread_stat(latency_histogram_t *);
+    latency_histogram_t combine_stats(const latency_histogram_t *);
+    ql::datum_t output_stat(const latency_histogram_t &);
+
+    ticks_t length;
+    thread_info_t *thread_data[MAX_THREADS];
+
+    DISABLE_COPYING(perfmon_latency_histogram_t);
+};
+
 /* perfmon_duration_sampler_t is a perfmon_t that monitors events that have a
  * starting and ending time. When something starts, call begin(); when
  * something ends, call end() with the same value as begin. It will produce
- * stats for the number of active events, the average length of an event, and
- * so on. If `global_full_perfmon` is false, it won't report any timing-related
+ * stats for the number of active events, the average length of an event, a
+ * latency histogram, and so on. If `global_full_perfmon` is false, it won't report any timing-related
  * stats because `get_ticks()` is rather slow.
  *
  * Frequently we're in the case where we'd like to have a single slow perfmon
@@ -234,9 +300,11 @@ private:
     perfmon_counter_t active;
     perfmon_counter_t total;
     perfmon_sampler_t recent;
+    perfmon_latency_histogram_t latency;
     perfmon_membership_t active_membership;
     perfmon_membership_t total_membership;
     perfmon_membership_t recent_membership;
+    perfmon_membership_t latency_membership;
 
     bool ignore_global_full_perfmon;
 public:
@@ -271,4 +339,21 @@ struct block_pm_duration {
     }
 };
 
+/* Records the time from its construction to its destruction in a
+ * `perfmon_latency_histogram_t`, unless that is NULL. */
+class block_pm_latency {
+public:
+    explicit block_pm_latency(perfmon_latency_histogram_t *_pm)
+        : start(_pm != NULL ? get_ticks() : 0), pm(_pm) { }
+    ~block_pm_latency() {
+        if (pm != NULL) {
+            pm->record(get_ticks() - start);
+        }
+    }
+private:
+    ticks_t start;
+    perfmon_latency_histogram_t *pm;
+    DISABLE_COPYING(block_pm_latency);
+};
+
 #endif /* PERFMON_PERFMON_HPP_ */
@@ -20,9 +20,12 @@ class js_pretty_printer_t
     : public generic_term_walker_t<counted_t<const document_t> > {
     unsigned int depth;
     bool prepend_ok, in_r_expr;
+    const bool normalize_literals;
     typedef std::vector<counted_t<const document_t> > v;
 public:
-    js_pretty_printer_t() : depth(0), prepend_ok(true), in_r_expr(false) {}
+    explicit js_pretty_printer_t(bool _normalize_literals)
+        : depth(0), prepend_ok(true), in_r_expr(false),
+          normalize_literals(_normalize_literals) {}
 protected:
     counted_t<const document_t> visit_generic(const Term &t) override {
         bool old_r_expr = in_r_expr;
@@ -154,6 +157,16 @@ private:
         return prepend_r_obj(make_nest(make_concat(std::move(term))));
     }
     counted_t<const document_t> to_js_datum(const Datum &d) {
+        if (normalize_literals) {
+            switch (d.type()) {
+            case Datum::R_BOOL:
+            case Datum::R_NUM:
+            case Datum::R_JSON:
+                return placeholder;
+            default:
+                break;
+            }
+        }
         switch (d.type()) {
         case Datum::R_NULL:
             return nil;
@@ -658,7 +671,7 @@ private:
     static counted_t<const document_t> lparen, rparen, lbrack, rbrack, lbrace, rbrace,
         colon, quote, sp, justdot, dotdotdot, comma, semicolon;
     static counted_t<const document_t> nil, true_v, false_v, r_st, json, row, do_st,
-        return_st, lambda_1, lambda_2, expr, object, js;
+        return_st, lambda_1, lambda_2, expr, object, js, placeholder;
 
     static const unsigned int MAX_DEPTH = 15;
 };
@@ -689,9 +702,14 @@ counted_t<const document_t> js_pretty_printer_t::lambda_2 = make_text("tion");
 counted_t<const document_t> js_pretty_printer_t::expr = make_text("expr");
 counted_t<const document_t> js_pretty_printer_t::object = make_text("object");
 counted_t<const document_t> js_pretty_printer_t::js = make_text("js");
+counted_t<const document_t> js_pretty_printer_t::placeholder = make_text("?");
 
 counted_t<const document_t> render_as_javascript(const Term &t) {
-    return js_pretty_printer_t().walk(t);
+    return js_pretty_printer_t(false).walk(t);
+}
+
+counted_t<const document_t> render_as_normalized_javascript(const Term &t) {
+    return js_pretty_printer_t(true).walk(t);
 }
 
 } // namespace pprint
@@ -915,6 +933,7 @@ static void pprint_update_reminder() {
     case Datum::R_NUM:
     case Datum::R_STR:
     case Datum::R_JSON:
+    case Datum::R_SERIALIZED:
     case Datum::R_ARRAY:
     case Datum::R_OBJECT:
         break;
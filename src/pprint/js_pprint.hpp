@@ -8,6 +8,11 @@ class Term;
 
 namespace pprint {
     counted_t<const document_t> render_as_javascript(const Term &t);
+
+    // Like `render_as_javascript`, but numbers, booleans and `r.json` strings are
+    // printed as `?`, so that queries that only differ in those values look the same.
+    // Other strings are kept, since they mostly name tables, fields and indexes.
+    counted_t<const document_t> render_as_normalized_javascript(const Term &t);
 }
 
 #endif // PPRINT_JS_PPRINT_HPP_
@@ -169,7 +169,13 @@ template<>
 void extract(cJSON *json, Query *q) {
     // It's ok to use the slow functions here, because the indexes are small
     transfer(cJSON_slow_GetArrayItem(json, 0), q, &Query::set_type);
-    transfer(cJSON_slow_GetArrayItem(json, 1), q, &Query::mutable_query);
+    if (q->type() == Query::BATCH) {
+        cJSON *batch = cJSON_slow_GetArrayItem(json, 1);
+        if (batch != NULL && batch->type != cJSON_Array) throw exc_t();
+        transfer_arr(batch, q, &Query::add_batch);
+    } else {
+        transfer(cJSON_slow_GetArrayItem(json, 1), q, &Query::mutable_query);
+    }
     q->set_accepts_r_json(true);
     transfer_arr(cJSON_slow_GetArrayItem(json, 2), q, &Query::add_global_optargs);
 }
@@ -202,60 +208,69 @@ bool parse_json_pb(Query *q, int64_t token, const char *str) THROWS_NOTHING {
     }
 }
 
-void write_json_pb(const Response &r, std::string *s) THROWS_NOTHING {
-    // Note: We must keep any existing prefix in `s` intact.
-#ifdef NDEBUG
-    const size_t start_offset = s->length();
-#endif
-    try {
-        *s += strprintf("{\"t\":%d,\"r\":[", r.type());
-        for (int i = 0; i < r.response_size(); ++i) {
-            *s += (i == 0) ? "" : ",";
-            const Datum *d = &r.response(i);
-            if (d->type() == Datum::R_JSON) {
-                *s += d->r_str();
-            } else if (d->type() == Datum::R_STR) {
-                scoped_cJSON_t tmp(cJSON_CreateString(d->r_str().c_str()));
-                *s += tmp.PrintUnformatted();
-            } else {
-                unreachable();
-            }
-        }
-        *s += "],\"n\":[";
-        for (int i = 0; i < r.notes_size(); ++i) {
-            *s += (i == 0) ? "" : ",";
-            *s += strprintf("%d", r.notes(i));
+static void write_json_response(const Response &r, std::string *s) {
+    *s += strprintf("{\"t\":%d,\"r\":[", r.type());
+    // A batch's responses take the place of the results.
+    for (int i = 0; i < r.batch_size(); ++i) {
+        *s += (i == 0) ? "" : ",";
+        write_json_response(r.batch(i), s);
+    }
+    for (int i = 0; i < r.response_size(); ++i) {
+        *s += (i == 0) ? "" : ",";
+        const Datum *d = &r.response(i);
+        if (d->type() == Datum::R_JSON) {
+            *s += d->r_str();
+        } else if (d->type() == Datum::R_STR) {
+            scoped_cJSON_t tmp(cJSON_CreateString(d->r_str().c_str()));
+            *s += tmp.PrintUnformatted();
+        } else {
+            unreachable();
         }
-        *s += "]";
+    }
+    *s += "],\"n\":[";
+    for (int i = 0; i < r.notes_size(); ++i) {
+        *s += (i == 0) ? "" : ",";
+        *s += strprintf("%d", r.notes(i));
+    }
+    *s += "]";
 
-        if (r.has_backtrace()) {
-            *s += ",\"b\":";
-            const Backtrace *bt = &r.backtrace();
-            scoped_cJSON_t arr(cJSON_CreateArray());
-            for (int i = 0; i < bt->frames_size(); ++i) {
-                const Frame *f = &bt->frames(i);
-                switch (f->type()) {
-                case Frame::POS:
-                    arr.AddItemToArray(cJSON_CreateNumber(f->pos()));
-                    break;
-                case Frame::OPT:
-                    arr.AddItemToArray(cJSON_CreateString(f->opt().c_str()));
-                    break;
-                default:
-                    unreachable();
-                }
+    if (r.has_backtrace()) {
+        *s += ",\"b\":";
+        const Backtrace *bt = &r.backtrace();
+        scoped_cJSON_t arr(cJSON_CreateArray());
+        for (int i = 0; i < bt->frames_size(); ++i) {
+            const Frame *f = &bt->frames(i);
+            switch (f->type()) {
+            case Frame::POS:
+                arr.AddItemToArray(cJSON_CreateNumber(f->pos()));
+                break;
+            case Frame::OPT:
+                arr.AddItemToArray(cJSON_CreateString(f->opt().c_str()));
+                break;
+            default:
+                unreachable();
             }
-            *s += arr.PrintUnformatted();
         }
+        *s += arr.PrintUnformatted();
+    }
 
-        if (r.has_profile()) {
-            *s += ",\"p\":";
-            const Datum *d = &r.profile();
-            guarantee(d->type() == Datum::R_JSON);
-            *s += d->r_str();
-        }
+    if (r.has_profile()) {
+        *s += ",\"p\":";
+        const Datum *d = &r.profile();
+        guarantee(d->type() == Datum::R_JSON);
+        *s += d->r_str();
+    }
+
+    *s += "}";
+}
 
-        *s += "}";
+void write_json_pb(const Response &r, std::string *s) THROWS_NOTHING {
+    // Note: We must keep any existing prefix in `s` intact.
+#ifdef NDEBUG
+    const size_t start_offset = s->length();
+#endif
+    try {
+        write_json_response(r, s);
     } catch (...) {
 #ifndef NDEBUG
         throw;
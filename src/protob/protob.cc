@@ -12,15 +12,20 @@
 
 #include "arch/arch.hpp"
 #include "arch/io/network.hpp"
+#include "arch/io/tls.hpp"
 #include "clustering/administration/metadata.hpp"
 #include "concurrency/coro_pool.hpp"
+#include "config/args.hpp"
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/queue/limited_fifo.hpp"
+#include "containers/archive/string_stream.hpp"
 #include "containers/auth_key.hpp"
 #include "perfmon/perfmon.hpp"
 #include "protob/json_shim.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
 #include "rpc/semilattice/view.hpp"
+#include "rpc/semilattice/watchable.hpp"
 #include "utils.hpp"
 
 #include "rdb_protocol/ql2.pb.h"
@@ -146,38 +151,116 @@ std::string too_large_response_message(size_t size) {
                      size, TOO_LARGE_RESPONSE_SIZE - 1);
 }
 
+// The JSON and binary protocols read queries the same way.  `protocol_t` decides
+// how to report problems with them.
+template <class protocol_t>
+bool parse_json_query(tcp_conn_t *conn,
+                      signal_t *interruptor,
+                      query_handler_t *handler,
+                      ql::protob_t<Query> *query_out) {
+    int64_t token;
+    uint32_t size;
+    conn->read(&token, sizeof(token), interruptor);
+    conn->read(&size, sizeof(size), interruptor);
+
+    if (size >= TOO_LARGE_QUERY_SIZE) {
+        Response error_response;
+        error_response.set_token(token);
+        ql::fill_error(&error_response, Response::CLIENT_ERROR,
+                       too_large_query_message(size));
+        protocol_t::send_response(error_response, handler, conn, interruptor);
+        throw tcp_conn_read_closed_exc_t();
+    } else {
+        scoped_array_t<char> data(size + 1);
+        conn->read(data.data(), size, interruptor);
+        data[size] = 0; // Null terminate the string, which the json parser requires
+
+        if (!json_shim::parse_json_pb(query_out->get(), token, data.data())) {
+            Response error_response;
+            error_response.set_token(token);
+            ql::fill_error(&error_response, Response::CLIENT_ERROR,
+                           unparseable_query_message);
+            protocol_t::send_response(error_response, handler, conn, interruptor);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sends `str`, which holds space for the token and size followed by the body of
+// `response`, the way the JSON and binary protocols frame responses.
+template <class protocol_t>
+void send_prefixed_response(const Response &response,
+                            std::string *str,
+                            query_handler_t *handler,
+                            tcp_conn_t *conn,
+                            signal_t *interruptor) {
+    const int64_t token = response.token();
+
+    uint32_t data_size; // filled in below
+    const size_t prefix_size = sizeof(token) + sizeof(data_size);
+    guarantee(str->size() >= prefix_size);
+
+    if (str->size() - prefix_size >= TOO_LARGE_RESPONSE_SIZE) {
+        Response error_response;
+        error_response.set_token(response.token());
+        ql::fill_error(&error_response, Response::RUNTIME_ERROR,
+                       too_large_response_message(str->size() - prefix_size));
+        protocol_t::send_response(error_response, handler, conn, interruptor);
+        return;
+    }
+
+    data_size = static_cast<uint32_t>(str->size() - prefix_size);
+
+    // Fill in the prefix.
+    // std::string::operator[] has unspecified complexity, but in practice
+    // it should be fine.
+    for (size_t i = 0; i < sizeof(token); ++i) {
+        (*str)[i] = reinterpret_cast<const char *>(&token)[i];
+    }
+    for (size_t i = 0; i < sizeof(data_size); ++i) {
+        (*str)[i + sizeof(token)] = reinterpret_cast<const char *>(&data_size)[i];
+    }
+
+    conn->write(str->data(), str->size(), interruptor);
+}
+
+const size_t json_response_prefix_size = sizeof(int64_t) + sizeof(uint32_t);
+
 class json_protocol_t {
 public:
     static bool parse_query(tcp_conn_t *conn,
                             signal_t *interruptor,
                             query_handler_t *handler,
                             ql::protob_t<Query> *query_out) {
-        int64_t token;
-        uint32_t size;
-        conn->read(&token, sizeof(token), interruptor);
-        conn->read(&size, sizeof(size), interruptor);
+        return parse_json_query<json_protocol_t>(conn, interruptor, handler, query_out);
+    }
 
-        if (size >= TOO_LARGE_QUERY_SIZE) {
-            Response error_response;
-            error_response.set_token(token);
-            ql::fill_error(&error_response, Response::CLIENT_ERROR,
-                           too_large_query_message(size));
-            send_response(error_response, handler, conn, interruptor);
-            throw tcp_conn_read_closed_exc_t();
-        } else {
-            scoped_array_t<char> data(size + 1);
-            conn->read(data.data(), size, interruptor);
-            data[size] = 0; // Null terminate the string, which the json parser requires
+    static void send_response(const Response &response,
+                              query_handler_t *handler,
+                              tcp_conn_t *conn,
+                              signal_t *interruptor) {
+        // Reserve space for the token and the size
+        std::string str(json_response_prefix_size, '\0');
+        json_shim::write_json_pb(response, &str);
+        send_prefixed_response<json_protocol_t>(response, &str, handler, conn,
+                                                interruptor);
+    }
+};
 
-            if (!json_shim::parse_json_pb(query_out->get(), token, data.data())) {
-                Response error_response;
-                error_response.set_token(token);
-                ql::fill_error(&error_response, Response::CLIENT_ERROR,
-                               unparseable_query_message);
-                send_response(error_response, handler, conn, interruptor);
-                return false;
-            }
+// Like the JSON protocol, but results are sent in the `datum_serialize` encoding
+// instead of as JSON text.  See `VersionDummy::BINARY` in ql2.proto for the format.
+class binary_protocol_t {
+public:
+    static bool parse_query(tcp_conn_t *conn,
+                            signal_t *interruptor,
+                            query_handler_t *handler,
+                            ql::protob_t<Query> *query_out) {
+        if (!parse_json_query<binary_protocol_t>(conn, interruptor, handler,
+                                                 query_out)) {
+            return false;
         }
+        query_out->get()->set_accepts_r_serialized(true);
         return true;
     }
 
@@ -185,38 +268,80 @@ public:
                               query_handler_t *handler,
                               tcp_conn_t *conn,
                               signal_t *interruptor) {
-        const int64_t token = response.token();
-
-        uint32_t data_size; // filled in below
-        const size_t prefix_size = sizeof(token) + sizeof(data_size);
         // Reserve space for the token and the size
-        std::string str(prefix_size, '\0');
+        std::string str(json_response_prefix_size, '\0');
+        write_body(response, &str);
+        send_prefixed_response<binary_protocol_t>(response, &str, handler, conn,
+                                                  interruptor);
+    }
 
-        json_shim::write_json_pb(response, &str);
-        guarantee(str.size() >= prefix_size);
+private:
+    template <class T>
+    static void append(T value, std::string *s) {
+        s->append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
 
-        if (str.size() - prefix_size >= TOO_LARGE_RESPONSE_SIZE) {
-            Response error_response;
-            error_response.set_token(response.token());
-            ql::fill_error(&error_response, Response::RUNTIME_ERROR,
-                           too_large_response_message(str.size() - prefix_size));
-            send_response(error_response, handler, conn, interruptor);
-            return;
-        }
+    static void append_bytes(const std::string &bytes, std::string *s) {
+        append<uint32_t>(bytes.size(), s);
+        s->append(bytes);
+    }
 
-        data_size = static_cast<uint32_t>(str.size() - prefix_size);
+    static void append_datum(const Datum &d, std::string *s) {
+        if (d.type() == Datum::R_SERIALIZED) {
+            append_bytes(d.r_str(), s);
+        } else {
+            // Error messages are filled in as plain strings.
+            guarantee(d.type() == Datum::R_STR);
+            write_message_t wm;
+            ql::datum_serialize(&wm, ql::datum_t(datum_string_t(d.r_str())),
+                                ql::check_datum_serialization_errors_t::NO);
+            string_stream_t stream;
+            int res = send_write_message(&stream, &wm);
+            guarantee(res == 0);
+            append_bytes(stream.str(), s);
+        }
+    }
 
-        // Fill in the prefix.
-        // std::string::operator[] has unspecified complexity, but in practice
-        // it should be fine.
-        for (size_t i = 0; i < sizeof(token); ++i) {
-            str[i] = reinterpret_cast<const char *>(&token)[i];
+    static void write_body(const Response &r, std::string *s) {
+        append<int32_t>(r.type(), s);
+        append<uint32_t>(r.batch_size() + r.response_size(), s);
+        for (int i = 0; i < r.batch_size(); ++i) {
+            std::string body;
+            write_body(r.batch(i), &body);
+            append_bytes(body, s);
+        }
+        for (int i = 0; i < r.response_size(); ++i) {
+            append_datum(r.response(i), s);
         }
-        for (size_t i = 0; i < sizeof(data_size); ++i) {
-            str[i + sizeof(token)] = reinterpret_cast<const char *>(&data_size)[i];
+        append<uint32_t>(r.notes_size(), s);
+        for (int i = 0; i < r.notes_size(); ++i) {
+            append<int32_t>(r.notes(i), s);
         }
 
-        conn->write(str.data(), str.size(), interruptor);
+        append<uint8_t>(r.has_backtrace() ? 1 : 0, s);
+        if (r.has_backtrace()) {
+            const Backtrace *bt = &r.backtrace();
+            append<uint32_t>(bt->frames_size(), s);
+            for (int i = 0; i < bt->frames_size(); ++i) {
+                const Frame *f = &bt->frames(i);
+                append<uint8_t>(f->type(), s);
+                switch (f->type()) {
+                case Frame::POS:
+                    append<int64_t>(f->pos(), s);
+                    break;
+                case Frame::OPT:
+                    append_bytes(f->opt(), s);
+                    break;
+                default:
+                    unreachable();
+                }
+            }
+        }
+
+        append<uint8_t>(r.has_profile() ? 1 : 0, s);
+        if (r.has_profile()) {
+            append_datum(r.profile(), s);
+        }
     }
 };
 
@@ -277,6 +402,18 @@ public:
     }
 };
 
+static size_t max_queries_per_connection = DEFAULT_MAX_QUERIES_PER_CONNECTION;
+static bool listen_on_all_threads = false;
+
+void set_max_queries_per_connection(size_t max_queries) {
+    guarantee(max_queries > 0);
+    max_queries_per_connection = max_queries;
+}
+
+void set_listen_on_all_threads(bool listen) {
+    listen_on_all_threads = listen;
+}
+
 query_server_t::query_server_t(rdb_context_t *_rdb_ctx,
                                const std::set<ip_address_t> &local_addresses,
                                int port,
@@ -284,13 +421,26 @@ query_server_t::query_server_t(rdb_context_t *_rdb_ctx,
                                uint32_t http_timeout_sec) :
         rdb_ctx(_rdb_ctx),
         handler(_handler),
-        http_conn_cache(http_timeout_sec),
-        next_thread(0) {
+        thread_loads(get_num_db_threads()),
+        next_thread(0),
+        http_conn_cache(http_timeout_sec) {
     rassert(rdb_ctx != NULL);
     try {
-        tcp_listener.init(new tcp_listener_t(local_addresses, port,
-            std::bind(&query_server_t::handle_conn,
-                      this, ph::_1, auto_drainer_t::lock_t(&drainer))));
+        if (listen_on_all_threads) {
+            per_thread_auth_metadata.init(
+                new all_thread_watchable_variable_t<auth_semilattice_metadata_t>(
+                    clone_ptr_t<watchable_t<auth_semilattice_metadata_t> >(
+                        new semilattice_watchable_t<auth_semilattice_metadata_t>(
+                            rdb_ctx->auth_metadata))));
+            per_thread_listener.init(new per_thread_tcp_listener_t(
+                local_addresses, port, get_num_db_threads(),
+                std::bind(&query_server_t::handle_conn_on_accepting_thread,
+                          this, ph::_1)));
+        } else {
+            tcp_listener.init(new tcp_listener_t(local_addresses, port,
+                std::bind(&query_server_t::handle_conn,
+                          this, ph::_1, auto_drainer_t::lock_t(&drainer))));
+        }
     } catch (const address_in_use_exc_t &ex) {
         throw address_in_use_exc_t(
             strprintf("Could not bind to RDB protocol port: %s", ex.what()));
@@ -300,7 +450,9 @@ query_server_t::query_server_t(rdb_context_t *_rdb_ctx,
 query_server_t::~query_server_t() { }
 
 int query_server_t::get_port() const {
-    return tcp_listener->get_port();
+    return per_thread_listener.has()
+        ? per_thread_listener->get_port()
+        : tcp_listener->get_port();
 }
 
 std::string query_server_t::read_sized_string(tcp_conn_t *conn,
@@ -335,16 +487,122 @@ auth_key_t query_server_t::read_auth_key(tcp_conn_t *conn,
     return ret;
 }
 
+/* Counts something towards a thread's load for as long as it exists. */
+class thread_load_counter_t {
+public:
+    explicit thread_load_counter_t(intptr_t *_count) : count(_count) {
+        __sync_add_and_fetch(count, 1);
+    }
+    ~thread_load_counter_t() {
+        __sync_sub_and_fetch(count, 1);
+    }
+    void move_to(intptr_t *other) {
+        __sync_add_and_fetch(other, 1);
+        __sync_sub_and_fetch(count, 1);
+        count = other;
+    }
+private:
+    intptr_t *count;
+    DISABLE_COPYING(thread_load_counter_t);
+};
+
+// A client connection's query cache, made when the connection runs its first query.
+// Many connections sit idle for most of their life, and they shouldn't pay for a
+// cache (and its entry in the jobs table's per-thread registry) before then.
+class lazy_query_cache_t {
+public:
+    lazy_query_cache_t(rdb_context_t *_rdb_ctx,
+                       const ip_and_port_t &_client_addr_port,
+                       ql::return_empty_normal_batches_t _return_empty_normal_batches)
+        : rdb_ctx(_rdb_ctx),
+          client_addr_port(_client_addr_port),
+          return_empty_normal_batches(_return_empty_normal_batches) { }
+
+    ql::query_cache_t *get() {
+        if (!cache.has()) {
+            cache.init(new ql::query_cache_t(rdb_ctx, client_addr_port,
+                                             return_empty_normal_batches));
+        }
+        return cache.get();
+    }
+
+    // The thread that the connection's tables' primary replicas run on, if it has
+    // nothing running and no cursors open, so that it can move there.
+    threadnum_t preferred_thread() const {
+        if (!cache.has() || !cache->empty()) {
+            return INVALID_THREAD;
+        }
+        return cache->get_table_affinity()->get_preferred_thread();
+    }
+
+    // Must be called before the connection moves to another thread.
+    void reset() {
+        cache.reset();
+    }
+
+private:
+    rdb_context_t *const rdb_ctx;
+    const ip_and_port_t client_addr_port;
+    const ql::return_empty_normal_batches_t return_empty_normal_batches;
+    scoped_ptr_t<ql::query_cache_t> cache;
+
+    DISABLE_COPYING(lazy_query_cache_t);
+};
+
+threadnum_t query_server_t::choose_thread() {
+    // Connections stay on their thread, and so do the queries they run.  So we
+    // keep new connections away from threads that are busy running queries (for
+    // example for a few heavy analytics clients), and otherwise spread them out.
+    // Ties go round-robin.
+    const int num_threads = thread_loads.size();
+    int best_thread = next_thread;
+    intptr_t best_queries = 0;
+    intptr_t best_connections = 0;
+    for (int i = 0; i < num_threads; ++i) {
+        const int thread = (next_thread + i) % num_threads;
+        const thread_load_t *load = &thread_loads[thread].value;
+        const intptr_t queries =
+            __atomic_load_n(&load->running_queries, __ATOMIC_RELAXED);
+        const intptr_t connections =
+            __atomic_load_n(&load->connections, __ATOMIC_RELAXED);
+        if (i == 0
+            || queries < best_queries
+            || (queries == best_queries && connections < best_connections)) {
+            best_thread = thread;
+            best_queries = queries;
+            best_connections = connections;
+        }
+    }
+    next_thread = (best_thread + 1) % num_threads;
+    return threadnum_t(best_thread);
+}
+
 void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
                                  auto_drainer_t::lock_t keepalive) {
     // This must be read here because of home threads and stuff
     auth_key_t auth_key = rdb_ctx->auth_metadata->get().auth_key.get_ref();
 
-    threadnum_t chosen_thread = threadnum_t(next_thread);
-    next_thread = (next_thread + 1) % get_num_db_threads();
+    threadnum_t chosen_thread = choose_thread();
 
     cross_thread_signal_t ct_keepalive(keepalive.get_drain_signal(), chosen_thread);
     on_thread_t rethreader(chosen_thread);
+    serve_conn(nconn, auth_key, &ct_keepalive);
+}
+
+void query_server_t::handle_conn_on_accepting_thread(
+        const scoped_ptr_t<tcp_conn_descriptor_t> &nconn) {
+    // The listener is destroyed before `thread_drainers`, so this can't be draining.
+    auto_drainer_t::lock_t keepalive(thread_drainers.get());
+    auth_key_t auth_key =
+        per_thread_auth_metadata->get_watchable()->get().auth_key.get_ref();
+    serve_conn(nconn, auth_key, keepalive.get_drain_signal());
+}
+
+void query_server_t::serve_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
+                                const auth_key_t &auth_key,
+                                signal_t *interruptor) {
+    thread_load_counter_t connection_load(
+        &thread_loads[get_thread_id().threadnum].value.connections);
 
     scoped_ptr_t<tcp_conn_t> conn;
     nconn->make_overcomplicated(&conn);
@@ -356,8 +614,12 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
     std::string init_error;
 
     try {
+        if (tls_ctx_t *tls_ctx = get_tls_ctx(tls_service_t::DRIVER, tls_role_t::SERVER)) {
+            conn->enable_tls(tls_ctx, interruptor);
+        }
+
         int32_t client_magic_number;
-        conn->read(&client_magic_number, sizeof(client_magic_number), &ct_keepalive);
+        conn->read(&client_magic_number, sizeof(client_magic_number), interruptor);
 
         bool pre_2 = client_magic_number == VersionDummy::V0_1;
         bool pre_3 = pre_2 || client_magic_number == VersionDummy::V0_2;
@@ -371,7 +633,7 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
                     "Authorization required but client does not support it.");
             }
         } else if (legal) {
-            auth_key_t provided_auth = read_auth_key(conn.get(), &ct_keepalive);
+            auth_key_t provided_auth = read_auth_key(conn.get(), interruptor);
             if (!timing_sensitive_equals(provided_auth, auth_key)) {
                 throw protob_server_exc_t("Incorrect authorization key.");
             }
@@ -381,27 +643,31 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
                                       "client driver version not match the server?");
         }
 
-        size_t max_concurrent_queries = pre_4 ? 1 : 1024;
+        size_t max_concurrent_queries = pre_4 ? 1 : max_queries_per_connection;
 
         // With version 0_3, the client driver specifies which protocol to use
         int32_t wire_protocol = VersionDummy::PROTOBUF;
         if (!pre_3) {
-            conn->read(&wire_protocol, sizeof(wire_protocol), &ct_keepalive);
+            conn->read(&wire_protocol, sizeof(wire_protocol), interruptor);
         }
 
-        ql::query_cache_t query_cache(rdb_ctx, client_addr_port,
-                                      pre_4 ? ql::return_empty_normal_batches_t::YES :
-                                              ql::return_empty_normal_batches_t::NO);
+        lazy_query_cache_t query_cache(rdb_ctx, client_addr_port,
+                                       pre_4 ? ql::return_empty_normal_batches_t::YES :
+                                               ql::return_empty_normal_batches_t::NO);
 
         const char *success_msg = "SUCCESS";
-        conn->write(success_msg, strlen(success_msg) + 1, &ct_keepalive);
+        conn->write(success_msg, strlen(success_msg) + 1, interruptor);
 
         if (wire_protocol == VersionDummy::JSON) {
-            connection_loop<json_protocol_t>(
-                conn.get(), max_concurrent_queries, &query_cache, &ct_keepalive);
+            serve_queries<json_protocol_t>(conn.get(), max_concurrent_queries,
+                                           &query_cache, &connection_load, interruptor);
+        } else if (wire_protocol == VersionDummy::BINARY) {
+            serve_queries<binary_protocol_t>(conn.get(), max_concurrent_queries,
+                                             &query_cache, &connection_load, interruptor);
         } else if (wire_protocol == VersionDummy::PROTOBUF) {
-            connection_loop<protobuf_protocol_t>(
-                conn.get(), max_concurrent_queries, &query_cache, &ct_keepalive);
+            serve_queries<protobuf_protocol_t>(conn.get(), max_concurrent_queries,
+                                               &query_cache, &connection_load,
+                                               interruptor);
         } else {
             throw protob_server_exc_t(strprintf("Unrecognized protocol specified: '%d'",
                                                 wire_protocol));
@@ -412,6 +678,7 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
     } catch (const interrupted_exc_t &ex) {
         // If we have been interrupted, we can't write a message to the client, as that
         // may block (and we would just be interrupted again anyway), just close.
+    } catch (const tcp_conn_t::tls_failed_exc_t &) {
     } catch (const tcp_conn_read_closed_exc_t &) {
     } catch (const tcp_conn_write_closed_exc_t &) {
     } catch (const std::exception &ex) {
@@ -420,7 +687,7 @@ void query_server_t::handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &ncon
 
     if (!init_error.empty()) {
         try {
-            conn->write(init_error.c_str(), init_error.length() + 1, &ct_keepalive);
+            conn->write(init_error.c_str(), init_error.length() + 1, interruptor);
             conn->shutdown_write();
         } catch (const tcp_conn_write_closed_exc_t &) {
             // Do nothing
@@ -450,6 +717,47 @@ void query_server_t::make_error_response(bool is_draining,
     }
 }
 
+template <class protocol_t>
+void query_server_t::serve_queries(tcp_conn_t *conn,
+                                   size_t max_concurrent_queries,
+                                   lazy_query_cache_t *query_cache,
+                                   thread_load_counter_t *connection_load,
+                                   signal_t *interruptor) {
+    ql::protob_t<Query> next_query;
+    const threadnum_t thread = connection_loop<protocol_t>(
+        conn, max_concurrent_queries, query_cache, interruptor, &next_query);
+    if (thread == INVALID_THREAD) {
+        return;
+    }
+
+    // The connection's queries all go to primary replicas on `thread`, so we serve it
+    // from there from now on.  It's idle and has no cursors open, so the only thing
+    // that has to come along is the query we already read.
+    const threadnum_t home_thread = get_thread_id();
+    query_cache->reset();
+    connection_load->move_to(&thread_loads[thread.threadnum].value.connections);
+    std::exception_ptr exc;
+    conn->rethread(INVALID_THREAD);
+    {
+        cross_thread_signal_t ct_interruptor(interruptor, thread);
+        on_thread_t thread_switcher(thread);
+        conn->rethread(thread);
+        // We must not switch threads while an exception is in flight.
+        try {
+            connection_loop<protocol_t>(conn, max_concurrent_queries, query_cache,
+                                        &ct_interruptor, &next_query);
+        } catch (...) {
+            exc = std::current_exception();
+        }
+        query_cache->reset();
+        conn->rethread(INVALID_THREAD);
+    }
+    conn->rethread(home_thread);
+    if (exc) {
+        std::rethrow_exception(exc);
+    }
+}
+
 template <class Callable>
 void save_exception(std::exception_ptr *err,
                     std::string *err_str,
@@ -467,10 +775,11 @@ void save_exception(std::exception_ptr *err,
 }
 
 template <class protocol_t>
-void query_server_t::connection_loop(tcp_conn_t *conn,
-                                     size_t max_concurrent_queries,
-                                     ql::query_cache_t *query_cache,
-                                     signal_t *drain_signal) {
+threadnum_t query_server_t::connection_loop(tcp_conn_t *conn,
+                                            size_t max_concurrent_queries,
+                                            lazy_query_cache_t *query_cache,
+                                            signal_t *drain_signal,
+                                            ql::protob_t<Query> *next_query) {
     std::exception_ptr err;
     std::string err_str;
     cond_t abort;
@@ -500,6 +809,8 @@ void query_server_t::connection_loop(tcp_conn_t *conn,
     // necessary for proper NOREPLY_WAIT semantics.
     typedef std::list<std::pair<ql::query_id_t, ql::protob_t<Query> > >
         nascent_query_list_t;
+    // How many of this connection's queries are running.
+    intptr_t running_queries = 0;
     nascent_query_list_t query_list;
 
     std_function_callback_t<nascent_query_list_t::iterator> callback(
@@ -509,13 +820,16 @@ void query_server_t::connection_loop(tcp_conn_t *conn,
             ql::query_id_t query_id(std::move(query_it->first));
             ql::protob_t<Query> query_pb(std::move(query_it->second));
             query_list.erase(query_it);
+            thread_load_counter_t query_load(
+                &thread_loads[get_thread_id().threadnum].value.running_queries);
+            thread_load_counter_t connection_load(&running_queries);
             wait_any_t cb_interruptor(pool_interruptor, &interruptor);
             Response response;
             bool replied = false;
 
             save_exception(&err, &err_str, &abort, [&]() {
                     handler->run_query(std::move(query_id), query_pb, &response,
-                                       query_cache, &cb_interruptor);
+                                       query_cache->get(), &cb_interruptor);
                     if (!ql::is_noreply(query_pb)) {
                         response.set_token(query_pb->token());
                         new_mutex_acq_t send_lock(&send_mutex, &cb_interruptor);
@@ -536,6 +850,9 @@ void query_server_t::connection_loop(tcp_conn_t *conn,
             }
         });
 
+    // Connections only move once, so that they can't bounce between threads.
+    const bool may_move = !next_query->has();
+    threadnum_t move_to = INVALID_THREAD;
     {
         // Pick a small limit so queries back up on the TCP connection.
         limited_fifo_queue_t<nascent_query_list_t::iterator> coro_queue(4);
@@ -543,12 +860,34 @@ void query_server_t::connection_loop(tcp_conn_t *conn,
                                                               &coro_queue,
                                                               &callback);
 
-        while (!err) {
+        if (!may_move) {
+            query_list.push_front(
+                std::make_pair(ql::query_id_t(query_cache->get()),
+                               std::move(*next_query)));
+            coro_queue.push(query_list.begin());
+        }
+
+        while (!err && move_to == INVALID_THREAD) {
             ql::protob_t<Query> query(ql::make_counted_query());
             save_exception(&err, &err_str, &abort, [&]() {
+                    scoped_ptr_t<trim_stack_while_waiting_t> trim_stack;
+                    if (running_queries == 0) {
+                        // The connection is idle, and may stay that way for a long
+                        // time.
+                        trim_stack.init(new trim_stack_while_waiting_t);
+                    }
                     if (protocol_t::parse_query(conn, &interruptor, handler, &query)) {
-                        query_list.push_front(std::make_pair(ql::query_id_t(query_cache),
-                                                             std::move(query)));
+                        if (may_move && running_queries == 0 && query_list.empty()) {
+                            threadnum_t thread = query_cache->preferred_thread();
+                            if (!(thread == INVALID_THREAD || thread == get_thread_id())) {
+                                *next_query = std::move(query);
+                                move_to = thread;
+                                return;
+                            }
+                        }
+                        query_list.push_front(
+                            std::make_pair(ql::query_id_t(query_cache->get()),
+                                           std::move(query)));
                         coro_queue.push(query_list.begin());
                     }
                 });
@@ -575,6 +914,7 @@ void query_server_t::connection_loop(tcp_conn_t *conn,
     if (err) {
         std::rethrow_exception(err);
     }
+    return move_to;
 }
 
 void query_server_t::handle(const http_req_t &req,
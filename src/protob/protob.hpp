@@ -15,7 +15,10 @@
 #include "arch/runtime/runtime.hpp"
 #include "arch/timing.hpp"
 #include "concurrency/auto_drainer.hpp"
+#include "concurrency/cache_line_padded.hpp"
 #include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/cross_thread_watchable.hpp"
+#include "concurrency/one_per_thread.hpp"
 #include "containers/archive/archive.hpp"
 #include "containers/counted.hpp"
 #include "http/http.hpp"
@@ -85,6 +88,9 @@ public:
                            signal_t *interruptor) = 0;
 };
 
+class lazy_query_cache_t;
+class thread_load_counter_t;
+
 class query_server_t : public http_app_t {
 public:
     query_server_t(
@@ -109,16 +115,41 @@ private:
                              const std::string &err,
                              Response *response_out);
 
+    // Picks the thread for a new client connection.
+    threadnum_t choose_thread();
+
     // For the client driver socket
     void handle_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
                      auto_drainer_t::lock_t);
-
-    // This is templatized based on the wire protocol requested by the client
+    // Like `handle_conn()`, for connections from `per_thread_listener`. They stay on
+    // the thread that accepted them.
+    void handle_conn_on_accepting_thread(
+        const scoped_ptr_t<tcp_conn_descriptor_t> &nconn);
+    // Serves a client connection on the current thread.
+    void serve_conn(const scoped_ptr_t<tcp_conn_descriptor_t> &nconn,
+                    const auth_key_t &auth_key,
+                    signal_t *interruptor);
+
+    // Runs the connection's queries, and moves it to the thread that its tables'
+    // primary replicas run on if they all run on the same one.
     template<class protocol_t>
-    void connection_loop(tcp_conn_t *conn,
-                         size_t max_concurrent_queries,
-                         ql::query_cache_t *query_cache,
-                         signal_t *interruptor);
+    void serve_queries(tcp_conn_t *conn,
+                       size_t max_concurrent_queries,
+                       lazy_query_cache_t *query_cache,
+                       thread_load_counter_t *connection_load,
+                       signal_t *interruptor);
+
+    // This is templatized based on the wire protocol requested by the client.  If
+    // `next_query` is empty, this returns the thread the connection should move to
+    // (or `INVALID_THREAD` once it's closed) and leaves the query it last read in
+    // `next_query`.  Otherwise the connection has just moved here, and this runs
+    // `next_query` first and stays on this thread.
+    template<class protocol_t>
+    threadnum_t connection_loop(tcp_conn_t *conn,
+                                size_t max_concurrent_queries,
+                                lazy_query_cache_t *query_cache,
+                                signal_t *interruptor,
+                                ql::protob_t<Query> *next_query);
 
     // For HTTP server
     void handle(const http_req_t &request,
@@ -128,12 +159,42 @@ private:
     rdb_context_t *const rdb_ctx;
     query_handler_t *const handler;
 
+    /* How many client connections and running queries each thread has.  Only a
+    thread's own connections change its counts, but `choose_thread` reads them from
+    the listener's thread, so they're accessed atomically.  Connections update them
+    until they're drained, so these must outlive the drainers below. */
+    struct thread_load_t {
+        thread_load_t() : connections(0), running_queries(0) { }
+        intptr_t connections;
+        intptr_t running_queries;
+    };
+    std::vector<cache_line_padded_t<thread_load_t> > thread_loads;
+
+    int next_thread;
+
     /* WARNING: The order here is fragile. */
     auto_drainer_t drainer;
     http_conn_cache_t http_conn_cache;
     scoped_ptr_t<tcp_listener_t> tcp_listener;
 
-    int next_thread;
+    /* Used instead of `tcp_listener` with `--listen-on-all-threads`. Connections are
+    served on the thread that accepted them, so they hold a lock on that thread's
+    drainer and read the auth key from that thread's copy of it. */
+    scoped_ptr_t<all_thread_watchable_variable_t<auth_semilattice_metadata_t> >
+        per_thread_auth_metadata;
+    one_per_thread_t<auto_drainer_t> thread_drainers;
+    scoped_ptr_t<per_thread_tcp_listener_t> per_thread_listener;
 };
 
+// Sets how many queries one client connection may run at once (clients older than
+// V0_4 run them one at a time regardless).  Must be called before the thread pool
+// starts, if at all.
+void set_max_queries_per_connection(size_t max_queries);
+
+// Makes query servers accept client connections on every thread through
+// `SO_REUSEPORT` sockets, and serve them on the thread that accepted them, instead
+// of accepting them on one thread and placing them on the least loaded one.  Must
+// be called before the query server is created, if at all.
+void set_listen_on_all_threads(bool listen);
+
 #endif /* PROTOB_PROTOB_HPP_ */
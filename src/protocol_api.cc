@@ -1 +1,11 @@
 #include "protocol_api.hpp"
+
+void merge_write_versions(const write_versions_t &versions,
+                          write_versions_t *versions_inout) {
+    for (const auto &pair : versions) {
+        auto res = versions_inout->insert(pair);
+        if (!res.second && res.first->second < pair.second) {
+            res.first->second = pair.second;
+        }
+    }
+}
@@ -3,6 +3,7 @@
 #define PROTOCOL_API_HPP_
 
 #include <algorithm>
+#include <map>
 #include <set>
 #include <string>
 #include <utility>
@@ -17,6 +18,7 @@
 #include "containers/binary_blob.hpp"
 #include "containers/scoped.hpp"
 #include "containers/object_buffer.hpp"
+#include "containers/uuid.hpp"
 #include "region/region.hpp"
 #include "region/region_map.hpp"
 #include "rpc/serialize_macros.hpp"
@@ -43,6 +45,17 @@ private:
     std::string message;
 };
 
+/* A `write_versions_t` holds the timestamp that some writes got on the branch of each
+shard that they touched.  ReQL hands it to clients as a write token: reads that are
+given the token only go to replicas that have applied those writes, so a client that
+passes the token of its last write to its reads sees its own writes even when reading
+from secondary replicas. */
+typedef std::map<branch_id_t, state_timestamp_t> write_versions_t;
+
+// Keeps the later timestamp for branches that are in both.
+void merge_write_versions(const write_versions_t &versions,
+                          write_versions_t *versions_inout);
+
 enum class table_readiness_t {
     unavailable,
     outdated_reads,
@@ -65,6 +78,16 @@ public:
                                read_response_t *response,
                                signal_t *interruptor)
         THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) = 0;
+    /* Like `read_outdated()`, but the result reflects the writes in `versions`.  Only
+    interfaces that know which replicas have applied a write can do better than an
+    up-to-date read. */
+    virtual void read_after(const read_t &r,
+                            const write_versions_t &,
+                            read_response_t *response,
+                            signal_t *interruptor)
+        THROWS_ONLY(interrupted_exc_t, cannot_perform_query_exc_t) {
+        read(r, response, order_token_t::ignore, interruptor);
+    }
     virtual void write(const write_t &,
                        write_response_t *response,
                        order_token_t tok,
@@ -76,6 +99,10 @@ public:
     virtual std::set<region_t> get_sharding_scheme()
         THROWS_ONLY(cannot_perform_query_exc_t) = 0;
 
+    /* Returns the thread that the primary replicas for every shard run on, if they
+    all run on the same thread of this server, and `INVALID_THREAD` otherwise. */
+    virtual threadnum_t get_local_primary_thread() { return INVALID_THREAD; }
+
     virtual signal_t *get_initial_ready_signal() { return NULL; }
 
     virtual bool check_readiness(table_readiness_t readiness,
@@ -55,6 +55,12 @@ ql::datum_t artificial_table_t::read_row(ql::env_t *env,
     return row;
 }
 
+bool artificial_table_t::read_rows(UNUSED ql::env_t *env,
+        UNUSED const std::vector<ql::datum_t> &pvals, UNUSED bool use_outdated,
+        UNUSED std::vector<ql::datum_t> *rows_out) {
+    return false;
+}
+
 counted_t<ql::datum_stream_t> artificial_table_t::read_all(
         ql::env_t *env,
         const std::string &get_all_sindex_id,
@@ -82,9 +88,14 @@ counted_t<ql::datum_stream_t> artificial_table_t::read_changes(
         ql::env_t *env,
         const ql::datum_t &,
         bool include_states,
+        const ql::changefeed::resume_t &resume,
         ql::changefeed::keyspec_t::spec_t &&spec,
         const ql::protob_t<const Backtrace> &bt,
-        UNUSED const std::string &table_name) {
+        const std::string &table_name) {
+    // System tables don't keep a change log.
+    rcheck_datum(!resume.resumable, ql::base_exc_t::GENERIC,
+                 strprintf("Changefeeds on system table `%s` can't be resumed.",
+                           table_name.c_str()));
     counted_t<ql::datum_stream_t> stream;
     std::string error;
     if (!backend->read_changes(
@@ -125,6 +136,15 @@ ql::datum_t artificial_table_t::read_nearest(
         error_message_index_not_found(sindex, table_name).c_str());
 }
 
+bool artificial_table_t::read_sample(
+        UNUSED ql::env_t *env,
+        UNUSED uint64_t num,
+        UNUSED bool use_outdated,
+        UNUSED std::vector<ql::datum_t> *rows_out) {
+    /* System tables are small, so they are sampled from `read_all()`. */
+    return false;
+}
+
 ql::datum_t artificial_table_t::write_batched_replace(
         ql::env_t *env,
         const std::vector<ql::datum_t> &keys,
@@ -206,10 +226,19 @@ bool artificial_table_t::write_sync_depending_on_durability(
         "Artificial tables don't support `sync()`.");
 }
 
+void artificial_table_t::set_read_after(UNUSED const write_versions_t &versions) {
+    /* Reads of artificial tables always see the latest writes, so there's nothing to
+    wait for. */
+}
+
+write_versions_t artificial_table_t::get_write_versions() const {
+    return write_versions_t();
+}
+
 bool artificial_table_t::sindex_create(
         UNUSED ql::env_t *env, UNUSED const std::string &id,
         UNUSED counted_t<const ql::func_t> index_func, UNUSED sindex_multi_bool_t multi,
-        UNUSED sindex_geo_bool_t geo) {
+        UNUSED sindex_geo_bool_t geo, UNUSED sindex_values_bool_t values) {
     rfail_datum(ql::base_exc_t::GENERIC,
         "Can't create a secondary index on an artificial table.");
 }
@@ -25,6 +25,12 @@ static const int64_t SCALE_CONSTANT = 0;
 #else
 static const int64_t SCALE_CONSTANT = 32;
 #endif // NDEBUG
+// The largest factor `batch_scaler_t` grows batches by.  With the defaults above this
+// means batches of at most 16 MB or 8 seconds.
+static const int64_t MAX_ADAPTIVE_SCALE = 16;
+// A client that takes more than this many times as long as our read to ask for the
+// next batch is considered slow.
+static const int64_t SLOW_CLIENT_FACTOR = 4;
 
 batchspec_t::batchspec_t(
     batch_type_t _batch_type,
@@ -194,6 +200,21 @@ batchspec_t batchspec_t::scale_down(int64_t divisor) const {
                        first_scaledown_factor, max_dur, start_time);
 }
 
+static int64_t saturating_mul(int64_t x, int64_t factor) {
+    return x > std::numeric_limits<int64_t>::max() / factor
+        ? std::numeric_limits<int64_t>::max()
+        : x * factor;
+}
+
+batchspec_t batchspec_t::scale_up(int64_t factor) const {
+    r_sanity_check(factor >= 1);
+    return batchspec_t(batch_type, min_els, max_els,
+                       saturating_mul(max_size, factor),
+                       first_scaledown_factor,
+                       saturating_mul(max_dur, factor),
+                       start_time);
+}
+
 batcher_t batchspec_t::to_batcher() const {
     int64_t real_min_els =
         batch_type != batch_type_t::NORMAL_FIRST
@@ -292,6 +313,32 @@ bool batcher_t::should_send_batch(ignore_latency_t ignore_latency) const {
             && (current_microtime() >= end_time && seen_one_el));
 }
 
+batch_scaler_t::batch_scaler_t()
+    : factor(1), request_time(0), last_read_duration(0), last_sent_time(0) { }
+
+bool batch_scaler_t::is_enabled(env_t *env) {
+    datum_t d;
+    return set_if_present("adaptive_batching", env, &d) && d.as_bool();
+}
+
+batchspec_t batch_scaler_t::on_request(const batchspec_t &batchspec) {
+    request_time = current_microtime();
+    if (last_sent_time != 0 && batchspec.get_batch_type() == batch_type_t::NORMAL) {
+        microtime_t client_duration = request_time - last_sent_time;
+        if (client_duration <= last_read_duration) {
+            factor = std::min(factor * 2, MAX_ADAPTIVE_SCALE);
+        } else if (client_duration > SLOW_CLIENT_FACTOR * last_read_duration) {
+            factor = std::max<int64_t>(factor / 2, 1);
+        }
+    }
+    return factor == 1 ? batchspec : batchspec.scale_up(factor);
+}
+
+void batch_scaler_t::on_batch_read() {
+    last_sent_time = current_microtime();
+    last_read_duration = last_sent_time - request_time;
+}
+
 batcher_t::batcher_t(
     batch_type_t _batch_type,
     int64_t min_els,
@@ -84,6 +84,9 @@ public:
     batchspec_t with_max_dur(int64_t new_max_dur) const;
     batchspec_t with_at_most(uint64_t max_els) const;
     batchspec_t scale_down(int64_t divisor) const;
+    // Multiplies the size and duration caps (but not a user-provided row cap) by
+    // `factor`, saturating instead of overflowing.
+    batchspec_t scale_up(int64_t factor) const;
     batcher_t to_batcher() const;
 
 private:
@@ -105,6 +108,33 @@ private:
 };
 RDB_DECLARE_SERIALIZABLE(batchspec_t);
 
+// Grows the batches of a long-running cursor when the client keeps up with them.
+// The first batch is never scaled, so small queries keep their latency.  After
+// each batch, the time the client took to ask for the next one is compared with
+// the time it took us to read it: a client that comes back faster than we can
+// read is bound by round-trips and gets batches twice as large, and a client
+// that is much slower than our reads gets them halved again.  Enabled by the
+// `adaptive_batching` global optarg.
+class batch_scaler_t {
+public:
+    batch_scaler_t();
+    static bool is_enabled(env_t *env);
+
+    // Called when the client asks for a batch; returns the spec to read it with.
+    batchspec_t on_request(const batchspec_t &batchspec);
+    // Called once the batch has been read and is about to be sent.
+    void on_batch_read();
+
+    int64_t get_factor() const { return factor; }
+
+private:
+    int64_t factor;
+    microtime_t request_time;
+    microtime_t last_read_duration;
+    // When the previous batch was sent, or 0 before the first one.
+    microtime_t last_sent_time;
+};
+
 } // namespace ql
 
 #endif // RDB_PROTOCOL_BATCHING_HPP_
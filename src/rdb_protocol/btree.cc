@@ -1,8 +1,13 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/btree.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <deque>
 #include <functional>
 #include <iterator>
+#include <map>
+#include <numeric>
 #include <set>
 #include <string>
 #include <vector>
@@ -12,14 +17,23 @@
 
 #include "btree/backfill.hpp"
 #include "btree/concurrent_traversal.hpp"
+#include "btree/depth_first_traversal.hpp"
 #include "btree/get_distribution.hpp"
+#include "btree/internal_node.hpp"
+#include "btree/leaf_node.hpp"
+#include "btree/node.hpp"
 #include "btree/operations.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "btree/reql_specific.hpp"
 #include "btree/superblock.hpp"
 #include "buffer_cache/serialize_onto_blob.hpp"
 #include "concurrency/coro_pool.hpp"
+#include "concurrency/cross_thread_signal.hpp"
+#include "concurrency/fifo_enforcer.hpp"
+#include "concurrency/new_semaphore.hpp"
+#include "concurrency/pmap.hpp"
 #include "concurrency/queue/unlimited_fifo.hpp"
+#include "config/args.hpp"
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/buffer_group_stream.hpp"
 #include "containers/archive/buffer_stream.hpp"
@@ -34,6 +48,7 @@
 #include "rdb_protocol/serialize_datum_onto_blob.hpp"
 #include "rdb_protocol/shards.hpp"
 #include "rdb_protocol/table_common.hpp"
+#include "thread_local.hpp"
 
 #include "debug.hpp"
 
@@ -92,6 +107,13 @@ void detach_rdb_value(buf_parent_t parent, const void *value) {
 void rdb_get(const store_key_t &store_key, btree_slice_t *slice,
              superblock_t *superblock, point_read_response_t *response,
              profile::trace_t *trace) {
+    if (!slice->key_filter.may_contain(store_key.btree_key())) {
+        slice->stats.record_keys_read(1);
+        superblock->release();
+        response->data = ql::datum_t::null();
+        return;
+    }
+
     keyvalue_location_t kv_location;
     rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
     find_keyvalue_location_for_read(&sizer, superblock,
@@ -106,6 +128,72 @@ void rdb_get(const store_key_t &store_key, btree_slice_t *slice,
     }
 }
 
+void rdb_get_multi(const std::vector<store_key_t> &keys, btree_slice_t *slice,
+                   superblock_t *superblock, multi_point_read_response_t *response,
+                   profile::trace_t *trace) {
+    slice->stats.record_keys_read(keys.size());
+    profile::starter_t starter("Look up a batch of keys.", trace);
+
+    const block_id_t root_id = superblock->get_root_block_id();
+    if (root_id == NULL_BLOCK_ID) {
+        superblock->release();
+        return;
+    }
+
+    // Every descent ends at the leaf that is responsible for `*key`.  Since the keys
+    // are sorted, that leaf is also responsible for all the keys up to its last one,
+    // which we look up in it before descending again.
+    auto key = keys.begin();
+    while (key != keys.end()) {
+        // Keys that the filter rules out don't need a descent of their own.  (When
+        // they fall into a leaf that we've gone down to anyway, we look there.)
+        if (!slice->key_filter.may_contain(key->btree_key())) {
+            ++key;
+            continue;
+        }
+        buf_lock_t buf(superblock->expose_buf(), root_id, access_t::read);
+        for (;;) {
+            block_id_t child_id;
+            {
+                buf_read_t read(&buf);
+                const node_t *node = static_cast<const node_t *>(read.get_data_read());
+                if (node::is_leaf(node)) {
+                    break;
+                }
+                child_id = internal_node::lookup(
+                    reinterpret_cast<const internal_node_t *>(node), key->btree_key());
+            }
+            buf_lock_t child(&buf, child_id, access_t::read);
+            buf = std::move(child);
+        }
+
+        buf_read_t read(&buf);
+        const leaf_node_t *leaf =
+            static_cast<const leaf_node_t *>(read.get_data_read());
+        if (leaf::begin(*leaf) == leaf::end(*leaf)) {
+            ++key;
+            continue;
+        }
+        const btree_key_t *last_key = (*leaf::rbegin(*leaf)).first;
+        auto it = leaf::inclusive_lower_bound(key->btree_key(), *leaf);
+        do {
+            while (it != leaf::end(*leaf)
+                   && btree_key_cmp((*it).first, key->btree_key()) < 0) {
+                ++it;
+            }
+            if (it != leaf::end(*leaf)
+                && btree_key_cmp((*it).first, key->btree_key()) == 0) {
+                response->rows.push_back(std::make_pair(
+                    *key,
+                    get_data(static_cast<const rdb_value_t *>((*it).second),
+                             buf_parent_t(&buf))));
+            }
+            ++key;
+        } while (key != keys.end() && btree_key_cmp(key->btree_key(), last_key) <= 0);
+    }
+    superblock->release();
+}
+
 void kv_location_delete(keyvalue_location_t *kv_location,
                         const store_key_t &key,
                         repli_timestamp_t timestamp,
@@ -209,106 +297,95 @@ kv_location_set(keyvalue_location_t *kv_location,
     return ql::serialization_result_t::SUCCESS;
 }
 
-batched_replace_response_t rdb_replace_and_return_superblock(
-    const btree_loc_info_t &info,
+// Replaces the row for `key`, which `kv_location` must point at.
+batched_replace_response_t rdb_replace_at_location(
+    const btree_info_t *btree,
+    const store_key_t &key,
+    keyvalue_location_t *kv_location,
     const btree_point_replacer_t *replacer,
     const deletion_context_t *deletion_context,
-    promise_t<superblock_t *> *superblock_promise,
-    rdb_modification_info_t *mod_info_out,
-    profile::trace_t *trace) {
+    rdb_modification_info_t *mod_info_out) THROWS_ONLY(interrupted_exc_t) {
     const return_changes_t return_changes = replacer->should_return_changes();
-    const datum_string_t &primary_key = info.btree->primary_key;
-    const store_key_t &key = *info.key;
+    const datum_string_t &primary_key = btree->primary_key;
 
-    try {
-        keyvalue_location_t kv_location;
-        rdb_value_sizer_t sizer(info.superblock->cache()->max_block_size());
-        find_keyvalue_location_for_write(&sizer, info.superblock,
-                                         info.key->btree_key(),
-                                         deletion_context->balancing_detacher(),
-                                         &kv_location,
-                                         &info.btree->slice->stats,
-                                         trace,
-                                         superblock_promise);
+    ql::datum_t old_val;
+    if (!kv_location->value.has()) {
+        // If there's no entry with this key, pass NULL to the function.
+        old_val = ql::datum_t::null();
+    } else {
+        // Otherwise pass the entry with this key to the function.
+        old_val = get_data(kv_location->value_as<rdb_value_t>(),
+                           buf_parent_t(&kv_location->buf));
+        guarantee(old_val.get_field(primary_key, ql::NOTHROW).has());
+    }
+    guarantee(old_val.has());
 
-        ql::datum_t old_val;
-        if (!kv_location.value.has()) {
-            // If there's no entry with this key, pass NULL to the function.
-            old_val = ql::datum_t::null();
-        } else {
-            // Otherwise pass the entry with this key to the function.
-            old_val = get_data(kv_location.value_as<rdb_value_t>(),
-                               buf_parent_t(&kv_location.buf));
-            guarantee(old_val.get_field(primary_key, ql::NOTHROW).has());
+    try {
+        /* Compute the replacement value for the row */
+        ql::datum_t new_val = replacer->replace(old_val);
+
+        /* Validate the replacement value and generate a stats object to return to
+        the user, but don't return it yet if we need to make changes. The reason for
+        this odd order is that we need to validate the change before we write the
+        change. */
+        rcheck_row_replacement(primary_key, key, old_val, new_val);
+        bool was_changed;
+        ql::datum_t resp = make_row_replacement_stats(
+            primary_key, key, old_val, new_val, return_changes, &was_changed);
+        if (!was_changed) {
+            return resp;
         }
-        guarantee(old_val.has());
 
-        try {
-            /* Compute the replacement value for the row */
-            ql::datum_t new_val = replacer->replace(old_val);
-
-            /* Validate the replacement value and generate a stats object to return to
-            the user, but don't return it yet if we need to make changes. The reason for
-            this odd order is that we need to validate the change before we write the
-            change. */
-            rcheck_row_replacement(primary_key, key, old_val, new_val);
-            bool was_changed;
-            ql::datum_t resp = make_row_replacement_stats(
-                primary_key, key, old_val, new_val, return_changes, &was_changed);
-            if (!was_changed) {
-                return resp;
+        /* Now that the change has passed validation, write it to disk */
+        if (new_val.get_type() == ql::datum_t::R_NULL) {
+            kv_location_delete(kv_location, key, btree->timestamp,
+                               deletion_context, mod_info_out);
+        } else {
+            r_sanity_check(new_val.get_field(primary_key, ql::NOTHROW).has());
+            ql::serialization_result_t res =
+                kv_location_set(kv_location, key, new_val,
+                                btree->timestamp, deletion_context,
+                                mod_info_out);
+            if (res & ql::serialization_result_t::ARRAY_TOO_BIG) {
+                rfail_typed_target(&new_val, "Array too large for disk writes "
+                                   "(limit 100,000 elements).");
+            } else if (res & ql::serialization_result_t::EXTREMA_PRESENT) {
+                rfail_typed_target(&new_val, "`r.minval` and `r.maxval` cannot be "
+                                   "written to disk.");
             }
+        }
 
-            /* Now that the change has passed validation, write it to disk */
-            if (new_val.get_type() == ql::datum_t::R_NULL) {
-                kv_location_delete(&kv_location, *info.key, info.btree->timestamp,
-                                   deletion_context, mod_info_out);
-            } else {
-                r_sanity_check(new_val.get_field(primary_key, ql::NOTHROW).has());
-                ql::serialization_result_t res =
-                    kv_location_set(&kv_location, *info.key, new_val,
-                                    info.btree->timestamp, deletion_context,
-                                    mod_info_out);
-                if (res & ql::serialization_result_t::ARRAY_TOO_BIG) {
-                    rfail_typed_target(&new_val, "Array too large for disk writes "
-                                       "(limit 100,000 elements).");
-                } else if (res & ql::serialization_result_t::EXTREMA_PRESENT) {
-                    rfail_typed_target(&new_val, "`r.minval` and `r.maxval` cannot be "
-                                       "written to disk.");
-                }
-            }
+        /* Report the changes for sindex and change-feed purposes */
+        if (old_val.get_type() != ql::datum_t::R_NULL) {
+            guarantee(!mod_info_out->deleted.second.empty());
+            mod_info_out->deleted.first = old_val;
+        } else {
+            guarantee(mod_info_out->deleted.second.empty());
+        }
+        if (new_val.get_type() != ql::datum_t::R_NULL) {
+            guarantee(!mod_info_out->added.second.empty());
+            mod_info_out->added.first = new_val;
+        } else {
+            guarantee(mod_info_out->added.second.empty());
+        }
 
-            /* Report the changes for sindex and change-feed purposes */
-            if (old_val.get_type() != ql::datum_t::R_NULL) {
-                guarantee(!mod_info_out->deleted.second.empty());
-                mod_info_out->deleted.first = old_val;
-            } else {
-                guarantee(mod_info_out->deleted.second.empty());
-            }
-            if (new_val.get_type() != ql::datum_t::R_NULL) {
-                guarantee(!mod_info_out->added.second.empty());
-                mod_info_out->added.first = new_val;
-            } else {
-                guarantee(mod_info_out->added.second.empty());
-            }
+        return resp;
 
-            return resp;
-
-        } catch (const ql::base_exc_t &e) {
-            return make_row_replacement_error_stats(old_val, return_changes, e.what());
-        }
-    } catch (const interrupted_exc_t &e) {
-        ql::datum_object_builder_t object_builder;
-        std::string msg = strprintf("interrupted (%s:%d)", __FILE__, __LINE__);
-        object_builder.add_error(msg.c_str());
-        // We don't rethrow because we're in a coroutine.  Theoretically the
-        // above message should never make it back to a user because the calling
-        // function will also be interrupted, but we document where it comes
-        // from to aid in future debugging if that invariant becomes violated.
-        return std::move(object_builder).to_datum();
+    } catch (const ql::base_exc_t &e) {
+        return make_row_replacement_error_stats(old_val, return_changes, e.what());
     }
 }
 
+batched_replace_response_t make_interrupted_replace_response() {
+    ql::datum_object_builder_t object_builder;
+    std::string msg = strprintf("interrupted (%s:%d)", __FILE__, __LINE__);
+    object_builder.add_error(msg.c_str());
+    // We don't rethrow because we're in a coroutine.  Theoretically the
+    // above message should never make it back to a user because the calling
+    // function will also be interrupted, but we document where it comes
+    // from to aid in future debugging if that invariant becomes violated.
+    return std::move(object_builder).to_datum();
+}
 
 class one_replace_t : public btree_point_replacer_t {
 public:
@@ -324,14 +401,24 @@ private:
     const size_t index;
 };
 
-void do_a_replace_from_batched_replace(
+/* Applies the replaces for `keys[order[begin]]`, `keys[order[begin + 1]]` and so on.
+After the first one, we keep going for as long as the next key is in the same leaf
+and we still hold the superblock, so that the next key doesn't have to walk down the
+tree again. We stop before that if the superblock has been passed back, so
+`*num_replaced_out` is final by the time `superblock_promise` is pulsed. */
+void do_replaces_from_batched_replace(
     auto_drainer_t::lock_t,
     fifo_enforcer_sink_t *batched_replaces_fifo_sink,
     const fifo_enforcer_write_token_t &batched_replaces_fifo_token,
-    const btree_loc_info_t &info,
-    const one_replace_t one_replace,
+    const btree_info_t *info,
+    superblock_t *superblock,
+    const std::vector<store_key_t> *keys,
+    const std::vector<size_t> *order,
+    size_t begin,
+    const btree_batched_replacer_t *replacer,
     const ql::configured_limits_t &limits,
     promise_t<superblock_t *> *superblock_promise,
+    size_t *num_replaced_out,
     rdb_modification_report_cb_t *sindex_cb,
     bool update_pkey_cfeeds,
     batched_replace_response_t *stats_out,
@@ -339,23 +426,62 @@ void do_a_replace_from_batched_replace(
     profile::trace_t *trace,
     std::set<std::string> *conditions)
 {
-    sampler->new_sample();
     fifo_enforcer_sink_t::exit_write_t exiter(
         batched_replaces_fifo_sink, batched_replaces_fifo_token);
 
     rdb_live_deletion_context_t deletion_context;
-    rdb_modification_report_t mod_report(*info.key);
-    ql::datum_t res = rdb_replace_and_return_superblock(
-        info, &one_replace, &deletion_context, superblock_promise, &mod_report.info,
-        trace);
-    *stats_out = (*stats_out).merge(res, ql::stats_merge, limits, conditions);
+    std::vector<rdb_modification_report_t> mod_reports;
+    *num_replaced_out = 1;
+    {
+        keyvalue_location_t kv_location;
+        rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+        sampler->new_sample();
+        find_keyvalue_location_for_write(&sizer, superblock,
+                                         (*keys)[(*order)[begin]].btree_key(),
+                                         deletion_context.balancing_detacher(),
+                                         &kv_location,
+                                         &info->slice->stats,
+                                         trace,
+                                         superblock_promise);
+        for (size_t i = begin; ; ) {
+            const store_key_t &key = (*keys)[(*order)[i]];
+            mod_reports.push_back(rdb_modification_report_t(key));
+            const one_replace_t one_replace(replacer, (*order)[i]);
+            ql::datum_t res;
+            try {
+                res = rdb_replace_at_location(info, key, &kv_location, &one_replace,
+                                              &deletion_context,
+                                              &mod_reports.back().info);
+            } catch (const interrupted_exc_t &) {
+                res = make_interrupted_replace_response();
+            }
+            *stats_out = (*stats_out).merge(res, ql::stats_merge, limits, conditions);
+
+            ++i;
+            // Deleting a row can merge the leaf with a sibling, after which
+            // `kv_location` doesn't tell us much about the tree anymore.
+            const rdb_modification_info_t &mod_info = mod_reports.back().info;
+            const bool deleted_row = !mod_info.deleted.second.empty()
+                && mod_info.added.second.empty();
+            if (i == order->size()
+                || kv_location.superblock == NULL
+                || deleted_row
+                || !find_keyvalue_location_in_same_leaf(
+                    &sizer, (*keys)[(*order)[i]].btree_key(), &kv_location)) {
+                break;
+            }
+            *num_replaced_out = i - begin + 1;
+            sampler->new_sample();
+        }
+    }
 
     // We wait to make sure we acquire `acq` in the same order we were
     // originally called.
     exiter.wait();
-    scoped_ptr_t<new_mutex_in_line_t> acq = sindex_cb->get_in_line();
-
-    sindex_cb->on_mod_report(mod_report, update_pkey_cfeeds, acq.get());
+    for (auto it = mod_reports.begin(); it != mod_reports.end(); ++it) {
+        scoped_ptr_t<new_mutex_in_line_t> acq = sindex_cb->get_in_line();
+        sindex_cb->on_mod_report(*it, update_pkey_cfeeds, acq.get());
+    }
 }
 
 batched_replace_response_t rdb_batched_replace(
@@ -375,6 +501,11 @@ batched_replace_response_t rdb_batched_replace(
 
     std::set<std::string> conditions;
 
+    // See `key_filter_t` about why this happens before we let go of the superblock.
+    for (const store_key_t &key : keys) {
+        info.slice->key_filter.add(key.btree_key());
+    }
+
     // We have to drain write operations before destructing everything above us,
     // because the coroutines being drained use them.
     {
@@ -391,20 +522,37 @@ batched_replace_response_t rdb_batched_replace(
         // write operations depending on the presence of limit changefeeds.
         scoped_ptr_t<real_superblock_t> current_superblock(superblock->release());
         bool update_pkey_cfeeds = sindex_cb->has_pkey_cfeeds();
+        // We apply the replaces in key order rather than in the order they were
+        // given.  Consecutive keys mostly end up in the same leaf, so the pipelined
+        // descents below find that leaf (and the path to it) already in the
+        // cache, and a sorted import dirties each leaf only once per batch.  While
+        // a replace still holds the superblock when it gets to its leaf, it also
+        // applies the following keys that go into that leaf.  The sort is stable
+        // so that duplicate keys are still applied in order.
+        std::vector<size_t> order(keys.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+                         [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
         {
             auto_drainer_t drainer;
-            for (size_t i = 0; i < keys.size(); ++i) {
+            for (size_t begin = 0; begin < order.size(); ) {
                 promise_t<superblock_t *> superblock_promise;
+                size_t num_replaced;
                 coro_queue.push(
                     std::bind(
-                        &do_a_replace_from_batched_replace,
+                        &do_replaces_from_batched_replace,
                         auto_drainer_t::lock_t(&drainer),
                         &sink,
                         source.enter_write(),
-                        btree_loc_info_t(&info, current_superblock.release(), &keys[i]),
-                        one_replace_t(replacer, i),
+                        &info,
+                        current_superblock.release(),
+                        &keys,
+                        &order,
+                        begin,
+                        replacer,
                         limits,
                         &superblock_promise,
+                        &num_replaced,
                         sindex_cb,
                         update_pkey_cfeeds,
                         &stats,
@@ -413,6 +561,7 @@ batched_replace_response_t rdb_batched_replace(
                         &conditions));
                 current_superblock.init(
                     static_cast<real_superblock_t *>(superblock_promise.wait()));
+                begin += num_replaced;
             }
             if (!update_pkey_cfeeds) {
                 current_superblock.reset(); // Release the superblock early if
@@ -442,6 +591,9 @@ void rdb_set(const store_key_t &key,
              rdb_modification_info_t *mod_info,
              profile::trace_t *trace,
              promise_t<superblock_t *> *pass_back_superblock) {
+    // See `key_filter_t` about why this happens before we let go of the superblock.
+    slice->key_filter.add(key.btree_key());
+
     keyvalue_location_t kv_location;
     rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
     find_keyvalue_location_for_write(&sizer, superblock, key.btree_key(),
@@ -480,8 +632,9 @@ class agnostic_rdb_backfill_callback_t : public agnostic_backfill_callback_t {
 public:
     agnostic_rdb_backfill_callback_t(rdb_backfill_callback_t *cb,
                                      const key_range_t &kr,
-                                     btree_slice_t *slice) :
-        cb_(cb), kr_(kr), slice_(slice) { }
+                                     btree_slice_t *slice,
+                                     size_t max_chunk_size) :
+        cb_(cb), kr_(kr), slice_(slice), max_chunk_size_(max_chunk_size) { }
 
     void on_delete_range(const key_range_t &range, signal_t *interruptor) THROWS_ONLY(interrupted_exc_t) {
         rassert(kr_.is_superset(range));
@@ -515,13 +668,12 @@ public:
             current_chunk_size += static_cast<size_t>(atom.key.size())
                 + serialized_size<cluster_version_t::CLUSTER>(atom.value);
 
-            if (current_chunk_size >= BACKFILL_MAX_KVPAIRS_SIZE) {
+            if (current_chunk_size >= max_chunk_size_) {
                 // To avoid flooding the receiving node with overly large chunks
                 // (which could easily make it run out of memory in extreme
                 // cases), pass on what we have got so far. Then continue
                 // with the remaining values.
-                slice_->stats.pm_keys_read.record(chunk_atoms.size());
-                slice_->stats.pm_total_keys_read += chunk_atoms.size();
+                slice_->stats.record_keys_read(chunk_atoms.size());
                 cb_->on_keyvalues(std::move(chunk_atoms), interruptor);
                 chunk_atoms = std::vector<backfill_atom_t>();
                 chunk_atoms.reserve(keys.size() - (i+1));
@@ -530,8 +682,7 @@ public:
         }
         if (!chunk_atoms.empty()) {
             // Pass on the final chunk
-            slice_->stats.pm_keys_read.record(chunk_atoms.size());
-            slice_->stats.pm_total_keys_read += chunk_atoms.size();
+            slice_->stats.record_keys_read(chunk_atoms.size());
             cb_->on_keyvalues(std::move(chunk_atoms), interruptor);
         }
     }
@@ -543,6 +694,7 @@ public:
     rdb_backfill_callback_t *cb_;
     key_range_t kr_;
     btree_slice_t *slice_;
+    size_t max_chunk_size_;
 };
 
 void rdb_backfill(btree_slice_t *slice, const key_range_t& key_range,
@@ -551,7 +703,11 @@ void rdb_backfill(btree_slice_t *slice, const key_range_t& key_range,
                   buf_lock_t *sindex_block,
                   parallel_traversal_progress_t *p, signal_t *interruptor)
     THROWS_ONLY(interrupted_exc_t) {
-    agnostic_rdb_backfill_callback_t agnostic_cb(callback, key_range, slice);
+    agnostic_rdb_backfill_callback_t agnostic_cb(
+        callback, key_range, slice,
+        since_when == repli_timestamp_t::distant_past
+            ? BACKFILL_FROM_SCRATCH_MAX_KVPAIRS_SIZE
+            : BACKFILL_MAX_KVPAIRS_SIZE);
     rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
     do_agnostic_btree_backfill(&sizer, key_range, since_when, &agnostic_cb,
                                superblock, sindex_block, p, interruptor);
@@ -595,14 +751,34 @@ void rdb_value_detacher_t::delete_value(buf_parent_t parent, const void *value)
 typedef ql::transform_variant_t transform_variant_t;
 typedef ql::terminal_variant_t terminal_variant_t;
 
+/* Lets us look up many rows below a superblock that the lookups would otherwise
+release. */
+class kept_superblock_t : public superblock_t {
+public:
+    explicit kept_superblock_t(superblock_t *_inner) : inner(_inner) { }
+    void release() { }
+    block_id_t get_root_block_id() { return inner->get_root_block_id(); }
+    void set_root_block_id(UNUSED block_id_t new_root_block) { unreachable(); }
+    block_id_t get_stat_block_id() { return inner->get_stat_block_id(); }
+    buf_parent_t expose_buf() { return inner->expose_buf(); }
+private:
+    superblock_t *inner;
+};
+
 class rget_sindex_data_t {
 public:
     rget_sindex_data_t(const key_range_t &_pkey_range, const ql::datum_range_t &_range,
                        reql_version_t wire_func_reql_version,
-                       ql::map_wire_func_t wire_func, sindex_multi_bool_t _multi)
+                       ql::map_wire_func_t wire_func, sindex_multi_bool_t _multi,
+                       const std::set<store_key_t> *_pkey_filter,
+                       btree_slice_t *_primary_slice,
+                       superblock_t *_primary_superblock)
         : pkey_range(_pkey_range), range(_range),
           func_reql_version(wire_func_reql_version),
-          func(wire_func.compile_wire_func()), multi(_multi) { }
+          func(wire_func.compile_wire_func()), multi(_multi),
+          pkey_filter(_pkey_filter),
+          primary_slice(_primary_slice),
+          primary_superblock(_primary_superblock) { }
 private:
     friend class rget_cb_t;
     const key_range_t pkey_range;
@@ -610,6 +786,13 @@ private:
     const reql_version_t func_reql_version;
     const counted_t<const ql::func_t> func;
     const sindex_multi_bool_t multi;
+    // If set, rows whose primary key isn't in here are skipped without loading
+    // them.
+    const std::set<store_key_t> *pkey_filter;
+    // Set if the index only stores primary keys, so that we have to read the rows
+    // from the primary index.
+    btree_slice_t *const primary_slice;
+    superblock_t *const primary_superblock;
 };
 
 class job_data_t {
@@ -620,39 +803,110 @@ public:
                sorting_t _sorting)
         : env(_env),
           batcher(batchspec.to_batcher()),
+          transforms(_transforms),
           sorting(_sorting),
           accumulator(_terminal
                       ? ql::make_terminal(*_terminal)
-                      : ql::make_append(sorting, &batcher)) {
+                      : ql::make_append(sorting, &batcher)),
+          has_terminal(static_cast<bool>(_terminal)),
+          is_limit_read(_terminal
+                        && boost::get<ql::limit_read_t>(&*_terminal) != NULL),
+          distinct_by_index(false) {
         for (size_t i = 0; i < _transforms.size(); ++i) {
             transformers.push_back(ql::make_op(_transforms[i]));
         }
         guarantee(transformers.size() == _transforms.size());
+        if (!_transforms.empty()) {
+            const ql::distinct_wire_func_t *distinct =
+                boost::get<ql::distinct_wire_func_t>(&_transforms[0]);
+            distinct_by_index = distinct != NULL && distinct->use_index;
+        }
     }
     job_data_t(job_data_t &&jd)
         : env(jd.env),
           batcher(std::move(jd.batcher)),
           transformers(std::move(jd.transformers)),
+          transforms(std::move(jd.transforms)),
           sorting(jd.sorting),
-          accumulator(jd.accumulator.release()) {
+          accumulator(jd.accumulator.release()),
+          has_terminal(jd.has_terminal),
+          is_limit_read(jd.is_limit_read),
+          distinct_by_index(jd.distinct_by_index) {
     }
 private:
     friend class rget_cb_t;
     ql::env_t *const env;
     ql::batcher_t batcher;
     std::vector<scoped_ptr_t<ql::op_t> > transformers;
+    // What `transformers` were made from, so that other threads can make their own.
+    std::vector<transform_variant_t> transforms;
     sorting_t sorting;
     scoped_ptr_t<ql::accumulator_t> accumulator;
+    // Without a terminal the accumulator batches the rows, and may stop at any row.
+    bool has_terminal;
+    bool is_limit_read;
+    // Whether the first transform is a `distinct` on the index value, which drops
+    // every row after the first one with the same index value.
+    bool distinct_by_index;
 };
 
 class rget_io_data_t {
 public:
-    rget_io_data_t(rget_read_response_t *_response, btree_slice_t *_slice)
-        : response(_response), slice(_slice) { }
+    rget_io_data_t(rget_read_response_t *_response, btree_slice_t *_slice,
+                   rget_scan_counts_t *_counts = NULL)
+        : response(_response), slice(_slice), counts(_counts) { }
 private:
     friend class rget_cb_t;
     rget_read_response_t *const response;
     btree_slice_t *const slice;
+    // May be `NULL`.
+    rget_scan_counts_t *const counts;
+};
+
+/* Scans of the primary index with transforms that only depend on the row (`map`,
+`filter` and `concat_map` with deterministic functions) don't transform the rows
+themselves: they collect them into chunks, transform each chunk on another thread,
+and then accumulate the results back on the traversal's thread.  Without a terminal
+the accumulator may stop at any row, so the chunks are accumulated in the order of
+the traversal; terminals see every row, so their chunks are accumulated as soon as
+they're ready. */
+static const size_t RGET_PARALLEL_CHUNK_SIZE = 64;
+
+// How many chunks may be waiting to be transformed or accumulated at once.
+static const int64_t RGET_PARALLEL_MAX_CHUNKS = 8;
+
+class rget_chunk_t {
+public:
+    rget_chunk_t() : error_index(0), interrupted(false) { }
+private:
+    friend class rget_cb_t;
+    std::vector<std::pair<store_key_t, ql::datum_t> > rows;
+    std::vector<ql::groups_t> results;
+    // Set if transforming `rows[error_index]` failed.
+    boost::optional<ql::exc_t> error;
+    size_t error_index;
+    bool interrupted;
+    new_semaphore_acq_t slot;
+    fifo_enforcer_write_token_t merge_token;
+};
+
+class parallel_transform_visitor_t : public boost::static_visitor<bool> {
+public:
+    bool operator()(const ql::map_wire_func_t &f) const {
+        return f.compile_wire_func()->is_deterministic();
+    }
+    bool operator()(const ql::filter_wire_func_t &f) const {
+        return f.filter_func.compile_wire_func()->is_deterministic()
+            && (!f.default_filter_val
+                || f.default_filter_val->compile_wire_func()->is_deterministic());
+    }
+    bool operator()(const ql::concatmap_wire_func_t &f) const {
+        return f.compile_wire_func()->is_deterministic();
+    }
+    template <class T>
+    bool operator()(const T &) const {
+        return false;
+    }
 };
 
 class rget_cb_t : public concurrent_traversal_callback_t {
@@ -667,7 +921,19 @@ public:
         concurrent_traversal_fifo_enforcer_signal_t waiter)
         THROWS_ONLY(interrupted_exc_t);
     void finish() THROWS_ONLY(interrupted_exc_t);
+
+    // Whether the traversal may stop early to skip over index keys (see `skip_to`).
+    bool may_skip() const;
+    // The key that the traversal should be resumed from, if the last traversal
+    // stopped to skip over keys.
+    boost::optional<store_key_t> take_skip_to();
 private:
+    bool can_transform_in_parallel() const;
+    void dispatch_chunk() THROWS_ONLY(interrupted_exc_t);
+    void transform_chunk(rget_chunk_t *chunk, threadnum_t thread,
+                         auto_drainer_t::lock_t keepalive);
+    void merge_chunk(rget_chunk_t *chunk);
+
     const rget_io_data_t io; // How do get data in/out.
     job_data_t job; // What to do next (stateful).
     const boost::optional<rget_sindex_data_t> sindex; // Optional sindex information.
@@ -676,6 +942,26 @@ private:
     bool bad_init;
     scoped_ptr_t<profile::disabler_t> disabler;
     scoped_ptr_t<profile::sampler_t> sampler;
+
+    // Set when an index `distinct` has seen the first row with some index value,
+    // to where the rows with the next index value begin (in the direction of the
+    // traversal).
+    boost::optional<store_key_t> skip_to;
+
+    // State for transforming the rows on other threads (see `rget_chunk_t`).
+    const bool parallel;
+    const bool ordered_merge;
+    std::map<std::string, ql::wire_func_t> optargs;
+    scoped_ptr_t<rget_chunk_t> chunk;
+    new_semaphore_t chunk_slots;
+    fifo_enforcer_source_t merge_source;
+    fifo_enforcer_sink_t merge_sink;
+    int next_thread;
+    // Set once no more rows should be accumulated.
+    bool stopped;
+    bool interrupted;
+    // Destroyed first, so that the chunks that are being transformed can finish.
+    scoped_ptr_t<auto_drainer_t> drainer;
 };
 
 rget_cb_t::rget_cb_t(rget_io_data_t &&_io,
@@ -685,7 +971,17 @@ rget_cb_t::rget_cb_t(rget_io_data_t &&_io,
     : io(std::move(_io)),
       job(std::move(_job)),
       sindex(std::move(_sindex)),
-      bad_init(false) {
+      bad_init(false),
+      parallel(can_transform_in_parallel()),
+      ordered_merge(!job.has_terminal),
+      chunk_slots(RGET_PARALLEL_MAX_CHUNKS),
+      next_thread(0),
+      stopped(false),
+      interrupted(false) {
+    if (parallel) {
+        optargs = job.env->get_all_optargs();
+        drainer.init(new auto_drainer_t);
+    }
     io.response->last_key = !reversed(job.sorting)
         ? range.left
         : (!range.right.unbounded ? range.right.key : store_key_t::max());
@@ -695,12 +991,166 @@ rget_cb_t::rget_cb_t(rget_io_data_t &&_io,
 }
 
 void rget_cb_t::finish() THROWS_ONLY(interrupted_exc_t) {
+    if (parallel) {
+        if (chunk.has() && !stopped) {
+            dispatch_chunk();
+        }
+        drainer.reset();
+        if (interrupted) {
+            throw interrupted_exc_t();
+        }
+    }
     job.accumulator->finish(&io.response->result);
     if (job.accumulator->should_send_batch()) {
         io.response->truncated = true;
     }
 }
 
+bool rget_cb_t::can_transform_in_parallel() const {
+    // The profiler and the unit tests' environments can't be used from other
+    // threads.
+    if (sindex || job.transforms.empty() || job.is_limit_read
+        || job.env->trace != NULL || job.env->get_rdb_ctx() == NULL
+        || get_num_db_threads() < 2) {
+        return false;
+    }
+    for (const auto &transform : job.transforms) {
+        if (!boost::apply_visitor(parallel_transform_visitor_t(), transform)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void rget_cb_t::dispatch_chunk() THROWS_ONLY(interrupted_exc_t) {
+    chunk->slot.init(&chunk_slots, 1);
+    wait_interruptible(chunk->slot.acquisition_signal(), job.env->interruptor);
+    if (ordered_merge) {
+        chunk->merge_token = merge_source.enter_write();
+    }
+    // Spread the chunks over the other threads.
+    const int num_threads = get_num_db_threads();
+    const int offset = 1 + next_thread % (num_threads - 1);
+    next_thread += 1;
+    threadnum_t thread((get_thread_id().threadnum + offset) % num_threads);
+    coro_t::spawn_sometime(std::bind(&rget_cb_t::transform_chunk, this,
+                                     chunk.release(), thread, drainer->lock()));
+}
+
+void rget_cb_t::transform_chunk(rget_chunk_t *_chunk, threadnum_t thread,
+                                auto_drainer_t::lock_t) {
+    scoped_ptr_t<rget_chunk_t> c(_chunk);
+    try {
+        cross_thread_signal_t ct_interruptor(job.env->interruptor, thread);
+        on_thread_t th(thread);
+        ql::env_t env(job.env->get_rdb_ctx(), ql::return_empty_normal_batches_t::NO,
+                      &ct_interruptor, optargs, NULL, NULL);
+        std::vector<scoped_ptr_t<ql::op_t> > ops;
+        for (const auto &transform : job.transforms) {
+            ops.push_back(ql::make_op(transform));
+        }
+        c->results.resize(c->rows.size());
+        for (size_t i = 0; i < c->rows.size(); ++i) {
+            ql::groups_t *data = &c->results[i];
+            *data = {{ql::datum_t(), ql::datums_t{c->rows[i].second}}};
+            try {
+                for (auto it = ops.begin(); it != ops.end(); ++it) {
+                    (**it)(&env, data, ql::datum_t());
+                }
+            } catch (const ql::exc_t &e) {
+                c->error = e;
+                c->error_index = i;
+                break;
+            } catch (const ql::datum_exc_t &e) {
+                c->error = ql::exc_t(e, NULL);
+                c->error_index = i;
+                break;
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        c->interrupted = true;
+    }
+    merge_chunk(c.get());
+}
+
+void rget_cb_t::merge_chunk(rget_chunk_t *c) {
+    fifo_enforcer_sink_t::exit_write_t exit_write;
+    if (ordered_merge) {
+        exit_write.begin(&merge_sink, c->merge_token);
+        exit_write.wait_lazily_unordered();
+    }
+    if (c->interrupted) {
+        interrupted = true;
+        stopped = true;
+    }
+    if (stopped) {
+        return;
+    }
+    const size_t num_rows = c->error ? c->error_index : c->rows.size();
+    try {
+        for (size_t i = 0; i < num_rows && !stopped; ++i) {
+            store_key_t *key = &c->rows[i].first;
+            if ((io.response->last_key < *key && !reversed(job.sorting)) ||
+                (io.response->last_key > *key && reversed(job.sorting))) {
+                io.response->last_key = *key;
+            }
+            if (io.counts != NULL) {
+                io.counts->rows_scanned += 1;
+                for (const auto &group : c->results[i]) {
+                    io.counts->rows_returned += group.second.size();
+                }
+            }
+            if ((*job.accumulator)(job.env, &c->results[i], std::move(*key),
+                                   ql::datum_t()) == done_traversing_t::YES) {
+                stopped = true;
+            }
+        }
+        if (!stopped && c->error) {
+            io.response->result = *c->error;
+            stopped = true;
+        }
+    } catch (const ql::exc_t &e) {
+        io.response->result = e;
+        stopped = true;
+    } catch (const ql::datum_exc_t &e) {
+        io.response->result = ql::exc_t(e, NULL);
+        stopped = true;
+    }
+}
+
+bool rget_cb_t::may_skip() const {
+    return sindex && job.distinct_by_index;
+}
+
+boost::optional<store_key_t> rget_cb_t::take_skip_to() {
+    boost::optional<store_key_t> ret;
+    ret.swap(skip_to);
+    return ret;
+}
+
+/* Finds the bound of the index keys with the same index value as `key`: the first
+key after them for ascending traversals, and the (exclusive) right bound of the keys
+before them for descending ones.  The index value's encoding ends in a NUL byte that
+no encoded value contains otherwise (binary values escape theirs), so all the keys
+with the value start with the same bytes and nothing else does.  Returns false if the
+value might have been truncated. */
+static bool sindex_value_bound(const store_key_t &key, sorting_t sorting,
+                               store_key_t *bound_out) {
+    if (ql::datum_t::key_is_truncated(key)) {
+        return false;
+    }
+    std::string secondary =
+        ql::datum_t::extract_secondary(key_to_unescaped_str(key));
+    if (secondary.empty() || secondary.back() != '\0') {
+        return false;
+    }
+    if (!reversed(sorting)) {
+        secondary.back() = '\1';
+    }
+    *bound_out = store_key_t(secondary);
+    return true;
+}
+
 // Handle a keyvalue pair.  Returns whether or not we're done early.
 done_traversing_t rget_cb_t::handle_pair(
     scoped_key_value_t &&keyvalue,
@@ -708,31 +1158,89 @@ done_traversing_t rget_cb_t::handle_pair(
     THROWS_ONLY(interrupted_exc_t) {
     sampler->new_sample();
 
-    if (bad_init || boost::get<ql::exc_t>(&io.response->result) != NULL) {
+    if (bad_init || stopped || boost::get<ql::exc_t>(&io.response->result) != NULL) {
         return done_traversing_t::YES;
     }
 
     // Load the key and value.
     store_key_t key(keyvalue.key());
-    if (sindex && !sindex->pkey_range.contains_key(ql::datum_t::extract_primary(key))) {
-        return done_traversing_t::NO;
+
+    // Whether the key alone shows that the row is in the sindex range, so that we
+    // don't have to evaluate the index function on it (or even load it, if nothing
+    // else needs it).  We don't bother if something needs the index value anyway.
+    bool key_in_sindex_range = false;
+    if (sindex && job.sorting == sorting_t::UNORDERED && job.transformers.empty()) {
+        const boost::optional<bool> contained
+            = sindex->range.contains_sindex_key(sindex->func_reql_version, key);
+        key_in_sindex_range = contained && *contained;
     }
 
-    lazy_json_t row(static_cast<const rdb_value_t *>(keyvalue.value()),
-                    keyvalue.expose_buf());
     ql::datum_t val;
-    // We only load the value if we actually use it (`count` does not).
-    if (job.accumulator->uses_val() || job.transformers.size() != 0 || sindex) {
-        val = row.get();
-        io.slice->stats.pm_keys_read.record();
-        io.slice->stats.pm_total_keys_read += 1;
+    if (sindex && sindex->primary_superblock != NULL) {
+        store_key_t primary_key(ql::datum_t::extract_primary(key));
+        if (!sindex->pkey_range.contains_key(primary_key)
+            || (sindex->pkey_filter != NULL
+                && sindex->pkey_filter->count(primary_key) == 0)) {
+            return done_traversing_t::NO;
+        }
+        keyvalue.reset();
+        // As below, we only look the row up if we actually use it.
+        if (job.accumulator->uses_val() || job.transformers.size() != 0
+            || !key_in_sindex_range) {
+            io.slice->stats.record_keys_read(1);
+            kept_superblock_t superblock(sindex->primary_superblock);
+            point_read_response_t row;
+            rdb_get(primary_key, sindex->primary_slice, &superblock, &row, NULL);
+            // Both indexes are read from the same snapshot, so this shouldn't
+            // happen.
+            if (row.data.get_type() == ql::datum_t::R_NULL) {
+                return done_traversing_t::NO;
+            }
+            val = std::move(row.data);
+        } else {
+            btree_stats_t::record_keys_scanned(1);
+        }
     } else {
-        row.reset();
+        if (sindex) {
+            store_key_t primary_key(ql::datum_t::extract_primary(key));
+            if (!sindex->pkey_range.contains_key(primary_key)
+                || (sindex->pkey_filter != NULL
+                    && sindex->pkey_filter->count(primary_key) == 0)) {
+                return done_traversing_t::NO;
+            }
+        }
+
+        lazy_json_t row(static_cast<const rdb_value_t *>(keyvalue.value()),
+                        keyvalue.expose_buf());
+        // We only load the value if we actually use it (`count` does not).
+        if (job.accumulator->uses_val() || job.transformers.size() != 0
+            || (sindex && !key_in_sindex_range)) {
+            val = row.get();
+            io.slice->stats.record_keys_read(1);
+        } else {
+            row.reset();
+            btree_stats_t::record_keys_scanned(1);
+        }
+        guarantee(!row.references_parent());
+        keyvalue.reset();
     }
-    guarantee(!row.references_parent());
-    keyvalue.reset();
     waiter.wait_interruptible();
 
+    if (parallel) {
+        // An earlier chunk may have stopped the traversal while we waited.
+        if (stopped) {
+            return done_traversing_t::YES;
+        }
+        if (!chunk.has()) {
+            chunk.init(new rget_chunk_t);
+        }
+        chunk->rows.push_back(std::make_pair(std::move(key), std::move(val)));
+        if (chunk->rows.size() >= RGET_PARALLEL_CHUNK_SIZE) {
+            dispatch_chunk();
+        }
+        return stopped ? done_traversing_t::YES : done_traversing_t::NO;
+    }
+
     try {
         // Update the last considered key.
         if ((io.response->last_key < key && !reversed(job.sorting)) ||
@@ -741,8 +1249,8 @@ done_traversing_t rget_cb_t::handle_pair(
         }
 
         // Check whether we're out of sindex range.
-        ql::datum_t sindex_val; // NULL if no sindex.
-        if (sindex) {
+        ql::datum_t sindex_val; // NULL if no sindex, or if the key was enough.
+        if (sindex && !key_in_sindex_range) {
             // Secondary index functions are deterministic (so no need for an
             // rdb_context_t) and evaluated in a pristine environment (without global
             // optargs).
@@ -762,19 +1270,36 @@ done_traversing_t rget_cb_t::handle_pair(
             }
         }
 
-        ql::groups_t data(optional_datum_less_t(job.env->reql_version()));
+        ql::groups_t data;
         data = {{ql::datum_t(), ql::datums_t{val}}};
 
         for (auto it = job.transformers.begin(); it != job.transformers.end(); ++it) {
             (**it)(job.env, &data, sindex_val);
             //                     ^^^^^^^^^^ NULL if no sindex
         }
+        if (io.counts != NULL) {
+            io.counts->rows_scanned += 1;
+            for (const auto &group : data) {
+                io.counts->rows_returned += group.second.size();
+            }
+        }
+        // An index `distinct` drops the rest of the rows with this index value, so
+        // rather than reading them we have the traversal start over past them.
+        store_key_t next_value_key;
+        const bool skip = may_skip()
+            && sindex_value_bound(key, job.sorting, &next_value_key);
         // We need lots of extra data for the accumulation because we might be
         // accumulating `rget_item_t`s for a batch.
-        return (*job.accumulator)(job.env,
-                                  &data,
-                                  std::move(key),
-                                  std::move(sindex_val)); // NULL if no sindex
+        done_traversing_t done =
+            (*job.accumulator)(job.env,
+                               &data,
+                               std::move(key),
+                               std::move(sindex_val)); // NULL if no sindex
+        if (done == done_traversing_t::NO && skip) {
+            skip_to = next_value_key;
+            return done_traversing_t::YES;
+        }
+        return done;
     } catch (const ql::exc_t &e) {
         io.response->result = e;
         return done_traversing_t::YES;
@@ -788,6 +1313,47 @@ done_traversing_t rget_cb_t::handle_pair(
     }
 }
 
+// Finds the first row of a btree in the traversal's direction.
+class first_key_traversal_cb_t : public depth_first_traversal_callback_t {
+public:
+    done_traversing_t handle_pair(scoped_key_value_t &&keyvalue) {
+        key = store_key_t(keyvalue.key());
+        return done_traversing_t::YES;
+    }
+    boost::optional<store_key_t> key;
+};
+
+bool rdb_count_from_stat_block(superblock_t *superblock,
+                               const key_range_t &range,
+                               uint64_t *count_out) {
+    const block_id_t stat_block_id = superblock->get_stat_block_id();
+    if (stat_block_id == NULL_BLOCK_ID) {
+        return false;
+    }
+    if (!range.is_superset(key_range_t::universe())) {
+        first_key_traversal_cb_t first, last;
+        btree_depth_first_traversal(superblock, key_range_t::universe(), &first,
+                                    direction_t::FORWARD, release_superblock_t::KEEP);
+        btree_depth_first_traversal(superblock, key_range_t::universe(), &last,
+                                    direction_t::BACKWARD, release_superblock_t::KEEP);
+        if ((first.key && !range.contains_key(*first.key))
+            || (last.key && !range.contains_key(*last.key))) {
+            return false;
+        }
+    }
+    // See `btree_parallel_traversal()` about why the stat block's parent is the txn.
+    buf_lock_t stat_block(buf_parent_t(superblock->expose_buf().txn()),
+                          stat_block_id, access_t::read);
+    buf_read_t read(&stat_block);
+    uint32_t sb_size;
+    const btree_statblock_t *sb_data =
+        static_cast<const btree_statblock_t *>(read.get_data_read(&sb_size));
+    guarantee(sb_size == BTREE_STATBLOCK_SIZE);
+    guarantee(sb_data->population >= 0);
+    *count_out = sb_data->population;
+    return true;
+}
+
 // TODO: Having two functions which are 99% the same sucks.
 void rdb_rget_slice(
         btree_slice_t *slice,
@@ -799,12 +1365,13 @@ void rdb_rget_slice(
         const boost::optional<terminal_variant_t> &terminal,
         sorting_t sorting,
         rget_read_response_t *response,
-        release_superblock_t release_superblock) {
+        release_superblock_t release_superblock,
+        rget_scan_counts_t *counts_out) {
 
     r_sanity_check(boost::get<ql::exc_t>(&response->result) == NULL);
     profile::starter_t starter("Do range scan on primary index.", ql_env->trace);
     rget_cb_t callback(
-        rget_io_data_t(response, slice),
+        rget_io_data_t(response, slice, counts_out),
         job_data_t(ql_env, batchspec, transforms, terminal, sorting),
         boost::optional<rget_sindex_data_t>(),
         range);
@@ -827,10 +1394,15 @@ void rdb_rget_secondary_slice(
         sorting_t sorting,
         const sindex_disk_info_t &sindex_info,
         rget_read_response_t *response,
-        release_superblock_t release_superblock) {
+        release_superblock_t release_superblock,
+        const std::set<store_key_t> *pkey_filter,
+        btree_slice_t *primary_slice,
+        superblock_t *primary_superblock) {
 
     r_sanity_check(boost::get<ql::exc_t>(&response->result) == NULL);
     guarantee(sindex_info.geo == sindex_geo_bool_t::REGULAR);
+    guarantee((sindex_info.values == sindex_values_bool_t::PRIMARY_KEY)
+              == (primary_superblock != NULL));
     profile::starter_t starter("Do range scan on secondary index.", ql_env->trace);
 
     const reql_version_t sindex_func_reql_version =
@@ -839,17 +1411,84 @@ void rdb_rget_secondary_slice(
         rget_io_data_t(response, slice),
         job_data_t(ql_env, batchspec, transforms, terminal, sorting),
         rget_sindex_data_t(pk_range, sindex_range, sindex_func_reql_version,
-                           sindex_info.mapping, sindex_info.multi),
+                           sindex_info.mapping, sindex_info.multi, pkey_filter,
+                           primary_slice, primary_superblock),
         sindex_region.inner);
-    btree_concurrent_traversal(
-        superblock,
-        sindex_region.inner,
-        &callback,
-        (!reversed(sorting) ? FORWARD : BACKWARD),
-        release_superblock);
+    // If the traversal skips keys, it has to be restarted under the superblock.
+    const bool may_skip = callback.may_skip();
+    key_range_t range = sindex_region.inner;
+    for (;;) {
+        btree_concurrent_traversal(
+            superblock,
+            range,
+            &callback,
+            (!reversed(sorting) ? FORWARD : BACKWARD),
+            may_skip ? release_superblock_t::KEEP : release_superblock);
+        boost::optional<store_key_t> skip_to = callback.take_skip_to();
+        if (!skip_to) {
+            break;
+        }
+        if (!reversed(sorting)) {
+            range.left = *skip_to;
+        } else {
+            range.right = key_range_t::right_bound_t(*skip_to);
+        }
+        if (range.is_empty()) {
+            break;
+        }
+    }
+    if (may_skip && release_superblock == release_superblock_t::RELEASE) {
+        superblock->release();
+    }
     callback.finish();
 }
 
+class collect_primary_keys_cb_t : public concurrent_traversal_callback_t {
+public:
+    collect_primary_keys_cb_t(const key_range_t *_pk_range,
+                              size_t _max_keys,
+                              std::set<store_key_t> *_keys_out)
+        : pk_range(_pk_range), max_keys(_max_keys), keys_out(_keys_out),
+          too_many(false) { }
+
+    done_traversing_t handle_pair(scoped_key_value_t &&keyvalue,
+                                  concurrent_traversal_fifo_enforcer_signal_t)
+        THROWS_ONLY(interrupted_exc_t) {
+        // The primary key is part of the secondary index key, so we never have to
+        // look at the value.
+        store_key_t primary_key(
+            ql::datum_t::extract_primary(store_key_t(keyvalue.key())));
+        keyvalue.reset();
+        if (pk_range->contains_key(primary_key)) {
+            keys_out->insert(std::move(primary_key));
+            if (keys_out->size() > max_keys) {
+                too_many = true;
+                return done_traversing_t::YES;
+            }
+        }
+        return done_traversing_t::NO;
+    }
+
+    const key_range_t *pk_range;
+    const size_t max_keys;
+    std::set<store_key_t> *keys_out;
+    bool too_many;
+};
+
+bool rdb_collect_sindex_primary_keys(
+        const region_t &sindex_region,
+        sindex_superblock_t *superblock,
+        const key_range_t &pk_range,
+        size_t max_keys,
+        std::set<store_key_t> *keys_out) {
+    keys_out->clear();
+    collect_primary_keys_cb_t callback(&pk_range, max_keys, keys_out);
+    btree_concurrent_traversal(
+        superblock, sindex_region.inner, &callback, FORWARD,
+        release_superblock_t::RELEASE);
+    return !callback.too_many;
+}
+
 void rdb_get_intersecting_slice(
         btree_slice_t *slice,
         const ql::datum_t &query_geometry,
@@ -864,7 +1503,7 @@ void rdb_get_intersecting_slice(
         rget_read_response_t *response) {
     guarantee(query_geometry.has());
 
-    guarantee(sindex_info.geo == sindex_geo_bool_t::GEO);
+    guarantee(sindex_info.geo != sindex_geo_bool_t::REGULAR);
     profile::starter_t starter("Do intersection scan on geospatial index.", ql_env->trace);
 
     const reql_version_t sindex_func_reql_version =
@@ -873,7 +1512,7 @@ void rdb_get_intersecting_slice(
         slice,
         geo_job_data_t(ql_env, batchspec, transforms, terminal),
         geo_sindex_data_t(pk_range, sindex_info.mapping, sindex_func_reql_version,
-                          sindex_info.multi),
+                          sindex_info.multi, sindex_info.geo),
         query_geometry,
         sindex_region.inner,
         response);
@@ -896,7 +1535,7 @@ void rdb_get_nearest_slice(
     const sindex_disk_info_t &sindex_info,
     nearest_geo_read_response_t *response) {
 
-    guarantee(sindex_info.geo == sindex_geo_bool_t::GEO);
+    guarantee(sindex_info.geo != sindex_geo_bool_t::REGULAR);
     profile::starter_t starter("Do nearest traversal on geospatial index.", ql_env->trace);
 
     const reql_version_t sindex_func_reql_version =
@@ -913,7 +1552,8 @@ void rdb_get_nearest_slice(
             nearest_traversal_cb_t callback(
                 slice,
                 geo_sindex_data_t(pk_range, sindex_info.mapping,
-                                  sindex_func_reql_version, sindex_info.multi),
+                                  sindex_func_reql_version, sindex_info.multi,
+                                  sindex_info.geo),
                 ql_env,
                 &state);
             btree_concurrent_traversal(
@@ -946,8 +1586,9 @@ void rdb_distribution_get(int max_depth,
                           distribution_read_response_t *response) {
     int64_t key_count_out;
     std::vector<store_key_t> key_splits;
+    std::map<store_key_t, int64_t> fanouts;
     get_btree_key_distribution(superblock, max_depth,
-                               &key_count_out, &key_splits);
+                               &key_count_out, &key_splits, &fanouts);
 
     int64_t keys_per_bucket;
     if (key_splits.size() == 0) {
@@ -955,15 +1596,190 @@ void rdb_distribution_get(int max_depth,
     } else  {
         keys_per_bucket = std::max<int64_t>(key_count_out / key_splits.size(), 1);
     }
-    response->key_counts[left_key] = keys_per_bucket;
 
-    for (std::vector<store_key_t>::iterator it  = key_splits.begin();
-                                            it != key_splits.end();
-                                            ++it) {
-        response->key_counts[*it] = keys_per_bucket;
+    if (fanouts.empty()) {
+        response->key_counts[left_key] = keys_per_bucket;
+        for (std::vector<store_key_t>::iterator it  = key_splits.begin();
+                                                it != key_splits.end();
+                                                ++it) {
+            response->key_counts[*it] = keys_per_bucket;
+        }
+        return;
+    }
+
+    /* Split `key_count_out` between the buckets in proportion to the fanouts that
+    were sampled for them. Buckets that didn't get a sample (because the tree changed
+    under us) get the average. */
+    int64_t total_fanout = 0;
+    for (auto const &pair : fanouts) {
+        total_fanout += pair.second;
+    }
+    const int64_t average_fanout =
+        std::max<int64_t>(total_fanout / static_cast<int64_t>(fanouts.size()), 1);
+    std::vector<std::pair<store_key_t, int64_t> > buckets;
+    buckets.reserve(key_splits.size() + 1);
+    int64_t total_weight = 0;
+    auto add_bucket = [&](const store_key_t &bucket_key, const store_key_t &fanout_key) {
+        auto it = fanouts.find(fanout_key);
+        int64_t weight = it == fanouts.end() ? average_fanout : it->second;
+        buckets.push_back(std::make_pair(bucket_key, weight));
+        total_weight += weight;
+    };
+    add_bucket(left_key, store_key_t::min());
+    for (auto const &key : key_splits) {
+        add_bucket(key, key);
+    }
+    for (auto const &bucket : buckets) {
+        response->key_counts[bucket.first] = std::max<int64_t>(
+            total_weight == 0 ? keys_per_bucket
+                : static_cast<int64_t>(static_cast<double>(key_count_out)
+                                       * bucket.second / total_weight),
+            1);
     }
 }
 
+// Trees with at most this many times the requested number of rows are read in full
+// rather than sampled by random descents.
+static const uint64_t SAMPLE_SCAN_FACTOR = 4;
+// How many random descents we make per requested row.  Some of them find a row that
+// we already have, and the surplus evens out the bias of the descents (see below).
+static const uint64_t SAMPLE_DESCENT_FACTOR = 2;
+
+// Collects every row of the traversed range with an unweighted sort key.
+class sample_scan_cb_t : public depth_first_traversal_callback_t {
+public:
+    explicit sample_scan_cb_t(signal_t *_interruptor) : interruptor(_interruptor) { }
+    done_traversing_t handle_pair(scoped_key_value_t &&keyvalue) {
+        if (interruptor->is_pulsed()) {
+            return done_traversing_t::YES;
+        }
+        rows.push_back(sample_read_response_t::keyed_row_t(
+            log(1.0 - randdouble()),
+            get_data(static_cast<const rdb_value_t *>(keyvalue.value()),
+                     keyvalue.expose_buf())));
+        return done_traversing_t::NO;
+    }
+    signal_t *interruptor;
+    std::vector<sample_read_response_t::keyed_row_t> rows;
+};
+
+// Walks from the root down to a random row in `range`, choosing uniformly among the
+// children (or rows) that overlap the range at every level.  Returns false if it
+// ends up in a leaf without any rows in the range.  `inverse_probability_out` is the
+// product of the choices' sizes, that is how many rows the descent's row stands for.
+static bool random_descent(superblock_t *superblock,
+                           const key_range_t &range,
+                           store_key_t *key_out,
+                           ql::datum_t *row_out,
+                           double *inverse_probability_out) {
+    const block_id_t root_id = superblock->get_root_block_id();
+    if (root_id == NULL_BLOCK_ID) {
+        return false;
+    }
+    double inverse_probability = 1.0;
+    buf_lock_t buf(superblock->expose_buf(), root_id, access_t::read);
+    for (;;) {
+        block_id_t child_id;
+        {
+            buf_read_t read(&buf);
+            const node_t *node = static_cast<const node_t *>(read.get_data_read());
+            if (node::is_leaf(node)) {
+                const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(node);
+                std::vector<std::pair<const btree_key_t *, const void *> > pairs;
+                for (auto it = leaf::inclusive_lower_bound(range.left.btree_key(), *leaf);
+                     it != leaf::end(*leaf);
+                     ++it) {
+                    if (!range.right.unbounded
+                        && btree_key_cmp((*it).first, range.right.key.btree_key()) >= 0) {
+                        break;
+                    }
+                    pairs.push_back(*it);
+                }
+                if (pairs.empty()) {
+                    return false;
+                }
+                const auto &pair = pairs[randint(pairs.size())];
+                *key_out = store_key_t(pair.first);
+                *row_out = get_data(static_cast<const rdb_value_t *>(pair.second),
+                                    buf_parent_t(&buf));
+                *inverse_probability_out = inverse_probability * pairs.size();
+                return true;
+            }
+            const internal_node_t *internal =
+                reinterpret_cast<const internal_node_t *>(node);
+            const int first =
+                internal_node::get_offset_index(internal, range.left.btree_key());
+            const int last = range.right.unbounded
+                ? internal->npairs - 1
+                : internal_node::get_offset_index(internal, range.right.key.btree_key());
+            inverse_probability *= last - first + 1;
+            child_id = internal_node::get_pair_by_index(
+                internal, first + randint(last - first + 1))->lnode;
+        }
+        buf_lock_t child(&buf, child_id, access_t::read);
+        buf = std::move(child);
+    }
+}
+
+void rdb_sample_slice(superblock_t *superblock,
+                      const key_range_t &range,
+                      uint64_t num,
+                      signal_t *interruptor,
+                      sample_read_response_t *response)
+    THROWS_ONLY(interrupted_exc_t) {
+    /* This is weighted sampling without replacement as described by Efraimidis and
+    Spirakis: a row that stands for `w` rows gets the sort key `log(u) / w` for a
+    uniformly random `u`, and the `num` rows with the largest keys are the sample.
+    The keys of different shards are comparable, so unsharding just keeps the
+    largest ones again. */
+    if (num == 0) {
+        return;
+    }
+    std::vector<sample_read_response_t::keyed_row_t> rows;
+    uint64_t population;
+    if (!rdb_count_from_stat_block(superblock, key_range_t::universe(), &population)
+        || population <= SAMPLE_SCAN_FACTOR * num) {
+        sample_scan_cb_t cb(interruptor);
+        btree_depth_first_traversal(superblock, range, &cb, direction_t::FORWARD,
+                                    release_superblock_t::KEEP);
+        rows = std::move(cb.rows);
+    } else {
+        /* Descending uniformly at every level favors the rows in emptier nodes, so we
+        weight every row by how unlikely it was to be found, which makes the sample
+        about uniform without any knowledge of the subtrees' sizes. */
+        const uint64_t descents = SAMPLE_DESCENT_FACTOR * num;
+        std::map<store_key_t, std::pair<double, ql::datum_t> > found;
+        for (uint64_t i = 0; i < descents && !interruptor->is_pulsed(); ++i) {
+            store_key_t key;
+            ql::datum_t row;
+            double inverse_probability;
+            if (random_descent(superblock, range, &key, &row, &inverse_probability)) {
+                found.insert(std::make_pair(
+                    key, std::make_pair(inverse_probability, std::move(row))));
+            }
+        }
+        rows.reserve(found.size());
+        for (auto &pair : found) {
+            const double weight = pair.second.first / descents;
+            rows.push_back(sample_read_response_t::keyed_row_t(
+                log(1.0 - randdouble()) / weight, std::move(pair.second.second)));
+        }
+    }
+    if (interruptor->is_pulsed()) {
+        throw interrupted_exc_t();
+    }
+
+    if (rows.size() > num) {
+        std::nth_element(rows.begin(), rows.begin() + num, rows.end(),
+                         [](const sample_read_response_t::keyed_row_t &a,
+                            const sample_read_response_t::keyed_row_t &b) {
+                             return a.first > b.first;
+                         });
+        rows.resize(num);
+    }
+    response->rows = std::move(rows);
+}
+
 static const int8_t HAS_VALUE = 0;
 static const int8_t HAS_NO_VALUE = 1;
 
@@ -1102,7 +1918,8 @@ void rdb_modification_report_cb_t::on_mod_report(
                     new_keys,
                     report.primary_key,
                     report.info.deleted.first,
-                    report.info.added.first}),
+                    report.info.added.first,
+                    0}),
             report.primary_key);
         sindexes_updated_cond.wait_lazily_unordered();
     }
@@ -1131,6 +1948,7 @@ void rdb_modification_report_cb_t::on_mod_report_sub(
 
 std::vector<std::string> expand_geo_key(
         reql_version_t reql_version,
+        sindex_geo_bool_t geo,
         const ql::datum_t &key,
         const store_key_t &primary_key,
         boost::optional<uint64_t> tag_num) {
@@ -1140,6 +1958,14 @@ std::vector<std::string> expand_geo_key(
     if (!key.is_ptype(ql::pseudo::geometry_string)) {
         return std::vector<std::string>();
     }
+    // Likewise, points-only indexes ignore lines and polygons.
+    if (geo == sindex_geo_bool_t::GEO_POINTS) {
+        ql::datum_t type = key.get_field("type", ql::NOTHROW);
+        if (!type.has() || type.get_type() != ql::datum_t::R_STR
+            || type.as_str() != "Point") {
+            return std::vector<std::string>();
+        }
+    }
 
     try {
         std::vector<std::string> grid_keys =
@@ -1172,31 +1998,28 @@ std::vector<std::string> expand_geo_key(
     }
 }
 
+// `sindex_env` must have been set up like in the other `compute_keys`.  Passing it
+// in lets the caller evaluate the function on several documents with one environment.
 void compute_keys(const store_key_t &primary_key,
                   ql::datum_t doc,
                   const sindex_disk_info_t &index_info,
+                  ql::env_t *sindex_env,
                   std::vector<std::pair<store_key_t, ql::datum_t> > *keys_out) {
     guarantee(keys_out->empty());
 
     const reql_version_t reql_version =
         index_info.mapping_version_info.latest_compatible_reql_version;
 
-    // Secondary index functions are deterministic (so no need for an rdb_context_t)
-    // and evaluated in a pristine environment (without global optargs).
-    cond_t non_interruptor;
-    ql::env_t sindex_env(&non_interruptor,
-                         ql::return_empty_normal_batches_t::NO,
-                         reql_version);
-
     ql::datum_t index =
-        index_info.mapping.compile_wire_func()->call(&sindex_env, doc)->as_datum();
+        index_info.mapping.compile_wire_func()->call(sindex_env, doc)->as_datum();
 
     if (index_info.multi == sindex_multi_bool_t::MULTI
         && index.get_type() == ql::datum_t::R_ARRAY) {
         for (uint64_t i = 0; i < index.arr_size(); ++i) {
             const ql::datum_t &skey = index.get(i, ql::THROW);
-            if (index_info.geo == sindex_geo_bool_t::GEO) {
+            if (index_info.geo != sindex_geo_bool_t::REGULAR) {
                 std::vector<std::string> geo_keys = expand_geo_key(reql_version,
+                                                                   index_info.geo,
                                                                    skey,
                                                                    primary_key,
                                                                    i);
@@ -1213,8 +2036,9 @@ void compute_keys(const store_key_t &primary_key,
             }
         }
     } else {
-        if (index_info.geo == sindex_geo_bool_t::GEO) {
+        if (index_info.geo != sindex_geo_bool_t::REGULAR) {
             std::vector<std::string> geo_keys = expand_geo_key(reql_version,
+                                                               index_info.geo,
                                                                index,
                                                                primary_key,
                                                                boost::none);
@@ -1232,6 +2056,19 @@ void compute_keys(const store_key_t &primary_key,
     }
 }
 
+void compute_keys(const store_key_t &primary_key,
+                  ql::datum_t doc,
+                  const sindex_disk_info_t &index_info,
+                  std::vector<std::pair<store_key_t, ql::datum_t> > *keys_out) {
+    // Secondary index functions are deterministic (so no need for an rdb_context_t)
+    // and evaluated in a pristine environment (without global optargs).
+    cond_t non_interruptor;
+    ql::env_t sindex_env(&non_interruptor,
+                         ql::return_empty_normal_batches_t::NO,
+                         index_info.mapping_version_info.latest_compatible_reql_version);
+    compute_keys(primary_key, doc, index_info, &sindex_env, keys_out);
+}
+
 void serialize_sindex_info(write_message_t *wm,
                            const sindex_disk_info_t &info) {
     serialize_cluster_version(wm, cluster_version_t::LATEST_DISK);
@@ -1245,6 +2082,7 @@ void serialize_sindex_info(write_message_t *wm,
     serialize<cluster_version_t::LATEST_DISK>(wm, info.mapping);
     serialize<cluster_version_t::LATEST_DISK>(wm, info.multi);
     serialize<cluster_version_t::LATEST_DISK>(wm, info.geo);
+    serialize<cluster_version_t::LATEST_DISK>(wm, info.values);
 }
 
 void deserialize_sindex_info(const std::vector<char> &data,
@@ -1271,7 +2109,8 @@ void deserialize_sindex_info(const std::vector<char> &data,
     case cluster_version_t::v1_14:
     case cluster_version_t::v1_15:
     case cluster_version_t::v1_16:
-    case cluster_version_t::v2_0_is_latest:
+    case cluster_version_t::v2_0:
+    case cluster_version_t::v2_1_is_latest:
         success = deserialize_for_version(
                 cluster_version,
                 &read_stream,
@@ -1305,19 +2144,203 @@ void deserialize_sindex_info(const std::vector<char> &data,
         success = deserialize_for_version(cluster_version, &read_stream, &info_out->geo);
         throw_if_bad_deserialization(success, "sindex description");
     }
+    if (cluster_version == cluster_version_t::v1_13
+        || cluster_version == cluster_version_t::v1_13_2
+        || cluster_version == cluster_version_t::v1_14
+        || cluster_version == cluster_version_t::v1_15
+        || cluster_version == cluster_version_t::v1_16
+        || cluster_version == cluster_version_t::v2_0) {
+        info_out->values = sindex_values_bool_t::DOCUMENT;
+    } else {
+        success = deserialize_for_version(cluster_version, &read_stream,
+                                          &info_out->values);
+        throw_if_bad_deserialization(success, "sindex description");
+    }
 
     guarantee(static_cast<size_t>(read_stream.tell()) == data.size(),
               "An sindex description was incompletely deserialized.");
 }
 
+/* Sets the secondary index entry `key` for the row whose primary index value is
+`row_value_ref`.  Unless the index only stores primary keys, the entry shares the
+row's blob. */
+MUST_USE ql::serialization_result_t
+sindex_kv_location_set(keyvalue_location_t *kv_location,
+                       const store_key_t &key,
+                       const std::vector<char> &row_value_ref,
+                       const sindex_disk_info_t &sindex_info,
+                       const deletion_context_t *deletion_context) {
+    if (sindex_info.values == sindex_values_bool_t::PRIMARY_KEY) {
+        // The primary key is a part of `key`, so there's nothing left to store.
+        return kv_location_set(kv_location, key, ql::datum_t::null(),
+                               repli_timestamp_t::distant_past, deletion_context,
+                               NULL);
+    }
+    return kv_location_set(kv_location, key, row_value_ref,
+                           repli_timestamp_t::distant_past, deletion_context);
+}
+
+/* Deserializing a sindex definition deserializes and compiles its function, which
+can cost more than the sindex update of a small write.  So every thread remembers
+the definitions of up to `MAX_CACHED_SINDEX_INFOS` sindexes that it has recently
+updated.  The entries are looked up by sindex id and checked against the serialized
+definition, which changes when the sindex gets migrated to a newer ReQL version.
+Entries of dropped sindexes are removed by `forget_cached_sindex_info()`. */
+class sindex_info_cache_t {
+public:
+    sindex_disk_info_t get(const secondary_index_t &sindex) {
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->id == sindex.id) {
+                if (it->definition == sindex.opaque_definition) {
+                    return it->info;
+                }
+                // The sindex was migrated, so the entry is out of date.
+                entries.erase(it);
+                break;
+            }
+        }
+        entry_t entry;
+        entry.id = sindex.id;
+        entry.definition = sindex.opaque_definition;
+        try {
+            deserialize_sindex_info(entry.definition, &entry.info);
+        } catch (const archive_exc_t &e) {
+            crash("%s", e.what());
+        }
+        if (entries.size() >= MAX_CACHED_SINDEX_INFOS) {
+            entries.pop_front();
+        }
+        entries.push_back(entry);
+        return entry.info;
+    }
+    void forget(uuid_u id) {
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it->id == id) {
+                entries.erase(it);
+                return;
+            }
+        }
+    }
+private:
+    static const size_t MAX_CACHED_SINDEX_INFOS = 64;
+    struct entry_t {
+        uuid_u id;
+        std::vector<char> definition;
+        sindex_disk_info_t info;
+    };
+    std::deque<entry_t> entries;
+};
+
+TLS_with_init(sindex_info_cache_t *, sindex_info_cache, NULL);
+
+static sindex_disk_info_t get_cached_sindex_info(const secondary_index_t &sindex) {
+    sindex_info_cache_t *cache = TLS_get_sindex_info_cache();
+    if (cache == NULL) {
+        // This is never freed, like other per-thread state.
+        cache = new sindex_info_cache_t();
+        TLS_set_sindex_info_cache(cache);
+    }
+    return cache->get(sindex);
+}
+
+void forget_cached_sindex_info(uuid_u sindex_id) {
+    sindex_info_cache_t *cache = TLS_get_sindex_info_cache();
+    if (cache != NULL) {
+        cache->forget(sindex_id);
+    }
+}
+
 /* Used below by rdb_update_sindexes. */
+/* Calls `change` with the `keyvalue_location_t` of each of `keys`, which must be
+sorted.  The keys of a multi index entry mostly go into the same few leaves, so we
+only walk down from the superblock again when `find_keyvalue_location_in_same_leaf`
+can't show that a key goes into the leaf that we hold from the previous one (it only
+trusts the leaf's parent if the parent is the root, or if the key is between two of
+the parent's keys).  `change` returns false if it might have merged the leaf with a
+sibling, after which the next key walks down from the superblock again. */
+void apply_sindex_changes_in_key_order(
+        const store_t::sindex_access_t *sindex,
+        const deletion_context_t *deletion_context,
+        const std::vector<const store_key_t *> &keys,
+        profile::trace_t *trace,
+        sindex_superblock_t **superblock,
+        const std::function<bool(const store_key_t &,
+                                 keyvalue_location_t *)> &change) {
+    rdb_value_sizer_t sizer((*superblock)->cache()->max_block_size());
+    for (size_t i = 0; i < keys.size(); ) {
+        promise_t<superblock_t *> return_superblock_local;
+        {
+            keyvalue_location_t kv_location;
+            find_keyvalue_location_for_write(
+                &sizer,
+                *superblock,
+                keys[i]->btree_key(),
+                deletion_context->balancing_detacher(),
+                &kv_location,
+                &sindex->btree->stats,
+                trace,
+                &return_superblock_local);
+            for (;;) {
+                const bool same_leaf = change(*keys[i], &kv_location);
+                ++i;
+                rassert(i == keys.size() || !(*keys[i] < *keys[i - 1]));
+                if (i == keys.size()
+                    || !same_leaf
+                    || !find_keyvalue_location_in_same_leaf(
+                        &sizer, keys[i]->btree_key(), &kv_location)) {
+                    break;
+                }
+            }
+            // The keyvalue location gets destroyed here.
+        }
+        *superblock =
+            static_cast<sindex_superblock_t *>(return_superblock_local.wait());
+    }
+}
+
+/* Sorts `entries` by key and stores each of them in the sindex, with the given
+(serialized) primary row as its value.  Used both for regular sindex updates and
+for post construction. */
+void set_sindex_entries_in_key_order(
+        const store_t::sindex_access_t *sindex,
+        const deletion_context_t *deletion_context,
+        const sindex_disk_info_t &sindex_info,
+        std::vector<std::pair<const store_key_t *, const std::vector<char> *> >
+            *entries,
+        profile::trace_t *trace,
+        sindex_superblock_t **superblock) {
+    std::sort(entries->begin(), entries->end(),
+              [](const std::pair<const store_key_t *, const std::vector<char> *> &a,
+                 const std::pair<const store_key_t *, const std::vector<char> *> &b) {
+                  return *a.first < *b.first;
+              });
+    std::vector<const store_key_t *> keys;
+    keys.reserve(entries->size());
+    for (const auto &entry : *entries) {
+        keys.push_back(entry.first);
+    }
+    // `apply_sindex_changes_in_key_order` calls `change` once for each key, in order.
+    size_t next_entry = 0;
+    apply_sindex_changes_in_key_order(
+        sindex, deletion_context, keys, trace, superblock,
+        [&](const store_key_t &key, keyvalue_location_t *kv_location) {
+            ql::serialization_result_t res =
+                sindex_kv_location_set(kv_location, key,
+                                       *(*entries)[next_entry].second,
+                                       sindex_info, deletion_context);
+            ++next_entry;
+            // this particular context cannot fail AT THE MOMENT.
+            guarantee(!bad(res));
+            return true;
+        });
+}
+
 void rdb_update_single_sindex(
         store_t *store,
         const store_t::sindex_access_t *sindex,
         const deletion_context_t *deletion_context,
         const rdb_modification_report_t *modification,
         size_t *updates_left,
-        auto_drainer_t::lock_t,
         cond_t *keys_available_cond,
         std::vector<ql::datum_t> *old_keys_out,
         std::vector<ql::datum_t> *new_keys_out) THROWS_NOTHING {
@@ -1330,12 +2353,13 @@ void rdb_update_single_sindex(
     guarantee(old_keys_out == NULL || old_keys_out->size() == 0);
     guarantee(new_keys_out == NULL || new_keys_out->size() == 0);
 
-    sindex_disk_info_t sindex_info;
-    try {
-        deserialize_sindex_info(sindex->sindex.opaque_definition, &sindex_info);
-    } catch (const archive_exc_t &e) {
-        crash("%s", e.what());
-    }
+    const sindex_disk_info_t sindex_info = get_cached_sindex_info(sindex->sindex);
+    // The old and the new version of the row are evaluated in the same environment.
+    // See the comment in `compute_keys`.
+    cond_t non_interruptor;
+    ql::env_t sindex_env(&non_interruptor,
+                         ql::return_empty_normal_batches_t::NO,
+                         sindex_info.mapping_version_info.latest_compatible_reql_version);
     // TODO(2015-01): Actually get real profiling information for
     // secondary index updates.
     profile::trace_t *const trace = nullptr;
@@ -1345,13 +2369,46 @@ void rdb_update_single_sindex(
     ql::changefeed::server_t *server =
         store->changefeed_server.has() ? store->changefeed_server.get() : NULL;
 
+    // If the secondary index is being deleted, we don't add any new values to
+    // the sindex tree.
+    // This is so we don't race against any sindex erase about who is faster
+    // (we with inserting new entries, or the erase with removing them).
+    const bool sindex_is_being_deleted = sindex->sindex.being_deleted;
+
+    /* When a row is replaced, most of its index keys usually stay the same (an
+    update of a field that the index doesn't look at keeps all of them).  Those
+    entries are overwritten by the new ones instead of being deleted first, and if
+    the index only stores primary keys, they are left alone altogether.  That's why we
+    compute the new keys before deleting the old ones. */
+    boost::optional<std::vector<std::pair<store_key_t, ql::datum_t> > > added_keys;
+    std::set<store_key_t> added_key_set;
+    if (!sindex_is_being_deleted
+        && modification->info.deleted.first.has()
+        && modification->info.added.first.has()) {
+        try {
+            std::vector<std::pair<store_key_t, ql::datum_t> > keys;
+            compute_keys(modification->primary_key, modification->info.added.first,
+                         sindex_info, &sindex_env, &keys);
+            for (const auto &pair : keys) {
+                added_key_set.insert(pair.first);
+            }
+            added_keys = std::move(keys);
+        } catch (const ql::base_exc_t &) {
+            // The new version of the row isn't in the index, which we find out
+            // again below.
+        }
+    }
+    // The keys that both versions of the row have.
+    std::set<store_key_t> kept_keys;
+
     if (modification->info.deleted.first.has()) {
         guarantee(!modification->info.deleted.second.empty());
         try {
             ql::datum_t deleted = modification->info.deleted.first;
 
             std::vector<std::pair<store_key_t, ql::datum_t> > keys;
-            compute_keys(modification->primary_key, deleted, sindex_info, &keys);
+            compute_keys(modification->primary_key, deleted, sindex_info, &sindex_env,
+                         &keys);
             if (old_keys_out != NULL) {
                 for (const auto &pair : keys) {
                     old_keys_out->push_back(pair.second);
@@ -1372,35 +2429,29 @@ void rdb_update_single_sindex(
                         }
                     });
             }
+            std::vector<const store_key_t *> deleted_keys;
             for (auto it = keys.begin(); it != keys.end(); ++it) {
-                promise_t<superblock_t *> return_superblock_local;
-                {
-                    keyvalue_location_t kv_location;
-                    rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
-
-                    find_keyvalue_location_for_write(
-                        &sizer,
-                        superblock,
-                        it->first.btree_key(),
-                        deletion_context->balancing_detacher(),
-                        &kv_location,
-                        &sindex->btree->stats,
-                        trace,
-                        &return_superblock_local);
-
-                    if (kv_location.value.has()) {
-                        kv_location_delete(
-                            &kv_location,
-                            it->first,
-                            repli_timestamp_t::distant_past,
-                            deletion_context,
-                            NULL);
-                    }
-                    // The keyvalue location gets destroyed here.
+                if (added_key_set.count(it->first) != 0) {
+                    kept_keys.insert(it->first);
+                } else {
+                    deleted_keys.push_back(&it->first);
                 }
-                superblock =
-                    static_cast<sindex_superblock_t *>(return_superblock_local.wait());
             }
+            std::sort(deleted_keys.begin(), deleted_keys.end(),
+                      [](const store_key_t *a, const store_key_t *b) {
+                          return *a < *b;
+                      });
+            apply_sindex_changes_in_key_order(
+                sindex, deletion_context, deleted_keys, trace, &superblock,
+                [&](const store_key_t &key, keyvalue_location_t *kv_location) {
+                    if (!kv_location->value.has()) {
+                        return true;
+                    }
+                    kv_location_delete(kv_location, key,
+                                       repli_timestamp_t::distant_past,
+                                       deletion_context, NULL);
+                    return false;
+                });
         } catch (const ql::base_exc_t &) {
             // Do nothing (it wasn't actually in the index).
 
@@ -1409,11 +2460,6 @@ void rdb_update_single_sindex(
         }
     }
 
-    // If the secondary index is being deleted, we don't add any new values to
-    // the sindex tree.
-    // This is so we don't race against any sindex erase about who is faster
-    // (we with inserting new entries, or the erase with removing them).
-    const bool sindex_is_being_deleted = sindex->sindex.being_deleted;
     if (!sindex_is_being_deleted && modification->info.added.first.has()) {
         bool decremented_updates_left = false;
         try {
@@ -1421,7 +2467,12 @@ void rdb_update_single_sindex(
 
             std::vector<std::pair<store_key_t, ql::datum_t> > keys;
 
-            compute_keys(modification->primary_key, added, sindex_info, &keys);
+            if (added_keys) {
+                keys = std::move(*added_keys);
+            } else {
+                compute_keys(modification->primary_key, added, sindex_info, &sindex_env,
+                             &keys);
+            }
             if (new_keys_out != NULL) {
                 guarantee(keys_available_cond != NULL);
                 for (const auto &pair : keys) {
@@ -1449,34 +2500,19 @@ void rdb_update_single_sindex(
                         }
                     });
             }
+            std::vector<std::pair<const store_key_t *, const std::vector<char> *> >
+                entries;
             for (auto it = keys.begin(); it != keys.end(); ++it) {
-                promise_t<superblock_t *> return_superblock_local;
-                {
-                    keyvalue_location_t kv_location;
-
-                    rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
-                    find_keyvalue_location_for_write(
-                        &sizer,
-                        superblock,
-                        it->first.btree_key(),
-                        deletion_context->balancing_detacher(),
-                        &kv_location,
-                        &sindex->btree->stats,
-                        trace,
-                        &return_superblock_local);
-
-                    ql::serialization_result_t res =
-                        kv_location_set(&kv_location, it->first,
-                                        modification->info.added.second,
-                                        repli_timestamp_t::distant_past,
-                                        deletion_context);
-                    // this particular context cannot fail AT THE MOMENT.
-                    guarantee(!bad(res));
-                    // The keyvalue location gets destroyed here.
+                if (sindex_info.values == sindex_values_bool_t::PRIMARY_KEY
+                    && kept_keys.count(it->first) != 0) {
+                    // The entry is already there, and it doesn't have a value.
+                    continue;
                 }
-                superblock = static_cast<sindex_superblock_t *>(
-                    return_superblock_local.wait());
+                entries.push_back(
+                    std::make_pair(&it->first, &modification->info.added.second));
             }
+            set_sindex_entries_in_key_order(
+                sindex, deletion_context, sindex_info, &entries, trace, &superblock);
         } catch (const ql::base_exc_t &) {
             // Do nothing (we just drop the row from the index).
 
@@ -1529,32 +2565,28 @@ void rdb_update_sindexes(
     cond_t *keys_available_cond,
     std::map<std::string, std::vector<ql::datum_t> > *old_keys_out,
     std::map<std::string, std::vector<ql::datum_t> > *new_keys_out) {
-    {
-        auto_drainer_t drainer;
-
-        size_t counter = sindexes.size();
-        if (counter == 0 && keys_available_cond != NULL) {
-            keys_available_cond->pulse();
-        }
-        for (const auto &sindex : sindexes) {
-            coro_t::spawn_sometime(
-                std::bind(
-                    &rdb_update_single_sindex,
-                    store,
-                    sindex.get(),
-                    deletion_context,
-                    modification,
-                    &counter,
-                    auto_drainer_t::lock_t(&drainer),
-                    keys_available_cond,
-                    old_keys_out == NULL
-                        ? NULL
-                        : &(*old_keys_out)[sindex->name.name],
-                    new_keys_out == NULL
-                        ? NULL
-                        : &(*new_keys_out)[sindex->name.name]));
-        }
+    size_t counter = sindexes.size();
+    if (counter == 0 && keys_available_cond != NULL) {
+        keys_available_cond->pulse();
     }
+    // The sindexes are separate btrees, so they can be updated concurrently.  None
+    // of the updates waits for the others, so throttling them can't deadlock.
+    throttled_pmap(sindexes.size(), [&](int64_t i) {
+        const store_t::sindex_access_t *sindex = sindexes[i].get();
+        rdb_update_single_sindex(
+            store,
+            sindex,
+            deletion_context,
+            modification,
+            &counter,
+            keys_available_cond,
+            old_keys_out == NULL
+                ? NULL
+                : &(*old_keys_out)[sindex->name.name],
+            new_keys_out == NULL
+                ? NULL
+                : &(*new_keys_out)[sindex->name.name]);
+    }, MAX_CONCURRENT_SINDEX_UPDATES);
 
     /* All of the sindex have been updated now it's time to actually clear the
      * deleted blob if it exists. */
@@ -1564,6 +2596,73 @@ void rdb_update_sindexes(
     }
 }
 
+/* Used below by `rdb_post_construct_sindexes`.  Inserts the rows of one
+post-construction chunk into a single sindex.  The sindex keys of the whole chunk
+are computed first and then inserted in sorted order, so that consecutive
+insertions mostly go into the leaf that we already hold instead of jumping all over
+the tree in primary key order. */
+void rdb_post_construct_single_sindex(
+        const store_t::sindex_access_t *sindex,
+        const deletion_context_t *deletion_context,
+        const std::vector<rdb_modification_report_t> *rows,
+        auto_drainer_t::lock_t) THROWS_NOTHING {
+    // See the comment in `rdb_update_single_sindex`.
+    if (sindex->sindex.being_deleted) {
+        return;
+    }
+
+    sindex_disk_info_t sindex_info;
+    try {
+        deserialize_sindex_info(sindex->sindex.opaque_definition, &sindex_info);
+    } catch (const archive_exc_t &e) {
+        crash("%s", e.what());
+    }
+
+    // `keys` owns the sindex keys that `entries` points into.  A deque, so that
+    // they don't move while we add more.
+    std::deque<store_key_t> keys;
+    std::vector<std::pair<const store_key_t *, const std::vector<char> *> > entries;
+    for (auto row = rows->begin(); row != rows->end(); ++row) {
+        guarantee(row->info.added.first.has());
+        std::vector<std::pair<store_key_t, ql::datum_t> > row_keys;
+        try {
+            compute_keys(row->primary_key, row->info.added.first, sindex_info,
+                         &row_keys);
+        } catch (const ql::base_exc_t &) {
+            // Do nothing (we just drop the row from the index).
+            continue;
+        }
+        for (auto it = row_keys.begin(); it != row_keys.end(); ++it) {
+            keys.push_back(std::move(it->first));
+            entries.push_back(std::make_pair(&keys.back(), &row->info.added.second));
+        }
+    }
+
+    // There are no changefeeds to update here: limit changefeeds can't be opened
+    // on an index until its post construction has finished.
+    sindex_superblock_t *superblock = sindex->superblock.get();
+    set_sindex_entries_in_key_order(
+        sindex, deletion_context, sindex_info, &entries, nullptr, &superblock);
+}
+
+/* Applies a chunk of freshly read rows to all sindexes that are being post
+constructed.  Like `rdb_update_sindexes`, the sindexes are updated concurrently. */
+void rdb_post_construct_sindexes(
+        const store_t::sindex_access_vector_t &sindexes,
+        const std::vector<rdb_modification_report_t> &rows,
+        const deletion_context_t *deletion_context) {
+    auto_drainer_t drainer;
+    for (const auto &sindex : sindexes) {
+        coro_t::spawn_sometime(
+            std::bind(
+                &rdb_post_construct_single_sindex,
+                sindex.get(),
+                deletion_context,
+                &rows,
+                auto_drainer_t::lock_t(&drainer)));
+    }
+}
+
 class post_construct_traversal_helper_t : public btree_traversal_helper_t {
 public:
     post_construct_traversal_helper_t(
@@ -1587,99 +2686,96 @@ public:
         buf_read_t leaf_read(leaf_node_buf);
         const leaf_node_t *leaf_node
             = static_cast<const leaf_node_t *>(leaf_read.get_data_read());
+        const max_block_size_t block_size = leaf_node_buf->cache()->max_block_size();
 
         // Number of key/value pairs we process before yielding
-        const int MAX_CHUNK_SIZE = 10;
-        int current_chunk_size = 0;
+        const size_t MAX_CHUNK_SIZE = 32;
         const rdb_post_construction_deletion_context_t deletion_context;
-        for (auto it = leaf::begin(*leaf_node); it != leaf::end(*leaf_node); ++it) {
-            if (current_chunk_size == 0) {
-                // Start a write transaction and acquire the secondary index
-                // at the beginning of each chunk. We reset the transaction
-                // after each chunk because large write transactions can cause
-                // the cache to go into throttling, and that would interfere
-                // with other transactions on this table.
-                try {
-                    write_token_t token;
-                    store_->new_write_token(&token);
-
-                    scoped_ptr_t<real_superblock_t> superblock;
-
-                    // We use HARD durability because we want post construction
-                    // to be throttled if we insert data faster than it can
-                    // be written to disk. Otherwise we might exhaust the cache's
-                    // dirty page limit and bring down the whole table.
-                    // Other than that, the hard durability guarantee is not actually
-                    // needed here.
-                    store_->acquire_superblock_for_write(
-                            repli_timestamp_t::distant_past,
-                            2 + MAX_CHUNK_SIZE,
-                            write_durability_t::HARD,
-                            &token,
-                            &wtxn,
-                            &superblock,
-                            interruptor_);
-
-                    // Acquire the sindex block.
-                    const block_id_t sindex_block_id = superblock->get_sindex_block_id();
-
-                    buf_lock_t sindex_block(superblock->expose_buf(), sindex_block_id,
-                                            access_t::write);
-
-                    superblock.reset();
-
-                    store_->acquire_sindex_superblocks_for_write(
-                            sindexes_to_post_construct_,
-                            &sindex_block,
-                            &sindexes);
-
-                    if (sindexes.empty()) {
-                        interrupt_myself_->pulse_if_not_already_pulsed();
-                        return;
-                    }
-                } catch (const interrupted_exc_t &e) {
+        std::vector<rdb_modification_report_t> chunk;
+        chunk.reserve(MAX_CHUNK_SIZE);
+        auto it = leaf::begin(*leaf_node);
+        while (it != leaf::end(*leaf_node)) {
+            // Load the rows of the next chunk before acquiring any write locks.
+            // Reading large values can block on disk, and we don't want the other
+            // leaves that are being traversed concurrently to wait for that.
+            chunk.clear();
+            for (; it != leaf::end(*leaf_node) && chunk.size() < MAX_CHUNK_SIZE;
+                 ++it) {
+                store_->btree->stats.record_keys_read(1);
+
+                /* Grab relevant values from the leaf node. */
+                const btree_key_t *key = (*it).first;
+                const void *value = (*it).second;
+                guarantee(key);
+
+                chunk.push_back(rdb_modification_report_t(store_key_t(key)));
+                rdb_modification_report_t *mod_report = &chunk.back();
+                const rdb_value_t *rdb_value = static_cast<const rdb_value_t *>(value);
+                mod_report->info.added
+                    = std::make_pair(
+                        get_data(rdb_value, buf_parent_t(leaf_node_buf)),
+                        std::vector<char>(rdb_value->value_ref(),
+                            rdb_value->value_ref() + rdb_value->inline_size(block_size)));
+            }
+
+            // Start a write transaction and acquire the secondary index
+            // for each chunk. We reset the transaction
+            // after each chunk because large write transactions can cause
+            // the cache to go into throttling, and that would interfere
+            // with other transactions on this table.
+            try {
+                write_token_t token;
+                store_->new_write_token(&token);
+
+                scoped_ptr_t<real_superblock_t> superblock;
+
+                // We use HARD durability because we want post construction
+                // to be throttled if we insert data faster than it can
+                // be written to disk. Otherwise we might exhaust the cache's
+                // dirty page limit and bring down the whole table.
+                // Other than that, the hard durability guarantee is not actually
+                // needed here.
+                store_->acquire_superblock_for_write(
+                        repli_timestamp_t::distant_past,
+                        2 + MAX_CHUNK_SIZE,
+                        write_durability_t::HARD,
+                        &token,
+                        &wtxn,
+                        &superblock,
+                        interruptor_);
+
+                // Acquire the sindex block.
+                const block_id_t sindex_block_id = superblock->get_sindex_block_id();
+
+                buf_lock_t sindex_block(superblock->expose_buf(), sindex_block_id,
+                                        access_t::write);
+
+                superblock.reset();
+
+                store_->acquire_sindex_superblocks_for_write(
+                        sindexes_to_post_construct_,
+                        &sindex_block,
+                        &sindexes);
+
+                if (sindexes.empty()) {
+                    interrupt_myself_->pulse_if_not_already_pulsed();
                     return;
                 }
+            } catch (const interrupted_exc_t &e) {
+                return;
             }
 
-            store_->btree->stats.pm_keys_read.record();
-            store_->btree->stats.pm_total_keys_read += 1;
-
-            /* Grab relevant values from the leaf node. */
-            const btree_key_t *key = (*it).first;
-            const void *value = (*it).second;
-            guarantee(key);
-
-            const store_key_t pk(key);
-            rdb_modification_report_t mod_report(pk);
-            const rdb_value_t *rdb_value = static_cast<const rdb_value_t *>(value);
-            const max_block_size_t block_size = leaf_node_buf->cache()->max_block_size();
-            mod_report.info.added
-                = std::make_pair(
-                    get_data(rdb_value, buf_parent_t(leaf_node_buf)),
-                    std::vector<char>(rdb_value->value_ref(),
-                        rdb_value->value_ref() + rdb_value->inline_size(block_size)));
-
-            rdb_update_sindexes(store_,
-                                sindexes,
-                                &mod_report,
-                                wtxn.get(),
-                                &deletion_context,
-                                NULL,
-                                NULL,
-                                NULL);
-            store_->btree->stats.pm_keys_set.record();
-            store_->btree->stats.pm_total_keys_set += 1;
-
-            ++current_chunk_size;
-            if (current_chunk_size >= MAX_CHUNK_SIZE) {
-                current_chunk_size = 0;
-                // Release the write transaction and yield.
-                // We continue later where we have left off.
-                sindexes.clear();
-                wtxn.reset();
-                coro_t::yield();
+            rdb_post_construct_sindexes(sindexes, chunk, &deletion_context);
+            for (size_t i = 0; i < chunk.size(); ++i) {
+                store_->btree->stats.pm_keys_set.record();
             }
+            store_->btree->stats.pm_total_keys_set += chunk.size();
+
+            // Release the write transaction and yield.
+            // We continue later where we have left off.
+            sindexes.clear();
+            wtxn.reset();
+            coro_t::yield();
         }
     }
 
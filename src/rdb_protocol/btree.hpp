@@ -65,6 +65,14 @@ void rdb_get(
     point_read_response_t *response,
     profile::trace_t *trace);
 
+// `keys` must be sorted.  Releases the superblock when it's done.
+void rdb_get_multi(
+    const std::vector<store_key_t> &keys,
+    btree_slice_t *slice,
+    superblock_t *superblock,
+    multi_point_read_response_t *response,
+    profile::trace_t *trace);
+
 struct btree_info_t {
     btree_info_t(btree_slice_t *_slice,
                  repli_timestamp_t _timestamp,
@@ -78,20 +86,6 @@ struct btree_info_t {
     const datum_string_t primary_key;
 };
 
-struct btree_loc_info_t {
-    btree_loc_info_t(const btree_info_t *_btree,
-                     real_superblock_t *_superblock,
-                     const store_key_t *_key)
-        : btree(_btree), superblock(_superblock), key(_key) {
-        guarantee(btree != NULL);
-        guarantee(superblock != NULL);
-        guarantee(key != NULL);
-    }
-    const btree_info_t *const btree;
-    real_superblock_t *const superblock;
-    const store_key_t *const key;
-};
-
 struct btree_batched_replacer_t {
     virtual ~btree_batched_replacer_t() { }
     virtual ql::datum_t replace(
@@ -160,6 +154,24 @@ void rdb_delete(const store_key_t &key, btree_slice_t *slice, repli_timestamp_t
                 rdb_modification_info_t *mod_info,
                 profile::trace_t *trace);
 
+/* Counts the rows of a primary btree that are in `range` from the population in its
+stat block, instead of traversing the btree.  That's only possible if all of the
+btree's rows are in `range`, which we check by looking up its first and last row.
+Returns false if it isn't possible.  Like a traversal, the count includes writes that
+have been applied, and may or may not include ones that are being applied. */
+bool rdb_count_from_stat_block(superblock_t *superblock,
+                               const key_range_t &range,
+                               uint64_t *count_out);
+
+// How many rows a range read passed to its transforms, and how many came out of them.
+struct rget_scan_counts_t {
+    rget_scan_counts_t() : rows_scanned(0), rows_returned(0) { }
+    uint64_t rows_scanned;
+    uint64_t rows_returned;
+};
+
+/* If `counts_out` isn't `NULL`, the rows that the read looks at and returns are
+added to it. */
 void rdb_rget_slice(
     btree_slice_t *slice,
     const key_range_t &range,
@@ -170,7 +182,8 @@ void rdb_rget_slice(
     const boost::optional<ql::terminal_variant_t> &terminal,
     sorting_t sorting,
     rget_read_response_t *response,
-    release_superblock_t release_superblock);
+    release_superblock_t release_superblock,
+    rget_scan_counts_t *counts_out = NULL);
 
 void rdb_rget_secondary_slice(
     btree_slice_t *slice,
@@ -185,7 +198,21 @@ void rdb_rget_secondary_slice(
     sorting_t sorting,
     const sindex_disk_info_t &sindex_info,
     rget_read_response_t *response,
-    release_superblock_t release_superblock);
+    release_superblock_t release_superblock,
+    const std::set<store_key_t> *pkey_filter = NULL,
+    // Required if the index only stores primary keys, to read the rows from.
+    btree_slice_t *primary_slice = NULL,
+    superblock_t *primary_superblock = NULL);
+
+// Collects the primary keys (within `pk_range`) of the rows in `sindex_region` of a
+// secondary index, without loading the rows.  Returns false if there are more
+// than `max_keys` of them.
+bool rdb_collect_sindex_primary_keys(
+    const region_t &sindex_region,
+    sindex_superblock_t *superblock,
+    const key_range_t &pk_range,
+    size_t max_keys,
+    std::set<store_key_t> *keys_out);
 
 void rdb_get_intersecting_slice(
     btree_slice_t *slice,
@@ -217,6 +244,16 @@ void rdb_distribution_get(int max_depth,
                           real_superblock_t *superblock,
                           distribution_read_response_t *response);
 
+/* Picks up to `num` random rows in `range` of the primary btree, each with a sort key
+for `read_t::unshard()`.  Trees that hold more than a few times `num` rows are sampled
+by descending from the root at random rather than by reading them. */
+void rdb_sample_slice(superblock_t *superblock,
+                      const key_range_t &range,
+                      uint64_t num,
+                      signal_t *interruptor,
+                      sample_read_response_t *response)
+    THROWS_ONLY(interrupted_exc_t);
+
 /* Secondary Indexes */
 
 struct rdb_modification_info_t {
@@ -277,13 +314,15 @@ struct sindex_disk_info_t {
     sindex_disk_info_t(const ql::map_wire_func_t &_mapping,
                        const sindex_reql_version_info_t &_mapping_version_info,
                        sindex_multi_bool_t _multi,
-                       sindex_geo_bool_t _geo) :
+                       sindex_geo_bool_t _geo,
+                       sindex_values_bool_t _values = sindex_values_bool_t::DOCUMENT) :
         mapping(_mapping), mapping_version_info(_mapping_version_info),
-        multi(_multi), geo(_geo) { }
+        multi(_multi), geo(_geo), values(_values) { }
     ql::map_wire_func_t mapping;
     sindex_reql_version_info_t mapping_version_info;
     sindex_multi_bool_t multi;
     sindex_geo_bool_t geo;
+    sindex_values_bool_t values;
 };
 
 void serialize_sindex_info(write_message_t *wm,
@@ -294,6 +333,10 @@ void deserialize_sindex_info(const std::vector<char> &data,
                              sindex_disk_info_t *info_out)
     THROWS_ONLY(archive_exc_t);
 
+// Drops what the calling thread has cached about the sindex `sindex_id` while
+// updating it.  To be called once the sindex is gone.
+void forget_cached_sindex_info(uuid_u sindex_id);
+
 /* An rdb_modification_cb_t is passed to BTree operations and allows them to
  * modify the secondary while they perform an operation. */
 class superblock_queue_t;
@@ -1,10 +1,12 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/store.hpp"  // NOLINT(build/include_order)
 
+#include <algorithm>  // NOLINT(build/include_order)
 #include <functional>  // NOLINT(build/include_order)
 
 #include "arch/runtime/coroutines.hpp"
 #include "btree/depth_first_traversal.hpp"
+#include "btree/key_filter.hpp"
 #include "btree/node.hpp"
 #include "btree/operations.hpp"
 #include "btree/reql_specific.hpp"
@@ -95,11 +97,17 @@ store_t::store_t(serializer_t *serializer,
                         ? NULL
                         : new ql::changefeed::server_t(ctx->manager)),
       index_report(std::move(_index_report)),
+      unindexed_scan_stats_membership(&perfmon_collection, &unindexed_scan_stats,
+                                      "unindexed_scans"),
       table_id(_table_id),
       write_superblock_acq_semaphore(WRITE_SUPERBLOCK_ACQ_WAITERS_LIMIT)
 {
     cache.init(new cache_t(serializer, balancer, &perfmon_collection));
+    // The shards of a table share the table's cache quota.
+    cache->set_quota_group(table_id);
     general_cache_conn.init(new cache_conn_t(cache.get()));
+    batch_query_cache_account
+        = cache->create_cache_account(BATCH_QUERY_CACHE_PRIORITY);
 
     if (create) {
         vector_stream_t key;
@@ -126,7 +134,8 @@ store_t::store_t(serializer_t *serializer,
                                  "primary",
                                  index_type_t::PRIMARY));
 
-    // Initialize sindex slices
+    // Initialize sindex slices, and find out how big the key filter should be
+    uint64_t population = 0;
     {
         // Since this is the btree constructor, nothing else should be locking these
         // things yet, so this should work fairly quickly and does not need a real
@@ -166,9 +175,17 @@ store_t::store_t(serializer_t *serializer,
         }
 
         update_outdated_sindex_list(&sindex_block);
+
+        if (key_filters_enabled()) {
+            if (!rdb_count_from_stat_block(superblock.get(), key_range_t::universe(),
+                                           &population)) {
+                population = 0;
+            }
+        }
     }
 
     help_construct_bring_sindexes_up_to_date();
+    maybe_rebuild_primary_key_filter(population);
 }
 
 store_t::~store_t() {
@@ -220,6 +237,9 @@ void store_t::write(
                               real_superblock.get());
     scoped_ptr_t<real_superblock_t> superblock(real_superblock.release());
     protocol_write(write, response, timestamp, &superblock, interruptor);
+
+    // The key filter fills up as rows are inserted.
+    maybe_rebuild_primary_key_filter(btree->key_filter.count());
 }
 
 // TODO: Figure out wtf does the backfill filtering, figure out wtf constricts delete range operations to hit only a certain hash-interval, figure out what filters keys.
@@ -259,8 +279,12 @@ void store_t::throttle_backfill_chunk(signal_t *interruptor)
     // time. We pause backfilling while any index post construction is going on on
     // this store by acquiring a read lock on `backfill_postcon_lock`.
     rwlock_in_line_t lock_acq(&backfill_postcon_lock, access_t::read);
-    wait_any_t waiter(lock_acq.read_signal(), interruptor);
-    waiter.wait_lazily_ordered();
+    // Usually no post construction is in line and we get the lock right away, so
+    // only set up the combined waiter when we actually have to wait.
+    if (!lock_acq.read_signal()->is_pulsed()) {
+        wait_any_t waiter(lock_acq.read_signal(), interruptor);
+        waiter.wait_lazily_ordered();
+    }
     if (interruptor->is_pulsed()) {
         throw interrupted_exc_t();
     }
@@ -367,6 +391,44 @@ void store_t::maybe_drop_all_sindexes(const binary_blob_t &zero_metainfo,
     }
 }
 
+static const char *const DETACHED_SUBTREES_PREFIX = "_DETACHED_";
+
+/* `reset_data()` lists the subtrees that it has cut out of the primary btree but that
+haven't been freed yet in the sindex block, under a name made by
+`compute_detached_subtrees_name()`. The entry has no superblock, and its
+`opaque_definition` holds the serialized block ids. */
+static sindex_name_t compute_detached_subtrees_name(uuid_u id) {
+    sindex_name_t result(DETACHED_SUBTREES_PREFIX + uuid_to_str(id));
+    result.being_deleted = true;
+    return result;
+}
+
+bool store_t::is_detached_subtrees_name(const sindex_name_t &name) {
+    return name.being_deleted
+        && name.name.compare(0, strlen(DETACHED_SUBTREES_PREFIX),
+                             DETACHED_SUBTREES_PREFIX) == 0;
+}
+
+static std::vector<char> serialize_block_ids(const std::vector<block_id_t> &block_ids) {
+    write_message_t wm;
+    serialize<cluster_version_t::LATEST_DISK>(&wm, block_ids);
+    vector_stream_t stream;
+    stream.reserve(wm.size());
+    int res = send_write_message(&stream, &wm);
+    guarantee(res == 0);
+    return stream.vector();
+}
+
+static std::vector<block_id_t> deserialize_block_ids(const std::vector<char> &data) {
+    std::vector<block_id_t> block_ids;
+    buffer_read_stream_t read_stream(data.data(), data.size());
+    archive_result_t res
+        = deserialize<cluster_version_t::LATEST_DISK>(&read_stream, &block_ids);
+    guarantee_deserialization(res, "detached subtrees");
+    guarantee(static_cast<size_t>(read_stream.tell()) == data.size());
+    return block_ids;
+}
+
 void store_t::reset_data(
         const binary_blob_t &zero_metainfo,
         const region_t &subregion,
@@ -380,6 +442,77 @@ void store_t::reset_data(
     // for any ranges.
     maybe_drop_all_sindexes(zero_metainfo, durability, interruptor);
 
+    // If no live secondary index has to hear about the erased rows, cut the subtrees
+    // that lie entirely inside the region out of the btree in one go, and free
+    // their blocks in the background.
+    {
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+
+        // Only the nodes along the boundaries of the region change.
+        const int expected_change_count = 16;
+        write_token_t token;
+        new_write_token(&token);
+        acquire_superblock_for_write(repli_timestamp_t::distant_past,
+                                     expected_change_count,
+                                     durability,
+                                     &token,
+                                     &txn,
+                                     &superblock,
+                                     interruptor);
+
+        buf_lock_t sindex_block(superblock->expose_buf(),
+                                superblock->get_sindex_block_id(),
+                                access_t::write);
+        std::map<sindex_name_t, secondary_index_t> sindexes;
+        ::get_secondary_indexes(&sindex_block, &sindexes);
+
+        bool has_live_sindexes = false;
+        for (auto const &sindex : sindexes) {
+            if (!sindex.first.being_deleted) {
+                has_live_sindexes = true;
+            }
+        }
+
+        if (!has_live_sindexes) {
+            rdb_value_deleter_t deleter;
+            std::vector<block_id_t> detached_subtrees;
+            rdb_erase_major_range(subregion.inner,
+                                  superblock.get(),
+                                  &deleter,
+                                  &detached_subtrees);
+
+            // Record the cut subtrees in the same transaction, so that they still
+            // get freed if we restart before `free_detached_subtrees()` is done.
+            boost::optional<sindex_name_t> detached_subtrees_name;
+            if (!detached_subtrees.empty()) {
+                secondary_index_t entry;
+                entry.being_deleted = true;
+                entry.opaque_definition = serialize_block_ids(detached_subtrees);
+                detached_subtrees_name = compute_detached_subtrees_name(entry.id);
+                ::set_secondary_index(&sindex_block, *detached_subtrees_name, entry);
+            }
+            sindex_block.reset_buf_lock();
+
+            region_map_t<binary_blob_t> old_metainfo;
+            get_metainfo_internal(superblock.get(), &old_metainfo);
+            region_map_t<binary_blob_t> new_metainfo = old_metainfo;
+            new_metainfo.set(subregion, zero_metainfo);
+            update_metainfo(old_metainfo, new_metainfo, superblock.get());
+
+            superblock.reset();
+            txn.reset();
+            if (detached_subtrees_name) {
+                coro_t::spawn_sometime(std::bind(&store_t::free_detached_subtrees,
+                                                 this,
+                                                 *detached_subtrees_name,
+                                                 drainer.lock()));
+            }
+            return;
+        }
+        sindex_block.reset_buf_lock();
+    }
+
     // Erase the data in small chunks
     always_true_key_tester_t key_tester;
     const uint64_t max_erased_per_pass = 100;
@@ -434,6 +567,126 @@ void store_t::reset_data(
     }
 }
 
+void store_t::free_detached_subtrees(
+        sindex_name_t name,
+        auto_drainer_t::lock_t store_keepalive)
+        THROWS_NOTHING {
+    with_priority_t p(CORO_PRIORITY_RESET_DATA);
+    rdb_value_deleter_t deleter;
+    const size_t max_freed_per_pass = 32;
+    try {
+        for (bool done = false; !done;) {
+            write_token_t token;
+            new_write_token(&token);
+            scoped_ptr_t<txn_t> txn;
+            scoped_ptr_t<real_superblock_t> superblock;
+            acquire_superblock_for_write(repli_timestamp_t::distant_past,
+                                         max_freed_per_pass + 1,
+                                         write_durability_t::SOFT,
+                                         &token,
+                                         &txn,
+                                         &superblock,
+                                         store_keepalive.get_drain_signal());
+
+            buf_lock_t sindex_block(superblock->expose_buf(),
+                                    superblock->get_sindex_block_id(),
+                                    access_t::write);
+            superblock->release();
+
+            secondary_index_t entry;
+            bool found = ::get_secondary_index(&sindex_block, name, &entry);
+            guarantee(found);
+            std::vector<block_id_t> subtrees
+                = deserialize_block_ids(entry.opaque_definition);
+
+            rdb_free_detached_subtrees(txn.get(), &subtrees, max_freed_per_pass,
+                                       &deleter);
+
+            if (subtrees.empty()) {
+                bool success = ::delete_secondary_index(&sindex_block, name);
+                guarantee(success);
+                // There is only a slice for the entry if it was there at startup.
+                secondary_index_slices.erase(entry.id);
+                done = true;
+            } else {
+                entry.opaque_definition = serialize_block_ids(subtrees);
+                ::set_secondary_index(&sindex_block, name, entry);
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        /* Ignore. The rest of the subtrees will be freed when the store is next
+        started up. */
+    }
+}
+
+void store_t::maybe_rebuild_primary_key_filter(size_t population) {
+    assert_thread();
+    if (btree->key_filter.needs_rebuild()) {
+        btree->key_filter.start_rebuild(
+            std::max<size_t>(PRIMARY_KEY_FILTER_MIN_CAPACITY, 2 * population));
+        coro_t::spawn_sometime(std::bind(&store_t::rebuild_primary_key_filter,
+                                         this,
+                                         drainer.lock()));
+    }
+}
+
+class key_filter_rebuild_callback_t : public depth_first_traversal_callback_t {
+public:
+    key_filter_rebuild_callback_t(key_filter_t *_filter, signal_t *_interruptor)
+        : filter(_filter), interruptor(_interruptor), keys_since_yield(0) { }
+
+    done_traversing_t handle_pair(scoped_key_value_t &&keyvalue) {
+        filter->add(keyvalue.key());
+        // Tables that are in the cache could otherwise keep the thread busy for a
+        // long time.
+        if (++keys_since_yield == KEYS_PER_YIELD) {
+            keys_since_yield = 0;
+            keyvalue.reset();
+            coro_t::yield();
+        }
+        return interruptor->is_pulsed() ? done_traversing_t::YES : done_traversing_t::NO;
+    }
+
+private:
+    static const int KEYS_PER_YIELD = 1000;
+
+    key_filter_t *filter;
+    signal_t *interruptor;
+    int keys_since_yield;
+};
+
+void store_t::rebuild_primary_key_filter(auto_drainer_t::lock_t store_keepalive)
+        THROWS_NOTHING {
+    with_priority_t p(CORO_PRIORITY_SINDEX_CONSTRUCTION);
+    signal_t *interruptor = store_keepalive.get_drain_signal();
+    try {
+        read_token_t token;
+        new_read_token(&token);
+        cache_account_t cache_account;
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> superblock;
+        acquire_superblock_for_read(&token, &txn, &superblock, interruptor,
+                                    true /* USE_SNAPSHOT */);
+        cache_account = txn->cache()->create_cache_account(
+            SINDEX_POST_CONSTRUCTION_CACHE_PRIORITY);
+        txn->set_account(&cache_account);
+
+        key_filter_rebuild_callback_t callback(&btree->key_filter, interruptor);
+        btree_depth_first_traversal(superblock.get(), key_range_t::universe(),
+                                    &callback, direction_t::FORWARD,
+                                    release_superblock_t::RELEASE);
+        superblock.reset();
+        txn.reset();
+        if (interruptor->is_pulsed()) {
+            throw interrupted_exc_t();
+        }
+    } catch (const interrupted_exc_t &) {
+        btree->key_filter.abort_rebuild();
+        return;
+    }
+    btree->key_filter.finish_rebuild();
+}
+
 scoped_ptr_t<new_mutex_in_line_t> store_t::get_in_line_for_sindex_queue(
         buf_lock_t *sindex_block) {
     assert_thread();
@@ -807,6 +1060,7 @@ void store_t::clear_sindex(
         ::delete_secondary_index(&sindex_block, compute_sindex_deletion_name(sindex.id));
         size_t num_erased = secondary_index_slices.erase(sindex.id);
         guarantee(num_erased == 1);
+        forget_cached_sindex_info(sindex.id);
     }
 }
 
@@ -819,6 +1073,7 @@ bool secondary_indexes_are_equivalent(const std::vector<char> &left,
 
     if (sindex_info_left.multi == sindex_info_right.multi &&
         sindex_info_left.geo == sindex_info_right.geo &&
+        sindex_info_left.values == sindex_info_right.values &&
         sindex_info_left.mapping_version_info.original_reql_version ==
             sindex_info_right.mapping_version_info.original_reql_version) {
         // Need to determine if the mapping function is the same, re-serialize them
@@ -1021,7 +1276,8 @@ MUST_USE bool store_t::acquire_sindex_superblock_for_read(
         real_superblock_t *superblock,
         scoped_ptr_t<sindex_superblock_t> *sindex_sb_out,
         std::vector<char> *opaque_definition_out,
-        uuid_u *sindex_uuid_out)
+        uuid_u *sindex_uuid_out,
+        release_superblock_t release_superblock)
     THROWS_ONLY(sindex_not_ready_exc_t) {
     assert_thread();
     rassert(opaque_definition_out != NULL);
@@ -1030,7 +1286,9 @@ MUST_USE bool store_t::acquire_sindex_superblock_for_read(
     /* Acquire the sindex block. */
     buf_lock_t sindex_block(superblock->expose_buf(), superblock->get_sindex_block_id(),
                             access_t::read);
-    superblock->release();
+    if (release_superblock == release_superblock_t::RELEASE) {
+        superblock->release();
+    }
 
     /* Figure out what the superblock for this index is. */
     secondary_index_t sindex;
@@ -1051,6 +1309,69 @@ MUST_USE bool store_t::acquire_sindex_superblock_for_read(
     return true;
 }
 
+MUST_USE bool store_t::acquire_sindex_superblock_for_read(
+        const sindex_name_t &name,
+        const std::string &table_name,
+        real_superblock_t *superblock,
+        scoped_ptr_t<sindex_superblock_t> *sindex_sb_out,
+        std::vector<char> *opaque_definition_out,
+        uuid_u *sindex_uuid_out,
+        const std::function<bool(const std::vector<char> &)> &choose_extra,
+        scoped_ptr_t<sindex_superblock_t> *extra_sb_out,
+        std::vector<char> *extra_definition_out,
+        uuid_u *extra_uuid_out,
+        release_superblock_t release_superblock)
+    THROWS_ONLY(sindex_not_ready_exc_t) {
+    assert_thread();
+    rassert(opaque_definition_out != NULL);
+    rassert(sindex_uuid_out != NULL);
+    rassert(extra_sb_out != NULL && !extra_sb_out->has());
+    rassert(extra_definition_out != NULL);
+    rassert(extra_uuid_out != NULL);
+
+    /* Acquire the sindex block. */
+    buf_lock_t sindex_block(superblock->expose_buf(), superblock->get_sindex_block_id(),
+                            access_t::read);
+    if (release_superblock == release_superblock_t::RELEASE) {
+        superblock->release();
+    }
+
+    std::map<sindex_name_t, secondary_index_t> sindexes;
+    ::get_secondary_indexes(&sindex_block, &sindexes);
+
+    auto it = sindexes.find(name);
+    if (it == sindexes.end()) {
+        return false;
+    }
+    const secondary_index_t &sindex = it->second;
+    *opaque_definition_out = sindex.opaque_definition;
+    *sindex_uuid_out = sindex.id;
+
+    if (!sindex.is_ready()) {
+        throw sindex_not_ready_exc_t(name.name, sindex, table_name);
+    }
+
+    for (auto jt = sindexes.begin(); jt != sindexes.end(); ++jt) {
+        if (jt == it
+            || jt->first.being_deleted
+            || jt->second.being_deleted
+            || !jt->second.is_ready()
+            || !choose_extra(jt->second.opaque_definition)) {
+            continue;
+        }
+        *extra_definition_out = jt->second.opaque_definition;
+        *extra_uuid_out = jt->second.id;
+        buf_lock_t extra_lock(&sindex_block, jt->second.superblock, access_t::read);
+        extra_sb_out->init(new sindex_superblock_t(std::move(extra_lock)));
+        break;
+    }
+
+    buf_lock_t superblock_lock(&sindex_block, sindex.superblock, access_t::read);
+    sindex_block.reset_buf_lock();
+    sindex_sb_out->init(new sindex_superblock_t(std::move(superblock_lock)));
+    return true;
+}
+
 MUST_USE bool store_t::acquire_sindex_superblock_for_write(
         const sindex_name_t &name,
         const std::string &table_name,
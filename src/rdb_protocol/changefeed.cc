@@ -2,14 +2,19 @@
 
 #include <queue>
 
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/memory_tags.hpp"
 #include "boost_utils.hpp"
 #include "btree/reql_specific.hpp"
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/interruptor.hpp"
 #include "containers/archive/boost_types.hpp"
+#include "containers/archive/string_stream.hpp"
 #include "rdb_protocol/artificial_table/backend.hpp"
 #include "rdb_protocol/btree.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/filter_predicate.hpp"
+#include "rdb_protocol/func.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/val.hpp"
 #include "rpc/mailbox/typed.hpp"
@@ -49,42 +54,95 @@ std::string print(const msg_t::limit_change_t &change) {
 } // namespace debug
 
 enum class pop_type_t { RANGE, POINT };
+
+struct queued_change_t {
+    datum_t old_val, new_val;
+    // Only set for resumable changefeeds.
+    datum_t resume_token;
+};
+
+// The size of the buffer `d` points into if it was deserialized, which is the usual
+// case for values that come from the shards.  Those buffers also count as datum
+// buffers, and may be shared with other datums.
+static int64_t datum_buf_size(const datum_t &d) {
+    const shared_buf_ref_t<char> *buf_ref = d.has() ? d.get_buf_ref() : NULL;
+    return buf_ref != NULL ? buf_ref->get_safety_boundary() : 0;
+}
+
+// Roughly the memory a queued change holds on to: the change itself, and the buffers
+// its values point into.
+static int64_t queued_change_size(const datum_t &old_val,
+                                  const datum_t &new_val,
+                                  const datum_t &resume_token) {
+    return sizeof(queued_change_t) + datum_buf_size(old_val)
+        + datum_buf_size(new_val) + datum_buf_size(resume_token);
+}
+
+// Roughly the memory a change in a `server_t`'s change log holds on to.
+static int64_t logged_change_size(const msg_t::change_t &change) {
+    int64_t size = sizeof(msg_t::change_t) + change.pkey.size()
+        + datum_buf_size(change.old_val) + datum_buf_size(change.new_val);
+    for (const auto *indexes : {&change.old_indexes, &change.new_indexes}) {
+        for (const auto &pair : *indexes) {
+            size += pair.first.size() + pair.second.size() * sizeof(datum_t);
+        }
+    }
+    return size;
+}
+
 class maybe_squashing_queue_t {
 public:
+    maybe_squashing_queue_t() : memory(memory_tag_t::changefeed_queues) { }
     virtual ~maybe_squashing_queue_t() { }
-    virtual void add(store_key_t key, datum_t old_val, datum_t new_val) = 0;
+    virtual void add(store_key_t key, datum_t old_val, datum_t new_val,
+                     datum_t resume_token) = 0;
     virtual size_t size() const = 0;
     virtual void clear() = 0;
     virtual datum_t pop() {
-        std::pair<datum_t, datum_t> pair = pop_impl();
+        queued_change_t change = pop_impl();
         std::map<datum_string_t, datum_t> ret;
-        if (pair.first.has()) ret[datum_string_t("old_val")] = pair.first;
-        if (pair.second.has()) ret[datum_string_t("new_val")] = pair.second;
+        if (change.old_val.has()) ret[datum_string_t("old_val")] = change.old_val;
+        if (change.new_val.has()) ret[datum_string_t("new_val")] = change.new_val;
+        if (change.resume_token.has()) {
+            ret[datum_string_t("resume_token")] = change.resume_token;
+        }
         return datum_t(std::move(ret));
     }
+protected:
+    // What the queued changes hold on to, according to `queued_change_size()`.
+    tagged_memory_t memory;
 private:
-    virtual std::pair<datum_t, datum_t> pop_impl() = 0;
+    virtual queued_change_t pop_impl() = 0;
 };
 
 class squashing_queue_t : public maybe_squashing_queue_t {
-    virtual void add(store_key_t key, datum_t old_val, datum_t new_val) {
+    virtual void add(store_key_t key, datum_t old_val, datum_t new_val,
+                     datum_t resume_token) {
+        // Squashing loses the changes a token would resume after.
+        guarantee(!resume_token.has());
         guarantee(old_val.has() || new_val.has());
         if (old_val.has() && new_val.has()) {
             rassert(old_val != new_val);
         }
         auto it = queue.find(key);
         if (it == queue.end()) {
+            memory.add(queued_change_size(old_val, new_val, datum_t()));
             auto pair = std::make_pair(std::move(key),
                                        std::make_pair(std::move(old_val),
                                                       std::move(new_val)));
             it = queue.insert(std::move(pair)).first;
         } else {
+            memory.add(-queued_change_size(
+                           it->second.first, it->second.second, datum_t()));
             if (!it->second.first.has()) {
                 it->second.first = std::move(old_val);
             }
             it->second.second = std::move(new_val);
             if (it->second.first == it->second.second) {
                 queue.erase(it);
+            } else {
+                memory.add(queued_change_size(
+                               it->second.first, it->second.second, datum_t()));
             }
         }
     }
@@ -93,38 +151,46 @@ class squashing_queue_t : public maybe_squashing_queue_t {
     }
     virtual void clear() {
         queue.clear();
+        memory.set(0);
     }
-    virtual std::pair<datum_t, datum_t> pop_impl() {
+    virtual queued_change_t pop_impl() {
         guarantee(size() != 0);
         auto it = queue.begin();
-        auto ret = std::move(it->second);
+        queued_change_t ret{
+            std::move(it->second.first), std::move(it->second.second), datum_t()};
         queue.erase(it);
+        memory.add(-queued_change_size(ret.old_val, ret.new_val, ret.resume_token));
         return ret;
     }
     std::map<store_key_t, std::pair<datum_t, datum_t> > queue;
 };
 
 class nonsquashing_queue_t : public maybe_squashing_queue_t {
-    virtual void add(store_key_t, datum_t old_val, datum_t new_val) {
+    virtual void add(store_key_t, datum_t old_val, datum_t new_val,
+                     datum_t resume_token) {
         guarantee(old_val.has() || new_val.has());
         if (old_val.has() && new_val.has()) {
             rassert(old_val != new_val);
         }
-        queue.emplace_back(std::move(old_val), std::move(new_val));
+        memory.add(queued_change_size(old_val, new_val, resume_token));
+        queue.push_back(queued_change_t{
+            std::move(old_val), std::move(new_val), std::move(resume_token)});
     }
     virtual size_t size() const {
         return queue.size();
     }
     virtual void clear() {
         queue.clear();
+        memory.set(0);
     }
-    virtual std::pair<datum_t, datum_t> pop_impl() {
+    virtual queued_change_t pop_impl() {
         guarantee(size() != 0);
         auto ret = std::move(queue.front());
         queue.pop_front();
+        memory.add(-queued_change_size(ret.old_val, ret.new_val, ret.resume_token));
         return ret;
     }
-    std::deque<std::pair<datum_t, datum_t> > queue;
+    std::deque<queued_change_t> queue;
 };
 
 scoped_ptr_t<maybe_squashing_queue_t> make_maybe_squashing_queue(bool squash) {
@@ -133,13 +199,43 @@ scoped_ptr_t<maybe_squashing_queue_t> make_maybe_squashing_queue(bool squash) {
         : scoped_ptr_t<maybe_squashing_queue_t>(new nonsquashing_queue_t());
 }
 
+datum_t resume_token_to_datum(const std::map<uuid_u, uint64_t> &positions) {
+    std::map<datum_string_t, datum_t> token;
+    for (auto it = positions.begin(); it != positions.end(); ++it) {
+        token[datum_string_t(uuid_to_str(it->first))]
+            = datum_t(static_cast<double>(it->second));
+    }
+    return datum_t(std::move(token));
+}
+
+std::map<uuid_u, uint64_t> parse_resume_token(const datum_t &token) {
+    const std::string err = strprintf("Invalid resume token `%s`.",
+                                      token.print().c_str());
+    rcheck_datum(token.get_type() == datum_t::R_OBJECT && !token.is_ptype()
+                 && token.obj_size() != 0,
+                 base_exc_t::GENERIC, err);
+    std::map<uuid_u, uint64_t> positions;
+    for (size_t i = 0; i < token.obj_size(); ++i) {
+        auto pair = token.get_pair(i);
+        uuid_u uuid;
+        int64_t position;
+        rcheck_datum(str_to_uuid(pair.first.to_std(), &uuid)
+                     && pair.second.get_type() == datum_t::R_NUM
+                     && number_as_integer(pair.second.as_num(), &position)
+                     && position >= 0,
+                     base_exc_t::GENERIC, err);
+        positions[uuid] = position;
+    }
+    return positions;
+}
+
 boost::optional<datum_t> apply_ops(
     const datum_t &val,
     const std::vector<scoped_ptr_t<op_t> > &ops,
     env_t *env,
     const datum_t &key) THROWS_NOTHING {
     try {
-        groups_t groups{optional_datum_less_t(env->reql_version())};
+        groups_t groups;
         groups[datum_t()] = std::vector<datum_t>{val};
         for (const auto &op : ops) {
             (*op)(env, &groups, key);
@@ -166,12 +262,18 @@ boost::optional<datum_t> apply_ops(
 }
 
 server_t::client_info_t::client_info_t()
-    : limit_clients(&opt_lt<std::string>),
+    : pending_stamp(0),
+      flush_scheduled(false),
+      resumable(false),
+      limit_clients(&opt_lt<std::string>),
       limit_clients_lock(new rwlock_t()) { }
 
 server_t::server_t(mailbox_manager_t *_manager)
     : uuid(generate_uuid()),
       manager(_manager),
+      next_seq(0),
+      log_enabled(false),
+      change_log_bytes(0),
       stop_mailbox(manager,
                    std::bind(&server_t::stop_mailbox_cb, this, ph::_1, ph::_2)),
       limit_stop_mailbox(manager, std::bind(&server_t::limit_stop_mailbox_cb,
@@ -323,6 +425,16 @@ void server_t::add_client_cb(signal_t *stopped, client_t::addr_t addr) {
     // This is true even if we have multiple shards per btree because
     // `add_client` only spawns one of us.
     guarantee(erased == 1);
+    if (log_enabled
+        && std::none_of(clients.begin(), clients.end(),
+                        [](const std::pair<const client_t::addr_t, client_info_t> &c) {
+                            return c.second.resumable;
+                        })) {
+        // Nothing can resume from the log anymore.
+        log_enabled = false;
+        std::deque<msg_t::change_t>().swap(change_log);
+        change_log_bytes = 0;
+    }
 }
 
 struct stamped_msg_t {
@@ -338,33 +450,108 @@ struct stamped_msg_t {
 
 RDB_MAKE_SERIALIZABLE_3(stamped_msg_t, server_uuid, stamp, submsg);
 
+// A batch of messages from one `server_t`, with consecutive stamps starting at
+// `first_stamp`.  Writing the uuid and stamp once per batch rather than once per
+// message keeps busy feeds from paying a mailbox message per change.
+struct stamped_msgs_t {
+    stamped_msgs_t() { }
+    stamped_msgs_t(uuid_u _server_uuid, uint64_t _first_stamp,
+                   std::vector<msg_t> &&_msgs)
+        : server_uuid(std::move(_server_uuid)),
+          first_stamp(_first_stamp),
+          msgs(std::move(_msgs)) { }
+    uuid_u server_uuid;
+    uint64_t first_stamp;
+    std::vector<msg_t> msgs;
+};
+
+RDB_MAKE_SERIALIZABLE_3(stamped_msgs_t, server_uuid, first_stamp, msgs);
+
 // This function takes a `lock_t` to make sure you have one.  (We can't just
 // always ackquire a drainer lock before sending because we sometimes send a
 // `stop_t` during destruction, and you can't acquire a drain lock on a draining
 // `auto_drainer_t`.)
+//
+// Messages are queued up in `client_info_t::pending` and sent in batches, either
+// when the batch is full, when we send a `stop_t` (after which the client may go
+// away), or once the coroutine that queued the first message yields.
 void server_t::send_one_with_lock(
-    const auto_drainer_t::lock_t &,
+    const auto_drainer_t::lock_t &lock,
     std::pair<const client_t::addr_t, client_info_t> *client,
     msg_t msg) {
-    uint64_t stamp;
+    client_info_t *info = &client->second;
+    const bool is_stop = boost::get<msg_t::stop_t>(&msg.op) != NULL;
     {
         // We don't need a write lock as long as we make sure the coroutine
         // doesn't block between reading and updating the stamp.
         ASSERT_NO_CORO_WAITING;
-        stamp = client->second.stamp++;
+        if (info->pending.empty()) {
+            info->pending_stamp = info->stamp;
+        }
+        info->stamp += 1;
+        info->pending.push_back(std::move(msg));
+    }
+    if (is_stop || info->pending.size() >= CHANGEFEED_MAX_BATCH_MSGS) {
+        flush_with_lock(client);
+    } else if (!info->flush_scheduled) {
+        info->flush_scheduled = true;
+        coro_t::spawn_later_ordered(
+            std::bind(&server_t::flush_cb, this, lock, client->first));
+    }
+}
+
+void server_t::flush_with_lock(
+    std::pair<const client_t::addr_t, client_info_t> *client) {
+    client_info_t *info = &client->second;
+    if (info->pending.empty()) {
+        return;
+    }
+    std::vector<msg_t> msgs;
+    msgs.swap(info->pending);
+    send(manager, client->first,
+         stamped_msgs_t(uuid, info->pending_stamp, std::move(msgs)));
+}
+
+// The drainer lock keeps `*this` alive until we've run.
+void server_t::flush_cb(auto_drainer_t::lock_t, client_t::addr_t addr) {
+    rwlock_in_line_t spot(&clients_lock, access_t::read);
+    spot.read_signal()->wait_lazily_unordered();
+    // The client may have been removed (after being sent everything) meanwhile.
+    auto it = clients.find(addr);
+    if (it != clients.end()) {
+        it->second.flush_scheduled = false;
+        flush_with_lock(&*it);
     }
-    send(manager, client->first, stamped_msg_t(uuid, stamp, std::move(msg)));
 }
 
 void server_t::send_all(const msg_t &msg, const store_key_t &key) {
     auto_drainer_t::lock_t lock(&drainer);
     rwlock_in_line_t spot(&clients_lock, access_t::read);
     spot.read_signal()->wait_lazily_unordered();
+    msg_t sequenced_msg;
+    const msg_t *to_send = &msg;
+    if (const msg_t::change_t *change = boost::get<msg_t::change_t>(&msg.op)) {
+        // The `seq` and the log have to be updated together (without blocking)
+        // for `get_stamp_and_log` to see a consistent log.
+        ASSERT_NO_CORO_WAITING;
+        msg_t::change_t sequenced = *change;
+        sequenced.seq = next_seq++;
+        if (log_enabled) {
+            change_log.push_back(sequenced);
+            change_log_bytes += logged_change_size(change_log.back());
+            while (change_log_bytes > CHANGEFEED_RESUME_LOG_BYTES) {
+                change_log_bytes -= logged_change_size(change_log.front());
+                change_log.pop_front();
+            }
+        }
+        sequenced_msg = msg_t(std::move(sequenced));
+        to_send = &sequenced_msg;
+    }
     for (auto it = clients.begin(); it != clients.end(); ++it) {
         if (std::any_of(it->second.regions.begin(),
                         it->second.regions.end(),
                         std::bind(&region_contains_key, ph::_1, std::cref(key)))) {
-            send_one_with_lock(lock, &*it, msg);
+            send_one_with_lock(lock, &*it, *to_send);
         }
     }
 }
@@ -399,6 +586,38 @@ uint64_t server_t::get_stamp(const client_t::addr_t &addr) {
     }
 }
 
+bool server_t::get_stamp_and_log(const client_t::addr_t &addr,
+                                 const boost::optional<uint64_t> &from,
+                                 uint64_t *stamp_out,
+                                 uint64_t *position_out,
+                                 std::vector<msg_t::change_t> *replay_out) {
+    auto_drainer_t::lock_t lock(&drainer);
+    rwlock_in_line_t spot(&clients_lock, access_t::read);
+    spot.read_signal()->wait_lazily_unordered();
+    // Changes sent after this point have a stamp of at least `*stamp_out` and a
+    // `seq` of at least `*position_out`, and everything before is in the log.
+    ASSERT_NO_CORO_WAITING;
+    auto it = clients.find(addr);
+    if (it == clients.end()) {
+        *stamp_out = std::numeric_limits<uint64_t>::max();
+    } else {
+        *stamp_out = it->second.stamp;
+        it->second.resumable = true;
+        log_enabled = true;
+    }
+    *position_out = next_seq;
+    replay_out->clear();
+    if (from) {
+        const uint64_t log_start = next_seq - change_log.size();
+        if (*from < log_start || *from > next_seq) {
+            return false;
+        }
+        replay_out->assign(change_log.begin() + (*from - log_start),
+                           change_log.end());
+    }
+    return true;
+}
+
 uuid_u server_t::get_uuid() {
     return uuid;
 }
@@ -678,13 +897,18 @@ limit_manager_t::limit_manager_t(
       spec(std::move(_spec)),
       gt(std::move(_gt)),
       item_queue(gt),
+      spare_queue(gt),
+      max_spares(std::min<size_t>(spec.limit, CHANGEFEED_LIMIT_MAX_SPARES)),
+      // If the initial read came up short we have the whole range.
+      spares_complete(item_vec.size() < spec.limit),
       aborted(false) {
     guarantee(clients_lock->read_signal()->is_pulsed());
 
-    // The final `NULL` argument means we don't profile any work done with this `env`.
+    // The final `NULL` arguments mean we don't profile or account for any work done
+    // with this `env`.
     env = make_scoped<env_t>(
         ctx, return_empty_normal_batches_t::NO,
-        drainer.get_drain_signal(), std::move(optargs), nullptr);
+        drainer.get_drain_signal(), std::move(optargs), nullptr, nullptr);
 
     guarantee(ops.size() == 0);
     for (const auto &transform : spec.range.transforms) {
@@ -858,6 +1082,38 @@ std::vector<item_t> limit_manager_t::read_more(
     return boost::apply_visitor(visitor, ref);
 }
 
+void limit_manager_t::add_to_window(item_t &&item, item_queue_t *real_added) {
+    bool inserted = item_queue.insert(item).second;
+    guarantee(inserted);
+    // If the item is also in `real_deleted` (e.g. it was updated, fell out of the
+    // window, and came back) the client gets a change replacing it, since we don't
+    // know whether it's the version the client has.
+    inserted = real_added->insert(std::move(item)).second;
+    guarantee(inserted);
+}
+
+void limit_manager_t::truncate_window(item_queue_t *real_added,
+                                      std::set<std::string> *real_deleted) {
+    std::vector<item_t> truncated = item_queue.truncate_top(spec.limit);
+    for (auto &&item : truncated) {
+        auto it = real_added->find_id(item.first);
+        if (it != real_added->end()) {
+            real_added->erase(it);
+        } else {
+            bool inserted = real_deleted->insert(item.first).second;
+            guarantee(inserted);
+        }
+        // Everything that was in the window comes before the first item we don't
+        // have in memory, so the spares stay contiguous.
+        bool inserted = spare_queue.insert(std::move(item)).second;
+        guarantee(inserted);
+    }
+    if (spare_queue.size() > max_spares) {
+        UNUSED std::vector<item_t> dropped = spare_queue.truncate_top(max_spares);
+        spares_complete = false;
+    }
+}
+
 void limit_manager_t::commit(
     rwlock_in_line_t *spot,
     const boost::variant<primary_ref_t, sindex_ref_t> &sindex_ref) THROWS_NOTHING {
@@ -872,9 +1128,21 @@ void limit_manager_t::commit(
         if (data_deleted) {
             bool inserted = real_deleted.insert(std::move(id)).second;
             guarantee(inserted);
+        } else {
+            UNUSED bool spare_deleted = spare_queue.del_id(id);
         }
     }
     deleted.clear();
+    // Unless we have the whole range in memory, a new item after the last one we
+    // have might not be the next one on disk, so we leave it for `read_more`.
+    boost::optional<item_t> last;
+    if (!spares_complete) {
+        if (spare_queue.size() != 0) {
+            last = item_t(**spare_queue.begin());
+        } else if (item_queue.size() != 0) {
+            last = item_t(**item_queue.begin());
+        }
+    }
     for (auto &&pair : added) {
         auto it = item_queue.find_id(pair.first);
         if (it != item_queue.end()) {
@@ -885,6 +1153,9 @@ void limit_manager_t::commit(
             item_queue.erase(it);
             real_added.erase(sub_it);
         }
+        if (!spares_complete && !(last && gt(*last, pair))) {
+            continue;
+        }
         bool inserted = item_queue.insert(pair).second;
         guarantee(inserted);
         inserted = real_added.insert(std::move(pair)).second;
@@ -892,31 +1163,27 @@ void limit_manager_t::commit(
     }
     added.clear();
 
-    std::vector<std::string> truncated = item_queue.truncate_top(spec.limit);
-    for (auto &&id : truncated) {
-        auto it = real_added.find_id(id);
-        if (it != real_added.end()) {
-            real_added.erase(it);
-        } else {
-            bool inserted = real_deleted.insert(std::move(id)).second;
-            guarantee(inserted);
-        }
+    truncate_window(&real_added, &real_deleted);
+
+    while (item_queue.size() < spec.limit && spare_queue.size() != 0) {
+        auto it = spare_queue.end();
+        --it;
+        item_t item(**it);
+        spare_queue.erase(it);
+        add_to_window(std::move(item), &real_added);
     }
-    // TODO: we should try to avoid this read if we know we only added rows.
-    if (item_queue.size() < spec.limit) {
+    if (item_queue.size() < spec.limit && !spares_complete) {
         auto data_it = item_queue.begin();
         boost::optional<item_queue_t::iterator> start;
         if (data_it != item_queue.end()) {
             start = data_it;
         }
+        // We read enough to refill the spares as well.
+        const size_t n = spec.limit - item_queue.size() + max_spares;
         std::vector<item_t> s;
         boost::optional<exc_t> exc;
         try {
-            s = read_more(
-                sindex_ref,
-                spec.range.sorting,
-                start,
-                spec.limit - item_queue.size());
+            s = read_more(sindex_ref, spec.range.sorting, start, n);
         } catch (const exc_t &e) {
             exc = e;
         }
@@ -926,16 +1193,12 @@ void limit_manager_t::commit(
             abort(*exc);
             return;
         }
-        guarantee(s.size() <= spec.limit - item_queue.size());
+        guarantee(s.size() <= n);
+        spares_complete = s.size() < n;
         for (auto &&pair : s) {
-            bool ins = item_queue.insert(pair).second;
-            guarantee(ins);
-            size_t erased = real_deleted.erase(pair.first);
-            if (erased == 0) {
-                ins = real_added.insert(pair).second;
-                guarantee(ins);
-            }
+            add_to_window(std::move(pair), &real_added);
         }
+        truncate_window(&real_added, &real_deleted);
     }
     std::set<std::string> remaining_deleted;
     for (auto &&id : real_deleted) {
@@ -986,9 +1249,9 @@ RDB_IMPL_SERIALIZABLE_3(msg_t::limit_change_t, sub, old_key, new_val);
 INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(msg_t::limit_change_t);
 RDB_IMPL_SERIALIZABLE_2(msg_t::limit_stop_t, sub, exc);
 INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(msg_t::limit_stop_t);
-RDB_IMPL_SERIALIZABLE_5(
+RDB_IMPL_SERIALIZABLE_6(
     msg_t::change_t,
-    old_indexes, new_indexes, pkey, old_val, new_val);
+    old_indexes, new_indexes, pkey, old_val, new_val, seq);
 INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(msg_t::change_t);
 RDB_IMPL_SERIALIZABLE_0_SINCE_v1_13(msg_t::stop_t);
 
@@ -1082,9 +1345,11 @@ public:
         const store_key_t &key,
         datum_t old_val,
         datum_t new_val,
+        datum_t resume_token,
         const configured_limits_t &limits) {
         if (update_stamp(uuid, stamp)) {
-            queue->add(key, std::move(old_val), std::move(new_val));
+            queue->add(key, std::move(old_val), std::move(new_val),
+                       std::move(resume_token));
             if (queue->size() > limits.array_size_limit()) {
                 skipped += queue->size();
                 queue->clear();
@@ -1120,7 +1385,11 @@ public:
 
     void each_range_sub(const auto_drainer_t::lock_t &lock,
                         const std::function<void(range_sub_t *)> &f) THROWS_NOTHING;
-    void each_active_range_sub(
+    // Calls `f` on every active range subscription that could care about a change
+    // from `old_val` to `new_val` (either of which may be empty).
+    void each_active_range_sub_for_change(
+        const datum_t &old_val,
+        const datum_t &new_val,
         const auto_drainer_t::lock_t &lock,
         const std::function<void(range_sub_t *)> &f) THROWS_NOTHING;
     void each_point_sub(const std::function<void(point_sub_t *)> &f) THROWS_NOTHING;
@@ -1164,11 +1433,24 @@ private:
                             const std::vector<int> &sub_threads,
                             int i);
     void each_point_sub_cb(const std::function<void(point_sub_t *)> &f, int i);
+    void each_range_sub_cb(
+        const std::function<void(range_sub_t *)> &f,
+        const std::vector<const std::vector<std::set<range_sub_t *> > *> &indexed,
+        const std::vector<int> &subscription_threads,
+        int i);
     void each_limit_sub_cb(const std::function<void(limit_sub_t *)> &f, int i);
 
     std::map<store_key_t, std::vector<std::set<point_sub_t *> > > point_subs;
     rwlock_t point_subs_lock;
     std::vector<std::set<range_sub_t *> > range_subs;
+    // Range subscriptions that can only match rows with a particular value at some
+    // path (see `range_sub_t::get_index_path`), keyed by that path and then by that
+    // value.  These aren't in `range_subs`, and changes only get dispatched to the
+    // ones whose value matches the old or new row.
+    std::map<std::vector<datum_string_t>,
+             std::map<datum_t,
+                      std::vector<std::set<range_sub_t *> >,
+                      latest_version_optional_datum_less_t> > indexed_range_subs;
     rwlock_t range_subs_lock;
     std::map<uuid_u, std::vector<std::set<limit_sub_t *> > > limit_subs;
     rwlock_t limit_subs_lock;
@@ -1190,14 +1472,14 @@ private:
     virtual void maybe_remove_feed() { client->maybe_remove_feed(client_lock, uuid); }
     virtual void stop_limit_sub(limit_sub_t *sub);
 
-    void mailbox_cb(signal_t *interruptor, stamped_msg_t msg);
+    void mailbox_cb(signal_t *interruptor, stamped_msgs_t msgs);
     void constructor_cb();
 
     auto_drainer_t::lock_t client_lock;
     client_t *client;
     uuid_u uuid;
     mailbox_manager_t *manager;
-    mailbox_t<void(stamped_msg_t)> mailbox;
+    mailbox_t<void(stamped_msgs_t)> mailbox;
     std::vector<server_t::addr_t> stop_addrs;
     std::vector<scoped_ptr_t<disconnect_watcher_t> > disconnect_watchers;
 
@@ -1357,7 +1639,7 @@ public:
                 break;
             }
         }
-        queue->add(store_key_t(pkey.print_primary()), datum_t(), initial);
+        queue->add(store_key_t(pkey.print_primary()), datum_t(), initial, datum_t());
         started = true;
     }
     virtual void start_real(env_t *env,
@@ -1382,7 +1664,8 @@ public:
         if (queue->size() == 0 || start_stamp > stamp) {
             stamp = start_stamp;
             queue->clear(); // Remove the premature values.
-            queue->add(store_key_t(pkey.print_primary()), datum_t(), resp->initial_val);
+            queue->add(store_key_t(pkey.print_primary()), datum_t(), resp->initial_val,
+                       datum_t());
         }
         started = true;
     }
@@ -1418,12 +1701,23 @@ class range_sub_t : public flat_sub_t {
 public:
     // Throws QL exceptions.
     range_sub_t(feed_t *feed, const datum_t &squash,
-                bool include_states, keyspec_t::range_t _spec)
-        : flat_sub_t(feed, squash, include_states), spec(std::move(_spec)),
-          state(state_t::READY), sent_state(state_t::NONE) {
+                bool include_states, resume_t _resume, keyspec_t::range_t _spec)
+        : flat_sub_t(feed, squash, include_states), resume(std::move(_resume)),
+          spec(std::move(_spec)), state(state_t::READY), sent_state(state_t::NONE) {
         for (const auto &transform : spec.transforms) {
             ops.push_back(make_op(transform));
         }
+        if (!spec.transforms.empty()) {
+            init_index(spec.transforms[0]);
+        }
+        if (has_ops()) {
+            write_message_t wm;
+            serialize<cluster_version_t::LATEST_OVERALL>(&wm, spec.transforms);
+            string_stream_t stream;
+            int res = send_write_message(&stream, &wm);
+            guarantee(res == 0);
+            ops_key = std::move(stream.str());
+        }
         feed->add_range_sub(this);
     }
     feed_type_t cfeed_type() const final { return feed_type_t::stream; }
@@ -1447,12 +1741,47 @@ public:
         read_response_t read_resp;
         // Note that we use the `outer_env`'s interruptor for the read.
         nif->read(
-            read_t(changefeed_stamp_t(*addr), profile_bool_t::DONT_PROFILE),
+            read_t(changefeed_stamp_t(*addr, resume), profile_bool_t::DONT_PROFILE),
             &read_resp, order_token_t::ignore, outer_env->interruptor);
         auto resp = boost::get<changefeed_stamp_response_t>(&read_resp.response);
         guarantee(resp != NULL);
+        if (resume.from) {
+            bool same_servers = resume.from->size() == resp->stamps.size();
+            for (auto it = resp->stamps.begin(); it != resp->stamps.end(); ++it) {
+                same_servers = same_servers && resume.from->count(it->first) != 0;
+            }
+            rcheck_datum(same_servers, base_exc_t::GENERIC,
+                         "Cannot resume changefeed: the resume token is for a "
+                         "different table, or the table's servers have restarted "
+                         "since it was generated.");
+            rcheck_datum(resp->truncated.empty(), base_exc_t::GENERIC,
+                         "Cannot resume changefeed: the changes since the resume "
+                         "token was generated are no longer logged, because there "
+                         "were too many or no resumable changefeed stayed open on "
+                         "the table.");
+        }
+        if (resume.resumable) {
+            log_positions = std::move(resp->log_positions);
+            resume_positions = resume.from ? *resume.from : log_positions;
+        }
         start_stamps = std::move(resp->stamps);
         guarantee(start_stamps.size() != 0);
+
+        // We replay the changes we missed before any live ones can arrive, since
+        // we don't block from here on.
+        configured_limits_t default_limits;
+        for (auto it = resp->replay.begin(); it != resp->replay.end(); ++it) {
+            auto stamp_it = start_stamps.find(it->first);
+            guarantee(stamp_it != start_stamps.end());
+            for (const auto &change : it->second) {
+                std::pair<datum_t, datum_t> vals = transform_change(change);
+                route_change(it->first, stamp_it->second, change,
+                             vals.first, vals.second, default_limits);
+            }
+        }
+        if (resume.resumable) {
+            resume_positions = log_positions;
+        }
     }
     boost::optional<std::string> sindex() const { return spec.sindex; }
     bool contains(const datum_t &sindex_key) const {
@@ -1471,6 +1800,60 @@ public:
     }
 
     bool has_ops() { return ops.size() != 0; }
+    // Subscriptions with equal `ops_key`s apply the same transformations, so
+    // they all get the same results from `apply_ops`.
+    const std::string &get_ops_key() const { return ops_key; }
+
+    // If `get_index_value` isn't empty, only rows whose field at `get_index_path`
+    // equals `get_index_value` can make it through our transformations.
+    const std::vector<datum_string_t> &get_index_path() const { return index_path; }
+    const datum_t &get_index_value() const { return index_value; }
+
+    // Returns `<old_val, new_val>` for `change` after our transformations.  Values
+    // that don't make it through them (or don't exist) become `null`.
+    std::pair<datum_t, datum_t> transform_change(const msg_t::change_t &change) {
+        std::pair<datum_t, datum_t> vals(datum_t::null(), datum_t::null());
+        if (has_ops()) {
+            if (change.old_val.has()) {
+                if (boost::optional<datum_t> d = apply_ops(change.old_val)) {
+                    vals.first = *d;
+                }
+            }
+            if (change.new_val.has()) {
+                if (boost::optional<datum_t> d = apply_ops(change.new_val)) {
+                    vals.second = *d;
+                }
+            }
+        } else {
+            guarantee(change.old_val.has() || change.new_val.has());
+            if (change.old_val.has()) {
+                vals.first = change.old_val;
+            }
+            if (change.new_val.has()) {
+                vals.second = change.new_val;
+            }
+        }
+        return vals;
+    }
+
+    // Queues `change`, whose values `transform_change` turned into `old_val` and
+    // `new_val`, if it's in our range.
+    void add_change(const uuid_u &server_uuid,
+                    uint64_t stamp,
+                    const msg_t::change_t &change,
+                    const datum_t &old_val,
+                    const datum_t &new_val,
+                    const configured_limits_t &limits) {
+        if (!log_positions.empty()) {
+            auto it = log_positions.find(server_uuid);
+            guarantee(it != log_positions.end());
+            if (change.seq < it->second) {
+                // We got this one from the change log in `start_real`.
+                return;
+            }
+        }
+        route_change(server_uuid, stamp, change, old_val, new_val, limits);
+    }
 
     boost::optional<datum_t> apply_ops(datum_t val) {
         guarantee(active());
@@ -1510,6 +1893,86 @@ public:
         return (include_states && state != sent_state) || queue->size() != 0;
     }
 private:
+    void route_change(const uuid_u &server_uuid,
+                      uint64_t stamp,
+                      const msg_t::change_t &change,
+                      const datum_t &old_val,
+                      const datum_t &new_val,
+                      const configured_limits_t &limits) {
+        datum_t resume_token;
+        if (resume.resumable) {
+            uint64_t *position = &resume_positions[server_uuid];
+            *position = std::max(*position, change.seq + 1);
+            resume_token = resume_token_to_datum(resume_positions);
+        }
+        // Duplicate values are caught before being written to disk and don't
+        // generate a `mod_report`, but if we have transforms the values might
+        // have changed.
+        if (has_ops() && new_val == old_val) {
+            return;
+        }
+        datum_t null = datum_t::null();
+        if (spec.sindex) {
+            size_t old_vals = 0, new_vals = 0;
+            auto old_it = change.old_indexes.find(*spec.sindex);
+            if (old_it != change.old_indexes.end()) {
+                for (const auto &idx : old_it->second) {
+                    if (contains(idx)) {
+                        old_vals += 1;
+                    }
+                }
+            }
+            auto new_it = change.new_indexes.find(*spec.sindex);
+            if (new_it != change.new_indexes.end()) {
+                for (const auto &idx : new_it->second) {
+                    if (contains(idx)) {
+                        new_vals += 1;
+                    }
+                }
+            }
+            while (new_vals > 0 && old_vals > 0) {
+                add_el(server_uuid, stamp, change.pkey,
+                       old_val, new_val, resume_token, limits);
+                --new_vals;
+                --old_vals;
+            }
+            while (old_vals > 0) {
+                guarantee(new_vals == 0);
+                add_el(server_uuid, stamp, change.pkey,
+                       old_val, null, resume_token, limits);
+                --old_vals;
+            }
+            while (new_vals > 0) {
+                guarantee(old_vals == 0);
+                add_el(server_uuid, stamp, change.pkey,
+                       null, new_val, resume_token, limits);
+                --new_vals;
+            }
+        } else {
+            if (contains(change.pkey)) {
+                add_el(server_uuid, stamp, change.pkey,
+                       old_val, new_val, resume_token, limits);
+            }
+        }
+    }
+
+    void init_index(const transform_variant_t &first_transform) {
+        const filter_wire_func_t *filter
+            = boost::get<filter_wire_func_t>(&first_transform);
+        // With a default value, rows missing the field can match too.
+        if (filter == NULL || filter->default_filter_val) {
+            return;
+        }
+        scoped_ptr_t<filter_predicate_t> predicate
+            = filter_predicate_t::compile(filter->filter_func.compile_wire_func());
+        datum_t value;
+        if (predicate.has() && predicate->get_required_equality(&index_path, &value)) {
+            index_value = value;
+        } else {
+            index_path.clear();
+        }
+    }
+
     scoped_ptr_t<env_t> make_env(env_t *outer_env) {
         // This is to support fake environments from the unit tests that don't
         // actually have a context.
@@ -1522,16 +1985,28 @@ private:
                 outer_env->return_empty_normal_batches,
                 drainer.get_drain_signal(),
                 outer_env->get_all_optargs(),
-                nullptr/*don't profile*/);
+                nullptr/*don't profile*/,
+                outer_env->usage);
     }
 
     scoped_ptr_t<env_t> env;
     std::vector<scoped_ptr_t<op_t> > ops;
+    // The serialized transformations, empty if there aren't any.
+    std::string ops_key;
+    std::vector<datum_string_t> index_path;
+    datum_t index_value;
 
     // The stamp (see `stamped_msg_t`) associated with our `changefeed_stamp_t`
     // read.  We use these to make sure we don't see changes from writes before
     // our subscription.
     std::map<uuid_u, uint64_t> start_stamps;
+    // For resumable changefeeds, the position of each `server_t`'s change log at
+    // the time of our `changefeed_stamp_t` read.  Changes from before then are
+    // replayed from the log instead.
+    std::map<uuid_u, uint64_t> log_positions;
+    // The positions a `resume_token` generated now resumes from.
+    std::map<uuid_u, uint64_t> resume_positions;
+    const resume_t resume;
     keyspec_t::range_t spec;
     state_t state, sent_state;
     auto_drainer_t drainer;
@@ -1869,77 +2344,31 @@ public:
         configured_limits_t default_limits;
         datum_t null = datum_t::null();
 
-        feed->each_active_range_sub(*lock, [&](range_sub_t *sub) {
-            datum_t new_val = null, old_val = null;
-            if (sub->has_ops()) {
-                if (change.new_val.has()) {
-                    if (boost::optional<datum_t> d = sub->apply_ops(change.new_val)) {
-                        new_val = *d;
-                    }
-                }
-                if (change.old_val.has()) {
-                    if (boost::optional<datum_t> d = sub->apply_ops(change.old_val)) {
-                        old_val = *d;
-                    }
-                }
-                // Duplicate values are caught before being written to disk and
-                // don't generate a `mod_report`, but if we have transforms the
-                // values might have changed.
-                if (new_val == old_val) {
-                    return;
-                }
-            } else {
-                guarantee(change.old_val.has() || change.new_val.has());
-                if (change.new_val.has()) {
-                    new_val = change.new_val;
-                }
-                if (change.old_val.has()) {
-                    old_val = change.old_val;
-                }
+        // Lots of clients often subscribe to the same thing (e.g. the same
+        // `filter(...).changes()` from every open browser page), so the
+        // transformed values are shared between subscriptions with the same
+        // transformations.  There's one cache per thread because the
+        // subscriptions on each thread are visited concurrently.
+        std::vector<std::map<std::string, std::pair<datum_t, datum_t> > >
+            transformed(get_num_threads());
+
+        feed->each_active_range_sub_for_change(
+            change.old_val, change.new_val, *lock, [&](range_sub_t *sub) {
+            if (!sub->has_ops()) {
+                std::pair<datum_t, datum_t> vals = sub->transform_change(change);
+                sub->add_change(server_uuid, stamp, change,
+                                vals.first, vals.second, default_limits);
+                return;
             }
-            boost::optional<std::string> sindex = sub->sindex();
-            if (sindex) {
-                size_t old_vals = 0, new_vals = 0;
-                auto old_it = change.old_indexes.find(*sindex);
-                if (old_it != change.old_indexes.end()) {
-                    for (const auto &idx : old_it->second) {
-                        if (sub->contains(idx)) {
-                            old_vals += 1;
-                        }
-                    }
-                }
-                auto new_it = change.new_indexes.find(*sindex);
-                if (new_it != change.new_indexes.end()) {
-                    for (const auto &idx : new_it->second) {
-                        if (sub->contains(idx)) {
-                            new_vals += 1;
-                        }
-                    }
-                }
-                while (new_vals > 0 && old_vals > 0) {
-                    sub->add_el(server_uuid, stamp, change.pkey,
-                                old_val, new_val, default_limits);
-                    --new_vals;
-                    --old_vals;
-                }
-                while (old_vals > 0) {
-                    guarantee(new_vals == 0);
-                    sub->add_el(server_uuid, stamp, change.pkey,
-                                old_val, null, default_limits);
-                    --old_vals;
-                }
-                while (new_vals > 0) {
-                    guarantee(old_vals == 0);
-                    sub->add_el(server_uuid, stamp, change.pkey,
-                                null, new_val, default_limits);
-                    --new_vals;
-                }
-            } else {
-                if (sub->contains(change.pkey)) {
-                    sub->add_el(server_uuid, stamp, change.pkey,
-                                old_val, new_val, default_limits);
-                }
+            auto *cache = &transformed[get_thread_id().threadnum];
+            auto it = cache->find(sub->get_ops_key());
+            if (it == cache->end()) {
+                it = cache->insert(
+                    std::make_pair(sub->get_ops_key(),
+                                   sub->transform_change(change))).first;
             }
+            sub->add_change(server_uuid, stamp, change,
+                            it->second.first, it->second.second, default_limits);
         });
         feed->on_point_sub(
             change.pkey,
@@ -1951,6 +2380,7 @@ public:
                       change.pkey,
                       change.old_val.has() ? change.old_val : null,
                       change.new_val.has() ? change.new_val : null,
+                      datum_t(),
                       default_limits));
     }
     void operator()(const msg_t::stop_t &) const {
@@ -1969,7 +2399,7 @@ private:
     uint64_t stamp;
 };
 
-void real_feed_t::mailbox_cb(signal_t *, stamped_msg_t msg) {
+void real_feed_t::mailbox_cb(signal_t *, stamped_msgs_t msgs) {
     // We stop receiving messages when detached (we're only receiving
     // messages because we haven't managed to get a message to the
     // stop mailboxes for some of the primary replicas yet).  This also stops
@@ -1985,7 +2415,7 @@ void real_feed_t::mailbox_cb(signal_t *, stamped_msg_t msg) {
         if (!lock.get_drain_signal()->is_pulsed()) {
             // We don't need a lock for this because the set of `uuid_u`s never
             // changes after it's initialized.
-            auto it = queues.find(msg.server_uuid);
+            auto it = queues.find(msgs.server_uuid);
             guarantee(it != queues.end());
             queue_t *queue = it->second.get();
             guarantee(queue != NULL);
@@ -1993,9 +2423,13 @@ void real_feed_t::mailbox_cb(signal_t *, stamped_msg_t msg) {
             rwlock_in_line_t spot(&queue->lock, access_t::write);
             spot.write_signal()->wait_lazily_unordered();
 
-            // Add us to the queue.
-            guarantee(msg.stamp >= queue->next);
-            queue->map.push(std::move(msg));
+            // Add us to the queue.  Batches can still arrive out of order.
+            guarantee(msgs.first_stamp >= queue->next);
+            for (size_t i = 0; i < msgs.msgs.size(); ++i) {
+                queue->map.push(stamped_msg_t(msgs.server_uuid,
+                                              msgs.first_stamp + i,
+                                              std::move(msgs.msgs[i])));
+            }
 
             // Read as much as we can from the queue (this enforces ordering.)
             while (queue->map.size() != 0 && queue->map.top().stamp == queue->next) {
@@ -2086,6 +2520,8 @@ subscription_t::get_els(batcher_t *batcher,
         while (!has_el() && !exc && skipped == 0) {
             cond_t wait_for_data;
             cond = &wait_for_data;
+            // Feeds on quiet tables can wait for a very long time.
+            trim_stack_while_waiting_t trim_stack;
             try {
                 // We don't need to wait on the drain signal because the interruptor
                 // will be pulsed if we're shutting down.  Not that `cond` might
@@ -2256,14 +2692,29 @@ void feed_t::del_point_sub(point_sub_t *sub, const store_key_t &key) THROWS_NOTH
 // If this throws we might leak the increment to `num_subs`.
 void feed_t::add_range_sub(range_sub_t *sub) THROWS_NOTHING {
     add_sub_with_lock(&range_subs_lock, [this, sub]() {
-            range_subs[sub->home_thread().threadnum].insert(sub);
+            if (sub->get_index_value().has()) {
+                map_add_sub(&indexed_range_subs[sub->get_index_path()],
+                            sub->get_index_value(), sub);
+            } else {
+                range_subs[sub->home_thread().threadnum].insert(sub);
+            }
         });
 }
 
 // Can't throw because it's called in a destructor.
 void feed_t::del_range_sub(range_sub_t *sub) THROWS_NOTHING {
-    del_sub_with_lock(&range_subs_lock, [this, sub]() {
-            return range_subs[sub->home_thread().threadnum].erase(sub);
+    del_sub_with_lock(&range_subs_lock, [this, sub]() -> size_t {
+            if (sub->get_index_value().has()) {
+                auto it = indexed_range_subs.find(sub->get_index_path());
+                guarantee(it != indexed_range_subs.end());
+                size_t erased = map_del_sub(&it->second, sub->get_index_value(), sub);
+                if (it->second.empty()) {
+                    indexed_range_subs.erase(it);
+                }
+                return erased;
+            } else {
+                return range_subs[sub->home_thread().threadnum].erase(sub);
+            }
         });
 }
 
@@ -2323,18 +2774,100 @@ void feed_t::each_range_sub(
     const auto_drainer_t::lock_t &lock,
     const std::function<void(range_sub_t *)> &f) THROWS_NOTHING {
     assert_thread();
+    guarantee(lock.has_lock());
     rwlock_in_line_t spot(&range_subs_lock, access_t::read);
-    each_sub_in_vec(range_subs, &spot, lock, f);
+    spot.read_signal()->wait_lazily_unordered();
+
+    std::vector<const std::vector<std::set<range_sub_t *> > *> indexed;
+    for (const auto &path_pair : indexed_range_subs) {
+        for (const auto &value_pair : path_pair.second) {
+            indexed.push_back(&value_pair.second);
+        }
+    }
+    std::vector<int> subscription_threads(get_num_threads());
+    for (int i = 0; i < get_num_threads(); ++i) {
+        subscription_threads[i] = i;
+    }
+    pmap(subscription_threads.size(),
+         std::bind(&feed_t::each_range_sub_cb,
+                   this,
+                   std::cref(f),
+                   std::cref(indexed),
+                   std::cref(subscription_threads),
+                   ph::_1));
 }
 
-void feed_t::each_active_range_sub(
+void feed_t::each_active_range_sub_for_change(
+    const datum_t &old_val,
+    const datum_t &new_val,
     const auto_drainer_t::lock_t &lock,
     const std::function<void(range_sub_t *)> &f) THROWS_NOTHING {
-    each_range_sub(lock, [&f](range_sub_t *sub) {
+    assert_thread();
+    guarantee(lock.has_lock());
+    rwlock_in_line_t spot(&range_subs_lock, access_t::read);
+    spot.read_signal()->wait_lazily_unordered();
+
+    // An indexed subscription can't match a row unless the row has the right
+    // value, so if neither the old nor the new row has it the subscription would
+    // see a change from `null` to `null`, which gets dropped anyway.
+    std::vector<const std::vector<std::set<range_sub_t *> > *> indexed;
+    for (const auto &path_pair : indexed_range_subs) {
+        for (const datum_t *row : {&old_val, &new_val}) {
+            if (!row->has()) {
+                continue;
+            }
+            datum_t value = filter_predicate_t::lookup_path(path_pair.first, *row);
+            if (!value.has()) {
+                continue;
+            }
+            auto it = path_pair.second.find(value);
+            if (it != path_pair.second.end()
+                && std::find(indexed.begin(), indexed.end(), &it->second)
+                   == indexed.end()) {
+                indexed.push_back(&it->second);
+            }
+        }
+    }
+
+    std::vector<int> subscription_threads;
+    for (int i = 0; i < get_num_threads(); ++i) {
+        bool any = range_subs[i].size() != 0;
+        for (auto it = indexed.begin(); !any && it != indexed.end(); ++it) {
+            any = (**it)[i].size() != 0;
+        }
+        if (any) {
+            subscription_threads.push_back(i);
+        }
+    }
+    std::function<void(range_sub_t *)> active_f = [&f](range_sub_t *sub) {
         if (sub->active()) {
             f(sub);
         }
-    });
+    };
+    pmap(subscription_threads.size(),
+         std::bind(&feed_t::each_range_sub_cb,
+                   this,
+                   std::cref(active_f),
+                   std::cref(indexed),
+                   std::cref(subscription_threads),
+                   ph::_1));
+}
+
+void feed_t::each_range_sub_cb(
+    const std::function<void(range_sub_t *)> &f,
+    const std::vector<const std::vector<std::set<range_sub_t *> > *> &indexed,
+    const std::vector<int> &subscription_threads,
+    int i) {
+    const int thread = subscription_threads[i];
+    on_thread_t th((threadnum_t(thread)));
+    for (range_sub_t *sub : range_subs[thread]) {
+        f(sub);
+    }
+    for (const auto *vec : indexed) {
+        for (range_sub_t *sub : (*vec)[thread]) {
+            f(sub);
+        }
+    }
 }
 
 void feed_t::each_point_sub(
@@ -2442,13 +2975,15 @@ client_t::~client_t() { }
 
 scoped_ptr_t<subscription_t> new_sub(
     feed_t *feed, const datum_t &squash, bool include_states,
-    const keyspec_t::spec_t &spec) {
+    const resume_t &resume, const keyspec_t::spec_t &spec) {
     struct spec_visitor_t : public boost::static_visitor<subscription_t *> {
         explicit spec_visitor_t(
-            feed_t *_feed, const datum_t *_squash, bool _include_states)
-            : feed(_feed), squash(_squash), include_states(_include_states) { }
+            feed_t *_feed, const datum_t *_squash, bool _include_states,
+            const resume_t *_resume)
+            : feed(_feed), squash(_squash), include_states(_include_states),
+              resume(_resume) { }
         subscription_t *operator()(const keyspec_t::range_t &range) const {
-            return new range_sub_t(feed, *squash, include_states, range);
+            return new range_sub_t(feed, *squash, include_states, *resume, range);
         }
         subscription_t *operator()(const keyspec_t::limit_t &limit) const {
             return new limit_sub_t(feed, *squash, include_states, limit);
@@ -2459,19 +2994,26 @@ scoped_ptr_t<subscription_t> new_sub(
         feed_t *feed;
         const datum_t *squash;
         bool include_states;
+        const resume_t *resume;
     };
     return scoped_ptr_t<subscription_t>(
-        boost::apply_visitor(spec_visitor_t(feed, &squash, include_states), spec));
+        boost::apply_visitor(
+            spec_visitor_t(feed, &squash, include_states, &resume), spec));
 }
 
 counted_t<datum_stream_t> client_t::new_stream(
     env_t *env,
     const datum_t &squash,
     bool include_states,
+    const resume_t &resume,
     const namespace_id_t &uuid,
     const protob_t<const Backtrace> &bt,
     const std::string &table_name,
     const keyspec_t::spec_t &spec) {
+    rcheck_datum(!resume.resumable
+                 || boost::get<keyspec_t::range_t>(&spec) != NULL,
+                 base_exc_t::GENERIC,
+                 "Only changefeeds on tables and ranges of tables can be resumed.");
     try {
         scoped_ptr_t<subscription_t> sub;
         boost::variant<scoped_ptr_t<range_sub_t>, scoped_ptr_t<point_sub_t> > presub;
@@ -2504,7 +3046,7 @@ counted_t<datum_stream_t> client_t::new_stream(
             on_thread_t th2(old_thread);
             real_feed_t *feed = feed_it->second.get();
             addr = feed->get_addr();
-            sub = new_sub(feed, squash, include_states, spec);
+            sub = new_sub(feed, squash, include_states, resume, spec);
         }
         namespace_interface_access_t access = namespace_source(uuid, env->interruptor);
         sub->start_real(env, table_name, access.get(), &addr);
@@ -2585,7 +3127,7 @@ counted_t<datum_stream_t> artificial_t::subscribe(
     // on the thread you want to use them on.
     guarantee(feed.has());
     scoped_ptr_t<subscription_t> sub = new_sub(
-        feed.get(), datum_t::boolean(false), include_states, spec);
+        feed.get(), datum_t::boolean(false), include_states, resume_t(), spec);
     sub->start_artificial(env, uuid, primary_key_name, initial_values);
     return make_counted<stream_t>(std::move(sub), bt);
 }
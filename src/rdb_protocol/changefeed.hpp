@@ -90,6 +90,9 @@ struct msg_t {
         /* For a newly-created row, `old_val` is an empty `datum_t`. For a deleted row,
         `new_val` is an empty `datum_t`. */
         datum_t old_val, new_val;
+        // The position of the change in the change log of the `server_t` that sent
+        // it (see `server_t::get_stamp_and_log`).  Set by `server_t::send_all`.
+        uint64_t seq;
         RDB_DECLARE_ME_SERIALIZABLE(change_t);
     };
     struct stop_t {
@@ -118,9 +121,9 @@ struct msg_t {
 RDB_DECLARE_SERIALIZABLE(msg_t);
 
 class real_feed_t;
-struct stamped_msg_t;
+struct stamped_msgs_t;
 
-typedef mailbox_addr_t<void(stamped_msg_t)> client_addr_t;
+typedef mailbox_addr_t<void(stamped_msgs_t)> client_addr_t;
 
 struct keyspec_t {
     struct range_t {
@@ -164,6 +167,20 @@ struct keyspec_t {
 };
 region_t keyspec_to_region(const keyspec_t &keyspec);
 
+// Options for resumable changefeeds (`changes(resumable=true)` and
+// `changes(resume_token=...)`).
+struct resume_t {
+    resume_t() : resumable(false) { }
+    // Whether to add a `resume_token` field to every change.
+    bool resumable;
+    // The position in the change log of each `server_t` to replay changes from,
+    // when resuming from a `resume_token`.  Resumed changefeeds are resumable.
+    boost::optional<std::map<uuid_u, uint64_t> > from;
+};
+
+// Throws QL exceptions if `token` isn't something we produced.
+std::map<uuid_u, uint64_t> parse_resume_token(const datum_t &token);
+
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(keyspec_t::range_t);
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(keyspec_t::limit_t);
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(keyspec_t::point_t);
@@ -193,6 +210,7 @@ public:
         env_t *env,
         const datum_t &squash,
         bool include_states,
+        const resume_t &resume,
         const namespace_id_t &table,
         const protob_t<const Backtrace> &bt,
         const std::string &table_name,
@@ -306,10 +324,13 @@ public:
     iterator top() {
         return size() == 0 ? end() : *index.begin();
     }
-    std::vector<Id> truncate_top(size_t n) {
-        std::vector<Id> ret;
+    // Removes elements from the top until there are only `n` left, and returns
+    // them in the order they were removed.
+    std::vector<std::pair<Id, std::pair<Key, Val> > > truncate_top(size_t n) {
+        std::vector<std::pair<Id, std::pair<Key, Val> > > ret;
         while (index.size() > n) {
-            ret.push_back((*index.begin())->first);
+            ret.push_back(std::make_pair((*index.begin())->first,
+                                         std::move((*index.begin())->second)));
             data.erase(*index.begin());
             index.erase(index.begin());
         }
@@ -393,6 +414,11 @@ private:
                          const boost::optional<item_queue_t::iterator> &start,
                          size_t n);
     void send(msg_t &&msg);
+    // These move items into and out of the visible window, recording the change
+    // in `real_added` and `real_deleted`.
+    void add_to_window(item_t &&item, item_queue_t *real_added);
+    void truncate_window(item_queue_t *real_added,
+                         std::set<std::string> *real_deleted);
 
     scoped_ptr_t<env_t> env;
 
@@ -403,7 +429,17 @@ private:
     std::vector<scoped_ptr_t<op_t> > ops;
 
     limit_order_t gt;
+    // The `spec.limit` items the client sees.
     item_queue_t item_queue;
+    // Up to `max_spares` of the items right after the ones in `item_queue`, so
+    // that we usually don't have to read from disk when an item leaves the
+    // window.  If `spares_complete` is true then these are all of the remaining
+    // items in the range; otherwise there may be more on disk, and any item after
+    // the last spare (or after the window, if there are no spares) is left for
+    // `read_more` to find.
+    item_queue_t spare_queue;
+    const size_t max_spares;
+    bool spares_complete;
 
     std::vector<std::pair<std::string, std::pair<datum_t, datum_t> > > added;
     std::vector<std::string> deleted;
@@ -441,6 +477,16 @@ public:
     addr_t get_stop_addr();
     limit_addr_t get_limit_stop_addr();
     uint64_t get_stamp(const client_t::addr_t &addr);
+    // Like `get_stamp`, but for resumable changefeeds.  Also sets `*position_out`
+    // to the `seq` the next change will get and, if `from` is set, `*replay_out`
+    // to the logged changes from `from` up to there.  Returns false if the log no
+    // longer reaches back to `from`.  The first call turns on the change log, which
+    // is dropped again once no client that called this is left.
+    MUST_USE bool get_stamp_and_log(const client_t::addr_t &addr,
+                                    const boost::optional<uint64_t> &from,
+                                    uint64_t *stamp_out,
+                                    uint64_t *position_out,
+                                    std::vector<msg_t::change_t> *replay_out);
     uuid_u get_uuid();
     // `f` will be called with a read lock on `clients` and a write lock on the
     // limit manager.
@@ -466,10 +512,28 @@ private:
     const uuid_u uuid;
     mailbox_manager_t *const manager;
 
+    // The `seq` of the next change we send.
+    uint64_t next_seq;
+    // The last `CHANGEFEED_RESUME_LOG_BYTES` worth of changes we sent, which
+    // resumed changefeeds replay.  The log lives in memory (and is only kept while a
+    // resumable changefeed is subscribed) because `uuid` and the stamps change
+    // whenever we're recreated anyway.
+    bool log_enabled;
+    std::deque<msg_t::change_t> change_log;
+    // The sum of `logged_change_size()` over `change_log`.
+    int64_t change_log_bytes;
+
     struct client_info_t {
         client_info_t();
         scoped_ptr_t<cond_t> cond;
         uint64_t stamp;
+        // Messages we haven't sent yet (see `send_one_with_lock`), the first of
+        // which has the stamp `pending_stamp`.
+        std::vector<msg_t> pending;
+        uint64_t pending_stamp;
+        bool flush_scheduled;
+        // Whether the client is a resumable changefeed (see `get_stamp_and_log`).
+        bool resumable;
         std::vector<region_t> regions;
         std::map<boost::optional<std::string>,
                  std::vector<scoped_ptr_t<limit_manager_t> >,
@@ -492,6 +556,8 @@ private:
     void send_one_with_lock(const auto_drainer_t::lock_t &lock,
                             std::pair<const client_t::addr_t, client_info_t> *client,
                             msg_t msg);
+    void flush_with_lock(std::pair<const client_t::addr_t, client_info_t> *client);
+    void flush_cb(auto_drainer_t::lock_t lock, client_t::addr_t addr);
 
     // Controls access to `clients`.  A `server_t` needs to read `clients` when:
     // * `send_all` is called
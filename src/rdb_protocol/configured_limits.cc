@@ -7,7 +7,9 @@ namespace ql {
 configured_limits_t
 from_optargs(rdb_context_t *ctx, signal_t *interruptor, global_optargs_t *arguments)
 {
-    if (arguments->has_optarg("array_limit")) {
+    const bool has_array_limit = arguments->has_optarg("array_limit");
+    const bool has_memory_limit = arguments->has_optarg("memory_limit");
+    if (has_array_limit || has_memory_limit) {
         // Fake an environment with no arguments.  We have to fake it
         // because of a chicken/egg problem; this function gets called
         // before there are any extant environments at all.  Only
@@ -19,19 +21,33 @@ from_optargs(rdb_context_t *ctx, signal_t *interruptor, global_optargs_t *argume
                   return_empty_normal_batches_t::NO,
                   interruptor,
                   std::map<std::string, wire_func_t>(),
+                  nullptr,
                   nullptr);
-        int64_t limit = arguments->get_optarg(&env, "array_limit")->as_int();
-        rcheck_datum(limit > 1, base_exc_t::GENERIC,
-                     strprintf("Illegal array size limit `%" PRIi64 "`.", limit));
-        return configured_limits_t(limit);
+        configured_limits_t defaults;
+        size_t array_limit = defaults.array_size_limit();
+        if (has_array_limit) {
+            int64_t limit = arguments->get_optarg(&env, "array_limit")->as_int();
+            rcheck_datum(limit > 1, base_exc_t::GENERIC,
+                         strprintf("Illegal array size limit `%" PRIi64 "`.", limit));
+            array_limit = limit;
+        }
+        uint64_t memory_limit = defaults.memory_limit();
+        if (has_memory_limit) {
+            int64_t limit = arguments->get_optarg(&env, "memory_limit")->as_int();
+            rcheck_datum(limit > 0, base_exc_t::GENERIC,
+                         strprintf("Illegal memory limit `%" PRIi64 "`.", limit));
+            memory_limit = limit;
+        }
+        return configured_limits_t(array_limit, memory_limit);
     } else {
         return configured_limits_t();
     }
 }
 
-RDB_IMPL_SERIALIZABLE_1(configured_limits_t, array_size_limit_);
+RDB_IMPL_SERIALIZABLE_2(configured_limits_t, array_size_limit_, memory_limit_);
 INSTANTIATE_SERIALIZABLE_FOR_CLUSTER(configured_limits_t);
 
-const configured_limits_t configured_limits_t::unlimited(std::numeric_limits<size_t>::max());
+const configured_limits_t configured_limits_t::unlimited(
+    std::numeric_limits<size_t>::max(), std::numeric_limits<uint64_t>::max());
 
 } // namespace ql
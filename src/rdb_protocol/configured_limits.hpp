@@ -1,8 +1,12 @@
 #ifndef RDB_PROTOCOL_CONFIGURED_LIMITS_HPP_
 #define RDB_PROTOCOL_CONFIGURED_LIMITS_HPP_
 
+#include <stdint.h>
+
+#include <limits>
 #include <map>
 #include <string>
+
 #include "rpc/serialize_macros.hpp"
 
 class rdb_context_t;
@@ -15,16 +19,24 @@ class global_optargs_t;
 
 class configured_limits_t {
 public:
-    configured_limits_t() : array_size_limit_(100000) {}
-    explicit configured_limits_t(const size_t limit) : array_size_limit_(limit) {}
+    configured_limits_t()
+        : array_size_limit_(100000),
+          memory_limit_(std::numeric_limits<uint64_t>::max()) {}
+    explicit configured_limits_t(const size_t limit,
+                                 const uint64_t memory_limit
+                                     = std::numeric_limits<uint64_t>::max())
+        : array_size_limit_(limit), memory_limit_(memory_limit) {}
 
     size_t array_size_limit() const { return array_size_limit_; }
+    // How many bytes the query may hold in buffers; see `query_memory_t`.
+    uint64_t memory_limit() const { return memory_limit_; }
 
     static const configured_limits_t unlimited;
 
     RDB_DECLARE_ME_SERIALIZABLE(configured_limits_t);
 private:
     size_t array_size_limit_;
+    uint64_t memory_limit_;
 };
 
 configured_limits_t from_optargs(rdb_context_t *ctx, signal_t *interruptor,
@@ -3,10 +3,48 @@
 
 #include "rdb_protocol/query_cache.hpp"
 #include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/error.hpp"
 #include "time.hpp"
 
 const char *rql_perfmon_name = "query_engine";
 
+namespace ql {
+
+datum_t write_versions_to_datum(const write_versions_t &versions) {
+    std::map<datum_string_t, datum_t> token;
+    for (const auto &pair : versions) {
+        token[datum_string_t(uuid_to_str(pair.first))]
+            = datum_t(static_cast<double>(pair.second.to_num()));
+    }
+    return datum_t(std::move(token));
+}
+
+write_versions_t parse_write_token(const datum_t &token) {
+    const std::string err = strprintf("Invalid write token `%s`.",
+                                      token.print().c_str());
+    rcheck_datum(token.get_type() == datum_t::R_OBJECT && !token.is_ptype(),
+                 base_exc_t::GENERIC, err);
+    write_versions_t versions;
+    for (size_t i = 0; i < token.obj_size(); ++i) {
+        auto pair = token.get_pair(i);
+        uuid_u branch;
+        int64_t timestamp;
+        rcheck_datum(str_to_uuid(pair.first.to_std(), &branch)
+                     && pair.second.get_type() == datum_t::R_NUM
+                     && number_as_integer(pair.second.as_num(), &timestamp)
+                     && timestamp >= 0,
+                     base_exc_t::GENERIC, err);
+        versions[branch] = state_timestamp_t::from_num(timestamp);
+    }
+    return versions;
+}
+
+}  // namespace ql
+
+// How many compiled regexes each thread keeps around.
+const size_t REGEX_CACHE_SIZE = 1000;
+
 rdb_context_t::stats_t::stats_t(perfmon_collection_t *global_stats)
     : qe_stats_membership(global_stats, &qe_stats_collection, rql_perfmon_name),
       client_connections_membership(&qe_stats_collection,
@@ -17,14 +55,32 @@ rdb_context_t::stats_t::stats_t(perfmon_collection_t *global_stats)
       queries_per_sec_membership(&qe_stats_collection,
                                  &queries_per_sec, "queries_per_sec"),
       queries_total_membership(&qe_stats_collection,
-                               &queries_total, "queries_total") { }
+                               &queries_total, "queries_total"),
+      query_latency(secs_to_ticks(1)),
+      query_latency_membership(&qe_stats_collection,
+                               &query_latency, "query_latency"),
+      term_cache_hits_membership(&qe_stats_collection,
+                                 &term_cache_hits, "term_cache_hits"),
+      term_cache_misses_membership(&qe_stats_collection,
+                                   &term_cache_misses, "term_cache_misses"),
+      regex_cache_hits_membership(&qe_stats_collection,
+                                  &regex_cache_hits, "regex_cache_hits"),
+      regex_cache_misses_membership(&qe_stats_collection,
+                                    &regex_cache_misses, "regex_cache_misses"),
+      result_cache_hits_membership(&qe_stats_collection,
+                                   &result_cache_hits, "result_cache_hits"),
+      result_cache_misses_membership(&qe_stats_collection,
+                                     &result_cache_misses, "result_cache_misses") { }
 
 rdb_context_t::rdb_context_t()
     : extproc_pool(nullptr),
       cluster_interface(nullptr),
       manager(nullptr),
       reql_http_proxy(),
-      stats(&get_global_perfmon_collection()) { }
+      io_backender(nullptr),
+      base_path(""),
+      stats(&get_global_perfmon_collection()),
+      regex_caches(REGEX_CACHE_SIZE, &stats) { }
 
 rdb_context_t::rdb_context_t(
         extproc_pool_t *_extproc_pool,
@@ -33,7 +89,10 @@ rdb_context_t::rdb_context_t(
       cluster_interface(_cluster_interface),
       manager(nullptr),
       reql_http_proxy(),
-      stats(&get_global_perfmon_collection()) { }
+      io_backender(nullptr),
+      base_path(""),
+      stats(&get_global_perfmon_collection()),
+      regex_caches(REGEX_CACHE_SIZE, &stats) { }
 
 rdb_context_t::rdb_context_t(
         extproc_pool_t *_extproc_pool,
@@ -42,13 +101,18 @@ rdb_context_t::rdb_context_t(
         boost::shared_ptr< semilattice_readwrite_view_t<auth_semilattice_metadata_t> >
             _auth_metadata,
         perfmon_collection_t *global_stats,
-        const std::string &_reql_http_proxy)
+        const std::string &_reql_http_proxy,
+        io_backender_t *_io_backender,
+        const base_path_t &_base_path)
     : extproc_pool(_extproc_pool),
       cluster_interface(_cluster_interface),
       auth_metadata(_auth_metadata),
       manager(_mailbox_manager),
       reql_http_proxy(_reql_http_proxy),
-      stats(global_stats)
+      io_backender(_io_backender),
+      base_path(_base_path),
+      stats(global_stats),
+      regex_caches(REGEX_CACHE_SIZE, &stats)
 { }
 
 rdb_context_t::~rdb_context_t() { }
@@ -56,3 +120,7 @@ rdb_context_t::~rdb_context_t() { }
 std::set<ql::query_cache_t *> *rdb_context_t::get_query_caches_for_this_thread() {
     return query_caches.get();
 }
+
+ql::regex_cache_t *rdb_context_t::get_regex_cache_for_this_thread() {
+    return regex_caches.get();
+}
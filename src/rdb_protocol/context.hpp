@@ -37,6 +37,7 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
 class auth_semilattice_metadata_t;
 class ellipsoid_spec_t;
 class extproc_pool_t;
+class io_backender_t;
 class name_string_t;
 class namespace_interface_t;
 template <class> class semilattice_readwrite_view_t;
@@ -44,17 +45,25 @@ enum class sindex_rename_result_t;
 
 enum class sindex_multi_bool_t;
 enum class sindex_geo_bool_t;
+enum class sindex_values_bool_t;
 
 namespace ql {
 class configured_limits_t;
 class env_t;
 class query_cache_t;
+struct regex_cache_t;
 class db_t : public single_threaded_countable_t<db_t> {
 public:
     db_t(uuid_u _id, const name_string_t &_name) : id(_id), name(_name) { }
     const uuid_u id;
     const name_string_t name;
 };
+
+// Write tokens (`return_write_token=true` and `table(write_token=...)`) are
+// `write_versions_t`s, as objects mapping branch IDs to timestamps.
+datum_t write_versions_to_datum(const write_versions_t &versions);
+// Throws QL exceptions if `token` isn't something we produced.
+write_versions_t parse_write_token(const datum_t &token);
 } // namespace ql
 
 class table_generate_config_params_t {
@@ -85,6 +94,12 @@ public:
 
     virtual ql::datum_t read_row(ql::env_t *env,
         ql::datum_t pval, bool use_outdated) = 0;
+    /* Like `read_row()` for each of `pvals`, but with one read per shard.  Returns
+    false if the table can't do that, in which case the caller has to read the rows
+    one by one. */
+    virtual bool read_rows(ql::env_t *env,
+        const std::vector<ql::datum_t> &pvals, bool use_outdated,
+        std::vector<ql::datum_t> *rows_out) = 0;
     virtual counted_t<ql::datum_stream_t> read_all(
         ql::env_t *env,
         const std::string &sindex,
@@ -97,6 +112,7 @@ public:
         ql::env_t *env,
         const ql::datum_t &squash,
         bool include_states,
+        const ql::changefeed::resume_t &resume,
         ql::changefeed::keyspec_t::spec_t &&spec,
         const ql::protob_t<const Backtrace> &bt,
         const std::string &table_name) = 0;
@@ -118,6 +134,14 @@ public:
         const ellipsoid_spec_t &geo_system,
         dist_unit_t dist_unit,
         const ql::configured_limits_t &limits) = 0;
+    /* Picks up to `num` random rows without reading the whole table.  Returns false
+    if the table can't do that, in which case the caller has to sample `read_all()`
+    instead. */
+    virtual bool read_sample(
+        ql::env_t *env,
+        uint64_t num,
+        bool use_outdated,
+        std::vector<ql::datum_t> *rows_out) = 0;
 
     virtual ql::datum_t write_batched_replace(ql::env_t *env,
         const std::vector<ql::datum_t> &keys,
@@ -131,9 +155,15 @@ public:
     virtual bool write_sync_depending_on_durability(ql::env_t *env,
         durability_requirement_t durability) = 0;
 
+    /* Makes the `use_outdated` reads of this table object wait until the replicas
+    they read from have the writes in `versions`. */
+    virtual void set_read_after(const write_versions_t &versions) = 0;
+    /* The versions of all the writes made through this table object so far. */
+    virtual write_versions_t get_write_versions() const = 0;
+
     virtual bool sindex_create(ql::env_t *env, const std::string &id,
         counted_t<const ql::func_t> index_func, sindex_multi_bool_t multi,
-        sindex_geo_bool_t geo) = 0;
+        sindex_geo_bool_t geo, sindex_values_bool_t values) = 0;
     virtual bool sindex_drop(ql::env_t *env, const std::string &id) = 0;
     virtual sindex_rename_result_t sindex_rename(ql::env_t *env,
         const std::string &old_name, const std::string &new_name, bool overwrite) = 0;
@@ -276,7 +306,9 @@ public:
                     semilattice_readwrite_view_t<
                         auth_semilattice_metadata_t> > _auth_metadata,
                   perfmon_collection_t *global_stats,
-                  const std::string &_reql_http_proxy);
+                  const std::string &_reql_http_proxy,
+                  io_backender_t *_io_backender,
+                  const base_path_t &_base_path);
 
     ~rdb_context_t();
 
@@ -290,6 +322,11 @@ public:
 
     const std::string reql_http_proxy;
 
+    // Used for spilling large sorts to temporary files.  The `io_backender` is
+    // `nullptr` on proxies and in most unit tests, which can't spill.
+    io_backender_t *io_backender;
+    const base_path_t base_path;
+
     class stats_t {
     public:
         explicit stats_t(perfmon_collection_t *global_stats);
@@ -304,14 +341,32 @@ public:
         perfmon_membership_t queries_per_sec_membership;
         perfmon_counter_t queries_total;
         perfmon_membership_t queries_total_membership;
+        perfmon_latency_histogram_t query_latency;
+        perfmon_membership_t query_latency_membership;
+        perfmon_counter_t term_cache_hits;
+        perfmon_membership_t term_cache_hits_membership;
+        perfmon_counter_t term_cache_misses;
+        perfmon_membership_t term_cache_misses_membership;
+        perfmon_counter_t regex_cache_hits;
+        perfmon_membership_t regex_cache_hits_membership;
+        perfmon_counter_t regex_cache_misses;
+        perfmon_membership_t regex_cache_misses_membership;
+        perfmon_counter_t result_cache_hits;
+        perfmon_membership_t result_cache_hits_membership;
+        perfmon_counter_t result_cache_misses;
+        perfmon_membership_t result_cache_misses_membership;
     private:
         DISABLE_COPYING(stats_t);
     } stats;
 
     std::set<ql::query_cache_t *> *get_query_caches_for_this_thread();
 
+    // Compiled regexes for `r.match`, shared by all the queries on a thread.
+    ql::regex_cache_t *get_regex_cache_for_this_thread();
+
 private:
     one_per_thread_t<std::set<ql::query_cache_t *> > query_caches;
+    one_per_thread_t<ql::regex_cache_t> regex_caches;
 
 private:
     DISABLE_COPYING(rdb_context_t);
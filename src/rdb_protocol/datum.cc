@@ -5,14 +5,17 @@
 #include <math.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <algorithm>
+#include <functional>
 #include <iterator>
 
 #include "errors.hpp"
 #include <boost/detail/endian.hpp>
 
 #include "containers/archive/stl_types.hpp"
+#include "containers/archive/string_stream.hpp"
 #include "containers/scoped.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/error.hpp"
@@ -454,8 +457,18 @@ inline void fail_if_invalid(reql_version_t reql_version, const char *string)
     }
 }
 
-datum_t to_datum(cJSON *json, const configured_limits_t &limits,
-                 reql_version_t reql_version) {
+// How deeply arrays and objects may be nested in JSON that we turn into datums.  We
+// recurse once per level, and every object level has a `datum_object_builder_t` on
+// the stack, so without a limit a small document could overflow a coroutine stack.
+const int MAX_JSON_NESTING_DEPTH = 100;
+
+static datum_t to_datum(cJSON *json, const configured_limits_t &limits,
+                        reql_version_t reql_version, int depth) {
+    if (json->type == cJSON_Array || json->type == cJSON_Object) {
+        rcheck_datum(depth < MAX_JSON_NESTING_DEPTH, base_exc_t::GENERIC,
+                     strprintf("JSON is nested more than %d levels deep.",
+                               MAX_JSON_NESTING_DEPTH));
+    }
     switch (json->type) {
     case cJSON_False: {
         return datum_t::boolean(false);
@@ -477,7 +490,7 @@ datum_t to_datum(cJSON *json, const configured_limits_t &limits,
         std::vector<datum_t> array;
         json_array_iterator_t it(json);
         while (cJSON *item = it.next()) {
-            array.push_back(to_datum(item, limits, reql_version));
+            array.push_back(to_datum(item, limits, reql_version, depth + 1));
         }
         return datum_t(std::move(array), limits);
     } break;
@@ -486,7 +499,8 @@ datum_t to_datum(cJSON *json, const configured_limits_t &limits,
         json_object_iterator_t it(json);
         while (cJSON *item = it.next()) {
             fail_if_invalid(reql_version, item->string);
-            bool dup = builder.add(item->string, to_datum(item, limits, reql_version));
+            bool dup = builder.add(item->string,
+                                   to_datum(item, limits, reql_version, depth + 1));
             rcheck_datum(!dup, base_exc_t::GENERIC,
                          strprintf("Duplicate key `%s` in JSON.", item->string));
         }
@@ -497,6 +511,297 @@ datum_t to_datum(cJSON *json, const configured_limits_t &limits,
     }
 }
 
+datum_t to_datum(cJSON *json, const configured_limits_t &limits,
+                 reql_version_t reql_version) {
+    return to_datum(json, limits, reql_version, 0);
+}
+
+// Parses JSON text straight into datums.  It accepts what `cJSON_Parse` accepts
+// (and applies the same checks as `to_datum` above), except that it rejects a few
+// malformed inputs cJSON lets through: unterminated strings and unpaired surrogates.
+// Input nested more than `MAX_JSON_NESTING_DEPTH` levels deep is rejected too.
+class json_datum_parser_t {
+public:
+    json_datum_parser_t(const char *json, size_t size,
+                        const configured_limits_t &limits,
+                        reql_version_t reql_version)
+        : p_(json), end_(json + size), depth_(0), limits_(limits),
+          reql_version_(reql_version) { }
+
+    datum_t parse() {
+        datum_t res;
+        skip_whitespace();
+        if (!parse_value(&res)) {
+            return datum_t();
+        }
+        skip_whitespace();
+        return p_ == end_ ? res : datum_t();
+    }
+
+private:
+    void skip_whitespace() {
+        while (p_ != end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) {
+            ++p_;
+        }
+    }
+
+    bool consume(const char *literal, size_t size) {
+        if (static_cast<size_t>(end_ - p_) < size || memcmp(p_, literal, size) != 0) {
+            return false;
+        }
+        p_ += size;
+        return true;
+    }
+
+    bool parse_value(datum_t *out) {
+        if (p_ == end_) {
+            return false;
+        }
+        switch (*p_) {
+        case 'n':
+            *out = datum_t::null();
+            return consume("null", 4);
+        case 't':
+            *out = datum_t::boolean(true);
+            return consume("true", 4);
+        case 'f':
+            *out = datum_t::boolean(false);
+            return consume("false", 5);
+        case '"': {
+            std::string str;
+            if (!parse_string(&str)) {
+                return false;
+            }
+            fail_if_invalid(reql_version_, str);
+            *out = datum_t(datum_string_t(str.size(), str.data()));
+            return true;
+        }
+        case '[': return parse_array(out);
+        case '{': return parse_object(out);
+        default:
+            return (*p_ == '-' || (*p_ >= '0' && *p_ <= '9')) && parse_number(out);
+        }
+    }
+
+    bool parse_number(datum_t *out) {
+        const char *start = p_;
+        const bool negative = *p_ == '-';
+        if (negative) {
+            ++p_;
+        }
+        // Integers that fit in a double's mantissa don't need `strtod`.
+        uint64_t integer = 0;
+        const char *digits = p_;
+        while (p_ != end_ && *p_ >= '0' && *p_ <= '9') {
+            integer = integer * 10 + (*p_ - '0');
+            ++p_;
+        }
+        if (p_ != digits && p_ - digits <= 15
+            && (p_ == end_ || (*p_ != '.' && *p_ != 'e' && *p_ != 'E'))) {
+            const double d = static_cast<double>(integer);
+            *out = datum_t(negative ? -d : d);
+            return true;
+        }
+
+        while (p_ != end_ && ((*p_ >= '0' && *p_ <= '9') || *p_ == '.'
+                              || *p_ == 'e' || *p_ == 'E' || *p_ == '+' || *p_ == '-')) {
+            ++p_;
+        }
+        // `strtod` wants a NUL-terminated string.
+        const std::string text(start, p_);
+        char *text_end;
+        const double d = strtod(text.c_str(), &text_end);
+        if (text_end != text.c_str() + text.size()) {
+            return false;
+        }
+        *out = datum_t(d);
+        return true;
+    }
+
+    bool parse_hex4(unsigned int *out) {
+        if (end_ - p_ < 4) {
+            return false;
+        }
+        unsigned int res = 0;
+        for (int i = 0; i < 4; ++i, ++p_) {
+            res <<= 4;
+            if (*p_ >= '0' && *p_ <= '9') {
+                res += *p_ - '0';
+            } else if (*p_ >= 'a' && *p_ <= 'f') {
+                res += 10 + *p_ - 'a';
+            } else if (*p_ >= 'A' && *p_ <= 'F') {
+                res += 10 + *p_ - 'A';
+            } else {
+                return false;
+            }
+        }
+        *out = res;
+        return true;
+    }
+
+    bool parse_string(std::string *out) {
+        rassert(*p_ == '"');
+        ++p_;
+        for (;;) {
+            // Copy runs of unescaped characters in one go.
+            const char *run = p_;
+            while (p_ != end_ && *p_ != '"' && *p_ != '\\' && *p_ != '\0') {
+                ++p_;
+            }
+            out->append(run, p_ - run);
+            if (p_ == end_ || *p_ == '\0') {
+                return false;
+            }
+            if (*p_ == '"') {
+                ++p_;
+                return true;
+            }
+
+            ++p_;
+            if (p_ == end_) {
+                return false;
+            }
+            const char c = *p_++;
+            switch (c) {
+            case 'b': out->push_back('\b'); break;
+            case 'f': out->push_back('\f'); break;
+            case 'n': out->push_back('\n'); break;
+            case 'r': out->push_back('\r'); break;
+            case 't': out->push_back('\t'); break;
+            case 'u': {
+                unsigned int uc;
+                if (!parse_hex4(&uc) || uc == 0 || (uc >= 0xDC00 && uc <= 0xDFFF)) {
+                    return false;
+                }
+                if (uc >= 0xD800 && uc <= 0xDBFF) {
+                    unsigned int uc2;
+                    if (!consume("\\u", 2) || !parse_hex4(&uc2)
+                        || uc2 < 0xDC00 || uc2 > 0xDFFF) {
+                        return false;
+                    }
+                    uc = 0x10000 + (((uc & 0x3FF) << 10) | (uc2 & 0x3FF));
+                }
+                if (uc < 0x80) {
+                    out->push_back(uc);
+                } else if (uc < 0x800) {
+                    out->push_back(0xC0 | (uc >> 6));
+                    out->push_back(0x80 | (uc & 0x3F));
+                } else if (uc < 0x10000) {
+                    out->push_back(0xE0 | (uc >> 12));
+                    out->push_back(0x80 | ((uc >> 6) & 0x3F));
+                    out->push_back(0x80 | (uc & 0x3F));
+                } else {
+                    out->push_back(0xF0 | (uc >> 18));
+                    out->push_back(0x80 | ((uc >> 12) & 0x3F));
+                    out->push_back(0x80 | ((uc >> 6) & 0x3F));
+                    out->push_back(0x80 | (uc & 0x3F));
+                }
+            } break;
+            // Like cJSON, any other escaped character stands for itself.
+            default: out->push_back(c); break;
+            }
+        }
+    }
+
+    // After a failure we give up on the whole input, so `parse_array` and
+    // `parse_object` only restore `depth_` when they succeed.
+    bool parse_array(datum_t *out) {
+        if (++depth_ > MAX_JSON_NESTING_DEPTH) {
+            return false;
+        }
+        ++p_;
+        std::vector<datum_t> array;
+        skip_whitespace();
+        if (p_ != end_ && *p_ == ']') {
+            ++p_;
+        } else {
+            for (;;) {
+                datum_t item;
+                skip_whitespace();
+                if (!parse_value(&item)) {
+                    return false;
+                }
+                array.push_back(std::move(item));
+                skip_whitespace();
+                if (p_ == end_) {
+                    return false;
+                }
+                const char c = *p_++;
+                if (c == ']') {
+                    break;
+                } else if (c != ',') {
+                    return false;
+                }
+            }
+        }
+        *out = datum_t(std::move(array), limits_);
+        --depth_;
+        return true;
+    }
+
+    bool parse_object(datum_t *out) {
+        if (++depth_ > MAX_JSON_NESTING_DEPTH) {
+            return false;
+        }
+        ++p_;
+        datum_object_builder_t builder;
+        skip_whitespace();
+        if (p_ != end_ && *p_ == '}') {
+            ++p_;
+        } else {
+            std::string key;
+            for (;;) {
+                skip_whitespace();
+                key.clear();
+                if (p_ == end_ || *p_ != '"' || !parse_string(&key)) {
+                    return false;
+                }
+                fail_if_invalid(reql_version_, key);
+                skip_whitespace();
+                if (p_ == end_ || *p_ != ':') {
+                    return false;
+                }
+                ++p_;
+                datum_t val;
+                skip_whitespace();
+                if (!parse_value(&val)) {
+                    return false;
+                }
+                bool dup = builder.add(datum_string_t(key.size(), key.data()),
+                                       std::move(val));
+                rcheck_datum(!dup, base_exc_t::GENERIC,
+                             strprintf("Duplicate key `%s` in JSON.", key.c_str()));
+                skip_whitespace();
+                if (p_ == end_) {
+                    return false;
+                }
+                const char c = *p_++;
+                if (c == '}') {
+                    break;
+                } else if (c != ',') {
+                    return false;
+                }
+            }
+        }
+        const std::set<std::string> pts = { pseudo::literal_string };
+        *out = std::move(builder).to_datum(pts);
+        --depth_;
+        return true;
+    }
+
+    const char *p_;
+    const char *const end_;
+    int depth_;
+    const configured_limits_t &limits_;
+    const reql_version_t reql_version_;
+};
+
+datum_t parse_json_datum(const char *json, size_t size,
+                         const configured_limits_t &limits,
+                         reql_version_t reql_version) {
+    return json_datum_parser_t(json, size, limits, reql_version).parse();
+}
+
 
 void check_str_validity(const char *bytes, size_t count) {
     const char *pos = static_cast<const char *>(memchr(bytes, 0, count));
@@ -1342,23 +1647,33 @@ std::pair<datum_string_t, datum_t> datum_t::unchecked_get_pair(size_t index) con
 }
 
 datum_t datum_t::get_field(const datum_string_t &key, throw_bool_t throw_bool) const {
-    // Use binary search on top of unchecked_get_pair()
-    size_t range_beg = 0;
-    // The obj_size() also makes sure that this has the right type (R_OBJECT)
-    size_t range_end = obj_size();
-    while (range_beg < range_end) {
-        const size_t center = range_beg + ((range_end - range_beg) / 2);
-        auto center_pair = unchecked_get_pair(center);
-        const int cmp = key.compare(center_pair.first);
-        if (cmp == 0) {
-            // Found it
-            return center_pair.second;
-        } else if (cmp < 0) {
-            range_end = center;
-        } else {
-            range_beg = center + 1;
+    check_type(R_OBJECT);
+    if (data.get_internal_type() == internal_type_t::BUF_R_OBJECT) {
+        // Search the serialized object in place, so that only the value we're
+        // looking for gets deserialized.
+        datum_t res = datum_get_field_from_buf(data.buf_ref, key);
+        if (res.has()) {
+            return res;
+        }
+    } else {
+        r_sanity_check(data.get_internal_type() == internal_type_t::R_OBJECT);
+        // Use binary search on top of unchecked_get_pair()
+        size_t range_beg = 0;
+        size_t range_end = data.r_object->size();
+        while (range_beg < range_end) {
+            const size_t center = range_beg + ((range_end - range_beg) / 2);
+            auto center_pair = unchecked_get_pair(center);
+            const int cmp = key.compare(center_pair.first);
+            if (cmp == 0) {
+                // Found it
+                return center_pair.second;
+            } else if (cmp < 0) {
+                range_end = center;
+            } else {
+                range_beg = center + 1;
+            }
+            rassert(range_beg <= range_end);
         }
-        rassert(range_beg <= range_end);
     }
 
     // Didn't find it
@@ -1410,6 +1725,122 @@ scoped_cJSON_t datum_t::as_json() const {
     return scoped_cJSON_t(as_json_raw());
 }
 
+// Escapes strings the way cJSON's `print_string_ptr` does, except that NULL bytes
+// are written as `\u0000` instead of ending the string.
+static void write_json_string(const char *str, size_t size, std::string *out) {
+    out->push_back('"');
+    size_t run_start = 0;
+    for (size_t i = 0; i < size; ++i) {
+        const unsigned char c = str[i];
+        if (c > 31 && c != '"' && c != '\\') {
+            continue;
+        }
+        // Copy the characters that don't need escaping in one go.
+        out->append(str + run_start, i - run_start);
+        run_start = i + 1;
+        out->push_back('\\');
+        switch (c) {
+        case '\\': out->push_back('\\'); break;
+        case '"': out->push_back('"'); break;
+        case '\b': out->push_back('b'); break;
+        case '\f': out->push_back('f'); break;
+        case '\n': out->push_back('n'); break;
+        case '\r': out->push_back('r'); break;
+        case '\t': out->push_back('t'); break;
+        default: {
+            char buf[6];
+            snprintf(buf, sizeof(buf), "u%04x", c);
+            out->append(buf, 5);
+        } break;
+        }
+    }
+    out->append(str + run_start, size - run_start);
+    out->push_back('"');
+}
+
+// Appends `d` formatted like `%.20g` would, if it's an integer that fits in a double's
+// mantissa; returns false otherwise.
+static bool write_json_integer(double d, std::string *out) {
+    const double max_exact = 9007199254740992.0;  // 2^53
+    if (!(d > -max_exact && d < max_exact) || d != floor(d)) {
+        return false;
+    }
+    uint64_t n = static_cast<uint64_t>(d < 0 ? -d : d);
+    char buf[20];
+    char *p = buf + sizeof(buf);
+    do {
+        *--p = '0' + n % 10;
+        n /= 10;
+    } while (n != 0);
+    if (d < 0) {
+        *--p = '-';
+    }
+    out->append(p, buf + sizeof(buf) - p);
+    return true;
+}
+
+void datum_t::write_json(std::string *out) const {
+    switch (get_type()) {
+    case MINVAL: rfail_datum(base_exc_t::GENERIC, "Cannot convert `r.minval` to JSON.");
+    case MAXVAL: rfail_datum(base_exc_t::GENERIC, "Cannot convert `r.maxval` to JSON.");
+    case R_NULL: out->append("null"); break;
+    case R_BINARY: {
+        out->push_back('{');
+        write_json_string(reql_type_string.data(), reql_type_string.size(), out);
+        out->push_back(':');
+        write_json_string(pseudo::binary_string, strlen(pseudo::binary_string), out);
+        out->push_back(',');
+        write_json_string(pseudo::data_key, strlen(pseudo::data_key), out);
+        out->push_back(':');
+        const std::string base64 = pseudo::encode_base64(as_binary());
+        write_json_string(base64.data(), base64.size(), out);
+        out->push_back('}');
+    } break;
+    case R_BOOL: out->append(as_bool() ? "true" : "false"); break;
+    case R_NUM: {
+        // Same format as cJSON's `print_number`.
+        const double d = as_num();
+        guarantee(risfinite(d));
+        if (d == 0.0 && std::signbit(d)) {
+            out->append("-0.0");
+        } else if (!write_json_integer(d, out)) {
+            char buf[64];
+            int len = snprintf(buf, sizeof(buf), "%.20g", d);
+            guarantee(len > 0 && static_cast<size_t>(len) < sizeof(buf));
+            out->append(buf, len);
+        }
+    } break;
+    case R_STR: write_json_string(as_str().data(), as_str().size(), out); break;
+    case R_ARRAY: {
+        out->push_back('[');
+        const size_t sz = arr_size();
+        for (size_t i = 0; i < sz; ++i) {
+            if (i != 0) {
+                out->push_back(',');
+            }
+            unchecked_get(i).write_json(out);
+        }
+        out->push_back(']');
+    } break;
+    case R_OBJECT: {
+        out->push_back('{');
+        const size_t sz = obj_size();
+        for (size_t i = 0; i < sz; ++i) {
+            if (i != 0) {
+                out->push_back(',');
+            }
+            auto pair = get_pair(i);
+            write_json_string(pair.first.data(), pair.first.size(), out);
+            out->push_back(':');
+            pair.second.write_json(out);
+        }
+        out->push_back('}');
+    } break;
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
 // TODO: make BINARY, STR, and OBJECT convertible to sequence?
 counted_t<datum_stream_t>
 datum_t::as_datum_stream(const protob_t<const Backtrace> &backtrace) const {
@@ -1658,6 +2089,164 @@ int datum_t::modern_cmp(const datum_t &rhs) const {
     }
 }
 
+// The first byte of each sort key, in the order `modern_cmp` puts the types in.  It's
+// never zero, so that a zero byte can end a list of sort keys.
+enum class sort_key_tag_t : uint8_t {
+    MINVAL = 1,
+    ARRAY,
+    BOOL,
+    NULL_,
+    NUM,
+    OBJECT,
+    BINARY,
+    TIME,
+    STR,
+    MAXVAL
+};
+
+static void append_sort_key_tag(sort_key_tag_t tag, std::string *out) {
+    out->push_back(static_cast<char>(tag));
+}
+
+// Zero bytes become 0x00 0xFF, and the string ends with 0x00 0x00, so a string sorts
+// before every longer string it's a prefix of.
+static void append_string_sort_key(const datum_string_t &str, std::string *out) {
+    const char *data = str.data();
+    for (size_t i = 0; i < str.size(); ++i) {
+        out->push_back(data[i]);
+        if (data[i] == '\0') {
+            out->push_back('\xFF');
+        }
+    }
+    out->push_back('\0');
+    out->push_back('\0');
+}
+
+// The IEEE 754 bits, big-endian, with the sign bit flipped for positive numbers and
+// all bits flipped for negative ones.
+static void append_num_sort_key(double d, std::string *out) {
+    if (d == 0) {
+        // `modern_cmp` considers -0.0 equal to 0.0.
+        d = 0;
+    }
+    uint64_t bits;
+    static_assert(sizeof(bits) == sizeof(d), "double isn't 64 bits");
+    memcpy(&bits, &d, sizeof(bits));
+    const uint64_t sign = static_cast<uint64_t>(1) << 63;
+    bits = (bits & sign) != 0 ? ~bits : bits | sign;
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        out->push_back(static_cast<char>((bits >> shift) & 0xFF));
+    }
+}
+
+bool datum_t::append_sort_key(std::string *out) const {
+    if (is_ptype()) {
+        if (get_type() == R_BINARY) {
+            append_sort_key_tag(sort_key_tag_t::BINARY, out);
+            append_string_sort_key(as_binary(), out);
+            return true;
+        } else if (get_reql_type() == pseudo::time_string) {
+            append_sort_key_tag(sort_key_tag_t::TIME, out);
+            append_num_sort_key(pseudo::time_to_epoch_time(*this), out);
+            return true;
+        }
+        // Geometry compares as an object to other data, but by its type name to the
+        // other pseudo-types, which doesn't fit into a single order.
+        return false;
+    }
+
+    switch (get_type()) {
+    case MINVAL:
+        append_sort_key_tag(sort_key_tag_t::MINVAL, out);
+        return true;
+    case MAXVAL:
+        append_sort_key_tag(sort_key_tag_t::MAXVAL, out);
+        return true;
+    case R_NULL:
+        append_sort_key_tag(sort_key_tag_t::NULL_, out);
+        return true;
+    case R_BOOL:
+        append_sort_key_tag(sort_key_tag_t::BOOL, out);
+        out->push_back(as_bool() ? 1 : 0);
+        return true;
+    case R_NUM:
+        append_sort_key_tag(sort_key_tag_t::NUM, out);
+        append_num_sort_key(as_num(), out);
+        return true;
+    case R_STR:
+        append_sort_key_tag(sort_key_tag_t::STR, out);
+        append_string_sort_key(as_str(), out);
+        return true;
+    case R_ARRAY: {
+        append_sort_key_tag(sort_key_tag_t::ARRAY, out);
+        const size_t sz = arr_size();
+        for (size_t i = 0; i < sz; ++i) {
+            if (!unchecked_get(i).append_sort_key(out)) {
+                return false;
+            }
+        }
+        out->push_back('\0');
+        return true;
+    } unreachable();
+    case R_OBJECT: {
+        append_sort_key_tag(sort_key_tag_t::OBJECT, out);
+        const size_t sz = obj_size();
+        for (size_t i = 0; i < sz; ++i) {
+            auto pair = unchecked_get_pair(i);
+            out->push_back('\1');
+            append_string_sort_key(pair.first, out);
+            if (!pair.second.append_sort_key(out)) {
+                return false;
+            }
+        }
+        out->push_back('\0');
+        return true;
+    } unreachable();
+    case R_BINARY: // This should be handled by the ptype code above
+    case UNINITIALIZED: // fallthru
+    default: unreachable();
+    }
+}
+
+size_t datum_t::hash() const {
+    size_t h = static_cast<size_t>(get_type());
+    switch (get_type()) {
+    case R_BOOL:
+        return h ^ std::hash<bool>()(as_bool());
+    case R_NUM: {
+        // 0.0 and -0.0 compare as equal.
+        double num = as_num();
+        return h ^ std::hash<double>()(num == 0 ? 0.0 : num);
+    }
+    case R_STR:
+        return h ^ std::hash<std::string>()(as_str().to_std());
+    case R_BINARY:
+        return h ^ std::hash<std::string>()(as_binary().to_std());
+    case R_ARRAY:
+        for (size_t i = 0; i < arr_size(); ++i) {
+            h = h * 31 + unchecked_get(i).hash();
+        }
+        return h;
+    case R_OBJECT:
+        if (is_ptype(pseudo::time_string)) {
+            // Times only compare their epoch time, not their time zone.
+            return h ^ std::hash<double>()(pseudo::time_to_epoch_time(*this));
+        }
+        for (size_t i = 0; i < obj_size(); ++i) {
+            auto pair = unchecked_get_pair(i);
+            h = h * 31 + std::hash<std::string>()(pair.first.to_std());
+            h = h * 31 + pair.second.hash();
+        }
+        return h;
+    case UNINITIALIZED: // fallthru
+    case MINVAL: // fallthru
+    case MAXVAL: // fallthru
+    case R_NULL: // fallthru
+    default:
+        return h;
+    }
+}
+
 bool datum_t::operator==(const datum_t &rhs) const { return modern_cmp(rhs) == 0; }
 bool datum_t::operator!=(const datum_t &rhs) const { return modern_cmp(rhs) != 0; }
 bool datum_t::compare_lt(reql_version_t reql_version, const datum_t &rhs) const {
@@ -1691,8 +2280,10 @@ datum_t to_datum(const Datum *d, const configured_limits_t &limits,
     } break;
     case Datum::R_JSON: {
         fail_if_invalid(reql_version, d->r_str());
-        scoped_cJSON_t cjson(cJSON_Parse(d->r_str().c_str()));
-        return to_datum(cjson.get(), limits, reql_version);
+        datum_t res = parse_json_datum(d->r_str().data(), d->r_str().size(),
+                                       limits, reql_version);
+        r_sanity_check(res.has());
+        return res;
     } break;
     case Datum::R_ARRAY: {
         datum_array_builder_t out(limits);
@@ -1801,7 +2392,26 @@ void datum_t::write_to_protobuf(Datum *d, use_json_t use_json) const {
     } break;
     case use_json_t::YES: {
         d->set_type(Datum::R_JSON);
-        d->set_r_str(as_json().PrintUnformatted());
+        std::string *json = d->mutable_r_str();
+        json->clear();
+        write_json(json);
+    } break;
+    case use_json_t::SERIALIZED: {
+        // We only refuse extrema at the top level.  Looking for nested ones would
+        // stop `datum_serialize` from copying serializations read from disk as is.
+        if (get_type() == MINVAL) {
+            rfail_datum(base_exc_t::GENERIC, "Cannot convert `r.minval` to a response.");
+        }
+        if (get_type() == MAXVAL) {
+            rfail_datum(base_exc_t::GENERIC, "Cannot convert `r.maxval` to a response.");
+        }
+        d->set_type(Datum::R_SERIALIZED);
+        write_message_t wm;
+        datum_serialize(&wm, *this, check_datum_serialization_errors_t::NO);
+        string_stream_t stream;
+        int res = send_write_message(&stream, &wm);
+        guarantee(res == 0);
+        *d->mutable_r_str() = std::move(stream.str());
     } break;
     default: unreachable();
     }
@@ -1854,7 +2464,11 @@ datum_t stats_merge(UNUSED const datum_string_t &key,
     return l;
 }
 
-datum_object_builder_t::datum_object_builder_t(const datum_t &copy_from) {
+datum_object_builder_t::datum_object_builder_t()
+    : map(std::less<datum_string_t>(), map_t::allocator_type(&arena)) { }
+
+datum_object_builder_t::datum_object_builder_t(const datum_t &copy_from)
+    : map(std::less<datum_string_t>(), map_t::allocator_type(&arena)) {
     const size_t copy_from_sz = copy_from.obj_size();
     for (size_t i = 0; i < copy_from_sz; ++i) {
         map.insert(copy_from.get_pair(i));
@@ -1967,13 +2581,26 @@ datum_t datum_object_builder_t::try_get(const datum_string_t &key) const {
     return it == map.end() ? datum_t() : it->second;
 }
 
+template <class... Args>
+datum_t datum_object_builder_t::to_datum_impl(Args &&... args) {
+    // This matches `datum_t::to_sorted_vec()`, which we can't use because our map
+    // has a different allocator.
+    std::vector<std::pair<datum_string_t, datum_t> > sorted_vec;
+    sorted_vec.reserve(map.size());
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        sorted_vec.push_back(std::make_pair(std::move(it->first), std::move(it->second)));
+    }
+    map.clear();
+    return datum_t(std::move(sorted_vec), std::forward<Args>(args)...);
+}
+
 datum_t datum_object_builder_t::to_datum() RVALUE_THIS {
-    return datum_t(std::move(map));
+    return to_datum_impl();
 }
 
 datum_t datum_object_builder_t::to_datum(
         const std::set<std::string> &permissible_ptypes) RVALUE_THIS {
-    return datum_t(std::move(map), permissible_ptypes);
+    return to_datum_impl(permissible_ptypes);
 }
 
 datum_array_builder_t::datum_array_builder_t(const datum_t &copy_from,
@@ -2142,6 +2769,48 @@ bool datum_range_t::contains(reql_version_t reql_version,
            (right_cmp > 0 || (right_cmp == 0 && right_bound_type == key_range_t::closed));
 }
 
+boost::optional<bool> datum_range_t::contains_sindex_key(
+        reql_version_t reql_version, const store_key_t &key) const {
+    r_sanity_check(left_bound.has() && right_bound.has());
+    // Only the latest version is known to sort keys like values.
+    if (reql_version != reql_version_t::LATEST || datum_t::key_is_truncated(key)) {
+        return boost::none;
+    }
+    components_t components = datum_t::extract_all(key_to_unescaped_str(key));
+    if (components.skey_version != skey_version_t::post_1_16) {
+        return boost::none;
+    }
+    // Untruncated secondary parts end with the NULL byte `print_secondary` appends,
+    // which `truncated_secondary` doesn't.
+    rassert(!components.secondary.empty() && components.secondary.back() == '\0');
+    components.secondary.pop_back();
+    // Untruncated keys sort like the values they were made from, and equal keys come
+    // from equal values.  So we can compare the secondary part of `key` with the
+    // bounds' keys instead -- unless a bound's key is truncated.  Extrema are never
+    // the value of a secondary index, and their keys are too long to compare anyway.
+    const size_t mts = datum_t::max_trunc_size(skey_version_t::post_1_16);
+    int left_cmp = -1;
+    if (left_bound.get_type() != datum_t::MINVAL) {
+        const store_key_t left_key = left_bound.truncated_secondary(
+            skey_version_t::post_1_16, extrema_ok_t::OK);
+        if (static_cast<size_t>(left_key.size()) >= mts) {
+            return boost::none;
+        }
+        left_cmp = key_to_unescaped_str(left_key).compare(components.secondary);
+    }
+    int right_cmp = 1;
+    if (right_bound.get_type() != datum_t::MAXVAL) {
+        const store_key_t right_key = right_bound.truncated_secondary(
+            skey_version_t::post_1_16, extrema_ok_t::OK);
+        if (static_cast<size_t>(right_key.size()) >= mts) {
+            return boost::none;
+        }
+        right_cmp = key_to_unescaped_str(right_key).compare(components.secondary);
+    }
+    return (left_cmp < 0 || (left_cmp == 0 && left_bound_type == key_range_t::closed)) &&
+           (right_cmp > 0 || (right_cmp == 0 && right_bound_type == key_range_t::closed));
+}
+
 bool datum_range_t::is_empty(reql_version_t reql_version) const {
     r_sanity_check(left_bound.has() && right_bound.has());
 
@@ -15,6 +15,7 @@
 #include <boost/optional.hpp>
 
 #include "btree/keys.hpp"
+#include "containers/arena.hpp"
 #include "containers/archive/archive.hpp"
 #include "containers/counted.hpp"
 #include "rdb_protocol/datum_string.hpp"
@@ -28,6 +29,12 @@
 // Unlike the late DBLPRI, this lacks a percent sign.
 #define PR_RECONSTRUCTABLE_DOUBLE ".20g"
 
+// How much space a `datum_object_builder_t` has for its fields before it needs to
+// allocate. Enough for two fields, which covers many small objects.  Builders live
+// on the stack of recursive functions such as the JSON parsers, so this has to
+// stay small.
+#define DATUM_OBJECT_BUILDER_INLINE_ARENA_SIZE 128
+
 class Datum;
 
 RDB_DECLARE_SERIALIZABLE(Datum);
@@ -61,7 +68,10 @@ enum throw_bool_t { NOTHROW = 0, THROW = 1 };
 // CLOBBER: Overwrite existing values.
 enum clobber_bool_t { NOCLOBBER = 0, CLOBBER = 1 };
 
-enum class use_json_t { NO = 0, YES = 1 };
+// How `write_to_protobuf` encodes a datum: as nested protobuf messages (NO), as an
+// R_JSON string (YES), or as an R_SERIALIZED string in the `datum_serialize`
+// encoding (SERIALIZED).
+enum class use_json_t { NO = 0, YES = 1, SERIALIZED = 2 };
 
 // When getting the typename of a datum, this should be YES if the name will be
 // used for sorting datums by type, and NO if the name is to be given to a user.
@@ -290,6 +300,9 @@ public:
 
     cJSON *as_json_raw() const;
     scoped_cJSON_t as_json() const;
+    // Appends the same text as `as_json().PrintUnformatted()` onto `out`, without
+    // building a cJSON tree first.
+    void write_json(std::string *out) const;
     counted_t<datum_stream_t> as_datum_stream(
             const protob_t<const Backtrace> &backtrace) const;
 
@@ -311,6 +324,17 @@ public:
     // Archaic datum_t::cmp implementation for reql_version_t::v1_13.
     int v1_13_cmp(const datum_t &rhs) const;
 
+    // Appends a binary sort key for the datum onto `out`.  Comparing two sort keys
+    // byte by byte (as unsigned chars, like `std::string::compare` does) orders them
+    // the same way `modern_cmp` orders the data, and no sort key is a prefix of
+    // another, so they can be concatenated and inverted.  Returns false, leaving a
+    // partial key in `out`, for data `modern_cmp` doesn't order consistently with
+    // the other types (geometry, unknown pseudo-types).
+    bool append_sort_key(std::string *out) const;
+
+    // Data that compare as equal (with `operator==`) have equal hashes.
+    size_t hash() const;
+
     // operator== and operator!= don't take a reql_version_t, unlike other comparison
     // functions, because we know (by inspection) that the behavior of cmp() hasn't
     // changed with respect to the question of equality vs. inequality.
@@ -442,6 +466,12 @@ public:
     static datum_range_t universe();
 
     bool contains(reql_version_t reql_version, datum_t val) const;
+    // Like `contains()`, but for the value a secondary index key was made from,
+    // without having to compute the value again.  Returns `boost::none` if the key
+    // doesn't tell -- because the key or one of the bounds is truncated, or because
+    // keys don't sort like values do in `reql_version`.
+    boost::optional<bool> contains_sindex_key(reql_version_t reql_version,
+                                              const store_key_t &key) const;
     bool is_empty(reql_version_t reql_version) const;
     bool is_universe() const;
 
@@ -470,6 +500,10 @@ private:
 
 datum_t to_datum(const Datum *d, const configured_limits_t &, reql_version_t);
 datum_t to_datum(cJSON *json, const configured_limits_t &, reql_version_t);
+// Parses JSON text straight into a datum, with the same checks as `to_datum` on the
+// cJSON tree.  Returns an empty datum if the text isn't valid JSON.
+datum_t parse_json_datum(const char *json, size_t size,
+                         const configured_limits_t &, reql_version_t);
 
 // This should only be used to send responses to the client.
 datum_t to_datum_for_client_serialization(grouped_data_t &&gd,
@@ -486,7 +520,7 @@ int64_t checked_convert_to_int(const rcheckable_t *target, double d);
 // you'll have to do check_str_validity checks yourself.
 class datum_object_builder_t {
 public:
-    datum_object_builder_t() { }
+    datum_object_builder_t();
     explicit datum_object_builder_t(const datum_t &copy_from);
 
     // Returns true if the insertion did _not_ happen because the key was already in
@@ -514,7 +548,18 @@ public:
             const std::set<std::string> &permissible_ptypes) RVALUE_THIS;
 
 private:
-    std::map<datum_string_t, datum_t> map;
+    // The builder is scratch space: `to_datum()` moves the fields out into the
+    // datum's sorted vector and the map's nodes are thrown away with the builder.
+    // So we allocate them from an arena instead of going through `malloc` for
+    // every field.
+    typedef std::map<datum_string_t, datum_t, std::less<datum_string_t>,
+                     arena_allocator_t<std::pair<const datum_string_t, datum_t> > >
+        map_t;
+    template <class... Args>
+    datum_t to_datum_impl(Args &&... args);
+
+    inline_arena_t<DATUM_OBJECT_BUILDER_INLINE_ARENA_SIZE> arena;
+    map_t map;
     DISABLE_COPYING(datum_object_builder_t);
 };
 
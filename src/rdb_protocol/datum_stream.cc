@@ -1,12 +1,16 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/datum_stream.hpp"
 
+#include <iterator>
 #include <map>
 
 #include "boost_utils.hpp"
+#include "containers/disk_backed_queue.hpp"
 #include "rdb_protocol/batching.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/func.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
 #include "rdb_protocol/term.hpp"
 #include "rdb_protocol/val.hpp"
 #include "utils.hpp"
@@ -696,7 +700,7 @@ scoped_ptr_t<val_t> datum_stream_t::run_terminal(
 }
 
 scoped_ptr_t<val_t> datum_stream_t::to_array(env_t *env) {
-    scoped_ptr_t<eager_acc_t> acc = make_to_array(env->reql_version());
+    scoped_ptr_t<eager_acc_t> acc = make_to_array();
     accumulate_all(env, acc.get());
     return acc->finish_eager(backtrace(), is_grouped(), env->limits());
 }
@@ -798,16 +802,14 @@ eager_datum_stream_t::done_t eager_datum_stream_t::next_grouped_batch(
 void eager_datum_stream_t::accumulate(
     env_t *env, eager_acc_t *acc, const terminal_variant_t &) {
     batchspec_t bs = batchspec_t::user(batch_type_t::TERMINAL, env);
-    // I'm guessing reql_version doesn't matter here, but why think about it?  We use
-    // th env's reql_version.
-    groups_t data(optional_datum_less_t(env->reql_version()));
+    groups_t data;
     while (next_grouped_batch(env, bs, &data) == done_t::NO) {
         (*acc)(env, &data);
     }
 }
 
 void eager_datum_stream_t::accumulate_all(env_t *env, eager_acc_t *acc) {
-    groups_t data(optional_datum_less_t(env->reql_version()));
+    groups_t data;
     done_t done = next_grouped_batch(env, batchspec_t::all(), &data);
     (*acc)(env, &data);
     if (done == done_t::NO) {
@@ -819,7 +821,7 @@ void eager_datum_stream_t::accumulate_all(env_t *env, eager_acc_t *acc) {
 
 std::vector<datum_t>
 eager_datum_stream_t::next_batch_impl(env_t *env, const batchspec_t &bs) {
-    groups_t data(optional_datum_less_t(env->reql_version()));
+    groups_t data;
     next_grouped_batch(env, bs, &data);
     return groups_to_batch(&data);
 }
@@ -830,11 +832,13 @@ datum_t eager_datum_stream_t::as_array(env_t *env) {
     }
 
     datum_array_builder_t arr(env->limits());
+    query_memory_charge_t memory;
     batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
     {
         profile::sampler_t sampler("Evaluating stream eagerly.", env->trace);
         datum_t d;
         while (d = next(env, batchspec), d.has()) {
+            memory.add(env, d);
             arr.add(d);
             sampler.new_sample();
         }
@@ -965,6 +969,347 @@ indexed_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batch
     return ret;
 }
 
+// EXTERNAL_SORT_DATUM_STREAM_T
+external_sort_datum_stream_t::external_sort_datum_stream_t(
+    std::function<bool(env_t *,  // NOLINT(readability/casting)
+                       profile::sampler_t *,
+                       const datum_t &,
+                       const datum_t &)> _lt_cmp,
+    const protob_t<const Backtrace> &bt_src)
+    : eager_datum_stream_t(bt_src), lt_cmp(_lt_cmp) { }
+
+external_sort_datum_stream_t::~external_sort_datum_stream_t() { }
+
+bool external_sort_datum_stream_t::can_spill(env_t *env) {
+    return env->get_rdb_ctx() != nullptr
+        && env->get_rdb_ctx()->io_backender != nullptr;
+}
+
+void external_sort_datum_stream_t::add_run(env_t *env, std::vector<datum_t> &&run) {
+    r_sanity_check(can_spill(env));
+    if (run.empty()) {
+        return;
+    }
+    {
+        profile::sampler_t sampler("Sorting run in-memory.", env->trace);
+        std::stable_sort(run.begin(), run.end(),
+                         std::bind(lt_cmp, env, &sampler, ph::_1, ph::_2));
+    }
+
+    profile::starter_t starter("Spilling sorted run to disk.", env->trace);
+    rdb_context_t *ctx = env->get_rdb_ctx();
+    scoped_ptr_t<disk_backed_queue_t<datum_t> > queue(
+        new disk_backed_queue_t<datum_t>(
+            ctx->io_backender,
+            serializer_filepath_t(ctx->base_path,
+                                  "sort_run_" + uuid_to_str(generate_uuid())),
+            &run_stats));
+    // The smallest element stays in memory as the head of the run.
+    for (size_t i = 1; i < run.size(); ++i) {
+        queue->push(run[i]);
+    }
+    heads.push_back(std::move(run[0]));
+    runs.push_back(std::move(queue));
+}
+
+std::vector<datum_t>
+external_sort_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+    std::vector<datum_t> ret;
+    batcher_t batcher = batchspec.to_batcher();
+
+    profile::sampler_t sampler("Merging sorted runs.", env->trace);
+    while (!batcher.should_send_batch()) {
+        // On ties the earlier run wins, which keeps the merge stable.
+        size_t best = heads.size();
+        for (size_t i = 0; i < heads.size(); ++i) {
+            if (heads[i].has()
+                && (best == heads.size()
+                    || lt_cmp(env, &sampler, heads[i], heads[best]))) {
+                best = i;
+            }
+        }
+        if (best == heads.size()) {
+            break;
+        }
+
+        batcher.note_el(heads[best]);
+        ret.push_back(std::move(heads[best]));
+        if (runs[best]->empty()) {
+            heads[best] = datum_t();
+            runs[best].reset();
+        } else {
+            runs[best]->pop(&heads[best]);
+        }
+    }
+    return ret;
+}
+
+bool external_sort_datum_stream_t::is_exhausted() const {
+    for (auto it = heads.begin(); it != heads.end(); ++it) {
+        if (it->has()) {
+            return false;
+        }
+    }
+    return true;
+}
+feed_type_t external_sort_datum_stream_t::cfeed_type() const {
+    return feed_type_t::not_feed;
+}
+bool external_sort_datum_stream_t::is_infinite() const {
+    return false;
+}
+bool external_sort_datum_stream_t::is_array() const {
+    return false;
+}
+
+// HASH_JOIN_DATUM_STREAM_T
+static const size_t HASH_JOIN_NUM_PARTITIONS = 16;
+
+size_t hash_join_datum_stream_t::datum_hash_t::operator()(const datum_t &d) const {
+    return d.hash();
+}
+
+hash_join_datum_stream_t::hash_join_datum_stream_t(
+    env_t *env,
+    counted_t<datum_stream_t> _left,
+    counted_t<const func_t> _left_key,
+    counted_t<datum_stream_t> right,
+    counted_t<const func_t> right_key,
+    const protob_t<const Backtrace> &bt_src)
+    : eager_datum_stream_t(bt_src),
+      left(std::move(_left)),
+      left_key(std::move(_left_key)),
+      max_table_size(env->limits().array_size_limit()),
+      table(0, datum_hash_t(), datum_eq_t(env->reql_version())),
+      table_size(0),
+      left_exhausted(false),
+      next_partition(0) {
+    profile::sampler_t sampler("Building hash table for join.", env->trace);
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    for (;;) {
+        std::vector<datum_t> rows = right->next_batch(env, batchspec);
+        if (rows.empty()) {
+            break;
+        }
+        for (auto it = rows.begin(); it != rows.end(); ++it) {
+            datum_t key = key_of(env, right_key, *it);
+            if (!key.has()) {
+                continue;
+            }
+            if (right_partitions.empty()) {
+                add_to_table(env, std::move(key), std::move(*it));
+            } else {
+                spill(env, std::move(key), std::move(*it), &right_partitions);
+            }
+            sampler.new_sample();
+        }
+    }
+}
+
+hash_join_datum_stream_t::~hash_join_datum_stream_t() { }
+
+datum_t hash_join_datum_stream_t::key_of(env_t *env,
+                                         const counted_t<const func_t> &f,
+                                         const datum_t &row) const {
+    // Like `eq_join`, skip null rows and rows without a join key.
+    if (row.get_type() == datum_t::R_NULL) {
+        return datum_t();
+    }
+    datum_t key;
+    try {
+        key = f->call(env, row)->as_datum();
+    } catch (const base_exc_t &e) {
+        if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+            throw;
+        }
+    }
+    if (key.has() && key.get_type() == datum_t::R_NULL) {
+        return datum_t();
+    }
+    return key;
+}
+
+void hash_join_datum_stream_t::add_to_table(env_t *env, datum_t &&key, datum_t &&row) {
+    table[std::move(key)].push_back(std::move(row));
+    ++table_size;
+    if (table_size <= max_table_size) {
+        return;
+    }
+    rcheck(external_sort_datum_stream_t::can_spill(env),
+           base_exc_t::GENERIC,
+           strprintf("Array over size limit `%zu`.", max_table_size));
+
+    // The right side doesn't fit into memory, so move it to temporary files.
+    rdb_context_t *ctx = env->get_rdb_ctx();
+    for (size_t i = 0; i < HASH_JOIN_NUM_PARTITIONS; ++i) {
+        const std::string suffix = uuid_to_str(generate_uuid());
+        left_partitions.push_back(scoped_ptr_t<disk_backed_queue_t<datum_t> >(
+            new disk_backed_queue_t<datum_t>(
+                ctx->io_backender,
+                serializer_filepath_t(ctx->base_path, "join_left_" + suffix),
+                &partition_stats)));
+        right_partitions.push_back(scoped_ptr_t<disk_backed_queue_t<datum_t> >(
+            new disk_backed_queue_t<datum_t>(
+                ctx->io_backender,
+                serializer_filepath_t(ctx->base_path, "join_right_" + suffix),
+                &partition_stats)));
+    }
+    for (auto it = table.begin(); it != table.end(); ++it) {
+        for (auto row = it->second.begin(); row != it->second.end(); ++row) {
+            spill(env, datum_t(it->first), std::move(*row), &right_partitions);
+        }
+    }
+    table.clear();
+    table_size = 0;
+}
+
+void hash_join_datum_stream_t::spill(
+        env_t *env, datum_t &&key, datum_t &&row,
+        std::vector<scoped_ptr_t<disk_backed_queue_t<datum_t> > > *partitions) {
+    // Use the high bits of the hash for partitioning, since the hash table uses
+    // the low ones.
+    const uint64_t mixed = static_cast<uint64_t>(datum_hash_t()(key))
+        * UINT64_C(0x9E3779B97F4A7C15);
+    const size_t partition = (mixed >> 32) % partitions->size();
+    std::vector<datum_t> pair;
+    pair.push_back(std::move(key));
+    pair.push_back(std::move(row));
+    (*partitions)[partition]->push(datum_t(std::move(pair), env->limits()));
+}
+
+void hash_join_datum_stream_t::partition_left(env_t *env) {
+    profile::sampler_t sampler("Partitioning left side of join.", env->trace);
+    batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
+    for (;;) {
+        std::vector<datum_t> rows = left->next_batch(env, batchspec);
+        if (rows.empty()) {
+            break;
+        }
+        for (auto it = rows.begin(); it != rows.end(); ++it) {
+            datum_t key = key_of(env, left_key, *it);
+            if (key.has()) {
+                spill(env, std::move(key), std::move(*it), &left_partitions);
+            }
+            sampler.new_sample();
+        }
+    }
+    left_exhausted = true;
+}
+
+bool hash_join_datum_stream_t::load_next_partition() {
+    if (next_partition >= right_partitions.size()) {
+        return false;
+    }
+    if (next_partition > 0) {
+        left_partitions[next_partition - 1].reset();
+    }
+    table.clear();
+    table_size = 0;
+    scoped_ptr_t<disk_backed_queue_t<datum_t> > partition
+        = std::move(right_partitions[next_partition]);
+    while (!partition->empty()) {
+        datum_t pair;
+        partition->pop(&pair);
+        table[pair.get(0)].push_back(pair.get(1));
+        ++table_size;
+        rcheck(table_size <= max_table_size, base_exc_t::GENERIC,
+               strprintf("Too many rows on the right side of the join share a "
+                         "partition (limit `%zu`).", max_table_size));
+    }
+    ++next_partition;
+    return true;
+}
+
+void hash_join_datum_stream_t::next_left(env_t *env, const batchspec_t &batchspec,
+                                         datum_t *key_out, datum_t *row_out) {
+    *key_out = datum_t();
+    *row_out = datum_t();
+    if (!right_partitions.empty()) {
+        if (!left_exhausted) {
+            partition_left(env);
+            load_next_partition();
+        }
+        for (;;) {
+            disk_backed_queue_t<datum_t> *partition
+                = left_partitions[next_partition - 1].get();
+            if (!partition->empty()) {
+                datum_t pair;
+                partition->pop(&pair);
+                *key_out = pair.get(0);
+                *row_out = pair.get(1);
+                return;
+            }
+            if (!load_next_partition()) {
+                return;
+            }
+        }
+    }
+
+    while (!key_out->has()) {
+        if (left_rows.empty()) {
+            if (left_exhausted) {
+                return;
+            }
+            std::vector<datum_t> rows = left->next_batch(env, batchspec);
+            if (rows.empty()) {
+                left_exhausted = true;
+                return;
+            }
+            std::move(rows.begin(), rows.end(), std::back_inserter(left_rows));
+        }
+        *row_out = std::move(left_rows.front());
+        left_rows.pop_front();
+        *key_out = key_of(env, left_key, *row_out);
+    }
+}
+
+std::vector<datum_t>
+hash_join_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &batchspec) {
+    std::vector<datum_t> ret;
+    batcher_t batcher = batchspec.to_batcher();
+
+    profile::sampler_t sampler("Probing hash table for join.", env->trace);
+    while (!batcher.should_send_batch()) {
+        if (matches.empty()) {
+            datum_t key, row;
+            next_left(env, batchspec, &key, &row);
+            if (!key.has()) {
+                break;
+            }
+            auto it = table.find(key);
+            if (it != table.end()) {
+                for (auto r = it->second.begin(); r != it->second.end(); ++r) {
+                    datum_object_builder_t joined;
+                    joined.overwrite("left", row);
+                    joined.overwrite("right", *r);
+                    matches.push_back(std::move(joined).to_datum());
+                }
+            }
+            sampler.new_sample();
+            continue;
+        }
+        batcher.note_el(matches.front());
+        ret.push_back(std::move(matches.front()));
+        matches.pop_front();
+    }
+    return ret;
+}
+
+bool hash_join_datum_stream_t::is_exhausted() const {
+    return left_exhausted && left_rows.empty() && matches.empty()
+        && next_partition >= right_partitions.size()
+        && (left_partitions.empty() || left_partitions.back()->empty());
+}
+feed_type_t hash_join_datum_stream_t::cfeed_type() const {
+    return feed_type_t::not_feed;
+}
+bool hash_join_datum_stream_t::is_infinite() const {
+    return false;
+}
+bool hash_join_datum_stream_t::is_array() const {
+    return false;
+}
+
 // ORDERED_DISTINCT_DATUM_STREAM_T
 ordered_distinct_datum_stream_t::ordered_distinct_datum_stream_t(
     counted_t<datum_stream_t> _source) : wrapper_datum_stream_t(_source) { }
@@ -1013,6 +1358,189 @@ offsets_of_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &bs) {
     return ret;
 }
 
+// GROUPED_CHANGES_DATUM_STREAM_T
+grouped_changes_datum_stream_t::grouped_changes_datum_stream_t(
+    reql_version_t reql_version,
+    std::vector<counted_t<const func_t> > &&_group_funcs,
+    grouped_reduction_t _reduction,
+    counted_t<const func_t> _value_func,
+    counted_t<datum_stream_t> _rows,
+    counted_t<datum_stream_t> _changes)
+    : wrapper_datum_stream_t(_changes),
+      group_funcs(std::move(_group_funcs)),
+      reduction(_reduction),
+      value_func(std::move(_value_func)),
+      rows(std::move(_rows)),
+      accs(optional_datum_less_t(reql_version)) {
+    guarantee(!group_funcs.empty() && rows.has() && source.has());
+}
+
+datum_t grouped_changes_datum_stream_t::group_of(env_t *env,
+                                                 const datum_t &row) const {
+    std::vector<datum_t> arr;
+    arr.reserve(group_funcs.size());
+    for (const auto &f : group_funcs) {
+        try {
+            try {
+                arr.push_back(f->call(env, row)->as_datum());
+            } catch (const base_exc_t &e) {
+                if (e.get_type() == base_exc_t::NON_EXISTENCE) {
+                    arr.push_back(datum_t::null());
+                } else {
+                    throw;
+                }
+            }
+        } catch (const datum_exc_t &e) {
+            throw exc_t(e, f->backtrace().get(), 1);
+        }
+    }
+    return arr.size() == 1
+        ? std::move(arr[0])
+        : datum_t(std::move(arr), env->limits());
+}
+
+boost::optional<double> grouped_changes_datum_stream_t::value_of(
+        env_t *env, const datum_t &row) const {
+    try {
+        return (value_func.has() ? value_func->call(env, row)->as_datum() : row)
+            .as_num();
+    } catch (const base_exc_t &e) {
+        if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+            throw;
+        }
+        return boost::none;
+    }
+}
+
+void grouped_changes_datum_stream_t::apply(env_t *env,
+                                           const datum_t &row,
+                                           bool add,
+                                           reductions_t *before) {
+    datum_t group = group_of(env, row);
+    boost::optional<double> value;
+    if (reduction != grouped_reduction_t::COUNT) {
+        value = value_of(env, row);
+    }
+    if (before->find(group) == before->end()) {
+        (*before)[group] = reduction_of(group);
+    }
+    if (add) {
+        acc_t *acc = &accs[group];
+        acc->rows += 1;
+        if (value) {
+            acc->values += 1;
+            acc->sum += *value;
+        }
+        rcheck(accs.size() <= env->limits().array_size_limit(),
+               base_exc_t::GENERIC,
+               strprintf("Too many groups (> %zu).",
+                         env->limits().array_size_limit()));
+    } else {
+        auto it = accs.find(group);
+        // A row written while we were computing the initial reductions can be
+        // removed before we've seen it.
+        if (it == accs.end()) {
+            return;
+        }
+        it->second.rows -= 1;
+        if (value && it->second.values != 0) {
+            it->second.values -= 1;
+            it->second.sum -= *value;
+        }
+        if (it->second.rows == 0) {
+            accs.erase(it);
+        }
+    }
+}
+
+datum_t grouped_changes_datum_stream_t::reduction_of(const datum_t &group) const {
+    auto it = accs.find(group);
+    if (it == accs.end()) {
+        return datum_t();
+    }
+    switch (reduction) {
+    case grouped_reduction_t::COUNT:
+        return datum_t(static_cast<double>(it->second.rows));
+    case grouped_reduction_t::SUM:
+        return datum_t(it->second.sum);
+    case grouped_reduction_t::AVG:
+        // `avg` fails on groups without any values; a changefeed can't, so we
+        // send `null` until the group has some.
+        return it->second.values == 0
+            ? datum_t::null()
+            : datum_t(it->second.sum / it->second.values);
+    default: unreachable();
+    }
+}
+
+static datum_t make_grouped_change(const datum_t &group,
+                                   const datum_t &old_val,
+                                   const datum_t &new_val) {
+    std::map<datum_string_t, datum_t> ret;
+    ret[datum_string_t("group")] = group;
+    if (old_val.has()) ret[datum_string_t("old_val")] = old_val;
+    if (new_val.has()) ret[datum_string_t("new_val")] = new_val;
+    return datum_t(std::move(ret));
+}
+
+std::vector<datum_t>
+grouped_changes_datum_stream_t::next_raw_batch(env_t *env, const batchspec_t &bs) {
+    std::vector<datum_t> ret;
+    if (rows.has()) {
+        profile::sampler_t sampler("Computing initial grouped reductions.",
+                                   env->trace);
+        reductions_t before(optional_datum_less_t(env->reql_version()));
+        batchspec_t scan_bs = batchspec_t::user(batch_type_t::TERMINAL, env);
+        for (;;) {
+            std::vector<datum_t> v = rows->next_batch(env, scan_bs);
+            if (v.size() == 0) break;
+            for (const auto &row : v) {
+                apply(env, row, true, &before);
+                sampler.new_sample();
+            }
+        }
+        rows.reset();
+        for (const auto &pair : accs) {
+            ret.push_back(make_grouped_change(
+                pair.first, datum_t(), reduction_of(pair.first)));
+        }
+        if (ret.size() != 0) {
+            return ret;
+        }
+    }
+
+    profile::sampler_t sampler("Updating grouped reductions.", env->trace);
+    const datum_t null = datum_t::null();
+    while (ret.size() == 0) {
+        std::vector<datum_t> v = source->next_batch(env, bs);
+        if (v.size() == 0) break;
+        reductions_t before(optional_datum_less_t(env->reql_version()));
+        for (const auto &change : v) {
+            datum_t error = change.get_field("error", NOTHROW);
+            // If changes were skipped the reductions would be wrong from here on.
+            rcheck(!error.has(), base_exc_t::GENERIC,
+                   strprintf("%s", error.print().c_str()));
+            datum_t old_val = change.get_field("old_val", NOTHROW);
+            if (old_val.has() && old_val != null) {
+                apply(env, old_val, false, &before);
+            }
+            datum_t new_val = change.get_field("new_val", NOTHROW);
+            if (new_val.has() && new_val != null) {
+                apply(env, new_val, true, &before);
+            }
+            sampler.new_sample();
+        }
+        for (const auto &pair : before) {
+            datum_t now = reduction_of(pair.first);
+            if (now.has() != pair.second.has()
+                || (now.has() && now != pair.second)) {
+                ret.push_back(make_grouped_change(pair.first, pair.second, now));
+            }
+        }
+    }
+    return ret;
+}
+
 // SLICE_DATUM_STREAM_T
 slice_datum_stream_t::slice_datum_stream_t(
     uint64_t _left, uint64_t _right, counted_t<datum_stream_t> _src)
@@ -1211,7 +1739,8 @@ union_datum_stream_t::union_datum_stream_t(
         env->return_empty_normal_batches,
         drainer.get_drain_signal(),
         env->get_all_optargs(),
-        trace.has() ? trace.get() : nullptr);
+        trace.has() ? trace.get() : nullptr,
+        env->usage);
 
     coro_streams.reserve(streams.size());
     for (auto &&stream : streams) {
@@ -1310,11 +1839,13 @@ datum_t union_datum_stream_t::as_array(env_t *env) {
         return datum_t();
     }
     datum_array_builder_t arr(env->limits());
+    query_memory_charge_t memory;
     batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env);
     {
         profile::sampler_t sampler("Evaluating stream eagerly.", env->trace);
         datum_t d;
         while (d = next(env, batchspec), d.has()) {
+            memory.add(env, d);
             arr.add(d);
             sampler.new_sample();
         }
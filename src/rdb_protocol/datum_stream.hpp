@@ -9,6 +9,7 @@
 #include <queue>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -23,6 +24,8 @@
 #include "rdb_protocol/real_table.hpp"
 #include "rdb_protocol/shards.hpp"
 
+template <class T> class disk_backed_queue_t;
+
 namespace ql {
 
 class env_t;
@@ -182,6 +185,54 @@ private:
     datum_t last_val;
 };
 
+enum class grouped_reduction_t { COUNT, SUM, AVG };
+
+/* Turns the changes on a selection into changes on `group(...).count()` (or
+`.sum(...)`, `.avg(...)`) of it, for `changes` on grouped reductions.  The
+reductions are computed from `rows` once, and then kept up to date from the
+`old_val`s and `new_val`s coming out of `source`, so each write costs a constant
+amount of work.  Every batch has one `{group, old_val, new_val}` object per
+group whose reduction changed (`old_val` is missing for new groups and `new_val`
+for groups that became empty). */
+class grouped_changes_datum_stream_t : public wrapper_datum_stream_t {
+public:
+    grouped_changes_datum_stream_t(reql_version_t reql_version,
+                                   std::vector<counted_t<const func_t> > &&_group_funcs,
+                                   grouped_reduction_t _reduction,
+                                   counted_t<const func_t> _value_func,
+                                   counted_t<datum_stream_t> _rows,
+                                   counted_t<datum_stream_t> _changes);
+
+private:
+    struct acc_t {
+        acc_t() : rows(0), values(0), sum(0.0) { }
+        uint64_t rows;
+        // The number of rows with a value (see `value_of`), and their sum.
+        uint64_t values;
+        double sum;
+    };
+    typedef std::map<datum_t, datum_t, optional_datum_less_t> reductions_t;
+
+    std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    // These mirror `group_trans_t` and the numeric terminals in `shards.cc`.
+    datum_t group_of(env_t *env, const datum_t &row) const;
+    boost::optional<double> value_of(env_t *env, const datum_t &row) const;
+    // Adds or removes `row`, recording the previous reduction of its group in
+    // `*before` the first time the group is touched.
+    void apply(env_t *env, const datum_t &row, bool add, reductions_t *before);
+    // Returns an empty datum if the group doesn't exist.
+    datum_t reduction_of(const datum_t &group) const;
+
+    std::vector<counted_t<const func_t> > group_funcs;
+    const grouped_reduction_t reduction;
+    counted_t<const func_t> value_func;
+    // Empty once the initial reductions have been sent.
+    counted_t<datum_stream_t> rows;
+    std::map<datum_t, acc_t, optional_datum_less_t> accs;
+};
+
 class array_datum_stream_t : public eager_datum_stream_t {
 public:
     array_datum_stream_t(datum_t _arr,
@@ -239,6 +290,125 @@ size_t index;
 std::vector<datum_t> data;
 };
 
+/* Sorts sequences that are too large to be sorted in memory.  The caller hands
+over the sequence in runs of bounded size, which get sorted and spilled to
+temporary files in the server's data directory.  The runs are merged lazily as
+the stream is read, so only the head of each run is kept in memory. */
+class external_sort_datum_stream_t : public eager_datum_stream_t {
+public:
+    external_sort_datum_stream_t(
+        std::function<bool(env_t *,  // NOLINT(readability/casting)
+                           profile::sampler_t *,
+                           const datum_t &,
+                           const datum_t &)> lt_cmp,
+        const protob_t<const Backtrace> &bt_src);
+    ~external_sort_datum_stream_t();
+
+    // Whether the server we're running on has somewhere to spill runs to.
+    static bool can_spill(env_t *env);
+
+    // Sorts `run` and writes it out to a new temporary file.  Runs must be added
+    // in the order of the original sequence for the sort to be stable.
+    void add_run(env_t *env, std::vector<datum_t> &&run);
+
+    virtual bool is_exhausted() const;
+    virtual feed_type_t cfeed_type() const;
+    virtual bool is_infinite() const;
+
+private:
+    virtual bool is_array() const;
+    virtual std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    std::function<bool(env_t *,  // NOLINT(readability/casting)
+                       profile::sampler_t *,
+                       const datum_t &,
+                       const datum_t &)> lt_cmp;
+
+    // The spilled runs and their smallest remaining elements.  A run's head is
+    // empty once the run has been exhausted.
+    perfmon_collection_t run_stats;
+    std::vector<scoped_ptr_t<disk_backed_queue_t<datum_t> > > runs;
+    std::vector<datum_t> heads;
+};
+
+/* Joins `left` with `right` on `left_key(l) == right_key(r)`, for `eq_join` with
+the `right_key` optarg.  `right` is read up front into a hash table, and `left` is
+then streamed against it.  If `right` has more matching rows than the array size
+limit, both sides are partitioned by hash into temporary files (the same way
+`external_sort_datum_stream_t` spills), and the partitions are joined one at a
+time; in that case the results are no longer in the order of `left`. */
+class hash_join_datum_stream_t : public eager_datum_stream_t {
+public:
+    hash_join_datum_stream_t(env_t *env,
+                             counted_t<datum_stream_t> left,
+                             counted_t<const func_t> left_key,
+                             counted_t<datum_stream_t> right,
+                             counted_t<const func_t> right_key,
+                             const protob_t<const Backtrace> &bt_src);
+    ~hash_join_datum_stream_t();
+
+    virtual bool is_exhausted() const;
+    virtual feed_type_t cfeed_type() const;
+    virtual bool is_infinite() const;
+
+private:
+    // Equal datums (by `datum_t::cmp`) have equal hashes.
+    class datum_hash_t {
+    public:
+        size_t operator()(const datum_t &d) const;
+    };
+    class datum_eq_t {
+    public:
+        explicit datum_eq_t(reql_version_t _reql_version)
+            : reql_version(_reql_version) { }
+        bool operator()(const datum_t &l, const datum_t &r) const {
+            return l.cmp(reql_version, r) == 0;
+        }
+    private:
+        reql_version_t reql_version;
+    };
+    typedef std::unordered_map<datum_t, std::vector<datum_t>,
+                               datum_hash_t, datum_eq_t> table_t;
+
+    virtual bool is_array() const;
+    virtual std::vector<datum_t>
+    next_raw_batch(env_t *env, const batchspec_t &batchspec);
+
+    // Returns an empty datum for rows that can't be joined.
+    datum_t key_of(env_t *env, const counted_t<const func_t> &f,
+                   const datum_t &row) const;
+    void add_to_table(env_t *env, datum_t &&key, datum_t &&row);
+    void spill(env_t *env, datum_t &&key, datum_t &&row,
+               std::vector<scoped_ptr_t<disk_backed_queue_t<datum_t> > > *partitions);
+    void partition_left(env_t *env);
+    // Returns false once all partitions have been joined.
+    bool load_next_partition();
+    // Sets `*key_out` and `*row_out` to empty datums once `left` is exhausted.
+    void next_left(env_t *env, const batchspec_t &batchspec,
+                   datum_t *key_out, datum_t *row_out);
+
+    counted_t<datum_stream_t> left;
+    counted_t<const func_t> left_key;
+    const size_t max_table_size;
+
+    table_t table;
+    size_t table_size;
+
+    // Rows of `left` that have been read but not probed yet, and matches that
+    // didn't fit into the previous batch.
+    std::deque<datum_t> left_rows;
+    std::deque<datum_t> matches;
+    bool left_exhausted;
+
+    // Only used once `right` has been spilled.  Each element of a partition is a
+    // `[key, row]` pair.
+    perfmon_collection_t partition_stats;
+    std::vector<scoped_ptr_t<disk_backed_queue_t<datum_t> > > left_partitions;
+    std::vector<scoped_ptr_t<disk_backed_queue_t<datum_t> > > right_partitions;
+    size_t next_partition;
+};
+
 struct coro_info_t;
 class coro_stream_t;
 
@@ -6,6 +6,10 @@
 #include <string.h>
 
 #include <limits>
+#include <new>
+
+#include "errors.hpp"
+#include <boost/detail/endian.hpp>
 
 #include "containers/archive/archive.hpp"
 #include "containers/archive/buffer_stream.hpp"
@@ -14,6 +18,10 @@
 #include "debug.hpp"
 #include "utils.hpp"
 
+#ifndef BOOST_LITTLE_ENDIAN
+static_assert(false, "datum_string_t::is_inline() assumes a little-endian layout.");
+#endif
+
 datum_string_t::datum_string_t() {
     init(0, "");
 }
@@ -22,11 +30,15 @@ datum_string_t::datum_string_t(size_t _size, const char *_data) {
     init(_size, _data);
 }
 
-datum_string_t::datum_string_t(const shared_buf_ref_t<char> &_ref)
-    : data_(_ref) { }
+datum_string_t::datum_string_t(const shared_buf_ref_t<char> &_ref) {
+    new (&data_) shared_buf_ref_t<char>(_ref);
+    rassert(!is_inline());
+}
 
-datum_string_t::datum_string_t(shared_buf_ref_t<char> &&_ref)
-    : data_(std::move(_ref)) { }
+datum_string_t::datum_string_t(shared_buf_ref_t<char> &&_ref) {
+    new (&data_) shared_buf_ref_t<char>(std::move(_ref));
+    rassert(!is_inline());
+}
 
 datum_string_t::datum_string_t(const char *c_str) {
     init(strlen(c_str), c_str);
@@ -36,15 +48,73 @@ datum_string_t::datum_string_t(const std::string &str) {
     init(str.size(), str.data());
 }
 
+datum_string_t::datum_string_t(const datum_string_t &copyee) {
+    assign_copy(copyee);
+}
+
+datum_string_t::datum_string_t(datum_string_t &&movee) noexcept {
+    assign_move(std::move(movee));
+}
+
+datum_string_t &datum_string_t::operator=(const datum_string_t &copyee) {
+    if (this != &copyee) {
+        // Copy first, in case `copyee` is only kept alive by our own buffer.
+        datum_string_t tmp(copyee);
+        this->~datum_string_t();
+        assign_move(std::move(tmp));
+    }
+    return *this;
+}
+
+datum_string_t &datum_string_t::operator=(datum_string_t &&movee) noexcept {
+    if (this != &movee) {
+        this->~datum_string_t();
+        assign_move(std::move(movee));
+    }
+    return *this;
+}
+
+datum_string_t::~datum_string_t() {
+    if (!is_inline()) {
+        data_.~shared_buf_ref_t<char>();
+    }
+}
+
+void datum_string_t::assign_copy(const datum_string_t &copyee) {
+    if (copyee.is_inline()) {
+        small_ = copyee.small_;
+    } else {
+        new (&data_) shared_buf_ref_t<char>(copyee.data_);
+    }
+}
+
+void datum_string_t::assign_move(datum_string_t &&movee) noexcept {
+    if (movee.is_inline()) {
+        small_ = movee.small_;
+    } else {
+        new (&data_) shared_buf_ref_t<char>(std::move(movee.data_));
+    }
+}
+
 void datum_string_t::init(size_t _size, const char *_data) {
+    static_assert(sizeof(small_) <= sizeof(data_),
+                  "Inline strings must not make datum_string_t bigger.");
+    if (_size <= MAX_INLINE_DATUM_STRING_SIZE) {
+        small_.tag = static_cast<uint8_t>((_size << 1) | 1);
+        memcpy(small_.chars, _data, _size);
+        return;
+    }
     const size_t str_offset = varint_uint64_serialized_size(_size);
     counted_t<shared_buf_t> data = shared_buf_t::create(str_offset + _size);
     serialize_varint_uint64_into_buf(_size, reinterpret_cast<uint8_t *>(data->data()));
     memcpy(data->data() + str_offset, _data, _size);
-    data_ = shared_buf_ref_t<char>(std::move(data), 0);
+    new (&data_) shared_buf_ref_t<char>(std::move(data), 0);
 }
 
 const char *datum_string_t::data() const {
+    if (is_inline()) {
+        return small_.chars;
+    }
     const size_t str_size = size();
     size_t data_offset = varint_uint64_serialized_size(str_size);
     data_.guarantee_in_boundary(data_offset + str_size);
@@ -52,6 +122,9 @@ const char *datum_string_t::data() const {
 }
 
 size_t datum_string_t::size() const {
+    if (is_inline()) {
+        return small_.tag >> 1;
+    }
     uint64_t res = 0;
     static_assert(sizeof(uint8_t) == sizeof(char), "sizeof(uint8_t) != sizeof(char)");
     buffer_read_stream_t data_stream(data_.get(), data_.get_safety_boundary());
@@ -125,16 +198,21 @@ std::string datum_string_t::to_std() const {
 datum_string_t concat(const datum_string_t &a, const datum_string_t &b) {
     const size_t a_size = a.size();
     const size_t b_size = b.size();
+    if (a_size + b_size <= datum_string_t::MAX_INLINE_DATUM_STRING_SIZE) {
+        char buf[datum_string_t::MAX_INLINE_DATUM_STRING_SIZE];
+        memcpy(buf, a.data(), a_size);
+        memcpy(buf + a_size, b.data(), b_size);
+        return datum_string_t(a_size + b_size, buf);
+    }
     const size_t str_offset = varint_uint64_serialized_size(a_size + b_size);
     counted_t<shared_buf_t> buf = shared_buf_t::create(str_offset + a_size + b_size);
     serialize_varint_uint64_into_buf(a_size + b_size,
                                      reinterpret_cast<uint8_t *>(buf->data(0)));
-    memcpy(buf->data(str_offset), a.data(), a.size());
-    memcpy(buf->data(str_offset + a.size()), b.data(), b.size());
+    memcpy(buf->data(str_offset), a.data(), a_size);
+    memcpy(buf->data(str_offset + a_size), b.data(), b_size);
     return datum_string_t(shared_buf_ref_t<char>(std::move(buf), 0));
 }
 
-
 void debug_print(printf_buffer_t *buf, const datum_string_t &s) {
     debug_print_quoted_string(buf, reinterpret_cast<const uint8_t *>(s.data()),
                               s.size());
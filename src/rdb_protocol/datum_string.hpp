@@ -2,6 +2,8 @@
 #ifndef RDB_PROTOCOL_DATUM_STRING_HPP_
 #define RDB_PROTOCOL_DATUM_STRING_HPP_
 
+#include <stdint.h>
+
 #include <string>
 
 #include "containers/archive/archive.hpp"
@@ -13,13 +15,24 @@
  * - it can contain any character, including '\0'
  *
  * Underneath `datum_string_t` uses a `shared_buf_ref_t`. This makes it
- * relatively cheap to copy.
+ * relatively cheap to copy. Strings of up to `MAX_INLINE_DATUM_STRING_SIZE` bytes
+ * that aren't backed by an existing buffer are instead stored inline, which covers
+ * most field names and many short values without any allocation or reference
+ * counting.
  */
 class datum_string_t {
 public:
+    static const size_t MAX_INLINE_DATUM_STRING_SIZE = 15;
+
     // Creates an empty datum_string_t
     datum_string_t();
 
+    datum_string_t(const datum_string_t &copyee);
+    datum_string_t(datum_string_t &&movee) noexcept;
+    datum_string_t &operator=(const datum_string_t &copyee);
+    datum_string_t &operator=(datum_string_t &&movee) noexcept;
+    ~datum_string_t();
+
     // Creates a datum_string_t with its content copied from _data
     datum_string_t(size_t _size, const char *_data);
 
@@ -59,9 +72,23 @@ private:
     void init(size_t _size, const char *_data);
     int compare(size_t other_size, const char *other_data) const;
 
-    // Contains the length of the string in varint encoding, followed by the actual
-    // string content.
-    shared_buf_ref_t<char> data_;
+    // Inline strings have the lowest bit of their first byte set. Otherwise that
+    // byte is the lowest byte of `data_`'s buffer pointer, whose lowest bit is
+    // always clear because the buffer is at least 2-byte aligned.
+    bool is_inline() const { return (small_.tag & 1) != 0; }
+    void assign_copy(const datum_string_t &copyee);
+    void assign_move(datum_string_t &&movee) noexcept;
+
+    union {
+        // Contains the length of the string in varint encoding, followed by the
+        // actual string content.
+        shared_buf_ref_t<char> data_;
+        struct {
+            // The size of the string shifted left by one, plus one.
+            uint8_t tag;
+            char chars[MAX_INLINE_DATUM_STRING_SIZE];
+        } small_;
+    };
 };
 
 datum_string_t concat(const datum_string_t &a, const datum_string_t &b);
@@ -134,11 +134,11 @@ extproc_pool_t *env_t::get_extproc_pool() {
     return rdb_ctx_->extproc_pool;
 }
 
-js_runner_t *env_t::get_js_runner() {
+js_runner_t *env_t::get_js_runner(const std::string &source) {
     assert_thread();
     extproc_pool_t *extproc_pool = get_extproc_pool();
     if (!js_runner_.connected()) {
-        js_runner_.begin(extproc_pool, interruptor, limits());
+        js_runner_.begin(extproc_pool, interruptor, limits(), source);
     }
     return &js_runner_;
 }
@@ -153,14 +153,19 @@ env_t::env_t(rdb_context_t *ctx,
              return_empty_normal_batches_t _return_empty_normal_batches,
              signal_t *_interruptor,
              std::map<std::string, wire_func_t> optargs,
-             profile::trace_t *_trace)
+             profile::trace_t *_trace,
+             resource_usage_t *_usage,
+             table_affinity_t *_table_affinity)
     : global_optargs_(std::move(optargs)),
       limits_(from_optargs(ctx, _interruptor, &global_optargs_)),
+      memory_(limits_.memory_limit()),
       reql_version_(reql_version_t::LATEST),
       regex_cache_(LRU_CACHE_SIZE),
       return_empty_normal_batches(_return_empty_normal_batches),
       interruptor(_interruptor),
       trace(_trace),
+      usage(_usage),
+      table_affinity(_table_affinity),
       evals_since_yield_(0),
       rdb_ctx_(ctx),
       eval_callback_(NULL) {
@@ -174,11 +179,14 @@ env_t::env_t(signal_t *_interruptor,
              return_empty_normal_batches_t _return_empty_normal_batches,
              reql_version_t reql_version)
     : global_optargs_(),
+      memory_(limits_.memory_limit()),
       reql_version_(reql_version),
       regex_cache_(LRU_CACHE_SIZE),
       return_empty_normal_batches(_return_empty_normal_batches),
       interruptor(_interruptor),
       trace(NULL),
+      usage(NULL),
+      table_affinity(NULL),
       evals_since_yield_(0),
       rdb_ctx_(NULL),
       eval_callback_(NULL) {
@@ -191,13 +199,57 @@ profile_bool_t profile_bool_optarg(const protob_t<Query> &query) {
     if (profile_arg.has() && profile_arg.get_type() == datum_t::type_t::R_BOOL &&
         profile_arg.as_bool()) {
         return profile_bool_t::PROFILE;
+    } else if (profile_as_trace_events_optarg(query)) {
+        return profile_bool_t::PROFILE;
     } else {
         return profile_bool_t::DONT_PROFILE;
     }
 }
 
+bool profile_as_trace_events_optarg(const protob_t<Query> &query) {
+    rassert(query.has());
+    datum_t profile_arg = static_optarg("profile", query);
+    return profile_arg.has() && profile_arg.get_type() == datum_t::type_t::R_STR
+        && profile_arg.as_str() == "trace_events";
+}
+
+query_priority_t query_priority_optarg(const protob_t<Query> &query) {
+    rassert(query.has());
+    datum_t priority_arg = static_optarg("priority", query);
+    if (!priority_arg.has()) {
+        return query_priority_t::INTERACTIVE;
+    }
+    if (priority_arg.get_type() == datum_t::type_t::R_STR) {
+        if (priority_arg.as_str() == "interactive") {
+            return query_priority_t::INTERACTIVE;
+        } else if (priority_arg.as_str() == "batch") {
+            return query_priority_t::BATCH;
+        }
+    }
+    rfail_datum(base_exc_t::GENERIC,
+                "Priority must be \"interactive\" or \"batch\" (got %s).",
+                priority_arg.trunc_print().c_str());
+}
+
+query_priority_t env_t::priority() {
+    if (!global_optargs_.has_optarg("priority")) {
+        return query_priority_t::INTERACTIVE;
+    }
+    // The query server has already checked the value.
+    scoped_ptr_t<val_t> priority_arg = global_optargs_.get_optarg(this, "priority");
+    return priority_arg->as_str() == "batch"
+        ? query_priority_t::BATCH
+        : query_priority_t::INTERACTIVE;
+}
+
 env_t::~env_t() { }
 
+regex_cache_t &env_t::regex_cache() {
+    return rdb_ctx_ != NULL
+        ? *rdb_ctx_->get_regex_cache_for_this_thread()
+        : regex_cache_;
+}
+
 void env_t::maybe_yield() {
     if (++evals_since_yield_ > EVALS_BEFORE_YIELD) {
         evals_since_yield_ = 0;
@@ -17,9 +17,11 @@
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/query_memory.hpp"
 #include "rdb_protocol/val.hpp"
 
 class extproc_pool_t;
+class table_affinity_t;
 
 namespace re2 {
 class RE2;
@@ -51,12 +53,26 @@ private:
 };
 
 profile_bool_t profile_bool_optarg(const protob_t<Query> &query);
+// True if the `profile` optarg asks for the profile in the Trace Event Format.
+bool profile_as_trace_events_optarg(const protob_t<Query> &query);
 
 scoped_ptr_t<profile::trace_t> maybe_make_profile_trace(profile_bool_t profile);
 
+/* The `priority` optarg puts a query in the interactive class (the default) or the
+batch class.  Batch queries are admitted a few at a time per thread, and their
+coroutines and shard reads run at a lower priority. */
+enum class query_priority_t { INTERACTIVE, BATCH };
+
+// Throws a `datum_exc_t` if the optarg is there but isn't "interactive" or "batch".
+query_priority_t query_priority_optarg(const protob_t<Query> &query);
+
 struct regex_cache_t {
-    explicit regex_cache_t(size_t cache_size) : regexes(cache_size) {}
+    explicit regex_cache_t(size_t cache_size,
+                           rdb_context_t::stats_t *_stats = NULL)
+        : regexes(cache_size), stats(_stats) {}
     lru_cache_t<std::string, std::shared_ptr<re2::RE2> > regexes;
+    // Where to count hits and misses, if anywhere.
+    rdb_context_t::stats_t *stats;
 };
 
 class env_t : public home_thread_mixin_t {
@@ -67,7 +83,9 @@ public:
           return_empty_normal_batches_t return_empty_normal_batches,
           signal_t *interruptor,
           std::map<std::string, wire_func_t> optargs,
-          profile::trace_t *trace);
+          profile::trace_t *trace,
+          resource_usage_t *usage,
+          table_affinity_t *table_affinity = NULL);
 
     // Used in unittest and for some secondary index environments (hence the
     // reql_version parameter).  (For secondary indexes, the interruptor definitely
@@ -84,8 +102,8 @@ public:
     extproc_pool_t *get_extproc_pool();
 
     // Returns js_runner, but first calls js_runner->begin() if it hasn't
-    // already been called.
-    js_runner_t *get_js_runner();
+    // already been called.  `source` is the JavaScript the caller is about to run.
+    js_runner_t *get_js_runner(const std::string &source);
 
     reql_cluster_interface_t *reql_cluster_interface();
 
@@ -112,7 +130,14 @@ public:
 
     configured_limits_t limits() const { return limits_; }
 
-    regex_cache_t &regex_cache() { return regex_cache_; }
+    // The priority from the `priority` optarg; see `query_priority_t`.
+    query_priority_t priority();
+
+    // The bytes the query holds in buffers, checked against `limits().memory_limit()`.
+    query_memory_t *memory() { return &memory_; }
+
+    // The thread's shared regex cache if we have an `rdb_context_t`, or our own.
+    regex_cache_t &regex_cache();
 
     reql_version_t reql_version() const { return reql_version_; }
 
@@ -124,12 +149,15 @@ private:
     // User specified configuration limits; e.g. array size limits
     const configured_limits_t limits_;
 
+    query_memory_t memory_;
+
     // The version of ReQL behavior that we should use.  Normally this is
     // LATEST_DISK, but when evaluating secondary index functions, it could be an
     // earlier value.
     const reql_version_t reql_version_;
 
-    // query specific cache parameters; for example match regexes.
+    // Match regexes, for envs without an `rdb_context_t` (e.g. for secondary index
+    // functions).
     regex_cache_t regex_cache_;
 
 public:
@@ -141,6 +169,14 @@ public:
     // This is non-empty when profiling is enabled.
     profile::trace_t *const trace;
 
+    // What the query has used so far, for the `rethinkdb.jobs` table.  NULL if
+    // this isn't a client query's environment.
+    resource_usage_t *const usage;
+
+    // Where the tables the client connection uses live.  NULL if this isn't a
+    // client query's environment.
+    table_affinity_t *const table_affinity;
+
     profile_bool_t profile() const;
 
     rdb_context_t *get_rdb_ctx() { return rdb_ctx_; }
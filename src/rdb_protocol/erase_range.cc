@@ -2,6 +2,7 @@
 #include "rdb_protocol/erase_range.hpp"
 
 #include "buffer_cache/alt.hpp"
+#include "btree/internal_node.hpp"
 #include "btree/leaf_node.hpp"
 #include "btree/node.hpp"
 #include "btree/operations.hpp"
@@ -168,3 +169,275 @@ done_traversing_t rdb_erase_small_range(
     return key_collector.get_aborted() ? done_traversing_t::NO : done_traversing_t::YES;
 }
 
+
+/* Whether every key that can be stored below a child with the key range
+(`left_excl_or_null`, `right_incl_or_null`] lies in `keys`.  Errs on the side of
+`false`. */
+bool subtree_is_covered(const key_range_t &keys,
+                        const btree_key_t *left_excl_or_null,
+                        const btree_key_t *right_incl_or_null) {
+    if (left_excl_or_null == nullptr
+            ? keys.left.size() != 0
+            : btree_key_cmp(keys.left.btree_key(), left_excl_or_null) > 0) {
+        return false;
+    }
+    return keys.right.unbounded
+        || (right_incl_or_null != nullptr
+            && btree_key_cmp(right_incl_or_null, keys.right.key.btree_key()) < 0);
+}
+
+/* Whether a child with the given key range might hold keys in `keys`.  Errs on the
+side of `true`. */
+bool subtree_overlaps(const key_range_t &keys,
+                      const btree_key_t *left_excl_or_null,
+                      const btree_key_t *right_incl_or_null) {
+    if (right_incl_or_null != nullptr
+            && btree_key_cmp(right_incl_or_null, keys.left.btree_key()) < 0) {
+        return false;
+    }
+    return keys.right.unbounded
+        || left_excl_or_null == nullptr
+        || btree_key_cmp(left_excl_or_null, keys.right.key.btree_key()) < 0;
+}
+
+/* Returns the number of keys it erased. */
+int64_t erase_range_in_leaf(value_sizer_t *sizer,
+                            buf_lock_t *buf,
+                            const key_range_t &keys,
+                            const value_deleter_t *deleter) {
+    std::vector<store_key_t> erased_keys;
+    {
+        buf_read_t read(buf);
+        const leaf_node_t *leaf = static_cast<const leaf_node_t *>(read.get_data_read());
+        for (auto it = leaf::inclusive_lower_bound(keys.left.btree_key(), *leaf);
+             it != leaf::end(*leaf);
+             ++it) {
+            const btree_key_t *key = (*it).first;
+            if (!keys.right.unbounded
+                    && btree_key_cmp(key, keys.right.key.btree_key()) >= 0) {
+                break;
+            }
+            deleter->delete_value(buf_parent_t(buf), (*it).second);
+            erased_keys.push_back(store_key_t(key));
+        }
+    }
+    if (!erased_keys.empty()) {
+        buf_write_t write(buf);
+        leaf_node_t *leaf = static_cast<leaf_node_t *>(write.get_data_write());
+        for (const store_key_t &key : erased_keys) {
+            leaf::erase_presence(sizer, leaf, key.btree_key(),
+                                 key_modification_proof_t::real_proof());
+        }
+    }
+    return erased_keys.size();
+}
+
+/* Counts the keys in the subtree rooted at `block_id`. */
+int64_t count_keys_in_subtree(buf_parent_t parent, block_id_t block_id) {
+    buf_lock_t buf(parent, block_id, access_t::read);
+    std::vector<block_id_t> children;
+    {
+        buf_read_t read(&buf);
+        const node_t *node = static_cast<const node_t *>(read.get_data_read());
+        if (node::is_leaf(node)) {
+            const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(node);
+            int64_t count = 0;
+            for (auto it = leaf::begin(*leaf); it != leaf::end(*leaf); ++it) {
+                ++count;
+            }
+            return count;
+        }
+        const internal_node_t *inode = reinterpret_cast<const internal_node_t *>(node);
+        for (int i = 0; i < inode->npairs; ++i) {
+            children.push_back(internal_node::get_pair_by_index(inode, i)->lnode);
+        }
+    }
+    int64_t count = 0;
+    for (block_id_t child_id : children) {
+        count += count_keys_in_subtree(buf_parent_t(&buf), child_id);
+    }
+    return count;
+}
+
+/* Returns the number of keys it erased, not counting the ones in cut subtrees unless
+`count_cut_keys` is true. */
+int64_t erase_range_in_subtree(value_sizer_t *sizer,
+                               buf_lock_t *buf,
+                               const key_range_t &keys,
+                               const btree_key_t *left_excl_or_null,
+                               const btree_key_t *right_incl_or_null,
+                               const value_deleter_t *deleter,
+                               bool count_cut_keys,
+                               std::vector<block_id_t> *detached_subtrees_out) {
+    struct child_t {
+        int index;
+        block_id_t block_id;
+        bool has_left;
+        bool has_right;
+        store_key_t left_excl;
+        store_key_t right_incl;
+        bool cut;
+    };
+    std::vector<child_t> children;
+    bool is_leaf;
+    {
+        buf_read_t read(buf);
+        const node_t *node = static_cast<const node_t *>(read.get_data_read());
+        is_leaf = node::is_leaf(node);
+        if (!is_leaf) {
+            const internal_node_t *inode =
+                reinterpret_cast<const internal_node_t *>(node);
+            for (int i = 0; i < inode->npairs; ++i) {
+                const btree_internal_pair *pair =
+                    internal_node::get_pair_by_index(inode, i);
+                const btree_key_t *left = i == 0
+                    ? left_excl_or_null
+                    : &internal_node::get_pair_by_index(inode, i - 1)->key;
+                const btree_key_t *right = i == inode->npairs - 1
+                    ? right_incl_or_null
+                    : &pair->key;
+                if (!subtree_overlaps(keys, left, right)) {
+                    continue;
+                }
+                child_t child;
+                child.index = i;
+                child.block_id = pair->lnode;
+                child.has_left = left != nullptr;
+                child.has_right = right != nullptr;
+                if (child.has_left) {
+                    child.left_excl.assign(left);
+                }
+                if (child.has_right) {
+                    child.right_incl.assign(right);
+                }
+                child.cut = subtree_is_covered(keys, left, right);
+                children.push_back(child);
+            }
+
+            /* The node must keep at least two children, or the code that fixes
+            underfull nodes can't find a sibling to merge them with.  The covered
+            children we keep are emptied by recursing into them instead. */
+            int kept = inode->npairs;
+            for (const child_t &child : children) {
+                if (child.cut) {
+                    --kept;
+                }
+            }
+            for (child_t &child : children) {
+                if (kept >= 2) {
+                    break;
+                }
+                if (child.cut) {
+                    child.cut = false;
+                    ++kept;
+                }
+            }
+        }
+    }
+
+    if (is_leaf) {
+        return erase_range_in_leaf(sizer, buf, keys, deleter);
+    }
+
+    int64_t erased = 0;
+    if (count_cut_keys) {
+        for (const child_t &child : children) {
+            if (child.cut) {
+                erased += count_keys_in_subtree(buf_parent_t(buf), child.block_id);
+            }
+        }
+    }
+
+    {
+        buf_write_t write(buf);
+        internal_node_t *inode = static_cast<internal_node_t *>(write.get_data_write());
+        /* Go right to left, so that removing a pair doesn't shift the indices of the
+        ones we have yet to remove. */
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            if (it->cut) {
+                internal_node::remove_by_index(sizer->block_size(), inode, it->index);
+                buf->detach_child(it->block_id);
+                detached_subtrees_out->push_back(it->block_id);
+            }
+        }
+    }
+
+    /* The children we kept still have their old key ranges as far as their contents
+    are concerned, even if they have taken over the ranges of cut neighbors. */
+    for (const child_t &child : children) {
+        if (!child.cut) {
+            buf_lock_t child_buf(buf, child.block_id, access_t::write);
+            erased += erase_range_in_subtree(
+                sizer, &child_buf, keys,
+                child.has_left ? child.left_excl.btree_key() : nullptr,
+                child.has_right ? child.right_incl.btree_key() : nullptr,
+                deleter, count_cut_keys, detached_subtrees_out);
+        }
+    }
+    return erased;
+}
+
+void rdb_erase_major_range(
+        const key_range_t &keys,
+        superblock_t *superblock,
+        const value_deleter_t *deleter,
+        std::vector<block_id_t> *detached_subtrees_out) {
+    const block_id_t root_id = superblock->get_root_block_id();
+    if (root_id == NULL_BLOCK_ID) {
+        return;
+    }
+    /* When the whole btree goes, its population drops to zero and there is no need
+    to count the keys in the subtrees that we cut. */
+    const bool erases_everything = keys.is_superset(key_range_t::universe());
+    rdb_value_sizer_t sizer(superblock->cache()->max_block_size());
+    buf_lock_t root(superblock->expose_buf(), root_id, access_t::write);
+    const int64_t erased = erase_range_in_subtree(
+        &sizer, &root, keys, nullptr, nullptr, deleter, !erases_everything,
+        detached_subtrees_out);
+
+    // See `apply_keyvalue_change()` about why the stat block's parent is the txn.
+    const block_id_t stat_block_id = superblock->get_stat_block_id();
+    if (stat_block_id != NULL_BLOCK_ID) {
+        buf_lock_t stat_block(buf_parent_t(root.txn()), stat_block_id, access_t::write);
+        buf_write_t stat_block_write(&stat_block);
+        auto stat_block_buf = static_cast<btree_statblock_t *>(
+                stat_block_write.get_data_write(BTREE_STATBLOCK_SIZE));
+        if (erases_everything) {
+            stat_block_buf->population = 0;
+        } else {
+            stat_block_buf->population -= erased;
+        }
+    }
+}
+
+void rdb_free_detached_subtrees(
+        txn_t *txn,
+        std::vector<block_id_t> *subtrees,
+        size_t max_blocks,
+        const value_deleter_t *deleter) {
+    for (size_t i = 0; i < max_blocks && !subtrees->empty(); ++i) {
+        const block_id_t block_id = subtrees->back();
+        subtrees->pop_back();
+        buf_lock_t buf(buf_parent_t(txn), block_id, access_t::write);
+        {
+            buf_read_t read(&buf);
+            const node_t *node = static_cast<const node_t *>(read.get_data_read());
+            if (node::is_leaf(node)) {
+                const leaf_node_t *leaf = reinterpret_cast<const leaf_node_t *>(node);
+                for (auto it = leaf::begin(*leaf); it != leaf::end(*leaf); ++it) {
+                    deleter->delete_value(buf_parent_t(&buf), (*it).second);
+                }
+            } else {
+                const internal_node_t *inode =
+                    reinterpret_cast<const internal_node_t *>(node);
+                for (int j = 0; j < inode->npairs; ++j) {
+                    const block_id_t child_id =
+                        internal_node::get_pair_by_index(inode, j)->lnode;
+                    buf.detach_child(child_id);
+                    subtrees->push_back(child_id);
+                }
+            }
+        }
+        buf.mark_deleted();
+    }
+}
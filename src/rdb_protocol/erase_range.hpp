@@ -15,6 +15,8 @@ class deletion_context_t;
 struct rdb_modification_report_t;
 class superblock_t;
 class signal_t;
+class txn_t;
+class value_deleter_t;
 
 class key_tester_t {
 public:
@@ -51,4 +53,37 @@ done_traversing_t rdb_erase_small_range(
     std::vector<rdb_modification_report_t> *mod_reports_out,
     key_range_t *deleted_out);
 
+/* `rdb_erase_major_range` erases every key in `keys` without visiting most of them.
+ * Each subtree whose key range lies entirely inside `keys` is cut out of its parent
+ * as a whole, and only the leaves at the boundaries of `keys` are edited key by key,
+ * so the nodes written while holding the superblock are O(log n) rather than O(m)
+ * keys.  (A node always keeps at least two children, so a few covered leaves may be
+ * emptied in place instead of being cut.)
+ * The block ids of the cut subtrees are appended to `detached_subtrees_out`; their
+ * blocks are unreachable but not yet freed, which is what
+ * `rdb_free_detached_subtrees` is for.  Values in the boundary leaves are deleted
+ * through `deleter` right away.
+ * The btree's population in its stat block drops by the number of keys erased, which
+ * means reading the cut subtrees to count their keys unless `keys` is the whole key
+ * space.
+ * No modification reports are generated, so this must only be used on a btree that
+ * has no live secondary indexes. */
+void rdb_erase_major_range(
+    const key_range_t &keys,
+    superblock_t *superblock,
+    const value_deleter_t *deleter,
+    std::vector<block_id_t> *detached_subtrees_out);
+
+/* Frees the blocks of subtrees cut out by `rdb_erase_major_range`, and deletes the
+ * values in their leaves through `deleter`.  It frees up to `max_blocks` nodes
+ * (not counting blob blocks) from the back of `*subtrees` in `txn`, and pushes the
+ * children of the internal nodes it frees back onto `*subtrees`, so that a large
+ * subtree can be freed over many small transactions.  The caller is done once
+ * `*subtrees` is empty. */
+void rdb_free_detached_subtrees(
+    txn_t *txn,
+    std::vector<block_id_t> *subtrees,
+    size_t max_blocks,
+    const value_deleter_t *deleter);
+
 #endif  // RDB_PROTOCOL_ERASE_RANGE_HPP_
@@ -0,0 +1,201 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/filter_planner.hpp"
+
+#include <string.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "rdb_protocol/btree.hpp"
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/filter_predicate.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/real_table.hpp"
+#include "rdb_protocol/val.hpp"
+
+namespace ql {
+
+// How many rows of the table the cost estimates are based on.
+const uint64_t FILTER_PLANNER_SAMPLE_SIZE = 100;
+
+// How many rows of a scan of the primary index cost as much as reading one row
+// through a secondary index, which takes a lookup in the primary index for each
+// index entry.
+const uint64_t INDEX_ROW_COST = 4;
+
+/* The tightest bounds that a filter's comparisons put on one field. */
+class field_bounds_t {
+public:
+    field_bounds_t() : left_type(key_range_t::none), right_type(key_range_t::none) { }
+
+    void add(reql_version_t reql_version, Term::TermType type, const datum_t &value) {
+        if (type == Term::EQ || type == Term::GT || type == Term::GE) {
+            tighten(reql_version, value,
+                    type == Term::GT ? key_range_t::open : key_range_t::closed,
+                    1, &left, &left_type);
+        }
+        if (type == Term::EQ || type == Term::LT || type == Term::LE) {
+            tighten(reql_version, value,
+                    type == Term::LT ? key_range_t::open : key_range_t::closed,
+                    -1, &right, &right_type);
+        }
+    }
+
+    // Returns false unless both bounds are numbers, strings or booleans of the same
+    // type, so that every value in between can be indexed and no value of another
+    // type is.
+    bool to_range(datum_range_t *range_out) const {
+        if (!left.has() || !right.has() || left.get_type() != right.get_type()) {
+            return false;
+        }
+        const datum_t::type_t type = left.get_type();
+        if (type != datum_t::R_NUM && type != datum_t::R_STR
+            && type != datum_t::R_BOOL) {
+            return false;
+        }
+        *range_out = datum_range_t(left, left_type, right, right_type);
+        return true;
+    }
+
+private:
+    // `direction` is 1 if bigger values are tighter, -1 if smaller ones are.
+    static void tighten(reql_version_t reql_version,
+                        const datum_t &value, key_range_t::bound_t value_type,
+                        int direction,
+                        datum_t *bound, key_range_t::bound_t *bound_type) {
+        if (!bound->has()) {
+            *bound = value;
+            *bound_type = value_type;
+            return;
+        }
+        const int cmp = value.cmp(reql_version, *bound) * direction;
+        if (cmp > 0) {
+            *bound = value;
+            *bound_type = value_type;
+        } else if (cmp == 0 && value_type == key_range_t::open) {
+            *bound_type = key_range_t::open;
+        }
+    }
+
+    datum_t left, right;
+    key_range_t::bound_t left_type, right_type;
+};
+
+// Returns the field that the index with the given `index_status()` entry is on, or
+// an empty string if it isn't a ready index on a single top-level field.
+static datum_string_t get_index_field(const datum_t &status) {
+    datum_t ready = status.get_field("ready", NOTHROW);
+    datum_t function = status.get_field("function", NOTHROW);
+    if (!ready.has() || ready.get_type() != datum_t::R_BOOL || !ready.as_bool()
+        || !function.has() || function.get_type() != datum_t::R_BINARY) {
+        return datum_string_t();
+    }
+    const datum_string_t &blob = function.as_binary();
+    const size_t prefix_size = strlen(sindex_blob_prefix);
+    if (blob.size() < prefix_size
+        || memcmp(blob.data(), sindex_blob_prefix, prefix_size) != 0) {
+        return datum_string_t();
+    }
+    sindex_disk_info_t info;
+    try {
+        deserialize_sindex_info(
+            std::vector<char>(blob.data() + prefix_size, blob.data() + blob.size()),
+            &info);
+    } catch (const archive_exc_t &) {
+        return datum_string_t();
+    }
+    std::vector<datum_string_t> path;
+    if (info.multi != sindex_multi_bool_t::SINGLE
+        || info.geo != sindex_geo_bool_t::REGULAR
+        || !filter_predicate_t::get_field_path(info.mapping.compile_wire_func(), &path)
+        || path.size() != 1) {
+        return datum_string_t();
+    }
+    return path[0];
+}
+
+bool plan_filter_index(env_t *env,
+                       const counted_t<table_t> &table,
+                       const counted_t<const func_t> &f,
+                       filter_index_plan_t *plan_out) {
+    if (table->use_outdated_reads()) {
+        return false;
+    }
+    scoped_ptr_t<filter_predicate_t> predicate = filter_predicate_t::compile(f);
+    if (!predicate.has()) {
+        return false;
+    }
+    std::vector<filter_predicate_t::comparison_t> comparisons;
+    predicate->get_required_comparisons(&comparisons);
+    if (comparisons.empty()) {
+        return false;
+    }
+
+    std::map<datum_string_t, field_bounds_t> bounds;
+    for (const auto &comparison : comparisons) {
+        bounds[comparison.field].add(
+            env->reql_version(), comparison.type, comparison.value);
+    }
+    std::map<datum_string_t, datum_range_t> ranges;
+    for (const auto &pair : bounds) {
+        datum_range_t range;
+        if (pair.second.to_range(&range)) {
+            ranges.insert(std::make_pair(pair.first, range));
+        }
+    }
+    if (ranges.empty()) {
+        return false;
+    }
+
+    std::vector<filter_index_plan_t> candidates;
+    std::vector<datum_string_t> candidate_fields;
+    std::vector<datum_t> sample;
+    try {
+        std::map<std::string, datum_t> statuses =
+            table->tbl->sindex_status(env, std::set<std::string>());
+        for (const auto &pair : statuses) {
+            datum_string_t field = get_index_field(pair.second);
+            auto it = ranges.find(field);
+            if (!field.empty() && it != ranges.end()) {
+                candidates.push_back(filter_index_plan_t{pair.first, it->second});
+                candidate_fields.push_back(field);
+            }
+        }
+        if (candidates.empty()
+            || !table->sample(env, FILTER_PLANNER_SAMPLE_SIZE, &sample)) {
+            return false;
+        }
+    } catch (const base_exc_t &) {
+        // If we can't get the statistics the filter can still scan the table, and
+        // report any errors from that.
+        return false;
+    }
+    if (sample.empty()) {
+        return false;
+    }
+
+    // A scan of the primary index reads every row of the sample.
+    uint64_t best_cost = sample.size();
+    bool found = false;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        uint64_t matches = 0;
+        for (const datum_t &row : sample) {
+            datum_t value = filter_predicate_t::lookup_path(
+                std::vector<datum_string_t>(1, candidate_fields[i]), row);
+            if (value.has()
+                && candidates[i].range.contains(env->reql_version(), value)) {
+                ++matches;
+            }
+        }
+        const uint64_t cost = matches * INDEX_ROW_COST;
+        if (cost < best_cost) {
+            best_cost = cost;
+            *plan_out = candidates[i];
+            found = true;
+        }
+    }
+    return found;
+}
+
+}  // namespace ql
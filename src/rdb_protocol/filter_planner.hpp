@@ -0,0 +1,42 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_FILTER_PLANNER_HPP_
+#define RDB_PROTOCOL_FILTER_PLANNER_HPP_
+
+#include <string>
+
+#include "containers/counted.hpp"
+#include "rdb_protocol/datum.hpp"
+
+namespace ql {
+
+class env_t;
+class func_t;
+class table_t;
+
+/* `plan_filter_index()` decides whether `table.filter(f)` should read a range of a
+secondary index instead of the whole table.
+
+It looks for the top-level fields that `f` requires to be within a range bounded on
+both sides by values of the same type (e.g. `r.row('age').ge(20).and(r.row('age').lt(
+30))`, or `{status: 'active'}`), and for ready single-field indexes on those fields.
+All values in such a range can be indexed, so the index range holds every row that
+could pass the filter. The filter itself still has to be applied to the rows that
+come back.
+
+To pick between the candidate indexes and a full scan, it estimates their costs from
+a small random sample of the table's rows: reading a row through an index costs
+about `INDEX_ROW_COST` times as much as reading it in a scan of the primary index. */
+struct filter_index_plan_t {
+    std::string sindex;
+    datum_range_t range;
+};
+
+// Returns false if `table.filter(f)` should read the whole table.
+bool plan_filter_index(env_t *env,
+                       const counted_t<table_t> &table,
+                       const counted_t<const func_t> &f,
+                       filter_index_plan_t *plan_out);
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_FILTER_PLANNER_HPP_
@@ -0,0 +1,409 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/filter_predicate.hpp"
+
+#include "rdb_protocol/configured_limits.hpp"
+#include "rdb_protocol/func.hpp"
+#include "rdb_protocol/pseudo_literal.hpp"
+
+namespace ql {
+
+/* Walks the source of a one-argument ReQL function.  We look at the `Term`
+protobufs rather than at the compiled terms, since the compiled terms don't
+expose their arguments. */
+static bool is_comparison(Term::TermType type) {
+    return type == Term::EQ || type == Term::NE
+        || type == Term::LT || type == Term::LE
+        || type == Term::GT || type == Term::GE;
+}
+
+class filter_predicate_t::compiler_t : public func_visitor_t {
+public:
+    compiler_t() : func(NULL) { }
+
+    void on_reql_func(const reql_func_t *reql_func) {
+        func = reql_func;
+    }
+    void on_js_func(const js_func_t *) { }
+
+    bool compile_bool(const Term &t, node_t *out) const {
+        if (t.optargs_size() != 0) {
+            return false;
+        }
+        out->type = t.type();
+        if (is_comparison(t.type())) {
+            return t.args_size() == 2
+                && compile_operand(t.args(0), &out->lhs)
+                && compile_operand(t.args(1), &out->rhs);
+        } else if (t.type() == Term::AND || t.type() == Term::OR
+                   || t.type() == Term::NOT) {
+            if (t.args_size() == 0 || (t.type() == Term::NOT && t.args_size() != 1)) {
+                return false;
+            }
+            out->children.resize(t.args_size());
+            for (int i = 0; i < t.args_size(); ++i) {
+                if (!compile_bool(t.args(i), &out->children[i])) {
+                    return false;
+                }
+            }
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    bool compile_path(const Term &t, std::vector<datum_string_t> *path) const {
+        if (t.optargs_size() != 0) {
+            return false;
+        }
+        if (t.type() == Term::VAR) {
+            return t.args_size() == 1
+                && t.args(0).type() == Term::DATUM
+                && t.args(0).has_datum()
+                && t.args(0).datum().type() == Datum::R_NUM
+                && t.args(0).datum().r_num()
+                   == static_cast<double>(func->arg_names[0].value);
+        } else if (t.type() == Term::IMPLICIT_VAR) {
+            // `r.row` can't be used in nested functions, so inside a one-argument
+            // function it always refers to that argument.
+            return t.args_size() == 0;
+        } else if (t.type() == Term::BRACKET || t.type() == Term::GET_FIELD) {
+            if (t.args_size() != 2
+                || t.args(1).type() != Term::DATUM
+                || !t.args(1).has_datum()
+                || t.args(1).datum().type() != Datum::R_STR
+                || !compile_path(t.args(0), path)) {
+                return false;
+            }
+            path->push_back(datum_string_t(t.args(1).datum().r_str()));
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    const reql_func_t *func;
+
+private:
+    bool compile_operand(const Term &t, operand_t *out) const {
+        if (t.type() == Term::DATUM) {
+            if (!t.has_datum()) {
+                return false;
+            }
+            // Arrays and objects normally arrive as `MAKE_ARRAY` and `MAKE_OBJ`
+            // terms; we stick to scalars so that no limits can apply.
+            const Datum::DatumType type = t.datum().type();
+            if (type != Datum::R_NULL && type != Datum::R_BOOL
+                && type != Datum::R_NUM && type != Datum::R_STR) {
+                return false;
+            }
+            try {
+                out->literal = to_datum(&t.datum(), configured_limits_t(),
+                                        reql_version_t::LATEST);
+            } catch (const base_exc_t &) {
+                return false;
+            }
+            return true;
+        }
+        return compile_path(t, &out->path);
+    }
+};
+
+scoped_ptr_t<filter_predicate_t> filter_predicate_t::compile(
+        const counted_t<const func_t> &f) {
+    compiler_t compiler;
+    f->visit(&compiler);
+    if (compiler.func == NULL) {
+        return scoped_ptr_t<filter_predicate_t>();
+    }
+    scoped_ptr_t<filter_predicate_t> res(new filter_predicate_t());
+    const Term &body = *compiler.func->body->get_src();
+    if (body.type() == Term::DATUM) {
+        // `filter({...})` is wrapped into a function returning the object, which
+        // `reql_func_t::filter_helper` then matches against the row.
+        if (!body.has_datum() || body.datum().type() != Datum::R_OBJECT) {
+            return scoped_ptr_t<filter_predicate_t>();
+        }
+        try {
+            res->root.lhs.literal = to_datum(&body.datum(), configured_limits_t(),
+                                             reql_version_t::LATEST);
+        } catch (const base_exc_t &) {
+            return scoped_ptr_t<filter_predicate_t>();
+        }
+        if (res->root.lhs.literal.get_type() != datum_t::R_OBJECT
+            || res->root.lhs.literal.is_ptype()) {
+            return scoped_ptr_t<filter_predicate_t>();
+        }
+        res->root.type = Term::DATUM;
+        return res;
+    }
+    if (compiler.func->arg_names.size() != 1
+        || !compiler.compile_bool(body, &res->root)) {
+        return scoped_ptr_t<filter_predicate_t>();
+    }
+    return res;
+}
+
+bool filter_predicate_t::get_field_path(const counted_t<const func_t> &f,
+                                        std::vector<datum_string_t> *path_out) {
+    compiler_t compiler;
+    f->visit(&compiler);
+    if (compiler.func == NULL || compiler.func->arg_names.size() != 1) {
+        return false;
+    }
+    path_out->clear();
+    return compiler.compile_path(*compiler.func->body->get_src(), path_out)
+        && !path_out->empty();
+}
+
+bool filter_predicate_t::only_uses_top_level_fields() const {
+    return only_top_level(root);
+}
+
+bool filter_predicate_t::only_top_level(const node_t &node) {
+    if (node.type == Term::AND || node.type == Term::OR || node.type == Term::NOT) {
+        for (auto it = node.children.begin(); it != node.children.end(); ++it) {
+            if (!only_top_level(*it)) {
+                return false;
+            }
+        }
+        return true;
+    } else if (node.type == Term::DATUM) {
+        // Matching nested objects could run into non-objects in the row.
+        for (size_t i = 0; i < node.lhs.literal.obj_size(); ++i) {
+            if (node.lhs.literal.get_pair(i).second.get_type() == datum_t::R_OBJECT) {
+                return false;
+            }
+        }
+        return true;
+    } else {
+        return node.lhs.path.size() <= 1 && node.rhs.path.size() <= 1;
+    }
+}
+
+boost::optional<bool> filter_predicate_t::test(reql_version_t reql_version,
+                                               const datum_t &row) const {
+    return test_node(reql_version, root, row);
+}
+
+boost::optional<bool> filter_predicate_t::test_node(reql_version_t reql_version,
+                                                    const node_t &node,
+                                                    const datum_t &row) {
+    if (node.type == Term::AND) {
+        // Like `and_term_t`, later arguments aren't looked at once one is false.
+        for (auto it = node.children.begin(); it != node.children.end(); ++it) {
+            boost::optional<bool> res = test_node(reql_version, *it, row);
+            if (!res || !*res) {
+                return res;
+            }
+        }
+        return true;
+    } else if (node.type == Term::OR) {
+        for (auto it = node.children.begin(); it != node.children.end(); ++it) {
+            boost::optional<bool> res = test_node(reql_version, *it, row);
+            if (!res || *res) {
+                return res;
+            }
+        }
+        return false;
+    } else if (node.type == Term::NOT) {
+        boost::optional<bool> res = test_node(reql_version, node.children[0], row);
+        if (!res) {
+            return res;
+        }
+        return !*res;
+    } else if (node.type == Term::DATUM) {
+        return match_object(node.lhs.literal, row);
+    }
+
+    datum_t lhs = resolve(node.lhs, row);
+    if (!lhs.has()) {
+        return boost::none;
+    }
+    datum_t rhs = resolve(node.rhs, row);
+    if (!rhs.has()) {
+        return boost::none;
+    }
+    // These match the predicates in `predicate_term_t`.
+    if (node.type == Term::EQ) {
+        return lhs == rhs;
+    } else if (node.type == Term::NE) {
+        return !(lhs == rhs);
+    }
+    const int cmp = lhs.cmp(reql_version, rhs);
+    if (node.type == Term::LT) {
+        return cmp < 0;
+    } else if (node.type == Term::LE) {
+        return cmp <= 0;
+    } else if (node.type == Term::GT) {
+        return cmp > 0;
+    } else {
+        guarantee(node.type == Term::GE);
+        return cmp >= 0;
+    }
+}
+
+// Mirrors `filter_match`, except that we give up instead of throwing.
+boost::optional<bool> filter_predicate_t::match_object(const datum_t &predicate,
+                                                       const datum_t &row) {
+    if (predicate.is_ptype(pseudo::literal_string)) {
+        return predicate.get_field(pseudo::value_key) == row;
+    }
+    if (row.get_type() != datum_t::R_OBJECT) {
+        return boost::none;
+    }
+    for (size_t i = 0; i < predicate.obj_size(); ++i) {
+        auto pair = predicate.get_pair(i);
+        datum_t elt = row.get_field(pair.first, NOTHROW);
+        if (!elt.has()) {
+            return boost::none;
+        } else if (pair.second.get_type() == datum_t::R_OBJECT
+                   && elt.get_type() == datum_t::R_OBJECT) {
+            boost::optional<bool> res = match_object(pair.second, elt);
+            if (!res || !*res) {
+                return res;
+            }
+        } else if (elt != pair.second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool filter_predicate_t::get_required_equality(std::vector<datum_string_t> *path_out,
+                                               datum_t *value_out) const {
+    path_out->clear();
+    return required_equality(root, path_out, value_out);
+}
+
+bool filter_predicate_t::required_equality(const node_t &node,
+                                           std::vector<datum_string_t> *path_out,
+                                           datum_t *value_out) {
+    if (node.type == Term::AND) {
+        for (auto it = node.children.begin(); it != node.children.end(); ++it) {
+            if (required_equality(*it, path_out, value_out)) {
+                return true;
+            }
+        }
+        return false;
+    } else if (node.type == Term::EQ) {
+        const operand_t *path, *literal;
+        if (node.lhs.literal.has() && !node.rhs.literal.has()) {
+            literal = &node.lhs;
+            path = &node.rhs;
+        } else if (!node.lhs.literal.has() && node.rhs.literal.has()) {
+            literal = &node.rhs;
+            path = &node.lhs;
+        } else {
+            return false;
+        }
+        if (path->path.empty()) {
+            return false;
+        }
+        *path_out = path->path;
+        *value_out = literal->literal;
+        return true;
+    } else if (node.type == Term::DATUM) {
+        return required_object_equality(node.lhs.literal, path_out, value_out);
+    } else {
+        return false;
+    }
+}
+
+bool filter_predicate_t::required_object_equality(
+        const datum_t &predicate,
+        std::vector<datum_string_t> *path_out,
+        datum_t *value_out) {
+    for (size_t i = 0; i < predicate.obj_size(); ++i) {
+        auto pair = predicate.get_pair(i);
+        path_out->push_back(pair.first);
+        if (pair.second.get_type() != datum_t::R_OBJECT) {
+            *value_out = pair.second;
+            return true;
+        } else if (!pair.second.is_ptype()
+                   && required_object_equality(pair.second, path_out, value_out)) {
+            // A nested object only matches a row whose field is also an object,
+            // so its fields have to be equal too.
+            return true;
+        }
+        path_out->pop_back();
+    }
+    return false;
+}
+
+void filter_predicate_t::get_required_comparisons(
+        std::vector<comparison_t> *out) const {
+    required_comparisons(root, out);
+}
+
+void filter_predicate_t::required_comparisons(const node_t &node,
+                                              std::vector<comparison_t> *out) {
+    if (node.type == Term::AND) {
+        for (auto it = node.children.begin(); it != node.children.end(); ++it) {
+            required_comparisons(*it, out);
+        }
+    } else if (node.type == Term::DATUM) {
+        for (size_t i = 0; i < node.lhs.literal.obj_size(); ++i) {
+            auto pair = node.lhs.literal.get_pair(i);
+            if (pair.second.get_type() != datum_t::R_OBJECT) {
+                out->push_back(comparison_t{pair.first, Term::EQ, pair.second});
+            }
+        }
+    } else if (is_comparison(node.type) && node.type != Term::NE) {
+        comparison_t comparison;
+        comparison.type = node.type;
+        if (node.lhs.path.size() == 1 && node.rhs.literal.has()) {
+            comparison.field = node.lhs.path[0];
+            comparison.value = node.rhs.literal;
+        } else if (node.rhs.path.size() == 1 && node.lhs.literal.has()) {
+            // `5 < r.row('a')` is `r.row('a') > 5`.
+            comparison.field = node.rhs.path[0];
+            comparison.value = node.lhs.literal;
+            switch (node.type) {
+            case Term::LT: comparison.type = Term::GT; break;
+            case Term::LE: comparison.type = Term::GE; break;
+            case Term::GT: comparison.type = Term::LT; break;
+            case Term::GE: comparison.type = Term::LE; break;
+            default: break;
+            }
+        } else {
+            return;
+        }
+        out->push_back(comparison);
+    }
+}
+
+datum_t filter_predicate_t::lookup_path(const std::vector<datum_string_t> &path,
+                                        const datum_t &row) {
+    datum_t res = row;
+    for (auto it = path.begin(); it != path.end(); ++it) {
+        if (res.get_type() != datum_t::R_OBJECT) {
+            return datum_t();
+        }
+        res = res.get_field(*it, NOTHROW);
+        if (!res.has()) {
+            return datum_t();
+        }
+    }
+    return res;
+}
+
+// Returns an empty datum if the interpreter would do anything other than a plain
+// field lookup along the way (e.g. map over an array, or throw).
+datum_t filter_predicate_t::resolve(const operand_t &operand, const datum_t &row) {
+    if (operand.literal.has()) {
+        return operand.literal;
+    }
+    datum_t res = row;
+    for (auto it = operand.path.begin(); it != operand.path.end(); ++it) {
+        if (res.get_type() != datum_t::R_OBJECT || res.is_ptype()) {
+            return datum_t();
+        }
+        res = res.get_field(*it, NOTHROW);
+        if (!res.has()) {
+            return datum_t();
+        }
+    }
+    return res;
+}
+
+}  // namespace ql
@@ -0,0 +1,115 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_FILTER_PREDICATE_HPP_
+#define RDB_PROTOCOL_FILTER_PREDICATE_HPP_
+
+#include <vector>
+
+#include "errors.hpp"
+#include <boost/optional.hpp>
+
+#include "containers/counted.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "version.hpp"
+
+namespace ql {
+
+class func_t;
+
+/* A `filter_predicate_t` is a precompiled form of simple `filter` functions, like
+`r.row('status').eq('active').and(r.row('age').gt(21))`.  It understands
+comparisons between field paths of the row and literal values, combined with
+`and`, `or` and `not`, as well as the object shortcut (`filter({status:
+'active'})`), and evaluates them by looking the fields up directly in the
+(usually still serialized) row instead of going through the interpreter.
+
+The predicate only answers when the answer can't differ from the interpreter's;
+if a field is missing or something along a path isn't a plain object, `test`
+returns `boost::none` and the caller has to call the function normally, which
+takes care of errors and of the filter's `default` value. */
+class filter_predicate_t {
+public:
+    // Returns an empty pointer if `f` isn't simple enough to be compiled.
+    static scoped_ptr_t<filter_predicate_t> compile(const counted_t<const func_t> &f);
+
+    boost::optional<bool> test(reql_version_t reql_version, const datum_t &row) const;
+
+    // If the predicate can only pass for rows where the field at `*path_out` is
+    // equal to `*value_out`, sets both and returns true.  Looking up `path_out` with
+    // `lookup_path` gives the value to compare against.
+    bool get_required_equality(std::vector<datum_string_t> *path_out,
+                               datum_t *value_out) const;
+
+    // A comparison of a top-level field with a literal, with the field on the left.
+    struct comparison_t {
+        datum_string_t field;
+        // One of `EQ`, `LT`, `LE`, `GT` or `GE`.
+        Term::TermType type;
+        datum_t value;
+    };
+
+    // Adds the comparisons that have to be true for the predicate to pass, i.e. the
+    // ones that aren't under an `or` or a `not`, to `*out`.
+    void get_required_comparisons(std::vector<comparison_t> *out) const;
+
+    // Returns true if the predicate only looks at top-level fields of the row (or
+    // the row itself), in which case it can't throw anything other than
+    // non-existence errors, which `filter` turns into its `default` value.
+    bool only_uses_top_level_fields() const;
+
+    // If `f` is a one-argument function that just returns a field of its argument
+    // (e.g. `r.row('name')`, or `r.row('address')('city')`), sets `*path_out` to the
+    // path to that field and returns true.
+    static bool get_field_path(const counted_t<const func_t> &f,
+                               std::vector<datum_string_t> *path_out);
+
+    // Follows `path` through nested objects, returning an empty datum if it runs
+    // into a missing field or a non-object.
+    static datum_t lookup_path(const std::vector<datum_string_t> &path,
+                               const datum_t &row);
+
+private:
+    // A field path into the row, or a literal datum if `literal` is set.
+    struct operand_t {
+        std::vector<datum_string_t> path;
+        datum_t literal;
+    };
+
+    struct node_t {
+        Term::TermType type;
+        // For AND, OR and NOT.
+        std::vector<node_t> children;
+        // For comparisons.  For DATUM (the object shortcut), `lhs.literal` is the
+        // object to match.
+        operand_t lhs, rhs;
+    };
+
+    filter_predicate_t() { }
+
+    class compiler_t;
+
+    static boost::optional<bool> test_node(reql_version_t reql_version,
+                                           const node_t &node,
+                                           const datum_t &row);
+    static datum_t resolve(const operand_t &operand, const datum_t &row);
+    static boost::optional<bool> match_object(const datum_t &predicate,
+                                              const datum_t &row);
+    static bool required_equality(const node_t &node,
+                                  std::vector<datum_string_t> *path_out,
+                                  datum_t *value_out);
+    static bool required_object_equality(const datum_t &predicate,
+                                         std::vector<datum_string_t> *path_out,
+                                         datum_t *value_out);
+    static bool only_top_level(const node_t &node);
+    static void required_comparisons(const node_t &node,
+                                     std::vector<comparison_t> *out);
+
+    node_t root;
+
+    DISABLE_COPYING(filter_predicate_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_FILTER_PREDICATE_HPP_
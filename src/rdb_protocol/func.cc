@@ -2,6 +2,7 @@
 
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/func_program.hpp"
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/pseudo_literal.hpp"
 #include "rdb_protocol/ql2.pb.h"
@@ -32,6 +33,35 @@ scoped_ptr_t<val_t> func_t::call(env_t *env,
     return call(env, make_vector(arg1, arg2), eval_flags);
 }
 
+// Calls the function on one argument at a time, as the results are taken.
+class lazy_call_each_results_t : public call_each_results_t {
+public:
+    lazy_call_each_results_t(env_t *_env,
+                             const std::vector<datum_t> *_args,
+                             const func_t *_parent)
+        : env(_env), args(_args), next_index(0), parent(_parent) { }
+
+    scoped_ptr_t<val_t> next() {
+        r_sanity_check(next_index < args->size());
+        datum_t arg = (*args)[next_index];
+        ++next_index;
+        return parent->call(env, arg);
+    }
+
+private:
+    env_t *env;
+    const std::vector<datum_t> *args;
+    size_t next_index;
+    const func_t *parent;
+};
+
+scoped_ptr_t<call_each_results_t> func_t::call_each(
+    env_t *env,
+    const std::vector<datum_t> &args) const {
+    return scoped_ptr_t<call_each_results_t>(
+        new lazy_call_each_results_t(env, &args, this));
+}
+
 void func_t::assert_deterministic(const char *extra_msg) const {
     rcheck(is_deterministic(),
            base_exc_t::GENERIC,
@@ -43,7 +73,8 @@ reql_func_t::reql_func_t(const protob_t<const Backtrace> backtrace,
                          std::vector<sym_t> _arg_names,
                          counted_t<const term_t> _body)
     : func_t(backtrace), captured_scope(_captured_scope),
-      arg_names(std::move(_arg_names)), body(std::move(_body)) { }
+      arg_names(std::move(_arg_names)), body(std::move(_body)),
+      program(func_program_t::compile(*body->get_src(), arg_names)) { }
 
 reql_func_t::~reql_func_t() { }
 
@@ -62,6 +93,19 @@ scoped_ptr_t<val_t> reql_func_t::call(env_t *env,
                          (arg_names.size() == 1 ? "" : "s"),
                          args.size()));
 
+        // Profiled queries want to see every term that gets evaluated.
+        if (program.has() && env->trace == NULL && arg_names.size() == args.size()) {
+            DEBUG_ONLY_CODE(env->do_eval_callback());
+            if (env->interruptor->is_pulsed()) {
+                throw interrupted_exc_t();
+            }
+            env->maybe_yield();
+            datum_t result;
+            if (program->run(env->reql_version(), args, &result)) {
+                return make_scoped<val_t>(std::move(result), body->backtrace());
+            }
+        }
+
         var_scope_t new_scope = arg_names.size() == 0
             ? captured_scope
             : captured_scope.with_func_arg_list(arg_names, args);
@@ -103,7 +147,7 @@ scoped_ptr_t<val_t> js_func_t::call(
         js_result_t result;
 
         try {
-            result = env->get_js_runner()->call(js_source, args, config);
+            result = env->get_js_runner(js_source)->call(js_source, args, config);
         } catch (const extproc_worker_exc_t &e) {
             rfail(base_exc_t::GENERIC,
                   "Javascript query `%s` caused a crash in a worker process.",
@@ -124,6 +168,71 @@ scoped_ptr_t<val_t> js_func_t::call(
     }
 }
 
+// Hands out the results of a batched JavaScript call.
+class js_call_each_results_t : public call_each_results_t {
+public:
+    js_call_each_results_t(std::vector<js_result_t> &&_results,
+                           const std::string &_js_source,
+                           uint64_t _js_timeout_ms,
+                           const js_func_t *_parent)
+        : results(std::move(_results)), next_index(0),
+          js_source(_js_source), js_timeout_ms(_js_timeout_ms), parent(_parent) { }
+
+    scoped_ptr_t<val_t> next() {
+        r_sanity_check(next_index < results.size());
+        const js_result_t &result = results[next_index];
+        ++next_index;
+        try {
+            return scoped_ptr_t<val_t>(
+                    boost::apply_visitor(
+                            js_result_visitor_t(js_source, js_timeout_ms, parent),
+                            result));
+        } catch (const datum_exc_t &e) {
+            rfail_target(parent, e.get_type(), "%s", e.what());
+            unreachable();
+        }
+    }
+
+private:
+    std::vector<js_result_t> results;
+    size_t next_index;
+    std::string js_source;
+    uint64_t js_timeout_ms;
+    const js_func_t *parent;
+};
+
+scoped_ptr_t<call_each_results_t> js_func_t::call_each(
+    env_t *env,
+    const std::vector<datum_t> &args) const {
+    js_runner_t::req_config_t config;
+    config.timeout_ms = js_timeout_ms;
+
+    r_sanity_check(!js_source.empty());
+    std::vector<std::vector<datum_t> > args_list;
+    args_list.reserve(args.size());
+    for (auto it = args.begin(); it != args.end(); ++it) {
+        args_list.push_back(make_vector(*it));
+    }
+
+    std::vector<js_result_t> results;
+    try {
+        results = env->get_js_runner(js_source)->call_batch(js_source, args_list, config);
+    } catch (const extproc_worker_exc_t &e) {
+        rfail(base_exc_t::GENERIC,
+              "Javascript query `%s` caused a crash in a worker process.",
+              js_source.c_str());
+    } catch (const interrupted_exc_t &e) {
+        rfail(base_exc_t::GENERIC,
+              "JavaScript query `%s` timed out after "
+              "%" PRIu64 ".%03" PRIu64 " seconds.",
+              js_source.c_str(), js_timeout_ms / 1000, js_timeout_ms % 1000);
+    }
+
+    return scoped_ptr_t<call_each_results_t>(
+        new js_call_each_results_t(std::move(results), js_source, js_timeout_ms,
+                                   this));
+}
+
 boost::optional<size_t> js_func_t::arity() const {
     return boost::none;
 }
@@ -252,8 +361,12 @@ bool filter_match(datum_t predicate, datum_t value,
     }
 }
 
-bool reql_func_t::filter_helper(env_t *env, datum_t arg) const {
-    datum_t d = call(env, make_vector(arg), NO_FLAGS)->as_datum();
+bool reql_func_t::filter_helper(env_t *env,
+                                datum_t arg,
+                                call_each_results_t *results) const {
+    datum_t d = results != NULL
+        ? results->next()->as_datum()
+        : call(env, make_vector(arg), NO_FLAGS)->as_datum();
     if (d.get_type() == datum_t::R_OBJECT &&
         (body->get_src()->type() == Term::MAKE_OBJ ||
          body->get_src()->type() == Term::DATUM)) {
@@ -282,19 +395,26 @@ std::string js_func_t::print_source() const {
     return ret;
 }
 
-bool js_func_t::filter_helper(env_t *env, datum_t arg) const {
-    datum_t d = call(env, make_vector(arg), NO_FLAGS)->as_datum();
+bool js_func_t::filter_helper(env_t *env,
+                              datum_t arg,
+                              call_each_results_t *results) const {
+    datum_t d = results != NULL
+        ? results->next()->as_datum()
+        : call(env, make_vector(arg), NO_FLAGS)->as_datum();
     return d.as_bool();
 }
 
-bool func_t::filter_call(env_t *env, datum_t arg, counted_t<const func_t> default_filter_val) const {
+bool func_t::filter_call(env_t *env,
+                         datum_t arg,
+                         counted_t<const func_t> default_filter_val,
+                         call_each_results_t *results) const {
     // We have to catch every exception type and save it so we can rethrow it later
     // So we don't trigger a coroutine wait in a catch statement
     std::exception_ptr saved_exception;
     base_exc_t::type_t exception_type;
 
     try {
-        return filter_helper(env, arg);
+        return filter_helper(env, arg, results);
     } catch (const base_exc_t &e) {
         saved_exception = std::current_exception();
         exception_type = e.get_type();
@@ -23,8 +23,19 @@ class js_runner_t;
 
 namespace ql {
 
+class filter_predicate_t;
+class func_program_t;
 class func_visitor_t;
 
+// What `func_t::call_each` returns.  Results are handed out in argument order, and
+// each call's error is only thrown when its turn comes, so callers see the same
+// errors in the same order as if they had called the function once per argument.
+class call_each_results_t {
+public:
+    virtual ~call_each_results_t() { }
+    virtual scoped_ptr_t<val_t> next() = 0;
+};
+
 class func_t : public slow_atomic_countable_t<func_t>, public pb_rcheckable_t {
 public:
     virtual ~func_t();
@@ -45,9 +56,19 @@ public:
 
     void assert_deterministic(const char *extra_msg) const;
 
+    // Calls the function on each of `args` in turn.  By default the calls happen
+    // lazily as the results are taken, so `args` must outlive the returned object;
+    // `js_func_t` instead evaluates the whole batch in one trip to a worker process.
+    virtual scoped_ptr_t<call_each_results_t> call_each(
+        env_t *env,
+        const std::vector<datum_t> &args) const;
+
+    // If `results` is given, the function's result for `arg` is taken from it
+    // instead of calling the function.
     bool filter_call(env_t *env,
                      datum_t arg,
-                     counted_t<const func_t> default_filter_val) const;
+                     counted_t<const func_t> default_filter_val,
+                     call_each_results_t *results = NULL) const;
 
     // These are simple, they call the vector version of call.
     scoped_ptr_t<val_t> call(env_t *env, eval_flags_t eval_flags = NO_FLAGS) const;
@@ -63,7 +84,9 @@ protected:
     explicit func_t(const protob_t<const Backtrace> &bt_source);
 
 private:
-    virtual bool filter_helper(env_t *env, datum_t arg) const = 0;
+    virtual bool filter_helper(env_t *env,
+                               datum_t arg,
+                               call_each_results_t *results) const = 0;
 
     DISABLE_COPYING(func_t);
 };
@@ -91,7 +114,8 @@ public:
 
 private:
     template <cluster_version_t> friend class wire_func_serialization_visitor_t;
-    bool filter_helper(env_t *env, datum_t arg) const;
+    friend class filter_predicate_t;
+    bool filter_helper(env_t *env, datum_t arg, call_each_results_t *results) const;
 
     // Only contains the parts of the scope that `body` uses.
     var_scope_t captured_scope;
@@ -102,6 +126,10 @@ private:
     // The body of the function, which gets ->eval(...) called when call(...) is called.
     counted_t<const term_t> body;
 
+    // `body` compiled into a `func_program_t`, if it's simple enough.  `call(...)`
+    // tries this first.
+    scoped_ptr_t<const func_program_t> program;
+
     DISABLE_COPYING(reql_func_t);
 };
 
@@ -118,6 +146,10 @@ public:
                              const std::vector<datum_t> &args,
                              eval_flags_t eval_flags) const;
 
+    scoped_ptr_t<call_each_results_t> call_each(
+        env_t *env,
+        const std::vector<datum_t> &args) const;
+
     boost::optional<size_t> arity() const;
 
     bool is_deterministic() const;
@@ -128,7 +160,7 @@ public:
 
 private:
     template <cluster_version_t> friend class wire_func_serialization_visitor_t;
-    bool filter_helper(env_t *env, datum_t arg) const;
+    bool filter_helper(env_t *env, datum_t arg, call_each_results_t *results) const;
 
     std::string js_source;
     uint64_t js_timeout_ms;
@@ -0,0 +1,353 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/func_program.hpp"
+
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include "rdb_protocol/configured_limits.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "utils.hpp"
+
+namespace ql {
+
+// Programs that need more registers than this aren't worth compiling.
+static const uint32_t MAX_PROGRAM_REGISTERS = 64;
+
+// `run()` keeps the registers on the stack if there are at most this many.
+static const size_t NUM_STACK_REGISTERS = 16;
+
+/* Each term is compiled into a register `dst`, and uses the registers after `dst` for
+its operands. */
+class func_program_t::compiler_t {
+public:
+    compiler_t(func_program_t *_program, const std::vector<sym_t> *_arg_names)
+        : program(_program), arg_names(_arg_names) { }
+
+    bool compile(const Term &t, uint32_t dst) {
+        if (dst >= MAX_PROGRAM_REGISTERS) {
+            return false;
+        }
+        program->num_registers = std::max<size_t>(program->num_registers, dst + 1);
+
+        switch (t.type()) {
+        case Term::VAR:
+            return compile_var(t, dst);
+        case Term::DATUM:
+            return compile_datum(t, dst);
+        case Term::GET_FIELD: // fallthru
+        case Term::BRACKET:
+            return compile_get_field(t, dst);
+        case Term::ADD:
+            return compile_arith(t, opcode_t::ADD, dst);
+        case Term::SUB:
+            return compile_arith(t, opcode_t::SUB, dst);
+        case Term::MUL:
+            return compile_arith(t, opcode_t::MUL, dst);
+        case Term::DIV:
+            return compile_arith(t, opcode_t::DIV, dst);
+        case Term::EQ:
+            return compile_predicate(t, opcode_t::EQ, dst);
+        case Term::NE:
+            return compile_predicate(t, opcode_t::NE, dst);
+        case Term::LT:
+            return compile_predicate(t, opcode_t::LT, dst);
+        case Term::LE:
+            return compile_predicate(t, opcode_t::LE, dst);
+        case Term::GT:
+            return compile_predicate(t, opcode_t::GT, dst);
+        case Term::GE:
+            return compile_predicate(t, opcode_t::GE, dst);
+        case Term::NOT:
+            if (t.args_size() != 1 || t.optargs_size() != 0
+                || !compile(t.args(0), dst)) {
+                return false;
+            }
+            emit(opcode_t::NOT, dst, dst);
+            return true;
+        case Term::AND: // fallthru
+        case Term::OR:
+            return compile_and_or(t, dst);
+        case Term::MAKE_OBJ:
+            return compile_make_obj(t, dst);
+        default:
+            return false;
+        }
+    }
+
+private:
+    void emit(opcode_t op, uint32_t dst, uint32_t a, uint32_t b = 0, uint32_t c = 0) {
+        instruction_t instruction;
+        instruction.op = op;
+        instruction.dst = dst;
+        instruction.a = a;
+        instruction.b = b;
+        instruction.c = c;
+        program->instructions.push_back(instruction);
+    }
+
+    bool compile_var(const Term &t, uint32_t dst) {
+        if (t.args_size() != 1 || t.optargs_size() != 0
+            || t.args(0).type() != Term::DATUM
+            || t.args(0).datum().type() != Datum::R_NUM) {
+            return false;
+        }
+        // Variables that aren't arguments of this function were captured from the
+        // enclosing scope.
+        const double name = t.args(0).datum().r_num();
+        for (size_t i = 0; i < arg_names->size(); ++i) {
+            if (static_cast<double>((*arg_names)[i].value) == name) {
+                emit(opcode_t::LOAD_ARG, dst, i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool compile_datum(const Term &t, uint32_t dst) {
+        if (t.args_size() != 0 || t.optargs_size() != 0 || !t.has_datum()) {
+            return false;
+        }
+        switch (t.datum().type()) {
+        case Datum::R_NULL: // fallthru
+        case Datum::R_BOOL: // fallthru
+        case Datum::R_NUM: // fallthru
+        case Datum::R_STR:
+            break;
+        default:
+            return false;
+        }
+        emit(opcode_t::LOAD_CONST, dst, program->constants.size());
+        program->constants.push_back(
+            to_datum(&t.datum(), configured_limits_t::unlimited, reql_version_t::LATEST));
+        return true;
+    }
+
+    bool compile_get_field(const Term &t, uint32_t dst) {
+        if (t.args_size() != 2 || t.optargs_size() != 0
+            || t.args(1).type() != Term::DATUM
+            || t.args(1).datum().type() != Datum::R_STR
+            || !compile(t.args(0), dst)) {
+            return false;
+        }
+        emit(opcode_t::GET_FIELD, dst, dst, program->strings.size());
+        program->strings.push_back(datum_string_t(t.args(1).datum().r_str()));
+        return true;
+    }
+
+    bool compile_arith(const Term &t, opcode_t op, uint32_t dst) {
+        if (t.args_size() < 1 || t.optargs_size() != 0 || !compile(t.args(0), dst)) {
+            return false;
+        }
+        for (int i = 1; i < t.args_size(); ++i) {
+            if (!compile(t.args(i), dst + 1)) {
+                return false;
+            }
+            emit(op, dst, dst, dst + 1);
+        }
+        return true;
+    }
+
+    bool compile_predicate(const Term &t, opcode_t op, uint32_t dst) {
+        if (t.args_size() < 2 || t.optargs_size() != 0) {
+            return false;
+        }
+        for (int i = 0; i < t.args_size(); ++i) {
+            if (!compile(t.args(i), dst + 1 + i)) {
+                return false;
+            }
+        }
+        emit(op, dst, dst + 1, t.args_size());
+        return true;
+    }
+
+    bool compile_and_or(const Term &t, uint32_t dst) {
+        if (t.args_size() < 1 || t.optargs_size() != 0) {
+            return false;
+        }
+        const bool is_and = t.type() == Term::AND;
+        std::vector<size_t> jumps;
+        for (int i = 0; i < t.args_size(); ++i) {
+            if (!compile(t.args(i), dst)) {
+                return false;
+            }
+            // `and` returns its last argument if they're all truthy, while `or`
+            // returns `false` if none of them are.
+            if (is_and && i == t.args_size() - 1) {
+                break;
+            }
+            jumps.push_back(program->instructions.size());
+            emit(is_and ? opcode_t::JUMP_IF_FALSE : opcode_t::JUMP_IF_TRUE, dst, dst);
+        }
+        if (!is_and) {
+            emit(opcode_t::LOAD_CONST, dst, program->constants.size());
+            program->constants.push_back(datum_t::boolean(false));
+        }
+        for (size_t jump : jumps) {
+            program->instructions[jump].b = program->instructions.size();
+        }
+        return true;
+    }
+
+    bool compile_make_obj(const Term &t, uint32_t dst) {
+        if (t.args_size() != 0) {
+            return false;
+        }
+        // The term tree evaluates the values in key order.
+        std::map<std::string, const Term *> pairs;
+        for (int i = 0; i < t.optargs_size(); ++i) {
+            if (!pairs.insert(std::make_pair(t.optargs(i).key(),
+                                             &t.optargs(i).val())).second) {
+                return false;
+            }
+        }
+        const uint32_t first_key = program->strings.size();
+        uint32_t reg = dst + 1;
+        for (const auto &pair : pairs) {
+            if (!compile(*pair.second, reg)) {
+                return false;
+            }
+            program->strings.push_back(datum_string_t(pair.first));
+            ++reg;
+        }
+        emit(opcode_t::MAKE_OBJ, dst, dst + 1, pairs.size(), first_key);
+        return true;
+    }
+
+    func_program_t *const program;
+    const std::vector<sym_t> *const arg_names;
+};
+
+scoped_ptr_t<func_program_t> func_program_t::compile(
+        const Term &body, const std::vector<sym_t> &arg_names) {
+    scoped_ptr_t<func_program_t> program(new func_program_t());
+    compiler_t compiler(program.get(), &arg_names);
+    try {
+        if (compiler.compile(body, 0)) {
+            return program;
+        }
+    } catch (const base_exc_t &) {
+    }
+    return scoped_ptr_t<func_program_t>();
+}
+
+bool func_program_t::run(reql_version_t reql_version,
+                         const std::vector<datum_t> &args,
+                         datum_t *out) const {
+    datum_t stack_registers[NUM_STACK_REGISTERS];
+    std::vector<datum_t> heap_registers;
+    datum_t *regs = stack_registers;
+    if (num_registers > NUM_STACK_REGISTERS) {
+        heap_registers.resize(num_registers);
+        regs = heap_registers.data();
+    }
+
+    try {
+        size_t pc = 0;
+        while (pc < instructions.size()) {
+            const instruction_t &ins = instructions[pc++];
+            switch (ins.op) {
+            case opcode_t::LOAD_ARG:
+                regs[ins.dst] = args[ins.a];
+                break;
+            case opcode_t::LOAD_CONST:
+                regs[ins.dst] = constants[ins.a];
+                break;
+            case opcode_t::GET_FIELD: {
+                // Pseudotypes only allow some of their fields to be read, depending on
+                // the ReQL version.
+                const datum_t &obj = regs[ins.a];
+                if (obj.get_type() != datum_t::R_OBJECT || obj.is_ptype()) {
+                    return false;
+                }
+                datum_t field = obj.get_field(strings[ins.b], NOTHROW);
+                if (!field.has()) {
+                    return false;
+                }
+                regs[ins.dst] = std::move(field);
+            } break;
+            case opcode_t::ADD: // fallthru
+            case opcode_t::SUB: // fallthru
+            case opcode_t::MUL: // fallthru
+            case opcode_t::DIV: {
+                const datum_t &lhs = regs[ins.a];
+                const datum_t &rhs = regs[ins.b];
+                if (lhs.get_type() != datum_t::R_NUM || rhs.get_type() != datum_t::R_NUM) {
+                    return false;
+                }
+                double result;
+                switch (ins.op) {
+                case opcode_t::ADD: result = lhs.as_num() + rhs.as_num(); break;
+                case opcode_t::SUB: result = lhs.as_num() - rhs.as_num(); break;
+                case opcode_t::MUL: result = lhs.as_num() * rhs.as_num(); break;
+                case opcode_t::DIV:
+                    if (rhs.as_num() == 0) {
+                        return false;
+                    }
+                    result = lhs.as_num() / rhs.as_num();
+                    break;
+                default: unreachable();
+                }
+                if (!risfinite(result)) {
+                    return false;
+                }
+                regs[ins.dst] = datum_t(result);
+            } break;
+            case opcode_t::EQ: // fallthru
+            case opcode_t::NE: // fallthru
+            case opcode_t::LT: // fallthru
+            case opcode_t::LE: // fallthru
+            case opcode_t::GT: // fallthru
+            case opcode_t::GE: {
+                bool result = true;
+                for (uint32_t i = 1; i < ins.b && result; ++i) {
+                    const datum_t &lhs = regs[ins.a + i - 1];
+                    const datum_t &rhs = regs[ins.a + i];
+                    switch (ins.op) {
+                    case opcode_t::EQ: // fallthru
+                    case opcode_t::NE: result = lhs == rhs; break;
+                    case opcode_t::LT: result = lhs.cmp(reql_version, rhs) < 0; break;
+                    case opcode_t::LE: result = lhs.cmp(reql_version, rhs) <= 0; break;
+                    case opcode_t::GT: result = lhs.cmp(reql_version, rhs) > 0; break;
+                    case opcode_t::GE: result = lhs.cmp(reql_version, rhs) >= 0; break;
+                    default: unreachable();
+                    }
+                }
+                // Like the `ne` term, this is `!(a == b == c)`.
+                regs[ins.dst] = datum_t::boolean(result != (ins.op == opcode_t::NE));
+            } break;
+            case opcode_t::NOT:
+                regs[ins.dst] = datum_t::boolean(!regs[ins.a].as_bool());
+                break;
+            case opcode_t::JUMP_IF_FALSE:
+                if (!regs[ins.a].as_bool()) {
+                    pc = ins.b;
+                }
+                break;
+            case opcode_t::JUMP_IF_TRUE:
+                if (regs[ins.a].as_bool()) {
+                    pc = ins.b;
+                }
+                break;
+            case opcode_t::MAKE_OBJ: {
+                datum_object_builder_t builder;
+                for (uint32_t i = 0; i < ins.b; ++i) {
+                    if (builder.add(strings[ins.c + i], regs[ins.a + i])) {
+                        return false;
+                    }
+                }
+                regs[ins.dst] = std::move(builder).to_datum();
+            } break;
+            default:
+                unreachable();
+            }
+        }
+    } catch (const base_exc_t &) {
+        return false;
+    }
+
+    *out = std::move(regs[0]);
+    return true;
+}
+
+}  // namespace ql
@@ -0,0 +1,81 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_FUNC_PROGRAM_HPP_
+#define RDB_PROTOCOL_FUNC_PROGRAM_HPP_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/datum_string.hpp"
+#include "rdb_protocol/sym.hpp"
+#include "version.hpp"
+
+class Term;
+
+namespace ql {
+
+/* `func_program_t` is a function body flattened into a list of instructions over a
+small array of datum registers, so that simple functions like `row('age').gt(21)` or
+`{id: x('id'), n: x('n').add(1)}` can be run without walking the term tree, which
+allocates a `val_t` for every node it evaluates.
+
+Only a pure subset of ReQL is supported: the function's own arguments, scalar
+constants, getting a constant field of an object, arithmetic on numbers, comparisons,
+`not`, `and`, `or` and object literals. `compile()` returns an empty pointer for any
+body outside of that subset.
+
+`run()` gives up and returns `false` whenever the term tree might do something
+different than it would, e.g. when an operand has the wrong type or a field is
+missing. Since the subset has no side effects, the caller can then evaluate the term
+tree instead, which reports the error with the right backtrace. */
+class func_program_t {
+public:
+    static scoped_ptr_t<func_program_t> compile(const Term &body,
+                                                const std::vector<sym_t> &arg_names);
+
+    /* `args` must have one datum for each of the `arg_names` the program was compiled
+    with. */
+    bool run(reql_version_t reql_version,
+             const std::vector<datum_t> &args,
+             datum_t *out) const;
+
+    size_t num_instructions() const { return instructions.size(); }
+
+private:
+    enum class opcode_t : uint8_t {
+        LOAD_ARG,     // dst = args[a]
+        LOAD_CONST,   // dst = constants[a]
+        GET_FIELD,    // dst = a[strings[b]]
+        ADD, SUB, MUL, DIV,  // dst = a <op> b
+        EQ, NE, LT, LE, GT, GE,  // dst = the predicate over the registers a..a+b-1
+        NOT,          // dst = !a
+        JUMP_IF_FALSE,  // if !a, continue at instruction b
+        JUMP_IF_TRUE,   // if a, continue at instruction b
+        MAKE_OBJ      // dst = {strings[c + i]: register a + i} for i < b
+    };
+
+    struct instruction_t {
+        opcode_t op;
+        uint32_t dst;
+        uint32_t a;
+        uint32_t b;
+        uint32_t c;
+    };
+
+    func_program_t() : num_registers(0) { }
+
+    class compiler_t;
+
+    std::vector<instruction_t> instructions;
+    std::vector<datum_t> constants;
+    std::vector<datum_string_t> strings;
+    size_t num_registers;
+
+    DISABLE_COPYING(func_program_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_FUNC_PROGRAM_HPP_
@@ -1,6 +1,8 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/geo/distances.hpp"
 
+#include <cmath>
+
 #include "rdb_protocol/geo/ellipsoid.hpp"
 #include "rdb_protocol/geo/exceptions.hpp"
 #include "rdb_protocol/geo/geojson.hpp"
@@ -11,73 +13,160 @@
 #include "rdb_protocol/geo/s2/s2polygon.h"
 #include "rdb_protocol/geo/s2/s2polyline.h"
 
-double geodesic_distance(const lon_lat_point_t &p1,
-                         const lon_lat_point_t &p2,
-                         const ellipsoid_spec_t &e) {
-    // Use Karney's algorithm
-    struct geod_geodesic g;
-    geod_init(&g, e.equator_radius(), e.flattening());
+// The straight-line distance is computed with some rounding error, so we only
+// trust it to reject points that are further away than this (relative) margin.
+const double CHORD_LENGTH_RELATIVE_MARGIN = 1e-9;
 
-    double dist;
-    geod_inverse(&g, p1.latitude, p1.longitude, p2.latitude, p2.longitude, &dist, NULL, NULL);
+static lon_lat_point_t s2point_to_lon_lat(const geo::S2Point &p) {
+    return lon_lat_point_t(geo::S2LatLng::Longitude(p).degrees(),
+                           geo::S2LatLng::Latitude(p).degrees());
+}
 
-    return dist;
+// Converts geodetic coordinates to cartesian coordinates relative to the
+// ellipsoid's center.
+static void to_cartesian(const lon_lat_point_t &p,
+                         double equator_radius,
+                         double eccentricity_sq,
+                         double xyz_out[3]) {
+    const double lat = p.latitude * (M_PI / 180.0);
+    const double lon = p.longitude * (M_PI / 180.0);
+    const double sin_lat = sin(lat);
+    const double cos_lat = cos(lat);
+    // The prime vertical radius of curvature
+    const double n =
+        equator_radius / sqrt(1.0 - eccentricity_sq * sin_lat * sin_lat);
+    xyz_out[0] = n * cos_lat * cos(lon);
+    xyz_out[1] = n * cos_lat * sin(lon);
+    xyz_out[2] = n * (1.0 - eccentricity_sq) * sin_lat;
 }
 
-double geodesic_distance(const geo::S2Point &p,
-                         const ql::datum_t &g,
-                         const ellipsoid_spec_t &e) {
-    class distance_estimator_t : public s2_geo_visitor_t<double> {
-    public:
-        distance_estimator_t(
-                lon_lat_point_t r, const geo::S2Point &r_s2, const ellipsoid_spec_t &_e)
-            : ref_(r), ref_s2_(r_s2), e_(_e) { }
-        double on_point(const geo::S2Point &point) {
-            lon_lat_point_t llpoint =
-                lon_lat_point_t(geo::S2LatLng::Longitude(point).degrees(),
-                                geo::S2LatLng::Latitude(point).degrees());
-            return geodesic_distance(ref_, llpoint, e_);
+class geodesic_distance_calculator_t::estimator_t
+    : public s2_geo_visitor_t<boost::optional<double> > {
+public:
+    estimator_t(const geodesic_distance_calculator_t *_calc,
+                boost::optional<double> _max_dist)
+        : calc(_calc), max_dist(_max_dist) { }
+
+    boost::optional<double> on_point(const geo::S2Point &point) {
+        return within(s2point_to_lon_lat(point));
+    }
+    boost::optional<double> on_line(const geo::S2Polyline &line) {
+        // This sometimes over-estimates large distances, because the
+        // projection assumes spherical rather than ellipsoid geometry.
+        int next_vertex;
+        geo::S2Point prj = line.Project(calc->origin_s2, &next_vertex);
+        if (prj == calc->origin_s2) {
+            // The origin is on the line
+            return 0.0;
+        } else {
+            return within(s2point_to_lon_lat(prj));
         }
-        double on_line(const geo::S2Polyline &line) {
-            // This sometimes over-estimates large distances, because the
-            // projection assumes spherical rather than ellipsoid geometry.
-            int next_vertex;
-            geo::S2Point prj = line.Project(ref_s2_, &next_vertex);
-            if (prj == ref_s2_) {
-                // ref_ is on the line
-                return 0.0;
-            } else {
-                lon_lat_point_t llprj =
-                    lon_lat_point_t(geo::S2LatLng::Longitude(prj).degrees(),
-                                    geo::S2LatLng::Latitude(prj).degrees());
-                return geodesic_distance(ref_, llprj, e_);
-            }
+    }
+    boost::optional<double> on_polygon(const geo::S2Polygon &polygon) {
+        // This sometimes over-estimates large distances, because the
+        // projection assumes spherical rather than ellipsoid geometry.
+        geo::S2Point prj = polygon.Project(calc->origin_s2);
+        if (prj == calc->origin_s2) {
+            // The origin is inside/on the polygon
+            return 0.0;
+        } else {
+            return within(s2point_to_lon_lat(prj));
         }
-        double on_polygon(const geo::S2Polygon &polygon) {
-            // This sometimes over-estimates large distances, because the
-            // projection assumes spherical rather than ellipsoid geometry.
-            geo::S2Point prj = polygon.Project(ref_s2_);
-            if (prj == ref_s2_) {
-                // ref_ is inside/on the polygon
-                return 0.0;
-            } else {
-                lon_lat_point_t llprj =
-                    lon_lat_point_t(geo::S2LatLng::Longitude(prj).degrees(),
-                                    geo::S2LatLng::Latitude(prj).degrees());
-                return geodesic_distance(ref_, llprj, e_);
+    }
+
+private:
+    boost::optional<double> within(const lon_lat_point_t &p) const {
+        if (max_dist) {
+            if (calc->chord_length(p)
+                > *max_dist * (1.0 + CHORD_LENGTH_RELATIVE_MARGIN)) {
+                return boost::none;
             }
+            double dist = calc->geodesic_distance(p);
+            if (dist > *max_dist) {
+                return boost::none;
+            }
+            return dist;
         }
-        lon_lat_point_t ref_;
-        const geo::S2Point &ref_s2_;
-        const ellipsoid_spec_t &e_;
-    };
-    distance_estimator_t estimator(
-            lon_lat_point_t(geo::S2LatLng::Longitude(p).degrees(),
-                            geo::S2LatLng::Latitude(p).degrees()),
-        p, e);
+        return calc->geodesic_distance(p);
+    }
+
+    const geodesic_distance_calculator_t *calc;
+    const boost::optional<double> max_dist;
+};
+
+geodesic_distance_calculator_t::geodesic_distance_calculator_t(
+        const lon_lat_point_t &_origin,
+        const ellipsoid_spec_t &e)
+    : origin(_origin),
+      origin_s2(geo::S2LatLng::FromDegrees(origin.latitude,
+                                           origin.longitude).ToPoint()),
+      equator_radius(e.equator_radius()),
+      eccentricity_sq(e.flattening() * (2.0 - e.flattening())) {
+    init(e);
+}
+
+geodesic_distance_calculator_t::geodesic_distance_calculator_t(
+        const geo::S2Point &_origin,
+        const ellipsoid_spec_t &e)
+    : origin(s2point_to_lon_lat(_origin)),
+      origin_s2(_origin),
+      equator_radius(e.equator_radius()),
+      eccentricity_sq(e.flattening() * (2.0 - e.flattening())) {
+    init(e);
+}
+
+void geodesic_distance_calculator_t::init(const ellipsoid_spec_t &e) {
+    to_cartesian(origin, equator_radius, eccentricity_sq, origin_xyz);
+    // Use Karney's algorithm
+    geod.init(new geod_geodesic);
+    geod_init(geod.get(), e.equator_radius(), e.flattening());
+}
+
+geodesic_distance_calculator_t::~geodesic_distance_calculator_t() { }
+
+double geodesic_distance_calculator_t::geodesic_distance(
+        const lon_lat_point_t &p) const {
+    double dist;
+    geod_inverse(geod.get(), origin.latitude, origin.longitude,
+                 p.latitude, p.longitude, &dist, NULL, NULL);
+    return dist;
+}
+
+double geodesic_distance_calculator_t::geodesic_distance(
+        const ql::datum_t &g) const {
+    estimator_t estimator(this, boost::none);
+    boost::optional<double> dist = visit_geojson(&estimator, g);
+    guarantee(dist);
+    return *dist;
+}
+
+boost::optional<double> geodesic_distance_calculator_t::geodesic_distance_if_within(
+        const ql::datum_t &g, double max_dist) const {
+    estimator_t estimator(this, max_dist);
     return visit_geojson(&estimator, g);
 }
 
+double geodesic_distance_calculator_t::chord_length(const lon_lat_point_t &p) const {
+    double xyz[3];
+    to_cartesian(p, equator_radius, eccentricity_sq, xyz);
+    const double dx = xyz[0] - origin_xyz[0];
+    const double dy = xyz[1] - origin_xyz[1];
+    const double dz = xyz[2] - origin_xyz[2];
+    return sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+double geodesic_distance(const lon_lat_point_t &p1,
+                         const lon_lat_point_t &p2,
+                         const ellipsoid_spec_t &e) {
+    return geodesic_distance_calculator_t(p1, e).geodesic_distance(p2);
+}
+
+double geodesic_distance(const geo::S2Point &p,
+                         const ql::datum_t &g,
+                         const ellipsoid_spec_t &e) {
+    return geodesic_distance_calculator_t(p, e).geodesic_distance(g);
+}
+
 lon_lat_point_t geodesic_point_at_dist(const lon_lat_point_t &p,
                                        double dist,
                                        double azimuth,
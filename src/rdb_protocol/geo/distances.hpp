@@ -5,7 +5,11 @@
 #include <string>
 #include <utility>
 
+#include "errors.hpp"
+#include <boost/optional.hpp>
+
 #include "containers/counted.hpp"
+#include "containers/scoped.hpp"
 #include "rdb_protocol/geo/lon_lat_types.hpp"
 #include "rdb_protocol/geo/s2/util/math/vector3.h"
 
@@ -17,6 +21,7 @@ class ellipsoid_spec_t;
 namespace ql {
 class datum_t;
 }
+struct geod_geodesic;
 
 // Returns the ellipsoidal distance between p1 and p2 on e (in meters).
 // (solves the inverse geodesic problem)
@@ -27,6 +32,45 @@ double geodesic_distance(const geo::S2Point &p,
                          const ql::datum_t &g,
                          const ellipsoid_spec_t &e);
 
+/* Computes the distances from one origin to many points or geometries, like
+`geodesic_distance`.  The ellipsoid is only set up once, and
+`geodesic_distance_if_within` can usually reject points that are too far away
+without solving the inverse geodesic problem: the straight line between two points
+is never longer than the geodesic between them, and it's much cheaper to compute. */
+class geodesic_distance_calculator_t {
+public:
+    geodesic_distance_calculator_t(const lon_lat_point_t &origin,
+                                   const ellipsoid_spec_t &e);
+    geodesic_distance_calculator_t(const geo::S2Point &origin,
+                                   const ellipsoid_spec_t &e);
+    ~geodesic_distance_calculator_t();
+
+    double geodesic_distance(const lon_lat_point_t &p) const;
+    double geodesic_distance(const ql::datum_t &g) const;
+
+    // Returns the same as `geodesic_distance(g)` if that's at most `max_dist`, and
+    // `boost::none` otherwise.
+    boost::optional<double> geodesic_distance_if_within(const ql::datum_t &g,
+                                                        double max_dist) const;
+
+private:
+    class estimator_t;
+
+    void init(const ellipsoid_spec_t &e);
+
+    // The straight-line distance between the origin and `p` through the ellipsoid.
+    double chord_length(const lon_lat_point_t &p) const;
+
+    const lon_lat_point_t origin;
+    const geo::S2Point origin_s2;
+    const double equator_radius;
+    const double eccentricity_sq;
+    double origin_xyz[3];
+    scoped_ptr_t<geod_geodesic> geod;
+
+    DISABLE_COPYING(geodesic_distance_calculator_t);
+};
+
 // Returns a point at distance `dist` (in meters) of `p` in direction `azimuth`
 // (in degrees between -180 and 180)
 // (solves the direct geodesic problem)
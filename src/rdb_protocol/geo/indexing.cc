@@ -18,6 +18,7 @@
 #include "rdb_protocol/geo/s2/s2regioncoverer.h"
 #include "rdb_protocol/geo/s2/strings/strutil.h"
 #include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/pseudo_geometry.hpp"
 
 using geo::S2CellId;
@@ -110,13 +111,18 @@ std::vector<std::string> compute_index_grid_keys(
     return result;
 }
 
-geo_index_traversal_helper_t::geo_index_traversal_helper_t(const signal_t *interruptor)
-    : is_initialized_(false), interruptor_(interruptor) { }
+geo_index_traversal_helper_t::geo_index_traversal_helper_t(
+        sindex_geo_bool_t geo, const signal_t *interruptor)
+    : is_initialized_(false), geo_(geo), interruptor_(interruptor) {
+    guarantee(geo_ != sindex_geo_bool_t::REGULAR);
+}
 
 geo_index_traversal_helper_t::geo_index_traversal_helper_t(
+        sindex_geo_bool_t geo,
         const std::vector<std::string> &query_grid_keys,
         const signal_t *interruptor)
-    : is_initialized_(false), interruptor_(interruptor) {
+    : is_initialized_(false), geo_(geo), interruptor_(interruptor) {
+    guarantee(geo_ != sindex_geo_bool_t::REGULAR);
     init_query(query_grid_keys);
 }
 
@@ -171,6 +177,13 @@ bool geo_index_traversal_helper_t::any_query_cell_intersects(
         ? S2CellId::FromFacePosLevel(5, 0, 0) // The largest valid cell id
         : btree_key_to_s2cellid(right_incl_or_null);
 
+    if (geo_ == sindex_geo_bool_t::GEO_POINTS) {
+        // Only leaf cells are stored, so nothing in [left_cell, right_cell] can
+        // reach beyond it. This turns the traversal into range scans over the
+        // query cells.
+        return any_query_cell_intersects(left_cell.range_min(), right_cell.range_max());
+    }
+
     // Determine a S2CellId range that is a superset of what's intersecting
     // with anything stored in [left_cell, right_cell].
     int common_level;
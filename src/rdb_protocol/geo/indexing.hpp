@@ -13,6 +13,7 @@ namespace ql {
 class datum_t;
 }
 class signal_t;
+enum class sindex_geo_bool_t;
 
 
 /* Polygons and lines are inserted into an index by computing a coverage of them
@@ -32,8 +33,12 @@ std::vector<std::string> compute_index_grid_keys(
 // TODO (daniel): Support compound indexes somehow.
 class geo_index_traversal_helper_t : public concurrent_traversal_callback_t {
 public:
-    explicit geo_index_traversal_helper_t(const signal_t *interruptor);
-    explicit geo_index_traversal_helper_t(
+    /* `geo` is the kind of geospatial index that is traversed. If it's
+    `GEO_POINTS`, every entry is a leaf cell, so ranges of the index can be pruned
+    exactly instead of by their smallest common parent cell. */
+    geo_index_traversal_helper_t(sindex_geo_bool_t geo, const signal_t *interruptor);
+    geo_index_traversal_helper_t(
+            sindex_geo_bool_t geo,
             const std::vector<std::string> &query_grid_keys,
             const signal_t *interruptor);
 
@@ -68,6 +73,7 @@ private:
 
     std::vector<geo::S2CellId> query_cells_;
     bool is_initialized_;
+    sindex_geo_bool_t geo_;
     const signal_t *interruptor_;
 };
 
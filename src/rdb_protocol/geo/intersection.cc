@@ -6,10 +6,13 @@
 #include "rdb_protocol/geo/geojson.hpp"
 #include "rdb_protocol/geo/geo_visitor.hpp"
 #include "rdb_protocol/geo/s2/s2.h"
+#include "rdb_protocol/geo/s2/s2latlng.h"
 #include "rdb_protocol/geo/s2/s2polygon.h"
 #include "rdb_protocol/geo/s2/s2polyline.h"
 #include "rdb_protocol/datum.hpp"
 
+using geo::S2LatLng;
+using geo::S2LatLngRect;
 using geo::S2Point;
 using geo::S2Polygon;
 using geo::S2Polyline;
@@ -129,3 +132,71 @@ bool geo_does_intersect(const S2Polygon &polygon,
     if (other_polygon.num_vertices() == 0) return false;
     return other_polygon.Intersects(&polygon);
 }
+
+// S2 computes bounding rectangles of edges numerically, so we leave some room for
+// rounding errors before deciding that two geometries can't intersect.  This is
+// about a centimeter on earth.
+const double BOUND_MARGIN_RADIANS = 1e-9;
+
+class geo_intersection_query_t::tester_t : public s2_geo_visitor_t<bool> {
+public:
+    explicit tester_t(const geo_intersection_query_t *_query) : query(_query) { }
+
+    bool on_point(const S2Point &other) {
+        return may_intersect(S2LatLngRect::FromPoint(S2LatLng(other)))
+            && test(other);
+    }
+    bool on_line(const S2Polyline &other) {
+        return may_intersect(other.GetRectBound()) && test(other);
+    }
+    bool on_polygon(const S2Polygon &other) {
+        return may_intersect(other.GetRectBound()) && test(other);
+    }
+
+private:
+    bool may_intersect(const S2LatLngRect &other_bound) const {
+        return query->bound.Intersects(other_bound.Expanded(
+            S2LatLng::FromRadians(BOUND_MARGIN_RADIANS, BOUND_MARGIN_RADIANS)));
+    }
+    template<class other_t>
+    bool test(const other_t &other) const {
+        if (query->point.has()) {
+            return geo_does_intersect(*query->point, other);
+        } else if (query->line.has()) {
+            return geo_does_intersect(*query->line, other);
+        } else {
+            return geo_does_intersect(*query->polygon, other);
+        }
+    }
+
+    const geo_intersection_query_t *query;
+};
+
+geo_intersection_query_t::geo_intersection_query_t(const datum_t &query_geometry)
+    : geometry(query_geometry) {
+    // This mirrors `visit_geojson`.
+    const datum_string_t type = geometry.get_field("type").as_str();
+    const datum_t coordinates = geometry.get_field("coordinates");
+    if (type == "Point") {
+        point = coordinates_to_s2point(coordinates);
+        bound = S2LatLngRect::FromPoint(S2LatLng(*point));
+    } else if (type == "LineString") {
+        line = coordinates_to_s2polyline(coordinates);
+        bound = line->GetRectBound();
+    } else if (type == "Polygon") {
+        polygon = coordinates_to_s2polygon(coordinates);
+        bound = polygon->GetRectBound();
+    } else {
+        // Let `visit_geojson` generate the right error.
+        intersection_tester_t tester(&geometry);
+        visit_geojson(&tester, geometry);
+        unreachable();
+    }
+}
+
+geo_intersection_query_t::~geo_intersection_query_t() { }
+
+bool geo_intersection_query_t::intersects(const datum_t &other) const {
+    tester_t tester(this);
+    return visit_geojson(&tester, other);
+}
@@ -3,6 +3,9 @@
 #define RDB_PROTOCOL_GEO_INTERSECTION_HPP_
 
 #include "containers/counted.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/geo/s2/s2latlngrect.h"
 #include "rdb_protocol/geo/s2/util/math/vector3.h"
 
 namespace geo {
@@ -11,9 +14,6 @@ class S2Polyline;
 class S2Polygon;
 }
 
-namespace ql {
-class datum_t;
-}
 
 /* A variant that works on two GeoJSON objects */
 bool geo_does_intersect(const ql::datum_t &g1,
@@ -39,4 +39,31 @@ bool geo_does_intersect(const geo::S2Polyline &line,
 bool geo_does_intersect(const geo::S2Polygon &polygon,
                         const geo::S2Polygon &other_polygon);
 
+/* A query geometry that is converted to S2 once, so that it can be tested against
+many other geometries.  `intersects` compares the bounding rectangles of the two
+geometries before running the exact test, which rejects most geometries that are
+far away from the query without having to look at their edges. */
+class geo_intersection_query_t {
+public:
+    explicit geo_intersection_query_t(const ql::datum_t &query_geometry);
+    ~geo_intersection_query_t();
+
+    const ql::datum_t &get_geometry() const { return geometry; }
+
+    // Equivalent to `geo_does_intersect(get_geometry(), other)`.
+    bool intersects(const ql::datum_t &other) const;
+
+private:
+    class tester_t;
+
+    const ql::datum_t geometry;
+    // Exactly one of these is set.
+    scoped_ptr_t<geo::S2Point> point;
+    scoped_ptr_t<geo::S2Polyline> line;
+    scoped_ptr_t<geo::S2Polygon> polygon;
+    geo::S2LatLngRect bound;
+
+    DISABLE_COPYING(geo_intersection_query_t);
+};
+
 #endif  // RDB_PROTOCOL_GEO_INTERSECTION_HPP_
@@ -2,6 +2,7 @@
 #include "rdb_protocol/geo_traversal.hpp"
 
 #include <cmath>
+#include <deque>
 
 #include "errors.hpp"
 #include <boost/variant/get.hpp>
@@ -21,6 +22,7 @@
 #include "rdb_protocol/geo/s2/s2latlng.h"
 #include "rdb_protocol/lazy_json.hpp"
 #include "rdb_protocol/profile.hpp"
+#include "thread_local.hpp"
 
 using geo::S2Point;
 using geo::S2LatLng;
@@ -35,6 +37,9 @@ const size_t MAX_PROCESSED_SET_SIZE = 10000;
 // overhead involved here and a finer grid avoids unnecessary post-filtering.
 const int QUERYING_GOAL_GRID_CELLS = GEO_INDEX_GOAL_GRID_CELLS * 2;
 
+// How many query coverings to remember on each thread.
+const size_t MAX_CACHED_COVERINGS = 128;
+
 // The radius used for the first batch of a get_nearest traversal.
 // As a fraction of the equator's radius.
 // The current value is equivalent to a radius of 10m on earth.
@@ -65,13 +70,56 @@ geo_job_data_t::geo_job_data_t(ql::env_t *_env, const ql::batchspec_t &batchspec
     guarantee(transformers.size() == _transforms.size());
 }
 
+/* Computing a covering is expensive for polygons, and clients often run the same
+query repeatedly (e.g. one batch after another, or on several shards on the same
+thread), so we remember the most recent ones. */
+class covering_cache_t {
+public:
+    std::vector<std::string> get(const ql::datum_t &geometry, int goal_cells) {
+        for (const auto &entry : entries) {
+            if (entry.goal_cells == goal_cells && entry.geometry == geometry) {
+                return entry.grid_keys;
+            }
+        }
+        entry_t entry;
+        entry.geometry = geometry;
+        entry.goal_cells = goal_cells;
+        entry.grid_keys = compute_index_grid_keys(geometry, goal_cells);
+        if (entries.size() >= MAX_CACHED_COVERINGS) {
+            entries.pop_front();
+        }
+        entries.push_back(entry);
+        return entry.grid_keys;
+    }
+private:
+    struct entry_t {
+        ql::datum_t geometry;
+        int goal_cells;
+        std::vector<std::string> grid_keys;
+    };
+    std::deque<entry_t> entries;
+};
+
+TLS_with_init(covering_cache_t *, covering_cache, NULL);
+
+static std::vector<std::string> compute_cached_index_grid_keys(
+        const ql::datum_t &geometry, int goal_cells) {
+    covering_cache_t *cache = TLS_get_covering_cache();
+    if (cache == NULL) {
+        // This is never freed, like other per-thread state.
+        cache = new covering_cache_t();
+        TLS_set_covering_cache(cache);
+    }
+    return cache->get(geometry, goal_cells);
+}
+
 /* ----------- geo_intersecting_cb_t -----------*/
 geo_intersecting_cb_t::geo_intersecting_cb_t(
         btree_slice_t *_slice,
         geo_sindex_data_t &&_sindex,
         ql::env_t *_env,
         std::set<store_key_t> *_distinct_emitted_in_out)
-    : geo_index_traversal_helper_t(_env->interruptor),
+    : geo_index_traversal_helper_t(_sindex.geo, _env->interruptor),
       slice(_slice),
       sindex(std::move(_sindex)),
       env(_env),
@@ -83,15 +131,15 @@ geo_intersecting_cb_t::geo_intersecting_cb_t(
 }
 
 void geo_intersecting_cb_t::init_query(const ql::datum_t &_query_geometry) {
-    query_geometry = _query_geometry;
+    query.init(new geo_intersection_query_t(_query_geometry));
     geo_index_traversal_helper_t::init_query(
-        compute_index_grid_keys(_query_geometry, QUERYING_GOAL_GRID_CELLS));
+        compute_cached_index_grid_keys(_query_geometry, QUERYING_GOAL_GRID_CELLS));
 }
 
 done_traversing_t geo_intersecting_cb_t::on_candidate(scoped_key_value_t &&keyvalue,
         concurrent_traversal_fifo_enforcer_signal_t waiter)
         THROWS_ONLY(interrupted_exc_t) {
-    guarantee(query_geometry.has());
+    guarantee(query.has());
     sampler->new_sample();
 
     store_key_t store_key(keyvalue.key());
@@ -113,8 +161,7 @@ done_traversing_t geo_intersecting_cb_t::on_candidate(scoped_key_value_t &&keyva
     lazy_json_t row(static_cast<const rdb_value_t *>(keyvalue.value()),
                     keyvalue.expose_buf());
     ql::datum_t val = row.get();
-    slice->stats.pm_keys_read.record();
-    slice->stats.pm_total_keys_read += 1;
+    slice->stats.record_keys_read(1);
     guarantee(!row.references_parent());
     keyvalue.reset();
 
@@ -143,9 +190,7 @@ done_traversing_t geo_intersecting_cb_t::on_candidate(scoped_key_value_t &&keyva
             sindex_val = sindex_val.get(*tag, ql::NOTHROW);
             guarantee(sindex_val.has());
         }
-        // TODO (daniel): This is a little inefficient because we re-parse
-        //   the query_geometry for each test.
-        if (geo_does_intersect(query_geometry, sindex_val)
+        if (query->intersects(sindex_val)
             && post_filter(sindex_val, val)) {
             if (distinct_emitted->size() >= env->limits().array_size_limit()) {
                 emit_error(ql::exc_t(ql::base_exc_t::GENERIC,
@@ -216,7 +261,7 @@ done_traversing_t collect_all_geo_intersecting_cb_t::emit_result(
     rassert(response->last_key <= key);
     response->last_key = key;
 
-    ql::groups_t data(optional_datum_less_t(job.env->reql_version()));
+    ql::groups_t data;
     data = {{ql::datum_t(), ql::datums_t{std::move(val)}}};
 
     for (auto it = job.transformers.begin(); it != job.transformers.end(); ++it) {
@@ -293,7 +338,12 @@ nearest_traversal_cb_t::nearest_traversal_cb_t(
         ql::env_t *_env,
         nearest_traversal_state_t *_state) :
     geo_intersecting_cb_t(_slice, std::move(_sindex), _env, &_state->distinct_emitted),
-    state(_state) {
+    state(_state),
+    distance_calculator(
+        S2LatLng::FromDegrees(state->center.latitude,
+                              state->center.longitude).ToPoint(),
+        state->reference_ellipsoid),
+    last_dist(0.0) {
     init_query_geometry();
 }
 
@@ -354,23 +404,23 @@ bool nearest_traversal_cb_t::post_filter(
         THROWS_ONLY(interrupted_exc_t, ql::base_exc_t, geo_exception_t) {
 
     // Filter out results that are outside of the current inradius
-    const S2Point s2center =
-        S2LatLng::FromDegrees(state->center.latitude, state->center.longitude).ToPoint();
-    const double dist = geodesic_distance(s2center, sindex_val, state->reference_ellipsoid);
-    return dist <= state->current_inradius;
+    boost::optional<double> dist = distance_calculator.geodesic_distance_if_within(
+        sindex_val, state->current_inradius);
+    if (!dist) {
+        return false;
+    }
+    last_dist = *dist;
+    return true;
 }
 
 done_traversing_t nearest_traversal_cb_t::emit_result(
-        ql::datum_t &&sindex_val,
+        UNUSED ql::datum_t &&sindex_val,
         UNUSED store_key_t &&key,
         ql::datum_t &&val)
         THROWS_ONLY(interrupted_exc_t, ql::base_exc_t, geo_exception_t) {
-    // TODO (daniel): Could we avoid re-computing the distance? We have already
-    //   done it in post_filter().
-    const S2Point s2center =
-        S2LatLng::FromDegrees(state->center.latitude, state->center.longitude).ToPoint();
-    const double dist = geodesic_distance(s2center, sindex_val, state->reference_ellipsoid);
-    result_acc.push_back(std::make_pair(dist, std::move(val)));
+    // `geo_intersecting_cb_t::on_candidate` calls us right after `post_filter`
+    // without blocking in between, so `last_dist` is the distance of this result.
+    result_acc.push_back(std::make_pair(last_dist, std::move(val)));
 
     return done_traversing_t::NO;
 }
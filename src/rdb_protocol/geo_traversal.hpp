@@ -16,9 +16,11 @@
 #include "containers/counted.hpp"
 #include "containers/scoped.hpp"
 #include "rdb_protocol/batching.hpp"
+#include "rdb_protocol/geo/distances.hpp"
 #include "rdb_protocol/geo/ellipsoid.hpp"
 #include "rdb_protocol/geo/exceptions.hpp"
 #include "rdb_protocol/geo/indexing.hpp"
+#include "rdb_protocol/geo/intersection.hpp"
 #include "rdb_protocol/geo/lon_lat_types.hpp"
 #include "rdb_protocol/protocol.hpp"
 #include "rdb_protocol/shards.hpp"
@@ -60,17 +62,20 @@ public:
             const key_range_t &_pkey_range,
             const ql::map_wire_func_t &_wire_func,
             reql_version_t _func_reql_version,
-            sindex_multi_bool_t _multi) :
+            sindex_multi_bool_t _multi,
+            sindex_geo_bool_t _geo) :
         pkey_range(_pkey_range),
         func(_wire_func.compile_wire_func()),
         func_reql_version(_func_reql_version),
-        multi(_multi) { }
+        multi(_multi),
+        geo(_geo) { }
 private:
     friend class geo_intersecting_cb_t;
     const key_range_t pkey_range;
     const counted_t<const ql::func_t> func;
     const reql_version_t func_reql_version;
     const sindex_multi_bool_t multi;
+    const sindex_geo_bool_t geo;
 };
 
 // Calls `emit_result()` exactly once for each document that's intersecting
@@ -109,7 +114,7 @@ protected:
 private:
     btree_slice_t *slice;
     geo_sindex_data_t sindex;
-    ql::datum_t query_geometry;
+    scoped_ptr_t<geo_intersection_query_t> query;
 
     ql::env_t *env;
 
@@ -226,6 +231,9 @@ private:
     boost::optional<ql::exc_t> error;
 
     nearest_traversal_state_t *state;
+    const geodesic_distance_calculator_t distance_calculator;
+    // The distance computed by the last call to `post_filter`, for `emit_result`.
+    double last_dist;
 };
 
 #endif  // RDB_PROTOCOL_GEO_TRAVERSAL_HPP_
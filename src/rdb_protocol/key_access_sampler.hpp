@@ -0,0 +1,57 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_KEY_ACCESS_SAMPLER_HPP_
+#define RDB_PROTOCOL_KEY_ACCESS_SAMPLER_HPP_
+
+#include <stdint.h>
+
+#include <map>
+#include <vector>
+
+#include "btree/keys.hpp"
+
+/* A store only looks at every `KEY_ACCESS_SAMPLE_INTERVAL`-th key that it reads or
+writes, and remembers the last `KEY_ACCESS_MAX_SAMPLES` of those. */
+#define KEY_ACCESS_SAMPLE_INTERVAL 16
+#define KEY_ACCESS_MAX_SAMPLES 1024
+
+/* `key_access_sampler_t` keeps a sample of the keys that a store has recently read
+or written. Distribution reads report it along with the document counts, so that
+rebalancing can take into account which parts of a table are busy and not just how
+many documents they hold. */
+class key_access_sampler_t {
+public:
+    key_access_sampler_t() : num_accesses(0), next_sample(0) { }
+
+    void record(const store_key_t &key) {
+        ++num_accesses;
+        if (num_accesses % KEY_ACCESS_SAMPLE_INTERVAL != 0) {
+            return;
+        }
+        if (samples.size() < KEY_ACCESS_MAX_SAMPLES) {
+            samples.push_back(key);
+        } else {
+            samples[next_sample] = key;
+            next_sample = (next_sample + 1) % KEY_ACCESS_MAX_SAMPLES;
+        }
+    }
+
+    /* Adds an estimate of how many recent accesses went to each sampled key in
+    `range` to `counts_out`. */
+    void get_counts(const key_range_t &range,
+                    std::map<store_key_t, int64_t> *counts_out) const {
+        for (auto it = samples.begin(); it != samples.end(); ++it) {
+            if (range.contains_key(*it)) {
+                (*counts_out)[*it] += KEY_ACCESS_SAMPLE_INTERVAL;
+            }
+        }
+    }
+
+private:
+    uint64_t num_accesses;
+    std::vector<store_key_t> samples;
+    size_t next_sample;
+
+    DISABLE_COPYING(key_access_sampler_t);
+};
+
+#endif  // RDB_PROTOCOL_KEY_ACCESS_SAMPLER_HPP_
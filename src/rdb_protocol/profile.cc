@@ -2,6 +2,7 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
 #include <limits>
 
 #include "errors.hpp"
@@ -166,6 +167,125 @@ void print_event_log(const event_log_t &event_log) {
     }
 }
 
+/* Lays out an event log as Trace Event Format "complete" events. The tasks that
+ * shards report were timed by the shards' own clocks, which we can't line up with
+ * ours. So instead of using the recorded start times, every task starts where its
+ * previous sibling ended, sub-tasks start where their parent starts, and every
+ * parallel task but the first one gets a lane (`tid`) of its own. */
+class trace_events_builder_t {
+public:
+    trace_events_builder_t() : next_lane_(1) { }
+
+    /* Lays out the tasks from `*begin` up to the next `stop_t`, starting at `ts`
+     * on `lane`, and returns how long they took together. */
+    ticks_t add_tasks(event_log_t::const_iterator *begin,
+                      event_log_t::const_iterator end,
+                      ticks_t ts, int lane) {
+        ticks_t cursor = ts;
+        while (*begin != end && !boost::get<stop_t>(&**begin)) {
+            if (const start_t *start = boost::get<start_t>(&**begin)) {
+                (*begin)++;
+                add_tasks(begin, end, cursor, lane);
+                const stop_t *stop = boost::get<stop_t>(&**begin);
+                guarantee(stop);
+                (*begin)++;
+                const ticks_t duration = stop->when_ - start->when_;
+                add_event(start->description_, cursor, duration, lane, 1);
+                cursor += duration;
+            } else if (const split_t *split = boost::get<split_t>(&**begin)) {
+                (*begin)++;
+                ticks_t longest = 0;
+                for (size_t i = 0; i < split->n_parallel_jobs_; ++i) {
+                    const int task_lane = i == 0 ? lane : next_lane_++;
+                    longest = std::max(longest, add_tasks(begin, end, cursor, task_lane));
+                    guarantee(boost::get<stop_t>(&**begin));
+                    (*begin)++;
+                }
+                cursor += longest;
+            } else if (const sample_t *sample = boost::get<sample_t>(&**begin)) {
+                (*begin)++;
+                const ticks_t duration = sample->mean_duration_ * sample->n_samples_;
+                add_event(sample->description_, cursor, duration, lane,
+                          sample->n_samples_);
+                cursor += duration;
+            } else {
+                unreachable();
+            }
+        }
+        return cursor - ts;
+    }
+
+    std::vector<ql::datum_t> events;
+
+private:
+    void add_event(const std::string &description, ticks_t ts, ticks_t duration,
+                   int lane, size_t n_samples) {
+        std::map<datum_string_t, ql::datum_t> args;
+        args[datum_string_t("n_samples")] =
+            ql::datum_t(safe_to_double(n_samples));
+        std::map<datum_string_t, ql::datum_t> res;
+        res[datum_string_t("name")] = ql::datum_t(datum_string_t(description));
+        res[datum_string_t("cat")] = ql::datum_t(datum_string_t("reql"));
+        res[datum_string_t("ph")] = ql::datum_t(datum_string_t("X"));
+        // Trace Event Format times are in microseconds.
+        res[datum_string_t("ts")] = ql::datum_t(safe_to_double(ts) / THOUSAND);
+        res[datum_string_t("dur")] = ql::datum_t(safe_to_double(duration) / THOUSAND);
+        res[datum_string_t("pid")] = ql::datum_t(0.0);
+        res[datum_string_t("tid")] = ql::datum_t(static_cast<double>(lane));
+        res[datum_string_t("args")] = ql::datum_t(std::move(args));
+        events.push_back(ql::datum_t(std::move(res)));
+    }
+
+    int next_lane_;
+};
+
+ql::datum_t construct_trace_events(const event_log_t &event_log,
+                                   const ql::configured_limits_t &limits) {
+    trace_events_builder_t builder;
+    event_log_t::const_iterator begin = event_log.begin();
+    builder.add_tasks(&begin, event_log.end(), 0, 0);
+    return ql::datum_t(std::move(builder.events), limits);
+}
+
+void wrap_parallel_tasks(const std::string &description,
+                         ticks_t start, ticks_t stop,
+                         const std::vector<sample_t> &samples,
+                         size_t n_parallel_tasks,
+                         event_log_t *event_log) {
+    event_log_t wrapped;
+    start_t wrapped_start(description);
+    wrapped_start.when_ = start;
+    wrapped.push_back(wrapped_start);
+    wrapped.insert(wrapped.end(), samples.begin(), samples.end());
+    if (n_parallel_tasks == 1) {
+        // A single task needs no split, just its terminating `stop_t` removed.
+        guarantee(!event_log->empty() && boost::get<stop_t>(&event_log->back()));
+        wrapped.insert(wrapped.end(), event_log->begin(), event_log->end() - 1);
+    } else {
+        wrapped.push_back(split_t(n_parallel_tasks));
+        wrapped.insert(wrapped.end(), event_log->begin(), event_log->end());
+    }
+    stop_t wrapped_stop;
+    wrapped_stop.when_ = stop;
+    wrapped.push_back(wrapped_stop);
+    // Terminates the task we turned the event log into.
+    wrapped.push_back(stop_t());
+    *event_log = std::move(wrapped);
+}
+
+bool single_task_duration(const event_log_t &event_log, ticks_t *duration_out) {
+    if (event_log.size() < 3) {
+        return false;
+    }
+    const start_t *start = boost::get<start_t>(&event_log.front());
+    const stop_t *stop = boost::get<stop_t>(&event_log[event_log.size() - 2]);
+    if (start == NULL || stop == NULL || stop->when_ < start->when_) {
+        return false;
+    }
+    *duration_out = stop->when_ - start->when_;
+    return true;
+}
+
 starter_t::starter_t(const std::string &description, trace_t *parent) {
     init(description, parent);
 }
@@ -300,6 +420,11 @@ ql::datum_t trace_t::as_datum() const {
                            ql::configured_limits_t());
 }
 
+ql::datum_t trace_t::as_trace_events_datum() const {
+    guarantee(!redirected_event_log_);
+    return construct_trace_events(event_log_, ql::configured_limits_t());
+}
+
 event_log_t trace_t::extract_event_log() RVALUE_THIS {
     // These guarantees imply that this trace_t gets left in a default-constructed
     // state (which is valid, thereby acceptable for an RVALUE_THIS function).
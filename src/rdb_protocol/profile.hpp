@@ -14,6 +14,7 @@
 #include "time.hpp"
 
 namespace ql {
+class configured_limits_t;
 class datum_t;
 } //namespace ql
 
@@ -65,6 +66,9 @@ class trace_t {
 public:
     trace_t();
     ql::datum_t as_datum() const;
+    /* The same profile as an array of Trace Event Format events, which
+     * chrome://tracing and similar viewers can display. */
+    ql::datum_t as_trace_events_datum() const;
     event_log_t extract_event_log() RVALUE_THIS;
 private:
     friend class starter_t;
@@ -199,6 +203,25 @@ private:
 
 void print_event_log(const event_log_t &event_log);
 
+ql::datum_t construct_trace_events(const event_log_t &event_log,
+                                   const ql::configured_limits_t &limits);
+
+/* The event logs that shards send back hold `n_parallel_tasks` tasks, each
+ * terminated by a `stop_t`, that the receiving side passes to a `splitter_t`.
+ * `wrap_parallel_tasks()` turns such an event log into a single task, called
+ * `description`, that went from `start` to `stop` and begins with `samples`.
+ * This is how the hops that a query takes to reach a shard show up in the
+ * profile. */
+void wrap_parallel_tasks(const std::string &description,
+                         ticks_t start, ticks_t stop,
+                         const std::vector<sample_t> &samples,
+                         size_t n_parallel_tasks,
+                         event_log_t *event_log);
+
+/* If `event_log` holds a single task as `wrap_parallel_tasks()` produces it,
+ * sets `*duration_out` to how long the task took and returns true. */
+bool single_task_duration(const event_log_t &event_log, ticks_t *duration_out);
+
 }  // namespace profile
 
 #endif  // RDB_PROTOCOL_PROFILE_HPP_
@@ -359,6 +359,15 @@ store_key_t sindex_list_region_key() {
     return store_key_t();
 }
 
+multi_point_read_t::multi_point_read_t(std::vector<store_key_t> &&_keys)
+    : keys(std::move(_keys)),
+      region(keys.empty()
+             ? region_t::empty()
+             : region_t(key_range_t(key_range_t::closed, keys.front(),
+                                    key_range_t::closed, keys.back()))) {
+    rassert(std::is_sorted(keys.begin(), keys.end()));
+}
+
 /* read_t::get_region implementation */
 struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const point_read_t &pr) const {
@@ -408,6 +417,14 @@ struct rdb_r_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const dummy_read_t &d) const {
         return d.region;
     }
+
+    region_t operator()(const sample_read_t &sr) const {
+        return sr.region;
+    }
+
+    region_t operator()(const multi_point_read_t &mpr) const {
+        return mpr.region;
+    }
 };
 
 region_t read_t::get_region() const THROWS_NOTHING {
@@ -415,9 +432,10 @@ region_t read_t::get_region() const THROWS_NOTHING {
 }
 
 struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
-    explicit rdb_r_shard_visitor_t(const hash_region_t<key_range_t> *_region,
-                                   read_t::variant_t *_payload_out)
-        : region(_region), payload_out(_payload_out) { }
+    rdb_r_shard_visitor_t(const hash_region_t<key_range_t> *_region,
+                          size_t _fanout,
+                          read_t::variant_t *_payload_out)
+        : region(_region), fanout(_fanout), payload_out(_payload_out) { }
 
     // The key was somehow already extracted from the arg.
     template <class T>
@@ -468,7 +486,18 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         bool do_read = rangey_read(rg);
         if (do_read) {
             auto rg_out = boost::get<rget_read_t>(payload_out);
-            rg_out->batchspec = rg_out->batchspec.scale_down(CPU_SHARDING_FACTOR);
+            // The unsharding of an ordered read merges every region's rows and
+            // cuts them off at the smallest last key, so rows fetched past
+            // roughly `1/fanout` of the batch from any one region get thrown
+            // away.  Unordered reads keep their larger per-region batches, but
+            // tables with few CPU shards don't need to make them any smaller than
+            // the number of regions.
+            int64_t divisor = fanout;
+            if (rg.sorting == sorting_t::UNORDERED) {
+                divisor = std::min<int64_t>(CPU_SHARDING_FACTOR, fanout);
+            }
+            divisor = std::max<int64_t>(divisor, 1);
+            rg_out->batchspec = rg_out->batchspec.scale_down(divisor);
         }
         return do_read;
     }
@@ -497,14 +526,36 @@ struct rdb_r_shard_visitor_t : public boost::static_visitor<bool> {
         return rangey_read(d);
     }
 
+    bool operator()(const sample_read_t &sr) const {
+        return rangey_read(sr);
+    }
+
+    bool operator()(const multi_point_read_t &mpr) const {
+        multi_point_read_t tmp;
+        for (const store_key_t &key : mpr.keys) {
+            if (region_contains_key(*region, key)) {
+                tmp.keys.push_back(key);
+            }
+        }
+        if (tmp.keys.empty()) {
+            return false;
+        }
+        tmp.region = region_intersection(*region, mpr.region);
+        *payload_out = tmp;
+        return true;
+    }
+
     const hash_region_t<key_range_t> *region;
+    size_t fanout;
     read_t::variant_t *payload_out;
 };
 
 bool read_t::shard(const hash_region_t<key_range_t> &region,
-                   read_t *read_out) const THROWS_NOTHING {
+                   read_t *read_out,
+                   size_t fanout) const THROWS_NOTHING {
     read_t::variant_t payload;
-    bool result = boost::apply_visitor(rdb_r_shard_visitor_t(&region, &payload), read);
+    bool result = boost::apply_visitor(
+        rdb_r_shard_visitor_t(&region, fanout, &payload), read);
     *read_out = read_t(payload, profile);
     return result;
 }
@@ -565,6 +616,8 @@ public:
     void operator()(const changefeed_stamp_t &);
     void operator()(const changefeed_point_stamp_t &);
     void operator()(const dummy_read_t &);
+    void operator()(const sample_read_t &);
+    void operator()(const multi_point_read_t &);
 
 private:
     // Shared by rget_read_t and intersecting_geo_read_t operators
@@ -628,6 +681,18 @@ void rdb_r_unshard_visitor_t::operator()(const changefeed_stamp_t &) {
                 it_out->second = std::max(it->second, it_out->second);
             }
         }
+        // Several responses can come from the same `server_t`; the later read
+        // has the later position and its replay includes the earlier one's.
+        for (auto it = res->log_positions.begin();
+             it != res->log_positions.end();
+             ++it) {
+            auto it_out = out->log_positions.find(it->first);
+            if (it_out == out->log_positions.end() || it->second > it_out->second) {
+                out->log_positions[it->first] = it->second;
+                out->replay[it->first] = std::move(res->replay[it->first]);
+            }
+        }
+        out->truncated.insert(res->truncated.begin(), res->truncated.end());
     }
 }
 
@@ -718,7 +783,7 @@ void rdb_r_unshard_visitor_t::unshard_range_batch(const query_t &q, sorting_t so
     }
     scoped_ptr_t<profile::trace_t> trace = ql::maybe_make_profile_trace(profile);
     ql::env_t env(ctx, ql::return_empty_normal_batches_t::NO,
-                  interruptor, q.optargs, trace.get_or_null());
+                  interruptor, q.optargs, trace.get_or_null(), nullptr);
 
     // Initialize response.
     response_out->response = query_response_t();
@@ -793,6 +858,14 @@ void rdb_r_unshard_visitor_t::operator()(const distribution_read_t &dg) {
     std::sort(results.begin(), results.end(), distribution_read_response_less_t());
 
     distribution_read_response_t res;
+    // Every shard only saw the accesses to its own keys, so we just add them up.
+    for (auto it = results.begin(); it != results.end(); ++it) {
+        for (auto mit = it->key_access_counts.begin();
+             mit != it->key_access_counts.end();
+             ++mit) {
+            res.key_access_counts[mit->first] += mit->second;
+        }
+    }
     size_t i = 0;
     while (i < results.size()) {
         // Find the largest hash shard for this key range
@@ -869,6 +942,38 @@ void rdb_r_unshard_visitor_t::operator()(const dummy_read_t &) {
     *response_out = responses[0];
 }
 
+void rdb_r_unshard_visitor_t::operator()(const sample_read_t &sr) {
+    std::vector<sample_read_response_t::keyed_row_t> rows;
+    for (size_t i = 0; i < count; ++i) {
+        auto res = boost::get<sample_read_response_t>(&responses[i].response);
+        guarantee(res != NULL);
+        std::move(res->rows.begin(), res->rows.end(), std::back_inserter(rows));
+    }
+    // The rows with the largest keys across all shards are a weighted sample
+    // without replacement of all of them.
+    auto greater_key = [](const sample_read_response_t::keyed_row_t &a,
+                          const sample_read_response_t::keyed_row_t &b) {
+        return a.first > b.first;
+    };
+    if (rows.size() > sr.num) {
+        std::nth_element(rows.begin(), rows.begin() + sr.num, rows.end(), greater_key);
+        rows.resize(sr.num);
+    }
+    response_out->response = sample_read_response_t();
+    boost::get<sample_read_response_t>(&response_out->response)->rows.swap(rows);
+}
+
+void rdb_r_unshard_visitor_t::operator()(const multi_point_read_t &) {
+    std::vector<std::pair<store_key_t, ql::datum_t> > rows;
+    for (size_t i = 0; i < count; ++i) {
+        auto res = boost::get<multi_point_read_response_t>(&responses[i].response);
+        guarantee(res != NULL);
+        std::move(res->rows.begin(), res->rows.end(), std::back_inserter(rows));
+    }
+    response_out->response = multi_point_read_response_t();
+    boost::get<multi_point_read_response_t>(&response_out->response)->rows.swap(rows);
+}
+
 void read_t::unshard(read_response_t *responses, size_t count,
                      read_response_t *response_out, rdb_context_t *ctx,
                      signal_t *interruptor) const
@@ -884,6 +989,10 @@ void read_t::unshard(read_response_t *responses, size_t count,
      * we set them here. */
     response_out->n_shards = 0;
     response_out->event_log.clear();
+    response_out->usage = resource_usage_t();
+    for (size_t i = 0; i < count; ++i) {
+        response_out->usage.add(responses[i].usage);
+    }
     if (profile == profile_bool_t::PROFILE) {
         for (size_t i = 0; i < count; ++i) {
             response_out->event_log.insert(
@@ -898,6 +1007,8 @@ void read_t::unshard(read_response_t *responses, size_t count,
 struct use_snapshot_visitor_t : public boost::static_visitor<bool> {
     bool operator()(const point_read_t &) const {                 return false; }
     bool operator()(const dummy_read_t &) const {                 return false; }
+    bool operator()(const sample_read_t &) const {                return true;  }
+    bool operator()(const multi_point_read_t &) const {           return true;  }
     bool operator()(const rget_read_t &) const {                  return true;  }
     bool operator()(const intersecting_geo_read_t &) const {      return true;  }
     bool operator()(const nearest_geo_read_t &) const {           return true;  }
@@ -919,6 +1030,8 @@ bool read_t::use_snapshot() const THROWS_NOTHING {
 struct route_to_primary_visitor_t : public boost::static_visitor<bool> {
     bool operator()(const point_read_t &) const {                 return false; }
     bool operator()(const dummy_read_t &) const {                 return false; }
+    bool operator()(const sample_read_t &) const {                return false; }
+    bool operator()(const multi_point_read_t &) const {           return false; }
     bool operator()(const rget_read_t &) const {                  return false; }
     bool operator()(const intersecting_geo_read_t &) const {      return false; }
     bool operator()(const nearest_geo_read_t &) const {           return false; }
@@ -1030,6 +1143,10 @@ struct rdb_w_get_region_visitor : public boost::static_visitor<region_t> {
     region_t operator()(const dummy_write_t &d) const {
         return d.region;
     }
+
+    region_t operator()(const expire_t &e) const {
+        return e.region;
+    }
 };
 
 #ifndef NDEBUG
@@ -1132,6 +1249,10 @@ struct rdb_w_shard_visitor_t : public boost::static_visitor<bool> {
         return rangey_write(d);
     }
 
+    bool operator()(const expire_t &e) const {
+        return rangey_write(e);
+    }
+
     const region_t *region;
     write_t::variant_t *payload_out;
 };
@@ -1176,6 +1297,10 @@ struct rdb_w_unshard_visitor_t : public boost::static_visitor<void> {
         merge_stats();
     }
 
+    void operator()(const expire_t &) const {
+        merge_stats();
+    }
+
     void operator()(const point_write_t &) const { monokey_response(); }
     void operator()(const point_delete_t &) const { monokey_response(); }
 
@@ -1234,6 +1359,12 @@ void write_t::unshard(write_response_t *responses, size_t count,
      * we set them here. */
     response_out->n_shards = 0;
     response_out->event_log.clear();
+    response_out->usage = resource_usage_t();
+    response_out->versions.clear();
+    for (size_t i = 0; i < count; ++i) {
+        response_out->usage.add(responses[i].usage);
+        merge_write_versions(responses[i].versions, &response_out->versions);
+    }
     if (profile == profile_bool_t::PROFILE) {
         for (size_t i = 0; i < count; ++i) {
             response_out->event_log.insert(
@@ -1263,20 +1394,26 @@ ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(
 RDB_IMPL_SERIALIZABLE_4_FOR_CLUSTER(rget_read_response_t,
                                     result, skey_version, truncated, last_key);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(nearest_geo_read_response_t, results_or_error);
-RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(distribution_read_response_t, region, key_counts);
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(distribution_read_response_t, region, key_counts,
+                                    key_access_counts);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(sindex_list_response_t, sindexes);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(sindex_status_response_t, statuses);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(
     changefeed_subscribe_response_t, server_uuids, addrs);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(
     changefeed_limit_subscribe_response_t, shards, limit_addrs);
-RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(changefeed_stamp_response_t, stamps);
+RDB_IMPL_SERIALIZABLE_4_FOR_CLUSTER(
+    changefeed_stamp_response_t, stamps, log_positions, replay, truncated);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(
     changefeed_point_stamp_response_t, stamp, initial_val);
-RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(read_response_t, response, event_log, n_shards);
+RDB_IMPL_SERIALIZABLE_4_FOR_CLUSTER(read_response_t, response, event_log, n_shards,
+                                    usage);
 RDB_IMPL_SERIALIZABLE_0_FOR_CLUSTER(dummy_read_response_t);
+RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(sample_read_response_t, rows);
+RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(multi_point_read_response_t, rows);
 
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(point_read_t, key);
+RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(multi_point_read_t, keys, region);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(dummy_read_t, region);
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(sindex_rangespec_t, id, region, original_range);
 
@@ -1295,13 +1432,15 @@ RDB_IMPL_SERIALIZABLE_8_FOR_CLUSTER(
 
 RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(
         distribution_read_t, max_depth, result_limit, region);
+RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(sample_read_t, num, region);
 RDB_IMPL_SERIALIZABLE_0_FOR_CLUSTER(sindex_list_t);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(sindex_status_t, sindexes, region);
 
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(changefeed_subscribe_t, addr, region);
 RDB_IMPL_SERIALIZABLE_5_FOR_CLUSTER(
     changefeed_limit_subscribe_t, addr, uuid, spec, table, region);
-RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(changefeed_stamp_t, addr, region);
+RDB_IMPL_SERIALIZABLE_4_FOR_CLUSTER(
+    changefeed_stamp_t, addr, region, resumable, resume_from);
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(changefeed_point_stamp_t, addr, key);
 
 RDB_IMPL_SERIALIZABLE_2_FOR_CLUSTER(read_t, read, profile);
@@ -1315,7 +1454,8 @@ RDB_IMPL_SERIALIZABLE_0_FOR_CLUSTER(dummy_write_response_t);
 
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(sindex_rename_response_t, result);
 
-RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(write_response_t, response, event_log, n_shards);
+RDB_IMPL_SERIALIZABLE_5_FOR_CLUSTER(write_response_t, response, event_log, n_shards,
+                                    usage, versions);
 
 // Serialization format for these changed in 1.14.  We only support the
 // latest version, since these are cluster-only types.
@@ -1326,10 +1466,12 @@ RDB_IMPL_SERIALIZABLE_5_FOR_CLUSTER(
 
 RDB_IMPL_SERIALIZABLE_3_SINCE_v1_13(point_write_t, key, data, overwrite);
 RDB_IMPL_SERIALIZABLE_1_SINCE_v1_13(point_delete_t, key);
-RDB_IMPL_SERIALIZABLE_5_FOR_CLUSTER(sindex_create_t, id, mapping, region, multi, geo);
+RDB_IMPL_SERIALIZABLE_6_FOR_CLUSTER(sindex_create_t,
+                                    id, mapping, region, multi, geo, values);
 RDB_IMPL_SERIALIZABLE_2_SINCE_v1_13(sindex_drop_t, id, region);
 RDB_IMPL_SERIALIZABLE_1_SINCE_v1_13(sync_t, region);
 RDB_IMPL_SERIALIZABLE_1_FOR_CLUSTER(dummy_write_t, region);
+RDB_IMPL_SERIALIZABLE_5_FOR_CLUSTER(expire_t, sindex, pkey, cutoff, max_rows, region);
 
 RDB_IMPL_SERIALIZABLE_4_FOR_CLUSTER(sindex_rename_t, region,
                                     old_name, new_name, overwrite);
@@ -15,6 +15,7 @@
 #include <boost/variant.hpp>
 #include <boost/optional.hpp>
 
+#include "arch/runtime/resource_usage.hpp"
 #include "btree/secondary_operations.hpp"
 #include "concurrency/cond_var.hpp"
 #include "perfmon/perfmon.hpp"
@@ -122,12 +123,19 @@ struct backfill_atom_t {
 RDB_DECLARE_SERIALIZABLE(backfill_atom_t);
 
 enum class sindex_multi_bool_t { SINGLE = 0, MULTI = 1};
-enum class sindex_geo_bool_t { REGULAR = 0, GEO = 1};
+// `GEO_POINTS` is a geospatial index that only indexes points, which lets queries
+// skip every part of the index that lies outside of the query's cells.
+enum class sindex_geo_bool_t { REGULAR = 0, GEO = 1, GEO_POINTS = 2};
+// Whether the entries of a secondary index hold a copy of their row (which is how
+// primary key reads get by without looking at the primary index), or nothing.
+enum class sindex_values_bool_t { DOCUMENT = 0, PRIMARY_KEY = 1};
 
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(sindex_multi_bool_t, int8_t,
         sindex_multi_bool_t::SINGLE, sindex_multi_bool_t::MULTI);
 ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(sindex_geo_bool_t, int8_t,
-        sindex_geo_bool_t::REGULAR, sindex_geo_bool_t::GEO);
+        sindex_geo_bool_t::REGULAR, sindex_geo_bool_t::GEO_POINTS);
+ARCHIVE_PRIM_MAKE_RANGED_SERIALIZABLE(sindex_values_bool_t, int8_t,
+        sindex_values_bool_t::DOCUMENT, sindex_values_bool_t::PRIMARY_KEY);
 
 namespace rdb_protocol {
 
@@ -166,6 +174,12 @@ struct point_read_response_t {
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(point_read_response_t);
 
+struct multi_point_read_response_t {
+    // The rows that were found, with their primary keys, in no particular order.
+    std::vector<std::pair<store_key_t, ql::datum_t> > rows;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(multi_point_read_response_t);
+
 struct rget_read_response_t {
     ql::result_t result;
     ql::skey_version_t skey_version;
@@ -209,6 +223,15 @@ struct nearest_geo_read_response_t {
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(nearest_geo_read_response_t);
 
+struct sample_read_response_t {
+    // Every row comes with a random sort key that is weighted by the number of rows
+    // that it stands for.  Unsharding keeps the rows with the largest keys, so that
+    // every shard contributes in proportion to its size.
+    typedef std::pair<double, ql::datum_t> keyed_row_t;
+    std::vector<keyed_row_t> rows;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(sample_read_response_t);
+
 void scale_down_distribution(size_t result_limit, std::map<store_key_t, int64_t> *key_counts);
 
 struct distribution_read_response_t {
@@ -220,6 +243,9 @@ struct distribution_read_response_t {
     // key_counts[kn] = the number of keys in [kn, right_key)
     region_t region;
     std::map<store_key_t, int64_t> key_counts;
+    // Estimates of how often the keys in `key_access_counts` have been accessed
+    // recently, from the stores' `key_access_sampler_t`s.
+    std::map<store_key_t, int64_t> key_access_counts;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(distribution_read_response_t);
 
@@ -249,6 +275,14 @@ struct changefeed_stamp_response_t {
     // different timestamps for each `server_t` because they're on different
     // servers and don't synchronize with each other.)
     std::map<uuid_u, uint64_t> stamps;
+    // These are only filled in for resumable changefeeds.  `log_positions` has
+    // the position of each `server_t`'s change log at the time of the stamp,
+    // `replay` has the logged changes from `changefeed_stamp_t::resume_from` up
+    // to there, and `truncated` has the `server_t`s whose logs don't reach back
+    // that far any more.
+    std::map<uuid_u, uint64_t> log_positions;
+    std::map<uuid_u, std::vector<ql::changefeed::msg_t::change_t> > replay;
+    std::set<uuid_u> truncated;
 };
 
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(changefeed_stamp_response_t);
@@ -292,10 +326,14 @@ struct read_response_t {
                            distribution_read_response_t,
                            sindex_list_response_t,
                            sindex_status_response_t,
-                           dummy_read_response_t> variant_t;
+                           dummy_read_response_t,
+                           sample_read_response_t,
+                           multi_point_read_response_t> variant_t;
     variant_t response;
     profile::event_log_t event_log;
     size_t n_shards;
+    // What the shards spent on the read, for the `rethinkdb.jobs` table.
+    resource_usage_t usage;
 
     read_response_t() { }
     explicit read_response_t(const variant_t &r)
@@ -312,6 +350,20 @@ public:
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(point_read_t);
 
+/* Looks up many primary keys at once.  Every shard gets the keys it's responsible for
+and reads them in one pass in key order, so that keys which share a leaf node are
+read from it without descending the btree again. */
+class multi_point_read_t {
+public:
+    multi_point_read_t() : region(region_t::empty()) { }
+    // `_keys` must be sorted and must not contain duplicates.
+    explicit multi_point_read_t(std::vector<store_key_t> &&_keys);
+
+    std::vector<store_key_t> keys;
+    region_t region;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(multi_point_read_t);
+
 // `dummy_read_t` can be used to poll for table readiness - it will go through all
 // the clustering and reactor layers, but is a no-op in the protocol layer.
 class dummy_read_t {
@@ -460,6 +512,22 @@ public:
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(distribution_read_t);
 
+/* Picks about `num` random rows from the primary index, by descending into the btree
+at random rather than reading all of it. */
+class sample_read_t {
+public:
+    sample_read_t()
+        : num(0), region(region_t::universe())
+    { }
+    explicit sample_read_t(uint64_t _num)
+        : num(_num), region(region_t::universe())
+    { }
+
+    uint64_t num;
+    region_t region;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(sample_read_t);
+
 struct sindex_list_t {
     sindex_list_t() { }
 };
@@ -509,13 +577,23 @@ struct changefeed_limit_subscribe_t {
 RDB_DECLARE_SERIALIZABLE(changefeed_limit_subscribe_t);
 
 struct changefeed_stamp_t {
-    changefeed_stamp_t() : region(region_t::universe()) { }
+    changefeed_stamp_t() : region(region_t::universe()), resumable(false) { }
     explicit changefeed_stamp_t(
-        ql::changefeed::client_t::addr_t _addr)
+        ql::changefeed::client_t::addr_t _addr,
+        const ql::changefeed::resume_t &resume = ql::changefeed::resume_t())
         : addr(std::move(_addr)),
-          region(region_t::universe()) { }
+          region(region_t::universe()),
+          resumable(resume.resumable) {
+        if (resume.from) {
+            resume_from = *resume.from;
+        }
+    }
     ql::changefeed::client_t::addr_t addr;
     region_t region;
+    // Whether to read the change log positions (see
+    // `changefeed_stamp_response_t`), and which changes to replay.
+    bool resumable;
+    std::map<uuid_u, uint64_t> resume_from;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(changefeed_stamp_t);
 
@@ -538,15 +616,21 @@ struct read_t {
                            distribution_read_t,
                            sindex_list_t,
                            sindex_status_t,
-                           dummy_read_t> variant_t;
+                           dummy_read_t,
+                           sample_read_t,
+                           multi_point_read_t> variant_t;
     variant_t read;
     profile_bool_t profile;
 
     region_t get_region() const THROWS_NOTHING;
     // Returns true if the read has any operation for this region.  Returns
-    // false if read_out has not been touched.
+    // false if read_out has not been touched.  `fanout` is the number of
+    // regions the read is being sent to; ordered range reads use it to size
+    // each region's batch so that the merged batch stays close to the
+    // requested size.
     bool shard(const region_t &region,
-               read_t *read_out) const THROWS_NOTHING;
+               read_t *read_out,
+               size_t fanout = CPU_SHARDING_FACTOR) const THROWS_NOTHING;
 
     void unshard(read_response_t *responses, size_t count,
                  read_response_t *response, rdb_context_t *ctx,
@@ -633,6 +717,10 @@ struct write_response_t {
 
     profile::event_log_t event_log;
     size_t n_shards;
+    // What the shards spent on the write, for the `rethinkdb.jobs` table.
+    resource_usage_t usage;
+    // The timestamp that the write got on each shard's branch.
+    write_versions_t versions;
 
     write_response_t() { }
     template<class T>
@@ -725,9 +813,10 @@ class sindex_create_t {
 public:
     sindex_create_t() { }
     sindex_create_t(const std::string &_id, const ql::map_wire_func_t &_mapping,
-                    sindex_multi_bool_t _multi, sindex_geo_bool_t _geo)
+                    sindex_multi_bool_t _multi, sindex_geo_bool_t _geo,
+                    sindex_values_bool_t _values)
         : id(_id), mapping(_mapping), region(region_t::universe()),
-          multi(_multi), geo(_geo)
+          multi(_multi), geo(_geo), values(_values)
     { }
 
     std::string id;
@@ -735,6 +824,7 @@ public:
     region_t region;
     sindex_multi_bool_t multi;
     sindex_geo_bool_t geo;
+    sindex_values_bool_t values;
 };
 RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(sindex_create_t);
 
@@ -787,6 +877,33 @@ public:
 };
 RDB_DECLARE_SERIALIZABLE(dummy_write_t);
 
+/* `expire_t` deletes the rows whose value in the secondary index `sindex` is a time
+before `cutoff`, at most `max_rows` of them per shard. The primary replicas of tables
+with an `expiry` send these. Every replica finds the same rows in its copy of the
+index, so they all delete the same ones. The response is the same as for
+`batched_replace_t`. */
+class expire_t {
+public:
+    expire_t() { }
+    expire_t(const std::string &_sindex,
+             const std::string &_pkey,
+             const ql::datum_t &_cutoff,
+             uint64_t _max_rows,
+             const region_t &_region) :
+        sindex(_sindex),
+        pkey(_pkey),
+        cutoff(_cutoff),
+        max_rows(_max_rows),
+        region(_region) { }
+
+    std::string sindex;
+    std::string pkey;
+    ql::datum_t cutoff;
+    uint64_t max_rows;
+    region_t region;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(expire_t);
+
 struct write_t {
     typedef boost::variant<batched_replace_t,
                            batched_insert_t,
@@ -796,7 +913,8 @@ struct write_t {
                            sindex_drop_t,
                            sindex_rename_t,
                            sync_t,
-                           dummy_write_t> variant_t;
+                           dummy_write_t,
+                           expire_t> variant_t;
     variant_t write;
 
     durability_requirement_t durability_requirement;
@@ -16,6 +16,7 @@ extern const char *const data_key;
 
 // Given a raw data string, encodes it into a `r.binary` pseudotype with base64 encoding
 scoped_cJSON_t encode_base64_ptype(const datum_string_t &data);
+std::string encode_base64(const datum_string_t &data);
 void write_binary_to_protobuf(Datum *d, const datum_string_t &data);
 
 // Given a `r.binary` pseudotype with base64 encoding, decodes it into a raw data string
@@ -294,6 +294,174 @@ std::string iso8601(const std::string &s, const std::string &default_tz, date_fo
 
 } // namespace sanitize
 
+// Hand-written conversions for the common cases of `iso8601_to_time` and
+// `time_to_iso8601`, which otherwise go through Boost's locale-driven stream
+// parsing and formatting.  They only handle dates in the years Boost supports,
+// with time zones of less than a day, and return false for anything else, so that
+// the Boost code still produces its usual results and errors in the corner cases.
+namespace fast {
+
+const int64_t ms_per_day = INT64_C(86400000);
+const int64_t us_per_day = INT64_C(86400000000);
+
+bool is_leap_year(int64_t y) {
+    return (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+}
+
+int days_in_month(int64_t y, int m) {
+    static const int days[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    return (m == 2 && is_leap_year(y)) ? 29 : days[m - 1];
+}
+
+// The number of days between 1970-01-01 and the given date of the proleptic
+// Gregorian calendar (see http://howardhinnant.github.io/date_algorithms.html).
+int64_t days_from_civil(int64_t y, int m, int d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// The inverse of `days_from_civil`.
+void civil_from_days(int64_t z, int64_t *y_out, int *m_out, int *d_out) {
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const int64_t doe = z - era * 146097;
+    const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int64_t mp = (5 * doy + 2) / 153;
+    *d_out = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+    *m_out = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    *y_out = yoe + era * 400 + (*m_out <= 2);
+}
+
+// Reads `n` digits of `s` starting at `at`, which the sanitizer has checked.
+int digits(const std::string &s, size_t at, size_t n) {
+    int res = 0;
+    for (size_t i = at; i < at + n; ++i) {
+        res = res * 10 + (s[i] - '0');
+    }
+    return res;
+}
+
+// Parses a sanitized "+HH:MM" or "-HH:MM" time zone into an offset in minutes.
+bool tz_offset_minutes(const std::string &tz, int *offset_out) {
+    if (tz.size() != 6 || (tz[0] != '+' && tz[0] != '-') || tz[3] != ':') {
+        return false;
+    }
+    const int hours = digits(tz, 1, 2);
+    if (hours > 23) {
+        return false;
+    }
+    const int minutes = hours * 60 + digits(tz, 4, 2);
+    *offset_out = tz[0] == '-' ? -minutes : minutes;
+    return true;
+}
+
+// `sanitized` is the output of `sanitize::iso8601`: a date ("YYYY-MM-DD" or
+// "YYYY-DDD"), "T", a time ("HH:MM:SS.mmm") and a time zone, which may be missing
+// or still unsanitized if it came from the default time zone.
+bool iso8601_to_epoch_time(const std::string &sanitized, date_format_t df,
+                           double *epoch_time_out, std::string *tz_out) {
+    const size_t date_size = (df == MONTH_DAY) ? 10 : 8;
+    const size_t time_start = date_size + 1;
+    const size_t tz_start = time_start + 12;
+    if ((df != MONTH_DAY && df != DAYCOUNT) || sanitized.size() <= tz_start) {
+        return false;
+    }
+
+    const int64_t year = digits(sanitized, 0, 4);
+    if (year < 1400) {
+        return false;
+    }
+    int64_t days;
+    if (df == MONTH_DAY) {
+        const int month = digits(sanitized, 5, 2);
+        const int day = digits(sanitized, 8, 2);
+        if (month < 1 || month > 12 || day < 1 || day > days_in_month(year, month)) {
+            return false;
+        }
+        days = days_from_civil(year, month, day);
+    } else {
+        const int day_of_year = digits(sanitized, 5, 3);
+        if (day_of_year < 1 || day_of_year > (is_leap_year(year) ? 366 : 365)) {
+            return false;
+        }
+        days = days_from_civil(year, 1, 1) + day_of_year - 1;
+    }
+
+    const int hours = digits(sanitized, time_start, 2);
+    const int minutes = digits(sanitized, time_start + 3, 2);
+    const int seconds = digits(sanitized, time_start + 6, 2);
+    const int millis = digits(sanitized, time_start + 9, 3);
+    if (hours > 23 || minutes > 59 || seconds > 59) {
+        return false;
+    }
+
+    std::string tz;
+    try {
+        tz = sanitize::tz(sanitized.substr(tz_start));
+    } catch (const datum_exc_t &e) {
+        return false;
+    }
+    int offset;
+    if (!tz_offset_minutes(tz, &offset)) {
+        return false;
+    }
+
+    const int64_t local_ms = days * ms_per_day
+        + ((hours * 60 + minutes) * 60 + seconds) * 1000 + millis;
+    *epoch_time_out = (local_ms - offset * INT64_C(60000)) / 1000.0;
+    *tz_out = tz;
+    return true;
+}
+
+bool time_to_iso8601(datum_t d, std::string *out) {
+    const double raw_sec = d.get_field(epoch_time_key).as_num();
+    const datum_t tz = d.get_field(timezone_key, NOTHROW);
+    int offset;
+    if (!tz.has() || !tz_offset_minutes(tz.as_str().to_std(), &offset)
+        || !(fabs(raw_sec) < 1e12)) {
+        return false;
+    }
+
+    // Truncate to microseconds the same way `add_seconds_to_ptime` does.
+    const int64_t sec = raw_sec;
+    const int64_t microsec = (raw_sec * 1000000.0) - (sec * 1000000);
+    const int64_t local_us = sec * 1000000 + microsec + offset * INT64_C(60000000);
+    int64_t days = local_us / us_per_day;
+    int64_t us_of_day = local_us % us_per_day;
+    if (us_of_day < 0) {
+        days -= 1;
+        us_of_day += us_per_day;
+    }
+
+    int64_t year;
+    int month, day;
+    civil_from_days(days, &year, &month, &day);
+    if (year < 1400 || year > 9999) {
+        return false;
+    }
+    const int64_t sec_of_day = us_of_day / 1000000;
+    const int64_t us = us_of_day % 1000000;
+    *out = strprintf("%04d-%02d-%02dT%02d:%02d:%02d",
+                     static_cast<int>(year), month, day,
+                     static_cast<int>(sec_of_day / 3600),
+                     static_cast<int>(sec_of_day / 60 % 60),
+                     static_cast<int>(sec_of_day % 60));
+    // Boost prints the fraction only when there is one, and we cut it down to
+    // milliseconds.
+    if (us != 0) {
+        *out += strprintf(".%03d", static_cast<int>(us / 1000));
+    }
+    *out += tz.as_str().to_std();
+    return true;
+}
+
+} // namespace fast
+
 bool tz_valid(const std::string &tz, std::string *tz_out = NULL) {
     try {
         std::string s = sanitize::tz(tz);
@@ -350,6 +518,12 @@ datum_t iso8601_to_time(
             rfail_target(target, base_exc_t::GENERIC, "%s", e.what());
         }
 
+        double epoch_time;
+        std::string tz;
+        if (fast::iso8601_to_epoch_time(sanitized, df, &epoch_time, &tz)) {
+            return make_time(epoch_time, tz);
+        }
+
         std::istringstream ss(sanitized);
         ss.exceptions(std::ios_base::failbit);
         switch (df) {
@@ -417,6 +591,10 @@ const std::locale tz_format =
 const std::locale no_tz_format =
     std::locale(std::locale::classic(), new output_timefmt_t("%Y-%m-%dT%H:%M:%S%F"));
 std::string time_to_iso8601(datum_t d) {
+    std::string fast_res;
+    if (fast::time_to_iso8601(d, &fast_res)) {
+        return fast_res;
+    }
     try {
         time_t t = time_to_boost(d);
         int year = t.date().year();
@@ -1,12 +1,42 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/query_cache.hpp"
 
+#include <functional>
+#include <limits>
+
+#include "logger.hpp"
+#include "pprint/js_pprint.hpp"
 #include "rdb_protocol/env.hpp"
 
 #include "debug.hpp"
 
 namespace ql {
 
+// How many bytes of serialized query terms per connection may have their compiled
+// form kept.  A compiled term is roughly as big as its serialized form.
+static const size_t COMPILED_TERM_CACHE_MAX_BYTES = MEGABYTE;
+
+// Queries and profiles in the slow query log are cut off after this many characters.
+static const size_t SLOW_QUERY_LOG_MAX_QUERY_LENGTH = 1024;
+static const size_t SLOW_QUERY_LOG_MAX_PROFILE_LENGTH = 16 * KILOBYTE;
+
+static ticks_t slow_query_threshold_ticks = 0;
+static double slow_query_profile_rate = 0;
+
+void set_slow_query_log(uint64_t threshold_ms, double profile_rate) {
+    guarantee(profile_rate >= 0 && profile_rate <= 1);
+    slow_query_threshold_ticks = threshold_ms * MILLION;
+    slow_query_profile_rate = profile_rate;
+}
+
+static std::string truncate_for_log(std::string s, size_t max_length) {
+    if (s.size() > max_length) {
+        s.resize(max_length);
+        s += "...";
+    }
+    return s;
+}
+
 query_cache_exc_t::query_cache_exc_t(Response_ResponseType _type,
                                      std::string _message,
                                      backtrace_t _bt) :
@@ -74,6 +104,9 @@ query_cache_t::query_cache_t(
         rdb_ctx(_rdb_ctx),
         client_addr_port(_client_addr_port),
         return_empty_normal_batches(_return_empty_normal_batches),
+        // Entries are evicted when they take up too many bytes, not by count.
+        compiled_terms(std::numeric_limits<size_t>::max()),
+        compiled_terms_bytes(0),
         next_query_id(0),
         oldest_outstanding_query_id(0) {
     auto res = rdb_ctx->get_query_caches_for_this_thread()->insert(this);
@@ -98,7 +131,7 @@ scoped_ptr_t<query_cache_t::ref_t> query_cache_t::create(
         protob_t<Query> original_query,
         use_json_t use_json,
         signal_t *interruptor) {
-    if (queries.find(token) != queries.end()) {
+    if (queries.find(token) != NULL) {
         throw query_cache_exc_t(Response::CLIENT_ERROR,
             strprintf("ERROR: duplicate token %" PRIi64, token), backtrace_t());
     }
@@ -110,8 +143,18 @@ scoped_ptr_t<query_cache_t::ref_t> query_cache_t::create(
         global_optargs = parse_global_optargs(original_query);
 
         Term *t = original_query->mutable_query();
-        compile_env_t compile_env((var_visibility_t()));
-        root_term = compile_term(&compile_env, original_query.make_child(t));
+        std::string serialized = t->SerializeAsString();
+        const size_t hash = std::hash<std::string>()(serialized);
+        auto cached = compiled_terms.find(hash);
+        if (cached != compiled_terms.end() && cached->second.serialized == serialized) {
+            ++rdb_ctx->stats.term_cache_hits;
+            root_term = cached->second.term;
+        } else {
+            ++rdb_ctx->stats.term_cache_misses;
+            compile_env_t compile_env((var_visibility_t()));
+            root_term = compile_term(&compile_env, original_query.make_child(t));
+            cache_compiled_term(hash, std::move(serialized), root_term);
+        }
     } catch (const exc_t &e) {
         throw query_cache_exc_t(Response::COMPILE_ERROR, e.what(), e.backtrace());
     } catch (const datum_exc_t &e) {
@@ -126,24 +169,47 @@ scoped_ptr_t<query_cache_t::ref_t> query_cache_t::create(
                                       entry.get(),
                                       use_json,
                                       interruptor));
-    auto insert_res = queries.insert(std::make_pair(token, std::move(entry)));
-    guarantee(insert_res.second);
+    bool inserted = queries.insert(token, std::move(entry));
+    guarantee(inserted);
     return ref;
 }
 
+void query_cache_t::cache_compiled_term(size_t hash, std::string &&serialized,
+                                        counted_t<const term_t> term) {
+    // A different term with the same hash gets replaced.
+    auto it = compiled_terms.find(hash);
+    if (it != compiled_terms.end()) {
+        compiled_terms_bytes -= it->second.serialized.size();
+        compiled_terms.erase(hash);
+    }
+    if (serialized.size() > COMPILED_TERM_CACHE_MAX_BYTES) {
+        return;
+    }
+    while (compiled_terms_bytes + serialized.size() > COMPILED_TERM_CACHE_MAX_BYTES) {
+        guarantee(!compiled_terms.empty());
+        const size_t oldest = compiled_terms.rbegin()->first;
+        compiled_terms_bytes -= compiled_terms.rbegin()->second.serialized.size();
+        compiled_terms.erase(oldest);
+    }
+    compiled_terms_bytes += serialized.size();
+    compiled_term_t *entry = &compiled_terms[hash];
+    entry->serialized = std::move(serialized);
+    entry->term = std::move(term);
+}
+
 scoped_ptr_t<query_cache_t::ref_t> query_cache_t::get(
         int64_t token,
         use_json_t use_json,
         signal_t *interruptor) {
-    auto it = queries.find(token);
-    if (it == queries.end()) {
+    scoped_ptr_t<entry_t> *entry = queries.find(token);
+    if (entry == NULL) {
         throw query_cache_exc_t(Response::CLIENT_ERROR,
             strprintf("Token %" PRIi64 " not in stream cache.", token), backtrace_t());
     }
 
     return scoped_ptr_t<ref_t>(new ref_t(this,
                                          token,
-                                         it->second.get(),
+                                         entry->get(),
                                          use_json,
                                          interruptor));
 }
@@ -151,8 +217,7 @@ scoped_ptr_t<query_cache_t::ref_t> query_cache_t::get(
 void query_cache_t::noreply_wait(const query_id_t &query_id,
                                  int64_t token,
                                  signal_t *interruptor) {
-    auto it = queries.find(token);
-    if (it != queries.end()) {
+    if (queries.find(token) != NULL) {
         throw query_cache_exc_t(Response::CLIENT_ERROR,
             strprintf("ERROR: duplicate token %" PRIi64, token), backtrace_t());
     }
@@ -165,9 +230,9 @@ void query_cache_t::noreply_wait(const query_id_t &query_id,
 
 void query_cache_t::terminate_query(int64_t token) {
     assert_thread();
-    auto entry_it = queries.find(token);
-    if (entry_it != queries.end()) {
-        terminate_internal(entry_it->second.get());
+    scoped_ptr_t<entry_t> *entry = queries.find(token);
+    if (entry != NULL) {
+        terminate_internal(entry->get());
     }
 }
 
@@ -186,7 +251,9 @@ query_cache_t::ref_t::ref_t(query_cache_t *_query_cache,
                             signal_t *interruptor) :
         entry(_entry),
         token(_token),
-        trace(maybe_make_profile_trace(entry->profile)),
+        trace(maybe_make_profile_trace(entry->profile_sampled
+                                           ? profile_bool_t::PROFILE
+                                           : entry->profile)),
         use_json(_use_json),
         query_cache(_query_cache),
         drainer_lock(&entry->drainer),
@@ -199,6 +266,43 @@ void query_cache_t::async_destroy_entry(query_cache_t::entry_t *entry) {
     delete entry;
 }
 
+void query_cache_t::prefetch_batch(
+        rdb_context_t *rdb_ctx,
+        return_empty_normal_batches_t return_empty_normal_batches,
+        query_cache_t::entry_t *entry,
+        auto_drainer_t::lock_t drainer_lock) {
+    wait_any_t interruptor(drainer_lock.get_drain_signal(),
+                           &entry->persistent_interruptor);
+    new_mutex_in_line_t mutex_lock(&entry->mutex);
+    try {
+        wait_interruptible(mutex_lock.acq_signal(), &interruptor);
+        // A `CONTINUE` may have been served (or the query stopped) while we were
+        // waiting for the mutex.
+        if (entry->state != entry_t::state_t::STREAM || entry->has_prefetched_batch) {
+            return;
+        }
+
+        charge_resource_usage_t charge(&entry->usage);
+        env_t env(rdb_ctx, return_empty_normal_batches, &interruptor,
+                  entry->global_optargs, nullptr, &entry->usage);
+        batchspec_t batchspec = batchspec_t::user(batch_type_t::NORMAL, &env);
+        if (entry->batch_scaler.get_factor() > 1) {
+            batchspec = batchspec.scale_up(entry->batch_scaler.get_factor());
+        }
+        try {
+            entry->prefetched_batch = entry->stream->next_batch(&env, batchspec);
+        } catch (const interrupted_exc_t &) {
+            throw;
+        } catch (...) {
+            entry->prefetch_exc = std::current_exception();
+        }
+        entry->has_prefetched_batch = true;
+    } catch (const interrupted_exc_t &) {
+        // The query was stopped or is being destroyed, so nobody will ask for the
+        // batch.
+    }
+}
+
 query_cache_t::ref_t::~ref_t() {
     query_cache->assert_thread();
     guarantee(entry->state != entry_t::state_t::START);
@@ -211,15 +315,58 @@ query_cache_t::ref_t::~ref_t() {
         // We remove the entry from the cache so no new queries can acquire it
         entry->state = entry_t::state_t::DELETING;
 
-        auto it = query_cache->queries.find(token);
-        guarantee(it != query_cache->queries.end());
+        scoped_ptr_t<entry_t> *it = query_cache->queries.find(token);
+        guarantee(it != NULL);
         coro_t::spawn_sometime(std::bind(&query_cache_t::async_destroy_entry,
-                                         it->second.release()));
-        query_cache->queries.erase(it);
+                                         it->release()));
+        query_cache->queries.erase(token);
     }
 }
 
 void query_cache_t::ref_t::fill_response(Response *res) {
+    const ticks_t start_ticks = get_ticks();
+    const bool is_start = entry->state == entry_t::state_t::START;
+    try {
+        fill_response_internal(res);
+    } catch (const std::exception &ex) {
+        log_if_slow(start_ticks, is_start, ex.what());
+        throw;
+    }
+    log_if_slow(start_ticks, is_start, nullptr);
+}
+
+void query_cache_t::ref_t::log_if_slow(ticks_t start_ticks,
+                                       bool is_start,
+                                       const char *error) {
+    if (slow_query_threshold_ticks == 0) {
+        return;
+    }
+    const ticks_t duration = get_ticks() - start_ticks;
+    if (duration < slow_query_threshold_ticks) {
+        return;
+    }
+
+    // The whole query is printed on one line, so that the log stays greppable.
+    const std::string query = truncate_for_log(
+        pprint::pretty_print(std::numeric_limits<size_t>::max(),
+            pprint::render_as_normalized_javascript(entry->original_query->query())),
+        SLOW_QUERY_LOG_MAX_QUERY_LENGTH);
+    std::string details = strprintf("%s, job %s, client %s",
+        is_start ? "start" : "continue",
+        uuid_to_str(entry->job_id).c_str(),
+        query_cache->client_addr_port.to_string().c_str());
+    if (error != nullptr) {
+        details += strprintf(", failed: %s", error);
+    }
+    if (trace.has()) {
+        details += ", profile: " + truncate_for_log(trace->as_datum().print(),
+                                                    SLOW_QUERY_LOG_MAX_PROFILE_LENGTH);
+    }
+    logWRN("Slow query (%.3fs): %s (%s)",
+           ticks_to_secs(duration), query.c_str(), details.c_str());
+}
+
+void query_cache_t::ref_t::fill_response_internal(Response *res) {
     query_cache->assert_thread();
     if (entry->state != entry_t::state_t::START &&
         entry->state != entry_t::state_t::STREAM) {
@@ -232,11 +379,14 @@ void query_cache_t::ref_t::fill_response(Response *res) {
     }
 
     try {
+        charge_resource_usage_t charge(&entry->usage);
         env_t env(query_cache->rdb_ctx,
                   query_cache->return_empty_normal_batches,
                   &combined_interruptor,
                   entry->global_optargs,
-                  trace.get_or_null());
+                  trace.get_or_null(),
+                  &entry->usage,
+                  &query_cache->table_affinity);
 
         if (entry->state == entry_t::state_t::START) {
             run(&env, res);
@@ -246,9 +396,13 @@ void query_cache_t::ref_t::fill_response(Response *res) {
         if (entry->state == entry_t::state_t::STREAM) {
             serve(&env, res);
         }
+        entry->usage.rows_returned += res->response_size();
 
-        if (trace.has()) {
-            trace->as_datum().write_to_protobuf(res->mutable_profile(), use_json);
+        if (entry->profile == profile_bool_t::PROFILE) {
+            (entry->profile_as_trace_events
+                ? trace->as_trace_events_datum()
+                : trace->as_datum()).write_to_protobuf(res->mutable_profile(),
+                                                       use_json);
         }
     } catch (const interrupted_exc_t &ex) {
         if (entry->persistent_interruptor.is_pulsed()) {
@@ -311,8 +465,27 @@ void query_cache_t::ref_t::serve(env_t *env, Response *res) {
     batch_type_t batch_type = entry->has_sent_batch
                                   ? batch_type_t::NORMAL
                                   : batch_type_t::NORMAL_FIRST;
-    std::vector<datum_t> ds = entry->stream->next_batch(
-            env, batchspec_t::user(batch_type, env));
+    std::vector<datum_t> ds;
+    if (entry->has_prefetched_batch) {
+        entry->has_prefetched_batch = false;
+        if (entry->prefetch_exc) {
+            std::exception_ptr exc;
+            std::swap(exc, entry->prefetch_exc);
+            std::rethrow_exception(exc);
+        }
+        ds = std::move(entry->prefetched_batch);
+        entry->prefetched_batch.clear();
+    } else {
+        const bool adaptive = batch_scaler_t::is_enabled(env);
+        batchspec_t batchspec = batchspec_t::user(batch_type, env);
+        if (adaptive) {
+            batchspec = entry->batch_scaler.on_request(batchspec);
+        }
+        ds = entry->stream->next_batch(env, batchspec);
+        if (adaptive) {
+            entry->batch_scaler.on_batch_read();
+        }
+    }
     entry->has_sent_batch = true;
     for (auto d = ds.begin(); d != ds.end(); ++d) {
         d->write_to_protobuf(res->add_response(), use_json);
@@ -352,6 +525,21 @@ void query_cache_t::ref_t::serve(env_t *env, Response *res) {
     default: unreachable();
     }
     entry->stream->set_notes(res);
+
+    // Feeds aren't prefetched because their batches wait for changes, and profiled
+    // queries aren't because the prefetch wouldn't show up in the profile.
+    if (entry->state == entry_t::state_t::STREAM
+        && entry->stream->cfeed_type() == feed_type_t::not_feed
+        && !trace.has()) {
+        scoped_ptr_t<val_t> prefetch = env->get_optarg(env, "prefetch_batches");
+        if (prefetch.has() && prefetch->as_bool()) {
+            coro_t::spawn_sometime(std::bind(&query_cache_t::prefetch_batch,
+                                             query_cache->rdb_ctx,
+                                             query_cache->return_empty_normal_batches,
+                                             entry,
+                                             auto_drainer_t::lock_t(&entry->drainer)));
+        }
+    }
 }
 
 query_cache_t::entry_t::entry_t(protob_t<Query> _original_query,
@@ -362,9 +550,14 @@ query_cache_t::entry_t::entry_t(protob_t<Query> _original_query,
         original_query(_original_query),
         global_optargs(std::move(_global_optargs)),
         profile(profile_bool_optarg(original_query)),
+        profile_as_trace_events(profile_as_trace_events_optarg(original_query)),
         start_time(current_microtime()),
+        profile_sampled(slow_query_threshold_ticks != 0
+                        && profile == profile_bool_t::DONT_PROFILE
+                        && randdouble() < slow_query_profile_rate),
         root_term(_root_term),
-        has_sent_batch(false) { }
+        has_sent_batch(false),
+        has_prefetched_batch(false) { }
 
 query_cache_t::entry_t::~entry_t() { }
 
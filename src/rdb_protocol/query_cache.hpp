@@ -10,6 +10,7 @@
 #include <string>
 
 #include "arch/address.hpp"
+#include "arch/runtime/resource_usage.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/new_mutex.hpp"
 #include "concurrency/wait_any.hpp"
@@ -17,11 +18,14 @@
 #include "concurrency/watchable.hpp"
 #include "containers/scoped.hpp"
 #include "containers/counted.hpp"
+#include "containers/flat_int_map.hpp"
 #include "containers/intrusive_list.hpp"
+#include "containers/lru_cache.hpp"
 #include "containers/object_buffer.hpp"
 #include "rdb_protocol/term.hpp"
 #include "rdb_protocol/datum_stream.hpp"
 #include "rdb_protocol/ql2.pb.h"
+#include "rdb_protocol/table_affinity.hpp"
 
 namespace ql {
 class env_t;
@@ -82,6 +86,9 @@ public:
               use_json_t _use_json,
               signal_t *interruptor);
 
+        void fill_response_internal(Response *res);
+        void log_if_slow(ticks_t start_ticks, bool is_start, const char *error);
+
         void run(env_t *env, Response *res); // Run a new query
         void serve(env_t *env, Response *res); // Serve a batch from a stream
 
@@ -99,10 +106,16 @@ public:
     };
 
     // const iteration for the jobs table
-    typedef std::map<int64_t, scoped_ptr_t<entry_t> >::const_iterator const_iterator;
+    typedef flat_int_map_t<int64_t, scoped_ptr_t<entry_t> >::const_iterator
+        const_iterator;
     const_iterator begin() const;
     const_iterator end() const;
 
+    // Whether the connection has no queries running and no cursors open.
+    bool empty() const { return queries.empty(); }
+
+    table_affinity_t *get_table_affinity() { return &table_affinity; }
+
     // Interrupt a query by token
     void terminate_query(int64_t token);
 
@@ -136,7 +149,15 @@ private:
         const protob_t<Query> original_query;
         const std::map<std::string, wire_func_t> global_optargs;
         const profile_bool_t profile;
+        // Whether the client wants the profile in the Trace Event Format.
+        const bool profile_as_trace_events;
         const microtime_t start_time;
+        // Whether we collect a profile for the slow query log, even if the client
+        // didn't ask for one.
+        const bool profile_sampled;
+
+        // What the query has used so far, shown in the `rethinkdb.jobs` table.
+        resource_usage_t usage;
 
         cond_t persistent_interruptor;
 
@@ -148,6 +169,14 @@ private:
         // stream is finished
         counted_t<datum_stream_t> stream;
         bool has_sent_batch;
+        batch_scaler_t batch_scaler;
+
+        // With the `prefetch_batches` optarg, the next batch is read while the
+        // client is busy with the current one.  Either the batch or the error
+        // that reading it raised is kept until the next `CONTINUE`.
+        bool has_prefetched_batch;
+        std::vector<datum_t> prefetched_batch;
+        std::exception_ptr prefetch_exc;
 
         // The order of these is very important, do not move them around
         new_mutex_t mutex; // Only one coroutine may be using this query at a time
@@ -157,13 +186,36 @@ private:
         DISABLE_COPYING(entry_t);
     };
 
+    // A compiled root term, and the serialized (and already preprocessed) query
+    // term that it was compiled from.
+    struct compiled_term_t {
+        std::string serialized;
+        counted_t<const term_t> term;
+    };
+
+    void cache_compiled_term(size_t hash, std::string &&serialized,
+                             counted_t<const term_t> term);
+
     void terminate_internal(entry_t *entry);
     static void async_destroy_entry(entry_t *entry);
+    static void prefetch_batch(rdb_context_t *rdb_ctx,
+                               return_empty_normal_batches_t return_empty_normal_batches,
+                               entry_t *entry,
+                               auto_drainer_t::lock_t drainer_lock);
 
     rdb_context_t *const rdb_ctx;
     ip_and_port_t client_addr_port;
     return_empty_normal_batches_t return_empty_normal_batches;
-    std::map<int64_t, scoped_ptr_t<entry_t> > queries;
+    flat_int_map_t<int64_t, scoped_ptr_t<entry_t> > queries;
+
+    // Compiled root terms of recent queries, keyed by a hash of the serialized query
+    // term.  Terms are immutable once compiled, so queries with the same term can
+    // share them; a hit only counts if the full serialized term matches.  Entries
+    // are evicted when their serialized terms take up too many bytes.
+    lru_cache_t<size_t, compiled_term_t> compiled_terms;
+    size_t compiled_terms_bytes;
+
+    table_affinity_t table_affinity;
 
     // Used for noreply waiting, this contains all allocated-but-incomplete query ids
     friend class query_id_t;
@@ -174,6 +226,14 @@ private:
     DISABLE_COPYING(query_cache_t);
 };
 
+// Makes the server log every request (a query's first batch, or any `CONTINUE`)
+// that takes at least `threshold_ms` milliseconds to answer, with the normalized
+// query.  `profile_rate` is the fraction of queries that are profiled, so that the
+// profile can be logged as well if they turn out to be slow.  A threshold of 0 (the
+// default) turns the log off.  Must be called before the thread pool starts, if at
+// all.
+void set_slow_query_log(uint64_t threshold_ms, double profile_rate);
+
 } // namespace ql
 
 #endif  // RDB_PROTOCOL_QUERY_CACHE_HPP_
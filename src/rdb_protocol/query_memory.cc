@@ -0,0 +1,78 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/query_memory.hpp"
+
+#include <atomic>
+
+#include "rdb_protocol/env.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/serialize_datum.hpp"
+
+namespace ql {
+
+static std::atomic<uint64_t> global_query_memory_limit(0);
+static std::atomic<uint64_t> global_query_memory_held(0);
+
+void set_global_query_memory_limit(uint64_t bytes) {
+    global_query_memory_limit = bytes;
+}
+
+query_memory_t::query_memory_t(uint64_t limit) : limit_(limit), held_(0) { }
+
+query_memory_t::~query_memory_t() {
+    guarantee(held_ == 0);
+}
+
+bool query_memory_t::try_charge(uint64_t bytes) {
+    if (bytes > limit_ - held_) {
+        return false;
+    }
+    const uint64_t global_limit = global_query_memory_limit;
+    const uint64_t global_held = global_query_memory_held.fetch_add(bytes) + bytes;
+    if (global_limit != 0 && global_held > global_limit) {
+        global_query_memory_held -= bytes;
+        return false;
+    }
+    held_ += bytes;
+    return true;
+}
+
+void query_memory_t::release(uint64_t bytes) {
+    guarantee(bytes <= held_);
+    held_ -= bytes;
+    global_query_memory_held -= bytes;
+}
+
+query_memory_charge_t::query_memory_charge_t() : memory_(NULL), bytes_(0) { }
+
+query_memory_charge_t::~query_memory_charge_t() {
+    reset();
+}
+
+bool query_memory_charge_t::try_add(env_t *env, const datum_t &d) {
+    r_sanity_check(memory_ == NULL || memory_ == env->memory());
+    memory_ = env->memory();
+    const uint64_t size = serialized_size<cluster_version_t::CLUSTER>(d);
+    if (!memory_->try_charge(size)) {
+        return false;
+    }
+    bytes_ += size;
+    return true;
+}
+
+void query_memory_charge_t::add(env_t *env, const datum_t &d) {
+    if (!try_add(env, d)) {
+        rfail_toplevel(base_exc_t::GENERIC,
+                       "Query memory limit exceeded (the query's limit is %" PRIu64
+                       " bytes, see the `memory_limit` optarg).",
+                       env->memory()->limit());
+    }
+}
+
+void query_memory_charge_t::reset() {
+    if (memory_ != NULL) {
+        memory_->release(bytes_);
+    }
+    bytes_ = 0;
+}
+
+}  // namespace ql
@@ -0,0 +1,68 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_QUERY_MEMORY_HPP_
+#define RDB_PROTOCOL_QUERY_MEMORY_HPP_
+
+#include <stdint.h>
+
+#include "errors.hpp"
+
+namespace ql {
+
+class datum_t;
+class env_t;
+
+/* Sets how many bytes all queries on this server may hold in buffers at once.  Zero
+(the default) means that there is no server-wide limit. */
+void set_global_query_memory_limit(uint64_t bytes);
+
+/* Counts the bytes that a query holds in buffers that grow with the size of its
+input, such as the arrays built by `coerce_to('array')` and `group()` and the rows
+that `order_by()` and `distinct()` sort in memory.  The query's own limit comes from
+the `memory_limit` optarg; the server-wide limit is shared by every query on every
+thread. */
+class query_memory_t {
+public:
+    explicit query_memory_t(uint64_t limit);
+    ~query_memory_t();
+
+    // Charges `bytes` unless that would go over the query's limit or the
+    // server-wide one, in which case it returns false and charges nothing.
+    MUST_USE bool try_charge(uint64_t bytes);
+    void release(uint64_t bytes);
+
+    uint64_t limit() const { return limit_; }
+
+private:
+    const uint64_t limit_;
+    uint64_t held_;
+
+    DISABLE_COPYING(query_memory_t);
+};
+
+/* The bytes that one buffer has charged to its query.  They are released when the
+buffer is cleared (for example because it was spilled to disk) or destroyed, so it
+must not outlive the `env_t`. */
+class query_memory_charge_t {
+public:
+    query_memory_charge_t();
+    ~query_memory_charge_t();
+
+    // Charges the size of `d`.  Returns false if the query is out of memory; the
+    // caller can then spill what it has buffered and `reset()`.
+    MUST_USE bool try_add(env_t *env, const datum_t &d);
+
+    // Like `try_add()`, but throws a query error if the query is out of memory.
+    void add(env_t *env, const datum_t &d);
+
+    void reset();
+
+private:
+    query_memory_t *memory_;
+    uint64_t bytes_;
+
+    DISABLE_COPYING(query_memory_charge_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_QUERY_MEMORY_HPP_
@@ -2,12 +2,14 @@
 #include "rdb_protocol/query_server.hpp"
 
 #include "concurrency/cross_thread_watchable.hpp"
+#include "concurrency/interruptor.hpp"
 #include "concurrency/watchable.hpp"
 #include "perfmon/perfmon.hpp"
 #include "rdb_protocol/counted_term.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/profile.hpp"
 #include "rdb_protocol/query_cache.hpp"
+#include "rdb_protocol/result_cache.hpp"
 #include "rpc/semilattice/view/field.hpp"
 
 rdb_query_server_t::rdb_query_server_t(const std::set<ip_address_t> &local_addresses,
@@ -15,7 +17,9 @@ rdb_query_server_t::rdb_query_server_t(const std::set<ip_address_t> &local_addre
                                        rdb_context_t *_rdb_ctx) :
     server(_rdb_ctx, local_addresses, port, this, default_http_timeout_sec),
     rdb_ctx(_rdb_ctx),
-    thread_counters(0) { }
+    thread_counters(0),
+    batch_query_semaphores(static_cast<int64_t>(MAX_BATCH_QUERIES_PER_THREAD)),
+    result_caches(_rdb_ctx) { }
 
 http_app_t *rdb_query_server_t::get_http_app() {
     return &server;
@@ -41,11 +45,27 @@ void rdb_query_server_t::run_query(ql::query_id_t &&query_id,
                                    signal_t *interruptor) {
     guarantee(query_cache != NULL);
     guarantee(interruptor != NULL);
+    block_pm_latency latency(&rdb_ctx->stats.query_latency);
     try {
         scoped_perfmon_counter_t client_active(&rdb_ctx->stats.clients_active); // TODO: make this correct for parallelized queries
         guarantee(rdb_ctx->cluster_interface);
+
+        // Batch queries wait for a slot before they start, and then run at a lower
+        // priority than interactive ones.  Continuations of their cursors don't
+        // wait, since they're already running.
+        new_semaphore_acq_t batch_slot;
+        scoped_ptr_t<with_priority_t> batch_priority;
+        if ((query->type() == Query::START || query->type() == Query::BATCH)
+            && ql::query_priority_optarg(query) == ql::query_priority_t::BATCH) {
+            batch_slot.init(batch_query_semaphores.get(), 1);
+            wait_interruptible(batch_slot.acquisition_signal(), interruptor);
+            batch_priority.init(new with_priority_t(CORO_PRIORITY_BATCH_QUERY));
+        }
+
         // `ql::run` will set the status code
-        ql::run(std::move(query_id), query, response_out, query_cache, interruptor);
+        result_caches.get()->run_query(query, response_out, interruptor, [&]() {
+            ql::run(std::move(query_id), query, response_out, query_cache, interruptor);
+        });
     } catch (const ql::exc_t &e) {
         fill_error(response_out, Response::COMPILE_ERROR, e.what(), e.backtrace());
     } catch (const ql::datum_exc_t &e) {
@@ -7,8 +7,10 @@
 
 #include "arch/address.hpp"
 #include "protob/protob.hpp"
+#include "concurrency/new_semaphore.hpp"
 #include "concurrency/one_per_thread.hpp"
 #include "rdb_protocol/ql2.pb.h"
+#include "rdb_protocol/result_cache.hpp"
 
 namespace ql {
 template <class> class protob_t;
@@ -41,6 +43,12 @@ public:
     query_server_t server;
     rdb_context_t *rdb_ctx;
     one_per_thread_t<int> thread_counters;
+    // Admits `MAX_BATCH_QUERIES_PER_THREAD` batch queries at a time on each thread.
+    one_per_thread_t<new_semaphore_t> batch_query_semaphores;
+    // Responses to queries run with `result_cache=true`.  They live here rather than
+    // in the `rdb_context_t` because their changefeeds have to be closed before the
+    // cluster interface goes away.
+    one_per_thread_t<ql::result_cache_t> result_caches;
 
     DISABLE_COPYING(rdb_query_server_t);
 };
@@ -42,6 +42,27 @@ private:
     reql_version_t reql_version_;
 };
 
+/* Hashes and compares datums for unordered containers, with the same notion of
+equality as `optional_datum_less_t`.  The empty datum is equal only to itself. */
+class optional_datum_hash_t {
+public:
+    size_t operator()(const ql::datum_t &a) const {
+        return a.has() ? a.hash() : 0;
+    }
+};
+
+class optional_datum_equal_t {
+public:
+    bool operator()(const ql::datum_t &a,
+                    const ql::datum_t &b) const {
+        if (a.has()) {
+            return b.has() && a == b;
+        } else {
+            return !b.has();
+        }
+    }
+};
+
 /* Sorts datums according to an undefined deterministic ordering. */
 class latest_version_optional_datum_less_t :
     public optional_datum_less_t {
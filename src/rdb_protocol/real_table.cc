@@ -1,6 +1,10 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved
 #include "rdb_protocol/real_table.hpp"
 
+#include <algorithm>
+#include <map>
+
+
 #include "math.hpp"
 #include "rdb_protocol/geo/ellipsoid.hpp"
 #include "rdb_protocol/geo/distances.hpp"
@@ -9,6 +13,7 @@
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/math_utils.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/table_affinity.hpp"
 
 namespace_interface_access_t::namespace_interface_access_t() :
     nif(NULL), ref_tracker(NULL), thread(INVALID_THREAD)
@@ -82,6 +87,35 @@ ql::datum_t real_table_t::read_row(ql::env_t *env,
     return p_res->data;
 }
 
+bool real_table_t::read_rows(ql::env_t *env,
+        const std::vector<ql::datum_t> &pvals, bool use_outdated,
+        std::vector<ql::datum_t> *rows_out) {
+    std::vector<store_key_t> keys;
+    keys.reserve(pvals.size());
+    for (const ql::datum_t &pval : pvals) {
+        keys.push_back(store_key_t(pval.print_primary()));
+    }
+    std::vector<store_key_t> sorted_keys = keys;
+    std::sort(sorted_keys.begin(), sorted_keys.end());
+    sorted_keys.erase(std::unique(sorted_keys.begin(), sorted_keys.end()),
+                      sorted_keys.end());
+
+    read_t read(multi_point_read_t(std::move(sorted_keys)), env->profile());
+    read_response_t res;
+    read_with_profile(env, read, &res, use_outdated);
+    multi_point_read_response_t *m_res =
+        boost::get<multi_point_read_response_t>(&res.response);
+    r_sanity_check(m_res);
+    std::map<store_key_t, ql::datum_t> rows(m_res->rows.begin(), m_res->rows.end());
+
+    rows_out->reserve(keys.size());
+    for (const store_key_t &key : keys) {
+        auto it = rows.find(key);
+        rows_out->push_back(it == rows.end() ? ql::datum_t::null() : it->second);
+    }
+    return true;
+}
+
 counted_t<ql::datum_stream_t> real_table_t::read_all(
         ql::env_t *env,
         const std::string &sindex,
@@ -112,11 +146,12 @@ counted_t<ql::datum_stream_t> real_table_t::read_changes(
     ql::env_t *env,
     const ql::datum_t &squash,
     bool include_states,
+    const ql::changefeed::resume_t &resume,
     ql::changefeed::keyspec_t::spec_t &&spec,
     const ql::protob_t<const Backtrace> &bt,
     const std::string &table_name) {
     return changefeed_client->new_stream(
-        env, squash, include_states, uuid, bt, table_name, std::move(spec));
+        env, squash, include_states, resume, uuid, bt, table_name, std::move(spec));
 }
 
 counted_t<ql::datum_stream_t> real_table_t::read_intersecting(
@@ -156,7 +191,7 @@ ql::datum_t real_table_t::read_nearest(
     read_response_t res;
     try {
         if (use_outdated) {
-            namespace_access.get()->read_outdated(read, &res, env->interruptor);
+            read_outdated(env, read, &res);
         } else {
             namespace_access.get()->read(
                 read, &res, order_token_t::ignore, env->interruptor);
@@ -194,6 +229,23 @@ ql::datum_t real_table_t::read_nearest(
     return std::move(formatted_result).to_datum();
 }
 
+bool real_table_t::read_sample(
+        ql::env_t *env,
+        uint64_t num,
+        bool use_outdated,
+        std::vector<ql::datum_t> *rows_out) {
+    read_t read(sample_read_t(num), env->profile());
+    read_response_t res;
+    read_with_profile(env, read, &res, use_outdated);
+    sample_read_response_t *s_res = boost::get<sample_read_response_t>(&res.response);
+    r_sanity_check(s_res);
+    rows_out->reserve(s_res->rows.size());
+    for (auto &row : s_res->rows) {
+        rows_out->push_back(std::move(row.second));
+    }
+    return true;
+}
+
 const size_t split_size = 128;
 template<class T>
 std::vector<std::vector<T> > split(std::vector<T> &&v) {
@@ -292,11 +344,19 @@ bool real_table_t::write_sync_depending_on_durability(ql::env_t *env,
     return true; // With our current implementation, a sync can never fail.
 }
 
+void real_table_t::set_read_after(const write_versions_t &versions) {
+    read_after_versions = versions;
+}
+
+write_versions_t real_table_t::get_write_versions() const {
+    return written_versions;
+}
+
 bool real_table_t::sindex_create(ql::env_t *env, const std::string &id,
         counted_t<const ql::func_t> index_func, sindex_multi_bool_t multi,
-        sindex_geo_bool_t geo) {
+        sindex_geo_bool_t geo, sindex_values_bool_t values) {
     ql::map_wire_func_t wire_func(index_func);
-    write_t write(sindex_create_t(id, wire_func, multi, geo), env->profile(),
+    write_t write(sindex_create_t(id, wire_func, multi, geo, values), env->profile(),
                   env->limits());
     write_response_t res;
     write_with_profile(env, &write, &res);
@@ -370,7 +430,9 @@ real_table_t::sindex_status(ql::env_t *env, const std::set<std::string> &sindexe
         status[datum_string_t("multi")] =
             ql::datum_t::boolean(pair.second.multi == sindex_multi_bool_t::MULTI);
         status[datum_string_t("geo")] =
-            ql::datum_t::boolean(pair.second.geo == sindex_geo_bool_t::GEO);
+            ql::datum_t::boolean(pair.second.geo != sindex_geo_bool_t::REGULAR);
+        status[datum_string_t("points_only")] = ql::datum_t::boolean(
+            pair.second.geo == sindex_geo_bool_t::GEO_POINTS);
         statuses.insert(std::make_pair(
             pair.first,
             ql::datum_t(std::move(status))));
@@ -390,16 +452,33 @@ void real_table_t::read_with_profile(ql::env_t *env, const read_t &read,
     /* Do the actual read. */
     try {
         if (!outdated) {
+            if (env->table_affinity != NULL) {
+                env->table_affinity->note_table_access(
+                    namespace_access.get()->get_local_primary_thread());
+            }
             namespace_access.get()->read(read, response, order_token_t::ignore,
                 env->interruptor);
         } else {
-            namespace_access.get()->read_outdated(read, response, env->interruptor);
+            read_outdated(env, read, response);
         }
     } catch (const cannot_perform_query_exc_t &e) {
         rfail_datum(ql::base_exc_t::GENERIC, "Cannot perform read: %s", e.what());
     }
     /* Append the results of the profile to the current task */
     splitter.give_splits(response->n_shards, response->event_log);
+    if (env->usage != NULL) {
+        env->usage->add(response->usage);
+    }
+}
+
+void real_table_t::read_outdated(ql::env_t *env, const read_t &read,
+        read_response_t *response) {
+    if (read_after_versions.empty()) {
+        namespace_access.get()->read_outdated(read, response, env->interruptor);
+    } else {
+        namespace_access.get()->read_after(
+            read, read_after_versions, response, env->interruptor);
+    }
 }
 
 void real_table_t::write_with_profile(ql::env_t *env, write_t *write,
@@ -410,12 +489,20 @@ void real_table_t::write_with_profile(ql::env_t *env, write_t *write,
     write->profile = env->profile();
     /* Do the actual write. */
     try {
+        if (env->table_affinity != NULL) {
+            env->table_affinity->note_table_access(
+                namespace_access.get()->get_local_primary_thread());
+        }
         namespace_access.get()->write(*write, response, order_token_t::ignore,
             env->interruptor);
     } catch (const cannot_perform_query_exc_t &e) {
         rfail_datum(ql::base_exc_t::GENERIC, "Cannot perform write: %s", e.what());
     }
+    merge_write_versions(response->versions, &written_versions);
     /* Append the results of the profile to the current task */
     splitter.give_splits(response->n_shards, response->event_log);
+    if (env->usage != NULL) {
+        env->usage->add(response->usage);
+    }
 }
 
@@ -68,6 +68,9 @@ public:
 
     ql::datum_t read_row(ql::env_t *env,
         ql::datum_t pval, bool use_outdated);
+    bool read_rows(ql::env_t *env,
+        const std::vector<ql::datum_t> &pvals, bool use_outdated,
+        std::vector<ql::datum_t> *rows_out);
     counted_t<ql::datum_stream_t> read_all(
         ql::env_t *env,
         const std::string &sindex,
@@ -80,6 +83,7 @@ public:
         ql::env_t *env,
         const ql::datum_t &squash,
         bool include_states,
+        const ql::changefeed::resume_t &resume,
         ql::changefeed::keyspec_t::spec_t &&spec,
         const ql::protob_t<const Backtrace> &bt,
         const std::string &table_name);
@@ -101,6 +105,11 @@ public:
         const ellipsoid_spec_t &geo_system,
         dist_unit_t dist_unit,
         const ql::configured_limits_t &limits);
+    bool read_sample(
+        ql::env_t *env,
+        uint64_t num,
+        bool use_outdated,
+        std::vector<ql::datum_t> *rows_out);
 
     ql::datum_t write_batched_replace(ql::env_t *env,
         const std::vector<ql::datum_t> &keys,
@@ -114,11 +123,15 @@ public:
     bool write_sync_depending_on_durability(ql::env_t *env,
         durability_requirement_t durability);
 
+    void set_read_after(const write_versions_t &versions);
+    write_versions_t get_write_versions() const;
+
     bool sindex_create(ql::env_t *env,
         const std::string &id,
         counted_t<const ql::func_t> index_func,
         sindex_multi_bool_t multi,
-        sindex_geo_bool_t geo);
+        sindex_geo_bool_t geo,
+        sindex_values_bool_t values);
     bool sindex_drop(ql::env_t *env,
         const std::string &id);
     sindex_rename_result_t sindex_rename(ql::env_t *env,
@@ -144,10 +157,14 @@ public:
     void write_with_profile(ql::env_t *env, write_t *, write_response_t *response);
 
 private:
+    void read_outdated(ql::env_t *env, const read_t &read, read_response_t *response);
+
     namespace_id_t uuid;
     namespace_interface_access_t namespace_access;
     std::string pkey;
     ql::changefeed::client_t *changefeed_client;
+    write_versions_t read_after_versions;
+    write_versions_t written_versions;
 };
 
 #endif /* RDB_PROTOCOL_REAL_TABLE_HPP_ */
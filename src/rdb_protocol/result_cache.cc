@@ -0,0 +1,486 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/result_cache.hpp"
+
+#include <limits>
+
+#include "arch/runtime/coroutines.hpp"
+#include "concurrency/interruptor.hpp"
+#include "concurrency/wait_any.hpp"
+#include "containers/name_string.hpp"
+#include "rdb_protocol/changefeed.hpp"
+#include "rdb_protocol/context.hpp"
+#include "rdb_protocol/counted_term.hpp"
+#include "rdb_protocol/datum_stream.hpp"
+#include "rdb_protocol/env.hpp"
+
+namespace ql {
+
+// How many bytes of responses all threads' caches may hold together by default.
+static const uint64_t DEFAULT_RESULT_CACHE_SIZE = 64 * MEGABYTE;
+
+// Each thread keeps at most this many changefeeds open for its cache.
+static const size_t MAX_WATCHED_TABLES = 64;
+
+static uint64_t result_cache_size = DEFAULT_RESULT_CACHE_SIZE;
+
+void set_query_result_cache_size(uint64_t bytes) {
+    result_cache_size = bytes;
+}
+
+class result_cache_t::watcher_t {
+public:
+    watcher_t() : generation(0), failed(false) { }
+
+    // Bumped whenever the table changes.
+    uint64_t generation;
+    // Pulsed once the changefeed is open, or failed to open.
+    cond_t ready;
+    // Set if the changefeed failed to open or broke later (for example because the
+    // table was dropped), so that we can't tell when the table changes anymore.
+    bool failed;
+    // The keys of the cached responses that depend on the table.
+    std::set<std::string> keys;
+
+    auto_drainer_t drainer;
+
+private:
+    DISABLE_COPYING(watcher_t);
+};
+
+result_cache_t::result_cache_t(rdb_context_t *_rdb_ctx)
+    : rdb_ctx(_rdb_ctx),
+      max_bytes(result_cache_size / get_num_threads()),
+      bytes(0),
+      // Entries are evicted when they take up too many bytes, not by count.
+      entries(std::numeric_limits<size_t>::max()) { }
+
+result_cache_t::~result_cache_t() { }
+
+static bool wants_result_cache(const Query &query) {
+    for (int i = 0; i < query.global_optargs_size(); ++i) {
+        const Query::AssocPair &optarg = query.global_optargs(i);
+        if (optarg.key() == "result_cache") {
+            return optarg.val().type() == Term::DATUM
+                && optarg.val().datum().type() == Datum::R_BOOL
+                && optarg.val().datum().r_bool();
+        }
+    }
+    return false;
+}
+
+static bool get_string(const Term &t, std::string *out) {
+    if (t.type() != Term::DATUM || t.args_size() != 0 || t.optargs_size() != 0
+        || t.datum().type() != Datum::R_STR) {
+        return false;
+    }
+    *out = t.datum().r_str();
+    return true;
+}
+
+static bool get_db_name(const Term &t, std::string *out) {
+    return t.type() == Term::DB && t.args_size() == 1 && t.optargs_size() == 0
+        && get_string(t.args(0), out);
+}
+
+static bool get_term_tables(const Term &t,
+                            const std::string &default_db,
+                            std::set<std::pair<std::string, std::string> > *tables_out) {
+    switch (t.type()) {
+    // Terms whose result can change even if no table does.
+    case Term::JAVASCRIPT: // fallthru
+    case Term::HTTP: // fallthru
+    case Term::NOW: // fallthru
+    case Term::RANDOM: // fallthru
+    case Term::SAMPLE: // fallthru
+    case Term::CHANGES: // fallthru
+    // Writes.
+    case Term::INSERT: // fallthru
+    case Term::UPDATE: // fallthru
+    case Term::DELETE: // fallthru
+    case Term::REPLACE: // fallthru
+    case Term::FOR_EACH: // fallthru
+    case Term::SYNC: // fallthru
+    case Term::DB_CREATE: // fallthru
+    case Term::DB_DROP: // fallthru
+    case Term::TABLE_CREATE: // fallthru
+    case Term::TABLE_DROP: // fallthru
+    case Term::INDEX_CREATE: // fallthru
+    case Term::INDEX_DROP: // fallthru
+    case Term::INDEX_RENAME: // fallthru
+    case Term::INDEX_WAIT: // fallthru
+    case Term::WAIT: // fallthru
+    case Term::RECONFIGURE: // fallthru
+    case Term::REBALANCE: // fallthru
+    // Metadata, which changefeeds don't tell us about.
+    case Term::DB_LIST: // fallthru
+    case Term::TABLE_LIST: // fallthru
+    case Term::INDEX_LIST: // fallthru
+    case Term::INDEX_STATUS: // fallthru
+    case Term::CONFIG: // fallthru
+    case Term::STATUS: // fallthru
+    case Term::INFO:
+        return false;
+    case Term::UUID:
+        // `r.uuid(str)` is deterministic, `r.uuid()` isn't.
+        if (t.args_size() == 0) {
+            return false;
+        }
+        break;
+    case Term::TABLE: {
+        std::string db = default_db;
+        std::string table;
+        if (t.args_size() == 1) {
+            if (!get_string(t.args(0), &table)) {
+                return false;
+            }
+        } else if (t.args_size() != 2
+                   || !get_db_name(t.args(0), &db)
+                   || !get_string(t.args(1), &table)) {
+            return false;
+        }
+        // The system tables change all the time.
+        if (db == "rethinkdb") {
+            return false;
+        }
+        tables_out->insert(std::make_pair(db, table));
+    } break;
+    default:
+        break;
+    }
+    for (int i = 0; i < t.args_size(); ++i) {
+        if (!get_term_tables(t.args(i), default_db, tables_out)) {
+            return false;
+        }
+    }
+    for (int i = 0; i < t.optargs_size(); ++i) {
+        if (!get_term_tables(t.optargs(i).val(), default_db, tables_out)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Finds the tables that `t` names, and whether it writes to any of them.  Sets
+`*unknown_out` if it names a table or database that isn't a literal. */
+static void get_written_tables(const Term &t,
+                               const std::string &default_db,
+                               bool *writes_out,
+                               bool *unknown_out,
+                               std::set<std::pair<std::string, std::string> > *tables_out) {
+    switch (t.type()) {
+    case Term::INSERT: // fallthru
+    case Term::UPDATE: // fallthru
+    case Term::DELETE: // fallthru
+    case Term::REPLACE: // fallthru
+    case Term::TABLE_DROP:
+        *writes_out = true;
+        break;
+    case Term::DB_DROP:
+        // We don't know which tables were in the database.
+        *writes_out = true;
+        *unknown_out = true;
+        break;
+    case Term::TABLE: {
+        std::string db = default_db;
+        std::string table;
+        if (t.args_size() == 1 && get_string(t.args(0), &table)) {
+            tables_out->insert(std::make_pair(db, table));
+        } else if (t.args_size() == 2
+                   && get_db_name(t.args(0), &db)
+                   && get_string(t.args(1), &table)) {
+            tables_out->insert(std::make_pair(db, table));
+        } else {
+            *unknown_out = true;
+        }
+    } break;
+    default:
+        break;
+    }
+    for (int i = 0; i < t.args_size(); ++i) {
+        get_written_tables(t.args(i), default_db, writes_out, unknown_out, tables_out);
+    }
+    for (int i = 0; i < t.optargs_size(); ++i) {
+        get_written_tables(t.optargs(i).val(), default_db, writes_out, unknown_out,
+                           tables_out);
+    }
+}
+
+bool result_cache_t::get_tables(const Query &query, std::set<table_key_t> *tables_out) {
+    std::string default_db = "test";
+    for (int i = 0; i < query.global_optargs_size(); ++i) {
+        const Query::AssocPair &optarg = query.global_optargs(i);
+        if (optarg.key() == "db") {
+            if (!get_db_name(optarg.val(), &default_db)) {
+                return false;
+            }
+        } else if (!get_term_tables(optarg.val(), default_db, tables_out)) {
+            return false;
+        }
+    }
+    return query.has_query()
+        && get_term_tables(query.query(), default_db, tables_out);
+}
+
+void result_cache_t::drop_written_tables(const Query &query) {
+    std::string default_db = "test";
+    bool writes = false;
+    bool unknown = false;
+    std::set<table_key_t> tables;
+    for (int i = 0; i < query.global_optargs_size(); ++i) {
+        const Query::AssocPair &optarg = query.global_optargs(i);
+        if (optarg.key() == "db") {
+            if (!get_db_name(optarg.val(), &default_db)) {
+                unknown = true;
+            }
+        } else {
+            get_written_tables(optarg.val(), default_db, &writes, &unknown, &tables);
+        }
+    }
+    if (query.has_query()) {
+        get_written_tables(query.query(), default_db, &writes, &unknown, &tables);
+    }
+    if (!writes) {
+        return;
+    }
+    // Bumping the generation also keeps reads that are still running from filling
+    // the cache with what they read before the write.
+    for (auto it = watchers.begin(); it != watchers.end(); ++it) {
+        if (unknown || tables.count(it->first) != 0) {
+            ++it->second->generation;
+            invalidate(it->second.get());
+        }
+    }
+}
+
+void result_cache_t::run_query(const protob_t<Query> &query,
+                               Response *response_out,
+                               signal_t *interruptor,
+                               const std::function<void()> &run) {
+    assert_thread();
+    if (max_bytes == 0 || query->type() != Query::START) {
+        run();
+        return;
+    }
+    if (!wants_result_cache(*query)) {
+        run();
+        drop_written_tables(*query);
+        return;
+    }
+
+    Query key_query(*query);
+    key_query.clear_token();
+    std::string key = key_query.SerializeAsString();
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        ++rdb_ctx->stats.result_cache_hits;
+        response_out->CopyFrom(it->second->response);
+        return;
+    }
+    ++rdb_ctx->stats.result_cache_misses;
+
+    std::set<table_key_t> tables;
+    if (!get_tables(*query, &tables)) {
+        run();
+        drop_written_tables(*query);
+        return;
+    }
+
+    // The changefeeds have to be open before the query reads the tables.  If a table
+    // changes while the query runs, we can't tell whether the response has the
+    // change, so we don't keep it.
+    std::vector<std::pair<watcher_t *, uint64_t> > generations;
+    std::vector<auto_drainer_t::lock_t> watcher_locks;
+    for (const table_key_t &table : tables) {
+        auto_drainer_t::lock_t lock;
+        watcher_t *watcher = get_watcher(table, interruptor, &lock);
+        if (watcher == NULL) {
+            run();
+            return;
+        }
+        generations.push_back(std::make_pair(watcher, watcher->generation));
+        watcher_locks.push_back(std::move(lock));
+    }
+
+    run();
+
+    if (response_out->type() != Response::SUCCESS_ATOM || response_out->has_profile()) {
+        return;
+    }
+    size_t i = 0;
+    for (const table_key_t &table : tables) {
+        // The watcher may have been replaced or dropped while the query ran.
+        auto jt = watchers.find(table);
+        if (jt == watchers.end()
+            || jt->second.get() != generations[i].first
+            || generations[i].first->failed
+            || generations[i].first->generation != generations[i].second) {
+            return;
+        }
+        ++i;
+    }
+    std::shared_ptr<entry_t> entry = std::make_shared<entry_t>();
+    entry->response = *response_out;
+    entry->tables.assign(tables.begin(), tables.end());
+    entry->bytes = key.size() + entry->response.ByteSize();
+    if (entry->bytes > max_bytes) {
+        return;
+    }
+    insert(std::move(key), std::move(entry));
+}
+
+result_cache_t::watcher_t *result_cache_t::get_watcher(
+        const table_key_t &table,
+        signal_t *interruptor,
+        auto_drainer_t::lock_t *lock_out) {
+    auto it = watchers.find(table);
+    if (it != watchers.end() && it->second->failed) {
+        // Try again, in case the table came back.
+        coro_t::spawn_sometime(std::bind(&result_cache_t::destroy_watcher,
+                                         it->second.release(),
+                                         auto_drainer_t::lock_t(&drainer)));
+        watchers.erase(it);
+        it = watchers.end();
+    }
+    if (it == watchers.end()) {
+        if (watchers.size() >= MAX_WATCHED_TABLES) {
+            drop_unused_watchers();
+            if (watchers.size() >= MAX_WATCHED_TABLES) {
+                return NULL;
+            }
+        }
+        it = watchers.insert(
+            std::make_pair(table, scoped_ptr_t<watcher_t>(new watcher_t()))).first;
+        coro_t::spawn_sometime(std::bind(&result_cache_t::watch, this,
+                                         it->second.get(), table,
+                                         auto_drainer_t::lock_t(
+                                             &it->second->drainer)));
+    }
+
+    watcher_t *watcher = it->second.get();
+    *lock_out = auto_drainer_t::lock_t(&watcher->drainer);
+    wait_any_t waiter(&watcher->ready, lock_out->get_drain_signal());
+    wait_interruptible(&waiter, interruptor);
+    if (lock_out->get_drain_signal()->is_pulsed() || watcher->failed) {
+        return NULL;
+    }
+    return watcher;
+}
+
+void result_cache_t::watch(watcher_t *watcher,
+                           table_key_t table,
+                           auto_drainer_t::lock_t keepalive) {
+    signal_t *interruptor = keepalive.get_drain_signal();
+    try {
+        env_t env(rdb_ctx,
+                  return_empty_normal_batches_t::NO,
+                  interruptor,
+                  std::map<std::string, wire_func_t>(),
+                  nullptr,
+                  nullptr);
+
+        name_string_t db_name, table_name;
+        counted_t<const db_t> db;
+        counted_t<base_table_t> tbl;
+        std::string error;
+        if (db_name.assign_value(table.first)
+            && table_name.assign_value(table.second)
+            && rdb_ctx->cluster_interface->db_find(db_name, interruptor, &db, &error)
+            && rdb_ctx->cluster_interface->table_find(
+                table_name, db, boost::none, interruptor, &tbl, &error)) {
+            counted_t<datum_stream_t> feed = tbl->read_changes(
+                &env,
+                datum_t::boolean(false),
+                false,
+                changefeed::resume_t(),
+                changefeed::keyspec_t::range_t{
+                    std::vector<transform_variant_t>(),
+                    boost::none,
+                    sorting_t::UNORDERED,
+                    datum_range_t::universe()},
+                make_counted_backtrace(),
+                table.second);
+            watcher->ready.pulse();
+
+            for (;;) {
+                std::vector<datum_t> changes = feed->next_batch(
+                    &env, batchspec_t::user(batch_type_t::NORMAL, &env));
+                if (!changes.empty()) {
+                    ++watcher->generation;
+                    invalidate(watcher);
+                }
+            }
+        }
+    } catch (const interrupted_exc_t &) {
+        // The watcher is being destroyed.
+        return;
+    } catch (const base_exc_t &) {
+    }
+
+    watcher->failed = true;
+    ++watcher->generation;
+    if (!watcher->ready.is_pulsed()) {
+        watcher->ready.pulse();
+    }
+    invalidate(watcher);
+}
+
+void result_cache_t::invalidate(watcher_t *watcher) {
+    std::set<std::string> keys;
+    keys.swap(watcher->keys);
+    for (const std::string &key : keys) {
+        erase(key);
+    }
+}
+
+void result_cache_t::insert(std::string &&key, std::shared_ptr<const entry_t> &&entry) {
+    // Another run of the same query may have filled the cache while ours ran.
+    erase(key);
+    while (bytes + entry->bytes > max_bytes) {
+        guarantee(!entries.empty());
+        std::string oldest = entries.rbegin()->first;
+        erase(oldest);
+    }
+    for (const table_key_t &table : entry->tables) {
+        auto it = watchers.find(table);
+        guarantee(it != watchers.end());
+        it->second->keys.insert(key);
+    }
+    bytes += entry->bytes;
+    entries[std::move(key)] = std::move(entry);
+}
+
+void result_cache_t::erase(const std::string &key) {
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        return;
+    }
+    std::shared_ptr<const entry_t> entry = it->second;
+    for (const table_key_t &table : entry->tables) {
+        auto jt = watchers.find(table);
+        if (jt != watchers.end()) {
+            jt->second->keys.erase(key);
+        }
+    }
+    bytes -= entry->bytes;
+    entries.erase(key);
+}
+
+void result_cache_t::drop_unused_watchers() {
+    for (auto it = watchers.begin(); it != watchers.end();) {
+        if (it->second->keys.empty()) {
+            coro_t::spawn_sometime(std::bind(&result_cache_t::destroy_watcher,
+                                             it->second.release(),
+                                             auto_drainer_t::lock_t(&drainer)));
+            watchers.erase(it++);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void result_cache_t::destroy_watcher(watcher_t *watcher, auto_drainer_t::lock_t) {
+    // This waits for `watch()` and anyone waiting for the feed to open.
+    delete watcher;
+}
+
+}  // namespace ql
@@ -0,0 +1,119 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_RESULT_CACHE_HPP_
+#define RDB_PROTOCOL_RESULT_CACHE_HPP_
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "concurrency/auto_drainer.hpp"
+#include "concurrency/cond_var.hpp"
+#include "containers/lru_cache.hpp"
+#include "containers/scoped.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "threading.hpp"
+
+class rdb_context_t;
+class signal_t;
+
+namespace ql {
+
+template <class> class protob_t;
+
+/* Sets how many bytes of responses the result caches on all threads may hold
+together.  Must be called before the thread pool starts, if at all. */
+void set_query_result_cache_size(uint64_t bytes);
+
+/* `result_cache_t` answers read-only queries that are run with `result_cache=true`
+from the response to an earlier run of the same query on the same thread, without
+evaluating them again.
+
+Queries are identified by everything in the `Query` except the token: the term, the
+global optargs and the response format.  Client queries always use the latest ReQL
+version, so that doesn't have to be part of the key.  Only queries whose result can
+only change when the tables that they name change are cached, which rules out
+writes, `r.now()`, `r.random()`, JavaScript and so on, and only if they return a
+single `SUCCESS_ATOM` response.
+
+A cached response is dropped as soon as anything in one of its tables changes.  For
+each table that has cached responses, the cache keeps a changefeed open that tells
+it about changes, so the responses can lag the tables only by as long as it takes
+changefeed messages to arrive.  The feed is opened before the query that fills the
+cache reads the table, so a change can't slip in between.  Writes that run on the
+same thread (and so every write on the same connection) drop the responses for the
+tables they name as soon as they're done, so a connection always reads its own
+acknowledged writes.  Writes from other connections may only show up once the
+changefeed has reported them, which is why the cache is opt-in. */
+class result_cache_t : public home_thread_mixin_t {
+public:
+    explicit result_cache_t(rdb_context_t *_rdb_ctx);
+    ~result_cache_t();
+
+    /* Fills `response_out` from the cache or calls `run()` to run `query`, and
+    keeps the response if it can. */
+    void run_query(const protob_t<Query> &query,
+                   Response *response_out,
+                   signal_t *interruptor,
+                   const std::function<void()> &run);
+
+private:
+    // A table by database and table name.
+    typedef std::pair<std::string, std::string> table_key_t;
+
+    class watcher_t;
+
+    struct entry_t {
+        Response response;
+        std::vector<table_key_t> tables;
+        size_t bytes;
+    };
+
+    // Returns false if `query` isn't something we can cache.
+    static bool get_tables(const Query &query, std::set<table_key_t> *tables_out);
+
+    /* Makes sure that `table` has a watcher whose changefeed is open, and returns it
+    with a lock that keeps it alive.  Returns NULL if the feed couldn't be opened, or if
+    we're already watching too many tables. */
+    watcher_t *get_watcher(const table_key_t &table,
+                           signal_t *interruptor,
+                           auto_drainer_t::lock_t *lock_out);
+
+    void watch(watcher_t *watcher,
+               table_key_t table,
+               auto_drainer_t::lock_t keepalive);
+
+    // Drops the cached responses that depend on `watcher`'s table.
+    void invalidate(watcher_t *watcher);
+
+    /* Drops the cached responses that depend on the tables that `query` writes to,
+    once it has run, so that the connection that ran it sees its own writes. */
+    void drop_written_tables(const Query &query);
+
+    void insert(std::string &&key, std::shared_ptr<const entry_t> &&entry);
+    void erase(const std::string &key);
+
+    // Stops the watchers that no cached response depends on.
+    void drop_unused_watchers();
+    static void destroy_watcher(watcher_t *watcher, auto_drainer_t::lock_t keepalive);
+
+    rdb_context_t *const rdb_ctx;
+    const size_t max_bytes;
+
+    size_t bytes;
+    lru_cache_t<std::string, std::shared_ptr<const entry_t> > entries;
+    std::map<table_key_t, scoped_ptr_t<watcher_t> > watchers;
+
+    auto_drainer_t drainer;
+
+    DISABLE_COPYING(result_cache_t);
+};
+
+}  // namespace ql
+
+#endif  // RDB_PROTOCOL_RESULT_CACHE_HPP_
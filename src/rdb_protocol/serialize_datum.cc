@@ -1,6 +1,9 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/serialize_datum.hpp"
 
+#include <string.h>
+
+#include <algorithm>
 #include <cmath>
 #include <limits>
 #include <string>
@@ -578,6 +581,7 @@ serialization_result_t datum_serialize(
     size_tree_node_t size;
     size.size = datum_serialized_size(datum, check_errors, &size.child_sizes);
 
+    wm->reserve(size.size);
     return datum_serialize(wm, datum, check_errors, size);
 }
 
@@ -704,6 +708,11 @@ archive_result_t datum_deserialize(read_stream_t *s, datum_t *datum) {
     case datum_serialized_type_t::BUF_R_ARRAY: // fallthru
     case datum_serialized_type_t::BUF_R_OBJECT:
     {
+        // If the stream is already a shared buffer, the datum can just point into it.
+        shared_buf_read_stream_t *shared_stream =
+            dynamic_cast<shared_buf_read_stream_t *>(s);
+        const int64_t start = shared_stream != NULL ? shared_stream->tell() : 0;
+
         // First read the serialized size of the buffer
         uint64_t ser_size;
         res = deserialize_varint_uint64(s, &ser_size);
@@ -717,7 +726,23 @@ archive_result_t datum_deserialize(read_stream_t *s, datum_t *datum) {
             return archive_result_t::RANGE_ERROR;
         }
 
-        // Then read the data into a shared_buf_t
+        datum_t::type_t dtype = type == datum_serialized_type_t::BUF_R_ARRAY
+                                ? datum_t::R_ARRAY
+                                : datum_t::R_OBJECT;
+
+        if (shared_stream != NULL) {
+            if (!shared_stream->skip(ser_size)) {
+                return archive_result_t::SOCK_EOF;
+            }
+            try {
+                *datum = datum_t(dtype, shared_stream->ref_at(start));
+            } catch (const base_exc_t &) {
+                return archive_result_t::RANGE_ERROR;
+            }
+            break;
+        }
+
+        // Otherwise read the data into a shared_buf_t
         counted_t<shared_buf_t> buf = shared_buf_t::create(static_cast<size_t>(ser_size) + ser_size_sz);
         serialize_varint_uint64_into_buf(ser_size, reinterpret_cast<uint8_t *>(buf->data()));
         int64_t num_read = force_read(s, buf->data() + ser_size_sz, ser_size);
@@ -729,9 +754,6 @@ archive_result_t datum_deserialize(read_stream_t *s, datum_t *datum) {
         }
 
         // ...from which we create the datum_t
-        datum_t::type_t dtype = type == datum_serialized_type_t::BUF_R_ARRAY
-                                ? datum_t::R_ARRAY
-                                : datum_t::R_OBJECT;
         try {
             *datum = datum_t(dtype, shared_buf_ref_t<char>(std::move(buf), 0));
         } catch (const base_exc_t &) {
@@ -836,27 +858,43 @@ size_t datum_get_array_size(const shared_buf_ref_t<char> &array) {
     return static_cast<size_t>(num_elements);
 }
 
+// The decoded header of a serialized array or object, as needed for looking up
+// element offsets.
+struct offset_table_header_t {
+    datum_offset_size_t offset_size;
+    size_t serialized_offset_size;
+    size_t num_elements;
+    // Where the offsets table starts, relative to the beginning of the array.
+    size_t offsets_offset;
+    // Where the first element starts, relative to the beginning of the array.
+    size_t data_offset;
+};
+
 /* The format of `array` is:
      varint ser_size
      varint num_elements
      uint*_t offsets[num_elements - 1] // counted from `data`, first element omitted
      T data[num_elements] */
-size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t index) {
+offset_table_header_t read_offset_table_header(const shared_buf_ref_t<char> &array) {
     buffer_read_stream_t sz_read_stream(array.get(), array.get_safety_boundary());
     uint64_t ser_size = 0;
     guarantee_deserialization(deserialize_varint_uint64(&sz_read_stream, &ser_size),
                               "datum decode array");
-    const datum_offset_size_t offset_size = get_offset_size_from_inner_size(ser_size);
-    size_t serialized_offset_size;
-    switch (offset_size) {
+    offset_table_header_t header;
+    header.offset_size = get_offset_size_from_inner_size(ser_size);
+    switch (header.offset_size) {
     case datum_offset_size_t::U8BIT:
-        serialized_offset_size = serialize_universal_size_t<uint8_t>::value; break;
+        header.serialized_offset_size = serialize_universal_size_t<uint8_t>::value;
+        break;
     case datum_offset_size_t::U16BIT:
-        serialized_offset_size = serialize_universal_size_t<uint16_t>::value; break;
+        header.serialized_offset_size = serialize_universal_size_t<uint16_t>::value;
+        break;
     case datum_offset_size_t::U32BIT:
-        serialized_offset_size = serialize_universal_size_t<uint32_t>::value; break;
+        header.serialized_offset_size = serialize_universal_size_t<uint32_t>::value;
+        break;
     case datum_offset_size_t::U64BIT:
-        serialized_offset_size = serialize_universal_size_t<uint64_t>::value; break;
+        header.serialized_offset_size = serialize_universal_size_t<uint64_t>::value;
+        break;
     default:
         unreachable();
     }
@@ -865,21 +903,26 @@ size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t inde
     guarantee_deserialization(deserialize_varint_uint64(&sz_read_stream, &num_elements),
                               "datum decode array");
     guarantee(num_elements <= std::numeric_limits<size_t>::max());
-    const size_t sz = static_cast<size_t>(num_elements);
-
-    guarantee(index < sz);
+    header.num_elements = static_cast<size_t>(num_elements);
+
+    header.offsets_offset = static_cast<size_t>(sz_read_stream.tell());
+    header.data_offset = header.num_elements == 0
+        ? header.offsets_offset
+        : header.offsets_offset
+          + (header.num_elements - 1) * header.serialized_offset_size;
+    return header;
+}
 
-    rassert(sz > 0);
-    const size_t data_offset =
-        static_cast<size_t>(sz_read_stream.tell())
-        + (num_elements - 1) * serialized_offset_size;
+size_t get_element_offset_from_header(const shared_buf_ref_t<char> &array,
+                                      const offset_table_header_t &header,
+                                      size_t index) {
+    guarantee(index < header.num_elements);
 
     if (index == 0) {
-        return data_offset;
+        return header.data_offset;
     } else {
         const size_t element_offset_offset =
-            static_cast<size_t>(sz_read_stream.tell())
-            + (index - 1) * serialized_offset_size;
+            header.offsets_offset + (index - 1) * header.serialized_offset_size;
 
         array.guarantee_in_boundary(element_offset_offset);
         buffer_read_stream_t read_stream(
@@ -887,7 +930,7 @@ size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t inde
             array.get_safety_boundary() - element_offset_offset);
 
         uint64_t element_offset;
-        switch (offset_size) {
+        switch (header.offset_size) {
         case datum_offset_size_t::U8BIT: {
             uint8_t off;
             guarantee_deserialization(deserialize_universal(&read_stream, &off),
@@ -912,12 +955,63 @@ size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t inde
                                       "datum decode array offset");
             element_offset = off;
         } break;
+        default:
+            unreachable();
         }
         guarantee(element_offset <= std::numeric_limits<size_t>::max(),
                   "Datum too large for this architecture.");
 
-        return data_offset + static_cast<size_t>(element_offset);
+        return header.data_offset + static_cast<size_t>(element_offset);
+    }
+}
+
+size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t index) {
+    return get_element_offset_from_header(array, read_offset_table_header(array), index);
+}
+
+datum_t datum_get_field_from_buf(const shared_buf_ref_t<char> &object,
+                                 const datum_string_t &key) {
+    const offset_table_header_t header = read_offset_table_header(object);
+    const size_t key_size = key.size();
+    const char *const key_data = key.data();
+
+    // The pairs are sorted by key, so we can binary search the offsets table.
+    size_t range_beg = 0;
+    size_t range_end = header.num_elements;
+    while (range_beg < range_end) {
+        const size_t center = range_beg + ((range_end - range_beg) / 2);
+        const size_t pair_offset =
+            get_element_offset_from_header(object, header, center);
+
+        // Compare against the serialized key in place (see the
+        // `datum_string_t` serialization format below), so we don't have to
+        // construct any `datum_string_t` or `datum_t` for the keys we skip.
+        object.guarantee_in_boundary(pair_offset);
+        buffer_read_stream_t key_stream(object.get() + pair_offset,
+                                        object.get_safety_boundary() - pair_offset);
+        uint64_t center_size;
+        guarantee_deserialization(deserialize_varint_uint64(&key_stream, &center_size),
+                                  "datum decode object key");
+        const size_t center_data_offset =
+            pair_offset + static_cast<size_t>(key_stream.tell());
+        guarantee(center_size <= object.get_safety_boundary() - center_data_offset);
+        const char *center_data = object.get() + center_data_offset;
+
+        const size_t common_size = std::min<size_t>(key_size, center_size);
+        int cmp = memcmp(key_data, center_data, common_size);
+        if (cmp == 0) {
+            cmp = key_size < center_size ? -1 : (key_size > center_size ? 1 : 0);
+        }
+        if (cmp == 0) {
+            return datum_deserialize_from_buf(
+                object, center_data_offset + static_cast<size_t>(center_size));
+        } else if (cmp < 0) {
+            range_end = center;
+        } else {
+            range_beg = center + 1;
+        }
     }
+    return datum_t();
 }
 
 size_t datum_serialized_size(const datum_string_t &s) {
@@ -943,6 +1037,20 @@ MUST_USE archive_result_t datum_deserialize(
         return archive_result_t::RANGE_ERROR;
     }
 
+    if (sz <= datum_string_t::MAX_INLINE_DATUM_STRING_SIZE) {
+        // Short strings are stored inline, so don't allocate a buffer for them.
+        char chars[datum_string_t::MAX_INLINE_DATUM_STRING_SIZE];
+        int64_t num_read = force_read(s, chars, sz);
+        if (num_read == -1) {
+            return archive_result_t::SOCK_ERROR;
+        }
+        if (static_cast<uint64_t>(num_read) < sz) {
+            return archive_result_t::SOCK_EOF;
+        }
+        *out = datum_string_t(static_cast<size_t>(sz), chars);
+        return archive_result_t::SUCCESS;
+    }
+
     const size_t str_offset = varint_uint64_serialized_size(sz);
     counted_t<shared_buf_t> buf =
         shared_buf_t::create(str_offset + static_cast<size_t>(sz));
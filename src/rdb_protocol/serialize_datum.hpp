@@ -57,6 +57,10 @@ std::pair<datum_string_t, datum_t> datum_deserialize_pair_from_buf(
 size_t datum_get_element_offset(const shared_buf_ref_t<char> &array, size_t index);
 // Reads the number of elements in the array stored in the buffer
 size_t datum_get_array_size(const shared_buf_ref_t<char> &array);
+// Looks up `key` in the object stored in the buffer without deserializing any
+// other pairs.  Returns an empty `datum_t` if the object has no such key.
+datum_t datum_get_field_from_buf(const shared_buf_ref_t<char> &object,
+                                 const datum_string_t &key);
 
 size_t datum_serialized_size(const datum_string_t &s);
 serialization_result_t datum_serialize(write_message_t *wm, const datum_string_t &s);
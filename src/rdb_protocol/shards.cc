@@ -1,15 +1,18 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/shards.hpp"
 
+#include <algorithm>
 #include <utility>
 
 #include "errors.hpp"
 #include <boost/variant.hpp>
 
 #include "debug.hpp"
+#include "rdb_protocol/filter_predicate.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/profile.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/query_memory.hpp"
 
 bool reversed(sorting_t sorting) { return sorting == sorting_t::DESCENDING; }
 
@@ -69,15 +72,28 @@ private:
             auto pair = acc.insert(std::make_pair(it->first, default_val));
             auto t_it = pair.first;
             bool keep = !pair.second;
-            for (auto el = it->second.begin(); el != it->second.end(); ++el) {
-                keep |= accumulate(env, *el, &t_it->second, key, sindex_val);
-            }
+            keep |= accumulate_all(env, it->second, &t_it->second, key, sindex_val);
             if (!keep) {
                 acc.erase(t_it);
             }
         }
         return should_send_batch() ? done_traversing_t::YES : done_traversing_t::NO;
     }
+    // Accumulates a whole batch of elements belonging to one group.  The default
+    // implementation just calls `accumulate` on each element, but terminals can
+    // override it to process the batch at once.
+    virtual bool accumulate_all(env_t *env,
+                                const datums_t &els,
+                                T *t,
+                                const store_key_t &key,
+                                // sindex_val may be NULL
+                                const datum_t &sindex_val) {
+        bool keep = false;
+        for (auto el = els.begin(); el != els.end(); ++el) {
+            keep |= accumulate(env, *el, t, key, sindex_val);
+        }
+        return keep;
+    }
     virtual bool accumulate(env_t *env,
                             const datum_t &el,
                             T *t,
@@ -97,8 +113,8 @@ private:
                          const store_key_t &last_key,
                          const std::vector<result_t *> &results) {
         guarantee(acc.size() == 0);
-        std::map<datum_t, std::vector<T *>, optional_datum_less_t>
-            vecs(optional_datum_less_t(env->reql_version()));
+        std::unordered_map<datum_t, std::vector<T *>,
+                           optional_datum_hash_t, optional_datum_equal_t> vecs;
         for (auto res = results.begin(); res != results.end(); ++res) {
             guarantee(*res);
             grouped_t<T> *gres = boost::get<grouped_t<T> >(*res);
@@ -314,8 +330,7 @@ bool is_grouped_data(grouped_t<stream_t> *streams, const ql::datum_t &q) {
 // (Also, I'm sorry for this absurd type hierarchy.)
 class to_array_t : public eager_acc_t {
 public:
-    explicit to_array_t(reql_version_t reql_version)
-        : groups(optional_datum_less_t(reql_version)), size(0) { }
+    to_array_t() : size(0) { }
 private:
     virtual void operator()(env_t *env, groups_t *gs) {
         for (auto kv = gs->begin(); kv != gs->end(); ++kv) {
@@ -334,6 +349,9 @@ private:
                     strprintf("Array over size limit `%zu`.",
                               env->limits().array_size_limit()).c_str());
             }
+            for (const datum_t &d : *lst2) {
+                memory.add(env, d);
+            }
             lst1->reserve(lst1->size() + lst2->size());
             std::move(lst2->begin(), lst2->end(), std::back_inserter(*lst1));
         }
@@ -366,6 +384,7 @@ private:
             }
 
             for (auto it = stream->begin(); it != stream->end(); ++it) {
+                memory.add(env, it->data);
                 lst->push_back(std::move(it->data));
             }
         }
@@ -393,10 +412,11 @@ private:
 
     groups_t groups;
     size_t size;
+    query_memory_charge_t memory;
 };
 
-scoped_ptr_t<eager_acc_t> make_to_array(reql_version_t reql_version) {
-    return make_scoped<to_array_t>(reql_version);
+scoped_ptr_t<eager_acc_t> make_to_array() {
+    return make_scoped<to_array_t>();
 }
 
 template<class T>
@@ -411,9 +431,7 @@ private:
             auto pair = acc->insert(std::make_pair(it->first, *default_val));
             auto t_it = pair.first;
             bool keep = !pair.second;
-            for (auto el = it->second.begin(); el != it->second.end(); ++el) {
-                keep |= accumulate(env, *el, &t_it->second);
-            }
+            keep |= accumulate_all(env, it->second, &t_it->second);
             if (!keep) {
                 acc->erase(t_it);
             }
@@ -475,6 +493,13 @@ private:
         }
     }
 
+    virtual bool accumulate_all(env_t *env,
+                                const datums_t &els,
+                                T *t,
+                                const store_key_t &,
+                                const datum_t &) {
+        return accumulate_all(env, els, t);
+    }
     virtual bool accumulate(env_t *env,
                             const datum_t &el,
                             T *t,
@@ -482,9 +507,59 @@ private:
                             const datum_t &) {
         return accumulate(env, el, t);
     }
+protected:
+    virtual bool accumulate_all(env_t *env,
+                                const datums_t &els,
+                                T *t) {
+        bool keep = false;
+        for (auto el = els.begin(); el != els.end(); ++el) {
+            keep |= accumulate(env, *el, t);
+        }
+        return keep;
+    }
     virtual bool accumulate(env_t *env,
                             const datum_t &el,
                             T *t) = 0;
+private:
+    // Unlike `grouped_acc_t::unshard`, this doesn't build a parallel map of every
+    // group in every shard.  The largest shard's groups become the accumulator and
+    // the other shards are folded into it one at a time, each one being freed as
+    // soon as it has been merged.  This keeps the peak memory of a high-cardinality
+    // `group` close to the size of the final result.
+    virtual void unshard(env_t *env,
+                         const store_key_t &,
+                         const std::vector<result_t *> &results) {
+        grouped_t<T> *acc = grouped_acc_t<T>::get_acc();
+        const T *default_val = grouped_acc_t<T>::get_default_val();
+        guarantee(acc->size() == 0);
+        std::vector<grouped_t<T> *> shards;
+        shards.reserve(results.size());
+        for (auto res = results.begin(); res != results.end(); ++res) {
+            guarantee(*res);
+            grouped_t<T> *gres = boost::get<grouped_t<T> >(*res);
+            guarantee(gres);
+            shards.push_back(gres);
+        }
+        auto largest = std::max_element(
+            shards.begin(), shards.end(),
+            [](grouped_t<T> *l, grouped_t<T> *r) { return l->size() < r->size(); });
+        if (largest == shards.end()) {
+            return;
+        }
+        // The shards saw different rows, and `reduce` was never guaranteed any
+        // order between shards, so it doesn't matter which one we start with.
+        acc->swap(**largest);
+        for (auto gres = shards.begin(); gres != shards.end(); ++gres) {
+            // Order doesn't matter here because each `kv->first` is different and
+            // we're looking them up in `acc`.
+            for (auto kv = (*gres)->begin(grouped::order_doesnt_matter_t());
+                 kv != (*gres)->end(grouped::order_doesnt_matter_t()); ++kv) {
+                auto t_it = acc->insert(std::make_pair(kv->first, *default_val)).first;
+                unshard_impl(env, &t_it->second, &kv->second);
+            }
+            (*gres)->clear();
+        }
+    }
 
     virtual void unshard_impl(env_t *env, T *out, const store_key_t &, const std::vector<T *> &ts) {
         for (auto it = ts.begin(); it != ts.end(); ++it) {
@@ -501,6 +576,12 @@ public:
         : terminal_t<uint64_t>(0) { }
 private:
     virtual bool uses_val() { return false; }
+    virtual bool accumulate_all(env_t *,
+                                const datums_t &els,
+                                uint64_t *out) {
+        *out += els.size();
+        return !els.empty();
+    }
     virtual bool accumulate(env_t *,
                             const datum_t &,
                             uint64_t *out) {
@@ -535,8 +616,15 @@ protected:
     virtual bool accumulate(env_t *env,
                             const datum_t &el,
                             T *out) {
+        return skip_nonexistence([&]() { maybe_acc(env, el, out, f); });
+    }
+
+    // Runs `fn`, returning `false` if it failed with a non-existence error (in
+    // which case the element is skipped) and `true` otherwise.
+    template<class Callable>
+    bool skip_nonexistence(Callable &&fn) {
         try {
-            maybe_acc(env, el, out, f);
+            fn();
             return true;
         } catch (const datum_exc_t &e) {
             if (e.get_type() != base_exc_t::NON_EXISTENCE) {
@@ -549,6 +637,8 @@ protected:
         }
         return false;
     }
+
+    const acc_func_t &get_acc_func() const { return f; }
 private:
     virtual void maybe_acc(env_t *env,
                            const datum_t &el,
@@ -559,16 +649,57 @@ private:
     protob_t<const Backtrace> bt;
 };
 
-class sum_terminal_t : public skip_terminal_t<double> {
-public:
-    explicit sum_terminal_t(const sum_wire_func_t &f)
-        : skip_terminal_t<double>(f, 0.0L) { }
+// Terminals that reduce a stream of numbers.  Rather than dispatching on every
+// element, a batch is first decoded into a flat column of doubles and then
+// reduced in one tight loop by `reduce_column`.  Elements are added in stream
+// order, so the result is identical to accumulating them one at a time.
+template<class T>
+class numeric_terminal_t : public skip_terminal_t<T> {
+protected:
+    numeric_terminal_t(const skip_wire_func_t &wf, T &&t)
+        : skip_terminal_t<T>(wf, std::move(t)) { }
 private:
+    virtual bool accumulate_all(env_t *env,
+                                const datums_t &els,
+                                T *out) {
+        const acc_func_t &f = skip_terminal_t<T>::get_acc_func();
+        column.clear();
+        column.reserve(els.size());
+        for (auto el = els.begin(); el != els.end(); ++el) {
+            skip_terminal_t<T>::skip_nonexistence([&]() {
+                column.push_back(f(env, *el).as_num());
+            });
+        }
+        if (column.empty()) {
+            return false;
+        }
+        reduce_column(column.data(), column.size(), out);
+        return true;
+    }
     virtual void maybe_acc(env_t *env,
                            const datum_t &el,
-                           double *out,
+                           T *out,
                            const acc_func_t &f) {
-        *out += f(env, el).as_num();
+        double d = f(env, el).as_num();
+        reduce_column(&d, 1, out);
+    }
+    virtual void reduce_column(const double *column, size_t n, T *out) = 0;
+
+    // Reused between batches to avoid reallocating.
+    std::vector<double> column;
+};
+
+class sum_terminal_t : public numeric_terminal_t<double> {
+public:
+    explicit sum_terminal_t(const sum_wire_func_t &f)
+        : numeric_terminal_t<double>(f, 0.0L) { }
+private:
+    virtual void reduce_column(const double *column, size_t n, double *out) {
+        double sum = *out;
+        for (size_t i = 0; i < n; ++i) {
+            sum += column[i];
+        }
+        *out = sum;
     }
     virtual datum_t unpack(double *d) {
         return datum_t(*d);
@@ -578,18 +709,21 @@ private:
     }
 };
 
-class avg_terminal_t : public skip_terminal_t<std::pair<double, uint64_t> > {
+class avg_terminal_t : public numeric_terminal_t<std::pair<double, uint64_t> > {
 public:
     explicit avg_terminal_t(const avg_wire_func_t &f)
-        : skip_terminal_t<std::pair<double, uint64_t> >(
+        : numeric_terminal_t<std::pair<double, uint64_t> >(
             f, std::make_pair(0.0L, 0ULL)) { }
 private:
-    virtual void maybe_acc(env_t *env,
-                           const datum_t &el,
-                           std::pair<double, uint64_t> *out,
-                           const acc_func_t &f) {
-        out->first += f(env, el).as_num();
-        out->second += 1;
+    virtual void reduce_column(const double *column,
+                               size_t n,
+                               std::pair<double, uint64_t> *out) {
+        double sum = out->first;
+        for (size_t i = 0; i < n; ++i) {
+            sum += column[i];
+        }
+        out->first = sum;
+        out->second += n;
     }
     virtual datum_t unpack(
         std::pair<double, uint64_t> *p) {
@@ -714,6 +848,107 @@ private:
     counted_t<const func_t> f;
 };
 
+// Keeps the first `k` elements of a stream under the ordering of an unindexed
+// `order_by`.  Elements are buffered along with their sort keys (in `sindex_key`),
+// and the buffer gets cut back to `k` elements with a stable sort whenever it has
+// grown to twice that.  This takes O(n log k) time and O(k) memory per shard.
+class top_k_terminal_t : public terminal_t<stream_t> {
+public:
+    explicit top_k_terminal_t(const top_k_wire_func_t &f)
+        : terminal_t<stream_t>(stream_t()),
+          k(f.k),
+          bt(f.bt.get_bt()),
+          reql_version(reql_version_t::LATEST) {
+        for (auto it = f.keys.begin(); it != f.keys.end(); ++it) {
+            funcs.push_back(it->first.compile_wire_func());
+            descending.push_back(it->second);
+        }
+    }
+private:
+    virtual bool accumulate(env_t *env,
+                            const datum_t &el,
+                            stream_t *out) {
+        if (k == 0) {
+            return false;
+        }
+        reql_version = env->reql_version();
+        out->push_back(rget_item_t(store_key_t(), sort_key(env, el), el));
+        if (out->size() >= 2 * k) {
+            truncate(out);
+        }
+        return true;
+    }
+    virtual datum_t unpack(stream_t *s) {
+        truncate(s);
+        std::vector<datum_t> ret;
+        ret.reserve(s->size());
+        for (auto it = s->begin(); it != s->end(); ++it) {
+            ret.push_back(std::move(it->data));
+        }
+        return datum_t(std::move(ret), configured_limits_t::unlimited);
+    }
+    virtual void unshard_impl(env_t *env,
+                              stream_t *out,
+                              stream_t *el) {
+        reql_version = env->reql_version();
+        for (auto it = el->begin(); it != el->end(); ++it) {
+            out->push_back(std::move(*it));
+            if (out->size() >= 2 * k) {
+                truncate(out);
+            }
+        }
+    }
+
+    // Each key is wrapped in a one-element array, and missing keys are stored as
+    // empty arrays so that they sort first (like in `orderby_term_t`).
+    datum_t sort_key(env_t *env, const datum_t &el) const {
+        std::vector<datum_t> keys;
+        keys.reserve(funcs.size());
+        for (size_t i = 0; i < funcs.size(); ++i) {
+            datum_t val;
+            try {
+                val = funcs[i]->call(env, el)->as_datum();
+            } catch (const base_exc_t &e) {
+                if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+                    throw exc_t(e, bt.get(), 1);
+                }
+            }
+            keys.push_back(val.has()
+                ? datum_t(std::vector<datum_t>{val}, configured_limits_t::unlimited)
+                : datum_t::empty_array());
+        }
+        return datum_t(std::move(keys), configured_limits_t::unlimited);
+    }
+
+    bool less(const rget_item_t &l, const rget_item_t &r) const {
+        for (size_t i = 0; i < descending.size(); ++i) {
+            int cmp = l.sindex_key.get(i).cmp(reql_version, r.sindex_key.get(i));
+            if (cmp != 0) {
+                return (cmp < 0) != descending[i];
+            }
+        }
+        return false;
+    }
+
+    // Elements that were added earlier win ties, so this behaves like the stable
+    // sort done by `orderby_term_t`.
+    void truncate(stream_t *s) const {
+        std::stable_sort(s->begin(), s->end(),
+                         [this](const rget_item_t &l, const rget_item_t &r) {
+                             return less(l, r);
+                         });
+        if (s->size() > k) {
+            s->erase(s->begin() + k, s->end());
+        }
+    }
+
+    const uint64_t k;
+    const protob_t<const Backtrace> bt;
+    std::vector<counted_t<const func_t> > funcs;
+    std::vector<bool> descending;
+    reql_version_t reql_version;
+};
+
 template<class T>
 class terminal_visitor_t : public boost::static_visitor<T *> {
 public:
@@ -739,6 +974,9 @@ public:
         return new limit_append_t(
             lr.is_primary, lr.n, lr.sorting, lr.ops);
     }
+    T *operator()(const top_k_wire_func_t &f) const {
+        return new top_k_terminal_t(f);
+    }
 };
 
 scoped_ptr_t<accumulator_t> make_terminal(const terminal_variant_t &t) {
@@ -890,8 +1128,9 @@ private:
     virtual void lst_transform(
         env_t *env, datums_t *lst, const datum_t &) {
         try {
+            scoped_ptr_t<call_each_results_t> results = f->call_each(env, *lst);
             for (auto it = lst->begin(); it != lst->end(); ++it) {
-                *it = f->call(env, *it)->as_datum();
+                *it = results->next()->as_datum();
             }
         } catch (const datum_exc_t &e) {
             throw exc_t(e, f->backtrace().get(), 1);
@@ -937,25 +1176,50 @@ public:
         : f(_f.filter_func.compile_wire_func()),
           default_val(_f.default_filter_val
                       ? _f.default_filter_val->compile_wire_func()
-                      : counted_t<const func_t>()) { }
+                      : counted_t<const func_t>()),
+          predicate(filter_predicate_t::compile(f)) { }
 private:
     virtual void lst_transform(
         env_t *env, datums_t *lst, const datum_t &) {
-        auto it = lst->begin();
-        auto loc = it;
+        // Work out which rows the predicate decides, and call `f` on the rest all
+        // at once (which matters for JavaScript functions, where each call is a
+        // round trip to a worker process).
+        std::vector<boost::optional<bool> > decided;
+        datums_t undecided;
+        if (predicate.has()) {
+            decided.resize(lst->size());
+            for (size_t i = 0; i < lst->size(); ++i) {
+                decided[i] = predicate->test(env->reql_version(), (*lst)[i]);
+                if (!decided[i]) {
+                    undecided.push_back((*lst)[i]);
+                }
+            }
+        }
+
+        size_t loc = 0;
         try {
-            for (it = lst->begin(); it != lst->end(); ++it) {
-                if (f->filter_call(env, *it, default_val)) {
-                    std::swap(*loc, *it);
+            // Without a predicate every row is undecided, so `f` is called on the
+            // batch itself rather than on a copy of it.  The rows are only moved
+            // below after `f` has been called on them.
+            scoped_ptr_t<call_each_results_t> results =
+                f->call_each(env, predicate.has() ? undecided : *lst);
+            for (size_t i = 0; i < lst->size(); ++i) {
+                bool keep = predicate.has() && decided[i]
+                    ? *decided[i]
+                    : f->filter_call(env, (*lst)[i], default_val, results.get());
+                if (keep) {
+                    std::swap((*lst)[loc], (*lst)[i]);
                     ++loc;
                 }
             }
         } catch (const datum_exc_t &e) {
             throw exc_t(e, f->backtrace().get(), 1);
         }
-        lst->erase(loc, lst->end());
+        lst->erase(lst->begin() + loc, lst->end());
     }
     counted_t<const func_t> f, default_val;
+    // Set if `f` is simple enough to be evaluated without the interpreter.
+    scoped_ptr_t<filter_predicate_t> predicate;
 };
 
 class concatmap_trans_t : public ungrouped_op_t {
@@ -970,11 +1234,24 @@ private:
         profile::sampler_t sampler("Evaluating CONCAT_MAP elements.", env->trace);
         try {
             for (auto it = lst->begin(); it != lst->end(); ++it) {
-                auto ds = f->call(env, *it)->as_seq(env);
+                scoped_ptr_t<val_t> v = f->call(env, *it);
+                // Functions usually return arrays, whose elements we can append
+                // directly instead of reading them back through a stream.
+                if (v->get_type().get_raw_type() == val_t::type_t::DATUM) {
+                    datum_t arr = v->as_datum();
+                    if (arr.get_type() == datum_t::R_ARRAY) {
+                        const size_t size = arr.arr_size();
+                        for (size_t i = 0; i < size; ++i) {
+                            new_lst.push_back(arr.get(i));
+                        }
+                        sampler.new_sample();
+                        continue;
+                    }
+                }
+                auto ds = v->as_seq(env);
                 for (;;) {
                     auto v = ds->next_batch(env, bs);
                     if (v.size() == 0) break;
-                    new_lst.reserve(new_lst.size() + v.size());
                     new_lst.insert(new_lst.end(), v.begin(), v.end());
                     sampler.new_sample();
                 }
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <limits>
 #include <map>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -24,7 +25,8 @@ enum class is_primary_t { NO, YES };
 namespace ql {
 
 template<class T>
-T groups_to_batch(std::map<datum_t, T, optional_datum_less_t> *g) {
+T groups_to_batch(std::unordered_map<datum_t, T,
+                                    optional_datum_hash_t, optional_datum_equal_t> *g) {
     if (g->size() == 0) {
         return T();
     } else {
@@ -36,7 +38,10 @@ T groups_to_batch(std::map<datum_t, T, optional_datum_less_t> *g) {
 // This stuff previously resided in the protocol, but has been broken out since
 // we want to use this logic in multiple places.
 typedef std::vector<ql::datum_t> datums_t;
-typedef std::map<ql::datum_t, datums_t, optional_datum_less_t> groups_t;
+// Groups are hashed rather than sorted, so that finding a row's group doesn't take
+// O(log G) datum comparisons.  Their iteration order is unspecified.
+typedef std::unordered_map<ql::datum_t, datums_t,
+                           optional_datum_hash_t, optional_datum_equal_t> groups_t;
 
 struct rget_item_t {
     rget_item_t() { }
@@ -167,8 +172,8 @@ archive_result_t deserialize_grouped(read_stream_t *s, datums_t *ds) {
 }
 
 // Passing this means the caller affirms that they're not iterating a grouped_t in a
-// way such that its map order matters.  (This means that its optional_datum_less_t
-// can use any reql version, and it doesn't need the value as a parameter.)
+// way such that its map order matters.  (Its map is a hash map, so there is no order
+// to rely on.)
 namespace grouped {
 enum class order_doesnt_matter_t { };
 }
@@ -177,10 +182,12 @@ enum class order_doesnt_matter_t { };
 template<class T>
 class grouped_t {
 public:
-    // We assume > v1_13 ordering.  We could get fancy and allow any
-    // ordering, but usage of grouped_t inside of secondary index functions is the
-    // only place where we'd want v1_13 ordering, so let's not bother.
-    grouped_t() : m(optional_datum_less_t(reql_version_t::LATEST_has_v1_14_ordering)) { }
+    // The groups are kept in a hash map, which has no intrinsic ordering at all;
+    // `iterate_ordered_by_version` sorts them when the order matters.
+    typedef std::unordered_map<datum_t, T, optional_datum_hash_t, optional_datum_equal_t>
+        map_t;
+
+    grouped_t() { }
     virtual ~grouped_t() { } // See grouped_data_t below.
     template <cluster_version_t W>
     friend
@@ -216,22 +223,20 @@ public:
         return archive_result_t::SUCCESS;
     }
 
-    // You're not allowed to use, in any way, the intrinsic ordering of the
+    // You're not allowed to use, in any way, the iteration order of the
     // grouped_t.  If you're processing its data into a parallel map, you're ok,
-    // since the parallel map provides its own ordering (that you specify).  This
-    // way, we know it's OK for the map ordering to use any reql_version (instead of
-    // taking that as a parameter, which would be completely impracticable).
-    typename std::map<datum_t, T, optional_datum_less_t>::iterator
+    // since the parallel map provides its own ordering (that you specify).
+    typename map_t::iterator
     begin(grouped::order_doesnt_matter_t) { return m.begin(); }
-    typename std::map<datum_t, T, optional_datum_less_t>::iterator
+    typename map_t::iterator
     end(grouped::order_doesnt_matter_t) { return m.end(); }
 
-    std::pair<typename std::map<datum_t, T, optional_datum_less_t>::iterator, bool>
+    std::pair<typename map_t::iterator, bool>
     insert(std::pair<datum_t, T> &&val) {
         return m.insert(std::move(val));
     }
     void
-    erase(typename std::map<datum_t, T, optional_datum_less_t>::iterator pos) {
+    erase(typename map_t::iterator pos) {
         m.erase(pos);
     }
 
@@ -240,18 +245,16 @@ public:
     T &operator[](const datum_t &k) { return m[k]; }
 
     void swap(grouped_t<T> &other) { m.swap(other.m); }
-    std::map<datum_t, T, optional_datum_less_t> *
-    get_underlying_map(grouped::order_doesnt_matter_t) {
+    map_t *get_underlying_map(grouped::order_doesnt_matter_t) {
         return &m;
     }
 
-    const std::map<datum_t, T, optional_datum_less_t> *
-    get_underlying_map(grouped::order_doesnt_matter_t) const {
+    const map_t *get_underlying_map(grouped::order_doesnt_matter_t) const {
         return &m;
     }
 
 private:
-    std::map<datum_t, T, optional_datum_less_t> m;
+    map_t m;
 };
 
 template <class T>
@@ -281,31 +284,21 @@ private:
 
 }  // namespace grouped_details
 
-// For some people that iterate a grouped_t, order matters.  If the grouped_t is
-// sorted by a different ordering than the one which they're expecting (because of
-// reql version compatibility), we have to copy the elements to a vector and sort
-// them before iterating them.
+// For some people that iterate a grouped_t, order matters.  The grouped_t is a hash
+// map, so we sort its elements once, by the ordering of the reql version they're
+// expecting, before iterating them.
 template <class T, class Callable>
 void iterate_ordered_by_version(reql_version_t reql_version,
                                 grouped_t<T> &grouped,  // NOLINT(runtime/references)
                                 Callable &&callable) {
-    std::map<datum_t, T, optional_datum_less_t> *m
+    typename grouped_t<T>::map_t *m
         = grouped.get_underlying_map(grouped::order_doesnt_matter_t());
-    if (m->key_comp().reql_version() == reql_version) {
-        for (std::pair<const datum_t, T> &pair : *m) {
-            callable(pair.first, pair.second);
-        }
-    } else {
-        // The map is sorted with the wrong reql_version.  Copy it into a vector and
-        // sort it first.
-        std::vector<std::pair<datum_t, T> > vec(m->begin(), m->end());
-        // The keys (pulled straight out of a std::map) are unique, so std::sort
-        // works fine.
-        std::sort(vec.begin(), vec.end(),
-                  grouped_details::grouped_pair_compare_t<T>(reql_version));
-        for (std::pair<datum_t, T> &pair : vec) {
-            callable(pair.first, pair.second);
-        }
+    std::vector<std::pair<datum_t, T> > vec(m->begin(), m->end());
+    // The keys (pulled straight out of a map) are unique, so std::sort works fine.
+    std::sort(vec.begin(), vec.end(),
+              grouped_details::grouped_pair_compare_t<T>(reql_version));
+    for (std::pair<datum_t, T> &pair : vec) {
+        callable(pair.first, pair.second);
     }
 }
 
@@ -360,7 +353,8 @@ typedef boost::variant<count_wire_func_t,
                        min_wire_func_t,
                        max_wire_func_t,
                        reduce_wire_func_t,
-                       limit_read_t
+                       limit_read_t,
+                       top_k_wire_func_t
                        > terminal_variant_t;
 
 class accumulator_t {
@@ -401,7 +395,7 @@ scoped_ptr_t<accumulator_t> make_append(const sorting_t &sorting, batcher_t *bat
 //                                                        NULL if unsharding ^^^^^^^
 scoped_ptr_t<accumulator_t> make_limit_append(size_t n, sorting_t sorting);
 scoped_ptr_t<accumulator_t> make_terminal(const terminal_variant_t &t);
-scoped_ptr_t<eager_acc_t> make_to_array(reql_version_t reql_version);
+scoped_ptr_t<eager_acc_t> make_to_array();
 scoped_ptr_t<eager_acc_t> make_eager_terminal(const terminal_variant_t &t);
 scoped_ptr_t<op_t> make_op(const transform_variant_t &tv);
 
@@ -1,6 +1,9 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "rdb_protocol/store.hpp"
 
+#include <limits>
+
+#include "btree/depth_first_traversal.hpp"
 #include "btree/reql_specific.hpp"
 #include "btree/superblock.hpp"
 #include "concurrency/cross_thread_signal.hpp"
@@ -12,7 +15,10 @@
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/env.hpp"
 #include "rdb_protocol/erase_range.hpp"
+#include "rdb_protocol/filter_predicate.hpp"
 #include "rdb_protocol/func.hpp"
+#include "rdb_protocol/profile.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
 #include "rdb_protocol/shards.hpp"
 #include "rdb_protocol/table_common.hpp"
 
@@ -143,7 +149,10 @@ void store_t::help_construct_bring_sindexes_up_to_date() {
         std::map<sindex_name_t, secondary_index_t> sindexes;
         get_secondary_indexes(&sindex_block, &sindexes);
         for (auto it = sindexes.begin(); it != sindexes.end(); ++it) {
-            if (it->second.being_deleted) {
+            if (is_detached_subtrees_name(it->first)) {
+                coro_t::spawn_sometime(std::bind(&store_t::free_detached_subtrees,
+                                                 this, it->first, drainer.lock()));
+            } else if (it->second.being_deleted) {
                 coro_t::spawn_sometime(std::bind(&sindex_clearer_t::clear,
                                                  this, it->second, drainer.lock()));
             }
@@ -162,22 +171,45 @@ scoped_ptr_t<sindex_superblock_t> acquire_sindex_for_read(
     const std::string &table_name,
     const std::string &sindex_id,
     sindex_disk_info_t *sindex_info_out,
-    uuid_u *sindex_uuid_out) {
+    uuid_u *sindex_uuid_out,
+    // If set, we also try to acquire another index as described in
+    // `store_t::acquire_sindex_superblock_for_read`.
+    const std::function<bool(const std::vector<char> &)> &choose_extra
+        = std::function<bool(const std::vector<char> &)>(),
+    scoped_ptr_t<sindex_superblock_t> *extra_sb_out = NULL,
+    sindex_disk_info_t *extra_info_out = NULL,
+    uuid_u *extra_uuid_out = NULL,
+    release_superblock_t release_superblock = release_superblock_t::RELEASE) {
     rassert(sindex_info_out != NULL);
     rassert(sindex_uuid_out != NULL);
 
     scoped_ptr_t<sindex_superblock_t> sindex_sb;
     std::vector<char> sindex_mapping_data;
+    std::vector<char> extra_mapping_data;
 
     uuid_u sindex_uuid;
     try {
-        bool found = store->acquire_sindex_superblock_for_read(
-            sindex_name_t(sindex_id),
-            table_name,
-            superblock,
-            &sindex_sb,
-            &sindex_mapping_data,
-            &sindex_uuid);
+        bool found = choose_extra
+            ? store->acquire_sindex_superblock_for_read(
+                sindex_name_t(sindex_id),
+                table_name,
+                superblock,
+                &sindex_sb,
+                &sindex_mapping_data,
+                &sindex_uuid,
+                choose_extra,
+                extra_sb_out,
+                &extra_mapping_data,
+                extra_uuid_out,
+                release_superblock)
+            : store->acquire_sindex_superblock_for_read(
+                sindex_name_t(sindex_id),
+                table_name,
+                superblock,
+                &sindex_sb,
+                &sindex_mapping_data,
+                &sindex_uuid,
+                release_superblock);
         if (!found) {
             // TODO: consider adding some logic on the machine handling the
             // query to attach a real backtrace here.
@@ -194,6 +226,9 @@ scoped_ptr_t<sindex_superblock_t> acquire_sindex_for_read(
 
     try {
         deserialize_sindex_info(sindex_mapping_data, sindex_info_out);
+        if (extra_sb_out != NULL && extra_sb_out->has()) {
+            deserialize_sindex_info(extra_mapping_data, extra_info_out);
+        }
     } catch (const archive_exc_t &e) {
         crash("%s", e.what());
     }
@@ -202,6 +237,93 @@ scoped_ptr_t<sindex_superblock_t> acquire_sindex_for_read(
     return std::move(sindex_sb);
 }
 
+// The most primary keys we collect from another secondary index to skip rows in a
+// secondary index read.  If there are more, loading and filtering the rows isn't
+// much more expensive anyway.
+const size_t MAX_INDEX_INTERSECTION_KEYS = 10000;
+
+/* A read like `getAll(a, {index: 'x'}).filter({y: b})` can skip all rows that are
+not in the range `[b, b]` of a secondary index on just `y`, without loading them.
+If the read's first transform is such a filter, this sets the field and the value
+to look up. */
+bool get_index_intersection(const rget_read_t &rget,
+                            datum_string_t *field_out,
+                            ql::datum_t *value_out) {
+    if (rget.transforms.empty()) {
+        return false;
+    }
+    const ql::filter_wire_func_t *filter =
+        boost::get<ql::filter_wire_func_t>(&rget.transforms[0]);
+    // With a `default`, rows without the field could pass the filter.
+    if (filter == NULL || filter->default_filter_val) {
+        return false;
+    }
+    scoped_ptr_t<ql::filter_predicate_t> predicate =
+        ql::filter_predicate_t::compile(filter->filter_func.compile_wire_func());
+    std::vector<datum_string_t> path;
+    // Other predicates could throw for the rows we'd skip.
+    if (!predicate.has()
+        || !predicate->only_uses_top_level_fields()
+        || !predicate->get_required_equality(&path, value_out)
+        || path.size() != 1) {
+        return false;
+    }
+    // `null` can't be stored in a secondary index, and we don't want to think
+    // about how the more complicated types are truncated.
+    const ql::datum_t::type_t type = value_out->get_type();
+    if (type != ql::datum_t::R_NUM
+        && type != ql::datum_t::R_STR
+        && type != ql::datum_t::R_BOOL) {
+        return false;
+    }
+    *field_out = path[0];
+    return true;
+}
+
+// The field that a range read's first `filter` compares to a single value, as its
+// path joined by dots.  It's what `unindexed_scan_stats_t` records.
+bool get_filtered_field(const rget_read_t &rget, std::string *field_out) {
+    if (rget.transforms.empty()) {
+        return false;
+    }
+    const ql::filter_wire_func_t *filter =
+        boost::get<ql::filter_wire_func_t>(&rget.transforms[0]);
+    if (filter == NULL) {
+        return false;
+    }
+    scoped_ptr_t<ql::filter_predicate_t> predicate =
+        ql::filter_predicate_t::compile(filter->filter_func.compile_wire_func());
+    std::vector<datum_string_t> path;
+    ql::datum_t value;
+    if (!predicate.has() || !predicate->get_required_equality(&path, &value)) {
+        return false;
+    }
+    field_out->clear();
+    for (const datum_string_t &part : path) {
+        if (!field_out->empty()) {
+            *field_out += ".";
+        }
+        *field_out += part.to_std();
+    }
+    return true;
+}
+
+bool is_field_index(const std::vector<char> &definition, const datum_string_t &field) {
+    sindex_disk_info_t info;
+    try {
+        deserialize_sindex_info(definition, &info);
+    } catch (const archive_exc_t &) {
+        return false;
+    }
+    std::vector<datum_string_t> path;
+    return info.multi == sindex_multi_bool_t::SINGLE
+        && info.geo == sindex_geo_bool_t::REGULAR
+        && ql::filter_predicate_t::get_field_path(
+            info.mapping.compile_wire_func(), &path)
+        && path.size() == 1
+        && path[0] == field;
+}
+
 void do_read(ql::env_t *env,
              store_t *store,
              btree_slice_t *btree,
@@ -210,15 +332,60 @@ void do_read(ql::env_t *env,
              rget_read_response_t *res,
              release_superblock_t release_superblock) {
     if (!rget.sindex) {
+        // An unfiltered `count()` whose range covers all of the rows of this store
+        // can be answered from the btree's population.
+        uint64_t count;
+        const region_t store_region = store->get_region();
+        if (rget.transforms.empty()
+            && rget.terminal
+            && boost::get<ql::count_wire_func_t>(&*rget.terminal) != NULL
+            && rget.region.beg <= store_region.beg
+            && rget.region.end >= store_region.end) {
+            profile::starter_t starter("Count rows from the primary index's "
+                                       "population.", env->trace);
+            if (rdb_count_from_stat_block(superblock, rget.region.inner, &count)) {
+                if (release_superblock == release_superblock_t::RELEASE) {
+                    superblock->release();
+                }
+                ql::grouped_t<uint64_t> counts;
+                if (count != 0) {
+                    counts.insert(std::make_pair(ql::datum_t(), count));
+                }
+                res->result = std::move(counts);
+                return;
+            }
+        }
         // Normal rget
-        rdb_rget_slice(btree, rget.region.inner, superblock,
-                       env, rget.batchspec, rget.transforms, rget.terminal,
-                       rget.sorting, res, release_superblock);
+        std::string filtered_field;
+        if (get_filtered_field(rget, &filtered_field)) {
+            rget_scan_counts_t counts;
+            rdb_rget_slice(btree, rget.region.inner, superblock,
+                           env, rget.batchspec, rget.transforms, rget.terminal,
+                           rget.sorting, res, release_superblock, &counts);
+            store->unindexed_scan_stats.record(
+                filtered_field, counts.rows_scanned, counts.rows_returned);
+        } else {
+            rdb_rget_slice(btree, rget.region.inner, superblock,
+                           env, rget.batchspec, rget.transforms, rget.terminal,
+                           rget.sorting, res, release_superblock);
+        }
     } else {
         sindex_disk_info_t sindex_info;
         uuid_u sindex_uuid;
         scoped_ptr_t<sindex_superblock_t> sindex_sb;
         region_t true_region;
+
+        datum_string_t intersection_field;
+        ql::datum_t intersection_value;
+        std::function<bool(const std::vector<char> &)> choose_intersection;
+        if (get_index_intersection(rget, &intersection_field, &intersection_value)) {
+            choose_intersection = [&](const std::vector<char> &definition) {
+                return is_field_index(definition, intersection_field);
+            };
+        }
+        scoped_ptr_t<sindex_superblock_t> intersection_sb;
+        sindex_disk_info_t intersection_info;
+        uuid_u intersection_uuid;
         try {
             sindex_sb =
                 acquire_sindex_for_read(
@@ -227,7 +394,17 @@ void do_read(ql::env_t *env,
                     rget.table_name,
                     rget.sindex->id,
                     &sindex_info,
-                    &sindex_uuid);
+                    &sindex_uuid,
+                    choose_intersection,
+                    &intersection_sb,
+                    &intersection_info,
+                    &intersection_uuid,
+                    // We don't know yet whether we'll have to read rows from the
+                    // primary index.
+                    release_superblock_t::KEEP);
+            if (sindex_info.values == sindex_values_bool_t::DOCUMENT) {
+                superblock->release();
+            }
             ql::skey_version_t skey_version =
                 ql::skey_version_from_reql_version(
                     sindex_info.mapping_version_info.latest_compatible_reql_version);
@@ -245,7 +422,7 @@ void do_read(ql::env_t *env,
             return;
         }
 
-        if (sindex_info.geo == sindex_geo_bool_t::GEO) {
+        if (sindex_info.geo != sindex_geo_bool_t::REGULAR) {
             res->result = ql::exc_t(
                 ql::base_exc_t::GENERIC,
                 strprintf(
@@ -255,13 +432,49 @@ void do_read(ql::env_t *env,
                 NULL);
             return;
         }
+        // The rows of limit changefeeds are kept up to date from the index alone.
+        if (sindex_info.values == sindex_values_bool_t::PRIMARY_KEY
+            && rget.terminal
+            && boost::get<ql::limit_read_t>(&*rget.terminal) != NULL) {
+            res->result = ql::exc_t(
+                ql::base_exc_t::GENERIC,
+                strprintf(
+                    "Index `%s` doesn't store its documents.  Cannot open a "
+                    "changefeed on an `order_by.limit` using it.",
+                    rget.sindex->id.c_str()),
+                NULL);
+            return;
+        }
+
+        std::set<store_key_t> intersection_keys;
+        bool use_intersection = false;
+        if (intersection_sb.has()) {
+            profile::starter_t starter("Look up filter value in secondary index.",
+                                       env->trace);
+            const ql::skey_version_t intersection_skey_version =
+                ql::skey_version_from_reql_version(
+                    intersection_info.mapping_version_info
+                        .latest_compatible_reql_version);
+            use_intersection = rdb_collect_sindex_primary_keys(
+                region_t(ql::datum_range_t(intersection_value)
+                         .to_sindex_keyrange(intersection_skey_version)),
+                intersection_sb.get(),
+                rget.region.inner,
+                MAX_INDEX_INTERSECTION_KEYS,
+                &intersection_keys);
+            intersection_sb.reset();
+        }
 
         rdb_rget_secondary_slice(
             store->get_sindex_slice(sindex_uuid),
             rget.sindex->original_range, std::move(true_region),
             sindex_sb.get(), env, rget.batchspec, rget.transforms,
             rget.terminal, rget.region.inner, rget.sorting,
-            sindex_info, res, release_superblock_t::RELEASE);
+            sindex_info, res, release_superblock_t::RELEASE,
+            use_intersection ? &intersection_keys : NULL,
+            btree,
+            sindex_info.values == sindex_values_bool_t::PRIMARY_KEY
+                ? superblock : NULL);
     }
 }
 
@@ -279,7 +492,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
 
     void operator()(const changefeed_limit_subscribe_t &s) {
         ql::env_t env(ctx, ql::return_empty_normal_batches_t::NO,
-                      interruptor, s.optargs, trace);
+                      interruptor, s.optargs, trace, nullptr);
         ql::stream_t stream;
         {
             std::vector<scoped_ptr_t<ql::op_t> > ops;
@@ -349,8 +562,21 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         guarantee(store->changefeed_server.has());
         response->response = changefeed_stamp_response_t();
         auto res = boost::get<changefeed_stamp_response_t>(&response->response);
-        res->stamps[store->changefeed_server->get_uuid()]
-            = store->changefeed_server->get_stamp(s.addr);
+        const uuid_u uuid = store->changefeed_server->get_uuid();
+        if (!s.resumable) {
+            res->stamps[uuid] = store->changefeed_server->get_stamp(s.addr);
+            return;
+        }
+        boost::optional<uint64_t> from;
+        auto it = s.resume_from.find(uuid);
+        if (it != s.resume_from.end()) {
+            from = it->second;
+        }
+        if (!store->changefeed_server->get_stamp_and_log(
+                s.addr, from, &res->stamps[uuid], &res->log_positions[uuid],
+                &res->replay[uuid])) {
+            res->truncated.insert(uuid);
+        }
     }
 
     void operator()(const changefeed_point_stamp_t &s) {
@@ -369,12 +595,13 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         response->response = point_read_response_t();
         point_read_response_t *res =
             boost::get<point_read_response_t>(&response->response);
+        store->key_access_sampler.record(get.key);
         rdb_get(get.key, btree, superblock, res, trace);
     }
 
     void operator()(const intersecting_geo_read_t &geo_read) {
         ql::env_t ql_env(ctx, ql::return_empty_normal_batches_t::NO,
-                         interruptor, geo_read.optargs, trace);
+                         interruptor, geo_read.optargs, trace, nullptr);
 
         response->response = rget_read_response_t();
         rget_read_response_t *res =
@@ -396,7 +623,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
             return;
         }
 
-        if (sindex_info.geo != sindex_geo_bool_t::GEO) {
+        if (sindex_info.geo == sindex_geo_bool_t::REGULAR) {
             res->result = ql::exc_t(
                 ql::base_exc_t::GENERIC,
                 strprintf(
@@ -424,7 +651,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
 
     void operator()(const nearest_geo_read_t &geo_read) {
         ql::env_t ql_env(ctx, ql::return_empty_normal_batches_t::NO,
-                         interruptor, geo_read.optargs, trace);
+                         interruptor, geo_read.optargs, trace, nullptr);
 
         response->response = nearest_geo_read_response_t();
         nearest_geo_read_response_t *res =
@@ -446,7 +673,7 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
             return;
         }
 
-        if (sindex_info.geo != sindex_geo_bool_t::GEO) {
+        if (sindex_info.geo == sindex_geo_bool_t::REGULAR) {
             res->results_or_error = ql::exc_t(
                 ql::base_exc_t::GENERIC,
                 strprintf(
@@ -479,7 +706,15 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         }
 
         ql::env_t ql_env(ctx, ql::return_empty_normal_batches_t::NO,
-                         interruptor, rget.optargs, trace);
+                         interruptor, rget.optargs, trace, nullptr);
+        scoped_ptr_t<with_priority_t> batch_priority;
+        if (rget.optargs.count("priority") != 0
+            && ql_env.priority() == ql::query_priority_t::BATCH) {
+            // Batch queries' range reads yield to everything else on this thread,
+            // and their blocks are loaded at a lower I/O priority.
+            batch_priority.init(new with_priority_t(CORO_PRIORITY_BATCH_QUERY));
+            superblock->get()->txn()->set_account(&store->batch_query_cache_account);
+        }
 
         response->response = rget_read_response_t();
         rget_read_response_t *res =
@@ -508,6 +743,8 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
             scale_down_distribution(dg.result_limit, &res->key_counts);
         }
 
+        store->key_access_sampler.get_counts(dg.region.inner, &res->key_access_counts);
+
         res->region = dg.region;
     }
 
@@ -589,6 +826,24 @@ struct rdb_read_visitor_t : public boost::static_visitor<void> {
         response->response = dummy_read_response_t();
     }
 
+    void operator()(const sample_read_t &sr) {
+        response->response = sample_read_response_t();
+        sample_read_response_t *res =
+            boost::get<sample_read_response_t>(&response->response);
+        profile::starter_t starter("Sample rows from the primary index.", trace);
+        rdb_sample_slice(superblock, sr.region.inner, sr.num, interruptor, res);
+    }
+
+    void operator()(const multi_point_read_t &mpr) {
+        response->response = multi_point_read_response_t();
+        multi_point_read_response_t *res =
+            boost::get<multi_point_read_response_t>(&response->response);
+        for (const store_key_t &key : mpr.keys) {
+            store->key_access_sampler.record(key);
+        }
+        rdb_get_multi(mpr.keys, btree, superblock, res, trace);
+    }
+
     rdb_read_visitor_t(btree_slice_t *_btree,
                        store_t *_store,
                        real_superblock_t *_superblock,
@@ -623,7 +878,9 @@ void store_t::protocol_read(const read_t &read,
                             signal_t *interruptor) {
     scoped_ptr_t<profile::trace_t> trace = ql::maybe_make_profile_trace(read.profile);
 
+    resource_usage_t usage;
     {
+        charge_resource_usage_t charge(&usage);
         profile::starter_t start_read("Perform read on shard.", trace);
         rdb_read_visitor_t v(btree.get(), this,
                              superblock,
@@ -632,6 +889,8 @@ void store_t::protocol_read(const read_t &read,
     }
 
     response->n_shards = 1;
+    usage.shard_requests = 1;
+    response->usage = usage;
     if (trace.has()) {
         response->event_log = std::move(*trace).extract_event_log();
     }
@@ -676,14 +935,48 @@ private:
     const return_changes_t return_changes;
 };
 
+// Deletes every row it's given, for `expire_t`.
+class expiry_replacer_t : public btree_batched_replacer_t {
+public:
+    ql::datum_t replace(UNUSED const ql::datum_t &d, UNUSED size_t index) const {
+        return ql::datum_t::null();
+    }
+    return_changes_t should_return_changes() const { return return_changes_t::NO; }
+};
+
+// Collects the first keys of a region of the primary btree, for `expire_t` on a
+// table whose primary key is the time.
+class expired_primary_keys_cb_t : public depth_first_traversal_callback_t {
+public:
+    expired_primary_keys_cb_t(const region_t &_region, uint64_t _max_keys,
+                              std::vector<store_key_t> *_keys_out)
+        : region(_region), max_keys(_max_keys), keys_out(_keys_out) { }
+    done_traversing_t handle_pair(scoped_key_value_t &&keyvalue) {
+        store_key_t key(keyvalue.key());
+        if (region_contains_key(region, key)) {
+            keys_out->push_back(key);
+        }
+        return keys_out->size() >= max_keys
+            ? done_traversing_t::YES
+            : done_traversing_t::NO;
+    }
+private:
+    const region_t region;
+    const uint64_t max_keys;
+    std::vector<store_key_t> *const keys_out;
+};
+
 struct rdb_write_visitor_t : public boost::static_visitor<void> {
     void operator()(const batched_replace_t &br) {
         ql::env_t ql_env(ctx, ql::return_empty_normal_batches_t::NO,
-                         interruptor, br.optargs, trace);
+                         interruptor, br.optargs, trace, nullptr);
         rdb_modification_report_cb_t sindex_cb(
             store, &sindex_block,
             auto_drainer_t::lock_t(&store->drainer));
         func_replacer_t replacer(&ql_env, br.f, br.return_changes);
+        for (auto it = br.keys.begin(); it != br.keys.end(); ++it) {
+            store->key_access_sampler.record(*it);
+        }
 
         response->response =
             rdb_batched_replace(
@@ -706,6 +999,7 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         keys.reserve(bi.inserts.size());
         for (auto it = bi.inserts.begin(); it != bi.inserts.end(); ++it) {
             keys.emplace_back(it->get_field(datum_string_t(bi.pkey)).print_primary());
+            store->key_access_sampler.record(keys.back());
         }
         response->response =
             rdb_batched_replace(
@@ -727,6 +1021,7 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
 
         rdb_live_deletion_context_t deletion_context;
         rdb_modification_report_t mod_report(w.key);
+        store->key_access_sampler.record(w.key);
         rdb_set(w.key, w.data, w.overwrite, btree, timestamp, superblock->get(),
                 &deletion_context, res, &mod_report.info, trace);
 
@@ -741,6 +1036,7 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
 
         rdb_live_deletion_context_t deletion_context;
         rdb_modification_report_t mod_report(d.key);
+        store->key_access_sampler.record(d.key);
         rdb_delete(d.key, btree, timestamp, superblock->get(), &deletion_context,
                 res, &mod_report.info, trace);
 
@@ -753,7 +1049,7 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
 
         write_message_t wm;
         sindex_disk_info_t info(c.mapping, sindex_reql_version_info_t::LATEST(),
-                                c.multi, c.geo);
+                                c.multi, c.geo, c.values);
         serialize_sindex_info(&wm, info);
 
         vector_stream_t stream;
@@ -833,6 +1129,31 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
         response->response = dummy_write_response_t();
     }
 
+    void operator()(const expire_t &e) {
+        sampler->new_sample();
+        std::vector<store_key_t> keys;
+        find_expired_rows(e, &keys);
+        if (keys.empty()) {
+            response->response = ql::datum_t::empty_object();
+            return;
+        }
+
+        rdb_modification_report_cb_t sindex_cb(
+            store, &sindex_block,
+            auto_drainer_t::lock_t(&store->drainer));
+        expiry_replacer_t replacer;
+        response->response =
+            rdb_batched_replace(
+                btree_info_t(btree, timestamp, datum_string_t(e.pkey)),
+                superblock,
+                keys,
+                &replacer,
+                &sindex_cb,
+                ql::configured_limits_t(),
+                sampler,
+                trace);
+    }
+
     rdb_write_visitor_t(btree_slice_t *_btree,
                         store_t *_store,
                         txn_t *_txn,
@@ -859,6 +1180,69 @@ struct rdb_write_visitor_t : public boost::static_visitor<void> {
     }
 
 private:
+    /* Collects the primary keys of the rows that `e` deletes. It takes the first
+    ones in the order of the index, so that every replica takes the same ones. Only
+    times sort in the range it looks at, so rows whose index value is something
+    else never expire. */
+    void find_expired_rows(const expire_t &e, std::vector<store_key_t> *keys_out) {
+        const ql::datum_range_t range(
+            ql::pseudo::make_time(-std::numeric_limits<double>::max(), "+00:00"),
+            key_range_t::closed,
+            e.cutoff,
+            key_range_t::open);
+
+        if (e.sindex == e.pkey) {
+            /* The rows are keyed by time, as in an append-only time series, so the
+            expired ones are all at the left end of the primary btree and no
+            secondary index is needed. */
+            key_range_t primary_range = range.to_primary_keyrange();
+            if (!primary_range.overlaps(e.region.inner)) {
+                return;
+            }
+            primary_range = primary_range.intersection(e.region.inner);
+            expired_primary_keys_cb_t cb(e.region, e.max_rows, keys_out);
+            btree_depth_first_traversal(superblock->get(), primary_range, &cb,
+                                        direction_t::FORWARD,
+                                        release_superblock_t::KEEP);
+            return;
+        }
+
+        secondary_index_t sindex;
+        if (!::get_secondary_index(&sindex_block, sindex_name_t(e.sindex), &sindex)
+                || !sindex.is_ready()) {
+            return;
+        }
+        sindex_disk_info_t sindex_info;
+        try {
+            deserialize_sindex_info(sindex.opaque_definition, &sindex_info);
+        } catch (const archive_exc_t &) {
+            return;
+        }
+        if (sindex_info.geo != sindex_geo_bool_t::REGULAR) {
+            return;
+        }
+
+        const region_t sindex_region(range.to_sindex_keyrange(
+            ql::skey_version_from_reql_version(
+                sindex_info.mapping_version_info.latest_compatible_reql_version)));
+
+        std::set<store_key_t> keys;
+        {
+            sindex_superblock_t sindex_superblock(
+                buf_lock_t(&sindex_block, sindex.superblock, access_t::read));
+            rdb_collect_sindex_primary_keys(sindex_region, &sindex_superblock,
+                                            e.region.inner, e.max_rows, &keys);
+        }
+        for (const store_key_t &key : keys) {
+            if (keys_out->size() == e.max_rows) {
+                break;
+            }
+            if (region_contains_key(e.region, key)) {
+                keys_out->push_back(key);
+            }
+        }
+    }
+
     void update_sindexes(const rdb_modification_report_t &mod_report) {
         std::vector<rdb_modification_report_t> mod_reports;
         // This copying of the mod_report is inefficient, but it seems this
@@ -891,7 +1275,9 @@ void store_t::protocol_write(const write_t &write,
                              signal_t *interruptor) {
     scoped_ptr_t<profile::trace_t> trace = ql::maybe_make_profile_trace(write.profile);
 
+    resource_usage_t usage;
     {
+        charge_resource_usage_t charge(&usage);
         profile::sampler_t start_write("Perform write on shard.", trace);
         rdb_write_visitor_t v(btree.get(),
                               this,
@@ -907,6 +1293,8 @@ void store_t::protocol_write(const write_t &write,
     }
 
     response->n_shards = 1;
+    usage.shard_requests = 1;
+    response->usage = usage;
     if (trace.has()) {
         response->event_log = std::move(*trace).extract_event_log();
     }
@@ -2,6 +2,7 @@
 #ifndef RDB_PROTOCOL_STORE_HPP_
 #define RDB_PROTOCOL_STORE_HPP_
 
+#include <functional>
 #include <map>
 #include <set>
 #include <string>
@@ -13,6 +14,7 @@
 #include "btree/node.hpp"
 #include "btree/parallel_traversal.hpp"
 #include "btree/secondary_operations.hpp"
+#include "buffer_cache/cache_account.hpp"
 #include "buffer_cache/types.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/new_mutex.hpp"
@@ -23,7 +25,9 @@
 #include "perfmon/perfmon.hpp"
 #include "protocol_api.hpp"
 #include "rdb_protocol/changefeed.hpp"
+#include "rdb_protocol/key_access_sampler.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/unindexed_scan_stats.hpp"
 #include "rpc/mailbox/typed.hpp"
 #include "store_view.hpp"
 #include "utils.hpp"
@@ -231,10 +235,29 @@ public:
     MUST_USE bool acquire_sindex_superblock_for_read(
             const sindex_name_t &name,
             const std::string &table_name,
-            real_superblock_t *superblock,  // releases this.
+            real_superblock_t *superblock,  // releases this, unless asked not to.
             scoped_ptr_t<sindex_superblock_t> *sindex_sb_out,
             std::vector<char> *opaque_definition_out,
-            uuid_u *sindex_uuid_out)
+            uuid_u *sindex_uuid_out,
+            release_superblock_t release_superblock = release_superblock_t::RELEASE)
+        THROWS_ONLY(sindex_not_ready_exc_t);
+
+    /* Like the above, but also acquires the superblock of one more ready
+    secondary index from the same snapshot: the first one other than `name` for
+    which `choose_extra` returns true given its opaque definition.  Leaves
+    `*extra_sb_out` empty if there's no such index. */
+    MUST_USE bool acquire_sindex_superblock_for_read(
+            const sindex_name_t &name,
+            const std::string &table_name,
+            real_superblock_t *superblock,  // releases this, unless asked not to.
+            scoped_ptr_t<sindex_superblock_t> *sindex_sb_out,
+            std::vector<char> *opaque_definition_out,
+            uuid_u *sindex_uuid_out,
+            const std::function<bool(const std::vector<char> &)> &choose_extra,
+            scoped_ptr_t<sindex_superblock_t> *extra_sb_out,
+            std::vector<char> *extra_definition_out,
+            uuid_u *extra_uuid_out,
+            release_superblock_t release_superblock = release_superblock_t::RELEASE)
         THROWS_ONLY(sindex_not_ready_exc_t);
 
     MUST_USE bool acquire_sindex_superblock_for_write(
@@ -356,6 +379,27 @@ private:
             secondary_index_t sindex,
             auto_drainer_t::lock_t store_keepalive)
             THROWS_NOTHING;
+    // Frees the blocks of subtrees that `reset_data()` has cut out of the primary
+    // btree, which are listed in the sindex block under `name` (see
+    // `compute_detached_subtrees_name()`). To be run in a coroutine. If the store
+    // shuts down before it's done, it picks up where it left off the next time the
+    // store starts.
+    void free_detached_subtrees(
+            sindex_name_t name,
+            auto_drainer_t::lock_t store_keepalive)
+            THROWS_NOTHING;
+    // Whether `name` is the sindex block entry that lists subtrees waiting for
+    // `free_detached_subtrees()`, rather than a secondary index.
+    static bool is_detached_subtrees_name(const sindex_name_t &name);
+
+    // Starts building the primary B-tree's key filter if it needs it, using
+    // `population` as an estimate of how many keys the B-tree has.
+    void maybe_rebuild_primary_key_filter(size_t population);
+    // Adds the keys of a snapshot of the primary B-tree to its key filter. To be run
+    // in a coroutine, after `key_filter_t::start_rebuild()`.
+    void rebuild_primary_key_filter(auto_drainer_t::lock_t store_keepalive)
+            THROWS_NOTHING;
+
     // Internally called by `delayed_clear_sindex()`
     void clear_sindex(
             secondary_index_t sindex,
@@ -404,6 +448,8 @@ public:
     // before we destruct perfmon_collection
     scoped_ptr_t<cache_t> cache;
     scoped_ptr_t<cache_conn_t> general_cache_conn;
+    // The reads of batch queries use this instead of the cache's default account.
+    cache_account_t batch_query_cache_account;
     scoped_ptr_t<btree_slice_t> btree;
     io_backender_t *io_backender_;
     base_path_t base_path_;
@@ -421,6 +467,13 @@ public:
     // any time the set of outdated indexes for this table changes
     scoped_ptr_t<outdated_index_report_t> index_report;
 
+    // Point reads and writes record their keys here.
+    key_access_sampler_t key_access_sampler;
+
+    // Range reads on the primary index that filter on a field record it here.
+    unindexed_scan_stats_t unindexed_scan_stats;
+    perfmon_membership_t unindexed_scan_stats_membership;
+
 private:
     namespace_id_t table_id;
 
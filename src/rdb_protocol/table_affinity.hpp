@@ -0,0 +1,40 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_TABLE_AFFINITY_HPP_
+#define RDB_PROTOCOL_TABLE_AFFINITY_HPP_
+
+#include "threading.hpp"
+
+/* `table_affinity_t` keeps track of where the primary replicas of the tables that a
+client connection reads from and writes to run.  If the connection keeps using tables
+whose primaries all run on the same thread of this server, the query server moves the
+connection to that thread, which saves two thread switches on every read and write. */
+class table_affinity_t {
+public:
+    table_affinity_t() : thread(INVALID_THREAD), streak(0) { }
+
+    /* `primary_thread` is the table's `get_local_primary_thread()`. */
+    void note_table_access(threadnum_t primary_thread) {
+        if (primary_thread == thread) {
+            ++streak;
+        } else {
+            thread = primary_thread;
+            streak = 1;
+        }
+    }
+
+    /* Returns the thread that the last `MIN_STREAK` table accesses all went to, or
+    `INVALID_THREAD`. */
+    threadnum_t get_preferred_thread() const {
+        return streak >= MIN_STREAK ? thread : INVALID_THREAD;
+    }
+
+private:
+    static const int64_t MIN_STREAK = 16;
+
+    threadnum_t thread;
+    int64_t streak;
+
+    DISABLE_COPYING(table_affinity_t);
+};
+
+#endif  // RDB_PROTOCOL_TABLE_AFFINITY_HPP_
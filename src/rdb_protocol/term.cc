@@ -213,6 +213,50 @@ void maybe_release_query_id(query_id_t &&id,
     }
 }
 
+// Runs each term of a `BATCH` query as its own `START` query, one after the other,
+// and collects their responses.  The terms reuse the batch's token; that's fine
+// because each one is finished (and so out of the query cache) before the next
+// one starts.
+void run_batch(const protob_t<Query> &q,
+               use_json_t use_json,
+               Response *res,
+               query_cache_t *query_cache,
+               signal_t *interruptor) {
+    for (int i = 0; i < q->batch_size(); ++i) {
+        protob_t<Query> sub_query = make_counted_query();
+        sub_query->set_type(Query::START);
+        sub_query->set_token(q->token());
+        sub_query->set_accepts_r_json(q->accepts_r_json());
+        sub_query->set_accepts_r_serialized(q->accepts_r_serialized());
+        sub_query->mutable_global_optargs()->CopyFrom(q->global_optargs());
+        sub_query->mutable_query()->Swap(q->mutable_batch(i));
+
+        Response *sub_res = res->add_batch();
+        sub_res->set_token(q->token());
+        try {
+            scoped_ptr_t<query_cache_t::ref_t> query_ref =
+                query_cache->create(q->token(), sub_query, use_json, interruptor);
+            query_ref->fill_response(sub_res);
+            if (sub_res->type() == Response::SUCCESS_PARTIAL) {
+                // Nobody could `CONTINUE` the stream, so we don't start it.
+                query_cache->terminate_query(q->token());
+                sub_res->Clear();
+                sub_res->set_token(q->token());
+                fill_error(sub_res, Response::CLIENT_ERROR,
+                           "Queries in a batch cannot return partial sequences.",
+                           backtrace_t());
+            }
+        } catch (const exc_t &e) {
+            fill_error(sub_res, Response::RUNTIME_ERROR, e.what(), e.backtrace());
+        } catch (const datum_exc_t &e) {
+            fill_error(sub_res, Response::RUNTIME_ERROR, e.what(), backtrace_t());
+        } catch (const query_cache_exc_t &e) {
+            fill_error(sub_res, e.type, e.message, e.bt);
+        }
+    }
+    res->set_type(Response::SUCCESS_BATCH);
+}
+
 void run(query_id_t &&query_id,
          protob_t<Query> q,
          Response *res,
@@ -236,7 +280,9 @@ void run(query_id_t &&query_id,
 #endif // INSTRUMENT
 
     int64_t token = q->token();
-    use_json_t use_json = q->accepts_r_json() ? use_json_t::YES : use_json_t::NO;
+    use_json_t use_json = q->accepts_r_serialized()
+        ? use_json_t::SERIALIZED
+        : (q->accepts_r_json() ? use_json_t::YES : use_json_t::NO);
 
     try {
         switch (q->type()) {
@@ -260,6 +306,10 @@ void run(query_id_t &&query_id,
             query_cache->noreply_wait(query_id, token, interruptor);
             res->set_type(Response::WAIT_COMPLETE);
         } break;
+        case Query_QueryType_BATCH: {
+            maybe_release_query_id(std::move(query_id), q);
+            run_batch(q, use_json, res, query_cache, interruptor);
+        } break;
         default: unreachable();
         }
     } catch (const exc_t &e) {
@@ -5,6 +5,7 @@
 #include "rdb_protocol/error.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/op.hpp"
+#include "rdb_protocol/terms/terms.hpp"
 #include "stl_utils.hpp"
 
 #include "debug.hpp"
@@ -675,6 +676,9 @@ counted_t<term_t> make_slice_term(
 
 counted_t<term_t> make_limit_term(
     compile_env_t *env, const protob_t<const Term> &term) {
+    if (can_fuse_orderby_limit(*term)) {
+        return make_orderby_limit_term(env, term);
+    }
     return make_counted<limit_term_t>(env, term);
 }
 
@@ -560,12 +560,19 @@ class table_term_t : public op_term_t {
 public:
     table_term_t(compile_env_t *env, const protob_t<const Term> &term)
         : op_term_t(env, term, argspec_t(1, 2),
-          optargspec_t({ "use_outdated", "identifier_format" })) { }
+          optargspec_t({ "use_outdated", "identifier_format", "write_token" })) { }
 private:
     virtual scoped_ptr_t<val_t> eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
         scoped_ptr_t<val_t> t = args->optarg(env, "use_outdated");
         bool use_outdated = t ? t->as_bool() : false;
 
+        // A write token lets us read from any replica that has the writes in it.
+        boost::optional<write_versions_t> read_after;
+        if (scoped_ptr_t<val_t> v = args->optarg(env, "write_token")) {
+            read_after = parse_write_token(v->as_datum());
+            use_outdated = true;
+        }
+
         auto identifier_format =
             boost::make_optional<admin_identifier_format_t>(false, admin_identifier_format_t());
         if (scoped_ptr_t<val_t> v = args->optarg(env, "identifier_format")) {
@@ -599,6 +606,9 @@ private:
                 identifier_format, env->env->interruptor, &table, &error)) {
             rfail(base_exc_t::GENERIC, "%s", error.c_str());
         }
+        if (read_after) {
+            table->set_read_after(*read_after);
+        }
         return new_val(make_counted<table_t>(
             std::move(table), db, name.str(), use_outdated, backtrace()));
     }
@@ -642,15 +652,12 @@ private:
         counted_t<table_t> table = args->arg(env, 0)->as_table();
         scoped_ptr_t<val_t> index = args->optarg(env, "index");
         std::string index_str = index ? index->as_str().to_std() : table->get_pkey();
-        std::vector<counted_t<datum_stream_t> > streams;
+        std::vector<datum_t> keys;
         for (size_t i = 1; i < args->num_args(); ++i) {
-            datum_t key = get_key_arg(args->arg(env, i));
-            counted_t<datum_stream_t> seq =
-                table->get_all(env->env, key, index_str, backtrace());
-            streams.push_back(seq);
+            keys.push_back(get_key_arg(args->arg(env, i)));
         }
-        counted_t<datum_stream_t> stream = make_counted<union_datum_stream_t>(
-            env->env, std::move(streams), backtrace());
+        counted_t<datum_stream_t> stream =
+            table->get_all(env->env, keys, index_str, backtrace());
         return new_val(make_counted<selection_t>(table, stream));
     }
     virtual const char *name() const { return "get_all"; }
@@ -24,22 +24,30 @@ public:
                          PRId64 "`.", num_int));
         const size_t num = num_int;
         counted_t<table_t> t;
-        counted_t<datum_stream_t> seq;
         scoped_ptr_t<val_t> v = args->arg(env, 0);
 
-        if (v->get_type().is_convertible(val_t::type_t::SELECTION)) {
-            counted_t<selection_t> t_seq = v->as_selection(env->env);
-            t = t_seq->table;
-            seq = t_seq->seq;
-        } else {
-            seq = v->as_seq(env->env);
+        // A whole table is sampled by its shards, which don't have to read it all.
+        std::vector<datum_t> result;
+        bool sampled = false;
+        if (v->get_type().get_raw_type() == val_t::type_t::TABLE) {
+            t = v->as_table();
+            profile::starter_t starter("Sampling rows in the shards.", env->env->trace);
+            sampled = t->sample(env->env, num, &result);
         }
 
-        std::vector<datum_t> result;
-        result.reserve(num);
-        size_t element_number = 0;
-        batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
-        {
+        if (!sampled) {
+            counted_t<datum_stream_t> seq;
+            if (v->get_type().is_convertible(val_t::type_t::SELECTION)) {
+                counted_t<selection_t> t_seq = v->as_selection(env->env);
+                t = t_seq->table;
+                seq = t_seq->seq;
+            } else {
+                seq = v->as_seq(env->env);
+            }
+
+            result.reserve(num);
+            size_t element_number = 0;
+            batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
             profile::sampler_t sampler("Sampling elements.", env->env->trace);
             datum_t row;
             while (row = seq->next(env->env, batchspec), row.has()) {
@@ -276,6 +276,11 @@ counted_t<term_t> make_outer_join_term(
 }
 counted_t<term_t> make_eq_join_term(
     compile_env_t *env, const protob_t<const Term> &term) {
+    for (int i = 0; i < term->optargs_size(); ++i) {
+        if (term->optargs(i).key() == "right_key") {
+            return make_hash_join_term(env, term);
+        }
+    }
     return make_counted<eq_join_term_t>(env, term);
 }
 counted_t<term_t> make_update_term(
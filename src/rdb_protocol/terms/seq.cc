@@ -6,6 +6,7 @@
 #include <vector>
 
 #include "rdb_protocol/error.hpp"
+#include "rdb_protocol/filter_planner.hpp"
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/math_utils.hpp"
 #include "rdb_protocol/op.hpp"
@@ -279,6 +280,14 @@ private:
             defval = wire_func_t(default_filter_term->eval_to_func(env->scope));
         }
 
+        // A filter on a whole table may be able to read a range of a secondary
+        // index instead.  With a `default`, rows missing from the index could pass.
+        filter_index_plan_t plan;
+        if (v0->get_type().get_raw_type() == val_t::type_t::TABLE && !defval
+            && plan_filter_index(env->env, v0->as_table(), f, &plan)) {
+            v0 = new_val(v0->as_table_slice()->with_bounds(plan.sindex, plan.range));
+        }
+
         if (v0->get_type().is_convertible(val_t::type_t::SELECTION)) {
             counted_t<selection_t> ts = v0->as_selection(env->env);
             ts->seq->add_transformation(filter_wire_func_t(f, defval), backtrace());
@@ -377,8 +386,94 @@ class changes_term_t : public op_term_t {
 public:
     changes_term_t(compile_env_t *env, const protob_t<const Term> &term)
         : op_term_t(env, term, argspec_t(1),
-                    optargspec_t({"squash", "include_states"})) { }
+                    optargspec_t({"squash", "include_states",
+                                  "resumable", "resume_token"})),
+          reduction(grouped_reduction_t::COUNT) {
+        // `changes` on `group(...).count()`, `.sum(...)` and `.avg(...)` is
+        // maintained incrementally from a changefeed on the grouped sequence, so
+        // we compile the pieces of the reduction ourselves.
+        const Term &reduction_term = term->args(0);
+        grouped_reduction_t kind;
+        if (reduction_term.type() == Term::COUNT) {
+            kind = grouped_reduction_t::COUNT;
+        } else if (reduction_term.type() == Term::SUM) {
+            kind = grouped_reduction_t::SUM;
+        } else if (reduction_term.type() == Term::AVG) {
+            kind = grouped_reduction_t::AVG;
+        } else {
+            return;
+        }
+        // `count` with an argument filters rather than maps.
+        const int max_args = kind == grouped_reduction_t::COUNT ? 1 : 2;
+        if (reduction_term.optargs_size() != 0
+            || reduction_term.args_size() < 1
+            || reduction_term.args_size() > max_args) {
+            return;
+        }
+        const Term &group_term = reduction_term.args(0);
+        if (group_term.type() != Term::GROUP
+            || group_term.optargs_size() != 0
+            || group_term.args_size() < 2) {
+            return;
+        }
+        reduction = kind;
+        seq_term = compile_term(env, term.make_child(&group_term.args(0)));
+        for (int i = 1; i < group_term.args_size(); ++i) {
+            group_terms.push_back(
+                compile_term(env, term.make_child(&group_term.args(i))));
+        }
+        if (reduction_term.args_size() == 2) {
+            value_term = compile_term(env, term.make_child(&reduction_term.args(1)));
+        }
+    }
 private:
+    scoped_ptr_t<val_t> eval_grouped(scope_env_t *env,
+                                     const datum_t &squash,
+                                     bool include_states,
+                                     const changefeed::resume_t &resume) const {
+        rcheck(!include_states && !resume.resumable, base_exc_t::GENERIC,
+               "Cannot use `include_states`, `resumable` or `resume_token` "
+               "with changefeeds on grouped reductions.");
+        counted_t<datum_stream_t> seq = seq_term->eval(env)->as_seq(env->env);
+        std::vector<changefeed::keyspec_t> keyspecs = seq->get_change_specs();
+        r_sanity_check(keyspecs.size() >= 1);
+        rcheck(keyspecs.size() == 1
+               && boost::get<changefeed::keyspec_t::range_t>(&keyspecs[0].spec)
+                  != NULL,
+               base_exc_t::GENERIC,
+               "Changefeeds on grouped reductions are only supported on tables "
+               "and ranges of tables.");
+        boost::apply_visitor(rcheck_spec_visitor_t(env->env, backtrace()),
+                             keyspecs[0].spec);
+        counted_t<datum_stream_t> changes = keyspecs[0].table->read_changes(
+            env->env,
+            squash,
+            false,
+            changefeed::resume_t(),
+            std::move(keyspecs[0].spec),
+            backtrace(),
+            keyspecs[0].table_name);
+
+        std::vector<counted_t<const func_t> > group_funcs;
+        group_funcs.reserve(group_terms.size());
+        for (const auto &t : group_terms) {
+            group_funcs.push_back(t->eval(env)->as_func(GET_FIELD_SHORTCUT));
+        }
+        counted_t<const func_t> value_func;
+        if (value_term.has()) {
+            value_func = value_term->eval(env)->as_func(GET_FIELD_SHORTCUT);
+        }
+        return new_val(
+            env->env,
+            make_counted<grouped_changes_datum_stream_t>(
+                env->env->reql_version(),
+                std::move(group_funcs),
+                reduction,
+                std::move(value_func),
+                std::move(seq),
+                std::move(changes)));
+    }
+
     virtual scoped_ptr_t<val_t> eval_impl(
         scope_env_t *env, args_t *args, eval_flags_t) const {
 
@@ -399,12 +494,32 @@ private:
             include_states = v->as_bool();
         }
 
+        changefeed::resume_t resume;
+        if (scoped_ptr_t<val_t> v = args->optarg(env, "resumable")) {
+            resume.resumable = v->as_bool();
+        }
+        if (scoped_ptr_t<val_t> v = args->optarg(env, "resume_token")) {
+            resume.from = changefeed::parse_resume_token(v->as_datum());
+            resume.resumable = true;
+        }
+        // Squashed changes leave holes in the log that a token can't describe.
+        rcheck(!resume.resumable || squash == datum_t::boolean(false),
+               base_exc_t::GENERIC,
+               "Cannot combine `squash` with `resumable` or `resume_token`.");
+
+        if (seq_term.has()) {
+            return eval_grouped(env, squash, include_states, resume);
+        }
+
         scoped_ptr_t<val_t> v = args->arg(env, 0);
         if (v->get_type().is_convertible(val_t::type_t::SEQUENCE)) {
             counted_t<datum_stream_t> seq = v->as_seq(env->env);
             std::vector<counted_t<datum_stream_t> > streams;
             std::vector<changefeed::keyspec_t> keyspecs = seq->get_change_specs();
             r_sanity_check(keyspecs.size() >= 1);
+            rcheck(!resume.resumable || keyspecs.size() == 1,
+                   base_exc_t::GENERIC,
+                   "Cannot resume changefeeds on a union of selections.");
             for (auto &&keyspec : keyspecs) {
                 boost::apply_visitor(rcheck_spec_visitor_t(env->env, backtrace()),
                                      keyspec.spec);
@@ -413,6 +528,7 @@ private:
                         env->env,
                         squash,
                         include_states,
+                        resume,
                         std::move(keyspec.spec),
                         backtrace(),
                         keyspec.table_name));
@@ -426,6 +542,8 @@ private:
                         env->env, std::move(streams), backtrace()));
             }
         } else if (v->get_type().is_convertible(val_t::type_t::SINGLE_SELECTION)) {
+            rcheck(!resume.resumable, base_exc_t::GENERIC,
+                   "Only changefeeds on tables and ranges of tables can be resumed.");
             return new_val(
                 env->env,
                 v->as_single_selection()->read_changes(squash, include_states));
@@ -435,6 +553,12 @@ private:
               ".changes() not yet supported on range selections");
     }
     virtual const char *name() const { return "changes"; }
+
+    // Only set for `changes` on a grouped reduction.
+    grouped_reduction_t reduction;
+    counted_t<const term_t> seq_term;
+    std::vector<counted_t<const term_t> > group_terms;
+    counted_t<const term_t> value_term;
 };
 
 class minval_term_t final : public op_term_t {
@@ -573,6 +697,30 @@ private:
     virtual const char *name() const { return "range"; }
 };
 
+// `eq_join` with a `right_key` joins on a field of the right sequence instead of
+// its primary key or a secondary index.  The right sequence is read into a hash
+// table once, rather than doing a `get_all` for every left row.
+class hash_join_term_t : public op_term_t {
+public:
+    hash_join_term_t(compile_env_t *env, const protob_t<const Term> &term)
+        : op_term_t(env, term, argspec_t(3), optargspec_t({"index", "right_key"})) { }
+private:
+    virtual scoped_ptr_t<val_t> eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
+        rcheck(!args->optarg(env, "index"), base_exc_t::GENERIC,
+               "Cannot use both `index` and `right_key` in `eq_join`.");
+        counted_t<datum_stream_t> left = args->arg(env, 0)->as_seq(env->env);
+        counted_t<const func_t> left_key =
+            args->arg(env, 1)->as_func(GET_FIELD_SHORTCUT);
+        counted_t<datum_stream_t> right = args->arg(env, 2)->as_seq(env->env);
+        counted_t<const func_t> right_key =
+            args->optarg(env, "right_key")->as_func(GET_FIELD_SHORTCUT);
+        return new_val(env->env, make_counted<hash_join_datum_stream_t>(
+            env->env, std::move(left), std::move(left_key),
+            std::move(right), std::move(right_key), backtrace()));
+    }
+    virtual const char *name() const { return "eq_join"; }
+};
+
 counted_t<term_t> make_minval_term(
     compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<minval_term_t>(env, term);
@@ -647,4 +795,9 @@ counted_t<term_t> make_range_term(
     return make_counted<range_term_t>(env, term);
 }
 
+counted_t<term_t> make_hash_join_term(
+    compile_env_t *env, const protob_t<const Term> &term) {
+    return make_counted<hash_join_term_t>(env, term);
+}
+
 } // namespace ql
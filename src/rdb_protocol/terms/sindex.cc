@@ -18,7 +18,8 @@ namespace ql {
 class sindex_create_term_t : public op_term_t {
 public:
     sindex_create_term_t(compile_env_t *env, const protob_t<const Term> &term)
-        : op_term_t(env, term, argspec_t(2, 3), optargspec_t({"multi", "geo"})) { }
+        : op_term_t(env, term, argspec_t(2, 3),
+                    optargspec_t({"multi", "geo", "points_only", "store_document"})) { }
 
     virtual scoped_ptr_t<val_t> eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
         counted_t<table_t> table = args->arg(env, 0)->as_table();
@@ -32,6 +33,7 @@ public:
         /* Check if we're doing a multi index or a normal index. */
         sindex_multi_bool_t multi = sindex_multi_bool_t::SINGLE;
         sindex_geo_bool_t geo = sindex_geo_bool_t::REGULAR;
+        sindex_values_bool_t values = sindex_values_bool_t::DOCUMENT;
         counted_t<const func_t> index_func;
         if (args->num_args() == 3) {
             scoped_ptr_t<val_t> v = args->arg(env, 2);
@@ -55,6 +57,7 @@ public:
                         deserialize_sindex_info(vec, &sindex_info);
                         multi = sindex_info.multi;
                         geo = sindex_info.geo;
+                        values = sindex_info.values;
                     } catch (const archive_exc_t &e) {
                         rfail(base_exc_t::GENERIC,
                               "Binary blob passed to index create could not "
@@ -98,8 +101,30 @@ public:
                 ? sindex_geo_bool_t::GEO
                 : sindex_geo_bool_t::REGULAR;
         }
+        /* Should a geo index only hold points? */
+        if (scoped_ptr_t<val_t> points_val = args->optarg(env, "points_only")) {
+            if (points_val->as_bool()) {
+                rcheck(geo != sindex_geo_bool_t::REGULAR,
+                       base_exc_t::GENERIC,
+                       "`points_only` requires a geospatial index (`geo=true`).");
+                geo = sindex_geo_bool_t::GEO_POINTS;
+            } else if (geo == sindex_geo_bool_t::GEO_POINTS) {
+                geo = sindex_geo_bool_t::GEO;
+            }
+        }
+        /* Should the index entries hold copies of their rows? */
+        if (scoped_ptr_t<val_t> store_val = args->optarg(env, "store_document")) {
+            values = store_val->as_bool()
+                ? sindex_values_bool_t::DOCUMENT
+                : sindex_values_bool_t::PRIMARY_KEY;
+        }
+        rcheck(geo == sindex_geo_bool_t::REGULAR
+               || values == sindex_values_bool_t::DOCUMENT,
+               base_exc_t::GENERIC,
+               "Geospatial indexes must store their documents.");
 
-        bool success = table->sindex_create(env->env, name, index_func, multi, geo);
+        bool success = table->sindex_create(env->env, name, index_func, multi, geo,
+                                            values);
 
         if (success) {
             datum_object_builder_t res;
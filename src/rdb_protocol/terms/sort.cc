@@ -1,6 +1,7 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/terms.hpp"
 
+#include <algorithm>
 #include <string>
 #include <utility>
 
@@ -13,6 +14,7 @@
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/op.hpp"
 #include "rdb_protocol/pb_utils.hpp"
+#include "rdb_protocol/query_memory.hpp"
 #include "rdb_protocol/term_walker.hpp"
 
 namespace ql {
@@ -51,7 +53,15 @@ class orderby_term_t : public op_term_t {
 public:
     orderby_term_t(compile_env_t *env, const protob_t<const Term> &term)
         : op_term_t(env, term, argspec_t(1, -1),
-          optargspec_t({"index"})), src_term(term) { }
+          optargspec_t({"index"})), src_term(term), fused_limit(false) { }
+    // For `order_by(...).limit(n)`, `term` is the `order_by` term with `n` appended
+    // to its arguments (see `make_orderby_limit_term`), and `_limit_bt` is the
+    // backtrace of the `limit` term.
+    orderby_term_t(compile_env_t *env, const protob_t<const Term> &term,
+                   const protob_t<const Backtrace> &_limit_bt)
+        : op_term_t(env, term, argspec_t(3, -1),
+          optargspec_t({"index"})), src_term(term), fused_limit(true),
+          limit_bt(_limit_bt) { }
 private:
     enum order_direction_t { ASC, DESC };
     class lt_cmp_t {
@@ -104,15 +114,137 @@ private:
             return false;
         }
 
+        // Sorts `*data` the same way `std::stable_sort` with this comparator would,
+        // but calls the functions only once per row: it builds a sort key for each
+        // row out of the values' `datum_t::append_sort_key` encodings (inverted for
+        // `DESC`) and sorts the keys.  Returns false, leaving `*data` alone, if some
+        // value has no sort key or the query uses the v1.13 ordering.
+        bool sort_by_keys(env_t *env,
+                          profile::sampler_t *sampler,
+                          std::vector<datum_t> *data) const {
+            if (data->size() < 2 || env->reql_version() == reql_version_t::v1_13) {
+                return false;
+            }
+            std::vector<std::pair<std::string, size_t> > keys;
+            keys.reserve(data->size());
+            for (size_t i = 0; i < data->size(); ++i) {
+                sampler->new_sample();
+                std::string key;
+                for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+                    datum_t val;
+                    try {
+                        val = it->second->call(env, (*data)[i])->as_datum();
+                    } catch (const base_exc_t &e) {
+                        if (e.get_type() != base_exc_t::NON_EXISTENCE) {
+                            throw;
+                        }
+                    }
+                    const size_t start = key.size();
+                    if (!val.has()) {
+                        // Missing values sort first, before any sort key.
+                        key.push_back('\0');
+                    } else if (!val.append_sort_key(&key)) {
+                        return false;
+                    }
+                    if (it->first == DESC) {
+                        for (size_t j = start; j < key.size(); ++j) {
+                            key[j] = ~key[j];
+                        }
+                    }
+                }
+                keys.push_back(std::make_pair(std::move(key), i));
+            }
+            // Ties are broken by the original position, which keeps the sort stable.
+            std::sort(keys.begin(), keys.end());
+            std::vector<datum_t> sorted;
+            sorted.reserve(data->size());
+            for (const auto &pair : keys) {
+                sorted.push_back(std::move((*data)[pair.second]));
+            }
+            *data = std::move(sorted);
+            return true;
+        }
+
     private:
         const std::vector<std::pair<order_direction_t, counted_t<const func_t> > >
             comparisons;
     };
 
+    // Only the first `n` rows are needed, so every shard picks its own first rows
+    // and we merge them, instead of sorting the whole sequence.
+    counted_t<datum_stream_t> sort_first_n(
+            scope_env_t *env,
+            const counted_t<datum_stream_t> &seq,
+            const std::vector<std::pair<order_direction_t, counted_t<const func_t> > >
+                &comparisons,
+            size_t n) const {
+        std::vector<std::pair<wire_func_t, bool> > keys;
+        for (auto it = comparisons.begin(); it != comparisons.end(); ++it) {
+            keys.push_back(std::make_pair(wire_func_t(it->second), it->first == DESC));
+        }
+        scoped_ptr_t<val_t> top = seq->run_terminal(
+            env->env, top_k_wire_func_t(std::move(keys), n, backtrace()));
+        return make_counted<array_datum_stream_t>(top->as_datum(), backtrace());
+    }
+
+    counted_t<datum_stream_t> sort_all(scope_env_t *env,
+                                       const counted_t<datum_stream_t> &seq,
+                                       const lt_cmp_t &lt_cmp) const {
+        // Sequences that don't fit into an array, or into the query's memory
+        // limit, get sorted in runs of at most that size, which are spilled to disk
+        // and merged lazily.
+        const bool can_spill = external_sort_datum_stream_t::can_spill(env->env);
+        const size_t run_size = env->env->limits().array_size_limit();
+        counted_t<external_sort_datum_stream_t> external_sort;
+        std::vector<datum_t> to_sort;
+        query_memory_charge_t memory;
+        batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
+        for (;;) {
+            std::vector<datum_t> data
+                = seq->next_batch(env->env, batchspec);
+            if (data.size() == 0) {
+                break;
+            }
+            bool out_of_memory = false;
+            for (const datum_t &d : data) {
+                if (can_spill) {
+                    out_of_memory = !memory.try_add(env->env, d) || out_of_memory;
+                } else {
+                    memory.add(env->env, d);
+                }
+            }
+            std::move(data.begin(), data.end(), std::back_inserter(to_sort));
+            if (can_spill && (to_sort.size() > run_size || out_of_memory)) {
+                if (!external_sort.has()) {
+                    external_sort = make_counted<external_sort_datum_stream_t>(
+                        lt_cmp, backtrace());
+                }
+                external_sort->add_run(env->env, std::move(to_sort));
+                to_sort.clear();
+                memory.reset();
+            } else {
+                rcheck_array_size(to_sort, env->env->limits(), base_exc_t::GENERIC);
+            }
+        }
+        if (external_sort.has()) {
+            external_sort->add_run(env->env, std::move(to_sort));
+            return external_sort;
+        }
+        profile::sampler_t sampler("Sorting in-memory.", env->env->trace);
+        if (!lt_cmp.sort_by_keys(env->env, &sampler, &to_sort)) {
+            auto fn = boost::bind(lt_cmp, env->env, &sampler, _1, _2);
+            std::stable_sort(to_sort.begin(), to_sort.end(), fn);
+        }
+        return make_counted<array_datum_stream_t>(
+            datum_t(std::move(to_sort), env->env->limits()),
+            backtrace());
+    }
+
     virtual scoped_ptr_t<val_t>
     eval_impl(scope_env_t *env, args_t *args, eval_flags_t) const {
         std::vector<std::pair<order_direction_t, counted_t<const func_t> > > comparisons;
-        for (size_t i = 1; i < args->num_args(); ++i) {
+        const size_t num_keys_end = args->num_args() - (fused_limit ? 1 : 0);
+        for (size_t i = 1; i < num_keys_end; ++i) {
             if (get_src()->args(i).type() == Term::DESC) {
                 comparisons.push_back(
                     std::make_pair(
@@ -138,6 +270,16 @@ private:
             seq = v0->as_seq(env->env);
         }
 
+        int32_t limit = -1;
+        bool limit_applied = false;
+        if (fused_limit) {
+            scoped_ptr_t<val_t> limit_arg = args->arg(env, num_keys_end);
+            limit = limit_arg->as_int<int32_t>();
+            rcheck_src(limit_bt.get(), limit >= 0, base_exc_t::GENERIC,
+                       strprintf("LIMIT takes a non-negative argument (got %d)",
+                                 limit));
+        }
+
         scoped_ptr_t<val_t> index = args->optarg(env, "index");
         if (seq.has() && seq->is_exhausted()){
             /* Do nothing for empty sequence */
@@ -176,23 +318,17 @@ private:
             }
             rcheck(!comparisons.empty(), base_exc_t::GENERIC,
                    "Must specify something to order by.");
-            std::vector<datum_t> to_sort;
-            batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
-            for (;;) {
-                std::vector<datum_t> data
-                    = seq->next_batch(env->env, batchspec);
-                if (data.size() == 0) {
-                    break;
-                }
-                std::move(data.begin(), data.end(), std::back_inserter(to_sort));
-                rcheck_array_size(to_sort, env->env->limits(), base_exc_t::GENERIC);
+            if (fused_limit && !seq->is_grouped()
+                && static_cast<size_t>(limit)
+                   <= env->env->limits().array_size_limit()) {
+                seq = sort_first_n(env, seq, comparisons, limit);
+                limit_applied = true;
+            } else {
+                seq = sort_all(env, seq, lt_cmp);
             }
-            profile::sampler_t sampler("Sorting in-memory.", env->env->trace);
-            auto fn = boost::bind(lt_cmp, env->env, &sampler, _1, _2);
-            std::stable_sort(to_sort.begin(), to_sort.end(), fn);
-            seq = make_counted<array_datum_stream_t>(
-                datum_t(std::move(to_sort), env->env->limits()),
-                backtrace());
+        }
+        if (fused_limit && !limit_applied) {
+            seq = seq->slice(0, limit);
         }
         return tbl_slice.has()
             ? new_val(make_counted<selection_t>(tbl_slice->get_tbl(), seq))
@@ -203,6 +339,8 @@ private:
 
 private:
     protob_t<const Term> src_term;
+    const bool fused_limit;
+    const protob_t<const Backtrace> limit_bt;
 };
 
 class distinct_term_t : public op_term_t {
@@ -247,28 +385,90 @@ private:
         // in ascending order.
         std::set<datum_t, optional_datum_less_t>
             results(optional_datum_less_t(env->env->reql_version()));
+        // If there are more distinct values than the array size limit, they are
+        // spilled to disk as sorted runs like in `orderby`, and the merge of the
+        // runs drops the values that more than one run has.
+        const bool can_spill = external_sort_datum_stream_t::can_spill(env->env);
+        const size_t run_size = env->env->limits().array_size_limit();
+        counted_t<external_sort_datum_stream_t> external_sort;
+        query_memory_charge_t memory;
         batchspec_t batchspec = batchspec_t::user(batch_type_t::TERMINAL, env->env);
         {
             profile::sampler_t sampler("Evaluating elements in distinct.",
                                        env->env->trace);
             datum_t d;
             while (d = s->next(env->env, batchspec), d.has()) {
+                // Duplicates are charged too, which overestimates a little.
+                bool out_of_memory = false;
+                if (can_spill) {
+                    out_of_memory = !memory.try_add(env->env, d);
+                } else {
+                    memory.add(env->env, d);
+                }
                 results.insert(std::move(d));
-                rcheck_array_size(results, env->env->limits(), base_exc_t::GENERIC);
+                if (can_spill && (results.size() > run_size || out_of_memory)) {
+                    if (!external_sort.has()) {
+                        external_sort = make_counted<external_sort_datum_stream_t>(
+                            &distinct_lt, backtrace());
+                    }
+                    external_sort->add_run(
+                        env->env, std::vector<datum_t>(results.begin(), results.end()));
+                    results.clear();
+                    memory.reset();
+                } else {
+                    rcheck_array_size(results, env->env->limits(), base_exc_t::GENERIC);
+                }
                 sampler.new_sample();
             }
         }
+        if (external_sort.has()) {
+            external_sort->add_run(
+                env->env, std::vector<datum_t>(results.begin(), results.end()));
+            return new_val(env->env, external_sort->ordered_distinct());
+        }
         std::vector<datum_t> toret;
         std::move(results.begin(), results.end(), std::back_inserter(toret));
         return new_val(datum_t(std::move(toret), env->env->limits()));
     }
 
+    static bool distinct_lt(env_t *env, profile::sampler_t *,
+                            const datum_t &l, const datum_t &r) {
+        return l.compare_lt(env->reql_version(), r);
+    }
+
     virtual const char *name() const { return "distinct"; }
 };
 
 counted_t<term_t> make_orderby_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<orderby_term_t>(env, term);
 }
+bool can_fuse_orderby_limit(const Term &limit_term) {
+    if (limit_term.args_size() != 2 || limit_term.optargs_size() != 0) {
+        return false;
+    }
+    const Term &orderby_term = limit_term.args(0);
+    if (orderby_term.type() != Term::ORDER_BY || orderby_term.args_size() < 2) {
+        return false;
+    }
+    for (int i = 0; i < orderby_term.optargs_size(); ++i) {
+        if (orderby_term.optargs(i).key() == "index") {
+            return false;
+        }
+    }
+    // With `r.args` we can't tell which argument is the limit.
+    for (int i = 0; i < orderby_term.args_size(); ++i) {
+        if (orderby_term.args(i).type() == Term::ARGS) {
+            return false;
+        }
+    }
+    return limit_term.args(1).type() != Term::ARGS;
+}
+counted_t<term_t> make_orderby_limit_term(compile_env_t *env,
+                                          const protob_t<const Term> &term) {
+    protob_t<Term> fused = make_counted_term_copy(term->args(0));
+    *fused->add_args() = term->args(1);
+    return make_counted<orderby_term_t>(env, fused, get_backtrace(term));
+}
 counted_t<term_t> make_distinct_term(compile_env_t *env, const protob_t<const Term> &term) {
     return make_counted<distinct_term_t>(env, term);
 }
@@ -1,6 +1,11 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "rdb_protocol/terms/terms.hpp"
 
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
 #include <re2/re2.h>
 
 #include "rdb_protocol/error.hpp"
@@ -20,6 +25,9 @@ private:
         regex_cache_t &cache = env->env->regex_cache();
         auto search = cache.regexes.find(re);
         if (search == cache.regexes.end()) {
+            if (cache.stats != NULL) {
+                ++cache.stats->regex_cache_misses;
+            }
             regexp.reset(new re2::RE2(re, re2::RE2::Quiet));
             if (!regexp->ok()) {
                 rfail(base_exc_t::GENERIC,
@@ -30,6 +38,9 @@ private:
             }
             cache.regexes[re] = regexp;
         } else {
+            if (cache.stats != NULL) {
+                ++cache.stats->regex_cache_hits;
+            }
             regexp = search->second;
         }
         r_sanity_check(static_cast<bool>(regexp));
@@ -80,6 +91,35 @@ private:
 
 const char *const splitchars = " \t\n\r\x0B\x0C";
 
+// A lookup table for `splitchars`, so that splitting on whitespace doesn't compare
+// every byte against each of them.
+class splitchar_table_t {
+public:
+    splitchar_table_t() {
+        memset(is_splitchar, 0, sizeof(is_splitchar));
+        for (const char *c = splitchars; *c != '\0'; ++c) {
+            is_splitchar[static_cast<uint8_t>(*c)] = true;
+        }
+    }
+
+    // The position of the first byte at or after `pos` that is (or, if `want` is
+    // false, isn't) one of `splitchars`, or `std::string::npos`.
+    size_t find(const std::string &s, size_t pos, bool want) const {
+        const char *data = s.data();
+        for (size_t i = pos; i < s.size(); ++i) {
+            if (is_splitchar[static_cast<uint8_t>(data[i])] == want) {
+                return i;
+            }
+        }
+        return std::string::npos;
+    }
+
+private:
+    bool is_splitchar[256];
+};
+
+const splitchar_table_t splitchar_table;
+
 class split_term_t : public op_term_t {
 public:
     split_term_t(compile_env_t *env, const protob_t<const Term> &term)
@@ -115,16 +155,22 @@ private:
                 ? std::string::npos
                 : (delim
                    ? (delim->size() == 0 ? last + 1 : s.find(*delim, last))
-                   : s.find_first_of(splitchars, last));
-            std::string tmp;
+                   : splitchar_table.find(s, last, true));
+            // The piece is [start, end), which we copy straight into the datum.
+            size_t start, end;
             if (next == std::string::npos) {
-                size_t start = delim ? last : s.find_first_not_of(splitchars, last);
-                tmp = start == std::string::npos ? "" : s.substr(start);
+                start = delim ? last : splitchar_table.find(s, last, false);
+                if (start == std::string::npos) {
+                    start = end = 0;
+                } else {
+                    end = s.size();
+                }
             } else {
-                tmp = s.substr(last, next - last);
+                start = last;
+                end = std::min(next, s.size());
             }
-            if ((delim && delim->size() != 0) || tmp.size() != 0) {
-                res.push_back(datum_t(datum_string_t(tmp)));
+            if ((delim && delim->size() != 0) || end != start) {
+                res.push_back(datum_t(datum_string_t(end - start, s.data() + start)));
             }
             last = (next == std::string::npos || next >= s.size())
                 ? std::string::npos
@@ -264,6 +264,8 @@ counted_t<term_t> make_zip_term(
     compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_range_term(
     compile_env_t *env, const protob_t<const Term> &term);
+counted_t<term_t> make_hash_join_term(
+    compile_env_t *env, const protob_t<const Term> &term);
 
 // sindex.cc
 counted_t<term_t> make_sindex_create_term(
@@ -282,6 +284,11 @@ counted_t<term_t> make_sindex_rename_term(
 // sort.cc
 counted_t<term_t> make_orderby_term(
     compile_env_t *env, const protob_t<const Term> &term);
+// Whether `limit_term` is a `limit` of an unindexed `order_by` that can be
+// compiled into a single term by `make_orderby_limit_term`.
+bool can_fuse_orderby_limit(const Term &limit_term);
+counted_t<term_t> make_orderby_limit_term(
+    compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_distinct_term(
     compile_env_t *env, const protob_t<const Term> &term);
 counted_t<term_t> make_asc_term(
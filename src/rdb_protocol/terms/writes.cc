@@ -61,7 +61,7 @@ public:
     insert_term_t(compile_env_t *env, const protob_t<const Term> &term)
         : op_term_t(env, term, argspec_t(2),
                     optargspec_t({"conflict", "durability", "return_vals",
-                                  "return_changes"})) { }
+                                  "return_changes", "return_write_token"})) { }
 
 private:
     static void maybe_generate_key(counted_t<table_t> tbl,
@@ -115,6 +115,10 @@ private:
             = parse_conflict_optarg(args->optarg(env, "conflict"));
         const durability_requirement_t durability_requirement
             = parse_durability_optarg(args->optarg(env, "durability"));
+        bool return_write_token = false;
+        if (scoped_ptr_t<val_t> v = args->optarg(env, "return_write_token")) {
+            return_write_token = v->as_bool();
+        }
 
         bool done = false;
         datum_t stats = new_stats_object();
@@ -201,6 +205,10 @@ private:
                           keys_skipped + generated_keys.size(),
                           generated_keys.size()).c_str(), env->env->limits());
         }
+        if (return_write_token) {
+            obj.overwrite("write_token",
+                          write_versions_to_datum(t->tbl->get_write_versions()));
+        }
 
         return new_val(std::move(obj).to_datum());
     }
@@ -211,8 +219,8 @@ class replace_term_t : public op_term_t {
 public:
     replace_term_t(compile_env_t *env, const protob_t<const Term> &term)
         : op_term_t(env, term, argspec_t(2),
-                    optargspec_t({"non_atomic", "durability",
-                                  "return_vals", "return_changes"})) { }
+                    optargspec_t({"non_atomic", "durability", "return_vals",
+                                  "return_changes", "return_write_token"})) { }
 
 private:
     virtual scoped_ptr_t<val_t> eval_impl(
@@ -232,6 +240,10 @@ private:
 
         const durability_requirement_t durability_requirement
             = parse_durability_optarg(args->optarg(env, "durability"));
+        bool return_write_token = false;
+        if (scoped_ptr_t<val_t> v = args->optarg(env, "return_write_token")) {
+            return_write_token = v->as_bool();
+        }
 
         counted_t<const func_t> f = args->arg(env, 1)->as_func(CONSTANT_SHORTCUT);
         if (!nondet_ok) {
@@ -241,8 +253,10 @@ private:
         scoped_ptr_t<val_t> v0 = args->arg(env, 0);
         datum_t stats = new_stats_object();
         std::set<std::string> conditions;
+        counted_t<table_t> written_table;
         if (v0->get_type().is_convertible(val_t::type_t::SINGLE_SELECTION)) {
             counted_t<single_selection_t> sel = v0->as_single_selection();
+            written_table = sel->get_tbl();
             datum_t replace_stats = sel->replace(
                 f, nondet_ok, durability_requirement, return_changes);
             stats = stats.merge(replace_stats, stats_merge, env->env->limits(),
@@ -251,6 +265,7 @@ private:
             counted_t<selection_t> tblrows = v0->as_selection(env->env);
             counted_t<table_t> tbl = tblrows->table;
             counted_t<datum_stream_t> ds = tblrows->seq;
+            written_table = tbl;
 
             if (f->is_deterministic()) {
                 // Attach a transformation to `ds` to pull out the primary key.
@@ -289,6 +304,10 @@ private:
 
         datum_object_builder_t obj(stats);
         obj.add_warnings(conditions, env->env->limits());
+        if (return_write_token) {
+            obj.overwrite("write_token", write_versions_to_datum(
+                written_table->tbl->get_write_versions()));
+        }
         return new_val(std::move(obj).to_datum());
     }
 
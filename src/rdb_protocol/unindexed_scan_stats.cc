@@ -0,0 +1,49 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/unindexed_scan_stats.hpp"
+
+#include "arch/runtime/runtime.hpp"
+
+void unindexed_scan_stats_t::record(const std::string &field,
+                                    uint64_t rows_scanned,
+                                    uint64_t rows_returned) {
+    assert_thread();
+    auto it = fields.find(field);
+    if (it == fields.end()) {
+        if (fields.size() >= UNINDEXED_SCAN_MAX_FIELDS) {
+            return;
+        }
+        it = fields.insert(std::make_pair(field, field_stats_t())).first;
+    }
+    ++it->second.reads;
+    it->second.rows_scanned += rows_scanned;
+    it->second.rows_returned += rows_returned;
+}
+
+void *unindexed_scan_stats_t::begin_stats() {
+    return new std::map<std::string, field_stats_t>;
+}
+
+void unindexed_scan_stats_t::visit_stats(void *ptr) {
+    if (get_thread_id() == home_thread()) {
+        *reinterpret_cast<std::map<std::string, field_stats_t> *>(ptr) = fields;
+    }
+}
+
+ql::datum_t unindexed_scan_stats_t::end_stats(void *ptr) {
+    std::map<std::string, field_stats_t> *copy =
+        reinterpret_cast<std::map<std::string, field_stats_t> *>(ptr);
+    ql::datum_object_builder_t builder;
+    for (const auto &pair : *copy) {
+        ql::datum_object_builder_t field_builder;
+        field_builder.overwrite("reads",
+            ql::datum_t(static_cast<double>(pair.second.reads)));
+        field_builder.overwrite("rows_scanned",
+            ql::datum_t(static_cast<double>(pair.second.rows_scanned)));
+        field_builder.overwrite("rows_returned",
+            ql::datum_t(static_cast<double>(pair.second.rows_returned)));
+        builder.overwrite(datum_string_t(pair.first),
+                          std::move(field_builder).to_datum());
+    }
+    delete copy;
+    return std::move(builder).to_datum();
+}
@@ -0,0 +1,49 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RDB_PROTOCOL_UNINDEXED_SCAN_STATS_HPP_
+#define RDB_PROTOCOL_UNINDEXED_SCAN_STATS_HPP_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include "perfmon/core.hpp"
+
+/* A store remembers at most this many different fields. Fields that show up after
+that are not recorded. */
+#define UNINDEXED_SCAN_MAX_FIELDS 64
+
+/* `unindexed_scan_stats_t` records which fields the `filter`s of a store's range reads
+on the primary index compare to a single value, and how many rows those reads looked
+at and returned. A field that is filtered on often, and that filters out most of the
+rows that are looked at, is a good candidate for a secondary index; the `table` rows
+of `rethinkdb.stats` list them as `index_suggestions`.
+
+It reports an object like `{"user.name": {reads: 12, rows_scanned: 12000,
+rows_returned: 30}}`, where the keys are the fields' paths joined by dots. */
+class unindexed_scan_stats_t : public perfmon_t, public home_thread_mixin_t {
+public:
+    unindexed_scan_stats_t() { }
+
+    void record(const std::string &field,
+                uint64_t rows_scanned,
+                uint64_t rows_returned);
+
+    void *begin_stats();
+    void visit_stats(void *);
+    ql::datum_t end_stats(void *);
+
+private:
+    struct field_stats_t {
+        field_stats_t() : reads(0), rows_scanned(0), rows_returned(0) { }
+        uint64_t reads;
+        uint64_t rows_scanned;
+        uint64_t rows_returned;
+    };
+
+    std::map<std::string, field_stats_t> fields;
+
+    DISABLE_COPYING(unindexed_scan_stats_t);
+};
+
+#endif  // RDB_PROTOCOL_UNINDEXED_SCAN_STATS_HPP_
@@ -36,6 +36,7 @@ public:
             env,
             squash,
             include_states,
+            changefeed::resume_t(),
             changefeed::keyspec_t::point_t{key},
             bt,
             tbl->display_name());
@@ -86,6 +87,7 @@ public:
             env,
             squash,
             include_states,
+            changefeed::resume_t(),
             std::move(spec),
             bt,
             slice->get_tbl()->display_name());
@@ -305,9 +307,10 @@ MUST_USE bool table_t::sindex_create(env_t *env,
                                      const std::string &id,
                                      counted_t<const func_t> index_func,
                                      sindex_multi_bool_t multi,
-                                     sindex_geo_bool_t geo) {
+                                     sindex_geo_bool_t geo,
+                                     sindex_values_bool_t values) {
     index_func->assert_deterministic("Index functions must be deterministic.");
-    return tbl->sindex_create(env, id, index_func, multi, geo);
+    return tbl->sindex_create(env, id, index_func, multi, geo, values);
 }
 
 MUST_USE bool table_t::sindex_drop(env_t *env, const std::string &id) {
@@ -377,17 +380,46 @@ datum_t table_t::get_row(env_t *env, datum_t pval) {
 
 counted_t<datum_stream_t> table_t::get_all(
         env_t *env,
-        datum_t value,
+        const std::vector<datum_t> &values,
         const std::string &get_all_sindex_id,
         const protob_t<const Backtrace> &bt) {
-    return tbl->read_all(
-        env,
-        get_all_sindex_id,
-        bt,
-        display_name(),
-        datum_range_t(value),
-        sorting_t::UNORDERED,
-        use_outdated);
+    std::vector<counted_t<datum_stream_t> > streams;
+    std::vector<datum_t> rows;
+    if (values.size() > 1
+        && get_all_sindex_id == get_pkey()
+        && tbl->read_rows(env, values, use_outdated, &rows)) {
+        // The rows were all read at once, but every key still gets its own stream so
+        // that `changes` can subscribe to each of them, like below.
+        for (size_t i = 0; i < values.size(); ++i) {
+            std::vector<datum_t> row;
+            if (rows[i].get_type() != datum_t::R_NULL) {
+                row.push_back(std::move(rows[i]));
+            }
+            streams.push_back(make_counted<vector_datum_stream_t>(
+                bt,
+                std::move(row),
+                changefeed::keyspec_t(
+                    changefeed::keyspec_t::range_t{
+                        std::vector<transform_variant_t>(),
+                        boost::none,
+                        sorting_t::UNORDERED,
+                        datum_range_t(values[i])},
+                    counted_t<base_table_t>(tbl),
+                    display_name())));
+        }
+    } else {
+        for (const datum_t &value : values) {
+            streams.push_back(tbl->read_all(
+                env,
+                get_all_sindex_id,
+                bt,
+                display_name(),
+                datum_range_t(value),
+                sorting_t::UNORDERED,
+                use_outdated));
+        }
+    }
+    return make_counted<union_datum_stream_t>(env, std::move(streams), bt);
 }
 
 counted_t<datum_stream_t> table_t::get_intersecting(
@@ -426,6 +458,10 @@ datum_t table_t::get_nearest(
         limits);
 }
 
+bool table_t::sample(env_t *env, uint64_t num, std::vector<datum_t> *rows_out) {
+    return tbl->read_sample(env, num, use_outdated, rows_out);
+}
+
 val_t::type_t::type_t(val_t::type_t::raw_type_t _raw_type) : raw_type(_raw_type) { }
 
 // NOTE: This *MUST* be kept in sync with the surrounding code (not that it
@@ -36,10 +36,12 @@ public:
             bool use_outdated, const protob_t<const Backtrace> &src);
     ql::datum_t get_id() const;
     const std::string &get_pkey() const;
+    bool use_outdated_reads() const { return use_outdated; }
     datum_t get_row(env_t *env, datum_t pval);
+    // The union of the rows that have any of `values` in the index.
     counted_t<datum_stream_t> get_all(
             env_t *env,
-            datum_t value,
+            const std::vector<datum_t> &values,
             const std::string &sindex_id,
             const protob_t<const Backtrace> &bt);
     counted_t<datum_stream_t> get_intersecting(
@@ -56,6 +58,8 @@ public:
             dist_unit_t dist_unit,
             const std::string &new_sindex_id,
             const configured_limits_t &limits);
+    // Returns false if the table can't be sampled without reading all of it.
+    bool sample(env_t *env, uint64_t num, std::vector<datum_t> *rows_out);
 
     datum_t make_error_datum(const base_exc_t &exception);
 
@@ -79,7 +83,7 @@ public:
     MUST_USE bool sindex_create(
         env_t *env, const std::string &name,
         counted_t<const func_t> index_func, sindex_multi_bool_t multi,
-        sindex_geo_bool_t geo);
+        sindex_geo_bool_t geo, sindex_values_bool_t values);
     MUST_USE bool sindex_drop(env_t *env, const std::string &name);
     MUST_USE sindex_rename_result_t sindex_rename(
         env_t *env, const std::string &old_name,
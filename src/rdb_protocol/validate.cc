@@ -55,6 +55,13 @@ void validate_pb(const Query &q) {
     } else {
         check_not_has(q, has_query, "query");
     }
+    if (q.type() == Query::BATCH) {
+        for (int i = 0; i < q.batch_size(); ++i) {
+            validate_pb(q.batch(i));
+        }
+    } else {
+        check_empty(q, batch_size, "batch");
+    }
     check_has(q, has_token, "token");
     for (int i = 0; i < q.global_optargs_size(); ++i) {
         validate_pb(q.global_optargs(i).val());
@@ -86,7 +93,8 @@ void validate_pb(const Response &r) {
     check_type(Response, r);
     if (r.type() == Response::SUCCESS_ATOM
         || r.type() == Response::SUCCESS_SEQUENCE
-        || r.type() == Response::SUCCESS_PARTIAL) {
+        || r.type() == Response::SUCCESS_PARTIAL
+        || r.type() == Response::SUCCESS_BATCH) {
         check_not_has(r, has_backtrace, "backtrace");
     } else {
         check_has(r, has_backtrace, "backtrace");
@@ -95,6 +103,9 @@ void validate_pb(const Response &r) {
     for (int i = 0; i < r.response_size(); ++i) {
         validate_pb(r.response(i));
     }
+    for (int i = 0; i < r.batch_size(); ++i) {
+        validate_pb(r.batch(i));
+    }
 }
 
 void validate_pb(const Datum &d) {
@@ -109,6 +120,9 @@ void validate_pb(const Datum &d) {
     } else {
         check_not_has(d, has_r_num, "r_num");
     }
+    rcheck_toplevel(d.type() != Datum::R_SERIALIZED, ql::base_exc_t::GENERIC,
+                    "MALFORMED PROTOBUF (Datum type R_SERIALIZED is only used in "
+                    "responses).");
     if (d.type() == Datum::R_STR || d.type() == Datum::R_JSON) {
         check_has(d, has_r_str, "r_str");
     } else {
@@ -186,6 +200,7 @@ static std::set<std::string> acceptable_keys = {
     "_EVAL_FLAGS_",
     "_NO_RECURSE_",
     "_SHORTCUT_",
+    "adaptive_batching",
     "array_limit",
     "attempts",
     "auth",
@@ -214,6 +229,7 @@ static std::set<std::string> acceptable_keys = {
     "max_batch_seconds",
     "max_dist",
     "max_results",
+    "memory_limit",
     "method",
     "min_batch_rows",
     "multi",
@@ -224,23 +240,33 @@ static std::set<std::string> acceptable_keys = {
     "page",
     "page_limit",
     "params",
+    "points_only",
+    "prefetch_batches",
     "primary_key",
     "primary_replica_tag",
+    "priority",
     "profile",
     "redirects",
     "replicas",
+    "result_cache",
     "result_format",
+    "resumable",
+    "resume_token",
     "return_changes",
     "return_vals",
+    "return_write_token",
     "right_bound",
+    "right_key",
     "shards",
     "squash",
+    "store_document",
     "time_format",
     "timeout",
     "unit",
     "use_outdated",
     "verify",
     "wait_for",
+    "write_token",
 };
 
 void validate_optargs(const Query &q) {
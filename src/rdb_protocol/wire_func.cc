@@ -230,4 +230,6 @@ archive_result_t deserialize(read_stream_t *s, bt_wire_func_t *btwf) {
 
 INSTANTIATE_SERIALIZABLE_SINCE_v1_13(bt_wire_func_t);
 
+RDB_IMPL_SERIALIZABLE_3_FOR_CLUSTER(top_k_wire_func_t, keys, k, bt);
+
 }  // namespace ql
@@ -194,6 +194,23 @@ public:
     explicit max_wire_func_t(Args... args) : skip_wire_func_t(args...) { }
 };
 
+// The keys of an unindexed `order_by` that is followed by a `limit`.  This gets
+// pushed down to the shards so that each of them only returns its `k` first rows.
+class top_k_wire_func_t {
+public:
+    top_k_wire_func_t() : k(0) { }
+    // Each key is a function and whether it sorts in descending order.
+    top_k_wire_func_t(std::vector<std::pair<wire_func_t, bool> > &&_keys,
+                      uint64_t _k,
+                      const protob_t<const Backtrace> &_bt)
+        : keys(std::move(_keys)), k(_k), bt(_bt) { }
+
+    std::vector<std::pair<wire_func_t, bool> > keys;
+    uint64_t k;
+    bt_wire_func_t bt;
+};
+RDB_DECLARE_SERIALIZABLE_FOR_CLUSTER(top_k_wire_func_t);
+
 }  // namespace ql
 
 #endif  // RDB_PROTOCOL_WIRE_FUNC_HPP_
@@ -2,6 +2,7 @@
 #include "rpc/connectivity/cluster.hpp"
 
 #include <netinet/in.h>
+#include <zlib.h>
 
 #include <algorithm>
 #include <functional>
@@ -10,6 +11,7 @@
 #include <boost/optional.hpp>
 
 #include "arch/io/network.hpp"
+#include "arch/io/tls.hpp"
 #include "arch/timing.hpp"
 #include "concurrency/cross_thread_signal.hpp"
 #include "concurrency/pmap.hpp"
@@ -26,11 +28,26 @@
 // Number of messages after which the message handling loop yields
 #define MESSAGE_HANDLER_MAX_BATCH_SIZE           8
 
+// Messages smaller than this are never compressed
+#define COMPRESSION_MIN_MESSAGE_SIZE             512
+
+// Messages that don't shrink below this fraction of their size count as incompressible
+#define COMPRESSION_MAX_USEFUL_RATIO             0.9
+
+// Upper bound on the number of messages we skip after incompressible ones
+#define COMPRESSION_MAX_BACKOFF                  256
+
+// Compressed messages that claim to be larger than this are rejected as invalid
+#define COMPRESSION_MAX_MESSAGE_SIZE             (1024 * MEGABYTE)
+
+// What we put into the handshake to say that we accept `compressed_tag` messages
+static const char *const compression_handshake_feature = "compression:zlib";
+
 // The cluster communication protocol version.
-static_assert(cluster_version_t::CLUSTER == cluster_version_t::v2_0_is_latest,
+static_assert(cluster_version_t::CLUSTER == cluster_version_t::v2_1_is_latest,
               "We need to update CLUSTER_VERSION_STRING when we add a new cluster "
               "version.");
-#define CLUSTER_VERSION_STRING "2.0"
+#define CLUSTER_VERSION_STRING "2.1"
 
 const std::string connectivity_cluster_t::cluster_proto_header("RethinkDB cluster\n");
 const std::string connectivity_cluster_t::cluster_version_string(CLUSTER_VERSION_STRING);
@@ -128,13 +145,21 @@ void connectivity_cluster_t::connection_t::kill_connection() {
 connectivity_cluster_t::connection_t::connection_t(run_t *p,
                                               peer_id_t id,
                                               keepalive_tcp_conn_stream_t *c,
-                                              const peer_address_t &a) THROWS_NOTHING :
+                                              const peer_address_t &a,
+                                              bool compress) THROWS_NOTHING :
     conn(c), peer_address(a),
+    compress_messages(compress),
+    compression_backoff(0),
+    messages_until_compression(0),
     pm_collection(),
     pm_bytes_sent(secs_to_ticks(1), true),
+    pm_bytes_on_wire(secs_to_ticks(1), true),
+    pm_send_latency(secs_to_ticks(1)),
     pm_collection_membership(&p->parent->connectivity_collection, &pm_collection,
         uuid_to_str(id.get_uuid())),
     pm_bytes_sent_membership(&pm_collection, &pm_bytes_sent, "bytes_sent"),
+    pm_bytes_on_wire_membership(&pm_collection, &pm_bytes_on_wire, "bytes_on_wire"),
+    pm_send_latency_membership(&pm_collection, &pm_send_latency, "send_latency"),
     parent(p), peer_id(id),
     drainers()
 {
@@ -156,6 +181,7 @@ connectivity_cluster_t::connection_t::~connection_t() THROWS_NOTHING {
 
     /* The drainers have been destroyed, so nothing can be holding the `send_mutex`. */
     guarantee(!send_mutex.is_locked());
+    guarantee(!bulk_send_mutex.is_locked());
 }
 
 // Helper function for the `run_t` constructor's initialization list
@@ -193,9 +219,11 @@ static peer_address_t our_peer_address(std::set<ip_address_t> local_addresses,
 connectivity_cluster_t::run_t::run_t(connectivity_cluster_t *p,
                                      const std::set<ip_address_t> &local_addresses,
                                      const peer_address_t &canonical_addresses,
-                                     int port, int client_port)
+                                     int port, int client_port,
+                                     bool _compress_messages)
         THROWS_ONLY(address_in_use_exc_t, tcp_socket_exc_t) :
     parent(p),
+    compress_messages(_compress_messages),
 
     /* Create the socket to use when listening for connections from peers */
     cluster_listener_socket(new tcp_bound_socket_t(local_addresses, port)),
@@ -227,7 +255,7 @@ connectivity_cluster_t::run_t::run_t(connectivity_cluster_t *p,
     `connection_map` on each thread and notifying any listeners that we're now
     connected to ourself. The destructor will remove us from the
     `connection_map` and again notify any listeners. */
-    connection_to_ourself(this, parent->me, NULL, routing_table[parent->me]),
+    connection_to_ourself(this, parent->me, NULL, routing_table[parent->me], false),
 
     listener(new tcp_listener_t(
         cluster_listener_socket.get(),
@@ -272,6 +300,17 @@ void connectivity_cluster_t::run_t::on_new_connection(
     nconn->make_overcomplicated(&conn);
     keepalive_tcp_conn_stream_t conn_stream(conn);
 
+    if (tls_ctx_t *tls_ctx = get_tls_ctx(tls_service_t::CLUSTER, tls_role_t::SERVER)) {
+        try {
+            conn->enable_tls(tls_ctx, lock.get_drain_signal());
+        } catch (const tcp_conn_t::tls_failed_exc_t &ex) {
+            logWRN("Rejected a cluster connection: %s", ex.what());
+            return;
+        } catch (const interrupted_exc_t &) {
+            return;
+        }
+    }
+
     handle(&conn_stream, boost::none, boost::none, lock, NULL);
 }
 
@@ -309,11 +348,18 @@ void connectivity_cluster_t::run_t::connect_to_peer(
         try {
             keepalive_tcp_conn_stream_t conn(selected_addr->ip(), selected_addr->port().value(),
                                              drainer_lock.get_drain_signal(), cluster_client_port);
+            if (tls_ctx_t *tls_ctx = get_tls_ctx(tls_service_t::CLUSTER, tls_role_t::CLIENT)) {
+                conn.get_underlying_conn()->enable_tls(
+                    tls_ctx, drainer_lock.get_drain_signal());
+            }
             if (!*successful_join) {
                 handle(&conn, expected_id, boost::optional<peer_address_t>(*address), drainer_lock, successful_join);
             }
         } catch (const tcp_conn_t::connect_failed_exc_t &) {
             /* Ignore */
+        } catch (const tcp_conn_t::tls_failed_exc_t &ex) {
+            logWRN("Could not connect to %s: %s",
+                   selected_addr->to_string().c_str(), ex.what());
         } catch (const interrupted_exc_t &) {
             /* Ignore */
         }
@@ -610,8 +656,12 @@ enum class handshake_result_code_t {
 class handshake_result_t {
 public:
     handshake_result_t() { }
-    static handshake_result_t success() {
-        return handshake_result_t(handshake_result_code_t::SUCCESS);
+    /* On success, `additional_info` lists the optional features that we accept,
+    separated by spaces. Peers that don't know about features ignore it. */
+    static handshake_result_t success(const std::string &features) {
+        handshake_result_t result(handshake_result_code_t::SUCCESS);
+        result.additional_info = features;
+        return result;
     }
     static handshake_result_t error(handshake_result_code_t error_code,
                                     const std::string &additional_info) {
@@ -622,6 +672,12 @@ public:
         return code;
     }
 
+    bool has_feature(const std::string &feature) const {
+        guarantee(code == handshake_result_code_t::SUCCESS);
+        std::vector<std::string> features = split_string(additional_info, ' ');
+        return std::find(features.begin(), features.end(), feature) != features.end();
+    }
+
     std::string get_error_reason() const {
         if (code == handshake_result_code_t::UNKNOWN_ERROR) {
             return error_code_string + " (" + additional_info + ")";
@@ -704,6 +760,48 @@ archive_result_t deserialize_universal(read_stream_t *s, handshake_result_t *out
     return res;
 }
 
+/* Reads the rest of a message tagged with `compressed_tag` and returns the tag of
+the message it wraps. `data_out` is filled with the decompressed data, which is the
+tag followed by the body. Returns false if the message is invalid or the connection
+fails. */
+bool read_compressed_message(read_stream_t *conn,
+                             connectivity_cluster_t::message_tag_t *tag_out,
+                             std::vector<char> *data_out) {
+    uint64_t uncompressed_size, compressed_size;
+    if (bad(deserialize_universal(conn, &uncompressed_size))
+        || bad(deserialize_universal(conn, &compressed_size))) {
+        return false;
+    }
+    // The uncompressed data contains at least the tag.
+    if (uncompressed_size < sizeof(connectivity_cluster_t::message_tag_t)
+        || uncompressed_size > COMPRESSION_MAX_MESSAGE_SIZE
+        || compressed_size > compressBound(uncompressed_size)) {
+        return false;
+    }
+
+    scoped_array_t<char> compressed(compressed_size);
+    if (force_read(conn, compressed.data(), compressed_size)
+        != static_cast<int64_t>(compressed_size)) {
+        return false;
+    }
+
+    std::vector<char> uncompressed(uncompressed_size);
+    uLongf size = uncompressed_size;
+    int res = uncompress(reinterpret_cast<Bytef *>(uncompressed.data()), &size,
+                         reinterpret_cast<const Bytef *>(compressed.data()),
+                         compressed_size);
+    if (res != Z_OK || size != uncompressed_size) {
+        return false;
+    }
+
+    *tag_out = uncompressed[0];
+    if (*tag_out == connectivity_cluster_t::compressed_tag) {
+        return false;
+    }
+    *data_out = std::move(uncompressed);
+    return true;
+}
+
 void fail_handshake(keepalive_tcp_conn_stream_t *conn,
                     const char *peername,
                     const handshake_result_t &reason,
@@ -876,10 +974,11 @@ void connectivity_cluster_t::run_t::handle(
         return;
     }
 
+    bool peer_accepts_compression;
     {
         // Tell the other node that we are happy to connect with it
         write_message_t wm;
-        serialize_universal(&wm, handshake_result_t::success());
+        serialize_universal(&wm, handshake_result_t::success(compression_handshake_feature));
         if (send_write_message(conn, &wm)) {
             return; // network error.
         }
@@ -895,6 +994,8 @@ void connectivity_cluster_t::run_t::handle(
                    sanitize_for_logger(handshake_result.get_error_reason()).c_str());
             return;
         }
+        peer_accepts_compression =
+            handshake_result.has_feature(compression_handshake_feature);
     }
 
     // Look up the ip addresses for the other host
@@ -1079,7 +1180,8 @@ void connectivity_cluster_t::run_t::handle(
         /* `connection_t` is the public interface of this coroutine. Its
         constructor registers it in the `connectivity_cluster_t`'s connection
         map. */
-        connection_t conn_structure(this, other_id, conn, *other_peer_addr.get());
+        connection_t conn_structure(this, other_id, conn, *other_peer_addr.get(),
+                                    compress_messages && peer_accepts_compression);
 
         /* `heartbeat_manager` will periodically send a heartbeat message to
         other servers, and it will also close the connection if we don't
@@ -1099,6 +1201,21 @@ void connectivity_cluster_t::run_t::handle(
                 archive_result_t res = deserialize_universal(conn, &tag);
                 if (bad(res)) { throw fake_archive_exc_t(); }
 
+                /* Compressed messages wrap the tag and body of another message.
+                We unpack them and then handle them just like the others. */
+                scoped_ptr_t<vector_read_stream_t> decompressed_stream;
+                if (tag == compressed_tag) {
+                    std::vector<char> data;
+                    if (!read_compressed_message(conn, &tag, &data)) {
+                        throw fake_archive_exc_t();
+                    }
+                    decompressed_stream.init(
+                        new vector_read_stream_t(std::move(data), sizeof(tag)));
+                }
+                read_stream_t *message_stream = decompressed_stream.has()
+                    ? static_cast<read_stream_t *>(decompressed_stream.get())
+                    : static_cast<read_stream_t *>(conn);
+
                 /* Ignore messages tagged with the heartbeat tag. The
                 `keepalive_tcp_conn_stream_t` will have already notified the
                 `heartbeat_manager_t` as soon as the heartbeat arrived. */
@@ -1114,7 +1231,7 @@ void connectivity_cluster_t::run_t::handle(
                     handler->on_message(
                         &conn_structure,
                         auto_drainer_t::lock_t(conn_structure.drainers.get()),
-                        conn); // might raise fake_archive_exc_t
+                        message_stream); // might raise fake_archive_exc_t
                 }
 
                 ++messages_handled_since_yield;
@@ -1229,12 +1346,48 @@ void connectivity_cluster_t::send_message(connection_t *connection,
         message_handlers[tag]->on_local_message(connection, connection_keepalive,
             std::move(buffer_data));
     } else {
+        block_pm_latency send_latency(&connection->pm_send_latency);
         on_thread_t threader(connection->conn->home_thread());
 
         /* Acquire the send-mutex so we don't collide with other things trying
-        to send on the same connection. */
+        to send on the same connection. Bulk messages line up behind each other
+        first; see `bulk_send_mutex`. Heartbeats don't have a handler, but are
+        control messages. */
+        mutex_t::acq_t bulk_acq;
+        if (message_handlers[tag] != NULL
+                && message_handlers[tag]->traffic_class == traffic_class_t::BULK) {
+            bulk_acq.reset(&connection->bulk_send_mutex);
+        }
         mutex_t::acq_t acq(&connection->send_mutex);
 
+        if (connection->compress_messages
+            && bytes_sent >= COMPRESSION_MIN_MESSAGE_SIZE) {
+            if (connection->messages_until_compression > 0) {
+                --connection->messages_until_compression;
+            } else {
+                bool compressed;
+                if (!send_compressed_message(connection, tag, buffer.vector(),
+                                             &compressed)) {
+                    if (connection->conn->is_read_open()) {
+                        connection->conn->shutdown_read();
+                    }
+                    return;
+                }
+                if (compressed) {
+                    connection->compression_backoff = 0;
+                    connection->pm_bytes_sent.record(bytes_sent);
+                    return;
+                }
+                /* Don't waste time on data that doesn't compress, but try again
+                every now and then in case the traffic changes. */
+                connection->compression_backoff = std::min(
+                    std::max(1, connection->compression_backoff * 2),
+                    COMPRESSION_MAX_BACKOFF);
+                connection->messages_until_compression =
+                    connection->compression_backoff;
+            }
+        }
+
         /* Write the tag to the network */
         {
             // All cluster versions use a uint8_t tag here.
@@ -1270,20 +1423,74 @@ void connectivity_cluster_t::send_message(connection_t *connection,
                 guarantee(res == static_cast<int64_t>(buffer.vector().size()));
             }
         }
+        connection->pm_bytes_on_wire.record(sizeof(tag) + bytes_sent);
     }
 
     connection->pm_bytes_sent.record(bytes_sent);
 }
 
+bool connectivity_cluster_t::send_compressed_message(connection_t *connection,
+                                                     message_tag_t tag,
+                                                     const std::vector<char> &body,
+                                                     bool *compressed_out) {
+    connection->assert_thread();
+
+    // The compressed data is the tag followed by the body.
+    const uint64_t uncompressed_size = sizeof(tag) + body.size();
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    int res = deflateInit(&stream, Z_BEST_SPEED);
+    guarantee(res == Z_OK, "deflateInit() failed: %d", res);
+    std::vector<char> compressed(deflateBound(&stream, uncompressed_size));
+    stream.next_out = reinterpret_cast<Bytef *>(compressed.data());
+    stream.avail_out = compressed.size();
+    stream.next_in = &tag;
+    stream.avail_in = sizeof(tag);
+    res = deflate(&stream, Z_NO_FLUSH);
+    guarantee(res == Z_OK, "deflate() failed: %d", res);
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(body.data()));
+    stream.avail_in = body.size();
+    res = deflate(&stream, Z_FINISH);
+    guarantee(res == Z_STREAM_END, "deflate() failed: %d", res);
+    const uint64_t compressed_size = stream.total_out;
+    deflateEnd(&stream);
+
+    if (compressed_size > uncompressed_size * COMPRESSION_MAX_USEFUL_RATIO) {
+        *compressed_out = false;
+        return true;
+    }
+
+    write_message_t wm;
+    serialize_universal(&wm, compressed_tag);
+    serialize_universal(&wm, uncompressed_size);
+    serialize_universal(&wm, compressed_size);
+    const size_t header_size = wm.size();
+    if (send_write_message(connection->conn, &wm) == -1) {
+        return false;
+    }
+    if (connection->conn->write(compressed.data(), compressed_size) == -1) {
+        return false;
+    }
+    connection->pm_bytes_on_wire.record(header_size + compressed_size);
+    *compressed_out = true;
+    return true;
+}
+
 cluster_message_handler_t::cluster_message_handler_t(
         connectivity_cluster_t *cm,
-        connectivity_cluster_t::message_tag_t t) :
-    connectivity_cluster(cm), tag(t)
+        connectivity_cluster_t::message_tag_t t,
+        connectivity_cluster_t::traffic_class_t tc) :
+    connectivity_cluster(cm), tag(t), traffic_class(tc)
 {
     guarantee(!connectivity_cluster->current_run);
     rassert(tag != connectivity_cluster_t::heartbeat_tag,
         "Tag %" PRIu8 " is reserved for heartbeat messages.",
         connectivity_cluster_t::heartbeat_tag);
+    rassert(tag != connectivity_cluster_t::compressed_tag,
+        "Tag %" PRIu8 " is reserved for compressed messages.",
+        connectivity_cluster_t::compressed_tag);
     rassert(connectivity_cluster->message_handlers[tag] == NULL);
     connectivity_cluster->message_handlers[tag] = this;
 }
@@ -73,6 +73,17 @@ public:
     /* This tag is reserved exclusively for heartbeat messages. */
     static const message_tag_t heartbeat_tag = 'H';
 
+    /* This tag is reserved for compressed messages. Its payload is the zlib
+    compressed tag and body of another message. We only send it to peers that said
+    during the handshake that they accept it. */
+    static const message_tag_t compressed_tag = 'Z';
+
+    /* Every tag belongs to a traffic class. `CONTROL` messages (heartbeats, directory
+    and semilattice updates) are allowed to overtake queued `BULK` messages (mailbox
+    traffic, which carries replication, backfills and queries) on their way to the
+    network. Messages within a class are still sent in order. */
+    enum class traffic_class_t { CONTROL, BULK };
+
     class run_t;
 
     /* `connection_t` represents an open connection to another server. If we lose
@@ -113,7 +124,7 @@ public:
         /* The constructor registers us in every thread's `connections` map, thereby
         notifying event subscribers. */
         connection_t(run_t *, peer_id_t, keepalive_tcp_conn_stream_t *,
-                const peer_address_t &peer) THROWS_NOTHING;
+                const peer_address_t &peer, bool compress_messages) THROWS_NOTHING;
         ~connection_t() THROWS_NOTHING;
 
         /* NULL for the loopback connection (i.e. our "connection" to ourself) */
@@ -127,9 +138,28 @@ public:
         /* Unused for our connection to ourself */
         mutex_t send_mutex;
 
+        /* `BULK` senders acquire this before `send_mutex`, so that at most one of
+        them is ever queued on `send_mutex`. That way a `CONTROL` message waits for
+        at most two other messages, no matter how many bulk messages are queued. */
+        mutex_t bulk_send_mutex;
+
+        /* True if we and the peer agreed to compress messages on this connection. */
+        const bool compress_messages;
+
+        /* If compressing doesn't pay off, we skip compression for an exponentially
+        growing number of messages. Protected by `send_mutex`. */
+        int compression_backoff;
+        int messages_until_compression;
+
         perfmon_collection_t pm_collection;
-        perfmon_sampler_t pm_bytes_sent;
-        perfmon_membership_t pm_collection_membership, pm_bytes_sent_membership;
+        /* `pm_bytes_sent` measures messages before compression, `pm_bytes_on_wire`
+        what actually went over the network. */
+        perfmon_sampler_t pm_bytes_sent, pm_bytes_on_wire;
+        /* How long sending a message to a remote peer takes, including waiting for
+        the send mutex. */
+        perfmon_latency_histogram_t pm_send_latency;
+        perfmon_membership_t pm_collection_membership, pm_bytes_sent_membership,
+            pm_bytes_on_wire_membership, pm_send_latency_membership;
 
         /* We only hold this information so we can deregister ourself */
         run_t *parent;
@@ -149,7 +179,8 @@ public:
         run_t(connectivity_cluster_t *parent,
               const std::set<ip_address_t> &local_addresses,
               const peer_address_t &canonical_addresses,
-              int port, int client_port)
+              int port, int client_port,
+              bool compress_messages = false)
             THROWS_ONLY(address_in_use_exc_t, tcp_socket_exc_t);
 
         ~run_t();
@@ -225,6 +256,9 @@ public:
 
         connectivity_cluster_t *parent;
 
+        /* If true, we compress messages to peers that accept compressed messages. */
+        const bool compress_messages;
+
         /* `attempt_table` is a table of all the host:port pairs we're currently
         trying to connect to or have connected to. If we are told to connect to
         an address already in this table, we'll just ignore it. That's important
@@ -292,6 +326,14 @@ private:
 
     class heartbeat_manager_t;
 
+    /* Tries to send the message compressed. Sets `*compressed_out` to false without
+    sending anything if it doesn't compress well. Returns false on network errors.
+    Must be called on the connection's thread while holding its `send_mutex`. */
+    bool send_compressed_message(connection_t *connection,
+                                 message_tag_t tag,
+                                 const std::vector<char> &body,
+                                 bool *compressed_out);
+
     /* `me` is our `peer_id_t`. */
     const peer_id_t me;
 
@@ -333,7 +375,9 @@ public:
 protected:
     /* Registers the message handler with the cluster */
     cluster_message_handler_t(connectivity_cluster_t *connectivity_cluster,
-                              connectivity_cluster_t::message_tag_t tag);
+                              connectivity_cluster_t::message_tag_t tag,
+                              connectivity_cluster_t::traffic_class_t traffic_class =
+                                  connectivity_cluster_t::traffic_class_t::CONTROL);
     virtual ~cluster_message_handler_t();
 
     /* This can be called on any thread. */
@@ -351,6 +395,7 @@ private:
     friend class connectivity_cluster_t;
     connectivity_cluster_t *connectivity_cluster;
     const connectivity_cluster_t::message_tag_t tag;
+    const connectivity_cluster_t::traffic_class_t traffic_class;
 };
 
 #endif /* RPC_CONNECTIVITY_CLUSTER_HPP_ */
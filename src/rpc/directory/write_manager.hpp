@@ -27,21 +27,43 @@ private:
     class initialization_writer_t;
     class update_writer_t;
 
+    /* For each connection, we have an instance of `conn_info_t` in `conns` and a
+    corresponding `stream_to_conn()` coroutine. `on_connection_change()` is responsible
+    for creating the `conn_info_t` and spawning the coroutine; the coroutine is
+    responsible for stopping itself and removing the `conn_info_t`. The coroutine sends
+    the initial value, and after that the current value whenever `dirty` is set. So if
+    the value changes several times while we're sending it, we only send it once more
+    afterwards. Since each connection may skip different values, each one has its own
+    FIFO source. */
+
+    class conn_info_t {
+    public:
+        conn_info_t() : dirty(false), pulse_on_dirty(nullptr) { }
+        /* Whenever the value changes, `dirty` is set and `pulse_on_dirty` is pulsed
+        if it is non-null. */
+        bool dirty;
+        cond_t *pulse_on_dirty;
+        fifo_enforcer_source_t metadata_fifo_source;
+    };
+
     void on_connection_change(
         const peer_id_t &peer_id,
         const connectivity_cluster_t::connection_pair_t *pair) THROWS_NOTHING;
     void on_value_change() THROWS_NOTHING;
+    void stream_to_conn(
+        connectivity_cluster_t::connection_t *connection,
+        auto_drainer_t::lock_t connection_keepalive,
+        auto_drainer_t::lock_t this_keepalive,
+        typename std::map<connectivity_cluster_t::connection_t *, conn_info_t>::iterator
+            conns_entry);
 
     connectivity_cluster_t *connectivity_cluster;
     connectivity_cluster_t::message_tag_t message_tag;
     clone_ptr_t<watchable_t<metadata_t> > value;
 
-    fifo_enforcer_source_t metadata_fifo_source;
-    std::map<peer_id_t, connectivity_cluster_t::connection_pair_t> last_connections;
-    /* protects `metadata_fifo_source` and `last_connections` */
-    mutex_assertion_t mutex_assertion;
+    std::map<connectivity_cluster_t::connection_t *, conn_info_t> conns;
 
-    /* Any time we want to write to the network, we acquire this first. */
+    /* We acquire this before sending the initial value to a connection. */
     new_semaphore_t semaphore;
 
     /* Destructor order is important here. First we must destroy the subscriptions, so
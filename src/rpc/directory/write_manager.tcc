@@ -5,9 +5,10 @@
 #include "rpc/directory/write_manager.hpp"
 
 #include <map>
-#include <set>
+#include <tuple>
 
 #include "arch/runtime/coroutines.hpp"
+#include "concurrency/wait_any.hpp"
 #include "containers/archive/versioned.hpp"
 
 #define MAX_OUTSTANDING_DIRECTORY_WRITES 4
@@ -33,50 +34,73 @@ directory_write_manager_t<metadata_t>::directory_write_manager_t(
 
 template<class metadata_t>
 void directory_write_manager_t<metadata_t>::on_connection_change(
-        const peer_id_t &peer_id,
+        UNUSED const peer_id_t &peer_id,
         const connectivity_cluster_t::connection_pair_t *pair) THROWS_NOTHING {
-    DEBUG_VAR mutex_assertion_t::acq_t mutex_assertion_lock(&mutex_assertion);
-    if (pair != nullptr && last_connections.count(peer_id) == 0) {
-        connectivity_cluster_t::connection_t *connection = pair->first;
-        auto_drainer_t::lock_t connection_keepalive = pair->second;
-        last_connections.insert(std::make_pair(peer_id, *pair));
-        auto_drainer_t::lock_t this_keepalive(&drainer);
-        metadata_t initial_value = value.get()->get();
-        fifo_enforcer_state_t initial_state = metadata_fifo_source.get_state();
-        coro_t::spawn_sometime(
-            [this, this_keepalive /* important to capture */,
-                    connection, connection_keepalive /* important to capture */,
-                    initial_value, initial_state]() {
-                new_semaphore_acq_t acq(&this->semaphore, 1);
-                acq.acquisition_signal()->wait();
-                initialization_writer_t writer(initial_value, initial_state);
-                connectivity_cluster->send_message(connection, connection_keepalive,
-                        message_tag, &writer);
-            });
-    }
-    if (pair == nullptr && last_connections.count(peer_id) == 1) {
-        last_connections.erase(peer_id);
+    if (pair != nullptr && conns.count(pair->first) == 0) {
+        auto it = conns.emplace(std::piecewise_construct,
+                                std::forward_as_tuple(pair->first),
+                                std::forward_as_tuple()).first;
+        coro_t::spawn_sometime(std::bind(
+            &directory_write_manager_t::stream_to_conn, this,
+            pair->first, pair->second, drainer.lock(), it));
     }
 }
 
 template<class metadata_t>
 void directory_write_manager_t<metadata_t>::on_value_change() THROWS_NOTHING {
-    DEBUG_VAR mutex_assertion_t::acq_t mutex_assertion_lock(&mutex_assertion);
-    metadata_t current_value = value.get()->get();
-    fifo_enforcer_write_token_t token = metadata_fifo_source.enter_write();
-    auto_drainer_t::lock_t this_keepalive(&drainer);
-    for (auto pair : last_connections) {
-        connectivity_cluster_t::connection_t *connection = pair.second.first;
-        auto_drainer_t::lock_t connection_keepalive = pair.second.second;
-        coro_t::spawn_sometime(
-            [this, this_keepalive /* important to capture */,
-                    connection, connection_keepalive /* important to capture */,
-                    current_value, token]() {
-                update_writer_t writer(current_value, token);
-                connectivity_cluster->send_message(connection, connection_keepalive,
-                        message_tag, &writer);
-            });
+    for (auto &pair : conns) {
+        pair.second.dirty = true;
+        if (pair.second.pulse_on_dirty != nullptr) {
+            pair.second.pulse_on_dirty->pulse_if_not_already_pulsed();
+        }
+    }
+}
+
+template<class metadata_t>
+void directory_write_manager_t<metadata_t>::stream_to_conn(
+        connectivity_cluster_t::connection_t *connection,
+        auto_drainer_t::lock_t connection_keepalive,
+        auto_drainer_t::lock_t this_keepalive,
+        typename std::map<connectivity_cluster_t::connection_t *, conn_info_t>::iterator
+            conns_entry) {
+    conn_info_t *conn_info = &conns_entry->second;
+    try {
+        wait_any_t interruptor(
+            connection_keepalive.get_drain_signal(),
+            this_keepalive.get_drain_signal());
+        {
+            new_semaphore_acq_t acq(&semaphore, 1);
+            wait_interruptible(acq.acquisition_signal(), &interruptor);
+            /* Any change from here on will be sent as an update. */
+            conn_info->dirty = false;
+            metadata_t initial_value = value.get()->get();
+            initialization_writer_t writer(
+                initial_value, conn_info->metadata_fifo_source.get_state());
+            connectivity_cluster->send_message(
+                connection, connection_keepalive, message_tag, &writer);
+        }
+        while (true) {
+            /* Wait until the value has changed. */
+            if (!conn_info->dirty) {
+                cond_t pulse_on_dirty;
+                assignment_sentry_t<cond_t *> cond_sentry(
+                    &conn_info->pulse_on_dirty, &pulse_on_dirty);
+                wait_interruptible(&pulse_on_dirty, &interruptor);
+            }
+
+            /* If the value changes again while we're sending this one, `dirty` will be
+            set again and we'll send the newer value afterwards. */
+            conn_info->dirty = false;
+            metadata_t current_value = value.get()->get();
+            update_writer_t writer(
+                current_value, conn_info->metadata_fifo_source.enter_write());
+            connectivity_cluster->send_message(
+                connection, connection_keepalive, message_tag, &writer);
+        }
+    } catch (const interrupted_exc_t &) {
+        /* OK, we broke out of the loop */
     }
+    conns.erase(conns_entry);
 }
 
 template <class metadata_t>
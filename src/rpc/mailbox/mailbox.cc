@@ -7,6 +7,7 @@
 
 #include "debug.hpp"
 #include "containers/archive/archive.hpp"
+#include "containers/archive/buffer_stream.hpp"
 #include "containers/archive/vector_stream.hpp"
 #include "containers/archive/versioned.hpp"
 #include "concurrency/pmap.hpp"
@@ -29,6 +30,11 @@ peer_id_t raw_mailbox_t::address_t::get_peer() const {
     return peer;
 }
 
+threadnum_t raw_mailbox_t::address_t::get_thread() const {
+    guarantee(!is_nil(), "A nil address has no thread");
+    return threadnum_t(thread);
+}
+
 std::string raw_mailbox_t::address_t::human_readable() const {
     return strprintf("%s:%d:%" PRIu64, uuid_to_str(peer.get_uuid()).c_str(), thread, mailbox_id);
 }
@@ -122,11 +128,42 @@ void send(mailbox_manager_t *src, raw_mailbox_t::address_t dest,
         src->get_message_tag(), &writer);
 }
 
+bool try_deliver_locally(mailbox_manager_t *src, raw_mailbox_t::address_t dest,
+        void *message) {
+    guarantee(src);
+    guarantee(!dest.is_nil());
+    if (dest.peer != src->get_connectivity_cluster()->get_me()) {
+        return false;
+    }
+    on_thread_t rethreader(threadnum_t(dest.thread));
+    if (rethreader.home_thread() == get_thread_id()) {
+        // Yield so the callback doesn't run in the middle of whatever the sender is
+        // doing, just like for a serialized local message.
+        coro_t::yield();
+    }
+    raw_mailbox_t *mbox = src->mailbox_tables.get()->find_mailbox(dest.mailbox_id);
+    if (mbox == NULL) {
+        return true;
+    }
+    try {
+        auto_drainer_t::lock_t keepalive(&mbox->drainer);
+        return mbox->callback->read_local(message, keepalive.get_drain_signal());
+    } catch (const interrupted_exc_t &) {
+        return true;
+    }
+}
+
 static const int MAX_OUTSTANDING_MAILBOX_WRITES_PER_THREAD = 4;
 
+/* Limits on what each thread's `message_buffer_pool_t` holds on to. Larger buffers
+are freed, so that a burst of huge messages doesn't pin memory. */
+static const size_t MAX_POOLED_MESSAGE_BUFFERS_PER_THREAD = 16;
+static const size_t MAX_POOLED_MESSAGE_BUFFER_SIZE = 64 * KILOBYTE;
+
 mailbox_manager_t::mailbox_manager_t(connectivity_cluster_t *connectivity_cluster,
         connectivity_cluster_t::message_tag_t message_tag) :
-    cluster_message_handler_t(connectivity_cluster, message_tag),
+    cluster_message_handler_t(connectivity_cluster, message_tag,
+                              connectivity_cluster_t::traffic_class_t::BULK),
     semaphores(MAX_OUTSTANDING_MAILBOX_WRITES_PER_THREAD)
     { }
 
@@ -136,21 +173,37 @@ mailbox_manager_t::mailbox_table_t::mailbox_table_t() {
 
 mailbox_manager_t::mailbox_table_t::~mailbox_table_t() {
 #ifndef NDEBUG
-    for (const auto &pair : mailboxes) {
+    mailboxes.visit([](raw_mailbox_t::id_t, raw_mailbox_t *mailbox) {
         debugf("ERROR: stray mailbox %p\n%s\n",
-               pair.second, pair.second->bt.lines().c_str());
-    }
+               mailbox, mailbox->bt.lines().c_str());
+    });
 #endif
     guarantee(mailboxes.empty(),
               "Please destroy all mailboxes before destroying the cluster");
 }
 
 raw_mailbox_t *mailbox_manager_t::mailbox_table_t::find_mailbox(raw_mailbox_t::id_t id) {
-    std::map<raw_mailbox_t::id_t, raw_mailbox_t *>::iterator it = mailboxes.find(id);
-    if (it == mailboxes.end()) {
-        return NULL;
-    } else {
-        return it->second;
+    raw_mailbox_t **mailbox = mailboxes.find(id);
+    return mailbox == NULL ? NULL : *mailbox;
+}
+
+std::vector<char> mailbox_manager_t::message_buffer_pool_t::take(size_t size) {
+    std::vector<char> buffer;
+    if (!buffers.empty()) {
+        buffer.swap(buffers.back());
+        buffers.pop_back();
+        pooled_memory.add(-static_cast<int64_t>(buffer.capacity()));
+    }
+    buffer.resize(size);
+    return buffer;
+}
+
+void mailbox_manager_t::message_buffer_pool_t::give_back(std::vector<char> &&buffer) {
+    if (buffers.size() < MAX_POOLED_MESSAGE_BUFFERS_PER_THREAD
+        && buffer.capacity() <= MAX_POOLED_MESSAGE_BUFFER_SIZE) {
+        buffer.clear();
+        pooled_memory.add(buffer.capacity());
+        buffers.push_back(std::move(buffer));
     }
 }
 
@@ -217,10 +270,32 @@ void mailbox_manager_t::on_message(connectivity_cluster_t::connection_t *connect
     mailbox_header_t mbox_header;
     read_mailbox_header(stream, &mbox_header);
 
+    // Messages that are too large to be pooled are read into a shared buffer instead,
+    // so that the datums in them can point into it rather than being copied out.
+    if (mbox_header.data_length > MAX_POOLED_MESSAGE_BUFFER_SIZE) {
+        counted_t<shared_buf_t> shared_data =
+            shared_buf_t::create(mbox_header.data_length);
+        int64_t bytes_read =
+            force_read(stream, shared_data->data(), mbox_header.data_length);
+        if (bytes_read != static_cast<int64_t>(mbox_header.data_length)) {
+            throw fake_archive_exc_t();
+        }
+        coro_t::spawn_now_dangerously(
+            [this, connection, connection_keepalive /* important to capture */,
+                    mbox_header, &shared_data]() {
+                counted_t<const shared_buf_t> data(std::move(shared_data));
+                tagged_memory_t message_memory(memory_tag_t::mailbox_buffers,
+                                               data->size());
+                shared_buf_read_stream_t shared_stream(std::move(data));
+                mailbox_read(connection, threadnum_t(mbox_header.dest_thread),
+                             mbox_header.dest_mailbox_id, &shared_stream, MAYBE_YIELD);
+            });
+        return;
+    }
+
     // Read the data from the read stream, so it can be deallocated before we continue
     // in a coroutine
-    std::vector<char> stream_data;
-    stream_data.resize(mbox_header.data_length);
+    std::vector<char> stream_data = buffer_pools.get()->take(mbox_header.data_length);
     int64_t bytes_read = force_read(stream, stream_data.data(), mbox_header.data_length);
     if (bytes_read != static_cast<int64_t>(mbox_header.data_length)) {
         throw fake_archive_exc_t();
@@ -248,11 +323,31 @@ void mailbox_manager_t::mailbox_read_coroutine(
         int64_t stream_data_offset,
         force_yield_t force_yield) {
 
+    // The message's buffer counts as mailbox memory until it goes back to the pool,
+    // or is freed.
+    tagged_memory_t message_memory(memory_tag_t::mailbox_buffers,
+                                   stream_data->capacity());
+
     // Construct a new stream to use
     vector_read_stream_t stream(std::move(*stream_data), stream_data_offset);
     stream_data = NULL; // <- It is not safe to use `stream_data` anymore once we
                         //    switch the thread
 
+    mailbox_read(connection, dest_thread, dest_mailbox_id, &stream, force_yield);
+
+    // We're back on the thread that we took the buffer on.
+    std::vector<char> used_data;
+    int64_t used_data_offset;
+    stream.swap(&used_data, &used_data_offset);
+    buffer_pools.get()->give_back(std::move(used_data));
+}
+
+void mailbox_manager_t::mailbox_read(
+        connectivity_cluster_t::connection_t *connection,
+        threadnum_t dest_thread,
+        raw_mailbox_t::id_t dest_mailbox_id,
+        read_stream_t *stream,
+        force_yield_t force_yield) {
     bool archive_exception = false;
     {
         on_thread_t rethreader(dest_thread);
@@ -267,7 +362,7 @@ void mailbox_manager_t::mailbox_read_coroutine(
             if (mbox != NULL) {
                 try {
                     auto_drainer_t::lock_t keepalive(&mbox->drainer);
-                    mbox->callback->read(&stream, keepalive.get_drain_signal());
+                    mbox->callback->read(stream, keepalive.get_drain_signal());
                 } catch (const interrupted_exc_t &) {
                     /* Do nothing. It's no longer safe to access `mbox` (because the
                     destructor is running) but otherwise we don't need to take any
@@ -294,11 +389,8 @@ raw_mailbox_t::id_t mailbox_manager_t::generate_mailbox_id() {
 
 raw_mailbox_t::id_t mailbox_manager_t::register_mailbox(raw_mailbox_t *mb) {
     raw_mailbox_t::id_t id = generate_mailbox_id();
-    std::map<raw_mailbox_t::id_t, raw_mailbox_t *> *mailboxes =
-        &mailbox_tables.get()->mailboxes;
-    std::pair<std::map<raw_mailbox_t::id_t, raw_mailbox_t *>::iterator, bool> res
-        = mailboxes->insert(std::make_pair(id, mb));
-    guarantee(res.second);  // Assert a new element was inserted.
+    bool inserted = mailbox_tables.get()->mailboxes.insert(id, mb);
+    guarantee(inserted);  // Assert a new element was inserted.
     return id;
 }
 
@@ -6,10 +6,12 @@
 #include <string>
 #include <vector>
 
+#include "arch/runtime/memory_tags.hpp"
 #include "backtrace.hpp"
 #include "concurrency/new_semaphore.hpp"
 #include "containers/archive/archive.hpp"
 #include "containers/archive/vector_stream.hpp"
+#include "containers/flat_int_map.hpp"
 #include "rpc/connectivity/cluster.hpp"
 #include "rpc/semilattice/joins/macros.hpp"
 
@@ -36,6 +38,15 @@ public:
         read_stream_t *stream,
         /* `interruptor` will be pulsed if the mailbox is destroyed. */
         signal_t *interruptor) = 0;
+
+    /* `read_local()` is like `read()`, but takes the message as the object it would
+    have been deserialized into, from a sender on the same server. It may move from
+    `*message`. It returns false if the callback can't take messages this way, in
+    which case it must leave `*message` untouched. Unlike `read()`, it runs in the
+    sender's coroutine, so it shouldn't block for long. */
+    virtual bool read_local(UNUSED void *message, UNUSED signal_t *interruptor) {
+        return false;
+    }
 };
 
 struct raw_mailbox_t : public home_thread_mixin_t {
@@ -51,6 +62,7 @@ private:
     friend class mailbox_manager_t;
     friend class raw_mailbox_writer_t;
     friend void send(mailbox_manager_t *, address_t, mailbox_write_callback_t *);
+    friend bool try_deliver_locally(mailbox_manager_t *, address_t, void *);
 
     mailbox_manager_t *manager;
 
@@ -87,6 +99,10 @@ public:
         fails. */
         peer_id_t get_peer() const;
 
+        /* Returns the thread on the mailbox's peer that the mailbox lives on. If the
+        address is nil, fails. */
+        threadnum_t get_thread() const;
+
         // Returns a friendly human-readable peer:thread:mailbox_id string.
         std::string human_readable() const;
 
@@ -96,6 +112,8 @@ public:
 
     private:
         friend void send(mailbox_manager_t *, raw_mailbox_t::address_t, mailbox_write_callback_t *callback);
+        friend bool try_deliver_locally(mailbox_manager_t *, raw_mailbox_t::address_t,
+                                        void *);
         friend struct raw_mailbox_t;
         friend class mailbox_manager_t;
 
@@ -130,6 +148,16 @@ void send(mailbox_manager_t *src,
           raw_mailbox_t::address_t dest,
           mailbox_write_callback_t *callback);
 
+/* If `dest` is on this server, `try_deliver_locally()` hands `message` straight to the
+mailbox's `read_local()` on the mailbox's thread, without serializing it, and returns
+true; if the mailbox no longer exists, the message is dropped and it also returns
+true. It returns false if `dest` is on another server or the mailbox doesn't support
+`read_local()`, in which case the caller should fall back to `send()`. */
+
+bool try_deliver_locally(mailbox_manager_t *src,
+                         raw_mailbox_t::address_t dest,
+                         void *message);
+
 /* `mailbox_manager_t` is a `cluster_message_handler_t` that takes care
 of actually routing messages to mailboxes. */
 
@@ -141,17 +169,32 @@ public:
 private:
     friend struct raw_mailbox_t;
     friend void send(mailbox_manager_t *, raw_mailbox_t::address_t, mailbox_write_callback_t *callback);
+    friend bool try_deliver_locally(mailbox_manager_t *, raw_mailbox_t::address_t,
+                                    void *);
 
     struct mailbox_table_t {
         mailbox_table_t();
         ~mailbox_table_t();
         raw_mailbox_t::id_t next_mailbox_id;
-        // TODO: use a buffered structure to reduce dynamic allocation
-        std::map<raw_mailbox_t::id_t, raw_mailbox_t *> mailboxes;
+        flat_int_map_t<raw_mailbox_t::id_t, raw_mailbox_t *> mailboxes;
         raw_mailbox_t *find_mailbox(raw_mailbox_t::id_t);
     };
     one_per_thread_t<mailbox_table_t> mailbox_tables;
 
+    /* Keeps the buffers of messages that have been delivered around for reuse, so
+    that receiving a message usually doesn't have to allocate one. Each buffer goes
+    back to the pool of the thread that took it. */
+    class message_buffer_pool_t {
+    public:
+        message_buffer_pool_t() : pooled_memory(memory_tag_t::mailbox_buffers) { }
+        std::vector<char> take(size_t size);
+        void give_back(std::vector<char> &&buffer);
+    private:
+        std::vector<std::vector<char> > buffers;
+        tagged_memory_t pooled_memory;
+    };
+    one_per_thread_t<message_buffer_pool_t> buffer_pools;
+
     /* We must acquire one of these semaphores whenever we want to send a message over a
     mailbox. This prevents mailbox messages from starving directory and semilattice
     messages. */
@@ -182,6 +225,13 @@ private:
                                 std::vector<char> *stream_data,
                                 int64_t stream_data_offset,
                                 force_yield_t force_yield);
+    // Delivers the message in `stream` to the mailbox on `dest_thread`, and kills the
+    // connection if the message can't be deserialized.
+    void mailbox_read(connectivity_cluster_t::connection_t *connection,
+                      threadnum_t dest_thread,
+                      raw_mailbox_t::id_t dest_mailbox_id,
+                      read_stream_t *stream,
+                      force_yield_t force_yield);
 };
 
 /* Note: disconnect_watcher_t keeps the connection alive for as long as it
@@ -22,6 +22,7 @@ public:
     }
     bool is_nil() const { return addr.is_nil(); }
     peer_id_t get_peer() const { return addr.get_peer(); }
+    threadnum_t get_thread() const { return addr.get_thread(); }
 
     friend class mailbox_t<T>;
 
@@ -72,6 +73,10 @@ private:
     template <class a0_t, class a1_t, class a2_t, class a3_t, class a4_t, class a5_t, class a6_t, class a7_t, class a8_t, class a9_t, class a10_t, class a11_t, class a12_t, class a13_t>
     friend void send(mailbox_manager_t *,
                      typename mailbox_t< void(a0_t, a1_t, a2_t, a3_t, a4_t, a5_t, a6_t, a7_t, a8_t, a9_t, a10_t, a11_t, a12_t, a13_t) >::address_t, const a0_t&, const a1_t&, const a2_t&, const a3_t&, const a4_t&, const a5_t&, const a6_t&, const a7_t&, const a8_t&, const a9_t&, const a10_t&, const a11_t&, const a12_t&, const a13_t&);
+    template <class a0_t>
+    friend void send_moving_locally(mailbox_manager_t *,
+                                    typename mailbox_t< void(a0_t) >::address_t,
+                                    a0_t &&);
 
     raw_mailbox_t::address_t addr;
 };
@@ -155,6 +160,10 @@ class mailbox_t< void(arg0_t) > {
             if (bad(res)) { throw fake_archive_exc_t(); }
             parent->fun(interruptor, std::move(arg0));
         }
+        bool read_local(void *message, signal_t *interruptor) {
+            parent->fun(interruptor, std::move(*static_cast<arg0_t *>(message)));
+            return true;
+        }
     private:
         mailbox_t< void(arg0_t) > *parent;
     };
@@ -195,6 +204,19 @@ void send(mailbox_manager_t *src,
     send(src, dest.addr, &writer);
 }
 
+/* `send_moving_locally()` is like `send()`, but if `dest` is on this server it
+moves `arg0` into the mailbox's callback instead of serializing it. Only use it
+for types that are safe to hand to another thread, and for mailboxes whose
+callbacks don't block for long, since they run in the sender's coroutine. */
+template<class arg0_t>
+void send_moving_locally(mailbox_manager_t *src,
+                         typename mailbox_t< void(arg0_t) >::address_t dest,
+                         arg0_t &&arg0) {
+    if (!try_deliver_locally(src, dest.addr, &arg0)) {
+        send(src, dest, arg0);
+    }
+}
+
 
 template<class arg0_t, class arg1_t>
 class mailbox_t< void(arg0_t, arg1_t) > {
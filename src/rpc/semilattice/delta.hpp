@@ -0,0 +1,18 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef RPC_SEMILATTICE_DELTA_HPP_
+#define RPC_SEMILATTICE_DELTA_HPP_
+
+/* `semilattice_delta(before, after)` returns a value that carries everything that
+`after` knows and `before` doesn't. Joining it into any value that is already at
+least `before` has the same effect as joining `after` into it. `after` must be at
+least `before`.
+
+`semilattice_manager_t` uses this to send only the parts of the metadata that a change
+touched, instead of all of it. The default just returns `after`; types that can get
+big should overload it to pick out the changed parts. */
+template<class T>
+T semilattice_delta(const T &, const T &after) {
+    return after;
+}
+
+#endif /* RPC_SEMILATTICE_DELTA_HPP_ */
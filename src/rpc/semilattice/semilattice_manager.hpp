@@ -29,6 +29,14 @@ constraints:
     such that `metadata_t` is a semilattice and `semilattice_join(a, b)` sets
     `*a` to the semilattice-join of `*a` and `b`.
 
+4. Optionally, there may be a function:
+
+        metadata_t semilattice_delta(const metadata_t &before, const metadata_t &after);
+
+    that returns only the part of `after` that isn't in `before`. See
+    `rpc/semilattice/delta.hpp`. If it exists, changes are sent to other nodes
+    as deltas rather than as the whole metadata.
+
 Currently it's not thread-safe at all; all accesses to the metadata must be on
 the home thread of the `semilattice_manager_t`. */
 
@@ -15,6 +15,7 @@
 #include "concurrency/wait_any.hpp"
 #include "containers/archive/versioned.hpp"
 #include "logger.hpp"
+#include "rpc/semilattice/delta.hpp"
 
 #define MAX_OUTSTANDING_SEMILATTICE_WRITES 4
 
@@ -68,7 +69,13 @@ void semilattice_manager_t<metadata_t>::root_view_t::join(const metadata_t &adde
     parent->assert_thread();
 
     metadata_version_t new_version = ++parent->metadata_version;
+    /* Callers usually join in the whole metadata even if they only changed a small
+    part of it, so we only send our peers what actually changed. They must already
+    have everything else: they got all of our metadata when they connected, and
+    every change since then. */
+    metadata_t old_metadata = parent->metadata;
     parent->join_metadata_locally(added_metadata);
+    metadata_t changed_metadata = semilattice_delta(old_metadata, parent->metadata);
 
     /* Distribute changes to all peers we can currently see. If we can't
     currently see a peer, that's OK; it will hear about the metadata change when
@@ -83,8 +90,8 @@ void semilattice_manager_t<metadata_t>::root_view_t::join(const metadata_t &adde
         coro_t::spawn_sometime(
             [this, parent_keepalive /* important to capture */,
              connection, connection_keepalive /* important to capture */,
-             new_version, added_metadata]() {
-                metadata_writer_t writer(added_metadata, new_version);
+             new_version, changed_metadata]() {
+                metadata_writer_t writer(changed_metadata, new_version);
                 new_semaphore_acq_t acq(&parent->semaphore, 1);
                 acq.acquisition_signal()->wait();
                 parent->get_connectivity_cluster()->send_message(connection,
@@ -1,13 +1,38 @@
 #include "serializer/buf_ptr.hpp"
 
+#include "buffer_cache/block_slab.hpp"
 #include "math.hpp"
 
+ser_buffer_t *alloc_ser_buffer(size_t size) {
+    block_slab_allocator_t *slab_allocator = get_block_slab_allocator();
+    if (slab_allocator != NULL) {
+        void *buf = slab_allocator->allocate(size);
+        if (buf != NULL) {
+            return static_cast<ser_buffer_t *>(buf);
+        }
+    }
+    return static_cast<ser_buffer_t *>(malloc_aligned(size, DEVICE_BLOCK_SIZE));
+}
+
+void free_ser_buffer(ser_buffer_t *buf) {
+    block_slab_allocator_t *slab_allocator = get_block_slab_allocator();
+    if (buf != NULL
+        && (slab_allocator == NULL || !slab_allocator->deallocate(buf))) {
+        free(buf);
+    }
+}
+
+void scoped_ser_buffer_t::reset() {
+    free_ser_buffer(ptr_);
+    ptr_ = NULL;
+}
+
 buf_ptr_t buf_ptr_t::alloc_uninitialized(block_size_t size) {
     guarantee(size.ser_value() != 0);
     const size_t count = compute_aligned_block_size(size);
     buf_ptr_t ret;
     ret.block_size_ = size;
-    ret.ser_buffer_.init(malloc_aligned(count, DEVICE_BLOCK_SIZE));
+    ret.ser_buffer_.init(alloc_ser_buffer(count));
     return ret;
 }
 
@@ -18,16 +43,16 @@ buf_ptr_t buf_ptr_t::alloc_zeroed(block_size_t size) {
     return ret;
 }
 
-scoped_malloc_t<ser_buffer_t> help_allocate_copy(const ser_buffer_t *copyee,
+scoped_ser_buffer_t help_allocate_copy(const ser_buffer_t *copyee,
                                                  size_t amount_to_copy,
                                                  size_t reserved_size) {
     rassert(amount_to_copy <= reserved_size);
-    void *buf = malloc_aligned(reserved_size, DEVICE_BLOCK_SIZE);
+    ser_buffer_t *buf = alloc_ser_buffer(reserved_size);
     memcpy(buf, copyee, amount_to_copy);
     memset(reinterpret_cast<char *>(buf) + amount_to_copy,
            0,
            reserved_size - amount_to_copy);
-    return scoped_malloc_t<ser_buffer_t>(buf);
+    return scoped_ser_buffer_t(buf);
 }
 
 buf_ptr_t buf_ptr_t::alloc_copy(const buf_ptr_t &copyee) {
@@ -54,7 +79,7 @@ void buf_ptr_t::resize_fill_zero(block_size_t new_size) {
         }
     } else {
         // We actually need to reallocate.
-        scoped_malloc_t<ser_buffer_t> buf
+        scoped_ser_buffer_t buf
             = help_allocate_copy(ser_buffer_.get(),
                                  std::min(block_size_.ser_value(),
                                           new_size.ser_value()),
@@ -8,6 +8,54 @@
 #include "math.hpp"
 #include "serializer/types.hpp"
 
+// Owns a block buffer.  Block buffers come from the block slab allocator if that's
+// enabled (see buffer_cache/block_slab.hpp), and from malloc otherwise, so they must
+// be freed with `free_ser_buffer` rather than `free`.
+class scoped_ser_buffer_t {
+public:
+    scoped_ser_buffer_t() : ptr_(NULL) { }
+    explicit scoped_ser_buffer_t(ser_buffer_t *ptr) : ptr_(ptr) { }
+    scoped_ser_buffer_t(scoped_ser_buffer_t &&movee) noexcept : ptr_(movee.ptr_) {
+        movee.ptr_ = NULL;
+    }
+    ~scoped_ser_buffer_t() {
+        reset();
+    }
+
+    void operator=(scoped_ser_buffer_t &&movee) noexcept {
+        scoped_ser_buffer_t tmp(std::move(movee));
+        std::swap(ptr_, tmp.ptr_);
+    }
+
+    void init(ser_buffer_t *ptr) {
+        guarantee(ptr_ == NULL);
+        ptr_ = ptr;
+    }
+
+    ser_buffer_t *get() const { return ptr_; }
+
+    ser_buffer_t *release() {
+        ser_buffer_t *tmp = ptr_;
+        ptr_ = NULL;
+        return tmp;
+    }
+
+    void reset();
+
+    bool has() const {
+        return ptr_ != NULL;
+    }
+
+private:
+    ser_buffer_t *ptr_;
+
+    DISABLE_COPYING(scoped_ser_buffer_t);
+};
+
+// Allocates a DEVICE_BLOCK_SIZE-aligned block buffer of `size` bytes.
+ser_buffer_t *alloc_ser_buffer(size_t size);
+void free_ser_buffer(ser_buffer_t *buf);
+
 // Memory-aligned bufs.  This type also keeps the unused part of the buf (up to the
 // DEVICE_BLOCK_SIZE multiple) zeroed out.
 
@@ -25,7 +73,7 @@ public:
     }
 
     buf_ptr_t(block_size_t size,
-            scoped_malloc_t<ser_buffer_t> ser_buffer)
+            scoped_ser_buffer_t ser_buffer)
         : block_size_(size),
           ser_buffer_(std::move(ser_buffer)) {
         guarantee(block_size_.ser_value() != 0);
@@ -81,7 +129,7 @@ public:
     }
 
     void release(block_size_t *block_size_out,
-                 scoped_malloc_t<ser_buffer_t> *ser_buffer_out) {
+                 scoped_ser_buffer_t *ser_buffer_out) {
         buf_ptr_t tmp(std::move(*this));
         *block_size_out = tmp.block_size_;
         *ser_buffer_out = std::move(tmp.ser_buffer_);
@@ -114,7 +162,7 @@ private:
     // more efficiently write the buffer to disk.
     block_size_t block_size_;
     // The buffer, or empty if this buf_ptr_t is empty.
-    scoped_malloc_t<ser_buffer_t> ser_buffer_;
+    scoped_ser_buffer_t ser_buffer_;
 
     DISABLE_COPYING(buf_ptr_t);
 };
@@ -0,0 +1,125 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/io_buffer_pool.hpp"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <utility>
+#include <vector>
+
+#include "config/args.hpp"
+#include "math.hpp"
+#include "thread_local.hpp"
+#include "utils.hpp"
+
+// The smallest size class. Smaller buffers are rounded up to this.
+const size_t IO_BUFFER_MIN_POOLED_SIZE = 4 * KILOBYTE;
+// The largest size class. Bigger buffers come from the allocator every time.
+const size_t IO_BUFFER_MAX_POOLED_SIZE = 8 * MEGABYTE;
+// Buffers at least this big are huge-page aligned.
+const size_t IO_BUFFER_HUGE_PAGE_SIZE = 2 * MEGABYTE;
+// How much memory each thread may keep around in freed buffers.
+const size_t IO_BUFFER_POOL_MAX_BYTES_PER_THREAD = 16 * MEGABYTE;
+
+const int IO_BUFFER_NUM_SIZE_CLASSES = 12;  // 4 KB, 8 KB, ..., 8 MB
+
+static int size_class_of(size_t capacity) {
+    int size_class = 0;
+    for (size_t s = IO_BUFFER_MIN_POOLED_SIZE; s < capacity; s *= 2) {
+        ++size_class;
+    }
+    rassert(size_class < IO_BUFFER_NUM_SIZE_CLASSES);
+    return size_class;
+}
+
+static size_t rounded_capacity(size_t size) {
+    if (size > IO_BUFFER_MAX_POOLED_SIZE) {
+        return ceil_aligned(size, DEVICE_BLOCK_SIZE);
+    }
+    size_t capacity = IO_BUFFER_MIN_POOLED_SIZE;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+struct io_buffer_pool_t {
+    io_buffer_pool_t() : pooled_bytes(0) { }
+    std::vector<char *> free_buffers[IO_BUFFER_NUM_SIZE_CLASSES];
+    size_t pooled_bytes;
+};
+
+// Allocated the first time a thread frees a buffer, and never freed, like the
+// buffers in it.
+TLS_with_init(io_buffer_pool_t *, io_buffer_pool, NULL);
+
+static char *allocate_io_buffer(size_t capacity) {
+    const bool huge = capacity >= IO_BUFFER_HUGE_PAGE_SIZE;
+    char *data = static_cast<char *>(
+        malloc_aligned(capacity, huge ? IO_BUFFER_HUGE_PAGE_SIZE : DEVICE_BLOCK_SIZE));
+#ifdef MADV_HUGEPAGE
+    if (huge) {
+        // This is only advice; kernels without transparent huge pages refuse it.
+        UNUSED int res = madvise(data, capacity, MADV_HUGEPAGE);
+    }
+#endif
+    return data;
+}
+
+io_buffer_t::io_buffer_t(size_t size)
+    : data_(NULL), capacity_(rounded_capacity(size)) {
+    if (capacity_ <= IO_BUFFER_MAX_POOLED_SIZE) {
+        io_buffer_pool_t *pool = TLS_get_io_buffer_pool();
+        if (pool != NULL) {
+            std::vector<char *> *free_buffers
+                = &pool->free_buffers[size_class_of(capacity_)];
+            if (!free_buffers->empty()) {
+                data_ = free_buffers->back();
+                free_buffers->pop_back();
+                pool->pooled_bytes -= capacity_;
+                return;
+            }
+        }
+    }
+    data_ = allocate_io_buffer(capacity_);
+}
+
+io_buffer_t::io_buffer_t(io_buffer_t &&movee)
+    : data_(movee.data_), capacity_(movee.capacity_) {
+    movee.data_ = NULL;
+    movee.capacity_ = 0;
+}
+
+io_buffer_t::~io_buffer_t() {
+    reset();
+}
+
+io_buffer_t &io_buffer_t::operator=(io_buffer_t &&movee) {
+    io_buffer_t tmp(std::move(movee));
+    std::swap(data_, tmp.data_);
+    std::swap(capacity_, tmp.capacity_);
+    return *this;
+}
+
+void io_buffer_t::reset() {
+    if (data_ == NULL) {
+        return;
+    }
+    if (capacity_ <= IO_BUFFER_MAX_POOLED_SIZE) {
+        io_buffer_pool_t *pool = TLS_get_io_buffer_pool();
+        if (pool == NULL) {
+            pool = new io_buffer_pool_t;
+            TLS_set_io_buffer_pool(pool);
+        }
+        if (pool->pooled_bytes + capacity_ <= IO_BUFFER_POOL_MAX_BYTES_PER_THREAD) {
+            pool->free_buffers[size_class_of(capacity_)].push_back(data_);
+            pool->pooled_bytes += capacity_;
+            data_ = NULL;
+            capacity_ = 0;
+            return;
+        }
+    }
+    ::free(data_);
+    data_ = NULL;
+    capacity_ = 0;
+}
@@ -0,0 +1,46 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_IO_BUFFER_POOL_HPP_
+#define SERIALIZER_IO_BUFFER_POOL_HPP_
+
+#include <stddef.h>
+
+#include "errors.hpp"
+
+/* `io_buffer_t` is a `DEVICE_BLOCK_SIZE`-aligned scratch buffer for a single disk read
+or write, such as the buffer of a read-ahead, of a compressed block that's being
+written or of an extent that the GC is collecting. The serializer goes through
+these at a high rate, so instead of going to the allocator every time, each thread
+keeps freed buffers in power-of-two size classes and hands them out again. Buffers
+of 2 MB or more are huge-page aligned and, where the kernel supports it, backed by
+transparent huge pages, which saves TLB misses when we walk over a whole extent.
+
+A buffer may be freed on a different thread than the one it was allocated on; it then
+goes to the pool of the thread that frees it.
+
+This doesn't cover the buffers of `buf_ptr_t`, since those belong to the cache once
+they've been read and are freed with `free()`. */
+class io_buffer_t {
+public:
+    io_buffer_t() : data_(NULL), capacity_(0) { }
+    // The contents of the buffer are uninitialized.
+    explicit io_buffer_t(size_t size);
+    io_buffer_t(io_buffer_t &&movee);
+    ~io_buffer_t();
+
+    io_buffer_t &operator=(io_buffer_t &&movee);
+
+    void reset();
+
+    bool has() const { return data_ != NULL; }
+    char *get() const { return data_; }
+    // At least the size that the buffer was allocated with.
+    size_t capacity() const { return capacity_; }
+
+private:
+    char *data_;
+    size_t capacity_;
+
+    DISABLE_COPYING(io_buffer_t);
+};
+
+#endif  // SERIALIZER_IO_BUFFER_POOL_HPP_
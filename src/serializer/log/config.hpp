@@ -11,10 +11,22 @@
 
 /* Configuration for the serializer that can change from run to run */
 
+enum class read_ahead_mode_t {
+    // Never read more than the requested block.
+    off,
+    // Read the blocks around every requested block while the cache is warming up.
+    always,
+    // Read around a requested block while the cache is warming up, but only if the
+    // reads that came before it look like a traversal. See `read_ahead_detector_t`.
+    adaptive
+};
+
 struct log_serializer_dynamic_config_t {
     log_serializer_dynamic_config_t() {
-        read_ahead = true;
+        read_ahead = read_ahead_mode_t::adaptive;
         io_batch_factor = DEFAULT_IO_BATCH_FACTOR;
+        compress_blocks = false;
+        ordered_writes = false;
     }
 
     /* The (minimal) batch size of i/o requests being taken from a single i/o account.
@@ -22,8 +34,22 @@ struct log_serializer_dynamic_config_t {
     i/o priority of the account. */
     int32_t io_batch_factor;
 
-    /* Enable reading more data than requested to let the cache warmup more quickly esp. on rotational drives */
-    bool read_ahead;
+    /* Whether to read more data than requested to let the cache warm up more quickly,
+    esp. on rotational drives */
+    read_ahead_mode_t read_ahead;
+
+    /* Store data blocks zlib-compressed if that saves space on disk.  This only
+    affects new writes; compressed blocks are always readable.  Comes from the
+    table's `compress_blocks` setting. */
+    bool compress_blocks;
+
+    /* Write the metablock of most index writes with a single datasync after it,
+    instead of one before and one after.  The metablock then carries a checksum of
+    the data blocks it newly refers to, and startup falls back to the previous
+    metablock if those didn't make it to disk.  Metablocks written with this
+    setting are always readable.  Turned on by the `--ordered-writes` server
+    option. */
+    bool ordered_writes;
 };
 
 /* This is equivalent to log_serializer_static_config_t below, but is an on-disk
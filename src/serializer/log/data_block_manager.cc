@@ -6,11 +6,15 @@
 
 #include <functional>
 
+#include <zlib.h>
+
+#include "errors.hpp"
+#include <boost/crc.hpp>
+
 #include "arch/arch.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "concurrency/mutex.hpp"
 #include "concurrency/new_mutex.hpp"
-#include "errors.hpp"
 #include "perfmon/perfmon.hpp"
 #include "serializer/buf_ptr.hpp"
 #include "serializer/log/log_serializer.hpp"
@@ -51,6 +55,13 @@ const size_t GC_YOUNG_EXTENT_MAX_SIZE = 50;
 // What's the definition of a "young" extent in microseconds?
 const microtime_t GC_YOUNG_EXTENT_TIMELIMIT_MICROS = 50000;
 
+// A block whose previous version is in an extent that we started writing at least this
+// long ago is considered cold. See `choose_target_extent()`.
+const microtime_t GC_COLD_BLOCK_MIN_AGE_MICROS = 60 * MILLION;
+
+// How stale `gc_age_reference_time` may get before we reorder the GC priority queue.
+const microtime_t GC_AGE_REFRESH_INTERVAL_MICROS = 1000000;
+
 
 // Identifies an extent, the time we started writing to the
 // extent, whether it's the extent we're currently writing to, and
@@ -59,16 +70,19 @@ class gc_entry_t : public intrusive_list_node_t<gc_entry_t> {
 private:
     struct block_info_t {
         uint32_t relative_offset;
+        // The space the block takes up on disk.
         block_size_t block_size;
+        // The size of the block once it has been decompressed.
+        block_size_t ser_block_size;
         bool token_referenced;
         bool index_referenced;
     };
 
 public:
     /* This constructor is for starting a new active extent. */
-    explicit gc_entry_t(data_block_manager_t *_parent)
+    gc_entry_t(data_block_manager_t *_parent, extent_tier_t tier)
         : parent(_parent),
-          extent_ref(parent->extent_manager->gen_extent()),
+          extent_ref(parent->extent_manager->gen_extent(tier)),
           timestamp(current_microtime()),
           was_written(false),
           state(state_active),
@@ -128,7 +142,7 @@ public:
             + aligned_value(block_infos.back().block_size);
     }
 
-    // Returns the ostensible size of the block_index'th block.  Note that
+    // Returns the ostensible on-disk size of the block_index'th block.  Note that
     // block_boundaries[i] + block_size(i) <= block_boundaries[i + 1].
     block_size_t block_size(unsigned int block_index) const {
         guarantee(state != state_reconstructing);
@@ -136,6 +150,14 @@ public:
         return block_infos[block_index].block_size;
     }
 
+    // Returns the size of the block_index'th block after decompression.  This is
+    // equal to block_size(block_index) for uncompressed blocks.
+    block_size_t ser_block_size(unsigned int block_index) const {
+        guarantee(state != state_reconstructing);
+        guarantee(block_index < block_infos.size());
+        return block_infos[block_index].ser_block_size;
+    }
+
     // Returns block_boundaries()[block_index].
     uint32_t relative_offset(unsigned int block_index) const {
         guarantee(state != state_reconstructing);
@@ -155,6 +177,7 @@ public:
     }
 
     bool new_offset(block_size_t block_size,
+                    block_size_t ser_block_size,
                     uint32_t *relative_offset_out,
                     unsigned int *block_index_out) {
         // Returns true if there's enough room at the end of the extent for the new
@@ -170,7 +193,8 @@ public:
         } else {
             *relative_offset_out = offset;
             *block_index_out = block_infos.size();
-            block_infos.push_back(block_info_t{offset, block_size, false, false});
+            block_infos.push_back(block_info_t{offset, block_size, ser_block_size,
+                                               false, false});
             update_stats(NULL, &block_infos.back());
             return true;
         }
@@ -195,6 +219,24 @@ public:
         return garbage_bytes_stat;
     }
 
+    /* The cost-benefit score from the LFS paper. Collecting an extent costs reading it
+    and then writing out the live fraction `u` of it, and frees up `1 - u` of an
+    extent. That space stays free for longer the older the extent's data is, since
+    data that has already lived for a long time is likely to keep on living. Ranking
+    by garbage alone keeps collecting recently written extents whose remaining blocks
+    are about to die anyway. The age is measured against
+    `gc_age_reference_time`, so that the order of extents in `gc_pq` doesn't change
+    behind its back. */
+    double cost_benefit() const {
+        const microtime_t reference_time = parent->gc_age_reference_time;
+        const double extent_size = parent->static_config->extent_size();
+        const double free_fraction = garbage_bytes() / extent_size;
+        const double live_fraction = 1.0 - free_fraction;
+        const double age = reference_time > timestamp
+            ? static_cast<double>(reference_time - timestamp) : 0.0;
+        return free_fraction * (age + 1.0) / (1.0 + live_fraction);
+    }
+
     bool block_is_garbage(unsigned int block_index) const {
         guarantee(state != state_reconstructing);
         guarantee(block_index < block_infos.size());
@@ -235,22 +277,27 @@ public:
         return std::lower_bound(block_infos.begin(), block_infos.end(), relative_offset, &gc_entry_t::info_less);
     }
 
-    void mark_live_indexwise_with_offset(int64_t offset, block_size_t block_size) {
+    void mark_live_indexwise_with_offset(int64_t offset, block_size_t block_size,
+                                         block_size_t ser_block_size) {
         guarantee(offset >= extent_ref.offset() && offset < extent_ref.offset() + UINT32_MAX);
 
         uint32_t relative_offset = offset - extent_ref.offset();
 
         auto it = find_lower_bound_iter(relative_offset);
         if (it == block_infos.end()) {
-            block_infos.push_back(block_info_t{relative_offset, block_size, false, true});
+            block_infos.push_back(block_info_t{relative_offset, block_size,
+                                               ser_block_size, false, true});
             update_stats(NULL, &block_infos.back());
         } else if (it->relative_offset > relative_offset) {
             guarantee(it->relative_offset >= relative_offset + aligned_value(block_size));
-            auto new_block = block_infos.insert(it, block_info_t{relative_offset, block_size, false, true});
+            auto new_block = block_infos.insert(it, block_info_t{relative_offset, block_size,
+                                                                 ser_block_size,
+                                                                 false, true});
             update_stats(NULL, &*new_block);
         } else {
             guarantee(it->relative_offset == relative_offset);
             guarantee(it->block_size == block_size);
+            guarantee(it->ser_block_size == ser_block_size);
             const block_info_t old_info = *it;
             it->index_referenced = true;
             update_stats(&old_info, &*it);
@@ -383,6 +430,8 @@ data_block_manager_t::data_block_manager_t(
         log_serializer_stats_t *_stats)
     : stats(_stats), shutdown_callback(NULL), state(state_unstarted),
       static_config(_static_config), extent_manager(em), serializer(_serializer),
+      cold_active_extent(NULL), gc_age_reference_time(current_microtime()),
+      read_ahead_detector(_static_config->extent_size(), APPROXIMATE_READ_AHEAD_SIZE),
       gc_stats(stats)
 {
     rassert(static_config != NULL);
@@ -406,7 +455,8 @@ void data_block_manager_t::start_reconstruct() {
 // gc_entry_t in the entries table.  (This is used when we start up, when
 // everything is presumed to be garbage, until we mark it as
 // non-garbage.)
-void data_block_manager_t::mark_live(int64_t offset, block_size_t ser_block_size) {
+void data_block_manager_t::mark_live(int64_t offset, block_size_t ser_block_size,
+                                     block_size_t disk_block_size) {
     uint64_t extent_id = static_config->extent_index(offset);
 
     if (entries.get(extent_id) == NULL) {
@@ -417,7 +467,7 @@ void data_block_manager_t::mark_live(int64_t offset, block_size_t ser_block_size
     }
 
     gc_entry_t *entry = entries.get(extent_id);
-    entry->mark_live_indexwise_with_offset(offset, ser_block_size);
+    entry->mark_live_indexwise_with_offset(offset, disk_block_size, ser_block_size);
 }
 
 void data_block_manager_t::end_reconstruct() {
@@ -428,8 +478,12 @@ void data_block_manager_t::start_existing(file_t *file,
                                           data_block_manager::metablock_mixin_t *last_metablock) {
     guarantee(state == state_unstarted);
     dbfile = file;
-    gc_io_account_nice.init(new file_account_t(file, GC_IO_PRIORITY_NICE));
-    gc_io_account_high.init(new file_account_t(file, GC_IO_PRIORITY_HIGH));
+    gc_io_account_nice.init(new file_account_t(file, GC_IO_PRIORITY_NICE,
+                                               UNLIMITED_OUTSTANDING_REQUESTS,
+                                               io_class_t::gc));
+    gc_io_account_high.init(new file_account_t(file, GC_IO_PRIORITY_HIGH,
+                                               UNLIMITED_OUTSTANDING_REQUESTS,
+                                               io_class_t::gc));
 
     /* Reconstruct the active data block extents from the metablock. */
     const int64_t offset = last_metablock->active_extent;
@@ -545,12 +599,13 @@ void read_ahead_interval(const int64_t block_offset,
 void read_ahead_offset_and_size(int64_t off_in,
                                 int64_t ser_block_size_in,
                                 int64_t extent_size,
+                                int64_t read_ahead_size,
                                 const std::vector<uint32_t> &boundaries,
                                 int64_t *offset_out, int64_t *size_out) {
     int64_t offset;
     int64_t end_offset;
     read_ahead_interval(off_in, ser_block_size_in, extent_size,
-                        APPROXIMATE_READ_AHEAD_SIZE,
+                        read_ahead_size,
                         DEVICE_BLOCK_SIZE,
                         boundaries,
                         &offset,
@@ -560,6 +615,68 @@ void read_ahead_offset_and_size(int64_t off_in,
     *size_out = end_offset - offset;
 }
 
+// Compressed blocks keep their `ls_buf_data_t` header uncompressed, so that
+// read-ahead and the GC can still tell which block they are looking at.  Only the
+// cache portion of the block is passed through zlib.
+
+// Returns false if compressing the block wouldn't save at least one device block on
+// disk, which is the only case in which it pays off.
+bool compress_block(const ser_buffer_t *buf, block_size_t block_size,
+                    io_buffer_t *data_out,
+                    block_size_t *disk_block_size_out) {
+    const uint32_t aligned_size = ceil_aligned(block_size.ser_value(), DEVICE_BLOCK_SIZE);
+    if (aligned_size <= DEVICE_BLOCK_SIZE) {
+        return false;
+    }
+    const uint32_t max_disk_size = aligned_size - DEVICE_BLOCK_SIZE;
+    if (max_disk_size <= sizeof(ls_buf_data_t)) {
+        return false;
+    }
+
+    io_buffer_t data(max_disk_size);
+    uLongf compressed_size = max_disk_size - sizeof(ls_buf_data_t);
+    // zlib fails with Z_BUF_ERROR if the result doesn't fit.
+    const int res = compress2(
+        reinterpret_cast<Bytef *>(data.get() + sizeof(ls_buf_data_t)),
+        &compressed_size,
+        reinterpret_cast<const Bytef *>(buf->cache_data),
+        block_size.value(),
+        Z_BEST_SPEED);
+    if (res != Z_OK) {
+        return false;
+    }
+
+    memcpy(data.get(), &buf->ser_header, sizeof(ls_buf_data_t));
+    const uint32_t disk_size = sizeof(ls_buf_data_t) + compressed_size;
+    memset(data.get() + disk_size, 0,
+           ceil_aligned(disk_size, DEVICE_BLOCK_SIZE) - disk_size);
+
+    *data_out = std::move(data);
+    *disk_block_size_out = block_size_t::unsafe_make(disk_size);
+    return true;
+}
+
+// Copies a block that has been read from disk into `buf_out`, decompressing it if
+// necessary.
+void decode_block(const char *data, block_size_t disk_block_size,
+                  block_size_t block_size, ser_buffer_t *buf_out) {
+    if (disk_block_size == block_size) {
+        memcpy(buf_out, data, block_size.ser_value());
+        return;
+    }
+
+    memcpy(&buf_out->ser_header, data, sizeof(ls_buf_data_t));
+    uLongf size = block_size.value();
+    const int res = uncompress(
+        reinterpret_cast<Bytef *>(buf_out->cache_data),
+        &size,
+        reinterpret_cast<const Bytef *>(data + sizeof(ls_buf_data_t)),
+        disk_block_size.ser_value() - sizeof(ls_buf_data_t));
+    guarantee(res == Z_OK && size == block_size.value(),
+              "Could not decompress block %" PRIi64 " (zlib error %d).",
+              buf_out->ser_header.block_id, res);
+}
+
 class dbm_read_ahead_t {
 public:
     static std::vector<uint32_t> get_boundaries(data_block_manager_t *parent,
@@ -573,8 +690,10 @@ public:
 
     static void perform_read_ahead(data_block_manager_t *const parent,
                                    const int64_t off_in,
-                                   const uint32_t ser_block_size_in,
-                                   void *const buf_out,
+                                   const block_size_t block_size_in,
+                                   const block_size_t disk_block_size_in,
+                                   const int64_t approximate_read_ahead_size,
+                                   ser_buffer_t *const buf_out,
                                    file_account_t *const io_account,
                                    log_serializer_stats_t *const stats) {
         const std::vector<uint32_t> boundaries = get_boundaries(parent, off_in);
@@ -584,14 +703,14 @@ public:
 
         // Finish initialization.
         read_ahead_offset_and_size(off_in,
-                                   ser_block_size_in,
+                                   disk_block_size_in.ser_value(),
                                    parent->static_config->extent_size(),
+                                   approximate_read_ahead_size,
                                    boundaries,
                                    &read_ahead_offset,
                                    &read_ahead_size);
 
-        scoped_malloc_t<char> read_ahead_buf(
-                malloc_aligned(read_ahead_size, DEVICE_BLOCK_SIZE));
+        io_buffer_t read_ahead_buf(read_ahead_size);
 
         // Do the disk read!
         co_read(parent->dbfile, read_ahead_offset, read_ahead_size,
@@ -622,7 +741,7 @@ public:
             if (current_offset == off_in) {
                 guarantee(!handled_required_block);
 
-                memcpy(buf_out, current_buf, ser_block_size_in);
+                decode_block(current_buf, disk_block_size_in, block_size_in, buf_out);
                 handled_required_block = true;
             } else {
                 const block_id_t block_id
@@ -639,14 +758,17 @@ public:
                 }
 
                 const block_size_t block_size = block_size_t::unsafe_make(info.ser_block_size);
+                const block_size_t disk_block_size
+                    = block_size_t::unsafe_make(info.disk_block_size());
+                guarantee(disk_block_size.ser_value() <= *(lower_it + 1) - *lower_it);
                 buf_ptr_t buf = buf_ptr_t::alloc_uninitialized(block_size);
-                memcpy(buf.ser_buffer(), current_buf, info.ser_block_size);
+                decode_block(current_buf, disk_block_size, block_size, buf.ser_buffer());
                 buf.fill_padding_zero();
-                guarantee(info.ser_block_size <= *(lower_it + 1) - *lower_it);
 
                 counted_t<ls_block_token_pointee_t> ls_token
                     = parent->serializer->generate_block_token(current_offset,
-                                                               block_size);
+                                                               block_size,
+                                                               disk_block_size);
 
                 counted_t<standard_block_token_t> token
                     = to_standard_block_token(block_id, std::move(ls_token));
@@ -662,7 +784,11 @@ public:
     }
 };
 
-bool data_block_manager_t::should_perform_read_ahead(int64_t offset) {
+int64_t data_block_manager_t::choose_read_ahead_size(int64_t offset) {
+    // We keep track of every read, so that we notice traversals even if they
+    // start in extents that we don't read ahead in.
+    const int64_t detected_size = read_ahead_detector.record_read(offset);
+
     uint64_t extent_id = static_config->extent_index(offset);
 
     gc_entry_t *entry = entries.get(extent_id);
@@ -670,22 +796,38 @@ bool data_block_manager_t::should_perform_read_ahead(int64_t offset) {
     // If the extent was written, we don't perform read ahead because it would
     // a) be potentially useless and b) has an elevated risk of conflicting with
     // active writes on the io queue.
-    return !entry->was_written && serializer->should_perform_read_ahead();
+    if (entry->was_written || !serializer->should_perform_read_ahead()) {
+        return 0;
+    }
+
+    switch (serializer->dynamic_config.read_ahead) {
+    case read_ahead_mode_t::off:
+        return 0;
+    case read_ahead_mode_t::always:
+        return APPROXIMATE_READ_AHEAD_SIZE;
+    case read_ahead_mode_t::adaptive:
+        return detected_size;
+    default:
+        unreachable();
+    }
 }
 
 buf_ptr_t data_block_manager_t::read(int64_t off_in, block_size_t block_size,
-                                   file_account_t *io_account) {
+                                     block_size_t disk_block_size,
+                                     file_account_t *io_account) {
     guarantee(state == state_ready);
-    if (should_perform_read_ahead(off_in)) {
+    const int64_t read_ahead_size = choose_read_ahead_size(off_in);
+    if (read_ahead_size > 0) {
         buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(block_size);
-        dbm_read_ahead_t::perform_read_ahead(this, off_in, block_size.ser_value(),
-                                             ret.ser_buffer(), io_account, stats);
+        dbm_read_ahead_t::perform_read_ahead(this, off_in, block_size, disk_block_size,
+                                             read_ahead_size, ret.ser_buffer(),
+                                             io_account, stats);
         // We have to fill the padding with zero, since only the first part of the
         // buf got memcpy'd into.
         ret.fill_padding_zero();
         return ret;
     } else {
-        if (divides(DEVICE_BLOCK_SIZE, off_in)) {
+        if (divides(DEVICE_BLOCK_SIZE, off_in) && disk_block_size == block_size) {
             buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(block_size);
             co_read(dbfile, off_in, ret.aligned_block_size(),
                     ret.ser_buffer(), io_account);
@@ -696,17 +838,16 @@ buf_ptr_t data_block_manager_t::read(int64_t off_in, block_size_t block_size,
             return ret;
         } else {
             int64_t floor_off_in = floor_aligned(off_in, DEVICE_BLOCK_SIZE);
-            int64_t ceil_off_end = ceil_aligned(off_in + block_size.ser_value(),
+            int64_t ceil_off_end = ceil_aligned(off_in + disk_block_size.ser_value(),
                                                 DEVICE_BLOCK_SIZE);
-            scoped_malloc_t<char> buf(malloc_aligned(ceil_off_end - floor_off_in,
-                                                     DEVICE_BLOCK_SIZE));
+            io_buffer_t buf(ceil_off_end - floor_off_in);
             co_read(dbfile, floor_off_in, ceil_off_end - floor_off_in,
                     buf.get(), io_account);
 
             buf_ptr_t ret = buf_ptr_t::alloc_uninitialized(block_size);
-            memcpy(ret.ser_buffer(), buf.get() + (off_in - floor_off_in),
-                   block_size.ser_value());
-            stats->bytes_read(ret.aligned_block_size());
+            decode_block(buf.get() + (off_in - floor_off_in), disk_block_size,
+                         block_size, ret.ser_buffer());
+            stats->bytes_read(ceil_off_end - floor_off_in);
             // We have to fill the padding to zero, in this case.
             ret.fill_padding_zero();
             return ret;
@@ -718,15 +859,88 @@ std::vector<counted_t<ls_block_token_pointee_t> >
 data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
                                   file_account_t *io_account,
                                   iocallback_t *cb) {
+    const bool compress = serializer->should_compress_blocks();
+
+    /* Put the hot blocks first and the cold ones after them, so that each group can
+    be written with as few i/o operations as possible. `order[i]` is the index in
+    `writes` of the `i`th write we do. */
+    const microtime_t now = current_microtime();
+    std::vector<size_t> order;
+    order.reserve(writes.size());
+    std::vector<gc_entry_t **> targets(writes.size());
+    for (size_t i = 0; i < writes.size(); ++i) {
+        targets[i] = choose_target_extent(writes[i].block_id, now);
+        if (targets[i] == &active_extent) {
+            order.push_back(i);
+        }
+    }
+    for (size_t i = 0; i < writes.size(); ++i) {
+        if (targets[i] != &active_extent) {
+            order.push_back(i);
+        }
+    }
+
+    std::vector<encoded_write_t> encoded_writes;
+    encoded_writes.reserve(writes.size());
+    std::vector<io_buffer_t> buffers;
+    for (auto ix = order.begin(); ix != order.end(); ++ix) {
+        const buf_write_info_t *it = &writes[*ix];
+        it->buf->ser_header.block_id = it->block_id;
+
+        io_buffer_t compressed;
+        block_size_t disk_block_size = it->block_size;
+        if (compress
+            && compress_block(it->buf, it->block_size, &compressed, &disk_block_size)) {
+            encoded_writes.push_back(encoded_write_t{
+                    reinterpret_cast<const ser_buffer_t *>(compressed.get()),
+                    it->block_size, disk_block_size, targets[*ix]});
+            buffers.push_back(std::move(compressed));
+            ++stats->pm_serializer_compressed_blocks;
+            stats->pm_serializer_compressed_bytes_saved
+                += it->block_size.ser_value() - disk_block_size.ser_value();
+        } else {
+            encoded_writes.push_back(encoded_write_t{it->buf, it->block_size,
+                                                     it->block_size, targets[*ix]});
+        }
+    }
+
+    std::vector<counted_t<ls_block_token_pointee_t> > tokens
+        = write_encoded(encoded_writes, std::move(buffers), io_account, cb);
+    guarantee(tokens.size() == writes.size());
+
+    std::vector<counted_t<ls_block_token_pointee_t> > result(writes.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        result[order[i]] = std::move(tokens[i]);
+    }
+    return result;
+}
+
+gc_entry_t **
+data_block_manager_t::choose_target_extent(block_id_t block_id, microtime_t now) {
+    const flagged_off64_t old_offset = serializer->lba_index->get_block_offset(block_id);
+    if (!old_offset.has_value()) {
+        // A new block. We don't know anything about it yet.
+        return &active_extent;
+    }
+    gc_entry_t *old_entry
+        = entries.get(static_config->extent_index(old_offset.get_value()));
+    if (old_entry != NULL && now > old_entry->timestamp
+        && now - old_entry->timestamp >= GC_COLD_BLOCK_MIN_AGE_MICROS) {
+        return &cold_active_extent;
+    }
+    return &active_extent;
+}
+
+std::vector<counted_t<ls_block_token_pointee_t> >
+data_block_manager_t::write_encoded(const std::vector<encoded_write_t> &writes,
+                                    std::vector<io_buffer_t> &&buffers,
+                                    file_account_t *io_account,
+                                    iocallback_t *cb) {
     // These tokens are grouped by extent.  You can do a contiguous write in each
     // extent.
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > token_groups
         = gimme_some_new_offsets(writes);
 
-    for (auto it = writes.begin(); it != writes.end(); ++it) {
-        it->buf->ser_header.block_id = it->block_id;
-    }
-
     struct intermediate_cb_t : public iocallback_t {
         virtual void on_io_complete() {
             --ops_remaining;
@@ -739,20 +953,24 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
 
         size_t ops_remaining;
         iocallback_t *cb;
+        std::vector<io_buffer_t> buffers;
     };
 
     intermediate_cb_t *const intermediate_cb = new intermediate_cb_t;
+    intermediate_cb->buffers = std::move(buffers);
     // We add 1 for degenerate case where token_groups is empty -- we call
     // intermediate_cb->on_io_complete later.
     intermediate_cb->ops_remaining = token_groups.size() + 1;
     intermediate_cb->cb = cb;
 
+    const bool ordered = serializer->should_order_writes();
+
     size_t write_number = 0;
     for (size_t i = 0; i < token_groups.size(); ++i) {
 
         const int64_t front_offset = token_groups[i].front()->offset();
         const int64_t back_offset = token_groups[i].back()->offset()
-            + gc_entry_t::aligned_value(token_groups[i].back()->block_size());
+            + gc_entry_t::aligned_value(token_groups[i].back()->disk_block_size());
 
         guarantee(divides(DEVICE_BLOCK_SIZE, front_offset));
 
@@ -765,19 +983,31 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
 
         for (size_t j = 0; j < token_groups[i].size(); ++j) {
             const int64_t j_offset = token_groups[i][j]->offset();
-            const block_size_t j_block_size = token_groups[i][j]->block_size();
+            const block_size_t j_block_size = token_groups[i][j]->disk_block_size();
             guarantee(j_offset == last_written_offset);
             const size_t j_aligned_size = gc_entry_t::aligned_value(j_block_size);
             total_aligned_size += j_aligned_size;
 
             // The behavior of gimme_some_new_offsets is supposed to retain order, so
             // we expect writes[write_number] to have the currently-relevant write.
-            guarantee(writes[write_number].block_size == j_block_size);
+            guarantee(writes[write_number].disk_block_size == j_block_size);
 
-            iovecs[j].iov_base = writes[write_number].buf;
+            // writev doesn't write to the buffers, it just takes non-const iovecs.
+            iovecs[j].iov_base = const_cast<ser_buffer_t *>(writes[write_number].data);
             iovecs[j].iov_len = j_aligned_size;
             last_written_offset = j_offset + j_aligned_size;
 
+            if (ordered) {
+                // The metablock will refer to the block through a checksum, so
+                // that it can be written without waiting for the block to get
+                // synced.
+                boost::crc_32_type crc_computer;
+                crc_computer.process_bytes(writes[write_number].data,
+                                           j_block_size.ser_value());
+                token_groups[i][j]->has_disk_crc_ = true;
+                token_groups[i][j]->disk_crc_ = crc_computer.checksum();
+            }
+
             ++write_number;
         }
 
@@ -787,6 +1017,7 @@ data_block_manager_t::many_writes(const std::vector<buf_write_info_t> &writes,
                              std::move(iovecs), io_account, intermediate_cb);
 
         stats->bytes_written(total_aligned_size);
+        stats->coalesced_write(token_groups[i].size());
     }
 
     // Call on_io_complete for degenerate case (we added 1 to ops_remaining
@@ -1015,7 +1246,7 @@ void data_block_manager_t::run_gc(gc_state_t *gc_state) {
 
 void data_block_manager_t::gc_one_extent(gc_state_t *gc_state) {
     // A buffer for blocks we're transferring.
-    scoped_malloc_t<char> gc_blocks;
+    io_buffer_t gc_blocks;
     size_t total_bytes_read = 0;
 
     // A helper for waiting for all reads to finish
@@ -1040,6 +1271,7 @@ void data_block_manager_t::gc_one_extent(gc_state_t *gc_state) {
         ++stats->pm_serializer_data_extents_gced;
 
         /* grab the entry */
+        refresh_gc_ages();
         guarantee (!gc_pq.empty());
         guarantee(gc_state->current_entry == NULL);
         gc_state->current_entry = gc_pq.pop();
@@ -1059,7 +1291,7 @@ void data_block_manager_t::gc_one_extent(gc_state_t *gc_state) {
         // once manually when we have issued all reads.
         read_cb.refcount++;
 
-        gc_blocks.init(malloc_aligned(extent_manager->extent_size, DEVICE_BLOCK_SIZE));
+        gc_blocks = io_buffer_t(extent_manager->extent_size);
 
         // We're going to send as few discrete reads as possible, minimizing
         // disk->CPU bandwidth usage, instead of simply reading the entire
@@ -1092,7 +1324,7 @@ void data_block_manager_t::gc_one_extent(gc_state_t *gc_state) {
                                 gc_blocks.get() + current_interval_begin,
                                 choose_gc_io_account(),
                                 &read_cb);
-                        total_bytes_read += current_interval_end - current_interval_end;
+                        total_bytes_read += current_interval_end - current_interval_begin;
                     }
 
                     current_interval_begin = beg;
@@ -1110,7 +1342,7 @@ void data_block_manager_t::gc_one_extent(gc_state_t *gc_state) {
                 gc_blocks.get() + current_interval_begin,
                 choose_gc_io_account(),
                 &read_cb);
-        total_bytes_read += current_interval_end - current_interval_end;
+        total_bytes_read += current_interval_end - current_interval_begin;
 
         // Ok, all reads have been issued. Call `on_io_complete()` once to allow
         // `read_cb` to be pulsed (see comment above).
@@ -1120,6 +1352,7 @@ void data_block_manager_t::gc_one_extent(gc_state_t *gc_state) {
     /* Wait for the reads to finish */
     read_cb.wait_lazily_unordered();
     stats->bytes_read(total_bytes_read);
+    stats->pm_serializer_gc_read_bytes_total += total_bytes_read;
 
     /* If other forces cause all of the blocks in the extent to become
     garbage before we even finish GCing it, they will set current_entry
@@ -1151,6 +1384,7 @@ void data_block_manager_t::gc_one_extent(gc_state_t *gc_state) {
                 + gc_state->current_entry->relative_offset(i);
 
             gc_writes.push_back(gc_write_t(block, block_offset,
+                                           gc_state->current_entry->ser_block_size(i),
                                            gc_state->current_entry->block_size(i)));
         }
         guarantee(gc_writes.size() == num_writes);
@@ -1199,19 +1433,24 @@ void data_block_manager_t::write_gcs(const std::vector<gc_write_t> &writes,
         // Step 1: Write buffers to disk and assemble index operations
         ASSERT_NO_CORO_WAITING;
 
-        std::vector<buf_write_info_t> the_writes;
+        std::vector<encoded_write_t> the_writes;
         the_writes.reserve(writes.size());
         for (size_t i = 0; i < writes.size(); ++i) {
             old_block_tokens.push_back(serializer->generate_block_token(writes[i].old_offset,
-                                                                        writes[i].block_size));
-
-            the_writes.push_back(buf_write_info_t(writes[i].buf,
-                                                  writes[i].block_size,
-                                                  writes[i].buf->ser_header.block_id));
+                                                                        writes[i].block_size,
+                                                                        writes[i].disk_block_size));
+            stats->pm_serializer_gc_written_bytes_total
+                += gc_entry_t::aligned_value(writes[i].disk_block_size);
+
+            // The blocks are moved exactly as they are on disk, compressed or not.
+            the_writes.push_back(encoded_write_t{writes[i].buf,
+                                                 writes[i].block_size,
+                                                 writes[i].disk_block_size,
+                                                 &cold_active_extent});
         }
 
-        new_block_tokens = many_writes(the_writes, choose_gc_io_account(),
-                                       &block_write_cond);
+        new_block_tokens = write_encoded(the_writes, std::vector<io_buffer_t>(),
+                                         choose_gc_io_account(), &block_write_cond);
 
         guarantee(new_block_tokens.size() == writes.size());
     }
@@ -1314,6 +1553,12 @@ void data_block_manager_t::actually_shutdown() {
         active_extent = NULL;
     }
 
+    if (cold_active_extent != NULL) {
+        UNUSED int64_t extent = cold_active_extent->extent_ref.release();
+        delete cold_active_extent;
+        cold_active_extent = NULL;
+    }
+
     while (gc_entry_t *entry = young_extent_queue.head()) {
         young_extent_queue.remove(entry);
         UNUSED int64_t extent = entry->extent_ref.release();
@@ -1332,43 +1577,56 @@ void data_block_manager_t::actually_shutdown() {
 }
 
 std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes) {
+data_block_manager_t::gimme_some_new_offsets(const std::vector<encoded_write_t> &writes) {
     ASSERT_NO_CORO_WAITING;
 
-    // Start a new extent if necessary.
-    if (active_extent == NULL) {
-        active_extent = new gc_entry_t(this);
-        ++stats->pm_serializer_data_extents_allocated;
-    }
-
-
-    guarantee(active_extent->state == gc_entry_t::state_active);
-
     std::vector<std::vector<counted_t<ls_block_token_pointee_t> > > ret;
 
     std::vector<counted_t<ls_block_token_pointee_t> > tokens;
+    gc_entry_t **previous_target = NULL;
     for (auto it = writes.begin(); it != writes.end(); ++it) {
+        gc_entry_t *&active = *it->target_extent;
+        // Long-lived blocks go to the slow tier, if there is one.
+        const extent_tier_t tier = it->target_extent == &cold_active_extent
+            ? extent_tier_t::slow
+            : extent_tier_t::fast;
+
+        // Start a new extent if necessary.
+        if (active == NULL) {
+            active = new gc_entry_t(this, tier);
+            ++stats->pm_serializer_data_extents_allocated;
+        }
+        guarantee(active->state == gc_entry_t::state_active);
+
+        // Writes to a different extent can't be part of the same group.
+        if (it->target_extent != previous_target && !tokens.empty()) {
+            ret.push_back(std::move(tokens));
+            tokens.clear();
+        }
+        previous_target = it->target_extent;
+
         uint32_t relative_offset = valgrind_undefined<uint32_t>(UINT32_MAX);
         unsigned int block_index = valgrind_undefined<unsigned int>(UINT_MAX);
-        if (!active_extent->new_offset(it->block_size,
-                                       &relative_offset, &block_index)) {
-            // Move the active_extent gc_entry_t to the young extent queue (if it's
+        if (!active->new_offset(it->disk_block_size, it->ser_block_size,
+                                &relative_offset, &block_index)) {
+            // Move the active gc_entry_t to the young extent queue (if it's
             // not already empty), and make a new gc_entry_t.
-            if (active_extent->num_live_blocks() == 0) {
-                gc_entry_t *old_active_extent = active_extent;
-                active_extent = new gc_entry_t(this);
+            if (active->num_live_blocks() == 0) {
+                gc_entry_t *old_active_extent = active;
+                active = new gc_entry_t(this, tier);
                 destroy_entry(old_active_extent);
             } else {
-                active_extent->state = gc_entry_t::state_young;
-                young_extent_queue.push_back(active_extent);
+                active->state = gc_entry_t::state_young;
+                young_extent_queue.push_back(active);
                 mark_unyoung_entries();
-                active_extent = new gc_entry_t(this);
+                active = new gc_entry_t(this, tier);
             }
 
             ++stats->pm_serializer_data_extents_allocated;
-            const bool succeeded = active_extent->new_offset(it->block_size,
-                                                             &relative_offset,
-                                                             &block_index);
+            const bool succeeded = active->new_offset(it->disk_block_size,
+                                                      it->ser_block_size,
+                                                      &relative_offset,
+                                                      &block_index);
             guarantee(succeeded);
 
             // Push the current group of tokens, if it's nonempty, onto the return vector.
@@ -1378,11 +1636,12 @@ data_block_manager_t::gimme_some_new_offsets(const std::vector<buf_write_info_t>
             }
         }
 
-        const int64_t offset = active_extent->extent_ref.offset() + relative_offset;
-        active_extent->was_written = true;
-        active_extent->mark_live_tokenwise(block_index);
+        const int64_t offset = active->extent_ref.offset() + relative_offset;
+        active->was_written = true;
+        active->mark_live_tokenwise(block_index);
 
-        tokens.push_back(serializer->generate_block_token(offset, it->block_size));
+        tokens.push_back(serializer->generate_block_token(offset, it->ser_block_size,
+                                                          it->disk_block_size));
     }
 
     if (!tokens.empty()) {
@@ -1450,7 +1709,17 @@ bool data_block_manager_t::do_we_want_to_start_gcing() const {
 }
 
 bool gc_entry_less_t::operator()(const gc_entry_t *x, const gc_entry_t *y) {
-    return x->garbage_bytes() < y->garbage_bytes();
+    return x->cost_benefit() < y->cost_benefit();
+}
+
+void data_block_manager_t::refresh_gc_ages() {
+    ASSERT_NO_CORO_WAITING;
+    const microtime_t now = current_microtime();
+    if (now - gc_age_reference_time < GC_AGE_REFRESH_INTERVAL_MICROS) {
+        return;
+    }
+    gc_age_reference_time = now;
+    gc_pq.rebuild();
 }
 
 /****************
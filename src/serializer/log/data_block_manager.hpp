@@ -12,6 +12,8 @@
 #include "perfmon/types.hpp"
 #include "serializer/log/config.hpp"
 #include "serializer/log/extent_manager.hpp"
+#include "serializer/io_buffer_pool.hpp"
+#include "serializer/log/read_ahead_detector.hpp"
 #include "serializer/types.hpp"
 
 class buf_ptr_t;
@@ -19,6 +21,8 @@ class log_serializer_t;
 class data_block_manager_t;
 class gc_entry_t;
 
+/* Orders extents by how much we gain from collecting them, relative to what it costs.
+See `gc_entry_t::cost_benefit()`. */
 struct gc_entry_less_t {
     bool operator() (const gc_entry_t *x, const gc_entry_t *y);
 };
@@ -46,7 +50,7 @@ public:
     void start_existing(file_t *dbfile, data_block_manager::metablock_mixin_t *last_metablock);
 
     buf_ptr_t read(int64_t off_in, block_size_t block_size,
-                 file_account_t *io_account);
+                   block_size_t disk_block_size, file_account_t *io_account);
 
     /* exposed gc api */
     /* mark a buffer as garbage */
@@ -54,7 +58,8 @@ public:
 
     /* r{start,end}_reconstruct functions for safety */
     void start_reconstruct();
-    void mark_live(int64_t offset, block_size_t block_size);
+    void mark_live(int64_t offset, block_size_t block_size,
+                   block_size_t disk_block_size);
     void end_reconstruct();
 
     /* We must make sure that blocks which have tokens pointing to them don't
@@ -75,17 +80,50 @@ public:
     // ratio of garbage to blocks in the system
     double garbage_ratio() const;
 
+    /* Compresses the blocks first if `log_serializer_dynamic_config_t::compress_blocks`
+    is set. */
     std::vector<counted_t<ls_block_token_pointee_t> >
     many_writes(const std::vector<buf_write_info_t> &writes,
                 file_account_t *io_account,
                 iocallback_t *cb);
 
-    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
-    gimme_some_new_offsets(const std::vector<buf_write_info_t> &writes);
-
     bool is_gc_active() const;
 
 private:
+    // A block the way it gets written to disk: `data` points to `disk_block_size`
+    // bytes, which hold the compressed form of the block if `disk_block_size` is
+    // less than `ser_block_size`.
+    struct encoded_write_t {
+        const ser_buffer_t *data;
+        block_size_t ser_block_size;
+        block_size_t disk_block_size;
+        // The active extent to put the block into, either `&active_extent` or
+        // `&cold_active_extent`.
+        gc_entry_t **target_extent;
+    };
+
+    // `buffers` are kept alive until the writes have completed.
+    std::vector<counted_t<ls_block_token_pointee_t> >
+    write_encoded(const std::vector<encoded_write_t> &writes,
+                  std::vector<io_buffer_t> &&buffers,
+                  file_account_t *io_account,
+                  iocallback_t *cb);
+
+    // Allocates space for each of `writes` at the end of its target extent, starting
+    // new extents as needed. Writes that go to the same extent should be next to each
+    // other, or they will be split into more i/o operations than necessary.
+    std::vector<std::vector<counted_t<ls_block_token_pointee_t> > >
+    gimme_some_new_offsets(const std::vector<encoded_write_t> &writes);
+
+    // Guesses whether the block is going to be overwritten soon, based on how long
+    // its current version has been around, and picks the active extent to write it
+    // to accordingly.
+    gc_entry_t **choose_target_extent(block_id_t block_id, microtime_t now);
+
+    // Refreshes `gc_age_reference_time` and reorders `gc_pq` accordingly, if the
+    // reference time is getting stale.
+    void refresh_gc_ages();
+
     void actually_shutdown();
 
     struct gc_state_t : public intrusive_list_node_t<gc_state_t>{
@@ -104,10 +142,13 @@ private:
         ser_buffer_t *buf;
         int64_t old_offset;
         block_size_t block_size;
+        // The size of `buf`, which differs from `block_size` if the block is
+        // compressed.  The GC moves compressed blocks without decompressing them.
+        block_size_t disk_block_size;
         gc_write_t(ser_buffer_t *b, int64_t _old_offset,
-                   block_size_t _block_size)
+                   block_size_t _block_size, block_size_t _disk_block_size)
             : buf(b), old_offset(_old_offset),
-              block_size(_block_size) { }
+              block_size(_block_size), disk_block_size(_disk_block_size) { }
     };
 
     /* Runs in a coroutine and keeps calling `gc_one_extent()` for as long as
@@ -145,7 +186,9 @@ private:
 
     void destroy_entry(gc_entry_t *entry);
 
-    bool should_perform_read_ahead(int64_t offset);
+    // Records a read at `offset` and returns how much to read around it, or 0 if we
+    // shouldn't read ahead.
+    int64_t choose_read_ahead_size(int64_t offset);
 
     log_serializer_stats_t *const stats;
 
@@ -177,15 +220,32 @@ private:
     /* Contains every extent in the gc_entry_t::state_reconstructing state */
     intrusive_list_t<gc_entry_t> reconstructed_extents;
 
-    /* Contains the extent in the gc_entry_t::state_active state. */
+    /* Contains the extent in the gc_entry_t::state_active state that new writes go
+    to. */
     gc_entry_t *active_extent;
 
+    /* Contains the extent in the gc_entry_t::state_active state that long-lived
+    blocks go to: those that the GC moves, and those whose previous version had been
+    around for at least `GC_COLD_BLOCK_MIN_AGE_MICROS`. Keeping them apart from
+    frequently overwritten blocks means that extents end up either mostly garbage or
+    mostly live, which is what makes GC cheap. This isn't recorded in the metablock;
+    after a restart it's treated like any other old extent. */
+    gc_entry_t *cold_active_extent;
+
     /* Contains every extent in the gc_entry_t::state_young state */
     intrusive_list_t<gc_entry_t> young_extent_queue;
 
     /* Contains every extent in the gc_entry_t::state_old state */
     priority_queue_t<gc_entry_t *, gc_entry_less_t> gc_pq;
 
+    /* The time that `gc_pq` measures the age of extents against. It is only updated
+    together with a full reordering of `gc_pq`, since changing it can change the
+    relative order of any two entries. */
+    microtime_t gc_age_reference_time;
+
+    // Tells sequential reads from random ones, for `choose_read_ahead_size()`.
+    read_ahead_detector_t read_ahead_detector;
+
     /* \brief structure to keep track of global stats about the data blocks
      */
     class gc_stat_t {
@@ -1,7 +1,7 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "serializer/log/extent_manager.hpp"
 
-#include <queue>
+#include <set>
 
 #include "arch/arch.hpp"
 #include "logger.hpp"
@@ -44,6 +44,10 @@ public:
 class extent_zone_t {
     const uint64_t extent_size;
 
+    // The id of the first extent in the slow tier, or SIZE_MAX if there's no slow
+    // tier.
+    const size_t slow_tier_begin;
+
     size_t offset_to_id(int64_t extent) const {
         rassert(divides(extent_size, extent));
         return extent / extent_size;
@@ -51,31 +55,75 @@ class extent_zone_t {
 
     /* free-list and extent map. Contains one entry per extent.  During the
     state_reserving_extents phase, each extent has state state_unreserved or
-    state state_in_use. When we transition to the state_running phase, we link
-    all of the state_unreserved entries in each zone together into extent free
-    queue.  The free queue can contain entries that point past the end of
-    extents, if the file size ever gets shrunk. */
+    state state_in_use. When we transition to the state_running phase, we add
+    all of the state_unreserved entries to the set of free extents. */
 
     std::vector<extent_info_t> extents;
 
-    // We want to remove the minimum element from the free_queue first, leaving
-    // free extents at the end of the file.
-    std::priority_queue<size_t,
-                        std::vector<size_t>,
-                        std::greater<size_t> > free_queue;
+    // We hand out the lowest free extent (of the right tier) first, leaving free
+    // extents at the end of the file.  Contains only ids below `extents.size()`.
+    std::set<size_t> free_extents;
 
     file_t *const dbfile;
 
     // The number of free extents in the file.
     size_t held_extents_;
 
+    size_t append_extent() {
+        extents.push_back(extent_info_t());
+        return extents.size() - 1;
+    }
+
+    void push_free_extent(size_t id) {
+        extents[id].set_state(extent_info_t::state_free);
+        free_extents.insert(id);
+        ++held_extents_;
+    }
+
+    size_t pop_free_extent(std::set<size_t>::iterator it) {
+        const size_t id = *it;
+        free_extents.erase(it);
+        --held_extents_;
+        return id;
+    }
+
+    size_t gen_fast_extent_id() {
+        if (!free_extents.empty() && *free_extents.begin() < slow_tier_begin) {
+            return pop_free_extent(free_extents.begin());
+        } else if (extents.size() < slow_tier_begin) {
+            return append_extent();
+        } else if (!free_extents.empty()) {
+            // The fast tier is full.
+            return pop_free_extent(free_extents.begin());
+        } else {
+            return append_extent();
+        }
+    }
+
+    size_t gen_slow_extent_id() {
+        auto it = free_extents.lower_bound(slow_tier_begin);
+        if (it != free_extents.end()) {
+            return pop_free_extent(it);
+        }
+        // Grow the file into the slow tier.  Whatever is left of the fast tier
+        // becomes free space.
+        while (extents.size() < slow_tier_begin) {
+            push_free_extent(append_extent());
+        }
+        return append_extent();
+    }
+
 public:
     size_t held_extents() const {
         return held_extents_;
     }
 
-    extent_zone_t(file_t *_dbfile, uint64_t _extent_size)
-        : extent_size(_extent_size), dbfile(_dbfile), held_extents_(0) {
+    extent_zone_t(file_t *_dbfile, uint64_t _extent_size, int64_t slow_tier_offset)
+        : extent_size(_extent_size),
+          slow_tier_begin(slow_tier_offset == -1
+                          ? SIZE_MAX
+                          : offset_to_id(slow_tier_offset)),
+          dbfile(_dbfile), held_extents_(0) {
         // (Avoid a bunch of reallocations by resize calls (avoiding O(n log n)
         // work on average).)
         extents.reserve(dbfile->get_file_size() / extent_size);
@@ -96,35 +144,18 @@ public:
     void reconstruct_free_list() {
         for (size_t extent_id = 0; extent_id < extents.size(); ++extent_id) {
             if (extents[extent_id].state() == extent_info_t::state_unreserved) {
-                extents[extent_id].set_state(extent_info_t::state_free);
-                free_queue.push(extent_id);
-                ++held_extents_;
+                push_free_extent(extent_id);
             }
         }
     }
 
-    extent_reference_t gen_extent() {
-        int64_t extent;
-
-        if (free_queue.empty()) {
-            rassert(held_extents_ == 0);
-            extent = extents.size() * extent_size;
-            extents.push_back(extent_info_t());
-        } else if (free_queue.top() >= extents.size()) {
-            rassert(held_extents_ == 0);
-            std::priority_queue<size_t,
-                                std::vector<size_t>,
-                                std::greater<size_t> > tmp;
-            free_queue = tmp;
-            extent = extents.size() * extent_size;
-            extents.push_back(extent_info_t());
-        } else {
-            extent = free_queue.top() * extent_size;
-            free_queue.pop();
-            --held_extents_;
-        }
+    extent_reference_t gen_extent(extent_tier_t tier) {
+        const size_t id = tier == extent_tier_t::slow && slow_tier_begin != SIZE_MAX
+            ? gen_slow_extent_id()
+            : gen_fast_extent_id();
+        const int64_t extent = id * extent_size;
 
-        extent_info_t *info = &extents[offset_to_id(extent)];
+        extent_info_t *info = &extents[id];
         info->set_state(extent_info_t::state_in_use);
 
         extent_reference_t extent_ref = make_extent_reference(extent);
@@ -134,6 +165,14 @@ public:
         return extent_ref;
     }
 
+    void reference_extents_in_use(std::vector<extent_reference_t> *refs_out) {
+        for (size_t extent_id = 0; extent_id < extents.size(); ++extent_id) {
+            if (extents[extent_id].state() == extent_info_t::state_in_use) {
+                refs_out->push_back(make_extent_reference(extent_id * extent_size));
+            }
+        }
+    }
+
     extent_reference_t make_extent_reference(const int64_t extent) {
         size_t id = offset_to_id(extent);
         guarantee(id < extents.size());
@@ -148,32 +187,14 @@ public:
         bool shrink_file = false;
         while (!extents.empty() && extents.back().state() == extent_info_t::state_free) {
             shrink_file = true;
+            DEBUG_VAR const size_t erased = free_extents.erase(extents.size() - 1);
+            rassert(erased == 1);
             --held_extents_;
             extents.pop_back();
         }
 
         if (shrink_file) {
             dbfile->set_file_size(extents.size() * extent_size);
-
-            // Prevent the existence of a relatively large free queue after the file
-            // size shrinks.
-            if (held_extents_ < free_queue.size() / 2) {
-                std::priority_queue<size_t,
-                                    std::vector<size_t>,
-                                    std::greater<size_t> > tmp;
-                for (size_t i = 0; i < held_extents_; ++i) {
-                    tmp.push(free_queue.top());
-                    free_queue.pop();
-                }
-
-                // held_extents_ was and will be the number of entries in the free_queue
-                // that _didn't_ point off the end of the file.  We just moved those
-                // entries to tmp.  The remaining entries must therefore point off the
-                // end of the file.  Check that no remaining entries point within the
-                // file.
-                guarantee(free_queue.top() >= extents.size(), "Tried to discard valid held extents.");
-                free_queue = std::move(tmp);
-            }
         }
     }
 
@@ -184,9 +205,7 @@ public:
         guarantee(info->extent_use_refcount > 0);
         --info->extent_use_refcount;
         if (info->extent_use_refcount == 0) {
-            info->set_state(extent_info_t::state_free);
-            free_queue.push(offset_to_id(extent));
-            ++held_extents_;
+            push_free_extent(offset_to_id(extent));
             try_shrink_file();
         }
     }
@@ -194,12 +213,16 @@ public:
 
 extent_manager_t::extent_manager_t(file_t *file,
                                    const log_serializer_on_disk_static_config_t *static_config,
+                                   int64_t slow_tier_offset,
                                    log_serializer_stats_t *_stats)
     : stats(_stats), extent_size(static_config->extent_size()),
       state(state_reserving_extents) {
     guarantee(divides(DEVICE_BLOCK_SIZE, extent_size));
 
-    zone.init(new extent_zone_t(file, extent_size));
+    guarantee(slow_tier_offset == -1
+              || (slow_tier_offset > 0 && divides(extent_size, slow_tier_offset)));
+
+    zone.init(new extent_zone_t(file, extent_size, slow_tier_offset));
 }
 
 extent_manager_t::~extent_manager_t() {
@@ -247,13 +270,13 @@ void extent_manager_t::begin_transaction(extent_transaction_t *out) {
     out->init();
 }
 
-extent_reference_t extent_manager_t::gen_extent() {
+extent_reference_t extent_manager_t::gen_extent(extent_tier_t tier) {
     assert_thread();
     rassert(state == state_running);
     ++stats->pm_extents_in_use;
     stats->pm_bytes_in_use += extent_size;
 
-    return zone->gen_extent();
+    return zone->gen_extent(tier);
 }
 
 extent_reference_t
@@ -262,6 +285,22 @@ extent_manager_t::copy_extent_reference(const extent_reference_t &extent_ref) {
     return zone->make_extent_reference(offset);
 }
 
+std::vector<extent_reference_t> extent_manager_t::pin_extents_in_use() {
+    assert_thread();
+    rassert(state == state_running);
+    std::vector<extent_reference_t> refs;
+    zone->reference_extents_in_use(&refs);
+    return refs;
+}
+
+void extent_manager_t::release_extent_pin(extent_reference_t &&extent_ref) {
+    assert_thread();
+    rassert(state == state_running);
+    // Unlike `release_extent()`, this doesn't touch the stats: the extent stopped
+    // counting as in use when its owner released it.
+    zone->release_extent(std::move(extent_ref));
+}
+
 void extent_manager_t::release_extent_into_transaction(extent_reference_t &&extent_ref, extent_transaction_t *txn) {
     release_extent_preliminaries();
     rassert(current_transaction);
@@ -18,6 +18,15 @@
 
 class extent_zone_t;
 
+// Which part of the file an extent should come from, if the file continues on a
+// second, slower device. See `serializer_file_opener_t::slow_tier_offset()`.
+enum class extent_tier_t {
+    // For extents that are written and read a lot.
+    fast,
+    // For extents that hold blocks that have been around for a long time.
+    slow
+};
+
 struct log_serializer_stats_t;
 
 // A reference to an extent in the extent manager.  An extent may not be freed until
@@ -96,8 +105,11 @@ public:
         int64_t padding;
     };
 
+    // `slow_tier_offset` is the (extent-aligned) offset at which the slow tier of
+    // the file starts, or -1 if there is only one tier.
     extent_manager_t(file_t *file,
                      const log_serializer_on_disk_static_config_t *static_config,
+                     int64_t slow_tier_offset,
                      log_serializer_stats_t *);
     ~extent_manager_t();
 
@@ -123,13 +135,22 @@ public:
     MUST_USE extent_reference_t copy_extent_reference(const extent_reference_t &copyee);
 
     void begin_transaction(extent_transaction_t *out);
-    MUST_USE extent_reference_t gen_extent();
+    // Without a slow tier, `tier` doesn't matter.  Otherwise we take the extent from
+    // the requested tier if we can, and from the other one if we must.
+    MUST_USE extent_reference_t gen_extent(extent_tier_t tier);
     void release_extent_into_transaction(extent_reference_t &&extent_ref,
                                          extent_transaction_t *txn);
     void release_extent(extent_reference_t &&extent_ref);
     void end_transaction(extent_transaction_t *t);
     void commit_transaction(extent_transaction_t *t);
 
+    /* `pin_extents_in_use()` takes an extra reference to every extent that is in use,
+    so that none of them gets reused (or overwritten) until the references are
+    handed back to `release_extent_pin()`. This is what keeps the extents that a
+    snapshot of the serializer refers to intact. */
+    std::vector<extent_reference_t> pin_extents_in_use();
+    void release_extent_pin(extent_reference_t &&extent_ref);
+
     /* Number of extents that have been released but not handed back out again. */
     size_t held_extents();
 
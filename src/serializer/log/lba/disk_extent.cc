@@ -45,11 +45,13 @@ void lba_disk_extent_t::sync(file_account_t *io_account, extent_t::sync_callback
     data->sync(cb);
 }
 
-void lba_disk_extent_t::read_step_1(read_info_t *info_out, extent_t::read_callback_t *cb) {
+void lba_disk_extent_t::read_step_1(read_info_t *info_out, file_account_t *io_account,
+                                    extent_t::read_callback_t *cb) {
     em->assert_thread();
     info_out->buffer = malloc_aligned(em->extent_size, DEVICE_BLOCK_SIZE);
     info_out->count = count;
-    data->read(0, sizeof(lba_extent_t) + sizeof(lba_entry_t) * count, info_out->buffer, cb);
+    data->read(0, sizeof(lba_extent_t) + sizeof(lba_entry_t) * count, info_out->buffer,
+               io_account, cb);
 }
 
 void lba_disk_extent_t::read_step_2(read_info_t *info, in_memory_index_t *index) {
@@ -61,7 +63,7 @@ void lba_disk_extent_t::read_step_2(read_info_t *info, in_memory_index_t *index)
         lba_entry_t *e = &extent->entries[i];
         if (!lba_entry_t::is_padding(e)) {
             index->set_block_info(e->block_id, e->recency, e->offset,
-                                  e->ser_block_size);
+                                  e->ser_block_size, e->compressed_block_size);
         }
     }
 
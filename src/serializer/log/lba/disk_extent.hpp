@@ -42,7 +42,8 @@ public:
         int count;
     };
 
-    void read_step_1(read_info_t *info_out, extent_t::read_callback_t *cb);
+    void read_step_1(read_info_t *info_out, file_account_t *io_account,
+                     extent_t::read_callback_t *cb);
     void read_step_2(read_info_t *info, in_memory_index_t *index);
 
     /* destroy() deletes the structure in memory and also tells the extent manager that the extent
@@ -64,9 +64,11 @@ struct lba_entry_t {
     // (It probably assumes that sizeof(lba_entry_t) evenly divides
     // DEVICE_BLOCK_SIZE).
 
-    // Put the zero-padding at the beginning of the LBA entry.  We could use this, or
-    // the first 16 bits, perhaps, as a version flag.
-    uint32_t zero_reserved;
+    // The number of bytes the block takes up on disk if it has been stored
+    // compressed, or 0 if it's stored as-is (in which case it takes up
+    // `ser_block_size` bytes).  This used to be zero padding, so LBA entries written
+    // before block compression existed read as uncompressed.
+    uint32_t compressed_block_size;
 
     // This could be a uint16_t if you wanted it to be, as long as block sizes are
     // all less than or equal to 4K (which is less than 64K).
@@ -80,10 +82,12 @@ struct lba_entry_t {
     flagged_off64_t offset;
 
     static lba_entry_t make(block_id_t block_id, repli_timestamp_t recency,
-                            flagged_off64_t offset, uint32_t ser_block_size) {
+                            flagged_off64_t offset, uint32_t ser_block_size,
+                            uint32_t compressed_block_size) {
         guarantee(ser_block_size != 0 || !offset.has_value());
+        guarantee(compressed_block_size < ser_block_size || compressed_block_size == 0);
         lba_entry_t entry;
-        entry.zero_reserved = 0;
+        entry.compressed_block_size = compressed_block_size;
         entry.ser_block_size = ser_block_size;
         entry.block_id = block_id;
         entry.recency = recency;
@@ -96,7 +100,7 @@ struct lba_entry_t {
     }
 
     static lba_entry_t make_padding_entry() {
-        return make(PADDING_BLOCK_ID, repli_timestamp_t::invalid, flagged_off64_t::padding(), 0);
+        return make(PADDING_BLOCK_ID, repli_timestamp_t::invalid, flagged_off64_t::padding(), 0, 0);
     }
 } __attribute__((__packed__));
 
@@ -128,7 +132,12 @@ struct lba_metablock_mixin_t {
      */
     lba_entry_t inline_lba_entries[LBA_NUM_INLINE_ENTRIES];
     int32_t inline_lba_entries_count;
-    int32_t padding;
+
+    /* Only meaningful in metablocks that have been written as ordered writes (see
+    `log_serializer_dynamic_config_t::ordered_writes`).  A CRC over the CRCs of the
+    data blocks that the inline entries added since the previous metablock refer to,
+    in the order of those entries.  This used to be zero padding. */
+    uint32_t ordered_write_crc;
 };
 
 
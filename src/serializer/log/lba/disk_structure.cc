@@ -9,7 +9,9 @@ lba_disk_structure_t::lba_disk_structure_t(extent_manager_t *_em, file_t *_file)
 {
 }
 
-lba_disk_structure_t::lba_disk_structure_t(extent_manager_t *_em, file_t *_file, lba_shard_metablock_t *metablock)
+lba_disk_structure_t::lba_disk_structure_t(extent_manager_t *_em, file_t *_file,
+                                           lba_shard_metablock_t *metablock,
+                                           file_account_t *io_account)
     : em(_em), file(_file)
 {
     if (metablock->last_lba_extent_offset != NULL_OFFSET) {
@@ -34,6 +36,7 @@ lba_disk_structure_t::lba_disk_structure_t(extent_manager_t *_em, file_t *_file,
             superblock_offset - superblock_extent_offset,
             superblock_size,
             startup_superblock_buffer,
+            io_account,
             this);
     } else {
         superblock_extent = NULL;
@@ -66,6 +69,7 @@ void lba_disk_structure_t::on_extent_read() {
 
 void lba_disk_structure_t::add_entry(block_id_t block_id, repli_timestamp_t recency,
                                      flagged_off64_t offset, uint32_t ser_block_size,
+                                     uint32_t compressed_block_size,
                                      file_account_t *io_account, extent_transaction_t *txn) {
     if (last_extent && last_extent->full()) {
         /* We have filled up an extent. Transfer it to the superblock. */
@@ -84,7 +88,9 @@ void lba_disk_structure_t::add_entry(block_id_t block_id, repli_timestamp_t rece
 
     rassert(!last_extent->full());
 
-    last_extent->add_entry(lba_entry_t::make(block_id, recency, offset, ser_block_size), io_account);
+    last_extent->add_entry(lba_entry_t::make(block_id, recency, offset, ser_block_size,
+                                             compressed_block_size),
+                           io_account);
 }
 
 std::set<lba_disk_extent_t *> lba_disk_structure_t::get_inactive_extents() const {
@@ -195,6 +201,7 @@ struct reader_t
 {
     lba_disk_structure_t *ds;   // The disk structure we are reading from
     in_memory_index_t *index;   // The in-memory-index we are reading into
+    file_account_t *io_account;   // The account we read the extents with
     lba_disk_structure_t::read_callback_t *rcb;   // Who to call back when we finish
 
     /* extent_reader_t takes care of reading a single extent. */
@@ -228,7 +235,7 @@ struct reader_t
         }
         void start_reading() {
             parent->active_readers++;
-            extent->read_step_1(&read_info, this);
+            extent->read_step_1(&read_info, parent->io_account, this);
         }
         void on_extent_read() {   // Called when our extent has been read from disk
             rassert(!have_read);
@@ -260,8 +267,9 @@ struct reader_t
     // reading process so that we stay under LBA_READ_BUFFER_SIZE.
     int active_readers;
 
-    reader_t(lba_disk_structure_t *_ds, in_memory_index_t *_index, lba_disk_structure_t::read_callback_t *cb)
-        : ds(_ds), index(_index), rcb(cb)
+    reader_t(lba_disk_structure_t *_ds, in_memory_index_t *_index,
+             file_account_t *_io_account, lba_disk_structure_t::read_callback_t *cb)
+        : ds(_ds), index(_index), io_account(_io_account), rcb(cb)
     {
         for (lba_disk_extent_t *e = ds->extents_in_superblock.head();
              e != NULL; e = ds->extents_in_superblock.next(e)) {
@@ -295,8 +303,9 @@ struct reader_t
     }
 };
 
-void lba_disk_structure_t::read(in_memory_index_t *index, read_callback_t *cb) {
-    new reader_t(this, index, cb);
+void lba_disk_structure_t::read(in_memory_index_t *index, file_account_t *io_account,
+                                read_callback_t *cb) {
+    new reader_t(this, index, io_account, cb);
 }
 
 void lba_disk_structure_t::prepare_metablock(lba_shard_metablock_t *mb_out) {
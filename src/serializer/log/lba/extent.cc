@@ -1,9 +1,12 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include "serializer/log/lba/extent.hpp"
 
+#include <sys/uio.h>
+
 #include <vector>
 
 #include "arch/arch.hpp"
+#include "containers/scoped.hpp"
 #include "math.hpp"
 #include "perfmon/perfmon.hpp"
 #include "serializer/log/stats.hpp"
@@ -26,18 +29,17 @@ struct extent_block_t :
         free(data);
     }
 
-    void write(file_account_t *io_account) {
+    // Chains this block behind the previous one.  The actual write is issued by
+    // `extent_t::flush_pending_blocks()`, together with its neighbours.
+    void enqueue() {
         waiting_for_prev = true;
         have_finished_sync = false;
 
-        parent->sync(this);
+        parent->chain_sync(this);
 
         if (parent->last_block) parent->last_block->is_last_block = false;
         parent->last_block = this;
         is_last_block = true;
-
-        parent->file->write_async(parent->extent_ref.offset() + offset, DEVICE_BLOCK_SIZE,
-                                  data, io_account, this, file_t::NO_DATASYNCS);
     }
 
     void on_extent_sync() {
@@ -64,15 +66,31 @@ struct extent_block_t :
     }
 };
 
+/* Completion for a run of contiguous blocks that has been written with a single
+`writev_async()`. */
+struct extent_block_run_t : public iocallback_t {
+    std::vector<extent_block_t *> blocks;
+
+    void on_io_complete() {
+        std::vector<extent_block_t *> to_complete;
+        to_complete.swap(blocks);
+        delete this;
+        for (auto it = to_complete.begin(); it != to_complete.end(); ++it) {
+            (*it)->on_io_complete();
+        }
+    }
+};
+
 extent_t::extent_t(extent_manager_t *_em, file_t *_file)
     : amount_filled(0), em(_em),
-      file(_file), last_block(NULL), current_block(NULL) {
-    extent_ref = em->gen_extent();
+      file(_file), last_block(NULL), current_block(NULL), pending_io_account(NULL) {
+    extent_ref = em->gen_extent(extent_tier_t::fast);
     ++em->stats->pm_serializer_lba_extents;
 }
 
 extent_t::extent_t(extent_manager_t *_em, file_t *_file, int64_t loc, size_t size)
-    : amount_filled(size), em(_em), file(_file), last_block(NULL), current_block(NULL)
+    : amount_filled(size), em(_em), file(_file), last_block(NULL), current_block(NULL),
+      pending_io_account(NULL)
 {
     extent_ref = em->reserve_extent(loc);
 
@@ -81,24 +99,28 @@ extent_t::extent_t(extent_manager_t *_em, file_t *_file, int64_t loc, size_t siz
 }
 
 void extent_t::destroy(extent_transaction_t *txn) {
+    flush_pending_blocks();
     em->release_extent_into_transaction(std::move(extent_ref), txn);
     delete this;
 }
 
 void extent_t::shutdown() {
+    flush_pending_blocks();
     UNUSED int64_t extent = extent_ref.release();
     delete this;
 }
 
 extent_t::~extent_t() {
     rassert(!current_block);
+    rassert(pending_blocks.empty());
     if (last_block) last_block->is_last_block = false;
     --em->stats->pm_serializer_lba_extents;
 }
 
-void extent_t::read(size_t pos, size_t length, void *buffer, read_callback_t *cb) {
+void extent_t::read(size_t pos, size_t length, void *buffer, file_account_t *io_account,
+                    read_callback_t *cb) {
     rassert(!last_block);
-    file->read_async(extent_ref.offset() + pos, length, buffer, DEFAULT_DISK_ACCOUNT, cb);
+    file->read_async(extent_ref.offset() + pos, length, buffer, io_account, cb);
 
     // Ideally we would count these stats when the io operation completes,
     // but this is more generic than doing it in each callback
@@ -126,8 +148,13 @@ void extent_t::append(void *buffer, size_t length, file_account_t *io_account) {
         if (amount_filled % DEVICE_BLOCK_SIZE == 0) {
             extent_block_t *b = current_block;
             current_block = NULL;
-            b->write(io_account);
-            em->stats->bytes_written(DEVICE_BLOCK_SIZE);
+            // Blocks from different accounts can't share a write.
+            if (!pending_blocks.empty() && pending_io_account != io_account) {
+                flush_pending_blocks();
+            }
+            b->enqueue();
+            pending_blocks.push_back(b);
+            pending_io_account = io_account;
         }
 
         length -= chunk;
@@ -135,9 +162,40 @@ void extent_t::append(void *buffer, size_t length, file_account_t *io_account) {
     }
 }
 
+void extent_t::flush_pending_blocks() {
+    if (pending_blocks.empty()) {
+        return;
+    }
+
+    const size_t count = pending_blocks.size();
+    scoped_array_t<iovec> iovecs(count);
+    extent_block_run_t *run = new extent_block_run_t;
+    run->blocks.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        extent_block_t *b = pending_blocks[i];
+        rassert(i == 0 || b->offset == pending_blocks[i - 1]->offset + DEVICE_BLOCK_SIZE);
+        iovecs[i].iov_base = b->data;
+        iovecs[i].iov_len = DEVICE_BLOCK_SIZE;
+        run->blocks.push_back(b);
+    }
+
+    const int64_t offset = extent_ref.offset() + pending_blocks[0]->offset;
+    pending_blocks.clear();
+    file->writev_async(offset, count * DEVICE_BLOCK_SIZE, std::move(iovecs),
+                       pending_io_account, run);
+
+    em->stats->bytes_written(count * DEVICE_BLOCK_SIZE);
+    em->stats->coalesced_write(count);
+}
+
 void extent_t::sync(sync_callback_t *cb) {
     rassert(divides(DEVICE_BLOCK_SIZE, amount_filled));
     rassert(!current_block);
+    flush_pending_blocks();
+    chain_sync(cb);
+}
+
+void extent_t::chain_sync(sync_callback_t *cb) {
     if (last_block) {
         last_block->sync_cbs.push_back(cb);
     } else {
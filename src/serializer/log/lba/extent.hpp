@@ -2,6 +2,8 @@
 #ifndef SERIALIZER_LOG_LBA_EXTENT_HPP_
 #define SERIALIZER_LOG_LBA_EXTENT_HPP_
 
+#include <vector>
+
 #include "serializer/log/extent_manager.hpp"
 #include "arch/types.hpp"
 
@@ -24,8 +26,12 @@ public:
     private:
         void on_io_complete() { on_extent_read(); }
     };
-    void read(size_t pos, size_t length, void *buffer, read_callback_t *);
+    void read(size_t pos, size_t length, void *buffer, file_account_t *io_account,
+              read_callback_t *);
 
+    /* Full blocks are not written right away; they are collected and written with a
+    single `writev_async()` on the next `sync()`, so that a batch of entries turns
+    into one disk request per extent instead of one per block. */
     void append(void *buffer, size_t length, file_account_t *io_account);
 
     struct sync_callback_t {
@@ -39,10 +45,20 @@ public:
 
 private:
     ~extent_t();   // Use destroy() or shutdown() instead
+
+    // Writes out all of `pending_blocks` as one contiguous write.
+    void flush_pending_blocks();
+    // Calls `cb` once all blocks that have been written so far are on disk.
+    void chain_sync(sync_callback_t *cb);
+
     extent_manager_t *const em;
     file_t *file;
     extent_block_t *last_block, *current_block;
 
+    // Full blocks that haven't been handed to the file yet, in offset order.
+    std::vector<extent_block_t *> pending_blocks;
+    file_account_t *pending_io_account;
+
     DISABLE_COPYING(extent_t);
 };
 
@@ -48,10 +48,12 @@ void lba_list_t::prepare_metablock(metablock_mixin_t *mb_out) {
     memset(&mb_out->inline_lba_entries[inline_lba_entries_count],
            0,
            (LBA_NUM_INLINE_ENTRIES - inline_lba_entries_count) * sizeof(lba_entry_t));
+    // The log serializer fills this in if it writes the metablock as an ordered
+    // write.
+    mb_out->ordered_write_crc = 0;
 }
 
 class lba_start_fsm_t :
-    private lba_disk_structure_t::load_callback_t,
     private lba_disk_structure_t::read_callback_t
 {
 public:
@@ -72,23 +74,20 @@ public:
                last_metablock->inline_lba_entries,
                last_metablock->inline_lba_entries_count * sizeof(lba_entry_t));
 
+        /* The shards cover disjoint sets of block ids, so each of them can start
+        reading its extents as soon as its own superblock has been loaded. Note that
+        we might get deleted in the last iteration of this loop, if none of the shards
+        had to go to disk. */
         cbs_out = LBA_SHARD_FACTOR;
+        for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
+            shard_loaders[i].parent = this;
+            shard_loaders[i].shard = i;
+        }
         for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
             owner->disk_structures[i] = new lba_disk_structure_t(
                 owner->extent_manager, owner->dbfile,
-                &last_metablock->shards[i]);
-            owner->disk_structures[i]->set_load_callback(this);
-        }
-    }
-
-    void on_lba_load() {
-        rassert(cbs_out > 0);
-        cbs_out--;
-        if (cbs_out == 0) {
-            cbs_out = LBA_SHARD_FACTOR;
-            for (int i = 0; i < LBA_SHARD_FACTOR; i++) {
-                owner->disk_structures[i]->read(&owner->in_memory_index, this);
-            }
+                &last_metablock->shards[i], owner->startup_io_account.get());
+            owner->disk_structures[i]->set_load_callback(&shard_loaders[i]);
         }
     }
 
@@ -105,7 +104,8 @@ public:
                         e->block_id,
                         e->recency,
                         e->offset,
-                        e->ser_block_size);
+                        e->ser_block_size,
+                        e->compressed_block_size);
             }
 
             owner->state = lba_list_t::state_ready;
@@ -113,6 +113,20 @@ public:
             delete this;
         }
     }
+
+private:
+    struct shard_loader_t : public lba_disk_structure_t::load_callback_t {
+        void on_lba_load() {
+            parent->owner->disk_structures[shard]->read(
+                &parent->owner->in_memory_index,
+                parent->owner->startup_io_account.get(),
+                parent);
+        }
+        lba_start_fsm_t *parent;
+        int shard;
+    };
+
+    shard_loader_t shard_loaders[LBA_SHARD_FACTOR];
 };
 
 bool lba_list_t::start_existing(file_t *file, metablock_mixin_t *last_metablock,
@@ -120,7 +134,10 @@ bool lba_list_t::start_existing(file_t *file, metablock_mixin_t *last_metablock,
     rassert(state == state_unstarted);
 
     dbfile = file;
-    gc_io_account.init(new file_account_t(dbfile, LBA_GC_IO_PRIORITY));
+    gc_io_account.init(new file_account_t(dbfile, LBA_GC_IO_PRIORITY,
+                                           UNLIMITED_OUTSTANDING_REQUESTS,
+                                           io_class_t::gc));
+    startup_io_account.init(new file_account_t(dbfile, LBA_STARTUP_IO_PRIORITY));
 
     lba_start_fsm_t *starter = new lba_start_fsm_t(this, last_metablock);
     if (state == state_ready) {
@@ -150,6 +167,10 @@ uint32_t lba_list_t::get_ser_block_size(block_id_t block) {
     return get_block_info(block).ser_block_size;
 }
 
+uint32_t lba_list_t::get_compressed_block_size(block_id_t block) {
+    return get_block_info(block).compressed_block_size;
+}
+
 block_size_t lba_list_t::get_block_size(block_id_t block) {
     return block_size_t::unsafe_make(get_block_info(block).ser_block_size);
 }
@@ -180,10 +201,12 @@ segmented_vector_t<repli_timestamp_t> lba_list_t::get_block_recencies(block_id_t
 
 void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
                                 flagged_off64_t offset, uint32_t ser_block_size,
+                                uint32_t compressed_block_size,
                                 file_account_t *io_account, extent_transaction_t *txn) {
     rassert(state == state_ready || state == state_gc_shutting_down);
 
-    in_memory_index.set_block_info(block, recency, offset, ser_block_size);
+    in_memory_index.set_block_info(block, recency, offset, ser_block_size,
+                                   compressed_block_size);
 
     // If the inline LBA is full, free it up first by moving its entries to
     // the LBA extents
@@ -192,7 +215,7 @@ void lba_list_t::set_block_info(block_id_t block, repli_timestamp_t recency,
         rassert(!check_inline_lba_full());
     }
     // Then store the entry inline
-    add_inline_entry(block, recency, offset, ser_block_size);
+    add_inline_entry(block, recency, offset, ser_block_size, compressed_block_size);
 }
 
 bool lba_list_t::check_inline_lba_full() const {
@@ -230,6 +253,7 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
                 e.recency,
                 e.offset,
                 e.ser_block_size,
+                e.compressed_block_size,
                 io_account,
                 txn);
     }
@@ -238,11 +262,13 @@ void lba_list_t::move_inline_entries_to_extents(file_account_t *io_account, exte
 }
 
 void lba_list_t::add_inline_entry(block_id_t block, repli_timestamp_t recency,
-                                flagged_off64_t offset, uint32_t ser_block_size) {
+                                flagged_off64_t offset, uint32_t ser_block_size,
+                                uint32_t compressed_block_size) {
 
     rassert(!check_inline_lba_full());
     inline_lba_entries[inline_lba_entries_count++] =
-            lba_entry_t::make(block, recency, offset, ser_block_size);
+            lba_entry_t::make(block, recency, offset, ser_block_size,
+                              compressed_block_size);
 }
 
 class lba_syncer_t :
@@ -323,6 +349,7 @@ void lba_list_t::gc(int lba_shard, auto_drainer_t::lock_t) {
                                                   get_block_recency(id),
                                                   off,
                                                   ser_block_size,
+                                                  get_compressed_block_size(id),
                                                   gc_io_account.get(),
                                                   txns.back().get());
         }
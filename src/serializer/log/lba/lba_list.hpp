@@ -45,6 +45,7 @@ public:
     // These return individual fields of get_block_info.
     flagged_off64_t get_block_offset(block_id_t block);
     uint32_t get_ser_block_size(block_id_t block);
+    uint32_t get_compressed_block_size(block_id_t block);
     block_size_t get_block_size(block_id_t block);
     repli_timestamp_t get_block_recency(block_id_t block);
     segmented_vector_t<repli_timestamp_t> get_block_recencies(block_id_t first,
@@ -62,6 +63,7 @@ public:
 
     void set_block_info(block_id_t block, repli_timestamp_t recency,
                         flagged_off64_t offset, uint32_t ser_block_size,
+                        uint32_t compressed_block_size,
                         file_account_t *io_account,
                         extent_transaction_t *txn);
 
@@ -104,6 +106,9 @@ private:
 
     file_t *dbfile;
     scoped_ptr_t<file_account_t> gc_io_account;
+    // The LBA is read with this at startup. Nothing can use the serializer until that
+    // is done, so it gets the same priority as cache reads instead of the default.
+    scoped_ptr_t<file_account_t> startup_io_account;
 
     in_memory_index_t in_memory_index;
 
@@ -116,7 +121,8 @@ private:
     bool check_inline_lba_full() const;
     void move_inline_entries_to_extents(file_account_t *io_account, extent_transaction_t *txn);
     void add_inline_entry(block_id_t block, repli_timestamp_t recency,
-                                flagged_off64_t offset, uint32_t ser_block_size);
+                                flagged_off64_t offset, uint32_t ser_block_size,
+                                uint32_t compressed_block_size);
 
     lba_disk_structure_t *disk_structures[LBA_SHARD_FACTOR];
 
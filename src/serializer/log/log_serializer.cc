@@ -6,8 +6,13 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <functional>
 
+#include "errors.hpp"
+#include <boost/crc.hpp>
+
+#include "arch/arch.hpp"
 #include "arch/io/disk.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "arch/runtime/coroutines.hpp"
@@ -17,13 +22,28 @@
 #include "perfmon/perfmon.hpp"
 #include "serializer/buf_ptr.hpp"
 #include "serializer/log/data_block_manager.hpp"
+#include "serializer/log/tiered_file.hpp"
 
 filepath_file_opener_t::filepath_file_opener_t(const serializer_filepath_t &filepath,
                                                io_backender_t *backender)
     : filepath_(filepath),
       backender_(backender),
+      slow_tier_offset_(-1),
       opened_temporary_(false) { }
 
+filepath_file_opener_t::filepath_file_opener_t(const serializer_filepath_t &filepath,
+                                               const std::string &slow_tier_path,
+                                               int64_t fast_tier_size,
+                                               io_backender_t *backender)
+    : filepath_(filepath),
+      backender_(backender),
+      slow_tier_path_(slow_tier_path),
+      slow_tier_offset_(ceil_aligned(std::max<int64_t>(fast_tier_size, 1),
+                                     DEFAULT_EXTENT_SIZE)),
+      opened_temporary_(false) {
+    guarantee(!slow_tier_path_.empty());
+}
+
 filepath_file_opener_t::~filepath_file_opener_t() { }
 
 std::string filepath_file_opener_t::file_name() const {
@@ -56,9 +76,30 @@ void filepath_file_opener_t::open_serializer_file(const std::string &path, int e
     }
 }
 
+void filepath_file_opener_t::open_slow_tier(bool create, scoped_ptr_t<file_t> *file_out) {
+    if (slow_tier_path_.empty()) {
+        return;
+    }
+    scoped_ptr_t<file_t> slow_file;
+    open_serializer_file(slow_tier_path_,
+                         create ? linux_file_t::mode_create | linux_file_t::mode_truncate : 0,
+                         &slow_file);
+    if (create) {
+        tiered_file_t::initialize_slow_file(slow_file.get(), slow_tier_offset_);
+    } else if (!tiered_file_t::read_slow_file_header(slow_file.get(),
+                                                     &slow_tier_offset_)) {
+        fail_due_to_user_error("The file \"%s\" doesn't appear to be the slow storage "
+                               "tier of a RethinkDB data file.", slow_tier_path_.c_str());
+    }
+    scoped_ptr_t<file_t> fast_file(std::move(*file_out));
+    file_out->init(new tiered_file_t(std::move(fast_file), std::move(slow_file),
+                                     slow_tier_offset_));
+}
+
 void filepath_file_opener_t::open_serializer_file_create_temporary(scoped_ptr_t<file_t> *file_out) {
     mutex_assertion_t::acq_t acq(&reentrance_mutex_);
     open_serializer_file(temporary_file_name(), linux_file_t::mode_create | linux_file_t::mode_truncate, file_out);
+    open_slow_tier(true, file_out);
     opened_temporary_ = true;
 }
 
@@ -85,6 +126,7 @@ void filepath_file_opener_t::move_serializer_file_to_permanent_location() {
 void filepath_file_opener_t::open_serializer_file_existing(scoped_ptr_t<file_t> *file_out) {
     mutex_assertion_t::acq_t acq(&reentrance_mutex_);
     open_serializer_file(current_file_name(), 0, file_out);
+    open_slow_tier(false, file_out);
 }
 
 void filepath_file_opener_t::unlink_serializer_file() {
@@ -95,6 +137,14 @@ void filepath_file_opener_t::unlink_serializer_file() {
     guarantee(opened_temporary_);
     const int res = ::unlink(current_file_name().c_str());
     guarantee_err(res == 0, "unlink() failed");
+    if (!slow_tier_path_.empty()) {
+        const int slow_res = ::unlink(slow_tier_path_.c_str());
+        guarantee_err(slow_res == 0, "unlink() failed");
+    }
+}
+
+int64_t filepath_file_opener_t::slow_tier_offset() const {
+    return slow_tier_offset_;
 }
 
 #ifdef SEMANTIC_SERIALIZER_CHECK
@@ -118,15 +168,17 @@ void filepath_file_opener_t::open_semantic_checking_file(scoped_ptr_t<semantic_c
 
 log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
     : serializer_collection(),
-      pm_serializer_block_reads(secs_to_ticks(1)),
+      pm_serializer_block_reads(secs_to_ticks(1), true),
       pm_serializer_index_reads(),
       pm_serializer_block_writes(),
-      pm_serializer_index_writes(secs_to_ticks(1)),
+      pm_serializer_index_writes(secs_to_ticks(1), true),
       pm_serializer_index_writes_size(secs_to_ticks(1), false),
       pm_serializer_read_bytes_per_sec(secs_to_ticks(1)),
       pm_serializer_read_bytes_total(),
       pm_serializer_written_bytes_per_sec(secs_to_ticks(1)),
       pm_serializer_written_bytes_total(),
+      pm_serializer_write_ops(),
+      pm_serializer_write_ops_blocks(),
       pm_extents_in_use(),
       pm_bytes_in_use(),
       pm_serializer_lba_extents(),
@@ -135,6 +187,12 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
       pm_serializer_data_extents_gced(),
       pm_serializer_old_garbage_block_bytes(),
       pm_serializer_old_total_block_bytes(),
+      pm_serializer_compressed_blocks(),
+      pm_serializer_compressed_bytes_saved(),
+      pm_serializer_gc_read_bytes_total(),
+      pm_serializer_gc_written_bytes_total(),
+      pm_serializer_read_ahead_blocks(),
+      pm_serializer_read_ahead_blocks_used(),
       pm_serializer_lba_gcs(),
       parent_collection_membership(parent, &serializer_collection, "serializer"),
       stats_membership(&serializer_collection,
@@ -147,6 +205,8 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
           &pm_serializer_read_bytes_total, "serializer_read_bytes_total",
           &pm_serializer_written_bytes_per_sec, "serializer_written_bytes_per_sec",
           &pm_serializer_written_bytes_total, "serializer_written_bytes_total",
+          &pm_serializer_write_ops, "serializer_write_ops",
+          &pm_serializer_write_ops_blocks, "serializer_write_ops_blocks",
           &pm_extents_in_use, "serializer_extents_in_use",
           &pm_bytes_in_use, "serializer_bytes_in_use",
           &pm_serializer_lba_extents, "serializer_lba_extents",
@@ -155,6 +215,12 @@ log_serializer_stats_t::log_serializer_stats_t(perfmon_collection_t *parent)
           &pm_serializer_data_extents_gced, "serializer_data_extents_gced",
           &pm_serializer_old_garbage_block_bytes, "serializer_old_garbage_block_bytes",
           &pm_serializer_old_total_block_bytes, "serializer_old_total_block_bytes",
+          &pm_serializer_compressed_blocks, "serializer_compressed_blocks",
+          &pm_serializer_compressed_bytes_saved, "serializer_compressed_bytes_saved",
+          &pm_serializer_gc_read_bytes_total, "serializer_gc_read_bytes_total",
+          &pm_serializer_gc_written_bytes_total, "serializer_gc_written_bytes_total",
+          &pm_serializer_read_ahead_blocks, "serializer_read_ahead_blocks",
+          &pm_serializer_read_ahead_blocks_used, "serializer_read_ahead_blocks_used",
           &pm_serializer_lba_gcs, "serializer_lba_gcs")
 { }
 
@@ -168,6 +234,11 @@ void log_serializer_stats_t::bytes_written(size_t count) {
     pm_serializer_written_bytes_total += count;
 }
 
+void log_serializer_stats_t::coalesced_write(size_t blocks) {
+    ++pm_serializer_write_ops;
+    pm_serializer_write_ops_blocks += blocks;
+}
+
 void log_serializer_t::create(serializer_file_opener_t *file_opener, static_config_t static_config) {
     log_serializer_on_disk_static_config_t *on_disk_config = &static_config;
 
@@ -187,6 +258,56 @@ void log_serializer_t::create(serializer_file_opener_t *file_opener, static_conf
     mb_manager_t::create(file.get(), static_config.extent_size(), &metablock);
 }
 
+/* An ordered write refers to the data blocks that it adds inline LBA entries for
+(relative to the metablock before it) through a CRC of their CRCs. This is only
+possible if it doesn't touch any LBA extents, since those are written without
+checksums. */
+static bool can_be_ordered_write_of(const lba_list_t::metablock_mixin_t &newest,
+                                    const lba_list_t::metablock_mixin_t &previous) {
+    return memcmp(newest.shards, previous.shards, sizeof(newest.shards)) == 0
+        && newest.inline_lba_entries_count >= previous.inline_lba_entries_count;
+}
+
+static uint32_t combine_ordered_write_crcs(const std::vector<uint32_t> &crcs) {
+    boost::crc_32_type crc_computer;
+    crc_computer.process_bytes(crcs.data(), crcs.size() * sizeof(uint32_t));
+    return crc_computer.checksum();
+}
+
+static bool ordered_write_made_it_to_disk(file_t *file,
+                                          const log_serializer_metablock_t &newest,
+                                          const log_serializer_metablock_t &previous) {
+    const lba_list_t::metablock_mixin_t &lba = newest.lba_index_part;
+    if (!can_be_ordered_write_of(lba, previous.lba_index_part)) {
+        return false;
+    }
+
+    const int64_t file_size = file->get_file_size();
+    std::vector<uint32_t> crcs;
+    for (int32_t i = previous.lba_index_part.inline_lba_entries_count;
+         i < lba.inline_lba_entries_count;
+         ++i) {
+        const lba_entry_t &entry = lba.inline_lba_entries[i];
+        if (!entry.offset.has_value()) {
+            continue;
+        }
+        const int64_t offset = entry.offset.get_value();
+        const uint32_t disk_size = entry.compressed_block_size != 0
+            ? entry.compressed_block_size
+            : entry.ser_block_size;
+        const int64_t aligned_size = ceil_aligned(disk_size, DEVICE_BLOCK_SIZE);
+        if (!divides(DEVICE_BLOCK_SIZE, offset) || offset + aligned_size > file_size) {
+            return false;
+        }
+        scoped_malloc_t<char> buffer(malloc_aligned(aligned_size, DEVICE_BLOCK_SIZE));
+        co_read(file, offset, aligned_size, buffer.get(), DEFAULT_DISK_ACCOUNT);
+        boost::crc_32_type crc_computer;
+        crc_computer.process_bytes(buffer.get(), disk_size);
+        crcs.push_back(crc_computer.checksum());
+    }
+    return combine_ordered_write_crcs(crcs) == lba.ordered_write_crc;
+}
+
 /* The process of starting up the serializer is handled by the ls_start_*_fsm_t. This is not
 necessary, because there is only ever one startup process for each serializer; the serializer could
 handle its own startup process. It is done this way to make it clear which parts of the serializer
@@ -199,7 +320,7 @@ struct ls_start_existing_fsm_t :
     public thread_message_t
 {
     explicit ls_start_existing_fsm_t(log_serializer_t *serializer)
-        : ser(serializer), start_existing_state(state_start) {
+        : ser(serializer), slow_tier_offset(-1), start_existing_state(state_start) {
     }
 
     ~ls_start_existing_fsm_t() {
@@ -213,9 +334,11 @@ struct ls_start_existing_fsm_t :
 
         scoped_ptr_t<file_t> dbfile;
         file_opener->open_serializer_file_existing(&dbfile);
+        slow_tier_offset = file_opener->slow_tier_offset();
         ser->dbfile = dbfile.release();
         ser->index_writes_io_account.init(
-            new file_account_t(ser->dbfile, INDEX_WRITE_IO_PRIORITY));
+            new file_account_t(ser->dbfile, INDEX_WRITE_IO_PRIORITY,
+                               UNLIMITED_OUTSTANDING_REQUESTS, io_class_t::flush));
 
         start_existing_state = state_read_static_header;
         // STATE A above implies STATE B here
@@ -249,7 +372,16 @@ struct ls_start_existing_fsm_t :
 
         if (start_existing_state == state_find_metablock) {
             // STATE D
+            if (slow_tier_offset != -1
+                && !divides(ser->static_config.extent_size(), slow_tier_offset)) {
+                fail_due_to_user_error("The boundary between the storage tiers of the "
+                                       "data file (%" PRIi64 " bytes) is not a multiple "
+                                       "of its extent size (%" PRIu64 " bytes).",
+                                       slow_tier_offset,
+                                       ser->static_config.extent_size());
+            }
             ser->extent_manager = new extent_manager_t(ser->dbfile, &ser->static_config,
+                                                       slow_tier_offset,
                                                        ser->stats.get());
             {
                 // We never end up releasing the static header extent reference.  Nobody says we
@@ -268,7 +400,10 @@ struct ls_start_existing_fsm_t :
                                            &ser->static_config, ser->stats.get());
 
             // STATE E
-            if (ser->metablock_manager->start_existing(ser->dbfile, &metablock_found, &metablock_buffer, this)) {
+            if (ser->metablock_manager->start_existing(
+                    ser->dbfile,
+                    std::bind(&ordered_write_made_it_to_disk, ser->dbfile, ph::_1, ph::_2),
+                    &metablock_found, &metablock_buffer, this)) {
                 crash("metablock_manager_t::start_existing always returns false");
                 // start_existing_state = state_start_lba;
             } else {
@@ -281,6 +416,8 @@ struct ls_start_existing_fsm_t :
         if (start_existing_state == state_start_lba) {
             // STATE G
             guarantee(metablock_found, "Could not find any valid metablock.");
+            ser->last_written_metablock.init(new log_serializer_t::metablock_t(
+                metablock_buffer));
 
             // STATE H
             if (ser->lba_index->start_existing(ser->dbfile, &metablock_buffer.lba_index_part, this)) {
@@ -304,10 +441,13 @@ struct ls_start_existing_fsm_t :
         if (start_existing_state == state_reconstruct_ongoing) {
             int batch = 0;
             for (; num_blocks_reconstructed < ser->lba_index->end_block_id(); num_blocks_reconstructed++) {
-                flagged_off64_t offset = ser->lba_index->get_block_offset(num_blocks_reconstructed);
-                if (offset.has_value()) {
-                    ser->data_block_manager->mark_live(offset.get_value(),
-                        ser->lba_index->get_block_size(num_blocks_reconstructed));
+                const index_block_info_t info
+                    = ser->lba_index->get_block_info(num_blocks_reconstructed);
+                if (info.offset.has_value()) {
+                    ser->data_block_manager->mark_live(
+                        info.offset.get_value(),
+                        block_size_t::unsafe_make(info.ser_block_size),
+                        block_size_t::unsafe_make(info.disk_block_size()));
                 }
                 ++batch;
                 if (batch >= LBA_RECONSTRUCTION_BATCH_SIZE) {
@@ -368,6 +508,9 @@ struct ls_start_existing_fsm_t :
     log_serializer_t *ser;
     cond_t *to_signal_when_done;
 
+    // See `serializer_file_opener_t::slow_tier_offset()`.
+    int64_t slow_tier_offset;
+
     enum state_t {
         state_start,
         state_read_static_header,
@@ -428,10 +571,11 @@ log_serializer_t::~log_serializer_t() {
     rassert(active_write_count == 0);
 }
 
-file_account_t *log_serializer_t::make_io_account(int priority, int outstanding_requests_limit) {
+file_account_t *log_serializer_t::make_io_account(int priority, int outstanding_requests_limit,
+                                                  io_class_t io_class) {
     assert_thread();
     rassert(dbfile);
-    return new file_account_t(dbfile, priority, outstanding_requests_limit);
+    return new file_account_t(dbfile, priority, outstanding_requests_limit, io_class);
 }
 
 buf_ptr_t log_serializer_t::block_read(const counted_t<ls_block_token_pointee_t> &token,
@@ -444,7 +588,7 @@ buf_ptr_t log_serializer_t::block_read(const counted_t<ls_block_token_pointee_t>
     stats->pm_serializer_block_reads.begin(&pm_time);
 
     buf_ptr_t ret = data_block_manager->read(token->offset_, token->block_size(),
-                                           io_account);
+                                             token->disk_block_size(), io_account);
 
     stats->pm_serializer_block_reads.end(&pm_time);
     return ret;
@@ -478,6 +622,11 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
     extent_transaction_t txn;
     index_write_prepare(&txn);
 
+    // The CRCs of the data blocks that we're pointing the index at, by offset, if we
+    // can write the metablock as an ordered write.
+    std::map<int64_t, uint32_t> data_crcs;
+    const bool ordered = should_order_writes();
+
     {
         // The in-memory index updates, at least due to the needs of
         // data_block_manager_t garbage collection, needs to be
@@ -490,6 +639,8 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
             const index_write_op_t &op = *write_op_it;
             flagged_off64_t offset = lba_index->get_block_offset(op.block_id);
             uint32_t ser_block_size = lba_index->get_ser_block_size(op.block_id);
+            uint32_t compressed_block_size
+                = lba_index->get_compressed_block_size(op.block_id);
 
             if (op.token) {
                 // Update the offset pointed to, and mark garbage/liveness as necessary.
@@ -503,14 +654,22 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
 
                 // Write new token to index, or remove from index as appropriate.
                 if (token.has()) {
+                    if (ordered && token->has_disk_crc_) {
+                        data_crcs[token->offset_] = token->disk_crc_;
+                    }
                     offset = flagged_off64_t::make(token->offset_);
                     ser_block_size = token->block_size().ser_value();
+                    compressed_block_size = token->is_compressed()
+                        ? token->disk_block_size().ser_value()
+                        : 0;
 
                     /* mark the life */
-                    data_block_manager->mark_live(offset.get_value(), token->block_size());
+                    data_block_manager->mark_live(offset.get_value(), token->block_size(),
+                                                  token->disk_block_size());
                 } else {
                     offset = flagged_off64_t::unused();
                     ser_block_size = 0;
+                    compressed_block_size = 0;
                 }
             }
 
@@ -518,12 +677,13 @@ void log_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
                 : lba_index->get_block_recency(op.block_id);
 
             lba_index->set_block_info(op.block_id, recency,
-                                      offset, ser_block_size,
+                                      offset, ser_block_size, compressed_block_size,
                                       index_writes_io_account.get(), &txn);
         }
     }
 
-    index_write_finish(mutex_acq, &txn, index_writes_io_account.get());
+    index_write_finish(mutex_acq, &txn, ordered ? &data_crcs : NULL,
+                       index_writes_io_account.get());
 
     stats->pm_serializer_index_writes.end(&pm_time);
 }
@@ -541,6 +701,7 @@ void log_serializer_t::index_write_prepare(extent_transaction_t *txn) {
 
 void log_serializer_t::index_write_finish(new_mutex_in_line_t *mutex_acq,
                                           extent_transaction_t *txn,
+                                          const std::map<int64_t, uint32_t> *data_crcs,
                                           file_account_t *io_account) {
     /* Sync the LBA */
     struct : public cond_t, public lba_list_t::sync_callback_t {
@@ -553,7 +714,7 @@ void log_serializer_t::index_write_finish(new_mutex_in_line_t *mutex_acq,
     extent_manager->end_transaction(txn);
 
     /* Write the metablock */
-    write_metablock(mutex_acq, &on_lba_sync, io_account);
+    write_metablock(mutex_acq, &on_lba_sync, data_crcs, io_account);
 
     active_write_count--;
 
@@ -576,6 +737,7 @@ void log_serializer_t::index_write_finish(new_mutex_in_line_t *mutex_acq,
 
 void log_serializer_t::write_metablock(new_mutex_in_line_t *mutex_acq,
                                        const signal_t *safe_to_write_cond,
+                                       const std::map<int64_t, uint32_t> *data_crcs,
                                        file_account_t *io_account) {
     assert_thread();
     metablock_t mb_buffer;
@@ -584,6 +746,11 @@ void log_serializer_t::write_metablock(new_mutex_in_line_t *mutex_acq,
     metablock information for this write even if another write starts before we finish
     waiting on `safe_to_write_cond`. */
     prepare_metablock(&mb_buffer);
+    const bool ordered = data_crcs != NULL && prepare_ordered_write(*data_crcs, &mb_buffer);
+    if (!previous_metablock.has()) {
+        previous_metablock.init(new metablock_t);
+    }
+    *previous_metablock = mb_buffer;
 
     /* Get in line for the metablock manager */
     bool waiting_for_prev_write = !metablock_waiter_queue.empty();
@@ -604,7 +771,8 @@ void log_serializer_t::write_metablock(new_mutex_in_line_t *mutex_acq,
         void on_metablock_write() { pulse(); }
     } on_metablock_write;
     const bool done_with_metablock =
-        metablock_manager->write_metablock(&mb_buffer, io_account, &on_metablock_write);
+        metablock_manager->write_metablock(&mb_buffer, ordered, io_account,
+                                           &on_metablock_write);
 
     /* Remove ourselves from the list of metablock waiters. */
     metablock_waiter_queue.pop_front();
@@ -616,19 +784,25 @@ void log_serializer_t::write_metablock(new_mutex_in_line_t *mutex_acq,
     }
 
     if (!done_with_metablock) on_metablock_write.wait();
+
+    /* This has to happen before the extent transaction gets committed, so that the
+    extents it refers to are in use for as long as it's the last written metablock. */
+    *last_written_metablock = mb_buffer;
 }
 
 void log_serializer_t::write_metablock_sans_pipelining(const signal_t *safe_to_write_cond,
                                                        file_account_t *io_account) {
     new_mutex_in_line_t dummy_acq;
-    write_metablock(&dummy_acq, safe_to_write_cond, io_account);
+    write_metablock(&dummy_acq, safe_to_write_cond, NULL, io_account);
 
 }
 
 counted_t<ls_block_token_pointee_t>
-log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size) {
+log_serializer_t::generate_block_token(int64_t offset, block_size_t block_size,
+                                       block_size_t disk_block_size) {
     assert_thread();
-    counted_t<ls_block_token_pointee_t> ret(new ls_block_token_pointee_t(this, offset, block_size));
+    counted_t<ls_block_token_pointee_t> ret(
+        new ls_block_token_pointee_t(this, offset, block_size, disk_block_size));
     return ret;
 }
 
@@ -765,7 +939,9 @@ counted_t<ls_block_token_pointee_t> log_serializer_t::index_read(block_id_t bloc
 
     index_block_info_t info = lba_index->get_block_info(block_id);
     if (info.offset.has_value()) {
-        return generate_block_token(info.offset.get_value(), block_size_t::unsafe_make(info.ser_block_size));
+        return generate_block_token(info.offset.get_value(),
+                                    block_size_t::unsafe_make(info.ser_block_size),
+                                    block_size_t::unsafe_make(info.disk_block_size()));
     } else {
         return counted_t<ls_block_token_pointee_t>();
     }
@@ -897,6 +1073,39 @@ void log_serializer_t::prepare_metablock(metablock_t *mb_buffer) {
     lba_index->prepare_metablock(&mb_buffer->lba_index_part);
 }
 
+bool log_serializer_t::prepare_ordered_write(const std::map<int64_t, uint32_t> &data_crcs,
+                                             metablock_t *mb_buffer) {
+    assert_thread();
+    // We don't know whether the metablock we started up from is still around, so
+    // the first one we write always gets datasynced on both sides.
+    if (!previous_metablock.has()) {
+        return false;
+    }
+    lba_list_t::metablock_mixin_t *lba = &mb_buffer->lba_index_part;
+    if (!can_be_ordered_write_of(*lba, previous_metablock->lba_index_part)) {
+        return false;
+    }
+
+    std::vector<uint32_t> crcs;
+    for (int32_t i = previous_metablock->lba_index_part.inline_lba_entries_count;
+         i < lba->inline_lba_entries_count;
+         ++i) {
+        const lba_entry_t &entry = lba->inline_lba_entries[i];
+        if (!entry.offset.has_value()) {
+            continue;
+        }
+        auto it = data_crcs.find(entry.offset.get_value());
+        if (it == data_crcs.end()) {
+            // The entry only updates the block's recency.  We can't tell whether
+            // we've written that one.
+            return false;
+        }
+        crcs.push_back(it->second);
+    }
+    lba->ordered_write_crc = combine_ordered_write_crcs(crcs);
+    return true;
+}
+
 
 void log_serializer_t::consider_start_gc() {
     assert_thread();
@@ -934,19 +1143,35 @@ void log_serializer_t::offer_buf_to_read_ahead_callbacks(
                                                       &local_buf,
                                                       token);
     }
+    ++stats->pm_serializer_read_ahead_blocks;
+    if (!local_buf.has()) {
+        ++stats->pm_serializer_read_ahead_blocks_used;
+    }
+}
+
+bool log_serializer_t::should_compress_blocks() const {
+    return dynamic_config.compress_blocks;
+}
+
+bool log_serializer_t::should_order_writes() const {
+    return dynamic_config.ordered_writes;
 }
 
 bool log_serializer_t::should_perform_read_ahead() {
     assert_thread();
-    return dynamic_config.read_ahead && !read_ahead_callbacks.empty();
+    return dynamic_config.read_ahead != read_ahead_mode_t::off
+        && !read_ahead_callbacks.empty();
 }
 
 ls_block_token_pointee_t::ls_block_token_pointee_t(log_serializer_t *serializer,
                                                    int64_t initial_offset,
-                                                   block_size_t initial_block_size)
+                                                   block_size_t initial_block_size,
+                                                   block_size_t initial_disk_block_size)
     : serializer_(serializer), ref_count_(0),
-      block_size_(initial_block_size), offset_(initial_offset) {
+      block_size_(initial_block_size), disk_block_size_(initial_disk_block_size),
+      offset_(initial_offset), has_disk_crc_(false), disk_crc_(0) {
     serializer_->assert_thread();
+    rassert(disk_block_size_.ser_value() <= block_size_.ser_value());
     serializer_->register_block_token(this, initial_offset);
 }
 
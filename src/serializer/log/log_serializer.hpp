@@ -61,6 +61,14 @@ class filepath_file_opener_t : public serializer_file_opener_t {
 public:
     filepath_file_opener_t(const serializer_filepath_t &filepath,
                            io_backender_t *backender);
+    // Splits the serializer file between two devices: the first `fast_tier_size`
+    // bytes (rounded up to a whole number of extents) live at `filepath`, the rest
+    // lives at `slow_tier_path`.  See `tiered_file_t`.  When opening an existing file,
+    // the boundary recorded in the slow file wins over `fast_tier_size`.
+    filepath_file_opener_t(const serializer_filepath_t &filepath,
+                           const std::string &slow_tier_path,
+                           int64_t fast_tier_size,
+                           io_backender_t *backender);
     ~filepath_file_opener_t();
 
     // The path of the final position of the file.
@@ -70,6 +78,7 @@ public:
     void move_serializer_file_to_permanent_location();
     void open_serializer_file_existing(scoped_ptr_t<file_t> *file_out);
     void unlink_serializer_file();
+    int64_t slow_tier_offset() const;
 #ifdef SEMANTIC_SERIALIZER_CHECK
     void open_semantic_checking_file(scoped_ptr_t<semantic_checking_file_t> *file_out);
 #endif
@@ -77,6 +86,10 @@ public:
 private:
     void open_serializer_file(const std::string &path, int extra_flags, scoped_ptr_t<file_t> *file_out);
 
+    // Wraps `*file_out` and the slow tier's file into a `tiered_file_t`, if there is
+    // a slow tier.
+    void open_slow_tier(bool create, scoped_ptr_t<file_t> *file_out);
+
     // The path of the temporary file.  This is file_name() with some suffix appended.
     std::string temporary_file_name() const;
 
@@ -88,6 +101,13 @@ private:
 
     io_backender_t *const backender_;
 
+    // Empty if the file isn't tiered.
+    const std::string slow_tier_path_;
+
+    // The boundary between the tiers, or -1 if the file isn't tiered.  Becomes the
+    // persisted boundary once an existing file has been opened.
+    int64_t slow_tier_offset_;
+
     // Makes sure that only one member function gets called at a time.  Some of them are blocking,
     // and we don't want to have to worry about stuff like what the value of opened_temporary_
     // should be during the blocking call to move_serializer_file_to_permanent_location().
@@ -117,6 +137,7 @@ class log_serializer_t :
     friend class data_block_manager_t;
     friend class dbm_read_ahead_t;
     friend class ls_block_token_pointee_t;
+    friend class log_serializer_snapshot_t;
 
 public:
     /* Serializer configuration. dynamic_config_t is everything that can be changed from run
@@ -138,7 +159,8 @@ public:
 #ifndef SEMANTIC_SERIALIZER_CHECK
     using serializer_t::make_io_account;
 #endif
-    file_account_t *make_io_account(int priority, int outstanding_requests_limit);
+    file_account_t *make_io_account(int priority, int outstanding_requests_limit,
+                                    io_class_t io_class);
 
     void register_read_ahead_cb(serializer_read_ahead_callback_t *cb);
     void unregister_read_ahead_cb(serializer_read_ahead_callback_t *cb);
@@ -170,13 +192,16 @@ private:
     void unregister_block_token(ls_block_token_pointee_t *token);
     void remap_block_to_new_offset(int64_t current_offset, int64_t new_offset);
     counted_t<ls_block_token_pointee_t> generate_block_token(int64_t offset,
-                                                             block_size_t block_size);
+                                                             block_size_t block_size,
+                                                             block_size_t disk_block_size);
 
     void offer_buf_to_read_ahead_callbacks(
             block_id_t block_id,
             buf_ptr_t &&buf,
             const counted_t<standard_block_token_t> &token);
     bool should_perform_read_ahead();
+    bool should_compress_blocks() const;
+    bool should_order_writes() const;
 
     /* Starts a new transaction, updates perfmons etc. */
     void index_write_prepare(extent_transaction_t *txn);
@@ -184,6 +209,7 @@ private:
        another index_write. */
     void index_write_finish(new_mutex_in_line_t *mutex_acq,
                             extent_transaction_t *txn,
+                            const std::map<int64_t, uint32_t> *data_crcs,
                             file_account_t *io_account);
 
     /* This mess is because the serializer is still mostly FSM-based */
@@ -200,9 +226,12 @@ private:
     complete.  This function writes the metablock in the state that it has when
     called, i.e.  it does not block between calling and preparing the new metablock.
     Use mutex_acq with a mutex you control if you want to extra-safely pipeline
-    operations from your caller. */
+    operations from your caller.  If `data_crcs` isn't `NULL`, it has the CRCs of the
+    blocks we've just written by offset, and we use them to write the metablock as an
+    ordered write if possible. */
     void write_metablock(new_mutex_in_line_t *mutex_acq,
                          const signal_t *safe_to_write_cond,
+                         const std::map<int64_t, uint32_t> *data_crcs,
                          file_account_t *io_account);
 
     // Used by the LBA gc operations to write metablocks -- it doesn't care to
@@ -213,6 +242,10 @@ private:
 
     typedef log_serializer_metablock_t metablock_t;
     void prepare_metablock(metablock_t *mb_buffer);
+    /* Fills in the checksum of an ordered write and returns true, or returns false if
+    `mb_buffer` has to be written with a datasync before it. */
+    bool prepare_ordered_write(const std::map<int64_t, uint32_t> &data_crcs,
+                               metablock_t *mb_buffer);
 
     void consider_start_gc();
 
@@ -263,6 +296,16 @@ private:
     is the oldest transaction that started but did not finish. */
     std::list<cond_t *> metablock_waiter_queue;
 
+    /* The metablock that we've prepared most recently, which is the one that is going
+    to be written right before the next one.  Empty until we've prepared the first
+    one. */
+    scoped_ptr_t<metablock_t> previous_metablock;
+
+    /* The metablock that was most recently written to disk. Everything it refers to is
+    on disk, and the extents it refers to stay in use at least until the next
+    metablock has been written, at which point this gets updated. */
+    scoped_ptr_t<metablock_t> last_written_metablock;
+
     int active_write_count;
 
     DISABLE_COPYING(log_serializer_t);
@@ -11,6 +11,7 @@
 #include "arch/arch.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "concurrency/cond_var.hpp"
+#include "logger.hpp"
 #include "serializer/log/log_serializer.hpp"
 #include "version.hpp"
 
@@ -34,7 +35,7 @@ std::vector<int64_t> initial_metablock_offsets(int64_t extent_size) {
 
 template<class metablock_t>
 metablock_manager_t<metablock_t>::metablock_manager_t::head_t::head_t(metablock_manager_t *manager)
-    : mb_slot(0), saved_mb_slot(static_cast<uint32_t>(-1)), wraparound(false), mgr(manager) { }
+    : mb_slot(0), wraparound(false), mgr(manager) { }
 
 template<class metablock_t>
 void metablock_manager_t<metablock_t>::metablock_manager_t::head_t::operator++() {
@@ -54,15 +55,10 @@ int64_t metablock_manager_t<metablock_t>::metablock_manager_t::head_t::offset()
 }
 
 template<class metablock_t>
-void metablock_manager_t<metablock_t>::metablock_manager_t::head_t::push() {
-    saved_mb_slot = mb_slot;
-}
-
-template<class metablock_t>
-void metablock_manager_t<metablock_t>::metablock_manager_t::head_t::pop() {
-    guarantee(saved_mb_slot != static_cast<uint32_t>(-1), "Popping without a saved state");
-    mb_slot = saved_mb_slot;
-    saved_mb_slot = static_cast<uint32_t>(-1);
+void metablock_manager_t<metablock_t>::metablock_manager_t::head_t::seek(uint32_t slot) {
+    guarantee(slot < mgr->metablock_offsets.size());
+    mb_slot = slot;
+    wraparound = false;
 }
 
 template<class metablock_t>
@@ -124,7 +120,7 @@ void metablock_manager_t<metablock_t>::create(file_t *dbfile, int64_t extent_siz
     // We use cluster_version_t::LATEST_DISK.  Maybe we'd want to decouple cluster
     // versions from disk format versions?  We can do that later if we want.
     buffer->prepare(static_cast<uint32_t>(cluster_version_t::LATEST_DISK), initial,
-                                          MB_START_VERSION);
+                    MB_START_VERSION, false);
     co_write(dbfile, metablock_offsets[0], METABLOCK_SIZE, buffer.get(),
              DEFAULT_DISK_ACCOUNT, file_t::WRAP_IN_DATASYNCS);
 }
@@ -144,12 +140,16 @@ bool disk_format_version_is_recognized(uint32_t disk_format_version) {
         || disk_format_version
             == static_cast<uint32_t>(cluster_version_t::v1_16)
         || disk_format_version
-            == static_cast<uint32_t>(cluster_version_t::v2_0_is_latest_disk);
+            == static_cast<uint32_t>(cluster_version_t::v2_0)
+        || disk_format_version
+            == static_cast<uint32_t>(cluster_version_t::v2_1_is_latest_disk);
 }
 
 
 template<class metablock_t>
-void metablock_manager_t<metablock_t>::co_start_existing(file_t *file, bool *mb_found, metablock_t *mb_out) {
+void metablock_manager_t<metablock_t>::co_start_existing(
+        file_t *file, const ordered_write_validator_t &validator,
+        bool *mb_found, metablock_t *mb_out) {
     rassert(state == state_unstarted);
     dbfile = file;
     rassert(dbfile != NULL);
@@ -199,8 +199,12 @@ void metablock_manager_t<metablock_t>::co_start_existing(file_t *file, bool *mb_
     // all IO operations to complete and then checking. I'm dubious
     // about the benefits though, so leaving this alone.
 
-    // We've read everything from disk. Now find the last good metablock.
+    // We've read everything from disk. Now find the last good metablock, and the one
+    // that was written before it.
     crc_metablock_t *last_good_mb = NULL;
+    crc_metablock_t *previous_good_mb = NULL;
+    uint32_t last_good_slot = 0;
+    uint32_t previous_good_slot = 0;
     for (unsigned i = 0; i < metablock_offsets.size(); i++) {
         crc_metablock_t *mb_temp = lbm.get_metablock(i);
         if (mb_temp->check_crc()) {
@@ -219,17 +223,27 @@ void metablock_manager_t<metablock_t>::co_start_existing(file_t *file, bool *mb_
             if (mb_temp->version > latest_version) {
                 /* this metablock is good, maybe there are more? */
                 latest_version = mb_temp->version;
-                head.push();
-                ++head;
+                previous_good_mb = last_good_mb;
+                previous_good_slot = last_good_slot;
                 last_good_mb = mb_temp;
-            } else {
-                break;
+                last_good_slot = i;
+            } else if (mb_temp->version < latest_version
+                       && (previous_good_mb == NULL
+                           || mb_temp->version > previous_good_mb->version)) {
+                previous_good_mb = mb_temp;
+                previous_good_slot = i;
             }
-        } else {
-            ++head;
         }
     }
 
+    if (last_good_mb != NULL && last_good_mb->is_ordered() && previous_good_mb != NULL
+        && !validator(last_good_mb->metablock, previous_good_mb->metablock)) {
+        logWRN("The most recent metablock refers to data that didn't make it to disk "
+               "before the server stopped.  Falling back to the metablock before it.");
+        last_good_mb = previous_good_mb;
+        last_good_slot = previous_good_slot;
+    }
+
     // Cool, hopefully got our metablock. Wrap it up.
     if (latest_version == MB_BAD_VERSION) {
 
@@ -247,7 +261,12 @@ void metablock_manager_t<metablock_t>::co_start_existing(file_t *file, bool *mb_
         /* we found a metablock, set everything up */
         next_version_number = latest_version + 1;
         latest_version = MB_BAD_VERSION; /* version is now useless */
-        head.pop();
+        // We write the next metablock into the slot after the one we've loaded, so
+        // that the latter stays around until the new one has been completely
+        // written.  If we've fallen back to an older metablock, this overwrites the
+        // one that we've rejected.
+        head.seek(last_good_slot);
+        ++head;
         *mb_found = true;
         memcpy(mb_buffer, last_good_mb, METABLOCK_SIZE);
         memcpy(mb_out, &(mb_buffer->metablock), sizeof(metablock_t));
@@ -258,32 +277,32 @@ void metablock_manager_t<metablock_t>::co_start_existing(file_t *file, bool *mb_
 
 //The following two functions will go away in favor of the preceding one
 template<class metablock_t>
-void metablock_manager_t<metablock_t>::start_existing_callback(file_t *file, bool *mb_found, metablock_t *mb_out, metablock_read_callback_t *cb) {
-    co_start_existing(file, mb_found, mb_out);
+void metablock_manager_t<metablock_t>::start_existing_callback(file_t *file, ordered_write_validator_t validator, bool *mb_found, metablock_t *mb_out, metablock_read_callback_t *cb) {
+    co_start_existing(file, validator, mb_found, mb_out);
     cb->on_metablock_read();
 }
 
 template<class metablock_t>
-bool metablock_manager_t<metablock_t>::start_existing(file_t *file, bool *mb_found, metablock_t *mb_out, metablock_read_callback_t *cb) {
-    coro_t::spawn_later_ordered(boost::bind(&metablock_manager_t<metablock_t>::start_existing_callback, this, file, mb_found, mb_out, cb));
+bool metablock_manager_t<metablock_t>::start_existing(file_t *file, const ordered_write_validator_t &validator, bool *mb_found, metablock_t *mb_out, metablock_read_callback_t *cb) {
+    coro_t::spawn_later_ordered(boost::bind(&metablock_manager_t<metablock_t>::start_existing_callback, this, file, validator, mb_found, mb_out, cb));
     return false;
 }
 template<class metablock_t>
-void metablock_manager_t<metablock_t>::co_write_metablock(metablock_t *mb, file_account_t *io_account) {
+void metablock_manager_t<metablock_t>::co_write_metablock(metablock_t *mb, bool ordered, file_account_t *io_account) {
     mutex_t::acq_t hold(&write_lock);
 
     rassert(state == state_ready);
     rassert(!mb_buffer_in_use);
 
     mb_buffer->prepare(static_cast<uint32_t>(cluster_version_t::LATEST_DISK), mb,
-                                             next_version_number++);
+                       next_version_number++, ordered);
     rassert(mb_buffer->check_crc());
 
     mb_buffer_in_use = true;
 
     state = state_writing;
     co_write(dbfile, head.offset(), METABLOCK_SIZE, mb_buffer, io_account,
-             file_t::WRAP_IN_DATASYNCS);
+             ordered ? file_t::DATASYNC_AFTER : file_t::WRAP_IN_DATASYNCS);
 
     ++head;
 
@@ -293,14 +312,14 @@ void metablock_manager_t<metablock_t>::co_write_metablock(metablock_t *mb, file_
 }
 
 template<class metablock_t>
-void metablock_manager_t<metablock_t>::write_metablock_callback(metablock_t *mb, file_account_t *io_account, metablock_write_callback_t *cb) {
-    co_write_metablock(mb, io_account);
+void metablock_manager_t<metablock_t>::write_metablock_callback(metablock_t *mb, bool ordered, file_account_t *io_account, metablock_write_callback_t *cb) {
+    co_write_metablock(mb, ordered, io_account);
     cb->on_metablock_write();
 }
 
 template<class metablock_t>
-bool metablock_manager_t<metablock_t>::write_metablock(metablock_t *mb, file_account_t *io_account, metablock_write_callback_t *cb) {
-    coro_t::spawn_later_ordered(boost::bind(&metablock_manager_t<metablock_t>::write_metablock_callback, this, mb, io_account, cb));
+bool metablock_manager_t<metablock_t>::write_metablock(metablock_t *mb, bool ordered, file_account_t *io_account, metablock_write_callback_t *cb) {
+    coro_t::spawn_later_ordered(boost::bind(&metablock_manager_t<metablock_t>::write_metablock_callback, this, mb, ordered, io_account, cb));
     return false;
 }
 
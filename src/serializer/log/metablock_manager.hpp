@@ -15,6 +15,7 @@
 #include <stddef.h>
 #include <string.h>
 
+#include <functional>
 #include <vector>
 
 #include "errors.hpp"
@@ -35,6 +36,9 @@
 
 /* TODO support multiple concurrent writes */
 static const char MB_MARKER_MAGIC[8] = {'m', 'e', 't', 'a', 'b', 'l', 'c', 'k'};
+/* Marks metablocks that have been written without a datasync before them, so the
+blocks they refer to might not have made it to disk. */
+static const char MB_ORDERED_MARKER_MAGIC[8] = {'o', 'r', 'd', 'r', 'b', 'l', 'c', 'k'};
 
 std::vector<int64_t> initial_metablock_offsets(int64_t extent_size);
 
@@ -58,16 +62,22 @@ public:
         // The value in the metablock (pointing at LBA superblocks, etc).
         metablock_t metablock;
     public:
-        void prepare(uint32_t _disk_format_version, metablock_t *mb, metablock_version_t vers) {
+        void prepare(uint32_t _disk_format_version, metablock_t *mb, metablock_version_t vers,
+                     bool ordered) {
             disk_format_version = _disk_format_version;
             metablock = *mb;
-            memcpy(magic_marker, MB_MARKER_MAGIC, sizeof(MB_MARKER_MAGIC));
+            memcpy(magic_marker, ordered ? MB_ORDERED_MARKER_MAGIC : MB_MARKER_MAGIC,
+                   sizeof(MB_MARKER_MAGIC));
             version = vers;
             _crc = compute_own_crc();
         }
         bool check_crc() {
             return (_crc == compute_own_crc());
         }
+        bool is_ordered() const {
+            return memcmp(magic_marker, MB_ORDERED_MARKER_MAGIC,
+                          sizeof(MB_ORDERED_MARKER_MAGIC)) == 0;
+        }
     private:
         uint32_t compute_own_crc() {
             boost::crc_32_type crc_computer;
@@ -84,21 +94,36 @@ public:
     /* Clear metablock slots and write an initial metablock to the database file */
     static void create(file_t *dbfile, int64_t extent_size, metablock_t *initial);
 
+    /* Called on startup if the newest metablock has been written as an ordered write,
+    with that metablock and the one that was written before it.  Returns whether
+    everything the newest metablock refers to made it to disk; we fall back to the
+    previous one if it didn't.  Only the newest metablock ever needs to be checked,
+    because we don't start writing a metablock until the previous one has been
+    datasynced. */
+    typedef std::function<bool(const metablock_t &newest, const metablock_t &previous)>
+        ordered_write_validator_t;
+
     /* Tries to load existing metablocks */
-    void co_start_existing(file_t *dbfile, bool *mb_found, metablock_t *mb_out);
+    void co_start_existing(file_t *dbfile, const ordered_write_validator_t &validator,
+                           bool *mb_found, metablock_t *mb_out);
     struct metablock_read_callback_t {
         virtual void on_metablock_read() = 0;
         virtual ~metablock_read_callback_t() {}
     };
 
-    bool start_existing(file_t *dbfile, bool *mb_found, metablock_t *mb_out, metablock_read_callback_t *cb);
+    bool start_existing(file_t *dbfile, const ordered_write_validator_t &validator,
+                        bool *mb_found, metablock_t *mb_out, metablock_read_callback_t *cb);
 
     struct metablock_write_callback_t {
         virtual void on_metablock_write() = 0;
         virtual ~metablock_write_callback_t() {}
     };
-    bool write_metablock(metablock_t *mb, file_account_t *io_account, metablock_write_callback_t *cb);
-    void co_write_metablock(metablock_t *mb, file_account_t *io_account);
+    /* An ordered write only datasyncs after writing the metablock, so the caller has
+    to make sure that the validator passed to `start_existing()` can tell whether
+    what the metablock refers to made it to disk. */
+    bool write_metablock(metablock_t *mb, bool ordered, file_account_t *io_account,
+                         metablock_write_callback_t *cb);
+    void co_write_metablock(metablock_t *mb, bool ordered, file_account_t *io_account);
 
     void shutdown();
 
@@ -108,7 +133,6 @@ private:
     struct head_t {
     private:
         uint32_t mb_slot;
-        uint32_t saved_mb_slot;
     public:
         // whether or not we've wrapped around the edge (used during startup)
         bool wraparound;
@@ -122,15 +146,15 @@ private:
         // return the offset we should be writing to
         int64_t offset();
 
-        // save the state to be loaded later (used to save the last known uncorrupted metablock)
-        void push();
-
-        //load a previously saved state (stack has max depth one)
-        void pop();
+        // jump to the given slot (used during startup)
+        void seek(uint32_t slot);
     };
 
-    void start_existing_callback(file_t *dbfile, bool *mb_found, metablock_t *mb_out, metablock_read_callback_t *cb);
-    void write_metablock_callback(metablock_t *mb, file_account_t *io_account, metablock_write_callback_t *cb);
+    void start_existing_callback(file_t *dbfile, ordered_write_validator_t validator,
+                                 bool *mb_found, metablock_t *mb_out,
+                                 metablock_read_callback_t *cb);
+    void write_metablock_callback(metablock_t *mb, bool ordered, file_account_t *io_account,
+                                  metablock_write_callback_t *cb);
     void on_io_complete();
 
     mutex_t write_lock;
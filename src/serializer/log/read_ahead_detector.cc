@@ -0,0 +1,60 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/log/read_ahead_detector.hpp"
+
+#include <algorithm>
+
+read_ahead_detector_t::read_ahead_detector_t(int64_t _extent_size,
+                                             int64_t _min_read_ahead_size)
+    : extent_size(_extent_size),
+      min_read_ahead_size(std::min(_min_read_ahead_size, _extent_size)),
+      num_recorded_reads(0) {
+    guarantee(extent_size > 0);
+    guarantee(min_read_ahead_size > 0);
+    for (auto it = extents.begin(); it != extents.end(); ++it) {
+        it->extent_index = 0;
+        it->reads = 0;
+        it->last_read = 0;
+    }
+}
+
+read_ahead_detector_t::tracked_extent_t *
+read_ahead_detector_t::find(int64_t extent_index) {
+    for (auto it = extents.begin(); it != extents.end(); ++it) {
+        if (it->reads > 0 && it->extent_index == extent_index) {
+            return &*it;
+        }
+    }
+    return NULL;
+}
+
+int64_t read_ahead_detector_t::record_read(int64_t offset) {
+    ++num_recorded_reads;
+    const int64_t extent_index = offset / extent_size;
+
+    tracked_extent_t *extent = find(extent_index);
+    if (extent == NULL) {
+        // A traversal that moves on to the next extent keeps its momentum.
+        const tracked_extent_t *previous = find(extent_index - 1);
+        const int64_t inherited_reads
+            = previous != NULL && previous->reads > 1 ? previous->reads - 1 : 0;
+
+        // Replace the extent that we haven't read from for the longest time.
+        extent = &*std::min_element(extents.begin(), extents.end(),
+            [](const tracked_extent_t &x, const tracked_extent_t &y) {
+                return x.last_read < y.last_read;
+            });
+        extent->extent_index = extent_index;
+        extent->reads = inherited_reads;
+    }
+    extent->last_read = num_recorded_reads;
+    ++extent->reads;
+
+    if (extent->reads < 2) {
+        return 0;
+    }
+    int64_t size = min_read_ahead_size;
+    for (int64_t i = 2; i < extent->reads && size < extent_size; ++i) {
+        size *= 2;
+    }
+    return std::min(size, extent_size);
+}
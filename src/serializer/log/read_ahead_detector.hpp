@@ -0,0 +1,50 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_READ_AHEAD_DETECTOR_HPP_
+#define SERIALIZER_LOG_READ_AHEAD_DETECTOR_HPP_
+
+#include <stdint.h>
+
+#include <array>
+
+#include "errors.hpp"
+
+// How many extents the read-ahead detector remembers.
+#define READ_AHEAD_DETECTOR_TRACKED_EXTENTS 8
+
+/* `read_ahead_detector_t` decides how much to read ahead for a block read, based on
+the reads that came before it. Traversals such as backfills and table scans visit
+blocks that were written together, so their reads keep landing in the same few extents
+(or in the extent right after the one they just finished), while point reads on a
+large table rarely hit the same extent twice in a row. We remember the last few
+extents that were read from and how many reads each got; the first read in an extent
+doesn't read ahead at all, and every further read doubles the read-ahead size, up to
+the whole extent. */
+class read_ahead_detector_t {
+public:
+    // `min_read_ahead_size` is used for the second read from an extent.
+    read_ahead_detector_t(int64_t extent_size, int64_t min_read_ahead_size);
+
+    // Records a read at `offset` and returns how many bytes around it should be read,
+    // or 0 if we should only read the block itself.
+    int64_t record_read(int64_t offset);
+
+private:
+    struct tracked_extent_t {
+        int64_t extent_index;
+        // 0 means that the slot is unused.
+        int64_t reads;
+        // When the extent was last read from, in units of `record_read()` calls.
+        uint64_t last_read;
+    };
+
+    tracked_extent_t *find(int64_t extent_index);
+
+    const int64_t extent_size;
+    const int64_t min_read_ahead_size;
+    uint64_t num_recorded_reads;
+    std::array<tracked_extent_t, READ_AHEAD_DETECTOR_TRACKED_EXTENTS> extents;
+
+    DISABLE_COPYING(read_ahead_detector_t);
+};
+
+#endif  // SERIALIZER_LOG_READ_AHEAD_DETECTOR_HPP_
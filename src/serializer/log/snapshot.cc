@@ -0,0 +1,86 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "serializer/log/snapshot.hpp"
+
+#include "arch/arch.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "serializer/log/static_header.hpp"
+#include "utils.hpp"
+
+// The same priority as the nice garbage collector.
+const int SNAPSHOT_IO_PRIORITY = 8;
+
+const log_serializer_t::metablock_t &log_serializer_snapshot_t::get_last_written_metablock(
+        log_serializer_t *serializer) {
+    serializer->assert_thread();
+    guarantee(serializer->state == log_serializer_t::state_ready);
+    return *serializer->last_written_metablock;
+}
+
+log_serializer_snapshot_t::log_serializer_snapshot_t(log_serializer_t *_serializer)
+    : serializer(_serializer),
+      metablock(get_last_written_metablock(serializer)),
+      pinned_extents(serializer->extent_manager->pin_extents_in_use()) { }
+
+log_serializer_snapshot_t::~log_serializer_snapshot_t() {
+    serializer->assert_thread();
+    for (extent_reference_t &extent_ref : pinned_extents) {
+        serializer->extent_manager->release_extent_pin(std::move(extent_ref));
+    }
+}
+
+int64_t log_serializer_snapshot_t::size_in_bytes() const {
+    return pinned_extents.size() * serializer->static_config.extent_size();
+}
+
+void log_serializer_snapshot_t::write_to_file(serializer_file_opener_t *file_opener,
+                                              int64_t max_bytes_per_second,
+                                              signal_t *interruptor) {
+    serializer->assert_thread();
+    const int64_t extent_size = serializer->static_config.extent_size();
+
+    scoped_ptr_t<file_t> file;
+    file_opener->open_serializer_file_create_temporary(&file);
+
+    /* Set the file up the way `log_serializer_t::create()` does, except that the
+    initial metablock is the snapshot's. The first extent holds the static header and
+    the metablocks, so we don't copy it. */
+    log_serializer_on_disk_static_config_t on_disk_config = serializer->static_config;
+    co_static_header_write(file.get(), &on_disk_config, sizeof(on_disk_config));
+    log_serializer_t::metablock_t metablock_copy = metablock;
+    mb_manager_t::create(file.get(), extent_size, &metablock_copy);
+
+    scoped_ptr_t<file_account_t> read_account(new file_account_t(
+        serializer->dbfile, SNAPSHOT_IO_PRIORITY, UNLIMITED_OUTSTANDING_REQUESTS,
+        io_class_t::gc));
+    scoped_malloc_t<char> buffer(malloc_aligned(extent_size, DEVICE_BLOCK_SIZE));
+    const ticks_t start_time = get_ticks();
+    int64_t bytes_copied = 0;
+    for (const extent_reference_t &extent_ref : pinned_extents) {
+        if (extent_ref.offset() == 0) {
+            continue;
+        }
+        co_read(serializer->dbfile, extent_ref.offset(), extent_size, buffer.get(),
+                read_account.get());
+        file->set_file_size_at_least(extent_ref.offset() + extent_size);
+        co_write(file.get(), extent_ref.offset(), extent_size, buffer.get(),
+                 DEFAULT_DISK_ACCOUNT, file_t::NO_DATASYNCS);
+        bytes_copied += extent_size;
+
+        if (max_bytes_per_second > 0) {
+            // Sleep until we're back under the rate limit.
+            const int64_t target_ms = bytes_copied * THOUSAND / max_bytes_per_second;
+            const int64_t elapsed_ms =
+                static_cast<int64_t>(ticks_to_secs(get_ticks() - start_time) * THOUSAND);
+            if (target_ms > elapsed_ms) {
+                nap(target_ms - elapsed_ms, interruptor);
+            }
+        }
+        if (interruptor->is_pulsed()) {
+            throw interrupted_exc_t();
+        }
+    }
+
+    file.reset();
+    file_opener->move_serializer_file_to_permanent_location();
+}
@@ -0,0 +1,53 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_SNAPSHOT_HPP_
+#define SERIALIZER_LOG_SNAPSHOT_HPP_
+
+#include <vector>
+
+#include "serializer/log/log_serializer.hpp"
+
+class signal_t;
+
+/* A `log_serializer_snapshot_t` captures the state of a `log_serializer_t` as of its
+most recently written metablock, without reading any blocks. It keeps a copy of that
+metablock and pins every extent that is in use, which includes every extent the
+metablock refers to, so that they aren't reused while the snapshot exists. The
+serializer keeps running normally in the meantime; the garbage collector may still move
+blocks out of the pinned extents, but the extents themselves keep their old contents
+until the snapshot is destroyed.
+
+`write_to_file()` then copies the snapshot into a new serializer file, which opens to
+the state the serializer was in when the snapshot was taken. It reads whole extents at
+the priority of the garbage collector and can be throttled, so that taking a backup
+doesn't compete with queries for the cache or much of the disk bandwidth.
+
+The snapshot must be created and destroyed on the serializer's home thread, and must be
+destroyed before the serializer. */
+class log_serializer_snapshot_t {
+public:
+    explicit log_serializer_snapshot_t(log_serializer_t *serializer);
+    ~log_serializer_snapshot_t();
+
+    /* The number of bytes that `write_to_file()` copies. */
+    int64_t size_in_bytes() const;
+
+    /* Creates the file through `file_opener` and copies the snapshot into it.
+    `max_bytes_per_second` limits how fast we read from the serializer's file; zero
+    means no limit. Blocks; throws `interrupted_exc_t` if `interruptor` is pulsed, in
+    which case the file is left in its temporary location. */
+    void write_to_file(serializer_file_opener_t *file_opener,
+                       int64_t max_bytes_per_second,
+                       signal_t *interruptor);
+
+private:
+    static const log_serializer_t::metablock_t &get_last_written_metablock(
+        log_serializer_t *serializer);
+
+    log_serializer_t *const serializer;
+    const log_serializer_t::metablock_t metablock;
+    std::vector<extent_reference_t> pinned_extents;
+
+    DISABLE_COPYING(log_serializer_snapshot_t);
+};
+
+#endif  // SERIALIZER_LOG_SNAPSHOT_HPP_
@@ -10,6 +10,8 @@ struct log_serializer_stats_t {
 
     void bytes_read(size_t count);
     void bytes_written(size_t count);
+    // Records a single write request to the file that covers `blocks` blocks.
+    void coalesced_write(size_t blocks);
 
     perfmon_duration_sampler_t pm_serializer_block_reads;
     perfmon_counter_t pm_serializer_index_reads;
@@ -22,6 +24,11 @@ struct log_serializer_stats_t {
     perfmon_rate_monitor_t pm_serializer_written_bytes_per_sec;
     perfmon_counter_t pm_serializer_written_bytes_total;
 
+    /* Data-block and LBA writes that are contiguous on disk are merged into one
+    writev.  The ratio of these two is the average number of blocks per writev. */
+    perfmon_counter_t pm_serializer_write_ops;
+    perfmon_counter_t pm_serializer_write_ops_blocks;
+
     /* used in serializer/log/extent_manager.cc */
     perfmon_counter_t pm_extents_in_use;
     perfmon_counter_t pm_bytes_in_use;
@@ -35,6 +42,16 @@ struct log_serializer_stats_t {
     perfmon_counter_t pm_serializer_data_extents_gced;
     perfmon_counter_t pm_serializer_old_garbage_block_bytes;
     perfmon_counter_t pm_serializer_old_total_block_bytes;
+    perfmon_counter_t pm_serializer_compressed_blocks;
+    perfmon_counter_t pm_serializer_compressed_bytes_saved;
+    // The part of the bytes read and written that the GC moved around.
+    perfmon_counter_t pm_serializer_gc_read_bytes_total;
+    perfmon_counter_t pm_serializer_gc_written_bytes_total;
+
+    /* used in serializer/log/log_serializer.cc.  A block read ahead is used if one
+    of the read-ahead callbacks (the caches) takes it. */
+    perfmon_counter_t pm_serializer_read_ahead_blocks;
+    perfmon_counter_t pm_serializer_read_ahead_blocks_used;
 
     /* used in serializer/log/lba/lba_list.cc */
     perfmon_counter_t pm_serializer_lba_gcs;
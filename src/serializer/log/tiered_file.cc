@@ -0,0 +1,179 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "serializer/log/tiered_file.hpp"
+
+#include <string.h>
+
+#include <functional>
+
+#include "arch/arch.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "config/args.hpp"
+#include "utils.hpp"
+
+// Identifies the slow file of a tiered serializer file.
+static const uint64_t SLOW_FILE_MAGIC = 0x72656974776f6c73ull;  // "slowtier"
+
+struct slow_file_header_t {
+    uint64_t magic;
+    int64_t slow_tier_offset;
+} __attribute__((__packed__));
+
+const int64_t tiered_file_t::SLOW_FILE_HEADER_SIZE = DEVICE_BLOCK_SIZE;
+
+void tiered_file_t::initialize_slow_file(file_t *slow_file, int64_t slow_tier_offset) {
+    scoped_malloc_t<char> buffer(malloc_aligned(SLOW_FILE_HEADER_SIZE, DEVICE_BLOCK_SIZE));
+    bzero(buffer.get(), SLOW_FILE_HEADER_SIZE);
+    slow_file_header_t *header = reinterpret_cast<slow_file_header_t *>(buffer.get());
+    header->magic = SLOW_FILE_MAGIC;
+    header->slow_tier_offset = slow_tier_offset;
+
+    slow_file->set_file_size(SLOW_FILE_HEADER_SIZE);
+    co_write(slow_file, 0, SLOW_FILE_HEADER_SIZE, buffer.get(), DEFAULT_DISK_ACCOUNT,
+             file_t::WRAP_IN_DATASYNCS);
+}
+
+bool tiered_file_t::read_slow_file_header(file_t *slow_file,
+                                          int64_t *slow_tier_offset_out) {
+    if (slow_file->get_file_size() < SLOW_FILE_HEADER_SIZE) {
+        return false;
+    }
+    scoped_malloc_t<char> buffer(malloc_aligned(SLOW_FILE_HEADER_SIZE, DEVICE_BLOCK_SIZE));
+    co_read(slow_file, 0, SLOW_FILE_HEADER_SIZE, buffer.get(), DEFAULT_DISK_ACCOUNT);
+    const slow_file_header_t *header
+        = reinterpret_cast<const slow_file_header_t *>(buffer.get());
+    if (header->magic != SLOW_FILE_MAGIC || header->slow_tier_offset <= 0) {
+        return false;
+    }
+    *slow_tier_offset_out = header->slow_tier_offset;
+    return true;
+}
+
+// What `create_account` returns: one account for each of the two files.
+struct tiered_file_t::tiered_account_t {
+    tiered_account_t(file_t *fast_file, file_t *slow_file,
+                     int priority, int outstanding_requests_limit,
+                     io_class_t io_class)
+        : fast(fast_file, priority, outstanding_requests_limit, io_class),
+          slow(slow_file, priority, outstanding_requests_limit, io_class) { }
+    file_account_t fast;
+    file_account_t slow;
+};
+
+tiered_file_t::tiered_file_t(scoped_ptr_t<file_t> &&fast_file,
+                             scoped_ptr_t<file_t> &&slow_file,
+                             int64_t slow_tier_offset)
+    : fast_file_(std::move(fast_file)),
+      slow_file_(std::move(slow_file)),
+      slow_tier_offset_(slow_tier_offset) {
+    guarantee(slow_tier_offset_ > 0);
+    guarantee(slow_file_->get_file_size() >= SLOW_FILE_HEADER_SIZE);
+}
+
+tiered_file_t::~tiered_file_t() { }
+
+int64_t tiered_file_t::get_file_size() {
+    const int64_t slow_size = slow_file_->get_file_size() - SLOW_FILE_HEADER_SIZE;
+    return slow_size > 0 ? slow_tier_offset_ + slow_size : fast_file_->get_file_size();
+}
+
+void tiered_file_t::set_file_size(int64_t size) {
+    if (size <= slow_tier_offset_) {
+        fast_file_->set_file_size(size);
+        slow_file_->set_file_size(SLOW_FILE_HEADER_SIZE);
+    } else {
+        fast_file_->set_file_size(slow_tier_offset_);
+        slow_file_->set_file_size(SLOW_FILE_HEADER_SIZE + size - slow_tier_offset_);
+    }
+}
+
+void tiered_file_t::set_file_size_at_least(int64_t size) {
+    if (size <= slow_tier_offset_) {
+        fast_file_->set_file_size_at_least(size);
+    } else {
+        fast_file_->set_file_size_at_least(slow_tier_offset_);
+        slow_file_->set_file_size_at_least(
+            SLOW_FILE_HEADER_SIZE + size - slow_tier_offset_);
+    }
+}
+
+file_t *tiered_file_t::route(int64_t *offset, size_t length, file_account_t **account) {
+    tiered_account_t *tiered_account = *account == DEFAULT_DISK_ACCOUNT
+        ? NULL
+        : static_cast<tiered_account_t *>((*account)->get_account());
+    if (*offset < slow_tier_offset_) {
+        guarantee(*offset + static_cast<int64_t>(length) <= slow_tier_offset_,
+                  "I/O crosses the boundary between the storage tiers");
+        if (tiered_account != NULL) {
+            *account = &tiered_account->fast;
+        }
+        return fast_file_.get();
+    } else {
+        *offset = *offset - slow_tier_offset_ + SLOW_FILE_HEADER_SIZE;
+        if (tiered_account != NULL) {
+            *account = &tiered_account->slow;
+        }
+        return slow_file_.get();
+    }
+}
+
+void tiered_file_t::read_async(int64_t offset, size_t length, void *buf,
+                               file_account_t *account, linux_iocallback_t *cb) {
+    file_t *file = route(&offset, length, &account);
+    file->read_async(offset, length, buf, account, cb);
+}
+
+void tiered_file_t::write_async(int64_t offset, size_t length, const void *buf,
+                                file_account_t *account, linux_iocallback_t *cb,
+                                wrap_in_datasyncs_t wrap_in_datasyncs) {
+    file_t *file = route(&offset, length, &account);
+    if (wrap_in_datasyncs == NO_DATASYNCS) {
+        file->write_async(offset, length, buf, account, cb, wrap_in_datasyncs);
+    } else {
+        file_t *other_file = file == fast_file_.get()
+            ? slow_file_.get()
+            : fast_file_.get();
+        coro_t::spawn_sometime(std::bind(&tiered_file_t::synced_write, this,
+                                         file, other_file, offset, length, buf,
+                                         account, cb, wrap_in_datasyncs));
+    }
+}
+
+// A datasync on `file` only flushes writes to that one file, so on its own a synced
+// write (such as the metablock's) would leave blocks it refers to in the other tier
+// unflushed.  We datasync the other file around the write too.
+void tiered_file_t::synced_write(file_t *file, file_t *other_file,
+                                 int64_t offset, size_t length, const void *buf,
+                                 file_account_t *account, linux_iocallback_t *cb,
+                                 wrap_in_datasyncs_t wrap_in_datasyncs) {
+    datasync(other_file);
+    co_write(file, offset, length, const_cast<void *>(buf), account,
+             wrap_in_datasyncs);
+    datasync(other_file);
+    cb->on_io_complete();
+}
+
+void tiered_file_t::datasync(file_t *file) {
+    // An empty write that's wrapped in datasyncs comes down to an fdatasync.
+    co_write(file, 0, 0, NULL, DEFAULT_DISK_ACCOUNT, WRAP_IN_DATASYNCS);
+}
+
+void tiered_file_t::writev_async(int64_t offset, size_t length,
+                                 scoped_array_t<iovec> &&bufs,
+                                 file_account_t *account, linux_iocallback_t *cb) {
+    file_t *file = route(&offset, length, &account);
+    file->writev_async(offset, length, std::move(bufs), account, cb);
+}
+
+void *tiered_file_t::create_account(int priority, int outstanding_requests_limit,
+                                    io_class_t io_class) {
+    return new tiered_account_t(fast_file_.get(), slow_file_.get(),
+                                priority, outstanding_requests_limit, io_class);
+}
+
+void tiered_file_t::destroy_account(void *account) {
+    delete static_cast<tiered_account_t *>(account);
+}
+
+bool tiered_file_t::coop_lock_and_check() {
+    return fast_file_->coop_lock_and_check() && slow_file_->coop_lock_and_check();
+}
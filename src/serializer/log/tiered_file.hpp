@@ -0,0 +1,76 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#ifndef SERIALIZER_LOG_TIERED_FILE_HPP_
+#define SERIALIZER_LOG_TIERED_FILE_HPP_
+
+#include "arch/types.hpp"
+#include "containers/scoped.hpp"
+
+/* `tiered_file_t` makes two files look like one: offsets below `slow_tier_offset` go to
+the fast file, and the rest go to the slow file, after a header that records
+`slow_tier_offset`. The log serializer then puts extents that hold long-lived blocks
+at or above `slow_tier_offset` (see `extent_tier_t`), so that the working set stays on
+the fast device while the bulk of the data can live on a bigger, cheaper one.
+
+No read or write may cross `slow_tier_offset`. The serializer never does that, since
+`slow_tier_offset` is a multiple of the extent size and no i/o crosses an extent
+boundary. */
+class tiered_file_t : public file_t {
+public:
+    // Size of the header at the start of the slow file.
+    static const int64_t SLOW_FILE_HEADER_SIZE;
+
+    // Writes the header of a new, empty slow file.
+    static void initialize_slow_file(file_t *slow_file, int64_t slow_tier_offset);
+
+    // Reads `*slow_tier_offset_out` from the header of an existing slow file.  Returns
+    // false if the file doesn't have a valid header.
+    static MUST_USE bool read_slow_file_header(file_t *slow_file,
+                                               int64_t *slow_tier_offset_out);
+
+    tiered_file_t(scoped_ptr_t<file_t> &&fast_file,
+                  scoped_ptr_t<file_t> &&slow_file,
+                  int64_t slow_tier_offset);
+    ~tiered_file_t();
+
+    int64_t slow_tier_offset() const { return slow_tier_offset_; }
+
+    int64_t get_file_size();
+    void set_file_size(int64_t size);
+    void set_file_size_at_least(int64_t size);
+
+    void read_async(int64_t offset, size_t length, void *buf,
+                    file_account_t *account, linux_iocallback_t *cb);
+    void write_async(int64_t offset, size_t length, const void *buf,
+                     file_account_t *account, linux_iocallback_t *cb,
+                     wrap_in_datasyncs_t wrap_in_datasyncs);
+    void writev_async(int64_t offset, size_t length, scoped_array_t<iovec> &&bufs,
+                      file_account_t *account, linux_iocallback_t *cb);
+
+    void *create_account(int priority, int outstanding_requests_limit,
+                         io_class_t io_class);
+    void destroy_account(void *account);
+
+    bool coop_lock_and_check();
+
+private:
+    struct tiered_account_t;
+
+    // Picks the file that `[offset, offset + length)` lives in, translates `offset`
+    // into that file and picks the matching part of `account`.
+    file_t *route(int64_t *offset, size_t length, file_account_t **account);
+
+    // Does a write that has datasyncs, datasyncing `other_file` as well.
+    void synced_write(file_t *file, file_t *other_file,
+                      int64_t offset, size_t length, const void *buf,
+                      file_account_t *account, linux_iocallback_t *cb,
+                      wrap_in_datasyncs_t wrap_in_datasyncs);
+    static void datasync(file_t *file);
+
+    scoped_ptr_t<file_t> fast_file_;
+    scoped_ptr_t<file_t> slow_file_;
+    const int64_t slow_tier_offset_;
+
+    DISABLE_COPYING(tiered_file_t);
+};
+
+#endif  // SERIALIZER_LOG_TIERED_FILE_HPP_
@@ -9,12 +9,21 @@
 #include "concurrency/new_mutex.hpp"
 #include "config/args.hpp"
 #include "serializer/types.hpp"
+#include "time.hpp"
 
 
 merger_serializer_t::merger_serializer_t(scoped_ptr_t<serializer_t> _inner,
-                                         int _max_active_writes) :
+                                         int _max_active_writes,
+                                         int64_t _max_commit_delay_usecs,
+                                         perfmon_collection_t *perfmon_collection) :
     inner(std::move(_inner)),
-    block_writes_io_account(make_io_account(MERGER_BLOCK_WRITE_IO_PRIORITY)),
+    block_writes_io_account(make_io_account(MERGER_BLOCK_WRITE_IO_PRIORITY,
+                                            io_class_t::flush)),
+    num_outstanding_index_writes(0),
+    max_commit_delay_usecs(_max_commit_delay_usecs),
+    pm_index_writes_merged(secs_to_ticks(1), false),
+    pm_index_writes_merged_membership(perfmon_collection, &pm_index_writes_merged,
+                                      "serializer_index_writes_merged"),
     write_committer(std::bind(&merger_serializer_t::do_index_write, this),
                     _max_active_writes) { }
 
@@ -32,6 +41,7 @@ void merger_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
     for (auto op = write_ops.begin(); op != write_ops.end(); ++op) {
         push_index_write_op(*op);
     }
+    ++num_outstanding_index_writes;
 
     // The caller is definitely "in line" for this merger serializer -- subsequent
     // index_write calls will get logically committed after ours.
@@ -41,9 +51,27 @@ void merger_serializer_t::index_write(new_mutex_in_line_t *mutex_acq,
     write_committer.sync();
 }
 
+void merger_serializer_t::wait_for_more_index_writes() {
+    if (max_commit_delay_usecs <= 0) {
+        return;
+    }
+    // Timers are too coarse for this, so we yield instead. Index writes from
+    // other threads get queued up on our thread in the meantime.
+    const ticks_t deadline = get_ticks() + max_commit_delay_usecs * 1000;
+    while (get_ticks() < deadline) {
+        const int num_before = num_outstanding_index_writes;
+        coro_t::yield();
+        if (num_outstanding_index_writes == num_before) {
+            break;
+        }
+    }
+}
+
 void merger_serializer_t::do_index_write() {
     assert_thread();
 
+    wait_for_more_index_writes();
+
     // Assemble the currently outstanding index writes into
     // a vector of index_write_op_t-s.
     std::vector<index_write_op_t> write_ops;
@@ -56,6 +84,8 @@ void merger_serializer_t::do_index_write() {
             write_ops.push_back(op_pair->second);
         }
         outstanding_index_write_ops.clear();
+        pm_index_writes_merged.record(num_outstanding_index_writes);
+        num_outstanding_index_writes = 0;
     }
 
     new_mutex_in_line_t mutex_acq(&inner_index_write_mutex);
@@ -10,6 +10,7 @@
 #include "concurrency/new_mutex.hpp"
 #include "concurrency/throttled_committer.hpp"
 #include "containers/scoped.hpp"
+#include "perfmon/perfmon.hpp"
 #include "serializer/buf_ptr.hpp"
 #include "serializer/serializer.hpp"
 
@@ -26,19 +27,28 @@
  * for all block_writes, so reduce the amount of random disk seeks that can
  * occur when writes from multiple different accounts get interleaved (see
  * https://github.com/rethinkdb/rethinkdb/issues/3348 )
+ *
+ * Before it starts an index write, the merger can wait for up to
+ * `max_commit_delay_usecs` for more index writes to come in, so that they can
+ * share the write and its datasyncs. It stops waiting as soon as no new index
+ * writes arrive, so a lone write isn't delayed noticeably. This mostly helps
+ * hard durability writes, every one of which waits for its own index write.
  */
 
 class merger_serializer_t : public serializer_t {
 public:
-    merger_serializer_t(scoped_ptr_t<serializer_t> _inner, int _max_active_writes);
+    merger_serializer_t(scoped_ptr_t<serializer_t> _inner, int _max_active_writes,
+                        int64_t _max_commit_delay_usecs,
+                        perfmon_collection_t *perfmon_collection);
     ~merger_serializer_t();
 
 
     /* Allocates a new io account for the underlying file.
     Use delete to free it. */
     using serializer_t::make_io_account;
-    file_account_t *make_io_account(int priority, int outstanding_requests_limit) {
-        return inner->make_io_account(priority, outstanding_requests_limit);
+    file_account_t *make_io_account(int priority, int outstanding_requests_limit,
+                                    io_class_t io_class) {
+        return inner->make_io_account(priority, outstanding_requests_limit, io_class);
     }
 
     /* Some serializer implementations support read-ahead to speed up cache warmup.
@@ -124,6 +134,10 @@ private:
 
     void do_index_write();
 
+    // Gives index writes that are about to come in a chance to join the next
+    // index write.
+    void wait_for_more_index_writes();
+
     const scoped_ptr_t<serializer_t> inner;
     const scoped_ptr_t<file_account_t> block_writes_io_account;
 
@@ -133,6 +147,15 @@ private:
 
     // A map of outstanding index write operations, indexed by block id
     std::map<block_id_t, index_write_op_t> outstanding_index_write_ops;
+    // The number of `index_write()` calls that `outstanding_index_write_ops`
+    // has been assembled from.
+    int num_outstanding_index_writes;
+
+    const int64_t max_commit_delay_usecs;
+
+    // How many `index_write()` calls each index write on `inner` served.
+    perfmon_sampler_t pm_index_writes_merged;
+    perfmon_membership_t pm_index_writes_merged_membership;
 
     throttled_committer_t write_committer;
 
@@ -48,10 +48,12 @@ public:
     serializer_t() { }
     virtual ~serializer_t() { }
 
-    /* Allocates a new io account for the underlying file.
+    /* Allocates a new io account for the underlying file.  `io_class` only
+    determines which disk stats the account's operations are counted in.
     Use delete to free it. */
-    file_account_t *make_io_account(int priority);
-    virtual file_account_t *make_io_account(int priority, int outstanding_requests_limit) = 0;
+    file_account_t *make_io_account(int priority, io_class_t io_class = io_class_t::other);
+    virtual file_account_t *make_io_account(int priority, int outstanding_requests_limit,
+                                            io_class_t io_class) = 0;
 
     /* Some serializer implementations support read-ahead to speed up cache warmup.
     This is supported through a serializer_read_ahead_callback_t which gets called whenever the serializer has read-ahead some buf.
@@ -111,7 +111,8 @@ public:
     translator_serializer_t(serializer_t *inner, int mod_count, int mod_id, config_block_id_t cfgid);
 
     /* Allocates a new io account for the underlying file */
-    file_account_t *make_io_account(int priority, int outstanding_requests_limit);
+    file_account_t *make_io_account(int priority, int outstanding_requests_limit,
+                                    io_class_t io_class);
 
     void index_write(new_mutex_in_line_t *mutex_acq,
                      const std::vector<index_write_op_t> &write_ops);
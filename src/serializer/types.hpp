@@ -121,9 +121,16 @@ class ls_block_token_pointee_t {
 public:
     int64_t offset() const { return offset_; }
     block_size_t block_size() const { return block_size_; }
+    // How much space the block takes up on disk.  This is smaller than
+    // `block_size()` if the block has been stored compressed.
+    block_size_t disk_block_size() const { return disk_block_size_; }
+    bool is_compressed() const {
+        return disk_block_size_.ser_value() != block_size_.ser_value();
+    }
 
 private:
     friend class log_serializer_t;
+    friend class data_block_manager_t;  // For `disk_crc_`.
     friend class dbm_read_ahead_fsm_t;  // For read-ahead tokens.
 
     friend void counted_add_ref(ls_block_token_pointee_t *p);
@@ -131,7 +138,8 @@ private:
 
     ls_block_token_pointee_t(log_serializer_t *serializer,
                              int64_t initial_offset,
-                             block_size_t initial_ser_block_size);
+                             block_size_t initial_ser_block_size,
+                             block_size_t initial_disk_block_size);
 
     log_serializer_t *serializer_;
     intptr_t ref_count_;
@@ -139,9 +147,18 @@ private:
     // The block's size.
     block_size_t block_size_;
 
+    // The block's size on disk.
+    block_size_t disk_block_size_;
+
     // The block's offset on disk.
     int64_t offset_;
 
+    // The CRC of the `disk_block_size_` bytes we wrote at `offset_`, if this token
+    // comes from a write in ordered-writes mode.  See
+    // `log_serializer_dynamic_config_t::ordered_writes`.
+    bool has_disk_crc_;
+    uint32_t disk_crc_;
+
     void do_destroy();
 
     DISABLE_COPYING(ls_block_token_pointee_t);
@@ -173,6 +190,10 @@ public:
     virtual void move_serializer_file_to_permanent_location() = 0;
     virtual void open_serializer_file_existing(scoped_ptr_t<file_t> *file_out) = 0;
     virtual void unlink_serializer_file() = 0;
+
+    // The offset at which the opened file switches over to a second, slower storage
+    // device, or -1 if it doesn't.  Only meaningful once the file has been opened.
+    virtual int64_t slow_tier_offset() const { return -1; }
 #ifdef SEMANTIC_SERIALIZER_CHECK
     virtual void open_semantic_checking_file(scoped_ptr_t<semantic_checking_file_t> *file_out) = 0;
 #endif
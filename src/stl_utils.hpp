@@ -5,6 +5,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -23,6 +24,9 @@ bool std_contains(const container_t &, const typename container_t::key_type &);
 template <class K, class V, class C>
 void debug_print(printf_buffer_t *buf, const std::map<K, V, C> &map);
 
+template <class K, class V, class H, class E>
+void debug_print(printf_buffer_t *buf, const std::unordered_map<K, V, H, E> &map);
+
 template <class T>
 void debug_print(printf_buffer_t *buf, const std::set<T> &map);
 
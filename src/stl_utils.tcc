@@ -44,6 +44,13 @@ void debug_print(printf_buffer_t *buf, const std::map<K, V, C> &map) {
     buf->appendf("}");
 }
 
+template <class K, class V, class H, class E>
+void debug_print(printf_buffer_t *buf, const std::unordered_map<K, V, H, E> &map) {
+    buf->appendf("{");
+    debug_print_iterators(buf, map.begin(), map.end());
+    buf->appendf("}");
+}
+
 template <class T>
 void debug_print(printf_buffer_t *buf, const std::set<T> &set) {
     buf->appendf("#{");
@@ -65,6 +65,14 @@ public:
         return ts;
     }
 
+    // For write tokens, which clients hand back to us (see `write_versions_t`).
+    uint64_t to_num() const { return num; }
+    static state_timestamp_t from_num(uint64_t n) {
+        state_timestamp_t t;
+        t.num = n;
+        return t;
+    }
+
     friend void debug_print(printf_buffer_t *buf, state_timestamp_t ts);
 
     RDB_MAKE_ME_SERIALIZABLE_1(state_timestamp_t, num);
@@ -5,6 +5,8 @@
 
 #include "containers/archive/boost_types.hpp"
 #include "containers/archive/stl_types.hpp"
+#include "containers/archive/string_stream.hpp"
+#include "utils.hpp"
 
 namespace unittest {
 
@@ -34,6 +36,58 @@ TEST(WriteMessageTest, Variant) {
     ASSERT_EQ(15u, s.size());
 }
 
+TEST(WriteMessageTest, LargeMessage) {
+    write_message_t wm;
+    std::string expected;
+    for (int i = 0; i < 100000; ++i) {
+        std::string chunk = strprintf("%d,", i);
+        wm.append(chunk.data(), chunk.size());
+        expected += chunk;
+    }
+    ASSERT_EQ(expected.size(), wm.size());
+
+    std::string s;
+    dump_to_string(&wm, &s);
+    ASSERT_EQ(expected, s);
+
+    // The buffers grow with the message.
+    ASSERT_LT(wm.unsafe_expose_buffers()->size(), 20u);
+}
+
+TEST(WriteMessageTest, Reserve) {
+    write_message_t wm;
+    wm.append("abc", 3);
+    std::string big(3 * write_buffer_t::MIN_DATA_SIZE, 'x');
+    wm.reserve(big.size());
+    wm.append(big.data(), big.size());
+
+    intrusive_list_t<write_buffer_t> *buffers = wm.unsafe_expose_buffers();
+    ASSERT_EQ(2u, buffers->size());
+    ASSERT_EQ(static_cast<int64_t>(big.size()), buffers->tail()->size);
 
+    std::string s;
+    dump_to_string(&wm, &s);
+    ASSERT_EQ("abc" + big, s);
+}
+
+TEST(ReadStreamTest, Contiguous) {
+    write_message_t wm;
+    serialize<cluster_version_t::LATEST_OVERALL>(&wm, std::string("Hello"));
+    serialize<cluster_version_t::LATEST_OVERALL>(&wm, static_cast<uint64_t>(42));
+    std::string s;
+    dump_to_string(&wm, &s);
+
+    string_read_stream_t stream(std::move(s), 0);
+    std::string str;
+    ASSERT_EQ(archive_result_t::SUCCESS,
+              deserialize<cluster_version_t::LATEST_OVERALL>(&stream, &str));
+    ASSERT_EQ("Hello", str);
+    uint64_t value;
+    ASSERT_EQ(archive_result_t::SUCCESS,
+              deserialize<cluster_version_t::LATEST_OVERALL>(&stream, &value));
+    ASSERT_EQ(42u, value);
+    char c;
+    ASSERT_EQ(0, force_read(&stream, &c, 1));
+}
 
 }  // namespace unittest
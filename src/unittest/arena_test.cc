@@ -0,0 +1,53 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <stdint.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+
+#include "unittest/gtest.hpp"
+
+#include "containers/arena.hpp"
+
+namespace unittest {
+
+TEST(ArenaTest, Alignment) {
+    inline_arena_t<64> arena;
+    for (size_t i = 0; i < 1000; ++i) {
+        char *c = static_cast<char *>(arena.allocate(1, 1));
+        *c = 'x';
+        double *d = static_cast<double *>(arena.allocate(sizeof(double), alignof(double)));
+        EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(d) % alignof(double));
+        *d = i;
+    }
+}
+
+TEST(ArenaTest, LargeAllocations) {
+    arena_t arena;
+    char *small = static_cast<char *>(arena.allocate(16, 1));
+    char *large = static_cast<char *>(arena.allocate(1024 * 1024, 1));
+    memset(large, 'x', 1024 * 1024);
+    // The large allocation got a chunk of its own, so the next small one still comes
+    // from the first chunk.
+    char *small2 = static_cast<char *>(arena.allocate(16, 1));
+    EXPECT_EQ(small + 16, small2);
+}
+
+TEST(ArenaTest, Map) {
+    typedef std::map<int, std::string, std::less<int>,
+                     arena_allocator_t<std::pair<const int, std::string> > > map_t;
+    inline_arena_t<256> arena;
+    map_t map((std::less<int>()), map_t::allocator_type(&arena));
+    for (int i = 0; i < 1000; ++i) {
+        map[i] = std::to_string(i);
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        map.erase(i);
+    }
+    ASSERT_EQ(500u, map.size());
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        EXPECT_EQ(std::to_string(it->first), it->second);
+    }
+}
+
+}  // namespace unittest
@@ -0,0 +1,51 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <vector>
+
+#include "buffer_cache/block_slab.hpp"
+#include "config/args.hpp"
+#include "serializer/types.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(BlockSlabTest, AllocateAndFree) {
+    block_slab_allocator_t allocator(2 * MEGABYTE);
+
+    std::vector<char *> bufs;
+    for (int i = 0; i < 1000; ++i) {
+        char *buf = static_cast<char *>(allocator.allocate(4000 + (i % 3) * 4096));
+        ASSERT_TRUE(buf != NULL);
+        ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(buf) % DEVICE_BLOCK_SIZE);
+        memset(buf, i % 256, 4000);
+        bufs.push_back(buf);
+    }
+    for (size_t i = 0; i < bufs.size(); ++i) {
+        ASSERT_EQ(static_cast<char>(i % 256), bufs[i][3999]);
+    }
+
+    // A freed buffer gets reused.
+    char *freed = bufs.back();
+    bufs.pop_back();
+    ASSERT_TRUE(allocator.deallocate(freed));
+    char *buf = static_cast<char *>(allocator.allocate(4000 + (999 % 3) * 4096));
+    ASSERT_EQ(freed, buf);
+    bufs.push_back(buf);
+
+    for (size_t i = 0; i < bufs.size(); ++i) {
+        ASSERT_TRUE(allocator.deallocate(bufs[i]));
+    }
+    // We keep one spare slab per buffer size.
+    ASSERT_EQ(3u * 2 * MEGABYTE, allocator.slab_bytes());
+}
+
+TEST(BlockSlabTest, ForeignPointers) {
+    block_slab_allocator_t allocator(2 * MEGABYTE);
+    ASSERT_TRUE(allocator.allocate(MEGABYTE) == NULL);
+
+    int local;
+    ASSERT_FALSE(allocator.deallocate(&local));
+}
+
+}  // namespace unittest
@@ -0,0 +1,45 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string>
+
+#include "containers/bloom_filter.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(BloomFilter, NoFalseNegatives) {
+    const size_t num_keys = 10000;
+    bloom_filter_t filter(num_keys);
+    for (size_t i = 0; i < num_keys; ++i) {
+        std::string key = "key" + std::to_string(i);
+        filter.add(key.data(), key.size());
+    }
+    // Some keys look like they were already there.
+    EXPECT_GT(filter.count(), num_keys * 98 / 100);
+    const size_t count = filter.count();
+    for (size_t i = 0; i < num_keys; ++i) {
+        std::string key = "key" + std::to_string(i);
+        EXPECT_TRUE(filter.may_contain(key.data(), key.size()));
+        EXPECT_FALSE(filter.add(key.data(), key.size()));
+    }
+    EXPECT_EQ(count, filter.count());
+}
+
+TEST(BloomFilter, FalsePositiveRate) {
+    const size_t num_keys = 10000;
+    bloom_filter_t filter(num_keys);
+    for (size_t i = 0; i < num_keys; ++i) {
+        std::string key = "present" + std::to_string(i);
+        filter.add(key.data(), key.size());
+    }
+    size_t false_positives = 0;
+    for (size_t i = 0; i < num_keys; ++i) {
+        std::string key = "absent" + std::to_string(i);
+        if (filter.may_contain(key.data(), key.size())) {
+            ++false_positives;
+        }
+    }
+    // About 1% is expected.
+    EXPECT_LT(false_positives, num_keys / 50);
+}
+
+}  // namespace unittest
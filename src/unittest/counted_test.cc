@@ -0,0 +1,68 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "containers/counted.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+class biased_test_object_t : public biased_countable_t<biased_test_object_t> {
+public:
+    explicit biased_test_object_t(bool *destroyed) : destroyed_(destroyed) { }
+    ~biased_test_object_t() {
+        *destroyed_ = true;
+    }
+private:
+    bool *destroyed_;
+};
+
+// Releases on the owner thread that are sent there from other threads are
+// delivered asynchronously.
+void wait_until_destroyed(const bool *destroyed) {
+    for (int i = 0; i < 1000 && !*destroyed; ++i) {
+        nap(1);
+    }
+}
+
+TPTEST(Counted, BiasedSingleThread) {
+    bool destroyed = false;
+    {
+        counted_t<biased_test_object_t> a(new biased_test_object_t(&destroyed));
+        counted_t<biased_test_object_t> b = a;
+        EXPECT_EQ(2, counted_use_count(a.get()));
+        b.reset();
+        EXPECT_TRUE(a.unique());
+    }
+    EXPECT_TRUE(destroyed);
+}
+
+TPTEST(Counted, BiasedReleasedOnOtherThread, 2) {
+    // The only reference is created on the owner and released elsewhere.
+    bool destroyed = false;
+    {
+        counted_t<biased_test_object_t> a(new biased_test_object_t(&destroyed));
+        on_thread_t switcher(threadnum_t(1));
+        a.reset();
+    }
+    wait_until_destroyed(&destroyed);
+    EXPECT_TRUE(destroyed);
+
+    // References are copied on both threads and released on the other one.
+    destroyed = false;
+    counted_t<biased_test_object_t> a(new biased_test_object_t(&destroyed));
+    counted_t<biased_test_object_t> owner_copy = a;
+    counted_t<biased_test_object_t> other_copy;
+    {
+        on_thread_t switcher(threadnum_t(1));
+        other_copy = a;
+        a.reset();
+        owner_copy.reset();
+    }
+    EXPECT_FALSE(destroyed);
+    other_copy.reset();
+    wait_until_destroyed(&destroyed);
+    EXPECT_TRUE(destroyed);
+}
+
+}  // namespace unittest
@@ -1,9 +1,11 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 
+#include "containers/archive/buffer_stream.hpp"
 #include "containers/archive/string_stream.hpp"
 #include "rdb_protocol/datum.hpp"
 #include "rdb_protocol/datum_string.hpp"
 #include "rdb_protocol/env.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
 #include "unittest/gtest.hpp"
 
 
@@ -44,6 +46,27 @@ void test_datum_serialization(const ql::datum_t datum) {
         ASSERT_EQ(archive_result_t::SUCCESS, res);
         ASSERT_EQ(deserialized_datum, redeserialized_datum);
     }
+
+    // Deserialize from a shared buffer, which arrays and objects point into instead
+    // of copying from it.
+    {
+        string_stream_t write_stream;
+        write_message_t wm;
+        serialize<cluster_version_t::LATEST_OVERALL>(&wm, datum);
+        int write_res = send_write_message(&write_stream, &wm);
+        ASSERT_EQ(0, write_res);
+
+        counted_t<shared_buf_t> buf = shared_buf_t::create(write_stream.str().size());
+        memcpy(buf->data(), write_stream.str().data(), write_stream.str().size());
+        shared_buf_read_stream_t read_stream(std::move(buf));
+        ql::datum_t shared_datum;
+        archive_result_t res
+            = deserialize<cluster_version_t::LATEST_OVERALL>(&read_stream,
+                                                             &shared_datum);
+        ASSERT_EQ(archive_result_t::SUCCESS, res);
+        ASSERT_EQ(datum, shared_datum);
+        ASSERT_EQ(static_cast<int64_t>(write_stream.str().size()), read_stream.tell());
+    }
 }
 
 
@@ -205,4 +228,218 @@ TEST(DatumTest, OffsetScaling) {
     }
 }
 
+void test_write_json(const ql::datum_t &datum) {
+    std::string direct;
+    datum.write_json(&direct);
+    ASSERT_EQ(datum.as_json().PrintUnformatted(), direct);
+}
+
+TEST(DatumTest, WriteJson) {
+    test_write_json(ql::datum_t::null());
+    test_write_json(ql::datum_t::boolean(true));
+    test_write_json(ql::datum_t::boolean(false));
+    test_write_json(ql::datum_t(0.0));
+    test_write_json(ql::datum_t(-0.0));
+    test_write_json(ql::datum_t(1.1));
+    test_write_json(ql::datum_t(-6.02214179e23));
+    test_write_json(ql::datum_t(std::numeric_limits<double>::denorm_min()));
+    test_write_json(ql::datum_t(42.0));
+    test_write_json(ql::datum_t(-123456789012345.0));
+    test_write_json(ql::datum_t(9007199254740991.0));
+    test_write_json(ql::datum_t(9007199254740992.0));
+    test_write_json(ql::datum_t("quote\" backslash\\ tab\t bell\x07 \xc3\xa9"));
+    test_write_json(ql::datum_t::binary(datum_string_t(std::string("\x00\x01\xff", 3))));
+
+    ql::datum_object_builder_t builder;
+    builder.overwrite("b", ql::datum_t(1.0));
+    builder.overwrite("a\n", ql::datum_t("x"));
+    builder.overwrite("c", ql::datum_t(
+        std::vector<ql::datum_t>{ql::datum_t::null(), ql::datum_t(2.5)},
+        ql::configured_limits_t::unlimited));
+    test_write_json(std::move(builder).to_datum());
+    test_write_json(ql::datum_t::empty_array());
+    test_write_json(ql::datum_t::empty_object());
+}
+
+ql::datum_t make_array(std::vector<ql::datum_t> &&elements) {
+    return ql::datum_t(std::move(elements), ql::configured_limits_t::unlimited);
+}
+
+TEST(DatumTest, SortKeys) {
+    std::vector<ql::datum_t> data;
+    data.push_back(ql::datum_t::minval());
+    data.push_back(ql::datum_t::maxval());
+    data.push_back(ql::datum_t::null());
+    data.push_back(ql::datum_t::boolean(false));
+    data.push_back(ql::datum_t::boolean(true));
+    data.push_back(ql::datum_t(-1e300));
+    data.push_back(ql::datum_t(-1.5));
+    data.push_back(ql::datum_t(-0.0));
+    data.push_back(ql::datum_t(0.0));
+    data.push_back(ql::datum_t(std::numeric_limits<double>::denorm_min()));
+    data.push_back(ql::datum_t(2.0));
+    data.push_back(ql::datum_t(1e300));
+    data.push_back(ql::datum_t(""));
+    data.push_back(ql::datum_t("a"));
+    data.push_back(ql::datum_t(datum_string_t(std::string("a\0", 2))));
+    data.push_back(ql::datum_t(datum_string_t(std::string("a\0b", 3))));
+    data.push_back(ql::datum_t("a\1"));
+    data.push_back(ql::datum_t("ab"));
+    data.push_back(ql::datum_t("\xff"));
+    data.push_back(ql::datum_t::binary(datum_string_t(std::string("\0\1", 2))));
+    data.push_back(ql::datum_t::binary(datum_string_t(std::string("\1", 1))));
+    data.push_back(ql::pseudo::make_time(0, "+00:00"));
+    data.push_back(ql::pseudo::make_time(0, "+01:00"));
+    data.push_back(ql::pseudo::make_time(-86400, "+00:00"));
+    data.push_back(ql::datum_t::empty_array());
+    data.push_back(make_array({ql::datum_t(1.0)}));
+    data.push_back(make_array({ql::datum_t(1.0), ql::datum_t::null()}));
+    data.push_back(make_array({ql::datum_t("a")}));
+    data.push_back(make_array({ql::datum_t::empty_array()}));
+    data.push_back(ql::datum_t::empty_object());
+    {
+        ql::datum_object_builder_t builder;
+        builder.overwrite("", ql::datum_t(1.0));
+        data.push_back(std::move(builder).to_datum());
+    }
+    {
+        ql::datum_object_builder_t builder;
+        builder.overwrite("a", ql::datum_t(1.0));
+        data.push_back(std::move(builder).to_datum());
+    }
+    {
+        ql::datum_object_builder_t builder;
+        builder.overwrite("a", ql::datum_t(1.0));
+        builder.overwrite("b", ql::datum_t::null());
+        data.push_back(std::move(builder).to_datum());
+    }
+    {
+        ql::datum_object_builder_t builder;
+        builder.overwrite("a", ql::datum_t("x"));
+        data.push_back(std::move(builder).to_datum());
+    }
+
+    std::vector<std::string> keys;
+    for (const ql::datum_t &d : data) {
+        std::string key;
+        ASSERT_TRUE(d.append_sort_key(&key)) << d.print();
+        keys.push_back(key);
+    }
+    for (size_t i = 0; i < data.size(); ++i) {
+        for (size_t j = 0; j < data.size(); ++j) {
+            const int expected = data[i].modern_cmp(data[j]);
+            const int actual = keys[i].compare(keys[j]);
+            EXPECT_EQ(expected < 0, actual < 0)
+                << data[i].print() << " vs " << data[j].print();
+            EXPECT_EQ(expected == 0, actual == 0)
+                << data[i].print() << " vs " << data[j].print();
+        }
+    }
+}
+
+TEST(DatumTest, HashMatchesEquality) {
+    std::vector<std::pair<ql::datum_t, ql::datum_t> > equal_pairs;
+    equal_pairs.push_back(std::make_pair(ql::datum_t(0.0), ql::datum_t(-0.0)));
+    equal_pairs.push_back(std::make_pair(ql::pseudo::make_time(0, "+00:00"),
+                                         ql::pseudo::make_time(0, "+01:00")));
+    equal_pairs.push_back(std::make_pair(
+        make_array({ql::datum_t(-0.0), ql::datum_t("a")}),
+        make_array({ql::datum_t(0.0), ql::datum_t("a")})));
+    equal_pairs.push_back(std::make_pair(
+        ql::datum_t::binary(datum_string_t(std::string("\0\1", 2))),
+        ql::datum_t::binary(datum_string_t(std::string("\0\1", 2)))));
+    for (const auto &pair : equal_pairs) {
+        ASSERT_TRUE(pair.first == pair.second) << pair.first.print();
+        EXPECT_EQ(pair.first.hash(), pair.second.hash()) << pair.first.print();
+    }
+}
+
+void test_parse_json(const std::string &json) {
+    scoped_cJSON_t cjson(cJSON_Parse(json.c_str()));
+    ASSERT_TRUE(cjson.get() != NULL);
+    ql::datum_t expected = ql::to_datum(cjson.get(), ql::configured_limits_t::unlimited,
+                                        reql_version_t::LATEST);
+    ql::datum_t direct = ql::parse_json_datum(json.data(), json.size(),
+                                              ql::configured_limits_t::unlimited,
+                                              reql_version_t::LATEST);
+    ASSERT_TRUE(direct.has());
+    ASSERT_EQ(expected, direct);
+}
+
+TEST(DatumTest, ParseJson) {
+    test_parse_json("null");
+    test_parse_json(" true ");
+    test_parse_json("false");
+    test_parse_json("0");
+    test_parse_json("-0");
+    test_parse_json("123456789012345678901234567890");
+    test_parse_json("-1.5e-300");
+    test_parse_json("\"esc\\\"\\/\\n\\u00e9\\ud83d\\ude00\"");
+    test_parse_json("[1, [2, {}], []]");
+    test_parse_json("{\"b\": 1, \"a\": {\"c\": \"d\"}}");
+    test_parse_json("{\"$reql_type$\": \"BINARY\", \"data\": \"AAH/\"}");
+
+    const char *bad[] = { "", "nul", "[1,]", "[1 2]", "{\"a\" 1}", "{1: 2}",
+                          "\"unterminated", "\"\\u0000\"", "\"\\ud83d\"", "0x10",
+                          "1e", "-", "[1] x" };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        ASSERT_FALSE(ql::parse_json_datum(bad[i], strlen(bad[i]),
+                                          ql::configured_limits_t::unlimited,
+                                          reql_version_t::LATEST).has()) << bad[i];
+    }
+}
+
+TEST(DatumTest, ParseJsonNestingLimit) {
+    for (size_t depth = 90; depth <= 110; depth += 20) {
+        const std::string arrays = std::string(depth, '[') + std::string(depth, ']');
+        std::string objects;
+        for (size_t i = 0; i < depth; ++i) {
+            objects += "{\"a\":";
+        }
+        objects += "1" + std::string(depth, '}');
+        for (const std::string &json : { arrays, objects }) {
+            const bool ok = depth <= 100;
+            EXPECT_EQ(ok, ql::parse_json_datum(json.data(), json.size(),
+                                               ql::configured_limits_t::unlimited,
+                                               reql_version_t::LATEST).has());
+            scoped_cJSON_t cjson(cJSON_Parse(json.c_str()));
+            ASSERT_TRUE(cjson.get() != NULL);
+            if (ok) {
+                test_parse_json(json);
+            } else {
+                EXPECT_THROW(ql::to_datum(cjson.get(),
+                                          ql::configured_limits_t::unlimited,
+                                          reql_version_t::LATEST),
+                             ql::base_exc_t);
+            }
+        }
+    }
+}
+
+TEST(DatumTest, InlineStrings) {
+    // Strings right around the inline size limit, including a NUL character.
+    std::vector<datum_string_t> strs;
+    for (size_t len = 0; len < 2 * datum_string_t::MAX_INLINE_DATUM_STRING_SIZE; ++len) {
+        std::string str(len, 'a');
+        if (len > 0) {
+            str[len / 2] = '\0';
+        }
+        strs.push_back(datum_string_t(str));
+        ASSERT_EQ(len, strs.back().size());
+        ASSERT_EQ(str, strs.back().to_std());
+        test_datum_serialization(ql::datum_t(strs.back()));
+    }
+    for (size_t i = 0; i < strs.size(); ++i) {
+        datum_string_t copy = strs[i];
+        ASSERT_EQ(strs[i], copy);
+        datum_string_t moved(std::move(copy));
+        ASSERT_EQ(strs[i], moved);
+        for (size_t j = 0; j < strs.size(); ++j) {
+            ASSERT_EQ(i < j, strs[i] < strs[j]);
+        }
+        const datum_string_t both = concat(strs[i], strs[i]);
+        ASSERT_EQ(strs[i].to_std() + strs[i].to_std(), both.to_std());
+    }
+}
+
 }  // namespace unittest
@@ -1,4 +1,5 @@
 #include "serializer/log/data_block_manager.hpp"
+#include "serializer/log/read_ahead_detector.hpp"
 #include "unittest/gtest.hpp"
 
 namespace unittest {
@@ -48,6 +49,29 @@ TEST(DBMTest, ReadAheadInterval) {
     ASSERT_EQ(100, end_offset);
 }
 
+TEST(DBMTest, ReadAheadDetector) {
+    read_ahead_detector_t detector(1000, 100);
 
+    // Reads that are all over the place don't read ahead.
+    for (int64_t i = 0; i < 20; ++i) {
+        ASSERT_EQ(0, detector.record_read(((i * 7) % 20) * 1000 + 10));
+    }
+
+    // Reads that stay in one extent read ahead more and more.
+    ASSERT_EQ(0, detector.record_read(50000));
+    ASSERT_EQ(100, detector.record_read(50100));
+    ASSERT_EQ(200, detector.record_read(50200));
+    ASSERT_EQ(400, detector.record_read(50300));
+    ASSERT_EQ(800, detector.record_read(50400));
+    ASSERT_EQ(1000, detector.record_read(50500));
+    ASSERT_EQ(1000, detector.record_read(50600));
+
+    // Moving on to the next extent doesn't start over.
+    ASSERT_EQ(1000, detector.record_read(51000));
+
+    // A random read in between doesn't disturb the traversal.
+    ASSERT_EQ(0, detector.record_read(90000));
+    ASSERT_EQ(1000, detector.record_read(51100));
+}
 
 }  // namespace unittest
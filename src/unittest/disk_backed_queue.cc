@@ -1,4 +1,5 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <algorithm>
 #include <queue>
 
 #include "arch/io/disk.hpp"
@@ -74,6 +75,42 @@ TEST(DiskBackedQueue, BigVals) {
     unittest::run_in_thread_pool(&run_big_values_test, 2);
 }
 
+// Enough items for the queue to write some of them to disk, pushed and popped in
+// uneven bursts so that items come from both the in-memory ends and the disk.
+void run_interleaved_test() {
+    static const int NUM_ELTS = 100000;
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+
+    const serializer_filepath_t serializer_path = dbq_serializer_path();
+
+    disk_backed_queue_t<int> queue(&io_backender, serializer_path, &get_global_perfmon_collection());
+    std::queue<int> ref_queue;
+
+    int pushed = 0;
+    while (pushed < NUM_ELTS || !ref_queue.empty()) {
+        int to_push = std::min(randint(30000), NUM_ELTS - pushed);
+        for (int i = 0; i < to_push; ++i, ++pushed) {
+            queue.push(pushed);
+            ref_queue.push(pushed);
+        }
+        int to_pop = pushed == NUM_ELTS
+            ? static_cast<int>(ref_queue.size())
+            : randint(static_cast<int>(ref_queue.size()) + 1);
+        for (int i = 0; i < to_pop; ++i) {
+            ASSERT_EQ(static_cast<int64_t>(ref_queue.size()), queue.size());
+            int x;
+            queue.pop(&x);
+            ASSERT_EQ(ref_queue.front(), x);
+            ref_queue.pop();
+        }
+    }
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(DiskBackedQueue, Interleaved) {
+    unittest::run_in_thread_pool(&run_interleaved_test, 2);
+}
+
 static void randomly_delay(int, signal_t *) {
     nap(randint(100));
 }
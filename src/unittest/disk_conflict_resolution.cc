@@ -159,7 +159,8 @@ struct write_test_t {
         offset(o),
         data(d.begin(), d.end()),
         action(driver->make_action()) {
-        action->make_write(IRRELEVANT_DEFAULT_FD, data.data(), d.size(), o, false);
+        action->make_write(IRRELEVANT_DEFAULT_FD, data.data(), d.size(), o,
+                           false, false);
         driver->submit(action);
     }
 
@@ -0,0 +1,77 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string.h>
+
+#include <vector>
+
+#include "arch/io/disk.hpp"
+#include "arch/types.hpp"
+#include "concurrency/cond_var.hpp"
+#include "serializer/io_buffer_pool.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+class counting_callback_t : public linux_iocallback_t {
+public:
+    explicit counting_callback_t(int _remaining) : remaining(_remaining) { }
+    void on_io_complete() {
+        if (--remaining == 0) {
+            done.pulse();
+        }
+    }
+    int remaining;
+    cond_t done;
+};
+
+/* `AdjacentRequests` sends many reads and writes of adjacent blocks at once, which
+the disk backend merges, and checks that every block still ends up in the right
+place. */
+TPTEST(DiskIo, AdjacentRequests) {
+    temp_file_t temp_file;
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    scoped_ptr_t<file_t> file;
+    file_open_result_t res = open_file(temp_file.name().permanent_path().c_str(),
+                                       linux_file_t::mode_read | linux_file_t::mode_write
+                                       | linux_file_t::mode_create,
+                                       &io_backender, &file);
+    ASSERT_NE(file_open_result_t::ERROR, res.outcome);
+
+    const int num_blocks = 256;
+    file->set_file_size_at_least(num_blocks * DEVICE_BLOCK_SIZE);
+    file_account_t account(file.get(), 1);
+
+    std::vector<io_buffer_t> blocks;
+    for (int i = 0; i < num_blocks; ++i) {
+        blocks.push_back(io_buffer_t(DEVICE_BLOCK_SIZE));
+        memset(blocks.back().get(), i, DEVICE_BLOCK_SIZE);
+    }
+    {
+        counting_callback_t callback(num_blocks);
+        for (int i = 0; i < num_blocks; ++i) {
+            file->write_async(i * DEVICE_BLOCK_SIZE, DEVICE_BLOCK_SIZE, blocks[i].get(),
+                              &account, &callback, file_t::NO_DATASYNCS);
+        }
+        callback.done.wait();
+    }
+
+    for (int i = 0; i < num_blocks; ++i) {
+        memset(blocks[i].get(), 0, DEVICE_BLOCK_SIZE);
+    }
+    {
+        counting_callback_t callback(num_blocks);
+        for (int i = num_blocks - 1; i >= 0; --i) {
+            file->read_async(i * DEVICE_BLOCK_SIZE, DEVICE_BLOCK_SIZE, blocks[i].get(),
+                             &account, &callback);
+        }
+        callback.done.wait();
+    }
+
+    for (int i = 0; i < num_blocks; ++i) {
+        for (int64_t j = 0; j < DEVICE_BLOCK_SIZE; ++j) {
+            ASSERT_EQ(static_cast<char>(i), blocks[i].get()[j]);
+        }
+    }
+}
+
+}  // namespace unittest
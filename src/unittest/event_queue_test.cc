@@ -0,0 +1,31 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/event_queue.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/pmap.hpp"
+#include "threading.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+void bounce_between_threads() {
+    const int num_threads = get_num_threads();
+    pmap(num_threads, [&](int i) {
+        for (int j = 0; j < 1000; ++j) {
+            on_thread_t thread_switcher(threadnum_t((i + j) % num_threads));
+        }
+    });
+    // Timers have to fire while the threads busy poll, too.
+    nap(5);
+}
+
+/* `BusyPoll` makes sure that messages between threads and timers still get delivered
+when the event loops spin instead of sleeping. */
+TEST(EventQueue, BusyPoll) {
+    set_event_loop_busy_poll(100);
+    run_in_thread_pool(bounce_between_threads, 4);
+    set_event_loop_busy_poll(0);
+}
+
+}  // namespace unittest
@@ -0,0 +1,90 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include <map>
+
+#include "unittest/gtest.hpp"
+
+#include "containers/flat_int_map.hpp"
+#include "containers/scoped.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+TEST(FlatIntMapTest, Simple) {
+    flat_int_map_t<uint64_t, int> map;
+    EXPECT_TRUE(map.empty());
+    EXPECT_TRUE(map.find(1) == NULL);
+    EXPECT_EQ(0u, map.erase(1));
+
+    EXPECT_TRUE(map.insert(1, 10));
+    EXPECT_TRUE(map.insert(2, 20));
+    EXPECT_FALSE(map.insert(1, 30));
+    EXPECT_EQ(2u, map.size());
+    ASSERT_TRUE(map.find(1) != NULL);
+    EXPECT_EQ(10, *map.find(1));
+    EXPECT_EQ(20, *map.find(2));
+
+    EXPECT_EQ(1u, map.erase(1));
+    EXPECT_EQ(0u, map.erase(1));
+    EXPECT_TRUE(map.find(1) == NULL);
+    EXPECT_EQ(20, *map.find(2));
+    EXPECT_EQ(1u, map.size());
+}
+
+/* Compares against `std::map` under random insertions and deletions, which
+exercises growing and the backward shifting on deletion. */
+TEST(FlatIntMapTest, Random) {
+    flat_int_map_t<uint64_t, uint64_t> map;
+    std::map<uint64_t, uint64_t> reference;
+    rng_t rng;
+    for (int i = 0; i < 20000; ++i) {
+        // A small key space makes collisions and repeated keys likely.
+        const uint64_t key = rng.randint(2000);
+        if (rng.randint(3) == 0) {
+            EXPECT_EQ(reference.erase(key), map.erase(key));
+        } else {
+            EXPECT_EQ(reference.insert(std::make_pair(key, i)).second,
+                      map.insert(key, i));
+        }
+        ASSERT_EQ(reference.size(), map.size());
+    }
+    for (uint64_t key = 0; key < 2000; ++key) {
+        auto it = reference.find(key);
+        uint64_t *value = map.find(key);
+        if (it == reference.end()) {
+            EXPECT_TRUE(value == NULL);
+        } else {
+            ASSERT_TRUE(value != NULL);
+            EXPECT_EQ(it->second, *value);
+        }
+    }
+    size_t visited = 0;
+    map.visit([&](uint64_t key, uint64_t value) {
+        EXPECT_EQ(reference[key], value);
+        ++visited;
+    });
+    EXPECT_EQ(reference.size(), visited);
+}
+
+TEST(FlatIntMapTest, MoveOnlyValues) {
+    flat_int_map_t<int64_t, scoped_ptr_t<int> > map;
+    // Enough entries to grow the table a few times.
+    for (int64_t key = 0; key < 100; ++key) {
+        EXPECT_TRUE(map.insert(key, make_scoped<int>(static_cast<int>(key) * 2)));
+    }
+    EXPECT_FALSE(map.insert(5, make_scoped<int>(0)));
+    EXPECT_EQ(10, **map.find(5));
+    for (int64_t key = 0; key < 100; key += 2) {
+        EXPECT_EQ(1u, map.erase(key));
+    }
+
+    size_t iterated = 0;
+    for (auto const &pair : map) {
+        EXPECT_EQ(1, pair.first % 2);
+        EXPECT_EQ(pair.first * 2, *pair.second);
+        ++iterated;
+    }
+    EXPECT_EQ(50u, iterated);
+    EXPECT_EQ(map.size(), iterated);
+}
+
+}  // namespace unittest
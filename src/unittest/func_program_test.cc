@@ -0,0 +1,85 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/func_program.hpp"
+#include "rdb_protocol/minidriver.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+static bool run_program(ql::r::reql_t &&body,
+                        const std::vector<ql::datum_t> &args,
+                        ql::datum_t *out) {
+    std::vector<ql::sym_t> arg_names;
+    for (size_t i = 0; i < args.size(); ++i) {
+        arg_names.push_back(ql::sym_t(i + 1));
+    }
+    scoped_ptr_t<ql::func_program_t> program
+        = ql::func_program_t::compile(body.get(), arg_names);
+    EXPECT_TRUE(program.has());
+    return program.has()
+        && program->run(reql_version_t::LATEST, args, out);
+}
+
+static ql::datum_t make_row(double age, const char *name) {
+    ql::datum_object_builder_t builder;
+    UNUSED bool dup = builder.add("age", ql::datum_t(age));
+    dup = builder.add("name", ql::datum_t(name));
+    return std::move(builder).to_datum();
+}
+
+TEST(FuncProgram, Predicates) {
+    using namespace ql;  // NOLINT(build/namespaces)
+    datum_t result;
+
+    ASSERT_TRUE(run_program(r::var(sym_t(1))["age"] > r::expr(21.0),
+                            {make_row(30, "a")}, &result));
+    EXPECT_EQ(datum_t::boolean(true), result);
+
+    ASSERT_TRUE(run_program(r::var(sym_t(1))["name"] == r::expr(std::string("b")),
+                            {make_row(30, "a")}, &result));
+    EXPECT_EQ(datum_t::boolean(false), result);
+
+    ASSERT_TRUE(run_program(
+        !(r::var(sym_t(1))["age"] >= r::expr(10.0) && r::var(sym_t(2)) < r::expr(5.0)),
+        {make_row(30, "a"), datum_t(1.0)}, &result));
+    EXPECT_EQ(datum_t::boolean(false), result);
+
+    // `and` returns its first falsy argument.
+    ASSERT_TRUE(run_program(r::var(sym_t(1)) && r::expr(1.0),
+                            {datum_t::null()}, &result));
+    EXPECT_EQ(datum_t::null(), result);
+}
+
+TEST(FuncProgram, Objects) {
+    using namespace ql;  // NOLINT(build/namespaces)
+    datum_t result;
+
+    ASSERT_TRUE(run_program(
+        r::object(r::optarg("n", r::var(sym_t(1))["age"] + r::expr(1.0)),
+                  r::optarg("name", r::var(sym_t(1))["name"])),
+        {make_row(30, "a")}, &result));
+    EXPECT_EQ(make_row(31, "a").get_field("age"), result.get_field("n"));
+    EXPECT_EQ(datum_t("a"), result.get_field("name"));
+}
+
+TEST(FuncProgram, FallsBack) {
+    using namespace ql;  // NOLINT(build/namespaces)
+    datum_t result;
+
+    // Missing fields, type errors and division by zero are left to the term tree.
+    EXPECT_FALSE(run_program(r::var(sym_t(1))["missing"] == r::expr(1.0),
+                             {make_row(30, "a")}, &result));
+    EXPECT_FALSE(run_program(r::var(sym_t(1))["name"] + r::expr(1.0),
+                             {make_row(30, "a")}, &result));
+    EXPECT_FALSE(run_program(r::var(sym_t(1)) / r::expr(0.0),
+                             {datum_t(1.0)}, &result));
+
+    // Captured variables and unsupported terms aren't compiled at all.
+    std::vector<sym_t> arg_names(1, sym_t(1));
+    EXPECT_FALSE(func_program_t::compile(
+        (r::var(sym_t(2)) == r::expr(1.0)).get(), arg_names).has());
+    EXPECT_FALSE(func_program_t::compile(
+        r::var(sym_t(1)).count().get(), arg_names).has());
+}
+
+}  // namespace unittest
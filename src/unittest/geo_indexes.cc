@@ -154,7 +154,8 @@ void insert_data(namespace_interface_t *nsi,
 
 void prepare_namespace(namespace_interface_t *nsi,
                        order_source_t *osource,
-                       const std::vector<datum_t> &data) {
+                       const std::vector<datum_t> &data,
+                       sindex_geo_bool_t geo = sindex_geo_bool_t::GEO) {
     // Create an index
     std::string index_id = "geo";
 
@@ -163,7 +164,7 @@ void prepare_namespace(namespace_interface_t *nsi,
     ql::map_wire_func_t m(mapping, make_vector(arg), get_backtrace(mapping));
 
     write_t write(sindex_create_t(index_id, m, sindex_multi_bool_t::SINGLE,
-                                  sindex_geo_bool_t::GEO),
+                                  geo, sindex_values_bool_t::DOCUMENT),
                   profile_bool_t::PROFILE, ql::configured_limits_t());
     write_response_t response;
 
@@ -419,6 +420,55 @@ void run_get_intersecting_test(namespace_interface_t *nsi, order_source_t *osour
     }
 }
 
+std::vector<datum_t> only_points(const std::vector<datum_t> &data) {
+    std::vector<datum_t> result;
+    for (const datum_t &d : data) {
+        if (d.get_field("type").as_str() == "Point") {
+            result.push_back(d);
+        }
+    }
+    return result;
+}
+
+void run_points_only_test(namespace_interface_t *nsi, order_source_t *osource) {
+    // To reproduce a known failure: initialize the rng seed manually.
+    const int rng_seed = randint(INT_MAX);
+    debugf("Using RNG seed %i\n", rng_seed);
+    rng_t rng(rng_seed);
+
+    // The index skips the lines and polygons, so queries must only find the points.
+    const size_t num_docs = 1500;
+    std::vector<datum_t> data = generate_data(num_docs, &rng);
+    prepare_namespace(nsi, osource, data, sindex_geo_bool_t::GEO_POINTS);
+    std::vector<datum_t> points = only_points(data);
+
+    try {
+        const int num_polygon_runs = 20;
+        for (int i = 0; i < num_polygon_runs; ++i) {
+            datum_t query_geometry = generate_polygon(&rng);
+            std::vector<datum_t> intersecting_res =
+                perform_get_intersecting(query_geometry, nsi, osource);
+            std::vector<datum_t> reference_res =
+                emulate_get_intersecting(query_geometry, points);
+            auto less = [](const datum_t &a, const datum_t &b) {
+                return a.cmp(reql_version_t::LATEST, b) < 0;
+            };
+            std::sort(intersecting_res.begin(), intersecting_res.end(), less);
+            std::sort(reference_res.begin(), reference_res.end(), less);
+            ASSERT_EQ(reference_res, intersecting_res);
+        }
+        const int num_nearest_runs = 10;
+        for (int i = 0; i < num_nearest_runs; ++i) {
+            double lat = rng.randdouble() * 180.0 - 90.0;
+            double lon = rng.randdouble() * 360.0 - 180.0;
+            test_get_nearest(lon_lat_point_t(lon, lat), points, nsi, osource);
+        }
+    } catch (const geo_exception_t &e) {
+        debugf("Caught a geo exception: %s\n", e.what());
+        FAIL();
+    }
+}
+
 // Test that `get_nearest` results agree with `distance`
 TPTEST(GeoIndexes, GetNearest) {
     run_with_namespace_interface(&run_get_nearest_test);
@@ -429,6 +479,11 @@ TPTEST(GeoIndexes, GetIntersecting) {
     run_with_namespace_interface(&run_get_intersecting_test);
 }
 
+// Test that points-only indexes find exactly the points
+TPTEST(GeoIndexes, PointsOnly) {
+    run_with_namespace_interface(&run_points_only_test);
+}
+
 } /* namespace unittest */
 
 
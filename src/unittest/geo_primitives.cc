@@ -106,5 +106,84 @@ TPTEST(GeoPrimitives, InExRadiusTest) {
     }
 }
 
+// Verifies that the bounding rectangle check in `geo_intersection_query_t` doesn't
+// change any results.
+TPTEST(GeoPrimitives, IntersectionQueryTest) {
+    const int rng_seed = randint(INT_MAX);
+    debugf("Using RNG seed %i\n", rng_seed);
+    rng_t rng(rng_seed);
+    const double r = 1000.0;
+    try {
+        for (int i = 0; i < 10; ++i) {
+            const lon_lat_point_t c(rng.randdouble() * 360.0 - 180.0,
+                                    rng.randdouble() * 160.0 - 80.0);
+            const datum_t polygon = construct_geo_polygon(
+                build_polygon_with_inradius_at_least(c, r, 8, WGS84_ELLIPSOID),
+                ql::configured_limits_t());
+            const datum_t line = construct_geo_line(
+                lon_lat_line_t{c, geodesic_point_at_dist(c, r, 0.0, WGS84_ELLIPSOID)},
+                ql::configured_limits_t());
+            const geo_intersection_query_t polygon_query(polygon);
+            const geo_intersection_query_t line_query(line);
+            for (int j = 0; j < 1000; ++j) {
+                const datum_t point = construct_geo_point(
+                    geodesic_point_at_dist(c, rng.randdouble() * 2.0 * r,
+                                           rng.randdouble() * 360.0 - 180.0,
+                                           WGS84_ELLIPSOID),
+                    ql::configured_limits_t());
+                ASSERT_EQ(geo_does_intersect(polygon, point),
+                          polygon_query.intersects(point));
+                ASSERT_EQ(geo_does_intersect(line, point),
+                          line_query.intersects(point));
+                const geo_intersection_query_t point_query(point);
+                ASSERT_EQ(geo_does_intersect(point, polygon),
+                          point_query.intersects(polygon));
+            }
+            ASSERT_TRUE(polygon_query.intersects(line));
+            ASSERT_TRUE(line_query.intersects(polygon));
+        }
+    } catch (const geo_exception_t &e) {
+        ADD_FAILURE() << "Caught a geo exception: " << e.what();
+    }
+}
+
+// Verifies that rejecting points based on the straight-line distance never rejects
+// points within the distance limit.
+TPTEST(GeoPrimitives, DistanceCalculatorTest) {
+    const int rng_seed = randint(INT_MAX);
+    debugf("Using RNG seed %i\n", rng_seed);
+    rng_t rng(rng_seed);
+    const ellipsoid_spec_t ellipsoids[] = {
+        UNIT_SPHERE, WGS84_ELLIPSOID, ellipsoid_spec_t(1.0, 0.4),
+        ellipsoid_spec_t(1.0, -0.5) };
+    try {
+        for (const ellipsoid_spec_t &e : ellipsoids) {
+            for (int i = 0; i < 10; ++i) {
+                const lon_lat_point_t c(rng.randdouble() * 360.0 - 180.0,
+                                        rng.randdouble() * 180.0 - 90.0);
+                const geodesic_distance_calculator_t calc(c, e);
+                const double max_dist = rng.randdouble() * e.equator_radius();
+                for (int j = 0; j < 1000; ++j) {
+                    const lon_lat_point_t p(rng.randdouble() * 360.0 - 180.0,
+                                            rng.randdouble() * 180.0 - 90.0);
+                    const double dist = geodesic_distance(c, p, e);
+                    ASSERT_EQ(dist, calc.geodesic_distance(p));
+                    boost::optional<double> within =
+                        calc.geodesic_distance_if_within(
+                            construct_geo_point(p, ql::configured_limits_t()),
+                            max_dist);
+                    if (dist <= max_dist) {
+                        ASSERT_TRUE(static_cast<bool>(within));
+                    } else {
+                        ASSERT_FALSE(static_cast<bool>(within));
+                    }
+                }
+            }
+        }
+    } catch (const geo_exception_t &e) {
+        ADD_FAILURE() << "Caught a geo exception: " << e.what();
+    }
+}
+
 }   /* namespace unittest */
 
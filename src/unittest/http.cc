@@ -212,4 +212,56 @@ TPTEST(Http, InterruptRoutingApp) {
     }
 }
 
+class recording_http_app_t : public http_app_t {
+public:
+    void handle(const http_req_t &req, http_res_t *res, signal_t *) {
+        request = req;
+        *res = http_res_t(http_status_code_t::OK, "text/plain", "hi");
+    }
+
+    http_req_t request;
+};
+
+/* `ParseRequest` sends a request whose head arrives in several pieces, and checks
+that the server puts it back together. */
+TPTEST(Http, ParseRequest) {
+    recording_http_app_t app;
+    ip_address_t loopback("127.0.0.1");
+    std::set<ip_address_t> ip_addresses;
+    ip_addresses.insert(loopback);
+    http_server_t server(ip_addresses, 0, &app);
+
+    cond_t non_interruptor;
+    tcp_conn_t conn(loopback, server.get_port(), &non_interruptor);
+    const char *pieces[] = {
+        "POST /a/b?x=1&y&x=2 HT",
+        "TP/1.1\r\nHost: local",
+        "host\r\nContent-Length:  4\r\n\r",
+        "\nbody" };
+    for (const char *piece : pieces) {
+        conn.write(piece, strlen(piece), &non_interruptor);
+        nap(10);
+    }
+
+    std::string response;
+    try {
+        for (;;) {
+            char buffer[256];
+            size_t size = conn.read_some(buffer, sizeof(buffer), &non_interruptor);
+            response.append(buffer, size);
+        }
+    } catch (const tcp_conn_read_closed_exc_t &) {
+    }
+    EXPECT_EQ(0u, response.find("HTTP/1.1 200 OK\r\n"));
+    EXPECT_EQ(response.size() - 6, response.find("\r\n\r\nhi"));
+
+    EXPECT_EQ(http_method_t::POST, app.request.method);
+    EXPECT_EQ("/a/b", app.request.resource.as_string());
+    EXPECT_EQ("1.1", app.request.version);
+    EXPECT_EQ("1", app.request.find_query_param("x").get());
+    EXPECT_EQ("", app.request.find_query_param("y").get());
+    EXPECT_EQ("localhost", app.request.find_header_line("host").get());
+    EXPECT_EQ("body", app.request.body);
+}
+
 }  // namespace unittest
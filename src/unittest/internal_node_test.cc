@@ -6,6 +6,7 @@
 
 #include "btree/internal_node.hpp"
 #include "btree/node.hpp"
+#include "containers/scoped.hpp"
 
 namespace unittest {
 
@@ -61,6 +62,50 @@ TEST(InternalNodeTest, Offsets) {
     EXPECT_EQ(9u, sizeof(btree_internal_pair));
 }
 
+TEST(InternalNodeTest, SearchIndex) {
+    const block_size_t bs = block_size_t::unsafe_make(4096);
+    scoped_malloc_t<internal_node_t> node(bs.value());
+    internal_node::init(bs, node.get());
+
+    // Lots of keys share their first eight bytes, some are prefixes of others, and
+    // some end in zero bytes, like the padding of short prefixes.
+    std::vector<store_key_t> keys;
+    for (int i = 0; i < 40; ++i) {
+        keys.push_back(store_key_t(strprintf("prefix%02d", i)));
+        keys.push_back(store_key_t(strprintf("p%d", i)));
+        keys.push_back(store_key_t(std::string("p") + std::string(i % 4, '\0')
+                                   + strprintf("%d", i)));
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    block_id_t next_id = 1;
+    std::vector<store_key_t> inserted;
+    for (const store_key_t &key : keys) {
+        if (!internal_node::insert(node.get(), key.btree_key(), next_id, next_id + 1)) {
+            break;
+        }
+        next_id += 2;
+        inserted.push_back(key);
+    }
+    ASSERT_LT(10u, inserted.size());
+    verify(bs, node.get());
+
+    internal_node::search_index_t index(node.get());
+    std::vector<store_key_t> probes = keys;
+    probes.push_back(store_key_t());
+    probes.push_back(store_key_t("p"));
+    probes.push_back(store_key_t("prefix"));
+    probes.push_back(store_key_t(std::string("p") + std::string(7, '\0')));
+    probes.push_back(store_key_t("prefix99"));
+    probes.push_back(store_key_t("zzz"));
+    for (const store_key_t &probe : probes) {
+        EXPECT_EQ(internal_node::get_offset_index(node.get(), probe.btree_key()),
+                  index.offset_index(node.get(), probe.btree_key()));
+        EXPECT_EQ(internal_node::lookup(node.get(), probe.btree_key()),
+                  internal_node::lookup(node.get(), probe.btree_key(), &index));
+    }
+}
 
 }  // namespace unittest
 
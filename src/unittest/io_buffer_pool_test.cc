@@ -0,0 +1,36 @@
+// Copyright 2010-2014 RethinkDB, all rights reserved.
+#include "config/args.hpp"
+#include "serializer/io_buffer_pool.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(IoBufferPoolTest, ReusesBuffers) {
+    char *first_data;
+    {
+        io_buffer_t buf(5000);
+        ASSERT_TRUE(buf.has());
+        ASSERT_LE(5000u, buf.capacity());
+        ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(buf.get()) % DEVICE_BLOCK_SIZE);
+        first_data = buf.get();
+    }
+
+    // A buffer of the same size class comes from the pool.
+    io_buffer_t buf(6000);
+    ASSERT_EQ(first_data, buf.get());
+
+    io_buffer_t moved(std::move(buf));
+    ASSERT_FALSE(buf.has());
+    ASSERT_EQ(first_data, moved.get());
+    moved.reset();
+    ASSERT_FALSE(moved.has());
+}
+
+TEST(IoBufferPoolTest, LargeBuffers) {
+    io_buffer_t buf(20 * MEGABYTE + 1);
+    ASSERT_LE(20u * MEGABYTE + 1, buf.capacity());
+    ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(buf.get()) % DEVICE_BLOCK_SIZE);
+    buf.get()[20 * MEGABYTE] = 'x';
+}
+
+}  // namespace unittest
@@ -0,0 +1,50 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string>
+
+#include "protob/json_shim.hpp"
+#include "rdb_protocol/ql2.pb.h"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(JsonShim, ParseBatch) {
+    Query q;
+    ASSERT_TRUE(json_shim::parse_json_pb(&q, 7, "[5, [1, \"a\"], {\"db\": \"test\"}]"));
+    EXPECT_EQ(Query::BATCH, q.type());
+    EXPECT_EQ(7, q.token());
+    EXPECT_FALSE(q.has_query());
+    ASSERT_EQ(2, q.batch_size());
+    EXPECT_EQ(Term::DATUM, q.batch(0).type());
+    EXPECT_EQ(Datum::R_STR, q.batch(1).datum().type());
+    ASSERT_EQ(1, q.global_optargs_size());
+    EXPECT_EQ("db", q.global_optargs(0).key());
+
+    // The terms of a batch must be in an array.
+    EXPECT_FALSE(json_shim::parse_json_pb(&q, 7, "[5, 1]"));
+}
+
+TEST(JsonShim, WriteBatch) {
+    Response r;
+    r.set_token(7);
+    r.set_type(Response::SUCCESS_BATCH);
+    Response *first = r.add_batch();
+    first->set_token(7);
+    first->set_type(Response::SUCCESS_ATOM);
+    Datum *d = first->add_response();
+    d->set_type(Datum::R_JSON);
+    d->set_r_str("1");
+    Response *second = r.add_batch();
+    second->set_token(7);
+    second->set_type(Response::CLIENT_ERROR);
+    second->mutable_backtrace();
+    d = second->add_response();
+    d->set_type(Datum::R_STR);
+    d->set_r_str("oops");
+
+    std::string s = "prefix";
+    json_shim::write_json_pb(r, &s);
+    EXPECT_EQ("prefix{\"t\":5,\"r\":[{\"t\":1,\"r\":[1],\"n\":[]},"
+              "{\"t\":16,\"r\":[\"oops\"],\"n\":[],\"b\":[]}],\"n\":[]}", s);
+}
+
+}  // namespace unittest
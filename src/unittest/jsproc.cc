@@ -85,6 +85,29 @@ SPAWNER_TEST(JSProc, LiteralString) {
     ASSERT_EQ(result.as_str(), "string data");
 }
 
+SPAWNER_TEST(JSProc, CachedScriptRunsInFreshContext) {
+    extproc_pool_t extproc_pool(1);
+    ql::configured_limits_t limits;
+
+    // The second job gets the same worker, and so the script compiled by the first,
+    // but it mustn't see the global the first one set.
+    const std::string source_code =
+        "var counter = (typeof counter === 'undefined') ? 1 : counter + 1; counter";
+
+    for (int i = 0; i < 2; ++i) {
+        js_runner_t js_runner;
+        js_runner.begin(&extproc_pool, NULL, limits, source_code);
+
+        js_runner_t::req_config_t config;
+        config.timeout_ms = 10000;
+        js_result_t result = js_runner.eval(source_code, config);
+
+        ql::datum_t *res_datum = boost::get<ql::datum_t>(&result);
+        ASSERT_TRUE(res_datum != NULL);
+        ASSERT_EQ(1, res_datum->as_int());
+    }
+}
+
 SPAWNER_TEST(JSProc, EvalAndCall) {
     extproc_pool_t extproc_pool(1);
     js_runner_t js_runner;
@@ -1,5 +1,7 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include <map>
+#include <string>
+#include <vector>
 
 #include "btree/leaf_node.hpp"
 #include "btree/node.hpp"
@@ -211,6 +213,37 @@ public:
         ASSERT_EQ(key_to_unescaped_str(p->first), key_to_unescaped_str(median));
     }
 
+    void SplitForAppend(LeafNodeTracker *right) {
+        ASSERT_EQ(bs_.ser_value(), right->bs_.ser_value());
+
+        ASSERT_TRUE(leaf::is_empty(right->node()));
+
+        store_key_t median;
+        leaf::split_for_append(&sizer_, node(), right->node(), median.btree_key());
+
+        std::map<store_key_t, std::string>::iterator p = kv_.end();
+        --p;
+        while (p->first > median && p != kv_.begin()) {
+            right->kv_[p->first] = p->second;
+            std::map<store_key_t, std::string>::iterator prev = p;
+            --p;
+            kv_.erase(prev);
+        }
+
+        ASSERT_EQ(key_to_unescaped_str(p->first), key_to_unescaped_str(median));
+
+        Verify();
+        right->Verify();
+    }
+
+    size_t Size() const {
+        return kv_.size();
+    }
+
+    bool IsUnderfull() {
+        return leaf::is_underfull(&sizer_, node());
+    }
+
     bool IsFull(const store_key_t& key, const std::string& value) {
         short_value_buffer_t value_buf(value);
         return leaf::is_full(&sizer_, node(), key.btree_key(), value_buf.data());
@@ -267,6 +300,32 @@ public:
         std::map<store_key_t, std::string> kv_map_;
     };
 
+    class lost_deletions_receptor_t : public leaf::entry_reception_callback_t {
+    public:
+        lost_deletions_receptor_t() : got_lost_deletions(false) { }
+        void lost_deletions() { got_lost_deletions = true; }
+        void deletion(const btree_key_t *, repli_timestamp_t) { }
+        void keys_values(const std::vector<const btree_key_t *> &,
+                         const std::vector<const void *> &,
+                         const std::vector<repli_timestamp_t> &) { }
+        bool got_lost_deletions;
+    };
+
+    // Whether a backfill since `tstamp` could send just the entries that changed.
+    bool HasHistorySince(repli_timestamp_t tstamp) {
+        lost_deletions_receptor_t receptor;
+        repli_timestamp_t max_possible_tstamp = { tstamp_counter_ };
+        leaf::dump_entries_since_time(&sizer_, node(), tstamp, max_possible_tstamp,
+                                      &receptor);
+        return !receptor.got_lost_deletions;
+    }
+
+    repli_timestamp_t LastTimestamp() const {
+        repli_timestamp_t ret;
+        ret.longtime = tstamp_counter_;
+        return ret;
+    }
+
     void printmap(const std::map<store_key_t, std::string>& m) {
         for (std::map<store_key_t, std::string>::const_iterator p = m.begin(), q = m.end(); p != q; ++p) {
             printf("%s: %s;", key_to_debug_str(p->first).c_str(), p->second.c_str());
@@ -429,6 +488,74 @@ TEST(LeafNodeTest, RandomOutOfOrder) {
     }
 }
 
+TEST(LeafNodeTest, SharedPrefixes) {
+    LeafNodeTracker tracker;
+
+    // Keys that only differ after a long common prefix, in a few different
+    // lengths, so that lookups have to tell them apart by their tails.
+    const std::string prefix(100, 'p');
+    std::vector<store_key_t> keys;
+    for (int i = 0; i < 26; ++i) {
+        std::string suffix(1 + i % 3, 'a' + i);
+        keys.push_back(store_key_t(prefix + suffix));
+        keys.push_back(store_key_t(prefix.substr(0, 50 + i) + suffix));
+    }
+    keys.push_back(store_key_t(prefix));
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (!tracker.Insert(keys[i], "v")) {
+            keys.resize(i);
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+        int index;
+        ASSERT_TRUE(leaf::find_key(tracker.node(), keys[i].btree_key(), &index));
+        ASSERT_EQ(0, btree_key_cmp(keys[i].btree_key(),
+                                   (*leaf::iterator(tracker.node(), index)).first));
+    }
+
+    int index;
+    store_key_t missing(prefix + "zzzz");
+    ASSERT_FALSE(leaf::find_key(tracker.node(), missing.btree_key(), &index));
+}
+
+TEST(LeafNodeTest, LookupIndex) {
+    LeafNodeTracker tracker;
+
+    std::vector<store_key_t> keys;
+    for (int i = 0; i < 200; ++i) {
+        store_key_t key(strprintf("key%d", i * 7));
+        if (!tracker.Insert(key, "v")) {
+            break;
+        }
+        keys.push_back(key);
+    }
+    ASSERT_LT(10u, keys.size());
+    // Removed keys leave deletion entries behind, which the index must find too.
+    for (size_t i = 0; i < keys.size(); i += 3) {
+        tracker.Remove(keys[i]);
+    }
+
+    leaf::lookup_index_t index(tracker.node());
+    std::vector<store_key_t> probes = keys;
+    probes.push_back(store_key_t());
+    probes.push_back(store_key_t("key"));
+    probes.push_back(store_key_t("key1"));
+    probes.push_back(store_key_t("zzz"));
+    for (size_t i = 0; i < probes.size(); ++i) {
+        int expected;
+        bool found = leaf::find_key(tracker.node(), probes[i].btree_key(), &expected);
+        int index_out = -1;
+        ASSERT_EQ(found, index.find_key(tracker.node(), probes[i].btree_key(),
+                                        &index_out));
+        if (found) {
+            ASSERT_EQ(expected, index_out);
+        }
+    }
+}
+
 TEST(LeafNodeTest, ZeroZeroMerging) {
     LeafNodeTracker left;
     LeafNodeTracker right;
@@ -608,6 +735,23 @@ TEST(LeafNodeTest, Splitting) {
     left.Split(&right);
 }
 
+TEST(LeafNodeTest, SplittingForAppend) {
+    LeafNodeTracker left;
+    for (int i = 0; i < 4272 / 12; ++i) {
+        left.Insert(store_key_t(strprintf("a%04d", i)), strprintf("A%d", i));
+    }
+
+    LeafNodeTracker right;
+
+    left.SplitForAppend(&right);
+
+    // The old node keeps most of the entries, and is nowhere near underfull.
+    ASSERT_GT(right.Size(), 0u);
+    ASSERT_LT(right.Size() * 5, left.Size());
+    ASSERT_FALSE(left.IsUnderfull());
+    ASSERT_TRUE(right.IsUnderfull());
+}
+
 TEST(LeafNodeTest, Fullness) {
     LeafNodeTracker node;
     int i;
@@ -618,4 +762,35 @@ TEST(LeafNodeTest, Fullness) {
     ASSERT_TRUE(node.IsFull(store_key_t(strprintf("a%d", i)), strprintf("A%d", i)));
 }
 
+TEST(LeafNodeTest, HistoryAfterOverwrites) {
+    // Fill a node about halfway, like it would be after a split.
+    int capacity = 0;
+    {
+        LeafNodeTracker full_node;
+        while (full_node.Insert(store_key_t(strprintf("a%d", capacity)), "A")) {
+            ++capacity;
+        }
+    }
+    LeafNodeTracker node;
+    const int num_keys = capacity / 2;
+    for (int i = 0; i < num_keys; ++i) {
+        ASSERT_TRUE(node.Insert(store_key_t(strprintf("a%d", i)), "A"));
+    }
+
+    // Overwriting keys keeps garbage collecting the node. That should only throw
+    // away as much of the history as it needs to, so we can always backfill the
+    // last 50 changes from it.
+    rng_t rng(0);
+    repli_timestamp_t checkpoint = node.LastTimestamp();
+    repli_timestamp_t min_history = checkpoint;
+    for (int i = 0; i < 2000; ++i) {
+        if (i % 50 == 0) {
+            min_history = checkpoint;
+            checkpoint = node.LastTimestamp();
+        }
+        ASSERT_TRUE(node.Insert(store_key_t(strprintf("a%d", rng.randint(num_keys))), "B"));
+        ASSERT_TRUE(node.HasHistorySince(min_history));
+    }
+}
+
 }  // namespace unittest
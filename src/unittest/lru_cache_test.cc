@@ -1,3 +1,5 @@
+#include <string>
+
 #include "unittest/gtest.hpp"
 
 #include "containers/lru_cache.hpp"
@@ -65,4 +67,29 @@ TEST(LRUCacheTest, Find) {
     EXPECT_EQ(10, cache.rbegin()->first);
 }
 
+TEST(LRUCacheTest, MovedKeys) {
+    lru_cache_t<std::string, int> cache(2);
+    std::string a = "a";
+    cache[std::move(a)] = 1;
+    cache["b"] = 2;
+    EXPECT_EQ(1, cache.find("a")->second);
+    EXPECT_EQ(2, cache.find("b")->second);
+    cache["c"] = 3;
+    EXPECT_EQ(2, cache.size());
+    EXPECT_EQ(cache.end(), cache.find("a"));
+    EXPECT_EQ(3, cache.find("c")->second);
+}
+
+TEST(LRUCacheTest, Erase) {
+    lru_cache_t<int, int> cache(10);
+    for (int i = 0; i < 5; i++) cache[i] = i;
+    EXPECT_TRUE(cache.erase(4));
+    EXPECT_FALSE(cache.erase(4));
+    EXPECT_TRUE(cache.erase(0));
+    EXPECT_EQ(3, cache.size());
+    EXPECT_EQ(cache.end(), cache.find(4));
+    EXPECT_EQ(3, cache.begin()->first);
+    EXPECT_EQ(1, cache.rbegin()->first);
+}
+
 } // namespace unittest
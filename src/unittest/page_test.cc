@@ -4,6 +4,7 @@
 #include "buffer_cache/page_cache.hpp"
 #include "buffer_cache/alt.hpp"
 #include "buffer_cache/cache_balancer.hpp"
+#include "buffer_cache/warmup_snapshot.hpp"
 #include "concurrency/auto_drainer.hpp"
 #include "concurrency/pmap.hpp"
 #include "containers/scoped.hpp"
@@ -57,7 +58,8 @@ public:
           throttler_(throttler) { }
 
     void flush(scoped_ptr_t<test_txn_t> txn) {
-        flush_and_destroy_txn(std::move(txn), &reset_throttler_acq);
+        flush_and_destroy_txn(std::move(txn), write_durability_t::SOFT,
+                              &reset_throttler_acq);
     }
 
     alt::throttler_acq_t make_throttler_acq() {
@@ -183,6 +185,40 @@ TPTEST(PageTest, OneWriteAcq, 4) {
     page_cache.flush(std::move(txn));
 }
 
+TPTEST(PageTest, WarmupSnapshot, 4) {
+    mock_ser_t mock;
+    dummy_cache_balancer_t balancer(GIGABYTE);
+    temp_file_t snapshot_file;
+    const std::string snapshot_path = snapshot_file.name().permanent_path();
+    {
+        test_cache_t page_cache(mock.ser.get(), &balancer, mock.throttler.get());
+        // There is no snapshot yet, so this doesn't load anything.
+        page_cache.enable_warmup_snapshots(snapshot_path);
+        auto txn = make_scoped<test_txn_t>(&page_cache);
+        for (block_id_t id = 0; id < 3; ++id) {
+            current_test_acq_t acq(txn.get(), id, access_t::write, page_create_t::yes);
+            acq.current_page_for_write();
+        }
+        page_cache.flush(std::move(txn));
+    }
+
+    std::vector<block_id_t> block_ids;
+    ASSERT_TRUE(load_warmup_snapshot(snapshot_path, &block_ids));
+    std::sort(block_ids.begin(), block_ids.end());
+    ASSERT_EQ((std::vector<block_id_t>{0, 1, 2}), block_ids);
+
+    {
+        test_cache_t page_cache(mock.ser.get(), &balancer, mock.throttler.get());
+        page_cache.enable_warmup_snapshots(snapshot_path);
+        auto txn = make_scoped<test_txn_t>(&page_cache);
+        {
+            current_test_acq_t acq(txn.get(), 1, access_t::read);
+            acq.current_page_for_read();
+        }
+        page_cache.flush(std::move(txn));
+    }
+}
+
 TPTEST(PageTest, OneWriteAcqOneReadAcq, 4) {
     mock_ser_t mock;
     dummy_cache_balancer_t balancer(GIGABYTE);
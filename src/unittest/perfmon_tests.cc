@@ -57,4 +57,42 @@ TEST(PerfmonTest, StddevComputation) {
     }
 }
 
+TEST(PerfmonTest, LatencyHistogramBuckets) {
+    typedef latency_histogram_t h;
+
+    // Every duration lands in a bucket whose upper bound is at least the duration,
+    // and less than an eighth more than it.
+    for (ticks_t d = 0; d < 100000; d = d * 1.01 + 1) {
+        size_t i = h::bucket_index(d);
+        ASSERT_LT(i, h::NUM_BUCKETS);
+        EXPECT_LE(d, h::bucket_upper_bound(i));
+        EXPECT_LE(h::bucket_upper_bound(i) - d, d / 8);
+        if (i > 0) {
+            EXPECT_LT(h::bucket_upper_bound(i - 1), d);
+        }
+    }
+    EXPECT_EQ(h::NUM_BUCKETS - 1, h::bucket_index(static_cast<ticks_t>(1) << 50));
+}
+
+TEST(PerfmonTest, LatencyHistogramPercentiles) {
+    latency_histogram_t a, b;
+    EXPECT_EQ(0u, a.percentile(0.5));
+
+    // 1..1000 microseconds, split between two histograms.
+    for (ticks_t us = 1; us <= 1000; ++us) {
+        (us % 2 == 0 ? a : b).record(us * 1000);
+    }
+    a.merge(b);
+    EXPECT_EQ(1000u, a.count());
+    EXPECT_EQ(1000000u, a.max());
+
+    const double fractions[] = { 0.5, 0.9, 0.99, 0.999 };
+    for (double f : fractions) {
+        const double expected = f * 1000000;
+        EXPECT_GE(a.percentile(f), expected);
+        EXPECT_LE(a.percentile(f), expected * 1.125);
+    }
+    EXPECT_EQ(1000000u, a.percentile(1.0));
+}
+
 }  // namespace unittest
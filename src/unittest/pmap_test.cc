@@ -0,0 +1,33 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "concurrency/pmap.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TPTEST(PmapTest, PmapOnThreads, 4) {
+    std::vector<threadnum_t> threads;
+    for (int i = 0; i < get_num_threads(); ++i) {
+        threads.push_back(threadnum_t(i));
+    }
+    // The caller's own thread appears twice, and runs its calls directly.
+    threads.push_back(get_thread_id());
+
+    std::vector<int> seen(threads.size(), -1);
+    pmap_on_threads(threads, [&](size_t i) {
+        seen[i] = get_thread_id().threadnum;
+    });
+    for (size_t i = 0; i < threads.size(); ++i) {
+        EXPECT_EQ(threads[i].threadnum, seen[i]);
+    }
+
+    std::vector<int> counts(get_num_threads(), 0);
+    pmap_on_threads([&](size_t i) {
+        ++counts[i];
+    });
+    for (int count : counts) {
+        EXPECT_EQ(1, count);
+    }
+}
+
+}  // namespace unittest
@@ -1,6 +1,8 @@
 // Copyright 2015 RethinkDB, all rights reserved.
 
+#include "pprint/js_pprint.hpp"
 #include "pprint/pprint.hpp"
+#include "rdb_protocol/ql2.pb.h"
 #include "unittest/gtest.hpp"
 
 namespace unittest {
@@ -82,4 +84,25 @@ TEST(PPrintTest, Involved) {
               pretty_print(4, handle));
 }
 
+TEST(PPrintTest, NormalizedJavascript) {
+    // r.table("users").get(17)
+    Term t;
+    t.set_type(Term::GET);
+    Term *table = t.add_args();
+    table->set_type(Term::TABLE);
+    Term *name = table->add_args();
+    name->set_type(Term::DATUM);
+    name->mutable_datum()->set_type(Datum::R_STR);
+    name->mutable_datum()->set_r_str("users");
+    Term *key = t.add_args();
+    key->set_type(Term::DATUM);
+    key->mutable_datum()->set_type(Datum::R_NUM);
+    key->mutable_datum()->set_r_num(17);
+
+    ASSERT_EQ("r.table(\"users\").get(17)",
+              pretty_print(80, render_as_javascript(t)));
+    ASSERT_EQ("r.table(\"users\").get(?)",
+              pretty_print(80, render_as_normalized_javascript(t)));
+}
+
 }  // namespace unittest
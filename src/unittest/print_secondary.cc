@@ -1,4 +1,6 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
+#include <vector>
+
 #include "unittest/gtest.hpp"
 #include "rdb_protocol/datum.hpp"
 
@@ -46,4 +48,56 @@ TEST(PrintSecondary, Mangle) {
                 "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb");
 }
 
+void test_contains_sindex_key(const ql::datum_range_t &range,
+                              const ql::datum_t &val,
+                              const std::string &pkey) {
+    store_key_t key(val.print_secondary(reql_version_t::LATEST, store_key_t(pkey),
+                                        boost::optional<uint64_t>()));
+    boost::optional<bool> contained = range.contains_sindex_key(reql_version_t::LATEST,
+                                                                key);
+    if (ql::datum_t::key_is_truncated(key)) {
+        ASSERT_FALSE(static_cast<bool>(contained));
+    } else {
+        ASSERT_TRUE(static_cast<bool>(contained));
+        ASSERT_EQ(range.contains(reql_version_t::LATEST, val), *contained);
+    }
+    // Older versions' keys never tell.
+    store_key_t old_key(val.print_secondary(reql_version_t::v1_14, store_key_t(pkey),
+                                            boost::optional<uint64_t>()));
+    ASSERT_FALSE(static_cast<bool>(
+        range.contains_sindex_key(reql_version_t::v1_14, old_key)));
+}
+
+TEST(PrintSecondary, ContainsSindexKey) {
+    std::vector<ql::datum_t> vals = {
+        ql::datum_t(1.0),
+        ql::datum_t(2.0),
+        ql::datum_t(3.0),
+        ql::datum_t(datum_string_t("a")),
+        ql::datum_t(datum_string_t("ab")),
+        ql::datum_t(datum_string_t("b")),
+        ql::datum_t(datum_string_t(std::string(300, 'a')))};
+    std::vector<ql::datum_range_t> ranges = {
+        ql::datum_range_t::universe(),
+        ql::datum_range_t(ql::datum_t(2.0)),
+        ql::datum_range_t(ql::datum_t(1.0), key_range_t::open,
+                          ql::datum_t(3.0), key_range_t::closed),
+        ql::datum_range_t(ql::datum_t(datum_string_t("a")), key_range_t::open,
+                          ql::datum_t(datum_string_t("b")), key_range_t::open),
+        ql::datum_range_t(ql::datum_t(datum_string_t("a")), key_range_t::closed,
+                          ql::datum_t::maxval(), key_range_t::open)};
+    for (const auto &range : ranges) {
+        for (const auto &val : vals) {
+            test_contains_sindex_key(range, val, "foo");
+        }
+    }
+
+    // A truncated bound doesn't tell either.
+    ql::datum_range_t long_range(ql::datum_t(datum_string_t(std::string(300, 'a'))));
+    store_key_t key(ql::datum_t(datum_string_t("b")).print_secondary(
+        reql_version_t::LATEST, store_key_t("foo"), boost::optional<uint64_t>()));
+    ASSERT_FALSE(static_cast<bool>(
+        long_range.contains_sindex_key(reql_version_t::LATEST, key)));
+}
+
 }  // namespace unittest
@@ -0,0 +1,72 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/datum.hpp"
+#include "rdb_protocol/error.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+class test_rcheckable_t : public ql::rcheckable_t {
+public:
+    void runtime_fail(ql::base_exc_t::type_t type,
+                      UNUSED const char *test, UNUSED const char *file, UNUSED int line,
+                      std::string msg) const {
+        throw ql::datum_exc_t(type, msg);
+    }
+};
+
+double parse_epoch_time(const std::string &s, const std::string &default_tz = "") {
+    test_rcheckable_t target;
+    return ql::pseudo::time_to_epoch_time(
+        ql::pseudo::iso8601_to_time(s, default_tz, &target));
+}
+
+std::string format_time(double epoch_time, const std::string &tz) {
+    return ql::pseudo::time_to_iso8601(ql::pseudo::make_time(epoch_time, tz));
+}
+
+TEST(PseudoTimeTest, ParseIso8601) {
+    EXPECT_EQ(0, parse_epoch_time("1970-01-01T00:00:00Z"));
+    EXPECT_EQ(1375242965, parse_epoch_time("2013-07-30T20:56:05-07:00"));
+    EXPECT_EQ(1375242965, parse_epoch_time("20130730T205605-0700"));
+    EXPECT_EQ(1375242965, parse_epoch_time("2013-07-30T20:56:05", "-07"));
+    EXPECT_EQ(1375242965.5, parse_epoch_time("2013-07-31T03:56:05.5+00:00"));
+    EXPECT_EQ(1375242965.123, parse_epoch_time("2013-07-31T03:56:05.123456Z"));
+    EXPECT_EQ(-1.5, parse_epoch_time("1969-12-31T23:59:58.500Z"));
+    // Ordinal dates, including the last day of a leap year.
+    EXPECT_EQ(parse_epoch_time("2012-12-31T00:00:00Z"),
+              parse_epoch_time("2012-366T00:00:00Z"));
+    EXPECT_EQ(parse_epoch_time("2000-02-29T12:00:00+05:30"),
+              parse_epoch_time("2000-060T12:00:00+05:30"));
+    EXPECT_EQ(-17987443200, parse_epoch_time("1400-01-01T00:00:00Z"));
+
+    test_rcheckable_t target;
+    EXPECT_THROW(ql::pseudo::iso8601_to_time("2013-02-29T00:00:00Z", "", &target),
+                 ql::base_exc_t);
+    EXPECT_THROW(ql::pseudo::iso8601_to_time("2013-07-30T20:56:05", "", &target),
+                 ql::base_exc_t);
+}
+
+TEST(PseudoTimeTest, FormatIso8601) {
+    EXPECT_EQ("1970-01-01T00:00:00+00:00", format_time(0, "+00:00"));
+    EXPECT_EQ("1970-01-01T00:00:01.444+00:00", format_time(1.4444445, "+00:00"));
+    EXPECT_EQ("2013-07-30T20:56:05-07:00", format_time(1375242965, "-07:00"));
+    EXPECT_EQ("1969-12-31T23:59:58.500+00:00", format_time(-1.5, "+00:00"));
+    EXPECT_EQ("2000-02-29T17:30:00+05:30", format_time(951825600, "+05:30"));
+    EXPECT_THROW(format_time(253430000000, "+00:00"), ql::base_exc_t);
+}
+
+TEST(PseudoTimeTest, RoundTrip) {
+    // Fractions that are exact in binary, since formatting truncates.
+    const double times[] = { -17987356800, -86400.25, -1, 0, 0.5, 951782400,
+                             1375242965.125, 253402214399 };
+    const char *tzs[] = { "+00:00", "-07:00", "+05:30", "+23:59", "-23:59" };
+    for (double t : times) {
+        for (const char *tz : tzs) {
+            std::string s = format_time(t, tz);
+            EXPECT_EQ(t, parse_epoch_time(s)) << s;
+        }
+    }
+}
+
+}  // namespace unittest
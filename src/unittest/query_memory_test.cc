@@ -0,0 +1,32 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/query_memory.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(QueryMemoryTest, QueryLimit) {
+    ql::query_memory_t memory(100);
+    ASSERT_TRUE(memory.try_charge(60));
+    ASSERT_FALSE(memory.try_charge(41));
+    ASSERT_TRUE(memory.try_charge(40));
+    memory.release(50);
+    ASSERT_TRUE(memory.try_charge(50));
+    memory.release(100);
+}
+
+TEST(QueryMemoryTest, GlobalLimit) {
+    ql::set_global_query_memory_limit(100);
+    {
+        ql::query_memory_t a(1000), b(1000);
+        ASSERT_TRUE(a.try_charge(70));
+        // `b` is under its own limit, but both together would be over the global one.
+        ASSERT_FALSE(b.try_charge(40));
+        ASSERT_TRUE(b.try_charge(30));
+        a.release(70);
+        ASSERT_TRUE(b.try_charge(40));
+        b.release(70);
+    }
+    ql::set_global_query_memory_limit(0);
+}
+
+}  // namespace unittest
@@ -0,0 +1,65 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <map>
+
+#include "unittest/gtest.hpp"
+
+#include "containers/radix_array.hpp"
+#include "utils.hpp"
+
+namespace unittest {
+
+TEST(RadixArrayTest, Simple) {
+    radix_array_t<int> array;
+    EXPECT_EQ(0, array.get(0));
+    EXPECT_EQ(0, array.get(1ull << 40));
+    size_t key = 0;
+    EXPECT_FALSE(array.find_next(&key));
+
+    array.set(3, 30);
+    array.set(1ull << 40, 40);
+    EXPECT_EQ(30, array.get(3));
+    EXPECT_EQ(40, array.get(1ull << 40));
+    EXPECT_EQ(0, array.get(4));
+
+    key = 0;
+    ASSERT_TRUE(array.find_next(&key));
+    EXPECT_EQ(3u, key);
+    ++key;
+    ASSERT_TRUE(array.find_next(&key));
+    EXPECT_EQ(1ull << 40, key);
+    ++key;
+    EXPECT_FALSE(array.find_next(&key));
+
+    array.set(1ull << 40, 0);
+    EXPECT_EQ(0, array.get(1ull << 40));
+    key = 4;
+    EXPECT_FALSE(array.find_next(&key));
+}
+
+TEST(RadixArrayTest, CompareToMap) {
+    // Small levels, so that the keys span many leaves and inner nodes.
+    radix_array_t<uint64_t, 3, 2> array;
+    std::map<size_t, uint64_t> reference;
+    for (int i = 0; i < 20000; ++i) {
+        const size_t key = randint(3000);
+        const uint64_t value = randint(3) == 0 ? 0 : randint(1000) + 1;
+        array.set(key, value);
+        if (value == 0) {
+            reference.erase(key);
+        } else {
+            reference[key] = value;
+        }
+    }
+    for (size_t key = 0; key < 3000; ++key) {
+        auto it = reference.find(key);
+        EXPECT_EQ(it == reference.end() ? 0 : it->second, array.get(key));
+    }
+    auto it = reference.begin();
+    for (size_t key = 0; array.find_next(&key); ++key, ++it) {
+        ASSERT_TRUE(it != reference.end());
+        EXPECT_EQ(it->first, key);
+    }
+    EXPECT_TRUE(it == reference.end());
+}
+
+}  // namespace unittest
@@ -1,9 +1,11 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include <functional>
+#include <set>
 
 #include "arch/io/disk.hpp"
 #include "arch/runtime/coroutines.hpp"
 #include "arch/timing.hpp"
+#include "btree/depth_first_traversal.hpp"
 #include "btree/operations.hpp"
 #include "btree/reql_specific.hpp"
 #include "buffer_cache/cache_balancer.hpp"
@@ -560,4 +562,115 @@ TPTEST(RDBBtree, SindexInterruptionViaStoreDelete) {
     store.reset();
 }
 
+class collect_all_keys_cb_t : public depth_first_traversal_callback_t {
+public:
+    done_traversing_t handle_pair(scoped_key_value_t &&keyvalue) {
+        keys.insert(store_key_t(keyvalue.key()));
+        return done_traversing_t::NO;
+    }
+    std::set<store_key_t> keys;
+};
+
+TPTEST(RDBBtree, EraseMajorRange) {
+    recreate_temporary_directory(base_path_t("."));
+    temp_file_t temp_file;
+
+    io_backender_t io_backender(file_direct_io_mode_t::buffered_desired);
+    dummy_cache_balancer_t balancer(GIGABYTE);
+
+    filepath_file_opener_t file_opener(temp_file.name(), &io_backender);
+    standard_serializer_t::create(
+        &file_opener,
+        standard_serializer_t::static_config_t());
+
+    standard_serializer_t serializer(
+        standard_serializer_t::dynamic_config_t(),
+        &file_opener,
+        &get_global_perfmon_collection());
+
+    store_t store(
+            &serializer,
+            &balancer,
+            "unit_test_store",
+            true,
+            &get_global_perfmon_collection(),
+            NULL,
+            &io_backender,
+            base_path_t("."),
+            scoped_ptr_t<outdated_index_report_t>(),
+            generate_uuid());
+
+    cond_t dummy_interruptor;
+
+    insert_rows(0, TOTAL_KEYS_TO_INSERT, &store);
+
+    /* Erase the middle of the table, which spans many leaves. */
+    const int first_erased = TOTAL_KEYS_TO_INSERT / 10;
+    const int first_kept = (TOTAL_KEYS_TO_INSERT * 9) / 10;
+    key_range_t erased_range(
+        key_range_t::closed,
+        store_key_t(ql::datum_t(static_cast<double>(first_erased)).print_primary()),
+        key_range_t::open,
+        store_key_t(ql::datum_t(static_cast<double>(first_kept)).print_primary()));
+
+    std::vector<block_id_t> detached_subtrees;
+    rdb_value_deleter_t deleter;
+    {
+        write_token_t token;
+        store.new_write_token(&token);
+
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> super_block;
+        store.acquire_superblock_for_write(repli_timestamp_t::distant_past,
+                                           1,
+                                           write_durability_t::SOFT,
+                                           &token,
+                                           &txn,
+                                           &super_block,
+                                           &dummy_interruptor);
+        rdb_erase_major_range(erased_range, super_block.get(), &deleter,
+                              &detached_subtrees);
+    }
+    /* The range covers most of the tree, so whole subtrees must have been cut. */
+    ASSERT_FALSE(detached_subtrees.empty());
+
+    while (!detached_subtrees.empty()) {
+        txn_t txn(store.general_cache_conn.get(), write_durability_t::SOFT,
+                  repli_timestamp_t::distant_past, 1);
+        rdb_free_detached_subtrees(&txn, &detached_subtrees, 8, &deleter);
+    }
+
+    {
+        read_token_t token;
+        store.new_read_token(&token);
+
+        scoped_ptr_t<txn_t> txn;
+        scoped_ptr_t<real_superblock_t> super_block;
+        store.acquire_superblock_for_read(&token, &txn, &super_block,
+                                          &dummy_interruptor, true);
+        collect_all_keys_cb_t cb;
+        btree_depth_first_traversal(super_block.get(), key_range_t::universe(), &cb,
+                                    direction_t::FORWARD, release_superblock_t::KEEP);
+
+        std::set<store_key_t> expected;
+        for (int i = 0; i < TOTAL_KEYS_TO_INSERT; ++i) {
+            if (i < first_erased || i >= first_kept) {
+                expected.insert(store_key_t(
+                    ql::datum_t(static_cast<double>(i)).print_primary()));
+            }
+        }
+        ASSERT_EQ(expected, cb.keys);
+
+        /* The population no longer counts the erased rows, cut subtrees included. */
+        uint64_t population;
+        ASSERT_TRUE(rdb_count_from_stat_block(super_block.get(),
+                                              key_range_t::universe(),
+                                              &population));
+        ASSERT_EQ(expected.size(), population);
+    }
+
+    /* Writes after the erase fix up the nodes it left underfull. */
+    insert_rows(first_erased, first_kept, &store);
+}
+
 } //namespace unittest
@@ -1,6 +1,8 @@
 // Copyright 2010-2013 RethinkDB, all rights reserved.
 #include "unittest/rdb_env.hpp"
 
+#include <algorithm>
+
 #include "rdb_protocol/func.hpp"
 #include "rdb_protocol/real_table.hpp"
 
@@ -96,9 +98,90 @@ void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(
     throw cannot_perform_query_exc_t("unimplemented");
 }
 
-void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(
-        UNUSED const rget_read_t &rget) {
-    throw cannot_perform_query_exc_t("unimplemented");
+// Every row is equally likely, so the sort keys don't matter.
+void mock_namespace_interface_t::read_visitor_t::operator()(const sample_read_t &sr) {
+    response->response = sample_read_response_t();
+    sample_read_response_t &res = boost::get<sample_read_response_t>(response->response);
+    for (const auto &pair : parent->data) {
+        if (sr.region.inner.contains_key(pair.first)) {
+            res.rows.push_back(sample_read_response_t::keyed_row_t(0.0, pair.second));
+        }
+    }
+    std::random_shuffle(res.rows.begin(), res.rows.end());
+    if (res.rows.size() > sr.num) {
+        res.rows.resize(sr.num);
+    }
+}
+
+void mock_namespace_interface_t::read_visitor_t::operator()(
+        const multi_point_read_t &mpr) {
+    response->response = multi_point_read_response_t();
+    multi_point_read_response_t &res =
+        boost::get<multi_point_read_response_t>(response->response);
+    for (const store_key_t &key : mpr.keys) {
+        auto it = parent->data.find(key);
+        if (it != parent->data.end()) {
+            res.rows.push_back(std::make_pair(key, it->second));
+        }
+    }
+}
+
+// Runs the read's transforms and terminal over the rows in range the way
+// `rdb_rget_slice` does, without the btree.  Secondary index reads are not supported.
+void mock_namespace_interface_t::read_visitor_t::operator()(const rget_read_t &rget) {
+    if (rget.sindex) {
+        throw cannot_perform_query_exc_t("unimplemented");
+    }
+    response->response = rget_read_response_t();
+    rget_read_response_t &res = boost::get<rget_read_response_t>(response->response);
+
+    const key_range_t &range = rget.region.inner;
+    const bool reverse = reversed(rget.sorting);
+    res.last_key = !reverse
+        ? range.left
+        : (!range.right.unbounded ? range.right.key : store_key_t::max());
+
+    ql::env_t *env = parent->env;
+    ql::batcher_t batcher = rget.batchspec.to_batcher();
+    std::vector<scoped_ptr_t<ql::op_t> > transformers;
+    for (const auto &transform : rget.transforms) {
+        transformers.push_back(ql::make_op(transform));
+    }
+    scoped_ptr_t<ql::accumulator_t> accumulator(
+        rget.terminal
+            ? ql::make_terminal(*rget.terminal)
+            : ql::make_append(rget.sorting, &batcher));
+
+    std::vector<std::pair<store_key_t, ql::datum_t> > rows;
+    for (const auto &pair : parent->data) {
+        if (range.contains_key(pair.first)) {
+            rows.push_back(pair);
+        }
+    }
+    if (reverse) {
+        std::reverse(rows.begin(), rows.end());
+    }
+
+    try {
+        for (const auto &row : rows) {
+            res.last_key = row.first;
+            ql::groups_t data;
+            data = {{ql::datum_t(), ql::datums_t{row.second}}};
+            for (const auto &transformer : transformers) {
+                (*transformer)(env, &data, ql::datum_t());
+            }
+            if ((*accumulator)(env, &data, row.first, ql::datum_t())
+                == done_traversing_t::YES) {
+                break;
+            }
+        }
+        accumulator->finish(&res.result);
+        if (accumulator->should_send_batch()) {
+            res.truncated = true;
+        }
+    } catch (const ql::exc_t &e) {
+        res.result = e;
+    }
 }
 
 void NORETURN mock_namespace_interface_t::read_visitor_t::operator()(
@@ -263,6 +346,10 @@ void NORETURN mock_namespace_interface_t::write_visitor_t::operator()(const sync
     throw cannot_perform_query_exc_t("unimplemented");
 }
 
+void NORETURN mock_namespace_interface_t::write_visitor_t::operator()(const expire_t &) {
+    throw cannot_perform_query_exc_t("unimplemented");
+}
+
 mock_namespace_interface_t::write_visitor_t::write_visitor_t(
             mock_namespace_interface_t *_parent,
             write_response_t *_response) :
@@ -319,7 +406,8 @@ test_rdb_env_t::instance_t::instance_t(test_rdb_env_t &&test_env) :
                            ql::return_empty_normal_batches_t::NO,
                            &interruptor,
                            std::map<std::string, ql::wire_func_t>(),
-                           nullptr /* no profile trace */));
+                           nullptr /* no profile trace */,
+                           nullptr /* no resource usage */));
 
     // Set up any databases, tables, and data
     for (auto const &db_name : test_env.databases) {
@@ -76,12 +76,14 @@ private:
         void NORETURN operator()(const changefeed_limit_subscribe_t &);
         void NORETURN operator()(const changefeed_stamp_t &);
         void NORETURN operator()(const changefeed_point_stamp_t &);
-        void NORETURN operator()(UNUSED const rget_read_t &rget);
+        void operator()(const rget_read_t &rget);
         void NORETURN operator()(UNUSED const intersecting_geo_read_t &gr);
         void NORETURN operator()(UNUSED const nearest_geo_read_t &gr);
         void NORETURN operator()(UNUSED const distribution_read_t &dg);
         void NORETURN operator()(UNUSED const sindex_list_t &sl);
         void NORETURN operator()(UNUSED const sindex_status_t &ss);
+        void operator()(const sample_read_t &sr);
+        void operator()(const multi_point_read_t &mpr);
 
         read_visitor_t(mock_namespace_interface_t *parent, read_response_t *_response);
 
@@ -99,6 +101,7 @@ private:
         void NORETURN operator()(UNUSED const sindex_drop_t &s);
         void NORETURN operator()(UNUSED const sindex_rename_t &s);
         void NORETURN operator()(UNUSED const sync_t &s);
+        void NORETURN operator()(UNUSED const expire_t &e);
 
         write_visitor_t(mock_namespace_interface_t *parent, write_response_t *_response);
 
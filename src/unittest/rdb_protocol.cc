@@ -16,6 +16,7 @@
 #include "rdb_protocol/minidriver.hpp"
 #include "rdb_protocol/pb_utils.hpp"
 #include "rdb_protocol/protocol.hpp"
+#include "rdb_protocol/pseudo_time.hpp"
 #include "rdb_protocol/store.hpp"
 #include "rpc/directory/read_manager.hpp"
 #include "rpc/semilattice/semilattice_manager.hpp"
@@ -186,7 +187,8 @@ std::string create_sindex(namespace_interface_t *nsi,
     ql::map_wire_func_t m(mapping, make_vector(arg), get_backtrace(mapping));
 
     write_t write(sindex_create_t(id, m, sindex_multi_bool_t::SINGLE,
-                                  sindex_geo_bool_t::REGULAR),
+                                  sindex_geo_bool_t::REGULAR,
+                                  sindex_values_bool_t::DOCUMENT),
                   profile_bool_t::PROFILE, ql::configured_limits_t());
     write_response_t response;
 
@@ -764,6 +766,102 @@ TEST(RDBProtocol, OvershardedMissingAttr) {
     run_in_thread_pool_with_namespace_interface(&run_sindex_missing_attr_test, true);
 }
 
+uint64_t expire_rows(namespace_interface_t *nsi,
+                     order_source_t *osource,
+                     const std::string &index,
+                     double cutoff_epoch_time,
+                     uint64_t max_rows) {
+    ql::datum_t cutoff = ql::pseudo::make_time(cutoff_epoch_time, "+00:00");
+    write_t write(expire_t(index, "id", cutoff, max_rows, region_t::universe()),
+                  profile_bool_t::PROFILE, ql::configured_limits_t());
+    write_response_t response;
+
+    cond_t interruptor;
+    nsi->write(write, &response,
+               osource->check_in("unittest::expire_rows(rdb_protocol.cc-A"),
+               &interruptor);
+
+    const ql::datum_t *stats = boost::get<ql::datum_t>(&response.response);
+    if (stats == NULL) {
+        ADD_FAILURE() << "got wrong type of result back";
+        return 0;
+    }
+    ql::datum_t deleted = stats->get_field("deleted", ql::NOTHROW);
+    return deleted.has() ? static_cast<uint64_t>(deleted.as_num()) : 0;
+}
+
+void run_expire_test(namespace_interface_t *nsi, order_source_t *osource) {
+    std::string id = create_sindex(nsi, osource);
+    wait_for_sindex(nsi, osource, id);
+
+    /* Rows 0 to 9 expire at that many seconds after the epoch. Row 10's `sid` isn't a
+    time, so it never expires. */
+    for (int i = 0; i <= 10; ++i) {
+        ql::datum_object_builder_t builder;
+        builder.overwrite("id", ql::datum_t(static_cast<double>(i)));
+        builder.overwrite("sid", i < 10
+            ? ql::pseudo::make_time(i, "+00:00")
+            : ql::datum_t(1.0));
+        store_key_t pk(ql::datum_t(static_cast<double>(i)).print_primary());
+        write_t write(point_write_t(pk, std::move(builder).to_datum()),
+                      DURABILITY_REQUIREMENT_SOFT, profile_bool_t::PROFILE,
+                      ql::configured_limits_t());
+        write_response_t response;
+        cond_t interruptor;
+        nsi->write(write, &response,
+                   osource->check_in("unittest::run_expire_test(rdb_protocol.cc-A"),
+                   &interruptor);
+    }
+
+    EXPECT_EQ(5u, expire_rows(nsi, osource, id, 5, 100));
+    EXPECT_EQ(0u, expire_rows(nsi, osource, id, 5, 100));
+    EXPECT_EQ(5u, expire_rows(nsi, osource, id, 1000, 100));
+    EXPECT_EQ(0u, expire_rows(nsi, osource, "doesnt_exist", 1000, 100));
+}
+
+TEST(RDBProtocol, Expire) {
+    run_in_thread_pool_with_namespace_interface(&run_expire_test, false);
+}
+
+TEST(RDBProtocol, OvershardedExpire) {
+    run_in_thread_pool_with_namespace_interface(&run_expire_test, true);
+}
+
+void run_primary_key_expire_test(namespace_interface_t *nsi, order_source_t *osource) {
+    /* Rows 0 to 9 are keyed by a time that many seconds after the epoch, as in a
+    time series. Row 10's key isn't a time, so it never expires. */
+    for (int i = 0; i <= 10; ++i) {
+        ql::datum_t id = i < 10
+            ? ql::pseudo::make_time(i, "+00:00")
+            : ql::datum_t(static_cast<double>(i));
+        ql::datum_object_builder_t builder;
+        builder.overwrite("id", id);
+        write_t write(point_write_t(store_key_t(id.print_primary()),
+                                    std::move(builder).to_datum()),
+                      DURABILITY_REQUIREMENT_SOFT, profile_bool_t::PROFILE,
+                      ql::configured_limits_t());
+        write_response_t response;
+        cond_t interruptor;
+        nsi->write(write, &response,
+                   osource->check_in(
+                       "unittest::run_primary_key_expire_test(rdb_protocol.cc-A"),
+                   &interruptor);
+    }
+
+    EXPECT_EQ(5u, expire_rows(nsi, osource, "id", 5, 100));
+    EXPECT_EQ(0u, expire_rows(nsi, osource, "id", 5, 100));
+    EXPECT_EQ(5u, expire_rows(nsi, osource, "id", 1000, 100));
+    EXPECT_EQ(0u, expire_rows(nsi, osource, "id", 1000, 100));
+}
+
+TEST(RDBProtocol, PrimaryKeyExpire) {
+    run_in_thread_pool_with_namespace_interface(&run_primary_key_expire_test, false);
+}
+
+TEST(RDBProtocol, OvershardedPrimaryKeyExpire) {
+    run_in_thread_pool_with_namespace_interface(&run_primary_key_expire_test, true);
+}
+
 TPTEST(RDBProtocol, ArtificialChangefeeds) {
     using ql::changefeed::artificial_t;
     using ql::changefeed::keyspec_t;
@@ -822,7 +920,8 @@ TPTEST(RDBProtocol, ArtificialChangefeeds) {
                     std::map<std::string, std::vector<ql::datum_t> >(),
                     store_key_t(ql::datum_t(static_cast<double>(i)).print_primary()),
                     ql::datum_t(-static_cast<double>(i)),
-                    ql::datum_t(static_cast<double>(i))}));
+                    ql::datum_t(static_cast<double>(i)),
+                    0}));
     }
     for (const auto &pair : bundles) {
         ql::batchspec_t bs(ql::batchspec_t::all()
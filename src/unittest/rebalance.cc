@@ -77,4 +77,24 @@ TEST(Rebalance, MaxKeyLength) {
     do_rebalance(distribution, 3);
 }
 
+TEST(Rebalance, LoadAware) {
+    std::map<store_key_t, int64_t> distribution;
+    for (char c = 'A'; c <= 'H'; ++c) {
+        distribution[store_key_t(std::string(1, c))] = 10;
+    }
+    /* Almost all of the accesses go to the first bucket. */
+    std::map<store_key_t, int64_t> access_counts;
+    access_counts[store_key_t("Abc")] = 760;
+    access_counts[store_key_t("F")] = 40;
+
+    table_shard_scheme_t unweighted = do_rebalance(distribution, 2);
+    ASSERT_EQ(1u, unweighted.split_points.size());
+    EXPECT_LT(store_key_t("D"), unweighted.split_points[0]);
+
+    table_shard_scheme_t weighted = do_rebalance(
+        weigh_distribution_by_load(distribution, access_counts), 2);
+    ASSERT_EQ(1u, weighted.split_points.size());
+    EXPECT_LT(weighted.split_points[0], store_key_t("B"));
+}
+
 }  // namespace unittest
@@ -0,0 +1,61 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "arch/runtime/coroutines.hpp"
+#include "arch/runtime/resource_usage.hpp"
+#include "arch/timing.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TPTEST(ResourceUsageTest, ChargesRunningTime) {
+    const ticks_t busy_time = 2 * MILLION;
+    resource_usage_t outer, inner;
+    {
+        charge_resource_usage_t charge_outer(&outer);
+        ASSERT_EQ(&outer, current_resource_usage());
+        {
+            charge_resource_usage_t charge_inner(&inner);
+            ASSERT_EQ(&inner, current_resource_usage());
+
+            const ticks_t start = get_ticks();
+            while (get_ticks() - start < busy_time) { }
+
+            // Neither waiting nor the coroutines that run meanwhile are charged.
+            bool spawned_is_charged = true;
+            coro_t::spawn_now_dangerously([&]() {
+                spawned_is_charged = current_resource_usage() != NULL;
+            });
+            ASSERT_FALSE(spawned_is_charged);
+            nap(50);
+
+            // A NULL usage doesn't change anything.
+            charge_resource_usage_t charge_nothing(NULL);
+            ASSERT_EQ(&inner, current_resource_usage());
+        }
+        ASSERT_EQ(&outer, current_resource_usage());
+    }
+    ASSERT_TRUE(current_resource_usage() == NULL);
+
+    EXPECT_GE(inner.run_ticks, busy_time);
+    EXPECT_LT(inner.run_ticks, 25 * MILLION);
+    EXPECT_LT(outer.run_ticks, 25 * MILLION);
+}
+
+TEST(ResourceUsageTest, Add) {
+    resource_usage_t a, b;
+    a.blocks_from_cache = 3;
+    a.rows_scanned = 10;
+    b.blocks_from_cache = 1;
+    b.blocks_from_disk = 2;
+    b.shard_requests = 1;
+    b.datum_bytes_allocated = 100;
+    a.add(b);
+    EXPECT_EQ(4u, a.blocks_from_cache);
+    EXPECT_EQ(2u, a.blocks_from_disk);
+    EXPECT_EQ(10u, a.rows_scanned);
+    EXPECT_EQ(1u, a.shard_requests);
+    EXPECT_EQ(100u, a.datum_bytes_allocated);
+    EXPECT_EQ(0u, a.rows_returned);
+}
+
+}  // namespace unittest
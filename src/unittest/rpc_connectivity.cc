@@ -456,6 +456,76 @@ TPTEST_MULTITHREAD(RPCConnectivityTest, BinaryData, 3) {
     EXPECT_TRUE(a2.got_spectrum);
 }
 
+/* `CompressedData` sends messages that are large enough to get compressed, in both
+directions between a node that compresses its messages and one that doesn't. */
+
+class repeated_spectrum_test_application_t : public cluster_message_handler_t {
+public:
+    static const int repetitions = 256;
+    explicit repeated_spectrum_test_application_t(connectivity_cluster_t *cm) :
+        cluster_message_handler_t(cm, 'R'),
+        spectra_received(0)
+        { }
+    void send_spectra(peer_id_t peer) {
+        class spectra_writer_t : public cluster_send_message_write_callback_t {
+        public:
+            virtual ~spectra_writer_t() { }
+            void write(write_stream_t *stream) {
+                char spectrum[CHAR_MAX - CHAR_MIN + 1];
+                for (int i = CHAR_MIN; i <= CHAR_MAX; i++) {
+                    spectrum[i - CHAR_MIN] = i;
+                }
+                for (int r = 0; r < repetitions; ++r) {
+                    int64_t res = stream->write(spectrum, CHAR_MAX - CHAR_MIN + 1);
+                    if (res != CHAR_MAX - CHAR_MIN + 1) { throw fake_archive_exc_t(); }
+                }
+            }
+        } writer;
+        auto_drainer_t::lock_t connection_keepalive;
+        connectivity_cluster_t::connection_t *connection =
+            get_connectivity_cluster()->get_connection(peer, &connection_keepalive);
+        ASSERT_TRUE(connection != NULL);
+        get_connectivity_cluster()->send_message(connection, connection_keepalive,
+                                                 get_message_tag(), &writer);
+    }
+    void on_message(connectivity_cluster_t::connection_t *,
+                    auto_drainer_t::lock_t,
+                    read_stream_t *stream) {
+        for (int r = 0; r < repetitions; ++r) {
+            char spectrum[CHAR_MAX - CHAR_MIN + 1];
+            int64_t res = force_read(stream, spectrum, CHAR_MAX - CHAR_MIN + 1);
+            if (res != CHAR_MAX - CHAR_MIN + 1) { throw fake_archive_exc_t(); }
+
+            for (int i = CHAR_MIN; i <= CHAR_MAX; i++) {
+                EXPECT_EQ(spectrum[i - CHAR_MIN], i);
+            }
+        }
+        ++spectra_received;
+    }
+    int spectra_received;
+};
+
+TPTEST_MULTITHREAD(RPCConnectivityTest, CompressedData, 3) {
+    connectivity_cluster_t c1, c2;
+    repeated_spectrum_test_application_t a1(&c1), a2(&c2);
+    connectivity_cluster_t::run_t cr1(&c1, get_unittest_addresses(), peer_address_t(),
+        ANY_PORT, 0, true);
+    connectivity_cluster_t::run_t cr2(&c2, get_unittest_addresses(), peer_address_t(),
+        ANY_PORT, 0, false);
+    cr1.join(get_cluster_local_address(&c2));
+
+    let_stuff_happen();
+
+    a1.send_spectra(c2.get_me());
+    a1.send_spectra(c2.get_me());
+    a2.send_spectra(c1.get_me());
+
+    let_stuff_happen();
+
+    EXPECT_EQ(2, a2.spectra_received);
+    EXPECT_EQ(1, a1.spectra_received);
+}
+
 /* `PeerIDSemantics` makes sure that `peer_id_t::is_nil()` works as expected. */
 TPTEST_MULTITHREAD(RPCConnectivityTest, PeerIDSemantics, 3) {
     peer_id_t nil_peer;
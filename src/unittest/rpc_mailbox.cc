@@ -178,4 +178,34 @@ TPTEST_MULTITHREAD(RPCMailboxTest, TypedMailbox, 3) {
     }
 }
 
+/* `SendMovingLocally` makes sure that `send_moving_locally()` hands messages straight
+to a mailbox on this server, including from another thread. */
+
+TPTEST_MULTITHREAD(RPCMailboxTest, SendMovingLocally, 3) {
+    connectivity_cluster_t c;
+    mailbox_manager_t m(&c, 'M');
+    connectivity_cluster_t::run_t r(&c, get_unittest_addresses(), peer_address_t(),
+        ANY_PORT, 0);
+
+    std::vector<std::string> inbox;
+    mailbox_t<void(std::string)> mbox(&m,
+        [&](signal_t *, std::string &&str) {
+            inbox.push_back(std::move(str));
+        });
+
+    mailbox_addr_t<void(std::string)> addr = mbox.get_address();
+
+    send_moving_locally(&m, addr, std::string("foo"));
+    /* The message was handed over before `send_moving_locally()` returned. */
+    ASSERT_EQ(1u, inbox.size());
+    EXPECT_EQ("foo", inbox[0]);
+
+    {
+        on_thread_t thread_switcher(threadnum_t(1));
+        send_moving_locally(&m, addr, std::string("bar"));
+    }
+    ASSERT_EQ(2u, inbox.size());
+    EXPECT_EQ("bar", inbox[1]);
+}
+
 }   /* namespace unittest */
@@ -222,6 +222,24 @@ TPTEST_MULTITHREAD(RPCSemilatticeTest, MemberView, 3) {
     EXPECT_EQ(9u, foo_view->get().i);
 }
 
+/* `MapDelta` tests that the delta of two maps contains only the changed entries. */
+TEST(RPCSemilatticeTest, MapDelta) {
+    std::map<std::string, int> before;
+    before["foo"] = 1;
+    before["bar"] = 2;
+    std::map<std::string, int> after = before;
+    after["bar"] = 3;
+    after["baz"] = 4;
+
+    std::map<std::string, int> delta = semilattice_delta(before, after);
+    EXPECT_EQ(2u, delta.size());
+    EXPECT_EQ(0u, delta.count("foo"));
+    EXPECT_EQ(3, delta["bar"]);
+    EXPECT_EQ(4, delta["baz"]);
+
+    EXPECT_TRUE(semilattice_delta(after, after).empty());
+}
+
 }   /* namespace unittest */
 
 #include "rpc/semilattice/semilattice_manager.tcc"
@@ -56,6 +56,36 @@ TEST(RwlockTest, ReadAfterWrite) {
     run_in_thread_pool(&read_after_write);
 }
 
+TPTEST(RwlockTest, UncontendedAcquisition) {
+    rwlock_t lock;
+    {
+        // Readers behind readers get the lock as soon as they get in line.
+        rwlock_in_line_t read1(&lock, access_t::read);
+        rwlock_in_line_t read2(&lock, access_t::read);
+        EXPECT_TRUE(read1.read_signal()->is_pulsed());
+        EXPECT_TRUE(read2.read_signal()->is_pulsed());
+
+        // A writer waits for them, and readers behind the writer wait too.
+        rwlock_in_line_t write(&lock, access_t::write);
+        rwlock_in_line_t read3(&lock, access_t::read);
+        EXPECT_FALSE(write.read_signal()->is_pulsed());
+        EXPECT_FALSE(read3.read_signal()->is_pulsed());
+
+        read1.reset();
+        read2.reset();
+        EXPECT_TRUE(write.write_signal()->is_pulsed());
+        EXPECT_FALSE(read3.read_signal()->is_pulsed());
+        write.reset();
+        EXPECT_TRUE(read3.read_signal()->is_pulsed());
+    }
+    {
+        // A writer on an idle lock gets it right away.
+        rwlock_in_line_t write(&lock, access_t::write);
+        EXPECT_TRUE(write.read_signal()->is_pulsed());
+        EXPECT_TRUE(write.write_signal()->is_pulsed());
+    }
+}
+
 
 
 }  // namespace unittest
@@ -0,0 +1,23 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "rdb_protocol/table_affinity.hpp"
+#include "unittest/gtest.hpp"
+
+namespace unittest {
+
+TEST(TableAffinity, Streak) {
+    table_affinity_t affinity;
+    EXPECT_TRUE(affinity.get_preferred_thread() == INVALID_THREAD);
+
+    for (int i = 0; i < 100; ++i) {
+        affinity.note_table_access(threadnum_t(2));
+    }
+    EXPECT_EQ(2, affinity.get_preferred_thread().threadnum);
+
+    // One query on a table that lives elsewhere starts the streak over.
+    affinity.note_table_access(INVALID_THREAD);
+    EXPECT_TRUE(affinity.get_preferred_thread() == INVALID_THREAD);
+    affinity.note_table_access(threadnum_t(2));
+    EXPECT_TRUE(affinity.get_preferred_thread() == INVALID_THREAD);
+}
+
+}  // namespace unittest
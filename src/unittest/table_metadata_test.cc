@@ -0,0 +1,72 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <string>
+
+#include "unittest/gtest.hpp"
+
+#include "clustering/administration/tables/table_metadata.hpp"
+#include "containers/archive/string_stream.hpp"
+#include "containers/archive/versioned.hpp"
+#include "containers/uuid.hpp"
+
+namespace unittest {
+
+static std::string message_to_string(write_message_t *wm) {
+    std::string out;
+    intrusive_list_t<write_buffer_t> *buffers = wm->unsafe_expose_buffers();
+    for (write_buffer_t *p = buffers->head(); p; p = buffers->next(p)) {
+        out.append(p->data, p->data + p->size);
+    }
+    return out;
+}
+
+static table_config_t make_table_config() {
+    table_config_t config;
+    table_config_t::shard_t shard;
+    shard.primary_replica = generate_uuid();
+    shard.replicas.insert(shard.primary_replica);
+    config.shards.push_back(shard);
+    config.write_ack_config.mode = write_ack_config_t::mode_t::majority;
+    config.durability = write_durability_t::HARD;
+    return config;
+}
+
+TEST(TableMetadataTest, ConfigRoundTrip) {
+    table_config_t config = make_table_config();
+    config.cache.min_bytes = 1000;
+    config.write_limits.writes_per_sec = 100;
+    config.expiry.index = std::string("expires");
+    config.block_size = 16384;
+    config.cpu_shards = 2;
+    config.compress_blocks = true;
+
+    write_message_t wm;
+    serialize<cluster_version_t::LATEST_DISK>(&wm, config);
+    string_read_stream_t stream(message_to_string(&wm), 0);
+    table_config_t out;
+    ASSERT_EQ(archive_result_t::SUCCESS,
+              deserialize<cluster_version_t::LATEST_DISK>(&stream, &out));
+    ASSERT_TRUE(config == out);
+}
+
+TEST(TableMetadataTest, ConfigFromV2_0) {
+    // Table configurations written by v2.0 end after the durability.
+    const table_config_t config = make_table_config();
+    write_message_t wm;
+    serialize<cluster_version_t::LATEST_DISK>(&wm, config.shards);
+    serialize<cluster_version_t::LATEST_DISK>(&wm, config.write_ack_config);
+    serialize<cluster_version_t::LATEST_DISK>(&wm, config.durability);
+    string_read_stream_t stream(message_to_string(&wm), 0);
+
+    table_config_t out;
+    out.cache.min_bytes = 1000;
+    out.block_size = 16384;
+    out.cpu_shards = 2;
+    out.compress_blocks = true;
+    ASSERT_EQ(archive_result_t::SUCCESS,
+              deserialize<cluster_version_t::v2_0>(&stream, &out));
+    ASSERT_TRUE(config == out);
+    char c;
+    ASSERT_EQ(0, force_read(&stream, &c, 1));
+}
+
+}  // namespace unittest
@@ -0,0 +1,48 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <functional>
+#include <set>
+#include <vector>
+
+#include "arch/io/network.hpp"
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "arch/types.hpp"
+#include "concurrency/cond_var.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+/* `PerThread` makes sure that a `per_thread_tcp_listener_t` accepts every connection
+exactly once, and calls the callback on a thread that has a listener. */
+TPTEST_MULTITHREAD(TcpListener, PerThread, 4) {
+    const int num_threads = get_num_threads();
+    std::vector<intptr_t> accepted(num_threads, 0);
+
+    per_thread_tcp_listener_t listener(std::set<ip_address_t>(), ANY_PORT, num_threads,
+        [&](scoped_ptr_t<tcp_conn_descriptor_t> &) {
+            __sync_add_and_fetch(&accepted[get_thread_id().threadnum], 1);
+        });
+    EXPECT_NE(ANY_PORT, listener.get_port());
+
+    const intptr_t num_conns = 64;
+    cond_t non_interruptor;
+    ip_address_t loopback("127.0.0.1");
+    std::vector<scoped_ptr_t<tcp_conn_t> > conns;
+    for (intptr_t i = 0; i < num_conns; ++i) {
+        conns.push_back(scoped_ptr_t<tcp_conn_t>(
+            new tcp_conn_t(loopback, listener.get_port(), &non_interruptor)));
+    }
+
+    intptr_t total = 0;
+    for (int attempt = 0; attempt < 500 && total < num_conns; ++attempt) {
+        nap(10);
+        total = 0;
+        for (int i = 0; i < num_threads; ++i) {
+            total += __atomic_load_n(&accepted[i], __ATOMIC_RELAXED);
+        }
+    }
+    EXPECT_EQ(num_conns, total);
+}
+
+}  // namespace unittest
@@ -1,7 +1,9 @@
 // Copyright 2010-2014 RethinkDB, all rights reserved.
 #include <algorithm>
+#include <vector>
 
 #include "arch/timing.hpp"
+#include "containers/scoped.hpp"
 #include "concurrency/pmap.hpp"
 #include "unittest/gtest.hpp"
 #include "unittest/unittest_utils.hpp"
@@ -31,6 +33,33 @@ void walk_wait_times(int i) {
 TPTEST(TimerTest, TestApproximateWaitTimes) {
     pmap(2, walk_wait_times);
 }
+/* Timers that are due after the current wheel tick spend some time in the timing wheel
+before they're moved into the priority queue, and timers that get canceled never leave
+the wheel. `TestWheelTimers` checks that neither affects the timers that do fire. */
+TPTEST(TimerTest, TestWheelTimers) {
+    std::vector<scoped_ptr_t<signal_timer_t> > canceled;
+    for (int64_t ms = 1; ms < 100000; ms = ms * 3 + 1) {
+        canceled.push_back(make_scoped<signal_timer_t>(ms));
+    }
+
+    signal_timer_t short_timer(30);
+    signal_timer_t long_timer(1500);
+    const ticks_t start = get_ticks();
+
+    canceled.clear();
 
+    short_timer.wait();
+    const int64_t short_diff = static_cast<int64_t>(get_ticks()) - static_cast<int64_t>(start);
+    ASSERT_LT(
+        llabs(short_diff - 30 * MILLION),
+        std::max(short_diff / 4, static_cast<int64_t>(2 * MILLION)));
+    ASSERT_FALSE(long_timer.is_pulsed());
+
+    long_timer.wait();
+    const int64_t long_diff = static_cast<int64_t>(get_ticks()) - static_cast<int64_t>(start);
+    ASSERT_LT(
+        llabs(long_diff - 1500 * MILLION),
+        std::max(long_diff / 4, static_cast<int64_t>(2 * MILLION)));
+}
 
 }  // namespace unittest
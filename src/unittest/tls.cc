@@ -0,0 +1,100 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <stdio.h>
+
+#include <set>
+#include <string>
+
+#include "arch/io/network.hpp"
+#include "arch/io/tls.hpp"
+#include "arch/types.hpp"
+#include "concurrency/cond_var.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+/* Writes a new self-signed certificate and its key, both PEM-encoded, to `path`. */
+void write_self_signed_certificate(const std::string &path) {
+    EVP_PKEY_CTX *key_ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, NULL);
+    guarantee(key_ctx != NULL);
+    guarantee(EVP_PKEY_keygen_init(key_ctx) == 1);
+    guarantee(EVP_PKEY_CTX_set_rsa_keygen_bits(key_ctx, 2048) == 1);
+    EVP_PKEY *key = NULL;
+    guarantee(EVP_PKEY_keygen(key_ctx, &key) == 1);
+    EVP_PKEY_CTX_free(key_ctx);
+
+    X509 *cert = X509_new();
+    guarantee(cert != NULL);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_get_notBefore(cert), 0);
+    X509_gmtime_adj(X509_get_notAfter(cert), 24 * 60 * 60);
+    X509_set_pubkey(cert, key);
+    X509_NAME *name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char *>("localhost"),
+                               -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    guarantee(X509_sign(cert, key, EVP_sha256()) != 0);
+
+    FILE *file = fopen(path.c_str(), "w");
+    guarantee(file != NULL);
+    guarantee(PEM_write_X509(file, cert) == 1);
+    guarantee(PEM_write_PrivateKey(file, key, NULL, NULL, 0, NULL, NULL) == 1);
+    fclose(file);
+
+    X509_free(cert);
+    EVP_PKEY_free(key);
+}
+
+/* `EchoAndResume` sends data both ways over a TLS connection, and checks that the
+client keeps the session so that it can resume it. */
+TPTEST(TLS, EchoAndResume) {
+    temp_file_t cert_file;
+    const std::string cert_path = cert_file.name().permanent_path();
+    write_self_signed_certificate(cert_path);
+
+    tls_ctx_t server_ctx(tls_role_t::SERVER, cert_path, cert_path, "");
+    tls_ctx_t client_ctx(tls_role_t::CLIENT, "", "", cert_path);
+
+    cond_t non_interruptor;
+    tcp_listener_t listener(std::set<ip_address_t>(), ANY_PORT,
+        [&](scoped_ptr_t<tcp_conn_descriptor_t> &nconn) {
+            scoped_ptr_t<tcp_conn_t> conn;
+            nconn->make_overcomplicated(&conn);
+            try {
+                conn->enable_tls(&server_ctx, &non_interruptor);
+                char buffer[5];
+                conn->read(buffer, sizeof(buffer), &non_interruptor);
+                conn->write(buffer, sizeof(buffer), &non_interruptor);
+                conn->read(buffer, 1, &non_interruptor);
+            } catch (const tcp_conn_t::tls_failed_exc_t &ex) {
+                ADD_FAILURE() << ex.what();
+            } catch (const tcp_conn_read_closed_exc_t &) {
+            } catch (const tcp_conn_write_closed_exc_t &) {
+            }
+        });
+
+    ip_address_t loopback("127.0.0.1");
+    for (int i = 0; i < 2; ++i) {
+        tcp_conn_t conn(loopback, listener.get_port(), &non_interruptor);
+        conn.enable_tls(&client_ctx, &non_interruptor);
+        conn.write("hello", 5, &non_interruptor);
+        char buffer[5];
+        conn.read(buffer, sizeof(buffer), &non_interruptor);
+        EXPECT_EQ("hello", std::string(buffer, sizeof(buffer)));
+    }
+
+    ip_and_port_t server_address(loopback, port_t(listener.get_port()));
+    ssl_session_st *session = client_ctx.get_session(server_address.to_string());
+    EXPECT_TRUE(session != NULL);
+    if (session != NULL) {
+        SSL_SESSION_free(session);
+    }
+}
+
+}  // namespace unittest
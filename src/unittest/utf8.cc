@@ -110,6 +110,22 @@ TEST(UTF8ValidationTest, NullBytes) {
     ASSERT_STREQ("Invalid initial byte seen", reason.explanation);
 }
 
+TEST(UTF8ValidationTest, LongAsciiRuns) {
+    utf8::reason_t reason;
+
+    // Long runs of ASCII are skipped a word at a time, so check that the position of
+    // a bad byte after (or in the middle of) such a run is still right.
+    ASSERT_TRUE(utf8::is_valid("abcdefghijklmnopqrstuvwxyz\xc2\xa2abcdefghij"));
+    ASSERT_FALSE(utf8::is_valid("abcdefghijklmnopqrstuvwxyz\xff", &reason));
+    ASSERT_EQ(26, reason.position);
+    ASSERT_STREQ("Invalid initial byte seen", reason.explanation);
+    ASSERT_FALSE(utf8::is_valid("abcdefghijk\xffmnopqrstuvwxyz", &reason));
+    ASSERT_EQ(11, reason.position);
+    ASSERT_FALSE(utf8::is_valid("abcdefgh\xc2", &reason));
+    ASSERT_EQ(9, reason.position);
+    ASSERT_STREQ("Expected continuation byte, saw end of string", reason.explanation);
+}
+
 TEST(UTF8ValidationTest, IllegalCharacters) {
     utf8::reason_t reason;
 
@@ -4,6 +4,7 @@
 #include "arch/address.hpp"
 #include "arch/runtime/runtime.hpp"
 #include "btree/keys.hpp"
+#include "concurrency/pmap.hpp"
 #include "stl_utils.hpp"
 #include "unittest/unittest_utils.hpp"
 #include "unittest/gtest.hpp"
@@ -138,6 +139,19 @@ TPTEST(UtilsTest, IPAddress) {
     }
 }
 
+// Concurrent lookups of the same host wait for a single `getaddrinfo()` call, and
+// must all get its result
+TPTEST(UtilsTest, ConcurrentHostLookups) {
+    std::vector<std::set<ip_address_t> > results(16);
+    pmap(results.size(), [&](size_t i) {
+        results[i] = hostname_to_ips("198.51.100.7");
+    });
+    for (const auto &ips : results) {
+        ASSERT_EQ(static_cast<size_t>(1), ips.size());
+        EXPECT_EQ("198.51.100.7", ips.begin()->to_string());
+    }
+}
+
 TEST(StlUtilsTest, SplitString) {
     EXPECT_EQ(make_vector<std::string>(""), split_string("", '.'));
     EXPECT_EQ(make_vector<std::string>("", ""), split_string(".", '.'));
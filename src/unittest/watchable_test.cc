@@ -0,0 +1,55 @@
+// Copyright 2010-2015 RethinkDB, all rights reserved.
+#include "arch/runtime/coroutines.hpp"
+#include "arch/timing.hpp"
+#include "concurrency/watchable.hpp"
+#include "unittest/gtest.hpp"
+#include "unittest/unittest_utils.hpp"
+
+namespace unittest {
+
+TPTEST(Watchable, CoalescedSubscription) {
+    watchable_variable_t<int> var(0);
+    clone_ptr_t<watchable_t<int> > watchable = var.get_watchable();
+    int calls = 0;
+    int last_seen = -1;
+    watchable_t<int>::coalesced_subscription_t subs([&]() {
+        ++calls;
+        last_seen = watchable->get();
+    });
+    {
+        watchable_t<int>::freeze_t freeze(watchable);
+        subs.reset(watchable, &freeze);
+    }
+
+    /* A burst of changes is delivered once, after `set_value()` returns. */
+    var.set_value(1);
+    var.set_value(2);
+    var.set_value(3);
+    EXPECT_EQ(0, calls);
+    coro_t::yield();
+    EXPECT_EQ(1, calls);
+    EXPECT_EQ(3, last_seen);
+
+    /* Changes made while the callback blocks are delivered in one more call. */
+    calls = 0;
+    watchable_t<int>::coalesced_subscription_t blocking_subs([&]() {
+        ++calls;
+        nap(10);
+        last_seen = watchable->get();
+    });
+    {
+        watchable_t<int>::freeze_t freeze(watchable);
+        subs.reset();
+        blocking_subs.reset(watchable, &freeze);
+    }
+    var.set_value(4);
+    coro_t::yield();
+    EXPECT_EQ(1, calls);
+    var.set_value(5);
+    var.set_value(6);
+    nap(50);
+    EXPECT_EQ(2, calls);
+    EXPECT_EQ(6, last_seen);
+}
+
+}  // namespace unittest
@@ -58,6 +58,9 @@ class JobsTestCase(rdb_unittest.RdbTestCase):
         self.assertTrue(response[0]["duration_sec"] >= test_duration)   # assertGreaterEqual in 2.7
         self.assertEqual(response[0]["id"][0], "query")
         self.assertEqual(response[0]["servers"], [server.name])
+        usage = response[0]["info"]["usage"]
+        self.assertTrue(usage["cpu_time_sec"] >= 0)
+        self.assertTrue(usage["shard_requests"] >= 0)
 
     def test_index_construction_disk_compaction(self):
         self.r.db(self.dbName) \
@@ -180,6 +180,8 @@ def compare_global_and_individual_stats(global_stats, individual_stats, expected
             assert a['query_engine']['written_docs_per_sec'] > 0
             assert b['query_engine']['written_docs_per_sec'] > 0
             assert a['query_engine']['queries_total'] <= b['query_engine']['queries_total']
+            assert set(b['query_engine']['query_latency'].keys()) == \
+                set(['count', 'p50', 'p90', 'p99', 'p999', 'max'])
             assert a['query_engine']['read_docs_total'] <= b['query_engine']['read_docs_total']
             assert a['query_engine']['written_docs_total'] <= b['query_engine']['written_docs_total']
         elif a['id'][0] == 'table':
@@ -63,6 +63,11 @@ with driver.Cluster(initial_servers=['a', 'b', 'never_used'], output_folder='.',
                     assert doc["server"] != "never_used"
             if len(s_shards) != len(c_shards):
                 return False
+            # The shards' key ranges cover the whole key space, in order.
+            assert len(s_shards[0]["key_range"][0]) == 0
+            assert s_shards[-1]["key_range"][1] is None
+            for (left, right) in zip(s_shards, s_shards[1:]):
+                assert left["key_range"][1] == right["key_range"][0]
             for (s_shard, c_shard) in zip(s_shards, c_shards):
                 if set(doc["server"] for doc in s_shard["replicas"]) != \
                         set(c_shard["replicas"]):
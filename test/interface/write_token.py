@@ -0,0 +1,66 @@
+#!/usr/bin/env python
+# Copyright 2015 RethinkDB, all rights reserved.
+
+"""The `interface.write_token` test checks that reads with a write token see the write on secondary replicas, which may lag behind the primary."""
+
+from __future__ import print_function
+
+import os, sys, time
+
+try:
+    xrange
+except NameError:
+    xrange = range
+
+startTime = time.time()
+
+sys.path.append(os.path.abspath(os.path.join(os.path.dirname(__file__), os.path.pardir, 'common')))
+import driver, scenario_common, utils, vcoptparse
+
+op = vcoptparse.OptParser()
+scenario_common.prepare_option_parser_mode_flags(op)
+_, command_prefix, serve_options = scenario_common.parse_mode_flags(op.parse(sys.argv))
+
+r = utils.import_python_driver()
+dbName, tableName = utils.get_test_db_table()
+
+num_writes = 500
+
+print("Starting cluster of three servers (%.2fs)" % (time.time() - startTime))
+with driver.Cluster(initial_servers=['a', 'b', 'c'], output_folder='.', command_prefix=command_prefix, extra_options=serve_options) as cluster:
+    cluster.check()
+
+    print("Establishing ReQL connections (%.2fs)" % (time.time() - startTime))
+    primary = cluster[0]
+    secondaries = cluster[1:]
+    primary_conn = r.connect(host=primary.host, port=primary.driver_port)
+    # Token reads prefer a replica on the server that the query runs on, so these go
+    # to the secondaries.
+    secondary_conns = [r.connect(host=server.host, port=server.driver_port)
+                       for server in secondaries]
+
+    print("Creating a table with one primary and two secondaries (%.2fs)" % (time.time() - startTime))
+    if dbName not in r.db_list().run(primary_conn):
+        r.db_create(dbName).run(primary_conn)
+    r.db(dbName).table_create(tableName).run(primary_conn)
+    tbl = r.db(dbName).table(tableName)
+    # With a single ack, writes return before the secondaries have applied them.
+    tbl.config().update({
+        'shards': [{'primary_replica': primary.name,
+                    'replicas': [server.name for server in cluster]}],
+        'write_acks': 'single',
+        'durability': 'soft'}).run(primary_conn)
+    tbl.wait().run(primary_conn)
+    tbl.insert({'id': 0, 'n': 0}).run(primary_conn)
+
+    print("Writing and reading back on the secondaries (%.2fs)" % (time.time() - startTime))
+    for i in xrange(1, num_writes + 1):
+        res = tbl.get(0).update({'n': i}, return_write_token=True).run(primary_conn)
+        assert res['replaced'] == 1, res
+        token = res['write_token']
+        for conn in secondary_conns:
+            n = r.db(dbName).table(tableName, write_token=token).get(0)['n'].run(conn)
+            assert n == i, "Read with a write token returned %r instead of %d" % (n, i)
+
+    cluster.check_and_stop()
+print("Done. (%.2fs)" % (time.time() - startTime))